@@ -6,6 +6,7 @@
 
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 
 #include "bmp_pvt.h"
 
@@ -21,7 +22,7 @@ public:
     virtual const char* format_name(void) const override { return "bmp"; }
     int supports(string_view feature) const override
     {
-        return feature == "ioproxy";
+        return feature == "ioproxy" || feature == "sequential_io";
     }
     virtual bool valid_file(const std::string& filename) const override;
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
@@ -30,6 +31,8 @@ public:
     virtual bool close(void) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
 
 private:
     int64_t m_padded_scanline_size;
@@ -57,6 +60,20 @@ private:
     bool read_color_table();
     bool color_table_is_all_gray();
     bool read_rle_image();
+    bool is_rle() const
+    {
+        return m_dib_header.compression == RLE4_COMPRESSION
+               || m_dib_header.compression == RLE8_COMPRESSION;
+    }
+    // Which scanline of the file holds scanline y of the image
+    int file_scanline(int y) const
+    {
+        // if the height is positive scanlines are stored bottom-up
+        return m_dib_header.height >= 0 ? m_spec.height - y - 1 : y;
+    }
+    // Decode one uncompressed scanline as stored in the file (`filebuf`)
+    // into `data`.
+    void decode_scanline(const unsigned char* filebuf, void* data) const;
 
     bool ioeof() { return size_t(ioproxy()->tell()) == ioproxy()->size(); }
 };
@@ -82,6 +99,10 @@ bmp_input_imageio_create()
 
 OIIO_EXPORT const char* bmp_input_extensions[] = { "bmp", "dib", nullptr };
 
+OIIO_EXPORT const char* bmp_input_signatures[] = {
+    "424d", "4241", "4349", "4350", "5054", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -297,10 +318,8 @@ BmpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     if (y < 0 || y > m_spec.height)
         return false;
 
-    size_t scanline_bytes = m_spec.scanline_bytes();
-    uint8_t* mscanline    = (uint8_t*)data;
-    if (m_dib_header.compression == RLE4_COMPRESSION
-        || m_dib_header.compression == RLE8_COMPRESSION) {
+    if (is_rle()) {
+        uint8_t* mscanline = (uint8_t*)data;
         for (int x = 0; x < m_spec.width; ++x) {
             int p = m_uncompressed[(m_spec.height - 1 - y) * m_spec.width + x];
             mscanline[3 * x]     = m_colortable[p].r;
@@ -310,34 +329,94 @@ BmpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
         return true;
     }
 
-    // if the height is positive scanlines are stored bottom-up
-    if (m_dib_header.height >= 0)
-        y = m_spec.height - y - 1;
-    const int64_t scanline_off = y * m_padded_scanline_size;
-
+    const int64_t offset = m_bmp_header.offset
+                           + file_scanline(y) * m_padded_scanline_size;
+    cspan<unsigned char> view = ioproxy()->view(offset,
+                                                m_padded_scanline_size);
+    if (view.size() == m_padded_scanline_size) {
+        decode_scanline(view.data(), data);
+        return true;
+    }
     fscanline.resize(m_padded_scanline_size);
-    ioseek(m_bmp_header.offset + scanline_off);
+    ioseek(offset);
     if (!ioread(fscanline.data(), m_padded_scanline_size)) {
         return false;  // Read failed
     }
+    decode_scanline(fscanline.data(), data);
+    return true;
+}
+
+
+
+bool
+BmpInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int z, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+    if (is_rle() || yend - ybegin < 2)
+        return ImageInput::read_native_scanlines(subimage, miplevel, ybegin,
+                                                 yend, z, data);
+    if (ybegin < 0 || yend > m_spec.height)
+        return false;
+
+    // Uncompressed scanlines are all the same size at fixed offsets, so the
+    // requested ones are one contiguous run of the file (in reverse order
+    // if it's stored bottom-up). Use it in place if the proxy can show it
+    // to us (for example, if the file is memory mapped), otherwise read it
+    // all at once, then decode the scanlines in parallel.
+    int firstrow = std::min(file_scanline(ybegin), file_scanline(yend - 1));
+    int64_t offset = m_bmp_header.offset + firstrow * m_padded_scanline_size;
+    size_t size    = size_t(yend - ybegin) * m_padded_scanline_size;
+    cspan<unsigned char> view = ioproxy()->view(offset, size);
+    const unsigned char* raw  = view.data();
+    if (size_t(view.size()) != size) {
+        fscanline.resize(size);
+        if (ioproxy()->pread(fscanline.data(), size, offset) != size) {
+            errorfmt("Read error reading scanlines {}-{}", ybegin, yend - 1);
+            return false;
+        }
+        raw = fscanline.data();
+    }
+
+    size_t scanline_bytes = m_spec.scanline_bytes();
+    parallel_for_chunked(
+        ybegin, yend, 0,
+        [&](int64_t b, int64_t e) {
+            for (int64_t y = b; y < e; ++y)
+                decode_scanline(raw
+                                    + (file_scanline(int(y)) - firstrow)
+                                          * m_padded_scanline_size,
+                                (uint8_t*)data + (y - ybegin) * scanline_bytes);
+        },
+        parallel_options(threads(), Split_Y, 1));
+    return true;
+}
+
+
+
+void
+BmpInput::decode_scanline(const unsigned char* filebuf, void* data) const
+{
+    size_t scanline_bytes = m_spec.scanline_bytes();
+    uint8_t* mscanline    = (uint8_t*)data;
 
     // in each case we process only first m_spec.scanline_bytes () bytes
     // as only they contain information about pixels. The rest are just
     // because scanline size have to be 32-bit boundary
     if (m_dib_header.bpp == 24 || m_dib_header.bpp == 32) {
-        for (unsigned int i = 0; i < m_spec.scanline_bytes();
-             i += m_spec.nchannels)
-            std::swap(fscanline[i], fscanline[i + 2]);
-        memcpy(data, fscanline.data(), m_spec.scanline_bytes());
-        return true;
+        memcpy(data, filebuf, scanline_bytes);
+        for (size_t i = 0; i < scanline_bytes; i += m_spec.nchannels)
+            std::swap(mscanline[i], mscanline[i + 2]);
+        return;
     }
-
     if (m_dib_header.bpp == 16) {
         const uint16_t RED   = 0x7C00;
         const uint16_t GREEN = 0x03E0;
         const uint16_t BLUE  = 0x001F;
         for (unsigned int i = 0, j = 0; j < scanline_bytes; i += 2, j += 3) {
-            uint16_t pixel   = (uint16_t) * (&fscanline[i]);
+            uint16_t pixel   = (uint16_t) * (&filebuf[i]);
             mscanline[j]     = (uint8_t)((pixel & RED) >> 8);
             mscanline[j + 1] = (uint8_t)((pixel & GREEN) >> 4);
             mscanline[j + 2] = (uint8_t)(pixel & BLUE);
@@ -347,29 +426,29 @@ BmpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
         if (m_allgray) {
             // Keep it as 1-channel image because all colors are gray
             for (unsigned int i = 0; i < scanline_bytes; ++i) {
-                mscanline[i] = m_colortable[fscanline[i]].r;
+                mscanline[i] = m_colortable[filebuf[i]].r;
             }
         } else {
             // Expand palette image into 3-channel RGB (existing code)
             for (unsigned int i = 0, j = 0; j < scanline_bytes; ++i, j += 3) {
-                mscanline[j]     = m_colortable[fscanline[i]].r;
-                mscanline[j + 1] = m_colortable[fscanline[i]].g;
-                mscanline[j + 2] = m_colortable[fscanline[i]].b;
+                mscanline[j]     = m_colortable[filebuf[i]].r;
+                mscanline[j + 1] = m_colortable[filebuf[i]].g;
+                mscanline[j + 2] = m_colortable[filebuf[i]].b;
             }
         }
     }
     if (m_dib_header.bpp == 4) {
         for (unsigned int i = 0, j = 0; j < scanline_bytes; ++i, j += 6) {
             uint8_t mask     = 0xF0;
-            mscanline[j]     = m_colortable[(fscanline[i] & mask) >> 4].r;
-            mscanline[j + 1] = m_colortable[(fscanline[i] & mask) >> 4].g;
-            mscanline[j + 2] = m_colortable[(fscanline[i] & mask) >> 4].b;
+            mscanline[j]     = m_colortable[(filebuf[i] & mask) >> 4].r;
+            mscanline[j + 1] = m_colortable[(filebuf[i] & mask) >> 4].g;
+            mscanline[j + 2] = m_colortable[(filebuf[i] & mask) >> 4].b;
             if (j + 3 >= scanline_bytes)
                 break;
             mask             = 0x0F;
-            mscanline[j + 3] = m_colortable[fscanline[i] & mask].r;
-            mscanline[j + 4] = m_colortable[fscanline[i] & mask].g;
-            mscanline[j + 5] = m_colortable[fscanline[i] & mask].b;
+            mscanline[j + 3] = m_colortable[filebuf[i] & mask].r;
+            mscanline[j + 4] = m_colortable[filebuf[i] & mask].g;
+            mscanline[j + 5] = m_colortable[filebuf[i] & mask].b;
         }
     }
     if (m_dib_header.bpp == 1) {
@@ -378,7 +457,7 @@ BmpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
                 if (size_t(k + 2) >= scanline_bytes)
                     break;
                 int index = 0;
-                if (fscanline[i] & (1 << j))
+                if (filebuf[i] & (1 << j))
                     index = 1;
                 mscanline[k]     = m_colortable[index].r;
                 mscanline[k + 1] = m_colortable[index].g;
@@ -386,7 +465,6 @@ BmpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
             }
         }
     }
-    return true;
 }
 
 
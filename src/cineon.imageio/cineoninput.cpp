@@ -8,9 +8,12 @@
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/typedesc.h>
 
+#include "../dpx.imageio/dpx_pvt.h"
+
 using namespace cineon;
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -25,11 +28,15 @@ public:
     virtual bool close() override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
 
 private:
     InStream* m_stream = nullptr;
     cineon::Reader m_cin;
     std::vector<unsigned char> m_userBuf;
+    bool m_rgb10;  // 10 bit RGB, one pixel per word, we can unpack it directly
+    std::vector<unsigned char> m_rawbuf;  // raw pixels for m_rgb10
 
     /// Reset everything to initial state
     ///
@@ -41,6 +48,8 @@ private:
             m_stream = nullptr;
         }
         m_userBuf.clear();
+        m_rgb10 = false;
+        m_rawbuf.clear();
     }
 
     /// Helper function - retrieve string for libcineon descriptor
@@ -69,6 +78,10 @@ cineon_imageio_library_version()
 
 OIIO_EXPORT const char* cineon_input_extensions[] = { "cin", nullptr };
 
+OIIO_EXPORT const char* cineon_input_signatures[] = {
+    "802a5fd7", "d75f2a80", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -350,6 +363,16 @@ CineonInput::open(const std::string& name, ImageSpec& newspec)
                          TypeDesc(TypeDesc::UCHAR, m_cin.header.UserSize()),
                          &m_userBuf[0]);
 
+    // The usual layout of 10 bit scans, three channels packed left
+    // justified into each 32 bit word, has a dedicated unpacker that
+    // doesn't need to go through libcineon.
+    m_rgb10 = (m_cin.header.NumberOfElements() == 3
+               && (m_cin.header.ImagePacking() & ~cineon::kPackAsManyAsPossible)
+                      == cineon::kLongWordLeft);
+    for (int i = 0; i < m_cin.header.NumberOfElements(); i++)
+        m_rgb10 &= (m_cin.header.BitDepth(i) == 10
+                    && m_cin.header.PixelsPerLine(i) == m_cin.header.Width());
+
     newspec = spec();
     return true;
 }
@@ -366,14 +389,47 @@ CineonInput::close()
 
 
 bool
-CineonInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+CineonInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                   void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+CineonInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                   int yend, int /*z*/, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
 
-    cineon::Block block(0, y, m_cin.header.Width() - 1, y);
+    if (m_rgb10) {
+        size_t width     = m_spec.width;
+        size_t linebytes = width * 4 + m_cin.header.EndOfLinePadding();
+        long offset      = m_cin.header.ImageOffset() + ybegin * linebytes;
+        size_t size      = size_t(yend - ybegin - 1) * linebytes + width * 4;
+        m_rawbuf.resize(size);
+        if (!m_stream->Seek(offset, InStream::kStart)
+            || m_stream->ReadDirect(m_rawbuf.data(), size) != size) {
+            errorfmt("Read error reading scanlines {}-{}", ybegin, yend - 1);
+            return false;
+        }
+        bool swap = m_cin.header.RequiresByteSwap();
+        parallel_for_chunked(
+            0, yend - ybegin, 0,
+            [&](int64_t b, int64_t e) {
+                for (int64_t y = b; y < e; ++y)
+                    DPX_pvt::unpack_10bit_rgb(
+                        (const uint32_t*)(m_rawbuf.data() + y * linebytes),
+                        (uint16_t*)data + y * width * 3, width, 2, swap);
+            },
+            parallel_options(threads(), Split_Y, 1));
+        return true;
+    }
+
+    cineon::Block block(0, ybegin, m_cin.header.Width() - 1, yend - 1);
 
     // FIXME: un-hardcode the channel from 0
     if (!m_cin.ReadBlock(data, m_cin.header.ComponentDataSize(0), block))
@@ -298,6 +298,13 @@ if (NOT USE_SIMD STREQUAL "")
     add_compile_options (${SIMD_COMPILE_FLAGS})
 endif ()
 
+# SIMD_DISPATCH additionally compiles the hottest kernels (see
+# src/libOpenImageIO/simd_kernels.cpp) for AVX2 and AVX-512 on x86-64, and
+# the bulk half conversions (src/libutil/fmath_f16c.cpp) for F16C, and
+# picks the best one the CPU supports at runtime, so that a build for a
+# conservative USE_SIMD baseline still uses the wider instructions.
+option (SIMD_DISPATCH "Compile hot kernels for several x86 ISA levels and choose at runtime" ON)
+
 
 ###########################################################################
 # Preparation to test for compiler/language features
@@ -169,6 +169,10 @@ checked_find_package (TBB 2017
                       DEFINITIONS  -DUSE_TBB=1
                       PREFER_CONFIG)
 
+# libcurl lets readers fetch http(s):// and s3:// URLs directly
+checked_find_package (CURL
+                      DEFINITIONS  -DUSE_CURL=1)
+
 checked_find_package (DCMTK VERSION_MIN 3.6.1)  # For DICOM images
 checked_find_package (FFmpeg VERSION_MIN 3.0)
 checked_find_package (GIF
@@ -219,6 +223,10 @@ endif ()
 
 checked_find_package (WebP)
 
+# libdeflate is optional. When found, the TIFF plugin uses it instead of zlib
+# for the zip (de)compression that it does itself on multiple threads.
+checked_find_package (Libdeflate DEFINITIONS -DUSE_LIBDEFLATE=1)
+
 option (USE_R3DSDK "Enable R3DSDK (RED camera) support" OFF)
 checked_find_package (R3DSDK)  # RED camera
 
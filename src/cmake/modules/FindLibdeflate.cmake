@@ -0,0 +1,46 @@
+# Module to find libdeflate
+#
+# This module will first look into the directories defined by the variables:
+#   - Libdeflate_ROOT, LIBDEFLATE_INCLUDE_PATH, LIBDEFLATE_LIBRARY_PATH
+#
+# This module defines the following variables:
+#
+# Libdeflate_FOUND          True if libdeflate was found.
+# LIBDEFLATE_INCLUDES       Where to find libdeflate headers
+# LIBDEFLATE_LIBRARIES      List of libraries to link against
+# LIBDEFLATE_VERSION        Version of libdeflate (e.g., 1.18)
+
+include (FindPackageHandleStandardArgs)
+
+find_path (LIBDEFLATE_INCLUDE_DIR libdeflate.h
+           HINTS
+               ${LIBDEFLATE_INCLUDE_PATH}
+               ENV LIBDEFLATE_INCLUDE_PATH
+           DOC "The directory where libdeflate headers reside")
+
+find_library (LIBDEFLATE_LIBRARY deflate
+              HINTS
+                  ${LIBDEFLATE_LIBRARY_PATH}
+                  ENV LIBDEFLATE_LIBRARY_PATH)
+
+if (LIBDEFLATE_INCLUDE_DIR AND EXISTS "${LIBDEFLATE_INCLUDE_DIR}/libdeflate.h")
+    file (STRINGS "${LIBDEFLATE_INCLUDE_DIR}/libdeflate.h" TMP
+          REGEX "^#define LIBDEFLATE_VERSION_STRING.*$")
+    string (REGEX MATCHALL "[0-9.]+" LIBDEFLATE_VERSION ${TMP})
+endif ()
+
+find_package_handle_standard_args (Libdeflate
+    REQUIRED_VARS   LIBDEFLATE_INCLUDE_DIR
+                    LIBDEFLATE_LIBRARY
+    VERSION_VAR     LIBDEFLATE_VERSION
+    )
+
+if (Libdeflate_FOUND)
+    set (LIBDEFLATE_INCLUDES "${LIBDEFLATE_INCLUDE_DIR}")
+    set (LIBDEFLATE_LIBRARIES ${LIBDEFLATE_LIBRARY})
+endif ()
+
+mark_as_advanced (
+    LIBDEFLATE_INCLUDE_DIR
+    LIBDEFLATE_LIBRARY
+    )
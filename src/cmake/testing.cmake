@@ -216,7 +216,7 @@ macro (oiio_add_all_tests)
                 python-imagespec python-roi python-deep python-colorconfig
                 python-imageinput python-imageoutput
                 python-imagebuf python-imagebufalgo
-                python-texturesys
+                python-imagecache python-texturesys python-threading
                 IMAGEDIR oiio-images
                 )
     endif ()
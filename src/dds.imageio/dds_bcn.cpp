@@ -0,0 +1,556 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+// Decoders for the BC4, BC5, BC6H and BC7 block compression formats. (BC1-3,
+// aka DXT1-5, are handled by squish.) Each function decodes one 4x4 block;
+// the caller is expected to spread whole rows of blocks across threads.
+//
+// References:
+//  * https://docs.microsoft.com/en-us/windows/win32/direct3d11/bc4-format
+//  * https://docs.microsoft.com/en-us/windows/win32/direct3d11/bc6h-format
+//  * https://docs.microsoft.com/en-us/windows/win32/direct3d11/bc7-format
+//  * https://www.khronos.org/registry/DataFormat/specs/1.3/dataformat.1.3.html
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+
+#include <OpenImageIO/imageio.h>
+
+#include "dds_pvt.h"
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+namespace DDS_pvt {
+
+namespace {
+
+// Reads the bits of a 128 bit block, least significant first.
+class BlockBits {
+public:
+    BlockBits(const uint8_t* block)
+    {
+        for (int i = 7; i >= 0; --i) {
+            m_lo = (m_lo << 8) | block[i];
+            m_hi = (m_hi << 8) | block[i + 8];
+        }
+    }
+    int read(int nbits)
+    {
+        if (!nbits)
+            return 0;
+        uint64_t v;
+        if (m_pos >= 64)
+            v = m_hi >> (m_pos - 64);
+        else if (m_pos + nbits <= 64)
+            v = m_lo >> m_pos;
+        else
+            v = (m_lo >> m_pos) | (m_hi << (64 - m_pos));
+        m_pos += nbits;
+        return int(v & ((uint64_t(1) << nbits) - 1));
+    }
+    int bit() { return read(1); }
+    int pos() const { return m_pos; }
+
+private:
+    uint64_t m_lo = 0, m_hi = 0;
+    int m_pos     = 0;
+};
+
+
+
+// Partition tables shared by BC6H (first 32 only) and BC7. For two
+// subsets, bit i of the mask says which subset pixel i belongs to.
+static const uint16_t partitions2[64] = {
+    0xcccc, 0x8888, 0xeeee, 0xecc8, 0xc880, 0xfeec, 0xfec8, 0xec80,
+    0xc800, 0xffec, 0xfe80, 0xe800, 0xffe8, 0xff00, 0xfff0, 0xf000,
+    0xf710, 0x008e, 0x7100, 0x08ce, 0x008c, 0x7310, 0x3100, 0x8cce,
+    0x088c, 0x3110, 0x6666, 0x366c, 0x17e8, 0x0ff0, 0x718e, 0x399c,
+    0xaaaa, 0xf0f0, 0x5a5a, 0x33cc, 0x3c3c, 0x55aa, 0x9696, 0xa55a,
+    0x73ce, 0x13c8, 0x324c, 0x3bdc, 0x6996, 0xc33c, 0x9966, 0x0660,
+    0x0272, 0x04e4, 0x4e40, 0x2720, 0xc936, 0x936c, 0x39c6, 0x639c,
+    0x9336, 0x9cc6, 0x817e, 0xe718, 0xccf0, 0x0fcc, 0x7744, 0xee22
+};
+
+static const uint8_t partitions3[64][16] = {
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 1, 0, 1, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2 },
+    { 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2, 0, 1, 1, 2 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0, 2, 2, 2, 0 },
+    { 0, 0, 0, 1, 0, 0, 1, 1, 0, 1, 1, 2, 1, 1, 2, 2 },
+    { 0, 1, 1, 1, 0, 0, 1, 1, 2, 0, 0, 1, 2, 2, 0, 0 },
+    { 0, 0, 0, 0, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 2, 2, 0, 0, 2, 2, 1, 1, 1, 1 },
+    { 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2, 0, 2, 2, 2 },
+    { 0, 0, 0, 1, 0, 0, 0, 1, 2, 2, 2, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2 },
+    { 0, 0, 0, 0, 1, 1, 0, 0, 2, 2, 1, 0, 2, 2, 1, 0 },
+    { 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1, 0, 0, 0, 0 },
+    { 0, 0, 1, 2, 0, 0, 1, 2, 1, 1, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1, 0, 1, 1, 0 },
+    { 0, 0, 0, 0, 0, 1, 1, 0, 1, 2, 2, 1, 1, 2, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 0, 2, 1, 1, 0, 2, 0, 0, 2, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 0, 0, 2, 2, 2, 2, 2 },
+    { 0, 0, 1, 1, 0, 1, 2, 2, 0, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 0, 0, 2, 0, 0, 0, 2, 2, 1, 1, 2, 2, 2, 1 },
+    { 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 0, 2, 2, 0, 0, 1, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 0, 0, 1, 2, 0, 0, 2, 2, 0, 2, 2, 2 },
+    { 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0, 0, 1, 2, 0 },
+    { 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0 },
+    { 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0, 1, 2, 0 },
+    { 0, 1, 2, 0, 2, 0, 1, 2, 1, 2, 0, 1, 0, 1, 2, 0 },
+    { 0, 0, 1, 1, 2, 2, 0, 0, 1, 1, 2, 2, 0, 0, 1, 1 },
+    { 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 0, 0, 0, 0, 1, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2, 1, 1, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 2, 2, 0, 0, 1, 1 },
+    { 0, 2, 2, 0, 1, 2, 2, 1, 0, 2, 2, 0, 1, 2, 2, 1 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 0, 1, 0, 1 },
+    { 0, 0, 0, 0, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1, 2, 1 },
+    { 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 0, 1, 2, 2, 2, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 2, 2, 2, 0, 1, 1, 1 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 0, 0, 0, 2, 1, 1, 1, 2 },
+    { 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 2, 2, 2, 0, 1, 1, 1, 0, 1, 1, 1, 0, 2, 2, 2 },
+    { 0, 0, 0, 2, 1, 1, 1, 2, 1, 1, 1, 2, 0, 0, 0, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2, 2, 1, 1, 2 },
+    { 0, 1, 1, 0, 0, 1, 1, 0, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 0, 2, 2, 0, 0, 1, 1, 0, 0, 1, 1, 0, 0, 2, 2 },
+    { 0, 0, 2, 2, 1, 1, 2, 2, 1, 1, 2, 2, 0, 0, 2, 2 },
+    { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 1, 1, 2 },
+    { 0, 0, 0, 2, 0, 0, 0, 1, 0, 0, 0, 2, 0, 0, 0, 1 },
+    { 0, 2, 2, 2, 1, 2, 2, 2, 0, 2, 2, 2, 1, 2, 2, 2 },
+    { 0, 1, 0, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2 },
+    { 0, 1, 1, 1, 2, 0, 1, 1, 2, 2, 0, 1, 2, 2, 2, 0 },
+};
+
+// The "anchor" pixel of each subset after the first, whose index is
+// stored with one bit fewer (its high bit being implicitly zero).
+static const uint8_t anchor2[64] = {
+    15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 15,
+    15, 2,  8,  2,  2,  8,  8,  15, 2,  8,  2,  2,  8,  8,  2,  2,
+    15, 15, 6,  8,  2,  8,  15, 15, 2,  8,  2,  2,  2,  15, 15, 6,
+    6,  2,  6,  8,  15, 15, 2,  2,  15, 15, 15, 15, 15, 2,  2,  15
+};
+
+static const uint8_t anchor3_1[64] = {
+    3,  3,  15, 15, 8,  3,  15, 15, 8,  8,  6,  6,  6,  5,  3,  3,
+    3,  3,  8,  15, 3,  3,  6,  10, 5,  8,  8,  6,  8,  5,  15, 15,
+    8,  15, 3,  5,  6,  10, 8,  15, 15, 3,  15, 5,  15, 15, 15, 15,
+    3,  15, 5,  5,  5,  8,  5,  10, 5,  10, 8,  13, 15, 12, 3,  3
+};
+
+static const uint8_t anchor3_2[64] = {
+    15, 8,  8,  3,  15, 15, 3,  8,  15, 15, 15, 15, 15, 15, 15, 8,
+    15, 8,  15, 3,  15, 8,  15, 8,  3,  15, 6,  10, 15, 15, 10, 8,
+    15, 3,  15, 10, 10, 8,  9,  10, 6,  15, 8,  15, 3,  6,  6,  8,
+    15, 3,  15, 15, 15, 15, 15, 15, 15, 15, 15, 15, 3,  15, 15, 8
+};
+
+static const int weights2[4] = { 0, 21, 43, 64 };
+static const int weights3[8] = { 0, 9, 18, 27, 37, 46, 55, 64 };
+static const int weights4[16] = { 0,  4,  9,  13, 17, 21, 26, 30,
+                                  34, 38, 43, 47, 51, 55, 60, 64 };
+
+static const int*
+index_weights(int bits)
+{
+    return bits == 2 ? weights2 : bits == 3 ? weights3 : weights4;
+}
+
+
+
+// Subset of pixel i for the given partition, and whether i is an anchor
+// (the first pixel, or the designated pixel of a later subset).
+inline int
+subset_of(int nsubsets, int partition, int i)
+{
+    if (nsubsets == 2)
+        return (partitions2[partition] >> i) & 1;
+    if (nsubsets == 3)
+        return partitions3[partition][i];
+    return 0;
+}
+
+inline bool
+is_anchor(int nsubsets, int partition, int i)
+{
+    if (i == 0)
+        return true;
+    if (nsubsets == 2)
+        return i == anchor2[partition];
+    if (nsubsets == 3)
+        return i == anchor3_1[partition] || i == anchor3_2[partition];
+    return false;
+}
+
+}  // namespace
+
+
+
+void
+decode_bc4_block(const uint8_t* block, uint8_t* dst, int stride, bool is_signed)
+{
+    int codes[8];
+    if (is_signed) {
+        // -128 is treated as -127, so that the range is symmetric
+        int e0   = std::max(int(int8_t(block[0])), -127);
+        int e1   = std::max(int(int8_t(block[1])), -127);
+        codes[0] = e0;
+        codes[1] = e1;
+        if (e0 > e1) {
+            for (int i = 1; i < 7; ++i)
+                codes[1 + i] = ((7 - i) * e0 + i * e1) / 7;
+        } else {
+            for (int i = 1; i < 5; ++i)
+                codes[1 + i] = ((5 - i) * e0 + i * e1) / 5;
+            codes[6] = -127;
+            codes[7] = 127;
+        }
+    } else {
+        // Same arithmetic as squish uses for DXT5 alpha
+        int e0   = block[0];
+        int e1   = block[1];
+        codes[0] = e0;
+        codes[1] = e1;
+        if (e0 > e1) {
+            for (int i = 1; i < 7; ++i)
+                codes[1 + i] = ((7 - i) * e0 + i * e1) / 7;
+        } else {
+            for (int i = 1; i < 5; ++i)
+                codes[1 + i] = ((5 - i) * e0 + i * e1) / 5;
+            codes[6] = 0;
+            codes[7] = 255;
+        }
+    }
+    uint64_t indices = 0;
+    for (int i = 7; i >= 2; --i)
+        indices = (indices << 8) | block[i];
+    for (int i = 0; i < 16; ++i, indices >>= 3)
+        dst[i * stride] = uint8_t(codes[indices & 7]);
+}
+
+
+
+void
+decode_bc6h_block(const uint8_t* block, uint16_t* dst, bool is_signed)
+{
+    // Where each field of the 14 modes lives: per mode, a list of runs of
+    // (endpoint component, first bit, number of bits), read in order after
+    // the mode bits. Component 3*p+c is channel c of endpoint p; endpoints
+    // 0 and 1 belong to the first subset, 2 and 3 to the second.
+    enum { R0, G0, B0, R1, G1, B1, R2, G2, B2, R3, G3, B3, END };
+    struct Run {
+        uint8_t comp, first, count;
+    };
+    struct Mode {
+        int code;          // value of the mode bits
+        int modebits;      // 2 or 5
+        int nsubsets;      // 1 or 2
+        bool transformed;  // endpoints after the first are deltas
+        int prec;          // endpoint precision
+        int delta[3];      // delta precision per channel
+        Run runs[26];
+    };
+    // clang-format off
+    static const Mode modes[14] = {
+        { 0x00, 2, 2, true, 10, { 5, 5, 5 },
+          { { G2, 4, 1 }, { B2, 4, 1 }, { B3, 4, 1 }, { R0, 0, 10 },
+            { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 5 }, { G3, 4, 1 },
+            { G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 },
+            { B1, 0, 5 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 },
+            { B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 }, { END, 0, 0 } } },
+        { 0x01, 2, 2, true, 7, { 6, 6, 6 },
+          { { G2, 5, 1 }, { G3, 4, 1 }, { G3, 5, 1 }, { R0, 0, 7 },
+            { B3, 0, 1 }, { B3, 1, 1 }, { B2, 4, 1 }, { G0, 0, 7 },
+            { B2, 5, 1 }, { B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 7 },
+            { B3, 3, 1 }, { B3, 5, 1 }, { B3, 4, 1 }, { R1, 0, 6 },
+            { G2, 0, 4 }, { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 6 },
+            { B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 }, { END, 0, 0 } } },
+        { 0x02, 5, 2, true, 11, { 5, 4, 4 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 5 },
+            { R0, 10, 1 }, { G2, 0, 4 }, { G1, 0, 4 }, { G0, 10, 1 },
+            { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 4 }, { B0, 10, 1 },
+            { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 },
+            { R3, 0, 5 }, { B3, 3, 1 }, { END, 0, 0 } } },
+        { 0x06, 5, 2, true, 11, { 4, 5, 4 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 },
+            { R0, 10, 1 }, { G3, 4, 1 }, { G2, 0, 4 }, { G1, 0, 5 },
+            { G0, 10, 1 }, { G3, 0, 4 }, { B1, 0, 4 }, { B0, 10, 1 },
+            { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 4 }, { B3, 0, 1 },
+            { B3, 2, 1 }, { R3, 0, 4 }, { G2, 4, 1 }, { B3, 3, 1 },
+            { END, 0, 0 } } },
+        { 0x0a, 5, 2, true, 11, { 4, 4, 5 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 },
+            { R0, 10, 1 }, { B2, 4, 1 }, { G2, 0, 4 }, { G1, 0, 4 },
+            { G0, 10, 1 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 },
+            { B0, 10, 1 }, { B2, 0, 4 }, { R2, 0, 4 }, { B3, 1, 1 },
+            { B3, 2, 1 }, { R3, 0, 4 }, { B3, 4, 1 }, { B3, 3, 1 },
+            { END, 0, 0 } } },
+        { 0x0e, 5, 2, true, 9, { 5, 5, 5 },
+          { { R0, 0, 9 }, { B2, 4, 1 }, { G0, 0, 9 }, { G2, 4, 1 },
+            { B0, 0, 9 }, { B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 },
+            { G2, 0, 4 }, { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 },
+            { B1, 0, 5 }, { B3, 1, 1 }, { B2, 0, 4 }, { R2, 0, 5 },
+            { B3, 2, 1 }, { R3, 0, 5 }, { B3, 3, 1 }, { END, 0, 0 } } },
+        { 0x12, 5, 2, true, 8, { 6, 5, 5 },
+          { { R0, 0, 8 }, { G3, 4, 1 }, { B2, 4, 1 }, { G0, 0, 8 },
+            { B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { B3, 3, 1 },
+            { B3, 4, 1 }, { R1, 0, 6 }, { G2, 0, 4 }, { G1, 0, 5 },
+            { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 },
+            { B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 }, { END, 0, 0 } } },
+        { 0x16, 5, 2, true, 8, { 5, 6, 5 },
+          { { R0, 0, 8 }, { B3, 0, 1 }, { B2, 4, 1 }, { G0, 0, 8 },
+            { G2, 5, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { G3, 5, 1 },
+            { B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 }, { G2, 0, 4 },
+            { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 5 }, { B3, 1, 1 },
+            { B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 }, { R3, 0, 5 },
+            { B3, 3, 1 }, { END, 0, 0 } } },
+        { 0x1a, 5, 2, true, 8, { 5, 5, 6 },
+          { { R0, 0, 8 }, { B3, 1, 1 }, { B2, 4, 1 }, { G0, 0, 8 },
+            { B2, 5, 1 }, { G2, 4, 1 }, { B0, 0, 8 }, { B3, 5, 1 },
+            { B3, 4, 1 }, { R1, 0, 5 }, { G3, 4, 1 }, { G2, 0, 4 },
+            { G1, 0, 5 }, { B3, 0, 1 }, { G3, 0, 4 }, { B1, 0, 6 },
+            { B2, 0, 4 }, { R2, 0, 5 }, { B3, 2, 1 }, { R3, 0, 5 },
+            { B3, 3, 1 }, { END, 0, 0 } } },
+        { 0x1e, 5, 2, false, 6, { 6, 6, 6 },
+          { { R0, 0, 6 }, { G3, 4, 1 }, { B3, 0, 1 }, { B3, 1, 1 },
+            { B2, 4, 1 }, { G0, 0, 6 }, { G2, 5, 1 }, { B2, 5, 1 },
+            { B3, 2, 1 }, { G2, 4, 1 }, { B0, 0, 6 }, { G3, 5, 1 },
+            { B3, 3, 1 }, { B3, 5, 1 }, { B3, 4, 1 }, { R1, 0, 6 },
+            { G2, 0, 4 }, { G1, 0, 6 }, { G3, 0, 4 }, { B1, 0, 6 },
+            { B2, 0, 4 }, { R2, 0, 6 }, { R3, 0, 6 }, { END, 0, 0 } } },
+        { 0x03, 5, 1, false, 10, { 10, 10, 10 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 10 },
+            { G1, 0, 10 }, { B1, 0, 10 }, { END, 0, 0 } } },
+        { 0x07, 5, 1, true, 11, { 9, 9, 9 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 9 },
+            { R0, 10, 1 }, { G1, 0, 9 }, { G0, 10, 1 }, { B1, 0, 9 },
+            { B0, 10, 1 }, { END, 0, 0 } } },
+        // In the last two modes, the high bits of the base endpoint are
+        // stored in reverse order; a count of 0x80|n marks such a run.
+        { 0x0b, 5, 1, true, 12, { 8, 8, 8 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 8 },
+            { R0, 10, 0x82 }, { G1, 0, 8 }, { G0, 10, 0x82 }, { B1, 0, 8 },
+            { B0, 10, 0x82 }, { END, 0, 0 } } },
+        { 0x0f, 5, 1, true, 16, { 4, 4, 4 },
+          { { R0, 0, 10 }, { G0, 0, 10 }, { B0, 0, 10 }, { R1, 0, 4 },
+            { R0, 10, 0x86 }, { G1, 0, 4 }, { G0, 10, 0x86 }, { B1, 0, 4 },
+            { B0, 10, 0x86 }, { END, 0, 0 } } },
+    };
+    // clang-format on
+
+    BlockBits bits(block);
+    int code = bits.read(2);
+    if (code > 1)
+        code |= bits.read(3) << 2;
+    const Mode* mode = nullptr;
+    for (auto& m : modes)
+        if (m.code == code && (m.modebits == 2) == (code < 2))
+            mode = &m;
+    if (!mode) {
+        // Reserved mode: the block decodes to black
+        memset(dst, 0, 16 * 3 * sizeof(uint16_t));
+        return;
+    }
+
+    int e[12] = { 0 };  // Endpoint components, in the enum order
+    for (const Run* r = mode->runs; r->comp != END; ++r) {
+        if (r->count & 0x80) {
+            int n = r->count & 0x7f;
+            for (int i = n - 1; i >= 0; --i)
+                e[r->comp] |= bits.bit() << (r->first + i);
+        } else {
+            e[r->comp] |= bits.read(r->count) << r->first;
+        }
+    }
+    int partition = mode->nsubsets == 2 ? bits.read(5) : 0;
+
+    auto sign_extend = [](int v, int nbits) {
+        int shift = 32 - nbits;
+        return int(uint32_t(v) << shift) >> shift;
+    };
+    int nendpoints = 2 * mode->nsubsets;
+    int prec       = mode->prec;
+    for (int c = 0; c < 3; ++c) {
+        if (is_signed)
+            e[c] = sign_extend(e[c], prec);
+        for (int p = 1; p < nendpoints; ++p) {
+            int& v = e[3 * p + c];
+            if (mode->transformed) {
+                v = (e[c] + sign_extend(v, mode->delta[c])) & ((1 << prec) - 1);
+                if (is_signed)
+                    v = sign_extend(v, prec);
+            } else if (is_signed) {
+                v = sign_extend(v, prec);
+            }
+        }
+    }
+
+    // Scale the endpoints up to 16 bits (unsigned) or 15 bits plus sign
+    for (int& v : e) {
+        if (!is_signed) {
+            if (prec >= 15)
+                ;
+            else if (v == 0)
+                ;
+            else if (v == (1 << prec) - 1)
+                v = 0xffff;
+            else
+                v = ((v << 16) + 0x8000) >> prec;
+        } else {
+            bool neg = v < 0;
+            int a    = neg ? -v : v;
+            if (prec >= 16)
+                ;
+            else if (a == 0)
+                ;
+            else if (a >= (1 << (prec - 1)) - 1)
+                a = 0x7fff;
+            else
+                a = ((a << 15) + 0x4000) >> (prec - 1);
+            v = neg ? -a : a;
+        }
+    }
+
+    int ibits          = mode->nsubsets == 2 ? 3 : 4;
+    const int* weights = index_weights(ibits);
+    for (int i = 0; i < 16; ++i) {
+        int s   = subset_of(mode->nsubsets, partition, i);
+        int idx = bits.read(ibits - (is_anchor(mode->nsubsets, partition, i)
+                                         ? 1
+                                         : 0));
+        int w   = weights[idx];
+        for (int c = 0; c < 3; ++c) {
+            int a = e[3 * (2 * s) + c], b = e[3 * (2 * s + 1) + c];
+            int v = ((64 - w) * a + w * b + 32) >> 6;
+            // Rescale to the half float bit pattern
+            uint16_t h;
+            if (!is_signed) {
+                h = uint16_t((v * 31) >> 6);
+            } else {
+                v = v < 0 ? -(((-v) * 31) >> 5) : (v * 31) >> 5;
+                h = v < 0 ? uint16_t(0x8000 | -v) : uint16_t(v);
+            }
+            dst[3 * i + c] = h;
+        }
+    }
+}
+
+
+
+void
+decode_bc7_block(const uint8_t* block, uint8_t* dst)
+{
+    struct Mode {
+        int nsubsets, partbits, rotbits, isbbits;
+        int colorbits, alphabits, endpbits, sharedpbits;
+        int ibits, ibits2;
+    };
+    static const Mode modes[8] = {
+        { 3, 4, 0, 0, 4, 0, 1, 0, 3, 0 }, { 2, 6, 0, 0, 6, 0, 0, 1, 3, 0 },
+        { 3, 6, 0, 0, 5, 0, 0, 0, 2, 0 }, { 2, 6, 0, 0, 7, 0, 1, 0, 2, 0 },
+        { 1, 0, 2, 1, 5, 6, 0, 0, 2, 3 }, { 1, 0, 2, 0, 7, 8, 0, 0, 2, 2 },
+        { 1, 0, 0, 0, 7, 7, 1, 0, 4, 0 }, { 2, 6, 0, 0, 5, 5, 1, 0, 2, 0 },
+    };
+
+    BlockBits bits(block);
+    int m = 0;
+    while (m < 8 && !bits.bit())
+        ++m;
+    if (m == 8) {
+        // Reserved mode: the block decodes to transparent black
+        memset(dst, 0, 16 * 4);
+        return;
+    }
+    const Mode& mode = modes[m];
+    int partition    = bits.read(mode.partbits);
+    int rotation     = bits.read(mode.rotbits);
+    int isb          = bits.read(mode.isbbits);
+
+    // Endpoints: all the reds, then greens, blues, and alphas
+    int nendpoints = 2 * mode.nsubsets;
+    int e[6][4];
+    for (int c = 0; c < 3; ++c)
+        for (int p = 0; p < nendpoints; ++p)
+            e[p][c] = bits.read(mode.colorbits);
+    for (int p = 0; p < nendpoints; ++p)
+        e[p][3] = mode.alphabits ? bits.read(mode.alphabits) : 255;
+
+    // P-bits, per endpoint or shared by the two endpoints of a subset,
+    // become an extra low bit; then expand everything to 8 bits.
+    int pbits[6] = { 0 };
+    int hasp     = mode.endpbits || mode.sharedpbits;
+    if (mode.endpbits)
+        for (int p = 0; p < nendpoints; ++p)
+            pbits[p] = bits.bit();
+    if (mode.sharedpbits)
+        for (int s = 0; s < mode.nsubsets; ++s)
+            pbits[2 * s] = pbits[2 * s + 1] = bits.bit();
+    for (int p = 0; p < nendpoints; ++p) {
+        for (int c = 0; c < 4; ++c) {
+            int nbits = c < 3 ? mode.colorbits : mode.alphabits;
+            if (!nbits)
+                continue;
+            int v = e[p][c];
+            if (hasp) {
+                v = (v << 1) | pbits[p];
+                ++nbits;
+            }
+            v <<= 8 - nbits;
+            e[p][c] = v | (v >> nbits);
+        }
+    }
+
+    // Indices: the primary set, then (modes 4 and 5) the secondary set
+    int idx[16], idx2[16];
+    for (int i = 0; i < 16; ++i)
+        idx[i] = bits.read(mode.ibits
+                           - (is_anchor(mode.nsubsets, partition, i) ? 1 : 0));
+    if (mode.ibits2)
+        for (int i = 0; i < 16; ++i)
+            idx2[i] = bits.read(mode.ibits2 - (i == 0 ? 1 : 0));
+
+    for (int i = 0; i < 16; ++i) {
+        int s             = subset_of(mode.nsubsets, partition, i);
+        const int* e0     = e[2 * s];
+        const int* e1     = e[2 * s + 1];
+        int cidx          = idx[i];
+        int aidx          = mode.ibits2 ? idx2[i] : idx[i];
+        int cbits         = mode.ibits;
+        int abits         = mode.ibits2 ? mode.ibits2 : mode.ibits;
+        if (isb) {
+            std::swap(cidx, aidx);
+            std::swap(cbits, abits);
+        }
+        const int* cw = index_weights(cbits);
+        const int* aw = index_weights(abits);
+        uint8_t* p    = dst + 4 * i;
+        for (int c = 0; c < 3; ++c)
+            p[c] = uint8_t(((64 - cw[cidx]) * e0[c] + cw[cidx] * e1[c] + 32)
+                           >> 6);
+        p[3] = uint8_t(((64 - aw[aidx]) * e0[3] + aw[aidx] * e1[3] + 32) >> 6);
+        if (rotation)
+            std::swap(p[3], p[rotation - 1]);
+    }
+}
+
+}  // namespace DDS_pvt
+
+OIIO_PLUGIN_NAMESPACE_END
@@ -18,6 +18,13 @@ namespace DDS_pvt {
 #define DDS_4CC_DXT3 DDS_MAKE4CC('D', 'X', 'T', '3')
 #define DDS_4CC_DXT4 DDS_MAKE4CC('D', 'X', 'T', '4')
 #define DDS_4CC_DXT5 DDS_MAKE4CC('D', 'X', 'T', '5')
+#define DDS_4CC_ATI1 DDS_MAKE4CC('A', 'T', 'I', '1')
+#define DDS_4CC_ATI2 DDS_MAKE4CC('A', 'T', 'I', '2')
+#define DDS_4CC_BC4U DDS_MAKE4CC('B', 'C', '4', 'U')
+#define DDS_4CC_BC4S DDS_MAKE4CC('B', 'C', '4', 'S')
+#define DDS_4CC_BC5U DDS_MAKE4CC('B', 'C', '5', 'U')
+#define DDS_4CC_BC5S DDS_MAKE4CC('B', 'C', '5', 'S')
+#define DDS_4CC_DX10 DDS_MAKE4CC('D', 'X', '1', '0')
 
 /// DDS pixel format flags. Channel flags are only applicable for uncompressed
 /// images.
@@ -100,6 +107,74 @@ typedef struct {
     dds_caps caps;      ///< DirectDraw Surface caps
 } dds_header;
 
+/// DX10 header extension, present when fmt.fourCC is DX10.
+///
+typedef struct {
+    uint32_t dxgiFormat;         ///< DXGI_FORMAT of the data
+    uint32_t resourceDimension;  ///< 1D, 2D or 3D texture
+    uint32_t miscFlag;           ///< 0x4 if the image is a cube map
+    uint32_t arraySize;          ///< number of array elements
+    uint32_t miscFlags2;         ///< alpha mode
+} dds_header_dx10;
+
+/// The subset of DXGI_FORMAT values that we know how to read.
+///
+enum {
+    DXGI_FORMAT_BC1_TYPELESS   = 70,
+    DXGI_FORMAT_BC1_UNORM      = 71,
+    DXGI_FORMAT_BC1_UNORM_SRGB = 72,
+    DXGI_FORMAT_BC2_TYPELESS   = 73,
+    DXGI_FORMAT_BC2_UNORM      = 74,
+    DXGI_FORMAT_BC2_UNORM_SRGB = 75,
+    DXGI_FORMAT_BC3_TYPELESS   = 76,
+    DXGI_FORMAT_BC3_UNORM      = 77,
+    DXGI_FORMAT_BC3_UNORM_SRGB = 78,
+    DXGI_FORMAT_BC4_TYPELESS   = 79,
+    DXGI_FORMAT_BC4_UNORM      = 80,
+    DXGI_FORMAT_BC4_SNORM      = 81,
+    DXGI_FORMAT_BC5_TYPELESS   = 82,
+    DXGI_FORMAT_BC5_UNORM      = 83,
+    DXGI_FORMAT_BC5_SNORM      = 84,
+    DXGI_FORMAT_BC6H_TYPELESS  = 94,
+    DXGI_FORMAT_BC6H_UF16      = 95,
+    DXGI_FORMAT_BC6H_SF16      = 96,
+    DXGI_FORMAT_BC7_TYPELESS   = 97,
+    DXGI_FORMAT_BC7_UNORM      = 98,
+    DXGI_FORMAT_BC7_UNORM_SRGB = 99
+};
+
+/// Block compression schemes, in the order of their BCn names.
+///
+enum class Compression {
+    None,
+    DXT1,  // aka BC1
+    DXT2,
+    DXT3,  // aka BC2
+    DXT4,
+    DXT5,  // aka BC3
+    BC4,
+    BC4S,
+    BC5,
+    BC5S,
+    BC6HU,
+    BC6HS,
+    BC7
+};
+
+/// Decode one 8 byte BC4 block into 16 values, written `stride` bytes
+/// apart. Signed blocks produce int8 values.
+void
+decode_bc4_block(const uint8_t* block, uint8_t* dst, int stride,
+                 bool is_signed);
+
+/// Decode one 16 byte BC6H block into 16 RGB triples of half bits.
+void
+decode_bc6h_block(const uint8_t* block, uint16_t* dst, bool is_signed);
+
+/// Decode one 16 byte BC7 block into 16 RGBA pixels.
+void
+decode_bc7_block(const uint8_t* block, uint8_t* dst);
+
 
 }  // namespace DDS_pvt
 
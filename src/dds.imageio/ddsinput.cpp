@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -10,6 +11,7 @@
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/typedesc.h>
 
 #include "dds_pvt.h"
@@ -48,22 +50,32 @@ public:
     virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
     virtual bool read_native_tile(int subimage, int miplevel, int x, int y,
                                   int z, void* data) override;
 
 private:
-    std::string m_filename;            ///< Stash the filename
-    std::vector<unsigned char> m_buf;  ///< Buffer the image pixels
+    std::string m_filename;             ///< Stash the filename
+    std::vector<unsigned char> m_buf;   ///< Buffer the image pixels
+    std::vector<unsigned char> m_cbuf;  ///< Compressed blocks of the level
+    std::vector<char> m_rowdone;        ///< Which block rows are decoded
     int m_subimage;
     int m_miplevel;
-    int m_nchans;            ///< Number of colour channels in image
-    int m_nfaces;            ///< Number of cube map sides in image
-    int m_Bpp;               ///< Number of bytes per pixel
-    int m_redL, m_redR;      ///< Bit shifts to extract red channel
-    int m_greenL, m_greenR;  ///< Bit shifts to extract green channel
-    int m_blueL, m_blueR;    ///< Bit shifts to extract blue channel
-    int m_alphaL, m_alphaR;  ///< Bit shifts to extract alpha channel
-    dds_header m_dds;        ///< DDS header
+    int m_nchans;               ///< Number of colour channels in image
+    int m_nfaces;               ///< Number of cube map sides in image
+    int m_Bpp;                  ///< Number of bytes per pixel
+    int m_redL, m_redR;         ///< Bit shifts to extract red channel
+    int m_greenL, m_greenR;     ///< Bit shifts to extract green channel
+    int m_blueL, m_blueR;       ///< Bit shifts to extract blue channel
+    int m_alphaL, m_alphaR;     ///< Bit shifts to extract alpha channel
+    int m_tileface;             ///< Cube face currently held in m_buf
+    Compression m_compression;  ///< Block compression scheme, if any
+    int m_blocksize;            ///< Bytes per 4x4 block
+    unsigned int m_dataofs;     ///< File offset of the first pixel data
+    TypeDesc m_format;          ///< Data type of the decoded pixels
+    dds_header m_dds;           ///< DDS header
+    dds_header_dx10 m_dx10;     ///< DX10 header extension
 
     /// Reset everything to initial state
     ///
@@ -71,7 +83,10 @@ private:
     {
         m_subimage = -1;
         m_miplevel = -1;
+        m_tileface = -1;
         m_buf.clear();
+        m_cbuf.clear();
+        m_rowdone.clear();
         ioproxy_clear();
     }
 
@@ -94,6 +109,23 @@ private:
 
     /// Helper function: performs the actual pixel decoding.
     bool internal_readimg(unsigned char* dst, int w, int h, int d);
+
+    /// Helper function: size in bytes of one compressed w x h slice.
+    ///
+    size_t compressed_size(unsigned int w, unsigned int h) const
+    {
+        return size_t((w + 3) / 4) * ((h + 3) / 4) * m_blocksize;
+    }
+
+    /// Helper function: decode one compressed block into 16 pixels of the
+    /// native format, packed contiguously.
+    void decode_block(const unsigned char* block, unsigned char* pixels) const;
+
+    /// Helper function: decode block rows [rbegin,rend) of the compressed
+    /// w x h slices in src into dst, spreading them across threads. Block
+    /// rows of successive depth slices are numbered consecutively.
+    void decode_block_rows(const unsigned char* src, unsigned char* dst,
+                           int w, int h, int rbegin, int rend) const;
 };
 
 
@@ -117,6 +149,8 @@ dds_imageio_library_version()
 
 OIIO_EXPORT const char* dds_input_extensions[] = { "dds", nullptr };
 
+OIIO_EXPORT const char* dds_input_signatures[] = { "44445320", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -174,6 +208,22 @@ DDSInput::open(const std::string& name, ImageSpec& newspec)
 
     // advance the file pointer by 8 bytes (reserved fields)
     ioseek(8, SEEK_CUR);
+
+    // DX10 header extension
+    m_dataofs = 128;
+    if (m_dds.fmt.flags & DDS_PF_FOURCC && m_dds.fmt.fourCC == DDS_4CC_DX10) {
+        if (!ioread(&m_dx10.dxgiFormat, sizeof(uint32_t), 1)
+            || !ioread(&m_dx10.resourceDimension, sizeof(uint32_t), 1)
+            || !ioread(&m_dx10.miscFlag, sizeof(uint32_t), 1)
+            || !ioread(&m_dx10.arraySize, sizeof(uint32_t), 1)
+            || !ioread(&m_dx10.miscFlags2, sizeof(uint32_t), 1))
+            return false;
+        if (bigendian()) {
+            swap_endian(&m_dx10.dxgiFormat);
+            swap_endian(&m_dx10.arraySize);
+        }
+        m_dataofs += 20;
+    }
 #undef RH
     if (bigendian()) {
         // DDS files are little-endian
@@ -242,22 +292,102 @@ DDSInput::open(const std::string& name, ImageSpec& newspec)
     }
 
     // validate the pixel format
-    // TODO: support DXGI and the "wackier" uncompressed formats
-    if (m_dds.fmt.flags & DDS_PF_FOURCC && m_dds.fmt.fourCC != DDS_4CC_DXT1
-        && m_dds.fmt.fourCC != DDS_4CC_DXT2 && m_dds.fmt.fourCC != DDS_4CC_DXT3
-        && m_dds.fmt.fourCC != DDS_4CC_DXT4
-        && m_dds.fmt.fourCC != DDS_4CC_DXT5) {
-        errorf("Unsupported compression type");
-        return false;
+    // TODO: support the "wackier" uncompressed formats
+    m_compression = Compression::None;
+    if (m_dds.fmt.flags & DDS_PF_FOURCC) {
+        switch (m_dds.fmt.fourCC) {
+        case DDS_4CC_DXT1: m_compression = Compression::DXT1; break;
+        case DDS_4CC_DXT2: m_compression = Compression::DXT2; break;
+        case DDS_4CC_DXT3: m_compression = Compression::DXT3; break;
+        case DDS_4CC_DXT4: m_compression = Compression::DXT4; break;
+        case DDS_4CC_DXT5: m_compression = Compression::DXT5; break;
+        case DDS_4CC_ATI1:
+        case DDS_4CC_BC4U: m_compression = Compression::BC4; break;
+        case DDS_4CC_BC4S: m_compression = Compression::BC4S; break;
+        case DDS_4CC_ATI2:
+        case DDS_4CC_BC5U: m_compression = Compression::BC5; break;
+        case DDS_4CC_BC5S: m_compression = Compression::BC5S; break;
+        case DDS_4CC_DX10:
+            switch (m_dx10.dxgiFormat) {
+            case DXGI_FORMAT_BC1_TYPELESS:
+            case DXGI_FORMAT_BC1_UNORM:
+            case DXGI_FORMAT_BC1_UNORM_SRGB:
+                m_compression = Compression::DXT1;
+                break;
+            case DXGI_FORMAT_BC2_TYPELESS:
+            case DXGI_FORMAT_BC2_UNORM:
+            case DXGI_FORMAT_BC2_UNORM_SRGB:
+                m_compression = Compression::DXT3;
+                break;
+            case DXGI_FORMAT_BC3_TYPELESS:
+            case DXGI_FORMAT_BC3_UNORM:
+            case DXGI_FORMAT_BC3_UNORM_SRGB:
+                m_compression = Compression::DXT5;
+                break;
+            case DXGI_FORMAT_BC4_TYPELESS:
+            case DXGI_FORMAT_BC4_UNORM:
+                m_compression = Compression::BC4;
+                break;
+            case DXGI_FORMAT_BC4_SNORM:
+                m_compression = Compression::BC4S;
+                break;
+            case DXGI_FORMAT_BC5_TYPELESS:
+            case DXGI_FORMAT_BC5_UNORM:
+                m_compression = Compression::BC5;
+                break;
+            case DXGI_FORMAT_BC5_SNORM:
+                m_compression = Compression::BC5S;
+                break;
+            case DXGI_FORMAT_BC6H_TYPELESS:
+            case DXGI_FORMAT_BC6H_UF16:
+                m_compression = Compression::BC6HU;
+                break;
+            case DXGI_FORMAT_BC6H_SF16:
+                m_compression = Compression::BC6HS;
+                break;
+            case DXGI_FORMAT_BC7_TYPELESS:
+            case DXGI_FORMAT_BC7_UNORM:
+            case DXGI_FORMAT_BC7_UNORM_SRGB:
+                m_compression = Compression::BC7;
+                break;
+            }
+            break;
+        }
+        if (m_compression == Compression::None) {
+            errorf("Unsupported compression type");
+            return false;
+        }
     }
 
     // determine the number of channels we have
-    if (m_dds.fmt.flags & DDS_PF_FOURCC) {
-        // squish decompresses everything to RGBA anyway
-        /*if (m_dds.fmt.fourCC == DDS_4CC_DXT1)
-            m_nchans = 3; // no alpha in DXT1
-        else*/
-        m_nchans = 4;
+    m_format = TypeDesc::UINT8;
+    if (m_compression != Compression::None) {
+        switch (m_compression) {
+        case Compression::BC4: m_nchans = 1; break;
+        case Compression::BC4S:
+            m_format = TypeDesc::INT8;
+            m_nchans = 1;
+            break;
+        case Compression::BC5: m_nchans = 2; break;
+        case Compression::BC5S:
+            m_format = TypeDesc::INT8;
+            m_nchans = 2;
+            break;
+        case Compression::BC6HU:
+        case Compression::BC6HS:
+            m_format = TypeDesc::HALF;
+            m_nchans = 3;
+            break;
+        default:
+            // squish decompresses DXT to RGBA anyway
+            m_nchans = 4;
+            break;
+        }
+        m_blocksize = (m_compression == Compression::DXT1
+                       || m_compression == Compression::BC4
+                       || m_compression == Compression::BC4S)
+                          ? 8
+                          : 16;
     } else {
         m_nchans = ((m_dds.fmt.flags & DDS_PF_LUMINANCE) ? 1 : 3)
                    + ((m_dds.fmt.flags & DDS_PF_ALPHA) ? 1 : 0);
@@ -335,7 +465,7 @@ DDSInput::internal_seek_subimage(int cubeface, int miplevel, unsigned int& w,
     // we can easily calculate the offsets because both compressed and
     // uncompressed images have predictable length
     // calculate the offset; start with after the header
-    unsigned int ofs = 128;
+    unsigned int ofs = m_dataofs;
     unsigned int len;
     // this loop is used to iterate over cube map sides, or run once in the
     // case of ordinary 2D or 3D images
@@ -348,14 +478,8 @@ DDSInput::internal_seek_subimage(int cubeface, int miplevel, unsigned int& w,
         // don't skip at all, so just add the offset and continue
         if (m_dds.mipmaps < 2) {
             if (j > 0) {
-                if (m_dds.fmt.flags & DDS_PF_FOURCC)
-                    // only check for DXT1 - all other formats have same block
-                    // size
-                    len = squish::GetStorageRequirements(w, h,
-                                                         m_dds.fmt.fourCC
-                                                                 == DDS_4CC_DXT1
-                                                             ? squish::kDxt1
-                                                             : squish::kDxt5);
+                if (m_compression != Compression::None)
+                    len = compressed_size(w, h) * d;
                 else
                     len = w * h * d * m_Bpp;
                 ofs += len;
@@ -363,13 +487,8 @@ DDSInput::internal_seek_subimage(int cubeface, int miplevel, unsigned int& w,
             continue;
         }
         for (int i = 0; i < miplevel; i++) {
-            if (m_dds.fmt.flags & DDS_PF_FOURCC)
-                // only check for DXT1 - all other formats have same block size
-                len = squish::GetStorageRequirements(w, h,
-                                                     m_dds.fmt.fourCC
-                                                             == DDS_4CC_DXT1
-                                                         ? squish::kDxt1
-                                                         : squish::kDxt5);
+            if (m_compression != Compression::None)
+                len = compressed_size(w, h) * d;
             else
                 len = w * h * d * m_Bpp;
             ofs += len;
@@ -410,6 +529,9 @@ DDSInput::seek_subimage(int subimage, int miplevel)
 
     // clear buffer so that readimage is called
     m_buf.clear();
+    m_cbuf.clear();
+    m_rowdone.clear();
+    m_tileface = -1;
 
     // for cube maps, the seek will be performed when reading a tile instead
     unsigned int w = 0, h = 0, d = 0;
@@ -418,7 +540,7 @@ DDSInput::seek_subimage(int subimage, int miplevel)
         w = m_dds.width;
         h = m_dds.height;
         d = m_dds.depth;
-        for (int i = 1; i < miplevel; i++) {
+        for (int i = 0; i < miplevel; i++) {
             w >>= 1;
             if (w < 1)
                 w = 1;
@@ -431,9 +553,9 @@ DDSInput::seek_subimage(int subimage, int miplevel)
         }
         // create imagespec for the 3x2 cube map layout
 #ifdef DDS_3X2_CUBE_MAP_LAYOUT
-        m_spec = ImageSpec(w * 3, h * 2, m_nchans, TypeDesc::UINT8);
+        m_spec = ImageSpec(w * 3, h * 2, m_nchans, m_format);
 #else   // 1x6 layout
-        m_spec = ImageSpec(w, h * 6, m_nchans, TypeDesc::UINT8);
+        m_spec = ImageSpec(w, h * 6, m_nchans, m_format);
 #endif  // DDS_3X2_CUBE_MAP_LAYOUT
         m_spec.depth      = d;
         m_spec.tile_width = m_spec.full_width = w;
@@ -442,12 +564,17 @@ DDSInput::seek_subimage(int subimage, int miplevel)
     } else {
         internal_seek_subimage(0, miplevel, w, h, d);
         // create imagespec
-        m_spec       = ImageSpec(w, h, m_nchans, TypeDesc::UINT8);
+        m_spec       = ImageSpec(w, h, m_nchans, m_format);
         m_spec.depth = d;
     }
 
     // fill the imagespec
-    if (m_dds.fmt.flags & DDS_PF_FOURCC) {
+    if (m_dds.fmt.fourCC == DDS_4CC_DX10) {
+        static const char* names[] = { "", "BC1", "BC2", "BC2", "BC3", "BC3",
+                                       "BC4", "BC4", "BC5", "BC5", "BC6H",
+                                       "BC6H", "BC7" };
+        m_spec.attribute("compression", names[int(m_compression)]);
+    } else if (m_dds.fmt.flags & DDS_PF_FOURCC) {
         std::string tempstr = "";
         tempstr += ((char*)&m_dds.fmt.fourCC)[0];
         tempstr += ((char*)&m_dds.fmt.fourCC)[1];
@@ -505,46 +632,109 @@ DDSInput::seek_subimage(int subimage, int miplevel)
 
 
 
-bool
-DDSInput::internal_readimg(unsigned char* dst, int w, int h, int d)
+void
+DDSInput::decode_block(const unsigned char* block, unsigned char* pixels) const
 {
-    if (m_dds.fmt.flags & DDS_PF_FOURCC) {
-        // compressed image
+    switch (m_compression) {
+    case Compression::BC4:
+    case Compression::BC4S:
+        decode_bc4_block(block, pixels, 1,
+                         m_compression == Compression::BC4S);
+        break;
+    case Compression::BC5:
+    case Compression::BC5S:
+        decode_bc4_block(block, pixels, 2,
+                         m_compression == Compression::BC5S);
+        decode_bc4_block(block + 8, pixels + 1, 2,
+                         m_compression == Compression::BC5S);
+        break;
+    case Compression::BC6HU:
+    case Compression::BC6HS:
+        decode_bc6h_block(block, (uint16_t*)pixels,
+                          m_compression == Compression::BC6HS);
+        break;
+    case Compression::BC7: decode_bc7_block(block, pixels); break;
+    default: {
+        // DXT1-5 go through squish, one block at a time
         int flags = 0;
-        switch (m_dds.fmt.fourCC) {
-        case DDS_4CC_DXT1: flags = squish::kDxt1; break;
+        switch (m_compression) {
+        case Compression::DXT1: flags = squish::kDxt1; break;
         // DXT2 and 3 are the same, only 2 has pre-multiplied alpha
-        case DDS_4CC_DXT2:
-        case DDS_4CC_DXT3: flags = squish::kDxt3; break;
+        case Compression::DXT2:
+        case Compression::DXT3: flags = squish::kDxt3; break;
         // DXT4 and 5 are the same, only 4 has pre-multiplied alpha
-        case DDS_4CC_DXT4:
-        case DDS_4CC_DXT5: flags = squish::kDxt5; break;
+        default: flags = squish::kDxt5; break;
         }
-        // create source buffer
-        std::vector<squish::u8> tmp(
-            squish::GetStorageRequirements(w, h, flags));
-        // load image into buffer
-        if (!ioread(&tmp[0], tmp.size(), 1))
-            return false;
-        // decompress image
-        squish::DecompressImage(dst, w, h, &tmp[0], flags);
-        tmp.clear();
+        squish::Decompress(pixels, block, flags);
         // correct pre-multiplied alpha, if necessary
-        if (m_dds.fmt.fourCC == DDS_4CC_DXT2
-            || m_dds.fmt.fourCC == DDS_4CC_DXT4) {
-            int k;
-            for (int y = 0; y < h; y++) {
-                for (int x = 0; x < w; x++) {
-                    k          = (y * w + x) * 4;
-                    dst[k + 0] = (unsigned char)((int)dst[k + 0] * 255
-                                                 / (int)dst[k + 3]);
-                    dst[k + 1] = (unsigned char)((int)dst[k + 1] * 255
-                                                 / (int)dst[k + 3]);
-                    dst[k + 2] = (unsigned char)((int)dst[k + 2] * 255
-                                                 / (int)dst[k + 3]);
-                }
+        if (m_compression == Compression::DXT2
+            || m_compression == Compression::DXT4) {
+            for (int k = 0; k < 16 * 4; k += 4) {
+                int a = pixels[k + 3];
+                if (!a)
+                    continue;
+                pixels[k + 0] = (unsigned char)std::min(255, pixels[k + 0]
+                                                                 * 255 / a);
+                pixels[k + 1] = (unsigned char)std::min(255, pixels[k + 1]
+                                                                 * 255 / a);
+                pixels[k + 2] = (unsigned char)std::min(255, pixels[k + 2]
+                                                                 * 255 / a);
             }
         }
+        break;
+    }
+    }
+}
+
+
+
+void
+DDSInput::decode_block_rows(const unsigned char* src, unsigned char* dst,
+                            int w, int h, int rbegin, int rend) const
+{
+    // Every block row is independent of the others, so hand them out to
+    // the thread pool. Each block is decoded whole into a small buffer and
+    // the part of it that lies within the image is copied out.
+    int bw          = (w + 3) / 4;
+    int bh          = (h + 3) / 4;
+    size_t pixbytes = m_spec.pixel_bytes();
+    parallel_for_chunked(
+        rbegin, rend, 0,
+        [&](int64_t b, int64_t e) {
+            // room for 16 pixels of up to four 8 bit or three 16 bit values
+            uint16_t pixels[16 * 4];
+            for (int64_t r = b; r < e; ++r) {
+                int z = int(r / bh), by = int(r % bh);
+                const unsigned char* block
+                    = src + (size_t(z) * bh + by) * bw * m_blocksize;
+                unsigned char* slice = dst + size_t(z) * w * h * pixbytes;
+                int ny               = std::min(4, h - by * 4);
+                for (int bx = 0; bx < bw; ++bx, block += m_blocksize) {
+                    decode_block(block, (unsigned char*)pixels);
+                    int nx = std::min(4, w - bx * 4);
+                    for (int y = 0; y < ny; ++y)
+                        memcpy(slice
+                                   + (size_t(by * 4 + y) * w + bx * 4)
+                                         * pixbytes,
+                               (unsigned char*)pixels + y * 4 * pixbytes,
+                               nx * pixbytes);
+                }
+            }
+        },
+        parallel_options(threads(), Split_Y, 1));
+}
+
+
+
+bool
+DDSInput::internal_readimg(unsigned char* dst, int w, int h, int d)
+{
+    if (m_compression != Compression::None) {
+        // compressed image
+        std::vector<unsigned char> tmp(compressed_size(w, h) * d);
+        if (!ioread(tmp.data(), tmp.size(), 1))
+            return false;
+        decode_block_rows(tmp.data(), dst, w, h, 0, ((h + 3) / 4) * d);
     } else {
         // uncompressed image
 
@@ -586,6 +776,18 @@ DDSInput::readimg_scanlines()
     m_buf.resize(m_spec.scanline_bytes() * m_spec.height * m_spec.depth
                  /*/ (1 << m_miplevel)*/);
 
+    if (m_compression != Compression::None) {
+        // Only load the compressed blocks; read_native_scanlines decodes
+        // the block rows as they are asked for.
+        m_cbuf.resize(compressed_size(m_spec.width, m_spec.height)
+                      * m_spec.depth);
+        m_rowdone.assign(((m_spec.height + 3) / 4) * m_spec.depth, 0);
+        if (!ioread(m_cbuf.data(), m_cbuf.size(), 1)) {
+            m_buf.clear();
+            return false;
+        }
+        return true;
+    }
     return internal_readimg(&m_buf[0], m_spec.width, m_spec.height,
                             m_spec.depth);
 }
@@ -616,6 +818,15 @@ DDSInput::close()
 bool
 DDSInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+DDSInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int z, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
@@ -624,11 +835,30 @@ DDSInput::read_native_scanline(int subimage, int miplevel, int y, int z,
     // don't proceed if a cube map - use tiles then instead
     if (m_dds.caps.flags2 & DDS_CAPS2_CUBEMAP)
         return false;
-    if (m_buf.empty())
-        readimg_scanlines();
+    if (m_buf.empty() && !readimg_scanlines())
+        return false;
+
+    if (m_compression != Compression::None) {
+        // decode just the block rows covering these scanlines, skipping
+        // any already done by an earlier call
+        int bh     = (m_spec.height + 3) / 4;
+        int rbegin = z * bh + ybegin / 4;
+        int rend   = z * bh + (yend + 3) / 4;
+        while (rbegin < rend && m_rowdone[rbegin])
+            ++rbegin;
+        while (rend > rbegin && m_rowdone[rend - 1])
+            --rend;
+        if (rbegin < rend) {
+            decode_block_rows(m_cbuf.data(), m_buf.data(), m_spec.width,
+                              m_spec.height, rbegin, rend);
+            std::fill(m_rowdone.begin() + rbegin, m_rowdone.begin() + rend,
+                      1);
+        }
+    }
 
     size_t size = spec().scanline_bytes();
-    memcpy(data, &m_buf[0] + z * m_spec.height * size + y * size, size);
+    memcpy(data, &m_buf[0] + (z * m_spec.height + ybegin) * size,
+           size * (yend - ybegin));
     return true;
 }
 
@@ -642,9 +872,6 @@ DDSInput::read_native_tile(int subimage, int miplevel, int x, int y, int z,
     if (!seek_subimage(subimage, miplevel))
         return false;
 
-    // static ints to keep track of the current cube face and re-seek and
-    // re-read face
-    static int lastx = -1, lasty = -1, lastz = -1;
     // don't proceed if not a cube map - use scanlines then instead
     if (!(m_dds.caps.flags2 & DDS_CAPS2_CUBEMAP))
         return false;
@@ -652,23 +879,24 @@ DDSInput::read_native_tile(int subimage, int miplevel, int x, int y, int z,
     if (x % m_spec.tile_width || y % m_spec.tile_height
         || z % m_spec.tile_width)
         return false;
-    if (m_buf.empty() || x != lastx || y != lasty || z != lastz) {
-        lastx          = x;
-        lasty          = y;
-        lastz          = z;
-        unsigned int w = 0, h = 0, d = 0;
 #ifdef DDS_3X2_CUBE_MAP_LAYOUT
-        internal_seek_subimage(((x / m_spec.tile_width) << 1)
-                                   + y / m_spec.tile_height,
-                               m_miplevel, w, h, d);
+    int face = ((x / m_spec.tile_width) << 1) + y / m_spec.tile_height;
 #else   // 1x6 layout
-        internal_seek_subimage(y / m_spec.tile_height, m_miplevel, w, h, d);
+    int face = y / m_spec.tile_height;
 #endif  // DDS_3X2_CUBE_MAP_LAYOUT
-        if (!w && !h && !d)
+    // keep the most recently read face around, and only seek to and decode
+    // the blocks of another face when it is asked for
+    if (m_buf.empty() || face != m_tileface) {
+        unsigned int w = 0, h = 0, d = 0;
+        internal_seek_subimage(face, m_miplevel, w, h, d);
+        m_tileface = face;
+        if (!w && !h && !d) {
             // face not present in file, black-pad the image
-            memset(&m_buf[0], 0, m_spec.tile_bytes());
-        else
-            readimg_tiles();
+            m_buf.assign(m_spec.tile_bytes(), 0);
+        } else if (!readimg_tiles()) {
+            m_buf.clear();
+            return false;
+        }
     }
 
     memcpy(data, &m_buf[0], m_spec.tile_bytes());
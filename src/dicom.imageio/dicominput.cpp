@@ -4,7 +4,9 @@
 
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 
+#include <atomic>
 #include <iostream>
 #include <memory>
 #include <set>
@@ -27,6 +29,11 @@
 // Sources of sample images:
 //   http://www.osirix-viewer.com/resources/dicom-image-library/
 //   http://barre.nom.fr/medical/samples/
+//
+// Each frame of a multi-frame file (such as a CT or MR series) is a
+// subimage, unless the "dicom:Volume" configuration hint asks for the frames
+// to be the z slices of a single volume, in which case they are all decoded
+// in parallel when the pixels are first read.
 
 
 
@@ -37,9 +44,9 @@ public:
     DICOMInput() {}
     virtual ~DICOMInput() { close(); }
     virtual const char* format_name(void) const override { return "dicom"; }
-    virtual int supports(string_view /*feature*/) const override
+    virtual int supports(string_view feature) const override
     {
-        return false;  // we don't support any optional features
+        return feature == "volumes";
     }
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
     virtual bool open(const std::string& name, ImageSpec& newspec,
@@ -51,13 +58,23 @@ public:
 
 private:
     std::unique_ptr<DicomImage> m_img;
-    int m_framecount, m_firstframe;
-    int m_bitspersample;
+    int m_framecount    = 0;  // Frames in the file
+    int m_bitspersample = 0;
+    bool m_volume       = false;  // Present the frames as one volume?
     std::string m_filename;
     int m_subimage              = -1;
-    const DiPixel* m_dipixel    = nullptr;
+    int m_frame                 = -1;  // Frame that m_img has decoded
     const char* m_internal_data = nullptr;
-
+    std::unique_ptr<char[]> m_volumedata;  // All frames, in volume mode
+
+    // Open m_img for decoding frames starting at `frame`.
+    bool open_frame(int frame);
+    // Decode frame (the next one if it follows m_frame) and point
+    // m_internal_data at its pixels.
+    bool decode_frame(int frame);
+    // Decode all the frames into m_volumedata, in parallel.
+    bool decode_volume();
+    bool setup_spec();
     void read_metadata();
 };
 
@@ -82,6 +99,8 @@ dicom_input_imageio_create()
 
 OIIO_EXPORT const char* dicom_input_extensions[] = { "dcm", nullptr };
 
+OIIO_EXPORT const char* dicom_input_signatures[] = { "@128:4449434d", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -98,15 +117,21 @@ DICOMInput::open(const std::string& name, ImageSpec& newspec)
 
 bool
 DICOMInput::open(const std::string& name, ImageSpec& newspec,
-                 const ImageSpec& /*config*/)
+                 const ImageSpec& config)
 {
+    close();
     m_filename = name;
-    m_subimage = -1;
-    m_img.reset();
+    m_volume   = config.get_int_attribute("dicom:Volume") != 0;
 
-    bool ok = seek_subimage(0, 0);
-    newspec = spec();
-    return ok;
+    // Index the file once: the frame count, and the spec and metadata that
+    // all its frames share.
+    if (!open_frame(0) || !setup_spec()) {
+        close();
+        return false;
+    }
+    m_subimage = 0;
+    newspec    = m_spec;
+    return true;
 }
 
 
@@ -115,8 +140,10 @@ bool
 DICOMInput::close()
 {
     m_img.reset();
+    m_volumedata.reset();
+    m_framecount    = 0;
     m_subimage      = -1;
-    m_dipixel       = nullptr;
+    m_frame         = -1;
     m_internal_data = nullptr;
     return true;
 }
@@ -135,54 +162,119 @@ static std::set<std::string> ignore_tags {
 bool
 DICOMInput::seek_subimage(int subimage, int miplevel)
 {
-    if (miplevel != 0)
+    if (subimage < 0 || subimage >= (m_volume ? 1 : m_framecount)
+        || miplevel != 0)
         return false;
+    // Every subimage has the same spec, so there's nothing to do until its
+    // pixels are read.
+    m_subimage = subimage;
+    return true;
+}
 
-    if (subimage == m_subimage) {
-        return true;  // already there
-    }
 
-    if (subimage < m_subimage) {
-        // Want an earlier subimage, Easier to close and start again
-        close();
-        m_subimage = -1;
+
+bool
+DICOMInput::open_frame(int frame)
+{
+    OFLog::configure(OFLogger::FATAL_LOG_LEVEL);
+    m_img.reset(new DicomImage(m_filename.c_str(),
+                               CIF_UsePartialAccessToPixelData, frame,
+                               1 /* fcount */));
+    if (m_img->getStatus() != EIS_Normal) {
+        m_img.reset();
+        m_frame = -1;
+        errorf("Unable to open DICOM file %s", m_filename);
+        return false;
     }
+    m_framecount    = m_img->getNumberOfFrames();
+    m_frame         = frame;
+    m_internal_data = nullptr;
+    return true;
+}
+
+
 
-    // Open if it's not already opened
-    if (!m_img || m_subimage < 0) {
-        OFLog::configure(OFLogger::FATAL_LOG_LEVEL);
-        m_img.reset(new DicomImage(m_filename.c_str(),
-                                   CIF_UsePartialAccessToPixelData,
-                                   0 /*first frame*/, 1 /* fcount */));
-        m_subimage = 0;
-        if (m_img->getStatus() != EIS_Normal) {
-            m_img.reset();
-            errorf("Unable to open DICOM file %s", m_filename);
+bool
+DICOMInput::decode_frame(int frame)
+{
+    if (frame != m_frame || !m_internal_data) {
+        // Decoding proceeds frame by frame, so step to the next one, but
+        // jump straight to any other rather than decode those in between.
+        if (m_img && frame == m_frame + 1) {
+            m_img->processNextFrames(1);
+            if (m_img->getStatus() != EIS_Normal) {
+                m_img.reset();
+                m_frame = -1;
+                errorf("Unable to seek to subimage %d", frame);
+                return false;
+            }
+            m_frame = frame;
+        } else if (frame != m_frame || !m_img) {
+            if (!open_frame(frame))
+                return false;
+        }
+        m_internal_data = (const char*)m_img->getOutputData(0, frame, 0);
+        if (!m_internal_data) {
+            errorf("Unable to decode subimage %d", frame);
             return false;
         }
-        m_framecount = m_img->getFrameCount();
-        m_firstframe = m_img->getFirstFrame();
     }
+    return true;
+}
+
+
 
-    if (subimage >= m_firstframe + m_framecount) {
-        errorf("Unable to seek to subimage %d", subimage);
+bool
+DICOMInput::decode_volume()
+{
+    if (m_volumedata)
+        return true;
+    const size_t framebytes = m_spec.image_bytes() / m_framecount;
+    std::unique_ptr<char[]> volume(new char[m_spec.image_bytes()]);
+
+    // Each task decodes a run of consecutive frames with a DicomImage of
+    // its own, since they can't be shared between threads.
+    std::atomic<int> badframe(-1);
+    parallel_for_chunked(
+        0, m_framecount, 0,
+        [&](int64_t b, int64_t e) {
+            std::unique_ptr<DicomImage> img(
+                new DicomImage(m_filename.c_str(),
+                               CIF_UsePartialAccessToPixelData, int(b), 1));
+            for (int64_t f = b; f < e && badframe < 0; ++f) {
+                if (f > b)
+                    img->processNextFrames(1);
+                const void* data = img->getStatus() == EIS_Normal
+                                       ? img->getOutputData(0, f, 0)
+                                       : nullptr;
+                if (!data) {
+                    badframe = int(f);
+                    return;
+                }
+                memcpy(volume.get() + f * framebytes, data, framebytes);
+            }
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (badframe >= 0) {
+        errorf("Unable to decode frame %d of DICOM file %s", int(badframe),
+               m_filename);
         return false;
     }
+    m_volumedata = std::move(volume);
+    return true;
+}
 
-    // Advance to the desired subimage
-    while (m_subimage < subimage) {
-        m_img->processNextFrames(1);
-        if (m_img->getStatus() != EIS_Normal) {
-            m_img.reset();
-            errorf("Unable to seek to subimage %d", subimage);
-            return false;
-        }
-        ++m_subimage;
-    }
 
-    m_dipixel             = m_img->getInterData();
-    m_internal_data       = (const char*)m_dipixel->getData();
-    EP_Representation rep = m_dipixel->getRepresentation();
+
+bool
+DICOMInput::setup_spec()
+{
+    const DiPixel* dipixel = m_img->getInterData();
+    if (!dipixel) {
+        errorf("Unable to read DICOM file %s", m_filename);
+        return false;
+    }
+    EP_Representation rep = dipixel->getRepresentation();
     TypeDesc format;
     switch (rep) {
     case EPR_Uint8: format = TypeDesc::UINT8; break;
@@ -193,7 +285,6 @@ DICOMInput::seek_subimage(int subimage, int miplevel)
     case EPR_Sint32: format = TypeDesc::INT32; break;
     default: break;
     }
-    m_internal_data = (const char*)m_img->getOutputData(0, m_subimage, 0);
 
     EP_Interpretation photo = m_img->getPhotometricInterpretation();
     struct PhotoTable {
@@ -228,6 +319,8 @@ DICOMInput::seek_subimage(int subimage, int miplevel)
 
     m_spec = ImageSpec(m_img->getWidth(), m_img->getHeight(), nchannels,
                        format);
+    if (m_volume)
+        m_spec.depth = m_spec.full_depth = m_framecount;
 
     m_bitspersample = m_img->getDepth();
     if (size_t(m_bitspersample) != m_spec.format.size() * 8)
@@ -239,7 +332,7 @@ DICOMInput::seek_subimage(int subimage, int miplevel)
     if (m_spec.nchannels > 1) {
         m_spec.attribute(
             "dicom:PlanarConfiguration",
-            (int)((DiColorPixel*)m_dipixel)->getPlanarConfiguration());
+            (int)((DiColorPixel*)dipixel)->getPlanarConfiguration());
     }
 
     read_metadata();
@@ -323,7 +416,7 @@ DICOMInput::read_metadata()
 
 
 bool
-DICOMInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+DICOMInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                  void* data)
 {
     lock_guard lock(*this);
@@ -332,9 +425,18 @@ DICOMInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     if (y < 0 || y >= m_spec.height)  // out of range scanline
         return false;
 
-    OIIO_DASSERT(m_internal_data);
     size_t size = m_spec.scanline_bytes();
-    memcpy(data, m_internal_data + y * size, size);
+    if (m_volume) {
+        if (z < 0 || z >= m_spec.depth || !decode_volume())
+            return false;
+        memcpy(data,
+               m_volumedata.get() + (size_t(z) * m_spec.height + y) * size,
+               size);
+    } else {
+        if (!decode_frame(subimage))
+            return false;
+        memcpy(data, m_internal_data + y * size, size);
+    }
 
     // Handle non-full bit depths
     int bits = m_spec.format.size() * 8;
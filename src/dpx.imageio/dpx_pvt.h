@@ -0,0 +1,111 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/simd.h>
+
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+// Fast paths for the most common layout of 10 bit film scans: RGB with
+// one pixel per 32 bit word, R in the highest bits and `pad` unused bits
+// at the bottom (2 for DPX "filled, method A" and Cineon's left justified
+// cells, 0 for DPX method B). Shared by the DPX and Cineon readers, and
+// used by the DPX writer.
+namespace DPX_pvt {
+
+// Byte swap each of the four words
+inline simd::vint4
+byteswap(const simd::vint4& w)
+{
+    using simd::srl;
+    return (w << 24) | ((w & simd::vint4(0xff00)) << 8)
+           | (srl(w, 8) & simd::vint4(0xff00)) | srl(w, 24);
+}
+
+
+
+/// Unpack `npixels` words of 10 bit RGB into 3*npixels uint16 values,
+/// scaling each to the full 16 bit range exactly as libdpx does. If
+/// `swap` is true, the words are byte swapped first.
+inline void
+unpack_10bit_rgb(const uint32_t* src, uint16_t* dst, size_t npixels, int pad,
+                 bool swap)
+{
+    using namespace simd;
+    const vint4 mask(0x3ff);
+    size_t i = 0;
+    for (; i + 4 <= npixels; i += 4, dst += 12) {
+        vint4 w;
+        w.load((const int*)src + i);
+        if (swap)
+            w = byteswap(w);
+        vint4 c[3] = { srl(w, 20 + pad) & mask, srl(w, 10 + pad) & mask,
+                       srl(w, pad) & mask };
+        OIIO_SIMD4_ALIGN int v[3][4];
+        for (int ch = 0; ch < 3; ++ch)
+            ((c[ch] << 6) | srl(c[ch], 4)).store(v[ch]);
+        for (int j = 0; j < 4; ++j) {
+            dst[3 * j + 0] = uint16_t(v[0][j]);
+            dst[3 * j + 1] = uint16_t(v[1][j]);
+            dst[3 * j + 2] = uint16_t(v[2][j]);
+        }
+    }
+    for (; i < npixels; ++i, dst += 3) {
+        uint32_t w;
+        memcpy(&w, src + i, sizeof(w));  // src need not be aligned
+        if (swap)
+            w = (w << 24) | ((w & 0xff00) << 8) | ((w >> 8) & 0xff00)
+                | (w >> 24);
+        for (int ch = 0; ch < 3; ++ch) {
+            uint32_t v = (w >> ((2 - ch) * 10 + pad)) & 0x3ff;
+            dst[ch]    = uint16_t((v << 6) | (v >> 4));
+        }
+    }
+}
+
+
+
+/// Pack 3*npixels uint16 values into `npixels` words of 10 bit RGB,
+/// keeping the top 10 bits of each value exactly as libdpx does. If
+/// `swap` is true, the words are byte swapped afterwards.
+inline void
+pack_10bit_rgb(const uint16_t* src, uint32_t* dst, size_t npixels, int pad,
+               bool swap)
+{
+    using namespace simd;
+    size_t i = 0;
+    for (; i + 4 <= npixels; i += 4, src += 12) {
+        OIIO_SIMD4_ALIGN int v[3][4];
+        for (int j = 0; j < 4; ++j) {
+            v[0][j] = src[3 * j + 0];
+            v[1][j] = src[3 * j + 1];
+            v[2][j] = src[3 * j + 2];
+        }
+        vint4 w = (srl(vint4(v[0]), 6) << (20 + pad))
+                  | (srl(vint4(v[1]), 6) << (10 + pad))
+                  | (srl(vint4(v[2]), 6) << pad);
+        if (swap)
+            w = byteswap(w);
+        w.store((int*)dst + i);
+    }
+    for (; i < npixels; ++i, src += 3) {
+        uint32_t w = (uint32_t(src[0] >> 6) << (20 + pad))
+                     | (uint32_t(src[1] >> 6) << (10 + pad))
+                     | (uint32_t(src[2] >> 6) << pad);
+        if (swap)
+            w = (w << 24) | ((w & 0xff00) << 8) | ((w >> 8) & 0xff00)
+                | (w >> 24);
+        dst[i] = w;
+    }
+}
+
+}  // namespace DPX_pvt
+
+OIIO_PLUGIN_NAMESPACE_END
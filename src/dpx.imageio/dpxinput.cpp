@@ -14,9 +14,12 @@
 #include "libdpx/DPXColorConverter.h"
 
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/typedesc.h>
 
+#include "dpx_pvt.h"
+
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 
@@ -47,6 +50,7 @@ private:
     dpx::Reader m_dpx;
     std::vector<unsigned char> m_userBuf;
     bool m_rawcolor;
+    bool m_rgb10;  // subimage is 10 bit filled RGB, we can unpack it directly
     std::vector<unsigned char> m_decodebuf;  // temporary decode buffer
 
     /// Reset everything to initial state
@@ -61,9 +65,14 @@ private:
         }
         m_userBuf.clear();
         m_rawcolor = false;
+        m_rgb10    = false;
         ioproxy_clear();
     }
 
+    /// Helper function - read and unpack scanlines of a 10 bit filled RGB
+    /// subimage, bypassing libdpx.
+    bool read_rgb10_scanlines(int ybegin, int yend, void* data);
+
     /// Helper function - retrieve string for libdpx characteristic
     ///
     std::string get_characteristic_string(dpx::Characteristic c);
@@ -102,6 +111,10 @@ dpx_imageio_library_version()
 
 OIIO_EXPORT const char* dpx_input_extensions[] = { "dpx", nullptr };
 
+OIIO_EXPORT const char* dpx_input_signatures[] = {
+    "53445058", "58504453", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -181,6 +194,16 @@ DPXInput::seek_subimage(int subimage, int miplevel)
 
     m_subimage = subimage;
 
+    // The common 10 bit RGB layout, one pixel per 32 bit word, has a
+    // dedicated unpacker that doesn't need to go through libdpx.
+    dpx::Packing packing = m_dpx.header.ImagePacking(subimage);
+    m_rgb10 = (m_dpx.header.ImageDescriptor(subimage) == dpx::kRGB
+               && m_dpx.header.BitDepth(subimage) == 10
+               && m_dpx.header.ComponentDataSize(subimage) == dpx::kWord
+               && m_dpx.header.ImageEncoding(subimage) == dpx::kNone
+               && (packing == dpx::kFilledMethodA
+                   || packing == dpx::kFilledMethodB));
+
     // create imagespec
     TypeDesc typedesc;
     switch (m_dpx.header.ComponentDataSize(subimage)) {
@@ -581,6 +604,10 @@ DPXInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
     if (!seek_subimage(subimage, miplevel))
         return false;
 
+    // RGB needs no color conversion, so this serves raw color as well
+    if (m_rgb10)
+        return read_rgb10_scanlines(ybegin, yend, data);
+
     dpx::Block block(0, ybegin - m_spec.y, m_dpx.header.Width() - 1,
                      yend - 1 - m_spec.y);
 
@@ -608,6 +635,46 @@ DPXInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
 
 
 
+bool
+DPXInput::read_rgb10_scanlines(int ybegin, int yend, void* data)
+{
+    const dpx::Header& header = m_dpx.header;
+    size_t width              = m_spec.width;
+    size_t linebytes = width * 4 + header.EndOfLinePadding(m_subimage);
+    int64_t offset   = header.DataOffset(m_subimage)
+                     + int64_t(ybegin - m_spec.y) * linebytes;
+    size_t size = size_t(yend - ybegin - 1) * linebytes + width * 4;
+
+    // Unpack straight out of the proxy's memory (for example, a memory
+    // mapped file) if it has any to show us, otherwise read into a buffer.
+    cspan<unsigned char> view = ioproxy()->view(offset, size);
+    const unsigned char* raw  = view.data();
+    if (size_t(view.size()) != size) {
+        m_decodebuf.resize(size);
+        if (ioproxy()->pread(m_decodebuf.data(), size, offset) != size) {
+            errorfmt("Read error reading scanlines {}-{}", ybegin, yend - 1);
+            return false;
+        }
+        raw = m_decodebuf.data();
+    }
+
+    int pad   = header.ImagePacking(m_subimage) == dpx::kFilledMethodA ? 2 : 0;
+    bool swap = header.RequiresByteSwap();
+    parallel_for_chunked(
+        0, yend - ybegin, 0,
+        [&](int64_t b, int64_t e) {
+            for (int64_t y = b; y < e; ++y)
+                DPX_pvt::unpack_10bit_rgb((const uint32_t*)(raw
+                                                            + y * linebytes),
+                                          (uint16_t*)data + y * width * 3,
+                                          width, pad, swap);
+        },
+        parallel_options(threads(), Split_Y, 1));
+    return true;
+}
+
+
+
 std::string
 DPXInput::get_characteristic_string(dpx::Characteristic c)
 {
@@ -14,9 +14,12 @@
 
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/typedesc.h>
 
+#include "dpx_pvt.h"
+
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 
@@ -92,6 +95,9 @@ private:
     // flush the pending buffer
     bool write_buffer();
 
+    // pack and write the pending buffer of a 10 bit filled RGB subimage
+    bool write_rgb10_buffer();
+
     bool prep_subimage(int s, bool allocate);
 
     /// Helper function - retrieve libdpx descriptor for string
@@ -568,7 +574,17 @@ DPXOutput::write_buffer()
 {
     bool ok = true;
     if (m_write_pending) {
-        ok = m_dpx.WriteElement(m_subimage, &m_buf[0], m_datasize);
+        const dpx::Header& header(m_dpx.header);
+        if (m_desc == dpx::kRGB && m_bitdepth == 10
+            && m_datasize == dpx::kWord
+            && (m_packing == dpx::kFilledMethodA
+                || m_packing == dpx::kFilledMethodB)
+            && header.DatumSwap(m_subimage)
+            && !header.EndOfLinePadding(m_subimage)
+            && !header.EndOfImagePadding(m_subimage))
+            ok = write_rgb10_buffer();
+        else
+            ok = m_dpx.WriteElement(m_subimage, &m_buf[0], m_datasize);
         if (!ok) {
             const char* err = strerror(errno);
             errorf("DPX write failed (%s)",
@@ -581,6 +597,36 @@ DPXOutput::write_buffer()
 
 
 
+bool
+DPXOutput::write_rgb10_buffer()
+{
+    // The common 10 bit RGB layout is one pixel per 32 bit word, so pack
+    // all the scanlines in parallel and have libdpx write them verbatim.
+    size_t width = m_spec.width;
+    std::vector<uint32_t> packed(width * m_spec.height);
+    int pad   = m_packing == dpx::kFilledMethodA ? 2 : 0;
+    bool swap = m_dpx.header.RequiresByteSwap();
+    parallel_for_chunked(
+        0, m_spec.height, 0,
+        [&](int64_t b, int64_t e) {
+            for (int64_t y = b; y < e; ++y)
+                DPX_pvt::pack_10bit_rgb((const uint16_t*)&m_buf[y * m_bytes],
+                                        packed.data() + y * width, width, pad,
+                                        swap);
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!m_dpx.WriteElement(m_subimage, packed.data(),
+                            long(packed.size() * sizeof(uint32_t))))
+        return false;
+    // Unlike the other flavor of WriteElement, this one doesn't record the
+    // start of the first element's data as the image offset.
+    if (m_subimage == 0)
+        m_dpx.header.SetImageOffset(m_dpx.header.DataOffset(0));
+    return true;
+}
+
+
+
 bool
 DPXOutput::close()
 {
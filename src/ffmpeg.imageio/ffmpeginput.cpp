@@ -29,6 +29,12 @@ extern "C" {  // ffmpeg is a C api
 #define USE_FFMPEG_4_3 (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 91, 100))
 #define USE_FFMPEG_4_4 (LIBAVCODEC_VERSION_INT >= AV_VERSION_INT(58, 134, 100))
 
+#if USE_FFMPEG_4_0
+extern "C" {
+#    include <libavutil/hwcontext.h>
+}
+#endif
+
 
 
 inline int
@@ -78,13 +84,32 @@ receive_frame(AVCodecContext* avctx, AVFrame* picture, AVPacket* avpkt)
 
 
 
-#include <OpenImageIO/imageio.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <mutex>
+#include <thread>
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 
+// Presentation timestamps of every frame of a video stream, gathered by
+// scanning its packets once (without decoding). Frame i of the movie is
+// the one with the i-th smallest pts, and decoding of frame i must start
+// from the last keyframe at or before it.
+struct FFmpegFrameIndex {
+    std::vector<int64_t> pts;        // pts of every frame, sorted
+    std::vector<int64_t> keyframes;  // pts of every keyframe, sorted
+};
+
+
+
 class FFmpegInput final : public ImageInput {
 public:
     FFmpegInput();
@@ -95,6 +120,8 @@ public:
     }
     virtual bool valid_file(const std::string& name) const override;
     virtual bool open(const std::string& name, ImageSpec& spec) override;
+    virtual bool open(const std::string& name, ImageSpec& spec,
+                      const ImageSpec& config) override;
     virtual bool close(void) override;
     virtual int current_subimage(void) const override
     {
@@ -104,7 +131,7 @@ public:
     virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
-    void read_frame(int pos);
+    bool read_frame(int pos);
 #if 0
     const char *metadata (const char * key);
     bool has_metadata (const char * key);
@@ -121,21 +148,38 @@ private:
     AVCodecContext* m_codec_context;
     AVCodec* m_codec;
     AVFrame* m_frame;
+    AVFrame* m_sw_frame;  // hardware decoded frames are copied here
     AVFrame* m_rgb_frame;
     size_t m_stride;  // scanline width in bytes, a.k.a. scanline stride
     AVPixelFormat m_dst_pix_format;
+    AVPixelFormat m_hw_pix_format;  // AV_PIX_FMT_NONE if not hw decoding
     SwsContext* m_sws_rgb_context;
     AVRational m_frame_rate;
     std::vector<uint8_t> m_rgb_buffer;
     std::vector<int> m_video_indexes;
+    std::shared_ptr<const FFmpegFrameIndex> m_index;  // may be null
     int m_video_stream;
     int64_t m_frames;
     int m_last_search_pos;
-    int m_last_decoded_pos;
+    int m_last_decoded_pos;  // -1 if the decoder position is unknown
+    int m_last_read_pos;     // last frame returned by read_frame
     bool m_offset_time;
     bool m_codec_cap_delay;
     bool m_read_frame;
     int64_t m_start_time;
+    std::string m_hwaccel;  // "ffmpeg:hwaccel" hint
+
+    // Sequential reads are served by a thread that decodes up to
+    // m_prefetch_size frames ahead. While it runs, it alone uses the
+    // format, codec and sws contexts.
+    std::thread m_prefetch_thread;
+    std::mutex m_prefetch_mutex;
+    std::condition_variable m_prefetch_cv;
+    std::deque<std::pair<int, std::vector<uint8_t>>> m_prefetched;
+    int m_prefetch_size;  // "ffmpeg:prefetch" hint, 0 disables
+    int m_prefetch_next;  // next frame the prefetch thread will decode
+    bool m_prefetch_stop;
+    bool m_prefetch_running;
 
     // init to initialize state
     void init(void)
@@ -145,25 +189,76 @@ private:
         m_codec_context   = 0;
         m_codec           = 0;
         m_frame           = 0;
+        m_sw_frame        = 0;
         m_rgb_frame       = 0;
         m_sws_rgb_context = 0;
         m_stride          = 0;
+        m_hw_pix_format   = AV_PIX_FMT_NONE;
         m_rgb_buffer.clear();
         m_video_indexes.clear();
+        m_index.reset();
         m_video_stream     = -1;
         m_frames           = 0;
         m_last_search_pos  = 0;
-        m_last_decoded_pos = 0;
+        m_last_decoded_pos = -1;
+        m_last_read_pos    = -1;
         m_offset_time      = true;
         m_read_frame       = false;
         m_codec_cap_delay  = false;
         m_subimage         = 0;
         m_start_time       = 0;
+        m_hwaccel.clear();
+        m_prefetched.clear();
+        m_prefetch_size    = 4;
+        m_prefetch_next    = 0;
+        m_prefetch_stop    = false;
+        m_prefetch_running = false;
     }
+
+    std::shared_ptr<const FFmpegFrameIndex> build_index();
+    int frame_number(int64_t pts) const;
+    bool decode_frame(int frame, uint8_t* dst);
+    bool convert_frame(const AVFrame* frame, uint8_t* dst);
+    void start_prefetch(int frame);
+    void stop_prefetch();
+    bool prefetched_frame(int frame);
+    void prefetch_loop(size_t nbytes);
+#if USE_FFMPEG_4_0
+    bool init_hwaccel(const std::string& name);
+    static AVPixelFormat get_hw_format(AVCodecContext* ctx,
+                                       const AVPixelFormat* formats);
+#endif
 };
 
 
 
+// Frame indices of recently opened movies, keyed by file name and
+// checked against the modification time, so that reopening a movie (as
+// ImageCache does when it runs short of file handles) doesn't rescan it.
+static std::mutex index_cache_mutex;
+static std::map<std::string,
+                std::pair<std::time_t, std::shared_ptr<const FFmpegFrameIndex>>>
+    index_cache;
+static const size_t index_cache_max = 64;
+
+
+
+// Map the deprecated full range "J" formats to their regular
+// counterparts, which is what swscale expects.
+static AVPixelFormat
+sws_pix_format(AVPixelFormat fmt)
+{
+    switch (fmt) {  // deprecation warning for YUV formats
+    case AV_PIX_FMT_YUVJ420P: return AV_PIX_FMT_YUV420P;
+    case AV_PIX_FMT_YUVJ422P: return AV_PIX_FMT_YUV422P;
+    case AV_PIX_FMT_YUVJ444P: return AV_PIX_FMT_YUV444P;
+    case AV_PIX_FMT_YUVJ440P: return AV_PIX_FMT_YUV440P;
+    default: return fmt;
+    }
+}
+
+
+
 // Obligatory material to make this a recognizeable imageio plugin
 OIIO_PLUGIN_EXPORTS_BEGIN
 
@@ -189,6 +284,8 @@ OIIO_EXPORT const char* ffmpeg_input_extensions[] = {
     "avi", "mov", "qt", "mp4", "m4a", "3gp", "3g2", "mj2", "m4v", "mpg", nullptr
 };
 
+OIIO_EXPORT const char* ffmpeg_input_signatures[] = { nullptr };
+
 
 OIIO_PLUGIN_EXPORTS_END
 
@@ -215,6 +312,19 @@ FFmpegInput::valid_file(const std::string& name) const
 
 
 
+bool
+FFmpegInput::open(const std::string& name, ImageSpec& spec,
+                  const ImageSpec& config)
+{
+    // Check 'config' for any special requests
+    m_prefetch_size = std::max(0, config.get_int_attribute("ffmpeg:prefetch",
+                                                           m_prefetch_size));
+    m_hwaccel       = config.get_string_attribute("ffmpeg:hwaccel");
+    return open(name, spec);
+}
+
+
+
 bool
 FFmpegInput::open(const std::string& name, ImageSpec& spec)
 {
@@ -288,6 +398,13 @@ FFmpegInput::open(const std::string& name, ImageSpec& spec)
         errorfmt("\"{}\" unsupported codec", file_name);
         return false;
     }
+
+#    if USE_FFMPEG_4_0
+    // Hardware decoding is only a hint: if no device can be had, quietly
+    // decode in software.
+    if (m_hwaccel.size() && m_hwaccel != "none")
+        init_hwaccel(m_hwaccel);
+#    endif
 #else
     m_codec_context = stream_codec(m_video_stream);
 
@@ -316,6 +433,28 @@ FFmpegInput::open(const std::string& name, ImageSpec& spec)
 
     m_frames     = stream->nb_frames;
     m_start_time = stream->start_time;
+
+    // The frame index lets us seek straight to the keyframe preceding any
+    // frame, and tells exactly how many frames there are.
+    std::time_t mtime = Filesystem::last_write_time(name);
+    {
+        std::lock_guard<std::mutex> lock(index_cache_mutex);
+        auto found = index_cache.find(name);
+        if (found != index_cache.end() && found->second.first == mtime)
+            m_index = found->second.second;
+    }
+    if (!m_index) {
+        m_index = build_index();
+        if (m_index) {
+            std::lock_guard<std::mutex> lock(index_cache_mutex);
+            if (index_cache.size() >= index_cache_max)
+                index_cache.clear();
+            index_cache[name] = std::make_pair(mtime, m_index);
+        }
+    }
+    if (m_index)
+        m_frames = int64_t(m_index->pts.size());
+
     if (!m_frames) {
         seek(0);
         AVPacket pkt;
@@ -337,16 +476,10 @@ FFmpegInput::open(const std::string& name, ImageSpec& spec)
         m_frames = max_pts;
     }
     m_frame     = av_frame_alloc();
+    m_sw_frame  = av_frame_alloc();
     m_rgb_frame = av_frame_alloc();
 
-    AVPixelFormat src_pix_format;
-    switch (m_codec_context->pix_fmt) {  // deprecation warning for YUV formats
-    case AV_PIX_FMT_YUVJ420P: src_pix_format = AV_PIX_FMT_YUV420P; break;
-    case AV_PIX_FMT_YUVJ422P: src_pix_format = AV_PIX_FMT_YUV422P; break;
-    case AV_PIX_FMT_YUVJ444P: src_pix_format = AV_PIX_FMT_YUV444P; break;
-    case AV_PIX_FMT_YUVJ440P: src_pix_format = AV_PIX_FMT_YUV440P; break;
-    default: src_pix_format = m_codec_context->pix_fmt; break;
-    }
+    AVPixelFormat src_pix_format = sws_pix_format(m_codec_context->pix_fmt);
 
     // Assume by default that we're delivering RGB UINT8
     int nchannels     = 3;
@@ -571,12 +704,18 @@ FFmpegInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
 bool
 FFmpegInput::close(void)
 {
+    stop_prefetch();
+#if USE_FFMPEG_3_1
+    avcodec_free_context(&m_codec_context);  // also drops the hw device
+#else
     if (m_codec_context)
         avcodec_close(m_codec_context);
+#endif
     if (m_format_context)
         avformat_close_input(&m_format_context);
     av_free(m_format_context);  // will free m_codec and m_codec_context
     av_frame_free(&m_frame);    // free after close input
+    av_frame_free(&m_sw_frame);
     av_frame_free(&m_rgb_frame);
     sws_freeContext(m_sws_rgb_context);
     init();
@@ -585,15 +724,51 @@ FFmpegInput::close(void)
 
 
 
-void
+bool
 FFmpegInput::read_frame(int frame)
 {
-    if (m_last_decoded_pos + 1 != frame) {
-        seek(frame);
+    bool ok = prefetched_frame(frame);
+    if (!ok) {
+        stop_prefetch();
+        ok = decode_frame(frame, m_rgb_buffer.data());
+        // Two frames in a row look like playback: start decoding ahead.
+        if (ok && frame == m_last_read_pos + 1)
+            start_prefetch(frame + 1);
+    }
+    if (ok)
+        avpicture_fill(reinterpret_cast<AVPicture*>(m_rgb_frame),
+                       &m_rgb_buffer[0], m_dst_pix_format,
+                       m_codec_context->width, m_codec_context->height);
+    else
+        m_rgb_frame->data[0] = NULL;
+    m_last_read_pos = frame;
+    m_read_frame    = true;
+    return ok;
+}
+
+
+
+bool
+FFmpegInput::decode_frame(int frame, uint8_t* dst)
+{
+    if (m_last_decoded_pos < 0 || frame != m_last_decoded_pos + 1) {
+        // Decoding onward from the current position is cheaper than
+        // seeking, unless a keyframe lies between here and the target.
+        bool onward = false;
+        if (m_index && m_last_decoded_pos >= 0 && frame > m_last_decoded_pos) {
+            const auto& kf = m_index->keyframes;
+            onward = std::upper_bound(kf.begin(), kf.end(),
+                                      m_index->pts[m_last_decoded_pos])
+                         == std::upper_bound(kf.begin(), kf.end(),
+                                             m_index->pts[frame]);
+        }
+        if (!onward)
+            seek(frame);
     }
     AVPacket pkt;
     int finished = 0;
     int ret      = 0;
+    bool ok      = false;
     while ((ret = av_read_frame(m_format_context, &pkt)) == 0
            || m_codec_cap_delay) {
         if (ret == AVERROR_EOF) {
@@ -607,38 +782,256 @@ FFmpegInput::read_frame(int frame)
 
             finished = receive_frame(m_codec_context, m_frame, &pkt);
 
-            double pts = 0;
-            if (static_cast<int64_t>(m_frame->pkt_pts)
-                != int64_t(AV_NOPTS_VALUE)) {
-                pts = av_q2d(
-                          m_format_context->streams[m_video_stream]->time_base)
-                      * m_frame->pkt_pts;
-            }
-
-            int current_frame = int((pts - m_start_time) * fps() + 0.5f);  //???
+            int current_frame = frame_number(
+                static_cast<int64_t>(m_frame->pkt_pts));
             //current_frame =   m_frame->display_picture_number;
             m_last_search_pos = current_frame;
 
             if (current_frame == frame && finished) {
-                avpicture_fill(reinterpret_cast<AVPicture*>(m_rgb_frame),
-                               &m_rgb_buffer[0], m_dst_pix_format,
-                               m_codec_context->width, m_codec_context->height);
-                sws_scale(m_sws_rgb_context,
-                          static_cast<uint8_t const* const*>(m_frame->data),
-                          m_frame->linesize, 0, m_codec_context->height,
-                          m_rgb_frame->data, m_rgb_frame->linesize);
+                ok                 = convert_frame(m_frame, dst);
                 m_last_decoded_pos = current_frame;
                 av_packet_unref(&pkt);
                 break;
             }
+            if (m_index && finished && current_frame > frame) {
+                // Frames come out in order, so we've missed it
+                av_packet_unref(&pkt);
+                break;
+            }
         }
         av_packet_unref(&pkt);
     }
-    m_read_frame = true;
+    if (!ok)
+        m_last_decoded_pos = -1;  // force a seek next time
+    return ok;
 }
 
 
 
+bool
+FFmpegInput::convert_frame(const AVFrame* frame, uint8_t* dst)
+{
+#if USE_FFMPEG_4_0
+    if (frame->format == m_hw_pix_format) {
+        // Download from the device, to whatever format it prefers
+        av_frame_unref(m_sw_frame);
+        if (av_hwframe_transfer_data(m_sw_frame, frame, 0) < 0)
+            return false;
+        frame = m_sw_frame;
+    }
+#endif
+    int w = m_codec_context->width, h = m_codec_context->height;
+    m_sws_rgb_context = sws_getCachedContext(
+        m_sws_rgb_context, w, h, sws_pix_format(AVPixelFormat(frame->format)),
+        w, h, m_dst_pix_format, SWS_AREA, NULL, NULL, NULL);
+    if (!m_sws_rgb_context)
+        return false;
+    uint8_t* dst_data[4];
+    int dst_linesize[4];
+    av_image_fill_arrays(dst_data, dst_linesize, dst, m_dst_pix_format, w, h,
+                         1);
+    sws_scale(m_sws_rgb_context,
+              static_cast<uint8_t const* const*>(frame->data), frame->linesize,
+              0, h, dst_data, dst_linesize);
+    return true;
+}
+
+
+
+void
+FFmpegInput::start_prefetch(int frame)
+{
+    if (m_prefetch_size <= 0 || threads() == 1 || frame >= m_nsubimages)
+        return;
+    m_prefetched.clear();
+    m_prefetch_next    = frame;
+    m_prefetch_stop    = false;
+    m_prefetch_running = true;
+    m_prefetch_thread  = std::thread(&FFmpegInput::prefetch_loop, this,
+                                    m_rgb_buffer.size());
+}
+
+
+
+void
+FFmpegInput::stop_prefetch()
+{
+    if (!m_prefetch_thread.joinable())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        m_prefetch_stop = true;
+    }
+    m_prefetch_cv.notify_all();
+    m_prefetch_thread.join();
+    m_prefetched.clear();
+    m_prefetch_running = false;
+}
+
+
+
+bool
+FFmpegInput::prefetched_frame(int frame)
+{
+    if (!m_prefetch_thread.joinable())
+        return false;
+    std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+    // Frames before the one asked for won't be asked for again
+    while (m_prefetched.size() && m_prefetched.front().first < frame)
+        m_prefetched.pop_front();
+    m_prefetch_cv.notify_all();
+    if (m_prefetched.empty()) {
+        if (frame != m_prefetch_next)
+            return false;  // not coming, the caller will have to seek
+        m_prefetch_cv.wait(lock, [&]() {
+            return m_prefetched.size() || !m_prefetch_running;
+        });
+    }
+    if (m_prefetched.empty() || m_prefetched.front().first != frame)
+        return false;
+    std::swap(m_rgb_buffer, m_prefetched.front().second);
+    m_prefetched.pop_front();
+    m_prefetch_cv.notify_all();
+    return true;
+}
+
+
+
+void
+FFmpegInput::prefetch_loop(size_t nbytes)
+{
+    std::vector<uint8_t> buf;
+    for (;;) {
+        int frame;
+        {
+            std::unique_lock<std::mutex> lock(m_prefetch_mutex);
+            m_prefetch_cv.wait(lock, [&]() {
+                return m_prefetch_stop
+                       || int(m_prefetched.size()) < m_prefetch_size;
+            });
+            if (m_prefetch_stop || m_prefetch_next >= m_nsubimages)
+                break;
+            frame = m_prefetch_next;
+        }
+        buf.resize(nbytes);
+        bool ok = decode_frame(frame, buf.data());
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        if (!ok)
+            break;
+        m_prefetched.emplace_back(frame, std::move(buf));
+        ++m_prefetch_next;
+        m_prefetch_cv.notify_all();
+    }
+    std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+    m_prefetch_running = false;
+    m_prefetch_cv.notify_all();
+}
+
+
+
+std::shared_ptr<const FFmpegFrameIndex>
+FFmpegInput::build_index()
+{
+    auto index = std::make_shared<FFmpegFrameIndex>();
+    AVPacket pkt;
+    av_init_packet(&pkt);
+    while (av_read_frame(m_format_context, &pkt) >= 0) {
+        if (pkt.stream_index == m_video_stream) {
+            if (pkt.pts == int64_t(AV_NOPTS_VALUE)) {
+                // Can't index frames we can't tell apart
+                av_packet_unref(&pkt);
+                return nullptr;
+            }
+            index->pts.push_back(pkt.pts);
+            if (pkt.flags & AV_PKT_FLAG_KEY)
+                index->keyframes.push_back(pkt.pts);
+        }
+        av_packet_unref(&pkt);
+    }
+    m_last_decoded_pos = -1;  // we're at the end now
+    if (index->pts.empty() || index->keyframes.empty())
+        return nullptr;
+    std::sort(index->pts.begin(), index->pts.end());
+    std::sort(index->keyframes.begin(), index->keyframes.end());
+    return index;
+}
+
+
+
+int
+FFmpegInput::frame_number(int64_t pts) const
+{
+    if (m_index) {
+        if (pts == int64_t(AV_NOPTS_VALUE))
+            return -1;
+        const auto& p = m_index->pts;
+        return int(std::lower_bound(p.begin(), p.end(), pts) - p.begin());
+    }
+    double t = 0;
+    if (pts != int64_t(AV_NOPTS_VALUE))
+        t = av_q2d(m_format_context->streams[m_video_stream]->time_base) * pts;
+    return int((t - m_start_time) * fps() + 0.5f);  //???
+}
+
+
+
+#if USE_FFMPEG_4_0
+bool
+FFmpegInput::init_hwaccel(const std::string& name)
+{
+    // "auto" tries every kind of device this FFmpeg knows about
+    std::vector<AVHWDeviceType> types;
+    if (name == "auto") {
+        AVHWDeviceType t = AV_HWDEVICE_TYPE_NONE;
+        while ((t = av_hwdevice_iterate_types(t)) != AV_HWDEVICE_TYPE_NONE)
+            types.push_back(t);
+    } else {
+        types.push_back(av_hwdevice_find_type_by_name(name.c_str()));
+    }
+    for (AVHWDeviceType type : types) {
+        if (type == AV_HWDEVICE_TYPE_NONE)
+            continue;
+        // Can the decoder use this kind of device at all?
+        AVPixelFormat hw_format = AV_PIX_FMT_NONE;
+        for (int i = 0;; ++i) {
+            const AVCodecHWConfig* hwconfig = avcodec_get_hw_config(m_codec, i);
+            if (!hwconfig)
+                break;
+            if ((hwconfig->methods & AV_CODEC_HW_CONFIG_METHOD_HW_DEVICE_CTX)
+                && hwconfig->device_type == type) {
+                hw_format = hwconfig->pix_fmt;
+                break;
+            }
+        }
+        AVBufferRef* device = NULL;
+        if (hw_format == AV_PIX_FMT_NONE
+            || av_hwdevice_ctx_create(&device, type, NULL, NULL, 0) < 0)
+            continue;
+        m_codec_context->hw_device_ctx = device;  // the context owns it now
+        m_codec_context->opaque        = this;
+        m_codec_context->get_format    = get_hw_format;
+        m_hw_pix_format                = hw_format;
+        return true;
+    }
+    return false;
+}
+
+
+
+AVPixelFormat
+FFmpegInput::get_hw_format(AVCodecContext* ctx, const AVPixelFormat* formats)
+{
+    auto self = static_cast<const FFmpegInput*>(ctx->opaque);
+    for (const AVPixelFormat* f = formats; *f != AV_PIX_FMT_NONE; ++f)
+        if (*f == self->m_hw_pix_format)
+            return *f;
+    // The device can't handle this stream after all; decode in software
+    return avcodec_default_get_format(ctx, formats);
+}
+#endif
+
+
+
 #if 0
 const char *
 FFmpegInput::metadata (const char * key)
@@ -662,9 +1055,19 @@ FFmpegInput::has_metadata (const char * key)
 bool
 FFmpegInput::seek(int frame)
 {
-    int64_t offset = time_stamp(frame);
-    int flags      = AVSEEK_FLAG_BACKWARD;
+    int flags = AVSEEK_FLAG_BACKWARD;
     avcodec_flush_buffers(m_codec_context);
+    if (m_index) {
+        // Go to the keyframe preceding the frame, in stream time base
+        const auto& kf = m_index->keyframes;
+        int64_t pts    = m_index->pts[std::min(size_t(std::max(frame, 0)),
+                                            m_index->pts.size() - 1)];
+        auto k         = std::upper_bound(kf.begin(), kf.end(), pts);
+        int64_t offset = (k == kf.begin()) ? kf.front() : *(k - 1);
+        av_seek_frame(m_format_context, m_video_stream, offset, flags);
+        return true;
+    }
+    int64_t offset = time_stamp(frame);
     av_seek_frame(m_format_context, -1, offset, flags);
     return true;
 }
@@ -44,25 +44,30 @@ public:
     virtual int supports(string_view feature) const override
     {
         return (feature == "arbitrary_metadata"
-                || feature == "exif"    // Because of arbitrary_metadata
-                || feature == "iptc");  // Because of arbitrary_metadata
+                || feature == "exif"  // Because of arbitrary_metadata
+                || feature == "iptc"  // Because of arbitrary_metadata
+                || feature == "ioproxy");
     }
     virtual bool valid_file(const std::string& filename) const override;
     virtual bool open(const std::string& name, ImageSpec& spec) override;
+    virtual bool open(const std::string& name, ImageSpec& spec,
+                      const ImageSpec& config) override;
     virtual bool close(void) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
     virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual int current_subimage() const override { return m_cur_subimage; }
 
 private:
-    FILE* m_fd;
     std::string m_filename;
     int m_cur_subimage;
     int m_bitpix;              // number of bits that represents data value;
     int m_naxes;               // number of axes of the image (e.g dimensions)
     std::vector<int> m_naxis;  // axis sizes of each dimension
-    fpos_t m_filepos;          // current position in the file
+    int64_t m_datapos;         // file offset of the current subimage's data
+    std::vector<unsigned char> m_buf;  // raw scanlines, if they can't be viewed
     // here we store informations how many times COMMENT, HISTORY, HIERARCH
     // keywords have occurred
     std::map<std::string, int> keys;
@@ -76,11 +81,12 @@ private:
 
     void init(void)
     {
-        m_fd = NULL;
         m_filename.clear();
         m_cur_subimage = 0;
         m_bitpix       = 0;
         m_naxes        = 0;
+        m_datapos      = 0;
+        m_buf.clear();
         m_subimages.clear();
         m_comment.clear();
         m_history.clear();
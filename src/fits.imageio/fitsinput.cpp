@@ -9,6 +9,7 @@
 #include "fits_pvt.h"
 
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/parallel.h>
 
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -33,6 +34,8 @@ fits_input_imageio_create()
 
 OIIO_EXPORT const char* fits_input_extensions[] = { "fits", nullptr };
 
+OIIO_EXPORT const char* fits_input_signatures[] = { "53494d504c45", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -53,6 +56,16 @@ FitsInput::valid_file(const std::string& filename) const
 
 
 
+bool
+FitsInput::open(const std::string& name, ImageSpec& spec,
+                const ImageSpec& config)
+{
+    ioproxy_retrieve_from_config(config);
+    return open(name, spec);
+}
+
+
+
 bool
 FitsInput::open(const std::string& name, ImageSpec& spec)
 {
@@ -60,26 +73,18 @@ FitsInput::open(const std::string& name, ImageSpec& spec)
     m_filename = name;
 
     // checking if the file exists and can be opened in READ mode
-    m_fd = Filesystem::fopen(m_filename, "rb");
-    if (!m_fd) {
-        errorf("Could not open file \"%s\"", m_filename);
+    if (!ioproxy_use_or_open(name))
         return false;
-    }
 
     // checking if the file is FITS file
     char magic[6] = { 0 };
-    if (fread(magic, 1, 6, m_fd) != 6) {
-        errorf("%s isn't a FITS file", m_filename);
-        return false;  // Read failed
-    }
-
-    if (strncmp(magic, "SIMPLE", 6)) {
+    if (ioproxy()->pread(magic, 6, 0) != 6 || strncmp(magic, "SIMPLE", 6)) {
         errorf("%s isn't a FITS file", m_filename);
         close();
         return false;
     }
     // moving back to the start of the file
-    fseek(m_fd, 0, SEEK_SET);
+    ioseek(0);
 
     subimage_search();
 
@@ -93,8 +98,17 @@ FitsInput::open(const std::string& name, ImageSpec& spec)
 
 
 bool
-FitsInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+FitsInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                 void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+FitsInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                 int yend, int /*z*/, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
@@ -103,44 +117,52 @@ FitsInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     // we return true just to support 0x0 images
     if (!m_naxes)
         return true;
+    if (ybegin < 0 || yend > m_spec.height || ybegin >= yend)
+        return false;
 
-    std::vector<unsigned char> data_tmp(m_spec.scanline_bytes());
-    long scanline_off = (m_spec.height - y) * m_spec.scanline_bytes();
-    fseek(m_fd, scanline_off, SEEK_CUR);
-    size_t n = fread(&data_tmp[0], 1, m_spec.scanline_bytes(), m_fd);
-    if (n != m_spec.scanline_bytes()) {
-        if (feof(m_fd))
-            errorf("Hit end of file unexpectedly (offset=%d, scanline %d)",
-                   ftell(m_fd), y);
-        else
-            errorf("read error");
-        return false;  // Read failed
+    // Scanlines are stored bottom-up at fixed offsets from the start of the
+    // data, so the requested ones are one contiguous run of the file, last
+    // scanline first. Use it in place if the proxy can show it to us (for
+    // example, if the file is memory mapped), otherwise read it.
+    size_t sbytes  = m_spec.scanline_bytes();
+    size_t size    = size_t(yend - ybegin) * sbytes;
+    int64_t offset = m_datapos + int64_t(m_spec.height - (yend - 1)) * sbytes;
+    cspan<unsigned char> view = ioproxy()->view(offset, size);
+    const unsigned char* raw  = view.data();
+    if (size_t(view.size()) != size) {
+        m_buf.resize(size);
+        if (ioproxy()->pread(m_buf.data(), size, offset) != size) {
+            errorf("Hit end of file unexpectedly (offset=%d, scanlines %d-%d)",
+                   offset, ybegin, yend - 1);
+            return false;  // Read failed
+        }
+        raw = m_buf.data();
     }
 
     // in FITS image data is stored in big-endian so we have to switch to
     // little-endian on little-endian machines
-    if (littleendian()) {
-        if (m_spec.format == TypeDesc::USHORT
-            || m_spec.format == TypeDesc::SHORT)
-            swap_endian((unsigned short*)&data_tmp[0],
-                        data_tmp.size() / sizeof(unsigned short));
-        else if (m_spec.format == TypeDesc::UINT
-                 || m_spec.format == TypeDesc::INT)
-            swap_endian((unsigned int*)&data_tmp[0],
-                        data_tmp.size() / sizeof(unsigned int));
-        else if (m_spec.format == TypeDesc::FLOAT)
-            swap_endian((float*)&data_tmp[0], data_tmp.size() / sizeof(float));
-        else if (m_spec.format == TypeDesc::DOUBLE)
-            swap_endian((double*)&data_tmp[0],
-                        data_tmp.size() / sizeof(double));
-    }
-
-    memcpy(data, &data_tmp[0], data_tmp.size());
-
-    // after reading scanline we set file pointer to the start of image data
-    fsetpos(m_fd, &m_filepos);
+    size_t typesize = m_spec.format.size();
+    bool swap       = littleendian() && typesize > 1;
+    size_t nvals    = sbytes / typesize;
+    parallel_for_chunked(
+        ybegin, yend, 0,
+        [&](int64_t b, int64_t e) {
+            for (int64_t y = b; y < e; ++y) {
+                auto dst = (unsigned char*)data + (y - ybegin) * sbytes;
+                memcpy(dst, raw + (yend - 1 - y) * sbytes, sbytes);
+                if (!swap)
+                    continue;
+                if (typesize == 2)
+                    swap_endian((uint16_t*)dst, nvals);
+                else if (typesize == 4)
+                    swap_endian((uint32_t*)dst, nvals);
+                else if (typesize == 8)
+                    swap_endian((uint64_t*)dst, nvals);
+            }
+        },
+        parallel_options(threads(), Split_Y, 1));
     return true;
-};
+}
 
 
 
@@ -158,7 +180,7 @@ FitsInput::seek_subimage(int subimage, int miplevel)
 
     // setting file pointer to the beginning of IMAGE extension
     m_cur_subimage = subimage;
-    fseek(m_fd, m_subimages[m_cur_subimage].offset, SEEK_SET);
+    ioseek(m_subimages[m_cur_subimage].offset);
 
     if (!set_spec_info())
         return false;
@@ -183,8 +205,8 @@ FitsInput::set_spec_info()
 
     // now we can get the current position in the file
     // this is the start of the image data
-    // we will need it in the read_native_scanline method
-    fgetpos(m_fd, &m_filepos);
+    // we will need it in the read_native_scanlines method
+    m_datapos = iotell();
 
     if (m_bitpix == 8)
         m_spec.set_format(TypeDesc::UCHAR);
@@ -204,9 +226,8 @@ FitsInput::set_spec_info()
 bool
 FitsInput::close(void)
 {
-    if (m_fd)
-        fclose(m_fd);
     init();
+    ioproxy_clear();
     return true;
 }
 
@@ -218,13 +239,8 @@ FitsInput::read_fits_header(void)
     std::string fits_header(HEADER_SIZE, 0);
 
     // we read whole header at once
-    if (fread(&fits_header[0], 1, HEADER_SIZE, m_fd) != HEADER_SIZE) {
-        if (feof(m_fd))
-            errorf("Hit end of file unexpectedly (offset=%d)", ftell(m_fd));
-        else
-            errorf("read error");
+    if (!ioread(&fits_header[0], HEADER_SIZE))
         return false;  // Read failed
-    }
 
     bool found_end = false;
     for (int i = 0; i < CARDS_PER_HEADER; ++i) {
@@ -385,19 +401,12 @@ FitsInput::add_to_spec(const std::string& keyname, const std::string& value)
 void
 FitsInput::subimage_search()
 {
-    // saving position of the file, just for safe)
-    fpos_t fpos;
-    fgetpos(m_fd, &fpos);
-
-    // starting reading headers from the beginning of the file
-    fseek(m_fd, 0, SEEK_SET);
-
     // we search for subimages by reading whole header and checking if it
     // starts by "SIMPLE" keyword (primary header is always image header)
     // or by "XTENSION= 'IMAGE   '" (it is image extensions)
     std::string hdu(HEADER_SIZE, 0);
     size_t offset = 0;
-    while (fread(&hdu[0], 1, HEADER_SIZE, m_fd) == HEADER_SIZE) {
+    while (ioproxy()->pread(&hdu[0], HEADER_SIZE, offset) == HEADER_SIZE) {
         if (!strncmp(&hdu[0], "SIMPLE", 6)
             || !strncmp(&hdu[0], "XTENSION= 'IMAGE   '", 20)) {
             fits_pvt::Subimage newSub;
@@ -407,7 +416,6 @@ FitsInput::subimage_search()
         }
         offset += HEADER_SIZE;
     }
-    fsetpos(m_fd, &fpos);
 }
 
 
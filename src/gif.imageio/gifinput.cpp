@@ -3,6 +3,7 @@
 // https://github.com/OpenImageIO/oiio
 
 #include <fcntl.h>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -77,6 +78,17 @@ private:
                                           ///  which subimages are sequentially
                                           ///  drawn.
 
+    /// Where each frame starts in the file, and how it leaves the canvas
+    /// for the next one. Built once by build_index() on first open.
+    struct FrameInfo {
+        int64_t offset;  ///< File position of the frame's first record
+        int disposal;    ///< Disposal method of the frame
+    };
+    std::vector<FrameInfo> m_frames;  ///< Frame index
+    int m_snapshot_interval = 0;      ///< Frames between canvas snapshots
+    /// Composited canvas after every m_snapshot_interval'th frame
+    std::map<int, std::vector<unsigned char>> m_snapshots;
+
     /// Reset everything to initial state
     ///
     void init(void);
@@ -93,6 +105,15 @@ private:
     ///
     void read_gif_extension(int ext_code, GifByteType* ext, ImageSpec& spec);
 
+    /// Scan the whole file once, recording the offset and disposal method
+    /// of every frame without decompressing any pixels.
+    ///
+    void build_index(void);
+
+    /// Remember the canvas if the current subimage is due a snapshot.
+    ///
+    void keep_snapshot(void);
+
     /// Decode and return a real scanline index in the interlaced image.
     ///
     int decode_line_number(int line_number, int height);
@@ -129,6 +150,10 @@ gif_input_imageio_create()
 }
 OIIO_EXPORT const char* gif_input_extensions[] = { "gif", NULL };
 
+OIIO_EXPORT const char* gif_input_signatures[] = {
+    "474946383761", "474946383961", nullptr
+};
+
 OIIO_EXPORT const char*
 gif_imageio_library_version()
 {
@@ -150,6 +175,9 @@ void
 GIFInput::init(void)
 {
     m_gif_file = nullptr;
+    m_frames.clear();
+    m_snapshots.clear();
+    m_snapshot_interval = 0;
     ioproxy_clear();
 }
 
@@ -320,11 +348,78 @@ GIFInput::read_subimage_metadata(ImageSpec& newspec)
 
     newspec.attribute("gif:Interlacing", m_gif_file->Image.Interlace ? 1 : 0);
 
+    newspec.width       = m_gif_file->SWidth;
+    newspec.height      = m_gif_file->SHeight;
+    newspec.depth       = 1;
+    newspec.full_height = newspec.height;
+    newspec.full_width  = newspec.width;
+    newspec.full_depth  = newspec.depth;
+
     return true;
 }
 
 
 
+void
+GIFInput::build_index(void)
+{
+    m_frames.clear();
+    m_snapshots.clear();
+    int64_t start = iotell();
+    int disposal  = DISPOSAL_UNSPECIFIED;
+    int64_t frame = start;  // where the records of the next frame begin
+    bool ok       = true;
+    GifRecordType rec_type;
+    do {
+        if (DGifGetRecordType(m_gif_file, &rec_type) == GIF_ERROR) {
+            ok = false;
+            break;
+        }
+        if (rec_type == IMAGE_DESC_RECORD_TYPE) {
+            // Skip over the compressed pixels without decoding them
+            int code_size;
+            GifByteType* block = nullptr;
+            ok = DGifGetImageDesc(m_gif_file) != GIF_ERROR
+                 && DGifGetCode(m_gif_file, &code_size, &block) != GIF_ERROR;
+            while (ok && block)
+                ok = DGifGetCodeNext(m_gif_file, &block) != GIF_ERROR;
+            if (!ok)
+                break;
+            m_frames.push_back({ frame, disposal });
+            disposal = DISPOSAL_UNSPECIFIED;
+            frame    = iotell();
+        } else if (rec_type == EXTENSION_RECORD_TYPE) {
+            int ext_code;
+            GifByteType* ext = nullptr;
+            ok = DGifGetExtension(m_gif_file, &ext_code, &ext) != GIF_ERROR;
+            while (ok && ext) {
+                if (ext_code == GRAPHICS_EXT_FUNC_CODE && ext[0] >= 4)
+                    disposal = (ext[1] & 0x1c) >> 2;
+                ok = DGifGetExtensionNext(m_gif_file, &ext) != GIF_ERROR;
+            }
+            if (!ok)
+                break;
+        }
+    } while (rec_type != TERMINATE_RECORD_TYPE);
+
+    if (!ok) {
+        // A damaged or truncated file: keep the frames we could index and
+        // let the sequential reader report the problem if it's reached.
+        (void)geterror();
+    }
+
+    // Keep the snapshots within a fixed memory budget, however long the
+    // animation, but don't bother snapshotting very often.
+    const size_t budget = size_t(64) << 20;
+    size_t canvasbytes  = std::max(m_canvas.size(), size_t(1));
+    size_t maxsnaps     = std::max(budget / canvasbytes, size_t(1));
+    m_snapshot_interval = std::max(8, int((m_frames.size() + maxsnaps - 1)
+                                          / maxsnaps));
+    ioseek(start);
+}
+
+
+
 bool
 GIFInput::read_subimage_data()
 {
@@ -390,9 +485,9 @@ GIFInput::seek_subimage(int subimage, int miplevel)
         return true;
     }
 
-    if (m_subimage > subimage) {
-        // requested subimage is located before the current one
-        // file needs to be reopened
+    if (m_subimage > subimage && m_frames.empty()) {
+        // requested subimage is located before the current one and we
+        // have no index, so the file needs to be reopened
         if (m_gif_file && !close()) {
             return false;
         }
@@ -417,6 +512,30 @@ GIFInput::seek_subimage(int subimage, int miplevel)
 #endif
         m_subimage = -1;
         m_canvas.resize(m_gif_file->SWidth * m_gif_file->SHeight * 4);
+        build_index();
+    }
+
+    if (subimage < int(m_frames.size())) {
+        // Find the closest place to resume decoding from: the frame we're
+        // already on, the last frame that doesn't depend on its
+        // predecessors (because they were disposed to background), or the
+        // last composited snapshot. `resume` is the frame already on the
+        // canvas, -1 for none.
+        int resume = subimage - 1;
+        while (resume >= 0 && resume != m_subimage
+               && m_frames[resume].disposal != DISPOSE_BACKGROUND
+               && !m_snapshots.count(resume))
+            --resume;
+        if (resume != m_subimage) {
+            if (resume >= 0 && resume != m_subimage
+                && m_frames[resume].disposal != DISPOSE_BACKGROUND)
+                m_canvas = m_snapshots[resume];
+            m_subimage        = resume;
+            m_disposal_method = resume >= 0 ? m_frames[resume].disposal
+                                            : DISPOSAL_UNSPECIFIED;
+            if (!ioseek(m_frames[resume + 1].offset))
+                return false;
+        }
     }
 
     // skip subimages preceding the requested one
@@ -425,6 +544,7 @@ GIFInput::seek_subimage(int subimage, int miplevel)
             if (!read_subimage_metadata(m_spec) || !read_subimage_data()) {
                 return false;
             }
+            keep_snapshot();
         }
     }
 
@@ -433,25 +553,30 @@ GIFInput::seek_subimage(int subimage, int miplevel)
         return false;
     }
 
-    m_spec.width       = m_gif_file->SWidth;
-    m_spec.height      = m_gif_file->SHeight;
-    m_spec.depth       = 1;
-    m_spec.full_height = m_spec.height;
-    m_spec.full_width  = m_spec.width;
-    m_spec.full_depth  = m_spec.depth;
-
     m_subimage = subimage;
 
     // draw subimage on canvas
     if (!read_subimage_data()) {
         return false;
     }
+    keep_snapshot();
 
     return true;
 }
 
 
 
+void
+GIFInput::keep_snapshot(void)
+{
+    if (m_snapshot_interval && m_subimage > 0
+        && m_subimage % m_snapshot_interval == 0
+        && m_subimage < int(m_frames.size()) && !m_snapshots.count(m_subimage))
+        m_snapshots[m_subimage] = m_canvas;
+}
+
+
+
 static spin_mutex gif_error_mutex;
 
 
@@ -493,6 +618,8 @@ GIFInput::close(void)
         m_gif_file = nullptr;
     }
     m_canvas.clear();
+    m_frames.clear();
+    m_snapshots.clear();
     ioproxy_clear();
     return ok;
 }
@@ -0,0 +1,177 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/simd.h>
+
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+// RGBE <-> float conversion shared by the HDR reader and writer. The
+// vectorized versions build the power of two for the shared exponent
+// directly from float exponent bits, four pixels at a time, and give
+// exactly the same results as the ldexp/frexp formulation.
+namespace HDR_pvt {
+
+/* standard conversion from rgbe to float pixels */
+/* note: Ward uses ldexp(col+0.5,exp-(128+8)).  However we wanted pixels */
+/*       in the range [0,1] to map back into the range [0,1].            */
+inline void
+rgbe2float(float& red, float& green, float& blue, const unsigned char rgbe[4])
+{
+    if (rgbe[3]) { /*nonzero pixel*/
+        float f = ldexpf(1.0f, rgbe[3] - (int)(128 + 8));
+        red     = rgbe[0] * f;
+        green   = rgbe[1] * f;
+        blue    = rgbe[2] * f;
+    } else {
+        red = green = blue = 0.0f;
+    }
+}
+
+
+
+// convert float[3] to rgbe-encoded pixels
+inline void
+float2rgbe(unsigned char* rgbe, float red, float green, float blue)
+{
+    float v = red;
+    if (green > v)
+        v = green;
+    if (blue > v)
+        v = blue;
+    if (v < 1e-32) {
+        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
+    } else {
+        int e;
+        v       = frexpf(v, &e) * 256.0f / v;
+        rgbe[0] = (unsigned char)(red * v);
+        rgbe[1] = (unsigned char)(green * v);
+        rgbe[2] = (unsigned char)(blue * v);
+        rgbe[3] = (unsigned char)(e + 128);
+    }
+}
+
+
+
+/// Convert `n` RGBE pixels to 3*n floats. The bytes of pixel i are
+/// `r[i*stride]`, `g[i*stride]`, `b[i*stride]` and `e[i*stride]`, so the
+/// stride is 4 for interleaved pixels and 1 for the planar scanlines of
+/// run length encoded files.
+inline void
+rgbe_to_float(const uint8_t* r, const uint8_t* g, const uint8_t* b,
+              const uint8_t* e, int stride, float* dst, size_t n)
+{
+    using namespace simd;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, dst += 12) {
+        const size_t s0 = i * stride, s1 = s0 + stride, s2 = s1 + stride,
+                     s3 = s2 + stride;
+        vint4 ex(e[s0], e[s1], e[s2], e[s3]);
+        if (any((ex > vint4(0)) & (ex < vint4(10)))) {
+            // 2^(e-136) is a denormal for the smallest exponents, leave
+            // those rare pixels to ldexpf.
+            for (size_t j = 0; j < 4; ++j) {
+                const size_t s            = s0 + j * stride;
+                const unsigned char px[4] = { r[s], g[s], b[s], e[s] };
+                rgbe2float(dst[3 * j], dst[3 * j + 1], dst[3 * j + 2], px);
+            }
+            continue;
+        }
+        // 2^(e-136) assembled as float bits, zero for a zero exponent
+        vfloat4 scale = blend0(bitcast_to_float((ex - vint4(9)) << 23),
+                               ex != vint4::Zero());
+        vfloat4 R = vfloat4(vint4(r[s0], r[s1], r[s2], r[s3])) * scale;
+        vfloat4 G = vfloat4(vint4(g[s0], g[s1], g[s2], g[s3])) * scale;
+        vfloat4 B = vfloat4(vint4(b[s0], b[s1], b[s2], b[s3])) * scale;
+        vfloat4 A = vfloat4::Zero();
+        transpose(R, G, B, A);
+        R.store(dst, 3);
+        G.store(dst + 3, 3);
+        B.store(dst + 6, 3);
+        A.store(dst + 9, 3);
+    }
+    for (; i < n; ++i, dst += 3) {
+        const size_t s            = i * stride;
+        const unsigned char px[4] = { r[s], g[s], b[s], e[s] };
+        rgbe2float(dst[0], dst[1], dst[2], px);
+    }
+}
+
+
+
+/// Convert 3*n floats to `n` RGBE pixels, with the same byte layout
+/// conventions as rgbe_to_float().
+inline void
+float_to_rgbe(const float* src, uint8_t* r, uint8_t* g, uint8_t* b,
+              uint8_t* e, int stride, size_t n)
+{
+    using namespace simd;
+    // float2rgbe compares against the double 1e-32; this is the smallest
+    // float that doesn't compare less than it.
+    float tiny = float(1e-32);
+    if (double(tiny) < 1e-32)
+        tiny = std::nextafter(tiny, 1.0f);
+    const vfloat4 big(std::numeric_limits<float>::max());
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4, src += 12) {
+        vfloat4 R, G, B, A;
+        R.load(src, 3);
+        G.load(src + 3, 3);
+        B.load(src + 6, 3);
+        A.load(src + 9, 3);
+        transpose(R, G, B, A);
+        if (!all((R >= vfloat4::Zero()) & (R <= big) & (G >= vfloat4::Zero())
+                 & (G <= big) & (B >= vfloat4::Zero()) & (B <= big))) {
+            // Negative, infinite or NaN values take the scalar path
+            for (size_t j = 0; j < 4; ++j) {
+                unsigned char px[4];
+                float2rgbe(px, src[3 * j], src[3 * j + 1], src[3 * j + 2]);
+                const size_t s = (i + j) * stride;
+                r[s]           = px[0];
+                g[s]           = px[1];
+                b[s]           = px[2];
+                e[s]           = px[3];
+            }
+            continue;
+        }
+        vfloat4 v      = max(max(R, G), B);
+        vbool4 nonzero = v >= vfloat4(tiny);
+        vint4 biased   = srl(bitcast_to_int(v), 23);  // sign bit is clear
+        // frexp gives v = m * 2^x with x = biased-126, and we scale by
+        // 256 / 2^x, which is another power of two.
+        vfloat4 scale = bitcast_to_float((vint4(126 + 8 + 127) - biased) << 23);
+        OIIO_SIMD4_ALIGN int c[4][4];
+        blend0(vint4(R * scale), nonzero).store(c[0]);
+        blend0(vint4(G * scale), nonzero).store(c[1]);
+        blend0(vint4(B * scale), nonzero).store(c[2]);
+        blend0(biased + vint4(2), nonzero).store(c[3]);
+        for (size_t j = 0; j < 4; ++j) {
+            const size_t s = (i + j) * stride;
+            r[s]           = uint8_t(c[0][j]);
+            g[s]           = uint8_t(c[1][j]);
+            b[s]           = uint8_t(c[2][j]);
+            e[s]           = uint8_t(c[3][j]);
+        }
+    }
+    for (; i < n; ++i, src += 3) {
+        unsigned char px[4];
+        float2rgbe(px, src[0], src[1], src[2]);
+        const size_t s = i * stride;
+        r[s]           = px[0];
+        g[s]           = px[1];
+        b[s]           = px[2];
+        e[s]           = px[3];
+    }
+}
+
+}  // namespace HDR_pvt
+
+OIIO_PLUGIN_NAMESPACE_END
@@ -9,10 +9,15 @@
 
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
+
+#include "hdr_pvt.h"
 
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
+using namespace HDR_pvt;
+
 /////////////////////////////////////////////////////////////////////////////
 // .hdr / .rgbe files - HDR files from Radiance
 //
@@ -46,6 +51,8 @@ public:
                       const ImageSpec& config) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
     virtual bool close() override;
     virtual int current_subimage(void) const override { return m_subimage; }
     virtual bool seek_subimage(int subimage, int miplevel) override;
@@ -53,22 +60,23 @@ public:
 private:
     std::string m_filename;  // File name
     int m_subimage;          // What subimage are we looking at?
-    int m_next_scanline;     // Next scanline to read
     std::vector<int64_t> m_scanline_offsets;  // Cached scanline offsets
     int64_t m_io_pos = 0;                     // current position
 
     void init()
     {
-        m_subimage      = -1;
-        m_next_scanline = 0;
+        m_subimage = -1;
         m_scanline_offsets.clear();
         ioproxy_clear();
     }
 
     bool RGBE_ReadHeader();
-    bool RGBE_ReadPixels(float* data, int y, uint64_t numpixels);
-    bool RGBE_ReadPixels_RLE(float* data, int y, int scanline_width,
-                             int num_scanlines);
+
+    // Return the size in bytes of the encoded scanline y at the start of
+    // `buf`, found by walking its run length structure without decoding
+    // any pixels. Returns 0 (after reporting an error) if the scanline is
+    // corrupt or truncated.
+    size_t scanline_length(cspan<unsigned char> buf, int y);
 
     // helper: fgets reads a "line" from the proxy, akin to std fgets. The
     // bytes go in the buffer, and part up to and including the new line is
@@ -112,25 +120,11 @@ hdr_input_imageio_create()
 
 OIIO_EXPORT const char* hdr_input_extensions[] = { "hdr", "rgbe", nullptr };
 
-OIIO_PLUGIN_EXPORTS_END
-
-
+OIIO_EXPORT const char* hdr_input_signatures[] = {
+    "233f52414449414e4345", "233f52474245", nullptr
+};
 
-/* standard conversion from rgbe to float pixels */
-/* note: Ward uses ldexp(col+0.5,exp-(128+8)).  However we wanted pixels */
-/*       in the range [0,1] to map back into the range [0,1].            */
-inline void
-rgbe2float(float& red, float& green, float& blue, unsigned char rgbe[4])
-{
-    if (rgbe[3]) { /*nonzero pixel*/
-        float f = ldexpf(1.0f, rgbe[3] - (int)(128 + 8));
-        red     = rgbe[0] * f;
-        green   = rgbe[1] * f;
-        blue    = rgbe[2] * f;
-    } else {
-        red = green = blue = 0.0f;
-    }
-}
+OIIO_PLUGIN_EXPORTS_END
 
 
 
@@ -169,7 +163,6 @@ HdrInput::open(const std::string& name, ImageSpec& newspec)
     // FIXME -- should we do anything about exposure, software,
     // pixaspect, primaries?  (N.B. rgbe.c doesn't even handle most of them)
 
-    m_next_scanline = 0;
     m_scanline_offsets.clear();
     m_scanline_offsets.push_back(m_io_pos);
 
@@ -296,138 +289,156 @@ HdrInput::RGBE_ReadHeader()
 
 
 
-/* simple read routine.  will not correctly handle run length encoding */
-bool
-HdrInput::RGBE_ReadPixels(float* data, int y, uint64_t numpixels)
+size_t
+HdrInput::scanline_length(cspan<unsigned char> buf, int y)
 {
-    size_t size = 4 * numpixels;
-    unsigned char* rgbe;
-    OIIO_ALLOCATE_STACK_OR_HEAP(rgbe, unsigned char, size);
-    if (ioproxy()->pread(rgbe, size, m_io_pos) != size) {
-        errorfmt("Read error reading pixels on scanline {}", y);
-        return false;
+    const int width = m_spec.width;
+    size_t flat     = 4 * size_t(width);
+    size_t avail    = size_t(buf.size());
+    if (width < 8 || width > 0x7fff || avail < 4 || buf[0] != 2
+        || buf[1] != 2 || (buf[2] & 0x80)) {
+        // Not run length encoded, just 4 bytes per pixel
+        if (avail < flat) {
+            errorfmt("Read error on scanline {}", y);
+            return 0;
+        }
+        return flat;
     }
-    m_io_pos += size;
-    for (uint64_t i = 0; i < numpixels; ++i)
-        rgbe2float(data[3 * i], data[3 * i + 1], data[3 * i + 2], &rgbe[4 * i]);
-    return true;
+    if ((int(buf[2]) << 8 | buf[3]) != width) {
+        errorfmt("wrong scanline width for scanline {}", y);
+        return 0;
+    }
+    // Each of the four channels is encoded separately, as a sequence of
+    // runs (a count byte > 128 followed by the value) and non-runs (a
+    // count byte followed by that many values).
+    size_t pos = 4;
+    for (int c = 0; c < 4; ++c) {
+        for (int x = 0; x < width;) {
+            if (pos + 2 > avail) {
+                errorfmt("Read error on scanline {}", y);
+                return 0;
+            }
+            int count = buf[pos] > 128 ? buf[pos] - 128 : buf[pos];
+            if (count == 0 || count > width - x) {
+                errorfmt("bad scanline {} data", y);
+                return 0;
+            }
+            pos += buf[pos] > 128 ? 2 : 1 + count;
+            x += count;
+        }
+    }
+    if (pos > avail) {
+        errorfmt("Read error on scanline {}", y);
+        return 0;
+    }
+    return pos;
 }
 
 
 
-bool
-HdrInput::RGBE_ReadPixels_RLE(float* data, int y, int scanline_width,
-                              int num_scanlines)
+// Decode one scanline whose encoding (already checked by scanline_length)
+// is at `src`, into 3*width floats. `planes` is scratch space for the
+// 4*width bytes of an RLE scanline.
+static void
+decode_scanline(const unsigned char* src, int width, float* data,
+                unsigned char* planes)
 {
-    if ((scanline_width < 8) || (scanline_width > 0x7fff))
-        /* run length encoding is not allowed so read flat*/
-        return RGBE_ReadPixels(data, y, scanline_width * num_scanlines);
-
-    unsigned char rgbe[4], *ptr, *ptr_end;
-    int i, count;
-    unsigned char buf[2];
-    std::vector<unsigned char> scanline_buffer;
-    Filesystem::IOProxy* m_io = ioproxy();
-
-    /* read in each successive scanline */
-    while (num_scanlines > 0) {
-        if (m_io->pread(rgbe, sizeof(rgbe), m_io_pos) < sizeof(rgbe)) {
-            errorfmt("Read error on scanline {}", y);
-            return false;
-        }
-        m_io_pos += sizeof(rgbe);
-        if ((rgbe[0] != 2) || (rgbe[1] != 2) || (rgbe[2] & 0x80)) {
-            /* this file is not run length encoded */
-            rgbe2float(data[0], data[1], data[2], rgbe);
-            data += 3;
-            return RGBE_ReadPixels(data, y, scanline_width * num_scanlines - 1);
-        }
-        if ((((int)rgbe[2]) << 8 | rgbe[3]) != scanline_width) {
-            errorfmt("wrong scanline width for scanline {}", y);
-            return false;
-        }
-        scanline_buffer.resize(4 * scanline_width);
-
-        ptr = &scanline_buffer[0];
-        /* read each of the four channels for the scanline into the buffer */
-        for (i = 0; i < 4; i++) {
-            ptr_end = &scanline_buffer[(i + 1) * scanline_width];
-            while (ptr < ptr_end) {
-                if (m_io->pread(buf, 2, m_io_pos) < 2) {
-                    errorfmt("Read error on scanline {}", y);
-                    return false;
-                }
-                m_io_pos += 2;
-                if (buf[0] > 128) {
-                    /* a run of the same value */
-                    count = buf[0] - 128;
-                    if ((count == 0) || (count > ptr_end - ptr)) {
-                        errorfmt("bad scanline {} data", y);
-                        return false;
-                    }
-                    while (count-- > 0)
-                        *ptr++ = buf[1];
-                } else {
-                    /* a non-run */
-                    count = buf[0];
-                    if ((count == 0) || (count > ptr_end - ptr)) {
-                        errorfmt("bad scanline {} data", y);
-                        return false;
-                    }
-                    *ptr++ = buf[1];
-                    if (--count > 0) {
-                        if (m_io->pread(ptr, count, m_io_pos)
-                            < uint64_t(count)) {
-                            errorfmt("Read error on scanline {}", y);
-                            return false;
-                        }
-                        m_io_pos += count;
-                        ptr += count;
-                    }
-                }
-            }
-        }
-        /* now convert data from buffer into floats */
-        for (i = 0; i < scanline_width; i++) {
-            rgbe[0] = scanline_buffer[i];
-            rgbe[1] = scanline_buffer[i + scanline_width];
-            rgbe[2] = scanline_buffer[i + 2 * scanline_width];
-            rgbe[3] = scanline_buffer[i + 3 * scanline_width];
-            rgbe2float(data[0], data[1], data[2], rgbe);
-            data += 3;
+    if (width < 8 || width > 0x7fff || src[0] != 2 || src[1] != 2
+        || (src[2] & 0x80)) {
+        // Not run length encoded
+        rgbe_to_float(src, src + 1, src + 2, src + 3, 4, data, width);
+        return;
+    }
+    src += 4;
+    unsigned char* ptr = planes;
+    for (unsigned char* end = planes + 4 * width; ptr < end;) {
+        if (src[0] > 128) {
+            /* a run of the same value */
+            memset(ptr, src[1], src[0] - 128);
+            ptr += src[0] - 128;
+            src += 2;
+        } else {
+            /* a non-run */
+            memcpy(ptr, src + 1, src[0]);
+            ptr += src[0];
+            src += 1 + src[0];
         }
-        num_scanlines--;
     }
-    return true;
+    rgbe_to_float(planes, planes + width, planes + 2 * width,
+                  planes + 3 * width, 1, data, width);
 }
 
 
 
 bool
-HdrInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+HdrInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+HdrInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int /*z*/, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
+    if (ybegin < 0 || yend > m_spec.height || ybegin > yend) {
+        errorfmt("Invalid scanline range {}-{}", ybegin, yend - 1);
+        return false;
+    }
+    if (ybegin == yend)
+        return true;
 
-    if (m_next_scanline != y) {
-        // For random access, use cached file offsets of scanlines. This avoids
-        // re-reading the same pixels many times over.
-        m_next_scanline = std::min((size_t)y, m_scanline_offsets.size() - 1);
-        m_io_pos        = m_scanline_offsets[m_next_scanline];
+    // Grab all the encoded bytes from the last scanline whose position we
+    // know, up to the most that the requested scanlines could occupy (an
+    // RLE scanline is at worst 2 bytes per channel per pixel). Use the
+    // proxy's memory directly if it has any to show us.
+    Filesystem::IOProxy* io = ioproxy();
+    const int width         = m_spec.width;
+
+    int first     = std::min(ybegin, int(m_scanline_offsets.size()) - 1);
+    int64_t start = m_scanline_offsets[first];
+    int64_t avail = std::max(int64_t(io->size()) - start, int64_t(0));
+    size_t size   = std::min((4 + 8 * size_t(width)) * size_t(yend - first),
+                             size_t(avail));
+    cspan<unsigned char> buf = io->view(start, size);
+    std::unique_ptr<unsigned char[]> readbuf;
+    if (size_t(buf.size()) != size) {
+        readbuf.reset(new unsigned char[size]);
+        size = io->pread(readbuf.get(), size, start);
+        buf  = cspan<unsigned char>(readbuf.get(), size);
     }
 
-    while (m_next_scanline <= y) {
-        // Keep reading until we've read the scanline we really need
-        bool ok = RGBE_ReadPixels_RLE((float*)data, y, m_spec.width, 1);
-        ++m_next_scanline;
-        if ((size_t)m_next_scanline == m_scanline_offsets.size()) {
-            m_scanline_offsets.push_back(m_io_pos);
-        }
-        if (!ok)
+    // Quick index pass to find where each scanline starts, caching the
+    // offsets for later random access.
+    std::vector<size_t> offsets(yend - first + 1, 0);
+    for (int y = first; y < yend; ++y) {
+        size_t pos = offsets[y - first];
+        size_t len = scanline_length(buf.subspan(pos), y);
+        if (!len)
             return false;
+        offsets[y - first + 1] = pos + len;
+        if (y + 1 == int(m_scanline_offsets.size()))
+            m_scanline_offsets.push_back(start + pos + len);
     }
+    m_io_pos = start + offsets.back();
+
+    // Now that we know where they all are, decode the scanlines in parallel
+    parallel_for_chunked(
+        ybegin, yend, 0,
+        [&](int64_t yb, int64_t ye) {
+            std::unique_ptr<unsigned char[]> planes(
+                new unsigned char[4 * size_t(width)]);
+            for (int64_t y = yb; y < ye; ++y)
+                decode_scanline(buf.data() + offsets[y - first], width,
+                                (float*)data + (y - ybegin) * 3 * width,
+                                planes.get());
+        },
+        parallel_options(threads(), Split_Y, 1));
     return true;
 }
 
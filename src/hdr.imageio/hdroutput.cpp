@@ -11,8 +11,12 @@
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/strutil.h>
 
+#include "hdr_pvt.h"
+
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
+using namespace HDR_pvt;
+
 class HdrOutput final : public ImageOutput {
 public:
     HdrOutput() { init(); }
@@ -57,36 +61,6 @@ OIIO_EXPORT const char* hdr_output_extensions[] = { "hdr", "rgbe", nullptr };
 OIIO_PLUGIN_EXPORTS_END
 
 
-// convert float[3] to rgbe-encoded pixels
-inline void
-float2rgbe(unsigned char* rgbe, float red, float green, float blue)
-{
-    float v = red;
-    if (green > v)
-        v = green;
-    if (blue > v)
-        v = blue;
-    if (v < 1e-32) {
-        rgbe[0] = rgbe[1] = rgbe[2] = rgbe[3] = 0;
-    } else {
-        int e;
-        v       = frexpf(v, &e) * 256.0f / v;
-        rgbe[0] = (unsigned char)(red * v);
-        rgbe[1] = (unsigned char)(green * v);
-        rgbe[2] = (unsigned char)(blue * v);
-        rgbe[3] = (unsigned char)(e + 128);
-    }
-}
-
-
-inline void
-float2rgbe(unsigned char* rgbe, const float* rgb)
-{
-    return float2rgbe(rgbe, rgb[0], rgb[1], rgb[2]);
-}
-
-
-
 // The code below is only needed for the run-length encoded files.
 // Run length encoding adds considerable complexity but does
 // save some space.  For each scanline, each channel (r,g,b,e) is
@@ -162,14 +136,10 @@ HdrOutput::RGBE_WritePixels_RLE(float* data, int scanline_width,
         rgbe[3] = scanline_width & 0xFF;
         if (!iowrite(rgbe, 4))
             return false;
-        for (int i = 0; i < scanline_width; i++) {
-            float2rgbe(rgbe, data);
-            buffer[i]                      = rgbe[0];
-            buffer[i + scanline_width]     = rgbe[1];
-            buffer[i + 2 * scanline_width] = rgbe[2];
-            buffer[i + 3 * scanline_width] = rgbe[3];
-            data += 3;
-        }
+        float_to_rgbe(data, buffer, buffer + scanline_width,
+                      buffer + 2 * scanline_width, buffer + 3 * scanline_width,
+                      1, scanline_width);
+        data += 3 * scanline_width;
         // write out each of the four channels separately run length encoded
         // first red, then green, then blue, then exponent
         for (int i = 0; i < 4; i++) {
@@ -191,8 +161,7 @@ HdrOutput::RGBE_WritePixels(float* data, int64_t numpixels)
 {
     unsigned char* rgbe;
     OIIO_ALLOCATE_STACK_OR_HEAP(rgbe, unsigned char, 4 * numpixels);
-    for (int64_t i = 0; i < numpixels; ++i)
-        float2rgbe(&rgbe[4 * i], data + 3 * i);
+    float_to_rgbe(data, rgbe, rgbe + 1, rgbe + 2, rgbe + 3, 4, numpixels);
     if (!iowrite(rgbe, 4 * numpixels))
         return false;
     return true;
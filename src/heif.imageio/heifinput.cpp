@@ -2,12 +2,21 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <atomic>
+#include <memory>
+#include <mutex>
+
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/tiffutils.h>
 
 #include <libheif/heif_cxx.h>
 
+// libheif >= 1.19 can decode the cells of a grid image individually
+#define HEIF_HAVE_TILING LIBHEIF_HAVE_VERSION(1, 19, 0)
+
 
 // This plugin utilises libheif:
 //   https://github.com/strukturag/libheif
@@ -27,7 +36,7 @@ public:
     virtual const char* format_name(void) const override { return "heif"; }
     virtual int supports(string_view feature) const override
     {
-        return feature == "exif";
+        return feature == "exif" || feature == "thumbnail";
     }
 #if LIBHEIF_HAVE_VERSION(1, 4, 0)
     virtual bool valid_file(const std::string& filename) const override;
@@ -41,6 +50,14 @@ public:
                                       void* data) override;
     virtual bool read_scanline(int y, int z, TypeDesc format, void* data,
                                stride_t xstride) override;
+#if HEIF_HAVE_TILING
+    virtual bool read_native_tile(int subimage, int miplevel, int x, int y,
+                                  int z, void* data) override;
+    virtual bool read_native_tiles(int subimage, int miplevel, int xbegin,
+                                   int xend, int ybegin, int yend, int zbegin,
+                                   int zend, void* data) override;
+#endif
+    virtual bool get_thumbnail(ImageBuf& thumb, int subimage) override;
 
 private:
     std::string m_filename;
@@ -54,7 +71,17 @@ private:
     heif_item_id m_primary_id;             // id of primary image
     std::vector<heif_item_id> m_item_ids;  // ids of all other images
     heif::ImageHandle m_ihandle;
-    heif::Image m_himage;
+    heif::Image m_himage;           // whole decoded image, made when needed
+    bool m_himage_decoded = false;  // has m_himage been decoded?
+
+    heif_chroma chroma() const
+    {
+        return m_has_alpha ? heif_chroma_interleaved_RGBA
+                           : heif_chroma_interleaved_RGB;
+    }
+#if HEIF_HAVE_TILING
+    bool decode_tile(int tx, int ty, uint8_t* data, std::string& err);
+#endif
 };
 
 
@@ -82,6 +109,13 @@ OIIO_EXPORT const char* heif_input_extensions[] = { "heic", "heif", "heics",
 #endif
                                                     nullptr };
 
+OIIO_EXPORT const char* heif_input_signatures[] = {
+    "@4:6674797068656963", "@4:6674797068656978", "@4:667479706865696d",
+    "@4:6674797068656973", "@4:6674797068657663", "@4:6674797068657678",
+    "@4:667479706d696631", "@4:667479706d736631", "@4:6674797061766966",
+    "@4:6674797061766973", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -160,8 +194,9 @@ HeifInput::open(const std::string& name, ImageSpec& newspec,
 bool
 HeifInput::close()
 {
-    m_himage  = heif::Image();
-    m_ihandle = heif::ImageHandle();
+    m_himage         = heif::Image();
+    m_himage_decoded = false;
+    m_ihandle        = heif::ImageHandle();
     m_ctx.reset();
     m_subimage                = -1;
     m_num_subimages           = 0;
@@ -191,9 +226,9 @@ HeifInput::seek_subimage(int subimage, int miplevel)
         auto id     = (subimage == 0) ? m_primary_id : m_item_ids[subimage - 1];
         m_ihandle   = m_ctx->get_image_handle(id);
         m_has_alpha = m_ihandle.has_alpha_channel();
-        auto chroma = m_has_alpha ? heif_chroma_interleaved_RGBA
-                                  : heif_chroma_interleaved_RGB;
-        m_himage    = m_ihandle.decode_image(heif_colorspace_RGB, chroma);
+        // Pixels are only decoded once they are asked for
+        m_himage         = heif::Image();
+        m_himage_decoded = false;
 
     } catch (const heif::Error& err) {
         std::string e = err.get_message();
@@ -205,16 +240,46 @@ HeifInput::seek_subimage(int subimage, int miplevel)
         return false;
     }
 
-    int bits = m_himage.get_bits_per_pixel(heif_channel_interleaved);
-    m_spec = ImageSpec(m_ihandle.get_width(), m_ihandle.get_height(), bits / 8,
-                       TypeUInt8);
+    // We always ask libheif for interleaved 8 bit RGB or RGBA
+    m_spec = ImageSpec(m_ihandle.get_width(), m_ihandle.get_height(),
+                       m_has_alpha ? 4 : 3, TypeUInt8);
+
+#if HEIF_HAVE_TILING
+    // Grid images (which is how phone cameras store their pictures) are
+    // presented as tiles, one per grid cell, so that each can be decoded
+    // on its own and in parallel with the others.
+    heif_image_tiling tiling;
+    heif_error terr = heif_image_handle_get_image_tiling(
+        m_ihandle.get_raw_image_handle().get(), 1, &tiling);
+    if (terr.code == heif_error_Ok && tiling.num_columns * tiling.num_rows > 1
+        && tiling.top_offset == 0 && tiling.left_offset == 0) {
+        m_spec.tile_width  = int(tiling.tile_width);
+        m_spec.tile_height = int(tiling.tile_height);
+        m_spec.tile_depth  = 1;
+    }
+#endif
 
     m_spec.attribute("oiio:ColorSpace", "sRGB");
 
+    // Advertise the first thumbnail, without decoding it
+    if (m_ihandle.get_number_of_thumbnails() > 0) {
+        try {
+            auto thandle = m_ihandle.get_thumbnail(
+                m_ihandle.get_list_of_thumbnail_IDs()[0]);
+            m_spec.attribute("thumbnail_width", thandle.get_width());
+            m_spec.attribute("thumbnail_height", thandle.get_height());
+            m_spec.attribute("thumbnail_nchannels",
+                             thandle.has_alpha_channel() ? 4 : 3);
+        } catch (const heif::Error&) {
+            // Just don't advertise one
+        }
+    }
+
 #if LIBHEIF_HAVE_VERSION(1, 12, 0)
     // Libheif >= 1.12 added API call to find out if the image is associated
     // alpha (i.e. colors are premultiplied).
-    m_associated_alpha = m_himage.is_premultiplied_alpha();
+    m_associated_alpha = heif_image_handle_is_premultiplied_alpha(
+        m_ihandle.get_raw_image_handle().get());
     m_do_associate     = (!m_associated_alpha && m_spec.alpha_channel >= 0
                       && !m_keep_unassociated_alpha);
     if (!m_associated_alpha && m_spec.nchannels >= 4) {
@@ -289,6 +354,16 @@ HeifInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     if (y < 0 || y >= m_spec.height)  // out of range scanline
         return false;
 
+    if (!m_himage_decoded) {
+        try {
+            m_himage = m_ihandle.decode_image(heif_colorspace_RGB, chroma());
+            m_himage_decoded = true;
+        } catch (const heif::Error& err) {
+            std::string e = err.get_message();
+            errorf("%s", e.empty() ? "unknown exception" : e.c_str());
+            return false;
+        }
+    }
     int ystride          = 0;
     const uint8_t* hdata = m_himage.get_plane(heif_channel_interleaved,
                                               &ystride);
@@ -327,4 +402,156 @@ HeifInput::read_scanline(int y, int z, TypeDesc format, void* data,
     return ok;
 }
 
+
+
+#if HEIF_HAVE_TILING
+bool
+HeifInput::decode_tile(int tx, int ty, uint8_t* data, std::string& err)
+{
+    heif_image* img = nullptr;
+    heif_error herr = heif_image_handle_decode_image_tile(
+        m_ihandle.get_raw_image_handle().get(), &img, heif_colorspace_RGB,
+        chroma(), nullptr, uint32_t(tx), uint32_t(ty));
+    if (herr.code != heif_error_Ok) {
+        err = herr.message ? herr.message : "unknown error";
+        return false;
+    }
+    int ystride          = 0;
+    const uint8_t* hdata = heif_image_get_plane_readonly(
+        img, heif_channel_interleaved, &ystride);
+    if (!hdata) {
+        heif_image_release(img);
+        err = "Unknown read error";
+        return false;
+    }
+    // Cells are all the same size, but be prepared for ones that aren't
+    int w = std::min(m_spec.tile_width,
+                     heif_image_get_width(img, heif_channel_interleaved));
+    int h = std::min(m_spec.tile_height,
+                     heif_image_get_height(img, heif_channel_interleaved));
+
+    size_t pixelbytes = m_spec.pixel_bytes();
+    size_t tilerow    = m_spec.tile_width * pixelbytes;
+    if (w < m_spec.tile_width || h < m_spec.tile_height)
+        memset(data, 0, m_spec.tile_bytes());
+    for (int y = 0; y < h; ++y)
+        memcpy(data + y * tilerow, hdata + y * ystride, w * pixelbytes);
+    heif_image_release(img);
+    // Tiles are handed out natively, so associate alpha here
+    if (m_do_associate)
+        OIIO::premult(m_spec.nchannels, w, h, 1, 0, m_spec.nchannels,
+                      TypeUInt8, data, pixelbytes, tilerow, AutoStride,
+                      m_spec.alpha_channel);
+    return true;
+}
+
+
+
+bool
+HeifInput::read_native_tile(int subimage, int miplevel, int x, int y,
+                            int /*z*/, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel) || !m_spec.tile_width)
+        return false;
+    std::string err;
+    if (!decode_tile(x / m_spec.tile_width, y / m_spec.tile_height,
+                     (uint8_t*)data, err)) {
+        errorfmt("{}", err);
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+HeifInput::read_native_tiles(int subimage, int miplevel, int xbegin, int xend,
+                             int ybegin, int yend, int zbegin, int zend,
+                             void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel) || !m_spec.tile_width
+        || !m_spec.valid_tile_range(xbegin, xend, ybegin, yend, zbegin, zend))
+        return false;
+
+    // Decode the grid cells in parallel, each straight into its place
+    int tw              = m_spec.tile_width;
+    int th              = m_spec.tile_height;
+    int nxtiles         = (xend - xbegin + tw - 1) / tw;
+    int nytiles         = (yend - ybegin + th - 1) / th;
+    stride_t pixelbytes = m_spec.pixel_bytes();
+    stride_t ystride    = (xend - xbegin) * pixelbytes;
+    std::atomic<bool> ok(true);
+    std::mutex errmutex;
+    std::string errmsg;
+    parallel_for(
+        0, int64_t(nxtiles) * nytiles,
+        [&](int64_t t) {
+            int x = xbegin + int(t % nxtiles) * tw;
+            int y = ybegin + int(t / nxtiles) * th;
+            std::unique_ptr<uint8_t[]> pels(new uint8_t[m_spec.tile_bytes()]);
+            std::string err;
+            if (!ok || !decode_tile(x / tw, y / th, pels.get(), err)) {
+                std::lock_guard<std::mutex> lock(errmutex);
+                if (errmsg.empty())
+                    errmsg = err;
+                ok = false;
+                return;
+            }
+            copy_image(m_spec.nchannels, std::min(tw, xend - x),
+                       std::min(th, yend - y), 1, pels.get(), pixelbytes,
+                       pixelbytes, tw * pixelbytes, AutoStride,
+                       (char*)data + (y - ybegin) * ystride
+                           + (x - xbegin) * pixelbytes,
+                       pixelbytes, ystride, AutoStride);
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok && errmsg.size())
+        errorfmt("{}", errmsg);
+    return ok;
+}
+#endif
+
+
+
+bool
+HeifInput::get_thumbnail(ImageBuf& thumb, int subimage)
+{
+    lock_guard lock(*this);
+    if (subimage < 0 || subimage >= m_num_subimages)
+        return false;
+    try {
+        // Only the (small) thumbnail item is decoded, never the image
+        heif_item_id id = subimage ? m_item_ids[subimage - 1] : m_primary_id;
+        auto ihandle    = m_ctx->get_image_handle(id);
+        if (ihandle.get_number_of_thumbnails() < 1)
+            return false;
+        auto thandle = ihandle.get_thumbnail(
+            ihandle.get_list_of_thumbnail_IDs()[0]);
+        bool alpha   = thandle.has_alpha_channel();
+        heif::Image timage
+            = thandle.decode_image(heif_colorspace_RGB,
+                                   alpha ? heif_chroma_interleaved_RGBA
+                                         : heif_chroma_interleaved_RGB);
+        int ystride          = 0;
+        const uint8_t* hdata = timage.get_plane(heif_channel_interleaved,
+                                                &ystride);
+        if (!hdata) {
+            errorf("Unknown read error");
+            return false;
+        }
+        ImageSpec thumbspec(thandle.get_width(), thandle.get_height(),
+                            alpha ? 4 : 3, TypeUInt8);
+        thumbspec.attribute("oiio:ColorSpace", "sRGB");
+        thumb.reset(thumbspec);
+        thumb.set_pixels(ROI::All(), TypeUInt8, hdata, AutoStride, ystride);
+    } catch (const heif::Error& err) {
+        std::string e = err.get_message();
+        errorf("%s", e.empty() ? "unknown exception" : e.c_str());
+        return false;
+    }
+    return true;
+}
+
 OIIO_PLUGIN_NAMESPACE_END
@@ -3,19 +3,25 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <future>
 #include <iostream>
 #include <iterator>
 #include <string>
+#include <thread>
+#include <utility>
 #include <vector>
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 
 
@@ -48,8 +54,13 @@ static bool sRGB     = false;
 static bool separate = false, contig = false;
 static bool noclobber  = false;
 static int return_code = EXIT_SUCCESS;
+static std::string manifest;
+static int jobs = 2;
 static ArgParse ap;
 
+// Pixels that must be converted are streamed in bands of about this size.
+static const imagesize_t band_bytes = imagesize_t(64) << 20;
+
 
 
 static int
@@ -70,6 +81,8 @@ getargs(int argc, char* argv[])
     ap.options ("iconvert -- copy images with format conversions and other alterations\n"
                 OIIO_INTRO_STRING "\n"
                 "Usage:  iconvert [options] inputfile outputfile\n"
+                "   or:  iconvert [options] inputfile... outputdir\n"
+                "   or:  iconvert --manifest FILE [options]\n"
                 "   or:  iconvert --inplace [options] file...\n",
                 "%*", parse_files, "",
                 "--help", &help, "Print help message",
@@ -98,6 +111,8 @@ getargs(int argc, char* argv[])
                 "--separate", &separate, "Force planarconfig separate",
                 "--contig", &contig, "Force planarconfig contig",
                 "--no-clobber", &noclobber, "Do no overwrite existing files",
+                "--manifest %s:FILE", &manifest, "Convert the input and output files listed in FILE, a pair per line",
+                "--jobs %d:N", &jobs, "Number of files to convert at once, when there are several (default 2)",
 //FIXME         "-z", &zfile, "Treat input as a depth file",
 //FIXME         "-c %s", &channellist, "Restrict/shuffle channels",
                 nullptr);
@@ -116,7 +131,17 @@ getargs(int argc, char* argv[])
         return;
     }
 
-    if (filenames.size() != 2 && !inplace) {
+    if (manifest.size() && (filenames.size() || inplace)) {
+        std::cerr << "iconvert: --manifest takes no other filenames\n";
+        ap.usage();
+        ap.abort();
+        return_code = EXIT_FAILURE;
+        return;
+    }
+    if (filenames.size() >= 2 && !inplace
+        && Filesystem::is_directory(filenames.back())) {
+        // Several inputs converted into a directory
+    } else if (filenames.size() != 2 && !inplace && manifest.empty()) {
         std::cerr
             << "iconvert: Must have both an input and output filename specified.\n";
         ap.usage();
@@ -263,16 +288,17 @@ adjust_spec(ImageInput* in, ImageOutput* out, const ImageSpec& inspec,
     if (orientation >= 1)
         outspec.attribute("Orientation", orientation);
     else {
-        orientation = outspec.get_int_attribute("Orientation", 1);
-        if (orientation >= 1 && orientation <= 8) {
+        // Files may be converted concurrently, so don't touch the global
+        int orient = outspec.get_int_attribute("Orientation", 1);
+        if (orient >= 1 && orient <= 8) {
             static int cw[] = { 0, 6, 7, 8, 5, 2, 3, 4, 1 };
             if (rotcw || rotccw || rot180)
-                orientation = cw[orientation];
+                orient = cw[orient];
             if (rotccw || rot180)
-                orientation = cw[orientation];
+                orient = cw[orient];
             if (rotccw)
-                orientation = cw[orientation];
-            outspec.attribute("Orientation", orientation);
+                orient = cw[orient];
+            outspec.attribute("Orientation", orient);
         }
     }
 
@@ -308,6 +334,65 @@ adjust_spec(ImageInput* in, ImageOutput* out, const ImageSpec& inspec,
 
 
 
+// Copy the pixels of the subimage and MIP level of `in` that `outspec`
+// describes to `out`, converting them to outspec.format, a band of
+// scanlines at a time. The next band is read while the last one is being
+// written, and the whole image is never held in memory.
+static bool
+copy_pixels_in_bands(ImageInput* in, ImageOutput* out, int subimage,
+                     int miplevel, const ImageSpec& outspec,
+                     const std::string& in_filename,
+                     const std::string& out_filename)
+{
+    const imagesize_t scanline_bytes = outspec.scanline_bytes(true);
+    int band = int(clamp(band_bytes / std::max(scanline_bytes, imagesize_t(1)),
+                         imagesize_t(1), imagesize_t(outspec.height)));
+    if (outspec.tile_width)
+        band = std::min(round_to_multiple(band, outspec.tile_height),
+                        outspec.height);
+    const int nbands = (outspec.height + band - 1) / band;
+    const int yend   = outspec.y + outspec.height;
+
+    std::vector<char> bufs[2];
+    auto read_band = [&](int b) {
+        int y0 = outspec.y + b * band;
+        int y1 = std::min(y0 + band, yend);
+        bufs[b & 1].resize(size_t(y1 - y0) * scanline_bytes);
+        return in->read_scanlines(subimage, miplevel, y0, y1, outspec.z, 0,
+                                  outspec.nchannels, outspec.format,
+                                  bufs[b & 1].data());
+    };
+    std::future<bool> reading = std::async(std::launch::async, read_band, 0);
+    bool ok                   = true;
+    for (int b = 0; ok && b < nbands; ++b) {
+        ok = reading.get();
+        if (!ok) {
+            std::cerr << "iconvert ERROR reading \"" << in_filename
+                      << "\" : " << in->geterror() << "\n";
+            break;
+        }
+        if (b + 1 < nbands)
+            reading = std::async(std::launch::async, read_band, b + 1);
+        int y0 = outspec.y + b * band;
+        int y1 = std::min(y0 + band, yend);
+        if (outspec.tile_width)
+            ok = out->write_tiles(outspec.x, outspec.x + outspec.width, y0, y1,
+                                  outspec.z, outspec.z + 1, outspec.format,
+                                  bufs[b & 1].data());
+        else
+            ok = out->write_scanlines(y0, y1, outspec.z, outspec.format,
+                                      bufs[b & 1].data());
+        if (!ok)
+            std::cerr << "iconvert ERROR writing \"" << out_filename
+                      << "\" : " << out->geterror() << "\n";
+    }
+    if (reading.valid())
+        reading.wait();
+    return ok;
+}
+
+
+
 static bool
 convert_file(const std::string& in_filename, const std::string& out_filename)
 {
@@ -451,6 +536,10 @@ convert_file(const std::string& in_filename, const std::string& out_filename)
                     std::cerr << "iconvert ERROR copying \"" << in_filename
                               << "\" to \"" << out_filename << "\" :\n\t"
                               << out->geterror() << "\n";
+            } else if (outspec.depth <= 1 && !outspec.deep) {
+                ok = copy_pixels_in_bands(in.get(), out.get(), subimage,
+                                          miplevel, outspec, in_filename,
+                                          out_filename);
             } else {
                 // Need to do it by hand for some reason.  Future expansion in which
                 // only a subset of channels are copied, or some such.
@@ -499,6 +588,57 @@ convert_file(const std::string& in_filename, const std::string& out_filename)
 
 
 
+// Convert each pair of files, several at once, so that reading one file
+// overlaps with converting and writing another.
+static bool
+convert_files(const std::vector<std::pair<std::string, std::string>>& files)
+{
+    std::atomic<size_t> next(0);
+    std::atomic<bool> ok(true);
+    auto convert_next = [&]() {
+        for (size_t i = next++; i < files.size(); i = next++)
+            if (!convert_file(files[i].first, files[i].second))
+                ok = false;
+    };
+    int nworkers = clamp(jobs, 1, int(files.size()));
+    std::vector<std::thread> workers;
+    for (int w = 1; w < nworkers; ++w)
+        workers.emplace_back(convert_next);
+    convert_next();
+    for (auto& w : workers)
+        w.join();
+    return ok;
+}
+
+
+
+// Read the pairs of input and output filenames, one pair per line.
+static bool
+read_manifest(const std::string& filename,
+              std::vector<std::pair<std::string, std::string>>& files)
+{
+    std::string text;
+    if (!Filesystem::read_text_file(filename, text)) {
+        std::cerr << "iconvert ERROR: Could not read \"" << filename << "\"\n";
+        return false;
+    }
+    for (string_view line : Strutil::splitsv(text, "\n")) {
+        line = Strutil::strip(line);
+        if (line.empty() || line.front() == '#')
+            continue;
+        auto pair = Strutil::splitsv(line);
+        if (pair.size() != 2) {
+            std::cerr << "iconvert ERROR: Manifest lines should name an input "
+                      << "and an output file, not \"" << line << "\"\n";
+            return false;
+        }
+        files.emplace_back(pair[0], pair[1]);
+    }
+    return true;
+}
+
+
+
 int
 main(int argc, char* argv[])
 {
@@ -515,12 +655,22 @@ main(int argc, char* argv[])
 
     bool ok = true;
 
-    if (inplace) {
+    std::vector<std::pair<std::string, std::string>> files;
+    if (manifest.size()) {
+        ok = read_manifest(manifest, files);
+    } else if (inplace) {
         for (auto&& s : filenames)
-            ok &= convert_file(s, s);
+            files.emplace_back(s, s);
+    } else if (Filesystem::is_directory(filenames.back())) {
+        const std::string& dir(filenames.back());
+        for (size_t i = 0; i + 1 < filenames.size(); ++i)
+            files.emplace_back(filenames[i],
+                               dir + "/" + Filesystem::filename(filenames[i]));
     } else {
-        ok = convert_file(filenames[0], filenames[1]);
+        files.emplace_back(filenames[0], filenames[1]);
     }
+    if (ok)
+        ok = convert_files(files);
 
     return ok ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -3,13 +3,19 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <algorithm>
 #include <cmath>
+#include <condition_variable>
 #include <cstdio>
 #include <cstdlib>
 #include <ctime>
 #include <iomanip>
 #include <iostream>
 #include <iterator>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/dassert.h>
@@ -18,6 +24,7 @@
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 
 
@@ -34,6 +41,40 @@ enum idiffErrors {
 };
 
 
+// Options that apply to every comparison
+struct Options {
+    bool verbose     = false;
+    bool quiet       = false;
+    bool compareall  = false;
+    bool outdiffonly = false;
+    bool diffabs     = false;
+    bool perceptual  = false;
+    bool fastfail    = false;
+    std::string diffimage;
+    float diffscale   = 1.0f;
+    float failthresh  = 1.0e-6f;
+    float failpercent = 0.0f;
+    float hardfail    = std::numeric_limits<float>::infinity();
+    float warnthresh  = 1.0e-6f;
+    float warnpercent = 0.0f;
+    float hardwarn    = std::numeric_limits<float>::infinity();
+};
+
+
+// One pair of images to compare, and what we found, for the summary of a
+// batch. The errors are the worst over all subimages compared.
+struct ImagePair {
+    std::string file0, file1;
+    std::string name;  // for its difference image, in batch mode
+    int ret          = ErrOK;
+    double maxerror  = 0.0;
+    double meanerror = 0.0;
+    double rms_error = 0.0;
+    double PSNR      = std::numeric_limits<double>::infinity();
+    imagesize_t nwarn = 0, nfail = 0;
+};
+
+
 
 static ArgParse
 getargs(int argc, char* argv[])
@@ -42,7 +83,9 @@ getargs(int argc, char* argv[])
     ArgParse ap;
     ap.intro("idiff -- compare two images\n"
              OIIO_INTRO_STRING)
-      .usage("idiff [options] image1 image2")
+      .usage("idiff [options] image1 image2\n"
+             "       idiff [options] dir1 dir2\n"
+             "       idiff [options] -manifest FILENAME")
       .print_defaults(true);
 
     ap.arg("filename")
@@ -82,6 +125,8 @@ getargs(int argc, char* argv[])
       .defaultval(std::numeric_limits<float>::infinity());
     ap.arg("-p")
       .help("Perform perceptual (rather than numeric) comparison");
+    ap.arg("-fastfail")
+      .help("Only determine pass/fail, stopping at the first sign of failure");
 
     ap.separator("Difference image options");
     ap.arg("-o")
@@ -96,6 +141,22 @@ getargs(int argc, char* argv[])
       .defaultval(1.0f)
       .metavar("FACTOR");
 
+    ap.separator("Batch options (comparing two directories, or a manifest)");
+    ap.arg("-manifest")
+      .help("Compare the pairs of images listed in a file, one pair per line")
+      .metavar("FILENAME");
+    ap.arg("-j")
+      .help("Number of image pairs to compare at once (0 = one per core)")
+      .metavar("N")
+      .defaultval(0);
+    ap.arg("-maxmem")
+      .help("Memory limit for the images being compared at once")
+      .metavar("MB")
+      .defaultval(4096);
+    ap.arg("-json")
+      .help("Write a summary of the comparisons as JSON")
+      .metavar("FILENAME");
+
     ap.parse(argc, (const char**)argv);
 
     return ap;
@@ -106,7 +167,7 @@ getargs(int argc, char* argv[])
 
 static bool
 read_input(const std::string& filename, ImageBuf& img, ImageCache* cache,
-           int subimage = 0, int miplevel = 0)
+           std::ostream& err, int subimage = 0, int miplevel = 0)
 {
     if (img.subimage() >= 0 && img.subimage() == subimage
         && img.miplevel() == miplevel)
@@ -116,8 +177,8 @@ read_input(const std::string& filename, ImageBuf& img, ImageCache* cache,
     if (img.read(subimage, miplevel, false, TypeFloat))
         return true;
 
-    std::cerr << "idiff ERROR: Could not read " << filename << ":\n\t"
-              << img.geterror() << "\n";
+    err << "idiff ERROR: Could not read " << filename << ":\n\t"
+        << img.geterror() << "\n";
     return false;
 }
 
@@ -127,127 +188,89 @@ read_input(const std::string& filename, ImageBuf& img, ImageCache* cache,
 // Windows (where they are in 1.#INF, 1.#NAN format) and all
 // others platform
 inline void
-safe_double_print(double val)
+safe_double_print(std::ostream& out, double val)
 {
     if (OIIO::isnan(val))
-        std::cout << "nan";
+        out << "nan";
     else if (OIIO::isinf(val))
-        std::cout << "inf";
+        out << "inf";
     else
-        std::cout << val;
-    std::cout << '\n';
+        out << val;
+    out << '\n';
 }
 
 
 
 inline void
-print_subimage(ImageBuf& img0, int subimage, int miplevel)
+print_subimage(std::ostream& out, ImageBuf& img0, int subimage, int miplevel)
 {
     if (img0.nsubimages() > 1)
-        std::cout << "Subimage " << subimage << ' ';
+        out << "Subimage " << subimage << ' ';
     if (img0.nmiplevels() > 1)
-        std::cout << " MIP level " << miplevel << ' ';
+        out << " MIP level " << miplevel << ' ';
     if (img0.nsubimages() > 1 || img0.nmiplevels() > 1)
-        std::cout << ": ";
-    std::cout << img0.spec().width << " x " << img0.spec().height;
+        out << ": ";
+    out << img0.spec().width << " x " << img0.spec().height;
     if (img0.spec().depth > 1)
-        std::cout << " x " << img0.spec().depth;
-    std::cout << ", " << img0.spec().nchannels << " channel\n";
+        out << " x " << img0.spec().depth;
+    out << ", " << img0.spec().nchannels << " channel\n";
 }
 
 
 
-int
-main(int argc, char* argv[])
+// Compare one pair of images, writing the report to `out` and `err`, and
+// return the idiffErrors code. The statistics are recorded in `pair`.
+static int
+compare_pair(ImagePair& pair, const Options& opt, ImageCache* imagecache,
+             std::ostream& out, std::ostream& err)
 {
-    // Helpful for debugging to make sure that any crashes dump a stack
-    // trace.
-    Sysutil::setup_crash_stacktrace("stdout");
-
-    Filesystem::convert_native_arguments(argc, (const char**)argv);
-    ArgParse ap = getargs(argc, argv);
-
-    std::vector<std::string> filenames = ap["filename"].as_vec<std::string>();
-    if (filenames.size() != 2) {
-        std::cerr << "idiff: Must have two input filenames.\n";
-        std::cout << "> " << Strutil::join(filenames, ", ") << "\n";
-        ap.usage();
-        return EXIT_FAILURE;
-    }
-    bool verbose          = ap["v"].get<int>();
-    bool quiet            = ap["q"].get<int>();
-    bool compareall       = ap["a"].get<int>();
-    bool outdiffonly      = ap["od"].get<int>();
-    bool diffabs          = ap["abs"].get<int>();
-    bool perceptual       = ap["p"].get<int>();
-    std::string diffimage = ap["o"].get();
-    float diffscale       = ap["scale"].get<float>();
-    float failthresh      = ap["fail"].get<float>();
-    float failpercent     = ap["failpercent"].get<float>();
-    float hardfail        = ap["hardfail"].get<float>();
-    float warnthresh      = ap["warn"].get<float>();
-    float warnpercent     = ap["warnpercent"].get<float>();
-    float hardwarn        = ap["hardwarn"].get<float>();
-
-    if (!quiet)
-        std::cout << "Comparing \"" << filenames[0] << "\" and \""
-                  << filenames[1] << "\"\n";
-
-    // Create a private ImageCache so we can customize its cache size
-    // and instruct it store everything internally as floats.
-    ImageCache* imagecache = ImageCache::create(true);
-    imagecache->attribute("forcefloat", 1);
-    if (sizeof(void*) == 4)  // 32 bit or 64?
-        imagecache->attribute("max_memory_MB", 512.0);
-    else
-        imagecache->attribute("max_memory_MB", 2048.0);
-    imagecache->attribute("autotile", 256);
-    // force a full diff, even for files tagged with the same
-    // fingerprint, just in case some mistake has been made.
-    imagecache->attribute("deduplicate", 0);
+    const std::string& file0(pair.file0);
+    const std::string& file1(pair.file1);
+    std::string diffimage = opt.diffimage;
+    if (!opt.quiet)
+        out << "Comparing \"" << file0 << "\" and \"" << file1 << "\"\n";
 
     ImageBuf img0, img1;
-    if (!read_input(filenames[0], img0, imagecache)
-        || !read_input(filenames[1], img1, imagecache))
+    if (!read_input(file0, img0, imagecache, err)
+        || !read_input(file1, img1, imagecache, err))
         return ErrFile;
     //    ImageSpec spec0 = img0.spec();  // stash it
 
     int ret = ErrOK;
     for (int subimage = 0; subimage < img0.nsubimages(); ++subimage) {
-        if (subimage > 0 && !compareall)
+        if (subimage > 0 && !opt.compareall)
+            break;
+        if (opt.fastfail && ret == ErrFail)
             break;
         if (subimage >= img1.nsubimages())
             break;
 
-        if (!read_input(filenames[0], img0, imagecache, subimage)
-            || !read_input(filenames[1], img1, imagecache, subimage)) {
-            std::cerr << "Failed to read subimage " << subimage << "\n";
+        if (!read_input(file0, img0, imagecache, err, subimage)
+            || !read_input(file1, img1, imagecache, err, subimage)) {
+            err << "Failed to read subimage " << subimage << "\n";
             return ErrFile;
         }
 
         if (img0.nmiplevels() != img1.nmiplevels()) {
-            if (!quiet)
-                std::cout
-                    << "Files do not match in their number of MIPmap levels\n";
+            if (!opt.quiet)
+                out << "Files do not match in their number of MIPmap levels\n";
         }
 
         for (int m = 0; m < img0.nmiplevels(); ++m) {
-            if (m > 0 && !compareall)
+            if (m > 0 && !opt.compareall)
                 break;
             if (m > 0 && img0.nmiplevels() != img1.nmiplevels()) {
-                std::cerr
-                    << "Files do not match in their number of MIPmap levels\n";
+                err << "Files do not match in their number of MIPmap levels\n";
                 ret = ErrDifferentSize;
                 break;
             }
 
-            if (!read_input(filenames[0], img0, imagecache, subimage, m)
-                || !read_input(filenames[1], img1, imagecache, subimage, m))
+            if (!read_input(file0, img0, imagecache, err, subimage, m)
+                || !read_input(file1, img1, imagecache, err, subimage, m))
                 return ErrFile;
 
             if (img0.deep() != img1.deep()) {
-                std::cerr
-                    << "One image contains deep data, the other does not\n";
+                err << "One image contains deep data, the other does not\n";
                 ret = ErrDifferentSize;
                 break;
             }
@@ -258,99 +281,114 @@ main(int argc, char* argv[])
                 npels = 1;  // Avoid divide by zero for 0x0 images
             OIIO_ASSERT(img0.spec().format == TypeFloat);
 
+            if (opt.fastfail && !opt.perceptual && diffimage.empty()) {
+                // Pass/fail only, no statistics to report
+                imagesize_t maxfail = imagesize_t(opt.failpercent / 100.0
+                                                  * npels);
+                if (!ImageBufAlgo::compare_fastfail(img0, img1, opt.failthresh,
+                                                    maxfail, opt.hardfail)) {
+                    ret = ErrFail;
+                    break;
+                }
+                continue;
+            }
+
             // Compare the two images.
             //
-            auto cr = ImageBufAlgo::compare(img0, img1, failthresh, warnthresh);
+            auto cr = ImageBufAlgo::compare(img0, img1, opt.failthresh,
+                                            opt.warnthresh);
 
             int yee_failures = 0;
-            if (perceptual && !img0.deep()) {
+            if (opt.perceptual && !img0.deep()) {
                 ImageBufAlgo::CompareResults cr;
                 yee_failures = ImageBufAlgo::compare_Yee(img0, img1, cr);
             }
 
-            if (cr.nfail > (failpercent / 100.0 * npels)
-                || cr.maxerror > hardfail
-                || yee_failures > (failpercent / 100.0 * npels)) {
+            if (cr.nfail > (opt.failpercent / 100.0 * npels)
+                || cr.maxerror > opt.hardfail
+                || yee_failures > (opt.failpercent / 100.0 * npels)) {
                 ret = ErrFail;
-            } else if (cr.nwarn > (warnpercent / 100.0 * npels)
-                       || cr.maxerror > hardwarn) {
+            } else if (cr.nwarn > (opt.warnpercent / 100.0 * npels)
+                       || cr.maxerror > opt.hardwarn) {
                 if (ret != ErrFail)
                     ret = ErrWarn;
             }
+            pair.maxerror  = std::max(pair.maxerror, cr.maxerror);
+            pair.meanerror = std::max(pair.meanerror, cr.meanerror);
+            pair.rms_error = std::max(pair.rms_error, cr.rms_error);
+            pair.PSNR      = std::min(pair.PSNR, cr.PSNR);
+            pair.nwarn += cr.nwarn;
+            pair.nfail += cr.nfail;
 
             // Print the report
             //
-            if (verbose || (ret != ErrOK && !quiet)) {
-                if (compareall)
-                    print_subimage(img0, subimage, m);
-                std::cout << "  Mean error = ";
-                safe_double_print(cr.meanerror);
-                std::cout << "  RMS error = ";
-                safe_double_print(cr.rms_error);
-                std::cout << "  Peak SNR = ";
-                safe_double_print(cr.PSNR);
-                std::cout << "  Max error  = " << cr.maxerror;
+            if (opt.verbose || (ret != ErrOK && !opt.quiet)) {
+                if (opt.compareall)
+                    print_subimage(out, img0, subimage, m);
+                out << "  Mean error = ";
+                safe_double_print(out, cr.meanerror);
+                out << "  RMS error = ";
+                safe_double_print(out, cr.rms_error);
+                out << "  Peak SNR = ";
+                safe_double_print(out, cr.PSNR);
+                out << "  Max error  = " << cr.maxerror;
                 if (cr.maxerror != 0) {
-                    std::cout << " @ (" << cr.maxx << ", " << cr.maxy;
+                    out << " @ (" << cr.maxx << ", " << cr.maxy;
                     if (img0.spec().depth > 1)
-                        std::cout << ", " << cr.maxz;
+                        out << ", " << cr.maxz;
                     if (cr.maxc < (int)img0.spec().channelnames.size())
-                        std::cout << ", " << img0.spec().channelnames[cr.maxc]
-                                  << ')';
+                        out << ", " << img0.spec().channelnames[cr.maxc]
+                            << ')';
                     else if (cr.maxc < (int)img1.spec().channelnames.size())
-                        std::cout << ", " << img1.spec().channelnames[cr.maxc]
-                                  << ')';
+                        out << ", " << img1.spec().channelnames[cr.maxc]
+                            << ')';
                     else
-                        std::cout << ", channel " << cr.maxc << ')';
+                        out << ", channel " << cr.maxc << ')';
                     if (!img0.deep()) {
-                        std::cout << "  values are ";
+                        out << "  values are ";
                         for (int c = 0; c < img0.spec().nchannels; ++c)
-                            std::cout
-                                << (c ? ", " : "")
+                            out << (c ? ", " : "")
                                 << img0.getchannel(cr.maxx, cr.maxy, 0, c);
-                        std::cout << " vs ";
+                        out << " vs ";
                         for (int c = 0; c < img1.spec().nchannels; ++c)
-                            std::cout
-                                << (c ? ", " : "")
+                            out << (c ? ", " : "")
                                 << img1.getchannel(cr.maxx, cr.maxy, 0, c);
                     }
                 }
-                std::cout << "\n";
+                out << "\n";
 #if OIIO_MSVS_BEFORE_2015
                 // When older Visual Studio is used, float values in
                 // scientific foramt are printed with three digit exponent.
                 // We change this behaviour to fit Linux way.
                 _set_output_format(_TWO_DIGIT_EXPONENT);
 #endif
-                std::streamsize precis = std::cout.precision();
-                std::cout << "  " << cr.nwarn << " pixels ("
-                          << std::setprecision(3) << (100.0 * cr.nwarn / npels)
-                          << std::setprecision(precis) << "%) over "
-                          << warnthresh << "\n";
-                std::cout << "  " << cr.nfail << " pixels ("
-                          << std::setprecision(3) << (100.0 * cr.nfail / npels)
-                          << std::setprecision(precis) << "%) over "
-                          << failthresh << "\n";
-                if (perceptual)
-                    std::cout << "  " << yee_failures << " pixels ("
-                              << std::setprecision(3)
-                              << (100.0 * yee_failures / npels)
-                              << std::setprecision(precis)
-                              << "%) failed the perceptual test\n";
+                std::streamsize precis = out.precision();
+                out << "  " << cr.nwarn << " pixels (" << std::setprecision(3)
+                    << (100.0 * cr.nwarn / npels) << std::setprecision(precis)
+                    << "%) over " << opt.warnthresh << "\n";
+                out << "  " << cr.nfail << " pixels (" << std::setprecision(3)
+                    << (100.0 * cr.nfail / npels) << std::setprecision(precis)
+                    << "%) over " << opt.failthresh << "\n";
+                if (opt.perceptual)
+                    out << "  " << yee_failures << " pixels ("
+                        << std::setprecision(3)
+                        << (100.0 * yee_failures / npels)
+                        << std::setprecision(precis)
+                        << "%) failed the perceptual test\n";
             }
 
             // If the user requested that a difference image be output,
             // do that.  N.B. we only do this for the first subimage
             // right now, because ImageBuf doesn't really know how to
             // write subimages.
-            if (diffimage.size() && (cr.maxerror != 0 || !outdiffonly)) {
+            if (diffimage.size() && (cr.maxerror != 0 || !opt.outdiffonly)) {
                 ImageBuf diff;
-                if (diffabs)
+                if (opt.diffabs)
                     ImageBufAlgo::absdiff(diff, img0, img1);
                 else
                     ImageBufAlgo::sub(diff, img0, img1);
-                if (diffscale != 1.0f)
-                    ImageBufAlgo::mul(diff, diff, diffscale);
+                if (opt.diffscale != 1.0f)
+                    ImageBufAlgo::mul(diff, diff, opt.diffscale);
                 diff.write(diffimage);
 
                 // Clear diff image name so we only save the first
@@ -360,31 +398,325 @@ main(int argc, char* argv[])
         }
     }
 
-    if (compareall && img0.nsubimages() != img1.nsubimages()) {
-        if (!quiet)
-            std::cerr << "Images had differing numbers of subimages ("
-                      << img0.nsubimages() << " vs " << img1.nsubimages()
-                      << ")\n";
+    if (opt.compareall && img0.nsubimages() != img1.nsubimages()) {
+        if (!opt.quiet)
+            err << "Images had differing numbers of subimages ("
+                << img0.nsubimages() << " vs " << img1.nsubimages() << ")\n";
         ret = ErrFail;
     }
-    if (!compareall && (img0.nsubimages() > 1 || img1.nsubimages() > 1)) {
-        if (!quiet)
-            std::cout << "Only compared the first subimage (of "
-                      << img0.nsubimages() << " and " << img1.nsubimages()
-                      << ", respectively)\n";
+    if (!opt.compareall && (img0.nsubimages() > 1 || img1.nsubimages() > 1)) {
+        if (!opt.quiet)
+            out << "Only compared the first subimage (of " << img0.nsubimages()
+                << " and " << img1.nsubimages() << ", respectively)\n";
     }
+    return ret;
+}
+
+
+
+static const char*
+status_name(int ret)
+{
+    static const char* names[] = { "PASS", "WARNING", "FAILURE",
+                                   "FAILURE", "ERROR" };
+    return ret >= ErrOK && ret < ErrLast ? names[ret] : "ERROR";
+}
 
-    if (ret == ErrOK) {
-        if (!quiet)
-            std::cout << "PASS\n";
+
+
+// Compare the pair, with its report and verdict.
+static int
+compare_and_report(ImagePair& pair, const Options& opt, ImageCache* imagecache,
+                   std::ostream& out, std::ostream& err)
+{
+    int ret  = compare_pair(pair, opt, imagecache, out, err);
+    pair.ret = ret;
+    if (ret == ErrFile) {
+        // The reason was already reported
+    } else if (ret == ErrOK) {
+        if (!opt.quiet)
+            out << "PASS\n";
     } else if (ret == ErrWarn) {
-        if (!quiet)
-            std::cout << "WARNING\n";
+        if (!opt.quiet)
+            out << "WARNING\n";
     } else if (ret) {
-        if (quiet)
-            std::cerr << "FAILURE\n";
+        if (opt.quiet)
+            err << "FAILURE\n";
         else
-            std::cout << "FAILURE\n";
+            out << "FAILURE\n";
+    }
+    return ret;
+}
+
+
+
+// The pairs to compare: files with the same relative path in both
+// directories, or the lines of a manifest.
+static bool
+batch_pairs(const std::string& manifest, const std::string& dir0,
+            const std::string& dir1, std::vector<ImagePair>& pairs)
+{
+    if (manifest.size()) {
+        std::string text;
+        if (!Filesystem::read_text_file(manifest, text)) {
+            std::cerr << "idiff ERROR: Could not read " << manifest << "\n";
+            return false;
+        }
+        for (string_view line : Strutil::splitsv(text, "\n")) {
+            line = Strutil::strip(line);
+            if (line.empty() || line.front() == '#')
+                continue;
+            auto files = Strutil::splitsv(line);
+            if (files.size() != 2) {
+                std::cerr << "idiff ERROR: Manifest lines should name two "
+                          << "images, not \"" << line << "\"\n";
+                return false;
+            }
+            ImagePair pair;
+            pair.file0 = files[0];
+            pair.file1 = files[1];
+            pair.name  = Filesystem::filename(pair.file0);
+            pairs.push_back(pair);
+        }
+        return true;
+    }
+
+    // Only the files with an extension that some format plugin claims
+    std::set<std::string> extensions;
+    for (string_view format : Strutil::splitsv(
+             OIIO::get_string_attribute("extension_list"), ";")) {
+        Strutil::parse_until_char(format, ':');
+        Strutil::parse_char(format, ':');
+        for (string_view ext : Strutil::splitsv(format, ","))
+            extensions.insert(Strutil::lower(ext));
+    }
+    std::vector<std::string> files;
+    if (!Filesystem::get_directory_entries(dir0, files, true)) {
+        std::cerr << "idiff ERROR: Could not read directory " << dir0 << "\n";
+        return false;
+    }
+    std::sort(files.begin(), files.end());
+    for (auto& f : files) {
+        std::string ext = Strutil::lower(Filesystem::extension(f, false));
+        if (!extensions.count(ext) || !Filesystem::is_regular(f))
+            continue;
+        string_view rel(f);
+        rel.remove_prefix(std::min(dir0.size(), rel.size()));
+        while (rel.size() && (rel.front() == '/' || rel.front() == '\\'))
+            rel.remove_prefix(1);
+        ImagePair pair;
+        pair.file0 = f;
+        pair.file1 = dir1 + "/" + std::string(rel);
+        pair.name  = Strutil::replace(Strutil::replace(rel, "/", "_", true),
+                                      "\\", "_", true);
+        pairs.push_back(pair);
+    }
+    return true;
+}
+
+
+
+// Only finite numbers are valid JSON.
+static std::string
+json_number(double val)
+{
+    return std::isfinite(val) ? Strutil::fmt::format("{}", val) : "null";
+}
+
+
+
+static bool
+write_json_summary(const std::string& filename,
+                   const std::vector<ImagePair>& pairs)
+{
+    int count[ErrLast] = {};
+    std::vector<std::string> results;
+    for (auto& p : pairs) {
+        ++count[p.ret];
+        results.push_back(Strutil::fmt::format(
+            "    {{\"image1\": \"{}\", \"image2\": \"{}\", \"status\": \"{}\", "
+            "\"maxerror\": {}, \"meanerror\": {}, \"rms_error\": {}, "
+            "\"psnr\": {}, \"nwarn\": {}, \"nfail\": {}}}",
+            Strutil::escape_chars(p.file0), Strutil::escape_chars(p.file1),
+            status_name(p.ret), json_number(p.maxerror),
+            json_number(p.meanerror), json_number(p.rms_error),
+            json_number(p.PSNR), p.nwarn, p.nfail));
+    }
+    std::string json = Strutil::fmt::format(
+        "{{\n  \"pairs\": {}, \"pass\": {}, \"warn\": {}, \"fail\": {}, "
+        "\"error\": {},\n  \"results\": [\n{}\n  ]\n}}\n",
+        pairs.size(), count[ErrOK], count[ErrWarn],
+        count[ErrFail] + count[ErrDifferentSize], count[ErrFile],
+        Strutil::join(results, ",\n"));
+    if (!Filesystem::write_text_file(filename, json)) {
+        std::cerr << "idiff ERROR: Could not write " << filename << "\n";
+        return false;
+    }
+    return true;
+}
+
+
+
+// Compare all the pairs, several at once, but starting a pair only when the
+// images already being compared leave room for its images under `maxmem`.
+// Each report is printed whole, as its pair finishes. Return the worst
+// idiffErrors code of any pair.
+static int
+compare_batch(std::vector<ImagePair>& pairs, const Options& opt,
+              ImageCache* imagecache, int nworkers, imagesize_t maxmem)
+{
+    std::mutex mutex;
+    std::condition_variable memory_freed;
+    size_t next          = 0;
+    imagesize_t inflight = 0;
+    int worst            = ErrOK;
+
+    auto worker = [&]() {
+        for (;;) {
+            size_t i;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (next >= pairs.size())
+                    return;
+                i = next++;
+            }
+            ImagePair& pair(pairs[i]);
+            Options pairopt(opt);
+            if (opt.diffimage.size())
+                pairopt.diffimage = opt.diffimage + "/" + pair.name;
+
+            // Images are compared as float, so that's what they'll take.
+            imagesize_t bytes = 0;
+            for (auto& f : { pair.file0, pair.file1 }) {
+                ImageSpec spec;
+                if (imagecache->get_imagespec(ustring(f), spec))
+                    bytes += spec.image_pixels() * spec.nchannels
+                             * sizeof(float);
+            }
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                memory_freed.wait(lock, [&]() {
+                    return inflight == 0 || inflight + bytes <= maxmem;
+                });
+                inflight += bytes;
+            }
+
+            std::ostringstream out, err;
+            int ret = compare_and_report(pair, pairopt, imagecache, out, err);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            inflight -= bytes;
+            memory_freed.notify_all();
+            worst = std::max(worst, ret);
+            std::cout << out.str() << std::flush;
+            std::cerr << err.str() << std::flush;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int w = 0; w < nworkers; ++w)
+        workers.emplace_back(worker);
+    for (auto& w : workers)
+        w.join();
+    return worst;
+}
+
+
+
+int
+main(int argc, char* argv[])
+{
+    // Helpful for debugging to make sure that any crashes dump a stack
+    // trace.
+    Sysutil::setup_crash_stacktrace("stdout");
+
+    Filesystem::convert_native_arguments(argc, (const char**)argv);
+    ArgParse ap = getargs(argc, argv);
+
+    std::vector<std::string> filenames = ap["filename"].as_vec<std::string>();
+    std::string manifest               = ap["manifest"].get();
+    bool batch = manifest.size()
+                 || (filenames.size() == 2
+                     && Filesystem::is_directory(filenames[0])
+                     && Filesystem::is_directory(filenames[1]));
+    if (manifest.size() ? filenames.size() != 0 : filenames.size() != 2) {
+        std::cerr << "idiff: Must have two input filenames.\n";
+        std::cout << "> " << Strutil::join(filenames, ", ") << "\n";
+        ap.usage();
+        return EXIT_FAILURE;
+    }
+    Options opt;
+    opt.verbose     = ap["v"].get<int>();
+    opt.quiet       = ap["q"].get<int>();
+    opt.compareall  = ap["a"].get<int>();
+    opt.outdiffonly = ap["od"].get<int>();
+    opt.diffabs     = ap["abs"].get<int>();
+    opt.perceptual  = ap["p"].get<int>();
+    opt.fastfail    = ap["fastfail"].get<int>();
+    opt.diffimage   = ap["o"].get();
+    opt.diffscale   = ap["scale"].get<float>();
+    opt.failthresh  = ap["fail"].get<float>();
+    opt.failpercent = ap["failpercent"].get<float>();
+    opt.hardfail    = ap["hardfail"].get<float>();
+    opt.warnthresh  = ap["warn"].get<float>();
+    opt.warnpercent = ap["warnpercent"].get<float>();
+    opt.hardwarn    = ap["hardwarn"].get<float>();
+
+    // Create a private ImageCache so we can customize its cache size
+    // and instruct it store everything internally as floats.
+    ImageCache* imagecache = ImageCache::create(true);
+    imagecache->attribute("forcefloat", 1);
+    if (sizeof(void*) == 4)  // 32 bit or 64?
+        imagecache->attribute("max_memory_MB", 512.0);
+    else
+        imagecache->attribute("max_memory_MB", 2048.0);
+    imagecache->attribute("autotile", 256);
+    // force a full diff, even for files tagged with the same
+    // fingerprint, just in case some mistake has been made.
+    imagecache->attribute("deduplicate", 0);
+
+    int ret = ErrOK;
+    if (batch) {
+        // In batch mode, -o names a directory for the difference images.
+        std::vector<ImagePair> pairs;
+        std::string dir0 = manifest.empty() ? filenames[0] : std::string();
+        std::string dir1 = manifest.empty() ? filenames[1] : std::string();
+        if (!batch_pairs(manifest, dir0, dir1, pairs))
+            ret = ErrFile;
+        else if (opt.diffimage.size()
+                 && !Filesystem::is_directory(opt.diffimage)
+                 && !Filesystem::create_directory(opt.diffimage)) {
+            std::cerr << "idiff ERROR: Could not create directory "
+                      << opt.diffimage << "\n";
+            ret = ErrFile;
+        } else {
+            int nworkers = ap["j"].get<int>();
+            if (nworkers <= 0)
+                nworkers = Sysutil::hardware_concurrency();
+            nworkers = std::max(1, std::min(nworkers, int(pairs.size())));
+            imagesize_t maxmem = imagesize_t(ap["maxmem"].get<int>()) << 20;
+            ret = compare_batch(pairs, opt, imagecache, nworkers, maxmem);
+
+            int count[ErrLast] = {};
+            for (auto& p : pairs)
+                ++count[p.ret];
+            if (!opt.quiet)
+                std::cout << "Compared " << pairs.size() << " pairs: "
+                          << count[ErrOK] << " passed, " << count[ErrWarn]
+                          << " with warnings, "
+                          << count[ErrFail] + count[ErrDifferentSize]
+                          << " failed, " << count[ErrFile] << " errors\n";
+            std::string json = ap["json"].get();
+            if (json.size() && !write_json_summary(json, pairs))
+                ret = std::max(ret, int(ErrFile));
+        }
+    } else {
+        ImagePair pair;
+        pair.file0 = filenames[0];
+        pair.file1 = filenames[1];
+        ret = compare_and_report(pair, opt, imagecache, std::cout, std::cerr);
+        std::string json = ap["json"].get();
+        if (json.size() && !write_json_summary(json, { pair }))
+            ret = std::max(ret, int(ErrFile));
     }
 
     imagecache->invalidate_all(true);
@@ -158,11 +158,19 @@ private:
         m_buf.clear();
     }
 
+    // location and extent of one tile of pixels in the file
+    struct TileInfo {
+        int64_t offset;  // of the pixel data
+        uint32_t size;   // bytes of pixel data
+        uint16_t xmin, ymin, xmax, ymax;
+        bool compressed;
+    };
+
     // helper to read an image
     bool readimg(void);
 
-    // helper to uncompress a rle channel
-    size_t uncompress_rle_channel(const uint8_t* in, uint8_t* out, int size);
+    // helper to decode the pixel data 'p' of a tile into m_buf
+    bool decode_tile(const TileInfo& tile, const uint8_t* p);
 
     bool read_short(uint16_t& val)
     {
@@ -3,8 +3,13 @@
 // https://github.com/OpenImageIO/oiio
 #include "iff_pvt.h"
 
+#include <atomic>
 #include <cmath>
 
+#include <OpenImageIO/parallel.h>
+
+#include "../libOpenImageIO/rle_pvt.h"
+
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 using namespace iff_pvt;
@@ -28,6 +33,8 @@ iff_input_imageio_create()
 
 OIIO_EXPORT const char* iff_input_extensions[] = { "iff", "z", nullptr };
 
+OIIO_EXPORT const char* iff_input_signatures[] = { "464f5234", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -145,8 +152,10 @@ IffInput::read_native_tile(int subimage, int miplevel, int x, int y, int /*z*/,
     if (!seek_subimage(subimage, miplevel))
         return false;
 
-    if (m_buf.empty())
-        readimg();
+    if (m_buf.empty() && !readimg()) {
+        m_buf.clear();
+        return false;
+    }
 
     // tile size
     int w  = m_spec.width;
@@ -194,15 +203,17 @@ IffInput::readimg()
     // set position tile may be called randomly
     fseek(m_fd, m_tbmp_start, SEEK_SET);
 
-    // resize buffer
-    m_buf.resize(m_spec.image_bytes());
-
+    // First find all the tiles, only reading the chunk headers and tile
+    // coordinates and seeking past the pixel data.
+    std::vector<TileInfo> tiles;
     for (unsigned int t = 0; t < m_iff_header.tiles;) {
         // get type
         if (!fread(&type, 1, sizeof(type), m_fd) ||
             // get length
-            !fread(&size, 1, sizeof(size), m_fd))
+            !fread(&size, 1, sizeof(size), m_fd)) {
+            errorfmt("\"{}\": could not read tile {}", m_filename, t);
             return false;
+        }
 
         if (littleendian())
             swap_endian(&size);
@@ -213,216 +224,44 @@ IffInput::readimg()
         if (type[0] == 'R' && type[1] == 'G' && type[2] == 'B'
             && type[3] == 'A') {
             // get tile coordinates.
-            uint16_t xmin, xmax, ymin, ymax;
-            if (!fread(&xmin, 1, sizeof(xmin), m_fd)
-                || !fread(&ymin, 1, sizeof(ymin), m_fd)
-                || !fread(&xmax, 1, sizeof(xmax), m_fd)
-                || !fread(&ymax, 1, sizeof(ymax), m_fd))
+            TileInfo tile;
+            if (size < 8 || !fread(&tile.xmin, 1, sizeof(tile.xmin), m_fd)
+                || !fread(&tile.ymin, 1, sizeof(tile.ymin), m_fd)
+                || !fread(&tile.xmax, 1, sizeof(tile.xmax), m_fd)
+                || !fread(&tile.ymax, 1, sizeof(tile.ymax), m_fd)) {
+                errorfmt("\"{}\": could not read tile {}", m_filename, t);
                 return false;
+            }
 
             // swap endianness
             if (littleendian()) {
-                swap_endian(&xmin);
-                swap_endian(&ymin);
-                swap_endian(&xmax);
-                swap_endian(&ymax);
+                swap_endian(&tile.xmin);
+                swap_endian(&tile.ymin);
+                swap_endian(&tile.xmax);
+                swap_endian(&tile.ymax);
             }
 
-            // get tile width/height
-            uint32_t tw = xmax - xmin + 1;
-            uint32_t th = ymax - ymin + 1;
-
-            // get image size
-            // skip coordinates, uint16_t (2) * 4 = 8
-            uint32_t image_size = chunksize - 8;
-
             // check tile
-            if (xmin > xmax || ymin > ymax || xmax >= m_spec.width
-                || ymax >= m_spec.height || !tw || !th) {
+            if (tile.xmin > tile.xmax || tile.ymin > tile.ymax
+                || tile.xmax >= m_spec.width || tile.ymax >= m_spec.height) {
+                errorfmt("\"{}\": tile {} is out of bounds", m_filename, t);
                 return false;
             }
 
-            // tile compress
-            bool tile_compress = false;
+            // skip coordinates, uint16_t (2) * 4 = 8
+            tile.offset = Filesystem::ftell(m_fd);
+            tile.size   = chunksize - 8;
 
             // if tile compression fails to be less than image data stored
             // uncompressed the tile is written uncompressed
-
-            // set channels
-            uint8_t channels = m_iff_header.pixel_channels;
-
-            // set tile size
-            uint32_t tile_size = tw * th * channels * m_spec.channel_bytes()
-                                 + 8;
-
-            // test if compressed
             // we use the non aligned size
-            if (tile_size > size) {
-                tile_compress = true;
-            }
+            uint32_t tw = tile.xmax - tile.xmin + 1;
+            uint32_t th = tile.ymax - tile.ymin + 1;
+            tile.compressed = (tw * th * m_spec.pixel_bytes() + 8 > size);
 
-            // handle 8-bit data.
-            if (m_iff_header.pixel_bits == 8) {
-                std::vector<uint8_t> scratch;
-
-                // set bytes.
-                scratch.resize(image_size);
-
-                if (!fread(&scratch[0], 1, scratch.size(), m_fd))
-                    return false;
-
-                // set tile data
-                uint8_t* p = static_cast<uint8_t*>(&scratch[0]);
-
-                // tile compress.
-                if (tile_compress) {
-                    // map BGR(A) to RGB(A)
-                    for (int c = (channels * m_spec.channel_bytes()) - 1;
-                         c >= 0; --c) {
-                        std::vector<uint8_t> in(tw * th);
-                        uint8_t* in_p = &in[0];
-
-                        // uncompress and increment
-                        p += uncompress_rle_channel(p, in_p, tw * th);
-
-                        // set tile
-                        for (uint16_t py = ymin; py <= ymax; py++) {
-                            uint8_t* out_dy = static_cast<uint8_t*>(&m_buf[0])
-                                              + (py * m_spec.width)
-                                                    * m_spec.pixel_bytes();
-
-                            for (uint16_t px = xmin; px <= xmax; px++) {
-                                uint8_t* out_p
-                                    = out_dy + px * m_spec.pixel_bytes() + c;
-                                *out_p++ = *in_p++;
-                            }
-                        }
-                    }
-                } else {
-                    int sy = 0;
-                    for (uint16_t py = ymin; py <= ymax; py++) {
-                        uint8_t* out_dy = static_cast<uint8_t*>(&m_buf[0])
-                                          + (py * m_spec.width + xmin)
-                                                * m_spec.pixel_bytes();
-
-                        // set tile
-                        int sx = 0;
-                        for (uint16_t px = xmin; px <= xmax; px++) {
-                            uint8_t* in_p
-                                = p + (sy * tw + sx) * m_spec.pixel_bytes();
-
-                            // map BGR(A) to RGB(A)
-                            for (int c = channels - 1; c >= 0; --c) {
-                                uint8_t* out_p = in_p
-                                                 + (c * m_spec.channel_bytes());
-                                *out_dy++ = *out_p;
-                            }
-                            sx++;
-                        }
-                        sy++;
-                    }
-                }
-            }
-            // handle 16-bit data.
-            else if (m_iff_header.pixel_bits == 16) {
-                std::vector<uint8_t> scratch;
-
-                // set bytes.
-                scratch.resize(image_size);
-
-                if (!fread(&scratch[0], 1, scratch.size(), m_fd))
-                    return false;
-
-                // set tile data
-                uint8_t* p = static_cast<uint8_t*>(&scratch[0]);
-
-                if (tile_compress) {
-                    // set map
-                    std::vector<uint8_t> map;
-                    if (littleendian()) {
-                        int rgb16[]  = { 0, 2, 4, 1, 3, 5 };
-                        int rgba16[] = { 0, 2, 4, 6, 1, 3, 5, 7 };
-                        if (m_iff_header.pixel_channels == 3) {
-                            map = std::vector<uint8_t>(rgb16, &rgb16[6]);
-                        } else {
-                            map = std::vector<uint8_t>(rgba16, &rgba16[8]);
-                        }
-
-                    } else {
-                        int rgb16[]  = { 1, 3, 5, 0, 2, 4 };
-                        int rgba16[] = { 1, 3, 5, 7, 0, 2, 4, 6 };
-                        if (m_iff_header.pixel_channels == 3) {
-                            map = std::vector<uint8_t>(rgb16, &rgb16[6]);
-                        } else {
-                            map = std::vector<uint8_t>(rgba16, &rgba16[8]);
-                        }
-                    }
-
-                    // map BGR(A)BGR(A) to RRGGBB(AA)
-                    for (int c = (channels * m_spec.channel_bytes()) - 1;
-                         c >= 0; --c) {
-                        int mc = map[c];
-
-                        std::vector<uint8_t> in(tw * th);
-                        uint8_t* in_p = &in[0];
-
-                        // uncompress and increment
-                        p += uncompress_rle_channel(p, in_p, tw * th);
-
-                        // set tile
-                        for (uint16_t py = ymin; py <= ymax; py++) {
-                            uint8_t* out_dy = static_cast<uint8_t*>(&m_buf[0])
-                                              + (py * m_spec.width)
-                                                    * m_spec.pixel_bytes();
-
-                            for (uint16_t px = xmin; px <= xmax; px++) {
-                                uint8_t* out_p
-                                    = out_dy + px * m_spec.pixel_bytes() + mc;
-                                *out_p++ = *in_p++;
-                            }
-                        }
-                    }
-                } else {
-                    int sy = 0;
-                    for (uint16_t py = ymin; py <= ymax; py++) {
-                        uint8_t* out_dy = static_cast<uint8_t*>(&m_buf[0])
-                                          + (py * m_spec.width + xmin)
-                                                * m_spec.pixel_bytes();
-
-                        // set scanline, make copy easier
-                        std::vector<uint16_t> scanline(tw
-                                                       * m_spec.pixel_bytes());
-                        uint16_t* sl_p = &scanline[0];
-
-                        // set tile
-                        int sx = 0;
-                        for (uint16_t px = xmin; px <= xmax; px++) {
-                            uint8_t* in_p
-                                = p + (sy * tw + sx) * m_spec.pixel_bytes();
-
-                            // map BGR(A) to RGB(A)
-                            for (int c = channels - 1; c >= 0; --c) {
-                                uint16_t pixel;
-                                uint8_t* out_p = in_p
-                                                 + (c * m_spec.channel_bytes());
-                                memcpy(&pixel, out_p, 2);
-                                // swap endianness
-                                if (littleendian()) {
-                                    swap_endian(&pixel);
-                                }
-                                *sl_p++ = pixel;
-                            }
-                            sx++;
-                        }
-                        // copy data
-                        memcpy(out_dy, &scanline[0], tw * m_spec.pixel_bytes());
-                        sy++;
-                    }
-                }
-
-            } else {
-                errorf("\"%s\": unsupported number of bits per pixel for tile",
-                       m_filename);
+            tiles.push_back(tile);
+            if (Filesystem::fseek(m_fd, tile.size, SEEK_CUR)) {
+                errorfmt("\"{}\": could not read tile {}", m_filename, t);
                 return false;
             }
 
@@ -431,58 +270,110 @@ IffInput::readimg()
 
         } else {
             // skip to the next block
-            if (fseek(m_fd, chunksize, SEEK_CUR))
+            if (Filesystem::fseek(m_fd, chunksize, SEEK_CUR)) {
+                errorfmt("\"{}\": could not read tile {}", m_filename, t);
                 return false;
+            }
         }
     }
-
-    // flip buffer to make read_native_tile easier,
-    // from tga.imageio:
-
-    int bytespp = m_spec.pixel_bytes();
-
-    std::vector<unsigned char> flip(m_spec.width * bytespp);
-    unsigned char *src, *dst, *tmp = &flip[0];
-    for (int y = 0; y < m_spec.height / 2; y++) {
-        src = &m_buf[(m_spec.height - y - 1) * m_spec.width * bytespp];
-        dst = &m_buf[y * m_spec.width * bytespp];
-
-        memcpy(tmp, src, m_spec.width * bytespp);
-        memcpy(src, dst, m_spec.width * bytespp);
-        memcpy(dst, tmp, m_spec.width * bytespp);
+    // resize buffer
+    m_buf.resize(m_spec.image_bytes());
+    if (tiles.empty())
+        return true;
+
+    // The tiles are (nearly) contiguous, read them all in one go.
+    int64_t base = tiles.front().offset;
+    int64_t end  = tiles.back().offset + tiles.back().size;
+    std::vector<uint8_t> data(end - base);
+    Filesystem::fseek(m_fd, base, SEEK_SET);
+    if (!fread(data.data(), 1, data.size(), m_fd)) {
+        errorfmt("\"{}\": could not read tile data", m_filename);
+        return false;
     }
 
+    // Tiles don't overlap, so decode them in parallel
+    std::atomic<bool> ok(true);
+    parallel_for(
+        0, int64_t(tiles.size()),
+        [&](int64_t t) {
+            const TileInfo& tile = tiles[t];
+            if (ok && !decode_tile(tile, &data[tile.offset - base]))
+                ok = false;
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok) {
+        errorfmt("\"{}\": corrupt tile data", m_filename);
+        return false;
+    }
     return true;
 }
 
 
 
-size_t
-IffInput::uncompress_rle_channel(const uint8_t* in, uint8_t* out, int size)
+bool
+IffInput::decode_tile(const TileInfo& tile, const uint8_t* p)
 {
-    const uint8_t* const _in = in;
-    const uint8_t* const end = out + size;
-
-    while (out < end) {
-        // information.
-        const uint8_t count = (*in & 0x7f) + 1;
-        const bool run      = (*in & 0x80) ? true : false;
-        ++in;
-
-        // find runs
-        if (!run) {
-            // verbatim
-            for (int i = 0; i < count; i++)
-                *out++ = *in++;
-        } else {
-            // duplicate
-            const uint8_t p = *in++;
-            for (int i = 0; i < count; i++)
-                *out++ = p;
+    const uint32_t tw      = tile.xmax - tile.xmin + 1;
+    const uint32_t th      = tile.ymax - tile.ymin + 1;
+    const uint8_t channels = m_iff_header.pixel_channels;
+    const size_t cbytes    = m_spec.channel_bytes();
+    const size_t pbytes    = m_spec.pixel_bytes();
+
+    // The file stores the image bottom to top, we flip it here to make
+    // read_native_tile easier.
+    auto out_row = [&](int py) {
+        return &m_buf[(size_t(m_spec.height - 1 - py) * m_spec.width
+                       + tile.xmin)
+                      * pbytes];
+    };
+
+    if (tile.compressed) {
+        // Each byte of the pixels is in a separate RLE plane, mapping
+        // BGR(A) to RGB(A), and for 16-bit data BGR(A)BGR(A) to RRGGBB(AA)
+        // in native byte order.
+        int map[8];
+        for (int c = 0; c < channels * int(cbytes); ++c)
+            map[c] = c;
+        if (cbytes == 2) {
+            static const int rgb16[][8]  = { { 0, 2, 4, 1, 3, 5 },
+                                             { 1, 3, 5, 0, 2, 4 } };
+            static const int rgba16[][8] = { { 0, 2, 4, 6, 1, 3, 5, 7 },
+                                             { 1, 3, 5, 7, 0, 2, 4, 6 } };
+            const int* m = (channels == 3 ? rgb16 : rgba16)[bigendian()];
+            std::copy(m, m + 2 * channels, map);
+        }
+
+        std::vector<uint8_t> in(tw * th);
+        size_t pos = 0;
+        for (int c = (channels * cbytes) - 1; c >= 0; --c) {
+            // uncompress and increment
+            size_t used = RLE_pvt::decode(RLE_pvt::RunBitHeader(), p + pos,
+                                          tile.size - pos, &in[0], tw * th);
+            if (!used)
+                return false;
+            pos += used;
+
+            // set tile
+            for (uint32_t y = 0; y < th; ++y)
+                RLE_pvt::copy(out_row(tile.ymin + y) + map[c], &in[y * tw], tw,
+                              1, pbytes);
         }
+    } else {
+        for (uint32_t y = 0; y < th; ++y) {
+            uint8_t* out_p      = out_row(tile.ymin + y);
+            const uint8_t* in_p = p + y * tw * pbytes;
+            for (uint32_t x = 0; x < tw; ++x, in_p += pbytes) {
+                // map BGR(A) to RGB(A)
+                for (int c = channels - 1; c >= 0; --c, out_p += cbytes)
+                    memcpy(out_p, in_p + c * cbytes, cbytes);
+            }
+        }
+        // swap endianness
+        if (cbytes == 2 && littleendian())
+            for (uint32_t y = 0; y < th; ++y)
+                swap_endian((uint16_t*)out_row(tile.ymin + y), tw * channels);
     }
-    const size_t r = in - _in;
-    return r;
+    return true;
 }
 
 OIIO_PLUGIN_NAMESPACE_END
@@ -10,11 +10,15 @@
 #include <iostream>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <regex>
+#include <sstream>
+#include <utility>
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 
@@ -32,34 +36,115 @@ static std::vector<std::string> filenames;
 
 
 
-static bool
-grep_file(const std::string& filename, std::regex& re,
-          bool ignore_nonimage_files = false)
+// What to search: a file, or a directory whose name is printed (with -d)
+// before the files within it. `err` holds an error to report in its place.
+struct SearchItem {
+    std::string name;
+    bool directory = false;
+    bool toplevel  = false;  // named on the command line
+    std::string err;
+};
+
+
+
+// One directory found by the walk, and its entries, each noting whether
+// it's a directory (and if so, which one in the next level of the walk).
+struct WalkDir {
+    std::string name;
+    std::vector<std::pair<std::string, int>> entries;
+};
+
+
+
+// Append to `items` the contents of directory `d` of the walk, depth first
+// in the order they were listed, as the serial recursion would.
+static void
+flatten_walk(const std::vector<std::vector<WalkDir>>& levels, int level, int d,
+             std::vector<SearchItem>& items)
 {
-    if (!Filesystem::exists(filename)) {
-        std::cerr << "igrep: " << filename << ": No such file or directory\n";
-        return false;
+    const WalkDir& dir(levels[level][d]);
+    SearchItem item;
+    item.name      = dir.name;
+    item.directory = true;
+    items.push_back(item);
+    for (auto& e : dir.entries) {
+        if (e.second >= 0) {
+            flatten_walk(levels, level + 1, e.second, items);
+        } else {
+            SearchItem item;
+            item.name = e.first;
+            items.push_back(item);
+        }
     }
+}
+
 
-    if (Filesystem::is_directory(filename)) {
-        if (!recursive)
-            return false;
-        if (print_dirs) {
-            std::cout << "(" << filename << "/)\n";
-            std::cout.flush();
+
+// Turn the command line filenames into the list of everything to search,
+// listing each level of directories (when recursive) in parallel.
+static std::vector<SearchItem>
+search_items()
+{
+    std::vector<SearchItem> items;
+    std::vector<std::vector<WalkDir>> levels(1);
+    std::vector<int> toplevel_dir(filenames.size(), -1);
+    for (size_t f = 0; f < filenames.size(); ++f) {
+        if (recursive && Filesystem::is_directory(filenames[f])) {
+            toplevel_dir[f] = int(levels[0].size());
+            levels[0].emplace_back();
+            levels[0].back().name = filenames[f];
+        }
+    }
+    for (size_t level = 0; levels[level].size(); ++level) {
+        std::vector<WalkDir>& dirs(levels[level]);
+        parallel_for(0, int64_t(dirs.size()), [&](int64_t d) {
+            std::vector<std::string> entries;
+            Filesystem::get_directory_entries(dirs[d].name, entries);
+            for (auto& e : entries)
+                dirs[d].entries.emplace_back(e, Filesystem::is_directory(e)
+                                                     ? 0
+                                                     : -1);
+        });
+        // Number the subdirectories, which make up the next level
+        levels.emplace_back();
+        for (auto& dir : levels[level]) {
+            for (auto& e : dir.entries) {
+                if (e.second >= 0) {
+                    e.second = int(levels[level + 1].size());
+                    levels[level + 1].emplace_back();
+                    levels[level + 1].back().name = e.first;
+                }
+            }
         }
-        bool r = false;
-        std::vector<std::string> directory_entries;
-        Filesystem::get_directory_entries(filename, directory_entries);
-        for (const auto& d : directory_entries)
-            r |= grep_file(d, re, true);
-        return r;
     }
 
-    auto in = ImageInput::open(filename);
+    for (size_t f = 0; f < filenames.size(); ++f) {
+        if (toplevel_dir[f] >= 0) {
+            flatten_walk(levels, 0, toplevel_dir[f], items);
+        } else if (!Filesystem::is_directory(filenames[f])) {
+            SearchItem item;
+            item.name     = filenames[f];
+            item.toplevel = true;
+            if (!Filesystem::exists(filenames[f]))
+                item.err = Strutil::fmt::format(
+                    "igrep: {}: No such file or directory\n", filenames[f]);
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+
+
+static bool
+grep_file(const std::string& filename, const std::regex& re,
+          bool ignore_nonimage_files, std::ostream& out, std::ostream& err)
+{
+    auto in = ImageInput::open_header(filename);
     if (!in.get()) {
+        std::string e = geterror();
         if (!ignore_nonimage_files)
-            std::cerr << geterror() << "\n";
+            err << e << "\n";
         return false;
     }
     ImageSpec spec = in->spec();
@@ -67,7 +152,7 @@ grep_file(const std::string& filename, std::regex& re,
     if (file_match) {
         bool match = std::regex_search(filename, re);
         if (match && !invert_match) {
-            std::cout << filename << "\n";
+            out << filename << "\n";
             return true;
         }
     }
@@ -87,11 +172,11 @@ grep_file(const std::string& filename, std::regex& re,
                     found |= match;
                     if (match && !invert_match) {
                         if (list_files) {
-                            std::cout << filename << "\n";
+                            out << filename << "\n";
                             return found;
                         }
-                        std::cout << filename << ": " << p.name() << " = "
-                                  << ((const char**)p.data())[i] << "\n";
+                        out << filename << ": " << p.name() << " = "
+                            << ((const char**)p.data())[i] << "\n";
                     }
                 }
             }
@@ -101,13 +186,49 @@ grep_file(const std::string& filename, std::regex& re,
     if (invert_match) {
         found = !found;
         if (found)
-            std::cout << filename << "\n";
+            out << filename << "\n";
     }
     return found;
 }
 
 
 
+// Search all the items, many files at once, printing the results in order
+// as soon as all the items before them are done.
+static void
+grep_items(const std::vector<SearchItem>& items, const std::regex& re)
+{
+    const size_t n = items.size();
+    std::vector<std::string> outs(n), errs(n);
+    std::vector<char> done(n, 0);
+    std::mutex print_mutex;
+    size_t printed = 0;
+    parallel_for_chunked(0, int64_t(n), 16, [&](int64_t b, int64_t e) {
+        for (int64_t i = b; i < e; ++i) {
+            const SearchItem& item(items[i]);
+            std::ostringstream out, err;
+            if (item.err.size())
+                err << item.err;
+            else if (item.directory && print_dirs)
+                out << "(" << item.name << "/)\n";
+            else if (!item.directory)
+                grep_file(item.name, re, !item.toplevel, out, err);
+            std::lock_guard<std::mutex> lock(print_mutex);
+            outs[i] = out.str();
+            errs[i] = err.str();
+            done[i] = 1;
+            for (; printed < n && done[printed]; ++printed) {
+                std::cout << outs[printed] << std::flush;
+                std::cerr << errs[printed];
+                std::string().swap(outs[printed]);
+                std::string().swap(errs[printed]);
+            }
+        }
+    });
+}
+
+
+
 static int
 parse_files(int argc, const char* argv[])
 {
@@ -154,6 +275,9 @@ main(int argc, const char* argv[])
       .help("Print directories (when recursive)");
     ap.arg("-a", &all_subimages)
       .help("Search all subimages of each file");
+    ap.arg("-speccache")
+      .help("Directory that caches headers, so unchanged files aren't opened")
+      .metavar("DIR");
 
     // clang-format on
     ap.parse(argc, argv);
@@ -163,14 +287,17 @@ main(int argc, const char* argv[])
         return help ? EXIT_SUCCESS : EXIT_FAILURE;
     }
 
+    std::string speccache = ap["speccache"].get();
+    if (speccache.size())
+        OIIO::attribute("spec_cache", speccache);
+
     auto flag = std::regex_constants::grep;
     if (ap["E"].get<int>())
         flag = std::regex_constants::extended;
     if (ap["i"].get<int>())
         flag |= std::regex_constants::icase;
     std::regex re(pattern, flag);
-    for (auto&& s : filenames)
-        grep_file(s, re);
+    grep_items(search_items(), re);
 
     return 0;
 }
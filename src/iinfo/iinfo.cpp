@@ -9,8 +9,10 @@
 #include <ctime>
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <memory>
 #include <regex>
+#include <tuple>
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/deepdata.h>
@@ -19,6 +21,7 @@
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 
@@ -84,8 +87,8 @@ print_sha1(ImageInput* input)
 // Stats
 
 static bool
-read_input(const std::string& filename, ImageBuf& img, int subimage = 0,
-           int miplevel = 0)
+read_input(const std::string& filename, ImageBuf& img, std::string& err,
+           int subimage = 0, int miplevel = 0)
 {
     if (img.subimage() >= 0 && img.subimage() == subimage)
         return true;
@@ -94,25 +97,25 @@ read_input(const std::string& filename, ImageBuf& img, int subimage = 0,
         && img.read(subimage, miplevel, false, TypeDesc::FLOAT))
         return true;
 
-    std::cerr << "iinfo ERROR: Could not read " << filename << ":\n\t"
-              << img.geterror() << "\n";
+    err += Strutil::fmt::format("iinfo ERROR: Could not read {}:\n\t{}\n",
+                                filename, img.geterror());
     return false;
 }
 
 
 
 static void
-print_stats_num(float val, int maxval, bool round)
+print_stats_num(std::string& out, float val, int maxval, bool round)
 {
     if (maxval == 0) {
-        printf("%f", val);
+        out += Strutil::sprintf("%f", val);
     } else {
         float fval = val * static_cast<float>(maxval);
         if (round) {
             int v = static_cast<int>(roundf(fval));
-            printf("%d", v);
+            out += Strutil::sprintf("%d", v);
         } else {
-            printf("%0.2f", fval);
+            out += Strutil::sprintf("%0.2f", fval);
         }
     }
 }
@@ -155,88 +158,102 @@ get_intsample_maxval(const ImageSpec& spec)
 
 
 static void
-print_stats_footer(unsigned int maxval)
+print_stats_footer(std::string& out, unsigned int maxval)
 {
     if (maxval == 0)
-        printf("(float)");
+        out += "(float)";
     else
-        printf("(of %u)", maxval);
+        out += Strutil::sprintf("(of %u)", maxval);
 }
 
 
-static void
-print_stats(const std::string& filename, const ImageSpec& originalspec,
-            int subimage = 0, int miplevel = 0, bool indentmip = false)
+// The stats of one subimage and MIP level: the report, and any errors.
+struct StatsReport {
+    std::string out, err;
+};
+
+// Stats computed ahead of time, by (filename, subimage, miplevel)
+static std::map<std::tuple<std::string, int, int>, StatsReport> stats_reports;
+
+
+
+static StatsReport
+stats_report(const std::string& filename, const ImageSpec& originalspec,
+             int subimage, int miplevel, bool indentmip)
 {
     const char* indent = indentmip ? "      " : "    ";
+    StatsReport report;
+    std::string& out(report.out);
 
     ImageBuf input;
-    if (!read_input(filename, input, subimage, miplevel)) {
-        // Note: read_input prints an error message if one occurs
-        return;
+    if (!read_input(filename, input, report.err, subimage, miplevel)) {
+        // Note: read_input reports an error message if one occurs
+        return report;
     }
 
     PixelStats stats = computePixelStats(input);
     if (!stats.min.size()) {
-        printf("%sStats: (unable to compute)\n", indent);
+        out += Strutil::sprintf("%sStats: (unable to compute)\n", indent);
         if (input.has_error())
-            std::cerr << "Error: " << input.geterror() << "\n";
-        return;
+            report.err += Strutil::fmt::format("Error: {}\n",
+                                               input.geterror());
+        return report;
     }
 
     // The original spec is used, otherwise the bit depth will
     // be reported incorrectly (as FLOAT)
     unsigned int maxval = (unsigned int)get_intsample_maxval(originalspec);
 
-    printf("%sStats Min: ", indent);
+    out += Strutil::sprintf("%sStats Min: ", indent);
     for (unsigned int i = 0; i < stats.min.size(); ++i) {
-        print_stats_num(stats.min[i], maxval, true);
-        printf(" ");
+        print_stats_num(out, stats.min[i], maxval, true);
+        out += ' ';
     }
-    print_stats_footer(maxval);
-    printf("\n");
+    print_stats_footer(out, maxval);
+    out += '\n';
 
-    printf("%sStats Max: ", indent);
+    out += Strutil::sprintf("%sStats Max: ", indent);
     for (unsigned int i = 0; i < stats.max.size(); ++i) {
-        print_stats_num(stats.max[i], maxval, true);
-        printf(" ");
+        print_stats_num(out, stats.max[i], maxval, true);
+        out += ' ';
     }
-    print_stats_footer(maxval);
-    printf("\n");
+    print_stats_footer(out, maxval);
+    out += '\n';
 
-    printf("%sStats Avg: ", indent);
+    out += Strutil::sprintf("%sStats Avg: ", indent);
     for (unsigned int i = 0; i < stats.avg.size(); ++i) {
-        print_stats_num(stats.avg[i], maxval, false);
-        printf(" ");
+        print_stats_num(out, stats.avg[i], maxval, false);
+        out += ' ';
     }
-    print_stats_footer(maxval);
-    printf("\n");
+    print_stats_footer(out, maxval);
+    out += '\n';
 
-    printf("%sStats StdDev: ", indent);
+    out += Strutil::sprintf("%sStats StdDev: ", indent);
     for (unsigned int i = 0; i < stats.stddev.size(); ++i) {
-        print_stats_num(stats.stddev[i], maxval, false);
-        printf(" ");
+        print_stats_num(out, stats.stddev[i], maxval, false);
+        out += ' ';
     }
-    print_stats_footer(maxval);
-    printf("\n");
+    print_stats_footer(out, maxval);
+    out += '\n';
 
-    printf("%sStats NanCount: ", indent);
+    out += Strutil::sprintf("%sStats NanCount: ", indent);
     for (unsigned int i = 0; i < stats.nancount.size(); ++i) {
-        printf("%llu ", (unsigned long long)stats.nancount[i]);
+        out += Strutil::sprintf("%llu ", (unsigned long long)stats.nancount[i]);
     }
-    printf("\n");
+    out += '\n';
 
-    printf("%sStats InfCount: ", indent);
+    out += Strutil::sprintf("%sStats InfCount: ", indent);
     for (unsigned int i = 0; i < stats.infcount.size(); ++i) {
-        printf("%llu ", (unsigned long long)stats.infcount[i]);
+        out += Strutil::sprintf("%llu ", (unsigned long long)stats.infcount[i]);
     }
-    printf("\n");
+    out += '\n';
 
-    printf("%sStats FiniteCount: ", indent);
+    out += Strutil::sprintf("%sStats FiniteCount: ", indent);
     for (unsigned int i = 0; i < stats.finitecount.size(); ++i) {
-        printf("%llu ", (unsigned long long)stats.finitecount[i]);
+        out += Strutil::sprintf("%llu ",
+                                (unsigned long long)stats.finitecount[i]);
     }
-    printf("\n");
+    out += '\n';
 
     if (input.deep()) {
         const DeepData* dd(input.deepdata());
@@ -253,39 +270,105 @@ print_stats(const std::string& filename, const ImageSpec& originalspec,
             if (c == 0)
                 ++emptypixels;
         }
-        printf("%sMin deep samples in any pixel : %llu\n", indent,
-               (unsigned long long)minsamples);
-        printf("%sMax deep samples in any pixel : %llu\n", indent,
-               (unsigned long long)maxsamples);
-        printf("%sAverage deep samples per pixel: %.2f\n", indent,
-               double(totalsamples) / double(npixels));
-        printf("%sTotal deep samples in all pixels: %llu\n", indent,
-               (unsigned long long)totalsamples);
-        printf("%sPixels with deep samples   : %llu\n", indent,
-               (unsigned long long)(npixels - emptypixels));
-        printf("%sPixels with no deep samples: %llu\n", indent,
-               (unsigned long long)emptypixels);
+        out += Strutil::sprintf("%sMin deep samples in any pixel : %llu\n",
+                                indent, (unsigned long long)minsamples);
+        out += Strutil::sprintf("%sMax deep samples in any pixel : %llu\n",
+                                indent, (unsigned long long)maxsamples);
+        out += Strutil::sprintf("%sAverage deep samples per pixel: %.2f\n",
+                                indent, double(totalsamples) / double(npixels));
+        out += Strutil::sprintf("%sTotal deep samples in all pixels: %llu\n",
+                                indent, (unsigned long long)totalsamples);
+        out += Strutil::sprintf("%sPixels with deep samples   : %llu\n",
+                                indent,
+                                (unsigned long long)(npixels - emptypixels));
+        out += Strutil::sprintf("%sPixels with no deep samples: %llu\n",
+                                indent, (unsigned long long)emptypixels);
     } else {
         std::vector<float> constantValues(input.spec().nchannels);
         if (isConstantColor(input, &constantValues[0])) {
-            printf("%sConstant: Yes\n", indent);
-            printf("%sConstant Color: ", indent);
+            out += Strutil::sprintf("%sConstant: Yes\n", indent);
+            out += Strutil::sprintf("%sConstant Color: ", indent);
             for (unsigned int i = 0; i < constantValues.size(); ++i) {
-                print_stats_num(constantValues[i], maxval, false);
-                printf(" ");
+                print_stats_num(out, constantValues[i], maxval, false);
+                out += ' ';
             }
-            print_stats_footer(maxval);
-            printf("\n");
+            print_stats_footer(out, maxval);
+            out += '\n';
         } else {
-            printf("%sConstant: No\n", indent);
+            out += Strutil::sprintf("%sConstant: No\n", indent);
         }
 
         if (isMonochrome(input)) {
-            printf("%sMonochrome: Yes\n", indent);
+            out += Strutil::sprintf("%sMonochrome: Yes\n", indent);
         } else {
-            printf("%sMonochrome: No\n", indent);
+            out += Strutil::sprintf("%sMonochrome: No\n", indent);
+        }
+    }
+    return report;
+}
+
+
+
+// Compute ahead of time the stats that will be printed for all the files,
+// for all their subimages and MIP levels at once, rather than one at a
+// time as they're printed.
+static void
+precompute_stats()
+{
+    struct Job {
+        std::string filename;
+        ImageSpec originalspec;
+        int subimage, miplevel, nmip;
+    };
+    std::vector<Job> jobs;
+    for (auto&& filename : filenames) {
+        auto in = ImageInput::open_header(filename);
+        if (!in)
+            continue;
+        ImageSpec spec;
+        for (int s = 0; (subimages || s == 0) && in->seek_subimage(s, 0, spec);
+             ++s) {
+            int nmip = 1;
+            ImageSpec mipspec;
+            while (in->seek_subimage(s, nmip, mipspec))
+                ++nmip;
+            for (int m = 0; m < nmip; ++m)
+                jobs.push_back({ filename, spec, s, m, nmip });
         }
     }
+
+    std::vector<StatsReport> reports(jobs.size());
+    parallel_for_chunked(0, int64_t(jobs.size()), 1, [&](int64_t b, int64_t) {
+        const Job& job(jobs[b]);
+        reports[b] = stats_report(job.filename, job.originalspec, job.subimage,
+                                  job.miplevel, job.nmip > 1);
+    });
+    for (size_t i = 0; i < jobs.size(); ++i) {
+        auto key = std::make_tuple(jobs[i].filename, jobs[i].subimage,
+                                   jobs[i].miplevel);
+        stats_reports[key] = std::move(reports[i]);
+    }
+}
+
+
+
+static void
+print_stats(const std::string& filename, const ImageSpec& originalspec,
+            int subimage = 0, int miplevel = 0, bool indentmip = false)
+{
+    StatsReport report;
+    auto found = stats_reports.find(
+        std::make_tuple(filename, subimage, miplevel));
+    if (found != stats_reports.end()) {
+        report = std::move(found->second);
+        stats_reports.erase(found);
+    } else {
+        report = stats_report(filename, originalspec, subimage, miplevel,
+                              indentmip);
+    }
+    fputs(report.out.c_str(), stdout);
+    fflush(stdout);
+    std::cerr << report.err;
 }
 
 
@@ -664,10 +747,17 @@ main(int argc, const char* argv[])
         longestname = std::max(longestname, s.length());
     longestname = std::min(longestname, (size_t)40);
 
+    if (compute_stats
+        && (metamatch.empty() || std::regex_search("stats", field_re)))
+        precompute_stats();
+
     int returncode      = EXIT_SUCCESS;
     long long totalsize = 0;
     for (auto&& s : filenames) {
-        auto in = ImageInput::open(s);
+        // Unless we need the pixels, the headers are all we read (and they
+        // may come from the "spec_cache", if one is set up).
+        auto in = (compute_sha1 || compute_stats) ? ImageInput::open(s)
+                                                  : ImageInput::open_header(s);
         if (!in) {
             std::string err = geterror();
             if (err.empty())
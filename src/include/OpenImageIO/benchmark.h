@@ -7,6 +7,7 @@
 #pragma once
 
 #include <iostream>
+#include <memory>
 #include <vector>
 
 #include <OpenImageIO/function_view.h>
@@ -122,11 +123,52 @@ OIIO_FORCEINLINE void clobber (T& p, Ts&... ps)
 ///   known constants, and it is probably smart to ensure that all variables
 ///   acccessed by your code should be passed to clobber() before running
 ///   the benchmark, to confuse the compiler into not assuming its value.
+///
+/// Every benchmark run by any Benchmarker is also recorded for the whole
+/// process (see all_results()), so that programs full of benchmarks can
+/// feed a performance-regression dashboard without any changes:
+///
+/// * If the environment variable `OIIO_BENCHMARK_OUTPUT` names a file, all
+///   the results are written to it (see write_results()) when the program
+///   exits.
+///
+/// * If `OIIO_BENCHMARK_BASELINE` names a file of earlier results, the
+///   program prints a comparison against it when it exits, listing every
+///   benchmark that got slower by more than `OIIO_BENCHMARK_THRESHOLD`
+///   (a fraction, default 0.05).
+
+namespace pvt {
+class PerfEvents;
+}
 
 class OIIO_UTIL_API Benchmarker {
 public:
     Benchmarker() {}
 
+    // Per-iteration counts of hardware events (the median across trials),
+    // when they are requested with hw_counters(true) and available.
+    struct Counters {
+        bool valid           = false;
+        double cycles        = 0.0;
+        double instructions  = 0.0;
+        double cache_misses  = 0.0;
+        double branch_misses = 0.0;
+    };
+
+    // Everything known about one benchmark run. All times are seconds per
+    // iteration.
+    struct Result {
+        std::string name;
+        size_t trials     = 0;
+        size_t iterations = 0;
+        size_t work       = 1;
+        double avg        = 0.0;
+        double stddev     = 0.0;
+        double range      = 0.0;
+        double median     = 0.0;
+        Counters counters;
+    };
+
     // Calling Benchmarker like a function (operator()) executes the
     // benchmark. This process runs func(args...), several trials, each
     // trial with many iterations. The value returned is the best estimate
@@ -136,6 +178,7 @@ public:
     {
         m_name = name;
         run(func, args...);
+        record_result();
         if (verbose())
             std::cout << (*this) << std::endl;
         return avg();
@@ -226,8 +269,72 @@ public:
     }
     Unit units() const { return m_units; }
 
+    // Control the number of untimed warmup trials, run after the number of
+    // iterations is settled and before the timed trials, to let caches,
+    // branch predictors, and CPU clock speeds reach their steady state.
+    // The default is 0.
+    Benchmarker& warmup(size_t val)
+    {
+        m_warmup = val;
+        return *this;
+    }
+    size_t warmup() const { return m_warmup; }
+
+    // Control robust outlier exclusion: after exclude_outliers() trims the
+    // fastest and slowest trials, also drop any trial more than this many
+    // median absolute deviations from the median. The default, 0, doesn't
+    // do this. A value around 3 rejects trials disturbed by other activity
+    // on the machine while keeping the ordinary variation.
+    Benchmarker& outlier_mad(double k)
+    {
+        m_outlier_mad = k;
+        return *this;
+    }
+    double outlier_mad() const { return m_outlier_mad; }
+
+    // Control whether to count hardware events (cycles, instructions, and
+    // cache and branch misses) of the calling thread during the timed
+    // trials. This is only supported on Linux, through perf_event_open,
+    // when the kernel permits it (see /proc/sys/kernel/perf_event_paranoid);
+    // otherwise counters() will not be valid.
+    Benchmarker& hw_counters(bool on)
+    {
+        m_hw_counters = on;
+        return *this;
+    }
+    bool hw_counters() const { return m_hw_counters; }
+
+    // The hardware event counts of the last benchmark.
+    const Counters& counters() const { return m_counters; }
+
     const std::string& name() const { return m_name; }
 
+    // The full record of the last benchmark.
+    Result result() const;
+
+    // All the benchmarks run so far, by every Benchmarker in the process.
+    static std::vector<Result> all_results();
+
+    // Write `results` (by default, all_results()) to `filename`, as CSV if
+    // it ends in ".csv" and as JSON otherwise, with times in ns. Return
+    // true for success.
+    static bool write_results(string_view filename);
+    static bool write_results(string_view filename,
+                              const std::vector<Result>& results);
+
+    // Read results written by write_results(). Return true for success.
+    static bool read_results(string_view filename,
+                             std::vector<Result>& results);
+
+    // Compare all_results() with the baseline results in `filename`, as
+    // written by write_results(), matching benchmarks by name. Report to
+    // `out` (if not null) each benchmark whose median time grew by more
+    // than the fraction `threshold`, and return how many did, or -1 if
+    // the baseline couldn't be read.
+    static int compare_to_baseline(string_view filename,
+                                   double threshold  = 0.05,
+                                   std::ostream* out = &std::cout);
+
 private:
     size_t m_iterations      = 0;
     size_t m_user_iterations = 0;
@@ -243,6 +350,12 @@ private:
     int m_verbose          = 1;
     int m_indent           = 0;
     Unit m_units           = Unit::autounit;
+    size_t m_warmup        = 0;
+    double m_outlier_mad   = 0.0;
+    bool m_hw_counters     = false;
+    Counters m_counters;
+    std::vector<double> m_counter_samples;  // per trial, 4 events each
+    std::shared_ptr<pvt::PerfEvents> m_perf;
 
     template<typename FUNC, typename... ARGS>
     double run(FUNC func, ARGS&&... args)
@@ -252,11 +365,19 @@ private:
         else
             m_iterations = determine_iterations(func, args...);
         m_times.resize(m_trials);
+        for (size_t w = 0; w < m_warmup; ++w)
+            do_trial(m_iterations, func, args...);
 
         double overhead = iteration_overhead() * iterations();
-        for (auto& t : m_times)
-            t = std::max(0.0, do_trial(m_iterations, func, args...) - overhead);
+        counters_begin();
+        for (size_t i = 0; i < m_trials; ++i) {
+            counters_start();
+            double t = do_trial(m_iterations, func, args...);
+            counters_stop(i);
+            m_times[i] = std::max(0.0, t - overhead);
+        }
         compute_stats();
+        counters_end();
         return avg();
     }
 
@@ -294,6 +415,11 @@ private:
     void compute_stats() { compute_stats(m_times, m_iterations); }
     void compute_stats(std::vector<double>& times, size_t iterations);
     double iteration_overhead();
+    void counters_begin();
+    void counters_start();
+    void counters_stop(size_t trial);
+    void counters_end();
+    void record_result();
 
     friend OIIO_UTIL_API std::ostream& operator<<(std::ostream& out,
                                              const Benchmarker& bench);
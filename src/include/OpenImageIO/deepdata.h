@@ -93,6 +93,22 @@ public:
     /// Return the size (in bytes) for all channels of one sample.
     size_t samplesize() const;
 
+    /// Is the sample data planar -- all the samples of each channel in one
+    /// contiguous array -- rather than interleaved, with all channels of
+    /// each sample together (the default)?
+    bool planar() const;
+
+    /// Switch the sample data between planar and interleaved storage,
+    /// converting any samples already present. The layout is kept through
+    /// `clear()` and `init()`, so an image reader will fill in a planar
+    /// `DeepData` without needing to convert it afterwards.
+    void set_planar(bool planar);
+
+    /// Return the distance (in bytes) between successive samples of
+    /// channel `c` within a pixel: `samplesize()` if interleaved, or
+    /// `channelsize(c)` if planar.
+    size_t sample_stride(int c) const;
+
     /// Retrieve the number of samples for the given pixel index.
     int samples(int64_t pixel) const;
 
@@ -112,6 +128,12 @@ public:
     /// pixel index.
     int capacity(int64_t pixel) const;
 
+    /// Set the capacity of all pixels at once, moving the sample data at
+    /// most once, no matter how many pixels grow. As with `set_capacity()`,
+    /// capacities already allocated are never reduced. The
+    /// `capacity.size()` is required to match `pixels()`.
+    void set_all_capacity(cspan<unsigned int> capacity);
+
     /// Insert `n` samples of the specified pixel, betinning at the sample
     /// position index. After insertion, the new samples will have
     /// uninitialized values.
@@ -143,12 +165,25 @@ public:
     void* data_ptr(int64_t pixel, int channel, int sample);
     const void* data_ptr(int64_t pixel, int channel, int sample) const;
 
+    /// For a planar `DeepData`, return all the samples of a float channel
+    /// of a pixel, which are contiguous, as a span suited to vectorized
+    /// loops. The span is empty if the `DeepData` is not planar, the
+    /// channel is not float, or the pixel has no samples. The same caveats
+    /// about pointer invalidation as for `data_ptr()` apply.
+    span<float> float_samples(int64_t pixel, int channel);
+    cspan<float> float_samples(int64_t pixel, int channel) const;
+
     cspan<TypeDesc> all_channeltypes() const;
     cspan<unsigned int> all_samples() const;
+    /// Return all the sample data, laid out according to `planar()`.
     cspan<char> all_data() const;
 
-    /// Fill in the vector with pointers to the start of the first
-    /// channel for each pixel.
+    /// Return the number of bytes of memory this DeepData holds, including
+    /// the per-pixel sample counts as well as the sample data.
+    size_t memsize() const;
+
+    /// Fill in the vector with pointers to the first sample of each channel
+    /// of each pixel. Successive samples are `sample_stride(c)` apart.
     void get_pointers(std::vector<void*>& pointers) const;
 
     /// Copy a deep sample from `src` to this `DeepData`. They must have the
@@ -20,8 +20,11 @@
 
 #include <cstdint>
 #include <cstdio>
+#include <cstring>
 #include <ctime>
 #include <fstream>
+#include <future>
+#include <memory>
 #include <mutex>
 #include <string>
 #include <vector>
@@ -46,6 +49,8 @@
 
 OIIO_NAMESPACE_BEGIN
 
+class thread_pool;
+
 #if OIIO_FILESYSTEM_USE_STDIO_FILEBUF
 // MingW uses GCC to build, but does not support having a wchar_t* passed as argument
 // of ifstream::open or ofstream::open. To properly support UTF-8 encoding on MingW we must
@@ -137,6 +142,41 @@ OIIO_UTIL_API bool get_directory_entries (const std::string &dirname,
                                bool recursive = false,
                                const std::string &filter_regex=std::string());
 
+/// One entry found by scan_directory().
+struct DirEntry {
+    std::string path;           ///< UTF-8 path, starting with the dirname
+    bool is_directory = false;  ///< Directory (following symlinks)?
+    bool is_regular   = false;  ///< Regular file (following symlinks)?
+    uint64_t size     = 0;      ///< Size in bytes, if options.stat
+    std::time_t mtime = 0;      ///< Modification time, if options.stat
+};
+
+/// Options for scan_directory().
+struct DirScanOptions {
+    bool recursive    = false;  ///< Also scan all subdirectories
+    bool files_only   = false;  ///< Only return regular files
+    bool stat         = false;  ///< Fill in the size and mtime of entries
+    int nthreads      = 0;      ///< Max threads to use (0 = all)
+    /// If not empty, only return entries whose file name (not the whole
+    /// path) entirely matches this regular expression. Subdirectories are
+    /// still searched when recursive, whether or not their names match.
+    std::string filter_regex;
+};
+
+/// Fill `entries` with the contents of directory `dirname` (or the current
+/// directory if it's empty), in no particular order. The type of each
+/// entry comes from the directory listing itself wherever the OS provides
+/// it, so unlike calling is_regular() on each name it needs no extra file
+/// system round trip per file, which matters on network file systems. A
+/// recursive scan lists the subdirectories at each depth in parallel, the
+/// optional `stat` of the entries is done in parallel, and the filter is
+/// applied as entries are found, so that the names that don't match never
+/// get collected. Return true if ok, false if `dirname` isn't a directory
+/// or the filter is not a valid regular expression.
+OIIO_UTIL_API bool scan_directory (const std::string &dirname,
+                         std::vector<DirEntry> &entries,
+                         const DirScanOptions &options = DirScanOptions());
+
 /// Return true if the UTF-8 encoded path is an "absolute" (not relative)
 /// path. If 'dot_is_absolute' is true, consider "./foo" absolute.
 OIIO_UTIL_API bool path_is_absolute (string_view path,
@@ -412,6 +452,32 @@ public:
     // Return the total size of the proxy data, in bytes.
     virtual size_t size () const { return 0; }
     virtual void flush () const { }
+    // If the proxy can hand out its bytes [offset,offset+size) in place,
+    // without copying (because it's backed by memory or a memory mapping),
+    // return them as a span that remains valid until the proxy is closed
+    // or destroyed. The span may be shorter than `size` if it would run
+    // past the end. Otherwise, return an empty span, and the caller should
+    // fall back to pread(). Like pread(), this is thread-safe.
+    virtual cspan<unsigned char> view (int64_t /*offset*/, size_t /*size*/) const {
+        return cspan<unsigned char>();
+    }
+
+    // One element of a batched read: read `size` bytes at `offset` into
+    // `buf[]`. Upon return from pread_batch(), `result` holds the number of
+    // bytes actually read.
+    struct ReadRequest {
+        void* buf      = nullptr;
+        size_t size    = 0;
+        int64_t offset = 0;
+        size_t result  = 0;
+    };
+    // Perform all of the reads in `requests`, in no particular order,
+    // returning true if every one of them was read in full. This is
+    // semantically just a series of pread() calls (and that is what the
+    // default implementation does), but proxies that can hand the whole
+    // batch to the OS at once (such as IOFile with io_uring on Linux) may
+    // override it to keep many reads in flight. Thread-safe like pread().
+    virtual bool pread_batch (span<ReadRequest> requests);
 
     Mode mode () const { return m_mode; }
     const std::string& filename () const { return m_filename; }
@@ -461,6 +527,7 @@ public:
     virtual size_t write(const void* buf, size_t size);
     virtual size_t pread(void* buf, size_t size, int64_t offset);
     virtual size_t pwrite(const void* buf, size_t size, int64_t offset);
+    virtual bool pread_batch(span<ReadRequest> requests);
     virtual size_t size() const;
     virtual void flush() const;
 
@@ -529,6 +596,7 @@ public:
     virtual size_t read(void* buf, size_t size);
     virtual size_t pread(void* buf, size_t size, int64_t offset);
     virtual size_t size() const { return m_buf.size(); }
+    virtual cspan<unsigned char> view(int64_t offset, size_t size) const;
 
     // Access the buffer (caveat emptor)
     cspan<unsigned char> buffer() const noexcept { return m_buf; }
@@ -537,6 +605,175 @@ protected:
     cspan<unsigned char> m_buf;
 };
 
+
+
+/// A read-only memory mapping of an entire file. The mapping stays valid
+/// until close() is called or the MappedFile is destroyed, so callers that
+/// hand out pointers into it should keep the MappedFile alive (for
+/// example, via a shared_ptr) for as long as those pointers are in use.
+/// Not every platform supports memory mapping; open() returns false if the
+/// file could not be mapped for any reason.
+class OIIO_UTIL_API MappedFile {
+public:
+    MappedFile() {}
+    MappedFile(string_view filename) { open(filename); }
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile() { close(); }
+
+    /// Map the named file, closing any file previously mapped. Return
+    /// true upon success.
+    bool open(string_view filename);
+    /// Unmap the file.
+    void close();
+    bool is_open() const noexcept { return m_data != nullptr; }
+
+    /// Access the mapped bytes (caveat emptor).
+    const unsigned char* data() const noexcept { return m_data; }
+    size_t size() const noexcept { return m_size; }
+    cspan<unsigned char> buffer() const noexcept
+    {
+        return cspan<unsigned char>(m_data, m_size);
+    }
+
+private:
+    const unsigned char* m_data = nullptr;
+    size_t m_size               = 0;
+#ifdef _WIN32
+    void* m_mapping = nullptr;  // HANDLE of the file mapping object
+#endif
+};
+
+
+
+/// IOProxy subclass for reading that memory maps the whole file, read-only
+/// (see MappedFile). read() and pread() are simply copies out of the
+/// mapping, and view() returns pointers straight into it, so readers that
+/// can consume bytes in place need no intermediate buffer at all. If the
+/// file can't be mapped, the proxy is left Closed (check `mode()` or
+/// `opened()`) with an error set.
+class OIIO_UTIL_API IOMMap : public IOProxy {
+public:
+    IOMMap(string_view filename);
+    IOMMap(const std::wstring& filename)
+        : IOMMap(Strutil::utf16_to_utf8(filename)) {}
+    virtual const char* proxytype() const { return "mmap"; }
+    virtual void close();
+    virtual bool seek(int64_t offset)
+    {
+        m_pos = offset;
+        return true;
+    }
+    virtual size_t read(void* buf, size_t size);
+    virtual size_t pread(void* buf, size_t size, int64_t offset);
+    virtual size_t size() const { return m_map.size(); }
+    virtual cspan<unsigned char> view(int64_t offset, size_t size) const;
+
+protected:
+    MappedFile m_map;
+};
+
+
+
+/// IOProxy wrapper for reading another proxy front to back in many small
+/// pieces. read() is served from a block of `blocksize` bytes; while the
+/// caller consumes it, the following block is read on `pool` in the
+/// background (if a pool is given), so that I/O overlaps decoding and each
+/// block costs one call into the underlying proxy rather than many. Seeking
+/// is free, and a read landing outside the buffered block just restarts
+/// the stream there. Reads at least a block long bypass the buffer, and
+/// pread() and view() pass straight through to the underlying proxy.
+///
+/// The wrapper owns `source` if it's passed as a unique_ptr.
+class OIIO_UTIL_API IOReadAhead : public IOProxy {
+public:
+    IOReadAhead(IOProxy* source, size_t blocksize = 256 * 1024,
+                thread_pool* pool = nullptr);
+    IOReadAhead(std::unique_ptr<IOProxy> source, size_t blocksize = 256 * 1024,
+                thread_pool* pool = nullptr);
+    virtual ~IOReadAhead();
+    virtual const char* proxytype() const { return "readahead"; }
+    virtual void close();
+    virtual bool seek(int64_t offset)
+    {
+        m_pos = offset;
+        return true;
+    }
+    virtual size_t read(void* buf, size_t size)
+    {
+        // Fast path: the whole request is in the current block.
+        if (m_pos >= m_bufstart
+            && m_pos + int64_t(size) <= m_bufstart + int64_t(m_buflen)) {
+            memcpy(buf, m_buf.data() + (m_pos - m_bufstart), size);
+            m_pos += int64_t(size);
+            return size;
+        }
+        return read_slow(buf, size);
+    }
+    virtual size_t pread(void* buf, size_t size, int64_t offset);
+    virtual bool pread_batch(span<ReadRequest> requests);
+    virtual size_t size() const;
+    virtual cspan<unsigned char> view(int64_t offset, size_t size) const;
+
+    // The proxy being wrapped.
+    IOProxy* source() const { return m_source; }
+
+private:
+    IOProxy* m_source = nullptr;
+    std::unique_ptr<IOProxy> m_owned_source;
+    size_t m_blocksize;
+    thread_pool* m_pool;
+    std::vector<unsigned char> m_buf;   // current block
+    int64_t m_bufstart = 0;
+    size_t m_buflen    = 0;
+    std::vector<unsigned char> m_next;  // block being read ahead
+    int64_t m_nextstart = -1;
+    std::future<size_t> m_nextread;
+
+    size_t read_slow(void* buf, size_t size);
+    void fill(int64_t pos);
+    void cancel_readahead();
+};
+
+
+
+/// ChangeWatcher reports the files that are written, replaced, renamed,
+/// deleted or touched within the directories it has been asked to watch,
+/// so that a cache of file contents can find out what went stale without
+/// checking every file. It uses inotify, so on other platforms, or when
+/// the process has run out of inotify instances, it's never valid(). It
+/// can't see changes made to network file systems by other machines.
+class OIIO_UTIL_API ChangeWatcher {
+public:
+    ChangeWatcher();
+    ~ChangeWatcher();
+    ChangeWatcher(const ChangeWatcher&) = delete;
+    ChangeWatcher& operator=(const ChangeWatcher&) = delete;
+
+    /// Can this watcher report changes?
+    bool valid() const noexcept;
+
+    /// Start watching the files in a directory ("" means the current
+    /// directory), if it isn't already. Return true if it's being watched,
+    /// or false if it can't be (for example, because it doesn't exist or
+    /// the system limit on watches has been reached).
+    bool watch(string_view dirname);
+
+    /// Wait up to `timeout_ms` milliseconds for changes (0 to just collect
+    /// any that are pending), and append the paths of the files that
+    /// changed -- the watched directory as it was given to watch(), then
+    /// the file's name -- to `changed`. A file may be listed more than
+    /// once. Return the number of paths appended, or -1 if the watcher
+    /// isn't valid or some changes may have been missed, because too many
+    /// piled up or a watched directory itself was moved or deleted.
+    int changes(std::vector<std::string>& changed, int timeout_ms = 0);
+
+    struct Impl;
+
+private:
+    std::unique_ptr<Impl> m_impl;
+};
+
 };  // namespace Filesystem
 
 OIIO_NAMESPACE_END
@@ -138,6 +138,25 @@ inline size_t xxhash (const Str& s, size_t seed=1771) {
     return xxhash (s.data(), s.length(), seed);
 }
 
+/// The 128 bit result of XXH3_128bits.
+struct XXH128_hash_t {
+    unsigned long long low64;
+    unsigned long long high64;
+};
+
+// XXH3 is the newer, much faster xxhash for large inputs, and matches the
+// upstream XXH3_64bits_withSeed / XXH3_128bits_withSeed exactly. Note that
+// its default seed is 0, not 1771 like XXH32/XXH64.
+unsigned long long OIIO_API XXH3_64bits (const void* input, size_t length,
+                                         unsigned long long seed=0);
+XXH128_hash_t      OIIO_API XXH3_128bits (const void* input, size_t length,
+                                          unsigned long long seed=0);
+
+inline size_t xxh3 (const void* input, size_t length, size_t seed=0)
+{
+    return size_t (XXH3_64bits (input, length, (unsigned long long)seed));
+}
+
 }   // end namespace xxhash
 
 
@@ -55,6 +55,23 @@ enum class InitializePixels { No = 0, Yes = 1 };
 
 
 
+/// Source of the memory that ImageBufs allocate for their own pixels,
+/// which may be installed with `ImageBuf::set_allocator()`. Both methods
+/// may be called concurrently from any thread. `deallocate()` is always
+/// passed the same size that was given to the `allocate()` call that
+/// returned `ptr`.
+class OIIO_API ImageBufAllocator {
+public:
+    virtual ~ImageBufAllocator() {}
+    /// Return at least `size` bytes aligned to at least 64 bytes, or
+    /// `nullptr` if that's not possible.
+    virtual void* allocate(size_t size) = 0;
+    /// Release memory obtained from `allocate(size)`.
+    virtual void deallocate(void* ptr, size_t size) = 0;
+};
+
+
+
 /// An ImageBuf is a simple in-memory representation of a 2D image.  It uses
 /// ImageInput and ImageOutput underneath for its file I/O, and has simple
 /// routines for setting and getting individual pixels, that hides most of
@@ -261,6 +278,15 @@ public:
     ImageBuf(string_view name, const ImageSpec& spec, void* buffer);
 
     /// Construct a copy of an ImageBuf.
+    ///
+    /// If `src` owns its pixel memory, the copy initially shares it rather
+    /// than duplicating it, and whichever of the two is first written to
+    /// -- through a writable `Iterator`, `setpixel()`, `set_pixels()`, the
+    /// non-const `localpixels()` or `pixeladdr()`, or `make_writable()` --
+    /// first makes itself a private copy. So copying an ImageBuf merely to
+    /// change its metadata costs no pixel copying at all. (Pointers to
+    /// pixel memory obtained *before* the copy was made are the exception:
+    /// writing through them is seen by both.)
     ImageBuf(const ImageBuf& src);
 
     /// Move the contents of an ImageBuf to another ImageBuf.
@@ -315,8 +341,9 @@ public:
     /// Make the ImageBuf be writable. That means that if it was previously
     /// backed by an ImageCache (storage was `IMAGECACHE`), it will force a
     /// full read so that the whole image is in local memory. This will
-    /// invalidate any current iterators on the image. It has no effect if
-    /// the image storage is not `IMAGECACHE`.
+    /// invalidate any current iterators on the image. If the pixels are
+    /// still shared with a copy of this ImageBuf, it makes a private copy
+    /// of them. Otherwise it has no effect.
     ///
     /// @param keep_cache_type
     ///             If true, preserve any ImageCache-forced data types (you
@@ -439,6 +466,21 @@ public:
               TypeDesc convert, ProgressCallback progress_callback = nullptr,
               void* progress_callback_data = nullptr);
 
+    /// Read only the pixels of the region `roi` (which is clipped to the
+    /// file's data window), including only its channel range, into local
+    /// memory. The ImageBuf's data window becomes that region, while the
+    /// full (display) window stays that of the file. Only the scanlines
+    /// or tiles that overlap the region are read from the file, which can
+    /// save a great deal of time and memory when you know that only a
+    /// small part of a big image will be used, as when it's about to be
+    /// cropped.
+    ///
+    /// @returns
+    ///             `true` upon success, or `false` if the read failed or
+    ///             `roi` does not overlap the data window.
+    bool read(int subimage, int miplevel, ROI roi,
+              TypeDesc convert = TypeDesc::UNKNOWN);
+
     /// Read the ImageSpec for the given file, subimage, and MIP level into
     /// the ImageBuf, but will not read the pixels or allocate any local
     /// storage (until a subsequent call to `read()`).  This is helpful if
@@ -653,6 +695,24 @@ public:
     /// data format conversion).
     ImageBuf copy(TypeDesc format /*= TypeDesc::UNKNOWN*/) const;
 
+    /// Return an ImageBuf that views the pixels of region `roi` (including
+    /// its channel range) of `this` in place, without copying them. The
+    /// view keeps the pixel coordinates of the region, and its data is
+    /// strided (see `pixel_stride()` and `scanline_stride()`) if it has
+    /// fewer channels or a narrower region than `this`.
+    ///
+    /// The view shares the pixel memory the way a copy of an ImageBuf
+    /// does: the first write to either of them gives the writer a private
+    /// copy (for the view, a contiguous one of just its own pixels), so
+    /// neither sees the other's changes, and the memory lives as long as
+    /// either of them uses it. If `this` wraps an application buffer, the
+    /// view sees later changes the application makes to it.
+    ///
+    /// A view is only possible if the pixels are in memory (not backed by
+    /// an ImageCache, and not deep) and `roi` is within the data window;
+    /// otherwise the result is an uninitialized ImageBuf.
+    ImageBuf view(ROI roi = {}) const;
+
     /// Swap the entire contents with another ImageBuf.
     void swap(ImageBuf& other) { std::swap(m_impl, other.m_impl); }
 
@@ -1022,6 +1082,19 @@ public:
     /// image being in RAM somewhere?
     bool cachedpixels() const;
 
+    /// Use `alloc` for the pixel memory of all ImageBufs that allocate it
+    /// from now on, or go back to the built-in allocator if it's empty.
+    /// Memory already allocated is handed back to whichever allocator it
+    /// came from when released.
+    ///
+    /// The built-in allocator keeps up to `"imagebuf:pool_MB"` (see
+    /// `OIIO::attribute()`) of recently released large buffers, grouped by
+    /// size class, and hands them out again to later ImageBufs of a similar
+    /// size. That saves the system allocator and the page faults of
+    /// touching fresh memory when temporaries are made over and over, as in
+    /// long chains of ImageBufAlgo operations.
+    static void set_allocator(std::shared_ptr<ImageBufAllocator> alloc);
+
     /// A pointer to the underlying ImageCache.
     ImageCache* imagecache() const;
 
@@ -1587,4 +1660,34 @@ protected:
 };
 
 
+
+/// Read the highest-resolution MIP level of every subimage of a file into
+/// its own locally-stored ImageBuf, opening the file only once. If the
+/// format reader supports concurrent reads of different subimages
+/// (`supports("concurrent_subimages")`, for example a multi-part OpenEXR
+/// file read with the OpenEXRCore library), the subimages are read in
+/// parallel; otherwise they are read one after another.
+///
+/// @param  filename
+///             The file to read.
+/// @param  convert
+///             The data type the pixels are converted to, or `UNKNOWN`
+///             (the default) to keep each subimage's native format.
+/// @param  nthreads
+///             The thread policy for the reads: 0 (the default) means to
+///             use the global OIIO "threads" attribute, 1 means read
+///             everything serially on the calling thread.
+/// @param  config
+///             Optional configuration hints passed to `ImageInput::open()`.
+///
+/// @returns
+///             One ImageBuf per subimage, in order. If the file could not
+///             be opened or any subimage could not be read, the result is
+///             empty and the error message may be retrieved with
+///             `OIIO::geterror()`.
+OIIO_API std::vector<ImageBuf>
+read_all_subimages(string_view filename, TypeDesc convert = TypeDesc::UNKNOWN,
+                   int nthreads = 0, const ImageSpec* config = nullptr);
+
+
 OIIO_NAMESPACE_END
@@ -272,7 +272,7 @@ bool OIIO_API checker (ImageBuf &dst, int width, int height, int depth,
 /// of `dst` or the ROI. Choosing different seed values will result in a
 /// different pattern, but for the same seed value, the noise at a given
 /// pixel coordinate (x,y,z) channel c will is completely deterministic and
-/// repeatable.
+/// repeatable, and identical for any `nthreads` or division of the ROI.
 ImageBuf OIIO_API noise (string_view noisetype,
                          float A = 0.0f, float B = 0.1f, bool mono = false,
                          int seed = 0, ROI roi={}, int nthreads=0);
@@ -396,6 +396,10 @@ ROI OIIO_API text_size (string_view text, int fontsize=16,
 /// fill value in `channelvalues[i]`. In-place operation is allowed (i.e.,
 /// `dst` and `src` the same image, but an extra copy will occur).
 ///
+/// If the result is a run of consecutive channels of `src`, in order, and
+/// the pixels of `src` are in memory, the result is an `ImageBuf::view()`
+/// of them: nothing is copied unless one of the two is written to.
+///
 /// @param  nchannels
 ///             The total number of channels that will be set up in the
 ///             `dst` image.
@@ -473,6 +477,11 @@ bool OIIO_API copy (ImageBuf &dst, const ImageBuf &src, TypeDesc convert=TypeUnk
 /// image plane or adjust the full/display window; it merely restricts which
 /// pixels are copied from `src` to `dst`.  (Note the difference compared to
 /// `cut()`).
+///
+/// If `roi` (with all channels) lies within the data window of `src` and
+/// its pixels are in memory, the result is an `ImageBuf::view()` of them,
+/// so nothing is copied unless one of the two is written to. The same
+/// goes for `cut()`.
 ImageBuf OIIO_API crop (const ImageBuf &src, ROI roi={}, int nthreads=0);
 /// Write to an existing image `dst` (allocating if it is uninitialized).
 bool OIIO_API crop (ImageBuf &dst, const ImageBuf &src, ROI roi={}, int nthreads=0);
@@ -906,6 +915,20 @@ bool OIIO_API over (ImageBuf &dst, const ImageBuf &A, const ImageBuf &B,
                     ROI roi={}, int nthreads=0);
 
 
+/// Composite a whole stack of `layers` in one pass, front-most first, so
+/// that the result is the same as `over(layers[0], over(layers[1], ...))`
+/// but without the intermediate images. Pixels stop accumulating once
+/// they are opaque, and rows stop reading layers once every pixel in them
+/// is. All layers must have the same number of channels
+/// and the same alpha channel. An uninitialized `dst` is sized to the
+/// union of the layers' pixel data windows.
+ImageBuf OIIO_API over (cspan<const ImageBuf*> layers,
+                        ROI roi={}, int nthreads=0);
+/// Write to an existing image `dst` (allocating if it is uninitialized).
+bool OIIO_API over (ImageBuf &dst, cspan<const ImageBuf*> layers,
+                    ROI roi={}, int nthreads=0);
+
+
 /// Just like `ImageBufAlgo::over()`, but inputs `A` and `B` must have
 /// designated 'z' channels, and on a pixel-by-pixel basis, the z values
 /// will determine which of `A` or `B` will be considered the foreground or
@@ -1017,6 +1040,61 @@ bool OIIO_API clamp (ImageBuf &dst, const ImageBuf &src,
 /// @}
 
 
+
+/// A chain of per-pixel operations on `src` that are only recorded as
+/// they are added, and then all done together by `eval()`, in a single
+/// pass over the pixels. Each strip of pixels is read from `src` once,
+/// goes through every operation while still in cache, and only the final
+/// result is written, without the full size intermediate image (and
+/// memory traffic) that each step costs when calling the equivalent
+/// ImageBufAlgo functions one after another. For example,
+///
+///     ImageBuf out = Expr(in).mul(gain).add(offset).clamp(0.0f, 1.0f)
+///                            .pow(1.0f / 2.2f).eval();
+///
+/// Values are carried as float from one operation to the next, so unlike
+/// separate calls, intermediate results are never rounded to the pixel
+/// type of `src`. Per-channel values follow the same conventions as the
+/// equivalent functions. `src` is referenced, not copied, and must stay
+/// alive until `eval()` is done.
+class OIIO_API Expr {
+public:
+    explicit Expr (const ImageBuf &src);
+    Expr (const Expr &other);
+    Expr (Expr &&other);
+    ~Expr ();
+
+    /// Add `b` to each pixel, as add().
+    Expr& add (cspan<float> b);
+    /// Subtract `b` from each pixel, as sub().
+    Expr& sub (cspan<float> b);
+    /// Multiply each pixel by `b`, as mul().
+    Expr& mul (cspan<float> b);
+    /// Raise each pixel to the power `b`, as pow().
+    Expr& pow (cspan<float> b);
+    /// Clamp each pixel, as clamp().
+    Expr& clamp (cspan<float> min=-std::numeric_limits<float>::max(),
+                 cspan<float> max=std::numeric_limits<float>::max(),
+                 bool clampalpha01 = false);
+    /// Apply a color transform to the first 3 or 4 channels, which must
+    /// exist, as colorconvert(). The processor is kept alive by the Expr.
+    Expr& colorconvert (std::shared_ptr<ColorProcessor> processor,
+                        bool unpremult = true);
+
+    /// Run the operations over the region `roi` of `src` and write the
+    /// results to `dst` (allocating it if it is uninitialized, with the
+    /// pixel type of `src`). `dst` may be the same image as `src`.
+    bool eval (ImageBuf &dst, ROI roi={}, int nthreads=0) const;
+    /// Run the operations and return the resulting image.
+    ImageBuf eval (ROI roi={}, int nthreads=0) const;
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+
+
 /// @defgroup maxminchan (Maximum / minimum of channels)
 /// @{
 ///
@@ -1250,6 +1328,20 @@ CompareResults OIIO_API compare (const ImageBuf &A, const ImageBuf &B,
                                  float failthresh, float warnthresh,
                                  ROI roi={}, int nthreads=0);
 
+/// Quickly decide whether two images match: return true if no more than
+/// `maxfail` pixels have a channel differing by more than `failthresh`,
+/// and no value differs by more than `hardfail`, using the same rules and
+/// default ROI as `compare()`. No statistics are gathered; tiles are
+/// compared in parallel and all of them stop as soon as the answer is
+/// known to be false. If both images are unmodified views of files through
+/// an ImageCache (and no `roi` is given), and the files carry the same
+/// `"oiio:SHA-1"` fingerprint of their pixels, no pixels are compared.
+bool OIIO_API compare_fastfail (const ImageBuf &A, const ImageBuf &B,
+                                float failthresh, imagesize_t maxfail = 0,
+                                float hardfail
+                                    = std::numeric_limits<float>::infinity(),
+                                ROI roi={}, int nthreads=0);
+
 /// Compare two images using Hector Yee's perceptual metric, returning
 /// the number of pixels that fail the comparison.  Only the first three
 /// channels (or first three channels specified by `roi`) are compared.
@@ -1415,6 +1507,19 @@ std::vector<imagesize_t> histogram (const ImageBuf &src, int channel=0,
                                     bool ignore_empty=false,
                                     ROI roi={}, int nthreads=0);
 
+/// Compute histograms of all channels `[roi.chbegin,roi.chend)` of `src`
+/// in a single pass over the pixels, with the same binning as
+/// `histogram()`. Return a vector of `bins` counts for each channel, one
+/// after the other, starting with channel `roi.chbegin`.
+///
+/// If there was an error, the returned vector will be empty, and an error
+/// message will be retrievable from src.geterror().
+OIIO_API
+std::vector<imagesize_t> histogram_channels (const ImageBuf &src,
+                                    int bins=256, float min=0.0f, float max=1.0f,
+                                    bool ignore_empty=false,
+                                    ROI roi={}, int nthreads=0);
+
 
 #ifndef DOXYGEN_SHOULD_SKIP_THIS
 /// DEPRECATED(1.9)
@@ -1469,6 +1574,11 @@ inline bool make_kernel (ImageBuf &dst, string_view name,
 /// it defaults to the full size `src`. If `normalized` is true, the kernel will
 /// be normalized for the  convolution, otherwise the original values will
 /// be used.
+///
+/// For 2D images, a kernel that is separable (the outer product of a row
+/// and a column, as the ones from `make_kernel()` are) is applied as two
+/// 1D passes, and a large non-separable kernel is applied via FFT, so the
+/// cost doesn't grow with the kernel area.
 ImageBuf OIIO_API convolve (const ImageBuf &src, const ImageBuf &kernel,
                             bool normalize = true, ROI roi={}, int nthreads=0);
 /// Write to an existing image `dst` (allocating if it is uninitialized).
@@ -1627,7 +1737,9 @@ bool OIIO_API fillholes_pushpull (ImageBuf &dst, const ImageBuf &src,
 ///
 /// Median filters are good for removing high-frequency detail smaller than
 /// the window size (including noise), without blurring edges that are
-/// larger than the window size.
+/// larger than the window size. For 8 bit images the cost per pixel does
+/// not depend on the window size, and for 16 bit images it grows only with
+/// the window height.
 ImageBuf OIIO_API median_filter (const ImageBuf &src,
                                  int width = 3, int height = -1,
                                  ROI roi={}, int nthreads=0);
@@ -1715,6 +1827,12 @@ bool OIIO_API erode (ImageBuf &dst, const ImageBuf &src,
 /// OpenColorIO support enabled, then the only transformations available are
 /// from "sRGB" to "linear" and vice versa.
 ///
+/// For 8 and 16 bit integer inputs, a transformation without channel
+/// crosstalk made by a `ColorConfig` is baked into per-channel lookup
+/// tables (once, and cached with the processor) whenever the image is big
+/// enough to be worth it. This gives exactly the same results, and is
+/// skipped when unpremultiplying.
+///
 /// @param  fromspace/tospace
 ///             For the varieties of `colorconvert()` that use named color
 ///             spaces, these specify the color spaces by name.
@@ -1819,6 +1937,44 @@ bool OIIO_API colormatrixtransform (ImageBuf &dst, const ImageBuf &src,
 #endif
 
 
+/// Return a copy of the pixels of `src` within the ROI, with the color
+/// channels decoded to linear by the transfer function `fromtransfer`,
+/// then transformed by the 4x4 matrix `M` just like
+/// `colormatrixtransform()`, then encoded by the transfer function
+/// `totransfer`. This is the common pattern of converting between color
+/// spaces that differ in primaries and encoding (such as sRGB-encoded
+/// camera images to a linear ACES working space), done in one pass over
+/// the pixels rather than one for each step. In-place operations
+/// (`dst` == `src`) are supported.
+///
+/// The transfer functions are named like the color spaces that are
+/// understood without OpenColorIO: `"linear"` (or `""`, for none),
+/// `"sRGB"`, `"Rec709"`, or `"Gamma"` followed by the exponent, such as
+/// `"Gamma2.2"`. An unknown name is an error. As with `colorconvert()`,
+/// the fourth channel (if it exists) is presumed to be alpha, any further
+/// channels are copied unaltered, and `unpremult` brackets the whole
+/// transform by dividing and multiplying by alpha.
+///
+/// For float pixels, the transfer functions are computed with a fast
+/// approximation of the power function, which differs from the exact one
+/// by about 1e-5 at most.
+#ifdef INCLUDED_IMATHMATRIX_H
+ImageBuf OIIO_API colormatrixtransfer (const ImageBuf &src,
+                                   const Imath::M44f& M,
+                                   string_view fromtransfer,
+                                   string_view totransfer,
+                                   bool unpremult=true, ROI roi={},
+                                   int nthreads=0);
+/// Write to an existing image `dst` (allocating if it is uninitialized).
+bool OIIO_API colormatrixtransfer (ImageBuf &dst, const ImageBuf &src,
+                                   const Imath::M44f& M,
+                                   string_view fromtransfer,
+                                   string_view totransfer,
+                                   bool unpremult=true, ROI roi={},
+                                   int nthreads=0);
+#endif
+
+
 /// Return a copy of the pixels of `src` within the ROI, applying an
 /// OpenColorIO "look" transform to the pixel values. In-place operations
 /// (`dst` == `src`) are supported.
@@ -2045,6 +2201,12 @@ enum MakeTextureMode {
 ///                                  output file doesn't already exist, or is
 ///                                  older than the input file, or was created
 ///                                  with different command-line arguments. (0)
+///    - `maketx:incremental` (int) :
+///                           If nonzero, and the input is a file, store a
+///                           hash of the file's contents and the conversion
+///                           settings in the texture as "oiio:SourceHash",
+///                           and skip making the texture if the output
+///                           already exists with a matching hash. (0)
 ///    - `maketx:constant_color_detect` (int) :
 ///                           If nonzero, detect images that are entirely
 ///                           one color, and change them to be low
@@ -2131,6 +2293,19 @@ enum MakeTextureMode {
 ///                           threshold. Zero causes the system to make a
 ///                           good guess at a reasonable threshold (e.g. 1
 ///                           GB). (0)
+///    - `maketx:stream` (int) :
+///                           If nonzero, build the MIP-map a few rows of
+///                           tiles at a time, writing tiles as they are
+///                           finished, rather than holding whole levels in
+///                           memory. Combined with a `maketx:read_local_MB`
+///                           threshold that leaves the input in the
+///                           ImageCache, this bounds the memory needed to
+///                           make very large textures. It only applies to
+///                           a plain texture with the "box" filter that
+///                           needs no resizing, sharpening, pixel shift,
+///                           custom MIP levels or overscan, and to file
+///                           formats with tiled MIP-maps; otherwise it is
+///                           ignored. (0)
 ///    - `maketx:forcefloat` (int) :
 ///                           Forces a conversion through float data for
 ///                           the sake of ImageBuf math. (1)
@@ -2176,6 +2351,18 @@ enum MakeTextureMode {
 ///                           When `maketx:cdf` is active, determines the
 ///                           number of bits to use for the size of the CDF
 ///                           table. (default: 8, meaning 256 bins)
+///    - `maketx:envlobes` (int) :
+///                           If nonzero, for the MakeTxEnvLatl modes, also
+///                           write the map convolved with GGX specular
+///                           lobes of increasing roughness and with the
+///                           cosine lobe to a companion texture (named
+///                           like "sky.lobes.exr" for "sky.exr"), for
+///                           environment lookups with a nonzero
+///                           `TextureOpt::roughness`. (default: 0)
+///    - `maketx:envlobes_res` (int) :
+///                           When `maketx:envlobes` is active, the width
+///                           of the level holding the sharpest lobe.
+///                           (default: 256)
 ///
 /// @param  mode
 ///    Describes what type of texture file we are creating and may
@@ -2231,6 +2418,29 @@ bool OIIO_API make_texture (MakeTextureMode mode,
                             string_view outputfilename,
                             const ImageSpec &config,
                             std::ostream *outstream = nullptr);
+
+/// One conversion for the batch version of make_texture.
+struct MakeTextureJob {
+    MakeTextureMode mode = MakeTxTexture;
+    std::string filename;        ///< Input file name.
+    std::string outputfilename;  ///< Output file name, or "" to make one
+                                 ///<   by changing the extension to ".tx".
+    ImageSpec config;            ///< Configuration, as for make_texture.
+    bool ok = false;             ///< Upon return: did it succeed?
+    std::string errors;          ///< Upon return: any error messages.
+};
+
+/// Batch version of make_texture that carries out a whole list of
+/// conversions, setting the `ok` and `errors` of each job. Up to `njobs`
+/// of them (0 picks a number from the `"threads"` attribute) run at once,
+/// sharing the global thread pool for their parallel work, so that the
+/// file reading and writing of some overlaps with the filtering of others.
+/// Each job's output is sent to `outstream` in one piece as it finishes.
+/// The jobs should have distinct output files. Return `true` if all of
+/// them succeeded.
+bool OIIO_API make_texture (span<MakeTextureJob> jobs,
+                            std::ostream *outstream = nullptr,
+                            int njobs = 0);
 /// @}
 
 
@@ -53,6 +53,12 @@ inline void
 parallel_image (ROI roi, parallel_options opt,
                 std::function<void(ROI)> f)
 {
+    // A region too small to split (or a single thread) needs no help from
+    // the thread pool, so don't even consult it.
+    if (opt.maxthreads == 1 || roi.npixels() < opt.minitems) {
+        f (roi);
+        return;
+    }
     opt.resolve ();
     // Try not to assign a thread less than 16k pixels, or it's not worth
     // the thread startup/teardown cost.
@@ -77,8 +83,7 @@ parallel_image (ROI roi, parallel_options opt,
         ychunk = roi.height();
         // ychunk = std::max (64, minitems/xchunk);
     } else if (splitdir == Split_Tile) {
-        int64_t n = std::min<imagesize_t>(opt.minitems, roi.npixels());
-        xchunk = ychunk = std::max (1, int(std::sqrt(n))/4);
+        xchunk = ychunk = cache_tile_size (opt.itembytes);
     } else {
         xchunk = ychunk = std::max (int64_t(1), int64_t(std::sqrt(opt.maxthreads))/2);
     }
@@ -93,6 +98,21 @@ parallel_image (ROI roi, parallel_options opt,
 }
 
 
+/// The same, for any callable: small regions call `f` directly, without
+/// first wrapping it in a std::function, which matters when tiny images
+/// are processed many times.
+template <class Func>
+inline void
+parallel_image (ROI roi, parallel_options opt, Func&& f)
+{
+    if (opt.maxthreads == 1 || roi.npixels() < opt.minitems) {
+        f (roi);
+        return;
+    }
+    parallel_image (roi, opt, std::function<void(ROI)>(std::forward<Func>(f)));
+}
+
+
 inline void
 parallel_image (ROI roi, std::function<void(ROI)> f)
 {
@@ -161,6 +181,58 @@ enum IBAprep_flags {
 
 
 
+/// Can for_each_row<T>() hand out the rows of `roi` in `buf`? That needs
+/// `buf` to hold local, non-deep pixels of native type `T` with no gaps
+/// between them, and `roi` to lie within its data window.
+template<typename T>
+inline bool has_row_spans (const ImageBuf &buf, ROI roi)
+{
+    const ImageSpec &spec (buf.spec());
+    return buf.localpixels() && !buf.deep()
+        && spec.format.basetype == BaseTypeFromC<T>::value
+        && buf.pixel_stride() == stride_t(spec.nchannels * sizeof(T))
+        && roi.xbegin >= spec.x && roi.xend <= spec.x + spec.width
+        && roi.ybegin >= spec.y && roi.yend <= spec.y + spec.height
+        && roi.zbegin >= spec.z && roi.zend <= spec.z + std::max(spec.depth, 1)
+        && roi.xbegin < roi.xend;
+}
+
+/// Call `f(row, y, z)` for each scanline of `roi` in `buf`, where `row` is
+/// a span of the native `T` values of pixels `[roi.xbegin, roi.xend)` of
+/// that scanline, all channels of each, contiguous in memory. Kernels can
+/// then loop over the values directly, which the compiler can vectorize,
+/// instead of paying for the per-pixel checks of an Iterator. If
+/// has_row_spans<T>(buf,roi) is false, nothing is called and false is
+/// returned, and the caller should fall back to iterators. Rows are
+/// visited serially; call this from within parallel_image() to spread
+/// them over threads.
+template<typename T, class F>
+inline bool for_each_row (ImageBuf &buf, ROI roi, F &&f)
+{
+    if (! has_row_spans<T>(buf, roi))
+        return false;
+    size_t n = size_t(roi.width()) * size_t(buf.nchannels());
+    for (int z = roi.zbegin; z < roi.zend; ++z)
+        for (int y = roi.ybegin; y < roi.yend; ++y)
+            f (span<T>((T *)buf.pixeladdr(roi.xbegin, y, z), n), y, z);
+    return true;
+}
+
+/// Read-only for_each_row(), handing out spans of `const T`.
+template<typename T, class F>
+inline bool for_each_row (const ImageBuf &buf, ROI roi, F &&f)
+{
+    if (! has_row_spans<T>(buf, roi))
+        return false;
+    size_t n = size_t(roi.width()) * size_t(buf.nchannels());
+    for (int z = roi.zbegin; z < roi.zend; ++z)
+        for (int y = roi.ybegin; y < roi.yend; ++y)
+            f (cspan<T>((const T *)buf.pixeladdr(roi.xbegin, y, z), n), y, z);
+    return true;
+}
+
+
+
 // DEPRECATED(2.3): Prefer TypeDesc::basetype_merge().
 TypeDesc::BASETYPE OIIO_API type_merge (TypeDesc::BASETYPE a, TypeDesc::BASETYPE b);
 
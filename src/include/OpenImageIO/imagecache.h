@@ -31,6 +31,7 @@ class ImageCacheImpl;
 class ImageCacheFile;
 class ImageCacheTile;
 class ImageCachePerThreadInfo;
+class ImageCachePageTable;
 };  // namespace pvt
 
 
@@ -100,6 +101,44 @@ public:
     /// - `float max_memory_MB` :
     ///           The maximum amount of memory (measured in MB) used for the
     ///           internal "tile cache." (Default: 256.0 MB)
+    /// - `float max_memory_fraction` :
+    ///           If nonzero, size the tile cache automatically instead:
+    ///           the budget becomes this fraction of the memory that the
+    ///           process may use, which is the physical memory or, if it
+    ///           is lower, the limit of its cgroup (as in a container).
+    ///           On Linux systems with pressure stall information, the
+    ///           budget is then cut by a quarter, and tiles freed, each
+    ///           time the system reports memory pressure, and grows back
+    ///           towards that ceiling after some seconds without any.
+    ///           Setting `max_memory_MB` turns this off. (Default: 0)
+    /// - `string diskcache_dir` :
+    ///           If set to the name of a directory (typically on fast local
+    ///           storage), it enables a second tier of tile cache on disk:
+    ///           tiles that were read from image files and are freed from
+    ///           the in-memory cache are saved there in their decoded,
+    ///           already-converted form, and subsequent reads of those tiles
+    ///           (by this or any other process using the same directory)
+    ///           will retrieve them from there rather than re-reading and
+    ///           decompressing the original files. Tiles are identified by
+    ///           the file's SHA-1 fingerprint if it has one, or else by its
+    ///           name and modification time. (Default: "", disabled)
+    /// - `float max_diskcache_MB` :
+    ///           The maximum amount of data (measured in MB) that this
+    ///           ImageCache will write into the `diskcache_dir`. Once the
+    ///           limit is reached, no more tiles are added to the disk
+    ///           cache, but the ones already there are still used.
+    ///           (Default: 10240.0 MB)
+    /// - `float compressed_tier_MB` :
+    ///           If nonzero, tiles that would be freed to keep the cache
+    ///           within `max_memory_MB` are instead kept in memory in
+    ///           compressed form, up to this many MB of compressed data,
+    ///           and uncompressed upon the next request for them rather
+    ///           than being read again from their file. This is a cheap
+    ///           way to hold working sets a bit larger than
+    ///           `max_memory_MB`, particularly of 8 bit or half textures,
+    ///           which tend to compress well. The oldest compressed tiles
+    ///           are discarded when the limit is reached. (Default: 0,
+    ///           disabled)
     /// - `string searchpath` :
     ///           The search path for images: a colon-separated list of
     ///           directories that will be searched in order for any image
@@ -179,6 +218,42 @@ public:
     ///           occasional spurious networking or other glitches that would
     ///           otherwise cause the entire long-running application to fail
     ///           upon a single transient error. (Default: 0)
+    /// - `int max_readahead_tiles` :
+    ///           When cache misses on a tiled file march along a row of
+    ///           tiles, read the following tiles of the row in the same
+    ///           call and add them to the cache as well, saving the
+    ///           per-read seek and decompression setup for each of them.
+    ///           The run length adapts to the access pattern of each file,
+    ///           doubling on each sequential miss up to this limit and
+    ///           falling back to a single tile on a random one. A value of
+    ///           1 or less disables read-ahead. (Default: 8)
+    /// - `int numa_replicate` :
+    ///           When nonzero, on machines with more than one NUMA node,
+    ///           a tile that threads on nodes other than the one that
+    ///           read it look up (past their micro-caches) at least this
+    ///           many times gets a copy of its pixels in the memory of
+    ///           the node doing the lookup, so that texture lookups there
+    ///           no longer cross the interconnect. The copies count against
+    ///           `max_memory_MB` and are freed along with their tile.
+    ///           Per-node counts are reported by `getstats()`. (Default: 0)
+    /// - `int get_pixels_streaming` :
+    ///           Controls when `get_pixels()` reads a region straight from
+    ///           the file into the caller's buffer (decoding bands of it in
+    ///           parallel) instead of tile by tile through the cache, so
+    ///           that one big read doesn't flush the whole working set. If
+    ///           0, never; if 1, when the region is bigger than
+    ///           `max_memory_MB`; if 2, for every region of a 2D image
+    ///           that lies within its data window. Streamed pixels are not
+    ///           left in the cache. (Default: 1)
+    /// - `int max_inputs_per_file` :
+    ///           The most file handles (ImageInputs) the cache will keep
+    ///           open for any one file. When a thread misses on a tile
+    ///           while another thread is already reading from the same
+    ///           file, it reads through a separate handle rather than
+    ///           waiting its turn, so tiles of one heavily used texture
+    ///           can be decoded in parallel. The extra handles count
+    ///           against `max_open_files`. A value of 1 makes all reads of
+    ///           a file share one handle. (Default: 4)
     /// - `int deduplicate` :
     ///           When nonzero, the ImageCache will notice duplicate images
     ///           under different names if their headers contain a SHA-1
@@ -187,6 +262,14 @@ public:
     ///           reads.  The default is 1 (de-duplication turned on). The
     ///           only reason to set it to 0 is if you specifically want to
     ///           disable the de-duplication optimization.
+    /// - `int deduplicate_content` :
+    ///           When nonzero (and `deduplicate` is on), also notice
+    ///           duplicates among images that have no SHA-1 fingerprint,
+    ///           by comparing fast (xxhash) hashes of the files' bytes. A
+    ///           file is only hashed once another open file turns out to
+    ///           have exactly the same size, so images that cannot be
+    ///           copies of each other are never read for this. Only
+    ///           byte-for-byte identical files are found. (Default: 0)
     /// - `string substitute_image` :
     ///           When set to anything other than the empty string, the
     ///           ImageCache will use the named image in place of *all*
@@ -207,6 +290,43 @@ public:
     ///           aren't getting any helpful additional information, this
     ///           can cut down on the clutter and the runtime. (default:
     ///           100)
+    /// - `int prefetch_threads` :
+    ///           The number of background threads used to service
+    ///           `prefetch_tiles()` requests. The threads are not created
+    ///           until the first prefetch request. If 0, prefetch requests
+    ///           are carried out immediately by the calling thread.
+    ///           (Default: 4)
+    /// - `int mmap_tiles` :
+    ///           When nonzero, tiles of files whose native pixels are
+    ///           stored uncompressed and exactly in the form the cache
+    ///           would hold them (currently, uncompressed tiled TIFF) are
+    ///           used in place from a read-only memory mapping of the file
+    ///           rather than being read into memory allocated by the cache.
+    ///           Such tiles do not count against `max_memory_MB`. A mapped
+    ///           file must not be modified or truncated while it is in use.
+    ///           (Default: 0)
+    /// - `int latency_stats` :
+    ///           When nonzero, record the distributions of how long each
+    ///           texture lookup took, how long threads waited for tile
+    ///           pixels that weren't yet in the cache, and how long file
+    ///           opens took, so that their tails can be seen as well as
+    ///           their averages. They're reported by `getstats(5)` and by
+    ///           the `stat:*_latency_*` attributes. This costs a timer
+    ///           query per lookup, so the default is 0.
+    /// - `int watch_files` :
+    ///           When nonzero, watch the directories of the files in the
+    ///           cache for files being rewritten, replaced, deleted or
+    ///           touched (using inotify, so only on Linux), and have
+    ///           `invalidate_all(false)` invalidate just the files reported
+    ///           to have changed, rather than checking the modification time
+    ///           of every file, which can be very slow for many files on a
+    ///           network file system. Files whose directories can't be
+    ///           watched are still checked individually, and every file is
+    ///           if the watcher may have missed some changes. Changes made
+    ///           to network file systems by other machines aren't seen, so
+    ///           only use this if files are written from this machine, or
+    ///           call `invalidate_files()` with the changes you know of.
+    ///           (Default: 0)
     /// - `int trust_file_extensions` :
     ///           When nonzero, assume that the file extensions of any
     ///           texture requests correctly indicates the file format (when
@@ -257,9 +377,58 @@ public:
     ///           opened (at the time of the query), and the peak number of
     ///           files opened at any time.
     ///
+    /// - `float stat:tile_table_load_factor` ,
+    ///   `int stat:tile_table_resizes` :
+    ///           Entries per bucket of the hash table that indexes the
+    ///           tiles in memory, and the number of times one of its bins
+    ///           has grown. Bins grow a little at a time, moving a few
+    ///           entries with each insertion, so that lookups never wait
+    ///           for a whole bin to be rehashed.
+    ///
+    /// - `int stat:autotile_bands_reused` :
+    ///           Number of tiles of autotiled scanline files that were
+    ///           copied from the row of tiles most recently decoded from
+    ///           the file, rather than reading those scanlines again.
+    ///
+    /// - `int stat:memory_pressure_events` :
+    ///           Number of times the tile cache budget was cut because the
+    ///           system reported memory pressure (see
+    ///           `max_memory_fraction`).
+    ///
+    /// - `int stat:tiles_prefetched` :
+    ///           Number of tile reads queued by `prefetch_tiles()`.
+    ///
+    /// - `int64 stat:tiles_mapped` :
+    ///           Number of tiles used in place from a memory-mapped file
+    ///           (see the `mmap_tiles` attribute) rather than read.
+    ///
+    /// - `int64 stat:tiles_constant` :
+    ///           Number of tiles that the file reported to be all one value
+    ///           (such as empty regions of a sparse volume), which share one
+    ///           copy of their pixels rather than being read.
+    ///
+    /// - `int64 stat:tiles_readahead` :
+    ///           Number of tiles added to the cache by read-ahead (see the
+    ///           `max_readahead_tiles` attribute) rather than on demand.
+    ///
+    /// - `int64 stat:bytes_streamed` :
+    ///           Bytes that `get_pixels()` read straight from files without
+    ///           going through the tile cache (see the
+    ///           `get_pixels_streaming` attribute).
+    ///
+    /// - `int64 stat:spare_inputs_opened` :
+    ///           Number of extra file handles opened so that different
+    ///           threads could read tiles of the same file at once (see
+    ///           the `max_inputs_per_file` attribute).
+    ///
     /// - `int stat:find_tile_calls` :
     ///           Number of times a filename was looked up in the file cache.
     ///
+    /// - `int64 stat:find_tile_index_hits` :
+    ///           Number of tile lookups that missed the per-thread
+    ///           microcache but were satisfied by the lock-free tile index,
+    ///           without locking the main tile cache.
+    ///
     /// - `int64 stat:image_size` :
     ///           Total size (uncompressed bytes of pixel data) of all
     ///           images referenced by the ImageCache. (Note: Prior to 1.7,
@@ -272,6 +441,28 @@ public:
     /// - `int64 stat:bytes_read` :
     ///           Total size (uncompressed bytes of pixel data) read.
     ///
+    /// - `int64 stat:diskcache_tiles_read` ,
+    ///   `int64 stat:diskcache_bytes_read` :
+    ///           Number of tiles (and bytes of pixel data) that were
+    ///           retrieved from the on-disk tile cache rather than read from
+    ///           their image files.
+    ///
+    /// - `int stat:diskcache_tiles_written` ,
+    ///   `int64 stat:diskcache_bytes_written` :
+    ///           Number of tiles (and bytes of pixel data) that were saved
+    ///           to the on-disk tile cache.
+    ///
+    /// - `int stat:compressed_tiles` ,
+    ///   `int64 stat:compressed_bytes` :
+    ///           Number of tiles (and bytes of compressed data) currently
+    ///           held in the compressed tier (see `compressed_tier_MB`).
+    ///
+    /// - `int stat:compressed_tiles_demoted` ,
+    ///   `int stat:compressed_tiles_restored` :
+    ///           Number of tiles that were compressed into the compressed
+    ///           tier rather than being freed, and number that were
+    ///           uncompressed from it rather than being read from a file.
+    ///
     /// - `int stat:unique_files` :
     ///           Number of unique files opened.
     ///
@@ -298,6 +489,36 @@ public:
     ///           Total time (across all threads) that threads spent looking
     ///           up individual tiles.
     ///
+    /// - `float stat:input_mutex_wait_time` :
+    ///           Total time (across all threads) that threads blocked
+    ///           waiting for exclusive use of a file's ImageInput.
+    ///
+    /// - `int64 stat:lookup_latency_count` ,
+    ///   `float stat:lookup_latency_mean` ,
+    ///   `float stat:lookup_latency_p50` ,
+    ///   `float stat:lookup_latency_max` :
+    ///           While `latency_stats` is on, the number of texture lookups
+    ///           timed, and their mean, percentile, and maximum latencies
+    ///           in seconds. Any percentile may be asked for: `p90`,
+    ///           `p99`, `p999` (99.9%), and so on; they are accurate to
+    ///           about 6%. Likewise, `stat:tile_wait_latency_*` describes
+    ///           waits for tiles that weren't yet in the cache (including
+    ///           reading them), and `stat:fileopen_latency_*` file opens.
+    ///
+    /// - `int64 stat:texture_queries` :
+    ///           Number of individual 2D texture lookups.
+    ///
+    /// - `int64 stat:aniso_probes` ,
+    ///   `int64 stat:closest_interps` ,
+    ///   `int64 stat:bilinear_interps` ,
+    ///   `int64 stat:cubic_interps` :
+    ///           Number of filter probes of texture lookups, and of those,
+    ///           how many were closest-texel, bilinear (4 texels), and
+    ///           bicubic (16 texels) interpolations.
+    ///
+    /// - `int64 stat:ewa_texels` :
+    ///           Number of texels weighed by EWA texture filtering.
+    ///
     /// The following member functions of ImageCache allow you to set (and
     /// in some cases retrieve) options that control the overall behavior of
     /// the image cache:
@@ -481,6 +702,37 @@ public:
     /// This method was added in OpenImageIO 2.3.
     virtual ustring filename_from_handle(ImageHandle* handle) = 0;
 
+    /// Set a caching hint for one image, given its handle, so that an
+    /// application can keep a few critical images resident, or stop one
+    /// huge image from crowding out all the others. Recognized hints are:
+    ///
+    /// - `int priority` :
+    ///           How hard to try to keep the image's tiles in memory. Each
+    ///           point of priority lets an unused tile survive one more
+    ///           pass of the cache's eviction sweep, and a negative
+    ///           priority makes the image's tiles the first to go.
+    ///           (Default: 0)
+    /// - `float max_resident_MB` :
+    ///           The most tile memory this image may hold in the cache.
+    ///           Once it is exceeded, the image's own oldest tiles are
+    ///           freed, whatever is happening in the rest of the cache.
+    ///           (Default: 0, meaning no limit other than `max_memory_MB`)
+    ///
+    /// The priority affects tiles read after it is set. Returns `true` if
+    /// the hint was recognized and of the right type, `false` otherwise.
+    ///
+    /// This method was added in OpenImageIO 2.4.
+    virtual bool file_attribute(ImageHandle* file, string_view name,
+                                TypeDesc type, const void* val) = 0;
+    /// Shortcut for an int hint.
+    bool file_attribute(ImageHandle* file, string_view name, int val) {
+        return file_attribute(file, name, TypeInt, &val);
+    }
+    /// Shortcut for a float hint.
+    bool file_attribute(ImageHandle* file, string_view name, float val) {
+        return file_attribute(file, name, TypeFloat, &val);
+    }
+
     /// @}
 
 
@@ -838,6 +1090,65 @@ public:
                              int xbegin, int xend, int ybegin, int yend,
                              int zbegin, int zend,
                              TypeDesc format, void *result) = 0;
+
+    /// One region to be retrieved by the batched variety of `get_pixels()`.
+    /// An undefined `roi` means the whole data window and all channels of
+    /// the subimage and MIP level; a channel range extending past the last
+    /// channel is clamped to it. The pixels are stored in `result`, with
+    /// the given strides (any `AutoStride` indicating a contiguous layout
+    /// in that dimension).
+    struct PixelRequest {
+        int subimage = 0;
+        int miplevel = 0;
+        ROI roi;
+        void* result     = nullptr;
+        stride_t xstride = AutoStride;
+        stride_t ystride = AutoStride;
+        stride_t zstride = AutoStride;
+    };
+
+    /// Batched variety of `get_pixels()` that retrieves, all in one call,
+    /// many (typically small) regions of one image, possibly from
+    /// different subimages and MIP levels, converting them all to
+    /// `format`. The regions are grouped by the tiles they overlap, so
+    /// each tile is looked up just once no matter how many regions it
+    /// serves, and the distinct tiles are read and copied out in parallel.
+    /// Pixels outside the data window are set to zero, as with the other
+    /// varieties. The regions' destinations must not overlap.
+    ///
+    /// @returns
+    ///             `true` for success, `false` if any of the requests was
+    ///             invalid or any of the tiles could not be read (the
+    ///             other requests are still filled in).
+    virtual bool get_pixels (ImageHandle *file, Perthread *thread_info,
+                             cspan<PixelRequest> requests,
+                             TypeDesc format) = 0;
+    /// A variety of the batched `get_pixels()` that takes a filename.
+    virtual bool get_pixels (ustring filename, cspan<PixelRequest> requests,
+                             TypeDesc format) = 0;
+
+    /// Retrieve the samples of a region of a deep image into `deepdata`,
+    /// which is reinitialized to hold `roi.npixels()` pixels (x varying
+    /// fastest, then y, then z) of the channels `[roi.chbegin,
+    /// roi.chend)`, with their native types and names. Pixels outside the
+    /// data window have no samples. An undefined `roi` means the whole
+    /// data window and all channels. The samples are read and kept in the
+    /// cache a tile at a time (tiles are emulated for scanline files, as
+    /// for flat ones), so working on one region of a huge deep image only
+    /// pages in the tiles that it touches.
+    ///
+    /// @returns
+    ///             `true` for success, `false` for failure, including if
+    ///             the image is not deep.
+    virtual bool get_deep_pixels (ustring filename, int subimage,
+                                  int miplevel, ROI roi,
+                                  DeepData &deepdata) = 0;
+    /// A more efficient variety of `get_deep_pixels()` for cases where you
+    /// can use an `ImageHandle*` to specify the image and optionally have
+    /// a `Perthread*` for the calling thread.
+    virtual bool get_deep_pixels (ImageHandle *file, Perthread *thread_info,
+                                  int subimage, int miplevel, ROI roi,
+                                  DeepData &deepdata) = 0;
     /// @}
 
     /// @{
@@ -875,6 +1186,16 @@ public:
     /// since they were first opened.
     virtual void invalidate_all(bool force = false) = 0;
 
+    /// Invalidate each of the named files, as if by `invalidate()`, but
+    /// with a single pass over the cached tiles, so a caller that knows
+    /// which files have changed (for example, from its own change feed)
+    /// pays for those rather than for every file in the cache. The names
+    /// may be those the files were asked for by, or, if the `watch_files`
+    /// attribute is on, the paths those resolved to. Names not in the cache
+    /// are ignored.
+    virtual void invalidate_files(cspan<ustring> filenames,
+                                  bool force = true) = 0;
+
     /// Close any open file handles associated with a named file (UTF-8
     /// encoded), but do not invalidate any image spec information or pixels
     /// associated with the files.  A client might do this in order to release
@@ -910,6 +1231,60 @@ public:
                              int x, int y, int z,
                              int chbegin = 0, int chend = -1) = 0;
 
+    /// Asynchronously read into the cache all tiles of the given image,
+    /// subimage, and MIP level that overlap the pixel region `roi`
+    /// (including its channel range; an undefined ROI means the whole
+    /// image). The reads are queued on a background I/O thread pool (see
+    /// the `prefetch_threads` attribute) and this call returns
+    /// immediately. Later `get_tile()`, `get_pixels()`, or texture lookups
+    /// that need those tiles will wait for the in-flight reads to complete
+    /// rather than issuing duplicate reads of their own. Tiles already in
+    /// the cache are left alone.
+    ///
+    /// This is thread-safe, and is intended to let an application that
+    /// knows ahead of time which tiles it will need overlap the file I/O
+    /// and decompression with its own computation.
+    ///
+    /// @returns
+    ///     The number of tile reads that were queued, or -1 if the file
+    ///     could not be found or opened.
+    virtual int prefetch_tiles (ustring filename, int subimage, int miplevel,
+                                ROI roi = ROI::All()) = 0;
+    /// A slightly more efficient variety of `prefetch_tiles()` for cases
+    /// where you can use an `ImageHandle*` to specify the image and
+    /// optionally have a `Perthread*` for the calling thread.
+    virtual int prefetch_tiles (ImageHandle *file, Perthread *thread_info,
+                                int subimage, int miplevel,
+                                ROI roi = ROI::All()) = 0;
+    /// Batched variety of `prefetch_tiles()` that queues the tiles
+    /// overlapping any of several regions of the same image and level.
+    virtual int prefetch_tiles (ImageHandle *file, Perthread *thread_info,
+                                int subimage, int miplevel,
+                                cspan<ROI> rois) = 0;
+
+    /// Write to the text file `path` a manifest of the cache's current
+    /// contents: the images that are open (with their modification times
+    /// and fingerprints) and the tiles that are resident, most recently
+    /// used first. A later process can hand it to `load_manifest()` to
+    /// start out with a warm cache.
+    ///
+    /// @returns
+    ///     `true` upon success, `false` if the file could not be written
+    ///     (in which case an error message is retrievable via `geterror()`).
+    virtual bool save_manifest (string_view path) = 0;
+
+    /// Read a manifest written by `save_manifest()` and, in the background
+    /// (as with `prefetch_tiles()`), reopen the images it lists and read
+    /// back their tiles, hottest first, up to what fits in `max_memory_MB`.
+    /// Images whose modification time or fingerprint no longer matches the
+    /// manifest are skipped, since their old tiles would be of no use.
+    ///
+    /// @returns
+    ///     `true` if the manifest was read, `false` if it could not be
+    ///     read or is not a manifest (with an error retrievable via
+    ///     `geterror()`).
+    virtual bool load_manifest (string_view path) = 0;
+
     /// After finishing with a tile, release_tile will allow it to
     /// once again be purged from the tile cache if required.
     virtual void release_tile(Tile* tile) const = 0;
@@ -930,6 +1305,61 @@ public:
     /// not yet been released with `release_tile()`.
     virtual const void* tile_pixels(Tile* tile, TypeDesc& format) const = 0;
 
+    /// An opaque data type for a page table that maps tiles of cached
+    /// images to the slots of an "atlas" buffer owned by the caller, for
+    /// example memory that is mapped to or staged for upload to a GPU.
+    typedef pvt::ImageCachePageTable PageTable;
+
+    /// Create a page table over the caller's `atlas` buffer, which holds
+    /// `nslots` pages, each `page_width x page_height` pixels of
+    /// `nchannels` contiguous channels of type `format`, stored one after
+    /// another: slot `i` begins at byte offset `i * page_width *
+    /// page_height * nchannels * format.size()` of `atlas`.  The buffer
+    /// must stay valid until the table is destroyed.
+    ///
+    /// The size of the atlas counts against the cache's `max_memory_MB`
+    /// for as long as the table exists, so pages and cached tiles share a
+    /// single memory budget, and creating a table will evict tiles if
+    /// needed to make room.
+    ///
+    /// @returns
+    ///     A pointer to the new table, or `nullptr` (with an error
+    ///     retrievable via `geterror()`) if the parameters are invalid.
+    virtual PageTable* create_page_table (void *atlas, int nslots,
+                                          int page_width, int page_height,
+                                          int nchannels, TypeDesc format) = 0;
+
+    /// Destroy a page table made by `create_page_table()`, returning its
+    /// share of the memory budget to the tile cache. The atlas buffer
+    /// itself is not freed.
+    virtual void destroy_page_table (PageTable *table) = 0;
+
+    /// Return the atlas slot holding the tile of the given image,
+    /// subimage, and MIP level that contains pixel (x,y,z), first filling
+    /// a slot from the tile cache (reading the tile if necessary) if the
+    /// tile is not already resident.  Pixels of tiles smaller than the
+    /// page, and channels beyond those in the file, are filled with 0.
+    /// When all slots are in use, the least recently requested page is
+    /// recycled. If `filled` is not NULL, it is set to true if the slot
+    /// was (re)written by this call, which means that the caller must
+    /// upload it and retire whatever tile its own page table previously
+    /// had in that slot. This is thread-safe.
+    ///
+    /// Pages are not updated when images are invalidated; call
+    /// `clear_page_table()` after `invalidate()` to drop stale pages.
+    ///
+    /// @returns
+    ///     The slot index, or -1 if the file could not be opened or the
+    ///     tile read, or if the image's tiles are larger than the pages.
+    virtual int page_slot (PageTable *table, ImageHandle *file,
+                           Perthread *thread_info, int subimage, int miplevel,
+                           int x, int y, int z = 0,
+                           bool *filled = nullptr) = 0;
+
+    /// Forget all of the pages in the table, so that subsequent
+    /// `page_slot()` calls will refill them.
+    virtual void clear_page_table (PageTable *table) = 0;
+
     /// The add_file() call causes a file to be opened or added to the
     /// cache. There is no reason to use this method unless you are
     /// supplying a custom creator, or configuration, or both.
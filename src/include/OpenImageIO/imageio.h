@@ -24,6 +24,7 @@
 #endif
 
 #include <cmath>
+#include <future>
 #include <limits>
 #include <string>
 #include <vector>
@@ -644,17 +645,23 @@ public:
     /// or decoding of values) for certain known metadata.
     static std::string metadata_val (const ParamValue &p, bool human=false);
 
-    enum SerialFormat  { SerialText, SerialXML };
+    enum SerialFormat  { SerialText, SerialXML, SerialBinary };
     enum SerialVerbose { SerialBrief, SerialDetailed, SerialDetailedHuman };
 
     /// Returns, as a string, a serialized version of the `ImageSpec`. The
-    /// `format` may be either `ImageSpec::SerialText` or
-    /// `ImageSpec::SerialXML`. The `verbose` argument may be one of:
+    /// `format` may be `ImageSpec::SerialText`, `ImageSpec::SerialXML`, or
+    /// `ImageSpec::SerialBinary`. The `verbose` argument may be one of:
     /// `ImageSpec::SerialBrief` (just resolution and other vital
     /// statistics, one line for `SerialText`, `ImageSpec::SerialDetailed`
     /// (contains all metadata in original form), or
     /// `ImageSpec::SerialDetailedHuman` (contains all metadata, in many
     /// cases with human-readable explanation).
+    ///
+    /// `SerialBinary` is a compact, versioned binary encoding of all of the
+    /// fields and metadata (except pointer-valued metadata, which would
+    /// mean nothing in another process), for moving specs between
+    /// processes or storing them, and ignores `verbose`. It's read back by
+    /// `from_binary()`, or examined in place with an `ImageSpecView`.
     std::string serialize (SerialFormat format,
                            SerialVerbose verbose = SerialDetailed) const;
 
@@ -664,6 +671,12 @@ public:
     /// Populates the fields of the `ImageSpec` based on the XML passed in.
     void from_xml (const char *xml);
 
+    /// Replace the contents of the `ImageSpec` with those of the result of
+    /// `serialize(SerialBinary)` in `data`. Return true for success, or
+    /// false, leaving the spec unchanged, if `data` isn't a complete and
+    /// valid binary spec of a version this library can read.
+    bool from_binary (string_view data);
+
     /// Hunt for the "Compression" and "CompressionQuality" settings in the
     /// spec and turn them into the compression name and quality. This
     /// handles compression name/qual combos of the form "name:quality".
@@ -818,6 +831,90 @@ public:
 
 
 
+/// ImageSpecView is a read-only view of an ImageSpec serialized with
+/// `ImageSpec::serialize(ImageSpec::SerialBinary)`, which answers queries
+/// straight from the serialized bytes: nothing is decoded or allocated
+/// until it's asked for, and string values are returned as views into the
+/// buffer. The binary layout has a fixed header and fixed-size tables of
+/// channels and metadata, so constructing a view only checks that the
+/// offsets and sizes in them are consistent.
+///
+/// The buffer must remain valid and unchanged for as long as the view is
+/// used. A view of anything that isn't a valid binary spec is invalid, and
+/// all of its queries return zeroes or the defaults given.
+class OIIO_API ImageSpecView {
+public:
+    /// View the binary spec in `data`.
+    explicit ImageSpecView (string_view data);
+
+    /// Is this a view of a valid binary spec?
+    bool valid () const noexcept { return m_data != nullptr; }
+
+    /// The fields of the ImageSpec.
+    int x () const noexcept { return field(0); }
+    int y () const noexcept { return field(1); }
+    int z () const noexcept { return field(2); }
+    int width () const noexcept { return field(3); }
+    int height () const noexcept { return field(4); }
+    int depth () const noexcept { return field(5); }
+    int full_x () const noexcept { return field(6); }
+    int full_y () const noexcept { return field(7); }
+    int full_z () const noexcept { return field(8); }
+    int full_width () const noexcept { return field(9); }
+    int full_height () const noexcept { return field(10); }
+    int full_depth () const noexcept { return field(11); }
+    int tile_width () const noexcept { return field(12); }
+    int tile_height () const noexcept { return field(13); }
+    int tile_depth () const noexcept { return field(14); }
+    int nchannels () const noexcept { return field(15); }
+    int alpha_channel () const noexcept { return field(16); }
+    int z_channel () const noexcept { return field(17); }
+    bool deep () const noexcept { return field(18) != 0; }
+    TypeDesc format () const noexcept;
+
+    /// The data format of channel `chan`, like `ImageSpec::channelformat()`.
+    TypeDesc channelformat (int chan) const noexcept;
+
+    /// The name of channel `chan`, or "" if there is no such channel.
+    string_view channel_name (int chan) const noexcept;
+
+    /// The number of metadata attributes, and the name and type of the
+    /// `i`-th one.
+    int nattribs () const noexcept { return m_nattribs; }
+    string_view attrib_name (int i) const noexcept;
+    TypeDesc attrib_type (int i) const noexcept;
+
+    /// If there is an attribute named `name` of exactly the type `type`,
+    /// copy its value to `*value` and return true, else return false.
+    /// String values are copied as `ustring`s.
+    bool getattribute (string_view name, TypeDesc type, void* value,
+                       bool casesensitive = false) const;
+
+    /// The value of the named attribute, if it's a single integer or
+    /// floating point value, converted to `int` or `float`; else the
+    /// `defaultval`.
+    int get_int_attribute (string_view name, int defaultval = 0) const;
+    float get_float_attribute (string_view name,
+                               float defaultval = 0) const;
+
+    /// The value of the named attribute, if it's a single string, as a view
+    /// into the buffer; else the `defaultval`.
+    string_view get_string_attribute (string_view name,
+                           string_view defaultval = string_view()) const;
+
+    /// Decode the whole spec.
+    ImageSpec spec () const;
+
+private:
+    const char* m_data = nullptr;
+    int m_nattribs     = 0;
+
+    int field (int i) const noexcept;
+    int find_attrib (string_view name, bool casesensitive = false) const;
+};
+
+
+
 
 /// ImageInput abstracts the reading of an image file in a file
 /// format-agnostic manner.
@@ -875,6 +972,29 @@ public:
         return open(Strutil::utf16_to_utf8(filename), config, ioproxy);
     }
 
+    /// Create an ImageInput that describes every subimage and MIP level of
+    /// the file -- `spec()`, `seek_subimage()`, and `format_name()` behave
+    /// as usual -- but that cannot read pixels. If the global `"spec_cache"`
+    /// attribute names a directory that holds the headers of the unchanged
+    /// file, they are used without opening the file. Otherwise the file is
+    /// opened, all of its headers are read, and the result is remembered
+    /// there for next time.
+    ///
+    /// @param filename
+    ///         The name of the file to describe, UTF-8 encoded.
+    ///
+    /// @param config
+    ///         Optional pointer to an ImageSpec whose metadata contains
+    ///         "configuration hints."
+    ///
+    /// @returns
+    ///         A `unique_ptr` that will free the ImageInput when it exits
+    ///         scope or is reset. The pointer will be empty if the file
+    ///         could not be opened, in which case `OIIO::geterror()` tells
+    ///         why.
+    static unique_ptr open_header (const std::string& filename,
+                                   const ImageSpec *config = nullptr);
+
     /// Create and return an ImageInput implementation that is able to read
     /// the given file or format.  If `do_open` is true (and the `filename`
     /// is the name of a file, not just a format), fully open it if possible
@@ -978,6 +1098,18 @@ public:
     /// - `"arbitrary_metadata"` : Does this format allow metadata with
     ///       arbitrary names and types?
     ///
+    /// - `"concurrent_subimages"` :
+    ///       May several threads read *different* subimages from this one
+    ///       opened ImageInput at the same time (using the read calls that
+    ///       take an explicit subimage), with the reads proceeding in
+    ///       parallel rather than serializing on the file? (Added in
+    ///       OpenImageIO 2.4.)
+    ///
+    /// - `"constant_tiles"` :
+    ///       Can this format reader tell, without reading it, that every
+    ///       pixel of some tiles has the same value, via
+    ///       `native_tile_constant()`? (Added in OpenImageIO 2.4.)
+    ///
     /// - `"exif"` :
     ///       Can this format store Exif camera data?
     ///
@@ -991,6 +1123,18 @@ public:
     ///       Can this format create images without reading from a disk
     ///       file?
     ///
+    /// - `"rawtiles"` :
+    ///       Does this format reader implement `read_raw_tile()` and
+    ///       `decode_raw_tile()`, so that the base class
+    ///       `read_native_tiles()` may fetch the compressed tiles serially
+    ///       and decode them in parallel? (Added in OpenImageIO 2.4.)
+    ///
+    /// - `"sequential_io"` :
+    ///       Does this format reader mostly walk its file front to back in
+    ///       many small `read()` calls, so that it benefits from having
+    ///       a read-ahead buffer (`Filesystem::IOReadAhead`) placed in
+    ///       front of the file it opens? (Added in OpenImageIO 2.4.)
+    ///
     /// - `"thumbnail"` :
     ///       Does this format reader support retrieving a reduced
     ///       resolution copy of the image via the `thumbnail()` method?
@@ -1082,7 +1226,11 @@ public:
     /// `seek_subimage()`. It is thus not thread-safe, since the spec may
     /// change if another thread calls `seek_subimage`, or any of the
     /// `read_*()` functions that take explicit subimage/miplevel.
-    virtual const ImageSpec &spec (void) const { return m_spec; }
+    ///
+    /// If the file was opened with the "oiio:LazyMetadata" configuration
+    /// hint set to 1, this is when any Exif, XMP, or IPTC metadata that the
+    /// reader kept undecoded is decoded into the spec.
+    virtual const ImageSpec &spec (void) const;
 
     /// Return a full copy of the ImageSpec of the designated subimage and
     /// MIPlevel. This method is thread-safe, but it is potentially
@@ -1473,6 +1621,93 @@ public:
     }
 #endif
 
+    /// Return true if a call to `read_image()`, `read_scanlines()`, or
+    /// `read_tiles()` covering the region `roi` of the given subimage and
+    /// MIP level, with the given data format and strides, would be decoded
+    /// directly into the caller's buffer, with no intermediate scratch
+    /// buffer and no copy or data conversion by ImageInput itself.
+    ///
+    /// That is guaranteed when all of the following hold:
+    /// * `format` is `TypeUnknown`, or is the file's native `spec.format`
+    ///   and the file does not have per-channel formats;
+    /// * all channels are requested;
+    /// * the strides are those of a contiguous buffer in the native
+    ///   layout (or `AutoStride`);
+    /// * for scanline files, `roi` spans the full width of the image;
+    /// * for tiled files, `roi` consists of whole tiles (including not
+    ///   ending in a partial tile at the image edge).
+    ///
+    /// @param  subimage    The subimage to read from (starting with 0).
+    /// @param  miplevel    The MIP level to read (0 is the highest
+    ///                     resolution level).
+    /// @param  roi         The region to read; if it is undefined, the
+    ///                     whole image and all channels.
+    /// @param  format      A TypeDesc describing the type of the data
+    ///                     buffer.
+    /// @param  xstride/ystride/zstride
+    ///                     The distance in bytes between successive pixels,
+    ///                     scanlines, and image planes (or `AutoStride`).
+    /// @returns            `true` if the read would be zero-copy.
+    ///
+    /// Plugins that override the read methods with their own buffering
+    /// may override this to report accurately.
+    ///
+    /// This method was added in OpenImageIO 2.4.
+    virtual bool read_is_zero_copy (int subimage, int miplevel, ROI roi,
+                                    TypeDesc format,
+                                    stride_t xstride=AutoStride,
+                                    stride_t ystride=AutoStride,
+                                    stride_t zstride=AutoStride);
+
+    /// @{
+    /// @name Asynchronous reads
+    ///
+    /// These are asynchronous variants of the thread-safe `read_image()`,
+    /// `read_scanlines()`, and `read_tiles()` (the ones that take an
+    /// explicit subimage and miplevel). Each returns immediately with a
+    /// `std::future<bool>` that becomes ready when the read has finished,
+    /// holding the value that the blocking call would have returned.
+    ///
+    /// The reads are executed by a dedicated OIIO I/O thread pool, which
+    /// is separate from the compute pool returned by
+    /// `default_thread_pool()`, so pending reads will not compete with
+    /// parallel image operations (and vice versa). The size of the I/O
+    /// pool is set by the global `"io_threads"` attribute; if it is 0, the
+    /// read is performed by the calling thread before the function returns
+    /// and the future is already ready.
+    ///
+    /// The caller is responsible for keeping both the ImageInput and the
+    /// `data` buffer alive (and not closing or re-opening the ImageInput)
+    /// until the future is ready. Any errors are retrievable with
+    /// `geterror()` after the future's `get()` returns `false`.
+    ///
+    /// These methods were added in OpenImageIO 2.4.
+
+    std::future<bool> read_image_async (int subimage, int miplevel,
+                                        int chbegin, int chend,
+                                        TypeDesc format, void *data,
+                                        stride_t xstride=AutoStride,
+                                        stride_t ystride=AutoStride,
+                                        stride_t zstride=AutoStride,
+                                        ProgressCallback progress_callback=NULL,
+                                        void *progress_callback_data=NULL);
+    std::future<bool> read_scanlines_async (int subimage, int miplevel,
+                                            int ybegin, int yend, int z,
+                                            int chbegin, int chend,
+                                            TypeDesc format, void *data,
+                                            stride_t xstride=AutoStride,
+                                            stride_t ystride=AutoStride);
+    std::future<bool> read_tiles_async (int subimage, int miplevel,
+                                        int xbegin, int xend,
+                                        int ybegin, int yend,
+                                        int zbegin, int zend,
+                                        int chbegin, int chend,
+                                        TypeDesc format, void *data,
+                                        stride_t xstride=AutoStride,
+                                        stride_t ystride=AutoStride,
+                                        stride_t zstride=AutoStride);
+    /// @}
+
     /// Read deep scanlines containing pixels (*,y,z), for all y in the
     /// range [ybegin,yend) into `deepdata`. This will fail if it is not a
     /// deep file.
@@ -1629,6 +1864,53 @@ public:
                                     int xbegin, int xend, int ybegin, int yend,
                                     int zbegin, int zend,
                                     int chbegin, int chend, void *data);
+
+    /// If the native pixels of the tile whose upper left corner is
+    /// (x,y,z) are stored in the file byte-for-byte as `read_native_tile()`
+    /// would return them (uncompressed, contiguous channels, native byte
+    /// order, no conversion of any kind), store the position of the tile
+    /// data within the file in `offset` and its length in `size`, and
+    /// return true. This lets a caller such as the ImageCache memory map
+    /// the file and use the pixels in place rather than reading them. The
+    /// base class implementation returns false, meaning that the tile can
+    /// only be retrieved by reading it.
+    virtual bool native_tile_location (int subimage, int miplevel,
+                                       int x, int y, int z,
+                                       int64_t& offset, int64_t& size);
+
+    /// If it is known without reading the tile whose upper left corner is
+    /// (x,y,z) that all of its pixels have the same value -- for example,
+    /// a region of a sparse volume that holds no data -- store that one
+    /// native pixel (all channels) in `pixel` and return true. This lets a
+    /// caller such as the ImageCache share one copy of such tiles rather
+    /// than reading and holding each of them. The base class
+    /// implementation returns false, meaning that the tile must be read.
+    virtual bool native_tile_constant (int subimage, int miplevel,
+                                       int x, int y, int z, void* pixel);
+
+    /// Read the raw (still compressed or encoded) bytes of the tile whose
+    /// upper left corner is (x,y,z) into `rawdata`, resizing it as needed,
+    /// without decoding them. Together with `decode_raw_tile()`, this
+    /// splits `read_native_tile()` into a part that must touch the file
+    /// (and is typically serialized by the reader's lock) and a part that
+    /// need not. Readers that implement both should return true for
+    /// `supports("rawtiles")`, which lets the base class
+    /// `read_native_tiles()` fetch the tiles one after another and decode
+    /// them concurrently on the thread pool. The base class implementation
+    /// fails.
+    virtual bool read_raw_tile (int subimage, int miplevel,
+                                int x, int y, int z,
+                                std::vector<unsigned char>& rawdata);
+
+    /// Decode `rawdata`, as previously retrieved by `read_raw_tile()` for
+    /// the same tile, into the native pixels (all channels, contiguous)
+    /// that `read_native_tile()` would have returned. This must be safe to
+    /// call concurrently from many threads without holding the reader's
+    /// lock, and may modify `rawdata` in place. The base class
+    /// implementation fails.
+    virtual bool decode_raw_tile (int subimage, int miplevel,
+                                  int x, int y, int z,
+                                  span<unsigned char> rawdata, void *data);
     /// @}
 
 
@@ -1787,6 +2069,17 @@ protected:
 
     /// @}
 
+    /// For readers that honor the "oiio:LazyMetadata" configuration hint:
+    /// remember the hint from `config`, and return it. If it's nonzero, the
+    /// Exif, XMP, and IPTC blocks of the file should be kept undecoded in
+    /// the spec with `defer_metadata()`, rather than decoded while opening.
+    int lazy_metadata(const ImageSpec& config);
+
+    /// The "oiio:LazyMetadata" hint the file was opened with: 0 to decode
+    /// metadata while opening, 1 to keep it undecoded until `spec()` is
+    /// called, 2 to leave it for the caller to decode.
+    int lazy_metadata() const;
+
 private:
     // PIMPL idiom -- this lets us hide details of the internals of the
     // ImageInput parent class so that changing them does not break the
@@ -2519,6 +2812,40 @@ protected:
                                     void *image_buffer,
                                     TypeDesc buf_format = TypeDesc::UNKNOWN);
 
+    /// @{
+    /// @name Pipelined write hooks for ImageOutput implementations.
+    ///
+    /// If the spec passed to open() has a nonzero `"oiio:pipeline"`
+    /// attribute and the plugin implements these hooks, `write_image()`
+    /// splits the image into chunks, converts each chunk to the native
+    /// format and compresses it on the thread pool, and meanwhile hands
+    /// the finished chunks, in order, to `pipeline_write()` on the
+    /// calling thread.
+
+    /// For a scanline file, return the number of scanlines per chunk; for
+    /// a tiled file, any nonzero value means one tile per chunk. Return 0
+    /// (the default) if the file as currently opened can't be written
+    /// this way.
+    virtual int pipeline_chunk_size () const { return 0; }
+
+    /// Compress the native, contiguous pixels of one chunk, described by
+    /// `chunk` (for a tile, `data` is always a full tile, padded at the
+    /// image edges), into `compressed`. It may overwrite `data`. This will
+    /// be called concurrently for different chunks, so it must not modify
+    /// the ImageOutput.
+    virtual bool pipeline_compress (const ROI& /*chunk*/, void* /*data*/,
+                                    std::vector<unsigned char>& /*compressed*/) const {
+        return false;
+    }
+
+    /// Append one compressed chunk to the file. This is called on the
+    /// thread that called `write_image()`, in chunk order.
+    virtual bool pipeline_write (const ROI& /*chunk*/,
+                                 cspan<unsigned char> /*compressed*/) {
+        return false;
+    }
+    /// @}
+
     /// @{
     /// @name IOProxy aids for ImageInput implementations.
     ///
@@ -2587,6 +2914,13 @@ private:
     std::unique_ptr<Impl, decltype(&impl_deleter)> m_impl;
 
     void append_error(string_view message) const; // add to m_errmessage
+
+    // write_image() by way of the pipeline_* hooks
+    bool write_image_pipelined(TypeDesc format, const void* data,
+                               stride_t xstride, stride_t ystride,
+                               stride_t zstride,
+                               ProgressCallback progress_callback,
+                               void* progress_callback_data);
 };
 
 
@@ -2661,6 +2995,29 @@ OIIO_API std::string geterror(bool clear = true);
 ///    many threads as the amount of hardware concurrency detected. Note
 ///    that this is separate from the OIIO `"threads"` attribute.
 ///
+/// - `int io_threads`
+///
+///    Sets the size of the OIIO I/O thread pool that services the
+///    asynchronous `ImageInput` reads (`read_image_async()` and friends).
+///    This pool is separate from the one governed by `"threads"`, so
+///    overlapping reads do not steal compute threads. The default is 4. A
+///    value of 0 means that asynchronous reads are performed synchronously
+///    by the calling thread. (This attribute was added in OpenImageIO 2.4.)
+///
+/// - `ptr parallel_executor`
+///
+///    A pointer to a `parallel_executor` (see thread.h) through which the
+///    host application's own task scheduler takes over the work of the
+///    default thread pool: `parallel_for()`, `parallel_image()`, and tasks
+///    pushed to the pool all run on the host's threads while OIIO's
+///    threads sit idle, so that an application with its own TBB arena (for
+///    which `OpenImageIO/parallel_tbb.h` has an adapter) isn't
+///    oversubscribed. Set it with
+///    `OIIO::attribute("parallel_executor", TypePointer, &executor)`, and
+///    set it back to a null pointer before the executor is destroyed. The
+///    default is null, meaning OIIO uses its own threads. (This attribute
+///    was added in OpenImageIO 2.4.)
+///
 /// - `string font_searchpath`
 ///
 ///    Colon-separated (or semicolon-separated) list of directories to search
@@ -2671,14 +3028,38 @@ OIIO_API std::string geterror(bool clear = true);
 ///    Colon-separated (or semicolon-separated) list of directories to search
 ///    for dynamically-loaded format plugins.
 ///
+///    The formats, extensions, and signatures of the plugins found there
+///    are remembered in a manifest file in the user's cache directory
+///    (or the file named by the `OIIO_PLUGIN_MANIFEST` environment
+///    variable; set it to `0` to disable the manifest). A plugin whose file
+///    has not changed since it was recorded is not loaded until one of its
+///    formats is actually used. (The manifest was added in OpenImageIO
+///    2.4.)
+///
+/// - `string spec_cache`
+///
+///    When not empty (the default is empty), the name of a directory in
+///    which to remember the ImageSpec of every subimage and MIP level of
+///    image files after they are first opened, keyed by the file's absolute
+///    path, size, and modification time. `ImageInput::open_header()` and
+///    the ImageCache's metadata queries then answer from there, without
+///    opening the file at all, as long as the file has not changed. Any
+///    number of processes may share the directory. It may also be set with
+///    the `OPENIMAGEIO_OPTIONS` environment variable, for example
+///    `OPENIMAGEIO_OPTIONS="spec_cache=/tmp/oiio_specs"`. (This attribute
+///    was added in OpenImageIO 2.4.)
+///
 /// - `int try_all_readers`
 ///
 ///    When nonzero (the default), a call to `ImageInput::create()` or
 ///    `ImageInput::open()` that does not succeed in opening the file with the
 ///    format reader implied by the file extension will try all available
-///    format readers to see if one of them can open the file. If this is
-///    zero, the only reader that will be tried is the one implied by the file
-///    extension.
+///    format readers to see if one of them can open the file. The readers
+///    whose declared "magic number" signatures match the first bytes of the
+///    file are tried first; readers with signatures that don't match are
+///    skipped, so that only formats with no known signature are tried
+///    blindly. If this is zero, the only reader that will be tried is the
+///    one implied by the file extension.
 ///
 /// - `int read_chunk`
 ///
@@ -2688,6 +3069,82 @@ OIIO_API std::string geterror(bool clear = true);
 ///    special value of 0 indicates that it should try to read the whole
 ///    image if possible.
 ///
+/// - `int use_mmap`
+///
+///    When nonzero, format readers that do their I/O through an `IOProxy`,
+///    when not handed one by the caller, will memory map the file for
+///    reading (with `Filesystem::IOMMap`) instead of using stdio, falling
+///    back to ordinary reads if the file can't be mapped. Readers able to
+///    use the mapped bytes in place (such as PNM and HDR) then skip their
+///    intermediate buffers, and TIFF files are opened allowing libtiff to
+///    use its own memory mapping. This is best reserved for files on local
+///    disks; mapping files on network file systems can behave poorly if
+///    they change or vanish while open. The default is 0. (This attribute
+///    was added in OpenImageIO 2.4.)
+///
+/// - `int imagebuf:pool_MB`
+///
+///    The maximum amount of memory, in MB, that the built-in ImageBuf pixel
+///    allocator keeps from released buffers of 1 MB or more, to hand out
+///    again to later ImageBufs of a similar size (sizes are grouped in
+///    classes no more than 25% apart). Zero, the default, disables the
+///    pool. (This attribute was added in OpenImageIO 2.4.)
+///
+/// - `int imagebuf:hugepages`
+///
+///    When nonzero, the built-in ImageBuf pixel allocator aligns buffers of
+///    2 MB or more to 2 MB and, on Linux, asks for them to be backed by
+///    transparent huge pages, reducing TLB misses and page faults when
+///    processing large images. The default is 0. (This attribute was added
+///    in OpenImageIO 2.4.)
+///
+/// - `int imagebuf:scratch_MB`
+///
+///    When nonzero, ImageBuf local pixel buffers of at least this many MB
+///    are not taken from RAM but memory mapped from a scratch file (which
+///    is deleted as soon as it's created), so that images larger than the
+///    physical memory may still be created, written to and processed: the
+///    operating system writes pixels that haven't been touched lately out
+///    to the scratch file and pages them back in when they're needed. It's
+///    much faster with pixels accessed in scanline order, as most
+///    ImageBufAlgo functions do. This is only supported on POSIX systems,
+///    and buffers fall back to ordinary memory if a scratch file can't be
+///    made. The default is 0. (This attribute was added in OpenImageIO
+///    2.4.)
+///
+/// - `string imagebuf:scratch_dir`
+///
+///    The directory where the scratch files for `"imagebuf:scratch_MB"`
+///    are made, which should be on a fast local disk with enough free
+///    space. The default, an empty string, means the system's temporary
+///    directory. (This attribute was added in OpenImageIO 2.4.)
+///
+/// - `int io_readahead`
+///
+///    The block size, in bytes, of the read-ahead buffer that is placed in
+///    front of the files opened by readers that report
+///    `supports("sequential_io")` (such as Targa, BMP, and PSD), which
+///    otherwise would issue many tiny reads. While one block is consumed,
+///    the next is read in the background on the `io_threads` pool. Zero
+///    disables the buffering. The default is 262144 (256 KB). (This
+///    attribute was added in OpenImageIO 2.4.)
+///
+/// - `int http_blocksize`
+/// - `int http_readahead`
+///
+///    Filenames that are `http://`, `https://`, or `s3://` URLs are read
+///    directly from the server with HTTP range requests by format readers
+///    that do their I/O through an `IOProxy` (which includes OpenEXR and
+///    TIFF), provided that OpenImageIO was built with libcurl. Only the
+///    parts of the file that are actually read are fetched, in blocks of
+///    `http_blocksize` bytes (default 1 MB), which are cached while the
+///    file is open. When a file is read sequentially, up to
+///    `http_readahead` further blocks (default 4) are fetched ahead in
+///    the background. `s3://bucket/key` names use the S3 endpoint for
+///    `$AWS_REGION` (or `$AWS_ENDPOINT_URL`, if set), and requests are
+///    signed if `$AWS_ACCESS_KEY_ID` and `$AWS_SECRET_ACCESS_KEY` are set.
+///    (These attributes were added in OpenImageIO 2.4.)
+///
 /// - `float[] missingcolor`, `string missingcolor`
 ///
 ///    This attribute may either be an array of float values, or a string
@@ -2729,6 +3186,11 @@ OIIO_API std::string geterror(bool clear = true);
 ///
 ///    When nonzero, use the new "OpenEXR core C library" when available,
 ///    for OpenEXR >= 3.1. This is experimental, and currently defaults to 0.
+///    This applies to writing as well as reading: the core-based writer
+///    compresses chunks in parallel on OIIO's own thread pool, honoring
+///    each ImageOutput's `threads()` rather than the global `exr_threads`.
+///    (Deep files, and files with "decreasingY" line order, are still
+///    written with the OpenEXR C++ library.)
 ///
 /// - `int limits:channels` (1024)
 ///
@@ -2765,6 +3227,30 @@ OIIO_API std::string geterror(bool clear = true);
 ///    the log information. When the `log_times` attribute is disabled,
 ///    there is no additional performance cost.
 ///
+/// - `string trace`
+///
+///    Setting `"trace"` to a filename starts recording a timeline of file
+///    opens, tile and image reads and writes, pixel conversions, texture
+///    making stages, and parallel tasks, on every thread. Setting it to ""
+///    stops recording and writes the trace to the file as Chrome
+///    trace-event JSON, which can be viewed with chrome://tracing or
+///    https://ui.perfetto.dev; a trace still being recorded is written
+///    when the application exits. The environment variable
+///    `OPENIMAGEIO_TRACE` starts a trace of the whole run. Retrieving the
+///    attribute returns the file being recorded to, or "". See
+///    `OpenImageIO/trace.h` for adding zones of your own.
+///
+/// - `string simd_dispatch`
+///
+///    On x86-64, the hottest kernels (currently the pixel data type
+///    conversions) are compiled for the build's baseline and also for AVX2
+///    and AVX-512, and the best level that the CPU and OS support is used
+///    at runtime. Setting `"simd_dispatch"` to `"baseline"`, `"avx2"`, or
+///    `"avx512"` forces that level (the call fails if the level wasn't
+///    compiled or can't run on this machine), and `""` or `"auto"` goes
+///    back to the best one. Results are the same at every level. Retrieving
+///    the attribute returns the level in use.
+///
 OIIO_API bool attribute(string_view name, TypeDesc type, const void* val);
 
 /// Shortcut attribute() for setting a single integer.
@@ -2834,6 +3320,32 @@ inline bool attribute (string_view name, string_view val) {
 ///   the approximate process memory used (resident) by the application, in
 ///   MB.
 ///
+/// - `int64 stat:memory:imagebuf`
+/// - `int64 stat:memory:imagebuf_pool`
+/// - `int64 stat:memory:deepdata`
+/// - `int64 stat:memory:metadata`
+/// - `int64 stat:memory:ustring`
+/// - `int64 stat:memory:imageinput`
+/// - `int64 stat:memory:colorprocessor`
+/// - `int64 stat:memory:total`
+///
+///   These read-only attributes report the bytes of memory currently held,
+///   process-wide, by OIIO subsystems outside of any ImageCache (whose own
+///   use is its `stat:cache_memory_used`): respectively, the local pixels
+///   of ImageBufs (including freed buffers kept for reuse by the
+///   `imagebuf:pool_MB` pool, which are also given separately), DeepData
+///   samples, attribute values too large to be stored in place (such as
+///   those of ImageSpec metadata), the ustring table, the codec state of
+///   open ImageInputs that can measure it (currently the OpenEXR reader
+///   when using the "Exr core" library), the lookup tables of cached
+///   ColorProcessors, and the sum of all of them.
+///
+/// - `int64 stat:imageinputs`
+/// - `int64 stat:imageoutputs`
+///
+///   The numbers of ImageInput and ImageOutput objects in existence, which
+///   can help to find leaks in long-running programs.
+///
 /// - `string timing_report`
 ///
 ///    Retrieving this attribute returns the timing report generated by the
@@ -2900,6 +3412,14 @@ inline string_view get_string_attribute (string_view name,
 }
 
 
+/// Return the thread pool that services asynchronous I/O, such as
+/// `ImageInput::read_image_async()`. It is sized by the `"io_threads"`
+/// attribute and kept apart from `default_thread_pool()`, so applications
+/// may also push their own file reads and writes to it, keeping them off
+/// the compute threads. (This function was added in OpenImageIO 2.4.)
+OIIO_API thread_pool* io_thread_pool ();
+
+
 /// Register the input and output 'create' routines and list of file
 /// extensions for a particular format.
 OIIO_API void declare_imageio_format (const std::string &format_name,
@@ -3031,6 +3551,16 @@ OIIO_API void premult (int nchannels, int width, int height, int depth,
                        stride_t ystride, stride_t zstride,
                        int alpha_channel = -1, int z_channel = -1);
 
+/// Convert associated to unassociated alpha by dividing all color
+/// (non-alpha, non-z) channels by alpha, the inverse of premult(). Pixels
+/// whose alpha is 0 or 1 are left unchanged. The parameters are the same
+/// as for premult().
+OIIO_API void unpremult (int nchannels, int width, int height, int depth,
+                         int chbegin, int chend,
+                         TypeDesc datatype, void *data, stride_t xstride,
+                         stride_t ystride, stride_t zstride,
+                         int alpha_channel = -1, int z_channel = -1);
+
 /// Helper routine for data conversion: Copy an image of nchannels x
 /// width x height x depth from src to dst.  The src and dst may have
 /// different data layouts, but must have the same data type.  Clever
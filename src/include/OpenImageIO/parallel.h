@@ -20,7 +20,11 @@
 
 OIIO_NAMESPACE_BEGIN
 
-/// Split strategies
+/// Split strategies. Split_Tile cuts 2D work into square tiles sized to
+/// fit in cache (see cache_tile_size()) and hands each task a run of
+/// neighbouring tiles in Morton order, which suits operations that read a
+/// 2D neighbourhood of each pixel (resampling, convolution, transposes)
+/// far better than strips across a very wide image.
 enum SplitDir { Split_X, Split_Y, Split_Z, Split_Biggest, Split_Tile };
 
 
@@ -47,7 +51,9 @@ public:
     // * If no pool was specified, use the default pool.
     // * If no max thread count was specified, use the pool size.
     // * If the calling thread is itself in the pool and the recursive flag
-    //   was not turned on, just use one thread.
+    //   was turned off, just use one thread. (Recursion is allowed by
+    //   default: a worker runs its own subtasks while it waits for them,
+    //   and idle workers steal them, so nesting can't deadlock the pool.)
     void resolve()
     {
         if (pool == nullptr)
@@ -62,14 +68,26 @@ public:
 
     int maxthreads    = 0;        // Max threads (0 = use all)
     SplitDir splitdir = Split_Y;  // Primary split direction
-    bool recursive    = false;    // Allow thread pool recursion
+    bool recursive    = true;     // Allow thread pool recursion
     size_t minitems   = 16384;    // Min items per task
+    size_t itembytes  = 0;        // Memory touched per item (0 = guess)
     thread_pool* pool = nullptr;  // If non-NULL, custom thread pool
     string_view name;             // For debugging
 };
 
 
 
+/// The side of a square tile of 2D items, each of which touches
+/// `itembytes` bytes of memory (0 means to guess 32, e.g. a 4-channel float
+/// pixel read and another written), such that a tile's working set fits
+/// in about half of the L2 cache reported by Sysutil::cache_size(). It is
+/// always a multiple of 8, at least 8 and at most 1024.
+OIIO_UTIL_API int64_t
+cache_tile_size (size_t itembytes = 0);
+// Implementation is in thread.cpp
+
+
+
 /// Parallel "for" loop, chunked: for a task that takes an int thread ID
 /// followed by an int64_t [begin,end) range, break it into non-overlapping
 /// sections that run in parallel using the default thread pool:
@@ -193,6 +211,10 @@ parallel_for_each (InputIt first, InputIt last, UnaryFunction f,
 /// a number of chunks equal to the twice number of threads in the queue.
 /// (We do this to offer better load balancing than if we used exactly the
 /// thread count.)
+///
+/// If opt.splitdir is Split_Tile, the chunks are visited in Morton order
+/// and each task is handed a run of consecutive ones, so that every thread
+/// works on a compact neighbourhood of the 2D range.
 OIIO_API void
 parallel_for_chunked_2D (int64_t xstart, int64_t xend, int64_t xchunksize,
                          int64_t ystart, int64_t yend, int64_t ychunksize,
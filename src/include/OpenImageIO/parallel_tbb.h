@@ -0,0 +1,72 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+/// \file
+/// A parallel_executor that runs OIIO's parallel work with TBB. OIIO itself
+/// does not use TBB; this header is only for applications that do, and
+/// need to include TBB and link against it themselves.
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+#include <tbb/blocked_range.h>
+#include <tbb/parallel_for.h>
+#include <tbb/task_arena.h>
+
+#include <OpenImageIO/thread.h>
+
+
+OIIO_NAMESPACE_BEGIN
+
+/// tbb_executor hands OIIO's tasks and parallel loops to a TBB task arena,
+/// so that they share TBB's worker threads with the rest of the
+/// application. Typical use:
+///
+///     static OIIO::tbb_executor executor;  // or executor(my_arena)
+///     OIIO::parallel_executor* ptr = &executor;
+///     OIIO::attribute("parallel_executor", OIIO::TypePointer, &ptr);
+///
+class tbb_executor final : public parallel_executor {
+public:
+    /// Run the work in an arena of the default concurrency. Like all
+    /// arenas, it draws on TBB's process-wide pool of worker threads.
+    tbb_executor()
+        : m_arena(&m_own_arena)
+    {
+    }
+
+    /// Run the work in the application's `arena`, which must outlive the
+    /// executor.
+    explicit tbb_executor(tbb::task_arena& arena)
+        : m_arena(&arena)
+    {
+    }
+
+    void submit(std::function<void()>&& task) override
+    {
+        m_arena->enqueue(std::move(task));
+    }
+
+    void parallel_for(int64_t start, int64_t end, int64_t grainsize,
+                      function_view<void(int64_t, int64_t)> task) override
+    {
+        size_t grain = size_t(std::max(grainsize, int64_t(1)));
+        m_arena->execute([&]() {
+            tbb::parallel_for(tbb::blocked_range<int64_t>(start, end, grain),
+                              [&](const tbb::blocked_range<int64_t>& r) {
+                                  task(r.begin(), r.end());
+                              });
+        });
+    }
+
+private:
+    tbb::task_arena m_own_arena;
+    tbb::task_arena* m_arena;
+};
+
+OIIO_NAMESPACE_END
@@ -82,16 +82,12 @@ public:
     // Set from string -- parse
     ParamValue(string_view _name, TypeDesc type, string_view value);
 
-    // Copy constructor
-    ParamValue(const ParamValue& p) noexcept
-    {
-        init_noclear(p.name(), p.type(), p.nvalues(), p.interp(), p.data(),
-                     true);
-    }
+    // Copy constructor. Values too big to be stored locally are shared
+    // with `p` (they are immutable and reference counted), not copied.
+    ParamValue(const ParamValue& p) noexcept { init_copy_noclear(p, true); }
     ParamValue(const ParamValue& p, bool _copy) noexcept
     {
-        init_noclear(p.name(), p.type(), p.nvalues(), p.interp(), p.data(),
-                     _copy);
+        init_copy_noclear(p, _copy);
     }
 
     // Rvalue (move) constructor
@@ -131,9 +127,10 @@ public:
     // Assignment
     const ParamValue& operator=(const ParamValue& p) noexcept
     {
-        if (this != &p)
-            init(p.name(), p.type(), p.nvalues(), p.interp(), p.data(),
-                 p.m_copy);
+        if (this != &p) {
+            clear_value();
+            init_copy_noclear(p, p.m_copy);
+        }
         return *this;
     }
     const ParamValue& operator=(ParamValue&& p) noexcept
@@ -209,6 +206,11 @@ public:
     ustring get_ustring(int maxsize = 64) const;
     ustring get_ustring_indexed(int index) const;
 
+    /// Return the total bytes of heap memory, across the whole process,
+    /// holding the values of ParamValues too big to be stored in place
+    /// (each block being counted once, however many copies share it).
+    static size_t heap_memory() noexcept;
+
 private:
     ustring m_name;   ///< data name
     TypeDesc m_type;  ///< data type, which may itself be an array
@@ -226,6 +228,7 @@ private:
     void init_noclear(ustring _name, TypeDesc _type, int _nvalues,
                       Interp _interp, const void* _value,
                       bool _copy = true) noexcept;
+    void init_copy_noclear(const ParamValue& p, bool _copy) noexcept;
     void clear_value() noexcept;
 };
 
@@ -560,6 +560,30 @@ inline bool cpu_has_avx512er() {int i[4]; cpuid(i,7,0); return (i[1] & (1<<27))
 inline bool cpu_has_avx512cd() {int i[4]; cpuid(i,7,0); return (i[1] & (1<<28)) != 0; }
 inline bool cpu_has_avx512bw() {int i[4]; cpuid(i,7,0); return (i[1] & (1<<30)) != 0; }
 inline bool cpu_has_avx512vl() {int i[4]; cpuid(i,7,0); return (i[1] & (0x80000000 /*1<<31*/)) != 0; }
+inline bool cpu_has_sha   () {int i[4]; cpuid(i,7,0); return (i[1] & (1<<29)) != 0; }
+
+/// Does the OS save the extended register state selected by `mask` (XCR0
+/// bits, e.g. 0x6 for AVX or 0xe6 for AVX-512) on context switches? A CPU
+/// may support AVX without the OS enabling it, and then using it faults.
+inline bool os_saves_xstate(uint64_t mask)
+{
+#if (defined(_WIN32) || defined(__i386__) || defined(__x86_64__))
+    int i[4];
+    cpuid(i, 1, 0);
+    if (!(i[2] & (1 << 27)))  // OSXSAVE
+        return false;
+# ifdef _MSC_VER
+    uint64_t xcr0 = _xgetbv(0);
+# else
+    uint32_t lo, hi;
+    __asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    uint64_t xcr0 = (uint64_t(hi) << 32) | lo;
+# endif
+    return (xcr0 & mask) == mask;
+#else
+    return false;
+#endif
+}
 
 // portable aligned malloc
 OIIO_API void* aligned_malloc(std::size_t size, std::size_t align);
@@ -52,6 +52,13 @@ memory_used(bool resident = true);
 OIIO_API size_t
 physical_memory();
 
+/// The most memory this process may use, in bytes: the physical memory, or
+/// less if the process is in a Linux control group with a lower limit (the
+/// cgroup v2 `memory.max` of its group or any ancestor, or the cgroup v1
+/// `memory.limit_in_bytes`). Return 0 if it can't be determined.
+OIIO_API size_t
+memory_limit();
+
 /// Convert calendar time pointed by 'time' into local time and save it in
 /// 'converted_time' variable. This is a fully reentrant/thread-safe
 /// alternative to the non-reentrant C localtime() call.
@@ -96,6 +103,22 @@ hardware_concurrency();
 OIIO_API unsigned int
 physical_concurrency();
 
+/// Number of NUMA nodes (groups of cores sharing local memory) on this
+/// machine, or 1 if that can't be determined on this platform.
+OIIO_API int
+numa_nodes();
+
+/// The NUMA node of the core the calling thread is running on at this
+/// moment (which may change if the thread is not pinned), or 0 if that
+/// can't be determined on this platform.
+OIIO_API int
+current_numa_node();
+
+/// The size in bytes of the level `level` data cache (1, 2, or 3) of the
+/// cores of this machine, or 0 if that can't be determined.
+OIIO_API size_t
+cache_size(int level = 2);
+
 /// Get the maximum number of open file handles allowed on this system.
 OIIO_API size_t
 max_open_files();
@@ -166,6 +189,39 @@ private:
 };
 
 
+
+/// MemoryPressureMonitor watches for the kernel reporting that this
+/// process's control group (or, failing that, the whole system) is short
+/// of memory: that its tasks have together spent at least `stall_us`
+/// microseconds waiting for memory within some `window_us` span. It uses
+/// Linux PSI ("pressure stall information") triggers, so on other
+/// platforms, or kernels without PSI, it's never valid(). Unprivileged
+/// processes may only use windows that are multiples of 2 seconds.
+class OIIO_API MemoryPressureMonitor {
+public:
+    MemoryPressureMonitor(int stall_us = 200000, int window_us = 2000000);
+    ~MemoryPressureMonitor();
+    MemoryPressureMonitor(const MemoryPressureMonitor&) = delete;
+    MemoryPressureMonitor& operator=(const MemoryPressureMonitor&) = delete;
+
+    /// Can this monitor report memory pressure?
+    bool valid() const noexcept { return m_trigger >= 0; }
+
+    /// Wait up to `timeout_ms` milliseconds for memory pressure. Return
+    /// true if there was some, or false if the time ran out, interrupt()
+    /// was called, or the monitor isn't valid (which returns right away).
+    bool wait(int timeout_ms);
+
+    /// Make a wait() in another thread, and any later one, return false
+    /// right away.
+    void interrupt();
+
+private:
+    int m_trigger = -1;          // The PSI trigger's file descriptor
+    int m_wake[2] = { -1, -1 };  // Pipe that interrupt() writes to
+};
+
+
 }  // namespace Sysutil
 
 OIIO_NAMESPACE_END
@@ -98,6 +98,7 @@ enum class MipMode {
     Aniso,      ///< Use two MIPmap levels w/ anisotropic
     StochasticTrilinear, ///< Stochastic trilinear
     StochasticAniso, ///< Stochastic anisotropic
+    EWA,        ///< Elliptically weighted average in a single MIP level
 };
 
 /// Interp mode determines how we sample within a mipmap level
@@ -106,7 +107,8 @@ enum class InterpMode {
     Closest,      ///< Force closest texel
     Bilinear,     ///< Force bilinear lookup within a mip level
     Bicubic,      ///< Force cubic lookup within a mip level
-    SmartBicubic  ///< Bicubic when magnifying, else bilinear
+    SmartBicubic, ///< Bicubic when magnifying, else bilinear
+    StochasticBilinear ///< One texel chosen by the bilinear weights
 };
 
 
@@ -197,6 +199,7 @@ public:
         MipModeAniso,      ///< Use two MIPmap levels w/ anisotropic
         MipModeStochasticTrilinear, ///< Stochastic trilinear
         MipModeStochasticAniso, ///< Stochastic anisotropic
+        MipModeEWA,        ///< Elliptically weighted average, one MIP level
     };
 
     /// Interp mode determines how we sample within a mipmap level
@@ -205,7 +208,8 @@ public:
         InterpClosest,      ///< Force closest texel
         InterpBilinear,     ///< Force bilinear lookup within a mip level
         InterpBicubic,      ///< Force cubic lookup within a mip level
-        InterpSmartBicubic  ///< Bicubic when magnifying, else bilinear
+        InterpSmartBicubic, ///< Bicubic when magnifying, else bilinear
+        InterpStochasticBilinear ///< One texel chosen by the bilinear weights
     };
 
 
@@ -220,7 +224,7 @@ public:
         fill(0.0f), missingcolor(nullptr),
         time(0.0f), rnd(0.0f), samples(1),
         rwrap(WrapDefault), rblur(0.0f), rwidth(1.0f),
-        envlayout(0)
+        roughness(0.0f), envlayout(0)
     { }
 
     /// Convert a TextureOptions for one index into a TextureOpt.
@@ -252,6 +256,21 @@ public:
     float rblur;   ///< Blur amount in the r direction
     float rwidth;  ///< Multiplier for derivatives in r direction
 
+    /// For latlong environment lookups only: if nonzero, return the
+    /// environment convolved with a reflection lobe around the direction,
+    /// rather than filtered over the ray derivatives. A value in (0,1] is
+    /// the (perceptual) GGX roughness of a specular lobe, and a negative
+    /// value asks for the cosine-weighted (diffuse) lobe. Maps made by
+    /// maketx with `"maketx:envlobes"` hold these lobes prefiltered, so
+    /// that each such lookup is a single trilinear probe; for other maps,
+    /// the lookup is approximated by blurring by the width of the lobe.
+    float roughness;
+
+    /// Caller's tag for the call site (for example, a shader name and
+    /// line), under which lookup costs are tallied while the
+    /// `"lookup_stats"` attribute is on. It is otherwise ignored.
+    ustring site;
+
     /// Utility: Return the Wrap enum corresponding to a wrap name:
     /// "default", "black", "clamp", "periodic", "mirror".
     static Wrap decode_wrapmode(const char* name)
@@ -315,6 +334,11 @@ public:
     int conservative_filter = 1;          ///< True: over-blur rather than alias
     float fill = 0.0f;                    ///< Fill value for missing channels
     const float *missingcolor = nullptr;  ///< Color for missing texture
+#if OIIO_VERSION_GREATER_EQUAL(2,4,0)
+    float bias = 0.0f;                    ///< Depth bias for shadow lookups
+    int samples = 1;                      ///< Number of samples for shadows
+    ustring site;                         ///< Call site tag for lookup_stats
+#endif
 
 private:
     // Options set INTERNALLY by libtexture after the options are passed
@@ -583,6 +607,13 @@ public:
     /// - `int flip_t` :
     ///             If nonzero, `t` coordinates will be flipped `1-t` for
     ///             all texture lookups. The default is 0.
+    /// - `int lookup_stats` :
+    ///             If nonzero, tally the cost of lookups per texture and
+    ///             per `TextureOpt::site` tag: points looked up, filter
+    ///             probes, texels fetched, tile microcache misses, and time
+    ///             spent reading tiles. They are reported by `getstats()`
+    ///             and `lookup_stats_json()`. The default is 0, which
+    ///             costs nothing.
     ///
     /// - `string options`
     ///             This catch-all is simply a comma-separated list of
@@ -1369,6 +1400,53 @@ public:
     /// @}
 
 
+    /// @{
+    /// @name   Deferred texture lookups
+    ///
+    /// Incoherent lookups (for example, from secondary rays) arrive in
+    /// essentially random order, which thrashes both the per-thread tile
+    /// microcache and the CPU caches. Instead of looking each one up as it
+    /// arrives, a renderer may collect many of them and hand them to
+    /// `texture_deferred()`, which sorts them by texture, MIP level and
+    /// tile before executing them.
+
+    /// One deferred 2D texture lookup.
+    struct TextureRequest {
+        TextureHandle *texture_handle = nullptr;  ///< Texture to look up
+        float s = 0.0f, t = 0.0f;                 ///< Texture coordinates
+        float dsdx = 0.0f, dtdx = 0.0f;           ///< Differentials
+        float dsdy = 0.0f, dtdy = 0.0f;
+        float *result = nullptr;     ///< Where to store the nchannels results
+        float *dresultds = nullptr;  ///< Optional derivative results
+        float *dresultdt = nullptr;
+    };
+
+    /// Perform all of the 2D texture lookups in `requests`, with the same
+    /// `options` and `nchannels` for all of them, in an order of the
+    /// texture system's choosing. Each request's results land in its own
+    /// `result` (and, if non-null, `dresultds`/`dresultdt`) storage,
+    /// exactly as the single-point `texture()` would have produced them.
+    ///
+    /// Before executing, the requests are sorted so that lookups of the
+    /// same texture, at the same estimated MIP level, on the same tile,
+    /// are done back to back. The statistics `"stat:deferred_queries"`,
+    /// `"stat:deferred_tile_switches"` and
+    /// `"stat:deferred_tile_switches_unsorted"` (and `getstats()`) report
+    /// how many tile changes the sorted order needed compared to the
+    /// order in which the requests were submitted.
+    ///
+    /// @returns
+    ///             `true` if all of the lookups succeeded.
+    ///
+    /// This method was added in OpenImageIO 2.4.
+    virtual bool texture_deferred (Perthread *thread_info,
+                                   TextureOpt &options,
+                                   cspan<TextureRequest> requests,
+                                   int nchannels) = 0;
+
+    /// @}
+
+
     /// @{
     /// @name   Texture metadata and raw texels
     ///
@@ -1714,6 +1792,16 @@ public:
                                         Perthread* thread_info,
                                         float s, float t) = 0;
 
+    /// Batched `resolve_udim()`: for each point `i` enabled in `mask`,
+    /// set `handles[i]` to the handle of the concrete tile file for
+    /// texture coordinates `(s[i], t[i])`, or nullptr if there is no
+    /// such tile. `s`, `t` and `handles` have `Tex::BatchWidth` entries.
+    ///
+    /// This method was added in OpenImageIO 2.4.
+    virtual void resolve_udim(TextureHandle* udimfile, Perthread* thread_info,
+                              Tex::RunMask mask, const float* s,
+                              const float* t, TextureHandle** handles) = 0;
+
     /// Produce a full inventory of the set of concrete files comprising the
     /// UDIM set specified by UTF-8 encoded `udimpattern`.  The apparent
     /// number of texture atlas tiles in the u and v directions will be
@@ -1789,6 +1877,17 @@ public:
     /// texture-specific statistics.
     virtual std::string getstats (int level=1, bool icstats=true) const = 0;
 
+    /// Return the per-texture and per-call-site lookup cost counters
+    /// gathered while the `"lookup_stats"` attribute was on, as a JSON
+    /// object with members `"textures"` and `"sites"`, each an array
+    /// (sorted by decreasing number of texels fetched) of objects with
+    /// members `"name"`, `"lookups"`, `"probes"`, `"texels"`,
+    /// `"microcache_misses"`, and `"io_time"` (in seconds).  The counters
+    /// are cleared by `reset_stats()`.
+    ///
+    /// This method was added in OpenImageIO 2.4.
+    virtual std::string lookup_stats_json () const = 0;
+
     /// Reset most statistics to be as they were with a fresh TextureSystem.
     /// Caveat emptor: this does not flush the cache itself, so the resulting
     /// statistics from the next set of texture requests will not match the
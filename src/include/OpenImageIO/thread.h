@@ -27,6 +27,7 @@
 #include <OpenImageIO/atomic.h>
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/export.h>
+#include <OpenImageIO/function_view.h>
 #include <OpenImageIO/oiioversion.h>
 #include <OpenImageIO/platform.h>
 
@@ -515,6 +516,142 @@ typedef spin_rw_mutex::write_lock_guard spin_rw_write_lock;
 
 
 
+/// Reader/writer spin mutex for data that is read far more often than it
+/// is written. A spin_rw_mutex keeps a single count of readers, so every
+/// read_lock() and read_unlock() moves that one cache line between the
+/// cores that use the mutex. This one instead keeps `Slots` reader counts,
+/// each on its own cache line, and each thread only touches the one that
+/// its thread id hashes to, so read locking scales with the number of
+/// threads. The costs are a write_lock() that must wait on every slot and
+/// `Slots + 1` cache lines of memory per mutex.
+///
+/// It has the same interface as spin_rw_mutex, and can stand in for it
+/// (for example, as the bin mutex of an unordered_map_concurrent). A read
+/// lock must be released by the thread that acquired it.
+template<int Slots = 8> class distributed_rw_mutex {
+public:
+    static_assert(Slots > 0 && (Slots & (Slots - 1)) == 0,
+                  "distributed_rw_mutex Slots must be a power of 2");
+
+    /// Default constructor -- initialize to unlocked.
+    ///
+    distributed_rw_mutex() noexcept {}
+
+    ~distributed_rw_mutex() noexcept {}
+
+    // Do not allow copy or assignment.
+    distributed_rw_mutex(const distributed_rw_mutex&) = delete;
+    const distributed_rw_mutex& operator=(const distributed_rw_mutex&) = delete;
+
+    /// Acquire the reader lock.
+    ///
+    void read_lock() noexcept
+    {
+        std::atomic<int>& readers(m_slots[slot()].readers);
+        // Register as a reader, and if nobody is writing, we're done.
+        // Otherwise, back out and wait for the writer to finish. The
+        // increment and the writer check are sequentially consistent, as
+        // are their counterparts in write_lock(), so a reader and a writer
+        // can't both miss each other.
+        for (;;) {
+            readers.fetch_add(1);
+            if (!m_writer.load())
+                return;
+            readers.fetch_sub(1, std::memory_order_relaxed);
+            atomic_backoff backoff;
+            while (m_writer.load(std::memory_order_relaxed))
+                backoff();
+        }
+    }
+
+    /// Release the reader lock.
+    ///
+    void read_unlock() noexcept
+    {
+        m_slots[slot()].readers.fetch_sub(1, std::memory_order_release);
+    }
+
+    /// Acquire the writer lock.
+    ///
+    void write_lock() noexcept
+    {
+        // Become the only writer, which stops new readers, then wait for
+        // the readers already in every slot to leave.
+        bool expected = false;
+        if (!m_writer.compare_exchange_weak(expected, true)) {
+            atomic_backoff backoff;
+            do {
+                backoff();
+                expected = false;
+            } while (!m_writer.compare_exchange_weak(expected, true));
+        }
+        for (auto& s : m_slots) {
+            if (s.readers.load() != 0) {
+                atomic_backoff backoff;
+                do {
+                    backoff();
+                } while (s.readers.load() != 0);
+            }
+        }
+    }
+
+    /// Release the writer lock.
+    ///
+    void write_unlock() noexcept
+    {
+        m_writer.store(false, std::memory_order_release);
+    }
+
+    /// lock() is a synonym for exclusive (write) lock.
+    void lock() { write_lock(); }
+
+    /// unlock() is a synonym for exclusive (write) unlock.
+    void unlock() { write_unlock(); }
+
+    /// Helper class: scoped read lock for a distributed_rw_mutex -- grabs
+    /// the read lock upon construction, releases the lock when it exits
+    /// scope.
+    class read_lock_guard {
+    public:
+        read_lock_guard (distributed_rw_mutex &fm) noexcept : m_fm(fm) { m_fm.read_lock(); }
+        ~read_lock_guard () noexcept { m_fm.read_unlock(); }
+    private:
+        read_lock_guard(const read_lock_guard& other) = delete;
+        read_lock_guard& operator = (const read_lock_guard& other) = delete;
+        distributed_rw_mutex & m_fm;
+    };
+
+    /// Helper class: scoped write lock for a distributed_rw_mutex -- grabs
+    /// the write lock upon construction, releases the lock when it exits
+    /// scope.
+    class write_lock_guard {
+    public:
+        write_lock_guard (distributed_rw_mutex &fm) noexcept : m_fm(fm) { m_fm.write_lock(); }
+        ~write_lock_guard () noexcept { m_fm.write_unlock(); }
+    private:
+        write_lock_guard(const write_lock_guard& other) = delete;
+        write_lock_guard& operator = (const write_lock_guard& other) = delete;
+        distributed_rw_mutex & m_fm;
+    };
+
+private:
+    struct Slot {
+        OIIO_CACHE_ALIGN std::atomic<int> readers { 0 };
+    };
+    OIIO_CACHE_ALIGN std::atomic<bool> m_writer { false };
+    Slot m_slots[Slots];
+
+    // The reader slot of the calling thread. Thread ids are often
+    // addresses with many zero low bits, so mix them up first.
+    static size_t slot() noexcept
+    {
+        uint64_t h = std::hash<std::thread::id>()(std::this_thread::get_id());
+        return size_t((h * 0x9e3779b97f4a7c15ULL) >> 40) & (Slots - 1);
+    }
+};
+
+
+
 /// Mutex pool. Sometimes, we have lots of objects that need to be
 /// individually locked for thread safety, but two separate objects don't
 /// need to lock against each other. If there are many more objects than
@@ -591,6 +728,34 @@ private:
 
 
 
+/// parallel_executor is the interface to a task scheduler belonging to the
+/// host application (for example, a TBB task arena -- see parallel_tbb.h
+/// for a ready-made adapter). Once it is given to a thread_pool with
+/// set_executor(), or to the default pool with the global
+/// `"parallel_executor"` attribute, the pool's own threads go idle and the
+/// work that OIIO would have run on them runs on the host's threads
+/// instead, so that OIIO and the application don't oversubscribe the
+/// machine between them.
+class OIIO_UTIL_API parallel_executor {
+public:
+    virtual ~parallel_executor();
+
+    /// Run `task` at some point, on any thread, and return without
+    /// waiting for it. The pool submits one of these for each task pushed
+    /// to it, and each one runs a waiting task from the pool's queue, if
+    /// there still is one by then.
+    virtual void submit(std::function<void()>&& task) = 0;
+
+    /// Call `task(b, e)` on non-overlapping ranges [b,e) that together
+    /// cover [start,end), split no finer than about `grainsize` items,
+    /// running them in parallel and returning only when all are done. The
+    /// calling thread may itself be one of the executor's.
+    virtual void parallel_for(int64_t start, int64_t end, int64_t grainsize,
+                              function_view<void(int64_t, int64_t)> task) = 0;
+};
+
+
+
 /// thread_pool is a persistent set of threads watching a queue to which
 /// tasks can be submitted.
 ///
@@ -643,7 +808,14 @@ private:
 /// The task function's first argument, the thread_id, is the thread number
 /// for the pool, or -1 if it's being executed by a non-pool thread (this
 /// can happen in cases where the whole pool is occupied and the calling
-/// thread contributes to running the work load).
+/// thread contributes to running the work load), or by a pool thread that
+/// is helping out while it waits for other tasks.
+///
+/// Tasks pushed from outside the pool go on a shared queue. Tasks pushed
+/// by a pool thread (i.e., subtasks of a task) go on that thread's own
+/// deque: it runs the newest of them first, while idle threads steal the
+/// oldest. A pool thread that waits on a task_set helps run tasks rather
+/// than blocking, so tasks may safely push subtasks and wait for them.
 ///
 /// Thread pool. Have fun, be safe.
 ///
@@ -749,6 +921,20 @@ public:
     /// queue.
     bool very_busy() const;
 
+    /// Hand this pool's work to the host application's scheduler: while
+    /// `executor` is set, the pool's own threads sit idle, every task
+    /// pushed is run by a thread of the executor (or by a thread waiting
+    /// on a task_set, which helps as usual), and parallel_for and friends
+    /// split their loops with executor->parallel_for(). Passing nullptr
+    /// puts the pool's threads back to work. The executor must outlive
+    /// its use by the pool, and the pool must outlive any tasks already
+    /// submitted to the executor.
+    void set_executor(parallel_executor* executor);
+
+    /// The executor set with set_executor(), or nullptr if the pool runs
+    /// its tasks on its own threads.
+    parallel_executor* executor() const;
+
 private:
     // Disallow copy construction and assignment
     thread_pool(const thread_pool&) = delete;
@@ -823,13 +1009,14 @@ public:
     // submitted as part of this task_set). If block == true, fully block
     // while waiting for that task to finish. If block is false, then busy
     // wait, and opportunistically run queue tasks yourself while you are
-    // waiting for the task to finish.
+    // waiting for the task to finish (even if you are a pool thread).
     void wait_for_task(size_t taskindex, bool block = false);
 
     // Wait for all tasks in the set to finish. If block == true, fully
     // block while waiting for the pool threads to all finish. If block is
     // false, then busy wait, and opportunistically run queue tasks yourself
-    // while you are waiting for other tasks to finish.
+    // while you are waiting for other tasks to finish (even if you are a
+    // pool thread, which is what makes nested parallelism safe).
     void wait(bool block = false);
 
     // Debugging sanity check, called after wait(), to ensure that all the
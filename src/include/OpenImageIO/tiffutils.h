@@ -217,6 +217,21 @@ OIIO_API bool decode_xmp (const std::string& xml, ImageSpec &spec);
 /// be part of ordinary TIFF or exif tags.
 OIIO_API std::string encode_xmp (const ImageSpec &spec, bool minimal=false);
 
+/// Keep a raw metadata block in spec without decoding it yet, as a hidden
+/// attribute, to be decoded later by `decode_deferred_metadata()`. The
+/// `kind` is one of "exif", "xmp", or "iptc", saying whether it is to be
+/// decoded by `decode_exif()`, `decode_xmp()`, or `decode_iptc_iim()`.
+/// Readers opened with the "oiio:LazyMetadata" configuration hint do this
+/// instead of decoding the blocks while the file is being opened. Return
+/// false if `kind` is not one of those.
+OIIO_API bool defer_metadata (string_view kind, cspan<uint8_t> blob,
+                              ImageSpec &spec);
+
+/// Decode all the metadata blocks that `defer_metadata()` kept in spec,
+/// in the order they were kept, replacing them with the metadata they
+/// hold. Return true if there were any.
+OIIO_API bool decode_deferred_metadata (ImageSpec &spec);
+
 
 /// Handy structure to hold information mapping TIFF/EXIF tags to their
 /// names and actions.
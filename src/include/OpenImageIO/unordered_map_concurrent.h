@@ -5,6 +5,9 @@
 
 #pragma once
 
+#include <algorithm>
+#include <memory>
+
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/hash.h>
 #include <OpenImageIO/thread.h>
@@ -91,10 +94,26 @@ find_with_hash(Map& map, const Key& key, size_t /*hash*/)
 /// the first entry of the next bin, it will also release its current
 /// lock and obtain a lock on the next bin.
 ///
+/// A bin's table grows as entries are added, but rather than rehashing
+/// all of its entries at once (during which nobody else could use the
+/// bin), a bin that has grown past a modest size moves its full table
+/// aside and starts a new one of twice the capacity. Each subsequent
+/// insertion or erasure in the bin then moves a few entries from the old
+/// table to the new one, until none are left. Lookups search both tables
+/// in the meantime, so no operation ever waits for more than a small,
+/// bounded amount of rehashing. The stats() method reports how full the
+/// bins are and how many such resizes there have been.
+///
+/// Each bin is locked with a MUTEX, which is a spin_rw_mutex by default.
+/// For maps that are read far more often than they're modified, by many
+/// threads at once, a distributed_rw_mutex lets readers of the same bin
+/// proceed without contending for its lock's cache line.
+///
 
 template<class KEY, class VALUE, class HASH = std::hash<KEY>,
          class PRED = std::equal_to<KEY>, size_t BINS = 16,
-         class BINMAP = std::unordered_map<KEY, VALUE, HASH, PRED>>
+         class BINMAP = std::unordered_map<KEY, VALUE, HASH, PRED>,
+         class MUTEX  = spin_rw_mutex>
 class unordered_map_concurrent {
 public:
     typedef BINMAP BinMap_t;
@@ -115,7 +134,7 @@ public:
     class iterator {
     public:
         friend class unordered_map_concurrent<KEY, VALUE, HASH, PRED, BINS,
-                                              BINMAP>;
+                                              BINMAP, MUTEX>;
 
     public:
         /// Construct an unordered_map_concurrent iterator that points
@@ -123,6 +142,7 @@ public:
         iterator(unordered_map_concurrent* umc = NULL)
             : m_umc(umc)
             , m_bin(-1)
+            , m_table(nullptr)
             , m_locked(false)
         {
         }
@@ -134,6 +154,7 @@ public:
         {
             m_umc         = src.m_umc;
             m_bin         = src.m_bin;
+            m_table       = src.m_table;
             m_biniterator = src.m_biniterator;
             m_locked      = src.m_locked;
             // assignment transfers lock ownership
@@ -173,8 +194,7 @@ public:
         /// equivalent to the end() iterator.
         operator bool()
         {
-            return m_umc && m_bin >= 0
-                   && m_biniterator != m_umc->m_bins[m_bin].map.end();
+            return m_umc && m_bin >= 0 && m_biniterator != m_table->end();
         }
 
         /// Iterator assignment transfers ownership of any bin locks
@@ -184,6 +204,7 @@ public:
             unbin();
             m_umc         = src.m_umc;
             m_bin         = src.m_bin;
+            m_table       = src.m_table;
             m_biniterator = src.m_biniterator;
             m_locked      = src.m_locked;
             // assignment transfers lock ownership
@@ -197,7 +218,8 @@ public:
                 return false;
             if (m_bin == -1 && other.m_bin == -1)
                 return true;
-            return m_bin == other.m_bin && m_biniterator == other.m_biniterator;
+            return m_bin == other.m_bin && m_table == other.m_table
+                   && m_biniterator == other.m_biniterator;
         }
         bool operator!=(const iterator& other) { return !(*this == other); }
 
@@ -210,7 +232,7 @@ public:
             OIIO_DASSERT(m_umc);
             OIIO_DASSERT(m_bin >= 0);
             ++m_biniterator;
-            while (m_biniterator == m_umc->m_bins[m_bin].map.end()) {
+            while (m_biniterator == m_table->end() && !next_table()) {
                 if (m_bin == BINS - 1) {
                     // ran off the end
                     unbin();
@@ -246,7 +268,7 @@ public:
         bool incr_no_lock()
         {
             ++m_biniterator;
-            return (m_biniterator != m_umc->m_bins[m_bin].map.end());
+            return m_biniterator != m_table->end() || next_table();
         }
 
     private:
@@ -269,12 +291,27 @@ public:
             unbin();
             m_bin = newbin;
             lock();
-            m_biniterator = m_umc->m_bins[m_bin].map.begin();
+            m_table       = &m_umc->m_bins[m_bin].map;
+            m_biniterator = m_table->begin();
+        }
+
+        // Having run off the end of the bin's main table, move on to the
+        // entries that a resize of the bin hasn't yet moved out of its old
+        // table, if there are any. Return true if we now point to one.
+        bool next_table()
+        {
+            Bin& bin(m_umc->m_bins[m_bin]);
+            if (m_table != &bin.map || bin.old.empty())
+                return false;
+            m_table       = &bin.old;
+            m_biniterator = bin.old.begin();
+            return true;
         }
 
         unordered_map_concurrent* m_umc;  // which umc this iterator refers to
         int m_bin;                        // which bin within the umc
-        BinMap_iterator_t m_biniterator;  // which entry within the bin
+        BinMap_t* m_table;                // which table of the bin
+        BinMap_iterator_t m_biniterator;  // which entry within the table
         bool m_locked;                    // do we own the lock on the bin?
     };
 
@@ -284,7 +321,7 @@ public:
     {
         iterator i(this);
         i.rebin(0);
-        while (i.m_biniterator == m_bins[i.m_bin].map.end()) {
+        while (i.m_biniterator == i.m_table->end() && !i.next_table()) {
             if (i.m_bin == BINS - 1) {
                 // ran off the end
                 i.unbin();
@@ -303,6 +340,29 @@ public:
         return i;
     }
 
+    /// Return a locked iterator pointing to the first entry of bin `b`,
+    /// or the end() iterator if that bin is empty. Unlike begin(), this
+    /// never moves on to subsequent bins, and the caller should advance
+    /// it only with `incr_no_lock()`, which stays within the bin. This
+    /// allows clients to visit the contents of one bin at a time (for
+    /// example, to let several threads do independent work on different
+    /// bins).
+    iterator bin_begin(size_t b)
+    {
+        OIIO_DASSERT(b < BINS);
+        iterator i(this);
+        i.rebin(int(b));
+        if (i.m_biniterator == i.m_table->end() && !i.next_table())
+            i.unbin();
+        return i;
+    }
+
+    /// Return the bin number that the key will always map to.
+    size_t bin_of(const KEY& key) { return whichbin(m_hash(key)); }
+
+    /// Return the number of bins.
+    static constexpr size_t nbins() { return BINS; }
+
     /// Search for key.  If found, return an iterator referring to the
     /// element, otherwise, return an iterator that is equivalent to
     /// this->end().  If do_lock is true, lock the bin that we're
@@ -318,8 +378,9 @@ public:
         Bin& bin(m_bins[b]);
         if (do_lock)
             bin.lock();
-        auto it = find_with_hash(bin.map, key, hash);
-        if (it == bin.map.end()) {
+        BinMap_t* table;
+        auto it = bin.lookup(key, hash, table);
+        if (it == table->end()) {
             // not found -- return the 'end' iterator
             if (do_lock)
                 bin.unlock();
@@ -328,6 +389,7 @@ public:
         // Found
         iterator i(this);
         i.m_bin         = (unsigned)b;
+        i.m_table       = table;
         i.m_biniterator = it;
         i.m_locked      = do_lock;
         return i;
@@ -354,9 +416,10 @@ public:
         iret.m_locked = do_lock;
         if (do_lock)
             bin.lock();
-        iret.m_biniterator = find_with_hash(bin.map, key, hash);
-        if (iret.m_biniterator == bin.map.end()) {
+        iret.m_biniterator = bin.lookup(key, hash, iret.m_table);
+        if (iret.m_biniterator == iret.m_table->end()) {
             // Not found in the map, insert it
+            bin.prepare_insert();
             auto result = bin.map.emplace(key, value);
             if (result.second) {
                 // the insert was successful!
@@ -380,8 +443,9 @@ public:
         Bin& bin(m_bins[b]);
         if (do_lock)
             bin.read_lock();
-        auto it    = find_with_hash(bin.map, key, hash);
-        bool found = (it != bin.map.end());
+        BinMap_t* table;
+        auto it    = bin.lookup(key, hash, table);
+        bool found = (it != table->end());
         if (found)
             value = it->second;
         if (do_lock)
@@ -404,17 +468,20 @@ public:
         Bin& bin(m_bins[b]);
         if (do_lock)
             bin.lock();
-        auto result = bin.map.emplace(key, value);
-        if (result.second) {
-            // the insert was successful!
+        BinMap_t* table;
+        auto it    = bin.lookup(key, hash, table);
+        bool added = (it == table->end());
+        if (added) {
+            bin.prepare_insert();
+            bin.map.emplace(key, value);
             ++m_size;
         } else {
             // Replace caller's value with the one already in the table.
-            value = result.first->second;
+            value = it->second;
         }
         if (do_lock)
             bin.unlock();
-        return result.second;
+        return added;
     }
 
     /// Insert <key,value> into the hash map if it's not already there.
@@ -434,14 +501,17 @@ public:
         Bin& bin(m_bins[b]);
         if (do_lock)
             bin.lock();
-        auto result = bin.map.emplace(key, value);
-        if (result.second) {
-            // the insert was successful!
+        BinMap_t* table;
+        auto it    = bin.lookup(key, hash, table);
+        bool added = (it == table->end());
+        if (added) {
+            bin.prepare_insert();
+            bin.map.emplace(key, value);
             ++m_size;
         }
         if (do_lock)
             bin.unlock();
-        return result.second;
+        return added;
     }
 
     /// If the key is in the map, safely erase it.
@@ -455,8 +525,14 @@ public:
         Bin& bin(m_bins[b]);
         if (do_lock)
             bin.lock();
-        bin.map.erase(key, hash);
-        --m_size;
+        BinMap_t* table;
+        auto it = bin.lookup(key, hash, table);
+        if (it != table->end()) {
+            table->erase(it);
+            --m_size;
+        }
+        if (!bin.old.empty())
+            bin.migrate(migrate_step);
         if (do_lock)
             bin.unlock();
     }
@@ -486,11 +562,56 @@ public:
     // determine the bin number.
     static constexpr size_t nobin_mask() { return ~size_t(0) >> log2(BINS); }
 
+    /// How full the map's bins are, as reported by stats().
+    struct Stats {
+        size_t entries     = 0;  ///< Entries in all the bins
+        size_t buckets     = 0;  ///< Hash table buckets of all the bins
+        size_t max_entries = 0;  ///< Entries in the fullest bin
+        size_t resizes     = 0;  ///< Incremental resizes begun, ever
+        size_t resizing    = 0;  ///< Bins with a resize under way now
+        size_t unmoved     = 0;  ///< Entries those resizes haven't moved
+
+        /// Entries per bucket, over all the bins.
+        float load_factor() const
+        {
+            return buckets ? float(entries) / float(buckets) : 0.0f;
+        }
+    };
+
+    /// Gather statistics of the bins, locking each in turn for reading.
+    Stats stats() const
+    {
+        Stats st;
+        for (const Bin& bin : m_bins) {
+            bin.read_lock();
+            size_t n = bin.map.size() + bin.old.size();
+            st.entries += n;
+            st.buckets += bin.map.bucket_count() + bin.old.bucket_count();
+            st.max_entries = std::max(st.max_entries, n);
+            st.resizes += bin.resizes;
+            st.resizing += !bin.old.empty();
+            st.unmoved += bin.old.size();
+            bin.read_unlock();
+        }
+        return st;
+    }
+
 private:
+    // A bin only resizes incrementally once its table holds this many
+    // entries; smaller ones are quicker to just rehash in place.
+    static constexpr size_t resize_min = 1024;
+    // How many entries each insertion or erasure in a bin moves to its new
+    // table while it's resizing. This is enough for the old table to be
+    // emptied long before the new one (twice the size) fills.
+    static constexpr size_t migrate_step = 16;
+
     struct Bin {
         OIIO_CACHE_ALIGN                  // align bin to cache line
-            mutable spin_rw_mutex mutex;  // mutex for this bin
+            mutable MUTEX mutex;          // mutex for this bin
         BinMap_t map;                     // hash map for this bin
+        BinMap_t old;                     // entries not yet moved by resize
+        std::unique_ptr<KEY> next;        // entry of `old` to move next
+        size_t resizes = 0;               // incremental resizes begun
 #ifndef NDEBUG
         mutable atomic_int m_nrlocks;  // for debugging
         mutable atomic_int m_nwlocks;  // for debugging
@@ -551,6 +672,71 @@ private:
 #endif
             mutex.unlock();
         }
+
+        // Find `key` in whichever of the tables holds it, and set `table`
+        // to that one. If it's in neither, return map.end(), with `table`
+        // set to &map.
+        BinMap_iterator_t lookup(const KEY& key, size_t hash,
+                                 BinMap_t*& table)
+        {
+            table   = &map;
+            auto it = find_with_hash(map, key, hash);
+            if (it == map.end() && !old.empty()) {
+                auto o = find_with_hash(old, key, hash);
+                if (o != old.end()) {
+                    table = &old;
+                    return o;
+                }
+            }
+            return it;
+        }
+        // Called with the bin locked, before adding a key that's in
+        // neither table to `map`. If a resize is under way, move a few more
+        // of its entries; otherwise, if the addition would make a large
+        // `map` rehash, set it aside as `old` and start a new one with
+        // twice its capacity.
+        void prepare_insert()
+        {
+            bool full = float(map.size() + 1)
+                        > map.max_load_factor() * float(map.bucket_count());
+            if (!old.empty()) {
+                // If the new table fills first after all (because of many
+                // erasures from it), finish the resize now.
+                migrate(full ? old.size() : migrate_step);
+            } else if (full && map.size() >= resize_min) {
+                BinMap_t fresh;
+                fresh.reserve(2 * map.size());
+                old.swap(map);
+                map.swap(fresh);
+                ++resizes;
+            }
+        }
+
+        // Move up to `n` entries from `old` to `map`. We remember where we
+        // left off by the key of the next entry to move rather than by an
+        // iterator, which erasures in the meantime could invalidate.
+        void migrate(size_t n)
+        {
+            auto it = old.end();
+            if (next)
+                it = old.find(*next);
+            if (it == old.end())
+                it = old.begin();
+            for (; n && it != old.end(); --n) {
+                map.emplace(it->first, it->second);
+                it = old.erase(it);
+            }
+            if (it != old.end()) {
+                if (next)
+                    *next = it->first;
+                else
+                    next.reset(new KEY(it->first));
+            } else {
+                next.reset();
+                if (old.empty())
+                    BinMap_t().swap(old);  // free its storage
+            }
+        }
     };
 
     HASH m_hash;        // hashing function
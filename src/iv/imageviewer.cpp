@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
 #include <iostream>
 #ifndef _WIN32
@@ -12,6 +14,7 @@
 #include "imageviewer.h"
 #include "ivgl.h"
 
+#include <QActionGroup>
 #include <QApplication>
 #include <QComboBox>
 #include <QDesktopWidget>
@@ -33,6 +36,7 @@
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/thread.h>
 #include <OpenImageIO/timer.h>
 
 #include "ivutils.h"
@@ -119,6 +123,7 @@ ImageViewer::ImageViewer()
     slideTimer       = new QTimer();
     slideDuration_ms = 5000;
     slide_loop       = true;
+    playTimer        = new QTimer();
     glwin            = new IvGL(this, *this);
     glwin->setPalette(m_palette);
     glwin->resize(m_default_width, m_default_height);
@@ -140,6 +145,8 @@ ImageViewer::ImageViewer()
 
 ImageViewer::~ImageViewer()
 {
+    glwin->finish_tile_loads();
+    finish_read_ahead();
     for (auto i : m_images)
         delete i;
 }
@@ -364,6 +371,11 @@ ImageViewer::createActions()
     slideShowAct = new QAction(tr("Start Slide Show"), this);
     connect(slideShowAct, SIGNAL(triggered()), this, SLOT(slideShow()));
 
+    playAct = new QAction(tr("&Play Sequence"), this);
+    playAct->setCheckable(true);
+    playAct->setShortcut(tr("Space"));
+    connect(playAct, SIGNAL(triggered()), this, SLOT(playSequence()));
+
     slideLoopAct = new QAction(tr("Loop slide show"), this);
     slideLoopAct->setCheckable(true);
     slideLoopAct->setChecked(true);
@@ -429,6 +441,29 @@ ImageViewer::createActions()
     slideShowDuration->setAccelerated(true);
     connect(slideShowDuration, SIGNAL(valueChanged(int)), this,
             SLOT(setSlideShowDuration(int)));
+
+    readAheadLabel = new QLabel(tr("Read ahead"));
+    readAhead      = new QSpinBox();
+    readAhead->setRange(0, 100);
+    readAhead->setSuffix(" images");
+
+    readBehindLabel = new QLabel(tr("Read behind"));
+    readBehind      = new QSpinBox();
+    readBehind->setRange(0, 100);
+    readBehind->setSuffix(" images");
+
+    readAheadMemoryLabel = new QLabel(tr("Read ahead max memory"));
+    readAheadMemory      = new QSpinBox();
+    readAheadMemory->setRange(0, 65536);
+    readAheadMemory->setSingleStep(256);
+    readAheadMemory->setSuffix(" MB");
+
+    playbackRateLabel = new QLabel(tr("Playback rate"));
+    playbackRate      = new QSpinBox();
+    playbackRate->setRange(1, 120);
+    playbackRate->setSuffix(" fps");
+    connect(playbackRate, SIGNAL(valueChanged(int)), this,
+            SLOT(setPlaybackRate(int)));
 }
 
 
@@ -501,6 +536,28 @@ ImageViewer::createMenus()
     colormodeMenu->addAction(viewColorLumAct);
     colormodeMenu->addAction(viewColorHeatmapAct);
 
+    // OCIO display transforms, applied by the shader. The action data is
+    // the display and view names (none for "None").
+    displayMenu                = new QMenu(tr("OCIO display"));
+    QActionGroup* displayGroup = new QActionGroup(displayMenu);
+    QAction* noDisplayAct      = displayMenu->addAction(tr("None"));
+    noDisplayAct->setCheckable(true);
+    noDisplayAct->setChecked(true);
+    displayGroup->addAction(noDisplayAct);
+    for (auto&& display : m_colorconfig.getDisplayNames()) {
+        for (auto&& view : m_colorconfig.getViewNames(display)) {
+            QAction* act = displayMenu->addAction(
+                QString::fromStdString(display + " / " + view));
+            act->setData(QStringList({ QString::fromStdString(display),
+                                       QString::fromStdString(view) }));
+            act->setCheckable(true);
+            displayGroup->addAction(act);
+        }
+    }
+    connect(displayGroup, SIGNAL(triggered(QAction*)), this,
+            SLOT(viewDisplayTransform(QAction*)));
+    displayMenu->setEnabled(m_colorconfig.getNumDisplays() > 0);
+
     viewMenu = new QMenu(tr("&View"), this);
     viewMenu->addAction(prevImageAct);
     viewMenu->addAction(nextImageAct);
@@ -517,6 +574,7 @@ ImageViewer::createMenus()
     viewMenu->addAction(viewSubimageNextAct);
     viewMenu->addMenu(channelMenu);
     viewMenu->addMenu(colormodeMenu);
+    viewMenu->addMenu(displayMenu);
     viewMenu->addMenu(expgamMenu);
     menuBar()->addMenu(viewMenu);
     // Full screen mode
@@ -528,6 +586,7 @@ ImageViewer::createMenus()
     toolsMenu->addAction(showInfoWindowAct);
     toolsMenu->addAction(showPixelviewWindowAct);
     toolsMenu->addMenu(slideMenu);
+    toolsMenu->addAction(playAct);
     toolsMenu->addMenu(sortMenu);
 
     // Menus, toolbars, & status
@@ -616,6 +675,10 @@ ImageViewer::readSettings(bool ui_is_set_up)
         maxMemoryIC->setValue(settings.value("maxMemoryIC", 2048).toInt());
     slideShowDuration->setValue(
         settings.value("slideShowDuration", 10).toInt());
+    readAhead->setValue(settings.value("readAhead", 8).toInt());
+    readBehind->setValue(settings.value("readBehind", 2).toInt());
+    readAheadMemory->setValue(settings.value("readAheadMemory", 2048).toInt());
+    playbackRate->setValue(settings.value("playbackRate", 24).toInt());
 
     ImageCache* imagecache = ImageCache::create(true);
     imagecache->attribute("automip", autoMipmap->isChecked());
@@ -636,6 +699,10 @@ ImageViewer::writeSettings()
     settings.setValue("autoMipmap", autoMipmap->isChecked());
     settings.setValue("maxMemoryIC", maxMemoryIC->value());
     settings.setValue("slideShowDuration", slideShowDuration->value());
+    settings.setValue("readAhead", readAhead->value());
+    settings.setValue("readBehind", readBehind->value());
+    settings.setValue("readAheadMemory", readAheadMemory->value());
+    settings.setValue("playbackRate", playbackRate->value());
     QStringList recent;
     for (auto&& s : m_recent_files)
         recent.push_front(QString(s.c_str()));
@@ -760,6 +827,7 @@ ImageViewer::reload()
     if (m_images.empty())
         return;
     IvImage* newimage = m_images[m_current_image];
+    finish_read_ahead(newimage);
     newimage->invalidate();
     //glwin->trigger_redraw ();
     displayCurrentImage();
@@ -949,6 +1017,7 @@ ImageViewer::loadCurrentImage(int subimage, int miplevel)
     }
     IvImage* img = cur();
     if (img) {
+        finish_read_ahead(img);
         // We need the spec available to compare the image format with
         // opengl's capabilities.
         if (!img->init_spec(img->name(), subimage, miplevel)) {
@@ -962,39 +1031,9 @@ ImageViewer::loadCurrentImage(int subimage, int miplevel)
         // CPU. If true, images should be loaded as UINT8.
         bool allow_transforms = false;
         bool srgb_transform   = false;
-
-        // By default, we try to load into OpenGL with the same format,
-        TypeDesc read_format        = TypeDesc::UNKNOWN;
-        const ImageSpec& image_spec = img->spec();
-
-        if (image_spec.format.basetype == TypeDesc::DOUBLE) {
-            // AFAIK, OpenGL doesn't support 64-bit floats as pixel size.
-            read_format = TypeDesc::FLOAT;
-        }
-        if (glwin->is_glsl_capable()) {
-            if (image_spec.format.basetype == TypeDesc::HALF
-                && !glwin->is_half_capable()) {
-                //std::cerr << "Loading HALF-FLOAT as FLOAT\n";
-                read_format = TypeDesc::FLOAT;
-            }
-            if (IsSpecSrgb(image_spec) && !glwin->is_srgb_capable()) {
-                // If the image is in sRGB, but OpenGL can't load sRGB textures then
-                // we'll need to do the transformation on the CPU after loading the
-                // image. We (so far) can only do this with UINT8 images, so make
-                // sure that it gets loaded in this format.
-                //std::cerr << "Loading as UINT8 to do sRGB\n";
-                read_format      = TypeDesc::UINT8;
-                srgb_transform   = true;
-                allow_transforms = true;
-            }
-        } else {
-            //std::cerr << "Loading as UINT8\n";
-            read_format      = TypeDesc::UINT8;
-            allow_transforms = true;
-
-            if (IsSpecSrgb(image_spec) && !glwin->is_srgb_capable())
-                srgb_transform = true;
-        }
+        TypeDesc read_format  = display_read_format(img->spec(),
+                                                    allow_transforms,
+                                                    srgb_transform);
 
         // FIXME: This actually won't work since the ImageCacheFile has already
         // been created when we did the init_spec.
@@ -1031,6 +1070,147 @@ ImageViewer::loadCurrentImage(int subimage, int miplevel)
 
 
 
+TypeDesc
+ImageViewer::display_read_format(const ImageSpec& image_spec,
+                                 bool& allow_transforms,
+                                 bool& srgb_transform) const
+{
+    // By default, we try to load into OpenGL with the same format,
+    TypeDesc read_format = TypeDesc::UNKNOWN;
+
+    if (image_spec.format.basetype == TypeDesc::DOUBLE) {
+        // AFAIK, OpenGL doesn't support 64-bit floats as pixel size.
+        read_format = TypeDesc::FLOAT;
+    }
+    if (glwin->is_glsl_capable()) {
+        if (image_spec.format.basetype == TypeDesc::HALF
+            && !glwin->is_half_capable()) {
+            //std::cerr << "Loading HALF-FLOAT as FLOAT\n";
+            read_format = TypeDesc::FLOAT;
+        }
+        // If the image is in sRGB but OpenGL can't load sRGB textures,
+        // the shader linearizes it, so it can stay in its own format.
+    } else {
+        //std::cerr << "Loading as UINT8\n";
+        read_format      = TypeDesc::UINT8;
+        allow_transforms = true;
+
+        if (IsSpecSrgb(image_spec) && !glwin->is_srgb_capable())
+            srgb_transform = true;
+    }
+    return read_format;
+}
+
+
+
+void
+ImageViewer::read_ahead()
+{
+    // Reap the reads that have finished.
+    for (auto r = m_read_ahead.begin(); r != m_read_ahead.end();) {
+        if (r->second.done.wait_for(std::chrono::seconds(0))
+            == std::future_status::ready) {
+            r->second.done.get();
+            r = m_read_ahead.erase(r);
+        } else {
+            ++r;
+        }
+    }
+
+    // Images read without GLSL need CPU transforms for their secondary
+    // buffer, which is only done for the image being displayed.
+    const int n = (int)m_images.size();
+    if (n < 2 || !glwin->is_glsl_capable())
+        return;
+
+    // The images to keep in memory, nearest first, wrapping around the ends
+    // of the list as playback does.
+    const int ahead  = std::min(readAhead->value(), n - 1);
+    const int behind = std::min(readBehind->value(), n - 1 - ahead);
+    std::vector<int> window;
+    for (int d = 1; d <= std::max(ahead, behind); ++d) {
+        if (d <= ahead)
+            window.push_back((m_current_image + d) % n);
+        if (d <= behind)
+            window.push_back((m_current_image - d + n) % n);
+    }
+    auto distance = [&](int i) {
+        int d = std::abs(i - m_current_image);
+        return std::min(d, n - d);
+    };
+
+    // How much memory is already held by the pixels we've read, or are
+    // reading. Images only backed by the ImageCache don't count.
+    const imagesize_t budget = imagesize_t(readAheadMemory->value()) << 20;
+    imagesize_t total        = 0;
+    std::vector<int> held;
+    for (int i = 0; i < n; ++i) {
+        IvImage* img = m_images[i];
+        auto r       = m_read_ahead.find(img);
+        if (r != m_read_ahead.end())
+            total += r->second.bytes;
+        else if (img->image_valid() && img->localpixels()) {
+            total += img->spec().image_bytes();
+            if (i != m_current_image
+                && std::find(window.begin(), window.end(), i) == window.end())
+                held.push_back(i);
+        }
+    }
+
+    // Over the budget, free the images outside the window, farthest first.
+    std::sort(held.begin(), held.end(),
+              [&](int a, int b) { return distance(a) > distance(b); });
+    for (int i : held) {
+        if (total <= budget)
+            break;
+        total -= m_images[i]->spec().image_bytes();
+        m_images[i]->release_pixels();
+    }
+
+    // Start reading the images in the window that will fit.
+    for (int i : window) {
+        IvImage* img = m_images[i];
+        if (m_read_ahead.count(img) || img->image_valid() || img->has_error())
+            continue;
+        if (!img->init_spec(img->name(), 0, 0))
+            continue;
+        const ImageSpec& spec = img->spec();
+        bool allow_transforms = false, srgb_transform = false;
+        TypeDesc format       = display_read_format(spec, allow_transforms,
+                                                    srgb_transform);
+        if (format.basetype == TypeDesc::UNKNOWN)
+            format = spec.format;
+        imagesize_t bytes = spec.image_pixels() * spec.nchannels
+                            * format.size();
+        if (total + bytes > budget)
+            break;
+        total += bytes;
+        // Force the read, so the pixels are in memory rather than left for
+        // the ImageCache to fetch when the image is displayed.
+        ReadAhead& r(m_read_ahead[img]);
+        r.bytes = bytes;
+        r.done  = default_thread_pool()->push(
+            [=](int /*id*/) { return img->read_iv(0, 0, true, format); });
+    }
+}
+
+
+
+void
+ImageViewer::finish_read_ahead(IvImage* img)
+{
+    for (auto r = m_read_ahead.begin(); r != m_read_ahead.end();) {
+        if (!img || r->first == img) {
+            r->second.done.wait();
+            r = m_read_ahead.erase(r);
+        } else {
+            ++r;
+        }
+    }
+}
+
+
+
 void
 ImageViewer::displayCurrentImage(bool update)
 {
@@ -1038,6 +1218,7 @@ ImageViewer::displayCurrentImage(bool update)
         m_current_image = 0;
     IvImage* img = cur();
     if (img) {
+        finish_read_ahead(img);
         if (!img->image_valid()) {
             bool load_result = false;
 
@@ -1077,6 +1258,9 @@ ImageViewer::displayCurrentImage(bool update)
     //    fitImageToWindowAct->setEnabled(true);
     //    fullScreenAct->setEnabled(true);
     updateActions();
+
+    // Read the neighbors in the background, for flipping through them.
+    read_ahead();
 }
 
 
@@ -1358,6 +1542,49 @@ ImageViewer::slideImages()
 }
 
 
+void
+ImageViewer::playSequence()
+{
+    if (playTimer->isActive()) {
+        playTimer->stop();
+        disconnect(playTimer, 0, 0, 0);
+    } else {
+        connect(playTimer, SIGNAL(timeout()), this, SLOT(playNextFrame()));
+        playTimer->start(1000 / playbackRate->value());
+    }
+    playAct->setChecked(playTimer->isActive());
+}
+
+
+
+void
+ImageViewer::setPlaybackRate(int fps)
+{
+    if (playTimer->isActive())
+        playTimer->setInterval(1000 / fps);
+}
+
+
+
+void
+ImageViewer::playNextFrame()
+{
+    if (m_images.size() < 2) {
+        playSequence();
+        return;
+    }
+    // Hold the current frame until the next one has been read, rather than
+    // stall the event loop waiting for it.
+    int next = (m_current_image + 1) % (int)m_images.size();
+    auto r   = m_read_ahead.find(m_images[next]);
+    if (r != m_read_ahead.end()
+        && r->second.done.wait_for(std::chrono::seconds(0))
+               != std::future_status::ready)
+        return;
+    current_image(next);
+}
+
+
 void
 ImageViewer::slideShow()
 {
@@ -1509,6 +1736,7 @@ ImageViewer::sortByImageDate()
     int numImg = m_images.size();
     if (numImg < 2)
         return;
+    finish_read_ahead();  // the comparison looks at the specs
     std::sort(m_images.begin(), m_images.end(), &compImageDate);
     current_image(0);
     displayCurrentImage();
@@ -1634,6 +1862,22 @@ ImageViewer::viewColorHeatmap()
 }
 
 
+void
+ImageViewer::viewDisplayTransform(QAction* act)
+{
+    QStringList names = act->data().toStringList();
+    if (names.size() == 2) {
+        m_ocio_display = names[0].toStdString();
+        m_ocio_view    = names[1].toStdString();
+    } else {
+        m_ocio_display.clear();
+        m_ocio_view.clear();
+    }
+    // The shader does the transform, so there's no need to reload pixels.
+    displayCurrentImage(false);
+}
+
+
 void
 ImageViewer::viewChannelPrev()
 {
@@ -1765,6 +2009,8 @@ ImageViewer::closeImg()
 {
     if (m_images.empty())
         return;
+    glwin->finish_tile_loads();
+    finish_read_ahead(m_images[m_current_image]);
     delete m_images[m_current_image];
     m_images[m_current_image] = NULL;
     m_images.erase(m_images.begin() + m_current_image);
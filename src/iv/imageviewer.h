@@ -18,6 +18,8 @@
 // included to remove std::min/std::max errors
 #include <OpenImageIO/platform.h>
 
+#include <future>
+#include <map>
 #include <vector>
 
 #include <QAction>
@@ -30,6 +32,7 @@
 // #include <QPrinter>
 #endif
 
+#include <OpenImageIO/color.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imageio.h>
 
@@ -91,6 +94,10 @@ public:
 
     void invalidate();
 
+    /// Free the pixels, so that they will be read again the next time the
+    /// image is displayed.
+    void release_pixels();
+
     /// Can we read the pixels of this image already?
     ///
     bool image_valid() const { return m_image_valid; }
@@ -276,6 +283,7 @@ private slots:
     void viewColorRGB();               ///< View current 3 channels as RGB
     void viewColor1Ch();               ///< View current channel as gray
     void viewColorHeatmap();           ///< View current channel as heatmap.
+    void viewDisplayTransform(QAction* act);  ///< Pick OCIO display/view
     void viewSubimagePrev();           ///< View prev subimage
     void viewSubimageNext();           ///< View next subimage
     void sortByName();                 ///< Sort images by Name.
@@ -289,6 +297,10 @@ private slots:
     void setSlideShowDuration(
         int seconds);            ///< Set the slide show duration in seconds
     void slideImages();          ///< Slide show - move to next image
+    void playSequence();         ///< Start or stop sequence playback
+    void setPlaybackRate(
+        int fps);                ///< Set the playback rate in frames/s
+    void playNextFrame();        ///< Playback - next image, once it's read
     void showInfoWindow();       ///< View extended info on image
     void showPixelviewWindow();  ///< View closeup pixel view
     void editPreferences();      ///< Edit viewer preferences
@@ -304,6 +316,10 @@ private:
     void removeRecentFile(const std::string& name);
     void updateRecentFilesMenu();
     bool loadCurrentImage(int subimage = 0, int miplevel = 0);
+    TypeDesc display_read_format(const ImageSpec& spec, bool& allow_transforms,
+                                 bool& srgb_transform) const;
+    void read_ahead();
+    void finish_read_ahead(IvImage* img = nullptr);
     void displayCurrentImage(bool update = true);
     void updateTitle();
     void updateStatusBar();
@@ -314,6 +330,7 @@ private:
     QTimer* slideTimer;     ///< Timer to use for slide show mode
     long slideDuration_ms;  ///< Slide show mode duration (in ms)
     bool slide_loop;        ///< Do we loop when in slide mode?
+    QTimer* playTimer;      ///< Timer to use for sequence playback
 
     IvGL* glwin;
     IvInfoWindow* infoWindow;
@@ -349,6 +366,7 @@ private:
     QAction *sortByNameAct, *sortByPathAct, *sortReverseAct;
     QAction *sortByImageDateAct, *sortByFileDateAct;
     QAction *slideShowAct, *slideLoopAct, *slideNoLoopAct;
+    QAction* playAct;
     QAction* showInfoWindowAct;
     QAction* editPreferencesAct;
     QAction* showPixelviewWindowAct;
@@ -356,6 +374,7 @@ private:
         *helpMenu;
     QMenu* openRecentMenu;
     QMenu *expgamMenu, *channelMenu, *colormodeMenu, *slideMenu, *sortMenu;
+    QMenu* displayMenu;
     QLabel *statusImgInfo, *statusViewInfo;
     QProgressBar* statusProgress;
     QComboBox* mouseModeComboBox;
@@ -374,6 +393,14 @@ private:
     QSpinBox* maxMemoryIC;
     QLabel* slideShowDurationLabel;
     QSpinBox* slideShowDuration;
+    QLabel* readAheadLabel;
+    QSpinBox* readAhead;
+    QLabel* readBehindLabel;
+    QSpinBox* readBehind;
+    QLabel* readAheadMemoryLabel;
+    QSpinBox* readAheadMemory;
+    QLabel* playbackRateLabel;
+    QSpinBox* playbackRate;
 
     std::vector<IvImage*> m_images;  // List of images
     int m_current_image;             // Index of current image, -1 if none
@@ -387,6 +414,16 @@ private:
     QPalette m_palette;                       // Custom palette
     bool m_darkPalette;                       // Use dark palette?
     bool m_rawcolor = false;                  // Use raw color mode
+    ColorConfig m_colorconfig;                // OCIO config, for displays
+    std::string m_ocio_display, m_ocio_view;  // Display transform, if any
+
+    // Images being read in the background, near the current one, and how
+    // much memory their pixels will take.
+    struct ReadAhead {
+        std::future<bool> done;
+        imagesize_t bytes = 0;
+    };
+    std::map<IvImage*, ReadAhead> m_read_ahead;
 
     // The default width and height of the window:
     static const int m_default_width  = 640;
@@ -5,6 +5,8 @@
 #include "ivgl.h"
 #include "imageviewer.h"
 
+#include <algorithm>
+#include <chrono>
 #include <iostream>
 
 #include <QComboBox>
@@ -13,7 +15,9 @@
 #include <QProgressBar>
 
 #include "ivutils.h"
+#include <OpenImageIO/fmath.h>
 #include <OpenImageIO/strutil.h>
+#include <OpenImageIO/thread.h>
 #include <OpenImageIO/timer.h>
 
 
@@ -59,6 +63,11 @@ IvGL::IvGL(QWidget* parent, ImageViewer& viewer)
     , m_current_image(NULL)
     , m_pixelview_left_corner(true)
     , m_last_texbuf_used(0)
+    , m_display_lut_tex(0)
+    , m_display_lut(false)
+    , m_preview_tex(0)
+    , m_preview_width(0)
+    , m_preview_height(0)
 {
 #if 0
     QGLFormat format;
@@ -76,7 +85,7 @@ IvGL::IvGL(QWidget* parent, ImageViewer& viewer)
 
 
 
-IvGL::~IvGL() {}
+IvGL::~IvGL() { finish_tile_loads(); }
 
 
 
@@ -170,6 +179,22 @@ IvGL::create_textures(void)
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
 
+    // And one for the display LUT.
+    glGenTextures(1, &m_display_lut_tex);
+    glBindTexture(GL_TEXTURE_2D, m_display_lut_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    // And one for the low resolution preview.
+    glGenTextures(1, &m_preview_tex);
+    glBindTexture(GL_TEXTURE_2D, m_preview_tex);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
     glGenBuffers(2, m_pbo_objects);
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo_objects[0]);
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo_objects[1]);
@@ -205,6 +230,33 @@ IvGL::create_shaders(void)
         "uniform int linearinterp;\n"
         "uniform int width;\n"
         "uniform int height;\n"
+        "uniform int srgbdecode;\n"
+        "uniform int displaylut;\n"
+        "uniform sampler2D luttex;\n"
+        "uniform float lutsize;\n"
+        "uniform float lutmin;\n"
+        "uniform float lutmax;\n"
+        "vec3 srgb_to_linear (vec3 C)\n"
+        "{\n"
+        "    vec3 hi = pow ((max (C, 0.0) + 0.055) / 1.055, vec3 (2.4));\n"
+        "    return mix (C / 12.92, hi, step (vec3 (0.04045), C));\n"
+        "}\n"
+        // The LUT is indexed by log2 of the values, from lutmin to lutmax,
+        // with blue choosing between slices laid side by side.
+        "vec3 display_lut (vec3 C)\n"
+        "{\n"
+        "    vec3 x = log2 (max (C, vec3 (1.0e-10)));\n"
+        "    x = clamp ((x - lutmin) / (lutmax - lutmin), 0.0, 1.0);\n"
+        "    x *= lutsize - 1.0;\n"
+        "    float b0 = floor (x.b);\n"
+        "    float b1 = min (b0 + 1.0, lutsize - 1.0);\n"
+        "    float w = lutsize * lutsize;\n"
+        "    float t = (x.g + 0.5) / lutsize;\n"
+        "    vec2 st0 = vec2 ((b0 * lutsize + x.r + 0.5) / w, t);\n"
+        "    vec2 st1 = vec2 ((b1 * lutsize + x.r + 0.5) / w, t);\n"
+        "    return mix (texture2D (luttex, st0).rgb,\n"
+        "                texture2D (luttex, st1).rgb, x.b - b0);\n"
+        "}\n"
         "vec4 rgba_mode (vec4 C)\n"
         "{\n"
         "    if (imgchannels <= 2) {\n"
@@ -279,6 +331,8 @@ IvGL::create_shaders(void)
         "        }\n"
         "    }\n"
         "    vec4 C = texture2D (imgtex, st);\n"
+        "    if (srgbdecode != 0)\n"
+        "        C.rgb = srgb_to_linear (C.rgb);\n"
         "    C = mix (C, vec4(0.05,0.05,0.05,1.0), black);\n"
         "    if (startchannel < 0)\n"
         "        C = vec4(0.0,0.0,0.0,1.0);\n"
@@ -295,6 +349,8 @@ IvGL::create_shaders(void)
         "    if (pixelview != 0)\n"
         "        C.a = 1.0;\n"
         "    C.xyz *= gain;\n"
+        "    if (displaylut != 0 && (colormode <= 1 || colormode == 3))\n"
+        "        C.xyz = display_lut (C.xyz);\n"
         "    float invgamma = 1.0/gamma;\n"
         "    C.xyz = pow (C.xyz, vec3 (invgamma, invgamma, invgamma));\n"
         "    gl_FragColor = C;\n"
@@ -510,6 +566,8 @@ IvGL::paintGL()
 
     const ImageSpec& spec(img->spec());
     float z = m_zoom;
+    if (m_use_shaders)
+        update_display_lut(img);
 
     glPushMatrix();
     glLoadIdentity();
@@ -566,8 +624,15 @@ IvGL::paintGL()
     m_viewer.statusViewInfo->hide();
     m_viewer.statusProgress->show();
 
-    // FIXME: change the code path so we can take full advantage of async DMA
-    // when using PBO.
+    // Read the tiles in the background if they can all stay resident in
+    // our texture buffers. Otherwise they evict each other every redraw,
+    // so just read them as we go.
+    size_t ntiles = size_t((xend - xbegin + m_texture_width - 1)
+                           / m_texture_width)
+                    * size_t((yend - ybegin + m_texture_height - 1)
+                             / m_texture_height);
+    bool async = ntiles <= m_texbufs.size();
+
     for (int ystart = ybegin; ystart < yend; ystart += m_texture_height) {
         for (int xstart = xbegin; xstart < xend; xstart += m_texture_width) {
             int tile_width  = std::min(xend - xstart, m_texture_width);
@@ -581,12 +646,36 @@ IvGL::paintGL()
             // FIXME: This can get too slow. Some ideas: avoid sending the tex
             // images more than necessary, figure an optimum texture size, use
             // multiple texture objects.
-            load_texture(xstart, ystart, tile_width, tile_height);
-            gl_rect(xstart, ystart, xstart + tile_width, ystart + tile_height,
-                    0, smin, tmin, smax, tmax);
+            if (load_texture(xstart, ystart, tile_width, tile_height,
+                             async)) {
+                gl_rect(xstart, ystart, xstart + tile_width,
+                        ystart + tile_height, 0, smin, tmin, smax, tmax);
+            } else if (m_preview_width) {
+                // Until the tile arrives, stretch the same part of the
+                // preview over it.
+                useshader(m_preview_width, m_preview_height);
+                glBindTexture(GL_TEXTURE_2D, m_preview_tex);
+                gl_rect(xstart, ystart, xstart + tile_width,
+                        ystart + tile_height, 0,
+                        float(xstart - spec.x) / spec.width,
+                        float(ystart - spec.y) / spec.height,
+                        float(xstart + tile_width - spec.x) / spec.width,
+                        float(ystart + tile_height - spec.y) / spec.height);
+                useshader(m_texture_width, m_texture_height);
+            }
         }
     }
 
+    // Tiles that have arrived but weren't used are no longer in view.
+    m_tile_loads.erase(
+        std::remove_if(m_tile_loads.begin(), m_tile_loads.end(),
+                       [](const std::unique_ptr<TileLoad>& t) {
+                           return !t->done.valid()
+                                  || t->done.wait_for(std::chrono::seconds(0))
+                                         == std::future_status::ready;
+                       }),
+        m_tile_loads.end());
+
     glPopMatrix();
 
     if (m_viewer.pixelviewOn()) {
@@ -929,6 +1018,29 @@ IvGL::useshader(int tex_width, int tex_height, bool pixelview)
 
     loc = glGetUniformLocation(m_shader_program, "height");
     glUniform1i(loc, tex_height);
+
+    // sRGB images that OpenGL can't linearize for us
+    bool srgb = Strutil::iequals(spec.get_string_attribute("oiio:ColorSpace"),
+                                 "sRGB");
+    loc       = glGetUniformLocation(m_shader_program, "srgbdecode");
+    glUniform1i(loc, srgb && !m_use_srgb);
+
+    loc = glGetUniformLocation(m_shader_program, "displaylut");
+    glUniform1i(loc, m_display_lut);
+    if (m_display_lut) {
+        // The LUT lives in texture unit 1.
+        glActiveTexture(GL_TEXTURE1);
+        glBindTexture(GL_TEXTURE_2D, m_display_lut_tex);
+        glActiveTexture(GL_TEXTURE0);
+        loc = glGetUniformLocation(m_shader_program, "luttex");
+        glUniform1i(loc, 1);
+        loc = glGetUniformLocation(m_shader_program, "lutsize");
+        glUniform1f(loc, float(display_lut_size));
+        loc = glGetUniformLocation(m_shader_program, "lutmin");
+        glUniform1f(loc, display_lut_min);
+        loc = glGetUniformLocation(m_shader_program, "lutmax");
+        glUniform1f(loc, display_lut_max);
+    }
     GLERRPRINT("After setting uniforms");
 }
 
@@ -939,6 +1051,9 @@ IvGL::update()
 {
     //std::cerr << "update image\n";
 
+    finish_tile_loads();
+    m_preview_width = m_preview_height = 0;
+
     IvImage* img = m_viewer.cur();
     if (!img) {
         m_current_image = NULL;
@@ -984,14 +1099,129 @@ IvGL::update()
                  closeuptexsize, 0, glformat, gltype, NULL);
     GLERRPRINT("Setting up pixelview texture");
 
-    // Resize the buffer at once, rather than create one each drawing.
-    m_tex_buffer.resize(m_texture_width * m_texture_height * nchannels
-                        * spec.channel_bytes());
+    load_preview(img, nchannels);
     m_current_image = img;
 }
 
 
 
+void
+IvGL::update_display_lut(IvImage* img)
+{
+    const std::string& display(m_viewer.m_ocio_display);
+    const std::string& view(m_viewer.m_ocio_view);
+    // sRGB images are linearized on their way out of the texture.
+    std::string colorspace = img->spec().get_string_attribute(
+        "oiio:ColorSpace");
+    if (colorspace.empty() || Strutil::iequals(colorspace, "sRGB"))
+        colorspace = "linear";
+    std::string key = display.empty() ? std::string()
+                                      : display + '/' + view + '/'
+                                            + colorspace;
+    if (key == m_display_lut_key)
+        return;
+    m_display_lut_key = key;
+    m_display_lut     = false;
+    if (key.empty() || !m_use_float)
+        return;
+
+    const ColorConfig& config(m_viewer.m_colorconfig);
+    auto processor = config.createDisplayTransform(display, view, colorspace);
+    if (!processor)
+        processor = config.createDisplayTransform(display, view, "linear");
+    if (!processor)
+        return;
+
+    // Slices of increasing blue side by side, each with red increasing to
+    // the right and green increasing downward, all spaced evenly in log2.
+    const int n = display_lut_size;
+    std::vector<float> lut(size_t(n) * n * n * 3);
+    for (int g = 0; g < n; ++g) {
+        for (int b = 0; b < n; ++b) {
+            for (int r = 0; r < n; ++r) {
+                float* p = &lut[((size_t(g) * n + b) * n + r) * 3];
+                p[0]     = exp2f(OIIO::lerp(display_lut_min, display_lut_max,
+                                            float(r) / (n - 1)));
+                p[1]     = exp2f(OIIO::lerp(display_lut_min, display_lut_max,
+                                            float(g) / (n - 1)));
+                p[2]     = exp2f(OIIO::lerp(display_lut_min, display_lut_max,
+                                            float(b) / (n - 1)));
+            }
+        }
+    }
+    processor->apply(lut.data(), n * n, n, 3, sizeof(float),
+                     3 * sizeof(float), n * n * 3 * sizeof(float));
+
+    glBindTexture(GL_TEXTURE_2D, m_display_lut_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0 /*mip level*/, GL_RGB32F_ARB, n * n, n,
+                 0 /*border width*/, GL_RGB, GL_FLOAT, lut.data());
+    GLERRPRINT("Loading display LUT");
+    m_display_lut = true;
+}
+
+
+
+void
+IvGL::load_preview(IvImage* img, int nchannels)
+{
+    // Only worth it for full resolution images that take a while to read.
+    const int maxres      = 1024;
+    const ImageSpec& spec = img->spec();
+    if (!m_use_npot_texture || img->miplevel() != 0
+        || (spec.width <= maxres && spec.height <= maxres))
+        return;
+
+    // Use the largest MIP level that's no bigger than maxres, or failing
+    // that, the thumbnail.
+    ImageBuf mip;
+    std::shared_ptr<ImageBuf> thumbnail;
+    const ImageBuf* preview = nullptr;
+    for (int m = 1, nmip = img->nmiplevels(); m < nmip && !preview; ++m) {
+        mip.reset(img->name(), img->subimage(), m, img->imagecache());
+        if (mip.spec().width <= maxres && mip.spec().height <= maxres)
+            preview = &mip;
+    }
+    if (!preview && img->has_thumbnail()) {
+        thumbnail = img->get_thumbnail();
+        preview   = thumbnail.get();
+    }
+    int chbegin = m_use_shaders ? m_viewer.current_channel() : 0;
+    if (!preview || preview->nchannels() < chbegin + nchannels)
+        return;
+
+    const ImageSpec& pspec = preview->spec();
+    std::vector<unsigned char> pixels(pspec.image_pixels() * nchannels
+                                      * spec.channel_bytes());
+    ROI roi     = pspec.roi();
+    roi.chbegin = chbegin;
+    roi.chend   = chbegin + nchannels;
+    if (!preview->get_pixels(roi, spec.format, pixels.data()))
+        return;
+
+    GLenum gltype, glformat, glinternalformat;
+    typespec_to_opengl(spec, nchannels, gltype, glformat, glinternalformat);
+    glBindTexture(GL_TEXTURE_2D, m_preview_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0 /*mip level*/, glinternalformat,
+                 pspec.width, pspec.height, 0 /*border width*/, glformat,
+                 gltype, pixels.data());
+    GLERRPRINT("Loading preview texture");
+    m_preview_width  = pspec.width;
+    m_preview_height = pspec.height;
+}
+
+
+
+void
+IvGL::finish_tile_loads()
+{
+    for (auto&& load : m_tile_loads)
+        if (load->done.valid())
+            load->done.wait();
+    m_tile_loads.clear();
+}
+
+
+
 void
 IvGL::view(float xcenter, float ycenter, float zoom, bool redraw)
 {
@@ -1439,8 +1669,8 @@ IvGL::typespec_to_opengl(const ImageSpec& spec, int nchannels, GLenum& gltype,
 
 
 
-void
-IvGL::load_texture(int x, int y, int width, int height)
+bool
+IvGL::load_texture(int x, int y, int width, int height, bool async)
 {
     const ImageSpec& spec = m_current_image->spec();
     // Find if this has already been loaded.
@@ -1448,45 +1678,87 @@ IvGL::load_texture(int x, int y, int width, int height)
         if (tb.x == x && tb.y == y && tb.width >= width
             && tb.height >= height) {
             glBindTexture(GL_TEXTURE_2D, tb.tex_object);
-            return;
+            return true;
         }
     }
 
-    setCursor(Qt::WaitCursor);
-
     int nchannels = spec.nchannels;
+    int chbegin   = 0;
     // For simplicity, we don't support more than 4 channels without shaders
     // (yet).
     if (m_use_shaders) {
         nchannels = num_channels(m_viewer.current_channel(), nchannels,
                                  m_viewer.current_color_mode());
+        chbegin   = m_viewer.current_channel();
     }
     GLenum gltype, glformat, glinternalformat;
     typespec_to_opengl(spec, nchannels, gltype, glformat, glinternalformat);
 
+    // Are the pixels already on their way?
+    auto load = std::find_if(m_tile_loads.begin(), m_tile_loads.end(),
+                             [&](const std::unique_ptr<TileLoad>& t) {
+                                 return t->x == x && t->y == y
+                                        && t->width == width
+                                        && t->height == height
+                                        && t->chbegin == chbegin
+                                        && t->chend == chbegin + nchannels;
+                             });
+    if (load == m_tile_loads.end()) {
+        setCursor(Qt::WaitCursor);
+        std::unique_ptr<TileLoad> tile(new TileLoad);
+        tile->x       = x;
+        tile->y       = y;
+        tile->width   = width;
+        tile->height  = height;
+        tile->chbegin = chbegin;
+        tile->chend   = chbegin + nchannels;
+        tile->pixels.resize(size_t(width) * height * nchannels
+                            * spec.channel_bytes());
+        // Copy the imagebuf pixels we need, that's the only way we can do
+        // it safely since ImageBuf has a cache underneath and the whole
+        // image may not be resident at once.
+        IvImage* img    = m_current_image;
+        TileLoad* t     = tile.get();
+        TypeDesc format = spec.format;
+        auto read       = [=]() {
+            img->get_pixels(ROI(t->x, t->x + t->width, t->y, t->y + t->height,
+                                0, 1, t->chbegin, t->chend),
+                            format, t->pixels.data());
+        };
+        if (async) {
+            tile->done = default_thread_pool()->push([=](int /*id*/) {
+                read();
+                // Have the GUI thread draw again now that it's here.
+                QMetaObject::invokeMethod(
+                    this, [this]() { parent_t::update(); },
+                    Qt::QueuedConnection);
+            });
+            m_tile_loads.push_back(std::move(tile));
+            return false;
+        }
+        read();
+        m_tile_loads.push_back(std::move(tile));
+        load = m_tile_loads.end() - 1;
+    } else if ((*load)->done.valid()) {
+        if (async
+            && (*load)->done.wait_for(std::chrono::seconds(0))
+                   != std::future_status::ready)
+            return false;
+        (*load)->done.wait();
+    }
+
     TexBuffer& tb = m_texbufs[m_last_texbuf_used];
     tb.x          = x;
     tb.y          = y;
     tb.width      = width;
     tb.height     = height;
-    // Copy the imagebuf pixels we need, that's the only way we can do
-    // it safely since ImageBuf has a cache underneath and the whole image
-    // may not be resident at once.
-    if (!m_use_shaders) {
-        m_current_image->get_pixels(ROI(x, x + width, y, y + height),
-                                    spec.format, &m_tex_buffer[0]);
-    } else {
-        m_current_image->get_pixels(ROI(x, x + width, y, y + height, 0, 1,
-                                        m_viewer.current_channel(),
-                                        m_viewer.current_channel() + nchannels),
-                                    spec.format, &m_tex_buffer[0]);
-    }
 
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, m_pbo_objects[m_last_pbo_used]);
-    glBufferData(GL_PIXEL_UNPACK_BUFFER, width * height * spec.pixel_bytes(),
-                 &m_tex_buffer[0], GL_STREAM_DRAW);
+    glBufferData(GL_PIXEL_UNPACK_BUFFER, (*load)->pixels.size(),
+                 (*load)->pixels.data(), GL_STREAM_DRAW);
     GLERRPRINT("After buffer data");
     m_last_pbo_used = (m_last_pbo_used + 1) & 1;
+    m_tile_loads.erase(load);
 
     // When using PBO this is the offset within the buffer.
     void* data = 0;
@@ -1498,6 +1770,7 @@ IvGL::load_texture(int x, int y, int width, int height)
     GLERRPRINT("After loading sub image");
     m_last_texbuf_used = (m_last_texbuf_used + 1) % m_texbufs.size();
     glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+    return true;
 }
 
 
@@ -21,6 +21,8 @@
 // included to remove std::min/std::max errors
 #include <OpenImageIO/platform.h>
 
+#include <future>
+#include <memory>
 #include <vector>
 
 #include <QOpenGLFunctions>
@@ -101,6 +103,10 @@ public:
                             GLenum& gltype, GLenum& glformat,
                             GLenum& glinternal) const;
 
+    /// Wait for any texture tiles still being read in the background, and
+    /// forget them. Call this before deleting an image they may read from.
+    void finish_tile_loads();
+
 protected:
     ImageViewer& m_viewer;          ///< Backpointer to viewer
     bool m_shaders_created;         ///< Have the shaders been created?
@@ -126,10 +132,6 @@ protected:
     IvImage* m_current_image;      ///< Image to show on screen.
     GLuint m_pixelview_tex;        ///< Pixelview's own texture.
     bool m_pixelview_left_corner;  ///< Draw pixelview in upper left or right
-    /// Buffer passed to IvImage::copy_image when not using PBO.
-    ///
-    std::vector<unsigned char> m_tex_buffer;
-
     /// Represents a texture object being used as a buffer.
     ///
     struct TexBuffer {
@@ -143,6 +145,31 @@ protected:
     int m_last_texbuf_used;
     bool m_mouse_activation;  ///< Can we expect the window to be activated by mouse?
 
+    /// The pixels of a texture tile, read from the image on a background
+    /// thread so that drawing doesn't wait for the ImageCache (and the
+    /// disk or network behind it).
+    ///
+    struct TileLoad {
+        int x, y, width, height;
+        int chbegin, chend;
+        std::vector<unsigned char> pixels;
+        std::future<void> done;
+    };
+    std::vector<std::unique_ptr<TileLoad>> m_tile_loads;
+
+    /// The OCIO display transform (see ImageViewer::viewDisplayTransform),
+    /// baked into a 3D LUT that the shader applies. It's stored as a 2D
+    /// texture of side-by-side slices, since we can't count on 3D ones.
+    GLuint m_display_lut_tex;
+    bool m_display_lut;             ///< Is there a display LUT to apply?
+    std::string m_display_lut_key;  ///< display/view/colorspace of the LUT
+
+    /// Low resolution stand-in for the whole image (a coarse MIP level or
+    /// the embedded thumbnail), drawn where tiles haven't arrived yet.
+    GLuint m_preview_tex;
+    int m_preview_width;   ///< Preview size, or 0 if there's no preview
+    int m_preview_height;
+
 
     virtual void initializeGL();
     virtual void resizeGL(int w, int h);
@@ -180,6 +207,11 @@ private:
     /// closeuptexsize is the size of the texture used to upload the pixelview
     /// to OpenGL.
     const static int closeuptexsize = 16;
+    /// The display LUT has display_lut_size points along each axis, spaced
+    /// evenly in log2 from display_lut_min to display_lut_max.
+    static constexpr int display_lut_size  = 32;
+    static constexpr float display_lut_min = -15.0f;
+    static constexpr float display_lut_max = 6.0f;
 
     void clamp_view_to_window();
 
@@ -192,8 +224,18 @@ private:
     void print_shader_log(std::ostream& out, const GLuint shader_id);
 
     /// Loads the given patch of the image, but first figures if it's already
-    /// been loaded.
-    void load_texture(int x, int y, int width, int height);
+    /// been loaded. If `async` is true, the pixels are read in the
+    /// background and this returns false (without binding a texture) until
+    /// they're ready, and then a redraw is requested.
+    bool load_texture(int x, int y, int width, int height, bool async);
+
+    /// Bake the display LUT, if the display transform or the color space
+    /// of img have changed.
+    void update_display_lut(IvImage* img);
+
+    /// Load the preview texture for img, if it has a suitable MIP level or
+    /// thumbnail.
+    void load_preview(IvImage* img, int nchannels);
 
     /// Destroys shaders and selects fixed-function pipeline
     void create_shaders_abort(void);
@@ -403,3 +403,12 @@ IvImage::invalidate()
     if (imagecache())
         imagecache()->invalidate(filename);
 }
+
+
+
+void
+IvImage::release_pixels()
+{
+    reset(name());
+    m_image_valid = false;
+}
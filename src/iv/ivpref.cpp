@@ -39,8 +39,25 @@ IvPreferenceWindow::IvPreferenceWindow(ImageViewer& viewer)
     slideShowLayout->addWidget(viewer.slideShowDurationLabel);
     slideShowLayout->addWidget(viewer.slideShowDuration);
 
+    QLayout* readAheadLayout = new QHBoxLayout;
+    readAheadLayout->addWidget(viewer.readAheadLabel);
+    readAheadLayout->addWidget(viewer.readAhead);
+    readAheadLayout->addWidget(viewer.readBehindLabel);
+    readAheadLayout->addWidget(viewer.readBehind);
+
+    QLayout* readAheadMemoryLayout = new QHBoxLayout;
+    readAheadMemoryLayout->addWidget(viewer.readAheadMemoryLabel);
+    readAheadMemoryLayout->addWidget(viewer.readAheadMemory);
+
+    QLayout* playbackLayout = new QHBoxLayout;
+    playbackLayout->addWidget(viewer.playbackRateLabel);
+    playbackLayout->addWidget(viewer.playbackRate);
+
     layout->addLayout(inner_layout);
     layout->addLayout(slideShowLayout);
+    layout->addLayout(readAheadLayout);
+    layout->addLayout(readAheadMemoryLayout);
+    layout->addLayout(playbackLayout);
     layout->addWidget(closeButton);
     setLayout(layout);
 
@@ -71,6 +71,9 @@ public:
                       const ImageSpec& config) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
+    virtual bool get_thumbnail(ImageBuf& thumb, int subimage) override;
     virtual bool close() override;
 
     const std::string& filename() const { return m_filename; }
@@ -90,6 +93,7 @@ private:
     std::string m_filename;
     int m_next_scanline;   // Which scanline is the next to read?
     bool m_raw;            // Read raw coefficients, not scanlines
+    int m_reduce;          // Decode at 1/m_reduce resolution (1, 2, 4, 8)
     bool m_cmyk;           // The input file is cmyk
     bool m_fatalerr;       // JPEG reader hit a fatal error
     bool m_decomp_create;  // Have we created the decompressor?
@@ -99,15 +103,32 @@ private:
     std::vector<unsigned char> m_cmyk_buf;  // For CMYK translation
     std::unique_ptr<ImageSpec> m_config;    // Saved copy of configuration spec
 
+    // State for decoding the restart intervals of a file in parallel. The
+    // header holds everything up to and including the SOS, minus metadata
+    // markers, and each entropy-coded segment is a [begin,end) byte range.
+    int m_rst_state;                        // 0 = unexamined, 1 = ok, -1 = no
+    std::vector<unsigned char> m_rst_file;  // Whole file, if not in memory
+    std::vector<unsigned char> m_rst_header;
+    std::vector<std::pair<const unsigned char*, const unsigned char*>>
+        m_rst_segments;
+    size_t m_rst_sofheight;  // Offset of the frame height in m_rst_header
+    int m_rst_srcrows;       // Full resolution rows per segment
+    bool m_rst_context;      // Need a neighbouring segment for upsampling
+
     void init()
     {
         m_fd            = NULL;
         m_raw           = false;
+        m_reduce        = 1;
         m_cmyk          = false;
         m_fatalerr      = false;
         m_decomp_create = false;
         m_coeffs        = NULL;
+        m_rst_state     = 0;
         m_jerr.jpginput = this;
+        std::vector<unsigned char>().swap(m_rst_file);
+        m_rst_header.clear();
+        m_rst_segments.clear();
         ioproxy_clear();
         m_config.reset();
     }
@@ -121,6 +142,15 @@ private:
 
     bool read_icc_profile(j_decompress_ptr cinfo, ImageSpec& spec);
 
+    // Find the restart markers and check that the segments between them
+    // are whole rows of MCUs that can be decoded independently.
+    bool setup_parallel_decode();
+    // Decode segments [sbegin,send) as a standalone JPEG stream, storing
+    // output scanlines [ybegin,yend) that it covers into data (which holds
+    // the scanlines from ybegin). Thread-safe.
+    bool decode_segments(int sbegin, int send, int ybegin, int yend,
+                         unsigned char* data, std::string& err) const;
+
     bool valid_file(const std::string& filename, Filesystem::IOProxy* io) const;
 
     void close_file() { init(); }
@@ -5,10 +5,14 @@
 #include <algorithm>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
+#include <mutex>
 
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/tiffutils.h>
 
 #include "jpeg_pvt.h"
@@ -47,6 +51,8 @@ jpeg_input_imageio_create()
 OIIO_EXPORT const char* jpeg_input_extensions[]
     = { "jpg", "jpe", "jpeg", "jif", "jfif", "jfi", nullptr };
 
+OIIO_EXPORT const char* jpeg_input_signatures[] = { "ffd8ff", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -168,6 +174,11 @@ JpgInput::open(const std::string& name, ImageSpec& newspec,
 {
     auto p = config.find_attribute("_jpeg:raw", TypeInt);
     m_raw  = p && *(int*)p->data();
+    // libjpeg can scale by 1/2, 1/4, or 1/8 as part of the inverse DCT,
+    // much more cheaply than decoding everything and resizing afterwards.
+    int reduce = config.get_int_attribute("jpeg:reduce", 1);
+    m_reduce   = reduce >= 8 ? 8 : reduce >= 4 ? 4 : reduce >= 2 ? 2 : 1;
+    lazy_metadata(config);
     ioproxy_retrieve_from_config(config);
     m_config.reset(new ImageSpec(config));  // save config spec
     return open(name, newspec);
@@ -254,10 +265,15 @@ JpgInput::open(const std::string& name, ImageSpec& newspec)
         m_cmyk                  = true;
     }
 
-    if (m_raw)
+    if (m_raw) {
         m_coeffs = jpeg_read_coefficients(&m_cinfo);
-    else
+    } else {
+        if (m_reduce > 1) {
+            m_cinfo.scale_num   = 1;
+            m_cinfo.scale_denom = m_reduce;
+        }
         jpeg_start_decompress(&m_cinfo);  // start working
+    }
     if (m_fatalerr)
         return false;
     m_next_scanline = 0;  // next scanline we'll read
@@ -285,13 +301,19 @@ JpgInput::open(const std::string& name, ImageSpec& newspec)
             && !strcmp((const char*)m->data, "Exif")) {
             // The block starts with "Exif\0\0", so skip 6 bytes to get
             // to the start of the actual Exif data TIFF directory
-            decode_exif(string_view((char*)m->data + 6, m->data_length - 6),
-                        m_spec);
+            cspan<uint8_t> exif(m->data + 6, m->data_length - 6);
+            if (lazy_metadata())
+                defer_metadata("exif", exif, m_spec);
+            else
+                decode_exif(exif, m_spec);
         } else if (m->marker == (JPEG_APP0 + 1)
                    && !strcmp((const char*)m->data,
                               "http://ns.adobe.com/xap/1.0/")) {
-            std::string xml((const char*)m->data, m->data_length);
-            decode_xmp(xml, m_spec);
+            cspan<uint8_t> xml(m->data, m->data_length);
+            if (lazy_metadata())
+                defer_metadata("xmp", xml, m_spec);
+            else
+                decode_xmp(xml, m_spec);
         } else if (m->marker == (JPEG_APP0 + 13)
                    && !strcmp((const char*)m->data, "Photoshop 3.0"))
             jpeg_decode_iptc((unsigned char*)m->data);
@@ -334,6 +356,45 @@ JpgInput::open(const std::string& name, ImageSpec& newspec)
 
 
 
+bool
+JpgInput::get_thumbnail(ImageBuf& thumb, int subimage)
+{
+    // JPEG files have no separate reduced-resolution image that we read,
+    // but decoding a 1/8 scale copy in the DCT domain costs only a small
+    // fraction of a full decode, so that's what we hand back. We use a
+    // separate decompressor, leaving this one's position undisturbed.
+    if (subimage != 0 || !ioproxy_opened())
+        return false;
+    ImageSpec config;
+    if (m_config)
+        config = *m_config;
+    config.erase_attribute("_jpeg:raw");
+    config.attribute("jpeg:reduce", 8);
+    // A memory buffer may be shared, but a file proxy's FILE* can't be.
+    Filesystem::IOProxy* io = ioproxy();
+    if (!strcmp(io->proxytype(), "memreader"))
+        config.attribute("oiio:ioproxy", TypeDesc::PTR, &io);
+    else
+        config.erase_attribute("oiio:ioproxy");
+
+    JpgInput in;
+    ImageSpec spec;
+    if (!in.open(m_filename, spec, config)) {
+        errorfmt("{}", in.geterror());
+        return false;
+    }
+    thumb.reset(spec, InitializePixels::No);
+    if (!in.read_image(0, 0, 0, spec.nchannels, TypeUInt8,
+                       thumb.localpixels())) {
+        errorfmt("{}", in.geterror());
+        thumb.reset();
+        return false;
+    }
+    return true;
+}
+
+
+
 bool
 JpgInput::read_icc_profile(j_decompress_ptr cinfo, ImageSpec& spec)
 {
@@ -475,6 +536,261 @@ JpgInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
 
 
 
+bool
+JpgInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int z, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+    yend = std::min(yend, m_spec.y + m_spec.height);
+    if (threads() != 1 && !m_raw && m_rst_state == 0) {
+        m_rst_state = setup_parallel_decode() ? 1 : -1;
+        if (m_rst_state < 0) {
+            std::vector<unsigned char>().swap(m_rst_file);
+            m_rst_segments.clear();
+        }
+    }
+    int segrows = m_rst_state > 0 ? m_rst_srcrows / m_reduce : 0;
+    if (m_rst_state <= 0 || threads() == 1 || yend - ybegin < 2 * segrows)
+        return ImageInput::read_native_scanlines(subimage, miplevel, ybegin,
+                                                 yend, z, data);
+
+    // Give each task a contiguous run of restart intervals, decoded as a
+    // little JPEG file of its own.
+    int sbegin   = ybegin / segrows;
+    int send     = std::min(int(m_rst_segments.size()),
+                            (yend + segrows - 1) / segrows);
+    int nthreads = threads() ? threads() : default_thread_pool()->size() + 1;
+    int64_t chunk = std::max(1, (send - sbegin + nthreads - 1) / nthreads);
+    std::mutex errmutex;
+    std::string err;
+    parallel_for_chunked(
+        sbegin, send, chunk,
+        [&](int64_t b, int64_t e) {
+            std::string e1;
+            if (!decode_segments(int(b), int(e), ybegin, yend,
+                                 (unsigned char*)data, e1)) {
+                std::lock_guard<std::mutex> elock(errmutex);
+                if (err.empty())
+                    err = e1;
+            }
+        },
+        threads());
+    if (!err.empty()) {
+        errorf("JPEG error: %s (\"%s\")", err, filename());
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+JpgInput::setup_parallel_decode()
+{
+    // Only sequential single-scan files with restart intervals that are
+    // whole MCU rows qualify.
+    if (m_cinfo.progressive_mode || !m_cinfo.restart_interval
+        || m_cinfo.comps_in_scan != m_cinfo.num_components
+        || !m_cinfo.MCUs_per_row
+        || m_cinfo.restart_interval % m_cinfo.MCUs_per_row)
+        return false;
+
+    const unsigned char* buf = nullptr;
+    size_t size              = 0;
+    Filesystem::IOProxy* io  = ioproxy();
+    if (!strcmp(io->proxytype(), "memreader")) {
+        auto buffer = reinterpret_cast<Filesystem::IOMemReader*>(io)->buffer();
+        buf         = buffer.data();
+        size        = buffer.size();
+    } else {
+        m_rst_file.resize(io->size());
+        if (io->pread(m_rst_file.data(), m_rst_file.size(), 0)
+            != m_rst_file.size())
+            return false;
+        buf  = m_rst_file.data();
+        size = m_rst_file.size();
+    }
+
+    // Copy the markers up to and including SOS, dropping the metadata the
+    // segment decoders don't need. APP0 (JFIF) and APP14 (Adobe) stay,
+    // since libjpeg uses them to guess the color space.
+    m_rst_header.assign(buf, buf + 2);  // SOI
+    m_rst_sofheight = 0;
+    size_t p        = 2;
+    for (;;) {
+        while (p < size && buf[p] != 0xff)
+            ++p;
+        while (p < size && buf[p] == 0xff)
+            ++p;
+        if (p + 2 >= size)
+            return false;
+        int marker = buf[p];
+        size_t len = (size_t(buf[p + 1]) << 8) + buf[p + 2];
+        if (marker == 0xd9 || len < 2 || p + 1 + len > size)
+            return false;
+        if ((marker >= 0xe0 && marker <= 0xef && marker != 0xe0
+             && marker != 0xee)
+            || marker == 0xfe) {
+            p += 1 + len;
+            continue;
+        }
+        if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4
+            && marker != 0xc8 && marker != 0xcc)
+            m_rst_sofheight = m_rst_header.size() + 5;  // FF Cn Lh Ll P Yh
+        m_rst_header.push_back(0xff);
+        m_rst_header.insert(m_rst_header.end(), buf + p, buf + p + 1 + len);
+        p += 1 + len;
+        if (marker == 0xda)  // SOS
+            break;
+    }
+    if (!m_rst_sofheight)
+        return false;
+
+    // Split the entropy-coded data at the RSTn markers. Any other marker
+    // had better be the EOI, or this isn't a single scan.
+    const unsigned char* s   = buf + p;
+    const unsigned char* end = buf + size;
+    const unsigned char* seg = s;
+    for (;;) {
+        s = (const unsigned char*)memchr(s, 0xff, end - s);
+        if (!s)
+            return false;
+        const unsigned char* m = s + 1;
+        while (m < end && *m == 0xff)
+            ++m;
+        if (m == end)
+            return false;
+        if (*m == 0) {
+            s = m + 1;
+            continue;
+        }
+        m_rst_segments.emplace_back(seg, s);
+        if (*m < 0xd0 || *m > 0xd7) {
+            if (*m != 0xd9)
+                return false;
+            break;
+        }
+        s = seg = m + 1;
+    }
+    size_t nmcu = size_t(m_cinfo.MCUs_per_row) * m_cinfo.MCU_rows_in_scan;
+    if (m_rst_segments.size()
+        != (nmcu + m_cinfo.restart_interval - 1) / m_cinfo.restart_interval)
+        return false;
+
+    int mcu_height = m_cinfo.num_components > 1
+                         ? DCTSIZE * m_cinfo.max_v_samp_factor
+                         : DCTSIZE;
+    m_rst_srcrows = mcu_height * int(m_cinfo.restart_interval)
+                    / int(m_cinfo.MCUs_per_row);
+    // Vertical upsampling of subsampled chroma looks at the neighbouring
+    // rows, so those decodes need an extra segment on either side.
+    m_rst_context = false;
+    for (int c = 0; c < m_cinfo.num_components; ++c)
+        if (m_cinfo.comp_info[c].v_samp_factor < m_cinfo.max_v_samp_factor)
+            m_rst_context = true;
+    return true;
+}
+
+
+
+namespace {
+
+struct segment_error_mgr {
+    struct jpeg_error_mgr pub;
+    jmp_buf setjmp_buffer;
+};
+
+static void
+segment_error_exit(j_common_ptr cinfo)
+{
+    longjmp(((segment_error_mgr*)cinfo->err)->setjmp_buffer, 1);
+}
+
+static void
+segment_output_message(j_common_ptr /*cinfo*/)
+{
+}
+
+}  // namespace
+
+
+
+bool
+JpgInput::decode_segments(int sbegin, int send, int ybegin, int yend,
+                          unsigned char* data, std::string& err) const
+{
+    int nsegs   = int(m_rst_segments.size());
+    int first   = m_rst_context ? std::max(sbegin - 1, 0) : sbegin;
+    int last    = m_rst_context ? std::min(send + 1, nsegs) : send;
+    int srcrows = std::min(int(m_cinfo.image_height), last * m_rst_srcrows)
+                  - first * m_rst_srcrows;
+
+    std::vector<unsigned char> stream(m_rst_header);
+    stream[m_rst_sofheight]     = (unsigned char)(srcrows >> 8);
+    stream[m_rst_sofheight + 1] = (unsigned char)(srcrows & 0xff);
+    for (int i = first; i < last; ++i) {
+        if (i > first) {
+            stream.push_back(0xff);
+            stream.push_back((unsigned char)(0xd0 + (i - first - 1) % 8));
+        }
+        stream.insert(stream.end(), m_rst_segments[i].first,
+                      m_rst_segments[i].second);
+    }
+    stream.push_back(0xff);
+    stream.push_back(0xd9);  // EOI
+
+    size_t scanline_bytes = m_spec.scanline_bytes();
+    std::vector<unsigned char> scratch(m_spec.width * 4);
+    int segrows = m_rst_srcrows / m_reduce;
+    int y0      = first * segrows;  // first row decoded
+    int ykeep   = std::max(ybegin, sbegin * segrows);
+    int y1      = std::min(yend, send * segrows);
+
+    struct jpeg_decompress_struct cinfo;
+    segment_error_mgr jerr;
+    cinfo.err               = jpeg_std_error(&jerr.pub);
+    jerr.pub.error_exit     = segment_error_exit;
+    jerr.pub.output_message = segment_output_message;
+    if (setjmp(jerr.setjmp_buffer)) {
+        char errbuf[JMSG_LENGTH_MAX];
+        (*cinfo.err->format_message)((j_common_ptr)&cinfo, errbuf);
+        err = errbuf;
+        jpeg_destroy_decompress(&cinfo);
+        return false;
+    }
+    jpeg_create_decompress(&cinfo);
+    jpeg_mem_src(&cinfo, stream.data(), stream.size());
+    jpeg_read_header(&cinfo, TRUE);
+    if (m_cmyk)
+        cinfo.out_color_space = JCS_CMYK;
+    if (m_reduce > 1) {
+        cinfo.scale_num   = 1;
+        cinfo.scale_denom = m_reduce;
+    }
+    jpeg_start_decompress(&cinfo);
+    for (int y = y0; y < y1; ++y) {
+        // Rows we keep go straight to the caller's buffer, unless they
+        // need CMYK conversion; context rows are discarded.
+        unsigned char* dst = y >= ykeep
+                                 ? data + (y - ybegin) * scanline_bytes
+                                 : nullptr;
+        JSAMPLE* row = (dst && !m_cmyk) ? dst : scratch.data();
+        if (jpeg_read_scanlines(&cinfo, &row, 1) != 1) {
+            err = "failed scanline read";
+            jpeg_destroy_decompress(&cinfo);
+            return false;
+        }
+        if (dst && m_cmyk)
+            cmyk_to_rgb(m_spec.width, row, 4, dst, 3);
+    }
+    jpeg_destroy_decompress(&cinfo);
+    return true;
+}
+
+
+
 bool
 JpgInput::close()
 {
@@ -518,7 +834,10 @@ JpgInput::jpeg_decode_iptc(const unsigned char* buf)
     int segmentsize = (buf[0] << 8) + buf[1];
     buf += 2;
 
-    decode_iptc_iim(buf, segmentsize, m_spec);
+    if (lazy_metadata())
+        defer_metadata("iptc", cspan<uint8_t>(buf, segmentsize), m_spec);
+    else
+        decode_iptc_iim(buf, segmentsize, m_spec);
 }
 
 OIIO_PLUGIN_NAMESPACE_END
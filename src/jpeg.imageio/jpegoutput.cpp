@@ -2,13 +2,16 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <atomic>
 #include <cassert>
 #include <cstdio>
+#include <cstring>
 #include <vector>
 
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/tiffutils.h>
 
 #include "jpeg_pvt.h"
@@ -67,12 +70,39 @@ private:
     unsigned long m_outsize = 0;
 #endif
 
+    // Destination manager that appends to a std::vector.
+    struct VectorDest {
+        struct jpeg_destination_mgr pub;
+        std::vector<unsigned char>* buf;
+    };
+
+    // With jpeg:restart_rows, scanlines are buffered and each restart
+    // interval is compressed independently (several at a time), then they
+    // are stitched together behind the header m_cinfo wrote into m_head.
+    bool m_parallel;
+    int m_band_rows;   // Scanlines per restart interval, 0 if not stitching
+    int m_group_rows;  // Scanlines compressed per task
+    int m_nsegments;   // Restart intervals compressed so far
+    VectorDest m_headdest;
+    std::vector<unsigned char> m_head;     // SOI, JFIF, metadata markers
+    std::vector<unsigned char> m_tables;   // DQT through SOS
+    size_t m_sofheight;                    // Offset of frame height in m_tables
+    std::vector<unsigned char> m_pending;  // Scanlines not yet compressed
+    std::vector<unsigned char> m_entropy;  // Compressed data so far
+
     void init(void)
     {
         m_copy_coeffs       = NULL;
         m_copy_decompressor = NULL;
+        m_parallel          = false;
+        m_band_rows         = 0;
+        m_nsegments         = 0;
         ioproxy_clear();
         clear_outbuffer();
+        std::vector<unsigned char>().swap(m_head);
+        m_tables.clear();
+        std::vector<unsigned char>().swap(m_pending);
+        std::vector<unsigned char>().swap(m_entropy);
     }
 
     void clear_outbuffer()
@@ -98,6 +128,16 @@ private:
     // Read the XResolution/YResolution and PixelAspectRatio metadata, store
     // in density fields m_cinfo.X_density,Y_density.
     void resmeta_to_density();
+
+    static void set_vector_dest(j_compress_ptr cinfo, VectorDest& dest,
+                                std::vector<unsigned char>& buf);
+    // Compress nrows buffered scanlines as a standalone JPEG with the same
+    // parameters as m_cinfo, into out. Thread-safe.
+    void compress_rows(const unsigned char* rows, int nrows,
+                       std::vector<unsigned char>& out) const;
+    // Compress the buffered scanlines in parallel and append them to
+    // m_entropy. Unless finishing, leave any incomplete task's worth.
+    bool compress_pending(bool finish);
 };
 
 
@@ -150,7 +190,12 @@ JpgOutput::open(const std::string& name, const ImageSpec& newspec,
     m_cinfo.err = jpeg_std_error(&c_jerr);  // set error handler
     jpeg_create_compress(&m_cinfo);         // create compressor
     Filesystem::IOProxy* m_io = ioproxy();
-    if (!strcmp(m_io->proxytype(), "file")) {
+    int restart_rows = m_spec.get_int_attribute("jpeg:restart_rows");
+    m_parallel       = restart_rows > 0 && !m_copy_coeffs
+                 && !m_spec.get_int_attribute("jpeg:progressive");
+    if (m_parallel) {
+        set_vector_dest(&m_cinfo, m_headdest, m_head);
+    } else if (!strcmp(m_io->proxytype(), "file")) {
         auto fd = reinterpret_cast<Filesystem::IOFile*>(m_io)->handle();
         jpeg_stdio_dest(&m_cinfo, fd);  // set output stream
     } else {
@@ -215,6 +260,38 @@ JpgOutput::open(const std::string& name, const ImageSpec& newspec,
             jpeg_simple_progression(&m_cinfo);
         }
 
+        // Emit restart markers every restart_rows MCU rows, as long as
+        // that fits in the 16 bit restart interval.
+        if (restart_rows > 0) {
+            int mcu_w = DCTSIZE, mcu_h = DCTSIZE;
+            if (m_cinfo.num_components > 1) {
+                for (int c = 0; c < m_cinfo.num_components; ++c) {
+                    mcu_w = std::max(mcu_w, DCTSIZE
+                                                * m_cinfo.comp_info[c]
+                                                      .h_samp_factor);
+                    mcu_h = std::max(mcu_h, DCTSIZE
+                                                * m_cinfo.comp_info[c]
+                                                      .v_samp_factor);
+                }
+            }
+            int mcus_per_row = (m_spec.width + mcu_w - 1) / mcu_w;
+            restart_rows     = std::min(restart_rows, 65535 / mcus_per_row);
+            if (restart_rows > 0) {
+                m_cinfo.restart_interval = restart_rows * mcus_per_row;
+                if (m_parallel) {
+                    size_t rowbytes = size_t(m_spec.width)
+                                      * m_cinfo.input_components;
+                    m_band_rows  = restart_rows * mcu_h;
+                    m_group_rows = m_band_rows
+                                   * int(std::max(size_t(1),
+                                                  (size_t(1) << 19)
+                                                      / (m_band_rows
+                                                         * rowbytes)));
+                    m_cinfo.optimize_coding = FALSE;
+                }
+            }
+        }
+
         jpeg_start_compress(&m_cinfo, TRUE);  // start working
         DBG std::cout << "out open: start_compress\n";
     }
@@ -384,7 +461,7 @@ JpgOutput::write_scanline(int y, int z, TypeDesc format, const void* data,
         errorf("Attempt to write too many scanlines to %s", m_filename);
         return false;
     }
-    assert(y == (int)m_cinfo.next_scanline);
+    assert(m_band_rows || y == (int)m_cinfo.next_scanline);
 
     // Here's where we do the dirty work of conforming to JFIF's limitation
     // of 1 or 3 channels, by temporarily doctoring the spec so that
@@ -403,14 +480,173 @@ JpgOutput::write_scanline(int y, int z, TypeDesc format, const void* data,
     data = to_native_scanline(format, data, xstride, m_scratch, m_dither, y, z);
     m_spec.nchannels = save_nchannels;
 
-    jpeg_write_scanlines(&m_cinfo, (JSAMPLE**)&data, 1);
     ++m_next_scanline;
+    if (m_band_rows) {
+        const unsigned char* row = (const unsigned char*)data;
+        m_pending.insert(m_pending.end(), row,
+                         row + m_spec.width * m_cinfo.input_components);
+        int nthreads = threads() ? threads()
+                                 : default_thread_pool()->size() + 1;
+        size_t limit = size_t(2 * nthreads) * m_group_rows * m_spec.width
+                       * m_cinfo.input_components;
+        if (m_pending.size() >= limit)
+            return compress_pending(false);
+        return true;
+    }
+    jpeg_write_scanlines(&m_cinfo, (JSAMPLE**)&data, 1);
 
     return true;
 }
 
 
 
+void
+JpgOutput::set_vector_dest(j_compress_ptr cinfo, VectorDest& dest,
+                           std::vector<unsigned char>& buf)
+{
+    dest.buf                      = &buf;
+    dest.pub.init_destination     = [](j_compress_ptr cinfo) {
+        VectorDest* d = (VectorDest*)cinfo->dest;
+        d->buf->resize(65536);
+        d->pub.next_output_byte = d->buf->data();
+        d->pub.free_in_buffer   = d->buf->size();
+    };
+    dest.pub.empty_output_buffer = [](j_compress_ptr cinfo) -> boolean {
+        // Called only when the whole buffer is full
+        VectorDest* d = (VectorDest*)cinfo->dest;
+        size_t used   = d->buf->size();
+        d->buf->resize(2 * used);
+        d->pub.next_output_byte = d->buf->data() + used;
+        d->pub.free_in_buffer   = d->buf->size() - used;
+        return TRUE;
+    };
+    dest.pub.term_destination = [](j_compress_ptr cinfo) {
+        VectorDest* d = (VectorDest*)cinfo->dest;
+        d->buf->resize(d->buf->size() - d->pub.free_in_buffer);
+    };
+    cinfo->dest = &dest.pub;
+}
+
+
+
+void
+JpgOutput::compress_rows(const unsigned char* rows, int nrows,
+                         std::vector<unsigned char>& out) const
+{
+    struct jpeg_compress_struct cinfo;
+    struct jpeg_error_mgr jerr;
+    VectorDest dest;
+    cinfo.err = jpeg_std_error(&jerr);
+    jpeg_create_compress(&cinfo);
+    set_vector_dest(&cinfo, dest, out);
+    cinfo.image_width      = m_cinfo.image_width;
+    cinfo.image_height     = nrows;
+    cinfo.input_components = m_cinfo.input_components;
+    cinfo.in_color_space   = m_cinfo.in_color_space;
+    jpeg_set_defaults(&cinfo);
+    jpeg_set_colorspace(&cinfo, m_cinfo.jpeg_color_space);
+    for (int c = 0; c < cinfo.num_components; ++c) {
+        cinfo.comp_info[c].h_samp_factor = m_cinfo.comp_info[c].h_samp_factor;
+        cinfo.comp_info[c].v_samp_factor = m_cinfo.comp_info[c].v_samp_factor;
+        cinfo.comp_info[c].quant_tbl_no  = m_cinfo.comp_info[c].quant_tbl_no;
+    }
+    for (int i = 0; i < NUM_QUANT_TBLS; ++i) {
+        if (!m_cinfo.quant_tbl_ptrs[i])
+            continue;
+        if (!cinfo.quant_tbl_ptrs[i])
+            cinfo.quant_tbl_ptrs[i] = jpeg_alloc_quant_table(
+                (j_common_ptr)&cinfo);
+        memcpy(cinfo.quant_tbl_ptrs[i]->quantval,
+               m_cinfo.quant_tbl_ptrs[i]->quantval,
+               sizeof(cinfo.quant_tbl_ptrs[i]->quantval));
+    }
+    cinfo.dct_method         = m_cinfo.dct_method;
+    cinfo.optimize_coding    = FALSE;
+    cinfo.restart_interval   = m_cinfo.restart_interval;
+    cinfo.write_JFIF_header  = FALSE;
+    cinfo.write_Adobe_marker = FALSE;
+    jpeg_start_compress(&cinfo, TRUE);
+    size_t rowbytes = size_t(cinfo.image_width) * cinfo.input_components;
+    for (int y = 0; y < nrows; ++y) {
+        JSAMPROW row = (JSAMPROW)(rows + y * rowbytes);
+        jpeg_write_scanlines(&cinfo, &row, 1);
+    }
+    jpeg_finish_compress(&cinfo);
+    jpeg_destroy_compress(&cinfo);
+}
+
+
+
+bool
+JpgOutput::compress_pending(bool finish)
+{
+    size_t rowbytes = size_t(m_spec.width) * m_cinfo.input_components;
+    int nrows       = int(m_pending.size() / rowbytes);
+    int ngroups     = finish ? (nrows + m_group_rows - 1) / m_group_rows
+                             : nrows / m_group_rows;
+    std::vector<std::vector<unsigned char>> compressed(ngroups);
+    parallel_for_chunked(
+        0, ngroups, 1,
+        [&](int64_t gbegin, int64_t gend) {
+            for (int64_t g = gbegin; g < gend; ++g) {
+                int r0 = int(g) * m_group_rows;
+                compress_rows(m_pending.data() + r0 * rowbytes,
+                              std::min(m_group_rows, nrows - r0),
+                              compressed[g]);
+            }
+        },
+        threads());
+
+    for (int g = 0; g < ngroups; ++g) {
+        // Find the scan data, between the SOS marker segment and the EOI.
+        const std::vector<unsigned char>& c = compressed[g];
+        size_t p = 2, sofheight = 0;  // skip SOI
+        while (p + 4 <= c.size() && c[p] == 0xff) {
+            int marker = c[p + 1];
+            size_t len = (size_t(c[p + 2]) << 8) + c[p + 3];
+            if (marker >= 0xc0 && marker <= 0xcf && marker != 0xc4
+                && marker != 0xc8 && marker != 0xcc)
+                sofheight = p + 5;
+            p += 2 + len;
+            if (marker == 0xda)  // SOS
+                break;
+        }
+        if (!sofheight || p + 2 > c.size() || c[c.size() - 2] != 0xff
+            || c[c.size() - 1] != 0xd9) {
+            errorf("JPEG compression error");
+            return false;
+        }
+        if (m_tables.empty()) {
+            m_tables.assign(c.begin() + 2, c.begin() + p);
+            m_sofheight = sofheight - 2;
+        }
+        // Each task numbered its restart markers from RST0; renumber them
+        // to continue the sequence, and put one between tasks too.
+        if (m_nsegments) {
+            m_entropy.push_back(0xff);
+            m_entropy.push_back(0xd0 + (m_nsegments - 1) % 8);
+        }
+        size_t begin = m_entropy.size();
+        m_entropy.insert(m_entropy.end(), c.begin() + p, c.end() - 2);
+        int nrst = 0;
+        for (size_t i = begin; i + 1 < m_entropy.size(); ++i) {
+            if (m_entropy[i] == 0xff && m_entropy[i + 1] >= 0xd0
+                && m_entropy[i + 1] <= 0xd7) {
+                m_entropy[i + 1] = 0xd0 + (m_nsegments + nrst++) % 8;
+                ++i;
+            }
+        }
+        m_nsegments += nrst + 1;
+    }
+    m_pending.erase(m_pending.begin(),
+                    m_pending.begin()
+                        + std::min(m_pending.size(),
+                                   size_t(ngroups) * m_group_rows * rowbytes));
+    return true;
+}
+
+
+
 bool
 JpgOutput::write_tile(int x, int y, int z, TypeDesc format, const void* data,
                       stride_t xstride, stride_t ystride, stride_t zstride)
@@ -446,11 +682,41 @@ JpgOutput::close()
         std::vector<char> buf(spec().scanline_bytes(), 0);
         char* data = &buf[0];
         while (m_next_scanline < spec().height) {
-            jpeg_write_scanlines(&m_cinfo, (JSAMPLE**)&data, 1);
+            if (m_band_rows)
+                m_pending.resize(m_pending.size()
+                                     + m_spec.width * m_cinfo.input_components,
+                                 0);
+            else
+                jpeg_write_scanlines(&m_cinfo, (JSAMPLE**)&data, 1);
             ++m_next_scanline;
         }
     }
 
+    if (m_band_rows) {
+        // The restart intervals were compressed separately; m_cinfo only
+        // wrote the header and metadata, and we assemble the rest.
+        ok &= compress_pending(true);
+        jpeg_abort_compress(&m_cinfo);
+        jpeg_destroy_compress(&m_cinfo);
+        if (ok) {
+            m_head.resize(m_head.size() - m_headdest.pub.free_in_buffer);
+            m_tables[m_sofheight]     = (unsigned char)(m_spec.height >> 8);
+            m_tables[m_sofheight + 1] = (unsigned char)(m_spec.height & 0xff);
+            static const unsigned char eoi[2] = { 0xff, 0xd9 };
+            ok &= ioproxy()->write(m_head.data(), m_head.size())
+                  == m_head.size();
+            ok &= ioproxy()->write(m_tables.data(), m_tables.size())
+                  == m_tables.size();
+            ok &= ioproxy()->write(m_entropy.data(), m_entropy.size())
+                  == m_entropy.size();
+            ok &= ioproxy()->write(eoi, 2) == 2;
+            if (!ok)
+                errorf("Could not write \"%s\"", m_filename);
+        }
+        init();
+        return ok;
+    }
+
     if (m_next_scanline >= spec().height || m_copy_coeffs) {
         DBG std::cout << "out close: about to finish_compress\n";
         jpeg_finish_compress(&m_cinfo);
@@ -463,7 +729,11 @@ JpgOutput::close()
     DBG std::cout << "out close: about to destroy_compress\n";
     jpeg_destroy_compress(&m_cinfo);
 
-    if (m_outsize) {
+    if (m_parallel) {
+        // Restart intervals were too long to stitch, so m_cinfo compressed
+        // everything, but into m_head.
+        ioproxy()->write(m_head.data(), m_head.size());
+    } else if (m_outsize) {
         // We had an IOProxy of some type that was not IOFile. JPEG doesn't
         // have fully general IO overloads, but it can write to memory
         // buffers, we did that, so now we have to copy that in one big chunk
@@ -3,6 +3,8 @@
 // https://github.com/OpenImageIO/oiio
 
 #include <cstdio>
+#include <cstring>
+#include <limits>
 #include <vector>
 
 #include <openjpeg.h>
@@ -94,16 +96,29 @@ public:
     virtual bool open(const std::string& name, ImageSpec& newspec,
                       const ImageSpec& config) override;
     virtual bool close(void) override;
+    virtual int current_miplevel(void) const override { return m_miplevel; }
+    virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_tile(int subimage, int miplevel, int x, int y,
+                                  int z, void* data) override;
+    virtual bool read_native_tiles(int subimage, int miplevel, int xbegin,
+                                   int xend, int ybegin, int yend, int zbegin,
+                                   int zend, void* data) override;
 
 private:
     std::string m_filename;
     std::vector<int> m_bpp;  // per channel bpp
-    opj_image_t* m_image;
+    opj_image_t* m_image;    // Decoded pixels of level m_image_level
+    int m_image_level;
     opj_codec_t* m_codec;
     opj_stream_t* m_stream;
     bool m_keep_unassociated_alpha;  // Do not convert unassociated alpha
+    int m_miplevel;
+    int m_nlevels;           // Resolution levels we expose as MIP levels
+    int m_tile_width;        // Code stream tile size, 0 if single-tiled
+    int m_tile_height;
+    ImageSpec m_topspec;     // Spec of the full resolution level
 
     void init(void);
 
@@ -112,6 +127,19 @@ private:
     opj_codec_t* create_decompressor();
     void destroy_decompressor();
 
+    // Set up m_codec and m_stream and read the header, asking for the
+    // resolution to be reduced by 2^reduce.
+    bool open_codec(int reduce, opj_image_t*& image);
+    // Decode the region [xbegin,xend) x [ybegin,yend) of MIP level
+    // miplevel (in that level's pixel coordinates). Only the code blocks
+    // covering it are decoded.
+    opj_image_t* decode_area(int miplevel, int xbegin, int xend, int ybegin,
+                             int yend);
+    // Convert rows [ybegin,yend) x [xbegin,xend) of a decoded image to
+    // native pixels, with ystride bytes between rows.
+    void convert_area(const opj_image_t* image, int xbegin, int xend,
+                      int ybegin, int yend, void* data, stride_t ystride);
+
     void destroy_stream()
     {
         if (m_stream) {
@@ -120,7 +148,11 @@ private:
         }
     }
 
-    template<typename T> void read_scanline(int y, int z, void* data);
+    template<typename T>
+    void read_scanline(const opj_image_t* image, int y, int xbegin, int xend,
+                       void* data);
+
+    void associate_alpha(void* data, int npixels);
 
     uint16_t baseTypeConvertU10ToU16(int src)
     {
@@ -132,9 +164,9 @@ private:
         return (uint16_t)((src << 4) | (src >> 8));
     }
 
-    template<typename T> void yuv_to_rgb(T* p_scanline)
+    template<typename T> void yuv_to_rgb(T* p_scanline, int npixels)
     {
-        for (int x = 0, i = 0; x < m_spec.width; ++x, i += m_spec.nchannels) {
+        for (int x = 0, i = 0; x < npixels; ++x, i += m_spec.nchannels) {
             float y = convert_type<T, float>(p_scanline[i + 0]);
             float u = convert_type<T, float>(p_scanline[i + 1]) - 0.5f;
             float v = convert_type<T, float>(p_scanline[i + 2]) - 0.5f;
@@ -195,6 +227,10 @@ jpeg2000_input_imageio_create()
 OIIO_EXPORT const char* jpeg2000_input_extensions[] = { "jp2", "j2k", "j2c",
                                                         nullptr };
 
+OIIO_EXPORT const char* jpeg2000_input_signatures[] = {
+    "0000000c6a5020200d0a870a", "ff4fff51", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -202,27 +238,26 @@ void
 Jpeg2000Input::init(void)
 {
     m_image                   = NULL;
+    m_image_level             = -1;
     m_codec                   = NULL;
     m_stream                  = NULL;
     m_keep_unassociated_alpha = false;
+    m_miplevel                = 0;
+    m_nlevels                 = 1;
+    m_tile_width              = 0;
+    m_tile_height             = 0;
     ioproxy_clear();
 }
 
 
 
 bool
-Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
+Jpeg2000Input::open_codec(int reduce, opj_image_t*& image)
 {
-    m_filename = name;
-
-    if (!ioproxy_use_or_open(name))
-        return false;
     ioseek(0);
-
     m_codec = create_decompressor();
     if (!m_codec) {
         errorfmt("Could not create Jpeg2000 stream decompressor");
-        close();
         return false;
     }
 
@@ -230,6 +265,7 @@ Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
 
     opj_dparameters_t parameters;
     opj_set_default_decoder_parameters(&parameters);
+    parameters.cp_reduce = reduce;
     opj_setup_decoder(m_codec, &parameters);
 
 #if OIIO_OPJ_VERSION >= 20200
@@ -244,7 +280,7 @@ Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
     m_stream = opj_stream_default_create(true /* is_input */);
     if (!m_stream) {
         errorfmt("Could not create Jpeg2000 stream");
-        close();
+        destroy_decompressor();
         return false;
     }
 
@@ -255,17 +291,99 @@ Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
     opj_stream_set_user_data_length(m_stream, ioproxy()->size());
     // opj_stream_set_write_function(m_stream, StreamWrite);
 
-    OIIO_ASSERT(m_image == nullptr);
-    if (!opj_read_header(m_stream, m_codec, &m_image)) {
+    image = nullptr;
+    if (!opj_read_header(m_stream, m_codec, &image)) {
         errorfmt("Could not read Jpeg2000 header");
-        close();
+        destroy_decompressor();
+        destroy_stream();
         return false;
     }
-    opj_decode(m_codec, m_stream, m_image);
+    return true;
+}
+
+
+
+opj_image_t*
+Jpeg2000Input::decode_area(int miplevel, int xbegin, int xend, int ybegin,
+                           int yend)
+{
+    opj_image_t* image = nullptr;
+    if (!open_codec(miplevel, image))
+        return nullptr;
+    // The decode area is given on the full resolution reference grid.
+    auto full = [=](int v, OPJ_UINT32 lo, OPJ_UINT32 hi) {
+        return OPJ_INT32(clamp(int64_t(v) << miplevel, int64_t(lo),
+                               int64_t(hi)));
+    };
+    OPJ_INT32 x0 = full(xbegin, image->x0, image->x1);
+    OPJ_INT32 y0 = full(ybegin, image->y0, image->y1);
+    OPJ_INT32 x1 = full(xend, image->x0, image->x1);
+    OPJ_INT32 y1 = full(yend, image->y0, image->y1);
+    bool ok      = opj_set_decode_area(m_codec, image, x0, y0, x1, y1)
+              && opj_decode(m_codec, m_stream, image)
+              && opj_end_decompress(m_codec, m_stream);
+    destroy_decompressor();
+    destroy_stream();
+    if (!ok) {
+        if (!has_error())
+            errorfmt("Could not decode Jpeg2000 image \"{}\"", m_filename);
+        opj_image_destroy(image);
+        return nullptr;
+    }
+    return image;
+}
+
 
+
+bool
+Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
+{
+    m_filename = name;
+
+    if (!ioproxy_use_or_open(name))
+        return false;
+
+    // Each resolution level of the code stream becomes a MIP level. Only
+    // the header is needed to find out how many there are and how the
+    // image is tiled.
+    opj_image_t* header = nullptr;
+    if (!open_codec(0, header)) {
+        close();
+        return false;
+    }
+#if OIIO_OPJ_VERSION >= 20100
+    if (opj_codestream_info_v2_t* cstr = opj_get_cstr_info(m_codec)) {
+        if (cstr->m_default_tile_info.tccp_info) {
+            m_nlevels = int(cstr->m_default_tile_info.tccp_info[0].numresolutions);
+            for (OPJ_UINT32 c = 1; c < cstr->nbcomps; ++c)
+                m_nlevels = std::min(m_nlevels,
+                                     int(cstr->m_default_tile_info.tccp_info[c]
+                                             .numresolutions));
+            m_nlevels = std::max(m_nlevels, 1);
+        }
+        if (cstr->tw * cstr->th > 1) {
+            m_tile_width  = int(cstr->tdx);
+            m_tile_height = int(cstr->tdy);
+        }
+        opj_destroy_cstr_info(&cstr);
+    }
+#endif
+    opj_image_destroy(header);
     destroy_decompressor();
     destroy_stream();
 
+    // Decoding the smallest level is cheap, and only a decoded image tells
+    // us the final components (after any palette expansion), color space
+    // and ICC profile. Keep it around in case that level is read.
+    OIIO_ASSERT(m_image == nullptr);
+    m_image = decode_area(m_nlevels - 1, 0, std::numeric_limits<int>::max(),
+                          0, std::numeric_limits<int>::max());
+    if (!m_image) {
+        close();
+        return false;
+    }
+    m_image_level = m_nlevels - 1;
+
     // we support only one, three or four components in image
     const int channelCount = m_image->numcomps;
     if (channelCount != 1 && channelCount != 3 && channelCount != 4) {
@@ -276,47 +394,39 @@ Jpeg2000Input::open(const std::string& name, ImageSpec& p_spec)
     }
 
     unsigned int maxPrecision = 0;
-    ROI datawindow;
     m_bpp.clear();
     m_bpp.reserve(channelCount);
-    std::vector<TypeDesc> chantypes(channelCount, TypeDesc::UINT8);
     for (int i = 0; i < channelCount; i++) {
         const opj_image_comp_t& comp(m_image->comps[i]);
         m_bpp.push_back(comp.prec);
         maxPrecision = std::max(comp.prec, maxPrecision);
-        ROI roichan(comp.x0, comp.x0 + comp.w * comp.dx, comp.y0,
-                    comp.y0 + comp.h * comp.dy);
-        datawindow = roi_union(datawindow, roichan);
-        // std::cout << "  chan " << i << "\n";
-        // std::cout << "     dx=" << comp.dx << " dy=" << comp.dy
-        //           << " x0=" << comp.x0 << " y0=" << comp.y0
-        //           << " w=" << comp.w << " h=" << comp.h
-        //           << " prec=" << comp.prec << " bpp=" << comp.bpp << "\n";
-        // std::cout << "     sgnd=" << comp.sgnd << " resno_decoded=" << comp.resno_decoded << " factor=" << comp.factor << "\n";
-        // std::cout << "     roichan=" << roichan << "\n";
     }
-    // std::cout << "overall x0=" << m_image->x0 << " y0=" << m_image->y0
-    //           << " x1=" << m_image->x1 << " y1=" << m_image->y1 << "\n";
-    // std::cout << "color_space=" << m_image->color_space << "\n";
     const TypeDesc format = (maxPrecision <= 8) ? TypeDesc::UINT8
                                                 : TypeDesc::UINT16;
 
-    m_spec   = ImageSpec(datawindow.width(), datawindow.height(), channelCount,
-                       format);
-    m_spec.x = datawindow.xbegin;
-    m_spec.y = datawindow.ybegin;
-    m_spec.full_x      = m_image->x0;
-    m_spec.full_y      = m_image->y0;
-    m_spec.full_width  = m_image->x1;
-    m_spec.full_height = m_image->y1;
-
-    m_spec.attribute("oiio:BitsPerSample", maxPrecision);
-    m_spec.attribute("oiio:ColorSpace", "sRGB");
+    m_topspec = ImageSpec(m_image->x1 - m_image->x0, m_image->y1 - m_image->y0,
+                          channelCount, format);
+    m_topspec.x           = m_image->x0;
+    m_topspec.y           = m_image->y0;
+    m_topspec.full_x      = m_image->x0;
+    m_topspec.full_y      = m_image->y0;
+    m_topspec.full_width  = m_image->x1;
+    m_topspec.full_height = m_image->y1;
+    m_topspec.tile_width  = m_tile_width;
+    m_topspec.tile_height = m_tile_height;
+
+    m_topspec.attribute("oiio:BitsPerSample", maxPrecision);
+    m_topspec.attribute("oiio:ColorSpace", "sRGB");
     if (m_image->icc_profile_len && m_image->icc_profile_buf)
-        m_spec.attribute("ICCProfile",
-                         TypeDesc(TypeDesc::UINT8, m_image->icc_profile_len),
-                         m_image->icc_profile_buf);
+        m_topspec.attribute("ICCProfile",
+                            TypeDesc(TypeDesc::UINT8, m_image->icc_profile_len),
+                            m_image->icc_profile_buf);
 
+    m_miplevel = -1;
+    if (!seek_subimage(0, 0)) {
+        close();
+        return false;
+    }
     p_spec = m_spec;
     return true;
 }
@@ -335,31 +445,132 @@ Jpeg2000Input::open(const std::string& name, ImageSpec& newspec,
 }
 
 
+
 bool
-Jpeg2000Input::read_native_scanline(int subimage, int miplevel, int y, int z,
-                                    void* data)
+Jpeg2000Input::seek_subimage(int subimage, int miplevel)
 {
-    lock_guard lock(*this);
-    if (!seek_subimage(subimage, miplevel))
+    if (subimage != 0 || miplevel < 0 || miplevel >= m_nlevels)
         return false;
+    if (miplevel == m_miplevel)
+        return true;
+
+    // Level m covers the full resolution reference grid divided by 2^m,
+    // rounded up, just as the decoder reduces it.
+    auto reduce = [=](int v) { return (v + (1 << miplevel) - 1) >> miplevel; };
+    int x0 = reduce(m_topspec.x), x1 = reduce(m_topspec.x + m_topspec.width);
+    int y0 = reduce(m_topspec.y), y1 = reduce(m_topspec.y + m_topspec.height);
+    m_spec             = m_topspec;
+    m_spec.x           = x0;
+    m_spec.y           = y0;
+    m_spec.width       = x1 - x0;
+    m_spec.height      = y1 - y0;
+    m_spec.full_x      = x0;
+    m_spec.full_y      = y0;
+    m_spec.full_width  = x1;
+    m_spec.full_height = y1;
+    m_miplevel         = miplevel;
+    return true;
+}
+
 
-    if (m_spec.format == TypeDesc::UINT8)
-        read_scanline<uint8_t>(y, z, data);
-    else
-        read_scanline<uint16_t>(y, z, data);
 
+void
+Jpeg2000Input::associate_alpha(void* data, int npixels)
+{
     // JPEG2000 specifically dictates unassociated (un-"premultiplied") alpha.
     // Convert to associated unless we were requested not to do so.
     if (m_spec.alpha_channel != -1 && !m_keep_unassociated_alpha) {
         float gamma = m_spec.get_float_attribute("oiio:Gamma", 2.2f);
         if (m_spec.format == TypeDesc::UINT16)
-            associateAlpha((unsigned short*)data, m_spec.width,
-                           m_spec.nchannels, m_spec.alpha_channel, gamma);
+            associateAlpha((unsigned short*)data, npixels, m_spec.nchannels,
+                           m_spec.alpha_channel, gamma);
         else
-            associateAlpha((unsigned char*)data, m_spec.width, m_spec.nchannels,
+            associateAlpha((unsigned char*)data, npixels, m_spec.nchannels,
                            m_spec.alpha_channel, gamma);
     }
+}
+
+
+
+void
+Jpeg2000Input::convert_area(const opj_image_t* image, int xbegin, int xend,
+                            int ybegin, int yend, void* data, stride_t ystride)
+{
+    for (int y = ybegin; y < yend; ++y) {
+        void* row = (char*)data + (y - ybegin) * ystride;
+        if (m_spec.format == TypeDesc::UINT8)
+            read_scanline<uint8_t>(image, y, xbegin, xend, row);
+        else
+            read_scanline<uint16_t>(image, y, xbegin, xend, row);
+        associate_alpha(row, xend - xbegin);
+    }
+}
+
+
+
+bool
+Jpeg2000Input::read_native_scanline(int subimage, int miplevel, int y,
+                                    int /*z*/, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+
+    if (m_image_level != miplevel) {
+        // Scanline access decodes the whole level once.
+        if (m_image)
+            opj_image_destroy(m_image);
+        m_image_level = -1;
+        m_image = decode_area(miplevel, m_spec.x, m_spec.x + m_spec.width,
+                              m_spec.y, m_spec.y + m_spec.height);
+        if (!m_image)
+            return false;
+        m_image_level = miplevel;
+    }
+    convert_area(m_image, m_spec.x, m_spec.x + m_spec.width, y, y + 1, data,
+                 m_spec.scanline_bytes());
+    return true;
+}
+
 
+
+bool
+Jpeg2000Input::read_native_tile(int subimage, int miplevel, int x, int y,
+                                int /*z*/, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+    int xend = std::min(x + m_spec.tile_width, m_spec.x + m_spec.width);
+    int yend = std::min(y + m_spec.tile_height, m_spec.y + m_spec.height);
+    if (xend - x < m_spec.tile_width || yend - y < m_spec.tile_height)
+        memset(data, 0, m_spec.tile_bytes());
+    opj_image_t* image = decode_area(miplevel, x, xend, y, yend);
+    if (!image)
+        return false;
+    convert_area(image, x, xend, y, yend, data,
+                 m_spec.tile_width * m_spec.pixel_bytes());
+    opj_image_destroy(image);
+    return true;
+}
+
+
+
+bool
+Jpeg2000Input::read_native_tiles(int subimage, int miplevel, int xbegin,
+                                 int xend, int ybegin, int yend,
+                                 int /*zbegin*/, int /*zend*/, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+    // A run of tiles is one contiguous area, so decode it all at once.
+    opj_image_t* image = decode_area(miplevel, xbegin, xend, ybegin, yend);
+    if (!image)
+        return false;
+    convert_area(image, xbegin, xend, ybegin, yend, data,
+                 (xend - xbegin) * m_spec.pixel_bytes());
+    opj_image_destroy(image);
     return true;
 }
 
@@ -425,32 +636,35 @@ Jpeg2000Input::destroy_decompressor()
 
 template<typename T>
 void
-Jpeg2000Input::read_scanline(int y, int /*z*/, void* data)
+Jpeg2000Input::read_scanline(const opj_image_t* image, int y, int xbegin,
+                             int xend, void* data)
 {
     T* scanline = static_cast<T*>(data);
     int nc      = m_spec.nchannels;
     // It's easier to loop over channels
     int bits = sizeof(T) * 8;
     for (int c = 0; c < nc; ++c) {
-        const opj_image_comp_t& comp(m_image->comps[c]);
-        int chan_ybegin = comp.y0, chan_yend = comp.y0 + comp.h * comp.dy;
-        int chan_xend = comp.w * comp.dx;
-        int yoff      = (y - comp.y0) / comp.dy;
-        for (int x = 0; x < m_spec.width; ++x) {
-            if (yoff < chan_ybegin || yoff >= chan_yend || x > chan_xend) {
+        // The decoded component holds a window of the level, starting at
+        // (comp.x0, comp.y0) in the component's own (subsampled) pixels.
+        const opj_image_comp_t& comp(image->comps[c]);
+        int yoff = y / int(comp.dy) - int(comp.y0);
+        for (int x = xbegin; x < xend; ++x) {
+            int xoff = x / int(comp.dx) - int(comp.x0);
+            T* dst   = scanline + (x - xbegin) * nc + c;
+            if (yoff < 0 || yoff >= int(comp.h) || xoff < 0
+                || xoff >= int(comp.w)) {
                 // Outside the window of this channel
-                scanline[x * nc + c] = T(0);
+                *dst = T(0);
             } else {
-                unsigned int val = comp.data[yoff * comp.w + x / comp.dx];
+                unsigned int val = comp.data[yoff * comp.w + xoff];
                 if (comp.sgnd)
                     val += (1 << (bits / 2 - 1));
-                scanline[x * nc + c] = (T)bit_range_convert(val, comp.prec,
-                                                            bits);
+                *dst = (T)bit_range_convert(val, comp.prec, bits);
             }
         }
     }
-    if (m_image->color_space == OPJ_CLRSPC_SYCC)
-        yuv_to_rgb(scanline);
+    if (image->color_space == OPJ_CLRSPC_SYCC)
+        yuv_to_rgb(scanline, xend - xbegin);
 }
 
 
@@ -4,12 +4,12 @@
 
 #include <algorithm>
 #include <cmath>
+#include <limits>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
-#include <boost/container/flat_map.hpp>
-
 #include <OpenImageIO/Imath.h>
 
 #include <OpenImageIO/color.h>
@@ -18,6 +18,7 @@
 #include <OpenImageIO/imagebufalgo_util.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/unordered_map_concurrent.h>
 
 #include "imageio_pvt.h"
 
@@ -56,6 +57,23 @@ static OCIO::ConstConfigRcPtr ocio_current_config;
 
 
 
+// Return `colorconfig`, or if it's null, the shared default ColorConfig,
+// creating it on first use. Only that needs the lock; creating processors
+// from a ColorConfig is thread-safe, and for the ones already in its cache
+// it's just a lookup.
+static ColorConfig*
+resolve_colorconfig(ColorConfig* colorconfig)
+{
+    if (colorconfig)
+        return colorconfig;
+    spin_lock lock(colorconfig_mutex);
+    if (!default_colorconfig)
+        default_colorconfig.reset(new ColorConfig);
+    return default_colorconfig.get();
+}
+
+
+
 // Class used as the key to index color processors in the cache.
 class ColorProcCacheKey {
 public:
@@ -68,6 +86,8 @@ public:
         , context_key(key)
         , context_value(val)
         , looks(looks)
+        , display(display)
+        , view(view)
         , file(file)
         , inverse(inverse)
     {
@@ -81,47 +101,27 @@ public:
         // because they're never used for the same lookup.
     }
 
-    friend bool operator<(const ColorProcCacheKey& a,
-                          const ColorProcCacheKey& b)
+    // Keys only ever need to be compared for equality, and since all the
+    // strings are ustrings, that's just comparing pointers.
+    friend bool operator==(const ColorProcCacheKey& a,
+                           const ColorProcCacheKey& b)
     {
-        if (a.hash < b.hash)
-            return true;
-        if (b.hash < a.hash)
-            return false;
-        // They hash the same, so now compare for real. Note that we just to
-        // impose an order, any order -- does not need to be alphabetical --
-        // so we just compare the pointers.
-        if (a.inputColorSpace.c_str() < b.inputColorSpace.c_str())
-            return true;
-        if (b.inputColorSpace.c_str() < a.inputColorSpace.c_str())
-            return false;
-        if (a.outputColorSpace.c_str() < b.outputColorSpace.c_str())
-            return true;
-        if (b.outputColorSpace.c_str() < a.outputColorSpace.c_str())
-            return false;
-        if (a.context_key.c_str() < b.context_key.c_str())
-            return true;
-        if (b.context_key.c_str() < a.context_key.c_str())
-            return false;
-        if (a.looks.c_str() < b.looks.c_str())
-            return true;
-        if (b.looks.c_str() < a.looks.c_str())
-            return false;
-        if (a.display.c_str() < b.display.c_str())
-            return true;
-        if (b.display.c_str() < a.display.c_str())
-            return false;
-        if (a.view.c_str() < b.view.c_str())
-            return true;
-        if (b.view.c_str() < a.view.c_str())
-            return false;
-        if (a.file.c_str() < b.view.c_str())
-            return true;
-        if (b.view.c_str() < a.view.c_str())
-            return false;
-        return int(a.inverse) < int(b.inverse);
+        return a.hash == b.hash && a.inputColorSpace == b.inputColorSpace
+               && a.outputColorSpace == b.outputColorSpace
+               && a.context_key == b.context_key
+               && a.context_value == b.context_value && a.looks == b.looks
+               && a.display == b.display && a.view == b.view
+               && a.file == b.file && a.inverse == b.inverse;
     }
 
+    // The hash is computed once, when the key is made.
+    struct Hasher {
+        size_t operator()(const ColorProcCacheKey& key) const
+        {
+            return key.hash;
+        }
+    };
+
     ustring inputColorSpace;
     ustring outputColorSpace;
     ustring context_key;
@@ -136,7 +136,17 @@ public:
 
 
 
-typedef boost::container::flat_map<ColorProcCacheKey, ColorProcessorHandle>
+// The processors are in a concurrent hash map, so that threads looking up
+// different transforms (or the same ones) only ever share a read lock on
+// one of its bins, and never contend with each other for long. Since
+// lookups of an already created processor are so common, the bins use a
+// distributed_rw_mutex, whose readers don't share a cache line.
+typedef unordered_map_concurrent<
+    ColorProcCacheKey, ColorProcessorHandle, ColorProcCacheKey::Hasher,
+    std::equal_to<ColorProcCacheKey>, 16,
+    std::unordered_map<ColorProcCacheKey, ColorProcessorHandle,
+                       ColorProcCacheKey::Hasher>,
+    distributed_rw_mutex<>>
     ColorProcessorMap;
 
 
@@ -176,7 +186,11 @@ public:
 private:
     mutable spin_rw_mutex m_mutex;
     mutable std::string m_error;
-    ColorProcessorMap colorprocmap;  // cache of ColorProcessors
+    // Cache of ColorProcessors. The map's bins are cache line aligned, so
+    // it needs aligned_new.
+    std::shared_ptr<ColorProcessorMap> colorprocmap {
+        aligned_new<ColorProcessorMap>(), aligned_delete<ColorProcessorMap>
+    };
     atomic_int colorprocs_requested;
     atomic_int colorprocs_created;
     std::string m_configname;
@@ -206,10 +220,9 @@ public:
     ColorProcessorHandle findproc(const ColorProcCacheKey& key)
     {
         ++colorprocs_requested;
-        spin_rw_read_lock lock(m_mutex);
-        auto found = colorprocmap.find(key);
-        return (found == colorprocmap.end()) ? ColorProcessorHandle()
-                                             : found->second;
+        ColorProcessorHandle handle;
+        colorprocmap->retrieve(key, handle);
+        return handle;
     }
 
     // Add the given color processor. Be careful -- if a matching one is
@@ -221,16 +234,10 @@ public:
         if (!handle)
             return handle;
         ++colorprocs_created;
-        spin_rw_write_lock lock(m_mutex);
-        auto found = colorprocmap.find(key);
-        if (found == colorprocmap.end()) {
-            // No equivalent item in the map. Add this one.
-            colorprocmap[key] = handle;
-        } else {
-            // There's already an equivalent one. Oops. Discard this one and
-            // return the one already in the map.
-            handle = found->second;
-        }
+        // If there's already an equivalent one, insert_retrieve discards
+        // this one and replaces `handle` with the one already in the map.
+        ColorProcessorHandle unused;
+        colorprocmap->insert_retrieve(key, handle, unused);
         return handle;
     }
 
@@ -665,6 +672,64 @@ ColorConfig::configname() const
 
 
 
+// Base for the ColorProcessors made by ColorConfig that may be baked into
+// per-channel lookup tables for 8 and 16 bit integer inputs. The tables are
+// built on first use and live as long as the processor, which is itself
+// held in the ColorConfig's cache of processors. They are only meaningful
+// if the processor has no channel crosstalk, in which case each output
+// channel depends only on the same input channel, and there are few
+// enough possible input values that the table is exact.
+class ColorProcessor_Bakeable : public ColorProcessor {
+public:
+    ~ColorProcessor_Bakeable()
+    {
+        pvt::colorprocessor_mem
+            -= (long long)((m_lut8.size() + m_lut16.size()) * sizeof(float));
+    }
+
+    // Return the table for UINT8 or UINT16 inputs: for each of 4 channels
+    // in turn, the result for every possible input value.
+    const float* lut(TypeDesc type) const
+    {
+        const bool is8 = (type == TypeDesc::UINT8);
+        std::vector<float>& table(is8 ? m_lut8 : m_lut16);
+        std::call_once(is8 ? m_once8 : m_once16, [&]() {
+            const int n = is8 ? 256 : 65536;
+            std::vector<float> ramp(size_t(n) * 4);
+            for (int i = 0; i < n; ++i) {
+                float v = is8 ? convert_type<unsigned char, float>(i)
+                              : convert_type<unsigned short, float>(i);
+                for (int c = 0; c < 4; ++c)
+                    ramp[4 * i + c] = v;
+            }
+            apply_for_tables(ramp.data(), n);
+            table.resize(size_t(n) * 4);
+            for (int c = 0; c < 4; ++c)
+                for (int i = 0; i < n; ++i)
+                    table[size_t(c) * n + i] = ramp[4 * i + c];
+            pvt::colorprocessor_mem += (long long)(table.size()
+                                                   * sizeof(float));
+        });
+        return table.data();
+    }
+
+protected:
+    // Run the processor on the `n` RGBA pixels the tables are made from.
+    // Processors whose apply() approximates override this to bake the
+    // exact results.
+    virtual void apply_for_tables(float* ramp, int n) const
+    {
+        apply(ramp, n, 1, 4, sizeof(float), 4 * sizeof(float),
+              stride_t(n) * 4 * sizeof(float));
+    }
+
+private:
+    mutable std::once_flag m_once8, m_once16;
+    mutable std::vector<float> m_lut8, m_lut16;
+};
+
+
+
 #ifdef USE_OCIO
 
 #    if OCIO_VERSION_HEX >= 0x02000000
@@ -689,7 +754,7 @@ ocio_bitdepth(TypeDesc type)
 
 
 // Custom ColorProcessor that wraps an OpenColorIO Processor.
-class ColorProcessor_OCIO final : public ColorProcessor {
+class ColorProcessor_OCIO final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_OCIO(OCIO::ConstProcessorRcPtr p)
         : m_p(p)
@@ -731,137 +796,165 @@ private:
 
 
 
+// Apply the transfer function `f`, which takes a float or any width of
+// vfloat, to the color channels (at most the first three) of each pixel.
+// Rows of packed color-only pixels are a flat run of floats, done 8 at a
+// time; packed RGBA pixels are done one vfloat4 per pixel, with the alpha
+// left as it was; anything else one value at a time.
+template<typename F>
+static void
+apply_transfer(float* data, int width, int height, int channels,
+               stride_t chanstride, stride_t xstride, stride_t ystride, F f)
+{
+    const int nc = std::min(channels, 3);
+    for (int y = 0; y < height; ++y) {
+        char* d = (char*)data + y * ystride;
+        if (chanstride == sizeof(float) && channels <= 3
+            && xstride == stride_t(channels * sizeof(float))) {
+            float* p = (float*)d;
+            int n    = width * channels;
+            for (; n >= 8; n -= 8, p += 8)
+                f(simd::vfloat8(p)).store(p);
+            for (; n > 0; n -= 4, p += 4) {
+                simd::vfloat4 v;
+                v.load(p, std::min(n, 4));
+                f(v).store(p, std::min(n, 4));
+            }
+        } else if (chanstride == sizeof(float) && channels == 4
+                   && xstride == stride_t(4 * sizeof(float))) {
+            const simd::vbool4 rgb(true, true, true, false);
+            for (int x = 0; x < width; ++x, d += xstride) {
+                simd::vfloat4 v((float*)d);
+                simd::select(rgb, f(v), v).store((float*)d);
+            }
+        } else {
+            for (int x = 0; x < width; ++x, d += xstride) {
+                for (int c = 0; c < nc; ++c) {
+                    float* p = (float*)(d + c * chanstride);
+                    *p       = f(*p);
+                }
+            }
+        }
+    }
+}
+
+
+
+// Bake the exact (scalar) transfer function into the tables' ramp.
+template<typename F>
+static void
+bake_transfer(float* ramp, int n, F f)
+{
+    for (int i = 0; i < n; ++i)
+        for (int c = 0; c < 3; ++c)
+            ramp[4 * i + c] = f(ramp[4 * i + c]);
+}
+
+
+
 // ColorProcessor that hard-codes sRGB-to-linear
-class ColorProcessor_sRGB_to_linear final : public ColorProcessor {
+class ColorProcessor_sRGB_to_linear final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_sRGB_to_linear()
-        : ColorProcessor() {};
+        : ColorProcessor_Bakeable() {};
     ~ColorProcessor_sRGB_to_linear() {};
 
     virtual void apply(float* data, int width, int height, int channels,
                        stride_t chanstride, stride_t xstride,
                        stride_t ystride) const
     {
-        if (channels > 3)
-            channels = 3;
-        if (channels == 3 && chanstride == sizeof(float)) {
-            for (int y = 0; y < height; ++y) {
-                char* d = (char*)data + y * ystride;
-                for (int x = 0; x < width; ++x, d += xstride) {
-                    simd::vfloat4 r;
-                    r.load((float*)d, 3);
-                    r = sRGB_to_linear(r);
-                    r.store((float*)d, 3);
-                }
-            }
-        } else {
-            for (int y = 0; y < height; ++y) {
-                char* d = (char*)data + y * ystride;
-                for (int x = 0; x < width; ++x, d += xstride) {
-                    char* dc = d;
-                    for (int c = 0; c < channels; ++c, dc += chanstride)
-                        ((float*)dc)[c] = sRGB_to_linear(((float*)dc)[c]);
-                }
-            }
-        }
+        apply_transfer(data, width, height, channels, chanstride, xstride,
+                       ystride,
+                       [](const auto& x) { return sRGB_to_linear(x); });
+    }
+
+protected:
+    void apply_for_tables(float* ramp, int n) const override
+    {
+        bake_transfer(ramp, n, [](float x) { return sRGB_to_linear(x); });
     }
 };
 
 
 // ColorProcessor that hard-codes linear-to-sRGB
-class ColorProcessor_linear_to_sRGB final : public ColorProcessor {
+class ColorProcessor_linear_to_sRGB final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_linear_to_sRGB()
-        : ColorProcessor() {};
+        : ColorProcessor_Bakeable() {};
     ~ColorProcessor_linear_to_sRGB() {};
 
     virtual void apply(float* data, int width, int height, int channels,
                        stride_t chanstride, stride_t xstride,
                        stride_t ystride) const
     {
-        if (channels > 3)
-            channels = 3;
-        if (channels == 3 && chanstride == sizeof(float)) {
-            for (int y = 0; y < height; ++y) {
-                char* d = (char*)data + y * ystride;
-                for (int x = 0; x < width; ++x, d += xstride) {
-                    simd::vfloat4 r;
-                    r.load((float*)d, 3);
-                    r = linear_to_sRGB(r);
-                    r.store((float*)d, 3);
-                }
-            }
-        } else {
-            for (int y = 0; y < height; ++y) {
-                char* d = (char*)data + y * ystride;
-                for (int x = 0; x < width; ++x, d += xstride) {
-                    char* dc = d;
-                    for (int c = 0; c < channels; ++c, dc += chanstride)
-                        ((float*)dc)[c] = linear_to_sRGB(((float*)dc)[c]);
-                }
-            }
-        }
+        apply_transfer(data, width, height, channels, chanstride, xstride,
+                       ystride,
+                       [](const auto& x) { return linear_to_sRGB(x); });
+    }
+
+protected:
+    void apply_for_tables(float* ramp, int n) const override
+    {
+        bake_transfer(ramp, n, [](float x) { return linear_to_sRGB(x); });
     }
 };
 
 
 
 // ColorProcessor that hard-codes Rec709-to-linear
-class ColorProcessor_Rec709_to_linear final : public ColorProcessor {
+class ColorProcessor_Rec709_to_linear final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_Rec709_to_linear()
-        : ColorProcessor() {};
+        : ColorProcessor_Bakeable() {};
     ~ColorProcessor_Rec709_to_linear() {};
 
     virtual void apply(float* data, int width, int height, int channels,
                        stride_t chanstride, stride_t xstride,
                        stride_t ystride) const
     {
-        if (channels > 3)
-            channels = 3;
-        for (int y = 0; y < height; ++y) {
-            char* d = (char*)data + y * ystride;
-            for (int x = 0; x < width; ++x, d += xstride) {
-                char* dc = d;
-                for (int c = 0; c < channels; ++c, dc += chanstride)
-                    ((float*)d)[c] = Rec709_to_linear(((float*)d)[c]);
-            }
-        }
+        apply_transfer(data, width, height, channels, chanstride, xstride,
+                       ystride,
+                       [](const auto& x) { return Rec709_to_linear(x); });
+    }
+
+protected:
+    void apply_for_tables(float* ramp, int n) const override
+    {
+        bake_transfer(ramp, n, [](float x) { return Rec709_to_linear(x); });
     }
 };
 
 
 // ColorProcessor that hard-codes linear-to-Rec709
-class ColorProcessor_linear_to_Rec709 final : public ColorProcessor {
+class ColorProcessor_linear_to_Rec709 final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_linear_to_Rec709()
-        : ColorProcessor() {};
+        : ColorProcessor_Bakeable() {};
     ~ColorProcessor_linear_to_Rec709() {};
 
     virtual void apply(float* data, int width, int height, int channels,
                        stride_t chanstride, stride_t xstride,
                        stride_t ystride) const
     {
-        if (channels > 3)
-            channels = 3;
-        for (int y = 0; y < height; ++y) {
-            char* d = (char*)data + y * ystride;
-            for (int x = 0; x < width; ++x, d += xstride) {
-                char* dc = d;
-                for (int c = 0; c < channels; ++c, dc += chanstride)
-                    ((float*)d)[c] = linear_to_Rec709(((float*)d)[c]);
-            }
-        }
+        apply_transfer(data, width, height, channels, chanstride, xstride,
+                       ystride,
+                       [](const auto& x) { return linear_to_Rec709(x); });
+    }
+
+protected:
+    void apply_for_tables(float* ramp, int n) const override
+    {
+        bake_transfer(ramp, n, [](float x) { return linear_to_Rec709(x); });
     }
 };
 
 
 
 // ColorProcessor that performs gamma correction
-class ColorProcessor_gamma final : public ColorProcessor {
+class ColorProcessor_gamma final : public ColorProcessor_Bakeable {
 public:
     ColorProcessor_gamma(float gamma)
-        : ColorProcessor()
+        : ColorProcessor_Bakeable()
         , m_gamma(gamma) {};
     ~ColorProcessor_gamma() {};
 
@@ -916,6 +1009,95 @@ public:
 
 
 
+// Transform `n` packed pixels of `nc` (3 or 4) float channels by the matrix
+// `M` (as `color * M`, with alpha 0 for 3 channels), with the transfer
+// function `decode` applied to the color channels before the matrix and
+// `encode` after it, each taking a vfloat8. Eight pixels at a time are
+// transposed into one vector per channel, so that the matrix is 16
+// multiply-adds and each transfer function one call per channel for all
+// eight, then transposed back.
+template<typename D, typename E>
+static void
+matrix_transfer_soa(float* data, imagesize_t n, int nc,
+                    const simd::matrix44& M, D decode, E encode)
+{
+    using namespace simd;
+    OIIO_DASSERT(nc == 3 || nc == 4);
+    vfloat8 m[16];
+    for (int i = 0; i < 4; ++i)
+        for (int j = 0; j < 4; ++j)
+            m[4 * i + j] = vfloat8(M[i][j]);
+    auto block = [&](float* p) {
+        vfloat4 q[8];
+        for (int i = 0; i < 8; ++i) {
+            if (nc == 4)
+                q[i].load(p + 4 * i);
+            else
+                q[i].load(p + 3 * i, 3);
+        }
+        transpose(q[0], q[1], q[2], q[3]);
+        transpose(q[4], q[5], q[6], q[7]);
+        vfloat8 r = decode(vfloat8(q[0], q[4]));
+        vfloat8 g = decode(vfloat8(q[1], q[5]));
+        vfloat8 b = decode(vfloat8(q[2], q[6]));
+        vfloat8 a(q[3], q[7]);
+        vfloat8 R = encode(r * m[0] + g * m[4] + b * m[8] + a * m[12]);
+        vfloat8 G = encode(r * m[1] + g * m[5] + b * m[9] + a * m[13]);
+        vfloat8 B = encode(r * m[2] + g * m[6] + b * m[10] + a * m[14]);
+        vfloat8 A = r * m[3] + g * m[7] + b * m[11] + a * m[15];
+        q[0] = R.lo();
+        q[1] = G.lo();
+        q[2] = B.lo();
+        q[3] = A.lo();
+        q[4] = R.hi();
+        q[5] = G.hi();
+        q[6] = B.hi();
+        q[7] = A.hi();
+        transpose(q[0], q[1], q[2], q[3]);
+        transpose(q[4], q[5], q[6], q[7]);
+        for (int i = 0; i < 8; ++i) {
+            if (nc == 4)
+                q[i].store(p + 4 * i);
+            else
+                q[i].store(p + 3 * i, 3);
+        }
+    };
+    for (; n >= 8; n -= 8, data += 8 * nc)
+        block(data);
+    if (n) {
+        // The last few pixels go through a padded copy.
+        float tail[32] = {};
+        memcpy(tail, data, n * nc * sizeof(float));
+        block(tail);
+        memcpy(data, tail, n * nc * sizeof(float));
+    }
+}
+
+
+
+// Run `soa(p, n)` on each row of an apply() image whose pixels are packed
+// 3 or 4 floats (on the whole image at once if the rows are contiguous),
+// and return true, or return false if they aren't.
+template<typename F>
+static bool
+apply_packed_rows(float* data, int width, int height, int channels,
+                  stride_t chanstride, stride_t xstride, stride_t ystride,
+                  F soa)
+{
+    if ((channels != 3 && channels != 4) || chanstride != sizeof(float)
+        || xstride != stride_t(channels * sizeof(float)))
+        return false;
+    if (ystride == width * xstride) {
+        soa(data, imagesize_t(width) * height);
+    } else {
+        for (int y = 0; y < height; ++y)
+            soa((float*)((char*)data + y * ystride), imagesize_t(width));
+    }
+    return true;
+}
+
+
+
 // ColorProcessor that implements a matrix multiply color transformation.
 class ColorProcessor_Matrix final : public ColorProcessor {
 public:
@@ -928,11 +1110,20 @@ public:
     }
     ~ColorProcessor_Matrix() {}
 
+    virtual bool hasChannelCrosstalk() const { return true; }
     virtual void apply(float* data, int width, int height, int channels,
                        stride_t chanstride, stride_t xstride,
                        stride_t ystride) const
     {
         using namespace simd;
+        auto ident = [](const vfloat8& x) { return x; };
+        if (apply_packed_rows(data, width, height, channels, chanstride,
+                              xstride, ystride,
+                              [&](float* p, imagesize_t n) {
+                                  matrix_transfer_soa(p, n, channels, m_M,
+                                                      ident, ident);
+                              }))
+            return;
         if (channels == 3 && chanstride == sizeof(float)) {
             for (int y = 0; y < height; ++y) {
                 char* d = (char*)data + y * ystride;
@@ -963,6 +1154,7 @@ public:
                     for (int c = 0; c < channels; ++c, dc += chanstride)
                         color[c] = *(float*)dc;
                     vfloat4 xcolor = color * m_M;
+                    dc             = d;
                     for (int c = 0; c < channels; ++c, dc += chanstride)
                         *(float*)dc = xcolor[c];
                 }
@@ -976,6 +1168,129 @@ private:
 
 
 
+// One of the built-in transfer functions, named like the color spaces
+// createColorProcessor() knows without OCIO: "linear" (or "lnf", "lnh",
+// or "", for none), "sRGB", "Rec709", or "GammaX.Y", either to linear
+// (decoding) or from linear (encoding). Called with a float it's the
+// exact function, with a vfloat8 the fast_pow_pos approximation.
+struct BuiltinTransfer {
+    enum Kind {
+        Linear,
+        sRGBToLinear,
+        LinearTosRGB,
+        Rec709ToLinear,
+        LinearToRec709,
+        Gamma
+    };
+    Kind kind   = Linear;
+    float gamma = 1.0f;
+
+    // Set from the name, and return false if it's none of these.
+    bool init(string_view name, bool tolinear)
+    {
+        using namespace Strutil;
+        if (name.empty() || iequals(name, "linear") || iequals(name, "lnf")
+            || iequals(name, "lnh")) {
+            kind = Linear;
+        } else if (iequals(name, "sRGB")) {
+            kind = tolinear ? sRGBToLinear : LinearTosRGB;
+        } else if (iequals(name, "Rec709")) {
+            kind = tolinear ? Rec709ToLinear : LinearToRec709;
+        } else if (istarts_with(name, "Gamma")) {
+            string_view gamstr = name;
+            Strutil::parse_word(gamstr);
+            float g = 0.0f;
+            if (!Strutil::parse_float(gamstr, g) || !(g > 0.0f))
+                return false;
+            kind  = Gamma;
+            gamma = tolinear ? g : 1.0f / g;
+        } else {
+            return false;
+        }
+        return true;
+    }
+
+    float operator()(float x) const
+    {
+        switch (kind) {
+        case sRGBToLinear: return sRGB_to_linear(x);
+        case LinearTosRGB: return linear_to_sRGB(x);
+        case Rec709ToLinear: return Rec709_to_linear(x);
+        case LinearToRec709: return linear_to_Rec709(x);
+        case Gamma: return powf(x, gamma);
+        default: return x;
+        }
+    }
+
+    simd::vfloat8 operator()(const simd::vfloat8& x) const
+    {
+        switch (kind) {
+        case sRGBToLinear: return sRGB_to_linear(x);
+        case LinearTosRGB: return linear_to_sRGB(x);
+        case Rec709ToLinear: return Rec709_to_linear(x);
+        case LinearToRec709: return linear_to_Rec709(x);
+        case Gamma: return fast_pow_pos(x, simd::vfloat8(gamma));
+        default: return x;
+        }
+    }
+};
+
+
+
+// ColorProcessor that decodes the color channels with one transfer
+// function, multiplies by a matrix, and encodes with another transfer
+// function, all in one pass over the pixels. It's the same as the three
+// processors one after another.
+class ColorProcessor_MatrixTransfer final : public ColorProcessor {
+public:
+    ColorProcessor_MatrixTransfer(const Imath::M44f& Matrix,
+                                  const BuiltinTransfer& decode,
+                                  const BuiltinTransfer& encode)
+        : ColorProcessor()
+        , m_M(Matrix)
+        , m_decode(decode)
+        , m_encode(encode)
+    {
+    }
+    ~ColorProcessor_MatrixTransfer() {}
+
+    virtual bool hasChannelCrosstalk() const { return true; }
+    virtual void apply(float* data, int width, int height, int channels,
+                       stride_t chanstride, stride_t xstride,
+                       stride_t ystride) const
+    {
+        if (apply_packed_rows(data, width, height, channels, chanstride,
+                              xstride, ystride,
+                              [&](float* p, imagesize_t n) {
+                                  matrix_transfer_soa(p, n, channels, m_M,
+                                                      m_decode, m_encode);
+                              }))
+            return;
+        const int nc = std::min(channels, 4);
+        for (int y = 0; y < height; ++y) {
+            char* d = (char*)data + y * ystride;
+            for (int x = 0; x < width; ++x, d += xstride) {
+                simd::vfloat4 color(0.0f);
+                for (int c = 0; c < nc; ++c)
+                    color[c] = *(float*)(d + c * chanstride);
+                for (int c = 0; c < 3; ++c)
+                    color[c] = m_decode(color[c]);
+                color = color * m_M;
+                for (int c = 0; c < 3; ++c)
+                    color[c] = m_encode(color[c]);
+                for (int c = 0; c < nc; ++c)
+                    *(float*)(d + c * chanstride) = color[c];
+            }
+        }
+    }
+
+private:
+    simd::matrix44 m_M;
+    BuiltinTransfer m_decode, m_encode;
+};
+
+
+
 ColorProcessorHandle
 ColorConfig::createColorProcessor(string_view inputColorSpace,
                                   string_view outputColorSpace,
@@ -1447,22 +1762,16 @@ ImageBufAlgo::colorconvert(ImageBuf& dst, const ImageBuf& src, string_view from,
         return false;
     }
     ColorProcessorHandle processor;
-    {
-        spin_lock lock(colorconfig_mutex);
-        if (!colorconfig)
-            colorconfig = default_colorconfig.get();
-        if (!colorconfig)
-            default_colorconfig.reset(colorconfig = new ColorConfig);
-        processor = colorconfig->createColorProcessor(from, to, context_key,
-                                                      context_value);
-        if (!processor) {
-            if (colorconfig->error())
-                dst.errorfmt("{}", colorconfig->geterror());
-            else
-                dst.errorfmt("Could not construct the color transform {} -> {}",
-                             from, to);
-            return false;
-        }
+    colorconfig = resolve_colorconfig(colorconfig);
+    processor   = colorconfig->createColorProcessor(from, to, context_key,
+                                                    context_value);
+    if (!processor) {
+        if (colorconfig->error())
+            dst.errorfmt("{}", colorconfig->geterror());
+        else
+            dst.errorfmt("Could not construct the color transform {} -> {}",
+                         from, to);
+        return false;
     }
 
     logtime.stop();  // transition to other colorconvert
@@ -1497,13 +1806,7 @@ ImageBufAlgo::colormatrixtransform(ImageBuf& dst, const ImageBuf& src,
 {
     pvt::LoggedTimer logtime("IBA::colormatrixtransform");
     ColorProcessorHandle processor;
-    {
-        spin_lock lock(colorconfig_mutex);
-        auto colorconfig = default_colorconfig.get();
-        if (!colorconfig)
-            default_colorconfig.reset(colorconfig = new ColorConfig);
-        processor = colorconfig->createMatrixTransform(M);
-    }
+    processor = resolve_colorconfig(nullptr)->createMatrixTransform(M);
 
     logtime.stop();  // transition to other colorconvert
     bool ok = colorconvert(dst, src, processor.get(), unpremult, roi, nthreads);
@@ -1525,6 +1828,60 @@ ImageBufAlgo::colormatrixtransform(const ImageBuf& src, const Imath::M44f& M,
 
 
 
+bool
+ImageBufAlgo::colormatrixtransfer(ImageBuf& dst, const ImageBuf& src,
+                                  const Imath::M44f& M,
+                                  string_view fromtransfer,
+                                  string_view totransfer, bool unpremult,
+                                  ROI roi, int nthreads)
+{
+    pvt::LoggedTimer logtime("IBA::colormatrixtransfer");
+    BuiltinTransfer decode, encode;
+    if (!decode.init(fromtransfer, true)) {
+        dst.errorfmt("colormatrixtransfer: unknown transfer function \"{}\"",
+                     fromtransfer);
+        return false;
+    }
+    if (!encode.init(totransfer, false)) {
+        dst.errorfmt("colormatrixtransfer: unknown transfer function \"{}\"",
+                     totransfer);
+        return false;
+    }
+    ColorProcessor_MatrixTransfer processor(M, decode, encode);
+    logtime.stop();  // transition to other colorconvert
+    return colorconvert(dst, src, &processor, unpremult, roi, nthreads);
+}
+
+
+
+ImageBuf
+ImageBufAlgo::colormatrixtransfer(const ImageBuf& src, const Imath::M44f& M,
+                                  string_view fromtransfer,
+                                  string_view totransfer, bool unpremult,
+                                  ROI roi, int nthreads)
+{
+    ImageBuf result;
+    bool ok = colormatrixtransfer(result, src, M, fromtransfer, totransfer,
+                                  unpremult, roi, nthreads);
+    if (!ok && !result.has_error())
+        result.errorfmt("ImageBufAlgo::colormatrixtransfer() error");
+    return result;
+}
+
+
+
+// Number of rows of `roi` to convert with each call to
+// ColorProcessor::apply(). Handing the processor a strip of pixels at a
+// time, rather than single scanlines, amortizes its per-call setup (which
+// is considerable for OCIO) while staying small enough to remain in cache.
+static int
+colorconvert_strip_rows(const ROI& roi)
+{
+    return clamp(16384 / std::max(roi.width(), 1), 1, roi.height());
+}
+
+
+
 template<class Rtype, class Atype>
 static bool
 colorconvert_impl(ImageBuf& R, const ImageBuf& A,
@@ -1544,18 +1901,20 @@ colorconvert_impl(ImageBuf& R, const ImageBuf& A,
         roi, parallel_options(nthreads),
         [&, unpremult, channelsToCopy, processor](ROI roi) {
             int width = roi.width();
-            // Temporary space to hold one RGBA scanline
-            vfloat4* scanline;
-            OIIO_ALLOCATE_STACK_OR_HEAP(scanline, vfloat4, width);
-            float* alpha;
-            OIIO_ALLOCATE_STACK_OR_HEAP(alpha, float, width);
+            int rows  = colorconvert_strip_rows(roi);
+            // Temporary space to hold a strip of RGBA scanlines
+            std::unique_ptr<vfloat4[]> strip(new vfloat4[size_t(width) * rows]);
+            std::unique_ptr<float[]> alpha(new float[size_t(width) * rows]);
+            vfloat4* scanline  = strip.get();
             const float fltmin = std::numeric_limits<float>::min();
             ImageBuf::ConstIterator<Atype> a(A, roi);
             ImageBuf::Iterator<Rtype> r(R, roi);
             for (int k = roi.zbegin; k < roi.zend; ++k) {
-                for (int j = roi.ybegin; j < roi.yend; ++j) {
-                    // Load the scanline
-                    a.rerange(roi.xbegin, roi.xend, j, j + 1, k, k + 1);
+                for (int j = roi.ybegin; j < roi.yend; j += rows) {
+                    int jend = std::min(j + rows, roi.yend);
+                    int n    = width * (jend - j);
+                    // Load the strip
+                    a.rerange(roi.xbegin, roi.xend, j, jend, k, k + 1);
                     for (int i = 0; !a.done(); ++a, ++i) {
                         vfloat4 v(0.0f);
                         for (int c = 0; c < channelsToCopy; ++c)
@@ -1568,7 +1927,7 @@ colorconvert_impl(ImageBuf& R, const ImageBuf& A,
                     // Optionally unpremult. Be careful of alpha==0 pixels,
                     // preserve their color rather than div-by-zero.
                     if (unpremult) {
-                        for (int i = 0; i < width; ++i) {
+                        for (int i = 0; i < n; ++i) {
                             float a  = extract<3>(scanline[i]);
                             alpha[i] = a;
                             a        = a >= fltmin ? a : 1.0f;
@@ -1577,31 +1936,31 @@ colorconvert_impl(ImageBuf& R, const ImageBuf& A,
                     }
 
                     // Apply the color transformation in place
-                    processor->apply((float*)&scanline[0], width, 1, 4,
+                    processor->apply((float*)&scanline[0], width, jend - j, 4,
                                      sizeof(float), 4 * sizeof(float),
                                      width * 4 * sizeof(float));
 
                     // Optionally re-premult. Be careful of alpha==0 pixels,
                     // preserve their value rather than crushing to black.
                     if (unpremult) {
-                        for (int i = 0; i < width; ++i) {
+                        for (int i = 0; i < n; ++i) {
                             float a  = alpha[i];
                             a        = a >= fltmin ? a : 1.0f;
                             scanline[i] *= vfloat4(a,a,a,1.0f);
                         }
                     }
 
-                    // Store the scanline
+                    // Store the strip
                     float* dstPtr = (float*)&scanline[0];
-                    r.rerange(roi.xbegin, roi.xend, j, j + 1, k, k + 1);
+                    r.rerange(roi.xbegin, roi.xend, j, jend, k, k + 1);
                     for (; !r.done(); ++r, dstPtr += 4)
                         for (int c = 0; c < channelsToCopy; ++c)
                             r[c] = dstPtr[c];
                     if (channelsToCopy < roi.chend && (&R != &A)) {
                         // If there are "leftover" channels, just copy them
                         // unaltered from the source.
-                        a.rerange(roi.xbegin, roi.xend, j, j + 1, k, k + 1);
-                        r.rerange(roi.xbegin, roi.xend, j, j + 1, k, k + 1);
+                        a.rerange(roi.xbegin, roi.xend, j, jend, k, k + 1);
+                        r.rerange(roi.xbegin, roi.xend, j, jend, k, k + 1);
                         for (; !r.done(); ++r, ++a)
                             for (int c = channelsToCopy; c < roi.chend; ++c)
                                 r[c] = 0.5 + 10 * a[c];
@@ -1629,20 +1988,24 @@ colorconvert_impl_float_rgba(ImageBuf& R, const ImageBuf& A,
                 && R.nchannels() == 4 && A.nchannels() == 4);
     parallel_image(roi, parallel_options(nthreads), [&](ROI roi) {
         int width = roi.width();
-        // Temporary space to hold one RGBA scanline
-        vfloat4* scanline;
-        OIIO_ALLOCATE_STACK_OR_HEAP(scanline, vfloat4, width);
-        float* alpha;
-        OIIO_ALLOCATE_STACK_OR_HEAP(alpha, float, width);
+        int rows  = colorconvert_strip_rows(roi);
+        // Temporary space to hold a strip of RGBA scanlines
+        std::unique_ptr<vfloat4[]> strip(new vfloat4[size_t(width) * rows]);
+        std::unique_ptr<float[]> alpha(new float[size_t(width) * rows]);
+        vfloat4* scanline  = strip.get();
         const float fltmin = std::numeric_limits<float>::min();
         for (int k = roi.zbegin; k < roi.zend; ++k) {
-            for (int j = roi.ybegin; j < roi.yend; ++j) {
-                // Load the scanline
-                memcpy((void*)scanline, A.pixeladdr(roi.xbegin, j, k),
-                       width * 4 * sizeof(float));
+            for (int j = roi.ybegin; j < roi.yend; j += rows) {
+                int jend = std::min(j + rows, roi.yend);
+                int n    = width * (jend - j);
+                // Load the strip
+                for (int y = j; y < jend; ++y)
+                    memcpy((void*)(scanline + (y - j) * width),
+                           A.pixeladdr(roi.xbegin, y, k),
+                           width * 4 * sizeof(float));
                 // Optionally unpremult
                 if (unpremult) {
-                    for (int i = 0; i < width; ++i) {
+                    for (int i = 0; i < n; ++i) {
                         vfloat4 p(scanline[i]);
                         float a  = extract<3>(p);
                         alpha[i] = a;
@@ -1655,13 +2018,13 @@ colorconvert_impl_float_rgba(ImageBuf& R, const ImageBuf& A,
                 }
 
                 // Apply the color transformation in place
-                processor->apply((float*)&scanline[0], width, 1, 4,
+                processor->apply((float*)&scanline[0], width, jend - j, 4,
                                  sizeof(float), 4 * sizeof(float),
                                  width * 4 * sizeof(float));
 
                 // Optionally premult
                 if (unpremult) {
-                    for (int i = 0; i < width; ++i) {
+                    for (int i = 0; i < n; ++i) {
                         vfloat4 p(scanline[i]);
                         float a = alpha[i];
                         a       = a >= fltmin ? a : 1.0f;
@@ -1669,8 +2032,10 @@ colorconvert_impl_float_rgba(ImageBuf& R, const ImageBuf& A,
                         scanline[i] = p;
                     }
                 }
-                memcpy(R.pixeladdr(roi.xbegin, j, k), scanline,
-                       width * 4 * sizeof(float));
+                for (int y = j; y < jend; ++y)
+                    memcpy(R.pixeladdr(roi.xbegin, y, k),
+                           scanline + (y - j) * width,
+                           width * 4 * sizeof(float));
             }
         }
     });
@@ -1679,6 +2044,40 @@ colorconvert_impl_float_rgba(ImageBuf& R, const ImageBuf& A,
 
 
 
+// Integer inputs through a processor baked into per-channel tables: just
+// a lookup per channel. The results are those of the processor (exact
+// ones, for the built-in transfer functions).
+template<class Rtype, class Atype>
+static void
+colorconvert_lut_rows(ImageBuf& R, const ImageBuf& A, const float* lut,
+                      ROI roi)
+{
+    const size_t n = size_t(std::numeric_limits<Atype>::max()) + 1;
+    ImageBuf::ConstIterator<Atype, Atype> a(A, roi);
+    ImageBuf::Iterator<Rtype> r(R, roi);
+    for (; !r.done(); ++r, ++a)
+        for (int c = roi.chbegin; c < roi.chend; ++c)
+            r[c] = lut[c * n + Atype(a[c])];
+}
+
+
+
+template<class Rtype>
+static bool
+colorconvert_impl_lut(ImageBuf& R, const ImageBuf& A, const float* lut,
+                      ROI roi, int nthreads)
+{
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        if (A.spec().format == TypeUInt8)
+            colorconvert_lut_rows<Rtype, unsigned char>(R, A, lut, roi);
+        else
+            colorconvert_lut_rows<Rtype, unsigned short>(R, A, lut, roi);
+    });
+    return true;
+}
+
+
+
 bool
 ImageBufAlgo::colorconvert(ImageBuf& dst, const ImageBuf& src,
                            const ColorProcessor* processor, bool unpremult,
@@ -1714,13 +2113,32 @@ ImageBufAlgo::colorconvert(ImageBuf& dst, const ImageBuf& src,
         unpremult = false;
     }
 
-    if (dst.localpixels() && src.localpixels() && dst.spec().format == TypeFloat
+    if (dst.localpixels() && pvt::packed_localpixels(dst)
+        && pvt::packed_localpixels(src) && dst.spec().format == TypeFloat
         && src.spec().format == TypeFloat && dst.nchannels() == 4
         && src.nchannels() == 4) {
         return colorconvert_impl_float_rgba(dst, src, processor, unpremult, roi,
                                             nthreads);
     }
 
+    // 8 and 16 bit inputs through a processor without crosstalk can use
+    // the processor baked into tables, if the image is big enough to be
+    // worth baking them. This is exact, so only unpremultiplying, which
+    // makes the inputs to the processor non-integer, rules it out.
+    auto bakeable = dynamic_cast<const ColorProcessor_Bakeable*>(processor);
+    TypeDesc srcformat = src.spec().format;
+    if (bakeable && !processor->hasChannelCrosstalk()
+        && (srcformat == TypeUInt8 || srcformat == TypeUInt16)
+        && roi.chbegin == 0 && roi.chend <= 4
+        && !(unpremult && roi.chend == 4)
+        && roi.npixels() >= (srcformat == TypeUInt8 ? 256 : 65536)) {
+        const float* lut = bakeable->lut(srcformat);
+        bool ok          = true;
+        OIIO_DISPATCH_TYPES(ok, "colorconvert", colorconvert_impl_lut,
+                            dst.spec().format, dst, src, lut, roi, nthreads);
+        return ok;
+    }
+
     bool ok = true;
     OIIO_DISPATCH_COMMON_TYPES2(ok, "colorconvert", colorconvert_impl,
                                 dst.spec().format, src.spec().format, dst, src,
@@ -1761,21 +2179,15 @@ ImageBufAlgo::ociolook(ImageBuf& dst, const ImageBuf& src, string_view looks,
         return false;
     }
     ColorProcessorHandle processor;
-    {
-        spin_lock lock(colorconfig_mutex);
-        if (!colorconfig)
-            colorconfig = default_colorconfig.get();
-        if (!colorconfig)
-            default_colorconfig.reset(colorconfig = new ColorConfig);
-        processor = colorconfig->createLookTransform(looks, from, to, inverse,
-                                                     key, value);
-        if (!processor) {
-            if (colorconfig->error())
-                dst.errorfmt("{}", colorconfig->geterror());
-            else
-                dst.errorfmt("Could not construct the color transform");
-            return false;
-        }
+    colorconfig = resolve_colorconfig(colorconfig);
+    processor   = colorconfig->createLookTransform(looks, from, to, inverse,
+                                                   key, value);
+    if (!processor) {
+        if (colorconfig->error())
+            dst.errorfmt("{}", colorconfig->geterror());
+        else
+            dst.errorfmt("Could not construct the color transform");
+        return false;
     }
 
     logtime.stop();  // transition to colorconvert
@@ -1812,30 +2224,24 @@ ImageBufAlgo::ociodisplay(ImageBuf& dst, const ImageBuf& src,
 {
     pvt::LoggedTimer logtime("IBA::ociodisplay");
     ColorProcessorHandle processor;
-    {
-        spin_lock lock(colorconfig_mutex);
-        if (!colorconfig)
-            colorconfig = default_colorconfig.get();
-        if (!colorconfig)
-            default_colorconfig.reset(colorconfig = new ColorConfig);
-        if (from.empty() || from == "current") {
-            auto linearspace = colorconfig->getColorSpaceNameByRole("linear");
-            from = src.spec().get_string_attribute("oiio:Colorspace",
-                                                   linearspace);
-        }
-        if (from.empty()) {
-            dst.errorfmt("Unknown color space name");
-            return false;
-        }
-        processor = colorconfig->createDisplayTransform(display, view, from,
-                                                        looks, key, value);
-        if (!processor) {
-            if (colorconfig->error())
-                dst.errorfmt("{}", colorconfig->geterror());
-            else
-                dst.errorfmt("Could not construct the color transform");
-            return false;
-        }
+    colorconfig = resolve_colorconfig(colorconfig);
+    if (from.empty() || from == "current") {
+        auto linearspace = colorconfig->getColorSpaceNameByRole("linear");
+        from = src.spec().get_string_attribute("oiio:Colorspace",
+                                               linearspace);
+    }
+    if (from.empty()) {
+        dst.errorfmt("Unknown color space name");
+        return false;
+    }
+    processor = colorconfig->createDisplayTransform(display, view, from,
+                                                    looks, key, value);
+    if (!processor) {
+        if (colorconfig->error())
+            dst.errorfmt("{}", colorconfig->geterror());
+        else
+            dst.errorfmt("Could not construct the color transform");
+        return false;
     }
 
     logtime.stop();  // transition to colorconvert
@@ -1872,20 +2278,14 @@ ImageBufAlgo::ociofiletransform(ImageBuf& dst, const ImageBuf& src,
         return false;
     }
     ColorProcessorHandle processor;
-    {
-        spin_lock lock(colorconfig_mutex);
-        if (!colorconfig)
-            colorconfig = default_colorconfig.get();
-        if (!colorconfig)
-            default_colorconfig.reset(colorconfig = new ColorConfig);
-        processor = colorconfig->createFileTransform(name, inverse);
-        if (!processor) {
-            if (colorconfig->error())
-                dst.errorfmt("{}", colorconfig->geterror());
-            else
-                dst.errorfmt("Could not construct the color transform");
-            return false;
-        }
+    colorconfig = resolve_colorconfig(colorconfig);
+    processor   = colorconfig->createFileTransform(name, inverse);
+    if (!processor) {
+        if (colorconfig->error())
+            dst.errorfmt("{}", colorconfig->geterror());
+        else
+            dst.errorfmt("Could not construct the color transform");
+        return false;
     }
 
     logtime.stop();  // transition to colorconvert
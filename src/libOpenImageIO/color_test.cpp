@@ -120,6 +120,106 @@ test_Rec709_conversion()
 
 
 
+// The SIMD transfer functions, at every width, must stay within their
+// documented error of the exact functions.
+static void
+test_transfer_simd_accuracy()
+{
+    // Exact, but with the same (float) thresholds between the segments
+    auto s2l = [](double x) {
+        return x <= 0.04045f ? x / 12.92 : pow((x + 0.055) / 1.055, 2.4);
+    };
+    auto l2s = [](double x) {
+        return x <= 0.0031308f ? 12.92 * x : 1.055 * pow(x, 1 / 2.4) - 0.055;
+    };
+    auto r2l = [](double x) {
+        return x < 0.081f ? x / 4.5 : pow((x + 0.099) / 1.099, 1 / 0.45);
+    };
+    auto l2r = [](double x) {
+        return x < 0.018f ? 4.5 * x : 1.099 * pow(x, 0.45) - 0.099;
+    };
+    double maxerr[4] = { 0, 0, 0, 0 };
+    auto check = [&](int i, float x, float y, double exact) {
+        double err = x <= 1.0f ? fabs(y - exact) : fabs(y - exact) / exact;
+        maxerr[i]  = std::max(maxerr[i], err);
+    };
+    const int n = 160000;  // steps across [0,2]
+    for (int i = 0; i < n; i += 16) {
+        float xs[16];
+        for (int j = 0; j < 16; ++j)
+            xs[j] = float(i + j) * (2.0f / n);
+        vfloat16 x16(xs);
+        vfloat16 a = sRGB_to_linear(x16), b = linear_to_sRGB(x16);
+        vfloat16 c = Rec709_to_linear(x16), d = linear_to_Rec709(x16);
+        for (int j = 0; j < 16; ++j) {
+            check(0, xs[j], a[j], s2l(xs[j]));
+            check(1, xs[j], b[j], l2s(xs[j]));
+            check(2, xs[j], c[j], r2l(xs[j]));
+            check(3, xs[j], d[j], l2r(xs[j]));
+        }
+        // Every width computes the same thing
+        float av[16], bv[16];
+        a.store(av);
+        b.store(bv);
+        int k = (i / 16) % 8;  // Try all lane offsets
+        OIIO_CHECK_SIMD_EQUAL(sRGB_to_linear(vfloat8(xs + k)), vfloat8(av + k));
+        OIIO_CHECK_SIMD_EQUAL(linear_to_sRGB(vfloat4(xs + k)), vfloat4(bv + k));
+        OIIO_CHECK_SIMD_EQUAL(linear_to_Rec709(x16.lo()), d.lo());
+        OIIO_CHECK_SIMD_EQUAL(Rec709_to_linear(x16.hi()), c.hi());
+    }
+    if (verbose)
+        Strutil::print("Max SIMD transfer errors: {} {} {} {}\n", maxerr[0],
+                       maxerr[1], maxerr[2], maxerr[3]);
+    for (double e : maxerr)
+        OIIO_CHECK_LT(e, 8.0e-6);
+}
+
+
+
+// The built-in transfer function processors transform only the color
+// channels, whatever the layout of the pixels.
+static void
+test_builtin_processors()
+{
+    ColorConfig config("");
+    ColorProcessorHandle p = config.createColorProcessor("sRGB", "linear");
+    OIIO_CHECK_ASSERT(p);
+    if (!p)
+        return;
+
+    // Packed RGBA: alpha is untouched
+    std::vector<float> rgba { 0.0f, 0.25f, 0.5f, 0.5f, 0.75f, 1.0f, 2.0f,
+                              0.25f };
+    p->apply(rgba.data(), 2, 1, 4, sizeof(float), 4 * sizeof(float),
+             8 * sizeof(float));
+    OIIO_CHECK_EQUAL_THRESH(rgba[1], sRGB_to_linear(0.25f), 1.0e-4);
+    OIIO_CHECK_EQUAL_THRESH(rgba[2], sRGB_to_linear(0.5f), 1.0e-4);
+    OIIO_CHECK_EQUAL(rgba[3], 0.5f);
+    OIIO_CHECK_EQUAL_THRESH(rgba[6], sRGB_to_linear(2.0f), 1.0e-3);
+    OIIO_CHECK_EQUAL(rgba[7], 0.25f);
+
+    // Packed RGB, an odd number of values
+    std::vector<float> rgb(3 * 7);
+    for (size_t i = 0; i < rgb.size(); ++i)
+        rgb[i] = float(i) / rgb.size();
+    std::vector<float> orig(rgb);
+    p->apply(rgb.data(), 7, 1, 3, sizeof(float), 3 * sizeof(float),
+             rgb.size() * sizeof(float));
+    for (size_t i = 0; i < rgb.size(); ++i)
+        OIIO_CHECK_EQUAL_THRESH(rgb[i], sRGB_to_linear(orig[i]), 1.0e-4);
+
+    // Planar: one channel of each pixel, 4 floats apart, the others left
+    std::vector<float> planar(8, 0.5f);
+    p->apply(planar.data(), 2, 1, 1, sizeof(float), 4 * sizeof(float),
+             8 * sizeof(float));
+    OIIO_CHECK_EQUAL_THRESH(planar[0], sRGB_to_linear(0.5f), 1.0e-4);
+    OIIO_CHECK_EQUAL(planar[1], 0.5f);
+    OIIO_CHECK_EQUAL_THRESH(planar[4], sRGB_to_linear(0.5f), 1.0e-4);
+    OIIO_CHECK_EQUAL(planar[5], 0.5f);
+}
+
+
+
 int
 main(int argc, char* argv[])
 {
@@ -135,6 +235,8 @@ main(int argc, char* argv[])
 
     test_sRGB_conversion();
     test_Rec709_conversion();
+    test_transfer_simd_accuracy();
+    test_builtin_processors();
 
     return unit_test_failures != 0;
 }
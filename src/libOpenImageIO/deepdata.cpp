@@ -5,6 +5,7 @@
 #include <algorithm>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <numeric>
 
 #include <OpenImageIO/Imath.h>
@@ -15,6 +16,8 @@
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/thread.h>
 
+#include "imageio_pvt.h"
+
 OIIO_NAMESPACE_BEGIN
 
 
@@ -27,6 +30,11 @@ OIIO_NAMESPACE_BEGIN
 // need to lock the mutex. As long as capacity is not changing, threads may
 // change number of samples (inserting or deleting) as well as altering
 // data, simultaneously, as long as they are working on separate pixels.
+//
+// The samples are usually interleaved, [p][s][c], but may instead be
+// planar, [c][p][s]: one array per channel, each of total capacity
+// samples, so that each channel's samples of a pixel are contiguous. Either
+// way the same cumulative capacity locates a pixel's samples.
 
 
 
@@ -41,7 +49,7 @@ public:
     std::vector<unsigned int> m_capacity;  // for each pixel [p]
     std::vector<unsigned int>
         m_cumcapacity;         // cumulative capacity before pixel [p]
-    std::vector<char> m_data;  // for each sample [p][s][c]
+    std::vector<char> m_data;  // for each sample [p][s][c] or [c][p][s]
     std::vector<std::string> m_channelnames;  // For each channel[c]
     std::vector<int> m_myalphachannel;        // For each channel[c], its alpha
         // myalphachannel[c] gives the alpha channel corresponding to channel
@@ -54,14 +62,38 @@ public:
     int m_AG_channel;
     int m_AB_channel;
     bool m_allocated;
+    bool m_planar = false;  // not reset by clear()
     spin_mutex m_mutex;
 
+    // Bytes of the sample data and per-pixel tables that are counted in
+    // pvt::deepdata_mem. Each Impl counts only its own, so this isn't
+    // copied along with the rest.
+    struct Counted {
+        size_t bytes = 0;
+        Counted()    = default;
+        Counted(const Counted&) {}
+        Counted& operator=(const Counted&) { return *this; }
+    } m_counted;
+
     Impl()
         : m_allocated(false)
     {
         clear();
     }
 
+    ~Impl() { pvt::deepdata_mem -= (long long)m_counted.bytes; }
+
+    // Update pvt::deepdata_mem after the big vectors may have changed size.
+    void account()
+    {
+        size_t bytes = m_data.capacity()
+                       + sizeof(unsigned int)
+                             * (m_nsamples.capacity() + m_capacity.capacity()
+                                + m_cumcapacity.capacity());
+        pvt::deepdata_mem += (long long)bytes - (long long)m_counted.bytes;
+        m_counted.bytes = bytes;
+    }
+
     void clear()
     {
         m_channeltypes.clear();
@@ -97,6 +129,7 @@ public:
                 }
                 m_data.resize(totalcapacity * m_samplesize);
                 m_allocated = true;
+                account();
             }
         }
     }
@@ -105,8 +138,11 @@ public:
     {
         OIIO_DASSERT(int(m_cumcapacity.size()) > pixel);
         OIIO_DASSERT(m_capacity[pixel] >= m_nsamples[pixel]);
-        return (m_cumcapacity[pixel] + sample) * m_samplesize
-               + m_channeloffsets[channel];
+        size_t s = m_cumcapacity[pixel] + sample;
+        if (m_planar)
+            return m_channeloffsets[channel] * total_capacity()
+                   + s * m_channelsizes[channel];
+        return s * m_samplesize + m_channeloffsets[channel];
     }
 
     void* data_ptr(int64_t pixel, int channel, int sample)
@@ -121,6 +157,77 @@ public:
         return m_cumcapacity.back() + m_capacity.back();
     }
 
+    // Move `n` samples of a pixel from sample `from` to sample `to`, all
+    // within its capacity.
+    void move_samples(int64_t pixel, int from, int to, int n)
+    {
+        if (n <= 0 || from == to)
+            return;
+        if (m_planar) {
+            for (size_t c = 0, e = m_channelsizes.size(); c < e; ++c)
+                memmove(data_ptr(pixel, c, to), data_ptr(pixel, c, from),
+                        n * m_channelsizes[c]);
+        } else {
+            memmove(data_ptr(pixel, 0, to), data_ptr(pixel, 0, from),
+                    n * m_samplesize);
+        }
+    }
+
+    // Give every pixel the new capacity `newcap[p]` (which must be no less
+    // than its samples), moving each pixel's samples to their new place.
+    void reallocate(const std::vector<unsigned int>& newcap)
+    {
+        size_t npixels  = m_capacity.size();
+        size_t oldtotal = total_capacity();
+        std::vector<unsigned int> newcum(npixels);
+        size_t newtotal = 0;
+        for (size_t p = 0; p < npixels; ++p) {
+            newcum[p] = newtotal;
+            newtotal += newcap[p];
+        }
+        std::vector<char> data(newtotal * m_samplesize, 0);
+        if (m_planar) {
+            for (size_t c = 0, e = m_channelsizes.size(); c < e; ++c) {
+                size_t size    = m_channelsizes[c];
+                const char* in = m_data.data() + m_channeloffsets[c] * oldtotal;
+                char* out      = data.data() + m_channeloffsets[c] * newtotal;
+                for (size_t p = 0; p < npixels; ++p)
+                    memcpy(out + newcum[p] * size, in + m_cumcapacity[p] * size,
+                           m_nsamples[p] * size);
+            }
+        } else {
+            for (size_t p = 0; p < npixels; ++p)
+                memcpy(&data[newcum[p] * m_samplesize],
+                       &m_data[m_cumcapacity[p] * m_samplesize],
+                       m_nsamples[p] * m_samplesize);
+        }
+        m_data.swap(data);
+        m_cumcapacity.swap(newcum);
+        m_capacity = newcap;
+        account();
+    }
+
+    // Grow the capacity of a planar pixel that currently has capacity `n`
+    // by `toadd` samples, which means opening a gap in every channel's
+    // array.
+    void grow_planar(int64_t pixel, int n, int toadd)
+    {
+        size_t oldtotal = total_capacity();
+        size_t newtotal = oldtotal + toadd;
+        size_t split    = m_cumcapacity[pixel] + n;
+        std::vector<char> data(newtotal * m_samplesize, 0);
+        for (size_t c = 0, e = m_channelsizes.size(); c < e; ++c) {
+            size_t size    = m_channelsizes[c];
+            const char* in = m_data.data() + m_channeloffsets[c] * oldtotal;
+            char* out      = data.data() + m_channeloffsets[c] * newtotal;
+            memcpy(out, in, split * size);
+            memcpy(out + (split + toadd) * size, in + split * size,
+                   (oldtotal - split) * size);
+        }
+        m_data.swap(data);
+        account();
+    }
+
     inline void sanity() const
     {
         // int nchannels = int (m_channeltypes.size());
@@ -172,6 +279,7 @@ DeepData::DeepData(const DeepData& d)
     if (d.m_impl) {
         m_impl  = new Impl;
         *m_impl = *(d.m_impl);
+        m_impl->account();
     }
 }
 
@@ -189,6 +297,7 @@ DeepData::operator=(const DeepData& d)
             *m_impl = *(d.m_impl);
         else
             m_impl->clear();
+        m_impl->account();
     }
     return *this;
 }
@@ -299,6 +408,55 @@ DeepData::samplesize() const
 
 
 
+bool
+DeepData::planar() const
+{
+    return m_impl && m_impl->m_planar;
+}
+
+
+
+void
+DeepData::set_planar(bool planar)
+{
+    if (!m_impl)
+        m_impl = new Impl;
+    if (planar == m_impl->m_planar)
+        return;
+    if (m_impl->m_allocated && m_impl->m_data.size()) {
+        // Transpose the samples between [p][s][c] and [c][p][s]
+        size_t total      = m_impl->total_capacity();
+        size_t samplesize = m_impl->m_samplesize;
+        std::vector<char> data(m_impl->m_data.size());
+        const char* in = m_impl->m_data.data();
+        for (int c = 0; c < m_nchannels; ++c) {
+            size_t size   = m_impl->m_channelsizes[c];
+            size_t offset = m_impl->m_channeloffsets[c];
+            for (size_t i = 0; i < total; ++i) {
+                size_t ipos = i * samplesize + offset;    // interleaved
+                size_t ppos = offset * total + i * size;  // planar
+                if (planar)
+                    memcpy(&data[ppos], in + ipos, size);
+                else
+                    memcpy(&data[ipos], in + ppos, size);
+            }
+        }
+        m_impl->m_data.swap(data);
+        m_impl->account();
+    }
+    m_impl->m_planar = planar;
+}
+
+
+
+size_t
+DeepData::sample_stride(int c) const
+{
+    return planar() ? channelsize(c) : samplesize();
+}
+
+
+
 // Is name the same as suffix, or does it end in ".suffix"?
 inline bool
 is_or_endswithdot(string_view name, string_view suffix)
@@ -335,6 +493,7 @@ DeepData::init(int64_t npix, int nchan, cspan<TypeDesc> channeltypes,
     m_impl->m_nsamples.resize(m_npixels, 0);
     m_impl->m_capacity.resize(m_npixels, 0);
     m_impl->m_cumcapacity.resize(m_npixels, 0);
+    m_impl->account();
 
     // Channel name hunt
     // First, find Z, Zback, A
@@ -480,11 +639,14 @@ DeepData::set_capacity(int64_t pixel, int samps)
             if (m_impl->m_data.empty()) {
                 size_t newtotal = (m_impl->total_capacity() + toadd);
                 m_impl->m_data.resize(newtotal * samplesize());
+            } else if (m_impl->m_planar) {
+                m_impl->grow_planar(pixel, n, toadd);
             } else {
                 size_t offset = m_impl->data_offset(pixel, 0, n);
                 m_impl->m_data.insert(m_impl->m_data.begin() + offset,
                                       toadd * samplesize(), 0);
             }
+            m_impl->account();
             // Adjust the cumulative prefix sum of samples for subsequent pixels
             for (int64_t p = pixel + 1; p < m_npixels; ++p)
                 m_impl->m_cumcapacity[p] += toadd;
@@ -497,6 +659,31 @@ DeepData::set_capacity(int64_t pixel, int samps)
 
 
 
+void
+DeepData::set_all_capacity(cspan<unsigned int> capacity)
+{
+    if (capacity.size() != m_npixels)
+        return;
+    OIIO_DASSERT(m_impl);
+    spin_lock lock(m_impl->m_mutex);
+    std::vector<unsigned int> newcap(m_impl->m_capacity);
+    bool grows = false;
+    for (int64_t p = 0; p < m_npixels; ++p) {
+        if (capacity[p] > newcap[p]) {
+            newcap[p] = capacity[p];
+            grows     = true;
+        }
+    }
+    if (!m_impl->m_allocated) {
+        m_impl->m_capacity.swap(newcap);
+        m_impl->account();
+    } else if (grows) {
+        m_impl->reallocate(newcap);
+    }
+}
+
+
+
 int
 DeepData::samples(int64_t pixel) const
 {
@@ -544,6 +731,7 @@ DeepData::set_all_samples(cspan<unsigned int> samples)
         // Data not yet allocated: copy in one shot
         m_impl->m_nsamples.assign(&samples[0], &samples[m_npixels]);
         m_impl->m_capacity.assign(&samples[0], &samples[m_npixels]);
+        m_impl->account();
     }
 }
 
@@ -561,13 +749,8 @@ DeepData::insert_samples(int64_t pixel, int samplepos, int n)
     // in play, they are working on separate pixels.
     if (m_impl->m_allocated) {
         // Move the data
-        if (samplepos < oldsamps) {
-            size_t offset = m_impl->data_offset(pixel, 0, samplepos);
-            size_t end    = m_impl->data_offset(pixel, 0, oldsamps);
-            std::copy_backward(m_impl->m_data.begin() + offset,
-                               m_impl->m_data.begin() + end,
-                               m_impl->m_data.begin() + end + n * samplesize());
-        }
+        m_impl->move_samples(pixel, samplepos, samplepos + n,
+                             oldsamps - samplepos);
     }
     // Add to this pixel's sample count
     m_impl->m_nsamples[pixel] += n;
@@ -584,12 +767,8 @@ DeepData::erase_samples(int64_t pixel, int samplepos, int n)
     n = std::min(n, int(m_impl->m_nsamples[pixel]));
     if (m_impl->m_allocated) {
         // Move the data
-        int oldsamps  = samples(pixel);
-        size_t offset = m_impl->data_offset(pixel, 0, samplepos);
-        size_t end    = m_impl->data_offset(pixel, 0, oldsamps);
-        std::copy(m_impl->m_data.begin() + offset + n * samplesize(),
-                  m_impl->m_data.begin() + end,
-                  m_impl->m_data.begin() + offset);
+        m_impl->move_samples(pixel, samplepos + n, samplepos,
+                             samples(pixel) - samplepos - n);
     }
     m_impl->m_nsamples[pixel] -= n;
 }
@@ -620,6 +799,28 @@ DeepData::data_ptr(int64_t pixel, int channel, int sample) const
 
 
 
+span<float>
+DeepData::float_samples(int64_t pixel, int channel)
+{
+    if (!planar() || channeltype(channel) != TypeDesc::FLOAT)
+        return span<float>();
+    float* ptr = (float*)data_ptr(pixel, channel, 0);
+    return ptr ? span<float>(ptr, samples(pixel)) : span<float>();
+}
+
+
+
+cspan<float>
+DeepData::float_samples(int64_t pixel, int channel) const
+{
+    if (!planar() || channeltype(channel) != TypeDesc::FLOAT)
+        return cspan<float>();
+    const float* ptr = (const float*)data_ptr(pixel, channel, 0);
+    return ptr ? cspan<float>(ptr, samples(pixel)) : cspan<float>();
+}
+
+
+
 float
 DeepData::deep_value(int64_t pixel, int channel, int sample) const
 {
@@ -814,6 +1015,28 @@ DeepData::all_data() const
 
 
 
+size_t
+DeepData::memsize() const
+{
+    size_t size = sizeof(DeepData);
+    if (m_impl) {
+        const Impl& d(*m_impl);
+        size += sizeof(Impl) + d.m_data.capacity()
+                + sizeof(unsigned int)
+                      * (d.m_nsamples.capacity() + d.m_capacity.capacity()
+                         + d.m_cumcapacity.capacity())
+                + d.m_channeltypes.capacity() * sizeof(TypeDesc)
+                + d.m_myalphachannel.capacity() * sizeof(int)
+                + (d.m_channelsizes.capacity() + d.m_channeloffsets.capacity())
+                      * sizeof(size_t);
+        for (auto& name : d.m_channelnames)
+            size += sizeof(std::string) + name.capacity();
+    }
+    return size;
+}
+
+
+
 void
 DeepData::get_pointers(std::vector<void*>& pointers) const
 {
@@ -884,9 +1107,13 @@ DeepData::copy_deep_pixel(int64_t pixel, const DeepData& src, int64_t srcpixel)
     if (sametypes)
         for (int c = 0; c < nchans; ++c)
             sametypes &= (channeltype(c) == src.channeltype(c));
-    if (sametypes)
+    if (sametypes && !planar() && !src.planar())
         memcpy(data_ptr(pixel, 0, 0), src.data_ptr(srcpixel, 0, 0),
                samplesize() * nsamples);
+    else if (sametypes && planar() && src.planar())
+        for (int c = 0; c < nchans; ++c)
+            memcpy(data_ptr(pixel, c, 0), src.data_ptr(srcpixel, c, 0),
+                   channelsize(c) * nsamples);
     else {
         for (int c = 0; c < nchans; ++c) {
             if (channeltype(c) == TypeDesc::UINT32
@@ -1016,13 +1243,35 @@ private:
 
 
 
+// Stable sort of n indices. Deep pixels mostly hold only a handful of
+// samples, for which an insertion sort is quicker than std::stable_sort
+// (which allocates a buffer), and it's stable, which matters because
+// merge_overlaps() doesn't treat coincident samples symmetrically.
+template<class COMPARE>
+static void
+sort_indices(int* indices, int n, COMPARE less)
+{
+    if (n > 16) {
+        std::stable_sort(indices, indices + n, less);
+        return;
+    }
+    for (int i = 1; i < n; ++i) {
+        int v = indices[i], j = i;
+        for (; j > 0 && less(v, indices[j - 1]); --j)
+            indices[j] = indices[j - 1];
+        indices[j] = v;
+    }
+}
+
+
+
 void
 DeepData::sort(int64_t pixel)
 {
     int zchan = m_impl->m_z_channel;
     if (zchan < 0)
         return;  // No channel labeled Z -- we don't know what to do
-    int zbackchan = m_impl->m_z_channel;
+    int zbackchan = m_impl->m_zback_channel;
     if (zbackchan < 0)
         zbackchan = zchan;
     int nsamples = samples(pixel);
@@ -1034,16 +1283,38 @@ DeepData::sort(int64_t pixel)
     // known at compile time. So we just sort the indices!
     int* sample_indices = OIIO_ALLOCA(int, nsamples);
     std::iota(sample_indices, sample_indices + nsamples, 0);
-    std::stable_sort(sample_indices, sample_indices + nsamples,
+    cspan<float> zs  = float_samples(pixel, zchan);
+    cspan<float> zbs = float_samples(pixel, zbackchan);
+    if (zs.size() && zbs.size()) {
+        // Planar float depths can be compared directly
+        sort_indices(sample_indices, nsamples, [&](int i, int j) {
+            return zs[i] < zs[j] || (!(zs[i] > zs[j]) && zbs[i] < zbs[j]);
+        });
+    } else {
+        sort_indices(sample_indices, nsamples,
                      SampleComparator(*this, pixel, zchan, zbackchan));
+    }
+    // Most pixels arrive already in order; then there's nothing to move.
+    bool sorted = true;
+    for (int i = 0; i < nsamples && sorted; ++i)
+        sorted = (sample_indices[i] == i);
+    if (sorted)
+        return;
 
-    // Now copy around using a temp buffer
-    size_t samplebytes = samplesize();
-    char* tmppixel     = OIIO_ALLOCA(char, samplebytes* nsamples);
-    memcpy(tmppixel, data_ptr(pixel, 0, 0), samplebytes * nsamples);
-    for (int i = 0; i < nsamples; ++i)
-        memcpy(data_ptr(pixel, 0, i),
-               tmppixel + samplebytes * sample_indices[i], samplebytes);
+    // Now copy around using a temp buffer, either whole samples or one
+    // channel at a time.
+    int nplanes        = planar() ? channels() : 1;
+    size_t samplebytes = planar() ? 0 : samplesize();
+    char* tmppixel     = OIIO_ALLOCA(char, samplesize() * nsamples);
+    for (int c = 0; c < nplanes; ++c) {
+        if (planar())
+            samplebytes = channelsize(c);
+        char* data = (char*)data_ptr(pixel, c, 0);
+        memcpy(tmppixel, data, samplebytes * nsamples);
+        for (int i = 0; i < nsamples; ++i)
+            memcpy(data + samplebytes * i,
+                   tmppixel + samplebytes * sample_indices[i], samplebytes);
+    }
 }
 
 
@@ -1190,6 +1461,13 @@ DeepData::opaque_z(int64_t pixel) const
 
     // There are samples, Z, and alpha channels. Figure out where it gets
     // opaque.
+    cspan<float> alphas = cA >= 0 ? float_samples(pixel, cA) : cspan<float>();
+    if (alphas.size()) {
+        for (int s = 0; s < nsamples; ++s)
+            if (alphas[s] >= 1.0f)
+                return deep_value(pixel, cZback, s);
+        return std::numeric_limits<float>::max();
+    }
     for (int s = 0; s < nsamples; ++s) {
         float alpha;
         if (cA >= 0)
@@ -1216,7 +1494,15 @@ DeepData::occlusion_cull(int64_t pixel)
     int alpha_channel = m_impl->m_alpha_channel;
     if (alpha_channel < 0)
         return;  // If there isn't a definitive alpha channel, never mind
-    int nsamples = samples(pixel);
+    int nsamples        = samples(pixel);
+    cspan<float> alphas = float_samples(pixel, alpha_channel);
+    if (alphas.size()) {
+        auto opaque = std::find_if(alphas.begin(), alphas.end(),
+                                   [](float a) { return a >= 1.0f; });
+        if (opaque != alphas.end())
+            set_samples(pixel, int(opaque - alphas.begin()) + 1);
+        return;
+    }
     for (int s = 0; s < nsamples; ++s) {
         if (deep_value(pixel, alpha_channel, s) >= 1.0f) {
             // We hit an opaque sample. Cull everything farther.
@@ -1472,4 +1472,62 @@ exif_tag_lookup(string_view name, int& tag, int& tifftype, int& count)
 }
 
 
+
+// Names of the attributes in which defer_metadata() keeps each kind of
+// block, and of the kinds, in the same order.
+static const ustring deferred_names[] = { ustring("oiio:DeferredExif"),
+                                          ustring("oiio:DeferredXMP"),
+                                          ustring("oiio:DeferredIPTC") };
+static const char* deferred_kinds[]   = { "exif", "xmp", "iptc" };
+
+
+
+bool
+defer_metadata(string_view kind, cspan<uint8_t> blob, ImageSpec& spec)
+{
+    for (int k = 0; k < 3; ++k) {
+        if (kind == deferred_kinds[k]) {
+            // Not spec.attribute(), which would replace an earlier block of
+            // the same kind.
+            TypeDesc type(TypeDesc::UINT8, int(blob.size()));
+            spec.extra_attribs.emplace_back(deferred_names[k], type, 1,
+                                            blob.data());
+            return true;
+        }
+    }
+    return false;
+}
+
+
+
+bool
+decode_deferred_metadata(ImageSpec& spec)
+{
+    bool found = false;
+    for (size_t i = 0; i < spec.extra_attribs.size();) {
+        const ParamValue& p(spec.extra_attribs[i]);
+        int k = 0;
+        while (k < 3 && p.uname() != deferred_names[k])
+            ++k;
+        if (k == 3) {
+            ++i;
+            continue;
+        }
+        // Take the block out before decoding, which appends to the
+        // attribute list.
+        const uint8_t* data = (const uint8_t*)p.data();
+        std::vector<uint8_t> blob(data, data + p.datasize());
+        spec.extra_attribs.erase(spec.extra_attribs.begin() + i);
+        if (k == 0)
+            decode_exif(blob, spec);
+        else if (k == 1)
+            decode_xmp(blob, spec);
+        else
+            decode_iptc_iim(blob.data(), int(blob.size()), spec);
+        found = true;
+    }
+    return found;
+}
+
+
 OIIO_NAMESPACE_END
@@ -4,6 +4,8 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <regex>
 #include <sstream>
 
@@ -1007,11 +1009,20 @@ spec_to_xml(const ImageSpec& spec, ImageSpec::SerialVerbose verbose)
 
 
 
+namespace {
+std::string
+spec_to_binary(const ImageSpec& spec);  // Defined below
+}
+
+
+
 std::string
 ImageSpec::serialize(SerialFormat fmt, SerialVerbose verbose) const
 {
     if (fmt == SerialXML)
         return spec_to_xml(*this, verbose);
+    if (fmt == SerialBinary)
+        return spec_to_binary(*this);
 
     // Text case:
     //
@@ -1144,6 +1155,545 @@ ImageSpec::from_xml(const char* xml)
 
 
 
+// The SerialBinary encoding of an ImageSpec. All numbers are little-endian.
+// Version 1 is:
+//
+//     0    "OISB"                          magic
+//     4    uint32 version
+//     8    uint32 size                     of the whole encoding, in bytes
+//     12   int32 x 19                      x, y, z, ... z_channel, deep
+//     88   TypeDesc                        format
+//     96   uint32 count, uint32 offset     table of channelformats
+//     104  uint32 count, uint32 offset     table of channel names
+//     112  uint32 count, uint32 offset     table of attributes
+//     120  the tables, then strings and attribute data
+//
+// A TypeDesc is 8 bytes: basetype, aggregate, vecsemantics, 0, and int32
+// arraylen. A string is 8 bytes: uint32 offset and uint32 length of its
+// characters. An attribute is 32 bytes: name (a string), TypeDesc, int32
+// nvalues, int32 interp, uint32 offset and uint32 size of its data, which
+// for string attributes is one string (8 bytes) per value. Offsets are
+// from the start of the encoding, and data is 8-byte aligned.
+namespace {
+
+static const char binspec_magic[4]   = { 'O', 'I', 'S', 'B' };
+static const uint32_t binspec_version = 1;
+static const size_t binspec_header    = 120;
+static const size_t binspec_attrib    = 32;
+
+template<typename T>
+inline T
+load_le(const char* p)
+{
+    T v;
+    memcpy(&v, p, sizeof(T));
+    if (bigendian())
+        swap_endian(&v);
+    return v;
+}
+
+template<typename T>
+inline void
+store_le(char* p, T v)
+{
+    if (bigendian())
+        swap_endian(&v);
+    memcpy(p, &v, sizeof(T));
+}
+
+// Swap the `n` values of type `t` at `p` between little-endian and native
+// order, if they differ.
+inline void
+swap_values_le(void* p, TypeDesc t, size_t n)
+{
+    if (!bigendian())
+        return;
+    n *= t.numelements() * t.aggregate;
+    switch (t.basesize()) {
+    case 2: swap_endian((uint16_t*)p, int(n)); break;
+    case 4: swap_endian((uint32_t*)p, int(n)); break;
+    case 8: swap_endian((uint64_t*)p, int(n)); break;
+    default: break;
+    }
+}
+
+inline TypeDesc
+load_typedesc(const char* p)
+{
+    TypeDesc t;
+    t.basetype     = (unsigned char)p[0];
+    t.aggregate    = (unsigned char)p[1];
+    t.vecsemantics = (unsigned char)p[2];
+    t.arraylen     = load_le<int32_t>(p + 4);
+    return t;
+}
+
+inline void
+store_typedesc(char* p, TypeDesc t)
+{
+    p[0] = char(t.basetype);
+    p[1] = char(t.aggregate);
+    p[2] = char(t.vecsemantics);
+    p[3] = 0;
+    store_le(p + 4, int32_t(t.arraylen));
+}
+
+inline bool
+valid_typedesc(TypeDesc t)
+{
+    return t.basetype < TypeDesc::PTR && t.aggregate >= 1
+           && t.aggregate <= 16 && t.arraylen >= -1;
+}
+
+inline string_view
+load_string(const char* base, const char* p)
+{
+    return string_view(base + load_le<uint32_t>(p), load_le<uint32_t>(p + 4));
+}
+
+// The decoded fixed part of an attribute's entry in the table
+struct BinAttrib {
+    string_view name;
+    TypeDesc type;
+    int nvalues, interp;
+    uint32_t offset, size;
+    size_t nstrings() const
+    {
+        return size_t(nvalues) * type.numelements() * type.aggregate;
+    }
+};
+
+inline BinAttrib
+load_attrib(const char* base, size_t entry)
+{
+    const char* p = base + entry;
+    BinAttrib a;
+    a.name    = load_string(base, p);
+    a.type    = load_typedesc(p + 8);
+    a.nvalues = load_le<int32_t>(p + 16);
+    a.interp  = load_le<int32_t>(p + 20);
+    a.offset  = load_le<uint32_t>(p + 24);
+    a.size    = load_le<uint32_t>(p + 28);
+    return a;
+}
+
+
+
+// The value of an attribute that is a single integer or floating point
+// value, as a double. Return false if it's something else.
+inline bool
+load_scalar(const char* base, const BinAttrib& a, double& v)
+{
+    TypeDesc t = a.type;
+    if (a.nvalues != 1 || t.aggregate != 1 || t.arraylen)
+        return false;
+    const char* p = base + a.offset;
+    switch (t.basetype) {
+    case TypeDesc::UINT8: v = load_le<uint8_t>(p); break;
+    case TypeDesc::INT8: v = load_le<int8_t>(p); break;
+    case TypeDesc::UINT16: v = load_le<uint16_t>(p); break;
+    case TypeDesc::INT16: v = load_le<int16_t>(p); break;
+    case TypeDesc::UINT32: v = load_le<uint32_t>(p); break;
+    case TypeDesc::INT32: v = load_le<int32_t>(p); break;
+    case TypeDesc::UINT64: v = double(load_le<uint64_t>(p)); break;
+    case TypeDesc::INT64: v = double(load_le<int64_t>(p)); break;
+    case TypeDesc::HALF: {
+        uint16_t bits = load_le<uint16_t>(p);
+        half h;
+        memcpy((void*)&h, &bits, sizeof(h));
+        v = float(h);
+        break;
+    }
+    case TypeDesc::FLOAT: v = load_le<float>(p); break;
+    case TypeDesc::DOUBLE: v = load_le<double>(p); break;
+    default: return false;
+    }
+    return true;
+}
+
+
+
+// Builds the encoding: a fixed-size front (header and tables), to which
+// strings and data are appended.
+class BinSpecWriter {
+public:
+    BinSpecWriter(size_t frontsize)
+        : m_buf(frontsize, '\0')
+    {
+    }
+    char* at(size_t offset) { return &m_buf[offset]; }
+    // Append `s` and store its offset and length at `entry`.
+    void put_string(size_t entry, string_view s)
+    {
+        store_le(at(entry), uint32_t(m_buf.size()));
+        store_le(at(entry + 4), uint32_t(s.size()));
+        m_buf.append(s.data(), s.size());
+    }
+    // Append `size` zero bytes, 8-byte aligned, and return their offset.
+    size_t reserve(size_t size)
+    {
+        m_buf.resize(round_to_multiple(m_buf.size(), size_t(8)));
+        size_t offset = m_buf.size();
+        m_buf.resize(offset + size);
+        return offset;
+    }
+    std::string& str() { return m_buf; }
+
+private:
+    std::string m_buf;
+};
+
+
+
+std::string
+spec_to_binary(const ImageSpec& spec)
+{
+    // Pointers don't survive the trip to another process, leave them out
+    std::vector<const ParamValue*> attribs;
+    for (auto& p : spec.extra_attribs)
+        if (p.type().basetype != TypeDesc::PTR)
+            attribs.push_back(&p);
+    const size_t nformats = spec.channelformats.size();
+    const size_t nnames   = spec.channelnames.size();
+    const size_t formats  = binspec_header;
+    const size_t names    = formats + 8 * nformats;
+    const size_t table    = names + 8 * nnames;
+    BinSpecWriter out(table + binspec_attrib * attribs.size());
+
+    memcpy(out.at(0), binspec_magic, 4);
+    store_le(out.at(4), binspec_version);
+    int fields[19] = { spec.x,           spec.y,
+                       spec.z,           spec.width,
+                       spec.height,      spec.depth,
+                       spec.full_x,      spec.full_y,
+                       spec.full_z,      spec.full_width,
+                       spec.full_height, spec.full_depth,
+                       spec.tile_width,  spec.tile_height,
+                       spec.tile_depth,  spec.nchannels,
+                       spec.alpha_channel, spec.z_channel,
+                       int(spec.deep) };
+    for (int i = 0; i < 19; ++i)
+        store_le(out.at(12 + 4 * i), int32_t(fields[i]));
+    store_typedesc(out.at(88), spec.format);
+    store_le(out.at(96), uint32_t(nformats));
+    store_le(out.at(100), uint32_t(formats));
+    store_le(out.at(104), uint32_t(nnames));
+    store_le(out.at(108), uint32_t(names));
+    store_le(out.at(112), uint32_t(attribs.size()));
+    store_le(out.at(116), uint32_t(table));
+    for (size_t c = 0; c < nformats; ++c)
+        store_typedesc(out.at(formats + 8 * c), spec.channelformats[c]);
+    for (size_t c = 0; c < nnames; ++c)
+        out.put_string(names + 8 * c, spec.channelnames[c]);
+
+    for (size_t i = 0; i < attribs.size(); ++i) {
+        const ParamValue& p(*attribs[i]);
+        const size_t entry = table + binspec_attrib * i;
+        TypeDesc t         = p.type();
+        out.put_string(entry, p.name());
+        store_typedesc(out.at(entry + 8), t);
+        store_le(out.at(entry + 16), int32_t(p.nvalues()));
+        store_le(out.at(entry + 20), int32_t(p.interp()));
+        size_t offset, size;
+        if (t.basetype == TypeDesc::STRING) {
+            size_t n = size_t(p.nvalues()) * t.numelements() * t.aggregate;
+            size     = 8 * n;
+            offset   = out.reserve(size);
+            for (size_t k = 0; k < n; ++k)
+                out.put_string(offset + 8 * k, ((const ustring*)p.data())[k]);
+        } else {
+            size   = p.datasize();
+            offset = out.reserve(size);
+            memcpy(out.at(offset), p.data(), size);
+            swap_values_le(out.at(offset), t, size_t(p.nvalues()));
+        }
+        store_le(out.at(entry + 24), uint32_t(offset));
+        store_le(out.at(entry + 28), uint32_t(size));
+    }
+    store_le(out.at(8), uint32_t(out.str().size()));
+    return std::move(out.str());
+}
+
+}  // namespace
+
+
+
+ImageSpecView::ImageSpecView(string_view data)
+{
+    // Check everything the queries will rely on, so that they needn't.
+    const char* d = data.data();
+    if (data.size() < binspec_header || memcmp(d, binspec_magic, 4)
+        || load_le<uint32_t>(d + 4) != binspec_version)
+        return;
+    const uint64_t size = load_le<uint32_t>(d + 8);
+    if (size > data.size() || size < binspec_header
+        || !valid_typedesc(load_typedesc(d + 88)))
+        return;
+    auto inside = [&](uint64_t offset, uint64_t len) {
+        return offset <= size && len <= size - offset;
+    };
+    auto valid_string = [&](const char* p) {
+        return inside(load_le<uint32_t>(p), load_le<uint32_t>(p + 4));
+    };
+    const uint32_t nformats = load_le<uint32_t>(d + 96);
+    const uint32_t formats  = load_le<uint32_t>(d + 100);
+    const uint32_t nnames   = load_le<uint32_t>(d + 104);
+    const uint32_t names    = load_le<uint32_t>(d + 108);
+    const uint32_t nattribs = load_le<uint32_t>(d + 112);
+    const uint32_t table    = load_le<uint32_t>(d + 116);
+    if (!inside(formats, 8 * uint64_t(nformats))
+        || !inside(names, 8 * uint64_t(nnames))
+        || !inside(table, binspec_attrib * uint64_t(nattribs))
+        || nattribs > uint32_t(std::numeric_limits<int>::max()))
+        return;
+    for (uint32_t c = 0; c < nformats; ++c)
+        if (!valid_typedesc(load_typedesc(d + formats + 8 * c)))
+            return;
+    for (uint32_t c = 0; c < nnames; ++c)
+        if (!valid_string(d + names + 8 * c))
+            return;
+    for (uint32_t i = 0; i < nattribs; ++i) {
+        const size_t entry = table + binspec_attrib * i;
+        if (!valid_string(d + entry))
+            return;
+        BinAttrib a = load_attrib(d, entry);
+        if (!valid_typedesc(a.type) || a.nvalues < 0 || a.interp < 0
+            || a.interp > ParamValue::INTERP_VERTEX
+            || !inside(a.offset, a.size))
+            return;
+        if (a.type.basetype == TypeDesc::STRING) {
+            if (a.size != 8 * uint64_t(a.nstrings()))
+                return;
+            for (size_t k = 0; k < a.nstrings(); ++k)
+                if (!valid_string(d + a.offset + 8 * k))
+                    return;
+        } else if (a.size != uint64_t(a.nvalues) * a.type.size()) {
+            return;
+        }
+    }
+    m_data     = d;
+    m_nattribs = int(nattribs);
+}
+
+
+
+int
+ImageSpecView::field(int i) const noexcept
+{
+    return m_data ? load_le<int32_t>(m_data + 12 + 4 * i) : 0;
+}
+
+
+
+TypeDesc
+ImageSpecView::format() const noexcept
+{
+    return m_data ? load_typedesc(m_data + 88) : TypeUnknown;
+}
+
+
+
+TypeDesc
+ImageSpecView::channelformat(int chan) const noexcept
+{
+    if (m_data && chan >= 0 && chan < int(load_le<uint32_t>(m_data + 96)))
+        return load_typedesc(m_data + load_le<uint32_t>(m_data + 100)
+                             + 8 * chan);
+    return format();
+}
+
+
+
+string_view
+ImageSpecView::channel_name(int chan) const noexcept
+{
+    if (m_data && chan >= 0 && chan < int(load_le<uint32_t>(m_data + 104)))
+        return load_string(m_data, m_data + load_le<uint32_t>(m_data + 108)
+                                       + 8 * chan);
+    return string_view();
+}
+
+
+
+string_view
+ImageSpecView::attrib_name(int i) const noexcept
+{
+    if (i < 0 || i >= m_nattribs)
+        return string_view();
+    return load_string(m_data, m_data + load_le<uint32_t>(m_data + 116)
+                                   + binspec_attrib * i);
+}
+
+
+
+TypeDesc
+ImageSpecView::attrib_type(int i) const noexcept
+{
+    if (i < 0 || i >= m_nattribs)
+        return TypeUnknown;
+    return load_typedesc(m_data + load_le<uint32_t>(m_data + 116)
+                         + binspec_attrib * i + 8);
+}
+
+
+
+int
+ImageSpecView::find_attrib(string_view name, bool casesensitive) const
+{
+    for (int i = 0; i < m_nattribs; ++i) {
+        string_view n = attrib_name(i);
+        if (casesensitive ? n == name : Strutil::iequals(n, name))
+            return i;
+    }
+    return -1;
+}
+
+
+
+bool
+ImageSpecView::getattribute(string_view name, TypeDesc type, void* value,
+                            bool casesensitive) const
+{
+    int i = find_attrib(name, casesensitive);
+    if (i < 0)
+        return false;
+    BinAttrib a = load_attrib(m_data, load_le<uint32_t>(m_data + 116)
+                                          + binspec_attrib * i);
+    if (a.type != type || a.nvalues != 1)
+        return false;
+    if (type.basetype == TypeDesc::STRING) {
+        for (size_t k = 0; k < a.nstrings(); ++k)
+            ((ustring*)value)[k] = ustring(
+                load_string(m_data, m_data + a.offset + 8 * k));
+    } else {
+        memcpy(value, m_data + a.offset, a.size);
+        swap_values_le(value, type, 1);
+    }
+    return true;
+}
+
+
+
+int
+ImageSpecView::get_int_attribute(string_view name, int defaultval) const
+{
+    int i    = find_attrib(name);
+    double v = 0.0;
+    if (i >= 0
+        && load_scalar(m_data,
+                       load_attrib(m_data, load_le<uint32_t>(m_data + 116)
+                                               + binspec_attrib * i),
+                       v))
+        return int(v);
+    return defaultval;
+}
+
+
+
+float
+ImageSpecView::get_float_attribute(string_view name, float defaultval) const
+{
+    int i    = find_attrib(name);
+    double v = 0.0;
+    if (i >= 0
+        && load_scalar(m_data,
+                       load_attrib(m_data, load_le<uint32_t>(m_data + 116)
+                                               + binspec_attrib * i),
+                       v))
+        return float(v);
+    return defaultval;
+}
+
+
+
+string_view
+ImageSpecView::get_string_attribute(string_view name,
+                                    string_view defaultval) const
+{
+    int i = find_attrib(name);
+    if (i < 0)
+        return defaultval;
+    BinAttrib a = load_attrib(m_data, load_le<uint32_t>(m_data + 116)
+                                          + binspec_attrib * i);
+    if (a.type != TypeString || a.nvalues != 1)
+        return defaultval;
+    return load_string(m_data, m_data + a.offset);
+}
+
+
+
+ImageSpec
+ImageSpecView::spec() const
+{
+    ImageSpec spec;
+    if (!m_data)
+        return spec;
+    spec.x             = x();
+    spec.y             = y();
+    spec.z             = z();
+    spec.width         = width();
+    spec.height        = height();
+    spec.depth         = depth();
+    spec.full_x        = full_x();
+    spec.full_y        = full_y();
+    spec.full_z        = full_z();
+    spec.full_width    = full_width();
+    spec.full_height   = full_height();
+    spec.full_depth    = full_depth();
+    spec.tile_width    = tile_width();
+    spec.tile_height   = tile_height();
+    spec.tile_depth    = tile_depth();
+    spec.nchannels     = nchannels();
+    spec.alpha_channel = alpha_channel();
+    spec.z_channel     = z_channel();
+    spec.deep          = deep();
+    spec.format        = format();
+    spec.channelformats.resize(load_le<uint32_t>(m_data + 96));
+    for (size_t c = 0; c < spec.channelformats.size(); ++c)
+        spec.channelformats[c] = channelformat(int(c));
+    spec.channelnames.resize(load_le<uint32_t>(m_data + 104));
+    for (size_t c = 0; c < spec.channelnames.size(); ++c)
+        spec.channelnames[c] = channel_name(int(c));
+
+    const size_t table = load_le<uint32_t>(m_data + 116);
+    spec.extra_attribs.reserve(m_nattribs);
+    std::vector<ustring> strings;
+    std::vector<char> swapped;
+    for (int i = 0; i < m_nattribs; ++i) {
+        BinAttrib a   = load_attrib(m_data, table + binspec_attrib * i);
+        auto interp   = ParamValue::Interp(a.interp);
+        const void* v = m_data + a.offset;
+        if (a.type.basetype == TypeDesc::STRING) {
+            strings.resize(a.nstrings());
+            for (size_t k = 0; k < strings.size(); ++k)
+                strings[k] = ustring(
+                    load_string(m_data, m_data + a.offset + 8 * k));
+            v = strings.data();
+        } else if (bigendian()) {
+            swapped.assign(m_data + a.offset, m_data + a.offset + a.size);
+            swap_values_le(swapped.data(), a.type, size_t(a.nvalues));
+            v = swapped.data();
+        }
+        spec.extra_attribs.emplace_back(a.name, a.type, a.nvalues, interp, v);
+    }
+    return spec;
+}
+
+
+
+bool
+ImageSpec::from_binary(string_view data)
+{
+    ImageSpecView view(data);
+    if (!view.valid())
+        return false;
+    *this = view.spec();
+    return true;
+}
+
+
+
+
 std::pair<string_view, int>
 ImageSpec::decode_compression_metadata(string_view defaultcomp,
                                        int defaultqual) const
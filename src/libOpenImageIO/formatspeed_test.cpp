@@ -0,0 +1,392 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+// Read and write throughput of every format plugin, on synthetic images of
+// a matrix of sizes, data types, channel counts, compression methods, and
+// tiled or scanline layouts, with varying numbers of threads.
+//
+// Each measurement is also recorded as a Benchmarker result, so setting
+// OIIO_BENCHMARK_OUTPUT saves them all as JSON or CSV, and setting
+// OIIO_BENCHMARK_BASELINE compares them to an earlier run.
+
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+using namespace OIIO;
+
+static bool verbose = false;
+static int ntrials  = 3;
+static int tilesize = 64;
+static std::string formats_arg;
+static std::string res_arg      = "256,1024";
+static std::string types_arg    = "uint8,uint16,half,float";
+static std::string channels_arg = "1,3,4";
+static std::string content_arg  = "noise,gradient,flat";
+static std::string layout_arg   = "scanline,tiled";
+static std::string threads_arg;
+static std::string compression_arg;
+static bool all_compression = false;
+static std::string tempdir;
+
+
+
+// Compression methods worth comparing, for the formats that have them.
+// Unless --allcompression is used, only each format's default is tested.
+static const std::map<std::string, std::vector<std::string>>
+    compression_methods = {
+        { "openexr",
+          { "none", "rle", "zips", "zip", "piz", "pxr24", "b44", "dwaa" } },
+        { "tiff", { "none", "lzw", "zip", "packbits" } },
+        { "png", { "default", "filtered", "rle" } },
+        { "jpeg", { "jpeg:50", "jpeg:90", "jpeg:100" } },
+        { "webp", { "webp:50", "webp:90", "webp:100" } },
+        { "heif", { "heic:50", "heic:90" } },
+        { "targa", { "none", "rle" } },
+    };
+
+
+
+static void
+getargs(int argc, char* argv[])
+{
+    ArgParse ap;
+    // clang-format off
+    ap.intro("formatspeed_test -- read and write throughput of every format\n"
+             OIIO_INTRO_STRING)
+      .usage("formatspeed_test [options]");
+
+    ap.arg("-v", &verbose)
+      .help("Verbose mode");
+    ap.arg("--format %s:NAMES", &formats_arg)
+      .help("Formats to test, comma-separated (default: all that can both read and write)");
+    ap.arg("--res %s:LIST", &res_arg)
+      .help(Strutil::sprintf("Square image resolutions (default: %s)", res_arg));
+    ap.arg("--types %s:LIST", &types_arg)
+      .help(Strutil::sprintf("Data types (default: %s)", types_arg));
+    ap.arg("--channels %s:LIST", &channels_arg)
+      .help(Strutil::sprintf("Channel counts (default: %s)", channels_arg));
+    ap.arg("--content %s:LIST", &content_arg)
+      .help(Strutil::sprintf("Image content: noise, gradient, flat (default: %s)", content_arg));
+    ap.arg("--layout %s:LIST", &layout_arg)
+      .help(Strutil::sprintf("File layouts: scanline, tiled (default: %s)", layout_arg));
+    ap.arg("--tile %d:SIZE", &tilesize)
+      .help(Strutil::sprintf("Tile size of tiled files (default: %d)", tilesize));
+    ap.arg("--compression %s:LIST", &compression_arg)
+      .help("Compression methods to test (default: each format's default)");
+    ap.arg("--allcompression", &all_compression)
+      .help("Test all the usual compression methods of each format");
+    ap.arg("--threads %s:LIST", &threads_arg)
+      .help("Thread counts (default: 1 and all cores)");
+    ap.arg("--trials %d", &ntrials)
+      .help(Strutil::sprintf("Number of trials (default: %d)", ntrials));
+    ap.arg("--tempdir %s:DIR", &tempdir)
+      .help("Directory for files of formats that can't use memory buffers");
+    // clang-format on
+
+    ap.parse(argc, (const char**)argv);
+}
+
+
+
+// The formats to test, as pairs of format name and file extension.
+static std::vector<std::pair<std::string, std::string>>
+test_formats()
+{
+    std::vector<std::pair<std::string, std::string>> result;
+    auto requested = Strutil::splits(formats_arg, ",");
+    for (auto& e :
+         Strutil::splitsv(OIIO::get_string_attribute("extension_list"), ";")) {
+        auto fmtexts           = Strutil::splitsv(e, ":");
+        string_view formatname = fmtexts[0];
+        if (fmtexts.size() < 2 || formatname == "null"
+            || formatname == "socket" || formatname == "term")
+            continue;
+        if (requested.size()
+            && std::find(requested.begin(), requested.end(), formatname)
+                   == requested.end())
+            continue;
+        std::string ext = Strutil::splits(fmtexts[1], ",")[0];
+        auto out        = ImageOutput::create(ext);
+        auto in         = ImageInput::create(ext);
+        (void)OIIO::geterror();  // discard errors of missing plugins
+        if (out && in)
+            result.emplace_back(formatname, ext);
+    }
+    return result;
+}
+
+
+
+// Make a float image of the given content: "noise" is the worst case for
+// compression, "gradient" a smooth, typical one, and "flat" the best case.
+static ImageBuf
+make_content(string_view content, int res, int nchannels)
+{
+    ImageBuf buf(ImageSpec(res, res, nchannels, TypeFloat));
+    if (content == "noise") {
+        ImageBufAlgo::noise(buf, "uniform", 0.0f, 1.0f, false, 42);
+    } else if (content == "gradient") {
+        std::vector<float> tl(nchannels), tr(nchannels), bl(nchannels),
+            br(nchannels);
+        for (int c = 0; c < nchannels; ++c) {
+            tl[c] = 0.0f;
+            tr[c] = 1.0f - 0.25f * c;
+            bl[c] = 0.25f * c;
+            br[c] = 1.0f;
+        }
+        ImageBufAlgo::fill(buf, tl, tr, bl, br);
+    } else {
+        ImageBufAlgo::fill(buf, std::vector<float>(nchannels, 0.5f));
+    }
+    return buf;
+}
+
+
+
+// An encoded image, in memory if the format supports IOProxy, otherwise in
+// a temporary file.
+struct Encoded {
+    std::string filename;
+    std::unique_ptr<Filesystem::IOVecOutput> outproxy;
+    std::unique_ptr<Filesystem::IOMemReader> inproxy;
+    bool in_memory = false;
+
+    ~Encoded()
+    {
+        if (!in_memory && filename.size())
+            Filesystem::remove(filename);
+    }
+
+    Filesystem::IOProxy* write_proxy()
+    {
+        if (!in_memory)
+            return nullptr;
+        outproxy.reset(new Filesystem::IOVecOutput);
+        return outproxy.get();
+    }
+
+    Filesystem::IOProxy* read_proxy()
+    {
+        if (!in_memory)
+            return nullptr;
+        inproxy.reset(new Filesystem::IOMemReader(outproxy->buffer()));
+        return inproxy.get();
+    }
+
+    size_t size() const
+    {
+        return in_memory ? outproxy->buffer().size()
+                         : Filesystem::file_size(filename);
+    }
+};
+
+
+
+static bool
+encode(Encoded& enc, const ImageSpec& spec, const ImageBuf& native)
+{
+    auto out = ImageOutput::create(enc.filename, enc.write_proxy());
+    bool ok  = out && out->open(enc.filename, spec)
+              && out->write_image(native.spec().format, native.localpixels())
+              && out->close();
+    if (!ok && verbose)
+        std::cout << "    write error: "
+                  << (out ? out->geterror() : OIIO::geterror()) << "\n";
+    return ok;
+}
+
+
+
+static bool
+decode(Encoded& enc, std::vector<char>& pixels)
+{
+    auto in = ImageInput::open(enc.filename, nullptr, enc.read_proxy());
+    if (!in)
+        return false;
+    const ImageSpec& spec(in->spec());
+    pixels.resize(spec.image_bytes());
+    return in->read_image(0, 0, 0, spec.nchannels, spec.format, pixels.data())
+           && in->close();
+}
+
+
+
+// Open the file and read just the first scanline or tile, for the latency
+// until the first pixels are available.
+static bool
+first_pixels(Encoded& enc, std::vector<char>& pixels)
+{
+    auto in = ImageInput::open(enc.filename, nullptr, enc.read_proxy());
+    if (!in)
+        return false;
+    const ImageSpec& spec(in->spec());
+    if (spec.tile_width) {
+        pixels.resize(spec.tile_bytes());
+        return in->read_tile(spec.x, spec.y, spec.z, spec.format,
+                             pixels.data());
+    }
+    pixels.resize(spec.scanline_bytes());
+    return in->read_scanline(spec.y, spec.z, spec.format, pixels.data());
+}
+
+
+
+// One combination of image and file parameters to test.
+struct Config {
+    int res;
+    int nchannels;
+    TypeDesc type;
+    bool tiled;
+    std::string compression;  // empty for the format's default
+};
+
+
+
+// Are the image properties of the file `enc` just what `config` asked for?
+// Formats change what they can't store (like the data type or tiling), and
+// those combinations are skipped rather than measured as something else.
+static bool
+matches(Encoded& enc, const Config& config)
+{
+    auto in = ImageInput::open(enc.filename, nullptr, enc.read_proxy());
+    return in && in->spec().format == config.type
+           && in->spec().nchannels == config.nchannels
+           && (in->spec().tile_width != 0) == config.tiled;
+}
+
+
+
+static void
+test_config(const std::string& formatname, const std::string& ext,
+            const Config& config, const std::vector<int>& threadcounts)
+{
+    ImageSpec spec(config.res, config.res, config.nchannels, config.type);
+    if (config.tiled)
+        spec.tile_width = spec.tile_height = tilesize;
+    if (config.compression.size())
+        spec.attribute("compression", config.compression);
+
+    Benchmarker bench;
+    bench.iterations(1).trials(ntrials).verbose(0);
+    std::vector<char> pixels;
+    for (auto& content : Strutil::splitsv(content_arg, ",")) {
+        ImageBuf native = make_content(content, config.res, config.nchannels)
+                              .copy(config.type);
+        double mbytes   = double(native.spec().image_bytes()) / 1.0e6;
+
+        Encoded enc;
+        enc.in_memory = ImageOutput::create(ext)->supports("ioproxy");
+        if (enc.in_memory)
+            enc.filename = "formatspeed." + ext;
+        else
+            enc.filename = (tempdir.size() ? tempdir
+                                           : Filesystem::temp_directory_path())
+                           + "/" + Filesystem::unique_path() + "." + ext;
+        if (!encode(enc, spec, native) || !decode(enc, pixels))
+            return;
+        if (!matches(enc, config)) {
+            if (verbose)
+                std::cout << "  skipping " << config.type << " "
+                          << config.nchannels << "ch "
+                          << (config.tiled ? "tiled" : "scanline") << "\n";
+            return;
+        }
+        double ratio = double(native.spec().image_bytes())
+                       / std::max(enc.size(), size_t(1));
+
+        for (int nthreads : threadcounts) {
+            OIIO::attribute("threads", nthreads);
+            OIIO::attribute("exr_threads", nthreads);
+            std::string name = Strutil::fmt::format(
+                "{}/{}/{}/{}ch/{}/{}/{}/{}t", formatname,
+                config.compression.size() ? config.compression : "default",
+                config.type, config.nchannels, config.res,
+                config.tiled ? "tiled" : "scanline", content, nthreads);
+            bench(name + "/encode", [&]() { encode(enc, spec, native); });
+            double enc_time = bench.median();
+            bench(name + "/decode", [&]() { decode(enc, pixels); });
+            double dec_time = bench.median();
+            bench(name + "/first", [&]() { first_pixels(enc, pixels); });
+            double first_time = bench.median();
+            Strutil::print("  {:<56} enc {:7.1f} MB/s  dec {:7.1f} MB/s  "
+                           "first {:7.2f} ms  ratio {:5.2f}\n",
+                           name, mbytes / enc_time, mbytes / dec_time,
+                           first_time * 1.0e3, ratio);
+        }
+    }
+}
+
+
+
+static void
+test_format(const std::string& formatname, const std::string& ext)
+{
+    std::vector<std::string> compressions = Strutil::splits(compression_arg,
+                                                            ",");
+    if (compressions.empty()) {
+        auto found = compression_methods.find(formatname);
+        if (all_compression && found != compression_methods.end())
+            compressions = found->second;
+        else
+            compressions.emplace_back();  // The format's default
+    }
+    std::vector<int> threadcounts;
+    for (auto& t : Strutil::splitsv(threads_arg, ","))
+        threadcounts.push_back(Strutil::from_string<int>(t));
+    if (threadcounts.empty()) {
+        threadcounts.push_back(1);
+        if (Sysutil::hardware_concurrency() > 1)
+            threadcounts.push_back(Sysutil::hardware_concurrency());
+    }
+
+    std::vector<Config> configs;
+    for (auto& res : Strutil::splitsv(res_arg, ","))
+        for (auto& type : Strutil::splitsv(types_arg, ","))
+            for (auto& nc : Strutil::splitsv(channels_arg, ","))
+                for (auto& layout : Strutil::splitsv(layout_arg, ","))
+                    for (auto& compression : compressions)
+                        configs.push_back({ Strutil::from_string<int>(res),
+                                            Strutil::from_string<int>(nc),
+                                            TypeDesc(type), layout == "tiled",
+                                            compression });
+    for (auto& config : configs)
+        test_config(formatname, ext, config, threadcounts);
+}
+
+
+
+int
+main(int argc, char** argv)
+{
+    getargs(argc, argv);
+
+    int nthreads = OIIO::get_int_attribute("threads");
+    auto formats = test_formats();
+    if (formats.empty()) {
+        std::cout << "Error: no formats to test.\n";
+        return -1;
+    }
+    for (auto& f : formats) {
+        std::cout << f.first << ":\n";
+        test_format(f.first, f.second);
+    }
+    OIIO::attribute("threads", nthreads);
+    if (verbose)
+        std::cout << "\n" << OIIO::geterror() << "\n";
+    return unit_test_failures;
+}
@@ -0,0 +1,629 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/thread.h>
+
+#include "imageio_pvt.h"
+
+#ifdef USE_CURL
+#    include <curl/curl.h>
+#endif
+
+
+OIIO_NAMESPACE_BEGIN
+using namespace pvt;
+
+
+
+bool
+pvt::is_remote_url(string_view filename)
+{
+    return Strutil::istarts_with(filename, "http://")
+           || Strutil::istarts_with(filename, "https://")
+           || Strutil::istarts_with(filename, "s3://");
+}
+
+
+
+Filesystem::IOProxy*
+pvt::create_read_ioproxy(string_view filename)
+{
+    if (is_remote_url(filename))
+        return new IOHttp(filename);
+    return new Filesystem::IOFile(filename, Filesystem::IOProxy::Read);
+}
+
+
+
+#ifdef USE_CURL
+
+namespace {
+
+// One cached block of the remote file.
+struct HttpBlock {
+    enum State { Pending, Ready, Failed };
+    State state = Pending;
+    std::vector<unsigned char> data;
+    uint64_t lastuse = 0;
+};
+using HttpBlockRef = std::shared_ptr<HttpBlock>;
+
+// A run of consecutive blocks [first, first+count) fetched by one GET.
+struct HttpRun {
+    int64_t first;
+    int64_t count;
+};
+
+// The block cache only has to absorb header parsing and the read-ahead
+// window -- ImageCache keeps the decoded tiles -- so it's kept modest.
+const size_t http_min_cache_blocks = 64;
+
+
+// Destination of a transfer's body. We refuse to grow past `limit`, which
+// aborts the transfer if a server ignores our Range header and starts
+// sending the whole file.
+struct HttpSink {
+    std::vector<unsigned char>* data;
+    size_t limit;
+};
+
+
+size_t
+http_write_cb(char* ptr, size_t size, size_t nmemb, void* userdata)
+{
+    HttpSink* sink = (HttpSink*)userdata;
+    size_t n       = size * nmemb;
+    if (sink->data->size() + n > sink->limit)
+        return 0;
+    sink->data->insert(sink->data->end(), (unsigned char*)ptr,
+                       (unsigned char*)ptr + n);
+    return n;
+}
+
+
+// Pick the total length out of a "Content-Range: bytes 0-0/12345" header.
+size_t
+http_header_cb(char* buffer, size_t size, size_t nitems, void* userdata)
+{
+    size_t n = size * nitems;
+    string_view line(buffer, n);
+    if (Strutil::istarts_with(line, "content-range:")) {
+        size_t slash = line.rfind('/');
+        if (slash != string_view::npos) {
+            string_view total = Strutil::strip(line.substr(slash + 1));
+            if (total.size() && total != "*")
+                *(int64_t*)userdata = Strutil::from_string<int64_t>(total);
+        }
+    }
+    return n;
+}
+
+
+void
+http_global_init()
+{
+    static std::once_flag once;
+    std::call_once(once, []() { curl_global_init(CURL_GLOBAL_DEFAULT); });
+}
+
+
+// Percent-encode an S3 key, leaving the '/' separators alone.
+std::string
+s3_escape_key(string_view key)
+{
+    std::string r;
+    for (char c : key) {
+        if (isalnum((unsigned char)c) || strchr("-_.~/", c))
+            r += c;
+        else
+            r += Strutil::fmt::format("%{:02X}", (unsigned char)c);
+    }
+    return r;
+}
+
+}  // namespace
+
+
+
+struct IOHttp::Impl {
+    std::string url;     // http(s) URL actually requested
+    std::string sigv4;   // CURLOPT_AWS_SIGV4 provider, if signing
+    std::string userpwd; // S3 "key:secret", if signing
+    curl_slist* headers = nullptr;
+    int64_t size        = 0;
+    int64_t blocksize   = 1 << 20;
+    int readahead       = 4;
+    size_t maxblocks    = http_min_cache_blocks;
+    // If the server doesn't honor range requests, the probe brought back
+    // the whole file, and we just serve it from here.
+    bool whole = false;
+    std::vector<unsigned char> wholefile;
+
+    std::mutex mutex;  // Guards everything below
+    std::condition_variable cv;
+    std::unordered_map<int64_t, HttpBlockRef> blocks;
+    uint64_t clock          = 0;
+    int64_t next_sequential = -1;  // Offset just past the last read
+    int readahead_in_flight = 0;
+    std::vector<CURL*> idle_handles;
+
+    ~Impl()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        cv.wait(lock, [&]() { return readahead_in_flight == 0; });
+        for (auto h : idle_handles)
+            curl_easy_cleanup(h);
+        idle_handles.clear();
+        if (headers)
+            curl_slist_free_all(headers);
+    }
+
+    int64_t nblocks() const { return (size + blocksize - 1) / blocksize; }
+
+    // Easy handles can't be shared between threads, but reusing them keeps
+    // their connections alive, so we keep a stash of idle ones.
+    CURL* get_handle()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            if (idle_handles.size()) {
+                CURL* h = idle_handles.back();
+                idle_handles.pop_back();
+                return h;
+            }
+        }
+        CURL* h = curl_easy_init();
+        if (!h)
+            return nullptr;
+        curl_easy_setopt(h, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(h, CURLOPT_FOLLOWLOCATION, 1L);
+        curl_easy_setopt(h, CURLOPT_NOSIGNAL, 1L);
+        curl_easy_setopt(h, CURLOPT_WRITEFUNCTION, http_write_cb);
+        curl_easy_setopt(h, CURLOPT_HEADERFUNCTION, http_header_cb);
+        if (headers)
+            curl_easy_setopt(h, CURLOPT_HTTPHEADER, headers);
+#    if LIBCURL_VERSION_NUM >= 0x074b00 /* 7.75 */
+        if (sigv4.size()) {
+            curl_easy_setopt(h, CURLOPT_AWS_SIGV4, sigv4.c_str());
+            curl_easy_setopt(h, CURLOPT_USERPWD, userpwd.c_str());
+        }
+#    endif
+        return h;
+    }
+
+    void put_handle(CURL* h)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle_handles.push_back(h);
+    }
+
+    // GET bytes [begin,end] (inclusive, as HTTP ranges are). Return the
+    // HTTP status, or 0 with `err` set if the transfer itself failed.
+    long transfer(int64_t begin, int64_t end, std::vector<unsigned char>& data,
+                  size_t limit, int64_t* total, std::string& err)
+    {
+        CURL* h = get_handle();
+        if (!h) {
+            err = "could not create an HTTP session";
+            return 0;
+        }
+        int64_t dummytotal = -1;
+        HttpSink sink { &data, limit };
+        char errbuf[CURL_ERROR_SIZE] = "";
+        std::string range = Strutil::fmt::format("{}-{}", begin, end);
+        curl_easy_setopt(h, CURLOPT_RANGE, range.c_str());
+        curl_easy_setopt(h, CURLOPT_WRITEDATA, &sink);
+        curl_easy_setopt(h, CURLOPT_HEADERDATA, total ? total : &dummytotal);
+        curl_easy_setopt(h, CURLOPT_ERRORBUFFER, errbuf);
+        CURLcode rc = curl_easy_perform(h);
+        long code   = 0;
+        if (rc == CURLE_OK)
+            curl_easy_getinfo(h, CURLINFO_RESPONSE_CODE, &code);
+        else
+            err = errbuf[0] ? errbuf : curl_easy_strerror(rc);
+        curl_easy_setopt(h, CURLOPT_ERRORBUFFER, nullptr);
+        put_handle(h);
+        return code;
+    }
+
+    // Under the lock: collect references to blocks [b0,b1], adding
+    // pending entries for any that aren't cached yet and appending those
+    // to `runs` for the caller to fetch.
+    void require(int64_t b0, int64_t b1, std::vector<HttpBlockRef>& refs,
+                 std::vector<HttpRun>& runs)
+    {
+        for (int64_t b = b0; b <= b1; ++b) {
+            HttpBlockRef& blk(blocks[b]);
+            if (!blk) {
+                blk.reset(new HttpBlock);
+                if (runs.size() && runs.back().first + runs.back().count == b)
+                    ++runs.back().count;
+                else
+                    runs.push_back({ b, 1 });
+            }
+            blk->lastuse = ++clock;
+            refs.push_back(blk);
+        }
+        evict(b0, b1);
+    }
+
+    // Under the lock: drop least recently used finished blocks outside
+    // [keep0,keep1] until we're back under maxblocks.
+    void evict(int64_t keep0, int64_t keep1)
+    {
+        while (blocks.size() > maxblocks) {
+            auto victim = blocks.end();
+            for (auto it = blocks.begin(); it != blocks.end(); ++it) {
+                if (it->second->state == HttpBlock::Pending
+                    || (it->first >= keep0 && it->first <= keep1))
+                    continue;
+                if (victim == blocks.end()
+                    || it->second->lastuse < victim->second->lastuse)
+                    victim = it;
+            }
+            if (victim == blocks.end())
+                break;
+            blocks.erase(victim);
+        }
+    }
+
+    // Fetch one run of blocks with a single ranged GET and publish them.
+    void fetch(const HttpRun& run, Filesystem::IOProxy* proxy)
+    {
+        int64_t begin = run.first * blocksize;
+        int64_t end   = std::min((run.first + run.count) * blocksize, size);
+        std::vector<unsigned char> data;
+        data.reserve(size_t(end - begin));
+        std::string err;
+        long code = transfer(begin, end - 1, data, size_t(end - begin),
+                             nullptr, err);
+        // A server may answer a range covering the whole file with a plain
+        // 200, which is just as good.
+        bool ok = (code == 206 || (code == 200 && begin == 0))
+                  && data.size() == size_t(end - begin);
+        if (!ok && err.empty())
+            err = code ? Strutil::fmt::format("HTTP status {}", code)
+                       : std::string("short read");
+        std::lock_guard<std::mutex> lock(mutex);
+        for (int64_t i = 0; i < run.count; ++i) {
+            auto found = blocks.find(run.first + i);
+            if (found == blocks.end())
+                continue;
+            HttpBlock& blk(*found->second);
+            if (ok) {
+                size_t b = size_t(i * blocksize);
+                size_t e = std::min(b + size_t(blocksize), data.size());
+                blk.data.assign(data.begin() + b, data.begin() + e);
+                blk.state = HttpBlock::Ready;
+            } else {
+                // Waiters still hold it; removing it lets a later read try
+                // again.
+                blk.state = HttpBlock::Failed;
+                blocks.erase(found);
+            }
+        }
+        if (!ok)
+            proxy->error(Strutil::fmt::format("Error reading \"{}\": {}", url,
+                                              err));
+        cv.notify_all();
+    }
+
+    // Fetch several runs, in parallel if there is more than one.
+    void fetch(const std::vector<HttpRun>& runs, Filesystem::IOProxy* proxy)
+    {
+        if (runs.size() == 1) {
+            fetch(runs[0], proxy);
+            return;
+        }
+        thread_pool* pool = io_thread_pool();
+        task_set tasks(pool);
+        for (auto& run : runs)
+            tasks.push(pool->push([&, run](int /*id*/) { fetch(run, proxy); }));
+        tasks.wait();
+    }
+
+    // Start fetching up to `readahead` blocks past b, without waiting.
+    void start_readahead(int64_t b, Filesystem::IOProxy* proxy)
+    {
+        std::vector<HttpRun> runs;
+        std::vector<HttpBlockRef> refs;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            int64_t last = std::min(b + readahead, nblocks() - 1);
+            if (last <= b)
+                return;
+            require(b + 1, last, refs, runs);
+            readahead_in_flight += int(runs.size());
+        }
+        thread_pool* pool = io_thread_pool();
+        for (auto& run : runs)
+            pool->push([this, run, proxy](int /*id*/) {
+                fetch(run, proxy);
+                std::lock_guard<std::mutex> lock(mutex);
+                --readahead_in_flight;
+                cv.notify_all();
+            });
+    }
+
+    // Copy [offset,offset+size) out of blocks refs (which start at block
+    // b0), after waiting for any still pending. Return the bytes copied,
+    // which stops short at the first failed block.
+    size_t copy_out(const std::vector<HttpBlockRef>& refs, int64_t b0,
+                    void* buf, size_t size, int64_t offset)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cv.wait(lock, [&]() {
+                for (auto& r : refs)
+                    if (r->state == HttpBlock::Pending)
+                        return false;
+                return true;
+            });
+        }
+        size_t done = 0;
+        while (done < size) {
+            int64_t pos    = offset + int64_t(done);
+            int64_t b      = pos / blocksize;
+            const auto& bk = refs[size_t(b - b0)];
+            size_t boff    = size_t(pos - b * blocksize);
+            if (bk->state != HttpBlock::Ready || boff >= bk->data.size())
+                break;
+            size_t n = std::min(size - done, bk->data.size() - boff);
+            memcpy((char*)buf + done, bk->data.data() + boff, n);
+            done += n;
+        }
+        return done;
+    }
+};
+
+
+
+IOHttp::IOHttp(string_view url)
+    : IOProxy(url, Closed)
+    , m_impl(new Impl)
+{
+    http_global_init();
+    Impl& impl(*m_impl);
+    impl.url       = url;
+    impl.blocksize = std::max(oiio_http_blocksize, 4096);
+    impl.readahead = std::max(oiio_http_readahead, 0);
+    impl.maxblocks = std::max(http_min_cache_blocks,
+                              size_t(2 * (impl.readahead + 1)));
+
+    if (Strutil::istarts_with(url, "s3://")) {
+        string_view rest   = url.substr(5);
+        size_t slash       = rest.find('/');
+        string_view bucket = rest.substr(0, slash);
+        string_view key    = slash == string_view::npos
+                                 ? string_view()
+                                 : rest.substr(slash + 1);
+        std::string region = Sysutil::getenv("AWS_REGION");
+        if (region.empty())
+            region = Sysutil::getenv("AWS_DEFAULT_REGION", "us-east-1");
+        string_view endpoint = Sysutil::getenv("AWS_ENDPOINT_URL");
+        if (endpoint.size())
+            impl.url = Strutil::fmt::format("{}/{}/{}",
+                                            Strutil::rstrip(endpoint, "/"),
+                                            bucket, s3_escape_key(key));
+        else
+            impl.url = Strutil::fmt::format("https://{}.s3.{}.amazonaws.com/{}",
+                                            bucket, region,
+                                            s3_escape_key(key));
+        string_view keyid  = Sysutil::getenv("AWS_ACCESS_KEY_ID");
+        string_view secret = Sysutil::getenv("AWS_SECRET_ACCESS_KEY");
+        if (keyid.size() && secret.size()) {
+#    if LIBCURL_VERSION_NUM >= 0x074b00 /* 7.75 */
+            impl.sigv4   = Strutil::fmt::format("aws:amz:{}:s3", region);
+            impl.userpwd = Strutil::fmt::format("{}:{}", keyid, secret);
+            string_view token = Sysutil::getenv("AWS_SESSION_TOKEN");
+            if (token.size())
+                impl.headers = curl_slist_append(
+                    nullptr, Strutil::fmt::format("x-amz-security-token: {}",
+                                                  token)
+                                 .c_str());
+#    else
+            error("Signed S3 requests need libcurl 7.75 or newer");
+            return;
+#    endif
+        }
+    }
+
+    // Probe with a one-byte range request, which tells us both the length
+    // of the file (via Content-Range) and whether ranges are honored. A
+    // HEAD would not do: presigned URLs are usually only valid for GET.
+    std::vector<unsigned char> data;
+    std::string err;
+    int64_t total = -1;
+    long code     = impl.transfer(0, 0, data, std::numeric_limits<size_t>::max(),
+                                  &total, err);
+    if (code == 206 && total >= 0) {
+        impl.size = total;
+    } else if (code == 200) {
+        impl.whole = true;
+        impl.wholefile.swap(data);
+        impl.size = int64_t(impl.wholefile.size());
+    } else {
+        if (err.empty())
+            err = Strutil::fmt::format("HTTP status {}", code);
+        error(Strutil::fmt::format("Could not open \"{}\": {}", impl.url,
+                                   err));
+        return;
+    }
+    m_mode = Read;
+}
+
+
+
+IOHttp::~IOHttp() {}
+
+
+
+void
+IOHttp::close()
+{
+    m_impl.reset(new Impl);
+    m_mode = Closed;
+}
+
+
+
+size_t
+IOHttp::size() const
+{
+    return size_t(m_impl->size);
+}
+
+
+
+size_t
+IOHttp::read(void* buf, size_t size)
+{
+    size_t r = pread(buf, size, m_pos);
+    m_pos += int64_t(r);
+    return r;
+}
+
+
+
+size_t
+IOHttp::pread(void* buf, size_t size, int64_t offset)
+{
+    Impl& impl(*m_impl);
+    if (m_mode != Read || offset < 0 || offset >= impl.size || !size)
+        return 0;
+    size = std::min(size, size_t(impl.size - offset));
+    if (impl.whole) {
+        memcpy(buf, impl.wholefile.data() + offset, size);
+        return size;
+    }
+    int64_t b0 = offset / impl.blocksize;
+    int64_t b1 = (offset + int64_t(size) - 1) / impl.blocksize;
+    std::vector<HttpBlockRef> refs;
+    std::vector<HttpRun> runs;
+    bool sequential;
+    {
+        std::lock_guard<std::mutex> lock(impl.mutex);
+        impl.require(b0, b1, refs, runs);
+        sequential           = (offset == impl.next_sequential);
+        impl.next_sequential = offset + int64_t(size);
+    }
+    if (runs.size())
+        impl.fetch(runs, this);
+    // Only read ahead on sequential access; tiled readers jump around and
+    // would just waste the bandwidth.
+    if (sequential && impl.readahead)
+        impl.start_readahead(b1, this);
+    return impl.copy_out(refs, b0, buf, size, offset);
+}
+
+
+
+bool
+IOHttp::pread_batch(span<ReadRequest> requests)
+{
+    Impl& impl(*m_impl);
+    if (m_mode != Read)
+        return false;
+    if (impl.whole || requests.size() < 2)
+        return IOProxy::pread_batch(requests);
+
+    // Gather every block the batch touches, so that each missing run is
+    // fetched just once and the runs are fetched in parallel.
+    std::vector<HttpRun> runs;
+    std::vector<std::vector<HttpBlockRef>> refs(requests.size());
+    {
+        std::lock_guard<std::mutex> lock(impl.mutex);
+        for (size_t i = 0; i < requests.size(); ++i) {
+            const ReadRequest& r(requests[i]);
+            if (r.offset < 0 || r.offset >= impl.size || !r.size)
+                continue;
+            size_t n   = std::min(r.size, size_t(impl.size - r.offset));
+            int64_t b0 = r.offset / impl.blocksize;
+            int64_t b1 = (r.offset + int64_t(n) - 1) / impl.blocksize;
+            impl.require(b0, b1, refs[i], runs);
+        }
+    }
+    std::sort(runs.begin(), runs.end(), [](const HttpRun& a, const HttpRun& b) {
+        return a.first < b.first;
+    });
+    if (runs.size())
+        impl.fetch(runs, this);
+
+    bool ok = true;
+    for (size_t i = 0; i < requests.size(); ++i) {
+        ReadRequest& r(requests[i]);
+        r.result = 0;
+        if (refs[i].size()) {
+            size_t n = std::min(r.size, size_t(impl.size - r.offset));
+            r.result = impl.copy_out(refs[i], r.offset / impl.blocksize, r.buf,
+                                     n, r.offset);
+        }
+        ok &= (r.result == r.size);
+    }
+    return ok;
+}
+
+
+
+#else /* !defined(USE_CURL) */
+
+struct IOHttp::Impl {};
+
+IOHttp::IOHttp(string_view url)
+    : IOProxy(url, Closed)
+{
+    error(Strutil::fmt::format(
+        "Could not open \"{}\": OpenImageIO was built without libcurl, so "
+        "remote URLs can't be read",
+        url));
+}
+
+IOHttp::~IOHttp() {}
+
+void
+IOHttp::close()
+{
+    m_mode = Closed;
+}
+
+size_t
+IOHttp::read(void* /*buf*/, size_t /*size*/)
+{
+    return 0;
+}
+
+size_t
+IOHttp::pread(void* /*buf*/, size_t /*size*/, int64_t /*offset*/)
+{
+    return 0;
+}
+
+bool
+IOHttp::pread_batch(span<ReadRequest> /*requests*/)
+{
+    return false;
+}
+
+size_t
+IOHttp::size() const
+{
+    return 0;
+}
+
+#endif
+
+OIIO_NAMESPACE_END
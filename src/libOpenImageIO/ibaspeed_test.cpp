@@ -0,0 +1,375 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+// Speed of the ImageBufAlgo operators -- point-wise, geometric, filters,
+// color, comparison, and deep -- on synthetic images of a matrix of pixel
+// types, channel counts, and sizes, each with a range of thread counts so
+// that the scaling of every operator can be seen.
+//
+// Each measurement is also recorded as a Benchmarker result, so "-o" (or
+// OIIO_BENCHMARK_OUTPUT) saves them all as JSON or CSV, and setting
+// OIIO_BENCHMARK_BASELINE compares them to an earlier run.
+
+
+#include <OpenImageIO/Imath.h>
+
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/unittest.h>
+
+#include <algorithm>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace OIIO;
+
+static bool verbose = false;
+static int ntrials  = 5;
+static std::string ops_arg;
+static std::string res_arg      = "256,2048";
+static std::string types_arg    = "uint8,half,float";
+static std::string channels_arg = "1,3,4";
+static std::string threads_arg;
+static std::string output_filename;
+
+
+
+static void
+getargs(int argc, char* argv[])
+{
+    ArgParse ap;
+    // clang-format off
+    ap.intro("ibaspeed_test -- speed and thread scaling of ImageBufAlgo operators\n"
+             OIIO_INTRO_STRING)
+      .usage("ibaspeed_test [options]");
+
+    ap.arg("-v", &verbose)
+      .help("Verbose mode");
+    ap.arg("--ops %s:LIST", &ops_arg)
+      .help("Operators or categories (pointwise, geometric, filter, color, compare, deep) to test, comma-separated (default: all)");
+    ap.arg("--res %s:LIST", &res_arg)
+      .help(Strutil::sprintf("Square image resolutions (default: %s)", res_arg));
+    ap.arg("--types %s:LIST", &types_arg)
+      .help(Strutil::sprintf("Pixel data types (default: %s)", types_arg));
+    ap.arg("--channels %s:LIST", &channels_arg)
+      .help(Strutil::sprintf("Channel counts (default: %s)", channels_arg));
+    ap.arg("--threads %s:LIST", &threads_arg)
+      .help("Thread counts (default: powers of 2 up to all cores)");
+    ap.arg("--trials %d", &ntrials)
+      .help(Strutil::sprintf("Number of trials (default: %d)", ntrials));
+    ap.arg("-o %s:FILENAME", &output_filename)
+      .help("Save the results to this file (CSV if it ends in \".csv\", otherwise JSON)");
+    // clang-format on
+
+    ap.parse(argc, (const char**)argv);
+}
+
+
+
+// The images that the operators work on, all of the same size, type, and
+// number of channels. With 4 channels, the last is alpha.
+struct Inputs {
+    ImageBuf A, B, C;
+    ImageBuf kernel;
+    ImageBuf deepA, deepB;
+};
+
+
+
+static Inputs
+make_inputs(int res, int nchannels, TypeDesc type)
+{
+    ImageSpec spec(res, res, nchannels, TypeFloat);
+    if (nchannels == 4)
+        spec.alpha_channel = 3;
+    ImageBuf A(spec), B(spec), C(spec);
+    ImageBufAlgo::noise(A, "uniform", 0.0f, 1.0f, false, 1);
+    ImageBufAlgo::noise(B, "uniform", 0.0f, 1.0f, false, 2);
+    ImageBufAlgo::noise(C, "uniform", 0.0f, 1.0f, false, 3);
+
+    Inputs in;
+    in.A      = A.copy(type);
+    in.B      = B.copy(type);
+    in.C      = C.copy(type);
+    in.kernel = ImageBufAlgo::make_kernel("gaussian", 5.0f, 5.0f);
+    in.deepA  = ImageBufAlgo::deepen(in.A, 1.0f);
+    in.deepB  = ImageBufAlgo::deepen(in.B, 2.0f);
+    return in;
+}
+
+
+
+// One operator to time: it runs the operation on the inputs with the given
+// number of threads, and returns false if the operation failed (or does
+// not apply to these inputs).
+struct Op {
+    const char* category;
+    const char* name;
+    std::function<bool(const Inputs&, int)> run;
+};
+
+
+
+// Make the run function of an operator that returns an image, which fails
+// if the image doesn't come back (for example, when it is empty because
+// the operator doesn't apply to the inputs).
+template<typename FUNC>
+static std::function<bool(const Inputs&, int)>
+image_op(FUNC func)
+{
+    return [=](const Inputs& in, int nt) {
+        ImageBuf R = func(in, nt);
+        return R.initialized() && !R.has_error();
+    };
+}
+
+
+
+static std::vector<Op>
+all_ops()
+{
+    using namespace ImageBufAlgo;
+    return {
+        // Point-wise
+        { "pointwise", "add", image_op([](const Inputs& in, int nt) {
+              return add(in.A, in.B, {}, nt);
+          }) },
+        { "pointwise", "sub", image_op([](const Inputs& in, int nt) {
+              return sub(in.A, in.B, {}, nt);
+          }) },
+        { "pointwise", "mul", image_op([](const Inputs& in, int nt) {
+              return mul(in.A, 0.5f, {}, nt);
+          }) },
+        { "pointwise", "mad", image_op([](const Inputs& in, int nt) {
+              return mad(in.A, in.B, in.C, {}, nt);
+          }) },
+        { "pointwise", "abs", image_op([](const Inputs& in, int nt) {
+              return abs(in.A, {}, nt);
+          }) },
+        { "pointwise", "pow", image_op([](const Inputs& in, int nt) {
+              return pow(in.A, 2.2f, {}, nt);
+          }) },
+        { "pointwise", "clamp", image_op([](const Inputs& in, int nt) {
+              return clamp(in.A, 0.25f, 0.75f, false, {}, nt);
+          }) },
+        { "pointwise", "channel_sum", image_op([](const Inputs& in, int nt) {
+              return channel_sum(in.A, 1.0f, {}, nt);
+          }) },
+        { "pointwise", "copy_float", image_op([](const Inputs& in, int nt) {
+              return copy(in.A, TypeFloat, {}, nt);
+          }) },
+        { "pointwise", "premult", image_op([](const Inputs& in, int nt) {
+              if (in.A.spec().alpha_channel < 0)
+                  return ImageBuf();
+              return premult(in.A, {}, nt);
+          }) },
+        { "pointwise", "over", image_op([](const Inputs& in, int nt) {
+              if (in.A.spec().alpha_channel < 0)
+                  return ImageBuf();
+              return over(in.A, in.B, {}, nt);
+          }) },
+
+        // Geometric
+        { "geometric", "flip", image_op([](const Inputs& in, int nt) {
+              return flip(in.A, {}, nt);
+          }) },
+        { "geometric", "transpose", image_op([](const Inputs& in, int nt) {
+              return transpose(in.A, {}, nt);
+          }) },
+        { "geometric", "resize_half", image_op([](const Inputs& in, int nt) {
+              ROI roi = in.A.roi();
+              roi.xend /= 2;
+              roi.yend /= 2;
+              return resize(in.A, "", 0.0f, roi, nt);
+          }) },
+        { "geometric", "resample_half", image_op([](const Inputs& in, int nt) {
+              ROI roi = in.A.roi();
+              roi.xend /= 2;
+              roi.yend /= 2;
+              return resample(in.A, true, roi, nt);
+          }) },
+        { "geometric", "rotate", image_op([](const Inputs& in, int nt) {
+              return rotate(in.A, 0.5f, string_view(), 0.0f, false, {}, nt);
+          }) },
+        { "geometric", "warp", image_op([](const Inputs& in, int nt) {
+              Imath::M33f M;
+              M.scale(Imath::V2f(0.7f, 1.3f));
+              M.rotate(0.3f);
+              return warp(in.A, M, string_view(), 0.0f, false,
+                          ImageBuf::WrapDefault, {}, nt);
+          }) },
+
+        // Filters
+        { "filter", "convolve_5x5", image_op([](const Inputs& in, int nt) {
+              return convolve(in.A, in.kernel, true, {}, nt);
+          }) },
+        { "filter", "median_3x3", image_op([](const Inputs& in, int nt) {
+              return median_filter(in.A, 3, 3, {}, nt);
+          }) },
+        { "filter", "unsharp_mask", image_op([](const Inputs& in, int nt) {
+              return unsharp_mask(in.A, "gaussian", 3.0f, 1.0f, 0.0f, {}, nt);
+          }) },
+        { "filter", "dilate_3x3", image_op([](const Inputs& in, int nt) {
+              return dilate(in.A, 3, 3, {}, nt);
+          }) },
+
+        // Color
+        { "color", "colorconvert", image_op([](const Inputs& in, int nt) {
+              return colorconvert(in.A, "sRGB", "linear", true, "", "",
+                                  nullptr, {}, nt);
+          }) },
+        { "color", "colormatrixtransform",
+          image_op([](const Inputs& in, int nt) {
+              Imath::M44f M(0.8f, 0.1f, 0.1f, 0.0f, 0.1f, 0.8f, 0.1f, 0.0f,
+                            0.1f, 0.1f, 0.8f, 0.0f, 0.0f, 0.0f, 0.0f, 1.0f);
+              return colormatrixtransform(in.A, M, true, {}, nt);
+          }) },
+        { "color", "rangecompress", image_op([](const Inputs& in, int nt) {
+              return rangecompress(in.A, false, {}, nt);
+          }) },
+
+        // Comparisons and statistics
+        { "compare", "compare",
+          [](const Inputs& in, int nt) {
+              return !compare(in.A, in.B, 1.0e-3f, 1.0e-4f, {}, nt).error;
+          } },
+        { "compare", "computePixelStats",
+          [](const Inputs& in, int nt) {
+              PixelStats stats = computePixelStats(in.A, {}, nt);
+              return !stats.min.empty();
+          } },
+        { "compare", "isConstantColor",
+          [](const Inputs& in, int nt) {
+              isConstantColor(in.A, 0.0f, {}, {}, nt);
+              return true;
+          } },
+        { "compare", "nonzero_region",
+          [](const Inputs& in, int nt) {
+              return nonzero_region(in.A, {}, nt).defined();
+          } },
+
+        // Deep
+        { "deep", "deepen", image_op([](const Inputs& in, int nt) {
+              return deepen(in.A, 1.0f, {}, nt);
+          }) },
+        { "deep", "flatten", image_op([](const Inputs& in, int nt) {
+              return flatten(in.deepA, {}, nt);
+          }) },
+        { "deep", "deep_merge", image_op([](const Inputs& in, int nt) {
+              return deep_merge(in.deepA, in.deepB, true, {}, nt);
+          }) },
+        { "deep", "deep_holdout", image_op([](const Inputs& in, int nt) {
+              return deep_holdout(in.deepA, in.deepB, {}, nt);
+          }) },
+    };
+}
+
+
+
+// The operators selected by --ops, by name or category.
+static std::vector<Op>
+test_ops()
+{
+    auto requested = Strutil::splits(ops_arg, ",");
+    std::vector<Op> ops;
+    for (auto& op : all_ops())
+        if (requested.empty()
+            || std::find(requested.begin(), requested.end(), op.name)
+                   != requested.end()
+            || std::find(requested.begin(), requested.end(), op.category)
+                   != requested.end())
+            ops.push_back(op);
+    return ops;
+}
+
+
+
+static std::vector<int>
+test_threadcounts()
+{
+    std::vector<int> threadcounts;
+    for (auto& t : Strutil::splitsv(threads_arg, ","))
+        threadcounts.push_back(Strutil::from_string<int>(t));
+    if (threadcounts.empty()) {
+        int hw = std::max(1, int(Sysutil::hardware_concurrency()));
+        for (int t = 1; t < hw; t *= 2)
+            threadcounts.push_back(t);
+        threadcounts.push_back(hw);
+    }
+    return threadcounts;
+}
+
+
+
+// Time every operator on one combination of image parameters, with each
+// of the thread counts, printing the rate and the speedup relative to the
+// first thread count.
+static void
+test_config(const std::vector<Op>& ops, int res, int nchannels,
+            TypeDesc type, const std::vector<int>& threadcounts)
+{
+    Inputs in      = make_inputs(res, nchannels, type);
+    double mpixels = double(res) * res / 1.0e6;
+    Benchmarker bench;
+    bench.iterations(1).trials(ntrials).verbose(0);
+    for (auto& op : ops) {
+        if (!op.run(in, threadcounts[0])) {
+            if (verbose)
+                std::cout << "  skipping " << op.name << " for " << type
+                          << " " << nchannels << "ch\n";
+            continue;
+        }
+        std::string config = Strutil::fmt::format("{}/{}/{}ch/{}", op.name,
+                                                  type, nchannels, res);
+        double first_time  = 0.0;
+        for (int nthreads : threadcounts) {
+            bench(Strutil::fmt::format("{}/{}/{}t", op.category, config,
+                                       nthreads),
+                  [&]() { op.run(in, nthreads); });
+            double t = bench.median();
+            if (nthreads == threadcounts[0])
+                first_time = t;
+            Strutil::print("  {:<44} {:4}t {:9.2f} ms {:9.1f} Mpix/s "
+                           "{:6.2f}x\n",
+                           config, nthreads, t * 1.0e3, mpixels / t,
+                           first_time / t);
+        }
+    }
+}
+
+
+
+int
+main(int argc, char** argv)
+{
+    getargs(argc, argv);
+
+    auto ops = test_ops();
+    if (ops.empty()) {
+        std::cout << "Error: no operators to test.\n";
+        return -1;
+    }
+    auto threadcounts = test_threadcounts();
+    for (auto& res : Strutil::splitsv(res_arg, ","))
+        for (auto& type : Strutil::splitsv(types_arg, ","))
+            for (auto& nc : Strutil::splitsv(channels_arg, ","))
+                test_config(ops, Strutil::from_string<int>(res),
+                            Strutil::from_string<int>(nc), TypeDesc(type),
+                            threadcounts);
+
+    if (output_filename.size()
+        && !Benchmarker::write_results(output_filename)) {
+        std::cout << "Error: could not write " << output_filename << "\n";
+        return -1;
+    }
+    if (verbose)
+        std::cout << "\n" << OIIO::geterror() << "\n";
+    return unit_test_failures;
+}
@@ -4,16 +4,27 @@
 
 
 #include <iostream>
+#include <map>
 #include <memory>
+#include <set>
+#include <vector>
+
+#if !defined(_WIN32)
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <unistd.h>
+#endif
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/deepdata.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagebufalgo_util.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/simd.h>
 #include <OpenImageIO/strongparam.h>
 #include <OpenImageIO/strutil.h>
@@ -26,7 +37,246 @@ OIIO_NAMESPACE_BEGIN
 
 OIIO_STRONG_PARAM_TYPE(DoLock, bool);
 
-static atomic_ll IB_local_mem_current;
+namespace {
+
+// The built-in ImageBufAllocator. Buffers of 1 MB or more are rounded up
+// to a size class (four per power of two), and when released are kept, up
+// to "imagebuf:pool_MB" in total, for the next request of the same class.
+// That memory has already been faulted in, so reusing it is much cheaper
+// than going back to the system for fresh pages.
+//
+// Buffers of "imagebuf:scratch_MB" or more are instead mapped from an
+// unlinked scratch file. The kernel then does the out-of-core work for
+// us: dirty pages are written back to the file under memory pressure and
+// faulted back in when touched, so the pixels act as a writable cache of
+// the file with page sized tiles. Those are never pooled, since the point
+// is to not hold on to them.
+class PixelPool final : public ImageBufAllocator {
+public:
+    ~PixelPool()
+    {
+        for (auto& c : m_free)
+            for (void* p : c.second)
+                aligned_free(p);
+        pvt::imagebuf_pooled_mem -= m_pooled;
+    }
+
+    void* allocate(size_t size) override
+    {
+        if (pvt::imagebuf_scratch_MB
+            && size >= (size_t(pvt::imagebuf_scratch_MB) << 20)) {
+            if (void* p = scratch_allocate(size)) {
+                spin_lock lock(m_mutex);
+                m_scratch.insert(p);
+                return p;
+            }
+        }
+        size_t cls = size_class(size);
+        if (size >= min_pooled) {
+            spin_lock lock(m_mutex);
+            auto found = m_free.find(cls);
+            if (found != m_free.end() && found->second.size()) {
+                void* p = found->second.back();
+                found->second.pop_back();
+                m_pooled -= cls;
+                pvt::imagebuf_pooled_mem -= cls;
+                return p;
+            }
+        }
+        return raw_allocate(cls);
+    }
+
+    void deallocate(void* ptr, size_t size) override
+    {
+        size_t cls   = size_class(size);
+        size_t limit = size_t(std::max(pvt::imagebuf_pool_MB, 0)) << 20;
+        if (size >= min_pooled) {
+            spin_lock lock(m_mutex);
+            if (m_scratch.erase(ptr)) {
+                scratch_free(ptr, size);
+                return;
+            }
+            if (m_pooled + cls <= limit) {
+                m_free[cls].push_back(ptr);
+                m_pooled += cls;
+                pvt::imagebuf_pooled_mem += cls;
+                return;
+            }
+            trim(limit);
+        }
+        aligned_free(ptr);
+    }
+
+private:
+    static constexpr size_t min_pooled = size_t(1) << 20;
+    static constexpr size_t hugepage   = size_t(2) << 20;
+
+    // The size actually allocated for a request of `size` bytes
+    static size_t size_class(size_t size)
+    {
+        if (size < min_pooled)
+            return size;
+        size_t step = size_t(1) << (floor2(size) - 2);
+        return round_to_multiple(size, step);
+    }
+    static int floor2(size_t x)
+    {
+        int b = 0;
+        while (x >>= 1)
+            ++b;
+        return b;
+    }
+
+    static void* raw_allocate(size_t size)
+    {
+        if (pvt::imagebuf_hugepages && size >= hugepage) {
+            void* p = aligned_malloc(size, hugepage);
+#if defined(__linux__) && defined(MADV_HUGEPAGE)
+            if (p)
+                madvise(p, size, MADV_HUGEPAGE);
+#endif
+            return p;
+        }
+        return aligned_malloc(size, 64);
+    }
+
+    // Map `size` bytes of a new scratch file, or return nullptr if that
+    // can't be done, and ordinary memory will have to do.
+    static void* scratch_allocate(size_t size)
+    {
+#if !defined(_WIN32)
+        std::string dir = pvt::imagebuf_scratch_dir.string();
+        if (dir.empty())
+            dir = Filesystem::temp_directory_path();
+        std::string path = dir + "/"
+                           + Filesystem::unique_path("oiio-%%%%-%%%%.scratch");
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+        if (fd < 0)
+            return nullptr;
+        ::unlink(path.c_str());  // the mapping keeps it alive
+        void* p = nullptr;
+        if (::ftruncate(fd, off_t(size)) == 0) {
+            p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd,
+                       0);
+            if (p == MAP_FAILED)
+                p = nullptr;
+        }
+        ::close(fd);
+        return p;
+#else
+        return nullptr;
+#endif
+    }
+
+    static void scratch_free(void* ptr, size_t size)
+    {
+#if !defined(_WIN32)
+        ::munmap(ptr, size);
+#endif
+    }
+
+    // Free pooled buffers, largest first, until no more than `limit` bytes
+    // are left. Only needed if the limit was lowered.
+    void trim(size_t limit)
+    {
+        for (auto c = m_free.rbegin(); c != m_free.rend() && m_pooled > limit;
+             ++c) {
+            while (c->second.size() && m_pooled > limit) {
+                aligned_free(c->second.back());
+                c->second.pop_back();
+                m_pooled -= c->first;
+                pvt::imagebuf_pooled_mem -= c->first;
+            }
+        }
+    }
+
+    spin_mutex m_mutex;
+    std::map<size_t, std::vector<void*>> m_free;  // by size class
+    size_t m_pooled = 0;                          // total bytes in m_free
+    std::set<void*> m_scratch;                    // mapped scratch buffers
+};
+
+static spin_mutex allocator_mutex;
+
+// The allocator in use (guarded by allocator_mutex). Function statics, so
+// that ImageBufs made during static initialization find them ready.
+static const std::shared_ptr<ImageBufAllocator>&
+builtin_allocator()
+{
+    static std::shared_ptr<ImageBufAllocator> pool(new PixelPool);
+    return pool;
+}
+
+static std::shared_ptr<ImageBufAllocator>&
+current_allocator()
+{
+    static std::shared_ptr<ImageBufAllocator> alloc(builtin_allocator());
+    return alloc;
+}
+
+}  // namespace
+
+
+
+void
+ImageBuf::set_allocator(std::shared_ptr<ImageBufAllocator> alloc)
+{
+    spin_lock lock(allocator_mutex);
+    current_allocator() = alloc ? std::move(alloc) : builtin_allocator();
+}
+
+
+
+// Allocate pixel memory that stays counted in pvt::imagebuf_local_mem
+// until the last ImageBuf sharing it lets go, and then goes back to the
+// allocator it came from.
+static std::shared_ptr<char>
+allocate_pixels(size_t size)
+{
+    std::shared_ptr<ImageBufAllocator> alloc;
+    {
+        spin_lock lock(allocator_mutex);
+        alloc = current_allocator();
+    }
+    char* mem = (char*)alloc->allocate(size);
+    if (!mem)
+        throw std::bad_alloc();
+    pvt::imagebuf_local_mem += size;
+    return std::shared_ptr<char>(mem, [size, alloc](char* p) {
+        pvt::imagebuf_local_mem -= size;
+        alloc->deallocate(p, size);
+    });
+}
+
+
+
+// Copy pixel memory. Big copies are split over threads, which is faster,
+// and also means that fresh pages are first touched by the threads (and
+// so, on NUMA machines, land on the memory nodes) that will later process
+// the pixels in parallel too.
+static void
+copy_pixel_memory(char* dst, const char* src, size_t size, int nthreads)
+{
+    const int64_t chunk = int64_t(4) << 20;
+    if (nthreads == 1 || int64_t(size) < 2 * chunk) {
+        memcpy(dst, src, size);
+        return;
+    }
+    parallel_for_chunked(0, int64_t(size), chunk,
+                         [=](int64_t b, int64_t e) {
+                             memcpy(dst + b, src + b, size_t(e - b));
+                         },
+                         parallel_options(nthreads, Split_Y, 1));
+}
+
+
+
+bool
+pvt::packed_localpixels(const ImageBuf& buf)
+{
+    return buf.localpixels()
+           && buf.pixel_stride() == stride_t(buf.spec().pixel_bytes());
+}
 
 
 
@@ -108,7 +358,8 @@ public:
               bool force = false, TypeDesc convert = TypeDesc::UNKNOWN,
               ProgressCallback progress_callback = nullptr,
               void* progress_callback_data       = nullptr,
-              DoLock do_lock                     = DoLock(true));
+              DoLock do_lock                     = DoLock(true),
+              ROI region                         = ROI::All());
     void copy_metadata(const ImageBufImpl& src);
 
     // Note: Uses std::format syntax
@@ -259,6 +510,48 @@ public:
                        && m_zstride == m_ystride * m_spec.height;
     }
 
+    // Before writing to our pixels, make sure nobody else sees them: if
+    // they are still shared with an ImageBuf we were copied from (or that
+    // was copied from us), give ourselves a private copy. A view of part of
+    // another buffer (see ImageBuf::view()) always gets a contiguous copy
+    // of just its own pixels.
+    void unshare_pixels()
+    {
+        if (!m_pixels_shared)
+            return;
+        lock_t lock(m_mutex);
+        if (!m_pixels_shared)
+            return;
+        if (m_localpixels != m_pixels.get() || !m_contiguous) {
+            size_t size                = m_spec.image_bytes();
+            std::shared_ptr<char> mine = allocate_pixels(size);
+            stride_t xstride = AutoStride, ystride = AutoStride,
+                     zstride = AutoStride;
+            ImageSpec::auto_stride(xstride, ystride, zstride, m_spec.format,
+                                   m_spec.nchannels, m_spec.width,
+                                   m_spec.height);
+            parallel_convert_image(m_spec.nchannels, m_spec.width,
+                                   m_spec.height, m_spec.depth, m_localpixels,
+                                   m_spec.format, m_xstride, m_ystride,
+                                   m_zstride, mine.get(), m_spec.format,
+                                   xstride, ystride, zstride, threads());
+            m_pixels         = std::move(mine);
+            m_localpixels    = m_pixels.get();
+            m_allocated_size = size;
+            m_xstride        = xstride;
+            m_ystride        = ystride;
+            m_zstride        = zstride;
+            eval_contiguous();
+        } else if (m_pixels.use_count() > 1) {
+            std::shared_ptr<char> mine = allocate_pixels(m_allocated_size);
+            copy_pixel_memory(mine.get(), m_pixels.get(), m_allocated_size,
+                              threads());
+            m_pixels      = std::move(mine);
+            m_localpixels = m_pixels.get();
+        }
+        m_pixels_shared = false;
+    }
+
     bool has_thumbnail(DoLock do_lock = DoLock(true)) const;
     void clear_thumbnail(DoLock do_lock = DoLock(true));
     void set_thumbnail(const ImageBuf& thumb, DoLock do_lock = DoLock(true));
@@ -275,8 +568,10 @@ private:
     mutable int m_threads;          ///< thread policy for this image
     ImageSpec m_spec;               ///< Describes the image (size, etc)
     ImageSpec m_nativespec;         ///< Describes the true native image
-    std::unique_ptr<char[]> m_pixels;  ///< Pixel data, if local and we own it
-    char* m_localpixels;               ///< Pointer to local pixels
+    std::shared_ptr<char> m_pixels;  ///< Pixel data, if local and we own it
+    char* m_localpixels;             ///< Pointer to local pixels
+    /// Might m_pixels be shared with copies of this ImageBuf?
+    mutable std::atomic<bool> m_pixels_shared { false };
     typedef std::recursive_mutex mutex_t;
     typedef std::unique_lock<mutex_t> lock_t;
     mutable mutex_t m_mutex;      ///< Thread safety for this ImageBuf
@@ -450,8 +745,13 @@ ImageBufImpl::ImageBufImpl(const ImageBufImpl& src)
             // Source just wrapped the client app's pixels, we do the same
             m_localpixels = src.m_localpixels;
         } else {
-            // We own our pixels -- copy from source
-            new_pixels(src.m_spec.image_bytes(), src.m_pixels.get());
+            // Source owns its pixels -- share them, and leave it to the
+            // first of us to write to make a copy (see unshare_pixels()).
+            m_pixels            = src.m_pixels;
+            m_localpixels       = src.m_localpixels;
+            m_allocated_size    = src.m_allocated_size;
+            m_pixels_shared     = true;
+            src.m_pixels_shared = true;
         }
     } else {
         // Source was cache-based or deep
@@ -594,7 +894,10 @@ ImageBufImpl::new_pixels(size_t size, const void* data)
     if (m_allocated_size)
         free_pixels();
     try {
-        m_pixels.reset(size ? new char[size] : nullptr);
+        if (size)
+            m_pixels = allocate_pixels(size);
+        else
+            m_pixels.reset();
     } catch (const std::exception& e) {
         // Could not allocate enough memory. So don't allocate anything,
         // consider this an uninitialized ImageBuf, issue an error, and hope
@@ -606,14 +909,14 @@ ImageBufImpl::new_pixels(size_t size, const void* data)
         size = 0;
     }
     m_allocated_size = size;
-    IB_local_mem_current += m_allocated_size;
+    m_pixels_shared  = false;
     if (data && size)
-        memcpy(m_pixels.get(), data, size);
+        copy_pixel_memory(m_pixels.get(), (const char*)data, size, threads());
     m_localpixels = m_pixels.get();
     m_storage     = size ? ImageBuf::LOCALBUFFER : ImageBuf::UNINITIALIZED;
     if (pvt::oiio_print_debug > 1)
         OIIO::debugfmt("IB allocated {} MB, global IB memory now {} MB\n",
-                       size >> 20, IB_local_mem_current >> 20);
+                       size >> 20, pvt::imagebuf_local_mem >> 20);
     eval_contiguous();
     return m_localpixels;
 }
@@ -622,14 +925,15 @@ ImageBufImpl::new_pixels(size_t size, const void* data)
 void
 ImageBufImpl::free_pixels()
 {
+    m_pixels.reset();  // frees the memory, unless a copy still shares it
+    m_pixels_shared = false;
     if (m_allocated_size) {
         if (pvt::oiio_print_debug > 1)
-            OIIO::debugfmt("IB freed {} MB, global IB memory now {} MB\n",
-                           m_allocated_size >> 20, IB_local_mem_current >> 20);
-        IB_local_mem_current -= m_allocated_size;
+            OIIO::debugfmt("IB released {} MB, global IB memory now {} MB\n",
+                           m_allocated_size >> 20,
+                           pvt::imagebuf_local_mem >> 20);
         m_allocated_size = 0;
     }
-    m_pixels.reset();
     m_deepdata.free();
     m_storage = ImageBuf::UNINITIALIZED;
     m_blackpixel.clear();
@@ -1007,11 +1311,107 @@ ImageBuf::init_spec(string_view filename, int subimage, int miplevel)
 
 
 
+// Read the pixels of `roi` (which must lie within the data window, and
+// whose channel range is ignored in favor of chbegin/chend) from the
+// current subimage and MIP level of `in` into the contiguous buffer
+// `data`. Tiled files are read a whole tile at a time and scanline files
+// a whole scanline at a time, so a strip of that around `roi` goes
+// through a scratch buffer, a bounded number of rows at a time.
+static bool
+read_region(ImageInput& in, int subimage, int miplevel, ROI roi, int chbegin,
+            int chend, TypeDesc format, void* data)
+{
+    const ImageSpec& nspec(in.spec());
+    const int nchans       = chend - chbegin;
+    const stride_t pixsize = stride_t(format.size()) * nchans;
+    const stride_t ystride = pixsize * roi.width();
+    const stride_t zstride = ystride * roi.height();
+
+    // The area that will actually be read for the rows [ybegin,yend) of
+    // plane z (or all of roi's planes, for tiles)
+    ROI area = roi;
+    if (nspec.tile_width) {
+        auto expand = [](int& b, int& e, int origin, int size, int tile) {
+            b = origin + (b - origin) / tile * tile;
+            e = std::min(origin + round_to_multiple(e - origin, tile),
+                         origin + size);
+        };
+        expand(area.xbegin, area.xend, nspec.x, nspec.width, nspec.tile_width);
+        expand(area.ybegin, area.yend, nspec.y, nspec.height,
+               nspec.tile_height);
+        expand(area.zbegin, area.zend, nspec.z, std::max(nspec.depth, 1),
+               std::max(nspec.tile_depth, 1));
+    } else {
+        area.xbegin = nspec.x;
+        area.xend   = nspec.x + nspec.width;
+    }
+    if (area.xbegin == roi.xbegin && area.xend == roi.xend
+        && area.ybegin == roi.ybegin && area.yend == roi.yend
+        && area.zbegin == roi.zbegin && area.zend == roi.zend) {
+        // No waste, read straight into place
+        if (nspec.tile_width)
+            return in.read_tiles(subimage, miplevel, roi.xbegin, roi.xend,
+                                 roi.ybegin, roi.yend, roi.zbegin, roi.zend,
+                                 chbegin, chend, format, data);
+        for (int z = roi.zbegin; z < roi.zend; ++z)
+            if (!in.read_scanlines(subimage, miplevel, roi.ybegin, roi.yend, z,
+                                   chbegin, chend, format,
+                                   (char*)data + (z - roi.zbegin) * zstride))
+                return false;
+        return true;
+    }
+
+    // Otherwise stage a band of rows at a time: a row of tiles, or a
+    // batch of scanlines.
+    const int band = nspec.tile_width ? nspec.tile_height
+                                      : std::max(pvt::oiio_read_chunk.load(),
+                                                 1);
+    const stride_t area_ystride = pixsize * area.width();
+    std::unique_ptr<char[]> scratch(
+        new char[area_ystride * band * (nspec.tile_width ? area.depth() : 1)]);
+    for (int z = roi.zbegin; z < roi.zend; ++z) {
+        for (int y = area.ybegin; y < area.yend; y += band) {
+            int yb = y, ye = std::min(y + band, area.yend);
+            bool ok;
+            if (nspec.tile_width)
+                ok = in.read_tiles(subimage, miplevel, area.xbegin, area.xend,
+                                   yb, ye, area.zbegin, area.zend, chbegin,
+                                   chend, format, scratch.get());
+            else
+                ok = in.read_scanlines(subimage, miplevel, yb, ye, z, chbegin,
+                                       chend, format, scratch.get());
+            if (!ok)
+                return false;
+            // Copy the part of the band that's within roi
+            int cb = std::max(yb, roi.ybegin), ce = std::min(ye, roi.yend);
+            if (cb >= ce)
+                continue;
+            const stride_t area_zstride = area_ystride * (ye - yb);
+            const char* src = scratch.get() + (cb - yb) * area_ystride
+                              + (roi.xbegin - area.xbegin) * pixsize;
+            char* dst = (char*)data + (cb - roi.ybegin) * ystride;
+            if (nspec.tile_width)  // the tiles hold all of roi's planes
+                src += (roi.zbegin - area.zbegin) * area_zstride;
+            else
+                dst += (z - roi.zbegin) * zstride;
+            copy_image(nchans, roi.width(), ce - cb,
+                       nspec.tile_width ? roi.depth() : 1, src, pixsize,
+                       pixsize, area_ystride, area_zstride, dst, pixsize,
+                       ystride, zstride);
+        }
+        if (nspec.tile_width)
+            break;  // all planes done
+    }
+    return true;
+}
+
+
+
 bool
 ImageBufImpl::read(int subimage, int miplevel, int chbegin, int chend,
                    bool force, TypeDesc convert,
                    ProgressCallback progress_callback,
-                   void* progress_callback_data, DoLock do_lock)
+                   void* progress_callback_data, DoLock do_lock, ROI region)
 {
     lock_t lock(m_mutex, std::defer_lock_t());
     if (do_lock)
@@ -1037,6 +1437,23 @@ ImageBufImpl::read(int subimage, int miplevel, int chbegin, int chend,
         chend = nativespec().nchannels;
     bool use_channel_subset = (chbegin != 0 || chend != nativespec().nchannels);
 
+    // Only a window of the pixels was asked for
+    bool use_region = false;
+    if (region.defined() && !m_spec.deep) {
+        region = roi_intersection(region, get_roi(m_nativespec));
+        if (region.xbegin >= region.xend || region.ybegin >= region.yend
+            || region.zbegin >= region.zend) {
+            error("Region to read does not overlap the data window of {}",
+                  m_name.string());
+            return false;
+        }
+        use_region = (region != get_roi(m_nativespec));
+        if (use_region) {
+            force = true;
+            set_roi(m_spec, region);
+        }
+    }
+
     if (m_spec.deep) {
         auto input = ImageInput::open(m_name.string(), m_configspec.get(),
                                       m_rioproxy);
@@ -1141,7 +1558,10 @@ ImageBufImpl::read(int subimage, int miplevel, int chbegin, int chend,
                 ImageSpec newspec;
                 ok &= in->seek_subimage(subimage, miplevel, newspec);
             }
-            if (ok) {
+            if (ok && use_region) {
+                ok &= read_region(*in, subimage, miplevel, region, chbegin,
+                                  chend, m_spec.format, m_localpixels);
+            } else if (ok) {
                 ok &= in->read_image(chbegin, chend, m_spec.format,
                                      m_localpixels, AutoStride, AutoStride,
                                      AutoStride, progress_callback,
@@ -1204,6 +1624,85 @@ ImageBuf::read(int subimage, int miplevel, int chbegin, int chend, bool force,
 
 
 
+bool
+ImageBuf::read(int subimage, int miplevel, ROI roi, TypeDesc convert)
+{
+    return m_impl->read(subimage, miplevel, roi.chbegin, roi.chend,
+                        true /* force */, convert, nullptr, nullptr,
+                        DoLock(true) /* acquire the lock */, roi);
+}
+
+
+
+std::vector<ImageBuf>
+read_all_subimages(string_view filename, TypeDesc convert, int nthreads,
+                   const ImageSpec* config)
+{
+    std::vector<ImageBuf> bufs;
+    auto in = ImageInput::open(filename, config);
+    if (!in)
+        return bufs;  // ImageInput::open has already set the error
+    in->threads(nthreads);  // Pass on our thread policy
+
+    std::vector<ImageSpec> specs;
+    ImageSpec newspec;
+    for (int s = 0; in->seek_subimage(s, 0, newspec); ++s)
+        specs.push_back(newspec);
+    if (specs.empty()) {
+        OIIO::pvt::errorfmt("{}", in->geterror());
+        return bufs;
+    }
+    in->geterror();  // discard any complaint about seeking past the end
+    bufs.resize(specs.size());
+
+    // ImageInput errors are per-thread, so each read holds on to its own
+    // error message and we report them all from here.
+    std::vector<std::string> errors(specs.size());
+    auto read_subimage = [&](int64_t s) {
+        const ImageSpec& spec(specs[s]);
+        bool ok;
+        if (spec.deep) {
+            bufs[s].reset(spec);
+            ok = in->read_native_deep_image(int(s), 0, *bufs[s].deepdata());
+        } else {
+            ImageSpec bufspec = spec;
+            bufspec.set_format(convert != TypeDesc::UNKNOWN ? convert
+                                                            : spec.format);
+            bufs[s].reset(bufspec, InitializePixels::No);
+            ok = in->read_image(int(s), 0, 0, spec.nchannels, bufspec.format,
+                                bufs[s].localpixels());
+        }
+        if (!ok)
+            errors[s] = in->geterror();
+    };
+    if (specs.size() > 1 && nthreads != 1
+        && in->supports("concurrent_subimages")) {
+        parallel_for_chunked(
+            0, int64_t(specs.size()), 1,
+            [&](int64_t b, int64_t e) {
+                for (; b < e; ++b)
+                    read_subimage(b);
+            },
+            nthreads);
+    } else {
+        for (int64_t s = 0, e = int64_t(specs.size()); s < e; ++s)
+            read_subimage(s);
+    }
+
+    std::string err;
+    for (size_t s = 0; s < errors.size(); ++s)
+        if (errors[s].size())
+            err += Strutil::fmt::format("{}subimage {}: {}",
+                                        err.size() ? "\n" : "", s, errors[s]);
+    if (err.size()) {
+        OIIO::pvt::errorfmt("{}", err);
+        bufs.clear();
+    }
+    return bufs;
+}
+
+
+
 void
 ImageBuf::set_write_format(cspan<TypeDesc> format)
 {
@@ -1280,57 +1779,95 @@ ImageBuf::write(ImageOutput* out, ProgressCallback progress_callback,
             ok &= out->write_image(bufformat, &tmp[0], AutoStride, AutoStride,
                                    AutoStride, progress_callback,
                                    progress_callback_data);
-        } else if (outspec.tile_width) {
-            // Big tiled image: break up into tile strips
-            size_t pixelsize = bufspec.pixel_bytes();
-            size_t chunksize = pixelsize * outspec.width * outspec.tile_height
-                               * outspec.tile_depth;
-            std::unique_ptr<char[]> tmp(new char[chunksize]);
-            for (int z = 0; z < outspec.depth; z += outspec.tile_depth) {
-                int zend = std::min(z + outspec.z + outspec.tile_depth,
-                                    outspec.z + outspec.depth);
-                for (int y = 0; y < outspec.height && ok;
-                     y += outspec.tile_height) {
-                    int yend = std::min(y + outspec.y + outspec.tile_height,
-                                        outspec.y + outspec.height);
-                    ok &= get_pixels(ROI(outspec.x, outspec.x + outspec.width,
-                                         outspec.y + y, yend, outspec.z + z,
-                                         zend),
-                                     bufformat, &tmp[0]);
-                    ok &= out->write_tiles(outspec.x, outspec.x + outspec.width,
-                                           y + outspec.y, yend, z + outspec.z,
-                                           zend, bufformat, &tmp[0]);
-                    if (progress_callback
-                        && progress_callback(progress_callback_data,
-                                             (float)(z * outspec.height + y)
-                                                 / (outspec.height
-                                                    * outspec.depth)))
-                        return ok;
-                }
-            }
         } else {
-            // Big scanline image: break up into scanline strips
-            imagesize_t slsize = bufspec.scanline_bytes();
-            int chunk = clamp(round_to_multiple(int(budget / slsize), 64), 1,
-                              1024);
-            std::unique_ptr<char[]> tmp(new char[chunk * slsize]);
-            for (int z = 0; z < outspec.depth; ++z) {
-                for (int y = 0; y < outspec.height && ok; y += chunk) {
-                    int yend = std::min(y + outspec.y + chunk,
-                                        outspec.y + outspec.height);
-                    ok &= get_pixels(ROI(outspec.x, outspec.x + outspec.width,
-                                         outspec.y + y, yend, outspec.z,
-                                         outspec.z + outspec.depth),
-                                     bufformat, &tmp[0]);
-                    ok &= out->write_scanlines(y + outspec.y, yend,
-                                               z + outspec.z, bufformat,
-                                               &tmp[0]);
-                    if (progress_callback
-                        && progress_callback(progress_callback_data,
-                                             (float)(z * outspec.height + y)
-                                                 / (outspec.height
-                                                    * outspec.depth)))
-                        return ok;
+            // Big image: break it up into strips -- rows of tiles, or for
+            // scanline files, bands of up to 1024 scanlines within the
+            // budget. While one strip is being compressed and written, the
+            // next is read from the cache and converted on the thread
+            // pool, and the cache is asked to prefetch the tiles of the
+            // strip after that, so reading, conversion and writing overlap.
+            std::vector<ROI> strips;
+            if (outspec.tile_width) {
+                int tile_depth = std::max(1, outspec.tile_depth);
+                for (int z = 0; z < outspec.depth; z += tile_depth)
+                    for (int y = 0; y < outspec.height;
+                         y += outspec.tile_height)
+                        strips.emplace_back(
+                            outspec.x, outspec.x + outspec.width,
+                            outspec.y + y,
+                            std::min(outspec.y + y + outspec.tile_height,
+                                     outspec.y + outspec.height),
+                            outspec.z + z,
+                            std::min(outspec.z + z + tile_depth,
+                                     outspec.z + outspec.depth));
+            } else {
+                imagesize_t slsize = bufspec.scanline_bytes();
+                int chunk = clamp(round_to_multiple(int(budget / slsize), 64),
+                                  1, 1024);
+                for (int z = 0; z < outspec.depth; ++z)
+                    for (int y = 0; y < outspec.height; y += chunk)
+                        strips.emplace_back(
+                            outspec.x, outspec.x + outspec.width,
+                            outspec.y + y,
+                            std::min(outspec.y + y + chunk,
+                                     outspec.y + outspec.height),
+                            outspec.z + z, outspec.z + z + 1);
+            }
+            size_t stripsize = 0;
+            for (const ROI& r : strips)
+                stripsize = std::max(stripsize,
+                                     size_t(r.npixels())
+                                         * bufspec.pixel_bytes());
+            std::unique_ptr<char[]> bufs[2] = {
+                std::unique_ptr<char[]>(new char[stripsize]),
+                std::unique_ptr<char[]>(new char[stripsize])
+            };
+
+            thread_pool* pool = default_thread_pool();
+            bool overlap      = threads() != 1 && pool->size() > 1
+                           && !pool->is_worker() && strips.size() > 1;
+            ImageCache* ic = m_impl->m_imagecache;
+
+            auto prefetch = [&](size_t i) {
+                if (ic && i < strips.size())
+                    ic->prefetch_tiles(m_impl->m_name, subimage(), miplevel(),
+                                       strips[i]);
+            };
+            auto fetch = [&](size_t i) {
+                return get_pixels(strips[i], bufformat, bufs[i & 1].get());
+            };
+            std::future<bool> next;
+            if (overlap) {
+                prefetch(1);
+                next = pool->push([&](int) { return fetch(0); });
+            }
+            for (size_t i = 0; i < strips.size(); ++i) {
+                bool fetched = overlap ? next.get() : fetch(i);
+                if (!fetched || !ok) {
+                    ok = false;
+                    break;
+                }
+                if (overlap && i + 1 < strips.size()) {
+                    prefetch(i + 2);
+                    next = pool->push([&, i](int) { return fetch(i + 1); });
+                }
+                const ROI& r(strips[i]);
+                const char* data = bufs[i & 1].get();
+                if (outspec.tile_width)
+                    ok &= out->write_tiles(r.xbegin, r.xend, r.ybegin, r.yend,
+                                           r.zbegin, r.zend, bufformat, data);
+                else
+                    ok &= out->write_scanlines(r.ybegin, r.yend, r.zbegin,
+                                               bufformat, data);
+                bool stop
+                    = progress_callback
+                      && progress_callback(progress_callback_data,
+                                           float(i + 1) / strips.size());
+                if (stop || !ok) {
+                    // Don't leave the pool reading into our buffers
+                    if (next.valid())
+                        next.wait();
+                    return ok;
                 }
             }
         }
@@ -1460,6 +1997,7 @@ ImageBuf::make_writable(bool keep_cache_type)
         return read(subimage(), miplevel(), 0, -1, true /*force*/,
                     keep_cache_type ? m_impl->m_cachedpixeltype : TypeDesc());
     }
+    m_impl->unshare_pixels();
     return true;
 }
 
@@ -1551,11 +2089,19 @@ ImageBufImpl::clear_thumbnail(DoLock do_lock)
         lock.lock();
     validate_spec(DoLock(false) /* we already hold the lock */);
     m_thumbnail.reset();
-    m_spec.erase_attribute("thumbnail_width");
-    m_spec.erase_attribute("thumbnail_height");
-    m_spec.erase_attribute("thumbnail_nchannels");
-    m_spec.erase_attribute("thumbnail_image");
     m_has_thumbnail = false;
+    // Every IBA function that writes to an existing image calls this, so
+    // don't pay for erase_attribute's regex matching unless there is
+    // something to erase.
+    for (const auto& p : m_spec.extra_attribs) {
+        if (Strutil::starts_with(p.name(), "thumbnail_")) {
+            m_spec.erase_attribute("thumbnail_width");
+            m_spec.erase_attribute("thumbnail_height");
+            m_spec.erase_attribute("thumbnail_nchannels");
+            m_spec.erase_attribute("thumbnail_image");
+            break;
+        }
+    }
 }
 
 
@@ -1708,6 +2254,7 @@ void*
 ImageBuf::localpixels()
 {
     m_impl->validate_pixels();
+    m_impl->unshare_pixels();
     return m_impl->m_localpixels;
 }
 
@@ -1828,9 +2375,10 @@ copy_pixels_impl(ImageBuf& dst, const ImageBuf& src, ROI roi, int nthreads = 0)
         int nchannels = roi.nchannels();
         if (is_same<D, S>::value) {
             // If both bufs are the same type, just directly copy the values
-            if (src.localpixels() && roi.chbegin == 0
+            if (pvt::packed_localpixels(src) && roi.chbegin == 0
                 && roi.chend == dst.nchannels()
-                && roi.chend == src.nchannels()) {
+                && roi.chend == src.nchannels()
+                && pvt::packed_localpixels(dst)) {
                 // Extra shortcut -- totally local pixels for src, copying all
                 // channels, so we can copy memory around line by line, rather
                 // than value by value.
@@ -1952,6 +2500,54 @@ ImageBuf::copy(TypeDesc format) const
 
 
 
+ImageBuf
+ImageBuf::view(ROI roi) const
+{
+    m_impl->validate_pixels();
+    if (!roi.defined())
+        roi = this->roi();
+    roi.chend = std::min(roi.chend, nchannels());
+    if (!localpixels() || deep() || roi.nchannels() < 1
+        || !this->roi().contains(roi))
+        return ImageBuf();
+
+    const ImageSpec& srcspec(spec());
+    ImageSpec viewspec = srcspec;
+    set_roi(viewspec, roi);
+    viewspec.nchannels = roi.nchannels();
+    viewspec.default_channel_names();
+    for (int c = 0; c < viewspec.nchannels; ++c)
+        viewspec.channelnames[c] = srcspec.channel_name(c + roi.chbegin);
+    auto viewchannel = [&](int c) {
+        return (c >= roi.chbegin && c < roi.chend) ? c - roi.chbegin : -1;
+    };
+    viewspec.channelformats.clear();
+    viewspec.alpha_channel = viewchannel(srcspec.alpha_channel);
+    viewspec.z_channel     = viewchannel(srcspec.z_channel);
+    viewspec.tile_width    = 0;
+    viewspec.tile_height   = 0;
+    viewspec.tile_depth    = 0;
+
+    // Wrap the region's pixels, then make the view co-own (or at least
+    // share) them like a copy does, so that it's copied on write.
+    ImageBuf result(viewspec,
+                    (void*)pixeladdr(roi.xbegin, roi.ybegin, roi.zbegin,
+                                     roi.chbegin),
+                    pixel_stride(), scanline_stride(), z_stride());
+    ImageBufImpl* view     = result.m_impl.get();
+    view->m_storage        = LOCALBUFFER;
+    view->m_pixels         = m_impl->m_pixels;
+    view->m_allocated_size = m_impl->m_allocated_size;
+    view->m_threads        = m_impl->m_threads;
+    view->m_pixels_shared  = true;
+    if (m_impl->m_pixels)
+        m_impl->m_pixels_shared = true;
+    view->eval_contiguous();
+    return result;
+}
+
+
+
 template<typename T>
 static inline float
 getchannel_(const ImageBuf& buf, int x, int y, int z, int c,
@@ -2301,6 +2897,19 @@ ImageBuf::set_pixels(ROI roi, TypeDesc format, const void* data,
     if (!roi.defined())
         roi = this->roi();
     roi.chend = std::min(roi.chend, nchannels());
+    if (localpixels() && this->roi().contains(roi)) {
+        // Like get_pixels, when the pixels are all in memory this is just
+        // a parallel_convert_image, which converts whole runs of values at
+        // once (with SIMD for the common types) rather than one by one.
+        ImageSpec::auto_stride(xstride, ystride, zstride, format.size(),
+                               roi.nchannels(), roi.width(), roi.height());
+        return parallel_convert_image(
+            roi.nchannels(), roi.width(), roi.height(), roi.depth(), data,
+            format, xstride, ystride, zstride,
+            pixeladdr(roi.xbegin, roi.ybegin, roi.zbegin, roi.chbegin),
+            spec().format, pixel_stride(), scanline_stride(), z_stride(),
+            threads());
+    }
     OIIO_DISPATCH_TYPES2(ok, "set_pixels", set_pixels_, spec().format, format,
                          *this, roi, data, xstride, ystride, zstride);
     return ok;
@@ -2681,6 +3290,7 @@ ImageBufImpl::pixeladdr(int x, int y, int z, int ch)
     validate_pixels();
     if (cachedpixels())
         return nullptr;
+    unshare_pixels();
     x -= m_spec.x;
     y -= m_spec.y;
     z -= m_spec.z;
@@ -2995,6 +3605,8 @@ ImageBuf::IteratorBase::init_ib(WrapMode wrap, bool write)
 {
     const ImageSpec& spec(m_ib->spec());
     m_deep        = spec.deep;
+    if (write)
+        m_ib->m_impl->unshare_pixels();
     m_localpixels = (m_ib->localpixels() != nullptr);
     if (!m_localpixels && write) {
         const_cast<ImageBuf*>(m_ib)->make_writable(true);
@@ -4,6 +4,7 @@
 
 
 #include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/deepdata.h>
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
@@ -59,6 +60,51 @@ test_is_imageio_format_name()
 
 
 
+// Every ISA level of the dispatched conversion kernels must give the same
+// results as the baseline, including for the partial vectors at the ends.
+void
+test_simd_dispatch()
+{
+    std::cout << "\nTesting SIMD dispatch\n";
+    const int n = 1003;
+    std::vector<float> fsrc(n);
+    std::vector<uint16_t> isrc(n);
+    for (int i = 0; i < n; ++i) {
+        fsrc[i] = float(i) / 700.0f - 0.25f;  // some out of [0,1]
+        isrc[i] = uint16_t(i * 65);
+    }
+    fsrc[0] = 0.5f / 255.0f;  // halfway when converted to uint8
+    const TypeDesc pairs[][2] = {
+        { TypeFloat, TypeUInt8 },  { TypeFloat, TypeUInt16 },
+        { TypeFloat, TypeHalf },   { TypeUInt16, TypeFloat },
+        { TypeUInt16, TypeHalf },  { TypeUInt8, TypeFloat },
+        { TypeUInt8, TypeHalf },
+    };
+    for (auto& p : pairs) {
+        const void* src = p[0] == TypeFloat ? (const void*)fsrc.data()
+                                            : (const void*)isrc.data();
+        std::vector<char> base(n * p[1].size()), other(base.size());
+        OIIO_CHECK_ASSERT(OIIO::attribute("simd_dispatch", "baseline"));
+        convert_pixel_values(p[0], src, p[1], base.data(), n);
+        for (const char* isa : { "avx2", "avx512" }) {
+            if (!OIIO::attribute("simd_dispatch", isa))
+                continue;  // Not compiled, or this CPU can't run it
+            std::fill(other.begin(), other.end(), 0);
+            convert_pixel_values(p[0], src, p[1], other.data(), n);
+            OIIO_CHECK_ASSERT(other == base);
+        }
+    }
+    unsigned char u8;
+    convert_pixel_values(TypeFloat, fsrc.data(), TypeUInt8, &u8, 1);
+    OIIO_CHECK_EQUAL(int(u8), 1);  // rounds like convert_type
+    OIIO_CHECK_ASSERT(!OIIO::attribute("simd_dispatch", "blort"));
+    OIIO_CHECK_ASSERT(OIIO::attribute("simd_dispatch", ""));
+    std::cout << "  using " << OIIO::get_string_attribute("simd_dispatch")
+              << "\n";
+}
+
+
+
 // Test iterators
 template<class ITERATOR>
 void
@@ -360,6 +406,223 @@ test_set_get_pixels()
 
 
 
+void
+test_copy_on_write()
+{
+    std::cout << "\nTesting copy-on-write of ImageBuf copies\n";
+    const float red[3] = { 1.0f, 0.0f, 0.0f }, green[3] = { 0.0f, 1.0f, 0.0f };
+    ImageBuf A(ImageSpec(4, 4, 3, TypeDesc::FLOAT));
+    ImageBufAlgo::fill(A, red);
+    const ImageBuf& Aconst(A);
+
+    // A copy shares the pixels until it's written to
+    ImageBuf B(A);
+    const ImageBuf& Bconst(B);
+    OIIO_CHECK_EQUAL(Bconst.localpixels(), Aconst.localpixels());
+    B.setpixel(1, 1, green);
+    OIIO_CHECK_NE(Bconst.localpixels(), Aconst.localpixels());
+    OIIO_CHECK_EQUAL(A.getchannel(1, 1, 0, 0), 1.0f);
+    OIIO_CHECK_EQUAL(B.getchannel(1, 1, 0, 1), 1.0f);
+    OIIO_CHECK_EQUAL(B.getchannel(2, 2, 0, 0), 1.0f);
+
+    // Writing through the original leaves the copy alone, too
+    ImageBuf C(A);
+    for (ImageBuf::Iterator<float> it(A); !it.done(); ++it)
+        it[0] = 0.5f;
+    OIIO_CHECK_EQUAL(A.getchannel(3, 3, 0, 0), 0.5f);
+    OIIO_CHECK_EQUAL(C.getchannel(3, 3, 0, 0), 1.0f);
+
+    // Once nobody else shares the pixels, writing needs no copy
+    const ImageBuf& Cconst(C);
+    ImageBuf D(C);
+    D.reset();
+    const void* Cpixels = Cconst.localpixels();
+    OIIO_CHECK_EQUAL(C.localpixels(), Cpixels);
+}
+
+
+
+// A view of a region and some channels shares the parent's pixels, and
+// is copied on the first write to either of them.
+void
+test_view()
+{
+    std::cout << "\nTesting ImageBuf views\n";
+    ImageSpec spec(6, 5, 4, TypeDesc::FLOAT);
+    spec.channelnames  = { "R", "G", "B", "A" };
+    spec.alpha_channel = 3;
+    ImageBuf A(spec);
+    for (ImageBuf::Iterator<float> it(A); !it.done(); ++it)
+        for (int c = 0; c < 4; ++c)
+            it[c] = float(it.y() * 100 + it.x() * 10 + c);
+    const ImageBuf& Aconst(A);
+
+    ROI roi(1, 4, 2, 5, 0, 1, 1, 4);  // GBA of a 3x3 region
+    ImageBuf V = A.view(roi);
+    const ImageBuf& Vconst(V);
+    OIIO_CHECK_ASSERT(V.initialized());
+    OIIO_CHECK_EQUAL(V.roi(), ROI(1, 4, 2, 5, 0, 1, 0, 3));
+    OIIO_CHECK_EQUAL(V.spec().channel_name(0), "G");
+    OIIO_CHECK_EQUAL(V.spec().alpha_channel, 2);
+    OIIO_CHECK_EQUAL(Vconst.localpixels(), Aconst.pixeladdr(1, 2, 0, 1));
+    OIIO_CHECK_EQUAL(V.pixel_stride(), A.pixel_stride());
+    OIIO_CHECK_ASSERT(!V.contiguous());
+    OIIO_CHECK_EQUAL(V.getchannel(3, 4, 0, 1), 432.0f);
+
+    // Writing to the parent leaves the view alone
+    ImageBufAlgo::zero(A);
+    OIIO_CHECK_EQUAL(V.getchannel(3, 4, 0, 1), 432.0f);
+
+    // Writing to the view makes it a contiguous copy of its own pixels,
+    // and it outlives the parent's pixels
+    ImageBuf W = Aconst.view(roi);
+    A.reset();
+    const float one[3] = { 1.0f, 1.0f, 1.0f };
+    V.setpixel(1, 2, one);
+    OIIO_CHECK_ASSERT(V.contiguous());
+    OIIO_CHECK_EQUAL(V.getchannel(1, 2, 0, 0), 1.0f);
+    OIIO_CHECK_EQUAL(V.getchannel(3, 4, 0, 2), 433.0f);
+    OIIO_CHECK_EQUAL(W.getchannel(1, 2, 0, 0), 0.0f);
+
+    // No view of a region outside the data window
+    OIIO_CHECK_ASSERT(!W.view(ROI(0, 4, 2, 5)).initialized());
+}
+
+
+
+void
+test_allocator()
+{
+    std::cout << "\nTesting ImageBuf pixel allocators\n";
+    ImageSpec spec(512, 512, 4, TypeDesc::FLOAT);  // 4 MB
+
+    // The built-in pool hands a released buffer to the next ImageBuf of
+    // the same size class.
+    OIIO::attribute("imagebuf:pool_MB", 64);
+    const void* first;
+    {
+        ImageBuf A(spec, InitializePixels::No);
+        first = A.localpixels();
+    }
+    {
+        ImageBuf B(ImageSpec(500, 512, 4, TypeDesc::FLOAT),
+                   InitializePixels::No);
+        OIIO_CHECK_EQUAL(B.localpixels(), first);
+    }
+    OIIO::attribute("imagebuf:pool_MB", 0);
+
+    // A custom allocator sees every allocation, and gets it back even if
+    // it's no longer installed by then.
+    struct Counting final : public ImageBufAllocator {
+        void* allocate(size_t size) override
+        {
+            ++nalloc;
+            return aligned_malloc(size, 64);
+        }
+        void deallocate(void* ptr, size_t) override
+        {
+            ++nfree;
+            aligned_free(ptr);
+        }
+        int nalloc = 0, nfree = 0;
+    };
+    auto counting = std::make_shared<Counting>();
+    ImageBuf::set_allocator(counting);
+    {
+        ImageBuf A(spec);
+        ImageBuf::set_allocator(nullptr);
+        ImageBuf B(A);  // shares A's pixels
+        OIIO_CHECK_EQUAL(counting->nalloc, 1);
+        OIIO_CHECK_EQUAL(counting->nfree, 0);
+    }
+    OIIO_CHECK_EQUAL(counting->nfree, 1);
+}
+
+
+
+// Test that the per-subsystem memory counters follow what's allocated
+// and freed.
+void
+test_memory_stats()
+{
+    std::cout << "\nTesting memory accounting\n";
+    auto stat = [](const char* name) {
+        long long val = -1;
+        OIIO_CHECK_ASSERT(OIIO::getattribute(name, TypeInt64, &val));
+        return val;
+    };
+    long long imagebuf0 = stat("stat:memory:imagebuf");
+    long long deep0     = stat("stat:memory:deepdata");
+    long long meta0     = stat("stat:memory:metadata");
+    long long inputs0   = stat("stat:imageinputs");
+    {
+        ImageBuf A(ImageSpec(256, 256, 4, TypeDesc::FLOAT));  // 1 MB
+        ImageBuf B(A);  // shares A's pixels
+        long long imagebuf1 = stat("stat:memory:imagebuf");
+        OIIO_CHECK_ASSERT(imagebuf1 >= imagebuf0 + (1 << 20));
+        OIIO_CHECK_ASSERT(imagebuf1 < imagebuf0 + (2 << 20));
+
+        DeepData dd;
+        std::vector<TypeDesc> types(2, TypeFloat);
+        std::vector<std::string> names { "Z", "A" };
+        dd.init(1000, 2, types, names);
+        std::vector<unsigned int> nsamples(1000, 4);
+        dd.set_all_samples(nsamples);
+        dd.set_deep_value(0, 0, 0, 1.0f);  // allocates the samples
+        OIIO_CHECK_ASSERT(stat("stat:memory:deepdata")
+                          >= deep0 + 1000 * 4 * 2 * (long long)sizeof(float));
+
+        ImageSpec spec;
+        std::vector<float> big(1000, 0.5f);
+        spec.attribute("big", TypeDesc(TypeDesc::FLOAT, 1000), big.data());
+        ImageSpec spec2(spec);  // shares the value
+        OIIO_CHECK_ASSERT(stat("stat:memory:metadata") >= meta0 + 4000);
+        OIIO_CHECK_ASSERT(stat("stat:memory:metadata") < meta0 + 8000);
+
+        OIIO_CHECK_ASSERT(stat("stat:memory:total")
+                          >= stat("stat:memory:imagebuf")
+                                 + stat("stat:memory:deepdata"));
+
+        auto in = ImageInput::create("tif");
+        if (in)
+            OIIO_CHECK_EQUAL(stat("stat:imageinputs"), inputs0 + 1);
+    }
+    OIIO_CHECK_ASSERT(stat("stat:memory:imagebuf") <= imagebuf0);
+    OIIO_CHECK_EQUAL(stat("stat:memory:deepdata"), deep0);
+    OIIO_CHECK_EQUAL(stat("stat:memory:metadata"), meta0);
+    OIIO_CHECK_EQUAL(stat("stat:imageinputs"), inputs0);
+    long long val;
+    OIIO_CHECK_ASSERT(
+        !OIIO::getattribute("stat:memory:bogus", TypeInt64, &val));
+}
+
+
+
+void
+test_scratch_storage()
+{
+    std::cout << "\nTesting ImageBuf scratch file storage\n";
+    OIIO::attribute("imagebuf:scratch_MB", 1);
+    {
+        ImageBuf A(ImageSpec(1024, 1024, 4, TypeDesc::FLOAT));
+        ImageBufAlgo::fill(A, { 0.25f, 0.5f, 0.75f, 1.0f });
+        const float val[4] = { 1.0f, 2.0f, 3.0f, 4.0f };
+        A.setpixel(1000, 1000, val);
+        float p[4];
+        A.getpixel(1000, 1000, p);
+        OIIO_CHECK_EQUAL(p[2], 3.0f);
+        A.getpixel(3, 5, p);
+        OIIO_CHECK_EQUAL(p[1], 0.5f);
+        ImageBuf B(A);
+        B.setpixel(3, 5, val);
+        A.getpixel(3, 5, p);
+        OIIO_CHECK_EQUAL(p[1], 0.5f);
+    }
+    OIIO::attribute("imagebuf:scratch_MB", 0);
+}
+
+
+
 void
 time_get_pixels()
 {
@@ -425,6 +688,46 @@ test_read_channel_subset()
 
 
 
+void
+test_read_region()
+{
+    std::cout << "\nTesting reading a region\n";
+
+    // Pixel (x,y) holds (x, y, x+y) so we can tell where anything came from
+    ImageSpec spec(64, 48, 3, TypeDesc::FLOAT);
+    ImageBuf A(spec);
+    for (ImageBuf::Iterator<float> p(A); !p.done(); ++p) {
+        p[0] = float(p.x());
+        p[1] = float(p.y());
+        p[2] = float(p.x() + p.y());
+    }
+    A.write("region_scanline.exr");
+    A.set_write_tiles(16, 16);
+    A.write("region_tiled.exr");
+
+    for (auto name : { "region_scanline.exr", "region_tiled.exr" }) {
+        ImageBuf B(name);
+        OIIO_CHECK_ASSERT(B.read(0, 0, ROI(10, 30, 5, 40, 0, 1, 1, 3)));
+        OIIO_CHECK_EQUAL(B.roi(), ROI(10, 30, 5, 40, 0, 1, 0, 2));
+        OIIO_CHECK_EQUAL(B.roi_full(), A.roi_full());
+        OIIO_CHECK_EQUAL(B.spec().channelnames[0], "G");
+        bool match = true;
+        for (ImageBuf::ConstIterator<float> p(B); !p.done(); ++p)
+            match &= (p[0] == float(p.y()) && p[1] == float(p.x() + p.y()));
+        OIIO_CHECK_ASSERT(match);
+
+        // Clipped to the data window, and an error if nothing is left
+        ImageBuf C(name);
+        OIIO_CHECK_ASSERT(C.read(0, 0, ROI(50, 100, 40, 100)));
+        OIIO_CHECK_EQUAL(C.roi(), ROI(50, 64, 40, 48, 0, 1, 0, 3));
+        ImageBuf D(name);
+        OIIO_CHECK_ASSERT(!D.read(0, 0, ROI(100, 120, 0, 10)));
+        Filesystem::remove(name);
+    }
+}
+
+
+
 void
 test_roi()
 {
@@ -462,6 +765,52 @@ test_roi()
 
 
 
+void
+test_read_all_subimages()
+{
+    std::cout << "\nTesting read_all_subimages\n";
+
+    // Write a file with three subimages of different sizes and colors
+    const int nsubimages = 3;
+    ImageSpec specs[nsubimages] = { ImageSpec(8, 8, 3, TypeUInt8),
+                                    ImageSpec(4, 6, 3, TypeUInt8),
+                                    ImageSpec(2, 2, 3, TypeUInt16) };
+    {
+        auto out = ImageOutput::create("multi.tif");
+        OIIO_CHECK_ASSERT(out && out->open("multi.tif", nsubimages, specs));
+        for (int s = 0; out && s < nsubimages; ++s) {
+            if (s)
+                out->open("multi.tif", specs[s], ImageOutput::AppendSubimage);
+            float val = float(s + 1) / nsubimages;
+            ImageBuf img(specs[s]);
+            ImageBufAlgo::fill(img, { val, 0.0f, 1.0f - val });
+            img.write(out.get());
+        }
+    }
+
+    std::vector<ImageBuf> bufs = read_all_subimages("multi.tif",
+                                                    TypeDesc::FLOAT);
+    OIIO_CHECK_EQUAL(bufs.size(), size_t(nsubimages));
+    for (int s = 0; s < int(bufs.size()); ++s) {
+        OIIO_CHECK_EQUAL(bufs[s].spec().width, specs[s].width);
+        OIIO_CHECK_EQUAL(bufs[s].spec().height, specs[s].height);
+        OIIO_CHECK_EQUAL(bufs[s].spec().format, TypeDesc::FLOAT);
+        float pixel[3];
+        bufs[s].getpixel(1, 1, pixel);
+        OIIO_CHECK_EQUAL_THRESH(pixel[0], float(s + 1) / nsubimages, 0.01f);
+        OIIO_CHECK_EQUAL(pixel[1], 0.0f);
+    }
+
+    // A missing file gives no images and an error
+    bufs = read_all_subimages("does-not-exist.tif");
+    OIIO_CHECK_ASSERT(bufs.empty());
+    OIIO_CHECK_ASSERT(OIIO::geterror().size());
+
+    Filesystem::remove("multi.tif");
+}
+
+
+
 // Test what happens when we read, replace the image on disk, then read
 // again.
 void
@@ -500,6 +849,113 @@ test_write_over()
 }
 
 
+// Planar DeepData must behave just like interleaved, whatever is done to it
+void
+test_deepdata_planar()
+{
+    std::cout << "test DeepData planar\n";
+    ImageSpec spec(3, 1, 4, TypeFloat);
+    spec.channelnames   = { "R", "A", "Z", "Zback" };
+    spec.channelformats = { TypeHalf, TypeFloat, TypeFloat, TypeFloat };
+    spec.deep           = true;
+    DeepData dd[2];
+    for (int planar = 0; planar < 2; ++planar) {
+        DeepData& d(dd[planar]);
+        if (planar)
+            d.set_planar(true);  // before init, like a reader would see
+        d.init(spec);
+        OIIO_CHECK_EQUAL(d.planar(), bool(planar));
+        for (int p = 0; p < 3; ++p) {
+            d.set_samples(p, 3);
+            for (int s = 0; s < 3; ++s) {
+                float z = float((p + 2 * s) % 3);
+                d.set_deep_value(p, 0, s, 0.25f * s);
+                d.set_deep_value(p, 1, s, s == 1 ? 1.0f : 0.5f);
+                d.set_deep_value(p, 2, s, z);
+                d.set_deep_value(p, 3, s, z + 0.5f);
+            }
+        }
+        d.insert_samples(0, 1, 2);  // grows the capacity
+        d.set_deep_value(0, 2, 1, 7.0f);
+        d.set_deep_value(0, 2, 2, 8.0f);
+        d.erase_samples(1, 0);
+        d.sort(2);
+        d.occlusion_cull(1);
+        OIIO_CHECK_EQUAL(d.sample_stride(0),
+                         planar ? sizeof(uint16_t) : d.samplesize());
+        OIIO_CHECK_EQUAL(d.float_samples(2, 2).size(), planar ? 3 : 0);
+        OIIO_CHECK_EQUAL(d.float_samples(2, 0).size(), 0);  // half
+    }
+    for (int p = 0; p < 3; ++p) {
+        OIIO_CHECK_EQUAL(dd[0].samples(p), dd[1].samples(p));
+        OIIO_CHECK_EQUAL(dd[0].opaque_z(p), dd[1].opaque_z(p));
+        for (int s = 0; s < dd[0].samples(p); ++s)
+            for (int c = 0; c < 4; ++c)
+                OIIO_CHECK_EQUAL(dd[0].deep_value(p, c, s),
+                                 dd[1].deep_value(p, c, s));
+    }
+
+    // Converting back gives the very same bytes
+    DeepData copy(dd[1]);
+    copy.set_planar(false);
+    OIIO_CHECK_ASSERT(std::equal(copy.all_data().begin(),
+                                 copy.all_data().end(),
+                                 dd[0].all_data().begin()));
+}
+
+
+
+void
+test_deep_merge()
+{
+    std::cout << "test deep_merge\n";
+    ImageSpec spec(16, 8, 3, TypeFloat);
+    spec.channelnames = { "A", "Z", "Zback" };
+    spec.deep         = true;
+    ImageBuf A(spec), B(spec);
+    for (int p = 0; p < 16 * 8; ++p) {
+        for (int i = 0; i < 2; ++i) {
+            DeepData& d(*(i ? B : A).deepdata());
+            int n = (p + i) % 5;
+            d.set_samples(p, n);
+            for (int s = 0; s < n; ++s) {
+                float z = float((p * 7 + s * 3 + i) % 11);
+                d.set_deep_value(p, 0, s, 0.1f * (s + 1));
+                d.set_deep_value(p, 1, s, z);
+                d.set_deep_value(p, 2, s, z + 1.5f);
+            }
+            d.sort(p);
+        }
+    }
+
+    // Reserving capacity for all pixels at once keeps the samples
+    DeepData reserved(*A.deepdata());
+    std::vector<unsigned int> capacity(reserved.pixels(), 20);
+    reserved.set_all_capacity(capacity);
+    OIIO_CHECK_EQUAL(reserved.capacity(5), 20);
+    for (int p = 0; p < reserved.pixels(); ++p)
+        for (int s = 0; s < reserved.samples(p); ++s)
+            OIIO_CHECK_EQUAL(reserved.deep_value(p, 1, s),
+                             A.deepdata()->deep_value(p, 1, s));
+
+    // The parallel merge matches merging one pixel at a time
+    DeepData serial(*A.deepdata());
+    for (int p = 0; p < serial.pixels(); ++p)
+        serial.merge_deep_pixels(p, *B.deepdata(), p);
+    for (int nthreads : { 1, 0 }) {
+        ImageBuf R = ImageBufAlgo::deep_merge(A, B, false, {}, nthreads);
+        const DeepData& r(*R.deepdata());
+        for (int p = 0; p < serial.pixels(); ++p) {
+            OIIO_CHECK_EQUAL(r.samples(p), serial.samples(p));
+            for (int s = 0; s < serial.samples(p); ++s)
+                for (int c = 0; c < 3; ++c)
+                    OIIO_CHECK_EQUAL(r.deep_value(p, c, s),
+                                     serial.deep_value(p, c, s));
+        }
+    }
+}
+
+
 
 int
 main(int /*argc*/, char* /*argv*/[])
@@ -508,6 +964,7 @@ main(int /*argc*/, char* /*argv*/[])
     // as good a place to verify them as any.
     test_wrapmodes();
     test_is_imageio_format_name();
+    test_simd_dispatch();
     test_roi();
 
     // Lots of tests related to ImageBuf::Iterator
@@ -528,8 +985,17 @@ main(int /*argc*/, char* /*argv*/[])
     ImageBuf_test_appbuffer_strided();
     test_open_with_config();
     test_read_channel_subset();
+    test_read_region();
+    test_read_all_subimages();
 
     test_set_get_pixels();
+    test_copy_on_write();
+    test_view();
+    test_allocator();
+    test_memory_stats();
+    test_scratch_storage();
+    test_deepdata_planar();
+    test_deep_merge();
     time_get_pixels();
 
     test_write_over();
@@ -2,8 +2,12 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <atomic>
 #include <cmath>
+#include <complex>
+#include <limits>
 #include <memory>
+#include <vector>
 
 #include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
@@ -246,9 +250,11 @@ ImageBufAlgo::IBAprep(ROI& roi, ImageBuf* dst, const ImageBuf* A,
             // Since we're altering pixels, be sure that any existing SHA
             // hash of dst's pixel values is erased.
             spec.erase_attribute("oiio:SHA-1");
+            spec.erase_attribute("oiio:SourceHash");
             std::string desc = spec.get_string_attribute("ImageDescription");
             if (desc.size()) {
                 Strutil::excise_string_after_head(desc, "oiio:SHA-1=");
+                Strutil::excise_string_after_head(desc, "oiio:SourceHash=");
                 spec.attribute("ImageDescription", desc);
             }
         }
@@ -360,7 +366,11 @@ convolve_(ImageBuf& dst, const ImageBuf& src, const ImageBuf& kernel,
     using namespace ImageBufAlgo;
     OIIO_DASSERT(kernel.spec().format == TypeDesc::FLOAT && kernel.localpixels()
                  && "kernel should be float and in local memory");
-    parallel_image(roi, nthreads, [&](ROI roi) {
+    // Each output pixel reads a kernel-sized neighbourhood of the source,
+    // which tiles reuse far better than strips of a wide image.
+    parallel_options opt(nthreads, Split_Tile);
+    opt.itembytes = (src.nchannels() + dst.nchannels()) * sizeof(float);
+    parallel_image(roi, opt, [&](ROI roi) {
         ROI kroi   = kernel.roi();
         int kchans = kernel.nchannels();
 
@@ -396,6 +406,231 @@ convolve_(ImageBuf& dst, const ImageBuf& src, const ImageBuf& kernel,
 
 
 
+// Kernels with at least this many values that aren't separable are
+// applied by FFT rather than directly.
+static constexpr imagesize_t convolve_fft_min_kernel = 16 * 16;
+
+
+
+// Fill `buf` with the float values of channels [chbegin,chend) of `src`
+// over [xbegin,xend) x [ybegin,yend) of its first plane, with coordinates
+// outside the data window clamped to its edges as WrapClamp would.
+static void
+get_clamped(const ImageBuf& src, int xbegin, int xend, int ybegin, int yend,
+            int chbegin, int chend, float* buf)
+{
+    const int nc = chend - chbegin;
+    const int w  = xend - xbegin;
+    const int x0 = clamp(xbegin, src.xbegin(), src.xend() - 1);
+    const int x1 = clamp(xend - 1, src.xbegin(), src.xend() - 1) + 1;
+    for (int y = ybegin; y < yend; ++y, buf += size_t(w) * nc) {
+        int sy = clamp(y, src.ybegin(), src.yend() - 1);
+        float* seg = buf + size_t(x0 - xbegin) * nc;
+        src.get_pixels(ROI(x0, x1, sy, sy + 1, src.zbegin(), src.zbegin() + 1,
+                           chbegin, chend),
+                       TypeFloat, seg);
+        for (float* p = buf; p < seg; p += nc)
+            std::copy(seg, seg + nc, p);
+        const float* last = buf + size_t(x1 - 1 - xbegin) * nc;
+        for (float* p = buf + size_t(x1 - xbegin) * nc;
+             p < buf + size_t(w) * nc; p += nc)
+            std::copy(last, last + nc, p);
+    }
+}
+
+
+
+// If the kernel is the outer product of a column and a row (to within
+// float precision), return true and those vectors, scaled so that
+// col[j] * row[i] is the kernel value.
+static bool
+separable_kernel(const ImageBuf& kernel, std::vector<float>& row,
+                 std::vector<float>& col)
+{
+    const int kw = kernel.spec().width, kh = kernel.spec().height;
+    const int kchans = kernel.nchannels();
+    const float* k   = (const float*)kernel.localpixels();
+    auto K = [=](int i, int j) { return k[(size_t(j) * kw + i) * kchans]; };
+    int i0 = 0, j0 = 0;
+    for (int j = 0; j < kh; ++j)
+        for (int i = 0; i < kw; ++i)
+            if (fabsf(K(i, j)) > fabsf(K(i0, j0))) {
+                i0 = i;
+                j0 = j;
+            }
+    const float p = K(i0, j0);
+    if (p == 0.0f)
+        return false;
+    row.resize(kw);
+    col.resize(kh);
+    for (int i = 0; i < kw; ++i)
+        row[i] = K(i, j0) / p;
+    for (int j = 0; j < kh; ++j)
+        col[j] = K(i0, j);
+    const float tol = 1.0e-6f * fabsf(p);
+    for (int j = 0; j < kh; ++j)
+        for (int i = 0; i < kw; ++i)
+            if (fabsf(K(i, j) - col[j] * row[i]) > tol)
+                return false;
+    return true;
+}
+
+
+
+// Convolution by a separable kernel as a horizontal pass by `row`
+// followed by a vertical pass by `col`. The horizontally filtered rows
+// are kept in a ring of kernel-height rows, so each is computed once.
+static bool
+convolve_separable(ImageBuf& dst, const ImageBuf& src, ROI kroi,
+                   const std::vector<float>& row, const std::vector<float>& col,
+                   float scale, ROI roi, int nthreads)
+{
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        const int nc = roi.nchannels();
+        const int kw = kroi.width(), kh = kroi.height();
+        const int w  = roi.width();
+        const size_t rowlen = size_t(w) * nc;
+        std::vector<float> in(size_t(w + kw - 1) * nc);
+        std::vector<float> ring(rowlen * kh);
+        std::vector<float> out(rowlen);
+        for (int j = 0; j < roi.height() + kh - 1; ++j) {
+            int y = roi.ybegin + kroi.ybegin + j;
+            get_clamped(src, roi.xbegin + kroi.xbegin,
+                        roi.xend + kroi.xend - 1, y, y + 1, roi.chbegin,
+                        roi.chend, in.data());
+            float* h = &ring[(j % kh) * rowlen];
+            std::fill(h, h + rowlen, 0.0f);
+            for (int i = 0; i < kw; ++i) {
+                const float wt = row[i];
+                const float* s = &in[size_t(i) * nc];
+                for (size_t v = 0; v < rowlen; ++v)
+                    h[v] += wt * s[v];
+            }
+            if (j < kh - 1)
+                continue;
+            // All the rows for output row j-(kh-1) are in the ring now
+            std::fill(out.begin(), out.end(), 0.0f);
+            for (int jj = 0; jj < kh; ++jj) {
+                const float wt = col[jj] * scale;
+                const float* r = &ring[((j - kh + 1 + jj) % kh) * rowlen];
+                for (size_t v = 0; v < rowlen; ++v)
+                    out[v] += wt * r[v];
+            }
+            int yout = roi.ybegin + j - (kh - 1);
+            dst.set_pixels(ROI(roi.xbegin, roi.xend, yout, yout + 1,
+                               roi.zbegin, roi.zend, roi.chbegin, roi.chend),
+                           TypeFloat, out.data());
+        }
+    });
+    return true;
+}
+
+
+
+// In-place 2D FFT of the w x h complex array `data`, using `tmp` (at
+// least 2*max(w,h) values) as scratch.
+static void
+fft2d(std::complex<float>* data, int w, int h, kissfft<float>& fx,
+      kissfft<float>& fy, std::complex<float>* tmp)
+{
+    for (int y = 0; y < h; ++y) {
+        fx.transform(data + size_t(y) * w, tmp);
+        std::copy(tmp, tmp + w, data + size_t(y) * w);
+    }
+    for (int x = 0; x < w; ++x) {
+        for (int y = 0; y < h; ++y)
+            tmp[y] = data[size_t(y) * w + x];
+        fy.transform(tmp, tmp + h);
+        for (int y = 0; y < h; ++y)
+            data[size_t(y) * w + x] = tmp[h + y];
+    }
+}
+
+
+
+// Convolution via FFT, for large kernels. The output is cut into tiles
+// that, padded by the kernel size, fit an FFT block; each tile's block of
+// (edge clamped) input is transformed, multiplied by the kernel's
+// spectrum, and transformed back (overlap-save), so tiles are independent
+// and the block size doesn't depend on the image size. As the kernel is
+// real, two channels are carried at once as the real and imaginary parts.
+static bool
+convolve_fft(ImageBuf& dst, const ImageBuf& src, const ImageBuf& kernel,
+             float scale, ROI roi, int nthreads)
+{
+    typedef std::complex<float> cpx;
+    const ROI kroi   = kernel.roi();
+    const int kw     = kroi.width(), kh = kroi.height();
+    const int kchans = kernel.nchannels();
+    const int fw     = ceil2(std::max(2 * kw, 64));
+    const int fh     = ceil2(std::max(2 * kh, 64));
+    const int tw = fw - kw + 1, th = fh - kh + 1;  // valid output per block
+    const size_t fsize = size_t(fw) * fh;
+
+    // Spectrum of the kernel, conjugated so that the product gives
+    // correlation like the direct loop, and with the normalization and
+    // the inverse transform's 1/(fw*fh) folded in.
+    std::vector<cpx> kspec(fsize, cpx(0.0f));
+    {
+        const float* k = (const float*)kernel.localpixels();
+        for (int j = 0; j < kh; ++j)
+            for (int i = 0; i < kw; ++i)
+                kspec[size_t(j) * fw + i] = k[(size_t(j) * kw + i) * kchans];
+        kissfft<float> fx(fw, false), fy(fh, false);
+        std::vector<cpx> tmp(2 * std::max(fw, fh));
+        fft2d(kspec.data(), fw, fh, fx, fy, tmp.data());
+        const float s = scale / float(fsize);
+        for (auto& v : kspec)
+            v = std::conj(v) * s;
+    }
+
+    const int ntx = (roi.width() + tw - 1) / tw;
+    const int nty = (roi.height() + th - 1) / th;
+    parallel_for_chunked(
+        0, int64_t(ntx) * nty, 1,
+        [&](int /*id*/, int64_t b, int64_t e) {
+            const int nc = roi.nchannels();
+            kissfft<float> fx(fw, false), fy(fh, false);
+            kissfft<float> ix(fw, true), iy(fh, true);
+            std::vector<float> in(fsize * nc), out(size_t(tw) * th * nc);
+            std::vector<cpx> block(fsize), tmp(2 * std::max(fw, fh));
+            for (int64_t t = b; t < e; ++t) {
+                int x0 = roi.xbegin + int(t % ntx) * tw;
+                int y0 = roi.ybegin + int(t / ntx) * th;
+                int cw = std::min(tw, roi.xend - x0);
+                int ch = std::min(th, roi.yend - y0);
+                get_clamped(src, x0 + kroi.xbegin, x0 + kroi.xbegin + fw,
+                            y0 + kroi.ybegin, y0 + kroi.ybegin + fh,
+                            roi.chbegin, roi.chend, in.data());
+                for (int c = 0; c < nc; c += 2) {
+                    bool pair = c + 1 < nc;
+                    for (size_t i = 0; i < fsize; ++i)
+                        block[i] = cpx(in[i * nc + c],
+                                       pair ? in[i * nc + c + 1] : 0.0f);
+                    fft2d(block.data(), fw, fh, fx, fy, tmp.data());
+                    for (size_t i = 0; i < fsize; ++i)
+                        block[i] *= kspec[i];
+                    fft2d(block.data(), fw, fh, ix, iy, tmp.data());
+                    for (int y = 0; y < ch; ++y)
+                        for (int x = 0; x < cw; ++x) {
+                            const cpx& v = block[size_t(y) * fw + x];
+                            float* o     = &out[(size_t(y) * cw + x) * nc];
+                            o[c]         = v.real();
+                            if (pair)
+                                o[c + 1] = v.imag();
+                        }
+                }
+                dst.set_pixels(ROI(x0, x0 + cw, y0, y0 + ch, roi.zbegin,
+                                   roi.zend, roi.chbegin, roi.chend),
+                               TypeFloat, out.data());
+            }
+        },
+        parallel_options(nthreads));
+    return true;
+}
+
+
+
 bool
 ImageBufAlgo::convolve(ImageBuf& dst, const ImageBuf& src,
                        const ImageBuf& kernel, bool normalize, ROI roi,
@@ -412,6 +647,26 @@ ImageBufAlgo::convolve(ImageBuf& dst, const ImageBuf& src,
         Ktmp.copy(kernel, TypeDesc::FLOAT);
         K = &Ktmp;
     }
+
+    // 2D images can skip the direct loop: a separable kernel is applied
+    // as two 1D passes, and a large one is applied by FFT.
+    ROI kroi = K->roi();
+    if (src.spec().depth == 1 && kroi.depth() == 1 && roi.depth() == 1
+        && kroi.npixels() > 1) {
+        float scale = 1.0f;
+        if (normalize) {
+            scale = 0.0f;
+            for (ImageBuf::ConstIterator<float> k(*K); !k.done(); ++k)
+                scale += k[0];
+            scale = 1.0f / scale;
+        }
+        std::vector<float> row, col;
+        if (separable_kernel(*K, row, col))
+            return convolve_separable(dst, src, kroi, row, col, scale, roi,
+                                      nthreads);
+        if (kroi.npixels() >= convolve_fft_min_kernel)
+            return convolve_fft(dst, src, *K, scale, roi, nthreads);
+    }
     OIIO_DISPATCH_COMMON_TYPES2(ok, "convolve", convolve_, dst.spec().format,
                                 src.spec().format, dst, src, *K, normalize, roi,
                                 nthreads);
@@ -671,7 +926,7 @@ median_filter_impl(ImageBuf& R, const ImageBuf& A, int width, int height,
             if (n) {
                 int mid = n / 2;
                 for (int c = 0; c < nchannels; ++c) {
-                    std::sort(chans[c] + 0, chans[c] + n);
+                    std::nth_element(chans[c], chans[c] + mid, chans[c] + n);
                     r[c] = chans[c][mid];
                 }
             } else {
@@ -685,6 +940,181 @@ median_filter_impl(ImageBuf& R, const ImageBuf& A, int width, int height,
 
 
 
+// Median filter of 8 bit data in constant time per pixel (Perreault &
+// Hebert): each column keeps a histogram of the window's rows, updated by
+// one pixel in and one out as the window moves down, and the window's
+// histogram is updated by one column histogram in and one out as it moves
+// across. As in median_filter_impl, the window is clipped to the data
+// window and the median is the (n/2)th smallest of the n values under it.
+static bool
+median_filter_hist8(ImageBuf& R, const ImageBuf& A, int width, int height,
+                    ROI roi, int nthreads)
+{
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        const int nc  = A.nchannels();
+        const int w_2 = std::max(1, width / 2);
+        const int h_2 = std::max(1, height / 2);
+        const int z   = roi.zbegin;
+        // The columns that any window of this strip covers
+        const int cx0   = std::max(roi.xbegin - w_2, A.xbegin());
+        const int cx1   = std::min(roi.xend - w_2 + width, A.xend());
+        const int ncols = std::max(0, cx1 - cx0);
+        std::vector<uint16_t> colhist(size_t(ncols) * nc * 256, 0);
+        std::vector<uint8_t> row(size_t(ncols) * nc);
+        std::vector<uint32_t> hist(size_t(nc) * 256);
+        std::vector<uint8_t> out(size_t(roi.width()) * nc);
+
+        auto addrow = [&](int y, bool add) {
+            if (y < A.ybegin() || y >= A.yend() || !ncols)
+                return;
+            A.get_pixels(ROI(cx0, cx1, y, y + 1, z, z + 1, 0, nc), TypeUInt8,
+                         row.data());
+            for (int i = 0, v = 0; i < ncols; ++i)
+                for (int c = 0; c < nc; ++c, ++v) {
+                    uint16_t& h = colhist[size_t(v) * 256 + row[v]];
+                    h           = add ? h + 1 : h - 1;
+                }
+        };
+        auto addcol = [&](int x, bool add) {
+            if (x < cx0 || x >= cx1)
+                return;
+            const uint16_t* ch = &colhist[size_t(x - cx0) * nc * 256];
+            if (add)
+                for (int b = 0; b < nc * 256; ++b)
+                    hist[b] += ch[b];
+            else
+                for (int b = 0; b < nc * 256; ++b)
+                    hist[b] -= ch[b];
+        };
+
+        for (int y = roi.ybegin - h_2; y < roi.ybegin - h_2 + height; ++y)
+            addrow(y, true);
+        for (int y = roi.ybegin; y < roi.yend; ++y) {
+            if (y > roi.ybegin) {
+                addrow(y - 1 - h_2, false);
+                addrow(y - 1 - h_2 + height, true);
+            }
+            const int nrows = std::max(0, std::min(y - h_2 + height,
+                                                   A.yend())
+                                              - std::max(y - h_2,
+                                                         A.ybegin()));
+            std::fill(hist.begin(), hist.end(), 0);
+            for (int x = roi.xbegin - w_2; x < roi.xbegin - w_2 + width; ++x)
+                addcol(x, true);
+            for (int x = roi.xbegin; x < roi.xend; ++x) {
+                if (x > roi.xbegin) {
+                    addcol(x - 1 - w_2, false);
+                    addcol(x - 1 - w_2 + width, true);
+                }
+                const int n = nrows
+                              * std::max(0, std::min(x - w_2 + width, cx1)
+                                                - std::max(x - w_2, cx0));
+                uint8_t* o = &out[size_t(x - roi.xbegin) * nc];
+                for (int c = 0; c < nc; ++c) {
+                    o[c] = 0;
+                    if (!n)
+                        continue;
+                    const uint32_t* h = &hist[size_t(c) * 256];
+                    uint32_t mid = n / 2, acc = 0;
+                    for (int b = 0; b < 256; ++b) {
+                        acc += h[b];
+                        if (acc > mid) {
+                            o[c] = uint8_t(b);
+                            break;
+                        }
+                    }
+                }
+            }
+            R.set_pixels(ROI(roi.xbegin, roi.xend, y, y + 1, z, z + 1, 0, nc),
+                         TypeUInt8, out.data());
+        }
+    });
+    return true;
+}
+
+
+
+// Median filter of 16 bit data with a sliding window histogram (Huang):
+// as the window moves across a row, one column of pixels leaves it and one
+// enters. A coarse histogram of the high bytes finds the block of 256
+// values holding the median without walking all 65536 bins. Same window
+// and median conventions as median_filter_hist8.
+static bool
+median_filter_hist16(ImageBuf& R, const ImageBuf& A, int width, int height,
+                     ROI roi, int nthreads)
+{
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        const int nc    = A.nchannels();
+        const int w_2   = std::max(1, width / 2);
+        const int h_2   = std::max(1, height / 2);
+        const int z     = roi.zbegin;
+        const int cx0   = std::max(roi.xbegin - w_2, A.xbegin());
+        const int cx1   = std::min(roi.xend - w_2 + width, A.xend());
+        const int ncols = std::max(0, cx1 - cx0);
+        std::vector<uint16_t> block(size_t(ncols) * height * nc);
+        std::vector<uint32_t> fine(size_t(nc) * 65536);
+        std::vector<uint32_t> coarse(size_t(nc) * 256);
+        std::vector<uint16_t> out(size_t(roi.width()) * nc);
+
+        for (int y = roi.ybegin; y < roi.yend; ++y) {
+            const int ry0 = std::max(y - h_2, A.ybegin());
+            const int ry1 = std::min(y - h_2 + height, A.yend());
+            const int nrows = std::max(0, ry1 - ry0);
+            if (nrows && ncols)
+                A.get_pixels(ROI(cx0, cx1, ry0, ry1, z, z + 1, 0, nc),
+                             TypeUInt16, block.data());
+            std::fill(fine.begin(), fine.end(), 0);
+            std::fill(coarse.begin(), coarse.end(), 0);
+            auto addcol = [&](int x, bool add) {
+                if (x < cx0 || x >= cx1)
+                    return;
+                for (int j = 0; j < nrows; ++j) {
+                    const uint16_t* p
+                        = &block[(size_t(j) * ncols + (x - cx0)) * nc];
+                    for (int c = 0; c < nc; ++c) {
+                        uint32_t& f = fine[size_t(c) * 65536 + p[c]];
+                        uint32_t& k = coarse[size_t(c) * 256 + (p[c] >> 8)];
+                        f           = add ? f + 1 : f - 1;
+                        k           = add ? k + 1 : k - 1;
+                    }
+                }
+            };
+            for (int x = roi.xbegin - w_2; x < roi.xbegin - w_2 + width; ++x)
+                addcol(x, true);
+            for (int x = roi.xbegin; x < roi.xend; ++x) {
+                if (x > roi.xbegin) {
+                    addcol(x - 1 - w_2, false);
+                    addcol(x - 1 - w_2 + width, true);
+                }
+                const int n = nrows
+                              * std::max(0, std::min(x - w_2 + width, cx1)
+                                                - std::max(x - w_2, cx0));
+                uint16_t* o = &out[size_t(x - roi.xbegin) * nc];
+                for (int c = 0; c < nc; ++c) {
+                    o[c] = 0;
+                    if (!n)
+                        continue;
+                    const uint32_t* k = &coarse[size_t(c) * 256];
+                    uint32_t mid = n / 2, acc = 0;
+                    int hi = 0;
+                    while (acc + k[hi] <= mid)
+                        acc += k[hi++];
+                    const uint32_t* f = &fine[size_t(c) * 65536 + hi * 256];
+                    int lo = 0;
+                    while (acc + f[lo] <= mid)
+                        acc += f[lo++];
+                    o[c] = uint16_t(hi * 256 + lo);
+                }
+            }
+            R.set_pixels(ROI(roi.xbegin, roi.xend, y, y + 1, z, z + 1, 0, nc),
+                         TypeUInt16, out.data());
+        }
+    });
+    return true;
+}
+
+
+
 bool
 ImageBufAlgo::median_filter(ImageBuf& dst, const ImageBuf& src, int width,
                             int height, ROI roi, int nthreads)
@@ -694,6 +1124,16 @@ ImageBufAlgo::median_filter(ImageBuf& dst, const ImageBuf& src, int width,
                  IBAprep_REQUIRE_SAME_NCHANNELS | IBAprep_NO_SUPPORT_VOLUME))
         return false;
 
+    if (width < 1)
+        width = 1;
+    if (height < 1)
+        height = width;
+    // 8 and 16 bit images use histograms, at a cost that doesn't depend
+    // on the window size.
+    if (src.spec().format == TypeUInt8 && height < 65536)
+        return median_filter_hist8(dst, src, width, height, roi, nthreads);
+    if (src.spec().format == TypeUInt16)
+        return median_filter_hist16(dst, src, width, height, roi, nthreads);
     bool ok;
     OIIO_DISPATCH_COMMON_TYPES2(ok, "median_filter", median_filter_impl,
                                 dst.spec().format, src.spec().format, dst, src,
@@ -718,48 +1158,82 @@ ImageBufAlgo::median_filter(const ImageBuf& src, int width, int height, ROI roi,
 
 enum MorphOp { MorphDilate, MorphErode };
 
-template<class Rtype, class Atype>
+// Running max (or min) over windows of `k` values of the `n` vectors of
+// `len` floats at `in`, `in + len`, ..., in time independent of `k` (van
+// Herk / Gil-Werman): g is the running max from the start of each block
+// of k, h the running max to the end of it, and a window straddles at most
+// one block boundary. Window i covers vectors [i, i+k), for i < n-k+1, and
+// its result goes to out[i]. `g` must hold n vectors; `h` may be `in`,
+// which is overwritten.
+template<class OP>
+static void
+van_herk(float* in, float* g, float* out, int n, int k, size_t len, OP op)
+{
+    for (int i = 0; i < n; ++i) {
+        float* gi       = g + i * len;
+        const float* gp = gi - len;
+        const float* xi = in + i * len;
+        if (i % k == 0)
+            std::copy(xi, xi + len, gi);
+        else
+            for (size_t v = 0; v < len; ++v)
+                gi[v] = op(gp[v], xi[v]);
+    }
+    float* h = in;
+    for (int i = n - 2; i >= 0; --i)
+        if (i % k != k - 1)
+            for (size_t v = 0; v < len; ++v)
+                h[i * len + v] = op(h[i * len + v], h[(i + 1) * len + v]);
+    for (int i = 0; i + k <= n; ++i)
+        for (size_t v = 0; v < len; ++v)
+            out[i * len + v] = op(h[i * len + v], g[(i + k - 1) * len + v]);
+}
+
+
+
+template<class OP>
 static bool
-morph_impl(ImageBuf& R, const ImageBuf& A, int width, int height, MorphOp op,
-           ROI roi, int nthreads)
+morph_impl(ImageBuf& R, const ImageBuf& A, int width, int height, OP op,
+           float identity, ROI roi, int nthreads)
 {
+    // Rows of output are done in chunks, so that the horizontally filtered
+    // rows that the vertical pass needs don't grow with the image.
+    const int chunk = std::max(64, height);
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        if (width < 1)
-            width = 1;
-        if (height < 1)
-            height = width;
-        int w_2       = std::max(1, width / 2);
-        int h_2       = std::max(1, height / 2);
-        int nchannels = R.nchannels();
-        float* vals   = OIIO_ALLOCA(float, nchannels);
-        ImageBuf::ConstIterator<Atype> a(A, roi);
-        for (ImageBuf::Iterator<Rtype> r(R, roi); !r.done(); ++r) {
-            a.rerange(r.x() - w_2, r.x() - w_2 + width, r.y() - h_2,
-                      r.y() - h_2 + height, r.z(), r.z() + 1,
-                      ImageBuf::WrapClamp);
-            if (op == MorphDilate) {
-                for (int c = 0; c < nchannels; ++c)
-                    vals[c] = -std::numeric_limits<float>::max();
-                for (; !a.done(); ++a) {
-                    if (a.exists()) {
-                        for (int c = 0; c < nchannels; ++c)
-                            vals[c] = std::max(vals[c], a[c]);
-                    }
+        const int nc  = A.nchannels();
+        const int w_2 = std::max(1, width / 2);
+        const int h_2 = std::max(1, height / 2);
+        const int z   = roi.zbegin;
+        const int w   = roi.width();
+        const size_t rowlen = size_t(w) * nc;
+        // Input span of a row, with identity outside the data window so
+        // that the windows are effectively clipped to it.
+        const int ex0 = roi.xbegin - w_2, elen = w + width - 1;
+        const int cx0 = std::max(ex0, A.xbegin());
+        const int cx1 = std::min(ex0 + elen, A.xend());
+        std::vector<float> ext(size_t(elen) * nc), eg(ext.size());
+        std::vector<float> hrows(size_t(chunk + height - 1) * rowlen);
+        std::vector<float> vg(hrows.size());
+        std::vector<float> out(size_t(chunk) * rowlen);
+        for (int y0 = roi.ybegin; y0 < roi.yend; y0 += chunk) {
+            const int y1 = std::min(y0 + chunk, roi.yend);
+            const int nin = y1 - y0 + height - 1;
+            for (int j = 0; j < nin; ++j) {
+                float* hr = &hrows[j * rowlen];
+                int y     = y0 - h_2 + j;
+                if (y < A.ybegin() || y >= A.yend() || cx0 >= cx1) {
+                    std::fill(hr, hr + rowlen, identity);
+                    continue;
                 }
-            } else if (op == MorphErode) {
-                for (int c = 0; c < nchannels; ++c)
-                    vals[c] = std::numeric_limits<float>::max();
-                for (; !a.done(); ++a) {
-                    if (a.exists()) {
-                        for (int c = 0; c < nchannels; ++c)
-                            vals[c] = std::min(vals[c], a[c]);
-                    }
-                }
-            } else {
-                OIIO_ASSERT(0 && "Unknown morphological operator");
+                std::fill(ext.begin(), ext.end(), identity);
+                A.get_pixels(ROI(cx0, cx1, y, y + 1, z, z + 1, 0, nc),
+                             TypeFloat, &ext[size_t(cx0 - ex0) * nc]);
+                van_herk(ext.data(), eg.data(), hr, elen, width, nc, op);
             }
-            for (int c = 0; c < nchannels; ++c)
-                r[c] = vals[c];
+            van_herk(hrows.data(), vg.data(), out.data(), nin, height, rowlen,
+                     op);
+            R.set_pixels(ROI(roi.xbegin, roi.xend, y0, y1, z, z + 1, 0, nc),
+                         TypeFloat, out.data());
         }
     });
     return true;
@@ -767,6 +1241,24 @@ morph_impl(ImageBuf& R, const ImageBuf& A, int width, int height, MorphOp op,
 
 
 
+static bool
+morph(ImageBuf& R, const ImageBuf& A, int width, int height, MorphOp op,
+      ROI roi, int nthreads)
+{
+    if (width < 1)
+        width = 1;
+    if (height < 1)
+        height = width;
+    const float big = std::numeric_limits<float>::max();
+    auto maxop      = [](float a, float b) { return std::max(a, b); };
+    auto minop      = [](float a, float b) { return std::min(a, b); };
+    if (op == MorphDilate)
+        return morph_impl(R, A, width, height, maxop, -big, roi, nthreads);
+    return morph_impl(R, A, width, height, minop, big, roi, nthreads);
+}
+
+
+
 bool
 ImageBufAlgo::dilate(ImageBuf& dst, const ImageBuf& src, int width, int height,
                      ROI roi, int nthreads)
@@ -776,11 +1268,7 @@ ImageBufAlgo::dilate(ImageBuf& dst, const ImageBuf& src, int width, int height,
                  IBAprep_REQUIRE_SAME_NCHANNELS | IBAprep_NO_SUPPORT_VOLUME))
         return false;
 
-    bool ok;
-    OIIO_DISPATCH_COMMON_TYPES2(ok, "dilate", morph_impl, dst.spec().format,
-                                src.spec().format, dst, src, width, height,
-                                MorphDilate, roi, nthreads);
-    return ok;
+    return morph(dst, src, width, height, MorphDilate, roi, nthreads);
 }
 
 
@@ -807,11 +1295,7 @@ ImageBufAlgo::erode(ImageBuf& dst, const ImageBuf& src, int width, int height,
                  IBAprep_REQUIRE_SAME_NCHANNELS | IBAprep_NO_SUPPORT_VOLUME))
         return false;
 
-    bool ok;
-    OIIO_DISPATCH_COMMON_TYPES2(ok, "erode", morph_impl, dst.spec().format,
-                                src.spec().format, dst, src, width, height,
-                                MorphErode, roi, nthreads);
-    return ok;
+    return morph(dst, src, width, height, MorphErode, roi, nthreads);
 }
 
 
@@ -1134,26 +1618,75 @@ ImageBufAlgo::complex_to_polar(const ImageBuf& src, ROI roi, int nthreads)
 
 
 
-// Helper for fillholes_pp: for any nonzero alpha pixels in dst, divide
-// all components by alpha.
-static bool
-divide_by_alpha(ImageBuf& dst, ROI roi, int nthreads)
-{
-    OIIO_ASSERT(dst.spec().format == TypeDesc::FLOAT);
-    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        const ImageSpec& spec(dst.spec());
-        int nc = spec.nchannels;
-        int ac = spec.alpha_channel;
-        for (ImageBuf::Iterator<float> d(dst, roi); !d.done(); ++d) {
-            float alpha = d[ac];
-            if (alpha != 0.0f) {
+// Helper for fillholes_pushpull: the taps of a 1D resize from `srcres` to
+// `dstres` pixels, with the same triangle filter weights that
+// resize(..., "triangle") uses (a 1-3-3-1 kernel when halving, linear
+// interpolation when doubling). Taps outside [0,srcres) are clamped to
+// the edge.
+namespace {
+struct PushPullTaps {
+    int ntaps;                  // taps per destination pixel
+    std::vector<int> first;     // first source pixel of each one's taps
+    std::vector<float> weight;  // ntaps normalized weights for each one
+
+    PushPullTaps(int srcres, int dstres)
+    {
+        float ratio  = float(dstres) / float(srcres);
+        float width  = 2.0f * std::max(1.0f, ratio);
+        float radinv = 2.0f / width;
+        int rad      = (int)ceilf((width / 2.0f) / ratio);
+        ntaps        = 2 * rad + 1;
+        first.resize(dstres);
+        weight.resize(size_t(dstres) * ntaps);
+        for (int x = 0; x < dstres; ++x) {
+            float src_xf = (x + 0.5f) * (1.0f / dstres) * srcres;
+            int src_x;
+            float frac = floorfrac(src_xf, &src_x);
+            float* w   = &weight[size_t(x) * ntaps];
+            float sum  = 0.0f;
+            for (int i = 0; i < ntaps; ++i) {
+                float d = fabsf(ratio * (i - rad - (frac - 0.5f)) * radinv);
+                w[i]    = d < 1.0f ? 1.0f - d : 0.0f;
+                sum += w[i];
+            }
+            if (sum != 0.0f)
+                for (int i = 0; i < ntaps; ++i)
+                    w[i] /= sum;
+            first[x] = src_x - rad;
+        }
+    }
+
+    // Filter the `nc` channel float image `src` (of `srcw` x `srch`
+    // pixels) at destination pixel (x,y) into `result`, using these taps
+    // in x and `ytaps` in y.
+    void sample(const PushPullTaps& ytaps, const float* src, int srcw,
+                int srch, int nc, int x, int y, float* result) const
+    {
+        const float* wx = &weight[size_t(x) * ntaps];
+        const float* wy = &ytaps.weight[size_t(y) * ytaps.ntaps];
+        float* h        = OIIO_ALLOCA(float, nc);
+        for (int c = 0; c < nc; ++c)
+            result[c] = 0.0f;
+        for (int j = 0; j < ytaps.ntaps; ++j) {
+            if (wy[j] == 0.0f)
+                continue;
+            int sy = OIIO::clamp(ytaps.first[y] + j, 0, srch - 1);
+            for (int c = 0; c < nc; ++c)
+                h[c] = 0.0f;
+            for (int i = 0; i < ntaps; ++i) {
+                if (wx[i] == 0.0f)
+                    continue;
+                int sx         = OIIO::clamp(first[x] + i, 0, srcw - 1);
+                const float* p = src + (size_t(sy) * srcw + sx) * nc;
                 for (int c = 0; c < nc; ++c)
-                    d[c] = d[c] / alpha;
+                    h[c] += wx[i] * p[c];
             }
+            for (int c = 0; c < nc; ++c)
+                result[c] += wy[j] * h[c];
         }
-    });
-    return true;
-}
+    }
+};
+}  // namespace
 
 
 
@@ -1161,58 +1694,128 @@ bool
 ImageBufAlgo::fillholes_pushpull(ImageBuf& dst, const ImageBuf& src, ROI roi,
                                  int nthreads)
 {
-    // N.B. Don't log time, it will be caught by the constituent parts
+    pvt::LoggedTimer logtime("IBA::fillholes_pushpull");
     const int req = (IBAprep_REQUIRE_SAME_NCHANNELS | IBAprep_REQUIRE_ALPHA
                      | IBAprep_NO_SUPPORT_VOLUME);
     if (!IBAprep(roi, &dst, &src, req))
         return false;
-    // We generate a bunch of temp images to form an image pyramid.
-    // These give us a place to stash them and make sure they are
-    // auto-deleted when the function exits.
-    std::vector<std::shared_ptr<ImageBuf>> pyramid;
-
-    // First, make a writable copy of the original image (converting
-    // to float as a convenience) as the top level of the pyramid.
-    ImageSpec topspec = src.spec();
+    const ImageSpec& srcspec(src.spec());
+    const int nc = srcspec.nchannels;
+    const int ac = srcspec.alpha_channel;
+    const int zc = srcspec.z_channel;
+
+    // The whole pyramid lives in one buffer: the top level is a float copy
+    // of the original image, and each level below it is half the size of
+    // the one above.
+    struct Level {
+        int width, height;
+        float* pixels;
+    };
+    std::vector<Level> levels;
+    size_t total = 0;
+    for (int w = srcspec.width, h = srcspec.height;; w /= 2, h /= 2) {
+        w = std::max(1, w);
+        h = std::max(1, h);
+        levels.push_back({ w, h, nullptr });
+        total += size_t(w) * h * nc;
+        if (w == 1 && h == 1)
+            break;
+    }
+    std::unique_ptr<float[]> buffer(new float[total]);
+    float* p = buffer.get();
+    for (auto& level : levels) {
+        level.pixels = p;
+        p += size_t(level.width) * level.height * nc;
+    }
+    ImageSpec topspec = srcspec;
     topspec.set_format(TypeDesc::FLOAT);
-    ImageBuf* top = new ImageBuf(topspec);
-    paste(*top, topspec.x, topspec.y, topspec.z, 0, src);
-    pyramid.emplace_back(top);
-
-    // Construct the rest of the pyramid by successive x/2 resizing and
-    // then dividing nonzero alpha pixels by their alpha (this "spreads
-    // out" the defined part of the image).
-    int w = src.spec().width, h = src.spec().height;
-    while (w > 1 || h > 1) {
-        w = std::max(1, w / 2);
-        h = std::max(1, h / 2);
-        ImageSpec smallspec(w, h, src.nchannels(), TypeDesc::FLOAT);
-        smallspec.alpha_channel = topspec.alpha_channel;
-        ImageBuf* small         = new ImageBuf(smallspec);
-        ImageBufAlgo::resize(*small, *pyramid.back(), "triangle");
-        divide_by_alpha(*small, get_roi(smallspec), nthreads);
-        pyramid.emplace_back(small);
-        // small->write(Strutil::sprintf("push%04d.exr", small->spec().width));
+    ImageBuf top(topspec, levels[0].pixels);
+    src.get_pixels(get_roi(srcspec), TypeFloat, levels[0].pixels);
+
+    // Is any pixel of the level not fully opaque?
+    auto has_holes = [&](const Level& level) {
+        std::atomic<bool> holes(false);
+        ImageBufAlgo::parallel_image(
+            ROI(0, level.width, 0, level.height), nthreads, [&](ROI r) {
+                for (int y = r.ybegin; y < r.yend && !holes; ++y) {
+                    const float* a = level.pixels
+                                     + size_t(y) * level.width * nc + ac;
+                    for (int x = 0; x < level.width; ++x, a += nc)
+                        if (!(*a >= 1.0f)) {
+                            holes = true;
+                            break;
+                        }
+                }
+            });
+        return bool(holes);
+    };
+
+    // Push: construct each level from the one above it by a triangle
+    // filtered x/2 resize, then dividing nonzero alpha pixels by their
+    // alpha (this "spreads out" the defined part of the image). Once a
+    // level has no holes, none of the smaller levels are needed.
+    size_t nlevels = 1;
+    while (nlevels < levels.size() && has_holes(levels[nlevels - 1])) {
+        const Level& big(levels[nlevels - 1]);
+        const Level& small(levels[nlevels]);
+        PushPullTaps xtaps(big.width, small.width);
+        PushPullTaps ytaps(big.height, small.height);
+        ImageBufAlgo::parallel_image(
+            ROI(0, small.width, 0, small.height), nthreads, [&](ROI r) {
+                for (int y = r.ybegin; y < r.yend; ++y) {
+                    float* d = small.pixels
+                               + (size_t(y) * small.width + r.xbegin) * nc;
+                    for (int x = r.xbegin; x < r.xend; ++x, d += nc) {
+                        xtaps.sample(ytaps, big.pixels, big.width,
+                                     big.height, nc, x, y, d);
+                        float alpha = d[ac];
+                        if (alpha != 0.0f)
+                            for (int c = 0; c < nc; ++c)
+                                d[c] = d[c] / alpha;
+                    }
+                }
+            });
+        ++nlevels;
     }
 
-    // Now pull back up the pyramid by doing an alpha composite of level
-    // i over a resized level i+1, thus filling in the alpha holes.  By
-    // time we get to the top, pixels whose original alpha are
-    // unchanged, those with alpha < 1 are replaced by the blended
-    // colors of the higher pyramid levels.
-    for (int i = (int)pyramid.size() - 2; i >= 0; --i) {
-        ImageBuf &big(*pyramid[i]), &small(*pyramid[i + 1]);
-        ImageBuf blowup(big.spec());
-        ImageBufAlgo::resize(blowup, small, "triangle");
-        ImageBufAlgo::over(big, big, blowup);
-        // big.write(Strutil::sprintf("pull%04d.exr", big.spec().width));
+    // Pull: back up the pyramid, composite each level over the resized
+    // level below it, thus filling in the alpha holes. Opaque pixels are
+    // unchanged by that, so only the others need the level below. By the
+    // time we get to the top, pixels whose original alpha was 1 are
+    // unchanged, and those with alpha < 1 are replaced by the blended
+    // colors of the smaller pyramid levels.
+    for (int i = int(nlevels) - 2; i >= 0; --i) {
+        const Level& big(levels[i]);
+        const Level& small(levels[i + 1]);
+        const int z = i == 0 ? zc : -1;
+        PushPullTaps xtaps(small.width, big.width);
+        PushPullTaps ytaps(small.height, big.height);
+        ImageBufAlgo::parallel_image(
+            ROI(0, big.width, 0, big.height), nthreads, [&](ROI r) {
+                float* s = OIIO_ALLOCA(float, nc);
+                for (int y = r.ybegin; y < r.yend; ++y) {
+                    float* b = big.pixels
+                               + (size_t(y) * big.width + r.xbegin) * nc;
+                    for (int x = r.xbegin; x < r.xend; ++x, b += nc) {
+                        float alpha = OIIO::clamp(b[ac], 0.0f, 1.0f);
+                        if (alpha >= 1.0f)
+                            continue;
+                        xtaps.sample(ytaps, small.pixels, small.width,
+                                     small.height, nc, x, y, s);
+                        float bz = z >= 0 ? b[z] : 0.0f;
+                        for (int c = 0; c < nc; ++c)
+                            b[c] = b[c] + (1.0f - alpha) * s[c];
+                        if (z >= 0)
+                            b[z] = alpha != 0.0f ? bz : s[z];
+                    }
+                }
+            });
     }
 
     // Now copy the completed base layer of the pyramid back to the
     // original requested output.
-    paste(dst, src.spec().x, src.spec().y, src.spec().z, 0, *pyramid[0]);
-
-    return true;
+    paste(dst, srcspec.x, srcspec.y, srcspec.z, 0, top);
+    return !dst.has_error();
 }
 
 
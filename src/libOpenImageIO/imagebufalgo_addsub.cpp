@@ -45,6 +45,20 @@ static bool
 add_impl(ImageBuf& R, const ImageBuf& A, cspan<float> b, ROI roi, int nthreads)
 {
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        // Float to float, the common case, runs over raw rows
+        if (std::is_same<Rtype, float>::value
+            && std::is_same<Atype, float>::value
+            && ImageBufAlgo::has_row_spans<Atype>(A, roi)) {
+            const int rn = R.nchannels(), an = A.nchannels();
+            auto addrow  = [&](span<Rtype> r, int y, int z) {
+                auto a = (const Atype*)A.pixeladdr(roi.xbegin, y, z);
+                for (int x = 0, w = roi.width(); x < w; ++x)
+                    for (int c = roi.chbegin; c < roi.chend; ++c)
+                        r[x * rn + c] = Rtype(float(a[x * an + c]) + b[c]);
+            };
+            if (ImageBufAlgo::for_each_row<Rtype>(R, roi, addrow))
+                return;
+        }
         ImageBuf::Iterator<Rtype> r(R, roi);
         ImageBuf::ConstIterator<Atype> a(A, roi);
         for (; !r.done(); ++r, ++a)
@@ -133,6 +133,27 @@ ImageBufAlgo::channels(ImageBuf& dst, const ImageBuf& src, int nchannels,
     if (all_same_type)                   // clear per-chan formats if
         newspec.channelformats.clear();  // they're all the same
 
+    // A run of consecutive channels of an in-memory image needs no copy:
+    // view them in place (see ImageBuf::view()), sharing src's pixels
+    // until one of the two is written to.
+    if (all_same_type && !src.deep()) {
+        int first = channelorder[0];
+        bool run  = first >= 0 && first + nchannels <= src.nchannels();
+        for (int c = 1; c < nchannels && run; ++c)
+            run = (channelorder[c] == first + c);
+        if (run) {
+            ROI roi       = src.roi();
+            roi.chbegin   = first;
+            roi.chend     = first + nchannels;
+            ImageBuf view = src.view(roi);
+            if (view.initialized()) {
+                view.specmod() = newspec;
+                dst            = std::move(view);
+                return true;
+            }
+        }
+    }
+
     // Update the image (realloc with the new spec)
     dst.reset(newspec);
 
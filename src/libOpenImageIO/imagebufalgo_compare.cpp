@@ -6,9 +6,12 @@
 /// Implementation of ImageBufAlgo algorithms that analyze or compare
 /// images.
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
 #include <iostream>
 #include <limits>
+#include <vector>
 
 #include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
@@ -117,6 +120,146 @@ finalize(ImageBufAlgo::PixelStats& p)
 
 
 
+// Add the stats of channels [cb,ce) of `npix` pixels of `nc` floats at
+// `p` to `st`. Partial results are kept in float for groups of pixels, one
+// lane per value of the group so the inner loop is contiguous and
+// vectorizes, then summed per channel into the double totals for each
+// chunk. A chunk that turns out to hold a NaN or Inf is redone with val().
+static void
+stats_values(const float* p, int npix, int nc, int cb, int ce,
+             ImageBufAlgo::PixelStats& st)
+{
+    constexpr int group = 8;    // pixels per group
+    constexpr int chunk = 512;  // pixels per float partial sum
+    const int len       = group * nc;
+    float* s            = OIIO_ALLOCA(float, 5 * len);
+    float *s2 = s + len, *mn = s2 + len, *mx = mn + len, *chk = mx + len;
+    const float inf = std::numeric_limits<float>::infinity();
+    int i = 0;
+    while (i + group <= npix) {
+        const int ngroups = std::min(chunk, npix - i) / group;
+        std::fill(s, s + 2 * len, 0.0f);
+        std::fill(mn, mn + len, inf);
+        std::fill(mx, mx + len, -inf);
+        std::fill(chk, chk + len, 0.0f);
+        for (int g = 0; g < ngroups; ++g) {
+            const float* q = p + size_t(g) * len;
+            for (int v = 0; v < len; ++v) {
+                float x = q[v];
+                s[v] += x;
+                s2[v] += x * x;
+                mn[v] = x < mn[v] ? x : mn[v];
+                mx[v] = x > mx[v] ? x : mx[v];
+                chk[v] += x * 0.0f;  // NaN unless x is finite
+            }
+        }
+        const int n = ngroups * group;
+        if (std::any_of(chk, chk + len, [](float x) { return x != 0.0f; })) {
+            for (int j = 0; j < n; ++j)
+                for (int c = cb; c < ce; ++c)
+                    val(st, c, p[size_t(j) * nc + c]);
+        } else {
+            for (int c = cb; c < ce; ++c) {
+                double sum = 0.0, sum2 = 0.0;
+                for (int k = 0; k < group; ++k) {
+                    sum += s[k * nc + c];
+                    sum2 += s2[k * nc + c];
+                    st.min[c] = std::min(st.min[c], mn[k * nc + c]);
+                    st.max[c] = std::max(st.max[c], mx[k * nc + c]);
+                }
+                st.sum[c] += sum;
+                st.sum2[c] += sum2;
+                st.finitecount[c] += n;
+            }
+        }
+        i += n;
+        p += size_t(n) * nc;
+    }
+    for (; i < npix; ++i, p += nc)
+        for (int c = cb; c < ce; ++c)
+            val(st, c, p[c]);
+}
+
+
+
+// Stats of a row of native values: convert to float, then stats_values().
+template<class T>
+inline void
+stats_row(cspan<T> row, int nc, int cb, int ce, ImageBufAlgo::PixelStats& st,
+          std::vector<float>& buf)
+{
+    const int n = int(row.size());
+    buf.resize(n);
+    for (int v = 0; v < n; ++v)
+        buf[v] = convert_type<T, float>(row[v]);
+    stats_values(buf.data(), int(row.size() / nc), nc, cb, ce, st);
+}
+
+template<>
+inline void
+stats_row(cspan<float> row, int nc, int cb, int ce,
+          ImageBufAlgo::PixelStats& st, std::vector<float>& /*buf*/)
+{
+    stats_values(row.data(), int(row.size() / nc), nc, cb, ce, st);
+}
+
+// uint8 is always finite and its sums are exact in integers, so it skips
+// the conversion to float entirely.
+template<>
+inline void
+stats_row(cspan<unsigned char> row, int nc, int cb, int ce,
+          ImageBufAlgo::PixelStats& st, std::vector<float>& /*buf*/)
+{
+    constexpr int group = 16;
+    constexpr int chunk = 4096;  // 255*255*chunk/group fits in uint32
+    const int len       = group * nc;
+    const int npix      = int(row.size() / nc);
+    uint32_t* s         = OIIO_ALLOCA(uint32_t, 2 * len);
+    uint32_t* s2        = s + len;
+    unsigned char* mn   = OIIO_ALLOCA(unsigned char, 2 * len);
+    unsigned char* mx   = mn + len;
+    const unsigned char* p = row.data();
+    int i                  = 0;
+    while (i + group <= npix) {
+        const int ngroups = std::min(chunk, npix - i) / group;
+        std::fill(s, s + 2 * len, 0u);
+        std::fill(mn, mn + len, 255);
+        std::fill(mx, mx + len, 0);
+        for (int g = 0; g < ngroups; ++g, p += len) {
+            for (int v = 0; v < len; ++v) {
+                uint32_t x = p[v];
+                s[v] += x;
+                s2[v] += x * x;
+                mn[v] = p[v] < mn[v] ? p[v] : mn[v];
+                mx[v] = p[v] > mx[v] ? p[v] : mx[v];
+            }
+        }
+        for (int c = cb; c < ce; ++c) {
+            uint64_t sum = 0, sum2 = 0;
+            unsigned char lo = 255, hi = 0;
+            for (int k = 0; k < group; ++k) {
+                sum += s[k * nc + c];
+                sum2 += s2[k * nc + c];
+                lo = std::min(lo, mn[k * nc + c]);
+                hi = std::max(hi, mx[k * nc + c]);
+            }
+            st.sum[c] += double(sum) / 255.0;
+            st.sum2[c] += double(sum2) / (255.0 * 255.0);
+            st.min[c] = std::min(st.min[c],
+                                 convert_type<unsigned char, float>(lo));
+            st.max[c] = std::max(st.max[c],
+                                 convert_type<unsigned char, float>(hi));
+            st.finitecount[c] += ngroups * group;
+        }
+        i += ngroups * group;
+    }
+    for (; i < npix; ++i, p += nc)
+        for (int c = cb; c < ce; ++c)
+            val(st, c, convert_type<unsigned char, float>(p[c]));
+}
+
+
+
 template<class T>
 static bool
 computePixelStats_(const ImageBuf& src, ImageBufAlgo::PixelStats& stats,
@@ -162,11 +305,20 @@ computePixelStats_(const ImageBuf& src, ImageBufAlgo::PixelStats& stats,
             ROI subroi(roi.xbegin, roi.xend, ybegin, yend, roi.zbegin,
                        roi.zend, roi.chbegin, roi.chend);
             ImageBufAlgo::PixelStats tmp(nchannels);
-            for (ImageBuf::ConstIterator<T> s(src, subroi); !s.done();
-                 ++s) {
-                for (int c = subroi.chbegin; c < subroi.chend; ++c) {
-                    float value = s[c];
-                    val(tmp, c, value);
+            // Local pixels go a row at a time, straight from memory
+            std::vector<float> buf;
+            bool rows = ImageBufAlgo::for_each_row<T>(src, subroi,
+                            [&](cspan<T> row, int /*y*/, int /*z*/) {
+                stats_row(row, nchannels, subroi.chbegin, subroi.chend, tmp,
+                          buf);
+            });
+            if (!rows) {
+                for (ImageBuf::ConstIterator<T> s(src, subroi); !s.done();
+                     ++s) {
+                    for (int c = subroi.chbegin; c < subroi.chend; ++c) {
+                        float value = s[c];
+                        val(tmp, c, value);
+                    }
                 }
             }
             std::lock_guard<OIIO::spin_mutex> lock(mutex);
@@ -377,6 +529,102 @@ ImageBufAlgo::compare(const ImageBuf& A, const ImageBuf& B, float failthresh,
 
 
 
+template<class Atype, class Btype>
+static bool
+compare_fastfail_(const ImageBuf& A, const ImageBuf& B, float failthresh,
+                  imagesize_t maxfail, float hardfail, ROI roi, int nthreads)
+{
+    const int Achannels = A.nchannels(), Bchannels = B.nchannels();
+    const float inf     = std::numeric_limits<float>::infinity();
+    std::atomic<imagesize_t> nfail(0);
+    std::atomic<bool> failed(false);
+    // Tiles are compared in parallel, and every worker gives up as soon as
+    // any of them finds that the images don't match.
+    parallel_for_chunked_2D(
+        roi.xbegin, roi.xend, 256, roi.ybegin, roi.yend, 64,
+        [&](int64_t xb, int64_t xe, int64_t yb, int64_t ye) {
+            for (int y = int(yb); y < int(ye) && !failed; ++y) {
+                ROI row(int(xb), int(xe), y, y + 1, roi.zbegin, roi.zend,
+                        roi.chbegin, roi.chend);
+                ImageBuf::ConstIterator<Atype> a(A, row, ImageBuf::WrapBlack);
+                ImageBuf::ConstIterator<Btype> b(B, row, ImageBuf::WrapBlack);
+                imagesize_t rowfail = 0;
+                for (; !a.done(); ++a, ++b) {
+                    bool pixelfail = false;
+                    for (int c = roi.chbegin; c < roi.chend; ++c) {
+                        float aval = c < Achannels ? a[c] : 0.0f;
+                        float bval = c < Bchannels ? b[c] : 0.0f;
+                        // Same rules as compare_value(): NaN matches NaN
+                        // and Inf matches Inf, other non-finite
+                        // differences are infinite errors.
+                        if (!isfinite(aval) || !isfinite(bval)) {
+                            if (isnan(aval) == isnan(bval)
+                                && isinf(aval) == isinf(bval))
+                                continue;
+                            if (hardfail < inf) {
+                                failed = true;
+                                return;
+                            }
+                            pixelfail = true;
+                            continue;
+                        }
+                        float f = fabsf(aval - bval);
+                        if (f > hardfail) {
+                            failed = true;
+                            return;
+                        }
+                        pixelfail |= !(f <= failthresh);
+                    }
+                    rowfail += pixelfail;
+                }
+                if (rowfail && (nfail += rowfail) > maxfail)
+                    failed = true;
+            }
+        },
+        nthreads);
+    return !failed;
+}
+
+
+
+bool
+ImageBufAlgo::compare_fastfail(const ImageBuf& A, const ImageBuf& B,
+                               float failthresh, imagesize_t maxfail,
+                               float hardfail, ROI roi, int nthreads)
+{
+    pvt::LoggedTimer logtimer("IBA::compare_fastfail");
+    // Two untouched views of files with the same fingerprint of their
+    // pixels needn't be looked at at all.
+    if (!roi.defined() && A.storage() == ImageBuf::IMAGECACHE
+        && B.storage() == ImageBuf::IMAGECACHE
+        && A.subimage() == B.subimage() && A.miplevel() == B.miplevel()
+        && A.roi() == B.roi() && A.spec().format == B.spec().format
+        && A.nchannels() == B.nchannels()) {
+        string_view Ahash = A.spec().get_string_attribute("oiio:SHA-1");
+        if (Ahash.size()
+            && Ahash == B.spec().get_string_attribute("oiio:SHA-1"))
+            return true;
+    }
+
+    if (!roi.defined())
+        roi = roi_union(get_roi(A.spec()), get_roi(B.spec()));
+    roi.chend = std::min(roi.chend, std::max(A.nchannels(), B.nchannels()));
+    if (A.deep() || B.deep()) {
+        // Deep images have no early out, take the full comparison
+        auto cr = compare(A, B, failthresh, failthresh, roi, nthreads);
+        return !cr.error && cr.nfail <= maxfail && !(cr.maxerror > hardfail);
+    }
+
+    bool ok;
+    OIIO_DISPATCH_COMMON_TYPES2_CONST(ok, "compare_fastfail",
+                                      compare_fastfail_, A.spec().format,
+                                      B.spec().format, A, B, failthresh,
+                                      maxfail, hardfail, roi, nthreads);
+    return ok;
+}
+
+
+
 template<typename T>
 static bool
 isConstantColor_(const ImageBuf& src, float threshold, span<float> color,
@@ -796,8 +1044,10 @@ simplePixelHashSHA1(const ImageBuf& src, string_view extrainfo, ROI roi)
     if (!roi.defined())
         roi = get_roi(src.spec());
 
-    bool localpixels           = src.localpixels();
     imagesize_t scanline_bytes = roi.width() * src.spec().pixel_bytes();
+    bool localpixels           = pvt::packed_localpixels(src)
+                                 && src.scanline_stride()
+                                        == stride_t(scanline_bytes);
     OIIO_ASSERT(scanline_bytes < std::numeric_limits<unsigned int>::max());
     // Do it a few scanlines at a time
     int chunk = std::max(1, int(16 * 1024 * 1024 / scanline_bytes));
@@ -868,11 +1118,163 @@ ImageBufAlgo::computePixelHashSHA1(const ImageBuf& src, string_view extrainfo,
 
 
 
+template<class T>
+static bool
+analyze_pixels_(const ImageBuf& src, int what, pvt::PixelAnalysis& result,
+                ImageBufAlgo::PixelStats* stats, string_view hashextra,
+                int hashblocksize, int nthreads)
+{
+    const ROI roi              = get_roi(src.spec());
+    const int nc               = src.nchannels();
+    const size_t pixel_bytes   = src.spec().pixel_bytes();
+    imagesize_t scanline_bytes = roi.width() * pixel_bytes;
+    const bool localpixels     = pvt::packed_localpixels(src)
+                                 && src.scanline_stride()
+                                        == stride_t(scanline_bytes);
+    OIIO_ASSERT(scanline_bytes < std::numeric_limits<unsigned int>::max());
+    const int chunk = std::max(1, int(16 * 1024 * 1024 / scanline_bytes));
+
+    // Hashing goes in the same blocks as computePixelHashSHA1, so that
+    // the digests match.
+    const bool hash     = what & pvt::AnalyzeSHA1;
+    const bool oneblock = hash
+                          && (hashblocksize <= 0
+                              || hashblocksize >= roi.height());
+    const int blocksize = oneblock ? roi.height() : hash ? hashblocksize : 64;
+    const int nblocks   = (roi.height() + blocksize - 1) / blocksize;
+    std::vector<std::string> digests(hash ? nblocks : 0);
+
+    // Constant means identical to the first pixel
+    std::vector<unsigned char> first(pixel_bytes);
+    src.get_pixels(ROI(roi.xbegin, roi.xbegin + 1, roi.ybegin, roi.ybegin + 1,
+                       roi.zbegin, roi.zbegin + 1),
+                   src.spec().format, first.data());
+    const int monochans  = std::min(nc, 3);
+    const bool nonfinite = (what & pvt::AnalyzeNonfinite)
+                           && !std::numeric_limits<T>::is_integer;
+    std::atomic<bool> constant((what & pvt::AnalyzeConstant) != 0);
+    std::atomic<bool> monochrome((what & pvt::AnalyzeMonochrome) != 0);
+    atomic_ll nonfinite_count(0);
+    if (stats)
+        stats->reset(nc);
+    OIIO::spin_mutex mutex;  // protect the shared stats when merging
+
+    // clang-format off
+    parallel_for_chunked(roi.ybegin, roi.yend, blocksize,
+                         [&](int64_t ybegin, int64_t yend) {
+        // Is there anything left that this block could change?
+        auto busy = [&]() {
+            return hash || stats || nonfinite || constant || monochrome;
+        };
+        std::unique_ptr<ImageBufAlgo::PixelStats> tmp;
+        if (stats)
+            tmp.reset(new ImageBufAlgo::PixelStats(nc));
+        std::vector<float> buf;
+        std::vector<unsigned char> pixels;
+        SHA1 sha;
+        imagesize_t found = 0;
+        for (int z = roi.zbegin; z < roi.zend && busy(); ++z) {
+            for (int y = int(ybegin); y < yend && busy(); y += chunk) {
+                int y1 = std::min(y + chunk, int(yend));
+                const unsigned char* p;
+                if (localpixels) {
+                    p = (const unsigned char*)src.pixeladdr(roi.xbegin, y, z);
+                } else {
+                    pixels.resize(size_t(scanline_bytes) * (y1 - y));
+                    src.get_pixels(ROI(roi.xbegin, roi.xend, y, y1, z, z + 1),
+                                   src.spec().format, pixels.data());
+                    p = pixels.data();
+                }
+                // Go a row at a time, so it stays in cache for all of it
+                const size_t npixels = size_t(roi.width());
+                for (int r = y; r < y1 && busy(); ++r, p += scanline_bytes) {
+                    if (hash)
+                        sha.append(p, size_t(scanline_bytes));
+                    if (tmp)
+                        stats_row(cspan<T>((const T*)p, npixels * nc), nc, 0,
+                                  nc, *tmp, buf);
+                    if (constant) {
+                        for (size_t i = 0; i < npixels; ++i) {
+                            if (memcmp(p + i * pixel_bytes, first.data(),
+                                       pixel_bytes)) {
+                                constant = false;
+                                break;
+                            }
+                        }
+                    }
+                    const T* v = (const T*)p;
+                    for (size_t i = 0; monochrome && i < npixels; ++i, v += nc)
+                        for (int c = 1; c < monochans; ++c)
+                            if (v[c] != v[0]) {
+                                monochrome = false;
+                                break;
+                            }
+                    v = (const T*)p;
+                    for (size_t i = 0; nonfinite && i < npixels; ++i, v += nc)
+                        for (int c = 0; c < nc; ++c)
+                            if (!isfinite(convert_type<T, float>(v[c]))) {
+                                ++found;
+                                break;
+                            }
+                }
+            }
+        }
+        nonfinite_count += found;
+        if (oneblock) {
+            sha.append(hashextra);
+            result.sha1 = sha.digest();
+        } else if (hash) {
+            digests[(ybegin - roi.ybegin) / blocksize] = sha.digest();
+        }
+        if (tmp) {
+            std::lock_guard<OIIO::spin_mutex> lock(mutex);
+            stats->merge(*tmp);
+        }
+    }, nthreads);
+    // clang-format on
+
+    if (hash && !oneblock) {
+        SHA1 sha;
+        for (int b = 0; b < nblocks; ++b)
+            sha.append(digests[b]);
+        sha.append(hashextra);
+        result.sha1 = sha.digest();
+    }
+    if (stats)
+        finalize(*stats);
+    result.constant   = constant;
+    result.monochrome = monochrome;
+    result.nonfinite  = nonfinite_count;
+    return !src.has_error();
+}
+
+
+
+bool
+pvt::analyze_pixels(const ImageBuf& src, int what, PixelAnalysis& result,
+                    ImageBufAlgo::PixelStats* stats, string_view hashextra,
+                    int hashblocksize, int nthreads)
+{
+    pvt::LoggedTimer logtimer("IBA::analyze_pixels");
+    result = PixelAnalysis();
+    if (src.deep() || src.nchannels() == 0 || src.spec().image_pixels() == 0) {
+        src.errorfmt("analyze_pixels needs a non-empty, non-deep image");
+        return false;
+    }
+    bool ok = true;
+    OIIO_DISPATCH_TYPES(ok, "analyze_pixels", analyze_pixels_,
+                        src.spec().format, src, what, result, stats, hashextra,
+                        hashblocksize, nthreads);
+    return ok;
+}
+
+
+
 template<class Atype>
 static bool
-histogram_impl(const ImageBuf& src, int channel, std::vector<imagesize_t>& hist,
-               int bins, float min, float max, bool ignore_empty, ROI roi,
-               int nthreads)
+histogram_impl(const ImageBuf& src, int chbegin, int chend,
+               std::vector<imagesize_t>& hist, int bins, float min, float max,
+               bool ignore_empty, ROI roi, int nthreads)
 {
     // Double check A's type.
     if (src.spec().format != BaseTypeFromC<Atype>::value) {
@@ -881,30 +1283,77 @@ histogram_impl(const ImageBuf& src, int channel, std::vector<imagesize_t>& hist,
     }
 
     std::mutex mutex;  // thread safety for the histogram result
+    const int nhist        = chend - chbegin;
+    const float ratio      = bins / (max - min);
+    const int bins_minus_1 = bins - 1;
+    auto bin               = [=](float val) {
+        val = clamp(val, min, max);
+        return clamp(int((val - min) * ratio), 0, bins_minus_1);
+    };
+    // For 8 and 16 bit types, look the bin of every possible value up
+    // rather than computing it for every pixel.
+    std::vector<int> lut;
+    if (sizeof(Atype) <= 2 && std::numeric_limits<Atype>::is_integer) {
+        lut.resize(size_t(1) << (8 * sizeof(Atype)));
+        for (size_t v = 0; v < lut.size(); ++v)
+            lut[v] = bin(convert_type<Atype, float>(
+                Atype(v + std::numeric_limits<Atype>::min())));
+    }
 
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        float ratio      = bins / (max - min);
-        int bins_minus_1 = bins - 1;
-
-        // Compute histogram to thread-local h.
-        std::vector<imagesize_t> h(bins, 0);
-        for (ImageBuf::ConstIterator<Atype> a(src, roi); !a.done(); a++) {
-            if (ignore_empty) {
-                bool allblack = true;
-                for (int c = roi.chbegin; c < roi.chend; ++c)
-                    allblack &= (a[c] == 0.0f);
-                if (allblack)
-                    continue;
+        // Compute histograms of all the channels to thread-local h, so
+        // that threads only contend once, to merge them.
+        std::vector<imagesize_t> h(size_t(nhist) * bins, 0);
+        const int nc = src.nchannels();
+        std::vector<int> idx;
+        bool rows = ImageBufAlgo::for_each_row<Atype>(
+            src, roi, [&](cspan<Atype> row, int /*y*/, int /*z*/) {
+                const int npix = int(row.size()) / nc;
+                idx.resize(size_t(npix) * nhist);
+                // Bin indices for the whole row first, in a loop that
+                // vectorizes, then the increments.
+                const Atype* p = row.data() + chbegin;
+                int* ix        = idx.data();
+                if (lut.size()) {
+                    const int* l = lut.data()
+                                   - int(std::numeric_limits<Atype>::min());
+                    for (int x = 0; x < npix; ++x, p += nc, ix += nhist)
+                        for (int c = 0; c < nhist; ++c)
+                            ix[c] = l[int(p[c])];
+                } else {
+                    for (int x = 0; x < npix; ++x, p += nc, ix += nhist)
+                        for (int c = 0; c < nhist; ++c)
+                            ix[c] = bin(convert_type<Atype, float>(p[c]));
+                }
+                for (int x = 0; x < npix; ++x) {
+                    if (ignore_empty) {
+                        bool allblack = true;
+                        for (int c = roi.chbegin; c < roi.chend; ++c)
+                            allblack &= (row[size_t(x) * nc + c] == Atype(0));
+                        if (allblack)
+                            continue;
+                    }
+                    for (int c = 0; c < nhist; ++c)
+                        h[size_t(c) * bins + idx[size_t(x) * nhist + c]] += 1;
+                }
+            });
+        if (!rows) {
+            for (ImageBuf::ConstIterator<Atype> a(src, roi); !a.done(); a++) {
+                if (ignore_empty) {
+                    bool allblack = true;
+                    for (int c = roi.chbegin; c < roi.chend; ++c)
+                        allblack &= (a[c] == 0.0f);
+                    if (allblack)
+                        continue;
+                }
+                for (int c = 0; c < nhist; ++c)
+                    h[size_t(c) * bins + bin(a[chbegin + c])] += 1;
             }
-            float val = a[channel];
-            val       = clamp(val, min, max);
-            int i     = clamp(int((val - min) * ratio), 0, bins_minus_1);
-            h[i] += 1;
         }
 
         // Safely update the master histogram
         lock_guard lock(mutex);
-        for (int i = 0; i < bins; ++i)
+        for (size_t i = 0; i < h.size(); ++i)
             hist[i] += h[i];
     });
     return true;
@@ -912,6 +1361,27 @@ histogram_impl(const ImageBuf& src, int channel, std::vector<imagesize_t>& hist,
 
 
 
+// Argument checks shared by the histogram functions
+static bool
+histogram_args_ok(const ImageBuf& src, int bins, float min, float max)
+{
+    if (src.nchannels() == 0) {
+        src.errorfmt("Input image must have at least 1 channel");
+        return false;
+    }
+    if (bins < 1) {
+        src.errorfmt("The number of bins must be at least 1");
+        return false;
+    }
+    if (max <= min) {
+        src.errorfmt("Invalid range, min must be strictly smaller than max");
+        return false;
+    }
+    return true;
+}
+
+
+
 std::vector<imagesize_t>
 ImageBufAlgo::histogram(const ImageBuf& src, int channel, int bins, float min,
                         float max, bool ignore_empty, ROI roi, int nthreads)
@@ -920,23 +1390,13 @@ ImageBufAlgo::histogram(const ImageBuf& src, int channel, int bins, float min,
     std::vector<imagesize_t> h;
 
     // Sanity checks
-    if (src.nchannels() == 0) {
-        src.errorfmt("Input image must have at least 1 channel");
-        return h;
-    }
-    if (channel < 0 || channel >= src.nchannels()) {
+    if (src.nchannels() && (channel < 0 || channel >= src.nchannels())) {
         src.errorfmt("Invalid channel {} for input image with channels 0 to {}",
                      channel, src.nchannels() - 1);
         return h;
     }
-    if (bins < 1) {
-        src.errorfmt("The number of bins must be at least 1");
-        return h;
-    }
-    if (max <= min) {
-        src.errorfmt("Invalid range, min must be strictly smaller than max");
+    if (!histogram_args_ok(src, bins, min, max))
         return h;
-    }
 
     // Specified ROI -> use it. Unspecified ROI -> initialize from src.
     if (!roi.defined())
@@ -945,9 +1405,38 @@ ImageBufAlgo::histogram(const ImageBuf& src, int channel, int bins, float min,
     h.resize(bins);
     bool ok = true;
     OIIO_DISPATCH_TYPES(ok, "histogram", histogram_impl, src.spec().format, src,
-                        channel, h, bins, min, max, ignore_empty, roi,
-                        nthreads);
+                        channel, channel + 1, h, bins, min, max, ignore_empty,
+                        roi, nthreads);
+
+    if (!ok && src.has_error())
+        h.clear();
+    return h;
+}
+
+
 
+std::vector<imagesize_t>
+ImageBufAlgo::histogram_channels(const ImageBuf& src, int bins, float min,
+                                 float max, bool ignore_empty, ROI roi,
+                                 int nthreads)
+{
+    pvt::LoggedTimer logtimer("IBA::histogram_channels");
+    std::vector<imagesize_t> h;
+    if (!histogram_args_ok(src, bins, min, max))
+        return h;
+    if (!roi.defined())
+        roi = get_roi(src.spec());
+    roi.chend = std::min(roi.chend, src.nchannels());
+    if (roi.nchannels() < 1) {
+        src.errorfmt("No channels to compute histograms for");
+        return h;
+    }
+
+    h.resize(size_t(roi.nchannels()) * bins);
+    bool ok = true;
+    OIIO_DISPATCH_TYPES(ok, "histogram_channels", histogram_impl,
+                        src.spec().format, src, roi.chbegin, roi.chend, h,
+                        bins, min, max, ignore_empty, roi, nthreads);
     if (!ok && src.has_error())
         h.clear();
     return h;
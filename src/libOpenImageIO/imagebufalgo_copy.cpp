@@ -252,6 +252,16 @@ bool
 ImageBufAlgo::crop(ImageBuf& dst, const ImageBuf& src, ROI roi, int nthreads)
 {
     pvt::LoggedTimer logtime("IBA::crop");
+    // A region within an in-memory image, with all of its channels, needs
+    // no copy: view it in place (see ImageBuf::view()), sharing src's
+    // pixels until one of the two is written to.
+    if (&dst != &src && roi.chbegin == 0 && roi.chend >= src.nchannels()) {
+        ImageBuf view = src.view(roi);
+        if (view.initialized()) {
+            dst = std::move(view);
+            return true;
+        }
+    }
     dst.clear();
     roi.chend = std::min(roi.chend, src.nchannels());
     if (!IBAprep(roi, &dst, &src, IBAprep_SUPPORT_DEEP))
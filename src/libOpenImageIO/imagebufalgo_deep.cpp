@@ -3,6 +3,8 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <algorithm>
+#include <array>
 #include <cmath>
 #include <iostream>
 #include <stdexcept>
@@ -45,8 +47,8 @@ flatten_(ImageBuf& dst, const ImageBuf& src, ROI roi, int nthreads)
         float& ABval(val[AB_channel]);
 
         for (ImageBuf::Iterator<DSTTYPE> r(dst, roi); !r.done(); ++r) {
-            int x = r.x(), y = r.y(), z = r.z();
-            int samps = src.deep_samples(x, y, z);
+            int64_t pixel = src.pixelindex(r.x(), r.y(), r.z(), true);
+            int samps     = dd->samples(pixel);
             // Clear accumulated values for this pixel (0 for colors, big for Z)
             memset(val, 0, nc * sizeof(float));
             if (Z_channel >= 0 && samps == 0)
@@ -59,7 +61,7 @@ flatten_(ImageBuf& dst, const ImageBuf& src, ROI roi, int nthreads)
                 if (alpha >= 1.0f)
                     break;
                 for (int c = 0; c < nc; ++c) {
-                    float v = src.deep_value(x, y, z, c, s);
+                    float v = dd->deep_value(pixel, c, s);
                     if (c == Z_channel || c == Zback_channel)
                         val[c] *= alpha;  // because Z are not premultiplied
                     float a;
@@ -236,6 +238,122 @@ ImageBufAlgo::deepen(const ImageBuf& src, float zvalue, ROI roi, int nthreads)
 
 
 
+// How many samples merging pixel Bpixel of B into pixel Apixel of A can
+// produce, including any splits that may occur.
+static int
+merged_capacity(const DeepData& A, int Apixel, const DeepData& B, int Bpixel)
+{
+    int Azchan              = A.Z_channel();
+    int Azbackchan          = A.Zback_channel();
+    int Bzchan              = B.Z_channel();
+    int Bzbackchan          = B.Zback_channel();
+    int Asamps              = A.samples(Apixel);
+    int Bsamps              = B.samples(Bpixel);
+    int nsplits             = 0;
+    int self_overlap_splits = 0;
+    for (int s = 0; s < Asamps; ++s) {
+        float src_z     = A.deep_value(Apixel, Azchan, s);
+        float src_zback = A.deep_value(Apixel, Azbackchan, s);
+        for (int d = 0; d < Bsamps; ++d) {
+            float dst_z     = B.deep_value(Bpixel, Bzchan, d);
+            float dst_zback = B.deep_value(Bpixel, Bzbackchan, d);
+            if (src_z > dst_z && src_z < dst_zback)
+                ++nsplits;
+            if (src_zback > dst_z && src_zback < dst_zback)
+                ++nsplits;
+            if (dst_z > src_z && dst_z < src_zback)
+                ++nsplits;
+            if (dst_zback > src_z && dst_zback < src_zback)
+                ++nsplits;
+        }
+        // Check for splits src vs src -- in case they overlap!
+        for (int ss = s; ss < Asamps; ++ss) {
+            float src_z2     = A.deep_value(Apixel, Azchan, ss);
+            float src_zback2 = A.deep_value(Apixel, Azbackchan, ss);
+            if (src_z2 > src_z && src_z2 < src_zback)
+                ++self_overlap_splits;
+            if (src_zback2 > src_z && src_zback2 < src_zback)
+                ++self_overlap_splits;
+            if (src_z > src_z2 && src_z < src_zback2)
+                ++self_overlap_splits;
+            if (src_zback > src_z2 && src_zback < src_zback2)
+                ++self_overlap_splits;
+        }
+    }
+    // Check for splits dst vs dst -- in case they overlap!
+    for (int d = 0; d < Bsamps; ++d) {
+        float dst_z     = B.deep_value(Bpixel, Bzchan, d);
+        float dst_zback = B.deep_value(Bpixel, Bzbackchan, d);
+        for (int dd = d; dd < Bsamps; ++dd) {
+            float dst_z2     = B.deep_value(Bpixel, Bzchan, dd);
+            float dst_zback2 = B.deep_value(Bpixel, Bzbackchan, dd);
+            if (dst_z2 > dst_z && dst_z2 < dst_zback)
+                ++self_overlap_splits;
+            if (dst_zback2 > dst_z && dst_zback2 < dst_zback)
+                ++self_overlap_splits;
+            if (dst_z > dst_z2 && dst_z < dst_zback2)
+                ++self_overlap_splits;
+            if (dst_zback > dst_z2 && dst_zback < dst_zback2)
+                ++self_overlap_splits;
+        }
+    }
+    return Asamps + Bsamps + nsplits + self_overlap_splits;
+}
+
+
+
+// Compute the deep pixels of dst within roi, in parallel. For each pixel,
+// `func(tmp, x, y, z)` builds the result in `tmp`, a one-pixel DeepData
+// with dst's channels, which is then copied into dst. Pixels never take
+// dst's lock: a result that doesn't fit the capacity dst already has for
+// that pixel (which would mean moving all of dst's samples) is set aside
+// and redone serially at the end.
+template<typename FUNC>
+static void
+parallel_deep_pixels(ImageBuf& dst, ROI roi, int nthreads, FUNC func)
+{
+    DeepData& dstdd(*dst.deepdata());
+    std::vector<std::string> names;
+    for (int c = 0; c < dstdd.channels(); ++c)
+        names.emplace_back(dstdd.channelname(c));
+    auto init_tmp = [&](DeepData& tmp) {
+        tmp.set_planar(dstdd.planar());
+        tmp.init(1, dstdd.channels(), dstdd.all_channeltypes(), names);
+    };
+    dstdd.all_data();  // allocate now, rather than racing in the threads
+
+    std::vector<std::array<int, 3>> deferred;
+    spin_mutex deferred_mutex;
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        DeepData tmp;
+        init_tmp(tmp);
+        for (int z = roi.zbegin; z < roi.zend; ++z)
+            for (int y = roi.ybegin; y < roi.yend; ++y)
+                for (int x = roi.xbegin; x < roi.xend; ++x) {
+                    int64_t pixel = dst.pixelindex(x, y, z, true);
+                    if (pixel < 0)
+                        continue;
+                    func(tmp, x, y, z);
+                    if (tmp.samples(0) <= dstdd.capacity(pixel)) {
+                        dstdd.copy_deep_pixel(pixel, tmp, 0);
+                    } else {
+                        spin_lock lock(deferred_mutex);
+                        deferred.push_back({ { x, y, z } });
+                    }
+                }
+    });
+    if (deferred.size()) {
+        DeepData tmp;
+        init_tmp(tmp);
+        for (auto& p : deferred) {
+            func(tmp, p[0], p[1], p[2]);
+            dstdd.copy_deep_pixel(dst.pixelindex(p[0], p[1], p[2]), tmp, 0);
+        }
+    }
+}
+
+
+
 bool
 ImageBufAlgo::deep_merge(ImageBuf& dst, const ImageBuf& A, const ImageBuf& B,
                          bool occlusion_cull, ROI roi, int nthreads)
@@ -254,95 +372,37 @@ ImageBufAlgo::deep_merge(ImageBuf& dst, const ImageBuf& A, const ImageBuf& B,
         return false;
     }
 
-    // First, set the capacity of the dst image to reserve enough space for
-    // the segments of both source images, including any splits that may
-    // occur.
+    // First, compute the capacity dst needs to hold the segments of both
+    // source images, including any splits that may occur, and reserve it
+    // all at once.
     DeepData& dstdd(*dst.deepdata());
     const DeepData& Add(*A.deepdata());
     const DeepData& Bdd(*B.deepdata());
-    int Azchan     = Add.Z_channel();
-    int Azbackchan = Add.Zback_channel();
-    int Bzchan     = Bdd.Z_channel();
-    int Bzbackchan = Bdd.Zback_channel();
-    for (int z = roi.zbegin; z < roi.zend; ++z)
-        for (int y = roi.ybegin; y < roi.yend; ++y)
-            for (int x = roi.xbegin; x < roi.xend; ++x) {
-                int dstpixel            = dst.pixelindex(x, y, z, true);
-                int Apixel              = A.pixelindex(x, y, z, true);
-                int Bpixel              = B.pixelindex(x, y, z, true);
-                int Asamps              = Add.samples(Apixel);
-                int Bsamps              = Bdd.samples(Bpixel);
-                int nsplits             = 0;
-                int self_overlap_splits = 0;
-                for (int s = 0; s < Asamps; ++s) {
-                    float src_z     = Add.deep_value(Apixel, Azchan, s);
-                    float src_zback = Add.deep_value(Apixel, Azbackchan, s);
-                    for (int d = 0; d < Bsamps; ++d) {
-                        float dst_z     = Bdd.deep_value(Bpixel, Bzchan, d);
-                        float dst_zback = Bdd.deep_value(Bpixel, Bzbackchan, d);
-                        if (src_z > dst_z && src_z < dst_zback)
-                            ++nsplits;
-                        if (src_zback > dst_z && src_zback < dst_zback)
-                            ++nsplits;
-                        if (dst_z > src_z && dst_z < src_zback)
-                            ++nsplits;
-                        if (dst_zback > src_z && dst_zback < src_zback)
-                            ++nsplits;
-                    }
-                    // Check for splits src vs src -- in case they overlap!
-                    for (int ss = s; ss < Asamps; ++ss) {
-                        float src_z2     = Add.deep_value(Apixel, Azchan, ss);
-                        float src_zback2 = Add.deep_value(Apixel, Azbackchan,
-                                                          ss);
-                        if (src_z2 > src_z && src_z2 < src_zback)
-                            ++self_overlap_splits;
-                        if (src_zback2 > src_z && src_zback2 < src_zback)
-                            ++self_overlap_splits;
-                        if (src_z > src_z2 && src_z < src_zback2)
-                            ++self_overlap_splits;
-                        if (src_zback > src_z2 && src_zback < src_zback2)
-                            ++self_overlap_splits;
-                    }
+    std::vector<unsigned int> capacity(dstdd.pixels(), 0);
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        for (int z = roi.zbegin; z < roi.zend; ++z)
+            for (int y = roi.ybegin; y < roi.yend; ++y)
+                for (int x = roi.xbegin; x < roi.xend; ++x) {
+                    int dstpixel = dst.pixelindex(x, y, z, true);
+                    if (dstpixel >= 0)
+                        capacity[dstpixel] = merged_capacity(
+                            Add, A.pixelindex(x, y, z, true), Bdd,
+                            B.pixelindex(x, y, z, true));
                 }
-                // Check for splits dst vs dst -- in case they overlap!
-                for (int d = 0; d < Bsamps; ++d) {
-                    float dst_z     = Bdd.deep_value(Bpixel, Bzchan, d);
-                    float dst_zback = Bdd.deep_value(Bpixel, Bzbackchan, d);
-                    for (int dd = d; dd < Bsamps; ++dd) {
-                        float dst_z2     = Bdd.deep_value(Bpixel, Bzchan, dd);
-                        float dst_zback2 = Bdd.deep_value(Bpixel, Bzbackchan,
-                                                          dd);
-                        if (dst_z2 > dst_z && dst_z2 < dst_zback)
-                            ++self_overlap_splits;
-                        if (dst_zback2 > dst_z && dst_zback2 < dst_zback)
-                            ++self_overlap_splits;
-                        if (dst_z > dst_z2 && dst_z < dst_zback2)
-                            ++self_overlap_splits;
-                        if (dst_zback > dst_z2 && dst_zback < dst_zback2)
-                            ++self_overlap_splits;
-                    }
-                }
-
-                dstdd.set_capacity(dstpixel, Asamps + Bsamps + nsplits
-                                                 + self_overlap_splits);
-            }
-
-    bool ok = ImageBufAlgo::copy(dst, A, TypeDesc::UNKNOWN, roi, nthreads);
-
-    for (int z = roi.zbegin; z < roi.zend; ++z)
-        for (int y = roi.ybegin; y < roi.yend; ++y)
-            for (int x = roi.xbegin; x < roi.xend; ++x) {
-                int dstpixel = dst.pixelindex(x, y, z, true);
-                int Bpixel   = B.pixelindex(x, y, z, true);
-                OIIO_DASSERT(dstpixel >= 0);
-                // OIIO_UNUSED_OK int oldcap = dstdd.capacity (dstpixel);
-                dstdd.merge_deep_pixels(dstpixel, Bdd, Bpixel);
-                // OIIO_DASSERT (oldcap == dstdd.capacity(dstpixel) &&
-                //          "Broken: we did not preallocate enough capacity");
-                if (occlusion_cull)
-                    dstdd.occlusion_cull(dstpixel);
-            }
-    return ok;
+    });
+    dstdd.set_all_capacity(capacity);
+
+    // Now each dst pixel is a copy of A's, with B's samples merged in.
+    parallel_deep_pixels(dst, roi, nthreads,
+                         [&](DeepData& tmp, int x, int y, int z) {
+                             tmp.copy_deep_pixel(0, Add,
+                                                 A.pixelindex(x, y, z, true));
+                             tmp.merge_deep_pixels(0, Bdd,
+                                                   B.pixelindex(x, y, z, true));
+                             if (occlusion_cull)
+                                 tmp.occlusion_cull(0);
+                         });
+    return true;
 }
 
 
@@ -360,9 +420,28 @@ ImageBufAlgo::deep_merge(const ImageBuf& A, const ImageBuf& B,
 
 
 
+// Return the first sample of the pixel whose depth channel `zchan` is
+// beyond `zthresh`, or the number of samples if there is none.
+static int
+first_beyond(const DeepData& dd, int64_t pixel, int zchan, float zthresh)
+{
+    int n           = dd.samples(pixel);
+    cspan<float> zs = dd.float_samples(pixel, zchan);
+    if (zs.size())
+        return int(std::find_if(zs.begin(), zs.end(),
+                                [=](float z) { return z > zthresh; })
+                   - zs.begin());
+    for (int s = 0; s < n; ++s)
+        if (dd.deep_value(pixel, zchan, s) > zthresh)
+            return s;
+    return n;
+}
+
+
+
 bool
 ImageBufAlgo::deep_holdout(ImageBuf& dst, const ImageBuf& src,
-                           const ImageBuf& thresh, ROI roi, int /*nthreads*/)
+                           const ImageBuf& thresh, ROI roi, int nthreads)
 {
     pvt::LoggedTimer logtime("IBA::deep_holdout");
     if (!src.deep() || !thresh.deep()) {
@@ -378,53 +457,43 @@ ImageBufAlgo::deep_holdout(ImageBuf& dst, const ImageBuf& src,
 
     DeepData& dstdd(*dst.deepdata());
     const DeepData& srcdd(*src.deepdata());
-    // First, reserve enough space in dst, to reduce the number of
-    // allocations we'll do later.
+    // Keep src's layout, so whole pixels copy straight across
+    dstdd.set_planar(srcdd.planar());
+    // First, reserve enough space in dst, in a single allocation, to
+    // reduce the number of allocations we'll do later.
+    std::vector<unsigned int> capacity(dstdd.pixels(), 0);
     for (int z = roi.zbegin; z < roi.zend; ++z)
         for (int y = roi.ybegin; y < roi.yend; ++y)
             for (int x = roi.xbegin; x < roi.xend; ++x) {
                 int dstpixel = dst.pixelindex(x, y, z, true);
                 int srcpixel = src.pixelindex(x, y, z, true);
                 if (dstpixel >= 0 && srcpixel >= 0)
-                    dstdd.set_capacity(dstpixel, srcdd.capacity(srcpixel));
+                    capacity[dstpixel] = srcdd.capacity(srcpixel);
             }
-    // Now we compute each pixel: We copy the src pixel to dst, then split
-    // any samples that span the opaque threshold, and then delete any
-    // samples that lie beyond the threshold.
+    dstdd.set_all_capacity(capacity);
+    // Now we compute each pixel: We copy the src pixel, then split any
+    // samples that span the opaque threshold, and then delete any samples
+    // that lie beyond the threshold.
     int Zchan     = dstdd.Z_channel();
     int Zbackchan = dstdd.Zback_channel();
     const DeepData& threshdd(*thresh.deepdata());
-    for (ImageBuf::Iterator<float> r(dst, roi); !r.done(); ++r) {
-        int x = r.x(), y = r.y(), z = r.z();
-        int srcpixel = src.pixelindex(x, y, z, true);
-        if (srcpixel < 0)
-            continue;  // Nothing in this pixel
-        int dstpixel = dst.pixelindex(x, y, z, true);
-        dstdd.copy_deep_pixel(dstpixel, srcdd, srcpixel);
+    parallel_deep_pixels(dst, roi, nthreads, [&](DeepData& tmp, int x, int y,
+                                                 int z) {
+        tmp.copy_deep_pixel(0, srcdd, src.pixelindex(x, y, z, true));
         int threshpixel = thresh.pixelindex(x, y, z, true);
         if (threshpixel < 0)
-            continue;  // No threshold mask for this pixel
+            return;  // No threshold mask for this pixel
         float zthresh = threshdd.opaque_z(threshpixel);
         // Eliminate the samples that are entirely beyond the depth
-        // threshold. Do this before the split; that makes it less
-        // likely that the split will force a re-allocation.
-        for (int s = 0, n = dstdd.samples(dstpixel); s < n; ++s) {
-            if (dstdd.deep_value(dstpixel, Zchan, s) > zthresh) {
-                dstdd.set_samples(dstpixel, s);
-                break;
-            }
-        }
+        // threshold. Do this before the split; that makes it less likely
+        // that the split will force a re-allocation.
+        tmp.set_samples(0, first_beyond(tmp, 0, Zchan, zthresh));
         // Now split any samples that straddle the z.
-        if (dstdd.split(dstpixel, zthresh)) {
+        if (tmp.split(0, zthresh)) {
             // If a split did occur, do another discard pass.
-            for (int s = 0, n = dstdd.samples(dstpixel); s < n; ++s) {
-                if (dstdd.deep_value(dstpixel, Zbackchan, s) > zthresh) {
-                    dstdd.set_samples(dstpixel, s);
-                    break;
-                }
-            }
+            tmp.set_samples(0, first_beyond(tmp, 0, Zbackchan, zthresh));
         }
-    }
+    });
     return true;
 }
 
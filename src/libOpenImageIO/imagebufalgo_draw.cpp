@@ -5,6 +5,8 @@
 #include <algorithm>
 #include <cmath>
 #include <limits>
+#include <memory>
+#include <unordered_map>
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filesystem.h>
@@ -13,10 +15,12 @@
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagebufalgo_util.h>
+#include <OpenImageIO/simd.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
 
 #include "imageio_pvt.h"
+#include "simd_kernels_pvt.h"
 
 #ifdef USE_FREETYPE
 #    include <ft2build.h>
@@ -528,39 +532,75 @@ hashrand(int x, int y, int z, int c, int seed)
 
 
 // Return a hash-based normal-distributed pseudorandom value.
-// We use the Marsaglia polar method, and hashrand to
+// We use the Marsaglia polar method, and hashrand to generate the pairs of
+// uniform values. The first pair, hashrand(x,y,z,c,seed) and
+// hashrand(x,y,z,c,seed+139), is passed in as u1 and u2.
 OIIO_FORCEINLINE float
-hashnormal(int x, int y, int z, int c, int seed)
+hashnormal(int x, int y, int z, int c, int seed, float u1, float u2)
 {
-    float xr, yr, r2;
-    int s = seed - 1;
-    do {
-        s += 1;
+    float xr = 2.0 * u1 - 1.0;
+    float yr = 2.0 * u2 - 1.0;
+    float r2 = xr * xr + yr * yr;
+    for (int s = seed + 1; r2 > 1.0 || r2 == 0.0; ++s) {
         xr = 2.0 * hashrand(x, y, z, c, s) - 1.0;
         yr = 2.0 * hashrand(x, y, z, c, s + 139) - 1.0;
         r2 = xr * xr + yr * yr;
-    } while (r2 > 1.0 || r2 == 0.0);
+    }
     float M = sqrt(-2.0 * log(r2) / r2);
     return xr * M;
 }
 
 
 
+// Helper for the hash-based noise types: for each scanline of roi, call
+// fill(x, y, z, c, row, n) to compute the noise values of channel c for
+// the n pixels starting at x (just once, for channel chbegin, if mono),
+// then apply(p, c, n) to each pixel and channel. Rows are filled with the
+// SIMD hashrand kernel, and since the values depend only on the pixel
+// coordinates, channel, and seed, the result is identical for any number
+// of threads or division of the ROI.
+template<typename T, typename FILL, typename APPLY>
+static void
+noise_rows(ImageBuf& dst, bool mono, ROI roi, FILL&& fill, APPLY&& apply)
+{
+    const int width = roi.width();
+    const int nc    = mono ? 1 : roi.nchannels();
+    std::unique_ptr<float[]> rows(new float[size_t(width) * nc]);
+    for (int z = roi.zbegin; z < roi.zend; ++z) {
+        for (int y = roi.ybegin; y < roi.yend; ++y) {
+            for (int c = 0; c < nc; ++c)
+                fill(roi.xbegin, y, z, roi.chbegin + c,
+                     rows.get() + size_t(c) * width, width);
+            ROI row(roi.xbegin, roi.xend, y, y + 1, z, z + 1, roi.chbegin,
+                    roi.chend);
+            int i = 0;
+            for (ImageBuf::Iterator<T> p(dst, row); !p.done(); ++p, ++i) {
+                for (int c = roi.chbegin; c < roi.chend; ++c) {
+                    int r = mono ? 0 : c - roi.chbegin;
+                    apply(p, c, rows[size_t(r) * width + i]);
+                }
+            }
+        }
+    }
+}
+
+
+
 template<typename T>
 static bool
 noise_uniform_(ImageBuf& dst, float min, float max, bool mono, int seed,
                ROI roi, int nthreads)
 {
+    const pvt::SimdKernels& kernels(pvt::simd_kernels());
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        for (ImageBuf::Iterator<T> p(dst, roi); !p.done(); ++p) {
-            int x = p.x(), y = p.y(), z = p.z();
-            float n = 0.0;
-            for (int c = roi.chbegin; c < roi.chend; ++c) {
-                if (c == roi.chbegin || !mono)
-                    n = lerp(min, max, hashrand(x, y, z, c, seed));
-                p[c] = p[c] + n;
-            }
-        }
+        noise_rows<T>(
+            dst, mono, roi,
+            [&](int x, int y, int z, int c, float* row, int n) {
+                kernels.hashrand(x, y, z, c, seed, row, n);
+            },
+            [&](ImageBuf::Iterator<T>& p, int c, float n) {
+                p[c] = p[c] + lerp(min, max, n);
+            });
     });
     return true;
 }
@@ -572,16 +612,22 @@ static bool
 noise_gaussian_(ImageBuf& dst, float mean, float stddev, bool mono, int seed,
                 ROI roi, int nthreads)
 {
+    const pvt::SimdKernels& kernels(pvt::simd_kernels());
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        for (ImageBuf::Iterator<T> p(dst, roi); !p.done(); ++p) {
-            int x = p.x(), y = p.y(), z = p.z();
-            float n = 0.0;
-            for (int c = roi.chbegin; c < roi.chend; ++c) {
-                if (c == roi.chbegin || !mono)
-                    n = mean + stddev * hashnormal(x, y, z, c, seed);
+        std::unique_ptr<float[]> u2(new float[roi.width()]);
+        noise_rows<T>(
+            dst, mono, roi,
+            [&](int x, int y, int z, int c, float* row, int n) {
+                kernels.hashrand(x, y, z, c, seed, row, n);
+                kernels.hashrand(x, y, z, c, seed + 139, u2.get(), n);
+                for (int i = 0; i < n; ++i) {
+                    float g = hashnormal(x + i, y, z, c, seed, row[i], u2[i]);
+                    row[i]  = mean + stddev * g;
+                }
+            },
+            [&](ImageBuf::Iterator<T>& p, int c, float n) {
                 p[c] = p[c] + n;
-            }
-        }
+            });
     });
     return true;
 }
@@ -593,17 +639,17 @@ static bool
 noise_salt_(ImageBuf& dst, float saltval, float saltportion, bool mono,
             int seed, ROI roi, int nthreads)
 {
+    const pvt::SimdKernels& kernels(pvt::simd_kernels());
     ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        for (ImageBuf::Iterator<T> p(dst, roi); !p.done(); ++p) {
-            int x = p.x(), y = p.y(), z = p.z();
-            float n = 0.0;
-            for (int c = roi.chbegin; c < roi.chend; ++c) {
-                if (c == roi.chbegin || !mono)
-                    n = hashrand(x, y, z, c, seed);
+        noise_rows<T>(
+            dst, mono, roi,
+            [&](int x, int y, int z, int c, float* row, int n) {
+                kernels.hashrand(x, y, z, c, seed, row, n);
+            },
+            [&](ImageBuf::Iterator<T>& p, int c, float n) {
                 if (n < saltportion)
                     p[c] = saltval;
-            }
-        }
+            });
     });
     return true;
 }
@@ -714,33 +760,126 @@ static std::vector<std::string> font_search_dirs;
 static const char* default_font_name[] = { "DroidSans", "cour", "Courier New",
                                            "FreeMono", nullptr };
 
-// Helper: given unicode and a font face, compute its size
+// Burned-in frame numbers and slates render the same few glyphs over and
+// over, so faces stay open and rendered glyphs are kept for the life of
+// the process (all guarded by ft_mutex).
+struct Glyph {
+    int left = 0, top = 0;              // bitmap offset from the pen
+    int width = 0, rows = 0;            // bitmap size
+    int advance = 0;                    // pen advance, in pixels
+    std::vector<unsigned char> bitmap;  // rows x width coverage
+};
+typedef std::shared_ptr<const Glyph> GlyphRef;  // null if unrenderable
+
+struct GlyphKey {
+    ustring font;
+    int size;
+    uint32_t ch;
+    bool operator==(const GlyphKey& b) const
+    {
+        return font == b.font && size == b.size && ch == b.ch;
+    }
+};
+struct GlyphKeyHasher {
+    size_t operator()(const GlyphKey& k) const
+    {
+        return k.font.hash() + 31 * (size_t(k.size) * 65599 + k.ch);
+    }
+};
+
+static std::unordered_map<std::string, std::string> resolved_fonts;
+static std::unordered_map<ustring, FT_Face, ustringHash> ft_faces;
+static std::unordered_map<GlyphKey, GlyphRef, GlyphKeyHasher> ft_glyphs;
+static const size_t max_cached_glyphs = 64 * 1024;
+
+
+
+// Find the glyphs for utext (null for newlines and characters that can't
+// be rendered), rendering with FreeType only those not seen before in
+// this font and size. Return false if the font file can't be used at all.
+// The caller must hold ft_mutex.
+static bool
+find_glyphs(ustring font, int fontsize, cspan<uint32_t> utext,
+            std::vector<GlyphRef>& glyphs, std::string& err)
+{
+    FT_Face& face(ft_faces[font]);
+    if (!face
+        && FT_New_Face(ft_library, font.c_str(), 0 /* face index */, &face)) {
+        ft_faces.erase(font);
+        err = Strutil::fmt::format("Could not set font face to \"{}\"", font);
+        return false;
+    }
+    bool sized = false;
+    glyphs.clear();
+    glyphs.reserve(utext.size());
+    for (auto ch : utext) {
+        if (ch == '\n') {
+            glyphs.emplace_back();
+            continue;
+        }
+        GlyphKey key { font, fontsize, ch };
+        auto found = ft_glyphs.find(key);
+        if (found != ft_glyphs.end()) {
+            glyphs.push_back(found->second);
+            continue;
+        }
+        if (!sized) {
+            if (FT_Set_Pixel_Sizes(face, 0 /*width*/, fontsize /*height*/)) {
+                err = Strutil::fmt::format("Could not set font size to {}",
+                                           fontsize);
+                return false;
+            }
+            sized = true;
+        }
+        std::shared_ptr<Glyph> g;
+        if (!FT_Load_Char(face, ch, FT_LOAD_RENDER)) {
+            FT_GlyphSlot slot = face->glyph;
+            g.reset(new Glyph);
+            g->left    = slot->bitmap_left;
+            g->top     = slot->bitmap_top;
+            g->width   = int(slot->bitmap.width);
+            g->rows    = int(slot->bitmap.rows);
+            g->advance = int(slot->advance.x >> 6);
+            g->bitmap.resize(size_t(g->width) * g->rows);
+            for (int j = 0; j < g->rows; ++j)
+                memcpy(&g->bitmap[size_t(j) * g->width],
+                       slot->bitmap.buffer + slot->bitmap.pitch * j, g->width);
+        }
+        if (ft_glyphs.size() >= max_cached_glyphs)
+            ft_glyphs.clear();  // glyphs in use are kept alive by their refs
+        ft_glyphs[key] = g;
+        glyphs.push_back(g);
+    }
+    return true;
+}
+
+
+
+// Helper: given unicode and its glyphs, compute its size
 static ROI
-text_size_from_unicode(cspan<uint32_t> utext, FT_Face face, int fontsize)
+text_size_from_unicode(cspan<uint32_t> utext, cspan<GlyphRef> glyphs,
+                       int fontsize)
 {
     int y = 0;
     int x = 0;
     ROI size;
     size.xbegin = size.ybegin = std::numeric_limits<int>::max();
     size.xend = size.yend = std::numeric_limits<int>::min();
-    FT_GlyphSlot slot     = face->glyph;
-    for (auto ch : utext) {
-        if (ch == '\n') {
+    for (int i = 0, n = int(utext.size()); i < n; ++i) {
+        if (utext[i] == '\n') {
             x = 0;
             y += fontsize;
             continue;
         }
-        int error = FT_Load_Char(face, ch, FT_LOAD_RENDER);
-        if (error)
+        const Glyph* g = glyphs[i].get();
+        if (!g)
             continue;  // ignore errors
-        size.ybegin = std::min(size.ybegin, y - slot->bitmap_top);
-        size.yend   = std::max(size.yend, y + int(slot->bitmap.rows)
-                                            - int(slot->bitmap_top) + 1);
-        size.xbegin = std::min(size.xbegin, x + int(slot->bitmap_left));
-        size.xend   = std::max(size.xend, x + int(slot->bitmap.width)
-                                            + int(slot->bitmap_left) + 1);
+        size.ybegin = std::min(size.ybegin, y - g->top);
+        size.yend   = std::max(size.yend, y + g->rows - g->top + 1);
+        size.xbegin = std::min(size.xbegin, x + g->left);
+        size.xend   = std::max(size.xend, x + g->width + g->left + 1);
         // increment pen position
-        x += slot->advance.x >> 6;
+        x += g->advance;
     }
     return size;  // Font rendering not supported
 }
@@ -796,6 +935,13 @@ resolve_font(string_view font_, std::string& result)
     if (ft_broken)
         return false;
 
+    // Fonts already found needn't be searched for again
+    auto resolved = resolved_fonts.find(font_);
+    if (resolved != resolved_fonts.end()) {
+        result = resolved->second;
+        return true;
+    }
+
     // If FT not yet initialized, do it now.
     if (!ft_library) {
         if (FT_Init_FreeType(&ft_library)) {
@@ -869,7 +1015,8 @@ resolve_font(string_view font_, std::string& result)
     }
 
     // Success
-    result = font;
+    result                = font;
+    resolved_fonts[font_] = font;
     return true;
 }
 
@@ -893,26 +1040,13 @@ ImageBufAlgo::text_size(string_view text, int fontsize, string_view font_)
         return size;
     }
 
-    int error = 0;
-    FT_Face face;  // handle to face object
-    error = FT_New_Face(ft_library, font.c_str(), 0 /* face index */, &face);
-    if (error) {
-        return size;  // couldn't open the face
-    }
-
-    error = FT_Set_Pixel_Sizes(face /*handle*/, 0 /*width*/,
-                               fontsize /*height*/);
-    if (error) {
-        FT_Done_Face(face);
-        return size;  // couldn't set the character size
-    }
-
     std::vector<uint32_t> utext;
     utext.reserve(text.size());
     Strutil::utf8_to_unicode(text, utext);
-    size = text_size_from_unicode(utext, face, fontsize);
-
-    FT_Done_Face(face);
+    std::vector<GlyphRef> glyphs;
+    std::string err;
+    if (find_glyphs(ustring(font), fontsize, utext, glyphs, err))
+        size = text_size_from_unicode(utext, glyphs, fontsize);
 #endif
 
     return size;  // Font rendering not supported
@@ -934,34 +1068,26 @@ ImageBufAlgo::render_text(ImageBuf& R, int x, int y, string_view text,
     }
 
 #ifdef USE_FREETYPE
-    // Thread safety
-    lock_guard ft_lock(ft_mutex);
-
-    std::string font;
-    bool ok = resolve_font(font_, font);
-    if (!ok) {
-        std::string err = font.size() ? font : "Font error";
-        R.errorfmt("{}", err);
-        return false;
-    }
-
-    int error = 0;
-    FT_Face face;  // handle to face object
-    error = FT_New_Face(ft_library, font.c_str(), 0 /* face index */, &face);
-    if (error) {
-        R.errorfmt("Could not set font face to \"{}\"", font);
-        return false;  // couldn't open the face
-    }
+    // Convert the UTF to 32 bit unicode
+    std::vector<uint32_t> utext;
+    utext.reserve(text.size());
+    Strutil::utf8_to_unicode(text, utext);
 
-    error = FT_Set_Pixel_Sizes(face /*handle*/, 0 /*width*/,
-                               fontsize /*height*/);
-    if (error) {
-        FT_Done_Face(face);
-        R.errorfmt("Could not set font size to {}", fontsize);
-        return false;  // couldn't set the character size
+    // Find the glyphs, holding the lock only while we do that
+    std::vector<GlyphRef> glyphs;
+    {
+        lock_guard ft_lock(ft_mutex);
+        std::string font, err;
+        if (!resolve_font(font_, font)) {
+            R.errorfmt("{}", font.size() ? font : "Font error");
+            return false;
+        }
+        if (!find_glyphs(ustring(font), fontsize, utext, glyphs, err)) {
+            R.errorfmt("{}", err);
+            return false;
+        }
     }
 
-    FT_GlyphSlot slot = face->glyph;  // a small shortcut
     int nchannels(R.nchannels());
     IBA_FIX_PERCHAN_LEN_DEF(textcolor, nchannels);
 
@@ -978,13 +1104,8 @@ ImageBufAlgo::render_text(ImageBuf& R, int x, int y, string_view text,
         textalpha = textcolor[3];
     }
 
-    // Convert the UTF to 32 bit unicode
-    std::vector<uint32_t> utext;
-    utext.reserve(text.size());
-    Strutil::utf8_to_unicode(text, utext);
-
     // Compute the size that the text will render as, into an ROI
-    ROI textroi     = text_size_from_unicode(utext, face, fontsize);
+    ROI textroi     = text_size_from_unicode(utext, glyphs, fontsize);
     textroi.zbegin  = 0;
     textroi.zend    = 1;
     textroi.chbegin = 0;
@@ -1014,27 +1135,29 @@ ImageBufAlgo::render_text(ImageBuf& R, int x, int y, string_view text,
 
     // Glyph by glyph, fill in our textimg buffer
     int origx = x;
-    for (auto ch : utext) {
-        if (ch == '\n') {
+    for (size_t n = 0; n < utext.size(); ++n) {
+        if (utext[n] == '\n') {
             x = origx;
             y += fontsize;
             continue;
         }
-        int error = FT_Load_Char(face, ch, FT_LOAD_RENDER);
-        if (error)
+        const Glyph* g = glyphs[n].get();
+        if (!g)
             continue;  // ignore errors
         // now, draw to our target surface
-        for (int j = 0; j < static_cast<int>(slot->bitmap.rows); ++j) {
-            int ry = y + j - slot->bitmap_top;
-            for (int i = 0; i < static_cast<int>(slot->bitmap.width); ++i) {
-                int rx  = x + i + slot->bitmap_left;
-                float b = slot->bitmap.buffer[slot->bitmap.pitch * j + i]
-                          / 255.0f;
-                textimg.setpixel(rx, ry, &b, 1);
+        for (int j = 0; j < g->rows; ++j) {
+            int ry = y + j - g->top;
+            if (ry < textroi.ybegin || ry >= textroi.yend)
+                continue;
+            const unsigned char* b = &g->bitmap[size_t(j) * g->width];
+            for (int i = 0; i < g->width; ++i) {
+                int rx = x + i + g->left;
+                if (rx >= textroi.xbegin && rx < textroi.xend)
+                    *(float*)textimg.pixeladdr(rx, ry) = b[i] / 255.0f;
             }
         }
         // increment pen position
-        x += slot->advance.x >> 6;
+        x += g->advance;
     }
 
     // Generate the alpha image -- if drop shadow is requested, dilate,
@@ -1051,21 +1174,39 @@ ImageBufAlgo::render_text(ImageBuf& R, int x, int y, string_view text,
         return false;
     roi = roi_intersection(textroi, R.roi());
 
-    // Now fill in the pixels of our destination image
-    float* pixelcolor = OIIO_ALLOCA(float, nchannels);
-    ImageBuf::ConstIterator<float> t(textimg, roi, ImageBuf::WrapBlack);
-    ImageBuf::ConstIterator<float> a(alphaimg, roi, ImageBuf::WrapBlack);
-    ImageBuf::Iterator<float> r(R, roi);
-    for (; !r.done(); ++r, ++t, ++a) {
-        float val   = t[0];
-        float alpha = a[0] * textalpha;
-        R.getpixel(r.x(), r.y(), pixelcolor);
-        for (int c = 0; c < nchannels; ++c)
-            pixelcolor[c] = val * textcolor[c] + (1.0f - alpha) * pixelcolor[c];
-        R.setpixel(r.x(), r.y(), pixelcolor);
+    // Now fill in the pixels of our destination image, a row at a time
+    if (roi.npixels() == 0)
+        return true;
+    roi.chbegin = 0;
+    roi.chend   = nchannels;
+    ROI row(roi.xbegin, roi.xend, 0, 1, 0, 1, 0, 1);
+    std::vector<float> pixels(roi.width() * nchannels);
+    std::vector<float> vals(roi.width()), alphas(roi.width());
+    for (int ry = roi.ybegin; ry < roi.yend; ++ry) {
+        row.ybegin = ry;
+        row.yend   = ry + 1;
+        textimg.get_pixels(row, TypeFloat, vals.data());
+        alphaimg.get_pixels(row, TypeFloat, alphas.data());
+        ROI rrow(roi.xbegin, roi.xend, ry, ry + 1, roi.zbegin, roi.zend, 0,
+                 nchannels);
+        R.get_pixels(rrow, TypeFloat, pixels.data());
+        float* p = pixels.data();
+        if (nchannels == 4) {
+            simd::vfloat4 color(textcolor.data());
+            for (int i = 0; i < roi.width(); ++i, p += 4) {
+                simd::vfloat4 v(p);
+                v = vals[i] * color + (1.0f - alphas[i] * textalpha) * v;
+                v.store(p);
+            }
+        } else {
+            for (int i = 0; i < roi.width(); ++i, p += nchannels) {
+                float alpha = alphas[i] * textalpha;
+                for (int c = 0; c < nchannels; ++c)
+                    p[c] = vals[i] * textcolor[c] + (1.0f - alpha) * p[c];
+            }
+        }
+        R.set_pixels(rrow, TypeFloat, pixels.data());
     }
-
-    FT_Done_Face(face);
     return true;
 
 #else
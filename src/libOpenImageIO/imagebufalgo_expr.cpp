@@ -0,0 +1,276 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+/// \file
+/// Implementation of ImageBufAlgo::Expr, chains of per-pixel operations
+/// evaluated in a single pass.
+
+#include <cmath>
+#include <limits>
+#include <memory>
+#include <vector>
+
+#include <OpenImageIO/color.h>
+#include <OpenImageIO/imagebuf.h>
+#include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/imagebufalgo_util.h>
+
+#include "imageio_pvt.h"
+
+
+OIIO_NAMESPACE_BEGIN
+
+using ImageBufAlgo::Expr;
+
+
+class Expr::Impl {
+public:
+    enum OpType { Add, Mul, Pow, Clamp, ColorConvert };
+    struct Op {
+        OpType type;
+        std::vector<float> a, b;  // per-channel arguments
+        bool flag = false;        // clampalpha01, or unpremult
+        std::shared_ptr<ColorProcessor> processor;
+    };
+
+    Impl(const ImageBuf& src)
+        : m_src(&src)
+    {
+    }
+
+    Op& push(OpType type, cspan<float> a = {})
+    {
+        m_ops.emplace_back();
+        m_ops.back().type = type;
+        m_ops.back().a.assign(a.begin(), a.end());
+        return m_ops.back();
+    }
+
+    // Pixels are processed a strip of rows at a time, of about this many
+    // values, small enough to stay in cache through all the operations.
+    static constexpr int strip_values = 16 * 1024;
+
+    void run(const Op& op, float* p, int npixels, ROI roi) const;
+
+    const ImageBuf* m_src;
+    std::vector<Op> m_ops;
+};
+
+
+
+// Stretch per-channel values to cover all of `nchannels`, as
+// IBA_FIX_PERCHAN_LEN does for the individual functions.
+static void
+fix_perchan(std::vector<float>& v, int nchannels, float zdef)
+{
+    float missing = v.size() ? v.back() : zdef;
+    if (int(v.size()) < nchannels)
+        v.resize(nchannels, missing);
+}
+
+
+
+void
+Expr::Impl::run(const Op& op, float* p, int npixels, ROI roi) const
+{
+    const int nc = roi.nchannels();
+    const int n  = npixels * nc;
+    const float* a = op.a.data() + roi.chbegin;
+    const float* b = op.b.data() + roi.chbegin;
+    switch (op.type) {
+    case Add:
+        for (int i = 0; i < n; i += nc)
+            for (int c = 0; c < nc; ++c)
+                p[i + c] += a[c];
+        break;
+    case Mul:
+        for (int i = 0; i < n; i += nc)
+            for (int c = 0; c < nc; ++c)
+                p[i + c] *= a[c];
+        break;
+    case Pow:
+        for (int i = 0; i < n; i += nc)
+            for (int c = 0; c < nc; ++c)
+                p[i + c] = std::pow(p[i + c], a[c]);
+        break;
+    case Clamp: {
+        for (int i = 0; i < n; i += nc)
+            for (int c = 0; c < nc; ++c)
+                p[i + c] = OIIO::clamp(p[i + c], a[c], b[c]);
+        int alpha = m_src->spec().alpha_channel - roi.chbegin;
+        if (op.flag && alpha >= 0 && alpha < nc)
+            for (int i = 0; i < n; i += nc)
+                p[i + alpha] = OIIO::clamp(p[i + alpha], 0.0f, 1.0f);
+        break;
+    }
+    case ColorConvert: {
+        // Like colorconvert_impl: only the first 4 channels, and alpha
+        // zero pixels keep their color rather than dividing by zero.
+        const int cc         = std::min(nc, 4);
+        const bool unpremult = op.flag && cc == 4;
+        const float fltmin   = std::numeric_limits<float>::min();
+        if (unpremult)
+            for (int i = 0; i < n; i += nc) {
+                float alpha = p[i + 3] >= fltmin ? p[i + 3] : 1.0f;
+                for (int c = 0; c < 3; ++c)
+                    p[i + c] /= alpha;
+            }
+        op.processor->apply(p, npixels, 1, cc, sizeof(float),
+                            nc * sizeof(float), n * sizeof(float));
+        if (unpremult)
+            for (int i = 0; i < n; i += nc) {
+                float alpha = p[i + 3] >= fltmin ? p[i + 3] : 1.0f;
+                for (int c = 0; c < 3; ++c)
+                    p[i + c] *= alpha;
+            }
+        break;
+    }
+    }
+}
+
+
+
+Expr::Expr(const ImageBuf& src)
+    : m_impl(new Impl(src))
+{
+}
+
+
+
+Expr::Expr(const Expr& other)
+    : m_impl(new Impl(*other.m_impl))
+{
+}
+
+
+
+Expr::Expr(Expr&& other) = default;
+Expr::~Expr()            = default;
+
+
+
+Expr&
+Expr::add(cspan<float> b)
+{
+    m_impl->push(Impl::Add, b);
+    return *this;
+}
+
+
+
+Expr&
+Expr::sub(cspan<float> b)
+{
+    auto& op = m_impl->push(Impl::Add, b);
+    for (auto& v : op.a)
+        v = -v;
+    return *this;
+}
+
+
+
+Expr&
+Expr::mul(cspan<float> b)
+{
+    m_impl->push(Impl::Mul, b);
+    return *this;
+}
+
+
+
+Expr&
+Expr::pow(cspan<float> b)
+{
+    m_impl->push(Impl::Pow, b);
+    return *this;
+}
+
+
+
+Expr&
+Expr::clamp(cspan<float> min, cspan<float> max, bool clampalpha01)
+{
+    auto& op = m_impl->push(Impl::Clamp, min);
+    op.b.assign(max.begin(), max.end());
+    op.flag = clampalpha01;
+    return *this;
+}
+
+
+
+Expr&
+Expr::colorconvert(std::shared_ptr<ColorProcessor> processor, bool unpremult)
+{
+    auto& op     = m_impl->push(Impl::ColorConvert);
+    op.processor = std::move(processor);
+    op.flag      = unpremult;
+    return *this;
+}
+
+
+
+bool
+Expr::eval(ImageBuf& dst, ROI roi, int nthreads) const
+{
+    pvt::LoggedTimer logtime("IBA::Expr");
+    const ImageBuf& src(*m_impl->m_src);
+    if (!ImageBufAlgo::IBAprep(roi, &dst, &src,
+                               ImageBufAlgo::IBAprep_CLAMP_MUTUAL_NCHANNELS))
+        return false;
+
+    // Settle the per-channel arguments for this image
+    std::vector<Impl::Op> ops(m_impl->m_ops);
+    for (auto& op : ops) {
+        if (op.type == Impl::Clamp) {
+            // Empty min or max means no clamping on that side
+            fix_perchan(op.a, roi.chend, -std::numeric_limits<float>::max());
+            fix_perchan(op.b, roi.chend, std::numeric_limits<float>::max());
+        } else if (op.type == Impl::ColorConvert) {
+            if (!op.processor || roi.nchannels() < 3) {
+                dst.errorfmt("Expr colorconvert needs {}",
+                             op.processor ? "at least 3 channels"
+                                          : "a color processor");
+                return false;
+            }
+        } else {
+            fix_perchan(op.a, roi.chend, 0.0f);
+        }
+    }
+
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        const int nc   = roi.nchannels();
+        const int rows = OIIO::clamp(Impl::strip_values
+                                         / std::max(roi.width() * nc, 1),
+                                     1, roi.height());
+        std::unique_ptr<float[]> buf(new float[size_t(rows) * roi.width()
+                                               * nc]);
+        for (int z = roi.zbegin; z < roi.zend; ++z) {
+            for (int y = roi.ybegin; y < roi.yend; y += rows) {
+                ROI strip(roi.xbegin, roi.xend, y,
+                          std::min(y + rows, roi.yend), z, z + 1,
+                          roi.chbegin, roi.chend);
+                src.get_pixels(strip, TypeFloat, buf.get());
+                for (auto& op : ops)
+                    m_impl->run(op, buf.get(), int(strip.npixels()), strip);
+                dst.set_pixels(strip, TypeFloat, buf.get());
+            }
+        }
+    });
+    return !dst.has_error();
+}
+
+
+
+ImageBuf
+Expr::eval(ROI roi, int nthreads) const
+{
+    ImageBuf result;
+    bool ok = eval(result, roi, nthreads);
+    if (!ok && !result.has_error())
+        result.errorfmt("ImageBufAlgo::Expr::eval() error");
+    return result;
+}
+
+
+OIIO_NAMESPACE_END
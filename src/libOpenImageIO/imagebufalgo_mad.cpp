@@ -27,8 +27,8 @@ mad_impl(ImageBuf& R, const ImageBuf& A, const ImageBuf& B, const ImageBuf& C,
         if ((is_same<Rtype, float>::value || is_same<Rtype, half>::value)
             && (is_same<ABCtype, float>::value || is_same<ABCtype, half>::value)
             // && R.localpixels() // has to be, because it's writable
-            && A.localpixels() && B.localpixels()
-            && C.localpixels()
+            && pvt::packed_localpixels(A) && pvt::packed_localpixels(B)
+            && pvt::packed_localpixels(C)
             // && R.contains_roi(roi)  // has to be, because IBAPrep
             && A.contains_roi(roi) && B.contains_roi(roi) && C.contains_roi(roi)
             && roi.chbegin == 0 && roi.chend == R.nchannels()
@@ -6,9 +6,12 @@
 /// Implementation of ImageBufAlgo algorithms that do math on
 /// single pixels at a time.
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <limits>
+#include <type_traits>
+#include <vector>
 
 #include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
@@ -19,6 +22,7 @@
 #include <OpenImageIO/simd.h>
 
 #include "imageio_pvt.h"
+#include "simd_kernels_pvt.h"
 
 
 OIIO_NAMESPACE_BEGIN
@@ -1356,72 +1360,94 @@ isfinite(half h)
 }
 
 
+// Check the channels of the pixel for non-finite values and, depending on
+// the mode, fix them. Return true if there were any.
 template<typename T>
 bool
-fixNonFinite_(ImageBuf& dst, ImageBufAlgo::NonFiniteFixMode mode,
-              int* pixelsFixed, ROI roi, int nthreads)
+fixNonFinite_pixel(ImageBuf& dst, ImageBuf::Iterator<T, T>& pixel,
+                   ImageBufAlgo::NonFiniteFixMode mode, ROI roi,
+                   const ROI& dstroi)
 {
-    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        ROI dstroi = get_roi(dst.spec());
-        int count  = 0;  // Number of pixels with nonfinite values
-
+    bool fixed = false;
+    for (int c = roi.chbegin; c < roi.chend; ++c) {
+        T value = pixel[c];
+        if (isfinite(value))
+            continue;
+        fixed = true;
         if (mode == ImageBufAlgo::NONFINITE_NONE
             || mode == ImageBufAlgo::NONFINITE_ERROR) {
-            // Just count the number of pixels with non-finite values
-            for (ImageBuf::Iterator<T, T> pixel(dst, roi); !pixel.done();
-                 ++pixel) {
-                for (int c = roi.chbegin; c < roi.chend; ++c) {
-                    T value = pixel[c];
-                    if (!isfinite(value)) {
-                        ++count;
-                        break;  // only count one per pixel
-                    }
-                }
-            }
+            // Just count the pixel
+            break;
         } else if (mode == ImageBufAlgo::NONFINITE_BLACK) {
             // Replace non-finite pixels with black
-            for (ImageBuf::Iterator<T, T> pixel(dst, roi); !pixel.done();
-                 ++pixel) {
-                bool fixed = false;
-                for (int c = roi.chbegin; c < roi.chend; ++c) {
-                    T value = pixel[c];
-                    if (!isfinite(value)) {
-                        pixel[c] = T(0.0);
-                        fixed    = true;
-                    }
-                }
-                if (fixed)
-                    ++count;
-            }
+            pixel[c] = T(0.0);
         } else if (mode == ImageBufAlgo::NONFINITE_BOX3) {
             // Replace non-finite pixels with a simple 3x3 window average
             // (the average excluding non-finite pixels, of course)
-            for (ImageBuf::Iterator<T, T> pixel(dst, roi); !pixel.done();
-                 ++pixel) {
-                bool fixed = false;
-                for (int c = roi.chbegin; c < roi.chend; ++c) {
-                    T value = pixel[c];
-                    if (!isfinite(value)) {
-                        int numvals = 0;
-                        T sum(0.0);
-                        ROI roi2(pixel.x() - 1, pixel.x() + 2, pixel.y() - 1,
-                                 pixel.y() + 2, pixel.z() - 1, pixel.z() + 2);
-                        roi2 = roi_intersection(roi2, dstroi);
-                        for (ImageBuf::Iterator<T, T> i(dst, roi2); !i.done();
-                             ++i) {
-                            T v = i[c];
-                            if (isfinite(v)) {
-                                sum += v;
-                                ++numvals;
-                            }
-                        }
-                        pixel[c] = numvals ? T(sum / numvals) : T(0.0);
-                        fixed    = true;
+            int numvals = 0;
+            T sum(0.0);
+            ROI roi2(pixel.x() - 1, pixel.x() + 2, pixel.y() - 1,
+                     pixel.y() + 2, pixel.z() - 1, pixel.z() + 2);
+            roi2 = roi_intersection(roi2, dstroi);
+            for (ImageBuf::Iterator<T, T> i(dst, roi2); !i.done(); ++i) {
+                T v = i[c];
+                if (isfinite(v)) {
+                    sum += v;
+                    ++numvals;
+                }
+            }
+            pixel[c] = numvals ? T(sum / numvals) : T(0.0);
+        }
+    }
+    return fixed;
+}
+
+
+
+template<typename T>
+bool
+fixNonFinite_(ImageBuf& dst, ImageBufAlgo::NonFiniteFixMode mode,
+              int* pixelsFixed, ROI roi, int nthreads)
+{
+    // If the pixels are in memory and packed, each scanline of the ROI is
+    // first scanned for NaN and Inf values as one span, with SIMD, and only
+    // the pixels it finds are examined channel by channel (in the same
+    // order as otherwise, so the results are the same). Clean images take
+    // little more than a pass over the memory. Getting the local pixels
+    // (non-const) first makes sure that they are our own to write.
+    const bool packed = dst.localpixels() && pvt::packed_localpixels(dst)
+                        && dst.spec().format.basetype
+                               == BaseTypeFromC<T>::value;
+    const pvt::SimdKernels& kernels(pvt::simd_kernels());
+    pvt::FindNonfiniteKernel find_nonfinite
+        = std::is_same<T, float>::value  ? kernels.find_nonfinite_float
+          : std::is_same<T, half>::value ? kernels.find_nonfinite_half
+                                         : kernels.find_nonfinite_double;
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        ROI dstroi = get_roi(dst.spec());
+        int count  = 0;  // Number of pixels with nonfinite values
+        if (packed) {
+            const size_t nc = size_t(dst.nchannels());
+            const size_t n  = size_t(roi.width()) * nc;
+            for (int z = roi.zbegin; z < roi.zend; ++z) {
+                for (int y = roi.ybegin; y < roi.yend; ++y) {
+                    const T* row = (const T*)dst.pixeladdr(roi.xbegin, y, z);
+                    for (size_t i = find_nonfinite(row, n); i < n;) {
+                        size_t p = i / nc;
+                        ImageBuf::Iterator<T, T> pixel(dst, roi.xbegin + int(p),
+                                                       y, z);
+                        if (fixNonFinite_pixel(dst, pixel, mode, roi, dstroi))
+                            ++count;
+                        i = (p + 1) * nc;
+                        i += find_nonfinite(row + i, n - i);
                     }
                 }
-                if (fixed)
-                    ++count;
             }
+        } else {
+            for (ImageBuf::Iterator<T, T> pixel(dst, roi); !pixel.done();
+                 ++pixel)
+                if (fixNonFinite_pixel(dst, pixel, mode, roi, dstroi))
+                    ++count;
         }
 
         if (pixelsFixed) {
@@ -1642,35 +1668,80 @@ over_impl(ImageBuf& R, const ImageBuf& A, const ImageBuf& B, bool zcomp,
 
 
 
-// Special case -- 4 channel RGBA float, in-memory buffer, no wrapping.
-// Use loops and SIMD.
+// Copy n RGBA pixels, converting between float and half as needed.
+template<class S, class D>
+inline void
+copy_rgba(const S* s, D* d, int n)
+{
+    if (std::is_same<S, D>::value) {
+        if ((const void*)s != (const void*)d)
+            memcpy((void*)d, s, size_t(n) * 4 * sizeof(S));
+    } else {
+        simd::vfloat4 v;
+        for (int i = 0; i < n; ++i, s += 4, d += 4) {
+            v.load(s);
+            v.store(d);
+        }
+    }
+}
+
+
+
+// Special case -- 4 channel RGBA float or half, in-memory buffers, no
+// wrapping. Use loops and SIMD. Each row is taken in spans, and a quick
+// scan of A's alpha lets spans where A is fully opaque just copy A, and
+// spans where A is entirely zero just copy B.
+template<class Rtype, class ABtype>
 static bool
-over_impl_rgbafloat(ImageBuf& R, const ImageBuf& A, const ImageBuf& B, ROI roi,
-                    int nthreads)
+over_impl_rgba(ImageBuf& R, const ImageBuf& A, const ImageBuf& B, ROI roi,
+               int nthreads)
 {
     using namespace simd;
-    OIIO_DASSERT(A.localpixels() && B.localpixels()
-                 && A.spec().format == TypeFloat && A.nchannels() == 4
-                 && B.spec().format == TypeFloat && B.nchannels() == 4
-                 && A.spec().alpha_channel == 3 && A.spec().z_channel < 0
-                 && B.spec().alpha_channel == 3 && B.spec().z_channel < 0);
+    OIIO_DASSERT(A.localpixels() && B.localpixels() && R.localpixels()
+                 && A.spec().format == BaseTypeFromC<ABtype>::value
+                 && B.spec().format == BaseTypeFromC<ABtype>::value
+                 && R.spec().format == BaseTypeFromC<Rtype>::value
+                 && A.nchannels() == 4 && B.nchannels() == 4
+                 && R.nchannels() == 4 && A.spec().alpha_channel == 3
+                 && A.spec().z_channel < 0 && B.spec().alpha_channel == 3
+                 && B.spec().z_channel < 0);
     // const int nchannels = 4, alpha_channel = 3;
     ImageBufAlgo::parallel_image(roi, nthreads, [=, &R, &A, &B](ROI roi) {
-        vfloat4 zero = vfloat4::Zero();
-        vfloat4 one  = vfloat4::One();
-        int w        = roi.width();
+        const int span = 64;
+        vfloat4 zero   = vfloat4::Zero();
+        vfloat4 one    = vfloat4::One();
+        int w          = roi.width();
         for (int z = roi.zbegin; z < roi.zend; ++z) {
             for (int y = roi.ybegin; y < roi.yend; ++y) {
-                float* r       = (float*)R.pixeladdr(roi.xbegin, y, z);
-                const float* a = (const float*)A.pixeladdr(roi.xbegin, y, z);
-                const float* b = (const float*)B.pixeladdr(roi.xbegin, y, z);
-                for (int x = 0; x < w; ++x, r += 4, a += 4, b += 4) {
-                    vfloat4 a_simd(a);
-                    vfloat4 b_simd(b);
-                    vfloat4 alpha           = shuffle<3>(a_simd);
-                    vfloat4 one_minus_alpha = one - clamp(alpha, zero, one);
-                    vfloat4 result          = a_simd + one_minus_alpha * b_simd;
-                    result.store(r);
+                Rtype* r        = (Rtype*)R.pixeladdr(roi.xbegin, y, z);
+                const ABtype* a = (const ABtype*)A.pixeladdr(roi.xbegin, y, z);
+                const ABtype* b = (const ABtype*)B.pixeladdr(roi.xbegin, y, z);
+                for (int x0 = 0; x0 < w; x0 += span) {
+                    int n       = std::min(span, w - x0);
+                    bool opaque = true, clear = true;
+                    for (int i = 0; i < n; ++i)
+                        opaque &= float(a[4 * i + 3]) >= 1.0f;
+                    for (int i = 0; i < 4 * n && !opaque && clear; ++i)
+                        clear = float(a[i]) == 0.0f;
+                    if (opaque) {
+                        copy_rgba(a, r, n);
+                    } else if (clear) {
+                        copy_rgba(b, r, n);
+                    } else {
+                        vfloat4 a_simd, b_simd;
+                        for (int i = 0; i < n; ++i) {
+                            a_simd.load(a + 4 * i);
+                            b_simd.load(b + 4 * i);
+                            vfloat4 alpha = shuffle<3>(a_simd);
+                            vfloat4 one_minus_alpha = one
+                                                      - clamp(alpha, zero, one);
+                            vfloat4 result = a_simd + one_minus_alpha * b_simd;
+                            result.store(r + 4 * i);
+                        }
+                    }
+                    r += 4 * n;
+                    a += 4 * n;
+                    b += 4 * n;
                 }
             }
         }
@@ -1689,17 +1760,26 @@ ImageBufAlgo::over(ImageBuf& dst, const ImageBuf& A, const ImageBuf& B, ROI roi,
                  IBAprep_REQUIRE_ALPHA | IBAprep_REQUIRE_SAME_NCHANNELS))
         return false;
 
-    if (A.localpixels() && B.localpixels() && A.spec().format == TypeFloat
-        && A.nchannels() == 4 && B.spec().format == TypeFloat
-        && B.nchannels() == 4 && A.spec().alpha_channel == 3
-        && A.spec().z_channel < 0 && B.spec().alpha_channel == 3
-        && B.spec().z_channel < 0 && A.roi().contains(roi)
-        && B.roi().contains(roi) && roi.chbegin == 0 && roi.chend == 4) {
-        // Easy case -- both buffers are float, 4 channels, alpha is
-        // channel[3], no special z channel, and pixel data windows
-        // completely cover the roi. This reduces to a simpler case we can
-        // handle without iterators and taking advantage of SIMD.
-        return over_impl_rgbafloat(dst, A, B, roi, nthreads);
+    TypeDesc abformat = A.spec().format;
+    if (pvt::packed_localpixels(A) && pvt::packed_localpixels(B)
+        && dst.localpixels() && pvt::packed_localpixels(dst)
+        && (abformat == TypeFloat || abformat == TypeHalf)
+        && B.spec().format == abformat
+        && (dst.spec().format == TypeFloat || dst.spec().format == abformat)
+        && A.nchannels() == 4 && B.nchannels() == 4 && dst.nchannels() == 4
+        && A.spec().alpha_channel == 3 && A.spec().z_channel < 0
+        && B.spec().alpha_channel == 3 && B.spec().z_channel < 0
+        && A.roi().contains(roi) && B.roi().contains(roi)
+        && dst.roi().contains(roi) && roi.chbegin == 0 && roi.chend == 4) {
+        // Easy case -- both buffers are float (or both half), 4 channels,
+        // alpha is channel[3], no special z channel, and pixel data
+        // windows completely cover the roi. This reduces to a simpler case
+        // we can handle without iterators and taking advantage of SIMD.
+        if (abformat == TypeHalf && dst.spec().format == TypeHalf)
+            return over_impl_rgba<half, half>(dst, A, B, roi, nthreads);
+        if (abformat == TypeHalf)
+            return over_impl_rgba<float, half>(dst, A, B, roi, nthreads);
+        return over_impl_rgba<float, float>(dst, A, B, roi, nthreads);
     }
 
     bool ok;
@@ -1723,6 +1803,110 @@ ImageBufAlgo::over(const ImageBuf& A, const ImageBuf& B, ROI roi, int nthreads)
 
 
 
+bool
+ImageBufAlgo::over(ImageBuf& dst, cspan<const ImageBuf*> layers, ROI roi,
+                   int nthreads)
+{
+    pvt::LoggedTimer logtime("IBA::over");
+    if (!layers.size()) {
+        dst.errorfmt("over() needs at least one layer");
+        return false;
+    }
+    for (const ImageBuf* L : layers) {
+        if (!L || !L->initialized()) {
+            dst.errorfmt("over(): uninitialized layer");
+            return false;
+        }
+        if (L->deep()) {
+            dst.errorfmt("deep images not supported");
+            return false;
+        }
+        if (L->nchannels() != layers[0]->nchannels()
+            || L->spec().alpha_channel != layers[0]->spec().alpha_channel) {
+            dst.errorfmt(
+                "over(): all layers must have the same channels and alpha");
+            return false;
+        }
+    }
+    const ImageBuf& A(*layers[0]);
+    if (!dst.initialized() && !roi.defined()) {
+        // Like IBAprep does for two inputs: cover the union of the layers,
+        // and punt to float if they don't agree on a data type.
+        ImageSpec spec = A.spec();
+        ROI full       = A.roi_full();
+        roi            = A.roi();
+        for (const ImageBuf* L : layers) {
+            roi  = roi_union(roi, L->roi());
+            full = roi_union(full, L->roi_full());
+            if (L->spec().format != A.spec().format)
+                spec.set_format(TypeFloat);
+        }
+        set_roi(spec, roi);
+        set_roi_full(spec, full);
+        spec.tile_width = spec.tile_height = spec.tile_depth = 0;
+        spec.erase_attribute("oiio:SHA-1");
+        dst.reset(spec);
+    }
+    if (!IBAprep(roi, &dst, &A,
+                 IBAprep_REQUIRE_ALPHA | IBAprep_REQUIRE_SAME_NCHANNELS))
+        return false;
+
+    // Accumulate front to back, one row at a time. Pixels stop taking
+    // contributions once they are opaque, and the rest of the layers are
+    // not read at all once the whole row is.
+    const int nc    = A.nchannels();
+    const int alpha = A.spec().alpha_channel;
+    roi.chbegin     = 0;
+    roi.chend       = nc;
+    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+        const int w = roi.width();
+        std::vector<float> acc(size_t(w) * nc), tmp(size_t(w) * nc);
+        for (int z = roi.zbegin; z < roi.zend; ++z) {
+            for (int y = roi.ybegin; y < roi.yend; ++y) {
+                ROI row(roi.xbegin, roi.xend, y, y + 1, z, z + 1, 0, nc);
+                std::fill(acc.begin(), acc.end(), 0.0f);
+                int nopaque = 0;
+                const size_t nlayers = size_t(layers.size());
+                for (size_t i = 0; i < nlayers && nopaque < w; ++i) {
+                    ROI lr = roi_intersection(row, layers[i]->roi());
+                    if (lr.width() <= 0 || lr.height() <= 0
+                        || lr.depth() <= 0)
+                        continue;
+                    layers[i]->get_pixels(lr, TypeFloat, tmp.data());
+                    float* p = acc.data() + size_t(lr.xbegin - row.xbegin) * nc;
+                    const float* s = tmp.data();
+                    for (int x = lr.xbegin; x < lr.xend; ++x) {
+                        if (p[alpha] < 1.0f) {
+                            float t = 1.0f - OIIO::clamp(p[alpha], 0.0f, 1.0f);
+                            for (int c = 0; c < nc; ++c)
+                                p[c] += t * s[c];
+                            nopaque += p[alpha] >= 1.0f;
+                        }
+                        p += nc;
+                        s += nc;
+                    }
+                }
+                dst.set_pixels(row, TypeFloat, acc.data());
+            }
+        }
+    });
+    return !dst.has_error();
+}
+
+
+
+ImageBuf
+ImageBufAlgo::over(cspan<const ImageBuf*> layers, ROI roi, int nthreads)
+{
+    ImageBuf result;
+    bool ok = over(result, layers, roi, nthreads);
+    if (!ok && !result.has_error())
+        result.errorfmt("ImageBufAlgo::over() error");
+    return result;
+}
+
+
+
 bool
 ImageBufAlgo::zover(ImageBuf& dst, const ImageBuf& A, const ImageBuf& B,
                     bool z_zeroisinf, ROI roi, int nthreads)
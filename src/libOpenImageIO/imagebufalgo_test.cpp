@@ -3,10 +3,15 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <iomanip>
 #include <iostream>
+#include <limits>
+#include <sstream>
 #include <string>
+#include <thread>
 
 #include <OpenImageIO/platform.h>
 
@@ -18,11 +23,14 @@
 #    include <opencv2/opencv.hpp>
 #endif
 
+#include <OpenImageIO/Imath.h>
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/color.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagebufalgo_util.h>
+#include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/timer.h>
 #include <OpenImageIO/unittest.h>
@@ -357,6 +365,45 @@ test_channel_append()
 
 
 
+// channels() of a run of channels, and cut() of a region, of an in-memory
+// image are views of its pixels rather than copies.
+void
+test_channel_views()
+{
+    std::cout << "test channel views\n";
+    ImageBuf A(ImageSpec(8, 6, 5, TypeDesc::HALF));
+    const float color[5] = { 0.1f, 0.2f, 0.3f, 0.4f, 0.5f };
+    ImageBufAlgo::fill(A, color);
+    const ImageBuf& Aconst(A);
+
+    int order[3] = { 1, 2, 3 };
+    ImageBuf C   = ImageBufAlgo::channels(A, 3, order);
+    ImageBuf D   = ImageBufAlgo::channels(A, 3, order);
+    const ImageBuf& Cconst(C);
+    OIIO_CHECK_EQUAL(C.nchannels(), 3);
+    OIIO_CHECK_EQUAL(C.spec().channel_name(0), "G");
+    OIIO_CHECK_EQUAL(Cconst.localpixels(), Aconst.pixeladdr(0, 0, 0, 1));
+    OIIO_CHECK_EQUAL(C.getchannel(7, 5, 0, 2), float(half(0.4f)));
+    ImageBufAlgo::zero(C);
+    OIIO_CHECK_EQUAL(A.getchannel(7, 5, 0, 2), float(half(0.3f)));
+    OIIO_CHECK_EQUAL(D.getchannel(7, 5, 0, 0), float(half(0.2f)));
+
+    // A reordering still copies
+    int swapped[2] = { 2, 1 };
+    ImageBuf S     = ImageBufAlgo::channels(A, 2, swapped);
+    OIIO_CHECK_EQUAL(S.getchannel(0, 0, 0, 0), float(half(0.3f)));
+    OIIO_CHECK_EQUAL(S.getchannel(0, 0, 0, 1), float(half(0.2f)));
+
+    ImageBuf R = ImageBufAlgo::cut(A, ROI(2, 5, 1, 4));
+    const ImageBuf& Rconst(R);
+    OIIO_CHECK_EQUAL(R.roi(), ROI(0, 3, 0, 3, 0, 1, 0, 5));
+    OIIO_CHECK_EQUAL(R.roi_full(), R.roi());
+    OIIO_CHECK_EQUAL(Rconst.localpixels(), Aconst.pixeladdr(2, 1));
+    OIIO_CHECK_EQUAL(R.getchannel(2, 2, 0, 4), float(half(0.5f)));
+}
+
+
+
 // Tests ImageBufAlgo::add
 void
 test_add()
@@ -390,6 +437,264 @@ test_add()
 
 
 
+// Tests ImageBufAlgo::for_each_row
+void
+test_for_each_row()
+{
+    std::cout << "test for_each_row\n";
+    ImageSpec spec(8, 4, 3, TypeDesc::FLOAT);
+    spec.x = 10;
+    ImageBuf A(spec);
+    ROI roi(12, 16, 1, 3, 0, 1, 0, 3);
+    int rows = 0;
+    bool ok  = ImageBufAlgo::for_each_row<float>(
+        A, roi, [&](span<float> row, int y, int /*z*/) {
+            OIIO_CHECK_EQUAL(row.size(), 4 * 3);
+            for (auto& v : row)
+                v = float(y);
+            ++rows;
+        });
+    OIIO_CHECK_ASSERT(ok);
+    OIIO_CHECK_EQUAL(rows, 2);
+    OIIO_CHECK_EQUAL(A.getchannel(13, 2, 0, 1), 2.0f);
+    OIIO_CHECK_EQUAL(A.getchannel(11, 2, 0, 1), 0.0f);
+    OIIO_CHECK_EQUAL(A.getchannel(13, 0, 0, 1), 0.0f);
+
+    // Wrong pixel type, or a region outside the data window, are refused
+    auto never = [&](cspan<uint8_t>, int, int) { OIIO_CHECK_ASSERT(0); };
+    OIIO_CHECK_ASSERT(
+        !ImageBufAlgo::for_each_row<uint8_t>((const ImageBuf&)A, roi, never));
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::has_row_spans<float>(
+        A, ROI(0, 16, 0, 4, 0, 1, 0, 3)));
+}
+
+
+
+// Small images are processed inline, on the calling thread, and writing
+// to an existing image only clears its thumbnail metadata.
+void
+test_small_image_inline()
+{
+    std::cout << "test small image inline\n";
+    int calls = 0;
+    auto caller = std::this_thread::get_id();
+    ImageBufAlgo::parallel_image(ROI(0, 64, 0, 64), 0, [&](ROI roi) {
+        OIIO_CHECK_ASSERT(std::this_thread::get_id() == caller);
+        OIIO_CHECK_EQUAL(roi, ROI(0, 64, 0, 64));
+        ++calls;
+    });
+    OIIO_CHECK_EQUAL(calls, 1);
+
+    ImageSpec spec(16, 16, 3, TypeDesc::FLOAT);
+    spec["Artist"]          = "me";
+    spec["thumbnail_width"] = 4;
+    ImageBuf A(spec);
+    const float one[3] = { 1.0f, 1.0f, 1.0f };
+    OIIO_CHECK_ASSERT(ImageBufAlgo::fill(A, one));
+    OIIO_CHECK_EQUAL(A.spec().get_string_attribute("Artist"), "me");
+    OIIO_CHECK_ASSERT(!A.spec().find_attribute("thumbnail_width"));
+    OIIO_CHECK_ASSERT(ImageBufAlgo::add(A, A, 1.0f));
+    OIIO_CHECK_EQUAL(A.getchannel(15, 15, 0, 2), 2.0f);
+    OIIO_CHECK_EQUAL(A.spec().get_string_attribute("Artist"), "me");
+}
+
+
+
+// Tests ImageBufAlgo::Expr against the separate operations
+void
+test_expr()
+{
+    std::cout << "test Expr\n";
+    ImageSpec spec(37, 21, 4, TypeDesc::FLOAT);
+    spec.alpha_channel = 3;
+    ImageBuf A(spec);
+    const float top[]    = { 0.1f, 0.2f, 0.3f, 0.4f };
+    const float bottom[] = { 0.9f, 0.8f, 0.7f, 1.5f };
+    ImageBufAlgo::fill(A, top, bottom);
+    const float gain[] = { 2.0f, 1.5f, 1.0f, 0.5f };
+    const float off[]  = { -0.1f };
+
+    ImageBuf R = ImageBufAlgo::mul(A, gain);
+    R          = ImageBufAlgo::sub(R, off);
+    R          = ImageBufAlgo::clamp(R, 0.0f, 1.2f, true);
+    R          = ImageBufAlgo::pow(R, 0.5f);
+
+    ImageBuf E
+        = ImageBufAlgo::Expr(A).mul(gain).sub(off).clamp(0.0f, 1.2f, true)
+              .pow(0.5f).eval();
+    OIIO_CHECK_EQUAL(E.roi(), R.roi());
+    auto comp = ImageBufAlgo::compare(R, E, 1e-6f, 1e-6f);
+    OIIO_CHECK_EQUAL(comp.nfail, 0);
+
+    // In place, on a channel subset
+    ImageBuf B(A);
+    ImageBufAlgo::Expr(B).add(1.0f).eval(B, ROI(0, 37, 0, 21, 0, 1, 1, 2));
+    OIIO_CHECK_EQUAL(B.getchannel(5, 5, 0, 1), A.getchannel(5, 5, 0, 1) + 1.0f);
+    OIIO_CHECK_EQUAL(B.getchannel(5, 5, 0, 2), A.getchannel(5, 5, 0, 2));
+}
+
+
+
+// Tests the two pass resize for separable filters against the one pass
+// version, which is still used for double images.
+void
+test_resize()
+{
+    std::cout << "test resize\n";
+    ImageSpec spec(67, 45, 3, TypeDesc::DOUBLE);
+    spec.full_x = -3;  // data window inside the full window
+    spec.full_width += 6;
+    ImageBuf Ad(spec);
+    const float top[]    = { 0.0f, 1.0f, 0.25f };
+    const float bottom[] = { 1.0f, 0.0f, 0.75f };
+    ImageBufAlgo::fill(Ad, top, top, bottom, bottom);
+    ImageBuf Af;
+    Af.copy(Ad, TypeFloat);
+
+    for (auto filtername : { "lanczos3", "blackman-harris", "box" }) {
+        for (auto size : { ROI(0, 30, 0, 17, 0, 1, 0, 3),
+                           ROI(0, 150, 0, 90, 0, 1, 0, 3) }) {
+            ImageBuf Rd(ImageSpec(size, TypeDesc::DOUBLE));
+            ImageBuf Rf(ImageSpec(size, TypeDesc::FLOAT));
+            ImageBufAlgo::resize(Rd, Ad, filtername);
+            ImageBufAlgo::resize(Rf, Af, filtername);
+            auto comp = ImageBufAlgo::compare(Rf, Rd, 1e-5f, 1e-5f);
+            OIIO_CHECK_EQUAL(comp.nfail, 0);
+        }
+    }
+}
+
+
+
+// Affine warps of local pixels take a separable fast path. Compare with
+// the same warp of an ImageCache-backed copy, which takes the general one.
+void
+test_warp()
+{
+    std::cout << "test warp\n";
+    ImageBuf A(ImageSpec(64, 48, 3, TypeDesc::FLOAT));
+    const float top[]    = { 0.0f, 1.0f, 0.25f };
+    const float bottom[] = { 1.0f, 0.0f, 0.75f };
+    ImageBufAlgo::fill(A, top, top, bottom, bottom);
+    const float pink[] = { 1.0f, 0.5f, 0.5f };
+    ImageBufAlgo::render_box(A, 20, 10, 40, 30, pink, true);
+    A.write("warp_src.exr");
+    ImageCache* ic = ImageCache::create(false);
+    ImageBuf C("warp_src.exr", 0, 0, ic);
+    C.read();
+    OIIO_CHECK_ASSERT(!C.localpixels());
+
+    Imath::M33f M;
+    M.rotate(0.3f);
+    M.scale(Imath::V2f(0.7f, 1.3f));
+    M.translate(Imath::V2f(5.0f, -3.0f));
+    for (auto filtername : { "lanczos3", "gaussian", "box" }) {
+        for (auto wrap : { ImageBuf::WrapBlack, ImageBuf::WrapPeriodic }) {
+            ImageBuf Rl = ImageBufAlgo::warp(A, M, filtername, 0.0f, false,
+                                             wrap);
+            ImageBuf Rc = ImageBufAlgo::warp(C, M, filtername, 0.0f, false,
+                                             wrap);
+            auto comp = ImageBufAlgo::compare(Rl, Rc, 1e-5f, 1e-5f);
+            OIIO_CHECK_EQUAL(comp.nfail, 0);
+        }
+    }
+    C.clear();
+    ic->destroy(ic);
+}
+
+
+
+// Separable kernels take two 1D passes and large ones go through FFT;
+// check both against a direct evaluation with clamped edges.
+void
+test_convolve()
+{
+    std::cout << "test convolve\n";
+    ImageSpec spec(53, 41, 3, TypeDesc::FLOAT);
+    spec.x = 5;
+    spec.y = -2;
+    ImageBuf A(spec);
+    ImageBufAlgo::noise(A, "uniform", 0.0f, 1.0f, false, 1);
+
+    ImageSpec kspec(20, 17, 1, TypeDesc::FLOAT);
+    kspec.x = -10;
+    kspec.y = -8;
+    ImageBuf Knoise(kspec);
+    ImageBufAlgo::noise(Knoise, "uniform", 0.0f, 1.0f, false, 2);
+    ImageBuf Kgauss = ImageBufAlgo::make_kernel("gaussian", 9.0f, 5.0f);
+
+    for (const ImageBuf* K : { &Kgauss, &Knoise }) {
+        ImageBuf R = ImageBufAlgo::convolve(A, *K, true);
+        ImageBuf Ref(spec);
+        float ksum = 0.0f;
+        for (ImageBuf::ConstIterator<float> k(*K); !k.done(); ++k)
+            ksum += k[0];
+        for (ImageBuf::Iterator<float> r(Ref); !r.done(); ++r) {
+            for (int c = 0; c < 3; ++c) {
+                float sum = 0.0f;
+                for (ImageBuf::ConstIterator<float> k(*K); !k.done(); ++k)
+                    sum += k[0]
+                           * A.getchannel(clamp(r.x() + k.x(), A.xbegin(),
+                                                A.xend() - 1),
+                                          clamp(r.y() + k.y(), A.ybegin(),
+                                                A.yend() - 1),
+                                          0, c);
+                r[c] = sum / ksum;
+            }
+        }
+        auto comp = ImageBufAlgo::compare(R, Ref, 1e-4f, 1e-4f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+    }
+}
+
+
+
+// 8 and 16 bit median filters use histograms, and dilate/erode run van
+// Herk min/max; check them against the float median and a direct search.
+void
+test_median_morph()
+{
+    std::cout << "test median_filter, dilate, erode\n";
+    ImageSpec spec(37, 29, 2, TypeDesc::FLOAT);
+    spec.x = -4;
+    spec.y = 3;
+    ImageBuf A(spec);
+    ImageBufAlgo::noise(A, "uniform", 0.0f, 1.0f, false, 3);
+
+    for (TypeDesc fmt : { TypeUInt8, TypeUInt16 }) {
+        ImageBuf Ai, Af;
+        Ai.copy(A, fmt);
+        Af.copy(Ai, TypeFloat);
+        ImageBuf Ri = ImageBufAlgo::median_filter(Ai, 5, 7);
+        ImageBuf Rf = ImageBufAlgo::median_filter(Af, 5, 7);
+        auto comp = ImageBufAlgo::compare(Ri, Rf, 1e-6f, 1e-6f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+    }
+
+    const int width = 4, height = 6;
+    ImageBuf D = ImageBufAlgo::dilate(A, width, height);
+    ImageBuf E = ImageBufAlgo::erode(A, width, height);
+    for (ImageBuf::ConstIterator<float> d(D), e(E); !d.done(); ++d, ++e) {
+        for (int c = 0; c < 2; ++c) {
+            float hi = -std::numeric_limits<float>::max();
+            float lo = std::numeric_limits<float>::max();
+            for (int y = d.y() - height / 2; y < d.y() - height / 2 + height;
+                 ++y)
+                for (int x = d.x() - width / 2; x < d.x() - width / 2 + width;
+                     ++x)
+                    if (x >= A.xbegin() && x < A.xend() && y >= A.ybegin()
+                        && y < A.yend()) {
+                        hi = std::max(hi, A.getchannel(x, y, 0, c));
+                        lo = std::min(lo, A.getchannel(x, y, 0, c));
+                    }
+            OIIO_CHECK_EQUAL(d[c], hi);
+            OIIO_CHECK_EQUAL(e[c], lo);
+        }
+    }
+}
+
+
+
 // Tests ImageBufAlgo::sub
 void
 test_sub()
@@ -528,6 +833,56 @@ test_over()
                 OIIO_CHECK_EQUAL(r[c], BGval[c]);
     }
 
+    // Rows mixing opaque, empty, and partly covered spans of the
+    // foreground, for the float and half fast paths
+    ImageSpec wide(300, 3, CHANNELS, TypeFloat);
+    ImageBuf FGw(wide), BGw(wide);
+    ImageBufAlgo::fill(BGw, BGval);
+    const float opaque[CHANNELS] = { 0.25f, 0.5f, 1.0f, 1.0f };
+    ImageBufAlgo::fill(FGw, opaque, ROI(0, 128, 0, 3));
+    ImageBufAlgo::fill(FGw, FGval, ROI(150, 230, 0, 3));
+    for (TypeDesc t : { TypeFloat, TypeHalf }) {
+        ImageBuf F(FGw.spec()), B(BGw.spec());
+        if (t == TypeHalf) {
+            F = ImageBufAlgo::copy(FGw, TypeHalf);
+            B = ImageBufAlgo::copy(BGw, TypeHalf);
+        } else {
+            F.copy(FGw);
+            B.copy(BGw);
+        }
+        ImageBuf Rw = ImageBufAlgo::over(F, B);
+        OIIO_CHECK_ASSERT(Rw.spec().format == t);
+        for (ImageBuf::ConstIterator<float> r(Rw), f(F), b(B); !r.done();
+             ++r, ++f, ++b)
+            for (int c = 0; c < CHANNELS; ++c)
+                OIIO_CHECK_EQUAL_THRESH(r[c], f[c] + (1.0f - f[3]) * b[c],
+                                        1e-3f);
+    }
+
+    // Fused stack of layers, with data windows that only partly overlap,
+    // against the chain of pairwise over operations.
+    ImageBuf L0(ImageSpec(ROI(2, 10, 0, 6, 0, 1, 0, 4), TypeFloat));
+    ImageBuf L1(ImageSpec(ROI(0, 8, 2, 8, 0, 1, 0, 4), TypeHalf));
+    ImageBuf L2(ImageSpec(ROI(0, 12, 0, 8, 0, 1, 0, 4), TypeFloat));
+    const float L0val[CHANNELS] = { 0.1f, 0.2f, 0.0f, 0.4f };
+    const float L1val[CHANNELS] = { 0.0f, 0.25f, 0.5f, 0.5f };
+    ImageBufAlgo::fill(L0, L0val);
+    ImageBufAlgo::fill(L0, opaque, ROI(2, 4, 0, 6));
+    ImageBufAlgo::fill(L1, L1val);
+    ImageBufAlgo::fill(L2, BGval);
+    ImageBuf stack = ImageBufAlgo::over({ &L0, &L1, &L2 });
+    ImageBuf chain = ImageBufAlgo::over(L0, ImageBufAlgo::over(L1, L2));
+    OIIO_CHECK_ASSERT(stack.roi() == chain.roi());
+    OIIO_CHECK_ASSERT(stack.spec().format == TypeFloat);
+    auto cr = ImageBufAlgo::compare(stack, chain, 1.0e-6f, 1.0e-6f);
+    OIIO_CHECK_EQUAL(cr.nfail, 0);
+    ImageBuf single;
+    OIIO_CHECK_ASSERT(ImageBufAlgo::over(single, { &L0 }));
+    cr = ImageBufAlgo::compare(single, L0, 0.0f, 0.0f);
+    OIIO_CHECK_EQUAL(cr.nfail, 0);
+    ImageBuf noalpha(ImageSpec(4, 4, 3, TypeFloat));
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::over(single, { &L0, &noalpha }));
+
     // Timing
     Benchmarker bench;
     ImageSpec onekfloat(1000, 1000, 4, TypeFloat);
@@ -538,6 +893,99 @@ test_over()
     ImageBufAlgo::fill(FG, FGval, ROI(250, 750, 100, 900));
     R.reset(onekfloat);
     bench("  IBA::over ", [&]() { ImageBufAlgo::over(R, FG, BG); });
+    bench("  IBA::over stack ", [&]() {
+        ImageBufAlgo::over(R, { &FG, &BG, &BG });
+    });
+}
+
+
+
+// Tests that 8 and 16 bit colorconvert through baked lookup tables gives
+// the same results as converting the same values as float.
+void
+test_colorconvert()
+{
+    std::cout << "test colorconvert\n";
+    for (TypeDesc t : { TypeUInt8, TypeUInt16 }) {
+        ImageSpec spec(300, 256, 3, t);
+        ImageBuf A(spec);
+        const float top[]    = { 0.0f, 0.2f, 1.0f };
+        const float bottom[] = { 1.0f, 0.7f, 0.0f };
+        ImageBufAlgo::fill(A, top, bottom, top, bottom);
+        ImageBuf Afloat = ImageBufAlgo::copy(A, TypeFloat);
+        ImageBuf R(ImageSpec(300, 256, 3, TypeFloat));
+        ImageBuf Rfloat(R.spec());
+        OIIO_CHECK_ASSERT(ImageBufAlgo::colorconvert(R, A, "sRGB", "linear"));
+        OIIO_CHECK_ASSERT(
+            ImageBufAlgo::colorconvert(Rfloat, Afloat, "sRGB", "linear"));
+        auto comp = ImageBufAlgo::compare(R, Rfloat, 0.0f, 0.0f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+    }
+
+    // Many threads asking for the same processors all get the one cached
+    // processor for each transform.
+    ColorConfig config;
+    auto fwd = config.createColorProcessor("sRGB", "linear");
+    auto inv = config.createColorProcessor("linear", "sRGB");
+    OIIO_CHECK_ASSERT(fwd && inv && fwd != inv);
+    std::atomic<int> mismatches(0);
+    parallel_for(0, 1000, [&](int64_t i) {
+        auto p = (i & 1) ? config.createColorProcessor("linear", "sRGB")
+                         : config.createColorProcessor("sRGB", "linear");
+        if (p != ((i & 1) ? inv : fwd))
+            ++mismatches;
+    });
+    OIIO_CHECK_EQUAL(mismatches, 0);
+}
+
+
+
+// Tests that colormatrixtransform matches the matrix done one pixel at a
+// time, and that the fused colormatrixtransfer matches doing its steps one
+// after another, for widths that aren't a multiple of the SIMD width.
+void
+test_colormatrix()
+{
+    std::cout << "test colormatrixtransform, colormatrixtransfer\n";
+    Imath::M44f M(0.6f, 0.1f, 0.1f, 0.0f, 0.3f, 0.8f, 0.1f, 0.0f, 0.1f, 0.1f,
+                  0.7f, 0.0f, 0.01f, 0.02f, 0.03f, 1.0f);
+    for (int nc : { 3, 4 }) {
+        ImageBuf A(ImageSpec(37, 5, nc, TypeFloat));
+        const float tl[] = { 0.0f, 0.2f, 1.0f, 1.0f };
+        const float tr[] = { 1.0f, 0.7f, 0.0f, 0.5f };
+        const float bl[] = { 0.5f, 0.0f, 0.25f, 0.25f };
+        const float br[] = { 0.1f, 1.0f, 0.9f, 1.0f };
+        ImageBufAlgo::fill(A, tl, tr, bl, br);
+
+        ImageBuf R = ImageBufAlgo::colormatrixtransform(A, M, false);
+        int nfail  = 0;
+        for (ImageBuf::ConstIterator<float> a(A), r(R); !a.done(); ++a, ++r) {
+            Imath::V4f c(a[0], a[1], a[2], nc == 4 ? a[3] : 0.0f);
+            Imath::V4f x = c * M;
+            for (int i = 0; i < nc; ++i)
+                nfail += std::abs(r[i] - x[i]) > 1.0e-6f;
+        }
+        OIIO_CHECK_EQUAL(nfail, 0);
+
+        ImageBuf T = ImageBufAlgo::colorconvert(A, "sRGB", "linear", false);
+        T          = ImageBufAlgo::colormatrixtransform(T, M, false);
+        T          = ImageBufAlgo::colorconvert(T, "linear", "Gamma2.2", false);
+        ImageBuf F = ImageBufAlgo::colormatrixtransfer(A, M, "sRGB",
+                                                       "Gamma2.2", false);
+        auto comp  = ImageBufAlgo::compare(F, T, 1.0e-3f, 1.0e-3f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+
+        // Linear on both sides is just the matrix
+        F    = ImageBufAlgo::colormatrixtransfer(A, M, "linear", "", false);
+        comp = ImageBufAlgo::compare(F, R, 0.0f, 0.0f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+    }
+
+    ImageBuf A(ImageSpec(8, 8, 4, TypeFloat));
+    ImageBuf F = ImageBufAlgo::colormatrixtransfer(A, Imath::M44f(), "sRGB",
+                                                   "bogus");
+    OIIO_CHECK_ASSERT(F.has_error());
+    F.geterror();
 }
 
 
@@ -584,6 +1032,45 @@ test_compare()
     OIIO_CHECK_EQUAL(comp.maxx, 9);
     OIIO_CHECK_EQUAL(comp.maxy, 0);
     OIIO_CHECK_EQUAL_THRESH(comp.meanerror, 0.0045f, 1.0e-8f);
+
+    // The fast pass/fail comparison counts failures the same way
+    OIIO_CHECK_ASSERT(ImageBufAlgo::compare_fastfail(A, B, failthresh, 5));
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::compare_fastfail(A, B, failthresh, 4));
+    OIIO_CHECK_ASSERT(
+        !ImageBufAlgo::compare_fastfail(A, B, failthresh, 5, 0.08f));
+    OIIO_CHECK_ASSERT(ImageBufAlgo::compare_fastfail(B, B, 0.0f));
+}
+
+
+
+// Tests ImageBufAlgo::compare_Yee, across several tiles
+void
+test_compare_Yee()
+{
+    std::cout << "test compare_Yee\n";
+    ImageSpec spec(150, 100, 3, TypeDesc::FLOAT);
+    ImageBuf A(spec), B(spec);
+    const float grey[3]  = { 0.5f, 0.5f, 0.5f };
+    const float white[3] = { 1.0f, 1.0f, 1.0f };
+    ImageBufAlgo::fill(A, grey);
+    ImageBufAlgo::fill(B, grey);
+    ImageBufAlgo::CompareResults comp;
+    OIIO_CHECK_EQUAL(ImageBufAlgo::compare_Yee(A, B, comp), 0);
+
+    // A bright square straddling the tiles; only pixels around it differ
+    ImageBufAlgo::fill(B, white, ROI(60, 70, 55, 75));
+    int nfail = ImageBufAlgo::compare_Yee(A, B, comp);
+    OIIO_CHECK_ASSERT(nfail >= 10 * 20);
+    OIIO_CHECK_LE(nfail, 50 * 60);
+    OIIO_CHECK_ASSERT(comp.maxx >= 40 && comp.maxx < 90);
+    OIIO_CHECK_ASSERT(comp.maxy >= 35 && comp.maxy < 95);
+    // Same answer with one thread
+    ImageBufAlgo::CompareResults comp1;
+    ImageBufAlgo::compare_Yee(A, B, comp1, 100.0f, 45.0f, {}, 1);
+    OIIO_CHECK_EQUAL(comp1.nfail, comp.nfail);
+    OIIO_CHECK_EQUAL(comp1.maxerror, comp.maxerror);
+    OIIO_CHECK_EQUAL(comp1.maxx, comp.maxx);
+    OIIO_CHECK_EQUAL(comp1.maxy, comp.maxy);
 }
 
 
@@ -683,6 +1170,61 @@ test_isMonochrome()
 
 
 
+// Tests that fixNonFinite gives the same results whether it scans packed
+// pixels for the bad ones first or looks at every pixel of a strided
+// buffer.
+void
+test_fixNonFinite()
+{
+    std::cout << "test fixNonFinite\n";
+    const int w = 61, h = 7;
+    std::vector<float> buf(w * h * 4);
+    for (size_t i = 0; i < buf.size(); ++i)
+        buf[i] = float(i % 97) / 97.0f;
+    const float inf = std::numeric_limits<float>::infinity();
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    // Bad values at the edges, next to each other, and in the 4th channel,
+    // which isn't part of the 3 channel images.
+    const int bad[][3] = { { 0, 0, 0 },  { 60, 0, 2 }, { 30, 3, 1 },
+                           { 31, 3, 1 }, { 31, 4, 0 }, { 17, 6, 2 },
+                           { 40, 2, 3 } };
+    int nbad           = 0;
+    for (auto b : bad) {
+        buf[(b[1] * w + b[0]) * 4 + b[2]] = (nbad & 1) ? inf : nan;
+        nbad += b[2] < 3;
+    }
+
+    for (auto mode : { ImageBufAlgo::NONFINITE_NONE,
+                       ImageBufAlgo::NONFINITE_BLACK,
+                       ImageBufAlgo::NONFINITE_BOX3 }) {
+        std::vector<float> strided(buf);
+        ImageBuf S(ImageSpec(w, h, 3, TypeFloat), strided.data(),
+                   4 * sizeof(float));
+        ImageBuf P = ImageBufAlgo::copy(S);
+        int sfixed = 0, pfixed = 0;
+        OIIO_CHECK_ASSERT(ImageBufAlgo::fixNonFinite(S, S, mode, &sfixed));
+        OIIO_CHECK_ASSERT(ImageBufAlgo::fixNonFinite(P, P, mode, &pfixed));
+        OIIO_CHECK_EQUAL(sfixed, nbad);
+        OIIO_CHECK_EQUAL(pfixed, nbad);
+        if (mode != ImageBufAlgo::NONFINITE_NONE) {
+            auto comp = ImageBufAlgo::compare(S, P, 0.0f, 0.0f);
+            OIIO_CHECK_EQUAL(comp.nfail, 0);
+        }
+
+        // Half pixels, and an ROI that skips some of the bad pixels
+        ImageBuf H = ImageBufAlgo::copy(ImageBuf(ImageSpec(w, h, 4, TypeFloat),
+                                                 buf.data()),
+                                        TypeHalf);
+        int hfixed = 0;
+        OIIO_CHECK_ASSERT(ImageBufAlgo::fixNonFinite(H, H, mode, &hfixed,
+                                                     ROI(1, w, 0, h, 0, 1, 0,
+                                                         4)));
+        OIIO_CHECK_EQUAL(hfixed, nbad);  // loses (0,0) but gains (40,2)
+    }
+}
+
+
+
 // Tests ImageBufAlgo::computePixelStats()
 void
 test_computePixelStats()
@@ -704,6 +1246,57 @@ test_computePixelStats()
         OIIO_CHECK_EQUAL(stats.infcount[c], 0);
         OIIO_CHECK_EQUAL(stats.finitecount[c], 4);
     }
+
+    // Rows of local pixels are summed in vectorized chunks; compare with
+    // straightforward sums, for widths that don't fill whole chunks, with
+    // a NaN and an Inf in the float image, and for a subset of channels.
+    ImageBuf A(ImageSpec(1203, 37, 3, TypeDesc::FLOAT));
+    ImageBufAlgo::noise(A, "uniform", 0.0f, 1.0f, false, 4);
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    const float inf = std::numeric_limits<float>::infinity();
+    float px[3];
+    A.getpixel(700, 3, px);
+    px[1] = nan;
+    A.setpixel(700, 3, px);
+    A.getpixel(5, 30, px);
+    px[2] = inf;
+    A.setpixel(5, 30, px);
+    for (TypeDesc fmt : { TypeFloat, TypeHalf, TypeUInt8 }) {
+        ImageBuf B;
+        B.copy(A, fmt);
+        ROI roi = B.roi();
+        roi.chbegin = 1;
+        stats = ImageBufAlgo::computePixelStats(B, roi);
+        OIIO_CHECK_EQUAL(stats.finitecount[0], 0);
+        for (int c = 1; c < 3; ++c) {
+            double sum = 0.0, sum2 = 0.0;
+            float lo = inf, hi = -inf;
+            imagesize_t n = 0, nnan = 0, ninf = 0;
+            for (ImageBuf::ConstIterator<float> p(B); !p.done(); ++p) {
+                float v = p[c];
+                if (std::isnan(v)) {
+                    ++nnan;
+                } else if (std::isinf(v)) {
+                    ++ninf;
+                } else {
+                    ++n;
+                    sum += v;
+                    sum2 += double(v) * v;
+                    lo = std::min(lo, v);
+                    hi = std::max(hi, v);
+                }
+            }
+            double avg = sum / n;
+            OIIO_CHECK_EQUAL(stats.finitecount[c], n);
+            OIIO_CHECK_EQUAL(stats.nancount[c], nnan);
+            OIIO_CHECK_EQUAL(stats.infcount[c], ninf);
+            OIIO_CHECK_EQUAL(stats.min[c], lo);
+            OIIO_CHECK_EQUAL(stats.max[c], hi);
+            OIIO_CHECK_EQUAL_THRESH(stats.avg[c], avg, 1e-6);
+            OIIO_CHECK_EQUAL_THRESH(stats.stddev[c],
+                                    std::sqrt(sum2 / n - avg * avg), 1e-5);
+        }
+    }
 }
 
 
@@ -753,6 +1346,25 @@ histogram_computation_test()
     for (int i = 0; i < HISTOGRAM_BINS; i++)
         if (i != SPIKE1 && i != SPIKE2 && i != SPIKE3)
             OIIO_CHECK_EQUAL(hist[i], 0);
+
+    // All channels at once must match one channel at a time, both for
+    // 8 bit (looked up bins) and float (computed bins) pixels.
+    ImageBuf B(ImageSpec(67, 31, 3, TypeDesc::FLOAT));
+    ImageBufAlgo::noise(B, "uniform", -0.1f, 1.1f, false, 5);
+    for (TypeDesc fmt : { TypeFloat, TypeUInt8 }) {
+        ImageBuf C;
+        C.copy(B, fmt);
+        ROI roi   = C.roi();
+        roi.chend = 2;
+        auto all  = ImageBufAlgo::histogram_channels(C, 100, 0.0f, 1.0f, false,
+                                                     roi);
+        OIIO_CHECK_EQUAL(all.size(), 200);
+        for (int c = 0; c < 2; ++c) {
+            auto one = ImageBufAlgo::histogram(C, c, 100);
+            OIIO_CHECK_ASSERT(std::equal(one.begin(), one.end(),
+                                         all.begin() + c * 100));
+        }
+    }
 }
 
 
@@ -787,6 +1399,177 @@ test_maketx_from_imagebuf()
 
 
 
+// The source analyses of make_texture, done together in one pass, must
+// agree with the separate functions.
+void
+test_maketx_analysis()
+{
+    std::cout << "test make_texture source analysis\n";
+    const char* txname = "oiio-analysis.tx";
+    ImageSpec configspec;
+    configspec.attribute("maketx:constant_color_detect", 1);
+    configspec.attribute("maketx:monochrome_detect", 1);
+    configspec.attribute("maketx:checknan", 1);
+    auto make = [&](const ImageBuf& A) {
+        remove(txname);
+        OIIO_CHECK_ASSERT(ImageBufAlgo::make_texture(
+            ImageBufAlgo::MakeTxTexture, A, txname, configspec));
+        ImageBuf B(txname);
+        B.init_spec(txname, 0, 0);
+        return B.spec();
+    };
+
+    // Several hash blocks
+    ImageBuf A = ImageBufAlgo::noise("uniform", 0.0f, 1.0f, false, 1,
+                                     ROI(0, 40, 0, 600, 0, 1, 0, 3));
+    ImageSpec spec = make(A);
+    OIIO_CHECK_EQUAL(spec.nchannels, 3);
+    OIIO_CHECK_EQUAL(spec.get_string_attribute("oiio:SHA-1"),
+                     ImageBufAlgo::computePixelHashSHA1(A, "box ", ROI::All(),
+                                                        256));
+
+    // Monochrome, though not constant
+    ImageBuf G = ImageBufAlgo::noise("uniform", 0.0f, 1.0f, true, 1,
+                                     ROI(0, 40, 0, 600, 0, 1, 0, 3));
+    spec = make(G);
+    OIIO_CHECK_EQUAL(spec.nchannels, 1);
+    OIIO_CHECK_EQUAL(spec.height, 600);
+
+    // Constant
+    spec = make(ImageBufAlgo::fill({ 0.25f, 0.5f, 0.75f },
+                                   ROI(0, 300, 0, 300, 0, 1, 0, 3)));
+    OIIO_CHECK_EQUAL(spec.width, 64);
+    OIIO_CHECK_EQUAL(spec.get_string_attribute("oiio:ConstantColor"),
+                     "0.25,0.5,0.75");
+
+    // Nonfinite pixels fail the checknan
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+    ImageBufAlgo::fill(A, { nan, nan, nan }, ROI(3, 4, 500, 501));
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::make_texture(ImageBufAlgo::MakeTxTexture,
+                                                  A, txname, configspec));
+    OIIO::geterror();
+    remove(txname);
+}
+
+
+
+// Streaming make_texture must give the same MIP levels as the normal path
+void
+test_maketx_stream()
+{
+    std::cout << "test make_texture streaming\n";
+    for (int res : { 64, 67 }) {
+        // Odd sizes take the interpolating filter, even ones the 2-pass
+        // box, and tiles of 16 make for several bands per level.
+        ImageSpec spec(res, res * 3 / 4, 4, TypeDesc::FLOAT);
+        ImageBuf A(spec);
+        float tl[] = { 0.0f, 0.0f, 1.0f, 1.0f };
+        float tr[] = { 1.0f, 0.5f, 0.0f, 1.0f };
+        float bl[] = { 0.2f, 1.0f, 0.2f, 0.0f };
+        float br[] = { 2.0f, 0.0f, 0.5f, 0.5f };
+        ImageBufAlgo::fill(A, tl, tr, bl, br);
+        ImageBuf checks = ImageBufAlgo::checker(3, 5, 1, 0.0f, 0.3f, 0, 0, 0,
+                                                spec.roi());
+        ImageBufAlgo::add(A, A, checks);
+
+        const char* names[] = { "oiio-stream0.tx", "oiio-stream1.tx" };
+        for (int stream = 0; stream < 2; ++stream) {
+            ImageSpec configspec;
+            configspec.tile_width  = 16;
+            configspec.tile_height = 16;
+            configspec.attribute("maketx:stream", stream);
+            OIIO_CHECK_ASSERT(ImageBufAlgo::make_texture(
+                ImageBufAlgo::MakeTxTexture, A, names[stream], configspec));
+        }
+        ImageBuf B(names[0]), S(names[1]);
+        OIIO_CHECK_EQUAL(B.nmiplevels(), S.nmiplevels());
+        for (int m = 0; m < B.nmiplevels(); ++m) {
+            B.reset(names[0], 0, m);
+            S.reset(names[1], 0, m);
+            auto comparison = ImageBufAlgo::compare(B, S, 0.0f, 0.0f);
+            OIIO_CHECK_EQUAL(comparison.nfail, 0);
+            OIIO_CHECK_EQUAL(comparison.maxerror, 0.0);
+        }
+        remove(names[0]);
+        remove(names[1]);
+    }
+}
+
+
+
+// Incremental make_texture skips only when source and settings match
+void
+test_maketx_incremental()
+{
+    std::cout << "test make_texture incremental\n";
+    const char* srcname = "oiio-incr-src.tif";
+    const char* txname  = "oiio-incr.tx";
+    remove(txname);
+    ImageBuf A = ImageBufAlgo::checker(4, 4, 1, 0.25f, 0.75f, 0, 0, 0,
+                                       ROI(0, 32, 0, 32, 0, 1, 0, 3));
+    A.write(srcname);
+    ImageSpec configspec;
+    configspec.attribute("maketx:incremental", 1);
+    auto make = [&]() {
+        std::ostringstream out;
+        OIIO_CHECK_ASSERT(ImageBufAlgo::make_texture(
+            ImageBufAlgo::MakeTxTexture, srcname, txname, configspec, &out));
+        return out.str().find("no update required") == std::string::npos;
+    };
+    OIIO_CHECK_ASSERT(make());   // no output yet
+    OIIO_CHECK_ASSERT(!make());  // unchanged
+    A.write(srcname);
+    OIIO_CHECK_ASSERT(!make());  // same contents, new time stamp
+
+    // Changed pixels or settings make it again
+    ImageBufAlgo::add(A, A, 0.125f);
+    A.write(srcname);
+    OIIO_CHECK_ASSERT(make());
+    configspec.attribute("maketx:filtername", "gaussian");
+    OIIO_CHECK_ASSERT(make());
+    OIIO_CHECK_ASSERT(!make());
+    remove(srcname);
+    remove(txname);
+}
+
+
+
+// Batch make_texture runs every job and reports on each
+void
+test_maketx_batch()
+{
+    std::cout << "test make_texture batch\n";
+    std::vector<ImageBufAlgo::MakeTextureJob> jobs(5);
+    for (int i = 0; i < 5; ++i) {
+        auto& job          = jobs[i];
+        job.filename       = Strutil::sprintf("oiio-batch%d.tif", i);
+        job.outputfilename = Strutil::sprintf("oiio-batch%d.tx", i);
+        job.config.attribute("maketx:filtername", i % 2 ? "box" : "gaussian");
+        if (i != 3)  // leave one missing
+            ImageBufAlgo::fill({ 0.25f * i }, ROI(0, 40 + i, 0, 30, 0, 1, 0, 1))
+                .write(job.filename);
+    }
+    std::ostringstream out;
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::make_texture(jobs, &out, 3));
+    for (int i = 0; i < 5; ++i) {
+        OIIO_CHECK_EQUAL(jobs[i].ok, i != 3);
+        OIIO_CHECK_EQUAL(jobs[i].errors.empty(), i != 3);
+        if (jobs[i].ok) {
+            ImageBuf T(jobs[i].outputfilename);
+            OIIO_CHECK_EQUAL(T.spec().width, 40 + i);
+            OIIO_CHECK_EQUAL(T.getchannel(1, 1, 0, 0), 0.25f * i);
+        }
+    }
+    OIIO_CHECK_ASSERT(out.str().find("oiio-batch3.tif") != std::string::npos);
+    for (auto& job : jobs) {
+        ImageCache::create()->invalidate(ustring(job.outputfilename));
+        remove(job.filename.c_str());
+        remove(job.outputfilename.c_str());
+    }
+}
+
+
+
 // Test various IBAprep features
 void
 test_IBAprep()
@@ -956,6 +1739,108 @@ test_opencv()
 
 
 
+// Holes filled by push-pull take the color around them, and opaque pixels
+// are left alone.
+void
+test_fillholes_pushpull()
+{
+    std::cout << "test fillholes_pushpull\n";
+    const float color[4] = { 0.2f, 0.4f, 0.6f, 1.0f };
+    ImageBuf A(ImageSpec(37, 21, 4, TypeDesc::FLOAT));
+    ImageBufAlgo::fill(A, color, ROI(0, 10, 0, 21));
+    ImageBuf B = ImageBufAlgo::fillholes_pushpull(A);
+    OIIO_CHECK_ASSERT(!B.has_error());
+    auto comp = ImageBufAlgo::compare(ImageBufAlgo::cut(B, ROI(0, 10, 0, 21)),
+                                      ImageBufAlgo::cut(A, ROI(0, 10, 0, 21)),
+                                      0.0f, 0.0f);
+    OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+    for (ImageBuf::ConstIterator<float> p(B); !p.done(); ++p)
+        for (int c = 0; c < 4; ++c)
+            OIIO_CHECK_EQUAL_THRESH(p[c], color[c], 1.0e-5f);
+
+    // Nothing to fill
+    ImageBuf C = ImageBufAlgo::fillholes_pushpull(B);
+    comp       = ImageBufAlgo::compare(B, C, 0.0f, 0.0f);
+    OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+}
+
+
+
+// Text rendered from the glyph cache, into images with and without the
+// 4-channel fast path, should come out the same every time.
+void
+test_render_text()
+{
+    std::cout << "test render_text\n";
+    ImageBuf A(ImageSpec(128, 32, 4, TypeDesc::FLOAT));
+    ImageBuf B(ImageSpec(128, 32, 3, TypeDesc::FLOAT));
+    ImageBufAlgo::fill(A, { 0.25f, 0.5f, 0.75f, 1.0f });
+    ImageBufAlgo::fill(B, { 0.25f, 0.5f, 0.75f });
+    if (!ImageBufAlgo::render_text(A, 4, 24, "Frame 1001", 20)) {
+        (void)A.geterror();
+        return;  // No font available
+    }
+    OIIO_CHECK_ASSERT(ImageBufAlgo::render_text(B, 4, 24, "Frame 1001", 20));
+    auto comp = ImageBufAlgo::compare(ImageBufAlgo::channels(A, 3, {}), B,
+                                      1.0e-6f, 1.0e-6f);
+    OIIO_CHECK_LE(comp.maxerror, 1.0e-6f);
+    ImageBuf C(A.spec());
+    ImageBufAlgo::fill(C, { 0.25f, 0.5f, 0.75f, 1.0f });
+    OIIO_CHECK_ASSERT(ImageBufAlgo::render_text(C, 4, 24, "Frame 1001", 20));
+    comp = ImageBufAlgo::compare(A, C, 0.0f, 0.0f);
+    OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+    OIIO_CHECK_ASSERT(!ImageBufAlgo::isConstantColor(A));
+    ROI size = ImageBufAlgo::text_size("Frame 1001", 20);
+    OIIO_CHECK_ASSERT(size.defined() && size.width() > 0);
+}
+
+
+
+// The hash-based noise must depend only on the pixel coordinates, channel,
+// and seed: not on the number of threads, the ROI it's split into, or the
+// SIMD level of the kernels.
+void
+test_noise()
+{
+    std::cout << "test noise\n";
+    ROI roi(-3, 250, 0, 37, 0, 2, 0, 3);
+    for (string_view type : { "uniform", "gaussian", "salt" }) {
+        for (bool mono : { false, true }) {
+            float B     = type == "salt" ? 0.1f : 0.5f;
+            ImageBuf A  = ImageBufAlgo::noise(type, 0.0f, B, mono, 7, roi, 1);
+            ImageBuf MT = ImageBufAlgo::noise(type, 0.0f, B, mono, 7, roi, 0);
+            auto comp   = ImageBufAlgo::compare(A, MT, 0.0f, 0.0f);
+            OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+
+            // Pieced together from uneven regions
+            ImageBuf P(A.spec());
+            ImageBufAlgo::zero(P);
+            ROI left(roi), right(roi);
+            left.xend = right.xbegin = 13;
+            OIIO_CHECK_ASSERT(
+                ImageBufAlgo::noise(P, type, 0.0f, B, mono, 7, left, 1));
+            OIIO_CHECK_ASSERT(
+                ImageBufAlgo::noise(P, type, 0.0f, B, mono, 7, right, 3));
+            comp = ImageBufAlgo::compare(A, P, 0.0f, 0.0f);
+            OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+
+            for (const char* isa : { "baseline", "avx2", "avx512" }) {
+                if (!OIIO::attribute("simd_dispatch", isa))
+                    continue;  // Not compiled, or this CPU can't run it
+                ImageBuf S = ImageBufAlgo::noise(type, 0.0f, B, mono, 7, roi);
+                comp       = ImageBufAlgo::compare(A, S, 0.0f, 0.0f);
+                OIIO_CHECK_EQUAL(comp.maxerror, 0.0f);
+            }
+            OIIO::attribute("simd_dispatch", "");
+        }
+    }
+    // A different seed gives a different pattern
+    ImageBuf A = ImageBufAlgo::noise("uniform", 0.0f, 1.0f, false, 1, roi);
+    ImageBuf C = ImageBufAlgo::noise("uniform", 0.0f, 1.0f, false, 2, roi);
+    OIIO_CHECK_GT(ImageBufAlgo::compare(A, C, 0.0f, 0.0f).maxerror, 0.0f);
+}
+
+
 int
 main(int argc, char** argv)
 {
@@ -975,18 +1860,37 @@ main(int argc, char** argv)
     test_crop();
     test_paste();
     test_channel_append();
+    test_channel_views();
     test_add();
+    test_for_each_row();
+    test_small_image_inline();
+    test_expr();
+    test_resize();
+    test_warp();
+    test_convolve();
+    test_median_morph();
     test_sub();
     test_mul();
     test_mad();
     test_over();
+    test_colorconvert();
+    test_colormatrix();
     test_compare();
+    test_compare_Yee();
     test_isConstantColor();
     test_isConstantChannel();
     test_isMonochrome();
     test_computePixelStats();
+    test_fixNonFinite();
     histogram_computation_test();
     test_maketx_from_imagebuf();
+    test_maketx_analysis();
+    test_maketx_stream();
+    test_maketx_incremental();
+    test_maketx_batch();
+    test_render_text();
+    test_fillholes_pushpull();
+    test_noise();
     test_IBAprep();
     test_opencv();
 
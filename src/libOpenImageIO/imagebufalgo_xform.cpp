@@ -150,17 +150,17 @@ transform(const Imath::M33f& M, ROI roi)
 template<typename SRCTYPE>
 inline void
 filtered_sample(const ImageBuf& src, float s, float t, float dsdx, float dtdx,
-                float dsdy, float dtdy, const Filter2D* filter,
+                float dsdy, float dtdy, const FilterLUT& filter,
                 ImageBuf::WrapMode wrap, bool edgeclamp, float* result)
 {
-    OIIO_DASSERT(filter);
+    OIIO_DASSERT(filter.valid());
     // Just use isotropic filtering
     float ds          = std::max(1.0f, std::max(fabsf(dsdx), fabsf(dsdy)));
     float dt          = std::max(1.0f, std::max(fabsf(dtdx), fabsf(dtdy)));
     float ds_inv      = 1.0f / ds;
     float dt_inv      = 1.0f / dt;
-    float filterrad_s = 0.5f * ds * filter->width();
-    float filterrad_t = 0.5f * dt * filter->width();
+    float filterrad_s = 0.5f * ds * filter.width();
+    float filterrad_t = 0.5f * dt * filter.width();
     int smin          = (int)floorf(s - filterrad_s);
     int smax          = (int)ceilf(s + filterrad_s);
     int tmin          = (int)floorf(t - filterrad_t);
@@ -186,8 +186,8 @@ filtered_sample(const ImageBuf& src, float s, float t, float dsdx, float dtdx,
     memset(sum, 0, nc * sizeof(float));
     float total_w = 0.0f;
     for (; !samp.done(); ++samp) {
-        float w = (*filter)(ds_inv * (samp.x() + 0.5f - s),
-                            dt_inv * (samp.y() + 0.5f - t));
+        float w = filter(ds_inv * (samp.x() + 0.5f - s),
+                         dt_inv * (samp.y() + 0.5f - t));
         for (int c = 0; c < nc; ++c)
             sum[c] += w * samp[c];
         total_w += w;
@@ -200,6 +200,72 @@ filtered_sample(const ImageBuf& src, float s, float t, float dsdx, float dtdx,
             result[c] = 0.0f;
 }
 
+
+
+// filtered_sample() for a separable filter and a footprint of ds x dt
+// source pixels (as it would compute from the derivatives) when `src` has
+// local pixels. The filter is evaluated once per column and once per row
+// of the footprint, rather than once per tap, and the pixels are read
+// straight from memory. Return false, having done nothing, if the
+// footprint isn't entirely within the data window; the caller should then
+// use filtered_sample(), which knows about wrap modes.
+template<typename SRCTYPE>
+inline bool
+separable_sample(const ImageBuf& src, float s, float t, float ds, float dt,
+                 const FilterLUT& filter, bool edgeclamp, float* xw, float* yw,
+                 float* result)
+{
+    float filterrad_s = 0.5f * ds * filter.width();
+    float filterrad_t = 0.5f * dt * filter.width();
+    int smin          = (int)floorf(s - filterrad_s);
+    int smax          = (int)ceilf(s + filterrad_s);
+    int tmin          = (int)floorf(t - filterrad_t);
+    int tmax          = (int)ceilf(t + filterrad_t);
+    if (edgeclamp) {
+        smin = clamp(smin, src.xbegin(), src.xend());
+        smax = clamp(smax, src.xbegin(), src.xend());
+        tmin = clamp(tmin, src.ybegin(), src.yend());
+        tmax = clamp(tmax, src.ybegin(), src.yend());
+    }
+    if (smin < src.xbegin() || smax > src.xend() || tmin < src.ybegin()
+        || tmax > src.yend())
+        return false;
+
+    const float ds_inv = 1.0f / ds, dt_inv = 1.0f / dt;
+    const int sw = smax - smin, th = tmax - tmin;
+    float total_x = filter.xfilt(ds_inv * (smin + 0.5f - s), ds_inv, sw, xw);
+    float total_y = filter.yfilt(dt_inv * (tmin + 0.5f - t), dt_inv, th, yw);
+
+    const int nc            = src.nchannels();
+    const stride_t xstride  = src.pixel_stride();
+    const stride_t ystride  = src.scanline_stride();
+    const char* row         = (const char*)src.pixeladdr(smin, tmin, 0);
+    for (int c = 0; c < nc; ++c)
+        result[c] = 0.0f;
+    for (int j = 0; j < th; ++j, row += ystride) {
+        if (yw[j] == 0.0f)
+            continue;
+        const char* p = row;
+        for (int i = 0; i < sw; ++i, p += xstride) {
+            float w = xw[i] * yw[j];
+            for (int c = 0; c < nc; ++c)
+                result[c] += w
+                             * convert_type<SRCTYPE, float>(
+                                 ((const SRCTYPE*)p)[c]);
+        }
+    }
+    float total_w = total_x * total_y;
+    if (total_w > 0.0f) {
+        float inv = 1.0f / total_w;
+        for (int c = 0; c < nc; ++c)
+            result[c] *= inv;
+    } else {
+        for (int c = 0; c < nc; ++c)
+            result[c] = 0.0f;
+    }
+    return true;
+}
+
 }  // namespace
 
 
@@ -210,18 +276,56 @@ warp_(ImageBuf& dst, const ImageBuf& src, const Imath::M33f& M,
       const Filter2D* filter, ImageBuf::WrapMode wrap, bool edgeclamp, ROI roi,
       int nthreads)
 {
-    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
+    // Neighbouring output pixels read neighbouring source pixels in any
+    // direction, so work in cache-sized tiles rather than strips.
+    parallel_options opt(nthreads, Split_Tile);
+    opt.itembytes = (src.nchannels() + dst.nchannels()) * sizeof(float);
+    // Tabulate the filter once, so the taps don't each make virtual calls.
+    FilterLUT lut = filter->make_lut();
+    ImageBufAlgo::parallel_image(roi, opt, [&](ROI roi) {
         int nc     = dst.nchannels();
         float* pel = OIIO_ALLOCA(float, nc);
         memset(pel, 0, nc * sizeof(float));
         Imath::M33f Minv = M.inverse();
         ImageBuf::Iterator<DSTTYPE> out(dst, roi);
+
+        // An affine transform (translation, rotation, scaling, shearing)
+        // has the same derivatives everywhere, and so the same filter
+        // footprint for every pixel. With a separable filter and local
+        // source pixels, skip the Dual2 math and the per-tap filter calls.
+        if (Minv[0][2] == 0.0f && Minv[1][2] == 0.0f && Minv[2][2] != 0.0f
+            && lut.separable() && src.localpixels()
+            && src.nchannels() == nc) {
+            const float winv = 1.0f / Minv[2][2];
+            const float dsdx = Minv[0][0] * winv, dtdx = Minv[0][1] * winv;
+            const float dsdy = Minv[1][0] * winv, dtdy = Minv[1][1] * winv;
+            const float ds
+                = std::max(1.0f, std::max(fabsf(dsdx), fabsf(dsdy)));
+            const float dt
+                = std::max(1.0f, std::max(fabsf(dtdx), fabsf(dtdy)));
+            const int maxtaps = int(ceilf(std::max(ds, dt) * lut.width())) + 2;
+            float* xw = OIIO_ALLOCA(float, maxtaps);
+            float* yw = OIIO_ALLOCA(float, maxtaps);
+            for (; !out.done(); ++out) {
+                float x = out.x() + 0.5f, y = out.y() + 0.5f;
+                float s = (x * Minv[0][0] + y * Minv[1][0] + Minv[2][0]) * winv;
+                float t = (x * Minv[0][1] + y * Minv[1][1] + Minv[2][1]) * winv;
+                if (!separable_sample<SRCTYPE>(src, s, t, ds, dt, lut,
+                                               edgeclamp, xw, yw, pel))
+                    filtered_sample<SRCTYPE>(src, s, t, dsdx, dtdx, dsdy,
+                                             dtdy, lut, wrap, edgeclamp, pel);
+                for (int c = roi.chbegin; c < roi.chend; ++c)
+                    out[c] = pel[c];
+            }
+            return;
+        }
+
         for (; !out.done(); ++out) {
             Dual2 x(out.x() + 0.5f, 1.0f, 0.0f);
             Dual2 y(out.y() + 0.5f, 0.0f, 1.0f);
             robust_multVecMatrix(Minv, x, y, x, y);
             filtered_sample<SRCTYPE>(src, x.val(), y.val(), x.dx(), y.dx(),
-                                     x.dy(), y.dy(), filter, wrap, edgeclamp,
+                                     x.dy(), y.dy(), lut, wrap, edgeclamp,
                                      pel);
             for (int c = roi.chbegin; c < roi.chend; ++c)
                 out[c] = pel[c];
@@ -360,6 +464,117 @@ ImageBufAlgo::rotate(ImageBuf& dst, const ImageBuf& src, float angle,
 
 
 
+// Two pass resize of the rows [roi.ybegin,roi.yend) for separable
+// filters. Each source row under the filter is weighted horizontally just
+// once, with the precomputed tap weights `xfiltval_all` (`xtaps` for each
+// output column, starting at source column `xstart[x-roi.xbegin]`), into a
+// float buffer, and each output row is then a weighted sum of those rows.
+// That costs xtaps+ytaps multiply-adds per output pixel rather than
+// xtaps*ytaps, with inner loops over contiguous floats that the compiler
+// can vectorize. Output rows are done in blocks, so that the filtered
+// rows they share are still in cache when they're used. Source pixels
+// are looked up as with WrapClamp: clamped to the full (display) window,
+// and black if outside the data window.
+static void
+resize_separable_rows(ImageBuf& dst, const ImageBuf& src, Filter2D* filter,
+                      ROI roi, const float* xfiltval_all, const int* xstart,
+                      int xtaps, float yratio, int radj)
+{
+    const ImageSpec& srcspec(src.spec());
+    const ImageSpec& dstspec(dst.spec());
+    const int nchannels = dstspec.nchannels;
+    const int width     = roi.width();
+    const int ytaps     = 2 * radj + 1;
+    const float srcfy   = srcspec.full_y, srcfh = srcspec.full_height;
+    const float dstfy   = dstspec.full_y, dstph = 1.0f / dstspec.full_height;
+    const int sx0       = srcspec.full_x, sx1 = sx0 + srcspec.full_width - 1;
+    const int sy0       = srcspec.full_y, sy1 = sy0 + srcspec.full_height - 1;
+
+    // The source columns needed by any output column
+    const int lx0 = xstart[0], lx1 = xstart[width - 1] + xtaps - 1;
+    const int lw  = lx1 - lx0 + 1;
+    std::vector<float> line(size_t(lw) * nchannels);
+    std::vector<float> outrow(size_t(width) * nchannels);
+    std::vector<float> yfiltval(ytaps);
+    std::vector<float> hrows;
+
+    auto src_row = [&](int y, float* frac) {
+        float src_yf = srcfy + (y - dstfy + 0.5f) * dstph * srcfh;
+        int src_y;
+        *frac = floorfrac(src_yf, &src_y);
+        return src_y;
+    };
+
+    const int block = 64;
+    for (int yb = roi.ybegin; yb < roi.yend; yb += block) {
+        const int ye = std::min(yb + block, roi.yend);
+        float frac;
+        const int hy0 = OIIO::clamp(src_row(yb, &frac) - radj, sy0, sy1);
+        const int hy1 = OIIO::clamp(src_row(ye - 1, &frac) + radj, sy0, sy1);
+        hrows.resize(size_t(hy1 - hy0 + 1) * width * nchannels);
+
+        // Horizontal pass over the source rows this block needs
+        for (int sy = hy0; sy <= hy1; ++sy) {
+            // Fetch the part inside the full window, and replicate its
+            // edge pixels for the rest.
+            int cx0 = OIIO::clamp(lx0, sx0, sx1);
+            int cx1 = OIIO::clamp(lx1, sx0, sx1);
+            float* inside = line.data() + size_t(cx0 - lx0) * nchannels;
+            src.get_pixels(ROI(cx0, cx1 + 1, sy, sy + 1, srcspec.z,
+                               srcspec.z + 1, 0, nchannels),
+                           TypeFloat, inside);
+            for (int x = lx0; x < cx0; ++x)
+                std::copy(inside, inside + nchannels,
+                          line.data() + size_t(x - lx0) * nchannels);
+            const float* last = line.data() + size_t(cx1 - lx0) * nchannels;
+            for (int x = cx1 + 1; x <= lx1; ++x)
+                std::copy(last, last + nchannels,
+                          line.data() + size_t(x - lx0) * nchannels);
+
+            float* h = hrows.data() + size_t(sy - hy0) * width * nchannels;
+            for (int x = 0; x < width; ++x, h += nchannels) {
+                const float* w = xfiltval_all + size_t(x) * xtaps;
+                const float* p = line.data()
+                                 + size_t(xstart[x] - lx0) * nchannels;
+                for (int c = 0; c < nchannels; ++c)
+                    h[c] = 0.0f;
+                for (int i = 0; i < xtaps; ++i, p += nchannels)
+                    for (int c = 0; c < nchannels; ++c)
+                        h[c] += w[i] * p[c];
+            }
+        }
+
+        // Vertical pass
+        for (int y = yb; y < ye; ++y) {
+            const int src_y     = src_row(y, &frac);
+            float totalweight_y = 0.0f;
+            for (int j = 0; j < ytaps; ++j) {
+                float w = filter->yfilt(yratio * (j - radj - (frac - 0.5f)));
+                yfiltval[j] = w;
+                totalweight_y += w;
+            }
+            std::fill(outrow.begin(), outrow.end(), 0.0f);
+            if (totalweight_y != 0.0f) {
+                for (int j = 0; j < ytaps; ++j) {
+                    float w = yfiltval[j] / totalweight_y;
+                    if (w == 0.0f)
+                        continue;
+                    int sy = OIIO::clamp(src_y - radj + j, sy0, sy1);
+                    const float* h = hrows.data()
+                                     + size_t(sy - hy0) * width * nchannels;
+                    for (size_t i = 0, n = outrow.size(); i < n; ++i)
+                        outrow[i] += w * h[i];
+                }
+            }
+            dst.set_pixels(ROI(roi.xbegin, roi.xend, y, y + 1, roi.zbegin,
+                               roi.zend, 0, nchannels),
+                           TypeFloat, outrow.data());
+        }
+    }
+}
+
+
+
 template<typename DSTTYPE, typename SRCTYPE>
 static bool
 resize_(ImageBuf& dst, const ImageBuf& src, Filter2D* filter, ROI roi,
@@ -402,6 +617,7 @@ resize_(ImageBuf& dst, const ImageBuf& src, Filter2D* filter, ROI roi,
         bool separable  = filter->separable();
         float* yfiltval = OIIO_ALLOCA(float, ytaps);
         std::unique_ptr<float[]> xfiltval_all;
+        std::unique_ptr<int[]> xstart;
         if (separable) {
             // For separable filters, horizontal tap weights will be the same
             // for every column. So we precompute all the tap weights for every
@@ -409,12 +625,14 @@ resize_(ImageBuf& dst, const ImageBuf& src, Filter2D* filter, ROI roi,
             // inside the loop (since we never revisit a y row). This
             // substantially speeds up resize.
             xfiltval_all.reset(new float[xtaps * roi.width()]);
+            xstart.reset(new int[roi.width()]);
             for (int x = roi.xbegin; x < roi.xend; ++x) {
                 float* xfiltval = xfiltval_all.get() + (x - roi.xbegin) * xtaps;
                 float s         = (x - dstfx + 0.5f) * dstpixelwidth;
                 float src_xf    = srcfx + s * srcfw;
                 int src_x;
-                float src_xf_frac   = floorfrac(src_xf, &src_x);
+                float src_xf_frac = floorfrac(src_xf, &src_x);
+                xstart[x - roi.xbegin] = src_x - radi;
                 float totalweight_x = 0.0f;
                 for (int i = 0; i < xtaps; ++i) {
                     float w = filter->xfilt(
@@ -473,8 +691,16 @@ resize_(ImageBuf& dst, const ImageBuf& src, Filter2D* filter, ROI roi,
         // src_xf_frac and src_yf_frac are the position within that pixel
         //     of our sample.
         //
-        // Separate cases for separable and non-separable filters.
-        if (separable) {
+        // Separate cases for separable and non-separable filters. Separable
+        // ones take two passes, unless double precision is involved (the
+        // two pass version works in float) or the source has fewer
+        // channels than the result.
+        if (separable && !std::is_same<DSTTYPE, double>::value
+            && !std::is_same<SRCTYPE, double>::value
+            && src.nchannels() >= nchannels) {
+            resize_separable_rows(dst, src, filter, roi, xfiltval_all.get(),
+                                  xstart.get(), xtaps, yratio, radj);
+        } else if (separable) {
             ImageBuf::Iterator<DSTTYPE> out(dst, roi);
             ImageBuf::ConstIterator<SRCTYPE> srcpel(src, ImageBuf::WrapClamp);
             for (int y = roi.ybegin; y < roi.yend; ++y) {
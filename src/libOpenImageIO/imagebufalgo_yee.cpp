@@ -8,6 +8,9 @@
 
 #include <cmath>
 #include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
 
 #include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
@@ -15,7 +18,7 @@
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagebufalgo_util.h>
-using Imath::Color3f;
+#include <OpenImageIO/simd.h>
 
 
 
@@ -35,115 +38,130 @@ namespace {
 #define PYRAMID_MAX_LEVELS 8
 
 
-class GaussianPyramid {
+// Each output tile is computed from its own piece of each image's
+// luminance, and of the successively more blurred copies of it, with
+// enough margin that the blurriest one (each level is a 5x5 blur of the
+// one before it) is right over the whole tile.
+static constexpr int tile_size   = 64;
+static constexpr int tile_margin = 2 * (PYRAMID_MAX_LEVELS - 1);
+
+
+
+// The "Gaussian pyramid" of luminance over one tile (not really a
+// pyramid, because the levels all have the same resolution, but really
+// just a bunch of successively more blurred images). Level i covers the
+// tile expanded by the margin that the levels after it still need,
+// clipped to the image, and lookups past the image edges are clamped as
+// convolve() does, so the values are the same as blurring the whole
+// image.
+class TilePyramid {
 public:
-    GaussianPyramid(ImageBuf& image)
+    // Level 0 is `lum`, which covers `roi`; blur with the normalized 1D
+    // `kernel` (of 5 values) in each direction for the other levels.
+    void build(const float* lum, ROI roi, ROI tile, ROI image,
+               const float* kernel)
     {
-        level[0].swap(image);  // swallow the source as the top level
-        ImageBuf kernel = ImageBufAlgo::make_kernel("gaussian", 5, 5);
-        for (int i = 1; i < PYRAMID_MAX_LEVELS; ++i)
-            ImageBufAlgo::convolve(level[i], level[i - 1], kernel);
+        level[0].roi = roi;
+        level[0].pixels.assign(lum, lum + roi.npixels());
+        for (int i = 1; i < PYRAMID_MAX_LEVELS; ++i) {
+            const Level& src(level[i - 1]);
+            Level& dst(level[i]);
+            const int margin = 2 * (PYRAMID_MAX_LEVELS - 1 - i);
+            dst.roi = roi_intersection(ROI(tile.xbegin - margin,
+                                           tile.xend + margin,
+                                           tile.ybegin - margin,
+                                           tile.yend + margin),
+                                       image);
+            const int w = dst.roi.width(), sw = src.roi.width();
+            // Horizontal pass over all the rows of the previous level,
+            // then vertical into this one.
+            tmp.assign(size_t(src.roi.height()) * w, 0.0f);
+            for (int y = 0; y < src.roi.height(); ++y) {
+                const float* s = &src.pixels[size_t(y) * sw];
+                float* h       = &tmp[size_t(y) * w];
+                for (int x = 0; x < w; ++x) {
+                    int sx = dst.roi.xbegin + x - src.roi.xbegin;
+                    for (int k = 0; k < 5; ++k)
+                        h[x] += kernel[k]
+                                * s[OIIO::clamp(sx + k - 2, 0, sw - 1)];
+                }
+            }
+            dst.pixels.assign(dst.roi.npixels(), 0.0f);
+            for (int y = 0; y < dst.roi.height(); ++y) {
+                int sy  = dst.roi.ybegin + y - src.roi.ybegin;
+                float* d = &dst.pixels[size_t(y) * w];
+                for (int k = 0; k < 5; ++k) {
+                    int ty = OIIO::clamp(sy + k - 2, 0, src.roi.height() - 1);
+                    const float* h = &tmp[size_t(ty) * w];
+                    for (int x = 0; x < w; ++x)
+                        d[x] += kernel[k] * h[x];
+                }
+            }
+        }
     }
 
-    ~GaussianPyramid() {}
-
     float value(int x, int y, int lev) const
     {
         if (lev >= PYRAMID_MAX_LEVELS)
             return 0.0f;
         else
-            return level[lev].getchannel(x, y, 0, 1);
-    }
-
-    ImageBuf& operator[](int lev)
-    {
-        OIIO_DASSERT(lev < PYRAMID_MAX_LEVELS);
-        return level[lev];
+            return (*this)(x, y, lev);
     }
 
     float operator()(int x, int y, int lev) const
     {
         OIIO_DASSERT(lev < PYRAMID_MAX_LEVELS);
-        return level[lev].getchannel(x, y, 0, 1);
+        const Level& l(level[lev]);
+        return l.pixels[size_t(y - l.roi.ybegin) * l.roi.width() + x
+                        - l.roi.xbegin];
     }
 
 private:
-    ImageBuf level[PYRAMID_MAX_LEVELS];
+    struct Level {
+        ROI roi;
+        std::vector<float> pixels;
+    };
+    Level level[PYRAMID_MAX_LEVELS];
+    std::vector<float> tmp;
 };
 
 
 
 // Adobe RGB (1998) with reference white D65 -> XYZ
 // matrix is from http://www.brucelindbloom.com/
-inline Color3f
-AdobeRGBToXYZ_color(const Color3f& rgb)
-{
-    return Color3f(rgb[0] * 0.576700f + rgb[1] * 0.185556f + rgb[2] * 0.188212f,
-                   rgb[0] * 0.297361f + rgb[1] * 0.627355f
-                       + rgb[2] * 0.0752847f,
-                   rgb[0] * 0.0270328f + rgb[1] * 0.0706879f
-                       + rgb[2] * 0.991248f);
-}
-
-
-
-static bool
-AdobeRGBToXYZ(ImageBuf& A, ROI roi, int nthreads)
+inline simd::vfloat4
+AdobeRGBToXYZ_color(const float* rgb)
 {
-    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        for (ImageBuf::Iterator<float> a(A, roi); !a.done(); ++a) {
-            Color3f rgb(a[0], a[1], a[2]);
-            Color3f XYZ = AdobeRGBToXYZ_color(rgb);
-            a[0]        = XYZ[0];
-            a[1]        = XYZ[1];
-            a[2]        = XYZ[2];
-        }
-    });
-    return true;
+    static const simd::vfloat4 r(0.576700f, 0.297361f, 0.0270328f, 0.0f);
+    static const simd::vfloat4 g(0.185556f, 0.627355f, 0.0706879f, 0.0f);
+    static const simd::vfloat4 b(0.188212f, 0.0752847f, 0.991248f, 0.0f);
+    return rgb[0] * r + rgb[1] * g + rgb[2] * b;
 }
 
 
 
 /// Convert a color in XYZ space to LAB space.
 ///
-static Color3f
-XYZToLAB_color(const Color3f xyz)
+static simd::vfloat4
+XYZToLAB_color(const simd::vfloat4& xyz)
 {
+    using namespace simd;
     // Reference white point
-    static const Color3f white(0.576700f + 0.185556f + 0.188212f,
+    static const vfloat4 white(0.576700f + 0.185556f + 0.188212f,
                                0.297361f + 0.627355f + 0.0752847f,
-                               0.0270328f + 0.0706879f + 0.991248f);
+                               0.0270328f + 0.0706879f + 0.991248f, 1.0f);
     const float epsilon = 216.0f / 24389.0f;
     const float kappa   = 24389.0f / 27.0f;
 
-    Color3f r = xyz / white;
-    Color3f f;
-    for (int i = 0; i < 3; i++) {
-        if (r[i] > epsilon)
-            f[i] = powf(r[i], 1.0f / 3.0f);
-        else
-            f[i] = (kappa * r[i] + 16.0f) / 116.0f;
-    }
-    return Color3f(116.0f * f[1] - 16.0f,    // L
+    vfloat4 r = xyz / white;
+    vfloat4 cuberoot(powf(r[0], 1.0f / 3.0f), powf(r[1], 1.0f / 3.0f),
+                     powf(r[2], 1.0f / 3.0f), 0.0f);
+    vfloat4 f = select(r > vfloat4(epsilon), cuberoot,
+                       (kappa * r + vfloat4(16.0f)) / vfloat4(116.0f));
+    return vfloat4(116.0f * f[1] - 16.0f,    // L
                    500.0f * (f[0] - f[1]),   // A
-                   200.0f * (f[1] - f[2]));  // B
-}
-
-
-
-static bool
-XYZToLAB(ImageBuf& A, ROI roi, int nthreads)
-{
-    ImageBufAlgo::parallel_image(roi, nthreads, [&](ROI roi) {
-        for (ImageBuf::Iterator<float> a(A, roi); !a.done(); ++a) {
-            Color3f XYZ(a[0], a[1], a[2]);
-            Color3f LAB = XYZToLAB_color(XYZ);
-            a[0]        = LAB[0];
-            a[1]        = LAB[1];
-            a[2]        = LAB[2];
-        }
-    });
-    return true;
+                   200.0f * (f[1] - f[2]),   // B
+                   0.0f);
 }
 
 
@@ -196,6 +214,49 @@ tvi(float adaptation_luminance)
 }
 
 
+
+// The per-tile inputs of the metric computed from one image: its
+// luminance pyramid, and the A and B channels of its LAB color.
+struct YeeTile {
+    TilePyramid lum;
+    std::vector<float> labA, labB;
+    std::vector<float> rgb, y;
+
+    // Fetch `region` (in the 0-origin coordinates of the `roi` of `img`
+    // being compared) of up to 3 channels, assumed to be in Adobe RGB
+    // (1998), and convert.
+    void convert(const ImageBuf& img, ROI roi, ROI region, ROI tile,
+                 ROI image, float luminance, const float* kernel)
+    {
+        const int w = region.width();
+        rgb.assign(region.npixels() * 3, 0.0f);
+        img.get_pixels(ROI(roi.xbegin + region.xbegin,
+                           roi.xbegin + region.xend,
+                           roi.ybegin + region.ybegin,
+                           roi.ybegin + region.yend, roi.zbegin,
+                           roi.zbegin + 1, roi.chbegin, roi.chbegin + 3),
+                       TypeFloat, rgb.data(), 3 * sizeof(float));
+        y.resize(region.npixels());
+        labA.resize(tile.npixels());
+        labB.resize(tile.npixels());
+        for (int j = region.ybegin; j < region.yend; ++j) {
+            for (int i = region.xbegin; i < region.xend; ++i) {
+                size_t p = size_t(j - region.ybegin) * w + i - region.xbegin;
+                simd::vfloat4 XYZ = AdobeRGBToXYZ_color(&rgb[p * 3]);
+                y[p]              = XYZ[1] * luminance;
+                if (tile.contains(i, j)) {
+                    simd::vfloat4 LAB = XYZToLAB_color(XYZ);
+                    size_t t = size_t(j - tile.ybegin) * tile.width() + i
+                               - tile.xbegin;
+                    labA[t] = LAB[1];
+                    labB[t] = LAB[2];
+                }
+            }
+        }
+        lum.build(y.data(), region, tile, image, kernel);
+    }
+};
+
 }  // namespace
 
 
@@ -213,39 +274,15 @@ ImageBufAlgo::compare_Yee(const ImageBuf& img0, const ImageBuf& img1,
     result.maxx = 0, result.maxy = 0, result.maxz = 0, result.maxc = 0;
     result.nfail = 0, result.nwarn = 0;
 
-    int nscanlines = roi.height() * roi.depth();
-
     bool luminanceOnly = false;
 
-    // assuming colorspaces are in Adobe RGB (1998), convert to LAB
-
-    // paste() to copy of up to 3 channels, converting to float, and
-    // ending up with a 0-origin image.  End up with an LAB image in
-    // aLAB, and a luminance image in aLum.
-    ImageSpec spec(roi.width(), roi.height(), 3 /*chans*/, TypeDesc::FLOAT);
-    ImageBuf aLAB(spec);
-    ImageBufAlgo::paste(aLAB, 0, 0, 0, 0, img0, roi, nthreads);
-    AdobeRGBToXYZ(aLAB, ROI::All(), nthreads);  // contains XYZ now
-    ImageBuf aLum;
-    int channelorder[] = { 1 };  // channel to copy
-    ImageBufAlgo::channels(aLum, aLAB, 1, channelorder);
-    ImageBufAlgo::mul(aLum, aLum, luminance, ROI::All(), nthreads);
-    XYZToLAB(aLAB, ROI::All(), nthreads);  // now it's LAB
-
-    // Same thing for img1/bLAB/bLum
-    ImageBuf bLAB(spec);
-    ImageBufAlgo::paste(bLAB, 0, 0, 0, 0, img1, roi, nthreads);
-    AdobeRGBToXYZ(bLAB, ROI::All(), nthreads);  // contains XYZ now
-    ImageBuf bLum;
-    ImageBufAlgo::channels(bLum, bLAB, 1, channelorder);
-    ImageBufAlgo::mul(bLum, bLum, luminance, ROI::All(), nthreads);
-    XYZToLAB(bLAB, ROI::All(), nthreads);  // now it's LAB
-
-    // Construct Gaussian pyramids (not really pyramids, because they all
-    // have the same resolution, but really just a bunch of successively
-    // more blurred images).
-    GaussianPyramid la(aLum);
-    GaussianPyramid lb(bLum);
+    // Both images are assumed to be in Adobe RGB (1998). Tile by tile, we
+    // convert them to LAB and to luminance, and construct Gaussian
+    // pyramids of the luminance, in the 0-origin coordinates of `image`.
+    const ROI image(0, roi.width(), 0, roi.height());
+    float kernel[5];
+    ImageBuf kernelbuf = ImageBufAlgo::make_kernel("gaussian", 5, 1);
+    kernelbuf.get_pixels(kernelbuf.roi(), TypeFloat, kernel);
 
     float num_one_degree_pixels = (float)(2 * tan(fov * 0.5 * M_PI / 180) * 180
                                           / M_PI);
@@ -267,70 +304,115 @@ ImageBufAlgo::compare_Yee(const ImageBuf& img0, const ImageBuf& img1,
     for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; ++i)
         F_freq[i] = csf_max / contrast_sensitivity(cpd[i], 100.0f);
 
-    for (int y = 0; y < nscanlines; ++y) {
-        for (int x = 0; x < roi.width(); ++x) {
-            float contrast[PYRAMID_MAX_LEVELS - 2];
-            float sum_contrast = 0;
-            for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++) {
-                float n1 = fabsf(la.value(x, y, i) - la.value(x, y, i + 1));
-                float n2 = fabsf(lb.value(x, y, i) - lb.value(x, y, i + 1));
-                float numerator   = std::max(n1, n2);
-                float d1          = fabsf(la.value(x, y, i + 2));
-                float d2          = fabsf(lb.value(x, y, i + 2));
-                float denominator = std::max(std::max(d1, d2), 1.0e-5f);
-                contrast[i]       = numerator / denominator;
-                sum_contrast += contrast[i];
-            }
-            if (sum_contrast < 1e-5)
-                sum_contrast = 1e-5f;
-            float F_mask[PYRAMID_MAX_LEVELS - 2];
-            float adapt = la.value(x, y, adaptation_level)
-                          + lb.value(x, y, adaptation_level);
-            adapt *= 0.5f;
-            if (adapt < 1e-5)
-                adapt = 1e-5f;
-            for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++)
-                F_mask[i] = mask(contrast[i]
-                                 * contrast_sensitivity(cpd[i], adapt));
-            float factor = 0;
-            for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++)
-                factor += contrast[i] * F_freq[i] * F_mask[i] / sum_contrast;
-            factor      = OIIO::clamp(factor, 1.0f, 10.0f);
-            float delta = fabsf(la.value(x, y, 0) - lb.value(x, y, 0));
-            bool pass   = true;
-            // pure luminance test
-            delta /= tvi(adapt);
-            if (delta > factor) {
-                pass = false;
-            } else if (!luminanceOnly) {
-                // CIE delta E test with modifications
-                float color_scale = 1.0f;
-                // ramp down the color test in scotopic regions
-                if (adapt < 10.0f) {
-                    color_scale = 1.0f - (10.0f - color_scale) / 10.0f;
-                    color_scale = color_scale * color_scale;
+    const int xtiles = (image.width() + tile_size - 1) / tile_size;
+    const int ytiles = (image.height() + tile_size - 1) / tile_size;
+    std::mutex mutex;
+    parallel_for(
+        0, int64_t(xtiles) * ytiles,
+        [&](int64_t t) {
+            ROI tile(int(t % xtiles) * tile_size, 0,
+                     int(t / xtiles) * tile_size, 0);
+            tile.xend = std::min(tile.xbegin + tile_size, image.xend);
+            tile.yend = std::min(tile.ybegin + tile_size, image.yend);
+            ROI region = roi_intersection(ROI(tile.xbegin - tile_margin,
+                                              tile.xend + tile_margin,
+                                              tile.ybegin - tile_margin,
+                                              tile.yend + tile_margin),
+                                          image);
+            std::unique_ptr<YeeTile> a(new YeeTile), b(new YeeTile);
+            a->convert(img0, roi, region, tile, image, luminance, kernel);
+            b->convert(img1, roi, region, tile, image, luminance, kernel);
+            const TilePyramid& la(a->lum);
+            const TilePyramid& lb(b->lum);
+
+            imagesize_t nfail = 0;
+            float maxerror    = 0.0f;
+            int maxx = 0, maxy = 0;
+            for (int y = tile.ybegin; y < tile.yend; ++y) {
+                for (int x = tile.xbegin; x < tile.xend; ++x) {
+                    float contrast[PYRAMID_MAX_LEVELS - 2];
+                    float sum_contrast = 0;
+                    for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++) {
+                        float n1 = fabsf(la.value(x, y, i)
+                                         - la.value(x, y, i + 1));
+                        float n2 = fabsf(lb.value(x, y, i)
+                                         - lb.value(x, y, i + 1));
+                        float numerator   = std::max(n1, n2);
+                        float d1          = fabsf(la.value(x, y, i + 2));
+                        float d2          = fabsf(lb.value(x, y, i + 2));
+                        float denominator = std::max(std::max(d1, d2),
+                                                     1.0e-5f);
+                        contrast[i]       = numerator / denominator;
+                        sum_contrast += contrast[i];
+                    }
+                    if (sum_contrast < 1e-5)
+                        sum_contrast = 1e-5f;
+                    float F_mask[PYRAMID_MAX_LEVELS - 2];
+                    float adapt = la.value(x, y, adaptation_level)
+                                  + lb.value(x, y, adaptation_level);
+                    adapt *= 0.5f;
+                    if (adapt < 1e-5)
+                        adapt = 1e-5f;
+                    for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++)
+                        F_mask[i] = mask(contrast[i]
+                                         * contrast_sensitivity(cpd[i],
+                                                                adapt));
+                    float factor = 0;
+                    for (int i = 0; i < PYRAMID_MAX_LEVELS - 2; i++)
+                        factor += contrast[i] * F_freq[i] * F_mask[i]
+                                  / sum_contrast;
+                    factor      = OIIO::clamp(factor, 1.0f, 10.0f);
+                    float delta = fabsf(la.value(x, y, 0)
+                                        - lb.value(x, y, 0));
+                    bool pass   = true;
+                    // pure luminance test
+                    delta /= tvi(adapt);
+                    if (delta > factor) {
+                        pass = false;
+                    } else if (!luminanceOnly) {
+                        // CIE delta E test with modifications
+                        float color_scale = 1.0f;
+                        // ramp down the color test in scotopic regions
+                        if (adapt < 10.0f) {
+                            color_scale = 1.0f
+                                          - (10.0f - color_scale) / 10.0f;
+                            color_scale = color_scale * color_scale;
+                        }
+                        size_t p = size_t(y - tile.ybegin) * tile.width()
+                                   + x - tile.xbegin;
+                        float da = a->labA[p] - b->labA[p];  // diff in A
+                        float db = a->labB[p] - b->labB[p];  // diff in B
+                        da       = da * da;
+                        db       = db * db;
+                        delta    = (da + db) * color_scale;
+                        if (delta > factor)
+                            pass = false;
+                    }
+                    if (!pass) {
+                        ++nfail;
+                        if (factor > maxerror) {
+                            maxerror = factor;
+                            maxx     = x;
+                            maxy     = y;
+                        }
+                    }
                 }
-                float da = aLAB.getchannel(x, y, 0, 1)
-                           - bLAB.getchannel(x, y, 0, 1);  // diff in A
-                float db = aLAB.getchannel(x, y, 0, 2)
-                           - bLAB.getchannel(x, y, 0, 2);  // diff in B
-                da    = da * da;
-                db    = db * db;
-                delta = (da + db) * color_scale;
-                if (delta > factor)
-                    pass = false;
             }
-            if (!pass) {
-                ++result.nfail;
-                if (factor > result.maxerror) {
-                    result.maxerror = factor;
-                    result.maxx     = x;
-                    result.maxy     = y;
-                    //                    result.maxz = z;
-                }
+
+            // Merge, keeping the first worst pixel in scanline order
+            // regardless of which tile finished first.
+            std::lock_guard<std::mutex> lock(mutex);
+            result.nfail += nfail;
+            if (maxerror > result.maxerror
+                || (maxerror == result.maxerror && maxerror > 0.0f
+                    && (maxy < result.maxy
+                        || (maxy == result.maxy && maxx < result.maxx)))) {
+                result.maxerror = maxerror;
+                result.maxx     = maxx;
+                result.maxy     = maxy;
             }
-        }
-    }
+        },
+        parallel_options(nthreads));
 
     return result.nfail;
 }
@@ -3,16 +3,52 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <OpenImageIO/argparse.h>
+#include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/deepdata.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/texture.h>
+#include <OpenImageIO/thread.h>
 #include <OpenImageIO/unittest.h>
 
 #include <iostream>
 
 using namespace OIIO;
 
+static bool bench     = false;
+static int iterations = 4000000;
+static int ntrials    = 1;
+static int maxthreads = 128;
+
+
+
+static void
+getargs(int argc, char* argv[])
+{
+    ArgParse ap;
+    // clang-format off
+    ap.intro("imagecache_test\n" OIIO_INTRO_STRING)
+      .usage("imagecache_test [options]");
+
+    ap.arg("--bench", &bench)
+      .help("Run the tile lookup thread scaling benchmark");
+    ap.arg("--threads %d", &maxthreads)
+      .help(Strutil::sprintf("Max number of threads for the benchmark (default: %d)", maxthreads));
+    ap.arg("--iters %d", &iterations)
+      .help(Strutil::sprintf("Number of benchmark iterations (default: %d)", iterations));
+    ap.arg("--trials %d", &ntrials)
+      .help("Number of benchmark trials");
+    // clang-format on
+
+    ap.parse(argc, (const char**)argv);
+}
+
 
 
 // Tests various ways for the subset of channels to be cached in a
@@ -134,9 +170,476 @@ test_app_buffer()
 
 
 
+// Write an image of 64x64 tiles (by default, 16x16 of them) with a
+// different value in each tile, so that there are many more tiles than
+// fit in the per-thread microcache.
+static ustring
+make_tiled_file(float offset = 0.0f, int res = 1024, int nchans = 1,
+                ustring filename = ustring("manytiles.tif"))
+{
+    ImageSpec spec(res, res, nchans, TypeDesc::FLOAT);
+    spec.tile_width  = 64;
+    spec.tile_height = 64;
+    ImageBuf A(spec);
+    for (ImageBuf::Iterator<float> p(A); !p.done(); ++p)
+        for (int c = 0; c < nchans; ++c)
+            p[c] = offset + float((p.y() / 64) * (res / 64) + p.x() / 64);
+    A.write(filename);
+    return filename;
+}
+
+
+
+// Test that tiles get found through the lock-free tile index once they
+// have fallen out of the microcache, and that invalidating the file
+// doesn't leave stale tiles findable there.
+void
+test_tile_index()
+{
+    std::cout << "\nTesting tile index lookups\n";
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    ustring filename       = make_tiled_file();
+    // The first pass reads the tiles, the second finds them in the main
+    // cache (adding them to the index), and the third in the index.
+    for (int pass = 0; pass < 3; ++pass) {
+        for (int t = 0; t < 256; ++t) {
+            float val = -1.0f;
+            int x = (t % 16) * 64 + 5, y = (t / 16) * 64 + 7;
+            OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, x, x + 1,
+                                                     y, y + 1, 0, 1,
+                                                     TypeDesc::FLOAT, &val));
+            OIIO_CHECK_EQUAL(val, float(t));
+        }
+    }
+    long long hits = 0;
+    imagecache->getattribute("stat:find_tile_index_hits", TypeDesc::INT64,
+                             &hits);
+    OIIO_CHECK_ASSERT(hits > 0);
+
+    // Change the file, and make sure we see the new pixels
+    make_tiled_file(1000.0f);
+    imagecache->invalidate(filename);
+    float val = -1.0f;
+    OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, 5, 6, 7, 8, 0, 1,
+                                             TypeDesc::FLOAT, &val));
+    OIIO_CHECK_EQUAL(val, 1000.0f);
+
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that latency distributions are recorded when asked for, and that
+// their percentiles are in order.
+void
+test_latency_stats()
+{
+    std::cout << "\nTesting latency stats\n";
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    TextureSystem* texsys  = TextureSystem::create(false, imagecache);
+    imagecache->attribute("latency_stats", 1);
+    ustring filename = make_tiled_file();
+    TextureOpt opt;
+    for (int t = 0; t < 256; ++t) {
+        float s = ((t % 16) + 0.5f) / 16.0f, tt = ((t / 16) + 0.5f) / 16.0f;
+        float result[3];
+        OIIO_CHECK_ASSERT(texsys->texture(filename, opt, s, tt, 0.0f, 0.0f,
+                                          0.0f, 0.0f, 3, result));
+    }
+    for (const char* which : { "lookup", "tile_wait", "fileopen" }) {
+        std::string stat = Strutil::fmt::format("stat:{}_latency_", which);
+        long long count  = 0;
+        float p50 = -1.0f, p999 = -1.0f, max = -1.0f;
+        OIIO_CHECK_ASSERT(imagecache->getattribute(stat + "count",
+                                                   TypeDesc::INT64, &count));
+        OIIO_CHECK_ASSERT(imagecache->getattribute(stat + "p50", p50));
+        OIIO_CHECK_ASSERT(imagecache->getattribute(stat + "p999", p999));
+        OIIO_CHECK_ASSERT(imagecache->getattribute(stat + "max", max));
+        OIIO_CHECK_ASSERT(count > 0);
+        OIIO_CHECK_ASSERT(p50 > 0.0f && p50 <= p999 && p999 <= max);
+    }
+    long long lookups = 0;
+    imagecache->getattribute("stat:lookup_latency_count", TypeDesc::INT64,
+                             &lookups);
+    OIIO_CHECK_EQUAL(lookups, 256);
+    OIIO_CHECK_ASSERT(Strutil::contains(texsys->getstats(5), "Latencies:"));
+    OIIO_CHECK_ASSERT(!Strutil::contains(texsys->getstats(4), "Latencies:"));
+
+    // Nothing is recorded when the stats are off
+    imagecache->reset_stats();
+    imagecache->attribute("latency_stats", 0);
+    float result[3];
+    texsys->texture(filename, opt, 0.5f, 0.5f, 0.0f, 0.0f, 0.0f, 0.0f, 3,
+                    result);
+    imagecache->getattribute("stat:lookup_latency_count", TypeDesc::INT64,
+                             &lookups);
+    OIIO_CHECK_EQUAL(lookups, 0);
+
+    TextureSystem::destroy(texsys);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that with a compressed tier, tiles squeezed out of a cache that's
+// too small come back from the tier rather than being read again.
+void
+test_compressed_tier()
+{
+    std::cout << "\nTesting compressed tile tier\n";
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    imagecache->attribute("max_memory_MB", 10.0f);
+    imagecache->attribute("compressed_tier_MB", 10.0f);
+    // 64 MB of pixels, but each tile is constant so compresses very well
+    ustring filename = make_tiled_file(0.0f, 2048, 4,
+                                       ustring("compressible.tif"));
+    for (int pass = 0; pass < 2; ++pass) {
+        for (int t = 0; t < 32 * 32; ++t) {
+            float val[4] = { -1.0f, -1.0f, -1.0f, -1.0f };
+            int x = (t % 32) * 64 + 3, y = (t / 32) * 64 + 9;
+            OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, x, x + 1,
+                                                     y, y + 1, 0, 1,
+                                                     TypeDesc::FLOAT, val));
+            OIIO_CHECK_EQUAL(val[3], float(t));
+        }
+    }
+    int demoted = 0, restored = 0;
+    imagecache->getattribute("stat:compressed_tiles_demoted", demoted);
+    imagecache->getattribute("stat:compressed_tiles_restored", restored);
+    OIIO_CHECK_ASSERT(demoted > 0);
+    OIIO_CHECK_ASSERT(restored > 0);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that a file with its own memory quota gives back its oldest tiles
+// once it goes over, even though the cache as a whole has room to spare.
+void
+test_file_quota()
+{
+    std::cout << "\nTesting per-file quota and priority hints\n";
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    imagecache->attribute("max_memory_MB", 100.0f);
+    // 4 MB of pixels in 256 tiles, but only 1 MB allowed to stay resident
+    ustring filename = make_tiled_file(0.0f);
+    ImageCache::ImageHandle* handle = imagecache->get_image_handle(filename);
+    OIIO_CHECK_ASSERT(imagecache->file_attribute(handle, "max_resident_MB",
+                                                 1.0f));
+    OIIO_CHECK_ASSERT(imagecache->file_attribute(handle, "priority", 2));
+    OIIO_CHECK_ASSERT(!imagecache->file_attribute(handle, "bogus", 1));
+    for (int t = 0; t < 16 * 16; ++t) {
+        float val = -1.0f;
+        int x = (t % 16) * 64 + 5, y = (t / 16) * 64 + 7;
+        OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, x, x + 1, y,
+                                                 y + 1, 0, 1, TypeDesc::FLOAT,
+                                                 &val));
+        OIIO_CHECK_EQUAL(val, float(t));
+    }
+    int evicted = 0;
+    long long memused = 0;
+    imagecache->getattribute("stat:tiles_quota_evicted", evicted);
+    imagecache->getattribute("stat:cache_memory_used", TypeDesc::INT64,
+                             &memused);
+    OIIO_CHECK_ASSERT(evicted > 0);
+    OIIO_CHECK_ASSERT(memused < 2 * 1024 * 1024);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that a manifest saved by one cache warms up another one.
+void
+test_manifest()
+{
+    std::cout << "\nTesting manifest save/load\n";
+    ustring filename = make_tiled_file();
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    // Keep read-ahead from bringing in tiles we didn't ask for
+    imagecache->attribute("max_readahead_tiles", 1);
+    for (int t = 0; t < 10; ++t) {
+        float val = -1.0f;
+        int x = t * 64;
+        OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, x, x + 1, 0,
+                                                 1, 0, 1, TypeDesc::FLOAT,
+                                                 &val));
+    }
+    OIIO_CHECK_ASSERT(imagecache->save_manifest("manifest.txt"));
+    ImageCache::destroy(imagecache);
+
+    imagecache = ImageCache::create(false /*not shared*/);
+    // With no prefetch threads, the loading is done before we return
+    imagecache->attribute("prefetch_threads", 0);
+    imagecache->attribute("max_readahead_tiles", 1);
+    OIIO_CHECK_ASSERT(!imagecache->load_manifest("manytiles.tif"));
+    (void)imagecache->geterror();
+    OIIO_CHECK_ASSERT(imagecache->load_manifest("manifest.txt"));
+    int prefetched = 0, created = 0;
+    imagecache->getattribute("stat:tiles_prefetched", prefetched);
+    OIIO_CHECK_EQUAL(prefetched, 10);
+    float val = -1.0f;
+    OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, 129, 130, 5, 6,
+                                             0, 1, TypeDesc::FLOAT, &val));
+    OIIO_CHECK_EQUAL(val, 2.0f);
+    imagecache->getattribute("stat:tiles_created", created);
+    OIIO_CHECK_EQUAL(created, 10);  // no extra reads for warmed tiles
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that many threads missing on different tiles of one file at once,
+// each possibly through its own ImageInput, all get the right pixels.
+void
+test_concurrent_reads()
+{
+    std::cout << "\nTesting concurrent tile reads of one file\n";
+    ustring filename = make_tiled_file();
+    for (int maxinputs : { 1, 4 }) {
+        ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+        imagecache->attribute("max_inputs_per_file", maxinputs);
+        imagecache->attribute("max_readahead_tiles", 1);
+        // Replicate across NUMA nodes as eagerly as possible (harmless on
+        // machines with just one node)
+        imagecache->attribute("numa_replicate", 1);
+        atomic_int wrong(0);
+        auto task = [&](int first) {
+            for (int t = first; t < 256; t += 8) {
+                float val = -1.0f;
+                int x = (t % 16) * 64 + 5, y = (t / 16) * 64 + 7;
+                imagecache->get_pixels(filename, 0, 0, x, x + 1, y, y + 1, 0,
+                                       1, TypeDesc::FLOAT, &val);
+                if (val != float(t))
+                    ++wrong;
+            }
+        };
+        thread_group threads;
+        for (int i = 0; i < 8; ++i)
+            threads.create_thread(task, i);
+        threads.join_all();
+        OIIO_CHECK_EQUAL(wrong, 0);
+        long long spares = -1;
+        imagecache->getattribute("stat:spare_inputs_opened", TypeDesc::INT64,
+                                 &spares);
+        OIIO_CHECK_ASSERT(spares >= 0 && spares <= 3);
+        if (maxinputs == 1)
+            OIIO_CHECK_EQUAL(spares, 0);
+        int nodes = 0;
+        imagecache->getattribute("stat:numa_nodes", nodes);
+        OIIO_CHECK_ASSERT(nodes >= 1);
+        ImageCache::destroy(imagecache);
+    }
+}
+
+
+
+// Test that files without fingerprints are deduplicated by content only
+// when their bytes really are identical.
+void
+test_content_dedup()
+{
+    std::cout << "\nTesting deduplication by content hash\n";
+    ustring orig = make_tiled_file(0.0f, 256, 1, ustring("dedup_a.tif"));
+    ustring same("dedup_b.tif");
+    Filesystem::copy(orig, same);
+    ustring diff = make_tiled_file(7.0f, 256, 1, ustring("dedup_c.tif"));
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    imagecache->attribute("deduplicate_content", 1);
+    for (ustring f : { orig, same, diff }) {
+        float val = -1.0f;
+        OIIO_CHECK_ASSERT(imagecache->get_pixels(f, 0, 0, 0, 1, 0, 1, 0, 1,
+                                                 TypeDesc::FLOAT, &val));
+        OIIO_CHECK_EQUAL(val, f == diff ? 7.0f : 0.0f);
+    }
+    int isdup_a = -1, isdup_b = -1, isdup_c = -1;
+    imagecache->get_image_info(orig, 0, 0, ustring("stat:is_duplicate"),
+                               TypeInt, &isdup_a);
+    imagecache->get_image_info(same, 0, 0, ustring("stat:is_duplicate"),
+                               TypeInt, &isdup_b);
+    imagecache->get_image_info(diff, 0, 0, ustring("stat:is_duplicate"),
+                               TypeInt, &isdup_c);
+    OIIO_CHECK_EQUAL(isdup_a, 0);
+    OIIO_CHECK_EQUAL(isdup_b, 1);
+    OIIO_CHECK_EQUAL(isdup_c, 0);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that get_pixels of big regions can bypass the tile cache, and still
+// get the right pixels when the region doesn't line up with the tiles.
+void
+test_streaming_get_pixels()
+{
+    std::cout << "\nTesting streaming get_pixels\n";
+    ustring filename       = make_tiled_file();
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    imagecache->attribute("get_pixels_streaming", 2);
+    const int xbegin = 37, xend = 1000, ybegin = 5, yend = 301;
+    std::vector<float> buf((xend - xbegin) * (yend - ybegin), -1.0f);
+    OIIO_CHECK_ASSERT(imagecache->get_pixels(filename, 0, 0, xbegin, xend,
+                                             ybegin, yend, 0, 1,
+                                             TypeDesc::FLOAT, buf.data()));
+    int wrong = 0;
+    for (int y = ybegin; y < yend; ++y)
+        for (int x = xbegin; x < xend; ++x)
+            if (buf[(y - ybegin) * (xend - xbegin) + (x - xbegin)]
+                != float((y / 64) * 16 + x / 64))
+                ++wrong;
+    OIIO_CHECK_EQUAL(wrong, 0);
+    long long streamed = 0;
+    int created        = -1;
+    imagecache->getattribute("stat:bytes_streamed", TypeDesc::INT64,
+                             &streamed);
+    imagecache->getattribute("stat:tiles_created", created);
+    OIIO_CHECK_ASSERT(streamed > 0);
+    OIIO_CHECK_EQUAL(created, 0);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that the batched get_pixels fills in many small regions at once,
+// including ones straddling tile boundaries or hanging off the image.
+void
+test_batched_get_pixels()
+{
+    std::cout << "\nTesting batched get_pixels\n";
+    ustring filename = make_tiled_file(0.0f, 256, 2, ustring("batched.tif"));
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    std::vector<ROI> rois;
+    for (int i = 0; i < 50; ++i)
+        rois.emplace_back(i * 5 - 2, i * 5 + 1, 62 + i, 65 + i, 0, 1, 0, 2);
+    rois.back().chbegin = 1;  // just the second channel
+    std::vector<std::vector<float>> bufs(rois.size());
+    std::vector<ImageCache::PixelRequest> requests(rois.size());
+    for (size_t i = 0; i < rois.size(); ++i) {
+        bufs[i].resize(rois[i].npixels() * rois[i].nchannels(), -1.0f);
+        requests[i].roi    = rois[i];
+        requests[i].result = bufs[i].data();
+    }
+    OIIO_CHECK_ASSERT(
+        imagecache->get_pixels(filename, requests, TypeDesc::FLOAT));
+    int wrong = 0;
+    for (size_t i = 0; i < rois.size(); ++i) {
+        const float* p = bufs[i].data();
+        for (int y = rois[i].ybegin; y < rois[i].yend; ++y)
+            for (int x = rois[i].xbegin; x < rois[i].xend; ++x)
+                for (int c = rois[i].chbegin; c < rois[i].chend; ++c)
+                    if (*p++ != (x < 0 ? 0.0f : float((y / 64) * 4 + x / 64)))
+                        ++wrong;
+    }
+    OIIO_CHECK_EQUAL(wrong, 0);
+    ImageCache::destroy(imagecache);
+}
+
+
+
+// Test that get_deep_pixels pieces together a region of a deep image from
+// its cached tiles, for both tiled and scanline files.
+void
+test_deep_pixels()
+{
+    if (!is_imageio_format_name("openexr"))
+        return;
+    std::cout << "\nTesting get_deep_pixels\n";
+    ImageSpec spec(100, 70, 3, TypeDesc::FLOAT);
+    spec.channelnames = { "A", "Z", "Zback" };
+    spec.deep         = true;
+    ImageBuf A(spec);
+    DeepData& dd(*A.deepdata());
+    for (int p = 0; p < dd.pixels(); ++p) {
+        dd.set_samples(p, p % 4);
+        for (int s = 0; s < dd.samples(p); ++s) {
+            dd.set_deep_value(p, 0, s, 0.25f);
+            dd.set_deep_value(p, 1, s, float(p + s));
+            dd.set_deep_value(p, 2, s, float(p + s) + 0.5f);
+        }
+    }
+    for (int tiled = 0; tiled < 2; ++tiled) {
+        ustring filename(tiled ? "deeptiles.exr" : "deepscans.exr");
+        if (tiled)
+            A.set_write_tiles(32, 32);
+        OIIO_CHECK_ASSERT(A.write(filename));
+        ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+        imagecache->attribute("autotile", 16);
+        ROI roi(10, 90, 20, 60, 0, 1, 1, 3);
+        DeepData result;
+        OIIO_CHECK_ASSERT(
+            imagecache->get_deep_pixels(filename, 0, 0, roi, result));
+        OIIO_CHECK_EQUAL(result.pixels(), roi.npixels());
+        OIIO_CHECK_EQUAL(result.channels(), 2);
+        int wrong = 0;
+        for (int y = roi.ybegin; y < roi.yend; ++y)
+            for (int x = roi.xbegin; x < roi.xend; ++x) {
+                int64_t p = (y - roi.ybegin) * roi.width() + x - roi.xbegin;
+                int64_t q = A.pixelindex(x, y, 0);
+                if (result.samples(p) != dd.samples(q))
+                    ++wrong;
+                else
+                    for (int s = 0; s < dd.samples(q); ++s)
+                        wrong += (result.deep_value(p, 0, s)
+                                  != dd.deep_value(q, 1, s));
+            }
+        OIIO_CHECK_EQUAL(wrong, 0);
+        // Flat images have no deep pixels
+        OIIO_CHECK_ASSERT(!imagecache->get_deep_pixels(make_tiled_file(), 0,
+                                                       0, ROI(), result));
+        (void)imagecache->geterror();
+        ImageCache::destroy(imagecache);
+    }
+}
+
+
+
+// How well does finding tiles that are already in the cache scale with
+// the number of threads?
+void
+benchmark_tile_lookup_scaling()
+{
+    std::cout << "\nTile lookup scaling (hw threads = "
+              << Sysutil::hardware_concurrency() << "):\n";
+    ImageCache* imagecache = ImageCache::create(false /*not shared*/);
+    ustring filename       = make_tiled_file();
+    // Get all the tiles into the cache before timing anything
+    std::vector<float> all(1024 * 1024);
+    imagecache->get_pixels(filename, 0, 0, 0, 1024, 0, 1024, 0, 1, 0, 1,
+                           TypeDesc::FLOAT, all.data());
+
+    auto task = [&](int iters) {
+        ImageCache::Perthread* thread_info = imagecache->create_thread_info();
+        ImageCache::ImageHandle* handle
+            = imagecache->get_image_handle(filename, thread_info);
+        // Hop around the tiles in a pseudo-random order, so that most
+        // lookups miss the microcache.
+        unsigned int t = unsigned(size_t(thread_info)) * 2654435761u;
+        for (int i = 0; i < iters; ++i) {
+            t = t * 1664525u + 1013904223u;
+            int x = int((t >> 8) & 15) * 64, y = int((t >> 16) & 15) * 64;
+            ImageCache::Tile* tile
+                = imagecache->get_tile(handle, thread_info, 0, 0, x, y, 0);
+            imagecache->release_tile(tile);
+        }
+        imagecache->destroy_thread_info(thread_info);
+    };
+    timed_thread_wedge(task, maxthreads, iterations, ntrials);
+
+    long long calls = 0, hits = 0;
+    imagecache->getattribute("stat:find_tile_calls", TypeDesc::INT64, &calls);
+    imagecache->getattribute("stat:find_tile_index_hits", TypeDesc::INT64,
+                             &hits);
+    std::cout << "  " << hits << " of " << calls
+              << " tile lookups were lock-free index hits\n";
+    ImageCache::destroy(imagecache);
+}
+
+
+
 int
-main(int /*argc*/, char* /*argv*/[])
+main(int argc, char* argv[])
 {
+    getargs(argc, argv);
+
     test_get_pixels_cachechannels(0, 10);
     test_get_pixels_cachechannels(0, 4);
     test_get_pixels_cachechannels(0, 4, 0, 6);
@@ -145,6 +648,19 @@ main(int /*argc*/, char* /*argv*/[])
     test_get_pixels_cachechannels(6, 9, 6, 9);
 
     test_app_buffer();
+    test_tile_index();
+    test_latency_stats();
+    test_compressed_tier();
+    test_file_quota();
+    test_manifest();
+    test_concurrent_reads();
+    test_content_dedup();
+    test_streaming_get_pixels();
+    test_batched_get_pixels();
+    test_deep_pixels();
+
+    if (bench)
+        benchmark_tile_lookup_scaling();
 
     return unit_test_failures;
 }
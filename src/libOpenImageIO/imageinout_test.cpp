@@ -14,6 +14,7 @@
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/tiffutils.h>
 #include <OpenImageIO/unittest.h>
 
 using namespace OIIO;
@@ -473,6 +474,198 @@ test_read_tricky_sizes()
 
 
 
+// Check which reads ImageInput reports as decoding straight into the
+// caller's buffer, and that such reads give the right answer.
+void
+test_read_zero_copy()
+{
+    char srcfilename[] = "tmp_zc.exr";
+    ImageSpec spec(4, 4, 3, TypeFloat);
+    ImageBuf src(spec);
+    ImageBufAlgo::fill(src, { 0.25f, 0.5f, 0.75f });
+    src.write(srcfilename);
+
+    float buf[4][4][3];
+    for (int tiled = 0; tiled < 2; ++tiled) {
+        if (tiled) {
+            src.set_write_tiles(2, 2);
+            src.write(srcfilename);
+        }
+        auto imgin = ImageInput::open(srcfilename);
+        OIIO_CHECK_ASSERT(imgin->read_is_zero_copy(0, 0, ROI(), TypeUnknown));
+        OIIO_CHECK_ASSERT(imgin->read_is_zero_copy(0, 0, ROI(), TypeFloat));
+        OIIO_CHECK_ASSERT(!imgin->read_is_zero_copy(0, 0, ROI(), TypeHalf));
+        OIIO_CHECK_ASSERT(!imgin->read_is_zero_copy(0, 0, ROI(0, 4, 0, 4, 0,
+                                                              1, 0, 2),
+                                                    TypeFloat));
+        OIIO_CHECK_ASSERT(
+            !imgin->read_is_zero_copy(0, 0, ROI(), TypeFloat, 4 * sizeof(float)));
+        OIIO_CHECK_EQUAL(imgin->read_is_zero_copy(0, 0, ROI(0, 2, 0, 2),
+                                                  TypeFloat),
+                         bool(tiled));
+        OIIO_CHECK_EQUAL(imgin->read_is_zero_copy(0, 0, ROI(0, 4, 0, 3),
+                                                  TypeFloat),
+                         !tiled);
+        memset(buf, 0, sizeof(buf));
+        OIIO_CHECK_ASSERT(imgin->read_image(0, 0, 0, 3, TypeFloat, buf));
+        OIIO_CHECK_EQUAL(buf[3][3][0], 0.25f);
+        OIIO_CHECK_EQUAL(buf[3][3][1], 0.5f);
+        OIIO_CHECK_EQUAL(buf[3][3][2], 0.75f);
+    }
+
+    Filesystem::remove(srcfilename);
+}
+
+
+
+// Write with "oiio:pipeline" (chunks compressed on the thread pool while
+// the calling thread writes them) and make sure it reads back unchanged.
+void
+test_write_pipeline()
+{
+    ImageSpec spec(97, 131, 3, TypeUInt8);
+    spec["compression"]   = "zip";
+    spec["oiio:pipeline"] = 1;
+    ImageBuf src(spec);
+    ImageBufAlgo::fill(src, { 0.0f, 0.25f, 0.5f }, { 1.0f, 0.75f, 0.0f });
+    for (int tiled = 0; tiled < 2; ++tiled) {
+        const char* filename = tiled ? "tmp_pipeline_tiled.tif"
+                                     : "tmp_pipeline.tif";
+        ImageSpec outspec = spec;
+        if (tiled)
+            outspec.tile_width = outspec.tile_height = 32;
+        auto out = ImageOutput::create(filename);
+        OIIO_CHECK_ASSERT(out && out->open(filename, outspec));
+        OIIO_CHECK_ASSERT(out->write_image(TypeUInt8, src.localpixels()));
+        out->close();
+        ImageBuf in(filename);
+        auto comp = ImageBufAlgo::compare(in, src, 0.0f, 0.0f);
+        OIIO_CHECK_EQUAL(comp.nfail, 0);
+        OIIO_CHECK_ASSERT(!comp.error);
+        if (!nodelete)
+            Filesystem::remove(filename);
+    }
+}
+
+
+
+// Premultiply as we write with the "oiio:AlphaConversion" hint, and
+// unpremultiply as we read with the same config hint.
+void
+test_alpha_conversion()
+{
+    const char* filename   = "tmp_alphaconv.exr";
+    const float unassoc[4] = { 0.5f, 0.25f, 1.0f, 0.5f };
+    float pixels[5][7][4];
+    for (auto& row : pixels)
+        for (auto& p : row)
+            std::copy(unassoc, unassoc + 4, p);
+    for (int tiled = 0; tiled < 2; ++tiled) {
+        ImageSpec spec(7, 5, 4, TypeHalf);
+        spec["oiio:AlphaConversion"] = "premult";
+        if (tiled)
+            spec.tile_width = spec.tile_height = 4;
+        auto out = ImageOutput::create(filename);
+        OIIO_CHECK_ASSERT(out && out->open(filename, spec));
+        OIIO_CHECK_ASSERT(out->write_image(TypeFloat, pixels));
+        out.reset();
+
+        float buf[5][7][4];
+        auto in = ImageInput::open(filename);
+        OIIO_CHECK_ASSERT(in && in->read_image(0, 0, 0, 4, TypeFloat, buf));
+        OIIO_CHECK_EQUAL(buf[4][6][0], 0.25f);
+        OIIO_CHECK_EQUAL(buf[4][6][2], 0.5f);
+        OIIO_CHECK_EQUAL(buf[4][6][3], 0.5f);
+
+        ImageSpec config;
+        config["oiio:AlphaConversion"] = "unpremult";
+        in = ImageInput::open(filename, &config);
+        OIIO_CHECK_ASSERT(in && in->read_image(0, 0, 0, 4, TypeFloat, buf));
+        for (int c = 0; c < 4; ++c) {
+            OIIO_CHECK_EQUAL(buf[0][0][c], unassoc[c]);
+            OIIO_CHECK_EQUAL(buf[4][6][c], unassoc[c]);
+        }
+    }
+    if (!nodelete)
+        Filesystem::remove(filename);
+}
+
+
+
+// With the "oiio:LazyMetadata" hint, Exif is decoded only when asked for.
+void
+test_lazy_metadata()
+{
+    const char* filename = "tmp_lazymeta.jpg";
+    ImageSpec spec(8, 8, 3, TypeUInt8);
+    spec.attribute("Exif:ExposureTime", 0.125f);
+    auto out = ImageOutput::create(filename);
+    OIIO_CHECK_ASSERT(out && out->open(filename, spec));
+    std::vector<unsigned char> pixels(spec.image_bytes(), 128);
+    OIIO_CHECK_ASSERT(out->write_image(TypeUInt8, pixels.data()));
+    out.reset();
+
+    // Left for the caller to decode
+    ImageSpec config;
+    config["oiio:LazyMetadata"] = 2;
+    auto in = ImageInput::open(filename, &config);
+    OIIO_CHECK_ASSERT(in);
+    ImageSpec lazyspec = in->spec();
+    OIIO_CHECK_ASSERT(!lazyspec.find_attribute("Exif:ExposureTime"));
+    OIIO_CHECK_ASSERT(decode_deferred_metadata(lazyspec));
+    OIIO_CHECK_EQUAL(lazyspec.get_float_attribute("Exif:ExposureTime"),
+                     0.125f);
+    OIIO_CHECK_ASSERT(!decode_deferred_metadata(lazyspec));
+
+    // Decoded by spec()
+    config["oiio:LazyMetadata"] = 1;
+    in = ImageInput::open(filename, &config);
+    OIIO_CHECK_ASSERT(in);
+    OIIO_CHECK_EQUAL(in->spec().get_float_attribute("Exif:ExposureTime"),
+                     0.125f);
+    OIIO_CHECK_ASSERT(!in->spec().find_attribute("oiio:DeferredExif"));
+    in.reset();
+    if (!nodelete)
+        Filesystem::remove(filename);
+}
+
+
+
+// Writing float pixels to uint8 with "oiio:dither" gives the same result
+// as adding the dither to the floats and then converting them.
+void
+test_dither()
+{
+    const char* filename = "tmp_dither.tif";
+    const int w = 300, h = 3, nc = 4;  // wider than the noise period
+    std::vector<float> pixels(w * h * nc);
+    for (size_t i = 0; i < pixels.size(); ++i)
+        pixels[i] = float(i % 509) / 508.0f;
+    ImageSpec spec(w, h, nc, TypeUInt8);
+    spec["oiio:dither"] = 1;
+    auto out            = ImageOutput::create(filename);
+    OIIO_CHECK_ASSERT(out && out->open(filename, spec));
+    OIIO_CHECK_ASSERT(out->write_image(TypeFloat, pixels.data()));
+    out.reset();
+
+    std::vector<float> dithered(pixels);
+    add_dither(nc, w, h, 1, dithered.data(), AutoStride, AutoStride,
+               AutoStride, 1.0f / 255.0f, spec.alpha_channel, spec.z_channel,
+               1);
+    std::vector<unsigned char> expected(pixels.size()), result(pixels.size());
+    convert_pixel_values(TypeFloat, dithered.data(), TypeUInt8,
+                         expected.data(), int(pixels.size()));
+    auto in = ImageInput::open(filename);
+    OIIO_CHECK_ASSERT(in
+                      && in->read_image(0, 0, 0, nc, TypeUInt8, result.data()));
+    OIIO_CHECK_ASSERT(result == expected);
+    in.reset();
+    if (!nodelete)
+        Filesystem::remove(filename);
+}
+
+
+
 int
 main(int argc, char* argv[])
 {
@@ -480,6 +673,11 @@ main(int argc, char* argv[])
 
     test_all_formats();
     test_read_tricky_sizes();
+    test_read_zero_copy();
+    test_write_pipeline();
+    test_alpha_conversion();
+    test_lazy_metadata();
+    test_dither();
 
     return unit_test_failures;
 }
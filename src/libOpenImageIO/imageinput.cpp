@@ -6,6 +6,7 @@
 #include <cstdio>
 #include <cstdlib>
 #include <memory>
+#include <mutex>
 #include <vector>
 
 #include <OpenImageIO/dassert.h>
@@ -15,6 +16,8 @@
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/parallel.h>
 #include <OpenImageIO/strutil.h>
+#include <OpenImageIO/tiffutils.h>
+#include <OpenImageIO/trace.h>
 #include <OpenImageIO/typedesc.h>
 
 #include "imageio_pvt.h"
@@ -41,6 +44,12 @@ public:
     // The "local" proxy that we will create to use if the user didn't
     // supply a proxy for us to use.
     std::unique_ptr<Filesystem::IOProxy> m_io_local;
+    // Alpha conversion for read_image() from the "oiio:AlphaConversion"
+    // config hint: 1 = premult, -1 = unpremult, 0 = none.
+    int m_alphaconvert = 0;
+    // The "oiio:LazyMetadata" config hint: 1 = decode deferred metadata in
+    // spec(), 2 = leave it for the caller to decode.
+    int m_lazy_metadata = 0;
 };
 
 
@@ -77,11 +86,12 @@ ImageInput::operator delete(void* ptr)
 ImageInput::ImageInput()
     : m_impl(new Impl, impl_deleter)
 {
+    ++pvt::imageinputs_live;
 }
 
 
 
-ImageInput::~ImageInput() {}
+ImageInput::~ImageInput() { --pvt::imageinputs_live; }
 
 
 
@@ -123,6 +133,8 @@ ImageInput::open(const std::string& filename, const ImageSpec* config,
         if (err.size())
             OIIO::pvt::errorfmt("{}", err);
         in.reset();
+    } else {
+        in->m_impl->m_alphaconvert = pvt::alpha_conversion(*config);
     }
 
     return in;
@@ -130,6 +142,20 @@ ImageInput::open(const std::string& filename, const ImageSpec* config,
 
 
 
+const ImageSpec&
+ImageInput::spec() const
+{
+    if (m_impl->m_lazy_metadata == 1) {
+        // Decode whatever metadata the reader kept undecoded, now that
+        // somebody wants to know.
+        lock_guard lock(*this);
+        decode_deferred_metadata(const_cast<ImageSpec&>(m_spec));
+    }
+    return m_spec;
+}
+
+
+
 ImageSpec
 ImageInput::spec(int subimage, int miplevel)
 {
@@ -141,7 +167,7 @@ ImageInput::spec(int subimage, int miplevel)
     ImageSpec ret;
     lock_guard lock(*this);
     if (seek_subimage(subimage, miplevel))
-        ret = m_spec;
+        ret = spec();
     return ret;
     // N.B. single return of named value should guaranteed copy elision.
 }
@@ -268,6 +294,7 @@ ImageInput::read_scanlines(int subimage, int miplevel, int ybegin, int yend,
                            int z, int chbegin, int chend, TypeDesc format,
                            void* data, stride_t xstride, stride_t ystride)
 {
+    OIIO_TRACE_ZONE("ImageInput::read_scanlines", "imageio", format_name());
     ImageSpec spec;
     int rps = 0;
     {
@@ -284,8 +311,8 @@ ImageInput::read_scanlines(int subimage, int miplevel, int ybegin, int yend,
             rps = m_spec.get_int_attribute("tiff:RowsPerStrip", 64);
     }
     if (spec.image_bytes() < 1) {
-        errorfmt("Invalid image size {} x {} ({} chans)", m_spec.width,
-                 m_spec.height, m_spec.nchannels);
+        errorfmt("Invalid image size {} x {} ({} chans)", spec.width,
+                 spec.height, spec.nchannels);
         return false;
     }
 
@@ -296,7 +323,10 @@ ImageInput::read_scanlines(int subimage, int miplevel, int ybegin, int yend,
     imagesize_t native_scanline_bytes
         = clamped_mult64((imagesize_t)spec.width,
                          (imagesize_t)native_pixel_bytes);
-    bool native        = (format == TypeDesc::UNKNOWN);
+    // Asking for the file's own uniform data format is as good as asking
+    // for native data, and lets us read straight into the user's buffer.
+    bool native        = (format == TypeDesc::UNKNOWN
+                   || (format == spec.format && spec.channelformats.empty()));
     size_t pixel_bytes = native ? native_pixel_bytes : format.size() * nchans;
     if (native && xstride == AutoStride)
         xstride = pixel_bytes;
@@ -573,6 +603,7 @@ ImageInput::read_tiles(int subimage, int miplevel, int xbegin, int xend,
                        int chend, TypeDesc format, void* data, stride_t xstride,
                        stride_t ystride, stride_t zstride)
 {
+    OIIO_TRACE_ZONE("ImageInput::read_tiles", "imageio", format_name());
     ImageSpec spec = spec_dimensions(subimage, miplevel);  // thread-safe
     if (spec.undefined())
         return false;
@@ -740,6 +771,159 @@ ImageInput::read_native_tile(int /*subimage*/, int /*miplevel*/, int /*x*/,
 }
 
 
+bool
+ImageInput::native_tile_location(int /*subimage*/, int /*miplevel*/,
+                                 int /*x*/, int /*y*/, int /*z*/,
+                                 int64_t& /*offset*/, int64_t& /*size*/)
+{
+    // By default, assume that the tile data in the file can't be used
+    // directly as native pixels.
+    return false;
+}
+
+
+
+bool
+ImageInput::native_tile_constant(int /*subimage*/, int /*miplevel*/,
+                                 int /*x*/, int /*y*/, int /*z*/,
+                                 void* /*pixel*/)
+{
+    // By default, we can't know what's in a tile without reading it.
+    return false;
+}
+
+
+
+bool
+ImageInput::read_raw_tile(int /*subimage*/, int /*miplevel*/, int /*x*/,
+                          int /*y*/, int /*z*/,
+                          std::vector<unsigned char>& /*rawdata*/)
+{
+    // Only formats that return true for supports("rawtiles") can separate
+    // fetching a tile from decoding it.
+    return false;
+}
+
+
+
+bool
+ImageInput::decode_raw_tile(int /*subimage*/, int /*miplevel*/, int /*x*/,
+                            int /*y*/, int /*z*/,
+                            span<unsigned char> /*rawdata*/, void* /*data*/)
+{
+    return false;
+}
+
+
+
+// Should read_native_tiles of this region take the raw fetch + parallel
+// decode path?
+static bool
+parallel_tile_decode(ImageInput* in, const ImageSpec& spec, int xbegin,
+                     int xend, int ybegin, int yend, int zbegin, int zend)
+{
+    thread_pool* pool = default_thread_pool();
+    bool multitile    = (xend - xbegin) > spec.tile_width
+                     || (yend - ybegin) > spec.tile_height
+                     || (zend - zbegin) > std::max(1, spec.tile_depth);
+    return multitile
+           // only if we're threading and don't enter the pool recursively!
+           && pool->size() > 1 && !pool->is_worker()
+           // only if this ImageInput wasn't asked to be single-threaded
+           && in->threads() != 1 && in->supports("rawtiles");
+}
+
+
+
+// Shared body of both base class read_native_tiles when the reader
+// supports "rawtiles": the raw tiles are fetched one after another by the
+// calling thread (that's the part that touches the file, and readers
+// serialize it anyway), and each is handed to the pool to be decoded and
+// copied into place as soon as it has been read.
+static bool
+read_native_tiles_parallel(ImageInput* in, const ImageSpec& spec,
+                           int subimage, int miplevel, int xbegin, int xend,
+                           int ybegin, int yend, int zbegin, int zend,
+                           int chbegin, int chend, void* data)
+{
+    int nchans                  = chend - chbegin;
+    int tw                      = spec.tile_width;
+    int th                      = spec.tile_height;
+    int td                      = std::max(1, spec.tile_depth);
+    stride_t native_pixel_bytes = (stride_t)spec.pixel_bytes(true);
+    stride_t native_tileystride = native_pixel_bytes * tw;
+    stride_t native_tilezstride = native_tileystride * th;
+    size_t prefix_bytes         = spec.pixel_bytes(0, chbegin, true);
+    stride_t subset_bytes       = spec.pixel_bytes(chbegin, chend, true);
+    stride_t subset_ystride     = (xend - xbegin) * subset_bytes;
+    stride_t subset_zstride     = (yend - ybegin) * subset_ystride;
+    size_t tilebytes            = spec.tile_bytes(true);
+
+    int nxtiles = (xend - xbegin + tw - 1) / tw;
+    int nytiles = (yend - ybegin + th - 1) / th;
+    int nztiles = (zend - zbegin + td - 1) / td;
+    std::vector<std::vector<unsigned char>> raw(size_t(nxtiles) * nytiles
+                                                * nztiles);
+
+    thread_pool* pool = default_thread_pool();
+    task_set tasks(pool);
+    std::atomic<bool> ok(true);
+    std::mutex errmutex;
+    std::string errmsg;
+    size_t t = 0;
+    for (int z = zbegin; ok && z < zend; z += td) {
+        for (int y = ybegin; ok && y < yend; y += th) {
+            for (int x = xbegin; ok && x < xend; x += tw, ++t) {
+                std::vector<unsigned char>* rawtile = &raw[t];
+                if (!in->read_raw_tile(subimage, miplevel, x, y, z,
+                                       *rawtile)) {
+                    ok = false;
+                    break;
+                }
+                // Clip the copy to the requested region so that tiles at
+                // the image edge never write into their neighbors' pixels.
+                int xw    = std::min(tw, xend - x);
+                int yh    = std::min(th, yend - y);
+                int zd    = std::min(td, zend - z);
+                char* dst = (char*)data + (z - zbegin) * subset_zstride
+                            + (y - ybegin) * subset_ystride
+                            + (x - xbegin) * subset_bytes;
+                tasks.push(pool->push([=, &ok, &errmutex,
+                                       &errmsg](int /*id*/) {
+                    std::unique_ptr<char[]> pels(new char[tilebytes]);
+                    if (in->decode_raw_tile(subimage, miplevel, x, y, z,
+                                            *rawtile, pels.get())) {
+                        copy_image(nchans, xw, yh, zd, &pels[prefix_bytes],
+                                   subset_bytes, native_pixel_bytes,
+                                   native_tileystride, native_tilezstride,
+                                   dst, subset_bytes, subset_ystride,
+                                   subset_zstride);
+                    } else {
+                        // Errors are per-thread, so carry the worker's
+                        // message back to be reported by the caller.
+                        std::string err = in->geterror();
+                        std::lock_guard<std::mutex> lock(errmutex);
+                        if (errmsg.empty())
+                            errmsg = err.size()
+                                         ? err
+                                         : Strutil::fmt::format(
+                                             "Could not decode tile at ({}, {}, {})",
+                                             x, y, z);
+                        ok = false;
+                    }
+                    std::vector<unsigned char>().swap(*rawtile);
+                }));
+            }
+        }
+    }
+    tasks.wait();
+    if (errmsg.size())
+        in->errorfmt("{}", errmsg);
+    return ok;
+}
+
+
+
 bool
 ImageInput::read_native_tiles(int subimage, int miplevel, int xbegin, int xend,
                               int ybegin, int yend, int zbegin, int zend,
@@ -761,6 +945,12 @@ ImageInput::read_native_tiles(int subimage, int miplevel, int xbegin, int xend,
     // calls read_native_tile, which is supplied by every plugin that
     // supports tiles.  Only the hardcore ones will overload
     // read_native_tiles with their own implementation.
+    if (parallel_tile_decode(this, spec, xbegin, xend, ybegin, yend, zbegin,
+                             zend))
+        return read_native_tiles_parallel(this, spec, subimage, miplevel,
+                                          xbegin, xend, ybegin, yend, zbegin,
+                                          zend, 0, spec.nchannels, data);
+
     stride_t pixel_bytes = (stride_t)spec.pixel_bytes(true);
     stride_t tileystride = pixel_bytes * spec.tile_width;
     stride_t tilezstride = tileystride * spec.tile_height;
@@ -819,6 +1009,11 @@ ImageInput::read_native_tiles(int subimage, int miplevel, int xbegin, int xend,
     // calls read_native_tile, which is supplied by every plugin that
     // supports tiles.  Only the hardcore ones will overload
     // read_native_tiles with their own implementation.
+    if (parallel_tile_decode(this, spec, xbegin, xend, ybegin, yend, zbegin,
+                             zend))
+        return read_native_tiles_parallel(this, spec, subimage, miplevel,
+                                          xbegin, xend, ybegin, yend, zbegin,
+                                          zend, chbegin, chend, data);
 
     int nchans                  = chend - chbegin;
     stride_t native_pixel_bytes = (stride_t)spec.pixel_bytes(true);
@@ -892,6 +1087,7 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
                        ProgressCallback progress_callback,
                        void* progress_callback_data)
 {
+    OIIO_TRACE_ZONE("ImageInput::read_image", "imageio", format_name());
     ImageSpec spec;
     int rps = 0;
     {
@@ -908,8 +1104,8 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
             rps = m_spec.get_int_attribute("tiff:RowsPerStrip", 64);
     }
     if (spec.image_bytes() < 1) {
-        errorfmt("Invalid image size {} x {} ({} chans)", m_spec.width,
-                 m_spec.height, m_spec.nchannels);
+        errorfmt("Invalid image size {} x {} ({} chans)", spec.width,
+                 spec.height, spec.nchannels);
         return false;
     }
 
@@ -925,6 +1121,23 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
         xstride = pixel_bytes;
     spec.auto_stride(xstride, ystride, zstride, format, nchans, spec.width,
                      spec.height);
+    // Any alpha conversion asked for by the config hint is done to each
+    // chunk right after it's read and converted, while it's still in cache.
+    const int alpha = spec.alpha_channel - chbegin;
+    const int zchan = spec.z_channel - chbegin;
+    const bool convert_alpha = m_impl->m_alphaconvert && alpha >= 0
+                               && alpha < nchans
+                               && !(native && spec.channelformats.size());
+    auto alpha_convert = [&](char* chunk, int height, int depth) {
+        TypeDesc bufformat = native ? spec.format : format;
+        if (m_impl->m_alphaconvert > 0)
+            premult(nchans, spec.width, height, depth, 0, nchans, bufformat,
+                    chunk, xstride, ystride, zstride, alpha, zchan);
+        else
+            unpremult(nchans, spec.width, height, depth, 0, nchans,
+                      bufformat, chunk, xstride, ystride, zstride, alpha,
+                      zchan);
+    };
     bool ok = true;
     if (progress_callback)
         if (progress_callback(progress_callback_data, 0.0f))
@@ -935,17 +1148,17 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
         // parallelization purposes), but as typical core counts increase,
         // we may someday want to revisit this to batch multiple rows.
         for (int z = 0; z < spec.depth; z += spec.tile_depth) {
+            int zend = std::min(z + spec.tile_depth, spec.depth);
             for (int y = 0; y < spec.height && ok; y += spec.tile_height) {
+                int yend    = std::min(y + spec.tile_height, spec.height);
+                char* chunk = (char*)data + z * zstride + y * ystride;
                 ok &= read_tiles(subimage, miplevel, spec.x,
                                  spec.x + spec.width, y + spec.y,
-                                 std::min(y + spec.y + spec.tile_height,
-                                          spec.y + spec.height),
-                                 z + spec.z,
-                                 std::min(z + spec.z + spec.tile_depth,
-                                          spec.z + spec.depth),
-                                 chbegin, chend, format,
-                                 (char*)data + z * zstride + y * ystride,
-                                 xstride, ystride, zstride);
+                                 yend + spec.y, z + spec.z, zend + spec.z,
+                                 chbegin, chend, format, chunk, xstride,
+                                 ystride, zstride);
+                if (ok && convert_alpha)
+                    alpha_convert(chunk, yend - y, zend - z);
                 if (progress_callback
                     && progress_callback(progress_callback_data,
                                          (float)y / spec.height))
@@ -962,10 +1175,12 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
         for (int z = 0; z < spec.depth; ++z) {
             for (int y = 0; y < spec.height && ok; y += chunk) {
                 int yend = std::min(y + spec.y + chunk, spec.y + spec.height);
+                char* d  = (char*)data + z * zstride + y * ystride;
                 ok &= read_scanlines(subimage, miplevel, y + spec.y, yend,
-                                     z + spec.z, chbegin, chend, format,
-                                     (char*)data + z * zstride + y * ystride,
+                                     z + spec.z, chbegin, chend, format, d,
                                      xstride, ystride);
+                if (ok && convert_alpha)
+                    alpha_convert(d, yend - (y + spec.y), 1);
                 if (progress_callback)
                     if (progress_callback(progress_callback_data,
                                           (float)y / spec.height))
@@ -980,6 +1195,98 @@ ImageInput::read_image(int subimage, int miplevel, int chbegin, int chend,
 
 
 
+bool
+ImageInput::read_is_zero_copy(int subimage, int miplevel, ROI roi,
+                              TypeDesc format, stride_t xstride,
+                              stride_t ystride, stride_t zstride)
+{
+    ImageSpec spec = spec_dimensions(subimage, miplevel);  // thread-safe
+    if (spec.undefined())
+        return false;
+    if (!roi.defined())
+        roi = spec.roi();
+    roi.chend = std::min(roi.chend, spec.nchannels);
+
+    // These mirror the conditions under which read_scanlines and
+    // read_tiles hand the user's buffer straight to read_native_*.
+    if (roi.chbegin != 0 || roi.chend != spec.nchannels)
+        return false;
+    if (format != TypeDesc::UNKNOWN
+        && (format != spec.format || spec.channelformats.size()))
+        return false;
+    if (spec.tile_width) {
+        if (!spec.valid_tile_range(roi.xbegin, roi.xend, roi.ybegin, roi.yend,
+                                   roi.zbegin, roi.zend)
+            || roi.width() % spec.tile_width
+            || roi.height() % spec.tile_height
+            || roi.depth() % std::max(1, spec.tile_depth))
+            return false;
+    } else {
+        if (roi.xbegin != spec.x || roi.xend != spec.x + spec.width)
+            return false;
+    }
+    stride_t pixel_bytes = stride_t(spec.pixel_bytes(true));
+    if (xstride == AutoStride)
+        xstride = pixel_bytes;
+    if (ystride == AutoStride)
+        ystride = xstride * roi.width();
+    if (zstride == AutoStride)
+        zstride = ystride * roi.height();
+    return xstride == pixel_bytes && ystride == pixel_bytes * roi.width()
+           && (zstride == ystride * roi.height() || roi.depth() <= 1);
+}
+
+
+
+std::future<bool>
+ImageInput::read_image_async(int subimage, int miplevel, int chbegin,
+                             int chend, TypeDesc format, void* data,
+                             stride_t xstride, stride_t ystride,
+                             stride_t zstride,
+                             ProgressCallback progress_callback,
+                             void* progress_callback_data)
+{
+    // The explicit-subimage read_image is thread-safe, so it's fine for it
+    // to run on an I/O pool thread while the caller carries on.
+    return io_thread_pool()->push([=](int /*id*/) {
+        return read_image(subimage, miplevel, chbegin, chend, format, data,
+                          xstride, ystride, zstride, progress_callback,
+                          progress_callback_data);
+    });
+}
+
+
+
+std::future<bool>
+ImageInput::read_scanlines_async(int subimage, int miplevel, int ybegin,
+                                 int yend, int z, int chbegin, int chend,
+                                 TypeDesc format, void* data, stride_t xstride,
+                                 stride_t ystride)
+{
+    return io_thread_pool()->push([=](int /*id*/) {
+        return read_scanlines(subimage, miplevel, ybegin, yend, z, chbegin,
+                              chend, format, data, xstride, ystride);
+    });
+}
+
+
+
+std::future<bool>
+ImageInput::read_tiles_async(int subimage, int miplevel, int xbegin, int xend,
+                             int ybegin, int yend, int zbegin, int zend,
+                             int chbegin, int chend, TypeDesc format,
+                             void* data, stride_t xstride, stride_t ystride,
+                             stride_t zstride)
+{
+    return io_thread_pool()->push([=](int /*id*/) {
+        return read_tiles(subimage, miplevel, xbegin, xend, ybegin, yend,
+                          zbegin, zend, chbegin, chend, format, data, xstride,
+                          ystride, zstride);
+    });
+}
+
+
+
 bool
 ImageInput::read_native_deep_scanlines(int /*subimage*/, int /*miplevel*/,
                                        int /*ybegin*/, int /*yend*/, int /*z*/,
@@ -1193,13 +1500,40 @@ bool
 ImageInput::ioproxy_use_or_open(string_view name)
 {
     Filesystem::IOProxy*& m_io(m_impl->m_io);
+    if (!m_io && oiio_use_mmap && !pvt::is_remote_url(name)) {
+        // If no proxy was supplied and we've been asked to, try to memory
+        // map the file, falling back to an IOFile below if that fails.
+        m_io = new Filesystem::IOMMap(name);
+        m_impl->m_io_local.reset(m_io);
+        if (!m_io->opened()) {
+            m_impl->m_io_local.reset();
+            m_io = nullptr;
+        }
+    }
     if (!m_io) {
-        // If no proxy was supplied, create an IOFile
-        m_io = new Filesystem::IOFile(name, Filesystem::IOProxy::Mode::Read);
+        // If no proxy was supplied, create an IOFile (or an IOHttp for a
+        // remote URL)
+        m_io = pvt::create_read_ioproxy(name);
         m_impl->m_io_local.reset(m_io);
+        // Readers that nibble at the file front to back get a read-ahead
+        // buffer in front of it, sparing them a call into stdio (and often
+        // the OS) per tiny read.
+        if (m_io->mode() == Filesystem::IOProxy::Mode::Read
+            && oiio_io_readahead > 0 && !strcmp(m_io->proxytype(), "file")
+            && supports("sequential_io")) {
+            m_io = new Filesystem::IOReadAhead(std::move(m_impl->m_io_local),
+                                               size_t(oiio_io_readahead),
+                                               io_thread_pool());
+            m_impl->m_io_local.reset(m_io);
+        }
     }
     if (!m_io || m_io->mode() != Filesystem::IOProxy::Mode::Read) {
-        errorfmt("Could not open file \"{}\"", name);
+        std::string err = m_io && pvt::is_remote_url(name) ? m_io->error()
+                                                           : std::string();
+        if (err.size())
+            errorfmt("{}", err);
+        else
+            errorfmt("Could not open file \"{}\"", name);
         ioproxy_clear();
         return false;
     }
@@ -1253,4 +1587,22 @@ ImageInput::iotell() const
 }
 
 
+
+int
+ImageInput::lazy_metadata(const ImageSpec& config)
+{
+    m_impl->m_lazy_metadata = config.get_int_attribute("oiio:LazyMetadata");
+    return m_impl->m_lazy_metadata;
+}
+
+
+
+int
+ImageInput::lazy_metadata() const
+{
+    return m_impl->m_lazy_metadata;
+}
+
+
+
 OIIO_NAMESPACE_END
@@ -4,6 +4,7 @@
 
 #include <cstdio>
 #include <cstdlib>
+#include <memory>
 
 #include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
@@ -16,9 +17,11 @@
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
 #include <OpenImageIO/timer.h>
+#include <OpenImageIO/trace.h>
 #include <OpenImageIO/typedesc.h>
 
 #include "imageio_pvt.h"
+#include "simd_kernels_pvt.h"
 
 OIIO_NAMESPACE_BEGIN
 
@@ -38,14 +41,31 @@ recursive_mutex imageio_mutex;
 atomic_int oiio_threads(threads_default());
 atomic_int oiio_exr_threads(threads_default());
 atomic_int oiio_read_chunk(256);
+atomic_int oiio_io_threads(4);
 atomic_int oiio_try_all_readers(1);
 int openexr_core(0);  // Should we use "Exr core C library"?
 int tiff_half(0);
 int tiff_multithread(1);
 int limit_channels(1024);
 int limit_imagesize_MB(32 * 1024);
+int oiio_use_mmap(0);
+int oiio_io_readahead(256 * 1024);
+int oiio_http_blocksize(1 << 20);
+int oiio_http_readahead(4);
+int imagebuf_pool_MB(0);
+int imagebuf_hugepages(0);
+int imagebuf_scratch_MB(0);
+ustring imagebuf_scratch_dir;
+atomic_ll imagebuf_local_mem(0);
+atomic_ll imagebuf_pooled_mem(0);
+atomic_ll deepdata_mem(0);
+atomic_ll imageinput_codec_mem(0);
+atomic_ll colorprocessor_mem(0);
+atomic_ll imageinputs_live(0);
+atomic_ll imageoutputs_live(0);
 ustring font_searchpath;
 ustring plugin_searchpath(OIIO_DEFAULT_PLUGIN_SEARCHPATH);
+ustring spec_cache_dir;
 std::string format_list;         // comma-separated list of all formats
 std::string input_format_list;   // comma-separated list of readable formats
 std::string output_format_list;  // comma-separated list of writable formats
@@ -60,6 +80,7 @@ int oiio_print_debug(oiio_debug_env ? Strutil::stoi(oiio_debug_env) : 1);
 int oiio_log_times = Strutil::from_string<int>(
     Sysutil::getenv("OPENIMAGEIO_LOG_TIMES"));
 std::vector<float> oiio_missingcolor;
+
 }  // namespace pvt
 
 using namespace pvt;
@@ -142,10 +163,29 @@ bool force_global_opts = []() {
     return true;
 }();
 
+
+// Start a trace of the whole run if "OPENIMAGEIO_TRACE" names a file.
+bool force_trace = []() {
+    auto filename = Sysutil::getenv("OPENIMAGEIO_TRACE");
+    if (!filename.empty())
+        Tracing::start(filename);
+    return true;
+}();
+
 }  // namespace
 
 
 
+thread_pool*
+io_thread_pool()
+{
+    static std::unique_ptr<thread_pool> io_pool(
+        new thread_pool(oiio_io_threads));
+    return io_pool.get();
+}
+
+
+
 // Return a comma-separated list of all the important SIMD/capabilities
 // supported by the hardware we're running on right now.
 static std::string
@@ -306,11 +346,53 @@ attribute(string_view name, TypeDesc type, const void* val)
         default_thread_pool()->resize(ot - 1);
         return true;
     }
+    if (name == "io_threads" && type == TypeInt) {
+        int iot         = OIIO::clamp(*(const int*)val, 0, maxthreads);
+        oiio_io_threads = iot;
+        io_thread_pool()->resize(iot);
+        return true;
+    }
+    if (name == "parallel_executor" && type == TypePointer) {
+        default_thread_pool()->set_executor(*(parallel_executor* const*)val);
+        return true;
+    }
     spin_lock lock(attrib_mutex);
     if (name == "read_chunk" && type == TypeInt) {
         oiio_read_chunk = *(const int*)val;
         return true;
     }
+    if (name == "use_mmap" && type == TypeInt) {
+        oiio_use_mmap = *(const int*)val;
+        return true;
+    }
+    if (name == "io_readahead" && type == TypeInt) {
+        oiio_io_readahead = *(const int*)val;
+        return true;
+    }
+    if (name == "http_blocksize" && type == TypeInt) {
+        oiio_http_blocksize = *(const int*)val;
+        return true;
+    }
+    if (name == "http_readahead" && type == TypeInt) {
+        oiio_http_readahead = *(const int*)val;
+        return true;
+    }
+    if (name == "imagebuf:pool_MB" && type == TypeInt) {
+        imagebuf_pool_MB = std::max(*(const int*)val, 0);
+        return true;
+    }
+    if (name == "imagebuf:hugepages" && type == TypeInt) {
+        imagebuf_hugepages = *(const int*)val;
+        return true;
+    }
+    if (name == "imagebuf:scratch_MB" && type == TypeInt) {
+        imagebuf_scratch_MB = std::max(*(const int*)val, 0);
+        return true;
+    }
+    if (name == "imagebuf:scratch_dir" && type == TypeString) {
+        imagebuf_scratch_dir = ustring(*(const char**)val);
+        return true;
+    }
     if (name == "font_searchpath" && type == TypeString) {
         font_searchpath = ustring(*(const char**)val);
         return true;
@@ -319,6 +401,12 @@ attribute(string_view name, TypeDesc type, const void* val)
         plugin_searchpath = ustring(*(const char**)val);
         return true;
     }
+    if (name == "spec_cache" && type == TypeString) {
+        spec_cache_dir = ustring(*(const char**)val);
+        return true;
+    }
+    if (name == "simd_dispatch" && type == TypeString)
+        return pvt::set_simd_dispatch(*(const char**)val);
     if (name == "exr_threads" && type == TypeInt) {
         oiio_exr_threads = OIIO::clamp(*(const int*)val, -1, maxthreads);
         return true;
@@ -351,6 +439,14 @@ attribute(string_view name, TypeDesc type, const void* val)
         oiio_log_times = *(const int*)val;
         return true;
     }
+    if (name == "trace" && type == TypeString) {
+        const char* filename = *(const char**)val;
+        if (filename && filename[0])
+            Tracing::start(filename);
+        else
+            Tracing::stop();
+        return true;
+    }
     if (name == "missingcolor" && type.basetype == TypeDesc::FLOAT) {
         // missingcolor as float array
         oiio_missingcolor.clear();
@@ -383,11 +479,51 @@ getattribute(string_view name, TypeDesc type, void* val)
         *(int*)val = oiio_threads;
         return true;
     }
+    if (name == "io_threads" && type == TypeInt) {
+        *(int*)val = oiio_io_threads;
+        return true;
+    }
+    if (name == "parallel_executor" && type == TypePointer) {
+        *(parallel_executor**)val = default_thread_pool()->executor();
+        return true;
+    }
     spin_lock lock(attrib_mutex);
     if (name == "read_chunk" && type == TypeInt) {
         *(int*)val = oiio_read_chunk;
         return true;
     }
+    if (name == "use_mmap" && type == TypeInt) {
+        *(int*)val = oiio_use_mmap;
+        return true;
+    }
+    if (name == "io_readahead" && type == TypeInt) {
+        *(int*)val = oiio_io_readahead;
+        return true;
+    }
+    if (name == "http_blocksize" && type == TypeInt) {
+        *(int*)val = oiio_http_blocksize;
+        return true;
+    }
+    if (name == "http_readahead" && type == TypeInt) {
+        *(int*)val = oiio_http_readahead;
+        return true;
+    }
+    if (name == "imagebuf:pool_MB" && type == TypeInt) {
+        *(int*)val = imagebuf_pool_MB;
+        return true;
+    }
+    if (name == "imagebuf:hugepages" && type == TypeInt) {
+        *(int*)val = imagebuf_hugepages;
+        return true;
+    }
+    if (name == "imagebuf:scratch_MB" && type == TypeInt) {
+        *(int*)val = imagebuf_scratch_MB;
+        return true;
+    }
+    if (name == "imagebuf:scratch_dir" && type == TypeString) {
+        *(ustring*)val = imagebuf_scratch_dir;
+        return true;
+    }
     if (name == "font_searchpath" && type == TypeString) {
         *(ustring*)val = font_searchpath;
         return true;
@@ -396,6 +532,10 @@ getattribute(string_view name, TypeDesc type, void* val)
         *(ustring*)val = plugin_searchpath;
         return true;
     }
+    if (name == "spec_cache" && type == TypeString) {
+        *(ustring*)val = spec_cache_dir;
+        return true;
+    }
     if (name == "format_list" && type == TypeString) {
         if (format_list.empty())
             pvt::catalog_all_plugins(plugin_searchpath.string());
@@ -450,6 +590,44 @@ getattribute(string_view name, TypeDesc type, void* val)
         *(int*)val = oiio_log_times;
         return true;
     }
+    if (name == "trace" && type == TypeString) {
+        *(ustring*)val = ustring(Tracing::filename());
+        return true;
+    }
+    if (Strutil::starts_with(name, "stat:memory:") && type == TypeInt64) {
+        long long imagebuf = imagebuf_local_mem + imagebuf_pooled_mem;
+        long long metadata = (long long)ParamValue::heap_memory();
+        long long ustrings = (long long)ustring::memory();
+        long long* result  = (long long*)val;
+        if (name == "stat:memory:imagebuf")
+            *result = imagebuf;
+        else if (name == "stat:memory:imagebuf_pool")
+            *result = imagebuf_pooled_mem;
+        else if (name == "stat:memory:deepdata")
+            *result = deepdata_mem;
+        else if (name == "stat:memory:metadata")
+            *result = metadata;
+        else if (name == "stat:memory:ustring")
+            *result = ustrings;
+        else if (name == "stat:memory:imageinput")
+            *result = imageinput_codec_mem;
+        else if (name == "stat:memory:colorprocessor")
+            *result = colorprocessor_mem;
+        else if (name == "stat:memory:total")
+            *result = imagebuf + deepdata_mem + metadata + ustrings
+                      + imageinput_codec_mem + colorprocessor_mem;
+        else
+            return false;
+        return true;
+    }
+    if (name == "stat:imageinputs" && type == TypeInt64) {
+        *(long long*)val = imageinputs_live;
+        return true;
+    }
+    if (name == "stat:imageoutputs" && type == TypeInt64) {
+        *(long long*)val = imageoutputs_live;
+        return true;
+    }
     if (name == "timing_report" && type == TypeString) {
         *(ustring*)val = ustring(timing_log.report());
         return true;
@@ -462,6 +640,10 @@ getattribute(string_view name, TypeDesc type, void* val)
         *(ustring*)val = ustring(oiio_simd_caps());
         return true;
     }
+    if (name == "simd_dispatch" && type == TypeString) {
+        *(ustring*)val = ustring(pvt::simd_kernels().isa);
+        return true;
+    }
     if (name == "resident_memory_used_MB" && type == TypeInt) {
         *(int*)val = int(Sysutil::memory_used(true) >> 20);
         return true;
@@ -586,7 +768,10 @@ pvt::convert_to_float(const void* src, float* dst, int nvals, TypeDesc format)
     case TypeDesc::UINT8:
         convert_type((const unsigned char*)src, dst, nvals);
         break;
-    case TypeDesc::HALF: convert_type((const half*)src, dst, nvals); break;
+    case TypeDesc::HALF:
+        convert_half_to_float(cspan<half>((const half*)src, nvals),
+                              span<float>(dst, nvals));
+        break;
     case TypeDesc::UINT16:
         convert_type((const unsigned short*)src, dst, nvals);
         break;
@@ -625,7 +810,10 @@ pvt::convert_from_float(const float* src, void* dst, size_t nvals,
     case TypeDesc::FLOAT:
         // If it's already float, return the source itself
         return src;
-    case TypeDesc::HALF:   convert_type(src, (half*)    dst, nvals); break;
+    case TypeDesc::HALF:
+        convert_float_to_half(cspan<float>(src, nvals),
+                              span<half>((half*)dst, nvals));
+        break;
     case TypeDesc::UINT8:  convert_type(src, (uint8_t*) dst, nvals); break;
     case TypeDesc::UINT16: convert_type(src, (uint16_t*)dst, nvals); break;
     case TypeDesc::UINT:   convert_type(src, (uint32_t*)dst, nvals); break;
@@ -658,6 +846,163 @@ pvt::parallel_convert_from_float(const float* src, void* dst, size_t nvals,
 
 
 
+// Fill `dither` with the blue noise dither of `npixels` pixels (at most
+// bntable_res) of the scanline (y,z) starting at x, scaled by the
+// amplitude and centered on 0, and 0 for the alpha and z channels. The
+// noise table repeats every bntable_res pixels in x, so this is also the
+// dither of the rest of the scanline, periodically.
+static void
+bluenoise_dither_row(float* dither, int nchannels, int npixels,
+                     float ditheramplitude, int alpha_channel, int z_channel,
+                     unsigned int ditherseed, int chorigin, int x, int y,
+                     int z)
+{
+    for (int i = 0; i < npixels; ++i) {
+        for (int c = 0; c < nchannels; ++c, ++dither) {
+            int channel = c + chorigin;
+            if (channel == alpha_channel || channel == z_channel) {
+                *dither = 0.0f;
+                continue;
+            }
+            float noise = pvt::bluenoise_4chan_ptr(x + i, y, z, channel & (~3),
+                                                   ditherseed)[channel & 3];
+            *dither     = ditheramplitude * (noise - 0.5f);
+        }
+    }
+}
+
+
+
+const void*
+pvt::parallel_convert_from_float_dithered(const float* src, unsigned char* dst,
+                                          int nchannels, int width, int height,
+                                          int depth, float ditheramplitude,
+                                          int alpha_channel, int z_channel,
+                                          unsigned int ditherseed, int xorigin,
+                                          int yorigin, int zorigin)
+{
+    // Each scanline gets one period of dither, which the SIMD kernel adds
+    // as it quantizes, a period at a time.
+    pvt::DitherKernel kernel = pvt::simd_kernels().float_to_uint8_dither;
+    const int period         = std::min(width, pvt::bntable_res);
+    const size_t rowvals     = size_t(width) * nchannels;
+    parallel_for_chunked(0, int64_t(height) * depth, 0, [&](int64_t b,
+                                                            int64_t e) {
+        std::vector<float> dither(size_t(period) * nchannels);
+        for (int64_t r = b; r < e; ++r) {
+            int y = int(r % height), z = int(r / height);
+            bluenoise_dither_row(dither.data(), nchannels, period,
+                                 ditheramplitude, alpha_channel, z_channel,
+                                 ditherseed, 0, xorigin, y + yorigin,
+                                 z + zorigin);
+            for (int x = 0; x < width; x += period) {
+                size_t offset = r * rowvals + size_t(x) * nchannels;
+                kernel(src + offset, dither.data(), dst + offset,
+                       size_t(std::min(period, width - x)) * nchannels);
+            }
+        }
+    });
+    return dst;
+}
+
+
+
+namespace {
+
+// Direct SIMD conversion kernels for the pairs of types that dominate
+// reading and writing images. Each converts `n` contiguous values with
+// results identical to going through convert_to_float/convert_from_float,
+// but without the intermediate float buffer. The kernels themselves are
+// in simd_kernels.cpp, compiled for each ISA level we dispatch among.
+using pvt::ConvertKernel;
+
+// The table of direct kernels, by source and destination base type.
+struct DirectConverter {
+    TypeDesc::BASETYPE src, dst;
+    ConvertKernel pvt::SimdKernels::*kernel;
+};
+
+static constexpr DirectConverter direct_converters[] = {
+    // clang-format off
+    { TypeDesc::UINT8,  TypeDesc::FLOAT,  &pvt::SimdKernels::uint8_to_float },
+    { TypeDesc::UINT16, TypeDesc::FLOAT,  &pvt::SimdKernels::uint16_to_float },
+    { TypeDesc::HALF,   TypeDesc::FLOAT,  &pvt::SimdKernels::half_to_float },
+    { TypeDesc::FLOAT,  TypeDesc::UINT8,  &pvt::SimdKernels::float_to_uint8 },
+    { TypeDesc::FLOAT,  TypeDesc::UINT16, &pvt::SimdKernels::float_to_uint16 },
+    { TypeDesc::FLOAT,  TypeDesc::HALF,   &pvt::SimdKernels::float_to_half },
+    { TypeDesc::UINT8,  TypeDesc::HALF,   &pvt::SimdKernels::uint8_to_half },
+    { TypeDesc::UINT16, TypeDesc::HALF,   &pvt::SimdKernels::uint16_to_half },
+    { TypeDesc::HALF,   TypeDesc::UINT8,  &pvt::SimdKernels::half_to_uint8 },
+    { TypeDesc::HALF,   TypeDesc::UINT16, &pvt::SimdKernels::half_to_uint16 },
+    // clang-format on
+};
+
+
+
+// Return the direct kernel for converting between two scalar types, or
+// nullptr if there isn't one.
+inline ConvertKernel
+direct_converter(TypeDesc src_type, TypeDesc dst_type)
+{
+    if (src_type.aggregate != TypeDesc::SCALAR || src_type.arraylen
+        || dst_type.aggregate != TypeDesc::SCALAR || dst_type.arraylen)
+        return nullptr;
+    for (auto& c : direct_converters)
+        if (c.src == src_type.basetype && c.dst == dst_type.basetype)
+            return pvt::simd_kernels().*c.kernel;
+    return nullptr;
+}
+
+
+
+// Convert a strided run of `width` pixels of `nchannels` each using a
+// direct kernel. Pixels are gathered into a contiguous buffer in batches
+// (unless the source is already contiguous), converted in one call, and
+// scattered to the destination (unless it is contiguous).
+void
+convert_strided_pixels(ConvertKernel kernel, int nchannels, int width,
+                       const char* src, size_t src_size, stride_t src_xstride,
+                       char* dst, size_t dst_size, stride_t dst_xstride)
+{
+    const size_t src_pixelsize = src_size * nchannels;
+    const size_t dst_pixelsize = dst_size * nchannels;
+    const bool src_contig      = src_xstride == stride_t(src_pixelsize);
+    const bool dst_contig      = dst_xstride == stride_t(dst_pixelsize);
+    // Enough for 1024 values of the largest (float) type
+    constexpr size_t bufsize = 4096;
+    alignas(16) char srcbuf[bufsize], dstbuf[bufsize];
+    int batch = std::max(1, int(bufsize / (4 * nchannels)));
+    if (size_t(nchannels) * 4 > bufsize) {
+        // Absurdly many channels -- convert one pixel at a time in place.
+        for (int x = 0; x < width; ++x, src += src_xstride, dst += dst_xstride)
+            kernel(src, dst, nchannels);
+        return;
+    }
+    for (int x = 0; x < width; x += batch) {
+        int npix = std::min(batch, width - x);
+        const char* s = src;
+        if (!src_contig) {
+            for (int i = 0; i < npix; ++i)
+                memcpy(srcbuf + i * src_pixelsize, src + i * src_xstride,
+                       src_pixelsize);
+            s = srcbuf;
+        }
+        char* d = dst_contig ? dst : dstbuf;
+        kernel(s, d, size_t(npix) * nchannels);
+        if (!dst_contig) {
+            for (int i = 0; i < npix; ++i)
+                memcpy(dst + i * dst_xstride, dstbuf + i * dst_pixelsize,
+                       dst_pixelsize);
+        }
+        src += npix * src_xstride;
+        dst += npix * dst_xstride;
+    }
+}
+
+}  // namespace
+
+
+
 bool
 convert_pixel_values(TypeDesc src_type, const void* src, TypeDesc dst_type,
                      void* dst, int n)
@@ -668,6 +1013,12 @@ convert_pixel_values(TypeDesc src_type, const void* src, TypeDesc dst_type,
         return true;
     }
 
+    // The most common pairs have direct kernels that need no temp buffer
+    if (ConvertKernel kernel = direct_converter(src_type, dst_type)) {
+        kernel(src, dst, size_t(n));
+        return true;
+    }
+
     if (dst_type == TypeFloat) {
         // Special case -- converting non-float to float
         pvt::convert_to_float(src, (float*)dst, n, src_type);
@@ -693,7 +1044,9 @@ convert_pixel_values(TypeDesc src_type, const void* src, TypeDesc dst_type,
     switch (dst_type.basetype) {
     case TypeDesc::UINT8: convert_type(buf, (unsigned char*)dst, n); break;
     case TypeDesc::UINT16: convert_type(buf, (unsigned short*)dst, n); break;
-    case TypeDesc::HALF: convert_type(buf, (half*)dst, n); break;
+    case TypeDesc::HALF:
+        convert_float_to_half(cspan<float>(buf, n), span<half>((half*)dst, n));
+        break;
     case TypeDesc::INT8: convert_type(buf, (char*)dst, n); break;
     case TypeDesc::INT16: convert_type(buf, (short*)dst, n); break;
     case TypeDesc::INT: convert_type(buf, (int*)dst, n); break;
@@ -717,6 +1070,7 @@ convert_image(int nchannels, int width, int height, int depth, const void* src,
               stride_t src_zstride, void* dst, TypeDesc dst_type,
               stride_t dst_xstride, stride_t dst_ystride, stride_t dst_zstride)
 {
+    OIIO_TRACE_ZONE("convert_image", "imageio");
     // If no format conversion is taking place, use the simplified
     // copy_image.
     if (src_type == dst_type)
@@ -732,12 +1086,21 @@ convert_image(int nchannels, int width, int height, int depth, const void* src,
     bool result = true;
     bool contig = (src_xstride == stride_t(nchannels * src_type.size())
                    && dst_xstride == stride_t(nchannels * dst_type.size()));
+    ConvertKernel kernel = contig ? nullptr
+                                  : direct_converter(src_type, dst_type);
     for (int z = 0; z < depth; ++z) {
         for (int y = 0; y < height; ++y) {
             const char* f = (const char*)src
                             + (z * src_zstride + y * src_ystride);
             char* t = (char*)dst + (z * dst_zstride + y * dst_ystride);
-            if (contig) {
+            if (kernel) {
+                // Strided pixels (such as a channel subset) of a type pair
+                // with a direct kernel: batch them through it rather than
+                // converting one pixel at a time.
+                convert_strided_pixels(kernel, nchannels, width, f,
+                                       src_type.size(), src_xstride, t,
+                                       dst_type.size(), dst_xstride);
+            } else if (contig) {
                 // Special case: pixels within each row are contiguous
                 // in both src and dst and we're copying all channels.
                 // Be efficient by converting each scanline as a single
@@ -845,23 +1208,29 @@ add_bluenoise(int nchannels, int width, int height, int depth, float* data,
 {
     ImageSpec::auto_stride(xstride, ystride, zstride, sizeof(float), nchannels,
                            width, height);
+    // Look up the noise once per scanline for one period of the table,
+    // rather than once per value.
+    const int period = std::min(width, pvt::bntable_res);
+    std::vector<float> dither(size_t(period) * nchannels);
     char* plane = (char*)data;
     for (int z = 0; z < depth; ++z, plane += zstride) {
         char* scanline = plane;
         for (int y = 0; y < height; ++y, scanline += ystride) {
+            bluenoise_dither_row(dither.data(), nchannels, period,
+                                 ditheramplitude, alpha_channel, z_channel,
+                                 ditherseed, chorigin, xorigin, y + yorigin,
+                                 z + zorigin);
             char* pixel = scanline;
-            for (int x = 0; x < width; ++x, pixel += xstride) {
-                float* val = (float*)pixel;
-                for (int c = 0; c < nchannels; ++c, ++val) {
+            for (int x = 0, i = 0; x < width; ++x, pixel += xstride) {
+                float* val     = (float*)pixel;
+                const float* d = &dither[size_t(i) * nchannels];
+                for (int c = 0; c < nchannels; ++c) {
                     int channel = c + chorigin;
-                    if (channel == alpha_channel || channel == z_channel)
-                        continue;
-                    float dither
-                        = pvt::bluenoise_4chan_ptr(x + xorigin, y + yorigin,
-                                                   z + zorigin, channel & (~3),
-                                                   ditherseed)[channel & 3];
-                    *val += ditheramplitude * (dither - 0.5f);
+                    if (channel != alpha_channel && channel != z_channel)
+                        val[c] += d[c];
                 }
+                if (++i == period)
+                    i = 0;
             }
         }
     }
@@ -916,7 +1285,7 @@ template<typename T>
 static void
 premult_impl(int width, int height, int depth, int chbegin, int chend, T* data,
              stride_t xstride, stride_t ystride, stride_t zstride,
-             int alpha_channel, int z_channel)
+             int alpha_channel, int z_channel, bool divide)
 {
     char* plane = (char*)data;
     for (int z = 0; z < depth; ++z, plane += zstride) {
@@ -926,10 +1295,12 @@ premult_impl(int width, int height, int depth, int chbegin, int chend, T* data,
             for (int x = 0; x < width; ++x, pixel += xstride) {
                 DataArrayProxy<T, float> val((T*)pixel);
                 float alpha = val[alpha_channel];
+                if (divide && (alpha == 0.0f || alpha == 1.0f))
+                    continue;  // unpremult leaves these alone
                 for (int c = chbegin; c < chend; ++c) {
                     if (c == alpha_channel || c == z_channel)
                         continue;
-                    val[c] = alpha * val[c];
+                    val[c] = divide ? val[c] / alpha : alpha * val[c];
                 }
             }
         }
@@ -938,10 +1309,12 @@ premult_impl(int width, int height, int depth, int chbegin, int chend, T* data,
 
 
 
-void
-premult(int nchannels, int width, int height, int depth, int chbegin, int chend,
-        TypeDesc datatype, void* data, stride_t xstride, stride_t ystride,
-        stride_t zstride, int alpha_channel, int z_channel)
+// Shared by premult() and unpremult(), which only differ in `divide`.
+static void
+premult_any(int nchannels, int width, int height, int depth, int chbegin,
+            int chend, TypeDesc datatype, void* data, stride_t xstride,
+            stride_t ystride, stride_t zstride, int alpha_channel,
+            int z_channel, bool divide)
 {
     if (alpha_channel < 0 || alpha_channel > nchannels)
         return;  // nothing to do
@@ -950,48 +1323,55 @@ premult(int nchannels, int width, int height, int depth, int chbegin, int chend,
     switch (datatype.basetype) {
     case TypeDesc::FLOAT:
         premult_impl(width, height, depth, chbegin, chend, (float*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::UINT8:
         premult_impl(width, height, depth, chbegin, chend, (unsigned char*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::UINT16:
         premult_impl(width, height, depth, chbegin, chend,
                      (unsigned short*)data, xstride, ystride, zstride,
-                     alpha_channel, z_channel);
+                     alpha_channel, z_channel, divide);
         break;
     case TypeDesc::HALF:
         premult_impl(width, height, depth, chbegin, chend, (half*)data, xstride,
-                     ystride, zstride, alpha_channel, z_channel);
+                     ystride, zstride, alpha_channel, z_channel, divide);
         break;
     case TypeDesc::INT8:
         premult_impl(width, height, depth, chbegin, chend, (char*)data, xstride,
-                     ystride, zstride, alpha_channel, z_channel);
+                     ystride, zstride, alpha_channel, z_channel, divide);
         break;
     case TypeDesc::INT16:
         premult_impl(width, height, depth, chbegin, chend, (short*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::INT:
         premult_impl(width, height, depth, chbegin, chend, (int*)data, xstride,
-                     ystride, zstride, alpha_channel, z_channel);
+                     ystride, zstride, alpha_channel, z_channel, divide);
         break;
     case TypeDesc::UINT:
         premult_impl(width, height, depth, chbegin, chend, (unsigned int*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::INT64:
         premult_impl(width, height, depth, chbegin, chend, (int64_t*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::UINT64:
         premult_impl(width, height, depth, chbegin, chend, (uint64_t*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     case TypeDesc::DOUBLE:
         premult_impl(width, height, depth, chbegin, chend, (double*)data,
-                     xstride, ystride, zstride, alpha_channel, z_channel);
+                     xstride, ystride, zstride, alpha_channel, z_channel,
+                     divide);
         break;
     default: OIIO_ASSERT(0 && "OIIO::premult() of an unsupported type"); break;
     }
@@ -999,6 +1379,43 @@ premult(int nchannels, int width, int height, int depth, int chbegin, int chend,
 
 
 
+void
+premult(int nchannels, int width, int height, int depth, int chbegin, int chend,
+        TypeDesc datatype, void* data, stride_t xstride, stride_t ystride,
+        stride_t zstride, int alpha_channel, int z_channel)
+{
+    premult_any(nchannels, width, height, depth, chbegin, chend, datatype,
+                data, xstride, ystride, zstride, alpha_channel, z_channel,
+                false);
+}
+
+
+
+void
+unpremult(int nchannels, int width, int height, int depth, int chbegin,
+          int chend, TypeDesc datatype, void* data, stride_t xstride,
+          stride_t ystride, stride_t zstride, int alpha_channel, int z_channel)
+{
+    premult_any(nchannels, width, height, depth, chbegin, chend, datatype,
+                data, xstride, ystride, zstride, alpha_channel, z_channel,
+                true);
+}
+
+
+
+int
+pvt::alpha_conversion(const ImageSpec& spec)
+{
+    string_view hint = spec.get_string_attribute("oiio:AlphaConversion");
+    if (hint == "premult")
+        return 1;
+    if (hint == "unpremult")
+        return -1;
+    return 0;
+}
+
+
+
 bool
 wrap_black(int& coord, int origin, int width)
 {
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <map>
@@ -14,6 +15,7 @@
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/plugin.h>
 #include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
 
 #include "imageio_pvt.h"
 
@@ -48,29 +50,235 @@ static recursive_mutex format_list_vector_mutex;
 // Which plugin names are procedural (not reading from files)
 static std::set<std::string> procedural_plugins;
 
+// What the plugin manifest remembers about one plugin DSO
+struct PluginManifestEntry {
+    std::time_t mtime = 0;
+    uint64_t size     = 0;
+    std::string format_name;
+    bool input = false, output = false, procedural = false;
+    std::vector<std::string> input_extensions;
+    std::vector<std::string> output_extensions;
+    std::vector<std::string> input_signatures;
+    bool has_lib_version = false;
+    std::string lib_version;
+};
+// Map plugin full path to its manifest entry
+static std::map<std::string, PluginManifestEntry> plugin_manifest;
+static bool plugin_manifest_read  = false;
+static bool plugin_manifest_dirty = false;
+// Map format name to full path, for plugins that were catalogued from the
+// manifest but have not yet been opened
+static std::map<std::string, std::string> lazy_plugins;
+// Map format names and extensions to the format name of a plugin that has
+// not yet been opened.
+static std::map<std::string, std::string> lazy_input_formats;
+static std::map<std::string, std::string> lazy_output_formats;
+
+// One "magic number" pattern: the bytes expected at the given offset from
+// the start of the file, with a mask so that wildcard bytes always match.
+struct InputSignature {
+    size_t offset = 0;
+    std::vector<unsigned char> bytes;
+    std::vector<unsigned char> mask;
+    size_t end() const { return offset + bytes.size(); }
+};
+
+// The signatures of one input format
+struct FormatSignatures {
+    std::string format_name;
+    std::vector<InputSignature> signatures;
+};
+
+// All known input format signatures, in the order they were declared
+static std::vector<FormatSignatures> input_signatures;
+// How many leading bytes of a file we need to test all the signatures
+static size_t input_signature_bytes = 0;
+
 static std::string pattern = Strutil::sprintf(".imageio.%s",
                                               Plugin::plugin_extension());
 
 
+template<typename T>
 inline void
-add_if_missing(std::vector<std::string>& vec, const std::string& val)
+add_if_missing(std::vector<T>& vec, const T& val)
 {
     if (std::find(vec.begin(), vec.end(), val) == vec.end())
         vec.push_back(val);
 }
 
-}  // namespace
 
+// Parse a signature pattern of the form "[@offset:]hexbytes", where a
+// "??" in place of a hex byte matches anything.
+static bool
+parse_input_signature(string_view pattern, InputSignature& sig)
+{
+    sig = InputSignature();
+    if (Strutil::parse_char(pattern, '@')) {
+        int offset = 0;
+        if (!Strutil::parse_int(pattern, offset) || offset < 0
+            || !Strutil::parse_char(pattern, ':'))
+            return false;
+        sig.offset = size_t(offset);
+    }
+    Strutil::skip_whitespace(pattern);
+    auto hexval = [](char c) -> int {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    };
+    for (; pattern.size() >= 2; pattern.remove_prefix(2)) {
+        if (pattern[0] == '?' && pattern[1] == '?') {
+            sig.bytes.push_back(0);
+            sig.mask.push_back(0);
+            continue;
+        }
+        int hi = hexval(pattern[0]), lo = hexval(pattern[1]);
+        if (hi < 0 || lo < 0)
+            return false;
+        sig.bytes.push_back((unsigned char)(hi * 16 + lo));
+        sig.mask.push_back(0xff);
+    }
+    return pattern.empty() && !sig.bytes.empty();
+}
 
 
-/// Register the input and output 'create' routine and list of file
-/// extensions for a particular format.
-void
-declare_imageio_format(const std::string& format_name,
-                       ImageInput::Creator input_creator,
-                       const char** input_extensions,
-                       ImageOutput::Creator output_creator,
-                       const char** output_extensions, const char* lib_version)
+
+// Return true if the file header matches the signature.
+static bool
+match_input_signature(const InputSignature& sig, cspan<unsigned char> header)
+{
+    if (sig.end() > size_t(header.size()))
+        return false;
+    for (size_t i = 0, n = sig.bytes.size(); i < n; ++i)
+        if ((header[sig.offset + i] & sig.mask[i]) != sig.bytes[i])
+            return false;
+    return true;
+}
+
+
+
+// Number of non-wildcard bytes in the signature, used to prefer the more
+// specific of several matching formats.
+static size_t
+input_signature_strength(const InputSignature& sig)
+{
+    return std::count(sig.mask.begin(), sig.mask.end(), 0xff);
+}
+
+
+
+/// Register the list of magic byte signatures for an input format. The
+/// list is terminated by a nullptr. Malformed patterns are ignored, and so
+/// is a second list for the same format.
+static void
+declare_input_signatures(const std::string& format_name,
+                         const char** signatures)
+{
+    if (!signatures || !*signatures)
+        return;
+    recursive_lock_guard lock(pvt::imageio_mutex);
+    for (auto& fsigs : input_signatures)
+        if (fsigs.format_name == format_name)
+            return;
+    FormatSignatures fsigs;
+    fsigs.format_name = format_name;
+    for (const char** s = signatures; *s; ++s) {
+        InputSignature sig;
+        if (parse_input_signature(*s, sig)) {
+            input_signature_bytes = std::max(input_signature_bytes, sig.end());
+            fsigs.signatures.push_back(std::move(sig));
+        } else {
+            OIIO::debugfmt("Invalid {} input signature \"{}\"\n",
+                           format_name, *s);
+        }
+    }
+    if (fsigs.signatures.size())
+        input_signatures.push_back(std::move(fsigs));
+}
+
+
+
+// Read the first bytes of the file, just enough to check all the known
+// signatures. Return false if the file could not be read at all.
+static bool
+read_signature_header(string_view filename, Filesystem::IOProxy* ioproxy,
+                      std::vector<unsigned char>& header)
+{
+    header.resize(input_signature_bytes);
+    if (header.empty())
+        return false;
+    std::unique_ptr<Filesystem::IOProxy> local;
+    if (!ioproxy) {
+        local.reset(pvt::create_read_ioproxy(filename));
+        ioproxy = local.get();
+    }
+    if (ioproxy->mode() != Filesystem::IOProxy::Read)
+        return false;
+    size_t n = ioproxy->pread(header.data(), header.size(), 0);
+    header.resize(n);
+    return n > 0;
+}
+
+
+
+// Given the first bytes of a file, return the names of all the formats
+// whose signatures match, most specific match first. Also return in
+// `nonmatching` the names of formats that have signatures but did not
+// match, and so need not be tried at all.
+static std::vector<std::string>
+sniff_input_formats(cspan<unsigned char> header,
+                    std::vector<std::string>& nonmatching)
+{
+    std::vector<std::pair<size_t, std::string>> matches;
+    recursive_lock_guard lock(pvt::imageio_mutex);
+    for (auto& fsigs : input_signatures) {
+        size_t strength = 0;
+        for (auto& sig : fsigs.signatures)
+            if (match_input_signature(sig, header))
+                strength = std::max(strength, input_signature_strength(sig));
+        if (strength)
+            matches.emplace_back(strength, fsigs.format_name);
+        else
+            nonmatching.push_back(fsigs.format_name);
+    }
+    std::stable_sort(matches.begin(), matches.end(),
+                     [](const auto& a, const auto& b) {
+                         return a.first > b.first;
+                     });
+    std::vector<std::string> names;
+    for (auto& m : matches)
+        add_if_missing(names, m.second);
+    return names;
+}
+
+// Can format_name claim the extension (or format name) `ext` in `formats`,
+// i.e., has no other format, loaded or not, already done so?
+template<class PluginMap>
+static bool
+can_claim(const PluginMap& formats,
+          const std::map<std::string, std::string>& lazy_formats,
+          const std::string& ext, const std::string& format_name)
+{
+    if (formats.find(ext) != formats.end())
+        return false;
+    auto lazy = lazy_formats.find(ext);
+    return lazy == lazy_formats.end() || lazy->second == format_name;
+}
+
+
+
+// Add the creators for a format to the lookup maps, under its name and
+// its extensions. Return the extensions it was the first to claim.
+static std::vector<std::string>
+register_imageio_format(const std::string& format_name,
+                        ImageInput::Creator input_creator,
+                        const char** input_extensions,
+                        ImageOutput::Creator output_creator,
+                        const char** output_extensions)
 {
     std::vector<std::string> all_extensions;
     // Look for input creator and list of supported extensions
@@ -78,12 +286,14 @@ declare_imageio_format(const std::string& format_name,
         for (const char** e = input_extensions; e && *e; ++e) {
             std::string ext(*e);
             Strutil::to_lower(ext);
-            if (input_formats.find(ext) == input_formats.end()) {
+            if (can_claim(input_formats, lazy_input_formats, ext,
+                          format_name)) {
                 input_formats[ext] = input_creator;
                 add_if_missing(all_extensions, ext);
             }
         }
-        if (input_formats.find(format_name) == input_formats.end())
+        if (can_claim(input_formats, lazy_input_formats, format_name,
+                      format_name))
             input_formats[format_name] = input_creator;
     }
 
@@ -92,17 +302,28 @@ declare_imageio_format(const std::string& format_name,
         for (const char** e = output_extensions; e && *e; ++e) {
             std::string ext(*e);
             Strutil::to_lower(ext);
-            if (output_formats.find(ext) == output_formats.end()) {
+            if (can_claim(output_formats, lazy_output_formats, ext,
+                          format_name)) {
                 output_formats[ext] = output_creator;
                 add_if_missing(all_extensions, ext);
             }
         }
-        if (output_formats.find(format_name) == output_formats.end())
+        if (can_claim(output_formats, lazy_output_formats, format_name,
+                      format_name))
             output_formats[format_name] = output_creator;
     }
+    return all_extensions;
+}
+
 
-    // Add the name to the master list of format_names, and extensions to
-    // their master list.
+
+// Add the name to the master list of format_names, and extensions to
+// their master list.
+static void
+add_to_format_lists(const std::string& format_name, bool input, bool output,
+                    const std::vector<std::string>& all_extensions,
+                    const char* lib_version)
+{
     {
         recursive_lock_guard lock(format_list_vector_mutex);
         format_list_vector.emplace_back(Strutil::lower(format_name));
@@ -111,12 +332,12 @@ declare_imageio_format(const std::string& format_name,
     if (format_list.length())
         format_list += std::string(",");
     format_list += format_name;
-    if (input_creator) {
+    if (input) {
         if (input_format_list.length())
             input_format_list += std::string(",");
         input_format_list += format_name;
     }
-    if (output_creator) {
+    if (output) {
         if (output_format_list.length())
             output_format_list += std::string(",");
         output_format_list += format_name;
@@ -134,6 +355,29 @@ declare_imageio_format(const std::string& format_name,
     }
 }
 
+}  // namespace
+
+
+
+/// Register the input and output 'create' routine and list of file
+/// extensions for a particular format.
+void
+declare_imageio_format(const std::string& format_name,
+                       ImageInput::Creator input_creator,
+                       const char** input_extensions,
+                       ImageOutput::Creator output_creator,
+                       const char** output_extensions, const char* lib_version)
+{
+    recursive_lock_guard lock(pvt::imageio_mutex);
+    std::vector<std::string> all_extensions
+        = register_imageio_format(format_name, input_creator,
+                                  input_extensions, output_creator,
+                                  output_extensions);
+    add_to_format_lists(format_name, input_creator != nullptr,
+                        output_creator != nullptr, all_extensions,
+                        lib_version);
+}
+
 
 
 bool
@@ -152,29 +396,175 @@ is_imageio_format_name(string_view name)
 
 
 
+namespace {
+
+// The plugin manifest is a small text file cached between runs, with one
+// line for each plugin DSO we've seen: its path, modification time and
+// size, and the format name, extensions, and signatures it declares. A
+// plugin whose file still matches its manifest entry is catalogued from
+// that entry and not opened until one of its formats is actually needed.
+//
+// The manifest lives in $OIIO_PLUGIN_MANIFEST if set ("0" disables it),
+// otherwise in the user's cache directory.
+
+static const int manifest_fields = 10;
+
+static std::string
+manifest_header()
+{
+    return Strutil::fmt::format("# OpenImageIO {} plugin manifest {}",
+                                OIIO_VERSION_STRING, OIIO_PLUGIN_VERSION);
+}
+
+
+
+static std::string
+plugin_manifest_path()
+{
+    std::string path = Sysutil::getenv("OIIO_PLUGIN_MANIFEST");
+    if (path == "0")
+        return std::string();
+    if (path.size())
+        return path;
+#ifdef _WIN32
+    std::string cachedir = Sysutil::getenv("LOCALAPPDATA");
+#else
+    std::string cachedir = Sysutil::getenv("XDG_CACHE_HOME");
+    if (cachedir.empty() && Sysutil::getenv("HOME").size())
+        cachedir = std::string(Sysutil::getenv("HOME")) + "/.cache";
+#endif
+    if (cachedir.empty())
+        return std::string();
+    return Strutil::fmt::format("{}/OpenImageIO/plugins-{}.manifest",
+                                cachedir, OIIO_VERSION_STRING);
+}
+
+
+
+// Strip characters that would break the manifest's line structure.
+static std::string
+manifest_field(string_view s)
+{
+    std::string f(s);
+    std::replace(f.begin(), f.end(), '\t', ' ');
+    std::replace(f.begin(), f.end(), '\n', ' ');
+    std::replace(f.begin(), f.end(), '\r', ' ');
+    return f;
+}
+
+
+
+static std::vector<std::string>
+manifest_list(string_view field)
+{
+    std::vector<std::string> list;
+    for (auto&& item : Strutil::splitsv(field, ","))
+        if (item.size())
+            list.emplace_back(item);
+    return list;
+}
+
+
+
 static void
-catalog_plugin(const std::string& format_name,
-               const std::string& plugin_fullpath)
+read_plugin_manifest()
 {
-    // Remember the plugin
-    std::map<std::string, std::string>::const_iterator found_path;
-    found_path = plugin_filepaths.find(format_name);
-    if (found_path != plugin_filepaths.end()) {
-        // Hey, we already have an entry for this format
-        if (found_path->second == plugin_fullpath) {
-            // It's ok if they're both the same file; just skip it.
-            return;
-        }
-        OIIO::debugf("OpenImageIO WARNING: %s had multiple plugins:\n"
-                     "\t\"%s\"\n    as well as\n\t\"%s\"\n"
-                     "    Ignoring all but the first one.\n",
-                     format_name, found_path->second, plugin_fullpath);
+    if (plugin_manifest_read)
+        return;
+    plugin_manifest_read = true;
+    std::string path = plugin_manifest_path();
+    std::string text;
+    if (path.empty() || !Filesystem::read_text_file(path, text))
+        return;
+    auto lines = Strutil::splitsv(text, "\n");
+    if (lines.empty() || lines[0] != manifest_header())
+        return;
+    for (size_t i = 1; i < lines.size(); ++i) {
+        auto fields = Strutil::splitsv(lines[i], "\t");
+        if (fields.size() != manifest_fields)
+            continue;
+        PluginManifestEntry entry;
+        entry.mtime = std::time_t(Strutil::from_string<int64_t>(fields[1]));
+        entry.size  = Strutil::from_string<uint64_t>(fields[2]);
+        entry.format_name       = fields[3];
+        entry.input             = fields[4].find('i') != string_view::npos;
+        entry.output            = fields[4].find('o') != string_view::npos;
+        entry.procedural        = fields[4].find('p') != string_view::npos;
+        entry.input_extensions  = manifest_list(fields[5]);
+        entry.output_extensions = manifest_list(fields[6]);
+        entry.input_signatures  = manifest_list(fields[7]);
+        entry.has_lib_version   = fields[8] == "1";
+        entry.lib_version       = fields[9];
+        plugin_manifest[fields[0]] = std::move(entry);
+    }
+}
+
+
+
+static void
+write_plugin_manifest()
+{
+    plugin_manifest_dirty = false;
+    std::string path = plugin_manifest_path();
+    if (path.empty())
         return;
+    std::string text = manifest_header() + "\n";
+    for (auto&& p : plugin_manifest) {
+        const PluginManifestEntry& e(p.second);
+        std::string flags = Strutil::fmt::format("{}{}{}", e.input ? "i" : "",
+                                                 e.output ? "o" : "",
+                                                 e.procedural ? "p" : "");
+        text += Strutil::fmt::format(
+            "{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+            manifest_field(p.first), int64_t(e.mtime), e.size,
+            manifest_field(e.format_name), flags,
+            Strutil::join(e.input_extensions, ","),
+            Strutil::join(e.output_extensions, ","),
+            Strutil::join(e.input_signatures, ","), e.has_lib_version ? 1 : 0,
+            manifest_field(e.lib_version));
+    }
+    // Write to a temporary file and rename it into place, so that other
+    // processes never see a partially written manifest.
+    std::string dir = Filesystem::parent_path(path);
+    std::string err;
+    if (dir.size() && !Filesystem::is_directory(dir)) {
+        Filesystem::create_directory(Filesystem::parent_path(dir), err);
+        Filesystem::create_directory(dir, err);
     }
+    std::string tmp = path + "." + Filesystem::unique_path("%%%%%%%%");
+    if (!Filesystem::write_text_file(tmp, text)
+        || !Filesystem::rename(tmp, path, err)) {
+        Filesystem::remove(tmp, err);
+        OIIO::debugfmt("Could not write plugin manifest \"{}\"\n", path);
+    }
+}
 
+
+
+// Copy a nullptr-terminated list of strings.
+static std::vector<std::string>
+string_list(const char** list)
+{
+    std::vector<std::string> v;
+    for (const char** s = list; s && *s; ++s)
+        v.emplace_back(*s);
+    return v;
+}
+
+
+
+// Open a plugin DSO and register what it provides. If `from_manifest` is
+// true, the format was already catalogued from the manifest, so only the
+// creators need to be added to the lookup maps. Otherwise, it is declared
+// just like a built-in format and its manifest entry is updated. Return
+// false if this isn't a usable plugin.
+static bool
+load_plugin(const std::string& format_name, const std::string& plugin_fullpath,
+            bool from_manifest)
+{
     Plugin::Handle handle = Plugin::open(plugin_fullpath);
     if (!handle) {
-        return;
+        return false;
     }
 
     std::string version_function = format_name + "_imageio_version";
@@ -182,7 +572,7 @@ catalog_plugin(const std::string& format_name,
                                                version_function.c_str());
     if (!plugin_version || *plugin_version != OIIO_PLUGIN_VERSION) {
         Plugin::close(handle);
-        return;
+        return false;
     }
 
     std::string lib_version_function = format_name + "_imageio_library_version";
@@ -204,18 +594,216 @@ catalog_plugin(const std::string& format_name,
     const char** output_extensions
         = (const char**)Plugin::getsym(handle,
                                        format_name + "_output_extensions");
+    // Signatures are optional, so don't report an error if they're missing
+    const char** input_signatures
+        = (const char**)Plugin::getsym(handle,
+                                       format_name + "_input_signatures",
+                                       false);
 
-    if (input_creator || output_creator)
-        declare_imageio_format(format_name, input_creator, input_extensions,
-                               output_creator, output_extensions,
-                               plugin_lib_version ? plugin_lib_version()
-                                                  : NULL);
-    else
+    if (!input_creator && !output_creator) {
         Plugin::close(handle);  // not useful
+        return false;
+    }
+
+    if (from_manifest) {
+        register_imageio_format(format_name, input_creator, input_extensions,
+                                output_creator, output_extensions);
+        return true;
+    }
+
+    const char* lib_version = plugin_lib_version ? plugin_lib_version()
+                                                 : NULL;
+    declare_imageio_format(format_name, input_creator, input_extensions,
+                           output_creator, output_extensions, lib_version);
+    if (input_creator)
+        declare_input_signatures(format_name, input_signatures);
+
+    // Remember what we learned, so next time we needn't open the plugin
+    // until it's needed.
+    if (plugin_manifest_path().size()) {
+        PluginManifestEntry entry;
+        entry.mtime             = Filesystem::last_write_time(plugin_fullpath);
+        entry.size              = Filesystem::file_size(plugin_fullpath);
+        entry.format_name       = format_name;
+        entry.input             = input_creator != nullptr;
+        entry.output            = output_creator != nullptr;
+        entry.input_extensions  = string_list(input_extensions);
+        entry.output_extensions = string_list(output_extensions);
+        entry.input_signatures  = string_list(input_signatures);
+        entry.has_lib_version   = lib_version != nullptr;
+        entry.lib_version       = lib_version ? lib_version : "";
+        if (input_creator) {
+            try {
+                std::unique_ptr<ImageInput> in(input_creator());
+                entry.procedural = in && in->supports("procedural");
+            } catch (...) {
+                // Safety in case the ctr throws an exception
+            }
+        }
+        plugin_manifest[plugin_fullpath] = std::move(entry);
+        plugin_manifest_dirty            = true;
+    }
+    return true;
+}
+
+
+
+// Catalog a plugin from its manifest entry without opening it, if the
+// entry exists and the file hasn't changed since. Return true on success.
+static bool
+catalog_plugin_from_manifest(const std::string& format_name,
+                             const std::string& plugin_fullpath)
+{
+    read_plugin_manifest();
+    auto found = plugin_manifest.find(plugin_fullpath);
+    if (found == plugin_manifest.end())
+        return false;
+    const PluginManifestEntry& entry(found->second);
+    if (entry.format_name != format_name
+        || entry.mtime != Filesystem::last_write_time(plugin_fullpath)
+        || entry.size != Filesystem::file_size(plugin_fullpath))
+        return false;
+
+    plugin_filepaths[format_name] = plugin_fullpath;
+    lazy_plugins[format_name]     = plugin_fullpath;
+    std::vector<std::string> all_extensions;
+    if (entry.input) {
+        for (auto ext : entry.input_extensions) {
+            Strutil::to_lower(ext);
+            if (can_claim(input_formats, lazy_input_formats, ext,
+                          format_name)) {
+                lazy_input_formats[ext] = format_name;
+                add_if_missing(all_extensions, ext);
+                if (entry.procedural)
+                    procedural_plugins.insert(ext);
+            }
+        }
+        if (can_claim(input_formats, lazy_input_formats, format_name,
+                      format_name)) {
+            lazy_input_formats[format_name] = format_name;
+            if (entry.procedural)
+                procedural_plugins.insert(format_name);
+        }
+        std::vector<const char*> sigs;
+        for (auto&& sig : entry.input_signatures)
+            sigs.push_back(sig.c_str());
+        sigs.push_back(nullptr);
+        declare_input_signatures(format_name, sigs.data());
+    }
+    if (entry.output) {
+        for (auto ext : entry.output_extensions) {
+            Strutil::to_lower(ext);
+            if (can_claim(output_formats, lazy_output_formats, ext,
+                          format_name)) {
+                lazy_output_formats[ext] = format_name;
+                add_if_missing(all_extensions, ext);
+            }
+        }
+        if (can_claim(output_formats, lazy_output_formats, format_name,
+                      format_name))
+            lazy_output_formats[format_name] = format_name;
+    }
+    add_to_format_lists(format_name, entry.input, entry.output,
+                        all_extensions,
+                        entry.has_lib_version ? entry.lib_version.c_str()
+                                              : nullptr);
+    return true;
+}
+
+
+
+// If the named format was catalogued from the manifest but its plugin not
+// yet opened, open it now.
+static void
+load_lazy_plugin(const std::string& format_name)
+{
+    auto lazy = lazy_plugins.find(format_name);
+    if (lazy == lazy_plugins.end())
+        return;
+    std::string plugin_fullpath = lazy->second;
+    lazy_plugins.erase(lazy);
+    if (!load_plugin(format_name, plugin_fullpath, true)) {
+        // The manifest was wrong about this one; forget it so that it
+        // gets a fresh look next time.
+        plugin_manifest.erase(plugin_fullpath);
+        write_plugin_manifest();
+    }
+}
+
+
+
+// Open every plugin that was catalogued from the manifest, except those
+// named in `except`.
+static void
+load_all_lazy_plugins(const std::vector<std::string>& except = {})
+{
+    std::vector<std::string> names;
+    for (auto&& lazy : lazy_plugins)
+        if (std::find(except.begin(), except.end(), lazy.first)
+            == except.end())
+            names.push_back(lazy.first);
+    for (auto&& name : names)
+        load_lazy_plugin(name);
 }
 
 
 
+// Find the input creator for an extension or format name, opening its
+// plugin first if needed. The caller must hold imageio_mutex.
+static ImageInput::Creator
+find_input_creator(const std::string& name)
+{
+    auto lazy = lazy_input_formats.find(name);
+    if (lazy != lazy_input_formats.end())
+        load_lazy_plugin(lazy->second);
+    auto found = input_formats.find(name);
+    return found != input_formats.end() ? found->second : nullptr;
+}
+
+
+
+// Find the output creator for an extension or format name, opening its
+// plugin first if needed. The caller must hold imageio_mutex.
+static ImageOutput::Creator
+find_output_creator(const std::string& name)
+{
+    auto lazy = lazy_output_formats.find(name);
+    if (lazy != lazy_output_formats.end())
+        load_lazy_plugin(lazy->second);
+    auto found = output_formats.find(name);
+    return found != output_formats.end() ? found->second : nullptr;
+}
+
+
+
+static void
+catalog_plugin(const std::string& format_name,
+               const std::string& plugin_fullpath)
+{
+    // Remember the plugin
+    std::map<std::string, std::string>::const_iterator found_path;
+    found_path = plugin_filepaths.find(format_name);
+    if (found_path != plugin_filepaths.end()) {
+        // Hey, we already have an entry for this format
+        if (found_path->second == plugin_fullpath) {
+            // It's ok if they're both the same file; just skip it.
+            return;
+        }
+        OIIO::debugf("OpenImageIO WARNING: %s had multiple plugins:\n"
+                     "\t\"%s\"\n    as well as\n\t\"%s\"\n"
+                     "    Ignoring all but the first one.\n",
+                     format_name, found_path->second, plugin_fullpath);
+        return;
+    }
+
+    if (!catalog_plugin_from_manifest(format_name, plugin_fullpath))
+        load_plugin(format_name, plugin_fullpath, false);
+}
+
+}  // namespace
+
+
+
 #ifdef EMBED_PLUGINS
 
 // Make extern declarations for the input and output create routines and
@@ -227,10 +815,12 @@ catalog_plugin(const std::string& format_name,
         ImageOutput* name##_output_imageio_create();   \
         extern const char* name##_output_extensions[]; \
         extern const char* name##_input_extensions[];  \
+        extern const char* name##_input_signatures[];  \
         extern const char* name##_imageio_library_version();
 #    define PLUGENTRY_RO(name)                        \
         ImageInput* name##_input_imageio_create();    \
         extern const char* name##_input_extensions[]; \
+        extern const char* name##_input_signatures[]; \
         extern const char* name##_imageio_library_version();
 #    define PLUGENTRY_WO(name)                         \
         ImageOutput* name##_output_imageio_create();   \
@@ -290,12 +880,14 @@ catalog_builtin_plugins()
             #name, (ImageInput::Creator)name##_input_imageio_create,     \
             name##_input_extensions,                                     \
             (ImageOutput::Creator)name##_output_imageio_create,          \
-            name##_output_extensions, name##_imageio_library_version())
+            name##_output_extensions, name##_imageio_library_version()), \
+        declare_input_signatures(#name, name##_input_signatures)
 #define DECLAREPLUG_RO(name)                                             \
         declare_imageio_format(                                          \
             #name, (ImageInput::Creator)name##_input_imageio_create,     \
             name##_input_extensions, nullptr, nullptr,                   \
-            name##_imageio_library_version())
+            name##_imageio_library_version()),                           \
+        declare_input_signatures(#name, name##_input_signatures)
 #define DECLAREPLUG_WO(name)                                             \
         declare_imageio_format(                                          \
             #name, nullptr, nullptr,                                     \
@@ -477,8 +1069,11 @@ pvt::catalog_all_plugins(std::string searchpath)
             }
         }
     }
+    if (plugin_manifest_dirty)
+        write_plugin_manifest();
 
-    // Inventory the procedural plugins
+    // Inventory the procedural plugins. Those catalogued from the manifest
+    // were already noted, and aren't in input_formats until they're opened.
     for (auto&& f : input_formats) {
         auto inp = ImageInput::create(f.first);
         if (inp->supports("procedural"))
@@ -524,17 +1119,15 @@ ImageOutput::create(string_view filename, Filesystem::IOProxy* ioproxy,
         // See if it's already in the table.  If not, scan all plugins we can
         // find to populate the table.
         Strutil::to_lower(format);
-        OutputPluginMap::const_iterator found = output_formats.find(format);
-        if (found == output_formats.end()) {
+        create_function = find_output_creator(format);
+        if (!create_function) {
             catalog_all_plugins(plugin_searchpath.size()
                                     ? plugin_searchpath
                                     : string_view(pvt::plugin_searchpath));
-            found = output_formats.find(format);
+            create_function = find_output_creator(format);
         }
-        if (found != output_formats.end()) {
-            create_function = found->second;
-        } else {
-            if (output_formats.empty()) {
+        if (!create_function) {
+            if (output_formats.empty() && lazy_output_formats.empty()) {
                 // This error is so fundamental, we echo it to stderr in
                 // case the app is too dumb to do so.
                 const char* msg
@@ -658,20 +1251,21 @@ ImageInput::create(string_view filename, bool do_open, const ImageSpec* config,
         // See if it's already in the table.  If not, scan all plugins we can
         // find to populate the table.
         Strutil::to_lower(format);
-        InputPluginMap::const_iterator found = input_formats.find(format);
-        if (found == input_formats.end()) {
+        create_function = find_input_creator(format);
+        if (!create_function) {
             if (plugin_searchpath.empty())
                 plugin_searchpath = pvt::plugin_searchpath;
             catalog_all_plugins(plugin_searchpath);
-            found = input_formats.find(format);
+            create_function = find_input_creator(format);
         }
-        if (found != input_formats.end())
-            create_function = found->second;
     }
 
     // Remember which prototypes we've already tried, so we don't double dip.
     std::vector<ImageInput::Creator> formats_tried;
 
+    // Formats whose signatures don't match the file, if we checked.
+    std::vector<std::string> nonmatching_formats;
+
     std::string specific_error;
     if (create_function && filename != format) {
         // If given a full filename, double-check that our guess
@@ -711,6 +1305,53 @@ ImageInput::create(string_view filename, bool do_open, const ImageSpec* config,
         in.reset();
     }
 
+    if (!create_function && pvt::oiio_try_all_readers && filename != format) {
+        // Before resorting to trying every reader, look at the first few
+        // bytes of the file and try only the formats whose signature
+        // matches. Formats that declare signatures but don't match need
+        // not be tried again below.
+        std::vector<unsigned char> header;
+        std::vector<std::string> matching;
+        if (read_signature_header(filename_stripped, ioproxy, header))
+            matching = sniff_input_formats(header, nonmatching_formats);
+        for (auto&& name : matching) {
+            ImageInput::Creator creator = nullptr;
+            {
+                recursive_lock_guard lock(imageio_mutex);
+                creator = find_input_creator(name);
+            }
+            if (!creator
+                || std::find(formats_tried.begin(), formats_tried.end(),
+                             creator)
+                       != formats_tried.end())
+                continue;
+            formats_tried.push_back(creator);
+            try {
+                in = std::unique_ptr<ImageInput>(creator());
+            } catch (...) {
+                // Safety in case the ctr throws an exception
+            }
+            if (!in)
+                continue;
+            if (!do_open && !ioproxy && in->valid_file(filename))
+                return in;
+            ImageSpec tmpspec;
+            in->set_ioproxy(ioproxy);
+            bool ok = config ? in->open(filename, tmpspec, *config)
+                             : in->open(filename, tmpspec);
+            if (ok) {
+                if (!do_open)
+                    in->close();
+                return in;
+            }
+            // The file looked like this format but didn't open. That's a
+            // more useful error than "no reader found".
+            if (specific_error.empty())
+                specific_error = in->geterror();
+            in.reset();
+        }
+    }
+
     if (!create_function && pvt::oiio_try_all_readers) {
         // If a plugin can't be found that was explicitly designated for
         // this extension, then just try every one we find and see if
@@ -723,6 +1364,15 @@ ImageInput::create(string_view filename, bool do_open, const ImageSpec* config,
             myconfig = *config;
         myconfig.attribute("nowait", (int)1);
         recursive_lock_guard lock(imageio_mutex);  // Ensure thread safety
+        // Plugins not yet opened need to be now, except the ones we know
+        // won't match. Formats already loaded whose signatures didn't
+        // match are skipped, too.
+        load_all_lazy_plugins(nonmatching_formats);
+        for (auto&& name : nonmatching_formats) {
+            auto found = input_formats.find(name);
+            if (found != input_formats.end())
+                add_if_missing(formats_tried, found->second);
+        }
         for (auto&& plugin : input_formats) {
             // If we already tried this create function, don't do it again
             if (std::find(formats_tried.begin(), formats_tried.end(),
@@ -761,7 +1411,7 @@ ImageInput::create(string_view filename, bool do_open, const ImageSpec* config,
 
     if (!create_function) {
         recursive_lock_guard lock(imageio_mutex);  // Ensure thread safety
-        if (input_formats.empty()) {
+        if (input_formats.empty() && lazy_input_formats.empty()) {
             // This error is so fundamental, we echo it to stderr in
             // case the app is too dumb to do so.
             const char* msg
@@ -5,6 +5,7 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <deque>
 #include <iostream>
 #include <memory>
 #include <vector>
@@ -17,6 +18,7 @@
 #include <OpenImageIO/plugin.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/thread.h>
+#include <OpenImageIO/trace.h>
 #include <OpenImageIO/typedesc.h>
 
 #include "imageio_pvt.h"
@@ -78,11 +80,12 @@ ImageOutput::operator delete(void* ptr)
 ImageOutput::ImageOutput()
     : m_impl(new Impl, impl_deleter)
 {
+    ++pvt::imageoutputs_live;
 }
 
 
 
-ImageOutput::~ImageOutput() {}
+ImageOutput::~ImageOutput() { --pvt::imageoutputs_live; }
 
 
 
@@ -101,6 +104,7 @@ ImageOutput::write_scanlines(int ybegin, int yend, int z, TypeDesc format,
                              const void* data, stride_t xstride,
                              stride_t ystride)
 {
+    OIIO_TRACE_ZONE("ImageOutput::write_scanlines", "imageio", format_name());
     // Default implementation: write each scanline individually
     stride_t native_pixel_bytes = (stride_t)m_spec.pixel_bytes(true);
     if (format == TypeDesc::UNKNOWN && xstride == AutoStride)
@@ -134,6 +138,7 @@ ImageOutput::write_tiles(int xbegin, int xend, int ybegin, int yend, int zbegin,
                          int zend, TypeDesc format, const void* data,
                          stride_t xstride, stride_t ystride, stride_t zstride)
 {
+    OIIO_TRACE_ZONE("ImageOutput::write_tiles", "imageio", format_name());
     if (!m_spec.valid_tile_range(xbegin, xend, ybegin, yend, zbegin, zend))
         return false;
 
@@ -357,7 +362,13 @@ ImageOutput::to_native_rectangle(int xbegin, int xend, int ybegin, int yend,
     contiguous &= ((ystride == xstride * width || height == 1)
                    && (zstride == ystride * height || depth == 1));
 
-    if (native_data && contiguous) {
+    // Alpha conversion asked for by the "oiio:AlphaConversion" hint is
+    // done to the float intermediate, so it needs us to take that path.
+    int alphaconvert = 0;
+    if (m_spec.alpha_channel >= 0 && m_spec.alpha_channel < m_spec.nchannels)
+        alphaconvert = pvt::alpha_conversion(m_spec);
+
+    if (native_data && contiguous && !alphaconvert) {
         // Data are already in the native format and contiguous
         // just return a ptr to the original data.
         return data;
@@ -378,6 +389,7 @@ ImageOutput::to_native_rectangle(int xbegin, int xend, int ybegin, int yend,
     // Handle the per-channel format case (#2) where the user is passing
     // a non-native buffer.
     if (perchanfile) {
+        // N.B. No alpha conversion here.
         OIIO_DASSERT(
             (contiguous || !native_data)
             && "Per-channel native output requires contiguous strides");
@@ -420,7 +432,7 @@ ImageOutput::to_native_rectangle(int xbegin, int xend, int ybegin, int yend,
     // contiguous, but it was in the correct native data format all along,
     // we can return the contiguized data without needing unnecessary
     // conversion into float and back.
-    if (native_data) {
+    if (native_data && !alphaconvert) {
         return data;
     }
 
@@ -429,12 +441,12 @@ ImageOutput::to_native_rectangle(int xbegin, int xend, int ybegin, int yend,
     // will always preserve enough precision.
     const float* buf;
     if (format == TypeDesc::FLOAT) {
-        if (!do_dither) {
-            // Already in float format and no dither -- leave it as-is.
+        if (!alphaconvert) {
+            // Already in float format -- leave it as-is.
             buf = (float*)data;
         } else {
             // Need to make a copy, even though it's already float, so the
-            // dither doesn't overwrite the caller's data.
+            // alpha conversion doesn't overwrite the caller's data.
             buf = (float*)&scratch[contiguoussize];
             memcpy((float*)buf, data, floatsize);
         }
@@ -444,18 +456,26 @@ ImageOutput::to_native_rectangle(int xbegin, int xend, int ybegin, int yend,
                                (int)rectangle_values, format);
     }
 
+    if (alphaconvert > 0)
+        premult(m_spec.nchannels, width, height, depth, 0, m_spec.nchannels,
+                TypeFloat, (float*)buf, AutoStride, AutoStride, AutoStride,
+                m_spec.alpha_channel, m_spec.z_channel);
+    else if (alphaconvert < 0)
+        unpremult(m_spec.nchannels, width, height, depth, 0, m_spec.nchannels,
+                  TypeFloat, (float*)buf, AutoStride, AutoStride, AutoStride,
+                  m_spec.alpha_channel, m_spec.z_channel);
+
     if (do_dither) {
         // Note: We only dither if the intent is to convert from a floating
-        // point data type to uint8 or less.
-        stride_t pixelsize = m_spec.nchannels * sizeof(float);
-        int bps            = m_spec["oiio:BitsPerSample"].get<int>(8);
-        int ditheramp      = 1 << (8 - bps);
-        OIIO::add_dither(m_spec.nchannels, width, height, depth, (float*)buf,
-                         pixelsize, pixelsize * stride_t(width),
-                         pixelsize * stride_t(width) * stride_t(height),
-                         float(ditheramp) / 255.0f, m_spec.alpha_channel,
-                         m_spec.z_channel, dither, 0, xorigin, yorigin,
-                         zorigin);
+        // point data type to uint8 or less. The dither is added as part of
+        // the conversion, leaving buf alone.
+        int bps       = m_spec["oiio:BitsPerSample"].get<int>(8);
+        int ditheramp = 1 << (8 - bps);
+        return parallel_convert_from_float_dithered(
+            buf, &scratch[contiguoussize + floatsize], m_spec.nchannels,
+            width, height, depth, float(ditheramp) / 255.0f,
+            m_spec.alpha_channel, m_spec.z_channel, dither, xorigin, yorigin,
+            zorigin);
     }
 
     // Convert from float to native format.
@@ -472,6 +492,7 @@ ImageOutput::write_image(TypeDesc format, const void* data, stride_t xstride,
                          ProgressCallback progress_callback,
                          void* progress_callback_data)
 {
+    OIIO_TRACE_ZONE("ImageOutput::write_image", "imageio", format_name());
     bool native          = (format == TypeDesc::UNKNOWN);
     stride_t pixel_bytes = native ? (stride_t)m_spec.pixel_bytes(native)
                                   : format.size() * m_spec.nchannels;
@@ -487,6 +508,17 @@ ImageOutput::write_image(TypeDesc format, const void* data, stride_t xstride,
                                zstride);
     }
 
+    // If asked for, and the plugin knows how, compress chunks on the
+    // thread pool while we write them out in order.
+    if (m_spec.get_int_attribute("oiio:pipeline") && threads() != 1
+        && pipeline_chunk_size() > 0) {
+        thread_pool* pool = default_thread_pool();
+        if (pool->size() > 1 && !pool->is_worker())
+            return write_image_pipelined(format, data, xstride, ystride,
+                                         zstride, progress_callback,
+                                         progress_callback_data);
+    }
+
     bool ok = true;
     if (progress_callback && progress_callback(progress_callback_data, 0.0f))
         return ok;
@@ -540,6 +572,120 @@ ImageOutput::write_image(TypeDesc format, const void* data, stride_t xstride,
 
 
 
+bool
+ImageOutput::write_image_pipelined(TypeDesc format, const void* data,
+                                   stride_t xstride, stride_t ystride,
+                                   stride_t zstride,
+                                   ProgressCallback progress_callback,
+                                   void* progress_callback_data)
+{
+    const ImageSpec& spec(m_spec);
+    bool tiled = spec.tile_width && supports("tiles");
+    int tile_depth = std::max(1, spec.tile_depth);
+
+    // List all the chunks, in the order they'll be written
+    std::vector<ROI> chunks;
+    if (tiled) {
+        for (int z = spec.z; z < spec.z + spec.depth; z += tile_depth)
+            for (int y = spec.y; y < spec.y + spec.height; y += spec.tile_height)
+                for (int x = spec.x; x < spec.x + spec.width;
+                     x += spec.tile_width)
+                    chunks.emplace_back(
+                        x, std::min(x + spec.tile_width, spec.x + spec.width),
+                        y, std::min(y + spec.tile_height, spec.y + spec.height),
+                        z, std::min(z + tile_depth, spec.z + spec.depth), 0,
+                        spec.nchannels);
+    } else {
+        int rows = pipeline_chunk_size();
+        for (int z = spec.z; z < spec.z + spec.depth; ++z)
+            for (int y = spec.y; y < spec.y + spec.height; y += rows)
+                chunks.emplace_back(spec.x, spec.x + spec.width, y,
+                                    std::min(y + rows, spec.y + spec.height),
+                                    z, z + 1, 0, spec.nchannels);
+    }
+
+    // Convert one chunk to native, contiguous (and for tiles, padded)
+    // pixels, and have the plugin compress it.
+    unsigned int dither = spec.get_int_attribute("oiio:dither");
+    stride_t pixel_bytes = stride_t(spec.pixel_bytes(true));
+    auto compress = [&](const ROI& roi,
+                        std::vector<unsigned char>* compressed) -> bool {
+        const char* d = (const char*)data + (roi.xbegin - spec.x) * xstride
+                        + (roi.ybegin - spec.y) * ystride
+                        + (roi.zbegin - spec.z) * zstride;
+        std::vector<unsigned char> scratch;
+        const void* native
+            = to_native_rectangle(roi.xbegin, roi.xend, roi.ybegin, roi.yend,
+                                  roi.zbegin, roi.zend, format, d, xstride,
+                                  ystride, zstride, scratch, dither,
+                                  roi.xbegin, roi.ybegin, roi.zbegin);
+        if (tiled) {
+            std::vector<unsigned char> tile(spec.tile_bytes(true), 0);
+            OIIO::copy_image(spec.nchannels, roi.width(), roi.height(),
+                             roi.depth(), native, pixel_bytes, pixel_bytes,
+                             pixel_bytes * roi.width(),
+                             pixel_bytes * roi.width() * roi.height(),
+                             tile.data(), pixel_bytes,
+                             pixel_bytes * spec.tile_width,
+                             pixel_bytes * spec.tile_width * spec.tile_height);
+            scratch.swap(tile);
+        } else if (native != scratch.data()) {
+            // The plugin is allowed to overwrite its input, so don't let
+            // it see the caller's buffer.
+            scratch.assign((const unsigned char*)native,
+                           (const unsigned char*)native
+                               + roi.npixels() * pixel_bytes);
+        }
+        return pipeline_compress(roi, scratch.data(), *compressed);
+    };
+
+    // Keep as many chunks in flight as we may use threads. A std::deque
+    // doesn't move its elements as it grows and shrinks at the ends, so
+    // the tasks can safely hold pointers to their output.
+    struct Pending {
+        std::future<bool> done;
+        std::vector<unsigned char> compressed;
+    };
+    thread_pool* pool = default_thread_pool();
+    size_t window     = size_t(threads() > 0 ? std::min(threads(), pool->size())
+                                             : pool->size());
+    window            = std::max(window, size_t(1));
+    std::deque<Pending> pending;
+    size_t next = 0;
+    bool ok     = true;
+    if (progress_callback && progress_callback(progress_callback_data, 0.0f))
+        return ok;
+    for (size_t c = 0; ok && c < chunks.size(); ++c) {
+        for (; next < chunks.size() && pending.size() < window; ++next) {
+            pending.emplace_back();
+            ROI roi          = chunks[next];
+            auto* compressed = &pending.back().compressed;
+            pending.back().done = pool->push([&, roi, compressed](int /*id*/) {
+                return compress(roi, compressed);
+            });
+        }
+        ok = pending.front().done.get();
+        if (!ok) {
+            if (!has_error())
+                errorfmt("Compression failed for {} chunk {}", format_name(),
+                         c);
+        } else {
+            ok = pipeline_write(chunks[c], pending.front().compressed);
+        }
+        pending.pop_front();
+        if (progress_callback
+            && progress_callback(progress_callback_data,
+                                 float(c + 1) / float(chunks.size())))
+            break;
+    }
+    // Don't leave tasks running that refer to our locals
+    for (auto& p : pending)
+        p.done.wait();
+    return ok;
+}
+
+
+
 bool
 ImageOutput::copy_image(ImageInput* in)
 {
@@ -325,6 +325,67 @@ test_imagespec_from_xml()
     OIIO_CHECK_EQUAL(spec.get_string_attribute("oiio:ColorSpace"), "Linear");
 }
 
+static void
+test_imagespec_binary()
+{
+    std::cout << "test_imagespec_binary\n";
+    ImageSpec spec(640, 480, 4, TypeHalf);
+    spec.x           = 10;
+    spec.full_height = 500;
+    spec.tile_width  = 64;
+    spec.tile_height = 64;
+    spec.channelformats.assign({ TypeHalf, TypeHalf, TypeHalf, TypeFloat });
+    spec.attribute("compression", "zip");
+    spec.attribute("oiio:BitsPerSample", 16);
+    spec.attribute("PixelAspectRatio", 1.5f);
+    float M[16] = { 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16 };
+    spec.attribute("worldtocamera", TypeMatrix, M);
+    ustring names[] = { ustring("a"), ustring(""), ustring("ccc") };
+    spec.attribute("names", TypeDesc(TypeDesc::STRING, 3), names);
+    void* ptr = &spec;
+    spec.attribute("pointer", TypeDesc::PTR, &ptr);
+
+    std::string bin = spec.serialize(ImageSpec::SerialBinary);
+    ImageSpec copy;
+    OIIO_CHECK_ASSERT(copy.from_binary(bin));
+    spec.erase_attribute("pointer");  // not serialized
+    OIIO_CHECK_EQUAL(copy.serialize(ImageSpec::SerialText,
+                                    ImageSpec::SerialDetailed),
+                     spec.serialize(ImageSpec::SerialText,
+                                    ImageSpec::SerialDetailed));
+
+    ImageSpecView view(bin);
+    OIIO_CHECK_ASSERT(view.valid());
+    OIIO_CHECK_EQUAL(view.x(), 10);
+    OIIO_CHECK_EQUAL(view.width(), 640);
+    OIIO_CHECK_EQUAL(view.full_height(), 500);
+    OIIO_CHECK_EQUAL(view.nchannels(), 4);
+    OIIO_CHECK_EQUAL(view.alpha_channel(), 3);
+    OIIO_CHECK_EQUAL(view.format(), TypeHalf);
+    OIIO_CHECK_EQUAL(view.channelformat(3), TypeFloat);
+    OIIO_CHECK_EQUAL(view.channel_name(1), "G");
+    OIIO_CHECK_EQUAL(view.channel_name(4), "");
+    OIIO_CHECK_EQUAL(view.nattribs(), 5);
+    OIIO_CHECK_EQUAL(view.get_string_attribute("Compression"), "zip");
+    OIIO_CHECK_EQUAL(view.get_int_attribute("oiio:BitsPerSample"), 16);
+    OIIO_CHECK_EQUAL(view.get_float_attribute("PixelAspectRatio"), 1.5f);
+    OIIO_CHECK_EQUAL(view.get_int_attribute("pointer", -1), -1);
+    float M2[16] = {};
+    OIIO_CHECK_ASSERT(view.getattribute("worldtocamera", TypeMatrix, M2));
+    OIIO_CHECK_EQUAL(M2[15], 16.0f);
+    ustring names2[3];
+    OIIO_CHECK_ASSERT(
+        view.getattribute("names", TypeDesc(TypeDesc::STRING, 3), names2));
+    OIIO_CHECK_EQUAL(names2[2], names[2]);
+    OIIO_CHECK_ASSERT(!view.getattribute("names", TypeString, names2));
+
+    // Damaged or truncated encodings aren't valid
+    OIIO_CHECK_ASSERT(!ImageSpecView(string_view(bin).substr(0, 100)).valid());
+    OIIO_CHECK_ASSERT(
+        !ImageSpecView(string_view(bin).substr(0, bin.size() - 1)).valid());
+    OIIO_CHECK_ASSERT(!copy.from_binary(imagespec_xml_string));
+}
+
 
 
 int
@@ -336,6 +397,7 @@ main(int /*argc*/, char* /*argv*/[])
     test_get_attribute();
     test_imagespec_from_ROI();
     test_imagespec_from_xml();
+    test_imagespec_binary();
 
     return unit_test_failures;
 }
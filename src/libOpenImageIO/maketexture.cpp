@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -9,6 +11,7 @@
 #include <iterator>
 #include <limits>
 #include <memory>
+#include <mutex>
 #include <sstream>
 
 #include <OpenImageIO/Imath.h>
@@ -18,6 +21,7 @@
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/filter.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/hash.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagebufalgo_util.h>
@@ -26,6 +30,7 @@
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
 #include <OpenImageIO/timer.h>
+#include <OpenImageIO/trace.h>
 
 #include "imageio_pvt.h"
 
@@ -306,7 +311,8 @@ resize_block(ImageBuf& dst, const ImageBuf& src, ROI roi, bool envlatlmode,
     OIIO_DASSERT(dstspec.nchannels == srcspec.nchannels);
     OIIO_DASSERT(dst.localpixels());
     bool ok;
-    if (src.localpixels() &&                     // Not a cached image
+    if (pvt::packed_localpixels(src) &&          // Not cached or strided
+        src.scanline_stride() == stride_t(srcspec.scanline_bytes()) &&
         !envlatlmode &&                          // not latlong wrap mode
         roi.xbegin == 0 &&                       // Region x at origin
         dstspec.width == roi.width() &&          // Full width ROI
@@ -619,13 +625,655 @@ maketx_merge_spec(ImageSpec& dstspec, const ImageSpec& srcspec)
 
 
 
+// Streaming MIP-map construction, for "maketx:stream". The top level is
+// read a row of tiles at a time, and each level holds on only to the rows
+// that are not yet written or still needed to filter the level below:
+// whenever rows arrive, the complete rows of tiles are written, and the
+// rows of the next level down that they finish are filtered and passed
+// along in turn. The results are identical to the "box" filter path of
+// write_mipmap.
+//
+// All the levels are produced together, but they have to be appended to
+// the texture in order, so the levels below the top are spooled to
+// temporary files and copied into place at the end.
+struct MipStreamLevel {
+    ImageSpec spec;                      // the level, as written
+    std::string filename;                // where it's going
+    ImageOutput* output = nullptr;       // ... and the file it's going to
+    std::unique_ptr<ImageOutput> spool;  // temp file, for all but the top
+    std::vector<float> rows;             // float pixels of [ybegin,yend)
+    int ybegin   = 0;
+    int yend     = 0;
+    int written  = 0;  // rows [0,written) have been output
+    int produced = 0;  // rows of the next level down made so far
+};
+
+
+
+// The range of rows of `big` that the box filter reads to make row `y` of
+// `small`, the next level down: the two rows that resize_block_2pass
+// averages when both dimensions of `big` are even, else the rows around
+// the ones interppixel_NDC_clamped interpolates, with one to spare on
+// either side so that rounding can't leave it short.
+static std::pair<int, int>
+mip_source_rows(const ImageSpec& small, const ImageSpec& big, int y)
+{
+    if (big.width % 2 == 0 && big.height % 2 == 0)
+        return { 2 * y, 2 * y + 1 };
+    int ytexel;
+    floorfrac((y + 0.5f) / float(small.height) * float(big.height) - 0.5f,
+              &ytexel);
+    return { OIIO::clamp(ytexel - 1, 0, big.height - 1),
+             OIIO::clamp(ytexel + 2, 0, big.height - 1) };
+}
+
+
+
+// Compute rows [ybegin,yend) of `small`, the level below `lev`, from the
+// rows that `lev` holds, filtering them just as resize_block does for the
+// whole level.
+static void
+mip_stream_filter(MipStreamLevel& lev, const ImageSpec& small, int ybegin,
+                  int yend, float* result)
+{
+    const ImageSpec& big(lev.spec);
+    const int nc = big.nchannels;
+    ImageSpec rspec(small.width, yend - ybegin, nc, TypeFloat);
+    ImageBuf dst(rspec, result);
+    if (big.width % 2 == 0 && big.height % 2 == 0) {
+        // Each result row averages two source rows
+        ImageSpec sspec(big.width, 2 * (yend - ybegin), nc, TypeFloat);
+        ImageBuf src(sspec, lev.rows.data()
+                                + size_t(2 * ybegin - lev.ybegin)
+                                      * big.width * nc);
+        ImageBufAlgo::parallel_image(get_roi(rspec),
+                                     std::bind(resize_block_2pass<float>,
+                                               std::ref(dst), std::cref(src),
+                                               _1, false));
+        return;
+    }
+
+    // The held rows, placed within the whole level, so that they're
+    // sampled exactly as resize_block_ would.
+    ImageSpec sspec(big.width, lev.yend - lev.ybegin, nc, TypeFloat);
+    sspec.y           = lev.ybegin;
+    sspec.full_height = big.height;
+    ImageBuf src(sspec, lev.rows.data());
+    const float xscale = 1.0f / (float)small.full_width;
+    const float yscale = 1.0f / (float)small.full_height;
+    ImageBufAlgo::parallel_image(
+        ROI(0, small.width, ybegin, yend, 0, 1, 0, nc), [&](ROI roi) {
+            for (int y = roi.ybegin; y < roi.yend; ++y) {
+                float t  = (y + 0.5f) * yscale;
+                float* d = result
+                           + (size_t(y - ybegin) * small.width + roi.xbegin)
+                                 * nc;
+                for (int x = roi.xbegin; x < roi.xend; ++x, d += nc) {
+                    float s = (x + 0.5f) * xscale;
+                    interppixel_NDC_clamped<float>(src, s, t, d, false);
+                }
+            }
+        });
+}
+
+
+
+// Receive rows [ybegin,yend) of level `L`, which pick up where the last
+// ones left off. Write any rows of tiles they complete, and hand on the
+// rows of the next level down that can now be made.
+static bool
+mip_stream_rows(std::vector<MipStreamLevel>& levels, size_t L, float* rows,
+                int ybegin, int yend, bool clamp_half, double& stat_miptime)
+{
+    using OIIO::pvt::errorfmt;
+    MipStreamLevel& lev(levels[L]);
+    const ImageSpec& spec(lev.spec);
+    const int nc         = spec.nchannels;
+    const size_t rowvals = size_t(spec.width) * nc;
+    const size_t nvals   = size_t(yend - ybegin) * rowvals;
+    OIIO_DASSERT(ybegin == lev.yend);
+
+    // Clamp just as write_mipmap does before writing or filtering a level
+    if (clamp_half) {
+        for (size_t i = 0; i < nvals; ++i)
+            rows[i] = OIIO::clamp<float>(rows[i], -HALF_MAX, HALF_MAX);
+        if (spec.alpha_channel >= 0 && spec.alpha_channel < nc)
+            for (size_t i = spec.alpha_channel; i < nvals; i += nc)
+                rows[i] = OIIO::clamp(rows[i], 0.0f, 1.0f);
+    }
+    lev.rows.insert(lev.rows.end(), rows, rows + nvals);
+    lev.yend = yend;
+
+    // Write out whole rows of tiles, and whatever is left at the bottom
+    int nwrite = lev.yend - lev.written;
+    if (lev.yend < spec.height)
+        nwrite -= nwrite % spec.tile_height;
+    if (nwrite > 0) {
+        const float* p = lev.rows.data()
+                         + size_t(lev.written - lev.ybegin) * rowvals;
+        if (!lev.output->write_tiles(0, spec.width, lev.written,
+                                     lev.written + nwrite, 0, 1, TypeFloat,
+                                     p)) {
+            errorfmt("Error writing \"{}\" : {}", lev.filename,
+                     lev.output->geterror());
+            return false;
+        }
+        lev.written += nwrite;
+    }
+
+    // Make whatever rows of the next level down we now can, and keep only
+    // the rows that it or the writing still need.
+    int keep = lev.written;
+    if (L + 1 < levels.size()) {
+        const ImageSpec& small(levels[L + 1].spec);
+        int y0 = lev.produced, y1 = lev.produced;
+        while (y1 < small.height
+               && mip_source_rows(small, spec, y1).second < lev.yend)
+            ++y1;
+        if (y1 > y0) {
+            Timer miptimer;
+            std::unique_ptr<float[]> result(
+                new float[size_t(y1 - y0) * small.width * nc]);
+            mip_stream_filter(lev, small, y0, y1, result.get());
+            stat_miptime += miptimer();
+            lev.produced = y1;
+            if (!mip_stream_rows(levels, L + 1, result.get(), y0, y1,
+                                 clamp_half, stat_miptime))
+                return false;
+        }
+        if (lev.produced < small.height)
+            keep = std::min(keep,
+                            mip_source_rows(small, spec, lev.produced).first);
+    }
+    if (keep > lev.ybegin) {
+        lev.rows.erase(lev.rows.begin(),
+                       lev.rows.begin() + size_t(keep - lev.ybegin) * rowvals);
+        lev.ybegin = keep;
+    }
+    return true;
+}
+
+
+
+// Write the already opened top level `outspec` of `out` from `img`, and
+// then append all the MIP levels below it, streaming the pixels through
+// as described above.
+static bool
+write_mipmap_streaming(const ImageBuf& img, const ImageSpec& outspec,
+                       const std::string& outputfilename, ImageOutput* out,
+                       TypeDesc outputdatatype, bool clamp_half, bool verbose,
+                       std::ostream& outstream, double& stat_miptime,
+                       size_t& peak_mem)
+{
+    using OIIO::pvt::errorfmt;
+    // All the levels, halving each time just like write_mipmap
+    std::vector<MipStreamLevel> levels(1);
+    levels[0].spec     = outspec;
+    levels[0].filename = outputfilename;
+    levels[0].output   = out;
+    while (levels.back().spec.width > 1 || levels.back().spec.height > 1) {
+        ImageSpec spec = levels.back().spec;
+        if (spec.width > 1)
+            spec.width /= 2;
+        if (spec.height > 1)
+            spec.height /= 2;
+        spec.full_width  = spec.width;
+        spec.full_height = spec.height;
+        spec.full_depth  = spec.depth;
+        spec.x           = 0;
+        spec.y           = 0;
+        spec.full_x      = 0;
+        spec.full_y      = 0;
+        spec.set_format(outputdatatype);
+        levels.emplace_back();
+        levels.back().spec = spec;
+    }
+
+    bool ok               = true;
+    std::string extension = Filesystem::extension(outputfilename);
+    for (size_t L = 1; L < levels.size() && ok; ++L) {
+        MipStreamLevel& lev(levels[L]);
+        lev.filename = Filesystem::replace_extension(
+            outputfilename, Strutil::sprintf(".mip%d", int(L)) + extension);
+        // The spool is read back, so keep it lossless
+        ImageSpec spoolspec = lev.spec;
+        spoolspec.attribute("compression", "zip");
+        spoolspec.attribute("openexr:levelmode", 0 /* ONE_LEVEL */);
+        lev.spool = ImageOutput::create(out->format_name());
+        if (!lev.spool || !lev.spool->open(lev.filename, spoolspec)) {
+            errorfmt("Could not open \"{}\" : {}", lev.filename,
+                     lev.spool ? lev.spool->geterror() : OIIO::geterror());
+            lev.spool.reset();
+            ok = false;
+        }
+        lev.output = lev.spool.get();
+    }
+
+    // Feed the top level through a row of tiles at a time
+    if (ok) {
+        const int nc = outspec.nchannels, band = outspec.tile_height;
+        std::unique_ptr<float[]> buf(
+            new float[size_t(band) * outspec.width * nc]);
+        for (int y = 0; y < outspec.height && ok; y += band) {
+            int yend = std::min(y + band, outspec.height);
+            ok = img.get_pixels(ROI(0, outspec.width, y, yend, 0, 1, 0, nc),
+                                TypeFloat, buf.get());
+            if (!ok)
+                errorfmt("Could not read \"{}\" : {}", img.name(),
+                         img.geterror());
+            else
+                ok = mip_stream_rows(levels, 0, buf.get(), y, yend,
+                                     clamp_half, stat_miptime);
+        }
+    }
+    if (verbose) {
+        size_t mem = Sysutil::memory_used(true);
+        peak_mem   = std::max(peak_mem, mem);
+    }
+    for (size_t L = 1; L < levels.size(); ++L) {
+        MipStreamLevel& lev(levels[L]);
+        if (lev.spool && !lev.spool->close() && ok) {
+            errorfmt("Error writing \"{}\" : {}", lev.filename,
+                     lev.spool->geterror());
+            ok = false;
+        }
+        lev.spool.reset();
+    }
+
+    // Append the spooled levels to the texture, in order, a row of tiles
+    // at a time in the output data format.
+    for (size_t L = 1; L < levels.size() && ok; ++L) {
+        const ImageSpec& spec(levels[L].spec);
+        if (!out->open(outputfilename, spec, ImageOutput::AppendMIPLevel)) {
+            errorfmt("Could not append \"{}\" : {}", outputfilename,
+                     out->geterror());
+            ok = false;
+            break;
+        }
+        auto in = ImageInput::create(out->format_name());
+        ImageSpec inspec;
+        if (!in || !in->open(levels[L].filename, inspec)) {
+            errorfmt("Could not read \"{}\" : {}", levels[L].filename,
+                     in ? in->geterror() : OIIO::geterror());
+            ok = false;
+            break;
+        }
+        std::unique_ptr<char[]> tiles(
+            new char[spec.scanline_bytes() * spec.tile_height]);
+        for (int y = 0; y < spec.height && ok; y += spec.tile_height) {
+            int yend = std::min(y + spec.tile_height, spec.height);
+            if (!in->read_tiles(0, 0, 0, spec.width, y, yend, 0, 1, 0,
+                                spec.nchannels, spec.format, tiles.get())) {
+                errorfmt("Could not read \"{}\" : {}", levels[L].filename,
+                         in->geterror());
+                ok = false;
+            } else if (!out->write_tiles(0, spec.width, y, yend, 0, 1,
+                                         spec.format, tiles.get())) {
+                errorfmt("Error writing \"{}\" : {}", outputfilename,
+                         out->geterror());
+                ok = false;
+            }
+        }
+        in->close();
+        if (verbose) {
+            size_t mem = Sysutil::memory_used(true);
+            peak_mem   = std::max(peak_mem, mem);
+            outstream << Strutil::sprintf("    %-15s (%s)", formatres(spec),
+                                          Strutil::memformat(mem))
+                      << std::endl;
+        }
+    }
+    for (size_t L = 1; L < levels.size(); ++L)
+        Filesystem::remove(levels[L].filename);
+    return ok;
+}
+
+
+
+// Prefiltered reflection lobes of a latlong environment map, for
+// "maketx:envlobes". They go in a companion texture, whose MIP level m
+// holds in its first half of the channels the map convolved with the GGX
+// lobe of roughness (m+1)/nlobes (or 1, past the first nlobes levels),
+// and in its second half the map convolved with the cosine lobe. As is
+// usual for prefiltered environment lighting, the lobes are centered on
+// the lookup direction, as if the normal and view directions were the
+// same. Convolution doesn't care which way is up, so this works in the
+// z-up convention and the lobes line up with the map's pixels either way.
+//
+// The specular lobes use filtered importance sampling (Krivanek &
+// Colbert, "Real-time Shading with Filtered Importance Sampling," EGSR
+// 2008): each of a fixed set of GGX samples looks up a box-filtered MIP
+// level of the map whose texels are about as big as the solid angle the
+// sample stands for.
+
+std::string
+pvt::env_lobes_filename(string_view filename)
+{
+    return Filesystem::replace_extension(filename,
+                                         ".lobes"
+                                             + Filesystem::extension(filename));
+}
+
+
+
+// A latlong image in float, with pixel (x,y) at s,t = (x+0.5)/w, (y+0.5)/h.
+struct LatlongLevel {
+    int w  = 0;
+    int h  = 0;
+    int nc = 0;
+    std::vector<float> pixels;
+
+    const float* pixel(int x, int y) const
+    {
+        return &pixels[(size_t(y) * w + x) * nc];
+    }
+};
+
+
+
+// Inverse of latlong_to_dir(s, t, false).
+inline void
+dir_to_latlong(const Imath::V3f& R, float& s, float& t)
+{
+    s = atan2f(R[1], R[0]) / (2.0f * float(M_PI)) + 0.5f;
+    t = 0.5f - atan2f(R[2], hypotf(R[0], R[1])) / float(M_PI);
+}
+
+
+
+// Add weight times the bilinear interpolation of lev at (s,t) to accum,
+// wrapping periodically in s and clamping in t.
+static void
+latlong_accum(const LatlongLevel& lev, float s, float t, float weight,
+              float* accum)
+{
+    int xtexel, ytexel;
+    float xfrac = floorfrac(s * lev.w - 0.5f, &xtexel);
+    float yfrac = floorfrac(t * lev.h - 0.5f, &ytexel);
+    int x0      = xtexel % lev.w;
+    if (x0 < 0)
+        x0 += lev.w;
+    int x1           = x0 + 1 < lev.w ? x0 + 1 : 0;
+    int y0           = OIIO::clamp(ytexel, 0, lev.h - 1);
+    int y1           = OIIO::clamp(ytexel + 1, 0, lev.h - 1);
+    const float* p00 = lev.pixel(x0, y0);
+    const float* p10 = lev.pixel(x1, y0);
+    const float* p01 = lev.pixel(x0, y1);
+    const float* p11 = lev.pixel(x1, y1);
+    for (int c = 0; c < lev.nc; ++c)
+        accum[c] += weight * bilerp(p00[c], p10[c], p01[c], p11[c], xfrac,
+                                    yfrac);
+}
+
+
+
+// Box filter a latlong level down by half.
+static LatlongLevel
+latlong_halve(const LatlongLevel& big)
+{
+    LatlongLevel small;
+    small.w  = std::max(1, big.w / 2);
+    small.h  = std::max(1, big.h / 2);
+    small.nc = big.nc;
+    small.pixels.resize(size_t(small.w) * small.h * small.nc);
+    parallel_for(0, small.h, [&](int y) {
+        int y0   = std::min(2 * y, big.h - 1);
+        int y1   = std::min(2 * y + 1, big.h - 1);
+        float* d = &small.pixels[size_t(y) * small.w * small.nc];
+        for (int x = 0; x < small.w; ++x) {
+            int x0 = std::min(2 * x, big.w - 1);
+            int x1 = std::min(2 * x + 1, big.w - 1);
+            for (int c = 0; c < big.nc; ++c, ++d)
+                *d = 0.25f
+                     * (big.pixel(x0, y0)[c] + big.pixel(x1, y0)[c]
+                        + big.pixel(x0, y1)[c] + big.pixel(x1, y1)[c]);
+        }
+    });
+    return small;
+}
+
+
+
+// One of the GGX samples of a specular lobe: the reflected direction in
+// the lobe's frame (z along the lobe's center), its cosine, and the MIP
+// level of the map to look it up in.
+struct LobeSample {
+    Imath::V3f L;
+    float NdotL;
+    float lod;
+};
+
+
+
+// The GGX samples, from a Hammersley sequence, for a lobe of the given
+// alpha, looking up a map whose finest level is srcw x srch with nsrc
+// levels.
+static std::vector<LobeSample>
+ggx_lobe_samples(float alpha, int nsamples, int srcw, int srch, int nsrc)
+{
+    std::vector<LobeSample> samples;
+    float a2         = alpha * alpha;
+    float texelsolid = 4.0f * float(M_PI) / (float(srcw) * float(srch));
+    for (int i = 0; i < nsamples; ++i) {
+        float u1    = (i + 0.5f) / nsamples;
+        float u2    = 0.0f;  // radical inverse of i
+        float scale = 0.5f;
+        for (int n = i; n; n >>= 1, scale *= 0.5f)
+            if (n & 1)
+                u2 += scale;
+        // Half vector from the GGX distribution, and the reflection of
+        // the lobe's center about it.
+        float cos2h = (1.0f - u1) / (1.0f + (a2 - 1.0f) * u1);
+        float cosh  = sqrtf(cos2h);
+        float sinh  = sqrtf(std::max(0.0f, 1.0f - cos2h));
+        float phi   = 2.0f * float(M_PI) * u2;
+        LobeSample sample;
+        sample.NdotL = 2.0f * cos2h - 1.0f;
+        if (sample.NdotL <= 0.0f)
+            continue;
+        sample.L = Imath::V3f(2.0f * cosh * sinh * cosf(phi),
+                              2.0f * cosh * sinh * sinf(phi), sample.NdotL);
+        // With the normal along the view direction, the pdf of L is D/4.
+        float d           = 1.0f + (a2 - 1.0f) * cos2h;
+        float D           = a2 / (float(M_PI) * d * d);
+        float samplesolid = 4.0f / (nsamples * D);
+        sample.lod = OIIO::clamp(0.5f * log2f(samplesolid / texelsolid) + 1.0f,
+                                 0.0f, float(nsrc - 1));
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+
+
+// Fill the specular (with the given GGX samples) and diffuse lobes of one
+// level of the lobes texture.
+static void
+env_lobe_level(ImageBuf& dst, const std::vector<LatlongLevel>& src,
+               const std::vector<LobeSample>& samples,
+               const std::vector<Imath::V3f>& irrdirs,
+               const std::vector<float>& irrpixels)
+{
+    int nc = src[0].nc;
+    int w  = dst.spec().width, h = dst.spec().height;
+    ImageBufAlgo::parallel_image(get_roi(dst.spec()), [&](ROI roi) {
+        float* spec    = OIIO_ALLOCA(float, 2 * nc);
+        float* diffuse = spec + nc;
+        for (ImageBuf::Iterator<float> d(dst, roi); !d.done(); ++d) {
+            Imath::V3f N  = latlong_to_dir((d.x() + 0.5f) / w,
+                                           (d.y() + 0.5f) / h, false);
+            Imath::V3f up = fabsf(N.z) < 0.999f ? Imath::V3f(0, 0, 1)
+                                                : Imath::V3f(1, 0, 0);
+            Imath::V3f T  = up.cross(N).normalized();
+            Imath::V3f B  = N.cross(T);
+            std::fill(spec, spec + 2 * nc, 0.0f);
+            float wsum = 0.0f;
+            for (const LobeSample& sample : samples) {
+                Imath::V3f L = T * sample.L.x + B * sample.L.y
+                               + N * sample.L.z;
+                float s, t;
+                dir_to_latlong(L, s, t);
+                int lev    = int(sample.lod);
+                float frac = sample.lod - float(lev);
+                latlong_accum(src[lev], s, t, sample.NdotL * (1.0f - frac),
+                              spec);
+                if (frac > 0.0f)
+                    latlong_accum(src[lev + 1], s, t, sample.NdotL * frac,
+                                  spec);
+                wsum += sample.NdotL;
+            }
+            for (int c = 0; c < nc; ++c)
+                spec[c] /= std::max(wsum, 1e-6f);
+            // irrpixels are premultiplied by their texels' solid angles
+            for (size_t i = 0, n = irrdirs.size(); i < n; ++i) {
+                float cosine = N.dot(irrdirs[i]);
+                if (cosine > 0.0f)
+                    for (int c = 0; c < nc; ++c)
+                        diffuse[c] += cosine * irrpixels[i * nc + c];
+            }
+            for (int c = 0; c < nc; ++c)
+                diffuse[c] *= float(M_1_PI);
+            for (int c = 0; c < 2 * nc; ++c)
+                d[c] = spec[c];
+        }
+    });
+}
+
+
+
+// Write the lobes texture for the latlong map img to filename, and set
+// nlobes to how many of its levels are distinct specular lobes.
+static bool
+write_env_lobes(const ImageBuf& img, const std::string& filename,
+                string_view outformat, TypeDesc outputdatatype,
+                const ImageSpec& configspec, int& nlobes,
+                std::ostream& outstream)
+{
+    using OIIO::pvt::errorfmt;
+    bool verbose = configspec.get_int_attribute("maketx:verbose") != 0;
+    const ImageSpec& imgspec(img.spec());
+    int nc   = imgspec.nchannels;
+    int res  = OIIO::clamp(configspec.get_int_attribute("maketx:envlobes_res",
+                                                        256),
+                           1, imgspec.width);
+    int resh = std::max(1, int(int64_t(imgspec.height) * res / imgspec.width));
+
+    // The map, at no more resolution than the sharpest lobe could use,
+    // and its box-filtered MIP levels.
+    std::vector<LatlongLevel> src(1);
+    {
+        ImageSpec basespec(std::min(imgspec.width, 4 * res),
+                           std::min(imgspec.height, 4 * resh), nc, TypeFloat);
+        ImageBuf base(basespec);
+        ImageBufAlgo::parallel_image(get_roi(basespec),
+                                     std::bind(resize_block, std::ref(base),
+                                               std::cref(img), _1, true,
+                                               false));
+        src[0].w  = basespec.width;
+        src[0].h  = basespec.height;
+        src[0].nc = nc;
+        src[0].pixels.resize(size_t(src[0].w) * src[0].h * nc);
+        base.get_pixels(get_roi(basespec), TypeFloat, src[0].pixels.data());
+    }
+    while (src.back().w > 1 || src.back().h > 1)
+        src.push_back(latlong_halve(src.back()));
+
+    // The diffuse lobe needs little resolution: convolve a small level,
+    // with its texels' directions and solid-angle weighted values.
+    const LatlongLevel* irr = &src.back();
+    for (const LatlongLevel& lev : src) {
+        if (lev.w <= 64) {
+            irr = &lev;
+            break;
+        }
+    }
+    std::vector<Imath::V3f> irrdirs;
+    std::vector<float> irrpixels;
+    for (int y = 0; y < irr->h; ++y) {
+        float t     = (y + 0.5f) / irr->h;
+        float solid = 2.0f * float(M_PI) / irr->w * float(M_PI) / irr->h
+                      * sinf(float(M_PI) * t);
+        for (int x = 0; x < irr->w; ++x) {
+            irrdirs.push_back(latlong_to_dir((x + 0.5f) / irr->w, t, false));
+            for (int c = 0; c < nc; ++c)
+                irrpixels.push_back(solid * irr->pixel(x, y)[c]);
+        }
+    }
+
+    nlobes = 1;
+    while ((res >> nlobes) >= 8)
+        ++nlobes;
+
+    auto out = ImageOutput::create(outformat);
+    if (!out) {
+        errorfmt("Could not find an ImageIO plugin to write {} files: {}",
+                 outformat, geterror());
+        return false;
+    }
+    ImageSpec outspec(res, resh, 2 * nc, outputdatatype);
+    outspec.tile_width  = configspec.tile_width ? configspec.tile_width : 64;
+    outspec.tile_height = configspec.tile_height ? configspec.tile_height
+                                                 : 64;
+    outspec.tile_depth  = 1;
+    for (int c = 0; c < 2 * nc; ++c) {
+        outspec.channelnames[c] = imgspec.channel_name(c % nc);
+        if (c >= nc)
+            outspec.channelnames[c] = "diffuse." + outspec.channelnames[c];
+    }
+    outspec.attribute("compression", "zip");
+    outspec.attribute("textureformat", "LatLong Environment");
+    outspec.attribute("wrapmodes", "periodic,clamp");
+    if (!strcmp(out->format_name(), "openexr"))
+        outspec.attribute("openexr:roundingmode", 0 /* ROUND_DOWN */);
+    if (verbose)
+        outstream << "  Writing environment lobes: " << filename << "\n";
+
+    for (int m = 0;; ++m) {
+        OIIO_TRACE_ZONE("make_texture env lobes level", "maketx");
+        ImageSpec levelspec   = outspec;
+        levelspec.width       = std::max(1, res >> m);
+        levelspec.height      = std::max(1, resh >> m);
+        levelspec.full_width  = levelspec.width;
+        levelspec.full_height = levelspec.height;
+        ImageSpec floatspec   = levelspec;
+        floatspec.set_format(TypeFloat);
+        ImageBuf level(floatspec);
+        float roughness = std::min(float(m + 1) / nlobes, 1.0f);
+        float alpha     = roughness * roughness;
+        std::vector<LobeSample> samples
+            = ggx_lobe_samples(alpha, 64, src[0].w, src[0].h, int(src.size()));
+        env_lobe_level(level, src, samples, irrdirs, irrpixels);
+        if (outputdatatype == TypeHalf)
+            ImageBufAlgo::clamp(level, level, -HALF_MAX, HALF_MAX, true);
+
+        ImageOutput::OpenMode mode = ImageOutput::Create;
+        if (m)
+            mode = out->supports("mipmap") ? ImageOutput::AppendMIPLevel
+                                           : ImageOutput::AppendSubimage;
+        if (!out->open(filename, levelspec, mode) || !level.write(out.get())) {
+            errorfmt("Error writing \"{}\" : {}", filename,
+                     out->has_error() ? out->geterror() : level.geterror());
+            return false;
+        }
+        if (levelspec.width == 1 && levelspec.height == 1)
+            break;
+    }
+    if (!out->close()) {
+        errorfmt("Error writing \"{}\" : {}", filename, out->geterror());
+        return false;
+    }
+    return true;
+}
+
+
+
 static bool
 write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
              const ImageSpec& outspec_template, std::string outputfilename,
              ImageOutput* out, TypeDesc outputdatatype, bool mipmap,
              string_view filtername, const ImageSpec& configspec,
              std::ostream& outstream, double& stat_writetime,
-             double& stat_miptime, size_t& peak_mem)
+             double& stat_miptime, size_t& peak_mem, bool streaming = false)
 {
     using OIIO::pvt::errorfmt;
     bool envlatlmode       = (mode == ImageBufAlgo::MakeTxEnvLatl);
@@ -639,8 +1287,10 @@ write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
     // Going from float to half is prone to generating Inf values if we had
     // any floats that were out of the range that half can represent. Nobody
     // wants Inf in textures; better to clamp.
+    // (When streaming, img is still in its original data format, but
+    // clamping anything else is harmless.)
     bool clamp_half = (outspec.format == TypeHalf
-                       && (img->spec().format == TypeFloat
+                       && (streaming || img->spec().format == TypeFloat
                            || img->spec().format == TypeHalf));
 
     if (mipmap && !out->supports("multiimage") && !out->supports("mipmap")) {
@@ -709,12 +1359,21 @@ write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
         outstream << "  Top level is " << formatres(outspec) << std::endl;
     }
 
-    if (clamp_half) {
+    if (streaming) {
+        double miptime = stat_miptime;
+        if (!write_mipmap_streaming(*img, outspec, outputfilename, out,
+                                    outputdatatype, clamp_half, verbose,
+                                    outstream, stat_miptime, peak_mem)) {
+            out->close();
+            return false;
+        }
+        stat_writetime -= stat_miptime - miptime;
+    } else if (clamp_half) {
         std::shared_ptr<ImageBuf> tmp(new ImageBuf);
         ImageBufAlgo::clamp(*tmp, *img, -HALF_MAX, HALF_MAX, true);
         std::swap(tmp, img);
     }
-    if (!img->write(out)) {
+    if (!streaming && !img->write(out)) {
         // ImageBuf::write transfers any errors from the ImageOutput to
         // the ImageBuf.
         errorfmt("Write failed: {}", img->geterror());
@@ -724,7 +1383,7 @@ write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
 
     stat_writetime += writetimer();
 
-    if (mipmap) {  // Mipmap levels:
+    if (mipmap && !streaming) {  // Mipmap levels:
         if (verbose)
             outstream << "  Mipmapping...\n" << std::flush;
         std::vector<std::string> mipimages;
@@ -737,6 +1396,7 @@ write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
 
         std::shared_ptr<ImageBuf> small(new ImageBuf);
         while (outspec.width > 1 || outspec.height > 1) {
+            OIIO_TRACE_ZONE("make_texture MIP level", "maketx");
             Timer miptimer;
             ImageSpec smallspec;
 
@@ -856,6 +1516,7 @@ write_mipmap(ImageBufAlgo::MakeTextureMode mode, std::shared_ptr<ImageBuf>& img,
             if (envlatlmode && src_samples_border)
                 fix_latl_edges(*small);
 
+            OIIO_TRACE_ZONE("make_texture write level", "maketx");
             Timer writetimer;
             // If the format explicitly supports MIP-maps, use that,
             // otherwise try to simulate MIP-mapping with multi-image.
@@ -971,6 +1632,71 @@ stripdir_cmd_line(string_view cmdline)
 
 
 
+// For "maketx:incremental": a SHA-1 of the bytes of the source file (which
+// is not decoded) together with everything else that decides the texture
+// made from it -- the mode, the data format and tiling, the version of
+// this library, and the config attributes other than those that only
+// affect reporting or memory use. Return the empty string if the file
+// can't be read.
+static std::string
+source_conversion_hash(string_view filename, ImageBufAlgo::MakeTextureMode mode,
+                       const ImageSpec& configspec)
+{
+    SHA1 sha;
+    FILE* file = Filesystem::fopen(filename, "rb");
+    if (!file)
+        return std::string();
+    const size_t chunk = 1 << 20;
+    std::unique_ptr<char[]> buf(new char[chunk]);
+    size_t n;
+    while ((n = fread(buf.get(), 1, chunk, file)) > 0)
+        sha.append(buf.get(), n);
+    bool ok = !ferror(file);
+    fclose(file);
+    if (!ok)
+        return std::string();
+
+    static const char* ignored[] = { "maketx:verbose",
+                                     "maketx:runstats",
+                                     "maketx:stats",
+                                     "maketx:full_command_line",
+                                     "maketx:updatemode",
+                                     "maketx:incremental",
+                                     "maketx:read_local_MB",
+                                     "maketx:stream" };
+    std::vector<const ParamValue*> attribs;
+    for (const ParamValue& p : configspec.extra_attribs)
+        if (std::find_if(std::begin(ignored), std::end(ignored),
+                         [&](const char* name) { return p.name() == name; })
+            == std::end(ignored))
+            attribs.push_back(&p);
+    // Sorted, so that the order they were set in doesn't matter
+    std::sort(attribs.begin(), attribs.end(),
+              [](const ParamValue* a, const ParamValue* b) {
+                  return a->name().string() < b->name().string();
+              });
+    sha.append(Strutil::sprintf("%s mode=%d format=%s tile=%dx%dx%d\n",
+                                OIIO_VERSION_STRING, int(mode),
+                                configspec.format, configspec.tile_width,
+                                configspec.tile_height, configspec.tile_depth));
+    for (auto p : attribs) {
+        sha.append(Strutil::sprintf("%s %s=", p->name(), p->type()));
+        if (p->type().basetype == TypeDesc::STRING) {
+            // The characters, not the addresses of the ustrings
+            for (int i = 0, n = p->nvalues() * p->type().numelements(); i < n;
+                 ++i) {
+                sha.append(p->get_ustring_indexed(i).string());
+                sha.append("\n", 1);
+            }
+        } else {
+            sha.append(p->data(), p->datasize());
+        }
+    }
+    return sha.digest();
+}
+
+
+
 static bool
 make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
                   std::string filename, std::string outputfilename,
@@ -997,6 +1723,8 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
                                           Strutil::memformat(mem));          \
     }
 
+    OIIO_TRACE_ZONE("make_texture", "maketx",
+                    ustring(outputfilename).c_str());
     ImageSpec configspec = _configspec;
 
     // Set default tile size if no specific one was requested via config
@@ -1098,6 +1826,25 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
         }
     }
 
+    // In incremental mode, skip making the texture if the output already
+    // exists and an earlier incremental run made it from identical source
+    // file contents with the same settings. Only the output's header is
+    // read, and the source is merely hashed, not decoded.
+    std::string source_hash;
+    if (configspec.get_int_attribute("maketx:incremental") && from_filename) {
+        source_hash = source_conversion_hash(src->name(), mode, configspec);
+        if (source_hash.size() && Filesystem::exists(outputfilename)) {
+            std::string lasthash;
+            if (auto in = ImageInput::open(outputfilename))
+                lasthash = in->spec().get_string_attribute("oiio:SourceHash");
+            if (lasthash == source_hash) {
+                outstream << "maketx: no update required for \""
+                          << outputfilename << "\"\n";
+                return true;
+            }
+        }
+    }
+
     bool shadowmode  = (mode == ImageBufAlgo::MakeTxShadow);
     bool envlatlmode = (mode == ImageBufAlgo::MakeTxEnvLatl
                         || mode == ImageBufAlgo::MakeTxEnvLatlFromLightProbe);
@@ -1143,6 +1890,8 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     double misc_time_1 = alltime.lap();
     STATUS("prep", misc_time_1);
     if (from_filename) {
+        OIIO_TRACE_ZONE("make_texture read", "maketx",
+                        ustring(src->name()).c_str());
         if (verbose)
             outstream << "Reading file: " << src->name() << std::endl;
         if (!src->read(0, 0, read_local)) {
@@ -1275,17 +2024,81 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     double misc_time_2 = alltime.lap();
     STATUS("misc2", misc_time_2);
 
+    // The hash is only computed for the top mipmap level of pixel data.
+    // Thus, any additional information that will affect the lower levels
+    // (such as filtering information) needs to be manually added into the
+    // hash.
+    std::ostringstream addlHashData;
+    addlHashData.imbue(
+        std::locale::classic());  // Force "C" locale with '.' decimal
+    addlHashData << configspec.get_string_attribute("maketx:filtername", "box")
+                 << " ";
+    float sharpen = configspec.get_float_attribute("maketx:sharpen", 0.0f);
+    if (sharpen != 0.0f) {
+        addlHashData << "sharpen_A=" << sharpen << " ";
+        // NB if we change the sharpening algorithm, change the letter!
+    }
+    if (configspec.get_int_attribute("maketx:highlightcomp", 0))
+        addlHashData << "highlightcomp=1 ";
+    const int sha1_blocksize = 256;
+
     // Some things require knowing a bunch about the pixel statistics.
     bool constant_color_detect = configspec.get_int_attribute(
         "maketx:constant_color_detect");
     bool opaque_detect = configspec.get_int_attribute("maketx:opaque_detect");
     bool compute_average_color
         = configspec.get_int_attribute("maketx:compute_average", 1);
-    ImageBufAlgo::PixelStats pixel_stats;
     bool compute_stats = (constant_color_detect || opaque_detect
                           || compute_average_color);
-    if (compute_stats) {
-        pixel_stats = ImageBufAlgo::computePixelStats(*src);
+    int nchannels = configspec.get_int_attribute("maketx:nchannels", -1);
+    TypeDesc srcformat = src->spec().format;
+    bool checknan      = configspec.get_int_attribute("maketx:checknan")
+                    && (srcformat.basetype == TypeDesc::FLOAT
+                        || srcformat.basetype == TypeDesc::HALF
+                        || srcformat.basetype == TypeDesc::DOUBLE);
+    bool monochrome_detect = configspec.get_int_attribute(
+                                 "maketx:monochrome_detect")
+                             && nchannels <= 0 && src->nchannels() >= 3;
+    // Only safe if the full/display window is the same as the data window.
+    bool full_window = (src->spec().x == 0 && src->spec().y == 0
+                        && src->spec().z == 0 && src->spec().full_x == 0
+                        && src->spec().full_y == 0 && src->spec().full_z == 0
+                        && src->spec().full_width == src->spec().width
+                        && src->spec().full_height == src->spec().height
+                        && src->spec().full_depth == src->spec().depth);
+    // The top level will be these very pixels -- and its hash can come from
+    // the same pass -- unless they're color converted, resized, or
+    // converted to float.
+    bool forcefloat = configspec.get_int_attribute("maketx:forcefloat", 1)
+                      || !configspec.get_int_attribute(
+                          "maketx:allow_pixel_shift");
+    bool hash_now
+        = configspec.get_int_attribute("maketx:hash", 1)
+          && configspec.get_string_attribute("maketx:incolorspace")
+                 == configspec.get_string_attribute("maketx:outcolorspace")
+          && !configspec.get_int_attribute("maketx:resize")
+          && (srcformat == TypeDesc::FLOAT || !forcefloat
+              || configspec.get_int_attribute("maketx:stream"));
+
+    // All of those analyses are done together in one pass over the pixels.
+    // They describe src only as long as its pixels don't change.
+    ImageBufAlgo::PixelStats pixel_stats;
+    pvt::PixelAnalysis analysis;
+    int analyses = (compute_stats && full_window ? pvt::AnalyzeConstant : 0)
+                   | (monochrome_detect ? pvt::AnalyzeMonochrome : 0)
+                   | (checknan ? pvt::AnalyzeNonfinite : 0)
+                   | (hash_now ? pvt::AnalyzeSHA1 : 0);
+    std::weak_ptr<ImageBuf> analyzed;
+    if (analyses || opaque_detect || compute_average_color) {
+        if (!pvt::analyze_pixels(*src, analyses, analysis,
+                                 opaque_detect || compute_average_color
+                                     ? &pixel_stats
+                                     : nullptr,
+                                 addlHashData.str(), sha1_blocksize)) {
+            errorfmt("{}", src->geterror());
+            return false;
+        }
+        analyzed = src;
     }
     double stat_pixelstatstime = alltime.lap();
     STATUS("pixelstats", stat_pixelstatstime);
@@ -1296,15 +2109,11 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     // wrap mode at runtime.
     std::vector<float> constantColor(src->nchannels());
     bool isConstantColor = false;
-    if (compute_stats && src->spec().x == 0 && src->spec().y == 0
-        && src->spec().z == 0 && src->spec().full_x == 0
-        && src->spec().full_y == 0 && src->spec().full_z == 0
-        && src->spec().full_width == src->spec().width
-        && src->spec().full_height == src->spec().height
-        && src->spec().full_depth == src->spec().depth) {
-        isConstantColor = (pixel_stats.min == pixel_stats.max);
+    if (compute_stats && full_window) {
+        isConstantColor = analysis.constant;
         if (isConstantColor)
-            constantColor = pixel_stats.min;
+            src->getpixel(src->xbegin(), src->ybegin(), src->zbegin(),
+                          constantColor.data(), src->nchannels());
         if (isConstantColor && constant_color_detect) {
             // Reset the image, to a new image, at the tile size
             ImageSpec newspec = src->spec();
@@ -1318,6 +2127,7 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
             std::string name    = std::string(src->name()) + ".constant_color";
             src->reset(name, newspec);
             ImageBufAlgo::fill(*src, &constantColor[0]);
+            analyzed.reset();
             if (verbose) {
                 outstream << "  Constant color image detected. ";
                 outstream << "Creating " << newspec.width << "x"
@@ -1326,8 +2136,6 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
         }
     }
 
-    int nchannels = configspec.get_int_attribute("maketx:nchannels", -1);
-
     // If requested -- and alpha is 1.0 everywhere -- drop it.
     if (opaque_detect && src->spec().alpha_channel == src->nchannels() - 1
         && nchannels <= 0 && pixel_stats.min[src->spec().alpha_channel] == 1.0f
@@ -1342,10 +2150,10 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     }
 
     // If requested - and we're a monochrome image - drop the extra channels
-    if (configspec.get_int_attribute("maketx:monochrome_detect")
-        && nchannels <= 0 && src->nchannels() == 3
+    // (dropping alpha doesn't change whether the color channels match).
+    if (monochrome_detect && src->nchannels() == 3
         && src->spec().alpha_channel < 0 &&  // RGB only
-        ImageBufAlgo::isMonochrome(*src)) {
+        analysis.monochrome) {
         if (verbose)
             outstream
                 << "  Monochrome image detected. Converting to single channel texture.\n";
@@ -1550,19 +2358,25 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
         errorfmt("Error fixing nans/infs.");
         return false;
     }
+    if (pixelsFixed)
+        analyzed.reset();
     if (verbose && pixelsFixed)
         outstream << "  Warning: " << pixelsFixed << " nan/inf pixels fixed.\n";
 
     // If --checknan was used and it's a floating point image, check for
     // nonfinite (NaN or Inf) values and abort if they are found.
-    if (configspec.get_int_attribute("maketx:checknan")
+    if (checknan
         && (srcspec.format.basetype == TypeDesc::FLOAT
             || srcspec.format.basetype == TypeDesc::HALF
             || srcspec.format.basetype == TypeDesc::DOUBLE)) {
         int found_nonfinite = 0;
-        ImageBufAlgo::parallel_image(get_roi(srcspec),
-                                     std::bind(check_nan_block, std::ref(*src),
-                                               _1, std::ref(found_nonfinite)));
+        if (analyzed.lock() == src)
+            found_nonfinite = int(analysis.nonfinite);
+        else
+            ImageBufAlgo::parallel_image(get_roi(srcspec),
+                                         std::bind(check_nan_block,
+                                                   std::ref(*src), _1,
+                                                   std::ref(found_nonfinite)));
         if (found_nonfinite) {
             errorfmt("maketx ERROR: Nan/Inf at {} pixels", found_nonfinite);
             return false;
@@ -1699,8 +2513,26 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     double misc_time_4 = alltime.lap();
     STATUS("misc3", misc_time_4);
 
+    // Streaming the MIP-map through a few rows of tiles at a time only
+    // covers the plain box filter downsizing of write_mipmap, and needs
+    // nothing done to the whole top level. It reads the pixels straight
+    // from src, converting to float as it goes.
+    bool nomipmap  = configspec.get_int_attribute("maketx:nomipmap") != 0;
+    bool streaming = configspec.get_int_attribute("maketx:stream") != 0
+                     && mode == ImageBufAlgo::MakeTxTexture && !do_resize
+                     && !nomipmap && !allow_shift && filtername == "box"
+                     && !orig_was_overscan && src->spec().x == 0
+                     && src->spec().y == 0 && dstspec.x == 0
+                     && dstspec.y == 0 && dstspec.depth == 1
+                     && configspec.get_float_attribute("maketx:sharpen") <= 0.0f
+                     && configspec.get_string_attribute("maketx:mipimages")
+                            .empty()
+                     && out->supports("tiles") && out->supports("mipmap");
+    if (streaming && verbose)
+        outstream << "  Streaming the MIP-map\n";
+
     std::shared_ptr<ImageBuf> toplevel;  // Ptr to top level of mipmap
-    if (!do_resize && dstspec.format == src->spec().format) {
+    if (!do_resize && (dstspec.format == src->spec().format || streaming)) {
         // No resize needed, no format conversion needed -- just stick to
         // the image we've already got
         toplevel = src;
@@ -1741,6 +2573,26 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     // master copy.  We can release src.
     src.reset();
 
+    // Prefilter the reflection lobes of an environment map, into a
+    // companion file that's renamed into place along with the texture.
+    int envlobes = 0;
+    std::string lobesfilename, lobestmpfilename;
+    if (envlatlmode && configspec.get_int_attribute("maketx:envlobes")) {
+        lobesfilename    = pvt::env_lobes_filename(outputfilename);
+        lobestmpfilename = Filesystem::unique_path(
+            Filesystem::replace_extension(lobesfilename,
+                                          ".%%%%%%%%.temp" + extension));
+        if (!write_env_lobes(*toplevel, lobestmpfilename, outformat,
+                             out_dataformat, configspec, envlobes,
+                             outstream)) {
+            Filesystem::remove(lobestmpfilename);
+            return false;
+        }
+        double stat_lobestime = alltime.lap();
+        stat_miptime += stat_lobestime;
+        STATUS("environment lobes", stat_lobestime);
+    }
+
 
     // Update the toplevel ImageDescription with the sha1 pixel hash and
     // constant color
@@ -1755,32 +2607,29 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
         Strutil::excise_string_after_head(desc, "AverageColor=");
         Strutil::excise_string_after_head(desc, "oiio:SHA-1=");
         Strutil::excise_string_after_head(desc, "SHA-1=");
+        Strutil::excise_string_after_head(desc, "oiio:SourceHash=");
         updatedDesc = true;
     }
-
-    // The hash is only computed for the top mipmap level of pixel data.
-    // Thus, any additional information that will affect the lower levels
-    // (such as filtering information) needs to be manually added into the
-    // hash.
-    std::ostringstream addlHashData;
-    addlHashData.imbue(
-        std::locale::classic());  // Force "C" locale with '.' decimal
-    addlHashData << filtername << " ";
-    float sharpen = configspec.get_float_attribute("maketx:sharpen", 0.0f);
-    if (sharpen != 0.0f) {
-        addlHashData << "sharpen_A=" << sharpen << " ";
-        // NB if we change the sharpening algorithm, change the letter!
+    // Any source hash came from the input, not from how we're making it
+    dstspec.erase_attribute("oiio:SourceHash");
+    if (source_hash.size()) {
+        if (out->supports("arbitrary_metadata")) {
+            dstspec.attribute("oiio:SourceHash", source_hash);
+        } else {
+            desc += Strutil::sprintf("%soiio:SourceHash=%s",
+                                     desc.length() ? " " : "", source_hash);
+            updatedDesc = true;
+        }
     }
-    if (configspec.get_int_attribute("maketx:highlightcomp", 0))
-        addlHashData << "highlightcomp=1 ";
 
-    const int sha1_blocksize = 256;
-    std::string hash_digest
-        = configspec.get_int_attribute("maketx:hash", 1)
-              ? ImageBufAlgo::computePixelHashSHA1(*toplevel,
-                                                   addlHashData.str(),
-                                                   ROI::All(), sha1_blocksize)
-              : "";
+    std::string hash_digest;
+    if (analyzed.lock() == toplevel && analysis.sha1.size())
+        hash_digest = analysis.sha1;
+    else if (configspec.get_int_attribute("maketx:hash", 1))
+        hash_digest = ImageBufAlgo::computePixelHashSHA1(*toplevel,
+                                                         addlHashData.str(),
+                                                         ROI::All(),
+                                                         sha1_blocksize);
     if (hash_digest.length()) {
         if (out->supports("arbitrary_metadata")) {
             dstspec.attribute("oiio:SHA-1", hash_digest);
@@ -1827,6 +2676,16 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
             outstream << "  AverageColor: " << avgstr << std::endl;
     }
 
+    if (envlobes) {
+        if (out->supports("arbitrary_metadata")) {
+            dstspec.attribute("oiio:EnvLobes", envlobes);
+        } else {
+            desc += Strutil::sprintf("%soiio:EnvLobes=%d",
+                                     desc.length() ? " " : "", envlobes);
+            updatedDesc = true;
+        }
+    }
+
     if (updatedDesc) {
         dstspec.attribute("ImageDescription", desc);
     }
@@ -1842,11 +2701,10 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
     STATUS("misc4", misc_time_5);
 
     // Write out, and compute, the mipmap levels for the specified image
-    bool nomipmap = configspec.get_int_attribute("maketx:nomipmap") != 0;
     bool ok = write_mipmap(mode, toplevel, dstspec, tmpfilename, out.get(),
                            out_dataformat, !shadowmode && !nomipmap, filtername,
                            configspec, outstream, stat_writetime, stat_miptime,
-                           peak_mem);
+                           peak_mem, streaming);
     out.reset();  // don't need it any more
 
     // If using update mode, stamp the output file with a modification time
@@ -1856,14 +2714,23 @@ make_texture_impl(ImageBufAlgo::MakeTextureMode mode, const ImageBuf* input,
 
     // Since we wrote the texture to a temp file first, now we rename it to
     // the final destination.
+    if (ok && envlobes) {
+        std::string err;
+        ok = Filesystem::rename(lobestmpfilename, lobesfilename, err);
+        if (!ok)
+            errorfmt("Could not rename file: {}", err);
+    }
     if (ok) {
         std::string err;
         ok = Filesystem::rename(tmpfilename, outputfilename, err);
         if (!ok)
             errorfmt("Could not rename file: {}", err);
     }
-    if (!ok)
+    if (!ok) {
         Filesystem::remove(tmpfilename);
+        if (envlobes)
+            Filesystem::remove(lobestmpfilename);
+    }
 
     if (verbose || configspec.get_int_attribute("maketx:runstats")
         || configspec.get_int_attribute("maketx:stats")) {
@@ -1933,6 +2800,52 @@ ImageBufAlgo::make_texture(ImageBufAlgo::MakeTextureMode mode,
 
 
 
+bool
+ImageBufAlgo::make_texture(span<MakeTextureJob> jobs, std::ostream* outstream,
+                           int njobs)
+{
+    pvt::LoggedTimer logtime("IBA::make_texture");
+    // Individual conversions are only partly parallel, so running a few
+    // at once keeps the thread pool busy through each one's serial parts.
+    if (njobs <= 0)
+        njobs = std::max(2, OIIO::get_int_attribute("threads") / 4);
+    njobs = std::min(njobs, int(jobs.size()));
+
+    std::atomic<size_t> next(0);
+    std::mutex outmutex;
+    auto worker = [&]() {
+        for (size_t j; (j = next++) < size_t(jobs.size());) {
+            MakeTextureJob& job(jobs[j]);
+            std::ostringstream jobstream;
+            OIIO::geterror();  // don't blame this job for old errors
+            job.ok     = make_texture_impl(job.mode, nullptr, job.filename,
+                                           job.outputfilename, job.config,
+                                           &jobstream);
+            job.errors = job.ok ? std::string() : OIIO::geterror();
+            if (outstream) {
+                std::lock_guard<std::mutex> lock(outmutex);
+                *outstream << jobstream.str();
+                if (!job.ok)
+                    *outstream << "make_texture ERROR: " << job.errors
+                               << "\n";
+                outstream->flush();
+            }
+        }
+    };
+    thread_group threads;
+    for (int i = 1; i < njobs; ++i)
+        threads.create_thread(worker);
+    worker();
+    threads.join_all();
+
+    bool ok = true;
+    for (auto& job : jobs)
+        ok &= job.ok;
+    return ok;
+}
+
+
+
 bool
 ImageBufAlgo::make_texture(ImageBufAlgo::MakeTextureMode mode,
                            const ImageBuf& input, string_view outputfilename,
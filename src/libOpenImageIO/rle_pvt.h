@@ -0,0 +1,204 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <OpenImageIO/imageio.h>
+
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+// Run length decoding shared by the Targa, SGI, IFF and RLA readers. All
+// of them use PackBits-style packets: a header giving a count and whether
+// the packet is a run (one element, repeated) or a literal (that many
+// elements, copied verbatim). They only differ in how the header is
+// spelled, which is what the header functors below describe.
+namespace RLE_pvt {
+
+/// Targa and IFF: one header byte, the count is the low 7 bits plus one,
+/// and the high bit is set for a run.
+struct RunBitHeader {
+    static constexpr size_t size = 1;
+    size_t operator()(const uint8_t* h, bool& run) const
+    {
+        run = (h[0] & 0x80) != 0;
+        return size_t(h[0] & 0x7f) + 1;
+    }
+};
+
+/// SGI: one header byte, or a big-endian 16 bit word for 16 bit channels.
+/// The count is the low 7 bits, the high bit is set for a literal, and a
+/// count of zero ends the data.
+struct LiteralBitHeader {
+    size_t size = 1;
+    size_t operator()(const uint8_t* h, bool& run) const
+    {
+        uint8_t b = h[size - 1];
+        run       = (b & 0x80) == 0;
+        return b & 0x7f;
+    }
+};
+
+/// RLA: one signed header byte, n >= 0 is a run of n+1 elements and
+/// n < 0 a literal of -n elements.
+struct SignedHeader {
+    static constexpr size_t size = 1;
+    size_t operator()(const uint8_t* h, bool& run) const
+    {
+        int n = int8_t(h[0]);
+        run   = n >= 0;
+        return run ? size_t(n) + 1 : size_t(-n);
+    }
+};
+
+
+
+/// Write `n` copies of the `elemsize` byte element `value`, `stride`
+/// bytes apart.
+inline void
+fill(uint8_t* out, const uint8_t* value, size_t n, size_t elemsize,
+     size_t stride)
+{
+    if (elemsize == 1) {
+        if (stride == 1)
+            memset(out, *value, n);
+        else
+            for (size_t i = 0; i < n; ++i, out += stride)
+                *out = *value;
+    } else if (stride == elemsize) {
+        // Contiguous: seed one element, then keep doubling what's there
+        memcpy(out, value, elemsize);
+        size_t done = 1;
+        while (done < n) {
+            size_t m = std::min(done, n - done);
+            memcpy(out + done * elemsize, out, m * elemsize);
+            done += m;
+        }
+    } else {
+        for (size_t i = 0; i < n; ++i, out += stride)
+            memcpy(out, value, elemsize);
+    }
+}
+
+
+
+/// Copy `n` packed elements of `elemsize` bytes to `out`, `stride` bytes
+/// apart.
+inline void
+copy(uint8_t* out, const uint8_t* in, size_t n, size_t elemsize,
+     size_t stride)
+{
+    if (stride == elemsize)
+        memcpy(out, in, n * elemsize);
+    else if (elemsize == 1)
+        for (size_t i = 0; i < n; ++i, out += stride)
+            *out = in[i];
+    else
+        for (size_t i = 0; i < n; ++i, in += elemsize, out += stride)
+            memcpy(out, in, elemsize);
+}
+
+
+
+/// Expand packets from `in[0..inlen-1]` until `n` (> 0) elements of
+/// `elemsize` bytes have been written to `out`, `stride` bytes apart (0
+/// means packed). The first `skip` elements of the first packet are
+/// dropped, so that a decode may start in the middle of a packet found by
+/// index_rows(). A packet straddling the end of the output is consumed
+/// up to its last used element if it's a literal, and entirely if it's a
+/// run. Return the number of bytes consumed, or 0 if the data is
+/// truncated, malformed, or ends before `n` elements were produced.
+template<class Header>
+inline size_t
+decode(const Header& header, const uint8_t* in, size_t inlen, uint8_t* out,
+       size_t n, size_t elemsize = 1, size_t stride = 0, size_t skip = 0)
+{
+    if (!stride)
+        stride = elemsize;
+    const size_t hsize = header.size;
+    size_t pos         = 0;
+    while (n) {
+        if (inlen - pos < hsize)
+            return 0;
+        bool run;
+        size_t count = header(in + pos, run);
+        pos += hsize;
+        if (count <= skip)
+            return 0;
+        if (!run)
+            pos += skip * elemsize;
+        count -= skip;
+        skip     = 0;
+        size_t m = std::min(count, n);
+        if (run) {
+            if (pos > inlen || inlen - pos < elemsize)
+                return 0;
+            fill(out, in + pos, m, elemsize, stride);
+            pos += elemsize;
+        } else {
+            if (pos > inlen || inlen - pos < m * elemsize)
+                return 0;
+            copy(out, in + pos, m, elemsize, stride);
+            pos += m * elemsize;
+        }
+        out += m * stride;
+        n -= m;
+    }
+    return pos;
+}
+
+
+
+/// Where a row starts in a stream whose packets may cross rows: the
+/// offset of the packet holding its first element, and how many elements
+/// of that packet belong to earlier rows.
+struct RowStart {
+    size_t offset = 0;
+    size_t skip   = 0;
+};
+
+/// Find the start of each of `nrows` rows of `rowlen` elements in the
+/// packets of `in[0..inlen-1]`. Only the packet headers are visited, so
+/// this single serial pass is cheap next to decode(), and lets the rows
+/// then be decoded independently. Return false if the data is truncated
+/// or malformed.
+template<class Header>
+inline bool
+index_rows(const Header& header, const uint8_t* in, size_t inlen,
+           size_t elemsize, size_t rowlen, size_t nrows, RowStart* rows)
+{
+    const size_t hsize = header.size;
+    const size_t total = rowlen * nrows;
+    size_t pos         = 0;  // byte offset of the packet
+    size_t elem        = 0;  // index of its first element
+    size_t row         = 0;
+    while (elem < total) {
+        if (pos > inlen || inlen - pos < hsize)
+            return false;
+        bool run;
+        size_t count = header(in + pos, run);
+        if (!count)
+            return false;
+        for (; row < nrows && row * rowlen < elem + count; ++row) {
+            rows[row].offset = pos;
+            rows[row].skip   = row * rowlen - elem;
+        }
+        // The last packet only needs to hold the elements we'll use
+        size_t used = run ? 1 : std::min(count, total - elem);
+        if (inlen - pos - hsize < used * elemsize)
+            return false;
+        pos += hsize + (run ? 1 : count) * elemsize;
+        elem += count;
+    }
+    return true;
+}
+
+}  // namespace RLE_pvt
+
+OIIO_PLUGIN_NAMESPACE_END
@@ -0,0 +1,401 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+// This file is compiled more than once: on its own, with the flags of the
+// build (the "baseline"), and, via simd_kernels_avx2.cpp and
+// simd_kernels_avx512.cpp, with the compiler flags for those ISA levels.
+// simd.h picks its widest vectors from the compiler flags, so the same
+// source becomes a kernel table per level, and simd_kernels() picks one
+// at runtime.
+//
+// Everything compiled per level lives in an anonymous namespace and is
+// built only from simd.h's force-inlined operations. That matters: an
+// out-of-line inline function instantiated here with AVX-512 enabled
+// could otherwise be the copy the linker keeps for the whole library.
+
+#include <atomic>
+#include <cstring>
+#include <limits>
+#include <type_traits>
+
+#include <OpenImageIO/Imath.h>
+#include <OpenImageIO/platform.h>
+#include <OpenImageIO/simd.h>
+#if !OIIO_F16C_ENABLED
+// Only for the (not inline) bulk half conversions
+#    include <OpenImageIO/fmath.h>
+#endif
+
+#include "simd_kernels_pvt.h"
+
+#ifndef OIIO_SIMD_KERNELS_ISA
+#    define OIIO_SIMD_KERNELS_ISA baseline
+#endif
+#define OIIO_SIMD_KERNELS_TABLE_(isa) simd_kernels_##isa
+#define OIIO_SIMD_KERNELS_TABLE(isa) OIIO_SIMD_KERNELS_TABLE_(isa)
+#define OIIO_SIMD_KERNELS_NAME_(isa) #isa
+#define OIIO_SIMD_KERNELS_NAME(isa) OIIO_SIMD_KERNELS_NAME_(isa)
+
+
+OIIO_NAMESPACE_BEGIN
+
+namespace {
+
+#if OIIO_SIMD_AVX >= 512
+typedef simd::vfloat16 vfloatN;
+typedef simd::vint16 vintN;
+#elif OIIO_SIMD_AVX
+typedef simd::vfloat8 vfloatN;
+typedef simd::vint8 vintN;
+#else
+typedef simd::vfloat4 vfloatN;
+typedef simd::vint4 vintN;
+#endif
+constexpr size_t W = vfloatN::elements;
+
+
+
+// Apply `op`, which converts W values from src to dst, to `n` values. A
+// partial vector at the end goes through zero-padded buffers, so that it
+// gets exactly the same arithmetic as the rest.
+template<typename S, typename D, typename OP>
+OIIO_FORCEINLINE void
+convert_loop(const S* src, D* dst, size_t n, OP op)
+{
+    for (; n >= W; n -= W, src += W, dst += W)
+        op(src, dst);
+    if (n) {
+        alignas(64) char sbuf[W * sizeof(S)] = {};
+        alignas(64) char dbuf[W * sizeof(D)];
+        memcpy(sbuf, src, n * sizeof(S));
+        op((const S*)sbuf, (D*)dbuf);
+        memcpy(dst, dbuf, n * sizeof(D));
+    }
+}
+
+
+
+// Normalized unsigned integer, or half, to float
+template<typename S>
+void
+to_float(const void* src, void* dst, size_t n)
+{
+    const vfloatN scale(std::is_integral<S>::value
+                            ? 1.0f / float(std::numeric_limits<S>::max())
+                            : 1.0f);
+    convert_loop((const S*)src, (float*)dst, n, [&](const S* s, float* d) {
+        vfloatN v;
+        v.load(s);
+        (v * scale).store(d);
+    });
+}
+
+
+
+// Float or half to normalized unsigned integer, rounding and clamping the
+// same way as convert_type<float,D>: truncating x*max+0.5. (simd::round
+// would round halfway cases differently depending on the vector width.)
+template<typename S, typename D>
+void
+to_uint(const void* src, void* dst, size_t n)
+{
+    const vfloatN max(float(std::numeric_limits<D>::max()));
+    const vfloatN zero(0.0f), half_one(0.5f);
+    convert_loop((const S*)src, (D*)dst, n, [&](const S* s, D* d) {
+        vfloatN v;
+        v.load(s);
+        vfloatN scaled = v * max + half_one;
+        vintN(simd::min(simd::max(scaled, zero), max)).store(d);
+    });
+}
+
+
+
+// Float to uint8, like to_uint<float,uint8_t>, adding the dither to each
+// value first.
+void
+to_uint8_dither(const float* src, const float* dither, uint8_t* dst, size_t n)
+{
+    const vfloatN max(255.0f), zero(0.0f), half_one(0.5f);
+    auto op = [&](const float* s, const float* d, uint8_t* o) {
+        vfloatN v, dv;
+        v.load(s);
+        dv.load(d);
+        vfloatN scaled = (v + dv) * max + half_one;
+        vintN(simd::min(simd::max(scaled, zero), max)).store(o);
+    };
+    for (; n >= W; n -= W, src += W, dither += W, dst += W)
+        op(src, dither, dst);
+    if (n) {
+        alignas(64) float sbuf[W] = {}, dbuf[W] = {};
+        alignas(64) uint8_t obuf[W];
+        memcpy(sbuf, src, n * sizeof(float));
+        memcpy(dbuf, dither, n * sizeof(float));
+        op(sbuf, dbuf, obuf);
+        memcpy(dst, obuf, n);
+    }
+}
+
+
+
+// bjhash::bjfinal of W sets of values at once
+OIIO_FORCEINLINE vintN
+bjfinal(vintN a, vintN b, vintN c)
+{
+    c ^= b;
+    c -= simd::rotl(b, 14);
+    a ^= c;
+    a -= simd::rotl(c, 11);
+    b ^= a;
+    b -= simd::rotl(a, 25);
+    c ^= b;
+    c -= simd::rotl(b, 16);
+    a ^= c;
+    a -= simd::rotl(c, 4);
+    b ^= a;
+    b -= simd::rotl(a, 14);
+    c ^= b;
+    c -= simd::rotl(b, 24);
+    return c;
+}
+
+
+
+// The noise hash of a run of pixels of one scanline: the low 20 bits of
+// bjfinal(bjfinal(x, y, z), c, seed), scaled to [0,1). Being a function of
+// the coordinates alone, it's the same however the image is divided up.
+void
+hashrand(int x, int y, int z, int c, int seed, float* dst, size_t n)
+{
+    const int magic = 0xfffff;
+    const vintN yv(y), zv(z), cv(c), seedv(seed), mask(magic);
+    const vfloatN scale(1.0f / (magic + 1));
+    auto op = [&](int x, float* d) {
+        vintN h = bjfinal(bjfinal(vintN::Iota(x), yv, zv), cv, seedv);
+        (vfloatN(h & mask) * scale).store(d);
+    };
+    for (; n >= W; n -= W, x += int(W), dst += W)
+        op(x, dst);
+    if (n) {
+        alignas(64) float buf[W];
+        op(x, buf);
+        memcpy(dst, buf, n * sizeof(float));
+    }
+}
+
+
+
+// Is the float, half or double at `p` a NaN or Inf, i.e., are all of its
+// exponent bits set?
+template<typename T>
+OIIO_FORCEINLINE bool
+nonfinite_bits(const T* p)
+{
+    typedef typename std::conditional<
+        sizeof(T) == 2, uint16_t,
+        typename std::conditional<sizeof(T) == 4, uint32_t,
+                                  uint64_t>::type>::type bits_t;
+    const bits_t exp = sizeof(T) == 2   ? bits_t(0x7c00)
+                       : sizeof(T) == 4 ? bits_t(0x7f800000)
+                                        : bits_t(0x7ff0000000000000ULL);
+    bits_t b;
+    memcpy(&b, p, sizeof(T));
+    return (b & exp) == exp;
+}
+
+
+
+// Find the first NaN or Inf of `n` values of type T. The values are tested
+// W 32 bit words at a time for all exponent bits set where one would
+// be: the exponent of a float, of either half of a pair, or of the high
+// word of a double (for which a low word can also match, so a hit is
+// always confirmed one value at a time). Clean data costs one pass of
+// vector ands and compares.
+template<typename T>
+size_t
+find_nonfinite(const void* src, size_t n)
+{
+    const T* p      = (const T*)src;
+    const size_t NB = W * 4 / sizeof(T);  // values per vector
+    const int m1    = sizeof(T) == 2 ? 0x7c00
+                      : sizeof(T) == 4 ? 0x7f800000 : 0x7ff00000;
+    const int m2    = sizeof(T) == 2 ? 0x7c000000 : m1;
+    const vintN mask1(m1), mask2(m2);
+    size_t i = 0;
+    for (; i + NB <= n; i += NB) {
+        vintN v((const int*)(p + i));
+        if (OIIO_UNLIKELY(any(((v & mask1) == mask1)
+                              | ((v & mask2) == mask2)))) {
+            for (size_t j = i; j < i + NB; ++j)
+                if (nonfinite_bits(p + j))
+                    return j;
+        }
+    }
+    for (; i < n; ++i)
+        if (nonfinite_bits(p + i))
+            return i;
+    return n;
+}
+
+
+
+// Float, or normalized unsigned integer, to half
+template<typename S>
+void
+to_half(const void* src, void* dst, size_t n)
+{
+    const vfloatN scale(std::is_integral<S>::value
+                            ? 1.0f / float(std::numeric_limits<S>::max())
+                            : 1.0f);
+    convert_loop((const S*)src, (half*)dst, n, [&](const S* s, half* d) {
+        vfloatN v;
+        v.load(s);
+        (v * scale).store(d);
+    });
+}
+
+
+
+#if OIIO_F16C_ENABLED
+constexpr pvt::ConvertKernel half_to_float_kernel = to_float<half>;
+constexpr pvt::ConvertKernel float_to_half_kernel = to_half<float>;
+#else
+// Without F16C at this level, simd.h converts half values one at a time,
+// but the bulk conversions of fmath.h can still use it (or NEON), if the
+// running CPU has it.
+void
+half_to_float_kernel(const void* src, void* dst, size_t n)
+{
+    convert_half_to_float(cspan<half>((const half*)src, n),
+                          span<float>((float*)dst, n));
+}
+
+void
+float_to_half_kernel(const void* src, void* dst, size_t n)
+{
+    convert_float_to_half(cspan<float>((const float*)src, n),
+                          span<half>((half*)dst, n));
+}
+#endif
+
+}  // namespace
+
+
+
+namespace pvt {
+
+extern const SimdKernels OIIO_SIMD_KERNELS_TABLE(OIIO_SIMD_KERNELS_ISA);
+
+const SimdKernels OIIO_SIMD_KERNELS_TABLE(OIIO_SIMD_KERNELS_ISA) = {
+    OIIO_SIMD_KERNELS_NAME(OIIO_SIMD_KERNELS_ISA),
+    to_float<uint8_t>,
+    to_float<uint16_t>,
+    half_to_float_kernel,
+    to_uint<float, uint8_t>,
+    to_uint<float, uint16_t>,
+    float_to_half_kernel,
+    to_half<uint8_t>,
+    to_half<uint16_t>,
+    to_uint<half, uint8_t>,
+    to_uint<half, uint16_t>,
+    to_uint8_dither,
+    hashrand,
+    find_nonfinite<float>,
+    find_nonfinite<half>,
+    find_nonfinite<double>,
+};
+
+}  // namespace pvt
+
+
+
+// The dispatcher itself is only compiled once, with the baseline flags.
+#ifndef OIIO_SIMD_KERNELS_WRAPPED
+
+namespace pvt {
+
+#if OIIO_SIMD_DISPATCH_AVX2
+extern const SimdKernels simd_kernels_avx2;
+#endif
+#if OIIO_SIMD_DISPATCH_AVX512
+extern const SimdKernels simd_kernels_avx512;
+#endif
+
+}  // namespace pvt
+
+namespace {
+
+// Return the kernels for the named level if they were compiled and this
+// machine can run them, otherwise nullptr.
+static const pvt::SimdKernels*
+kernels_for(string_view isa)
+{
+    if (isa == "baseline")
+        return &pvt::simd_kernels_baseline;
+#if OIIO_SIMD_DISPATCH_AVX2
+    if (isa == "avx2")
+        return (cpu_has_avx2() && cpu_has_fma() && cpu_has_f16c()
+                && os_saves_xstate(0x6))
+                   ? &pvt::simd_kernels_avx2
+                   : nullptr;
+#endif
+#if OIIO_SIMD_DISPATCH_AVX512
+    if (isa == "avx512")
+        return (cpu_has_avx512f() && cpu_has_avx512dq() && cpu_has_avx512bw()
+                && cpu_has_avx512vl() && cpu_has_avx2() && cpu_has_fma()
+                && cpu_has_f16c() && os_saves_xstate(0xe6))
+                   ? &pvt::simd_kernels_avx512
+                   : nullptr;
+#endif
+    return nullptr;
+}
+
+
+
+static const pvt::SimdKernels*
+best_kernels()
+{
+    for (string_view isa : { "avx512", "avx2" })
+        if (const pvt::SimdKernels* k = kernels_for(isa))
+            return k;
+    return &pvt::simd_kernels_baseline;
+}
+
+
+
+static std::atomic<const pvt::SimdKernels*> current_kernels(nullptr);
+
+}  // namespace
+
+
+
+const pvt::SimdKernels&
+pvt::simd_kernels() noexcept
+{
+    const SimdKernels* k = current_kernels.load(std::memory_order_acquire);
+    if (OIIO_UNLIKELY(!k)) {
+        // Racing threads all pick the same table, so it's fine if several
+        // of them get here.
+        k = best_kernels();
+        current_kernels.store(k, std::memory_order_release);
+    }
+    return *k;
+}
+
+
+
+bool
+pvt::set_simd_dispatch(string_view isa)
+{
+    const SimdKernels* k = (isa.empty() || isa == "auto") ? best_kernels()
+                                                          : kernels_for(isa);
+    if (!k)
+        return false;
+    current_kernels.store(k, std::memory_order_release);
+    return true;
+}
+
+#endif /* ifndef OIIO_SIMD_KERNELS_WRAPPED */
+
+OIIO_NAMESPACE_END
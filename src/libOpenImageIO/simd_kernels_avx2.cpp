@@ -0,0 +1,10 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+// The kernels of simd_kernels.cpp, compiled with the flags for AVX2
+// (set in CMakeLists.txt).
+
+#define OIIO_SIMD_KERNELS_ISA avx2
+#define OIIO_SIMD_KERNELS_WRAPPED 1
+#include "simd_kernels.cpp"
@@ -0,0 +1,67 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <OpenImageIO/oiioversion.h>
+#include <OpenImageIO/string_view.h>
+
+
+OIIO_NAMESPACE_BEGIN
+
+namespace pvt {
+
+// Convert `n` contiguous values from one type to another.
+typedef void (*ConvertKernel)(const void* src, void* dst, size_t n);
+
+// Convert `n` contiguous floats to uint8 like float_to_uint8, after adding
+// dither[i] to src[i] (exactly as if it had been added to the floats first).
+typedef void (*DitherKernel)(const float* src, const float* dither,
+                             uint8_t* dst, size_t n);
+
+// Fill dst[i], for i in [0,n), with the uniform [0,1) value that
+// ImageBufAlgo::noise hashes from pixel (x+i, y, z), channel c and seed.
+typedef void (*HashRandKernel)(int x, int y, int z, int c, int seed,
+                               float* dst, size_t n);
+
+// Return the index of the first of `n` contiguous float, half or double
+// values that is a NaN or Inf, or `n` if they are all finite.
+typedef size_t (*FindNonfiniteKernel)(const void* p, size_t n);
+
+// The hot kernels that are compiled once for each x86 ISA level we
+// dispatch among (see simd_kernels.cpp), so that one build can use AVX2 or
+// AVX-512 where the running CPU has it, whatever the baseline it was
+// compiled for. Results are identical at every level.
+struct SimdKernels {
+    const char* isa;  // "baseline", "avx2", or "avx512"
+
+    // Normalized integer or half <-> float, rounding and clamping like
+    // convert_type.
+    ConvertKernel uint8_to_float, uint16_to_float, half_to_float;
+    ConvertKernel float_to_uint8, float_to_uint16, float_to_half;
+    ConvertKernel uint8_to_half, uint16_to_half;
+    ConvertKernel half_to_uint8, half_to_uint16;
+    DitherKernel float_to_uint8_dither;
+    HashRandKernel hashrand;
+    FindNonfiniteKernel find_nonfinite_float, find_nonfinite_half;
+    FindNonfiniteKernel find_nonfinite_double;
+};
+
+// The kernels to use: the highest level that was compiled and that the
+// CPU and OS support, unless lowered by set_simd_dispatch().
+const SimdKernels&
+simd_kernels() noexcept;
+
+// Use the kernels for the named level ("baseline", "avx2", "avx512"), or
+// the best available one if `isa` is "" or "auto". Return false (and
+// change nothing) if the level wasn't compiled or the CPU can't run it.
+bool
+set_simd_dispatch(string_view isa);
+
+}  // namespace pvt
+
+OIIO_NAMESPACE_END
@@ -0,0 +1,346 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/typedesc.h>
+#include <OpenImageIO/ustring.h>
+
+#include "imageio_pvt.h"
+
+
+// The spec cache is a directory of small files, one per image file, each
+// holding the ImageSpec of every subimage and MIP level of the image in its
+// ImageSpec::SerialBinary encoding. The entries are keyed by the image's
+// absolute path, size, modification time and the configuration hints it
+// was opened with, so an entry is simply never found again once the file
+// changes. Entries are written to a temporary name and renamed into place,
+// so that any number of processes may share the directory without locking.
+
+OIIO_NAMESPACE_BEGIN
+
+namespace {
+
+static const char spec_cache_magic[] = "OIIOSPEC";
+static const uint32_t spec_cache_version = 2;
+
+
+
+// Append-only binary encoding
+class Writer {
+public:
+    template<class T> void put(const T& v)
+    {
+        m_buf.append((const char*)&v, sizeof(T));
+    }
+    void put(string_view s)
+    {
+        put(uint32_t(s.size()));
+        m_buf.append(s.data(), s.size());
+    }
+    std::string& str() { return m_buf; }
+
+private:
+    std::string m_buf;
+};
+
+
+
+// Decoding of what Writer produced. Any read past the end, or of values
+// that make no sense, clears ok() and from then on yields zeroes.
+class Reader {
+public:
+    Reader(string_view buf)
+        : m_buf(buf)
+    {
+    }
+    template<class T> void get(T& v)
+    {
+        if (!need(sizeof(T))) {
+            v = T();
+            return;
+        }
+        memcpy((void*)&v, m_buf.data() + m_pos, sizeof(T));
+        m_pos += sizeof(T);
+    }
+    void get(std::string& s)
+    {
+        uint32_t len = 0;
+        get(len);
+        s.clear();
+        if (need(len)) {
+            s.assign(m_buf.data() + m_pos, len);
+            m_pos += len;
+        }
+    }
+    // Consume `s` verbatim, or fail
+    bool expect(string_view s)
+    {
+        if (need(s.size()) && m_buf.substr(m_pos, s.size()) == s)
+            m_pos += s.size();
+        else
+            m_ok = false;
+        return m_ok;
+    }
+    bool ok() const { return m_ok; }
+    bool at_end() const { return m_pos == m_buf.size(); }
+
+private:
+    bool need(size_t n)
+    {
+        if (m_ok && m_buf.size() - m_pos < n)
+            m_ok = false;
+        return m_ok;
+    }
+    string_view m_buf;
+    size_t m_pos = 0;
+    bool m_ok    = true;
+};
+
+
+
+// The key of an entry: everything that, if changed, could change what the
+// image's reader reports. Empty if the file isn't a plain file we can
+// stat, or the configuration can't be serialized.
+static std::string
+spec_cache_key(string_view filename, const ImageSpec* config)
+{
+    uint64_t size = Filesystem::file_size(filename);
+    if (size == uint64_t(-1) || !Filesystem::is_regular(filename))
+        return {};
+    if (config) {
+        for (auto& p : config->extra_attribs)
+            if (p.type().basetype == TypeDesc::PTR)
+                return {};  // e.g. an IOProxy, the file isn't the source
+    }
+    std::string path(filename);
+    if (!Filesystem::path_is_absolute(path))
+        path = Filesystem::current_path() + "/" + path;
+    Writer key;
+    key.put(string_view(OIIO_VERSION_STRING));
+    key.put(string_view(path));
+    key.put(size);
+    key.put(int64_t(Filesystem::last_write_time(filename)));
+    key.put(uint32_t(config != nullptr));
+    if (config)
+        key.put(string_view(config->serialize(ImageSpec::SerialBinary)));
+    return std::move(key.str());
+}
+
+
+
+static std::string
+spec_cache_entry(const std::string& dir, const std::string& key)
+{
+    return Strutil::fmt::format("{}/{:016x}.spec", dir, Strutil::strhash(key));
+}
+
+
+
+// The ImageInput handed out by ImageInput::open_header(): it answers
+// seek_subimage() and spec() from a list of specs, and reads no pixels.
+class HeaderOnlyInput final : public ImageInput {
+public:
+    HeaderOnlyInput(std::vector<std::vector<ImageSpec>>&& specs,
+                    string_view format_name, string_view filename)
+        : m_specs(std::move(specs))
+        , m_format(format_name)
+        , m_filename(filename)
+    {
+        seek_subimage(0, 0);
+    }
+    const char* format_name(void) const override { return m_format.c_str(); }
+    bool open(const std::string& name, ImageSpec& newspec) override
+    {
+        errorfmt("\"{}\": a header-only input can't be reopened", name);
+        return false;
+    }
+    bool close() override { return true; }
+    int current_subimage(void) const override
+    {
+        lock_guard lock(*this);
+        return m_subimage;
+    }
+    int current_miplevel(void) const override
+    {
+        lock_guard lock(*this);
+        return m_miplevel;
+    }
+    bool seek_subimage(int subimage, int miplevel) override
+    {
+        lock_guard lock(*this);
+        if (subimage < 0 || subimage >= int(m_specs.size()) || miplevel < 0
+            || miplevel >= int(m_specs[subimage].size()))
+            return false;
+        m_subimage = subimage;
+        m_miplevel = miplevel;
+        m_spec     = m_specs[subimage][miplevel];
+        return true;
+    }
+    bool read_native_scanline(int /*subimage*/, int /*miplevel*/, int /*y*/,
+                              int /*z*/, void* /*data*/) override
+    {
+        errorfmt("\"{}\": only the header was read, not the pixels",
+                 m_filename);
+        return false;
+    }
+    bool read_native_tile(int /*subimage*/, int /*miplevel*/, int /*x*/,
+                          int /*y*/, int /*z*/, void* /*data*/) override
+    {
+        errorfmt("\"{}\": only the header was read, not the pixels",
+                 m_filename);
+        return false;
+    }
+
+private:
+    std::vector<std::vector<ImageSpec>> m_specs;
+    std::string m_format;
+    std::string m_filename;
+    int m_subimage = -1;
+    int m_miplevel = -1;
+};
+
+}  // namespace
+
+
+
+bool
+pvt::spec_cache_lookup(string_view filename, const ImageSpec* config,
+                       std::vector<std::vector<ImageSpec>>& specs,
+                       std::string& format_name)
+{
+    std::string dir = spec_cache_dir.string();
+    if (dir.empty())
+        return false;
+    std::string key = spec_cache_key(filename, config);
+    if (key.empty())
+        return false;
+    std::string entry = spec_cache_entry(dir, key);
+    uint64_t size     = Filesystem::file_size(entry);
+    if (size == uint64_t(-1) || size > (64 << 20))
+        return false;
+    std::string buf(size_t(size), '\0');
+    if (Filesystem::read_bytes(entry, &buf[0], buf.size()) != buf.size())
+        return false;
+
+    Reader in(buf);
+    uint32_t version = 0;
+    std::string storedkey;
+    in.expect(spec_cache_magic);
+    in.get(version);
+    in.get(storedkey);
+    if (!in.ok() || version != spec_cache_version || storedkey != key)
+        return false;  // stale, damaged, or a hash collision
+    std::string format;
+    uint32_t nsubimages = 0;
+    in.get(format);
+    in.get(nsubimages);
+    std::vector<std::vector<ImageSpec>> result;
+    std::string spec;
+    for (uint32_t s = 0; s < nsubimages && in.ok(); ++s) {
+        uint32_t nlevels = 0;
+        in.get(nlevels);
+        if (!nlevels)
+            return false;
+        result.emplace_back();
+        for (uint32_t m = 0; m < nlevels && in.ok(); ++m) {
+            in.get(spec);
+            result.back().emplace_back();
+            if (!result.back().back().from_binary(spec))
+                return false;
+        }
+    }
+    if (!in.ok() || !in.at_end() || result.empty())
+        return false;
+    specs.swap(result);
+    format_name.swap(format);
+    return true;
+}
+
+
+
+void
+pvt::spec_cache_store(string_view filename, const ImageSpec* config,
+                      const std::vector<std::vector<ImageSpec>>& specs,
+                      string_view format_name)
+{
+    std::string dir = spec_cache_dir.string();
+    if (dir.empty() || specs.empty())
+        return;
+    std::string key = spec_cache_key(filename, config);
+    if (key.empty())
+        return;
+    Writer out;
+    out.str() = spec_cache_magic;
+    out.put(spec_cache_version);
+    out.put(string_view(key));
+    out.put(format_name);
+    out.put(uint32_t(specs.size()));
+    for (auto& levels : specs) {
+        out.put(uint32_t(levels.size()));
+        for (auto& spec : levels)
+            out.put(string_view(spec.serialize(ImageSpec::SerialBinary)));
+    }
+
+    // Failing to write the cache is never an error, it just stays cold
+    if (!Filesystem::is_directory(dir))
+        Filesystem::create_directory(dir);
+    std::string entry = spec_cache_entry(dir, key);
+    std::string tmp   = Strutil::fmt::format("{}/{}", dir,
+                                           Filesystem::unique_path(
+                                               "%%%%%%%%%%%%.tmp"));
+    if (Filesystem::write_binary_file(tmp, cspan<char>(out.str().data(),
+                                                       out.str().size()))) {
+        std::string err;
+        if (Filesystem::rename(tmp, entry, err))
+            return;
+    }
+    Filesystem::remove(tmp);
+}
+
+
+
+std::unique_ptr<ImageInput>
+pvt::header_only_input(std::vector<std::vector<ImageSpec>>&& specs,
+                       string_view format_name, string_view filename)
+{
+    return std::unique_ptr<ImageInput>(
+        new HeaderOnlyInput(std::move(specs), format_name, filename));
+}
+
+
+
+ImageInput::unique_ptr
+ImageInput::open_header(const std::string& filename, const ImageSpec* config)
+{
+    std::vector<std::vector<ImageSpec>> specs;
+    std::string format;
+    if (pvt::spec_cache_lookup(filename, config, specs, format))
+        return pvt::header_only_input(std::move(specs), format, filename);
+
+    auto in = ImageInput::open(filename, config);
+    if (!in)
+        return {};
+    for (int s = 0; in->seek_subimage(s, 0); ++s) {
+        specs.emplace_back();
+        for (int m = 0; in->seek_subimage(s, m); ++m)
+            specs.back().push_back(in->spec());
+    }
+    format = in->format_name();
+    in->close();
+    if (specs.empty()) {
+        pvt::errorfmt("\"{}\": no subimages could be read", filename);
+        return {};
+    }
+    pvt::spec_cache_store(filename, config, specs, format);
+    return pvt::header_only_input(std::move(specs), format, filename);
+}
+
+OIIO_NAMESPACE_END
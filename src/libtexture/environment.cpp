@@ -8,6 +8,7 @@
 #include <sstream>
 #include <string>
 
+#include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filter.h>
 #include <OpenImageIO/fmath.h>
@@ -206,6 +207,49 @@ namespace {  // anonymous
 
 static EightBitConverter<float> uchar2float;
 
+
+// fast_atan2() from fmath.h for a whole batch of lanes at once.
+inline Tex::FloatWide
+atan2_wide(const Tex::FloatWide& y, const Tex::FloatWide& x)
+{
+    using Tex::FloatWide;
+    FloatWide a = abs(x), b = abs(y);
+    FloatWide k = safe_div(min(a, b), max(a, b));
+    FloatWide t = k * k;
+    FloatWide r = k * (0.430165678f * t + 1.0f)
+                  / ((0.0579354987f * t + 0.763007998f) * t + 1.0f);
+    r = blend(r, float(M_PI_2) - r, b > a);  // account for arg reduction
+    r = blend(r, float(M_PI) - r, x < 0.0f);
+    return blend(r, -r, y < 0.0f);
+}
+
+
+// Normalize a batch of vectors, leaving zero-length ones zero.
+inline void
+normalize_wide(Tex::FloatWide& x, Tex::FloatWide& y, Tex::FloatWide& z)
+{
+    Tex::FloatWide len = sqrt(x * x + y * y + z * z);
+    x                  = safe_div(x, len);
+    y                  = safe_div(y, len);
+    z                  = safe_div(z, len);
+}
+
+
+// Angle between two batches of unit vectors. atan2 of the cross and dot
+// products stays accurate for the tiny angles typical of ray
+// differentials, where acos of the dot product does not.
+inline Tex::FloatWide
+angle_wide(const Tex::FloatWide& ax, const Tex::FloatWide& ay,
+           const Tex::FloatWide& az, const Tex::FloatWide& bx,
+           const Tex::FloatWide& by, const Tex::FloatWide& bz)
+{
+    Tex::FloatWide cx = ay * bz - az * by;
+    Tex::FloatWide cy = az * bx - ax * bz;
+    Tex::FloatWide cz = ax * by - ay * bx;
+    return atan2_wide(sqrt(cx * cx + cy * cy + cz * cz),
+                      ax * bx + ay * by + az * bz);
+}
+
 }  // end anonymous namespace
 
 namespace pvt {  // namespace pvt
@@ -310,6 +354,9 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
                                float* result, float* dresultds,
                                float* dresultdt)
 {
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info_,
+                         texture_handle_, options.site, 1);
+
     // Handle >4 channel lookups by recursion.
     if (nchannels > 4) {
         int save_firstchannel = options.firstchannel;
@@ -406,9 +453,51 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
     // FIXME -- ick, why is it x and y at all, shouldn't it be s and t?
     // N.B. naturalres formulated for latlong
 
+    // A reflection lobe comes from the prefiltered lobes of the map, if it
+    // has them, blended with the ordinary lookup only for the sharpest
+    // lobes. Otherwise, approximate the lobe by blurring by its width.
+    float mirrorweight = 1.0f;
+    float lobeblur     = 0.0f;
+    if (options.roughness != 0.0f) {
+        TextureFile* lobefile = nullptr;
+        if (texturefile->m_env_lobes > 0) {
+            lobefile = find_texturefile(texturefile->m_env_lobes_file,
+                                        thread_info);
+            lobefile = verify_texturefile(lobefile, thread_info);
+        }
+        if (lobefile && !lobefile->broken()) {
+            float lobeweight = 1.0f;
+            if (options.roughness > 0.0f)
+                lobeweight = std::min(options.roughness
+                                          * texturefile->m_env_lobes,
+                                      1.0f);
+            float s, t;
+            vector_to_latlong(R, texturefile->m_y_up, s, t);
+            if (!environment_lobe(*lobefile, texturefile->m_env_lobes,
+                                  thread_info, options, s, t, lobeweight,
+                                  nchannels, result, dresultds, dresultdt))
+                return false;
+            mirrorweight = 1.0f - lobeweight;
+            if (mirrorweight <= 0.0f) {
+                if (actualchannels < nchannels && options.firstchannel == 0
+                    && m_gray_to_rgb)
+                    fill_gray_channels(spec, nchannels, result, dresultds,
+                                       dresultdt);
+                return true;
+            }
+        } else if (options.roughness > 0.0f) {
+            // A GGX lobe of alpha = roughness^2 reflects into a cone of
+            // half-angle about 2*atan(alpha).
+            float alpha = options.roughness * options.roughness;
+            lobeblur    = 4.0f * atanf(std::min(alpha, 1.0f));
+        } else {
+            lobeblur = float(M_PI);
+        }
+    }
+
     // Account for width and blur
-    float xfilt = xfilt_noblur * options.swidth + options.sblur;
-    float yfilt = yfilt_noblur * options.twidth + options.tblur;
+    float xfilt = xfilt_noblur * options.swidth + options.sblur + lobeblur;
+    float yfilt = yfilt_noblur * options.twidth + options.tblur + lobeblur;
 
     // Figure out major versus minor, and aspect ratio
     Imath::V3f Rmajor;  // major axis
@@ -439,6 +528,10 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
         sampler    = &TextureSystemImpl::sample_bicubic;
         probecount = &stats.cubic_interps;
         break;
+    case TextureOpt::InterpStochasticBilinear:
+        sampler    = &TextureSystemImpl::sample_closest;
+        probecount = &stats.closest_interps;
+        break;
     default:
         sampler    = &TextureSystemImpl::sample_bilinear;
         probecount = &stats.bilinear_interps;
@@ -448,7 +541,8 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
     TextureOpt::MipMode mipmode = options.mipmode;
     bool aniso                  = (mipmode == TextureOpt::MipModeDefault
                   || mipmode == TextureOpt::MipModeAniso
-                  || mipmode == TextureOpt::MipModeStochasticAniso);
+                  || mipmode == TextureOpt::MipModeStochasticAniso
+                  || mipmode == TextureOpt::MipModeEWA);
 
     float aspect, trueaspect, filtwidth;
     int nsamples;
@@ -553,7 +647,8 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
             OIIO_SIMD4_ALIGN float sval[4] = { s, 0.0f, 0.0f, 0.0f };
             OIIO_SIMD4_ALIGN float tval[4] = { t, 0.0f, 0.0f, 0.0f };
             OIIO_SIMD4_ALIGN float weight[4]
-                = { levelweight[level] * invsamples, 0.0f, 0.0f, 0.0f };
+                = { levelweight[level] * invsamples * mirrorweight, 0.0f, 0.0f,
+                    0.0f };
             vfloat4 r, drds, drdt;
             ok &= (this->*sampler)(1, sval, tval, miplevel[level], *texturefile,
                                    thread_info, options, nchannels,
@@ -582,6 +677,200 @@ TextureSystemImpl::environment(TextureHandle* texture_handle_,
 
 
 
+bool
+TextureSystemImpl::environment_lobe(TextureFile& lobefile, int nlobes,
+                                    PerThreadInfo* thread_info,
+                                    TextureOpt& options, float s, float t,
+                                    float weight, int nchannels, float* result,
+                                    float* dresultds, float* dresultdt)
+{
+    // The lobes file holds the specular lobes in its first half of the
+    // channels, MIP level m being the lobe of roughness (m+1)/nlobes, and
+    // the diffuse lobe in the second half of the channels of every level.
+    const ImageSpec& spec(lobefile.spec(0, 0));
+    ImageCacheFile::SubimageInfo& subinfo(lobefile.subimageinfo(0));
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    int nlevels      = (int)subinfo.levels.size();
+    int lobechannels = spec.nchannels / 2;
+    TextureOpt opt(options);
+    opt.subimage = 0;
+    opt.swrap    = lobefile.m_sample_border
+                       ? TextureOpt::WrapPeriodicSharedBorder
+                       : TextureOpt::WrapPeriodic;
+    opt.twrap    = TextureOpt::WrapClamp;
+
+    int miplevel[2]  = { nlevels - 1, nlevels - 1 };
+    float levelblend = 0.0f;
+    if (options.roughness < 0.0f) {
+        // The diffuse lobe is so smooth that a small level holds it.
+        for (int m = 0; m < nlevels; ++m) {
+            if (subinfo.spec(m).full_width <= 32) {
+                miplevel[0] = miplevel[1] = m;
+                break;
+            }
+        }
+        opt.firstchannel += lobechannels;
+    } else {
+        int last    = std::min(nlobes, nlevels) - 1;
+        float level = OIIO::clamp(options.roughness * nlobes - 1.0f, 0.0f,
+                                  float(last));
+        miplevel[0] = std::min(int(level), last);
+        miplevel[1] = std::min(miplevel[0] + 1, last);
+        levelblend  = level - float(miplevel[0]);
+    }
+    int actualchannels = OIIO::clamp(lobechannels - options.firstchannel, 0,
+                                     nchannels);
+
+    bool ok              = true;
+    float levelweight[2] = { 1.0f - levelblend, levelblend };
+    for (int level = 0; level < 2; ++level) {
+        if (!levelweight[level])
+            continue;
+        ++stats.bilinear_interps;
+        OIIO_SIMD4_ALIGN float sval[4] = { s, 0.0f, 0.0f, 0.0f };
+        OIIO_SIMD4_ALIGN float tval[4] = { t, 0.0f, 0.0f, 0.0f };
+        OIIO_SIMD4_ALIGN float lweight[4]
+            = { levelweight[level] * weight, 0.0f, 0.0f, 0.0f };
+        vfloat4 r, drds, drdt;
+        ok &= sample_bilinear(1, sval, tval, miplevel[level], lobefile,
+                              thread_info, opt, nchannels, actualchannels,
+                              lweight, &r, dresultds ? &drds : NULL,
+                              dresultds ? &drdt : NULL);
+        for (int c = 0; c < nchannels; ++c)
+            result[c] += r[c];
+        if (dresultds) {
+            for (int c = 0; c < nchannels; ++c) {
+                dresultds[c] += drds[c];
+                dresultdt[c] += drdt[c];
+            }
+        }
+    }
+    return ok;
+}
+
+
+
+/// Convert a batch of direction vectors to latlong st coordinates
+///
+inline void
+vector_to_latlong_wide(const Tex::FloatWide& Rx, const Tex::FloatWide& Ry,
+                       const Tex::FloatWide& Rz, bool y_is_up,
+                       Tex::FloatWide& s, Tex::FloatWide& t)
+{
+    const float inv2pi = float(0.5 * M_1_PI);
+    if (y_is_up) {
+        s = atan2_wide(-Rx, Rz) * inv2pi + 0.5f;
+        t = 0.5f - atan2_wide(Ry, sqrt(Rz * Rz + Rx * Rx)) * float(M_1_PI);
+    } else {
+        s = atan2_wide(Ry, Rx) * inv2pi + 0.5f;
+        t = 0.5f - atan2_wide(Rz, sqrt(Rx * Rx + Ry * Ry)) * float(M_1_PI);
+    }
+    // learned from experience, beware NaNs
+    s = blend0(s, s == s);
+    t = blend0(t, t == t);
+}
+
+
+
+bool
+TextureSystemImpl::environment_batch_bilinear(
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    const TextureOptBatch& batchopt, Tex::RunMask mask, const float* R,
+    const float* dRdx, const float* dRdy, int nchannels, float* result,
+    float* dresultds, float* dresultdt)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+
+    int nlanes = lane_count(mask);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.environment_batches;
+    stats.environment_queries += nlanes;
+
+    const ImageSpec& spec(texturefile.spec(options.subimage, 0));
+
+    // Environment maps dictate particular wrap modes
+    options.swrap = texturefile.m_sample_border
+                        ? TextureOpt::WrapPeriodicSharedBorder
+                        : TextureOpt::WrapPeriodic;
+    options.twrap = TextureOpt::WrapClamp;
+
+    options.envlayout  = LayoutLatLong;
+    int actualchannels = OIIO::clamp(spec.nchannels - options.firstchannel, 0,
+                                     nchannels);
+
+    // Unit-length vectors in the direction of R, R+dRdx, R+dRdy, for all
+    // lanes at once. These define the ellipse we're filtering over.
+    const int bw = Tex::BatchWidth;
+    FloatWide Rx(R), Ry(R + bw), Rz(R + 2 * bw);
+    FloatWide Xx = Rx + FloatWide(dRdx), Xy = Ry + FloatWide(dRdx + bw);
+    FloatWide Xz = Rz + FloatWide(dRdx + 2 * bw);
+    FloatWide Yx = Rx + FloatWide(dRdy), Yy = Ry + FloatWide(dRdy + bw);
+    FloatWide Yz = Rz + FloatWide(dRdy + 2 * bw);
+    normalize_wide(Rx, Ry, Rz);
+    normalize_wide(Xx, Xy, Xz);
+    normalize_wide(Yx, Yy, Yz);
+    // angles formed by the ellipse axes, accounting for width and blur
+    FloatWide xfilt = max(angle_wide(Rx, Ry, Rz, Xx, Xy, Xz),
+                          FloatWide(1e-8f));
+    FloatWide yfilt = max(angle_wide(Rx, Ry, Rz, Yx, Yy, Yz),
+                          FloatWide(1e-8f));
+    xfilt = xfilt * FloatWide(batchopt.swidth) + FloatWide(batchopt.sblur);
+    yfilt = yfilt * FloatWide(batchopt.twidth) + FloatWide(batchopt.tblur);
+    FloatWide filtwidth = options.conservative_filter ? max(xfilt, yfilt)
+                                                      : min(xfilt, yfilt);
+    IntWide level0, level1;
+    FloatWide levelblend;
+    compute_miplevels_batch(texturefile, options, filtwidth, true, level0,
+                            level1, levelblend);
+
+    // FIXME -- assuming latlong
+    FloatWide s, t;
+    vector_to_latlong_wide(Rx, Ry, Rz, texturefile.m_y_up, s, t);
+
+    bool derivs = (dresultds && dresultdt);
+    vfloat4 accum[Tex::BatchWidth], daccumds[Tex::BatchWidth],
+        daccumdt[Tex::BatchWidth];
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        accum[i].clear();
+        daccumds[i].clear();
+        daccumdt[i].clear();
+    }
+    int npointson = 0;
+    bool ok = sample_bilinear_mipmap_batch(mask, level0, level1, levelblend,
+                                           s, t, texturefile, thread_info,
+                                           options, nchannels, actualchannels,
+                                           accum, derivs ? daccumds : nullptr,
+                                           derivs ? daccumdt : nullptr,
+                                           npointson);
+    stats.bilinear_interps += npointson;
+    stats.aniso_probes += nlanes;
+    stats.aniso_queries += nlanes;
+
+    bool gray_fill = (actualchannels < nchannels && options.firstchannel == 0
+                      && m_gray_to_rgb);
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        if (!((mask >> i) & 1))
+            continue;
+        if (gray_fill)
+            fill_gray_channels(spec, nchannels, (float*)&accum[i],
+                               derivs ? (float*)&daccumds[i] : nullptr,
+                               derivs ? (float*)&daccumdt[i] : nullptr);
+        // As for single points, the derivs stay zero unless the caller
+        // asked for both of them.
+        for (int c = 0; c < nchannels; ++c) {
+            result[c * Tex::BatchWidth + i] = accum[i][c];
+            if (dresultds)
+                dresultds[c * Tex::BatchWidth + i] = daccumds[i][c];
+            if (dresultdt)
+                dresultdt[c * Tex::BatchWidth + i] = daccumdt[i][c];
+        }
+    }
+    return ok;
+}
+
+
+
 bool
 TextureSystemImpl::environment(TextureHandle* texture_handle,
                                Perthread* thread_info, TextureOptBatch& options,
@@ -590,7 +879,9 @@ TextureSystemImpl::environment(TextureHandle* texture_handle,
                                int nchannels, float* result, float* dresultds,
                                float* dresultdt)
 {
-    // (FIXME) CHEAT! Texture points individually
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info,
+                         texture_handle, options.site, lane_count(mask));
+
     TextureOpt opt;
     opt.firstchannel        = options.firstchannel;
     opt.subimage            = options.subimage;
@@ -604,6 +895,33 @@ TextureSystemImpl::environment(TextureHandle* texture_handle,
     opt.fill                = options.fill;
     opt.missingcolor        = options.missingcolor;
 
+    // Bilinear lookups with a single probe (the non-anisotropic MIP modes)
+    // have a real wide implementation. Everything else (and missing
+    // textures) looks up the points one by one.
+    bool wide_mip = (opt.mipmode == TextureOpt::MipModeNoMIP
+                     || opt.mipmode == TextureOpt::MipModeOneLevel
+                     || opt.mipmode == TextureOpt::MipModeTrilinear);
+    TextureFile* texturefile = (TextureFile*)texture_handle;
+    if (opt.interpmode == TextureOpt::InterpBilinear && wide_mip
+        && nchannels <= 4 && texturefile) {
+        PerThreadInfo* ptinfo = m_imagecache->get_perthread_info(
+            (PerThreadInfo*)thread_info);
+        texturefile = verify_texturefile(texturefile, ptinfo);
+        if (texturefile && !texturefile->broken()) {
+            if (!opt.subimagename.empty())
+                opt.subimage = m_imagecache->subimage_from_name(
+                    texturefile, opt.subimagename);
+            if (opt.subimage >= 0 && opt.subimage < texturefile->subimages()) {
+                opt.subimagename.clear();
+                return environment_batch_bilinear(*texturefile, ptinfo, opt,
+                                                  options, mask, R, dRdx, dRdy,
+                                                  nchannels, result, dresultds,
+                                                  dresultdt);
+            }
+            opt.subimage = options.subimage;
+        }
+    }
+
     bool ok          = true;
     Tex::RunMask bit = 1;
     for (int i = 0; i < Tex::BatchWidth; ++i, bit <<= 1) {
@@ -3,11 +3,15 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <algorithm>
 #include <cstring>
+#include <functional>
 #include <memory>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <tuple>
+#include <unordered_map>
 #include <vector>
 
 #include <OpenImageIO/Imath.h>
@@ -18,12 +22,15 @@
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/optparser.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/simd.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/texture.h>
 #include <OpenImageIO/thread.h>
+#include <OpenImageIO/tiffutils.h>
 #include <OpenImageIO/timer.h>
+#include <OpenImageIO/trace.h>
 #include <OpenImageIO/typedesc.h>
 #include <OpenImageIO/ustring.h>
 #include <OpenImageIO/varyingref.h>
@@ -31,6 +38,8 @@
 #include "imagecache_pvt.h"
 #include "imageio_pvt.h"
 
+#include <zlib.h>
+
 
 OIIO_NAMESPACE_BEGIN
 using namespace pvt;
@@ -116,12 +125,63 @@ namespace pvt {  // namespace pvt
 
 
 
+void
+LatencyHistogram::clear()
+{
+    count = 0;
+    std::fill(counts, counts + nbuckets, 0LL);
+    total = 0.0;
+    max   = 0.0;
+}
+
+
+
+void
+LatencyHistogram::merge(const LatencyHistogram& h)
+{
+    if (!h.count)
+        return;
+    count += h.count;
+    for (int i = 0; i < nbuckets; ++i)
+        counts[i] += h.counts[i];
+    total += h.total;
+    max = std::max(max, h.max);
+}
+
+
+
+double
+LatencyHistogram::percentile(double pct) const
+{
+    if (!count)
+        return 0.0;
+    long long rank = std::max(1LL, (long long)ceil(pct * 0.01 * count));
+    long long seen = 0;
+    for (int i = 0; i < nbuckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+            // The top of the bucket, which is never less than the value
+            if (i < subbuckets)
+                return std::min(max, (i + 1) * 1.0e-9);
+            int shift   = i / subbuckets - 1;
+            double high = double(uint64_t(subbuckets + i % subbuckets + 1)
+                                 << shift);
+            return std::min(max, high * 1.0e-9);
+        }
+    }
+    return max;
+}
+
+
+
 void
 ImageCacheStatistics::init()
 {
     // ImageCache stats:
     find_tile_calls             = 0;
     find_tile_microcache_misses = 0;
+    find_tile_microcache_assoc_hits = 0;
+    find_tile_index_hits            = 0;
     find_tile_cache_misses      = 0;
     //    tiles_created = 0;
     //    tiles_current = 0;
@@ -129,6 +189,15 @@ ImageCacheStatistics::init()
     files_totalsize        = 0;
     files_totalsize_ondisk = 0;
     bytes_read             = 0;
+    diskcache_tiles_read   = 0;
+    diskcache_bytes_read   = 0;
+    tiles_mapped           = 0;
+    tiles_constant         = 0;
+    tiles_readahead        = 0;
+    spare_inputs_opened    = 0;
+    bytes_streamed         = 0;
+    page_fills             = 0;
+    page_evictions         = 0;
     //    open_files_created = 0;
     //    open_files_current = 0;
     //    open_files_peak = 0;
@@ -158,6 +227,18 @@ ImageCacheStatistics::init()
     cubic_interps       = 0;
     file_retry_success  = 0;
     tile_retry_success  = 0;
+
+    deferred_queries                = 0;
+    deferred_tile_switches          = 0;
+    deferred_tile_switches_unsorted = 0;
+    ewa_queries                     = 0;
+    ewa_texels                      = 0;
+    shadow_taps                     = 0;
+    shadow_blocker_searches         = 0;
+
+    lookup_latency.clear();
+    tile_wait_latency.clear();
+    fileopen_latency.clear();
 }
 
 
@@ -168,6 +249,8 @@ ImageCacheStatistics::merge(const ImageCacheStatistics& s)
     // ImageCache stats:
     find_tile_calls += s.find_tile_calls;
     find_tile_microcache_misses += s.find_tile_microcache_misses;
+    find_tile_microcache_assoc_hits += s.find_tile_microcache_assoc_hits;
+    find_tile_index_hits += s.find_tile_index_hits;
     find_tile_cache_misses += s.find_tile_cache_misses;
     //    tiles_created += s.tiles_created;
     //    tiles_current += s.tiles_current;
@@ -175,6 +258,15 @@ ImageCacheStatistics::merge(const ImageCacheStatistics& s)
     files_totalsize += s.files_totalsize;
     files_totalsize_ondisk += s.files_totalsize_ondisk;
     bytes_read += s.bytes_read;
+    diskcache_tiles_read += s.diskcache_tiles_read;
+    diskcache_bytes_read += s.diskcache_bytes_read;
+    tiles_mapped += s.tiles_mapped;
+    tiles_constant += s.tiles_constant;
+    tiles_readahead += s.tiles_readahead;
+    spare_inputs_opened += s.spare_inputs_opened;
+    bytes_streamed += s.bytes_streamed;
+    page_fills += s.page_fills;
+    page_evictions += s.page_evictions;
     //    open_files_created += s.open_files_created;
     //    open_files_current += s.open_files_current;
     //    open_files_peak += s.open_files_peak;
@@ -202,8 +294,19 @@ ImageCacheStatistics::merge(const ImageCacheStatistics& s)
     closest_interps += s.closest_interps;
     bilinear_interps += s.bilinear_interps;
     cubic_interps += s.cubic_interps;
+    deferred_queries += s.deferred_queries;
+    deferred_tile_switches += s.deferred_tile_switches;
+    deferred_tile_switches_unsorted += s.deferred_tile_switches_unsorted;
+    ewa_queries += s.ewa_queries;
+    ewa_texels += s.ewa_texels;
+    shadow_taps += s.shadow_taps;
+    shadow_blocker_searches += s.shadow_blocker_searches;
     file_retry_success += s.file_retry_success;
     tile_retry_success += s.tile_retry_success;
+
+    lookup_latency.merge(s.lookup_latency);
+    tile_wait_latency.merge(s.tile_wait_latency);
+    fileopen_latency.merge(s.fileopen_latency);
 }
 
 
@@ -322,6 +425,96 @@ ImageCacheFile::reset(ImageInput::Creator creator, const ImageSpec* config)
 
 
 
+ustring
+ImageCacheFile::content_hash()
+{
+    lock_guard lock(m_content_hash_mutex);
+    if (m_content_hash.empty()) {
+        // Chain the hash of each chunk into the seed of the next.
+        const size_t chunksize = 1 << 20;
+        std::unique_ptr<char[]> buf(new char[chunksize]);
+        uint64_t size = Filesystem::file_size(m_filename);
+        if (size == uint64_t(-1))
+            return ustring();
+        unsigned long long h = 0;
+        uint64_t pos = 0;
+        while (pos < size) {
+            size_t n = Filesystem::read_bytes(m_filename, buf.get(),
+                                              chunksize, size_t(pos));
+            if (!n)
+                return ustring();  // unreadable, don't mistake it for empty
+            h = xxhash::XXH64(buf.get(), n, h);
+            pos += n;
+        }
+        m_content_hash = ustring::fmtformat("xxh64:{:016x}:{}", h, size);
+    }
+    return m_content_hash;
+}
+
+
+
+void
+ImageCacheFile::decode_deferred_metadata_locked()
+{
+    lock_guard lock(m_metadata_mutex);
+    if (m_metadata_decoded.load(std::memory_order_relaxed))
+        return;  // Another thread beat us to it
+    for (auto& si : m_subimages) {
+        for (auto& level : si.levels) {
+            OIIO::decode_deferred_metadata(level.spec);
+            OIIO::decode_deferred_metadata(level.nativespec);
+        }
+    }
+    m_metadata_decoded.store(true, std::memory_order_release);
+}
+
+
+
+void
+ImageCacheFile::incr_resident(const TileID& id, size_t size)
+{
+    m_resident_bytes += (long long)size;
+    long long quota = m_max_resident_bytes;
+    if (quota <= 0 || size == 0)
+        return;
+    spin_lock lock(m_resident_mutex);
+    if (!m_resident_tiles)
+        m_resident_tiles.reset(new std::deque<TileID>);
+    m_resident_tiles->push_back(id);
+    // Tiles that the main clock sweep freed are never popped, so keep
+    // the list to a few times what could fit in the quota by forgetting
+    // the oldest entries.
+    size_t cap = size_t(4 * (quota / (long long)size)) + 64;
+    while (m_resident_tiles->size() > cap)
+        m_resident_tiles->pop_front();
+}
+
+
+
+TileID
+ImageCacheFile::pop_oldest_resident()
+{
+    spin_lock lock(m_resident_mutex);
+    if (!m_resident_tiles || m_resident_tiles->empty())
+        return TileID();
+    TileID id = m_resident_tiles->front();
+    m_resident_tiles->pop_front();
+    return id;
+}
+
+
+
+void
+ImageCacheFile::push_resident(const TileID& id)
+{
+    spin_lock lock(m_resident_mutex);
+    if (!m_resident_tiles)
+        m_resident_tiles.reset(new std::deque<TileID>);
+    m_resident_tiles->push_back(id);
+}
+
+
+
 std::shared_ptr<ImageInput>
 ImageCacheFile::get_imageinput(ImageCachePerThreadInfo* /*thread_info*/)
 {
@@ -439,12 +632,147 @@ ImageCacheFile::SubimageInfo::init(ImageCacheFile& icfile,
         const Imath::M44f* m = (const Imath::M44f*)p->data();
         Mlocal.reset(new Imath::M44f(c2w * (*m)));
     }
+
+    // Shadow maps carry the camera and projection of the light's view.
+    // Like Mlocal, pre-concatenate common-to-world so that lookups may
+    // pass positions in "common" space.
+    p = spec.find_attribute("worldtocamera", TypeMatrix);
+    if (p) {
+        Imath::M44f c2w;
+        icfile.m_imagecache.get_commontoworld(c2w);
+        const Imath::M44f* m = (const Imath::M44f*)p->data();
+        Mcamera.reset(new Imath::M44f(c2w * (*m)));
+    }
+    p = spec.find_attribute("worldtoscreen", TypeMatrix);
+    if (p) {
+        Imath::M44f c2w;
+        icfile.m_imagecache.get_commontoworld(c2w);
+        const Imath::M44f* m = (const Imath::M44f*)p->data();
+        Mscreen.reset(new Imath::M44f(c2w * (*m)));
+    }
+}
+
+
+
+std::shared_ptr<ImageInput>
+ImageCacheFile::create_imageinput(ImageSpec& configspec)
+{
+    configspec = ImageSpec();
+    if (m_configspec)
+        configspec = *m_configspec;
+    if (imagecache().unassociatedalpha())
+        configspec.attribute("oiio:UnassociatedAlpha", 1);
+    // Formats whose libraries cache decoded data themselves (Ptex) should
+    // leave that to us, so that everything lives within our memory limit.
+    configspec.attribute("ptex:imagecache", 1);
+    // Most files are opened only for their pixels, so leave Exif, XMP, and
+    // IPTC blocks undecoded until somebody asks for the metadata.
+    if (!configspec.find_attribute("oiio:LazyMetadata"))
+        configspec.attribute("oiio:LazyMetadata", 2);
+
+    std::shared_ptr<ImageInput> inp;
+    if (m_inputcreator)
+        inp.reset(m_inputcreator());
+    else {
+        // If we are trusting extensions and this isn't a special "REST-ful"
+        // name construction, just open with the extension in order to skip
+        // an unnecessary file open.
+        std::string fmt;
+        if (m_imagecache.trust_file_extensions()
+            && m_filename.find('?') != m_filename.npos)
+            fmt = OIIO::Filesystem::extension(fmt, false);
+        else
+            fmt = m_filename.string();
+        inp = ImageInput::create(fmt, false, &configspec,
+                                 m_imagecache.plugin_searchpath());
+    }
+    return inp;
+}
+
+
+
+ImageCacheFile::InputLease
+ImageCacheFile::acquire_input(ImageCachePerThreadInfo* thread_info,
+                              const std::shared_ptr<ImageInput>& inp)
+{
+    // Usually nobody else is reading, so take the main ImageInput.
+    if (!m_input_busy.exchange(true))
+        return { inp, true, false };
+
+    // Somebody is, so reuse an idle spare, or open a new one if we're
+    // still under the limits. Otherwise, fall back to sharing the main
+    // ImageInput, whose own mutex will make us wait our turn.
+    {
+        spin_lock lock(m_spare_inputs_mutex);
+        if (m_spare_inputs.size()) {
+            InputLease lease { std::move(m_spare_inputs.back()), false, true };
+            m_spare_inputs.pop_back();
+            return lease;
+        }
+        if (m_nspare_inputs + 1 >= imagecache().max_inputs_per_file()
+            || imagecache().open_files_current()
+                   >= imagecache().max_open_files())
+            return { inp, false, false };
+        ++m_nspare_inputs;  // Reserve it before we let go of the lock
+    }
+    ImageSpec configspec, nativespec;
+    std::shared_ptr<ImageInput> spare = create_imageinput(configspec);
+    if (spare && spare->open(m_filename.string(), nativespec, configspec)) {
+        imagecache().incr_open_files();
+        ++thread_info->m_stats.spare_inputs_opened;
+        return { spare, false, true };
+    }
+    // No luck, don't try to report it -- the main ImageInput still works.
+    if (spare)
+        (void)spare->geterror();
+    spin_lock lock(m_spare_inputs_mutex);
+    --m_nspare_inputs;
+    return { inp, false, false };
+}
+
+
+
+void
+ImageCacheFile::release_input(InputLease& lease,
+                              const std::shared_ptr<ImageInput>& inp)
+{
+    if (lease.main) {
+        m_input_busy = false;
+    } else if (lease.spare) {
+        {
+            // Keep the spare for the next concurrent read, unless the
+            // file was closed or reopened while we were using it.
+            spin_lock lock(m_spare_inputs_mutex);
+            if (get_imageinput(nullptr) == inp) {
+                m_spare_inputs.push_back(std::move(lease.input));
+                return;
+            }
+            --m_nspare_inputs;
+        }
+        lease.input.reset();
+        imagecache().decr_open_files();
+    }
+}
+
+
+
+void
+ImageCacheFile::close_spare_inputs()
+{
+    std::vector<std::shared_ptr<ImageInput>> spares;
+    {
+        spin_lock lock(m_spare_inputs_mutex);
+        spares.swap(m_spare_inputs);
+        m_nspare_inputs -= int(spares.size());
+    }
+    for (size_t i = 0, e = spares.size(); i < e; ++i)
+        imagecache().decr_open_files();
 }
 
 
 
 std::shared_ptr<ImageInput>
-ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
+ImageCacheFile::open(ImageCachePerThreadInfo* thread_info, bool header_only)
 {
     // Simple case -- no lock needed: atomically retrieve a shared pointer
     // to the ImageInput. If it exists, return it. Unless the file is
@@ -456,6 +784,7 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
         return inp;
 
     // The file wasn't already opened and in a good state.
+    OIIO_TRACE_ZONE("ImageCacheFile::open", "imagecache", m_filename.c_str());
 
     // Enforce limits on maximum number of open files.
     imagecache().check_max_files(thread_info);
@@ -479,36 +808,35 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
         return inp;
 
     ImageSpec configspec;
-    if (m_configspec)
-        configspec = *m_configspec;
-    if (imagecache().unassociatedalpha())
-        configspec.attribute("oiio:UnassociatedAlpha", 1);
-
-    if (m_inputcreator)
-        inp.reset(m_inputcreator());
-    else {
-        // If we are trusting extensions and this isn't a special "REST-ful"
-        // name construction, just open with the extension in order to skip
-        // an unnecessary file open.
-        std::string fmt;
-        if (m_imagecache.trust_file_extensions()
-            && m_filename.find('?') != m_filename.npos)
-            fmt = OIIO::Filesystem::extension(fmt, false);
-        else
-            fmt = m_filename.string();
-        inp = ImageInput::create(fmt, false, &configspec,
-                                 m_imagecache.plugin_searchpath());
-    }
+    inp = create_imageinput(configspec);
     if (!inp) {
         mark_broken(OIIO::geterror());
         invalidate_spec();
         return {};
     }
 
+    // If all we're after is the metadata, the spec cache may already have
+    // it, in which case we fill in the subimages from there and leave the
+    // file unopened until somebody wants its pixels.
+    std::vector<std::vector<ImageSpec>> cachedspecs;
+    std::string cachedformat;
+    bool from_cache = header_only && !validspec() && !m_inputcreator
+                      && pvt::spec_cache_lookup(m_filename.string(),
+                                                &configspec, cachedspecs,
+                                                cachedformat);
+    bool store_specs = !from_cache && !m_inputcreator
+                       && !pvt::spec_cache_dir.empty();
+
     ImageSpec nativespec, tempspec;
     mark_not_broken();
     bool ok = true;
-    for (int tries = 0; tries <= imagecache().failure_retries(); ++tries) {
+    if (from_cache) {
+        inp = pvt::header_only_input(std::move(cachedspecs), cachedformat,
+                                     m_filename.string());
+        nativespec = inp->spec();
+    }
+    for (int tries = 0; !from_cache && tries <= imagecache().failure_retries();
+         ++tries) {
         ok = inp->open(m_filename.c_str(), nativespec, configspec);
         if (ok) {
             tempspec = nativespec;
@@ -527,8 +855,10 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
         inp.reset();
         return {};
     }
-    m_fileformat = ustring(inp->format_name());
-    ++m_timesopened;
+    m_fileformat     = ustring(inp->format_name());
+    m_constant_tiles = inp->supports("constant_tiles");
+    if (!from_cache)
+        ++m_timesopened;
     use();
 
     // If we are simply re-opening a closed file, and the spec is still
@@ -543,6 +873,7 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
     // of the ImageCacheFile.
     m_subimages.clear();
     int nsubimages = 0;
+    std::vector<std::vector<ImageSpec>> nativespecs;
 
     // Since each subimage can potentially have its own mipmap levels,
     // keep track of the highest level discovered
@@ -554,8 +885,12 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
         SubimageInfo& si(subimageinfo(nsubimages));
         int max_mip_res = imagecache().max_mip_res();
         int nmip        = 0;
+        if (store_specs)
+            nativespecs.emplace_back();
         do {
             tempspec = nativespec;
+            if (store_specs)
+                nativespecs.back().push_back(nativespec);
             if (nmip == 0) {
                 // Things to do on MIP level 0, i.e. once per subimage
                 si.init(*this, tempspec, imagecache().forcefloat());
@@ -686,6 +1021,11 @@ ImageCacheFile::open(ImageCachePerThreadInfo* thread_info)
     thread_info->m_stats.files_totalsize_ondisk += m_total_imagesize_ondisk;
 
     init_from_spec();  // Fill in the rest of the fields
+    if (store_specs)
+        pvt::spec_cache_store(m_filename.string(), &configspec, nativespecs,
+                              m_fileformat.string());
+    if (from_cache)
+        return {};  // Nothing is open, but we're not broken
     set_imageinput(inp);
     return inp;
 }
@@ -748,6 +1088,16 @@ ImageCacheFile::init_from_spec()
             m_sample_border = true;
     }
 
+    // Latlong maps made with "maketx:envlobes" have their reflection lobes
+    // prefiltered in a companion file.
+    m_env_lobes = 0;
+    m_env_lobes_file.clear();
+    if (m_texformat == TexFormatLatLongEnv
+        && spec.get_int_attribute("oiio:EnvLobes") > 0) {
+        m_env_lobes      = spec.get_int_attribute("oiio:EnvLobes");
+        m_env_lobes_file = ustring(pvt::env_lobes_filename(m_filename));
+    }
+
     if (m_texformat == TexFormatCubeFaceEnv
         || m_texformat == TexFormatCubeFaceShadow) {
         int w = std::max(spec.full_width, spec.tile_width);
@@ -789,6 +1139,8 @@ ImageCacheFile::read_tile(ImageCachePerThreadInfo* thread_info, int subimage,
                           int chend, TypeDesc format, void* data)
 {
     OIIO_DASSERT(chend > chbegin);
+    OIIO_TRACE_ZONE("ImageCacheFile::read_tile", "imagecache",
+                    m_filename.c_str());
 
     // Mark if we ever use a mip level that's not the first
     if (miplevel > 0)
@@ -816,14 +1168,35 @@ ImageCacheFile::read_tile(ImageCachePerThreadInfo* thread_info, int subimage,
     // Ordinary tiled
     bool ok = true;
     const ImageSpec& spec(this->spec(subimage, miplevel));
+
+    // If recent misses have been marching along this tile row, read a run
+    // of the following tiles with the same call and put them in the cache
+    // as well, rather than paying for a separate seek and codec setup when
+    // each of them is asked for.
+    int ntiles = readahead_run(thread_info, subimage, miplevel, x, y, z,
+                               chbegin, chend);
+    stride_t pixelsize = stride_t(chend - chbegin) * format.size();
+    stride_t ystride   = pixelsize * spec.tile_width * ntiles;
+    stride_t zstride   = ystride * spec.tile_height;
+    std::unique_ptr<char[]> runbuf;
+    if (ntiles > 1)
+        runbuf.reset(new char[zstride * spec.tile_depth]);
+    void* readbuf = ntiles > 1 ? runbuf.get() : data;
+
+    // If another thread is already reading from this file, use a separate
+    // ImageInput so that the two reads don't have to take turns.
+    InputLease lease = acquire_input(thread_info, inp);
+    ImageInput* reader = lease.input.get();
     for (int tries = 0; tries <= imagecache().failure_retries(); ++tries) {
-        ok = inp->read_tiles(subimage, miplevel, x, x + spec.tile_width, y,
+        ok = reader->read_tiles(subimage, miplevel, x,
+                             x + spec.tile_width * ntiles, y,
                              y + spec.tile_height, z, z + spec.tile_depth,
-                             chbegin, chend, format, data);
+                             chbegin, chend, format, readbuf, pixelsize,
+                             ystride, zstride);
         if (ok) {
             if (tries)  // succeeded, but only after a failure!
                 ++thread_info->m_stats.tile_retry_success;
-            (void)inp->geterror();  // Eat the errors
+            (void)reader->geterror();  // Eat the errors
             break;
         }
         if (tries < imagecache().failure_retries()) {
@@ -833,15 +1206,111 @@ ImageCacheFile::read_tile(ImageCachePerThreadInfo* thread_info, int subimage,
         }
     }
     if (!ok) {
-        std::string err = inp->geterror();
+        std::string err = reader->geterror();
         if (errors_should_issue()) {
             imagecache().error("{}",
                                err.size() ? err : std::string("unknown error"));
         }
     }
+    release_input(lease, inp);
+
+    if (ok) {
+        size_t b = spec.tile_bytes() * ntiles;
+        thread_info->m_stats.bytes_read += b;
+        m_bytesread += b;
+        m_tilesread += ntiles;
+    }
+
+    if (ok && ntiles > 1) {
+        // Hand the requested tile back to the caller, and add the rest of
+        // the run to the cache.
+        copy_image(chend - chbegin, spec.tile_width, spec.tile_height,
+                   spec.tile_depth, readbuf, pixelsize, pixelsize, ystride,
+                   zstride, data, pixelsize, pixelsize * spec.tile_width,
+                   pixelsize * spec.tile_width * spec.tile_height);
+        for (int i = 1; i < ntiles; ++i) {
+            TileID id(*this, subimage, miplevel, x + i * spec.tile_width, y,
+                      z, chbegin, chend);
+            if (!imagecache().tile_in_cache(id, thread_info)) {
+                ImageCacheTileRef tile;
+                tile = new ImageCacheTile(id,
+                                          runbuf.get()
+                                              + i * spec.tile_width * pixelsize,
+                                          format, pixelsize, ystride, zstride);
+                ok &= tile->valid();
+                ok &= imagecache().add_tile_to_cache(tile, thread_info);
+                ++thread_info->m_stats.tiles_readahead;
+            }
+        }
+    }
+    return ok;
+}
+
+
+
+bool
+ImageCacheFile::read_deep_tile(ImageCachePerThreadInfo* thread_info,
+                               int subimage, int miplevel, int x, int y, int z,
+                               int chbegin, int chend, DeepData& deepdata)
+{
+    const SubimageInfo& subinfo(subimageinfo(subimage));
+    const ImageSpec& spec(this->spec(subimage, miplevel));
+    if (subinfo.unmipped && miplevel != 0) {
+        imagecache().error("No MIP level {} of deep image \"{}\"", miplevel,
+                           filename());
+        return false;
+    }
+    std::shared_ptr<ImageInput> inp = open(thread_info);
+    if (!inp)
+        return false;
+
+    int xend = std::min(x + spec.tile_width, spec.x + spec.width);
+    int yend = std::min(y + spec.tile_height, spec.y + spec.height);
+    int zend = std::min(z + spec.tile_depth, spec.z + spec.depth);
+    InputLease lease   = acquire_input(thread_info, inp);
+    ImageInput* reader = lease.input.get();
+    bool ok            = true;
+    if (!subinfo.untiled) {
+        ok = reader->read_native_deep_tiles(subimage, miplevel, x, xend, y,
+                                            yend, z, zend, chbegin, chend,
+                                            deepdata);
+    } else if (x == spec.x && xend == spec.x + spec.width) {
+        ok = reader->read_native_deep_scanlines(subimage, miplevel, y, yend, z,
+                                                chbegin, chend, deepdata);
+    } else {
+        // An emulated tile narrower than the image: read whole scanlines
+        // and keep our part of them.
+        DeepData rows;
+        ok = reader->read_native_deep_scanlines(subimage, miplevel, y, yend, z,
+                                                chbegin, chend, rows);
+        if (ok) {
+            int w = xend - x, h = yend - y;
+            std::vector<std::string> names;
+            for (int c = 0; c < rows.channels(); ++c)
+                names.emplace_back(rows.channelname(c));
+            deepdata.init(int64_t(w) * h, rows.channels(),
+                          rows.all_channeltypes(), names);
+            auto rowpixel = [&](int i) {
+                return int64_t(i / w) * spec.width + (x - spec.x) + i % w;
+            };
+            std::vector<unsigned int> nsamples(size_t(w) * h);
+            for (int i = 0; i < w * h; ++i)
+                nsamples[i] = rows.samples(rowpixel(i));
+            deepdata.set_all_samples(nsamples);
+            for (int i = 0; i < w * h; ++i)
+                deepdata.copy_deep_pixel(i, rows, rowpixel(i));
+        }
+    }
+    if (!ok) {
+        std::string err = reader->geterror();
+        if (errors_should_issue())
+            imagecache().error("{}",
+                               err.size() ? err : std::string("unknown error"));
+    }
+    release_input(lease, inp);
 
     if (ok) {
-        size_t b = spec.tile_bytes();
+        size_t b = deepdata.all_data().size();
         thread_info->m_stats.bytes_read += b;
         m_bytesread += b;
         ++m_tilesread;
@@ -851,6 +1320,166 @@ ImageCacheFile::read_tile(ImageCachePerThreadInfo* thread_info, int subimage,
 
 
 
+int
+ImageCacheFile::readahead_run(ImageCachePerThreadInfo* thread_info,
+                              int subimage, int miplevel, int x, int y, int z,
+                              int chbegin, int chend)
+{
+    int maxrun = imagecache().max_readahead_tiles();
+    if (maxrun <= 1)
+        return 1;
+    const ImageSpec& spec(this->spec(subimage, miplevel));
+    int run = 1;
+    {
+        // A miss a little further along the same row as the last one is
+        // taken as a sign of sequential access, and doubles the run
+        // length. Anything else starts over with a single tile.
+        spin_lock lock(m_readahead_mutex);
+        if (subimage == m_readahead_subimage
+            && miplevel == m_readahead_miplevel && y == m_readahead_y
+            && z == m_readahead_z && x > m_readahead_x
+            && x - m_readahead_x <= 2 * m_readahead_run * spec.tile_width)
+            run = std::min(2 * m_readahead_run, maxrun);
+        m_readahead_subimage = subimage;
+        m_readahead_miplevel = miplevel;
+        m_readahead_x        = x;
+        m_readahead_y        = y;
+        m_readahead_z        = z;
+        m_readahead_run      = run;
+    }
+    // Stop at the end of the row, or at the first tile that's already in
+    // the cache (or is being read by another thread, or can be restored
+    // from the compressed tier).
+    int n = 1;
+    for (; n < run; ++n) {
+        int xx = x + n * spec.tile_width;
+        if (xx >= spec.x + spec.width)
+            break;
+        TileID id(*this, subimage, miplevel, xx, y, z, chbegin, chend);
+        if (imagecache().tile_in_cache(id, thread_info)
+            || imagecache().in_compressed_tier(id))
+            break;
+    }
+    return n;
+}
+
+
+
+const void*
+ImageCacheFile::map_tile(ImageCachePerThreadInfo* thread_info, int subimage,
+                         int miplevel, int x, int y, int z, int chbegin,
+                         int chend,
+                         std::shared_ptr<Filesystem::MappedFile>& mapping)
+{
+    // Only real tiles of a real file, held in the cache in their native
+    // format with all of their channels, can possibly be used in place.
+    const SubimageInfo& subinfo(subimageinfo(subimage));
+    if (subinfo.untiled || (subinfo.unmipped && miplevel != 0)
+        || m_duplicate)
+        return nullptr;
+    const ImageSpec& nspec(nativespec(subimage, miplevel));
+    if (nspec.format != subinfo.datatype || !nspec.channelformats.empty()
+        || chbegin != 0 || chend != nspec.nchannels)
+        return nullptr;
+
+    {
+        spin_lock lock(m_mapped_mutex);
+        if (!m_mapped && !m_map_failed) {
+            std::shared_ptr<Filesystem::MappedFile> m(
+                new Filesystem::MappedFile(m_filename));
+            if (m->is_open())
+                m_mapped = m;
+            else
+                m_map_failed = true;
+        }
+        mapping = m_mapped;
+    }
+    if (!mapping)
+        return nullptr;
+
+    std::shared_ptr<ImageInput> inp = open(thread_info);
+    int64_t offset = 0, size = 0;
+    if (!inp
+        || !inp->native_tile_location(subimage, miplevel, x, y, z, offset,
+                                      size)) {
+        mapping.reset();
+        return nullptr;
+    }
+    // The cache may read a SIMD width past the end of the last pixel, so
+    // that much must be mapped too. Also insist on the channels being
+    // naturally aligned within the mapping (its start is page aligned).
+    size_t channelsize = subinfo.channelsize;
+    if (offset < 0 || size < int64_t(nspec.tile_bytes())
+        || size_t(offset) + size_t(size) + OIIO_SIMD_MAX_SIZE_BYTES
+               > mapping->size()
+        || (channelsize && size_t(offset) % channelsize)) {
+        mapping.reset();
+        return nullptr;
+    }
+    ++thread_info->m_stats.tiles_mapped;
+    return mapping->data() + offset;
+}
+
+
+
+const void*
+ImageCacheFile::constant_tile(ImageCachePerThreadInfo* thread_info,
+                              int subimage, int miplevel, int x, int y, int z,
+                              int chbegin, int chend,
+                              std::shared_ptr<char>& holder)
+{
+    if (!m_constant_tiles || m_duplicate)
+        return nullptr;
+    const SubimageInfo& subinfo(subimageinfo(subimage));
+    if (subinfo.untiled || (subinfo.unmipped && miplevel != 0))
+        return nullptr;
+    const ImageSpec& nspec(nativespec(subimage, miplevel));
+    if (!nspec.channelformats.empty())
+        return nullptr;
+
+    std::shared_ptr<ImageInput> inp = open(thread_info);
+    std::vector<char> native(nspec.pixel_bytes(true));
+    if (!inp
+        || !inp->native_tile_constant(subimage, miplevel, x, y, z,
+                                      native.data()))
+        return nullptr;
+
+    // The one pixel as the cache holds it
+    int nchans = chend - chbegin;
+    std::string key(4 * sizeof(int) + nchans * subinfo.channelsize, '\0');
+    int ids[4] = { subimage, miplevel, chbegin, chend };
+    memcpy(&key[0], ids, sizeof(ids));
+    if (!convert_types(nspec.format,
+                       native.data() + chbegin * nspec.format.size(),
+                       subinfo.datatype, &key[sizeof(ids)], nchans))
+        return nullptr;
+
+    spin_lock lock(m_constant_tile_mutex);
+    auto found = m_constant_tile_pixels.find(key);
+    if (found != m_constant_tile_pixels.end()) {
+        holder = found->second;
+    } else {
+        // Don't let a file with many different constant values keep an
+        // unbounded number of them around; those tiles are just read.
+        if (m_constant_tile_pixels.size() >= 256)
+            return nullptr;
+        size_t pixelsize = nchans * subinfo.channelsize;
+        size_t npixels   = spec(subimage, miplevel).tile_pixels();
+        size_t size      = npixels * pixelsize + OIIO_SIMD_MAX_SIZE_BYTES;
+        holder.reset(new char[size], std::default_delete<char[]>());
+        for (size_t i = 0; i < npixels; ++i)
+            memcpy(holder.get() + i * pixelsize, &key[sizeof(ids)],
+                   pixelsize);
+        memset(holder.get() + npixels * pixelsize, 0,
+               OIIO_SIMD_MAX_SIZE_BYTES);
+        m_constant_tile_pixels[key] = holder;
+    }
+    ++thread_info->m_stats.tiles_constant;
+    return holder.get();
+}
+
+
+
 bool
 ImageCacheFile::read_unmipped(ImageCachePerThreadInfo* thread_info,
                               int subimage, int miplevel, int x, int y, int z,
@@ -897,8 +1526,7 @@ ImageCacheFile::read_unmipped(ImageCachePerThreadInfo* thread_info,
     // tile after the pixels are read.  Well, except that below our call
     // to get_pixels may recursively trigger more tiles to be read, and
     // totally change the microcache.  Simple solution: save & restore it.
-    ImageCacheTileRef oldtile     = thread_info->tile;
-    ImageCacheTileRef oldlasttile = thread_info->lasttile;
+    ImageCacheTileRef oldtile = thread_info->tile;
 
     // Auto-mipping will totally thrash the cache if the user unwisely
     // sets it to be too small compared to the image file that needs to
@@ -937,8 +1565,7 @@ ImageCacheFile::read_unmipped(ImageCachePerThreadInfo* thread_info,
     lores.get_pixels(ROI(0, tw, 0, th, 0, 1, 0, nchans), format, data);
 
     // Restore the microcache to the way it was before.
-    thread_info->tile     = oldtile;
-    thread_info->lasttile = oldlasttile;
+    thread_info->tile = oldtile;
 
     return ok;
 }
@@ -976,53 +1603,85 @@ ImageCacheFile::read_untiled(ImageCachePerThreadInfo* thread_info,
         // buffer to be an even multiple of the tile width, so round up.
         stride_t scanlinesize = tw * ((spec.width + tw - 1) / tw);
         scanlinesize *= pixelsize;
-        std::unique_ptr<char[]> buf(
-            new char[scanlinesize * th]);  // a whole tile-row size
-        int yy = y - spec.y;               // counting from top scanline
+        size_t bandsize = size_t(scanlinesize) * th;  // a whole tile-row
+        int yy          = y - spec.y;  // counting from top scanline
         // [y0,y1] is the range of scanlines to read for a tile-row
         int y0 = yy - (yy % th);
         int y1 = std::min(y0 + th - 1, spec.height - 1);
         y0 += spec.y;
         y1 += spec.y;
-        // Read the whole tile-row worth of scanlines
-        ok = inp->read_scanlines(subimage, miplevel, y0, y1 + 1, z, chbegin,
-                                 chend, format, (void*)&buf[0], pixelsize,
-                                 scanlinesize);
-        if (!ok) {
-            std::string err = inp->geterror();
-            if (!err.empty() && errors_should_issue())
-                imagecache().error("{}", err);
-        }
-        size_t b = (y1 - y0 + 1) * spec.scanline_bytes();
-        thread_info->m_stats.bytes_read += b;
-        m_bytesread += b;
-        ++m_tilesread;
-
-        // For all tiles in the tile-row, enter them into the cache if not
-        // already there.  Special case for the tile we're actually being
-        // asked for -- save it in 'data' rather than adding a tile.
         int xx = x - spec.x;      // counting from left row
         int x0 = xx - (xx % tw);  // start of the tile we are retrieving
-        for (int i = 0; i < spec.width; i += tw) {
-            if (i == xx) {
-                // This is the tile we've been asked for
-                convert_image(nchans, tw, th, 1, &buf[x0 * pixelsize], format,
-                              pixelsize, scanlinesize, scanlinesize * th, data,
-                              format, xstride, ystride, zstride);
+
+        // Several threads often want tiles of the same row at about the
+        // same time, and a tile of the row may be asked for again after
+        // it's been freed. If the band we need is the one we decoded last,
+        // just copy the tile from it. Otherwise read it, while holding
+        // m_band_mutex so that others wanting it wait for us, and keep it
+        // (if the row has more than one tile).
+        std::shared_ptr<char> band;
+        bool fresh = false;
+        {
+            lock_guard lock(m_band_mutex);
+            if (m_band.pixels && m_band.subimage == subimage
+                && m_band.miplevel == miplevel && m_band.y == y0
+                && m_band.z == z && m_band.chbegin == chbegin
+                && m_band.chend == chend && m_band.format == format) {
+                band = m_band.pixels;
+                imagecache().incr_bands_reused();
             } else {
-                // Not the tile we asked for, but it's in the same
-                // tile-row, so let's put it in the cache anyway so
-                // it'll be there when asked for.
-                TileID id(*this, subimage, miplevel, i + spec.x, y0, z, chbegin,
-                          chend);
-                if (!imagecache().tile_in_cache(id, thread_info)) {
-                    ImageCacheTileRef tile;
-                    tile = new ImageCacheTile(id, &buf[i * pixelsize], format,
-                                              pixelsize, scanlinesize,
-                                              scanlinesize * th);
-                    ok &= tile->valid();
-                    ok &= imagecache().add_tile_to_cache(tile, thread_info);
+                band.reset(new char[bandsize], std::default_delete<char[]>());
+                fresh = true;
+                // Read the whole tile-row worth of scanlines
+                ok = inp->read_scanlines(subimage, miplevel, y0, y1 + 1, z,
+                                         chbegin, chend, format, band.get(),
+                                         pixelsize, scanlinesize);
+                if (!ok) {
+                    std::string err = inp->geterror();
+                    if (!err.empty() && errors_should_issue())
+                        imagecache().error("{}", err);
                 }
+                size_t b = (y1 - y0 + 1) * spec.scanline_bytes();
+                thread_info->m_stats.bytes_read += b;
+                m_bytesread += b;
+                ++m_tilesread;
+                if (ok && spec.width > tw) {
+                    imagecache().decr_mem(m_band.size);
+                    imagecache().incr_mem(bandsize);
+                    m_band.subimage = subimage;
+                    m_band.miplevel = miplevel;
+                    m_band.y        = y0;
+                    m_band.z        = z;
+                    m_band.chbegin  = chbegin;
+                    m_band.chend    = chend;
+                    m_band.format   = format;
+                    m_band.pixels   = band;
+                    m_band.size     = bandsize;
+                }
+            }
+            // This is the tile we've been asked for
+            convert_image(nchans, tw, th, 1, band.get() + x0 * pixelsize,
+                          format, pixelsize, scanlinesize, scanlinesize * th,
+                          data, format, xstride, ystride, zstride);
+        }
+
+        // For all the other tiles of a tile-row we just read, enter them
+        // into the cache if not already there. This is done after letting
+        // go of m_band_mutex, because a thread that has already added one
+        // of them to the cache, and is waiting for the mutex to fill it,
+        // would otherwise hold us up forever.
+        for (int i = 0; fresh && ok && i < spec.width; i += tw) {
+            if (i == xx)
+                continue;
+            TileID id(*this, subimage, miplevel, i + spec.x, y0, z, chbegin,
+                      chend);
+            if (!imagecache().tile_in_cache(id, thread_info)) {
+                ImageCacheTileRef tile;
+                tile = new ImageCacheTile(id, band.get() + i * pixelsize,
+                                          format, pixelsize, scanlinesize,
+                                          scanlinesize * th);
+                ok &= tile->valid();
+                ok &= imagecache().add_tile_to_cache(tile, thread_info);
             }
         }
     } else {
@@ -1057,6 +1716,20 @@ ImageCacheFile::close()
     // are still hanging onto it.
     std::shared_ptr<ImageInput> empty;
     set_imageinput(empty);
+    close_spare_inputs();
+    release_band();
+}
+
+
+
+void
+ImageCacheFile::release_band()
+{
+    lock_guard lock(m_band_mutex);
+    if (m_band.pixels) {
+        imagecache().decr_mem(m_band.size);
+        m_band = DecodedBand();
+    }
 }
 
 
@@ -1082,9 +1755,24 @@ ImageCacheFile::invalidate()
     recursive_lock_guard guard(m_input_mutex);
     m_mutex_wait_time += input_mutex_timer();
     close();
+    {
+        // The file may have changed, so don't keep using an old mapping
+        // (tiles still holding it keep it alive until they are freed).
+        spin_lock lock(m_mapped_mutex);
+        m_mapped.reset();
+        m_map_failed = false;
+    }
+    {
+        spin_lock lock(m_constant_tile_mutex);
+        m_constant_tile_pixels.clear();
+    }
     invalidate_spec();
     mark_not_broken();
     m_fingerprint.clear();
+    {
+        lock_guard lock(m_content_hash_mutex);
+        m_content_hash.clear();
+    }
     duplicate(NULL);
 
     m_filename = m_imagecache.resolve_filename(m_filename_original.string());
@@ -1237,6 +1925,7 @@ ImageCacheImpl::find_file(ustring filename,
 
         if (newfile) {
             check_max_files(thread_info);
+            watch_file(tf);
             if (!tf->duplicate())
                 ++thread_info->m_stats.unique_files;
         }
@@ -1277,12 +1966,14 @@ ImageCacheImpl::verify_file(ImageCacheFile* tf,
         recursive_lock_guard guard(tf->m_input_mutex);
         tf->m_mutex_wait_time += input_mutex_timer();
         if (!tf->validspec()) {
-            tf->open(thread_info);
+            tf->open(thread_info, header_only);
             OIIO_DASSERT(tf->m_broken || tf->validspec());
             double createtime = timer();
             ImageCacheStatistics& stats(thread_info->m_stats);
             stats.fileio_time += createtime;
             stats.fileopen_time += createtime;
+            if (m_latency_stats)
+                stats.fileopen_latency.record(createtime);
             tf->iotime() += createtime;
 
             // What if we've opened another file, with a different name,
@@ -1291,38 +1982,21 @@ ImageCacheImpl::verify_file(ImageCacheFile* tf,
             if (!tf->fingerprint().empty() && m_deduplicate) {
                 // std::cerr << filename << " hash=" << tf->fingerprint() << "\n";
                 ImageCacheFile* dup = find_fingerprint(tf->fingerprint(), tf);
-                if (dup != tf) {
+                if (dup != tf && duplicate_compatible(tf, dup)) {
                     // Already in fingerprints -- mark this one as a
-                    // duplicate, but ONLY if we don't have other
-                    // reasons not to consider them true duplicates (the
-                    // fingerprint only considers source image pixel values,
-                    // and of course only if they are the same "shape".
-                    // FIXME -- be sure to add extra tests
-                    // here if more metadata have significance later!
-                    bool match = (tf->subimages() == dup->subimages());
-                    const ImageSpec& tfspec(tf->nativespec(0, 0));
-                    const ImageSpec& dupspec(dup->nativespec(0, 0));
-                    match &= (tfspec.width == dupspec.width
-                              && tfspec.height == dupspec.height
-                              && tfspec.depth == dupspec.depth
-                              && tfspec.nchannels == dupspec.nchannels
-                              && tf->subimages() == dup->subimages()
-                              && tf->miplevels(0) == dup->miplevels(0)
-                              && tf->m_swrap == dup->m_swrap
-                              && tf->m_twrap == dup->m_twrap
-                              && tf->m_rwrap == dup->m_rwrap
-                              && tf->m_envlayout == dup->m_envlayout
-                              && tf->m_y_up == dup->m_y_up
-                              && tf->m_sample_border == dup->m_sample_border);
-                    for (int s = 0, e = tf->subimages(); match && s < e; ++s) {
-                        match &= (tf->datatype(s) == dup->datatype(s));
-                    }
-                    if (match) {
-                        tf->duplicate(dup);
-                        tf->close();
-                        // std::cerr << "  duplicates "
-                        //   << fingerfound->second.get()->filename() << "\n";
-                    }
+                    // duplicate.
+                    tf->duplicate(dup);
+                    tf->close();
+                    // std::cerr << "  duplicates "
+                    //   << fingerfound->second.get()->filename() << "\n";
+                }
+            } else if (m_deduplicate && m_deduplicate_content && !tf->broken()
+                       && !tf->is_udim()) {
+                // No fingerprint in the header, but maybe the same bytes.
+                ImageCacheFile* dup = find_content_duplicate(tf);
+                if (dup != tf && duplicate_compatible(tf, dup)) {
+                    tf->duplicate(dup);
+                    tf->close();
                 }
             }
 #if IMAGECACHE_TIME_STATS
@@ -1355,11 +2029,72 @@ ImageCacheImpl::find_fingerprint(ustring finger, ImageCacheFile* file)
 
 
 
+bool
+ImageCacheImpl::duplicate_compatible(const ImageCacheFile* tf,
+                                     const ImageCacheFile* dup) const
+{
+    // Don't consider them true duplicates if we have other reasons not
+    // to (the fingerprint only considers source image pixel values), and
+    // of course only if they are the same "shape".
+    // FIXME -- be sure to add extra tests
+    // here if more metadata have significance later!
+    bool match = (tf->subimages() == dup->subimages());
+    const ImageSpec& tfspec(tf->nativespec(0, 0));
+    const ImageSpec& dupspec(dup->nativespec(0, 0));
+    match &= (tfspec.width == dupspec.width && tfspec.height == dupspec.height
+              && tfspec.depth == dupspec.depth
+              && tfspec.nchannels == dupspec.nchannels
+              && tf->subimages() == dup->subimages()
+              && tf->miplevels(0) == dup->miplevels(0)
+              && tf->m_swrap == dup->m_swrap && tf->m_twrap == dup->m_twrap
+              && tf->m_rwrap == dup->m_rwrap
+              && tf->m_envlayout == dup->m_envlayout
+              && tf->m_y_up == dup->m_y_up
+              && tf->m_sample_border == dup->m_sample_border);
+    for (int s = 0, e = tf->subimages(); match && s < e; ++s) {
+        match &= (tf->datatype(s) == dup->datatype(s));
+    }
+    return match;
+}
+
+
+
+ImageCacheFile*
+ImageCacheImpl::find_content_duplicate(ImageCacheFile* file)
+{
+    // Files of different sizes can't be byte-identical, so nothing needs
+    // hashing until a second file of some size comes along.
+    uint64_t size = Filesystem::file_size(file->filename());
+    if (size == 0 || size == uint64_t(-1))
+        return file;
+    ImageCacheFileRef first;
+    {
+        spin_lock lock(m_fingerprints_mutex);
+        auto found = m_content_sizes.emplace(size, file);
+        if (found.second)
+            return file;  // first of its size
+        first = found.first->second;
+    }
+    if (first.get() == file)
+        return file;
+    // N.B. Don't hold one file's hash lock while hashing the other, so
+    // two threads doing this for the same pair can't deadlock.
+    ustring firsthash = first->content_hash();
+    ustring hash      = file->content_hash();
+    if (firsthash.empty() || hash.empty())
+        return file;
+    (void)find_fingerprint(firsthash, first.get());
+    return find_fingerprint(hash, file);
+}
+
+
+
 void
 ImageCacheImpl::clear_fingerprints()
 {
     spin_lock lock(m_fingerprints_mutex);
     m_fingerprints.clear();
+    m_content_sizes.clear();
 }
 
 
@@ -1444,6 +2179,88 @@ ImageCacheImpl::check_max_files(ImageCachePerThreadInfo* /*thread_info*/)
 
 
 
+void
+ImageCacheImpl::numa_replicate(ImageCacheTile& tile, int node)
+{
+    if (tile.numa_node() == node
+        || tile.note_remote_use() < m_numa_replicate)
+        return;
+    if (tile.add_numa_replica(node)) {
+        incr_mem(tile.memsize());
+        ++m_stat_numa_replicas[node];
+    }
+}
+
+
+
+void
+ImageCacheImpl::evict_tile(ImageCacheTile& tile)
+{
+    unpublish_tile(&tile);
+    if (compressed_tier_enabled())
+        demote_tile(tile);
+    if (diskcache_enabled() && tile.persistable())
+        write_disk_tile(tile);
+}
+
+
+
+void
+ImageCacheImpl::check_file_quota(ImageCacheFile& file)
+{
+    // Free the file's oldest tiles, regardless of how recently they were
+    // used -- a file with a quota is usually streamed through once, so
+    // first in is a good guess at least likely to be needed again. Don't
+    // do too much on any one call; the next tile read will continue.
+    for (int i = 0; i < 16 && file.over_quota(); ++i) {
+        TileID id = file.pop_oldest_resident();
+        if (id.empty())
+            break;
+        // Erase it while holding the bin lock, so that racing evictions
+        // of the same tile can't both succeed.
+        TileCache::iterator found = m_tilecache.find(id);
+        if (!found)
+            continue;  // Already freed by the main sweep
+        if (!found->second->pixels_ready()) {
+            // Still being read by another thread, come back to it later.
+            found.unlock();
+            file.push_resident(id);
+            continue;
+        }
+        ImageCacheTileRef doomed = found->second;
+        m_tilecache.erase(id, false /* don't lock, we hold it already */);
+        found.unlock();
+        evict_tile(*doomed);
+        ++m_stat_tiles_quota_evicted;
+    }
+}
+
+
+
+bool
+ImageCacheImpl::file_attribute(ImageCacheFile* file, string_view name,
+                               TypeDesc type, const void* val)
+{
+    if (!file)
+        return false;
+    if (name == "priority" && type == TypeInt) {
+        file->priority(*(const int*)val);
+        return true;
+    }
+    if (name == "max_resident_MB" && (type == TypeFloat || type == TypeInt)) {
+        float mb = (type == TypeFloat) ? *(const float*)val
+                                       : float(*(const int*)val);
+        file->max_resident_bytes(
+            (long long)(std::max(mb, 0.0f) * 1024.0f * 1024.0f));
+        if (file->over_quota())
+            check_file_quota(*file);
+        return true;
+    }
+    return false;
+}
+
+
+
 void
 ImageCacheImpl::set_min_cache_size(long long newsize)
 {
@@ -1492,6 +2309,9 @@ ImageCacheTile::ImageCacheTile(const TileID& id, const void* pels,
         m_valid = true;
     }
     id.file().imagecache().incr_tiles(m_pixels_size);
+    file.incr_resident(id, m_pixels_size);
+    if (file.imagecache().numa_nodes() > 1)
+        m_numa_node = short(file.imagecache().update_thread_numa_node());
     m_pixels_ready = true;  // Caller sent us the pixels, no read necessary
     // FIXME -- for shadow, fill in mindepth, maxdepth
 }
@@ -1501,6 +2321,16 @@ ImageCacheTile::ImageCacheTile(const TileID& id, const void* pels,
 ImageCacheTile::~ImageCacheTile()
 {
     m_id.file().imagecache().decr_tiles(memsize());
+    m_id.file().decr_resident(memsize());
+    if (std::atomic<char*>* r = m_numa_replicas.load()) {
+        for (int i = 0; i < max_numa_nodes; ++i) {
+            if (char* p = r[i].load()) {
+                delete[] p;
+                m_id.file().imagecache().decr_mem(m_pixels_size);
+            }
+        }
+        delete[] r;
+    }
     if (m_nofree)
         m_pixels.release();  // release without freeing
 }
@@ -1526,17 +2356,81 @@ ImageCacheTile::read(ImageCachePerThreadInfo* thread_info)
     ImageCacheFile& file(m_id.file());
     m_channelsize = file.datatype(id().subimage()).size();
     m_pixelsize   = m_id.nchannels() * m_channelsize;
-    size_t size   = memsize_needed();
+    ImageCacheImpl& imagecache(file.imagecache());
+    if (m_id.deep()) {
+        // Deep samples are held in a DeepData, and count all of its
+        // memory. They are never mapped, constant, or kept in the disk
+        // cache or compressed tier.
+        m_deepdata.reset(new DeepData);
+        m_valid = file.read_deep_tile(thread_info, m_id.subimage(),
+                                      m_id.miplevel(), m_id.x(), m_id.y(),
+                                      m_id.z(), m_id.chbegin(), m_id.chend(),
+                                      *m_deepdata);
+        return finish_read(m_pixels_size = m_deepdata->memsize());
+    }
+    size_t size = memsize_needed();
     OIIO_ASSERT(memsize() == 0 && size > OIIO_SIMD_MAX_SIZE_BYTES);
-    m_pixels.reset(new char[m_pixels_size = size]);
-    // Clear the end pad values so there aren't NaNs sucked up by simd loads
-    memset(m_pixels.get() + size - OIIO_SIMD_MAX_SIZE_BYTES, 0,
-           OIIO_SIMD_MAX_SIZE_BYTES);
-    m_valid = file.read_tile(thread_info, m_id.subimage(), m_id.miplevel(),
-                             m_id.x(), m_id.y(), m_id.z(), m_id.chbegin(),
-                             m_id.chend(), file.datatype(m_id.subimage()),
-                             &m_pixels[0]);
+    // If the file knows the tile is all one value (such as empty space in
+    // a sparse volume), share one copy of it with all the tiles like it.
+    // Otherwise, if allowed, and the file stores the tile exactly as we'd
+    // hold it, use the pixels in place from a memory mapping of the file.
+    // Like tiles made by add_tile without copying, these don't own their
+    // pixels and count no memory against the cache.
+    const void* mapped = file.constant_tile(thread_info, m_id.subimage(),
+                                            m_id.miplevel(), m_id.x(),
+                                            m_id.y(), m_id.z(), m_id.chbegin(),
+                                            m_id.chend(), m_constant);
+    if (!mapped && imagecache.mmap_tiles())
+        mapped = file.map_tile(thread_info, m_id.subimage(), m_id.miplevel(),
+                               m_id.x(), m_id.y(), m_id.z(), m_id.chbegin(),
+                               m_id.chend(), m_mapping);
+    if (!mapped) {
+        m_pixels.reset(new char[m_pixels_size = size]);
+        // Clear the end pad values so there aren't NaNs sucked up by simd
+        // loads
+        memset(m_pixels.get() + size - OIIO_SIMD_MAX_SIZE_BYTES, 0,
+               OIIO_SIMD_MAX_SIZE_BYTES);
+    }
+    // If there's an on-disk tile cache, look there first, and only go to
+    // the image file itself if it's not found.
+    if (mapped) {
+        m_nofree = true;  // Don't free the pointer!
+        m_pixels.reset((char*)mapped);
+        size    = 0;
+        m_valid = true;
+    } else if (imagecache.compressed_tier_enabled()
+               && imagecache.restore_compressed_tile(
+                   m_id, &m_pixels[0], size - OIIO_SIMD_MAX_SIZE_BYTES,
+                   m_persist)) {
+        m_valid = true;
+    } else if (imagecache.diskcache_enabled()
+        && imagecache.read_disk_tile(m_id, &m_pixels[0],
+                                     size - OIIO_SIMD_MAX_SIZE_BYTES,
+                                     thread_info)) {
+        m_valid = true;
+    } else {
+        m_valid   = file.read_tile(thread_info, m_id.subimage(),
+                                 m_id.miplevel(), m_id.x(), m_id.y(), m_id.z(),
+                                 m_id.chbegin(), m_id.chend(),
+                                 file.datatype(m_id.subimage()), &m_pixels[0]);
+        m_persist = m_valid;
+    }
+    return finish_read(size);
+}
+
+
+
+bool
+ImageCacheTile::finish_read(size_t size)
+{
+    ImageCacheFile& file(m_id.file());
+    ImageCacheImpl& imagecache(file.imagecache());
     file.imagecache().incr_mem(size);
+    file.incr_resident(m_id, size);
+    if (imagecache.numa_nodes() > 1) {
+        m_numa_node = short(imagecache.update_thread_numa_node());
+        imagecache.incr_numa_tiles_read(m_numa_node);
+    }
     if (m_valid) {
         ImageCacheFile::LevelInfo& lev(
             file.levelinfo(m_id.subimage(), m_id.miplevel()));
@@ -1578,6 +2472,53 @@ ImageCacheTile::read(ImageCachePerThreadInfo* thread_info)
 
 
 
+void
+ImageCacheTile::set_read_cost(double seconds)
+{
+    // One extra clock sweep of survival for each order of magnitude that
+    // the read took beyond 1ms, up to a maximum of 4 sweeps in total.
+    int lives = 1;
+    for (double t = 0.001; seconds > t && lives < 4; t *= 10.0)
+        ++lives;
+    // The file's priority hint adds (or takes away) sweeps on top.
+    lives = OIIO::clamp(lives + file().priority(), 0, 16);
+    m_lives = lives;
+    if (m_used)
+        m_used = lives;
+}
+
+
+
+bool
+ImageCacheTile::add_numa_replica(int node)
+{
+    if (m_nofree || !m_pixels_size || !m_valid || m_deepdata || node < 0
+        || node >= max_numa_nodes)
+        return false;
+    std::atomic<char*>* r = m_numa_replicas.load(std::memory_order_acquire);
+    if (!r) {
+        std::atomic<char*>* newr = new std::atomic<char*>[max_numa_nodes];
+        for (int i = 0; i < max_numa_nodes; ++i)
+            newr[i] = nullptr;
+        if (m_numa_replicas.compare_exchange_strong(r, newr))
+            r = newr;
+        else
+            delete[] newr;  // somebody else beat us, r is now theirs
+    }
+    if (r[node].load())
+        return false;
+    char* copy = new char[m_pixels_size];
+    memcpy(copy, m_pixels.get(), m_pixels_size);
+    char* expected = nullptr;
+    if (!r[node].compare_exchange_strong(expected, copy)) {
+        delete[] copy;
+        return false;
+    }
+    return true;
+}
+
+
+
 void
 ImageCacheTile::wait_pixels_ready() const
 {
@@ -1605,14 +2546,17 @@ ImageCacheTile::data(int x, int y, int z, int c) const
         return NULL;
     size_t offset = ((z * h + y) * w + x) * pixelsize()
                     + (c - m_id.chbegin()) * channelsize();
-    return (const void*)&m_pixels[offset];
+    return (const void*)(pixels() + offset);
 }
 
 
 
 ImageCacheImpl::ImageCacheImpl()
     : m_perthread_info(&cleanup_perthread_info)
+    , m_tile_index(new std::atomic<ImageCacheTile*>[tile_index_size])
 {
+    for (size_t i = 0; i < tile_index_size; ++i)
+        m_tile_index[i] = nullptr;
     init();
 }
 
@@ -1649,6 +2593,10 @@ ImageCacheImpl::init()
     m_latlong_y_up_default = true;
     m_Mw2c.makeIdentity();
     m_mem_used                = 0;
+    m_max_diskcache_bytes     = 10 * 1024LL * 1024 * 1024;  // 10 GB
+    m_diskcache_bytes         = 0;
+    m_max_compressed_bytes    = 0;
+    m_compressed_bytes        = 0;
     m_statslevel              = 0;
     m_max_errors_per_file     = 100;
     m_stat_tiles_created      = 0;
@@ -1657,6 +2605,20 @@ ImageCacheImpl::init()
     m_stat_open_files_created = 0;
     m_stat_open_files_current = 0;
     m_stat_open_files_peak    = 0;
+    m_stat_diskcache_tiles_written = 0;
+    m_stat_tiles_prefetched        = 0;
+    m_stat_compressed_tiles_demoted  = 0;
+    m_stat_compressed_tiles_restored = 0;
+    m_stat_tiles_quota_evicted       = 0;
+    m_stat_memory_pressure_events    = 0;
+    m_stat_bands_reused              = 0;
+    m_memory_thread_stop             = false;
+    m_watch_files                    = false;
+    for (int i = 0; i < ImageCacheTile::max_numa_nodes; ++i) {
+        m_stat_numa_tiles_read[i] = 0;
+        m_stat_numa_replicas[i]   = 0;
+    }
+    m_prefetch_threads             = 4;
 
     // Allow environment variable to override default options
     const char* options = getenv("OPENIMAGEIO_IMAGECACHE_OPTIONS");
@@ -1668,8 +2630,22 @@ ImageCacheImpl::init()
 
 ImageCacheImpl::~ImageCacheImpl()
 {
+    // Let any queued prefetch reads finish before we tear anything down.
+    m_prefetch_pool.reset();
+    set_max_memory_fraction(0.0f);
+    set_watch_files(false);
     printstats();
     erase_perthread_info();
+    // Nobody can be looking in the tile index any more, so release all
+    // of its tiles right away.
+    unpublish_tiles({});
+    std::vector<ImageCacheTile*> freeable;
+    {
+        spin_lock lock(m_retired_tiles_mutex);
+        reclaim_retired_tiles(freeable, true);
+    }
+    for (ImageCacheTile* t : freeable)
+        intrusive_ptr_release(t);
 }
 
 
@@ -1685,6 +2661,26 @@ ImageCacheImpl::mergestats(ImageCacheStatistics& stats) const
 
 
 
+void
+ImageCacheImpl::merge_lookup_costs(LookupCostMap& files,
+                                   LookupCostMap& sites) const
+{
+    files.clear();
+    sites.clear();
+    spin_lock lock(m_perthread_info_mutex);
+    for (ImageCachePerThreadInfo* p : m_all_perthread_info) {
+        if (!p)
+            continue;
+        spin_lock costlock(p->m_cost_mutex);
+        for (auto& c : p->m_file_costs)
+            files[c.first].merge(c.second);
+        for (auto& c : p->m_site_costs)
+            sites[c.first].merge(c.second);
+    }
+}
+
+
+
 std::string
 ImageCacheImpl::onefile_stat_line(const ImageCacheFileRef& file, int i,
                                   bool includestats) const
@@ -1905,11 +2901,48 @@ ImageCacheImpl::getstats(int level) const
                 << " peak\n";
             out << "    total tile requests : " << stats.find_tile_calls
                 << "\n";
+            TileCache::Stats tablestats = m_tilecache.stats();
+            if (tablestats.resizes)
+                out << "    tile table : load factor "
+                    << Strutil::sprintf("%.2f", tablestats.load_factor())
+                    << ", " << tablestats.resizes << " resizes ("
+                    << tablestats.resizing << " in progress)\n";
+            if (m_stat_tiles_prefetched)
+                out << "    tiles prefetched : " << m_stat_tiles_prefetched
+                    << "\n";
+            if (stats.tiles_mapped)
+                out << "    tiles memory-mapped : " << stats.tiles_mapped
+                    << "\n";
+            if (stats.tiles_constant)
+                out << "    constant tiles shared : " << stats.tiles_constant
+                    << "\n";
+            if (stats.tiles_readahead)
+                out << "    tiles read ahead : " << stats.tiles_readahead
+                    << "\n";
+            if (stats.page_fills)
+                out << "    atlas pages filled : " << stats.page_fills << " ("
+                    << stats.page_evictions << " recycled)\n";
+            if (stats.bytes_streamed)
+                out << "    read without caching, for big get_pixels : "
+                    << Strutil::memformat(stats.bytes_streamed) << "\n";
+            if (stats.spare_inputs_opened)
+                out << "    extra file handles for concurrent reads : "
+                    << stats.spare_inputs_opened << "\n";
             out << "    micro-cache misses : "
                 << stats.find_tile_microcache_misses << " ("
                 << 100.0 * (double)stats.find_tile_microcache_misses
                        / (double)stats.find_tile_calls
                 << "%)\n";
+            out << "    micro-cache hits other than the last tile : "
+                << stats.find_tile_microcache_assoc_hits << " ("
+                << 100.0 * (double)stats.find_tile_microcache_assoc_hits
+                       / (double)stats.find_tile_calls
+                << "%)\n";
+            out << "    lock-free tile index hits : "
+                << stats.find_tile_index_hits << " ("
+                << 100.0 * (double)stats.find_tile_index_hits
+                       / (double)stats.find_tile_calls
+                << "%)\n";
             out << "    main cache misses : " << stats.find_tile_cache_misses
                 << " ("
                 << 100.0 * (double)stats.find_tile_cache_misses
@@ -1921,6 +2954,37 @@ ImageCacheImpl::getstats(int level) const
         }
         out << "    Peak cache memory : " << Strutil::memformat(m_mem_used)
             << "\n";
+        if (diskcache_enabled()) {
+            out << "  Disk tile cache: " << m_diskcache_dir << "\n";
+            out << "    tiles read : " << stats.diskcache_tiles_read << " ("
+                << Strutil::memformat(stats.diskcache_bytes_read) << ")\n";
+            out << "    tiles written : " << m_stat_diskcache_tiles_written
+                << " (" << Strutil::memformat(m_diskcache_bytes) << ")\n";
+        }
+        if (compressed_tier_enabled() || m_stat_compressed_tiles_demoted) {
+            out << "  Compressed tile tier: "
+                << Strutil::memformat(m_max_compressed_bytes) << " limit\n";
+            out << "    tiles compressed : " << m_stat_compressed_tiles_demoted
+                << ", restored : " << m_stat_compressed_tiles_restored
+                << "\n";
+            out << "    current : " << m_compressed_tiles.size()
+                << " tiles, " << Strutil::memformat(m_compressed_bytes)
+                << "\n";
+        }
+        if (m_stat_tiles_quota_evicted)
+            out << "    Tiles freed by per-file quotas : "
+                << m_stat_tiles_quota_evicted << "\n";
+        if (m_stat_memory_pressure_events)
+            out << "    Memory pressure events : "
+                << m_stat_memory_pressure_events << " (budget now "
+                << Strutil::memformat(m_max_memory_bytes) << ")\n";
+        if (m_numa_nodes > 1) {
+            out << "  NUMA nodes : " << m_numa_nodes << "\n";
+            for (int n = 0; n < m_numa_nodes; ++n)
+                out << "    node " << n << ": tiles read "
+                    << m_stat_numa_tiles_read[n] << ", replicated here "
+                    << m_stat_numa_replicas[n] << "\n";
+        }
         if (stats.tile_locking_time > 0.001)
             out << "    Tile mutex locking time : "
                 << Strutil::timeintervalformat(stats.tile_locking_time) << "\n";
@@ -1958,6 +3022,33 @@ ImageCacheImpl::getstats(int level) const
             Strutil::timeintervalformat(total_iotime));
     }
 
+    if (level >= 5
+        && (stats.lookup_latency.count || stats.tile_wait_latency.count
+            || stats.fileopen_latency.count)) {
+        auto fmt = [](double s) {
+            return s < 1.0e-3 ? Strutil::sprintf("%.1fus", s * 1.0e6)
+                   : s < 1.0  ? Strutil::sprintf("%.2fms", s * 1.0e3)
+                              : Strutil::sprintf("%.2fs", s);
+        };
+        out << Strutil::sprintf("  %-16s %10s %10s %10s %10s %10s %10s %10s\n",
+                                "Latencies:", "count", "mean", "p50", "p90",
+                                "p99", "p99.9", "max");
+        auto line = [&](const char* what, const LatencyHistogram& h) {
+            if (!h.count)
+                return;
+            out << Strutil::sprintf("    %-14s %10lld %10s %10s %10s %10s "
+                                    "%10s %10s\n",
+                                    what, h.count, fmt(h.total / h.count),
+                                    fmt(h.percentile(50.0)),
+                                    fmt(h.percentile(90.0)),
+                                    fmt(h.percentile(99.0)),
+                                    fmt(h.percentile(99.9)), fmt(h.max));
+        };
+        line("lookup", stats.lookup_latency);
+        line("tile wait", stats.tile_wait_latency);
+        line("file open", stats.fileopen_latency);
+    }
+
     // Try to point out hot spots
     if (level > 0) {
         if (total_duplicates)
@@ -2091,8 +3182,13 @@ ImageCacheImpl::reset_stats()
 {
     {
         spin_lock lock(m_perthread_info_mutex);
-        for (size_t i = 0; i < m_all_perthread_info.size(); ++i)
-            m_all_perthread_info[i]->m_stats.init();
+        for (size_t i = 0; i < m_all_perthread_info.size(); ++i) {
+            ImageCachePerThreadInfo* p = m_all_perthread_info[i];
+            p->m_stats.init();
+            spin_lock costlock(p->m_cost_mutex);
+            p->m_file_costs.clear();
+            p->m_site_costs.clear();
+        }
     }
 
     {
@@ -2121,6 +3217,7 @@ ImageCacheImpl::attribute(string_view name, TypeDesc type, const void* val)
         set_max_open_files(*(const int*)val);
     } else if (name == "max_memory_MB" && type == TypeDesc::FLOAT) {
         float size = *(const float*)val;
+        set_max_memory_fraction(0.0f);
 #ifdef NDEBUG
         size = std::max(size, 10.0f);  // Don't let users choose < 10 MB
 #else
@@ -2129,12 +3226,40 @@ ImageCacheImpl::attribute(string_view name, TypeDesc type, const void* val)
         m_max_memory_bytes = (long long)(size * (long long)(1024 * 1024));
     } else if (name == "max_memory_MB" && type == TypeDesc::INT) {
         float size = *(const int*)val;
+        set_max_memory_fraction(0.0f);
 #ifdef NDEBUG
         size = std::max(size, 10.0f);  // Don't let users choose < 10 MB
 #else
         size = std::max(size, 1.0f);  // But let developers debugging do it
 #endif
         m_max_memory_bytes = (long long)(size * (long long)(1024 * 1024));
+    } else if (name == "max_memory_fraction" && type == TypeDesc::FLOAT) {
+        set_max_memory_fraction(*(const float*)val);
+    } else if (name == "max_diskcache_MB" && type == TypeDesc::FLOAT) {
+        float size            = std::max(*(const float*)val, 0.0f);
+        m_max_diskcache_bytes = (long long)(size * (long long)(1024 * 1024));
+    } else if (name == "max_diskcache_MB" && type == TypeDesc::INT) {
+        float size            = std::max(*(const int*)val, 0);
+        m_max_diskcache_bytes = (long long)(size * (long long)(1024 * 1024));
+    } else if (Strutil::iequals(name, "compressed_tier_MB")
+               && (type == TypeDesc::FLOAT || type == TypeDesc::INT)) {
+        float size = type == TypeDesc::FLOAT ? *(const float*)val
+                                             : float(*(const int*)val);
+        m_max_compressed_bytes = (long long)(std::max(size, 0.0f)
+                                             * (long long)(1024 * 1024));
+        spin_lock lock(m_compressed_mutex);
+        trim_compressed_tiles();
+    } else if (name == "diskcache_dir" && type == TypeDesc::STRING) {
+        std::string dir = std::string(*(const char**)val);
+        if (dir.size() && !Filesystem::is_directory(dir)) {
+            std::string err;
+            if (!Filesystem::create_directory(dir, err)) {
+                error("Could not create disk tile cache directory \"{}\": {}",
+                      dir, err);
+                dir.clear();
+            }
+        }
+        m_diskcache_dir = dir;
     } else if (name == "searchpath" && type == TypeDesc::STRING) {
         std::string s = std::string(*(const char**)val);
         if (s != m_searchpath) {
@@ -2198,6 +3323,12 @@ ImageCacheImpl::attribute(string_view name, TypeDesc type, const void* val)
             m_deduplicate = r;
             do_invalidate = true;
         }
+    } else if (name == "deduplicate_content" && type == TypeDesc::INT) {
+        bool r = (*(const int*)val != 0);
+        if (r != m_deduplicate_content) {
+            m_deduplicate_content = r;
+            do_invalidate         = true;
+        }
     } else if (name == "unassociatedalpha" && type == TypeDesc::INT) {
         bool r = (*(const int*)val != 0);
         if (r != m_unassociatedalpha) {
@@ -2206,8 +3337,35 @@ ImageCacheImpl::attribute(string_view name, TypeDesc type, const void* val)
         }
     } else if (name == "failure_retries" && type == TypeDesc::INT) {
         m_failure_retries = *(const int*)val;
+    } else if (name == "max_readahead_tiles" && type == TypeDesc::INT) {
+        m_max_readahead_tiles = *(const int*)val;
+    } else if (name == "numa_replicate" && type == TypeDesc::INT) {
+        m_numa_replicate = std::max(*(const int*)val, 0);
+        int nodes        = std::min(Sysutil::numa_nodes(),
+                             int(ImageCacheTile::max_numa_nodes));
+        m_numa_nodes     = (m_numa_replicate && nodes > 1) ? nodes : 0;
+    } else if (name == "get_pixels_streaming" && type == TypeDesc::INT) {
+        m_get_pixels_streaming = *(const int*)val;
+    } else if (name == "max_inputs_per_file" && type == TypeDesc::INT) {
+        m_max_inputs_per_file = std::max(*(const int*)val, 1);
+    } else if (name == "prefetch_threads" && type == TypeDesc::INT) {
+        int n = std::max(*(const int*)val, 0);
+        spin_lock lock(m_prefetch_pool_mutex);
+        if (n != m_prefetch_threads) {
+            m_prefetch_threads = n;
+            if (m_prefetch_pool)
+                m_prefetch_pool->resize(n);
+        }
     } else if (name == "trust_file_extensions" && type == TypeDesc::INT) {
         m_trust_file_extensions = *(const int*)val;
+    } else if (name == "mmap_tiles" && type == TypeDesc::INT) {
+        m_mmap_tiles = (*(const int*)val != 0);
+    } else if (name == "latency_stats" && type == TypeDesc::INT) {
+        m_latency_stats = (*(const int*)val != 0);
+    } else if (name == "watch_files" && type == TypeDesc::INT) {
+        bool w = (*(const int*)val != 0);
+        if (w != m_watch_files)
+            set_watch_files(w);
     } else if (name == "latlong_up" && type == TypeDesc::STRING) {
         bool y_up = !strcmp("y", *(const char**)val);
         if (y_up != m_latlong_y_up_default) {
@@ -2225,8 +3383,12 @@ ImageCacheImpl::attribute(string_view name, TypeDesc type, const void* val)
         return false;
     }
 
-    if (do_invalidate)
-        invalidate_all(force_invalidate);
+    if (do_invalidate) {
+        if (force_invalidate)
+            invalidate_all(true);
+        else
+            invalidate_stale(true);
+    }
     return true;
 }
 
@@ -2244,6 +3406,15 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
     ATTR_DECODE("max_open_files", int, m_max_open_files);
     ATTR_DECODE("max_memory_MB", float, m_max_memory_bytes / (1024.0 * 1024.0));
     ATTR_DECODE("max_memory_MB", int, m_max_memory_bytes / (1024 * 1024));
+    ATTR_DECODE("max_memory_fraction", float, m_max_memory_fraction);
+    ATTR_DECODE("max_diskcache_MB", float,
+                m_max_diskcache_bytes / (1024.0 * 1024.0));
+    ATTR_DECODE("max_diskcache_MB", int,
+                m_max_diskcache_bytes / (1024 * 1024));
+    ATTR_DECODE("compressed_tier_MB", float,
+                m_max_compressed_bytes / (1024.0 * 1024.0));
+    ATTR_DECODE("compressed_tier_MB", int,
+                m_max_compressed_bytes / (1024 * 1024));
     ATTR_DECODE("statistics:level", int, m_statslevel);
     ATTR_DECODE("max_errors_per_file", int, m_max_errors_per_file);
     ATTR_DECODE("autotile", int, m_autotile);
@@ -2253,9 +3424,19 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
     ATTR_DECODE("accept_untiled", int, m_accept_untiled);
     ATTR_DECODE("accept_unmipped", int, m_accept_unmipped);
     ATTR_DECODE("deduplicate", int, m_deduplicate);
+    ATTR_DECODE("deduplicate_content", int, m_deduplicate_content);
     ATTR_DECODE("unassociatedalpha", int, m_unassociatedalpha);
     ATTR_DECODE("trust_file_extensions", int, m_trust_file_extensions);
+    ATTR_DECODE("mmap_tiles", int, m_mmap_tiles);
+    ATTR_DECODE("latency_stats", int, m_latency_stats);
+    ATTR_DECODE("watch_files", int, m_watch_files);
+    ATTR_DECODE("prefetch_threads", int, m_prefetch_threads);
     ATTR_DECODE("failure_retries", int, m_failure_retries);
+    ATTR_DECODE("max_readahead_tiles", int, m_max_readahead_tiles);
+    ATTR_DECODE("max_inputs_per_file", int, m_max_inputs_per_file);
+    ATTR_DECODE("get_pixels_streaming", int, m_get_pixels_streaming);
+    ATTR_DECODE("numa_replicate", int, m_numa_replicate);
+    ATTR_DECODE("stat:numa_nodes", int, std::max(m_numa_nodes, 1));
     ATTR_DECODE("total_files", int, m_files.size());
     ATTR_DECODE("max_mip_res", int, m_max_mip_res);
 
@@ -2268,6 +3449,10 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
         *(ustring*)val = m_plugin_searchpath;
         return true;
     }
+    if (name == "diskcache_dir" && type == TypeDesc::STRING) {
+        *(ustring*)val = m_diskcache_dir;
+        return true;
+    }
     if (name == "worldtocommon"
         && (type == TypeMatrix || type == TypeDesc(TypeDesc::FLOAT, 16))) {
         *(Imath::M44f*)val = m_Mw2c;
@@ -2306,6 +3491,30 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
         ATTR_DECODE("stat:open_files_created", int, m_stat_open_files_created);
         ATTR_DECODE("stat:open_files_current", int, m_stat_open_files_current);
         ATTR_DECODE("stat:open_files_peak", int, m_stat_open_files_peak);
+        ATTR_DECODE("stat:tiles_prefetched", int, m_stat_tiles_prefetched);
+        ATTR_DECODE("stat:compressed_tiles", int, m_compressed_tiles.size());
+        ATTR_DECODE("stat:compressed_bytes", long long, m_compressed_bytes);
+        ATTR_DECODE("stat:compressed_tiles_demoted", int,
+                    m_stat_compressed_tiles_demoted);
+        ATTR_DECODE("stat:compressed_tiles_restored", int,
+                    m_stat_compressed_tiles_restored);
+        ATTR_DECODE("stat:tiles_quota_evicted", int,
+                    m_stat_tiles_quota_evicted);
+        ATTR_DECODE("stat:diskcache_tiles_written", int,
+                    m_stat_diskcache_tiles_written);
+        ATTR_DECODE("stat:diskcache_bytes_written", long long,
+                    m_diskcache_bytes);
+        ATTR_DECODE("stat:memory_pressure_events", int,
+                    m_stat_memory_pressure_events);
+        ATTR_DECODE("stat:autotile_bands_reused", int, m_stat_bands_reused);
+        if (name == "stat:tile_table_load_factor" && type == TypeFloat) {
+            *(float*)val = m_tilecache.stats().load_factor();
+            return true;
+        }
+        if (name == "stat:tile_table_resizes" && type == TypeInt) {
+            *(int*)val = int(m_tilecache.stats().resizes);
+            return true;
+        }
 
         // All the other stats are those that need to be summed from all
         // the threads.
@@ -2314,6 +3523,10 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
         ATTR_DECODE("stat:find_tile_calls", long long, stats.find_tile_calls);
         ATTR_DECODE("stat:find_tile_microcache_misses", long long,
                     stats.find_tile_microcache_misses);
+        ATTR_DECODE("stat:find_tile_microcache_assoc_hits", long long,
+                    stats.find_tile_microcache_assoc_hits);
+        ATTR_DECODE("stat:find_tile_index_hits", long long,
+                    stats.find_tile_index_hits);
         ATTR_DECODE("stat:find_tile_cache_misses", int,
                     stats.find_tile_cache_misses);
         ATTR_DECODE("stat:files_totalsize", long long,
@@ -2321,6 +3534,18 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
         ATTR_DECODE("stat:image_size", long long, stats.files_totalsize);
         ATTR_DECODE("stat:file_size", long long, stats.files_totalsize_ondisk);
         ATTR_DECODE("stat:bytes_read", long long, stats.bytes_read);
+        ATTR_DECODE("stat:diskcache_tiles_read", long long,
+                    stats.diskcache_tiles_read);
+        ATTR_DECODE("stat:diskcache_bytes_read", long long,
+                    stats.diskcache_bytes_read);
+        ATTR_DECODE("stat:tiles_mapped", long long, stats.tiles_mapped);
+        ATTR_DECODE("stat:tiles_constant", long long, stats.tiles_constant);
+        ATTR_DECODE("stat:tiles_readahead", long long, stats.tiles_readahead);
+        ATTR_DECODE("stat:page_fills", long long, stats.page_fills);
+        ATTR_DECODE("stat:page_evictions", long long, stats.page_evictions);
+        ATTR_DECODE("stat:spare_inputs_opened", long long,
+                    stats.spare_inputs_opened);
+        ATTR_DECODE("stat:bytes_streamed", long long, stats.bytes_streamed);
         ATTR_DECODE("stat:unique_files", int, stats.unique_files);
         ATTR_DECODE("stat:fileio_time", float, stats.fileio_time);
         ATTR_DECODE("stat:fileopen_time", float, stats.fileopen_time);
@@ -2333,10 +3558,65 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
                     stats.texture3d_queries);
         ATTR_DECODE("stat:environment_queries", long long,
                     stats.environment_queries);
+        ATTR_DECODE("stat:deferred_queries", long long,
+                    stats.deferred_queries);
+        ATTR_DECODE("stat:deferred_tile_switches", long long,
+                    stats.deferred_tile_switches);
+        ATTR_DECODE("stat:deferred_tile_switches_unsorted", long long,
+                    stats.deferred_tile_switches_unsorted);
+        ATTR_DECODE("stat:ewa_queries", long long, stats.ewa_queries);
+        ATTR_DECODE("stat:ewa_texels", long long, stats.ewa_texels);
+        ATTR_DECODE("stat:aniso_probes", long long, stats.aniso_probes);
+        ATTR_DECODE("stat:closest_interps", long long, stats.closest_interps);
+        ATTR_DECODE("stat:bilinear_interps", long long,
+                    stats.bilinear_interps);
+        ATTR_DECODE("stat:cubic_interps", long long, stats.cubic_interps);
+        ATTR_DECODE("stat:shadow_taps", long long, stats.shadow_taps);
+        ATTR_DECODE("stat:shadow_blocker_searches", long long,
+                    stats.shadow_blocker_searches);
         ATTR_DECODE("stat:getimageinfo_queries", long long,
                     stats.imageinfo_queries);
         ATTR_DECODE("stat:gettextureinfo_queries", long long,
                     stats.imageinfo_queries);
+        if (name == "stat:input_mutex_wait_time" && type == TypeFloat) {
+            double wait = 0.0;
+            for (FilenameMap::iterator f = m_files.begin(); f != m_files.end();
+                 ++f)
+                wait += f->second->m_mutex_wait_time;
+            *(float*)val = float(wait);
+            return true;
+        }
+        // Latencies: "stat:<which>_latency_<stat>", where the stat is
+        // "count", "mean", "max", or a percentile such as "p50" or "p999"
+        // (99.9%), all but the count being in seconds.
+        const std::pair<const char*, const LatencyHistogram*> latencies[]
+            = { { "stat:lookup_latency_", &stats.lookup_latency },
+                { "stat:tile_wait_latency_", &stats.tile_wait_latency },
+                { "stat:fileopen_latency_", &stats.fileopen_latency } };
+        for (auto& l : latencies) {
+            string_view which = name;
+            if (!Strutil::parse_prefix(which, l.first))
+                continue;
+            const LatencyHistogram& h(*l.second);
+            if (which == "count" && type == TypeDesc::INT64) {
+                *(long long*)val = h.count;
+                return true;
+            }
+            if (type != TypeFloat)
+                return false;
+            if (which == "mean")
+                *(float*)val = h.count ? float(h.total / h.count) : 0.0f;
+            else if (which == "max")
+                *(float*)val = float(h.max);
+            else if (which.size() >= 3 && which[0] == 'p'
+                     && Strutil::string_is_int(which.substr(1)))
+                *(float*)val = float(h.percentile(
+                    Strutil::stoi(which.substr(1))
+                    / std::pow(10.0, int(which.size()) - 3)));
+            else
+                return false;
+            return true;
+        }
     }
 
     return false;
@@ -2345,6 +3625,23 @@ ImageCacheImpl::getattribute(string_view name, TypeDesc type, void* val) const
 
 
 
+// Wait until the tile's pixels, which another thread may still be
+// reading, are ready, timing the wait if it's one and we're asked to.
+static void
+wait_pixels_ready(const ImageCacheTile& tile, bool latency_stats,
+                  ImageCacheStatistics& stats)
+{
+    if (latency_stats && !tile.pixels_ready()) {
+        Timer timer;
+        tile.wait_pixels_ready();
+        stats.tile_wait_latency.record(timer());
+    } else {
+        tile.wait_pixels_ready();
+    }
+}
+
+
+
 bool
 ImageCacheImpl::find_tile_main_cache(const TileID& id, ImageCacheTileRef& tile,
                                      ImageCachePerThreadInfo* thread_info)
@@ -2354,11 +3651,34 @@ ImageCacheImpl::find_tile_main_cache(const TileID& id, ImageCacheTileRef& tile,
 
     ++stats.find_tile_microcache_misses;
 
+    // Most tiles that are in the cache at all can be found in the
+    // lock-free index, without touching the bin locks.
+    size_t hash = id.hash();
+    tile        = find_tile_index(id, hash, thread_info);
+    if (tile) {
+        ++stats.find_tile_index_hits;
+        wait_pixels_ready(*tile, m_latency_stats, stats);
+        tile->use();
+        if (m_numa_nodes > 1)
+            numa_replicate(*tile, update_thread_numa_node());
+        return true;
+    }
+
     {
 #if IMAGECACHE_TIME_STATS
         Timer timer1;
 #endif
-        bool found = m_tilecache.retrieve(id, tile);
+        bool found = false;
+        {
+            TileCache::iterator t = m_tilecache.find(id);
+            if (t) {
+                // Publish it while the bin is locked, so that it can't be
+                // erased before it's in the index.
+                tile = t->second;
+                publish_tile(tile.get(), hash);
+                found = true;
+            }
+        }
 #if IMAGECACHE_TIME_STATS
         stats.find_tile_time += timer1();
 #endif
@@ -2368,10 +3688,12 @@ ImageCacheImpl::find_tile_main_cache(const TileID& id, ImageCacheTileRef& tile,
             // released the lock (above) before calling wait_pixels_ready,
             // otherwise we could deadlock if another thread reading the
             // pixels needs to lock the cache because it's doing automip.
-            tile->wait_pixels_ready();
+            wait_pixels_ready(*tile, m_latency_stats, stats);
             tile->use();
             OIIO_DASSERT(id == tile->id());
             OIIO_DASSERT(tile);
+            if (m_numa_nodes > 1)
+                numa_replicate(*tile, update_thread_numa_node());
             return true;
         }
     }
@@ -2390,7 +3712,10 @@ ImageCacheImpl::find_tile_main_cache(const TileID& id, ImageCacheTileRef& tile,
     OIIO_DASSERT(tile);
     OIIO_DASSERT(id == tile->id());
 
+    Timer waittimer(m_latency_stats ? Timer::StartNow : Timer::DontStartNow);
     bool ok = add_tile_to_cache(tile, thread_info);
+    if (m_latency_stats)
+        stats.tile_wait_latency.record(waittimer());
     OIIO_DASSERT(id == tile->id());
     return ok && tile->valid();
 }
@@ -2408,14 +3733,7 @@ ImageCacheImpl::add_tile_to_cache(ImageCacheTileRef& tile,
     // somebody else to read the pixels.
     bool ok = true;
     if (ourtile) {
-        if (!tile->pixels_ready()) {
-            Timer timer;
-            ok              = tile->read(thread_info);
-            double readtime = timer();
-            thread_info->m_stats.fileio_time += readtime;
-            tile->id().file().iotime() += readtime;
-        }
-        check_max_mem(thread_info);
+        ok = read_new_tile(tile, thread_info);
     } else {
         // Somebody else already added the tile to the cache before we
         // could, so we'll use their reference, but we need to wait until it
@@ -2427,8 +3745,146 @@ ImageCacheImpl::add_tile_to_cache(ImageCacheTileRef& tile,
 
 
 
+ImageCacheTileRef
+ImageCacheImpl::find_tile_index(const TileID& id, size_t hash,
+                                ImageCachePerThreadInfo* thread_info)
+{
+    ImageCacheTileRef tile;
+    // Announce the epoch we're looking in, so that a tile we find can't
+    // be released out from under us before we've taken our reference.
+    thread_info->tile_epoch = m_tile_epoch.load();
+    ImageCacheTile* t = m_tile_index[hash & (tile_index_size - 1)].load();
+    if (t && t->id() == id)
+        tile = t;
+    thread_info->tile_epoch = 0;
+    return tile;
+}
+
+
+
+void
+ImageCacheImpl::publish_tile(ImageCacheTile* tile, size_t hash)
+{
+    std::atomic<ImageCacheTile*>& slot(
+        m_tile_index[hash & (tile_index_size - 1)]);
+    if (slot.load() == tile)
+        return;  // already there
+    intrusive_ptr_add_ref(tile);  // the index's reference
+    ImageCacheTile* old = slot.exchange(tile);
+    if (old)
+        retire_tile(old);
+}
+
+
+
+void
+ImageCacheImpl::unpublish_tile(ImageCacheTile* tile)
+{
+    ImageCacheTile* expected = tile;
+    if (m_tile_index[tile->id().hash() & (tile_index_size - 1)]
+            .compare_exchange_strong(expected, nullptr))
+        retire_tile(tile);
+}
+
+
+
+void
+ImageCacheImpl::unpublish_tiles(cspan<const ImageCacheFile*> files)
+{
+    // Holding the retired list lock keeps any tile from being released
+    // while we examine it, because releases are only decided under it.
+    spin_lock lock(m_retired_tiles_mutex);
+    for (size_t i = 0; i < tile_index_size; ++i) {
+        ImageCacheTile* t = m_tile_index[i].load();
+        if (t
+            && (files.empty()
+                || std::binary_search(files.begin(), files.end(),
+                                      &t->file()))
+            && m_tile_index[i].compare_exchange_strong(t, nullptr))
+            m_retired_tiles.emplace_back(m_tile_epoch.fetch_add(1), t);
+    }
+}
+
+
+
+void
+ImageCacheImpl::retire_tile(ImageCacheTile* tile)
+{
+    std::vector<ImageCacheTile*> freeable;
+    {
+        spin_lock lock(m_retired_tiles_mutex);
+        // The epoch increment comes after the tile left the index, so any
+        // reader that starts in a later epoch can't find it.
+        m_retired_tiles.emplace_back(m_tile_epoch.fetch_add(1), tile);
+        if (m_retired_tiles.size() >= 64)
+            reclaim_retired_tiles(freeable);
+    }
+    // Release outside the lock, since this may free the tiles.
+    for (ImageCacheTile* t : freeable)
+        intrusive_ptr_release(t);
+}
+
+
+
+void
+ImageCacheImpl::reclaim_retired_tiles(std::vector<ImageCacheTile*>& freeable,
+                                      bool all)
+{
+    // A tile retired in epoch e may still be seen by a reader that
+    // started in an epoch <= e, but not by any later one.
+    uint64_t oldest = std::numeric_limits<uint64_t>::max();
+    if (!all) {
+        spin_lock lock(m_perthread_info_mutex);
+        for (ImageCachePerThreadInfo* p : m_all_perthread_info) {
+            uint64_t e = p ? p->tile_epoch.load() : 0;
+            if (e && e < oldest)
+                oldest = e;
+        }
+    }
+    size_t keep = 0;
+    for (auto& r : m_retired_tiles) {
+        if (r.first < oldest)
+            freeable.push_back(r.second);
+        else
+            m_retired_tiles[keep++] = r;
+    }
+    m_retired_tiles.resize(keep);
+}
+
+
+
+bool
+ImageCacheImpl::read_new_tile(ImageCacheTileRef& tile,
+                              ImageCachePerThreadInfo* thread_info)
+{
+    bool ok = true;
+    if (!tile->pixels_ready()) {
+        Timer timer;
+        ok              = tile->read(thread_info);
+        double readtime = timer();
+        thread_info->m_stats.fileio_time += readtime;
+        ImageCacheFile& file(tile->id().file());
+        file.iotime() += readtime;
+        // Weight the tile by what it would cost to read it again: the
+        // slower of this read and the file's average per-tile read,
+        // which reflects the file's format, compression, and the speed
+        // of the device it lives on.
+        double avgtime = file.tilesread()
+                             ? file.iotime() / double(file.tilesread())
+                             : 0.0;
+        tile->set_read_cost(std::max(readtime, avgtime));
+    }
+    check_max_mem(thread_info, m_tilecache.bin_of(tile->id()));
+    if (tile->id().file().over_quota())
+        check_file_quota(tile->id().file());
+    return ok;
+}
+
+
+
 void
-ImageCacheImpl::check_max_mem(ImageCachePerThreadInfo* /*thread_info*/)
+ImageCacheImpl::check_max_mem(ImageCachePerThreadInfo* /*thread_info*/,
+                              size_t startbin)
 {
     OIIO_DASSERT(m_mem_used < (long long)m_max_memory_bytes * 10);  // sanity
 #if 0
@@ -2443,80 +3899,236 @@ ImageCacheImpl::check_max_mem(ImageCachePerThreadInfo* /*thread_info*/)
     if (m_mem_used < (long long)m_max_memory_bytes)
         return;
 
-    // Try to grab the tile_sweep_mutex lock. If somebody else holds it,
-    // just return -- leave the memory limit enforcement to whomever is
-    // already in this function, no need for two threads to do it at
-    // once.  If this means we may ephemerally be over the memory limit
-    // (because another thread adds a tile before we have freed enough
-    // here), so be it.
-    if (!m_tile_sweep_mutex.try_lock())
+    // What we want to do is have a "clock hand" that sweeps across the
+    // cache, releasing tiles that haven't been used for a long time. So
+    // that many threads may free memory at once, there is a separate hand
+    // for each bin of the tile cache, and a thread only sweeps bins whose
+    // sweep mutex it can grab without waiting. If every bin is already
+    // being swept by somebody else, just return -- leave the memory limit
+    // enforcement to whomever is already doing it. If this means we may
+    // ephemerally be over the memory limit (because another thread adds a
+    // tile before we have freed enough), so be it.
+    //
+    // Starting at a bin that depends on the caller (the bin of the tile
+    // it just added) spreads the concurrent sweepers over different bins.
+    //
+    // Be careful of looping for too long, exit the loop if we just keep
+    // spinning uncontrollably.
+    const size_t nbins = TileCache::nbins();
+    int full_loops     = 0;
+    for (size_t i = 0; m_mem_used >= (long long)m_max_memory_bytes; ++i) {
+        if (i == nbins) {
+            i = 0;
+            if (++full_loops >= 100 || m_tilecache.empty())
+                break;
+        }
+        size_t bin = (startbin + i) % nbins;
+        TileSweepShard& shard(m_tile_sweep[bin]);
+        if (!shard.mutex.try_lock())
+            continue;
+        sweep_tile_bin(bin, shard);
+        shard.mutex.unlock();
+    }
+}
+
+
+
+void
+ImageCacheImpl::set_max_memory_fraction(float fraction)
+{
+    // Stop any thread adapting the budget to the previous setting.
+    if (m_memory_thread.joinable()) {
+        m_memory_thread_stop = true;
+        m_memory_monitor->interrupt();
+        m_memory_thread.join();
+        m_memory_thread_stop = false;
+    }
+    m_memory_monitor.reset();
+    m_max_memory_fraction = OIIO::clamp(fraction, 0.0f, 1.0f);
+    if (m_max_memory_fraction == 0.0f)
         return;
 
-    // Now, what we want to do is have a "clock hand" that sweeps across
-    // the cache, releasing tiles that haven't been used for a long
-    // time.  Because of multi-thread, rather than keep an iterator
-    // around for this (which could be invalidated since the last time
-    // we used it), we just remember the tileID of the next tile to
-    // check, then look it up fresh.  That is m_tile_sweep_id.
+    // The ceiling respects any cgroup (container) limit, not just the
+    // physical memory of the machine.
+    long long ceiling = (long long)(m_max_memory_fraction
+                                    * double(Sysutil::memory_limit()));
+    if (ceiling <= 0)
+        return;  // No idea how much memory there is; leave the budget be
+    ceiling            = std::max(ceiling, 10LL * 1024 * 1024);
+    m_max_memory_bytes = ceiling;
+
+    // Where the kernel offers pressure stall notifications (Linux PSI),
+    // follow them; otherwise the ceiling is just a fixed budget.
+    m_memory_monitor.reset(new Sysutil::MemoryPressureMonitor);
+    if (m_memory_monitor->valid())
+        m_memory_thread = std::thread(&ImageCacheImpl::adapt_max_memory, this,
+                                      ceiling);
+    else
+        m_memory_monitor.reset();
+}
 
-    // Get a (locked) iterator for the next tile to be examined.
+
+
+void
+ImageCacheImpl::adapt_max_memory(long long ceiling)
+{
+    const long long floor = std::max(ceiling / 16, 10LL * 1024 * 1024);
+    const double calm_time = 10.0;  // Seconds without pressure before growing
+    Timer calm;
+    while (!m_memory_thread_stop) {
+        Timer waited;
+        if (m_memory_monitor->wait(1000)) {
+            // Give back a quarter of what we hold (or of the budget, if
+            // we're holding less), down to a minimum useful size.
+            ++m_stat_memory_pressure_events;
+            long long budget = std::min((long long)m_max_memory_bytes,
+                                        (long long)m_mem_used);
+            m_max_memory_bytes = std::max(floor, budget - budget / 4);
+            check_max_mem(nullptr, 0);
+            calm.reset();
+            calm.start();
+        } else if (m_memory_thread_stop) {
+            break;
+        } else if (calm() >= calm_time && m_max_memory_bytes < ceiling) {
+            m_max_memory_bytes = std::min(ceiling,
+                                          m_max_memory_bytes + ceiling / 8);
+            calm.reset();
+            calm.start();
+        } else if (waited() < 0.5) {
+            // The wait failed rather than timing out; don't spin.
+            std::this_thread::sleep_for(std::chrono::seconds(1));
+        }
+    }
+}
+
+
+
+void
+ImageCacheImpl::set_watch_files(bool watch)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_watch_mutex);
+        m_watcher.reset();
+        m_watched_files.clear();
+        m_unwatched_files.clear();
+        m_watch_files = false;
+        if (!watch)
+            return;
+        m_watcher.reset(new Filesystem::ChangeWatcher);
+        if (!m_watcher->valid()) {
+            m_watcher.reset();
+            return;
+        }
+        m_watch_resync = true;
+        m_watch_files  = true;
+    }
+    // Watch the files that are already in the cache.
+    for (FilenameMap::iterator fileit = m_files.begin(), e = m_files.end();
+         fileit != e; ++fileit)
+        watch_file(fileit->second.get());
+}
+
+
+
+void
+ImageCacheImpl::watch_file(ImageCacheFile* file)
+{
+    // UDIM patterns aren't files, but each of their tiles is watched once
+    // it's used.
+    if (!m_watch_files || file->is_udim())
+        return;
+    std::string name = file->filename().string();
+    if (pvt::is_remote_url(name))
+        return;
+    std::lock_guard<std::mutex> lock(m_watch_mutex);
+    if (!m_watcher)
+        return;
+    if (m_watcher->watch(Filesystem::parent_path(name))) {
+        m_watched_files[name] = file;
+    } else if (std::find(m_unwatched_files.begin(), m_unwatched_files.end(),
+                         file)
+               == m_unwatched_files.end()) {
+        m_unwatched_files.emplace_back(file);
+    }
+}
+
+
+
+bool
+ImageCacheImpl::take_file_changes(std::vector<ImageCacheFileRef>& changed,
+                                  std::vector<ImageCacheFileRef>& unwatched)
+{
+    std::lock_guard<std::mutex> lock(m_watch_mutex);
+    if (!m_watcher)
+        return false;
+    std::vector<std::string> paths;
+    bool complete = m_watcher->changes(paths) >= 0 && !m_watch_resync;
+    // Files opened before watching began could have changed unseen, so the
+    // first time around, every file must be checked.
+    m_watch_resync = false;
+    if (!complete)
+        return false;
+    for (const std::string& path : paths) {
+        auto w = m_watched_files.find(path);
+        if (w != m_watched_files.end())
+            changed.push_back(w->second);
+    }
+    unwatched = m_unwatched_files;
+    return true;
+}
+
+
+
+void
+ImageCacheImpl::sweep_tile_bin(size_t bin, TileSweepShard& shard)
+{
+    // Because of multi-thread, rather than keep an iterator around for
+    // this (which could be invalidated since the last time we used it),
+    // we just remember the tileID of the next tile to check in each bin,
+    // then look it up fresh. Get a (locked) iterator for the next tile to
+    // be examined.
     TileCache::iterator sweep;
-    if (!m_tile_sweep_id.empty()) {
+    if (!shard.sweep_id.empty()) {
         // We saved the sweep_id. Find the iterator corresponding to it.
-        sweep = m_tilecache.find(m_tile_sweep_id);
-        // Note: if the sweep_id is no longer in the table, sweep will be an
-        // empty iterator. That's ok, it will be fixed early in the main
-        // loop below.
+        sweep = m_tilecache.find(shard.sweep_id);
     }
+    // If the sweep_id is no longer in the table (or the hand was parked at
+    // the end of the bin), start over at the beginning of the bin.
+    if (!sweep)
+        sweep = m_tilecache.bin_begin(bin);
 
-    // Loop while we still use too much tile memory.  Also, be careful
-    // of looping for too long, exit the loop if we just keep spinning
-    // uncontrollably.
-    int full_loops = 0;
-    while (m_mem_used >= (long long)m_max_memory_bytes && full_loops < 100) {
-        // If we have fallen off the end of the cache, loop back to the
-        // beginning and increment our full_loops count.
-        if (!sweep) {
-            sweep = m_tilecache.begin();
-            ++full_loops;
-        }
-        // If we're STILL at the end, it must be that somehow the entire
-        // cache is empty.  So just declare ourselves done.
-        if (!sweep)
-            break;
+    while (sweep && m_mem_used >= (long long)m_max_memory_bytes) {
         OIIO_DASSERT(sweep->second);
-
         if (!sweep->second->release()) {
             // This is a tile we should delete.  To keep iterating
             // safely, we have a good trick:
-            // 1. remember the TileID of the tile to delete
-            TileID todelete = sweep->first;
-            size_t size     = sweep->second->memsize();
-            OIIO_DASSERT(m_mem_used >= (long long)size);
-            // 2. Find the TileID of the NEXT item. We do this by
-            // incrementing the sweep iterator and grabbing its id.
-            ++sweep;
-            m_tile_sweep_id = (sweep ? sweep->first : TileID());
+            // 1. remember the TileID of the tile to delete (and hold a
+            // reference, in case it needs to be saved to the disk cache).
+            TileID todelete          = sweep->first;
+            ImageCacheTileRef doomed = sweep->second;
+            OIIO_DASSERT(m_mem_used >= (long long)sweep->second->memsize());
+            // 2. Find the TileID of the NEXT item in this bin. We do this
+            // by incrementing the sweep iterator and grabbing its id.
+            shard.sweep_id = (sweep.incr_no_lock() ? sweep->first : TileID());
             // 3. Release the bin lock and erase the tile we wish to delete.
             sweep.unlock();
             m_tilecache.erase(todelete);
+            evict_tile(*doomed);
+            doomed.reset();
             // 4. Re-establish a locked iterator for the next item, since
             // the old iterator may have been invalidated by the erasure.
-            if (!m_tile_sweep_id.empty())
-                sweep = m_tilecache.find(m_tile_sweep_id);
+            if (shard.sweep_id.empty())
+                return;
+            sweep = m_tilecache.find(shard.sweep_id);
         } else {
-            ++sweep;
+            sweep.incr_no_lock();
         }
     }
 
-    // OK, by this point we have either freed enough tiles to be below
-    // the limit again, or the cache is empty, or we've looped over the
-    // cache too many times and are giving up.
-
     // Now we must save the tileid for next time.  Just set it to an
-    // empty ID if we don't have a valid iterator at this point.
-    m_tile_sweep_id = (sweep ? sweep->first : TileID());
-    m_tile_sweep_mutex.unlock();
+    // empty ID if we ran off the end of the bin, so that next time we
+    // start over at its beginning.
+    shard.sweep_id = (sweep ? sweep->first : TileID());
 
     // N.B. As we exit, the iterators will go out of scope and we will
     // retain no locks on the cache.
@@ -2524,6 +4136,234 @@ ImageCacheImpl::check_max_mem(ImageCachePerThreadInfo* /*thread_info*/)
 
 
 
+// Every disk tile cache file starts with this, followed by the length of
+// the key, the key itself, and then the raw pixels of the tile.
+static const char disk_tile_magic[8] = { 'O', 'I', 'I', 'O', 't', 'i', 'l', '1' };
+
+
+
+std::string
+ImageCacheImpl::disk_tile_key(const TileID& id) const
+{
+    const ImageCacheFile& file(id.file());
+    if (file.broken() || file.is_udim() || !file.validspec()
+        || file.mod_time() == 0)
+        return std::string();
+    // Identify the file contents by fingerprint if it has one (so that
+    // it's shared by duplicates), otherwise by name and modification time
+    // so that we never return stale tiles for a changed file. Also
+    // include everything that changes the layout or type of the tile as
+    // stored in the cache.
+    const ImageSpec& spec(file.spec(id.subimage(), id.miplevel()));
+    bool fingerprinted = !file.fingerprint().empty();
+    return Strutil::fmt::format(
+        "{}:{} sub={} mip={} xyz={},{},{} ch={}-{} tile={}x{}x{} type={}",
+        fingerprinted ? file.fingerprint() : file.filename(),
+        fingerprinted ? 0LL : (long long)file.mod_time(), id.subimage(), id.miplevel(), id.x(), id.y(), id.z(), id.chbegin(),
+        id.chend(), spec.tile_width, spec.tile_height, spec.tile_depth,
+        file.datatype(id.subimage()).c_str());
+}
+
+
+
+std::string
+ImageCacheImpl::disk_tile_path(string_view key) const
+{
+    // Spread the tiles over 256 subdirectories to keep them from getting
+    // unwieldy.
+    uint64_t h = Strutil::strhash(key);
+    return Strutil::fmt::format("{}/{:02x}/{:016x}.tile", m_diskcache_dir,
+                                h >> 56, h);
+}
+
+
+
+void
+ImageCacheImpl::demote_tile(const ImageCacheTile& tile)
+{
+    // Only tiles whose pixels we read and own are worth keeping.
+    if (!tile.valid() || !tile.pixels_ready() || !tile.memsize()
+        || tile.deepdata())
+        return;
+    const TileID& id(tile.id());
+    size_t size = id.file().spec(id.subimage(), id.miplevel()).tile_pixels()
+                  * tile.pixelsize();
+    // Compress as fast as zlib can. Tiles that don't shrink to at most 3/4
+    // of their size are not worth the trouble.
+    uLongf csize = compressBound(uLong(size));
+    std::unique_ptr<unsigned char[]> cbuf(new unsigned char[csize]);
+    if (compress2(cbuf.get(), &csize, (const Bytef*)tile.data(), uLong(size),
+                  Z_BEST_SPEED)
+            != Z_OK
+        || csize > size * 3 / 4)
+        return;
+    CompressedTile ct;
+    ct.data.reset(new unsigned char[csize]);
+    memcpy(ct.data.get(), cbuf.get(), csize);
+    ct.size    = csize;
+    ct.persist = tile.persistable();
+
+    spin_lock lock(m_compressed_mutex);
+    auto found = m_compressed_tiles.find(id);
+    if (found != m_compressed_tiles.end())
+        return;  // Already there
+    m_compressed_bytes += (long long)csize;
+    m_compressed_tiles.emplace(id, std::move(ct));
+    m_compressed_order.push_back(id);
+    ++m_stat_compressed_tiles_demoted;
+    trim_compressed_tiles();
+}
+
+
+
+bool
+ImageCacheImpl::restore_compressed_tile(const TileID& id, void* data,
+                                        size_t size, bool& persist)
+{
+    CompressedTile ct;
+    {
+        spin_lock lock(m_compressed_mutex);
+        auto found = m_compressed_tiles.find(id);
+        if (found == m_compressed_tiles.end())
+            return false;
+        // It's going back into the main cache, so take it out of the tier.
+        // Its entry in m_compressed_order is left to be skipped later.
+        ct = std::move(found.value());
+        m_compressed_tiles.erase(found);
+        m_compressed_bytes -= (long long)ct.size;
+    }
+    // Uncompress outside the lock
+    uLongf usize = uLongf(size);
+    if (uncompress((Bytef*)data, &usize, ct.data.get(), uLong(ct.size)) != Z_OK
+        || usize != size)
+        return false;
+    persist = ct.persist;
+    ++m_stat_compressed_tiles_restored;
+    return true;
+}
+
+
+
+void
+ImageCacheImpl::trim_compressed_tiles()
+{
+    while (m_compressed_bytes > m_max_compressed_bytes
+           && !m_compressed_order.empty()) {
+        auto found = m_compressed_tiles.find(m_compressed_order.front());
+        m_compressed_order.pop_front();
+        if (found != m_compressed_tiles.end()) {
+            m_compressed_bytes -= (long long)found->second.size;
+            m_compressed_tiles.erase(found);
+        }
+    }
+    // Don't let entries of restored tiles pile up in the order queue.
+    if (m_compressed_order.size() > 2 * m_compressed_tiles.size() + 1024) {
+        std::deque<TileID> order;
+        for (const TileID& id : m_compressed_order)
+            if (m_compressed_tiles.find(id) != m_compressed_tiles.end())
+                order.push_back(id);
+        m_compressed_order.swap(order);
+    }
+}
+
+
+
+void
+ImageCacheImpl::purge_compressed_tiles(cspan<const ImageCacheFile*> files)
+{
+    spin_lock lock(m_compressed_mutex);
+    if (files.empty()) {
+        m_compressed_tiles.clear();
+        m_compressed_order.clear();
+        m_compressed_bytes = 0;
+        return;
+    }
+    for (auto t = m_compressed_tiles.begin();
+         t != m_compressed_tiles.end();) {
+        if (std::binary_search(files.begin(), files.end(),
+                               &t->first.file())) {
+            m_compressed_bytes -= (long long)t->second.size;
+            t = m_compressed_tiles.erase(t);
+        } else {
+            ++t;
+        }
+    }
+}
+
+
+
+bool
+ImageCacheImpl::read_disk_tile(const TileID& id, void* data, size_t size,
+                               ImageCachePerThreadInfo* thread_info)
+{
+    std::string key = disk_tile_key(id);
+    if (key.empty())
+        return false;
+    FILE* fd = Filesystem::fopen(disk_tile_path(key), "rb");
+    if (!fd)
+        return false;
+    // Verify the header and the full key, guarding against hash
+    // collisions and truncated or foreign files.
+    char magic[sizeof(disk_tile_magic)];
+    uint32_t keylen = 0;
+    bool ok         = fread(magic, sizeof(magic), 1, fd) == 1
+              && !memcmp(magic, disk_tile_magic, sizeof(magic))
+              && fread(&keylen, sizeof(keylen), 1, fd) == 1
+              && keylen == key.size();
+    if (ok) {
+        std::string filekey(keylen, ' ');
+        ok = fread(&filekey[0], keylen, 1, fd) == 1 && filekey == key
+             && fread(data, size, 1, fd) == 1;
+    }
+    fclose(fd);
+    if (ok) {
+        ++thread_info->m_stats.diskcache_tiles_read;
+        thread_info->m_stats.diskcache_bytes_read += size;
+    }
+    return ok;
+}
+
+
+
+void
+ImageCacheImpl::write_disk_tile(const ImageCacheTile& tile)
+{
+    const TileID& id(tile.id());
+    size_t size = id.file().spec(id.subimage(), id.miplevel()).tile_pixels()
+                  * tile.pixelsize();
+    if (m_diskcache_bytes + (long long)size > m_max_diskcache_bytes)
+        return;  // full
+    std::string key = disk_tile_key(id);
+    if (key.empty())
+        return;
+    std::string path = disk_tile_path(key);
+    if (Filesystem::exists(path))
+        return;  // There already (perhaps written by another process)
+    std::string dir = Filesystem::parent_path(path);
+    if (!Filesystem::is_directory(dir))
+        Filesystem::create_directory(dir);
+    // Write to a temporary file and then rename it into place, so that
+    // no reader (in this or any other process) ever sees a partial tile.
+    std::string tmppath = path + "." + Filesystem::unique_path() + ".tmp";
+    FILE* fd            = Filesystem::fopen(tmppath, "wb");
+    if (!fd)
+        return;
+    uint32_t keylen = uint32_t(key.size());
+    bool ok = fwrite(disk_tile_magic, sizeof(disk_tile_magic), 1, fd) == 1
+              && fwrite(&keylen, sizeof(keylen), 1, fd) == 1
+              && fwrite(key.data(), keylen, 1, fd) == 1
+              && fwrite(tile.data(), size, 1, fd) == 1;
+    ok &= (fclose(fd) == 0);
+    if (ok && Filesystem::rename(tmppath, path)) {
+        m_diskcache_bytes += (long long)size;
+        ++m_stat_diskcache_tiles_written;
+    } else {
+        Filesystem::remove(tmppath);
+    }
+}
+
+
+
 std::string
 ImageCacheImpl::resolve_filename(const std::string& filename) const
 {
@@ -2810,6 +4650,7 @@ ImageCacheImpl::get_image_info(ImageCacheFile* file,
 
     // general case -- handle anything else that's able to be found by
     // spec.find_attribute().
+    file->decode_deferred_metadata();
     ParamValue tmpparam;
     const ParamValue* p = spec.find_attribute(dataname, tmpparam);
     if (p && p->type().basevalues() == datatype.basevalues()) {
@@ -2916,6 +4757,7 @@ ImageCacheImpl::imagespec(ImageCacheFile* file,
                   file->miplevels(subimage));
         return NULL;
     }
+    file->decode_deferred_metadata();
     const ImageSpec* spec = native ? &file->nativespec(subimage, miplevel)
                                    : &file->spec(subimage, miplevel);
     return spec;
@@ -3078,6 +4920,23 @@ ImageCacheImpl::get_pixels(ImageCacheFile* file,
     stride_t zplanesize         = (yend - ybegin) * scanlinesize;
     OIIO_DASSERT(spec.depth >= 1 && spec.tile_depth >= 1);
 
+    // A big enough region of a 2D image is better read straight from the
+    // file than through the cache, whose whole working set it would flush.
+    if (m_get_pixels_streaming && spec.depth == 1 && zbegin == spec.z
+        && zend == spec.z + 1 && xbegin >= spec.x
+        && xend <= spec.x + spec.width && ybegin >= spec.y
+        && yend <= spec.y + spec.height
+        && !(file->subimageinfo(subimage).unmipped && miplevel > 0)) {
+        imagesize_t bytes = imagesize_t(xend - xbegin) * (yend - ybegin)
+                            * cache_stride;
+        if (m_get_pixels_streaming >= 2
+            || bytes > imagesize_t(m_max_memory_bytes))
+            return get_pixels_streaming(file, thread_info, subimage, miplevel,
+                                        xbegin, xend, ybegin, yend, chbegin,
+                                        chend, format, result, xstride,
+                                        ystride);
+    }
+
     imagesize_t npixelsread = 0;
     char* zptr              = (char*)result;
     for (int z = zbegin; z < zend; ++z, zptr += zstride) {
@@ -3173,6 +5032,261 @@ ImageCacheImpl::get_pixels(ImageCacheFile* file,
 
 
 
+bool
+ImageCacheImpl::get_pixels(ustring filename, cspan<PixelRequest> requests,
+                           TypeDesc format)
+{
+    ImageCachePerThreadInfo* thread_info = get_perthread_info();
+    ImageCacheFile* file                 = find_file(filename, thread_info);
+    if (!file) {
+        error("Image file \"{}\" not found", filename);
+        return false;
+    }
+    return get_pixels(file, thread_info, requests, format);
+}
+
+
+
+bool
+ImageCacheImpl::get_pixels(ImageHandle* file, Perthread* thread_info,
+                           cspan<PixelRequest> requests, TypeDesc format)
+{
+    if (!thread_info)
+        thread_info = get_perthread_info();
+    file = verify_file(file, thread_info);
+    if (!file || file->broken()) {
+        if (file && file->errors_should_issue())
+            error("Invalid image file \"{}\": {}", file->filename(),
+                  file->broken_error_message());
+        return false;
+    }
+    if (file->is_udim()) {
+        error("Cannot get_pixels() of a UDIM-like virtual file");
+        return false;
+    }
+
+    // Resolve each request's region and strides, zero the parts of its
+    // destination that lie outside the data window, and note the piece
+    // of it that each overlapping tile will supply.
+    struct Piece {
+        int subimage, miplevel, x, y, z;
+        int request;
+        bool operator<(const Piece& p) const
+        {
+            return std::tie(subimage, miplevel, z, y, x, request)
+                   < std::tie(p.subimage, p.miplevel, p.z, p.y, p.x,
+                              p.request);
+        }
+        bool same_tile(const Piece& p) const
+        {
+            return subimage == p.subimage && miplevel == p.miplevel
+                   && x == p.x && y == p.y && z == p.z;
+        }
+    };
+    std::vector<ROI> rois(requests.size());
+    std::vector<Piece> pieces;
+    std::vector<stride_t> strides(3 * requests.size());
+    bool ok = true;
+    for (int r = 0, n = int(requests.size()); r < n; ++r) {
+        const PixelRequest& req(requests[r]);
+        int subimage = req.subimage, miplevel = req.miplevel;
+        if (subimage < 0 || subimage >= file->subimages() || miplevel < 0
+            || miplevel >= file->miplevels(subimage)) {
+            if (file->errors_should_issue())
+                error("get_pixels asked for nonexistent subimage {} MIP "
+                      "level {} of \"{}\"",
+                      subimage, miplevel, file->filename());
+            ok = false;
+            continue;
+        }
+        const ImageSpec& spec(file->spec(subimage, miplevel));
+        ROI roi = req.roi.defined() ? req.roi : get_roi(spec);
+        roi.chend = std::min(roi.chend, spec.nchannels);
+        if (roi.chbegin < 0 || roi.chbegin >= roi.chend || !req.result) {
+            error("get_pixels: invalid request for channels [{},{}) of "
+                  "\"{}\"",
+                  roi.chbegin, roi.chend, file->filename());
+            ok = false;
+            continue;
+        }
+        stride_t xstride = req.xstride, ystride = req.ystride;
+        stride_t zstride = req.zstride;
+        ImageSpec::auto_stride(xstride, ystride, zstride, format,
+                               roi.nchannels(), roi.width(), roi.height());
+        rois[r]            = roi;
+        strides[3 * r]     = xstride;
+        strides[3 * r + 1] = ystride;
+        strides[3 * r + 2] = zstride;
+
+        ROI region = roi_intersection(roi, get_roi(spec));
+        bool empty = region.width() <= 0 || region.height() <= 0
+                     || region.depth() <= 0;
+        if (empty || region.npixels() < roi.npixels()) {
+            size_t pixelsize = roi.nchannels() * format.size();
+            for (int z = 0; z < roi.depth(); ++z)
+                for (int y = 0; y < roi.height(); ++y)
+                    for (int x = 0; x < roi.width(); ++x)
+                        memset((char*)req.result + z * zstride + y * ystride
+                                   + x * xstride,
+                               0, pixelsize);
+        }
+        if (empty)
+            continue;
+        for (int z = region.zbegin - (region.zbegin - spec.z) % spec.tile_depth;
+             z < region.zend; z += spec.tile_depth)
+            for (int y = region.ybegin
+                         - (region.ybegin - spec.y) % spec.tile_height;
+                 y < region.yend; y += spec.tile_height)
+                for (int x = region.xbegin
+                             - (region.xbegin - spec.x) % spec.tile_width;
+                     x < region.xend; x += spec.tile_width)
+                    pieces.push_back({ subimage, miplevel, x, y, z, r });
+    }
+
+    // Sort the pieces so that those served by the same tile are adjacent,
+    // then look up the distinct tiles in parallel, each copying out all of
+    // its pieces.
+    std::sort(pieces.begin(), pieces.end());
+    std::vector<size_t> tilestart;
+    for (size_t i = 0; i < pieces.size(); ++i)
+        if (i == 0 || !pieces[i].same_tile(pieces[i - 1]))
+            tilestart.push_back(i);
+    tilestart.push_back(pieces.size());
+    atomic_int failures(0);
+    parallel_for(0, int64_t(tilestart.size()) - 1, [&](int64_t t) {
+        ImageCachePerThreadInfo* ti = get_perthread_info();
+        const Piece& first(pieces[tilestart[t]]);
+        const ImageSpec& spec(file->spec(first.subimage, first.miplevel));
+        TileID id(*file, first.subimage, first.miplevel, first.x, first.y,
+                  first.z, 0, spec.nchannels);
+        if (!find_tile(id, ti, false)) {
+            ++failures;
+            return;
+        }
+        ImageCacheTileRef tile(ti->tile);
+        if (!tile->data()) {
+            ++failures;
+            return;
+        }
+        TypeDesc cachetype = file->datatype(first.subimage);
+        stride_t txstride  = tile->pixelsize();
+        stride_t tystride  = txstride * spec.tile_width;
+        stride_t tzstride  = tystride * spec.tile_height;
+        ROI tileroi(first.x, first.x + spec.tile_width, first.y,
+                    first.y + spec.tile_height, first.z,
+                    first.z + spec.tile_depth);
+        tileroi = roi_intersection(tileroi, get_roi(spec));
+        for (size_t i = tilestart[t]; i < tilestart[t + 1]; ++i) {
+            int r = pieces[i].request;
+            const ROI& roi(rois[r]);
+            ROI piece = roi_intersection(tileroi, roi);
+            const stride_t* s = &strides[3 * r];
+            char* dst = (char*)requests[r].result
+                        + (piece.zbegin - roi.zbegin) * s[2]
+                        + (piece.ybegin - roi.ybegin) * s[1]
+                        + (piece.xbegin - roi.xbegin) * s[0];
+            if (!convert_image(roi.nchannels(), piece.width(), piece.height(),
+                               piece.depth(),
+                               tile->data(piece.xbegin, piece.ybegin,
+                                          piece.zbegin, roi.chbegin),
+                               cachetype, txstride, tystride, tzstride, dst,
+                               format, s[0], s[1], s[2]))
+                ++failures;
+        }
+    });
+    return ok && failures == 0;
+}
+
+
+
+bool
+ImageCacheImpl::get_pixels_streaming(ImageCacheFile* file,
+                                     ImageCachePerThreadInfo* thread_info,
+                                     int subimage, int miplevel, int xbegin,
+                                     int xend, int ybegin, int yend,
+                                     int chbegin, int chend, TypeDesc format,
+                                     void* result, stride_t xstride,
+                                     stride_t ystride)
+{
+    std::shared_ptr<ImageInput> inp = file->open(thread_info);
+    if (!inp)
+        return false;
+    const ImageSpec& spec(file->nativespec(subimage, miplevel));
+    bool untiled = file->subimageinfo(subimage).untiled;
+
+    // Read in bands of whole tile rows (or of scanlines, for untiled
+    // files), spanning the region widened to the tile boundaries, which
+    // is what the ImageInput can read in one call. Bands that line up
+    // exactly with the region are read straight into the result; the
+    // bands at the edges go through a scratch buffer.
+    int bandheight = untiled ? 64 : spec.tile_height;
+    int bx = spec.x, bxend = spec.x + spec.width;
+    if (!untiled) {
+        bx    = xbegin - (xbegin - spec.x) % spec.tile_width;
+        bxend = std::min(bxend, xend + (spec.tile_width
+                                        - (xend - spec.x) % spec.tile_width)
+                                           % spec.tile_width);
+    }
+    int y0         = ybegin - (ybegin - spec.y) % bandheight;
+    int nbands     = (yend - y0 + bandheight - 1) / bandheight;
+    int nchans     = chend - chbegin;
+    stride_t pixelsize = stride_t(nchans) * format.size();
+    stride_t bandystride = pixelsize * (bxend - bx);
+
+    // Decode the bands in parallel. Each one gets its own ImageInput if
+    // the file's limits allow it, so the decodes really do overlap.
+    atomic_int failures(0);
+    parallel_for(0, nbands, [&](int64_t b) {
+        ImageCachePerThreadInfo* ti = get_perthread_info();
+        int by    = y0 + int(b) * bandheight;
+        int byend = std::min(by + bandheight, spec.y + spec.height);
+        int cy = std::max(by, ybegin), cyend = std::min(byend, yend);
+        bool direct = (bx == xbegin && bxend == xend && by == cy
+                       && byend == cyend);
+        std::unique_ptr<char[]> scratch;
+        char* dst          = (char*)result + (cy - ybegin) * ystride;
+        stride_t dxstride  = xstride;
+        stride_t dystride  = ystride;
+        if (!direct) {
+            scratch.reset(new char[bandystride * (byend - by)]);
+            dst      = scratch.get();
+            dxstride = pixelsize;
+            dystride = bandystride;
+        }
+        ImageCacheFile::InputLease lease = file->acquire_input(ti, inp);
+        ImageInput* reader               = lease.input.get();
+        bool ok = untiled
+                      ? reader->read_scanlines(subimage, miplevel, by, byend,
+                                               spec.z, chbegin, chend, format,
+                                               dst, dxstride, dystride)
+                      : reader->read_tiles(subimage, miplevel, bx, bxend, by,
+                                           byend, spec.z, spec.z + 1, chbegin,
+                                           chend, format, dst, dxstride,
+                                           dystride);
+        if (!ok) {
+            std::string err = reader->geterror();
+            if (file->errors_should_issue())
+                error("{}", err.size() ? err : std::string("unknown error"));
+            ++failures;
+        }
+        file->release_input(lease, inp);
+        if (ok && !direct)
+            copy_image(nchans, xend - xbegin, cyend - cy, 1,
+                       scratch.get() + (cy - by) * bandystride
+                           + (xbegin - bx) * pixelsize,
+                       pixelsize, pixelsize, bandystride, AutoStride,
+                       (char*)result + (cy - ybegin) * ystride, xstride,
+                       ystride, AutoStride);
+        imagesize_t bytes = imagesize_t(bxend - bx) * (byend - by)
+                            * spec.pixel_bytes(chbegin, chend, true);
+        ti->m_stats.bytes_read += bytes;
+        ti->m_stats.bytes_streamed += bytes;
+    });
+    return failures == 0;
+}
+
+
+
 ImageCache::Tile*
 ImageCacheImpl::get_tile(ustring filename, int subimage, int miplevel, int x,
                          int y, int z, int chbegin, int chend)
@@ -3219,6 +5333,378 @@ ImageCacheImpl::get_tile(ImageHandle* file, Perthread* thread_info,
 
 
 
+bool
+ImageCacheImpl::get_deep_pixels(ustring filename, int subimage, int miplevel,
+                                ROI roi, DeepData& deepdata)
+{
+    ImageCachePerThreadInfo* thread_info = get_perthread_info();
+    ImageCacheFile* file                 = find_file(filename, thread_info);
+    if (!file) {
+        error("Image file \"{}\" not found", filename);
+        return false;
+    }
+    return get_deep_pixels(file, thread_info, subimage, miplevel, roi,
+                           deepdata);
+}
+
+
+
+bool
+ImageCacheImpl::get_deep_pixels(ImageHandle* file, Perthread* thread_info,
+                                int subimage, int miplevel, ROI roi,
+                                DeepData& deepdata)
+{
+    if (!thread_info)
+        thread_info = get_perthread_info();
+    file = verify_file(file, thread_info);
+    if (!file || file->broken()) {
+        if (file && file->errors_should_issue())
+            error("Invalid image file \"{}\": {}", file->filename(),
+                  file->broken_error_message());
+        return false;
+    }
+    if (file->is_udim() || subimage < 0 || subimage >= file->subimages()
+        || miplevel < 0 || miplevel >= file->miplevels(subimage)) {
+        error("get_deep_pixels asked for nonexistent subimage {} MIP level {} "
+              "of \"{}\"",
+              subimage, miplevel, file->filename());
+        return false;
+    }
+    const ImageSpec& spec(file->spec(subimage, miplevel));
+    const ImageSpec& nspec(file->nativespec(subimage, miplevel));
+    if (!spec.deep) {
+        error("get_deep_pixels: \"{}\" is not a deep image",
+              file->filename());
+        return false;
+    }
+    if (!roi.defined())
+        roi = get_roi(spec);
+    roi.chend = std::min(roi.chend, spec.nchannels);
+    if (roi.chbegin < 0 || roi.chbegin >= roi.chend) {
+        error("get_deep_pixels: invalid channel range [{},{})", roi.chbegin,
+              roi.chend);
+        return false;
+    }
+
+    std::vector<TypeDesc> types;
+    std::vector<std::string> names;
+    for (int c = roi.chbegin; c < roi.chend; ++c) {
+        types.push_back(nspec.channelformat(c));
+        names.push_back(nspec.channel_name(c));
+    }
+    deepdata.init(roi.npixels(), roi.nchannels(), types, names);
+
+    // Gather the tiles overlapping the region, holding on to them while
+    // we first size every pixel (so the samples are allocated just once)
+    // and then copy the samples.
+    ROI region = roi_intersection(roi, get_roi(spec));
+    std::vector<ImageCacheTileRef> tiles;
+    if (region.npixels()) {
+        int x0 = spec.x + (region.xbegin - spec.x) / spec.tile_width
+                              * spec.tile_width;
+        int y0 = spec.y + (region.ybegin - spec.y) / spec.tile_height
+                              * spec.tile_height;
+        int z0 = spec.z + (region.zbegin - spec.z) / spec.tile_depth
+                              * spec.tile_depth;
+        for (int z = z0; z < region.zend; z += spec.tile_depth)
+            for (int y = y0; y < region.yend; y += spec.tile_height)
+                for (int x = x0; x < region.xend; x += spec.tile_width) {
+                    TileID id(*file, subimage, miplevel, x, y, z,
+                              roi.chbegin, roi.chend, true);
+                    if (!find_tile(id, thread_info, true))
+                        return false;
+                    tiles.push_back(thread_info->tile);
+                }
+    }
+    // Call f(pixel, tiledata, tilepixel) for each pixel of the region
+    int xmax = spec.x + spec.width, ymax = spec.y + spec.height;
+    int zmax   = spec.z + spec.depth;
+    auto index = [](const ROI& r, int x, int y, int z) {
+        return (int64_t(z - r.zbegin) * r.height() + (y - r.ybegin))
+                   * r.width()
+               + (x - r.xbegin);
+    };
+    auto each_pixel = [&](const std::function<void(int64_t, const DeepData&,
+                                                   int64_t)>& f) {
+        for (auto& tile : tiles) {
+            // The part of the tile within the data window, as it holds it
+            const TileID& id(tile->id());
+            ROI t(id.x(), std::min(id.x() + spec.tile_width, xmax), id.y(),
+                  std::min(id.y() + spec.tile_height, ymax), id.z(),
+                  std::min(id.z() + spec.tile_depth, zmax));
+            ROI r = roi_intersection(t, region);
+            for (int z = r.zbegin; z < r.zend; ++z)
+                for (int y = r.ybegin; y < r.yend; ++y)
+                    for (int x = r.xbegin; x < r.xend; ++x)
+                        f(index(roi, x, y, z), *tile->deepdata(),
+                          index(t, x, y, z));
+        }
+    };
+    std::vector<unsigned int> nsamples(deepdata.pixels(), 0);
+    each_pixel([&](int64_t p, const DeepData& dd, int64_t tp) {
+        nsamples[p] = dd.samples(tp);
+    });
+    deepdata.set_all_samples(nsamples);
+    each_pixel([&](int64_t p, const DeepData& dd, int64_t tp) {
+        deepdata.copy_deep_pixel(p, dd, tp);
+    });
+    return true;
+}
+
+
+
+int
+ImageCacheImpl::prefetch_tiles(ustring filename, int subimage, int miplevel,
+                               ROI roi)
+{
+    ImageCachePerThreadInfo* thread_info = get_perthread_info();
+    ImageCacheFile* file                 = find_file(filename, thread_info);
+    return prefetch_tiles(file, thread_info, subimage, miplevel,
+                          cspan<ROI>(&roi, 1));
+}
+
+
+
+int
+ImageCacheImpl::prefetch_tiles(ImageHandle* file, Perthread* thread_info,
+                               int subimage, int miplevel, ROI roi)
+{
+    return prefetch_tiles(file, thread_info, subimage, miplevel,
+                          cspan<ROI>(&roi, 1));
+}
+
+
+
+int
+ImageCacheImpl::prefetch_tiles(ImageHandle* file, Perthread* thread_info,
+                               int subimage, int miplevel, cspan<ROI> rois)
+{
+    if (!thread_info)
+        thread_info = get_perthread_info();
+    file = verify_file(file, thread_info);
+    if (!file || file->broken() || file->is_udim())
+        return -1;
+    if (subimage < 0 || subimage >= file->subimages() || miplevel < 0
+        || miplevel >= file->miplevels(subimage))
+        return -1;
+    const ImageSpec& spec(file->spec(subimage, miplevel));
+    int nqueued = 0;
+    for (ROI roi : rois) {
+        if (!roi.defined())
+            roi = get_roi(spec);
+        roi = roi_intersection(roi, get_roi(spec));
+        if (roi.npixels() == 0)
+            continue;
+        // Walk over the corners of all tiles overlapping the region.
+        for (int z = roi.zbegin - (roi.zbegin - spec.z) % spec.tile_depth;
+             z < roi.zend; z += spec.tile_depth) {
+            for (int y = roi.ybegin - (roi.ybegin - spec.y) % spec.tile_height;
+                 y < roi.yend; y += spec.tile_height) {
+                for (int x = roi.xbegin
+                             - (roi.xbegin - spec.x) % spec.tile_width;
+                     x < roi.xend; x += spec.tile_width) {
+                    TileID id(*file, subimage, miplevel, x, y, z,
+                              roi.chbegin, roi.chend);
+                    if (tile_in_cache(id, thread_info))
+                        continue;
+                    // Add the not-yet-read tile to the cache right away, so
+                    // that anybody else who needs it will find it and wait
+                    // for its pixels, rather than reading it themselves.
+                    ImageCacheTileRef tile = new ImageCacheTile(id);
+                    if (!m_tilecache.insert_retrieve(id, tile, tile))
+                        continue;  // somebody else beat us to it
+                    ++nqueued;
+                    prefetch_pool()->push([=](int /*id*/) {
+                        ImageCacheTileRef t(tile);
+                        (void)read_new_tile(t, get_perthread_info());
+                    });
+                }
+            }
+        }
+    }
+    m_stat_tiles_prefetched += nqueued;
+    return nqueued;
+}
+
+
+
+thread_pool*
+ImageCacheImpl::prefetch_pool()
+{
+    spin_lock lock(m_prefetch_pool_mutex);
+    if (!m_prefetch_pool)
+        m_prefetch_pool.reset(new thread_pool(m_prefetch_threads));
+    return m_prefetch_pool.get();
+}
+
+
+
+// A manifest is a text file beginning with this line, followed by lines
+//     file <index> <mod_time> <fingerprint or -> <filename>
+// for each image, then lines
+//     tile <file index> <subimage> <miplevel> <x> <y> <z> <chbegin> <chend>
+// for each tile, most recently used first.
+static const char manifest_header[] = "OpenImageIO ImageCache manifest 1";
+
+namespace {
+struct ManifestTile {
+    int file, subimage, miplevel, x, y, z, chbegin, chend;
+};
+struct ManifestFile {
+    ustring filename;
+    std::time_t mod_time;
+    ustring fingerprint;
+};
+}  // namespace
+
+
+
+bool
+ImageCacheImpl::save_manifest(string_view path)
+{
+    std::vector<ImageCacheFileRef> files;
+    std::unordered_map<const ImageCacheFile*, int> fileindex;
+    std::string out = Strutil::fmt::format("{}\n", manifest_header);
+    for (FilenameMap::iterator f = m_files.begin(); f != m_files.end(); ++f) {
+        const ImageCacheFileRef& file(f->second);
+        if (file->broken() || file->is_udim() || !file->validspec())
+            continue;
+        std::string fp = file->fingerprint().string();
+        out += Strutil::fmt::format("file {} {} {} {}\n", files.size(),
+                                    (long long)file->mod_time(),
+                                    fp.size() ? fp : std::string("-"),
+                                    f->first);
+        fileindex[file.get()] = int(files.size());
+        files.push_back(file);
+    }
+
+    // Of the resident tiles, the ones with the most clock sweeps of life
+    // left are the ones most worth having again.
+    std::vector<std::pair<int, ManifestTile>> tiles;
+    for (TileCache::iterator t = m_tilecache.begin(), e = m_tilecache.end();
+         t != e; ++t) {
+        const ImageCacheTileRef& tile(t->second);
+        if (!tile->pixels_ready() || !tile->valid() || tile->deepdata())
+            continue;
+        const TileID& id(tile->id());
+        auto fi = fileindex.find(&id.file());
+        if (fi == fileindex.end())
+            continue;
+        tiles.emplace_back(tile->used(),
+                           ManifestTile { fi->second, id.subimage(),
+                                          id.miplevel(), id.x(), id.y(),
+                                          id.z(), id.chbegin(), id.chend() });
+    }
+    std::stable_sort(tiles.begin(), tiles.end(),
+                     [](const std::pair<int, ManifestTile>& a,
+                        const std::pair<int, ManifestTile>& b) {
+                         return a.first > b.first;
+                     });
+    for (auto& t : tiles) {
+        const ManifestTile& m(t.second);
+        out += Strutil::fmt::format("tile {} {} {} {} {} {} {} {}\n", m.file,
+                                    m.subimage, m.miplevel, m.x, m.y, m.z,
+                                    m.chbegin, m.chend);
+    }
+
+    if (!Filesystem::write_text_file(path, out)) {
+        error("Could not write ImageCache manifest \"{}\"", path);
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+ImageCacheImpl::load_manifest(string_view path)
+{
+    std::string text;
+    if (!Filesystem::read_text_file(path, text)) {
+        error("Could not read ImageCache manifest \"{}\"", path);
+        return false;
+    }
+    std::vector<string_view> lines = Strutil::splitsv(text, "\n");
+    if (lines.empty() || Strutil::strip(lines[0]) != manifest_header) {
+        error("\"{}\" is not an ImageCache manifest", path);
+        return false;
+    }
+
+    auto files = std::make_shared<std::vector<ManifestFile>>();
+    auto tiles = std::make_shared<std::vector<ManifestTile>>();
+    for (size_t i = 1; i < lines.size(); ++i) {
+        string_view line = lines[i];
+        if (Strutil::parse_prefix(line, "file")) {
+            int index = -1;
+            Strutil::parse_int(line, index);
+            Strutil::skip_whitespace(line);
+            string_view mtime = Strutil::parse_until(line, " \t");
+            Strutil::skip_whitespace(line);
+            string_view fp = Strutil::parse_until(line, " \t");
+            string_view name = Strutil::strip(line);
+            if (index != int(files->size()) || name.empty())
+                break;  // Malformed, use what we have so far
+            files->push_back({ ustring(name),
+                               std::time_t(
+                                   Strutil::from_string<int64_t>(mtime)),
+                               fp == "-" ? ustring() : ustring(fp) });
+        } else if (Strutil::parse_prefix(line, "tile")) {
+            ManifestTile t;
+            if (!Strutil::parse_int(line, t.file)
+                || !Strutil::parse_int(line, t.subimage)
+                || !Strutil::parse_int(line, t.miplevel)
+                || !Strutil::parse_int(line, t.x)
+                || !Strutil::parse_int(line, t.y)
+                || !Strutil::parse_int(line, t.z)
+                || !Strutil::parse_int(line, t.chbegin)
+                || !Strutil::parse_int(line, t.chend) || t.file < 0
+                || t.file >= int(files->size()))
+                break;
+            tiles->push_back(t);
+        }
+    }
+
+    // Reopening the files and queueing their tiles happens in the
+    // background, so the caller can get on with its own setup. The tile
+    // reads themselves are spread over the prefetch pool.
+    long long budget = m_max_memory_bytes;
+    prefetch_pool()->push([=](int /*id*/) {
+        ImageCachePerThreadInfo* thread_info = get_perthread_info();
+        std::vector<ImageCacheFile*> opened(files->size(), nullptr);
+        for (size_t i = 0; i < files->size(); ++i) {
+            const ManifestFile& mf((*files)[i]);
+            std::string resolved = resolve_filename(mf.filename.string());
+            if (Filesystem::last_write_time(resolved) != mf.mod_time)
+                continue;  // Changed since the manifest was saved
+            ImageCacheFile* file = verify_file(find_file(mf.filename,
+                                                         thread_info),
+                                               thread_info);
+            if (!file || file->broken()
+                || (!mf.fingerprint.empty()
+                    && file->fingerprint() != mf.fingerprint))
+                continue;
+            opened[i] = file;
+        }
+        long long left = budget;
+        for (const ManifestTile& t : *tiles) {
+            ImageCacheFile* file = opened[t.file];
+            if (!file || t.subimage >= file->subimages()
+                || t.miplevel >= file->miplevels(t.subimage))
+                continue;
+            const ImageSpec& spec(file->spec(t.subimage, t.miplevel));
+            left -= (long long)spec.tile_bytes();
+            if (left < 0)
+                break;  // Don't evict the tiles we just fetched
+            ROI roi(t.x, t.x + 1, t.y, t.y + 1, t.z, t.z + 1, t.chbegin,
+                    t.chend);
+            prefetch_tiles(file, thread_info, t.subimage, t.miplevel, roi);
+        }
+    });
+    return true;
+}
+
+
+
 void
 ImageCacheImpl::release_tile(ImageCache::Tile* tile) const
 {
@@ -3266,6 +5752,126 @@ ImageCacheImpl::tile_pixels(ImageCache::Tile* tile, TypeDesc& format) const
 
 
 
+ImageCache::PageTable*
+ImageCacheImpl::create_page_table(void* atlas, int nslots, int page_width,
+                                  int page_height, int nchannels,
+                                  TypeDesc format)
+{
+    if (!atlas || nslots <= 0 || page_width <= 0 || page_height <= 0
+        || nchannels <= 0 || format.basetype == TypeDesc::UNKNOWN) {
+        error("Invalid page table: {} slots of {}x{}x{} {}", nslots,
+              page_width, page_height, nchannels, format);
+        return nullptr;
+    }
+    ImageCachePageTable* table = new ImageCachePageTable(atlas, nslots,
+                                                         page_width,
+                                                         page_height,
+                                                         nchannels, format);
+    // The atlas comes out of the same budget as the tiles; make room for
+    // it now rather than waiting for the next tile to be read.
+    incr_mem(table->memsize());
+    check_max_mem(nullptr, 0);
+    return table;
+}
+
+
+
+void
+ImageCacheImpl::destroy_page_table(PageTable* table)
+{
+    if (!table)
+        return;
+    decr_mem(table->memsize());
+    delete table;
+}
+
+
+
+int
+ImageCacheImpl::page_slot(PageTable* table, ImageHandle* file,
+                          Perthread* thread_info, int subimage, int miplevel,
+                          int x, int y, int z, bool* filled)
+{
+    if (filled)
+        *filled = false;
+    if (!table)
+        return -1;
+    if (!thread_info)
+        thread_info = get_perthread_info();
+    file = verify_file(file, thread_info);
+    if (!file || file->broken() || file->is_udim())
+        return -1;
+    if (subimage < 0 || subimage >= file->subimages() || miplevel < 0
+        || miplevel >= file->miplevels(subimage))
+        return -1;
+    const ImageSpec& spec(file->spec(subimage, miplevel));
+    if (spec.tile_width > table->page_width()
+        || spec.tile_height > table->page_height() || spec.tile_depth > 1) {
+        error("Tiles of \"{}\" ({}x{}x{}) do not fit {}x{} atlas pages",
+              file->filename(), spec.tile_width, spec.tile_height,
+              spec.tile_depth, table->page_width(), table->page_height());
+        return -1;
+    }
+    // Snap x,y,z to the corner of the tile. Use all the channels, just
+    // as get_tile() and texture lookups do, so that the pages are filled
+    // from the very same cached tiles.
+    x = spec.x + ((x - spec.x) / spec.tile_width) * spec.tile_width;
+    y = spec.y + ((y - spec.y) / spec.tile_height) * spec.tile_height;
+    z = spec.z + ((z - spec.z) / spec.tile_depth) * spec.tile_depth;
+    TileID id(*file, subimage, miplevel, x, y, z, 0, spec.nchannels);
+    {
+        spin_lock lock(table->mutex());
+        int slot = table->find(id);
+        if (slot >= 0)
+            return slot;
+    }
+
+    // Not resident. Get the tile without holding the table lock, since it
+    // may have to be read from disk.
+    if (!find_tile(id, thread_info, true))
+        return -1;
+    ImageCacheTileRef tile(thread_info->tile);
+    spin_lock lock(table->mutex());
+    int slot = table->find(id);
+    if (slot >= 0)
+        return slot;  // Another thread filled it while we were reading
+    bool evicted = false;
+    slot         = table->claim(id, evicted);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.page_fills;
+    if (evicted)
+        ++stats.page_evictions;
+
+    char* page = table->slot_data(slot);
+    int nc     = std::min(table->nchannels(), id.nchannels());
+    if (nc < table->nchannels() || spec.tile_width < table->page_width()
+        || spec.tile_height < table->page_height())
+        memset(page, 0, table->slot_bytes());
+    TypeDesc srcformat = file->datatype(subimage);
+    stride_t srcpixel  = id.nchannels() * srcformat.size();
+    stride_t dstpixel  = table->pixel_bytes();
+    convert_image(nc, spec.tile_width, spec.tile_height, 1, tile->data(),
+                  srcformat, srcpixel, srcpixel * spec.tile_width, AutoStride,
+                  page, table->format(), dstpixel,
+                  dstpixel * table->page_width(), AutoStride);
+    if (filled)
+        *filled = true;
+    return slot;
+}
+
+
+
+void
+ImageCacheImpl::clear_page_table(PageTable* table)
+{
+    if (!table)
+        return;
+    spin_lock lock(table->mutex());
+    table->clear();
+}
+
+
+
 bool
 ImageCacheImpl::add_file(ustring filename, ImageInput::Creator creator,
                          const ImageSpec* config, bool replace)
@@ -3346,12 +5952,63 @@ ImageCacheImpl::invalidate(ImageHandle* handle, bool force)
             return;
     }
 
+    std::vector<ImageCacheFileRef> files { file };
+    invalidate_batch(files);
+}
+
+
+
+void
+ImageCacheImpl::invalidate_files(cspan<ustring> filenames, bool force)
+{
+    // Names may be those the files were asked for by, or the paths they
+    // resolved to, as a file change watcher would report them.
+    std::vector<ImageCacheFileRef> files;
+    for (ustring name : filenames) {
+        ImageCacheFileRef file;
+        if (!m_files.retrieve(name, file)) {
+            std::lock_guard<std::mutex> lock(m_watch_mutex);
+            auto w = m_watched_files.find(name.string());
+            if (w == m_watched_files.end())
+                continue;
+            file = w->second;
+        }
+        if (!force) {
+            recursive_lock_guard guard(file->m_input_mutex);
+            if (file->mod_time()
+                    == Filesystem::last_write_time(file->filename())
+                && !file->broken())
+                continue;
+        }
+        files.push_back(file);
+    }
+    invalidate_batch(files);
+}
+
+
+
+void
+ImageCacheImpl::invalidate_batch(std::vector<ImageCacheFileRef>& files)
+{
+    if (files.empty())
+        return;
+    auto by_address = [](const ImageCacheFileRef& a,
+                         const ImageCacheFileRef& b) {
+        return a.get() < b.get();
+    };
+    std::sort(files.begin(), files.end(), by_address);
+    files.erase(std::unique(files.begin(), files.end()), files.end());
+    std::vector<const ImageCacheFile*> sorted(files.size());
+    for (size_t i = 0, e = files.size(); i < e; ++i)
+        sorted[i] = files[i].get();
+
     // Iterate over the entire tilecache, record the TileID's of all
-    // tiles that are from the file we are invalidating.
+    // tiles that are from the files we are invalidating.
     std::vector<TileID> tiles_to_delete;
     for (TileCache::iterator tci = m_tilecache.begin(), e = m_tilecache.end();
          tci != e; ++tci) {
-        if (&(*tci).second->file() == file)
+        if (std::binary_search(sorted.begin(), sorted.end(),
+                               &(*tci).second->file()))
             tiles_to_delete.push_back((*tci).second->id());
     }
     // N.B. at this point, we hold no locks!
@@ -3359,16 +6016,34 @@ ImageCacheImpl::invalidate(ImageHandle* handle, bool force)
     // Safely erase all the tiles we found
     for (const TileID& id : tiles_to_delete)
         m_tilecache.erase(id);
+    unpublish_tiles(sorted);
+    purge_compressed_tiles(sorted);
 
-    const ustring fingerprint = file->fingerprint();
+    for (const ImageCacheFileRef& file : files) {
+        const ustring fingerprint = file->fingerprint();
+        const ustring contenthash = file->content_hash_if_known();
 
-    // Invalidate the file itself (close it and clear its spec)
-    file->invalidate();
+        // Invalidate the file itself (close it and clear its spec)
+        file->invalidate();
+        // It may resolve to a different path now
+        watch_file(file.get());
 
-    // Remove the fingerprint corresponding to this file
-    {
+        // Remove the fingerprint corresponding to this file
         spin_lock lock(m_fingerprints_mutex);
         m_fingerprints.erase(fingerprint);
+        // Its contents may have changed, so forget what we knew about them
+        if (contenthash.size()) {
+            auto f = m_fingerprints.find(contenthash);
+            if (f != m_fingerprints.end() && f->second == file)
+                m_fingerprints.erase(f);
+        }
+        for (auto s = m_content_sizes.begin(); s != m_content_sizes.end();
+             ++s) {
+            if (s->second == file) {
+                m_content_sizes.erase(s);
+                break;
+            }
+        }
     }
 
     purge_perthread_microcaches();
@@ -3390,6 +6065,8 @@ ImageCacheImpl::invalidate_all(bool force)
         }
         for (const TileID& id : tiles_to_delete)
             m_tilecache.erase(id);
+        unpublish_tiles({});
+        purge_compressed_tiles({});
         // Invalidate (close and clear spec) all individual files
         for (FilenameMap::iterator fileit = m_files.begin(), e = m_files.end();
              fileit != e; ++fileit) {
@@ -3404,29 +6081,54 @@ ImageCacheImpl::invalidate_all(bool force)
 
     // Not forced... we need to look for particular files that seem
     // to need invalidation.
+    invalidate_stale(false);
+}
 
-    // Make a list of all files that need to be invalidated
-    std::vector<ustring> all_files;
-    for (FilenameMap::iterator fileit = m_files.begin(), e = m_files.end();
-         fileit != e; ++fileit) {
-        const ImageCacheFileRef& f(fileit->second);
+
+
+void
+ImageCacheImpl::invalidate_stale(bool check_settings)
+{
+    // Has the file been broken, removed, or modified since it was opened?
+    auto changed_on_disk = [&](const ImageCacheFileRef& f) {
         ustring name = f->filename();
         Timer input_mutex_timer;
         recursive_lock_guard guard(f->m_input_mutex);
         f->m_mutex_wait_time += input_mutex_timer();
-        // If the file was broken when we opened it, or if it no longer
-        // exists, definitely invalidate it.
-        if (f->broken() || !Filesystem::exists(name)) {
-            all_files.push_back(name);
+        // Remote files can't be checked this way, so they stay unless
+        // broken or forced.
+        return f->broken()
+               || (!pvt::is_remote_url(name)
+                   && (!Filesystem::exists(name)
+                       || Filesystem::last_write_time(name) != f->mod_time()));
+    };
+
+    // If a watcher is keeping track of which files changed, only those (and
+    // the ones it can't watch) need looking at, rather than stat-ing every
+    // file, unless we must also compare every file to the settings.
+    std::vector<ImageCacheFileRef> changed, unwatched;
+    bool watching = take_file_changes(changed, unwatched);
+    for (const ImageCacheFileRef& f : unwatched)
+        if (changed_on_disk(f))
+            changed.push_back(f);
+    if (watching && !check_settings) {
+        invalidate_batch(changed);
+        // Mark the per-thread microcaches as invalid
+        purge_perthread_microcaches();
+        return;
+    }
+
+    // Make a list of all files that need to be invalidated
+    std::vector<ImageCacheFileRef> all_files(std::move(changed));
+    for (FilenameMap::iterator fileit = m_files.begin(), e = m_files.end();
+         fileit != e; ++fileit) {
+        const ImageCacheFileRef& f(fileit->second);
+        if (watching ? f->broken() : changed_on_disk(f)) {
+            all_files.push_back(f);
             continue;
         }
-        // Invalidate the file if it has been modified since it was
-        // last opened.
-        std::time_t t = Filesystem::last_write_time(name);
-        if (t != f->mod_time()) {
-            all_files.push_back(name);
+        if (watching && !check_settings)
             continue;
-        }
         for (int s = 0; s < f->subimages(); ++s) {
             const ImageCacheFile::SubimageInfo& sub(f->subimageinfo(s));
             // Invalidate if any unmipped subimage didn't automip but
@@ -3434,7 +6136,7 @@ ImageCacheImpl::invalidate_all(bool force)
             if (sub.unmipped
                 && ((m_automip && f->miplevels(s) <= 1)
                     || (!m_automip && f->miplevels(s) > 1))) {
-                all_files.push_back(name);
+                all_files.push_back(f);
                 break;
             }
             // Invalidate if any untiled subimage doesn't match the current
@@ -3444,7 +6146,7 @@ ImageCacheImpl::invalidate_all(bool force)
                     const ImageCacheFile::LevelInfo& level(f->levelinfo(s, m));
                     if (level.spec.tile_width != m_autotile
                         || level.spec.tile_height != m_autotile) {
-                        all_files.push_back(name);
+                        all_files.push_back(f);
                         break;
                     }
                 }
@@ -3453,10 +6155,7 @@ ImageCacheImpl::invalidate_all(bool force)
     }
 
     // Now, invalidate all the files in our "needs invalidation" list
-    for (auto f : all_files) {
-        // fprintf (stderr, "Invalidating %s\n", f.c_str());
-        invalidate(f, true);
-    }
+    invalidate_batch(all_files);
 
     // Mark the per-thread microcaches as invalid
     purge_perthread_microcaches();
@@ -3526,15 +6225,18 @@ ImageCacheFile::udim_setup()
         return;
 
     // Enumerate all the matching textures by looking at all files in the
-    // directory portion of the pattern, and seeing if they match a regex
-    // we derive from the non-directory part of the pattern.
-    std::vector<std::string> filenames;
+    // directory portion of the pattern, and seeing if their names match a
+    // regex we derive from the non-directory part of the pattern. The
+    // filter is applied during the scan, so the (possibly thousands of)
+    // other files in the directory are never collected.
+    std::vector<Filesystem::DirEntry> entries;
     std::string dirname = Filesystem::parent_path(m_filename);
     if (dirname.empty())
         dirname = ".";
     std::string pat = udim_to_wildcard(Filesystem::filename(m_filename));
-    Filesystem::get_directory_entries(dirname, filenames, false /*recurse*/,
-                                      pat);
+    Filesystem::DirScanOptions scanopt;
+    scanopt.filter_regex = pat;
+    Filesystem::scan_directory(dirname, entries, scanopt);
 
     // Now we have all the matching filenames, and we need to associate
     // these with uv tile numbering, for which we again use the regex
@@ -3543,7 +6245,8 @@ ImageCacheFile::udim_setup()
     std::vector<UdimInfo> udim_list;  // temporary -- we don't know extent
     udim_list.reserve(100);
     std::regex decoder(pat);
-    for (auto udim_tile_name : filenames) {
+    for (auto& entry : entries) {
+        const std::string& udim_tile_name(entry.path);
         std::string fnpart = Filesystem::filename(udim_tile_name);
         std::match_results<std::string::const_iterator> match;
         if (std::regex_match(fnpart, match, decoder) && match.size() > 1) {
@@ -3662,6 +6365,12 @@ ImageCacheImpl::resolve_udim(ImageCacheFile* udimfile, Perthread* thread_info,
     if (udiminfo.filename.empty())
         return nullptr;
 
+    // If this thread already resolved the tile, no lock is needed.
+    ImageCachePerThreadInfo* ptinfo = get_perthread_info(thread_info);
+    size_t ntiles                   = udimfile->m_udim_lookup.size();
+    if (ImageCacheFile* f = ptinfo->udim_tiles(udimfile, ntiles)[index])
+        return f;
+
     // Which is our mutex from the pool? Use a hash baseed on the filename.
     spin_rw_mutex& udim_lookup_mutex(
         udim_lookup_mutex_pool[udimfile->filename()]);
@@ -3675,11 +6384,14 @@ ImageCacheImpl::resolve_udim(ImageCacheFile* udimfile, Perthread* thread_info,
     // If that didn't work, get a write lock and we'll make the entry for
     // the first time.
     if (!realfile) {
-        realfile = find_file(udiminfo.filename, thread_info);
+        realfile = find_file(udiminfo.filename, ptinfo);
         // Grab the actual write lock to change the `ImageCacheFile*`.
         spin_rw_mutex::write_lock_guard rlock(udim_lookup_mutex);
         udiminfo.icfile = realfile;
     }
+    // Don't hold on to the table reference across find_file, a purge of
+    // the per-thread info could have cleared it.
+    ptinfo->udim_tiles(udimfile, ntiles)[index] = realfile;
     return realfile;
 }
 
@@ -3753,10 +6465,10 @@ ImageCacheImpl::get_perthread_info(ImageCachePerThreadInfo* p)
     if (p->purge) {  // has somebody requested a tile purge?
         // This is safe, because it's our thread.
         spin_lock lock(m_perthread_info_mutex);
-        p->tile     = NULL;
-        p->lasttile = NULL;
-        p->purge    = 0;
+        p->purge_microcache();
+        p->purge = 0;
         p->m_thread_files.clear();
+        p->purge_udim_tiles();
     }
     return p;
 }
@@ -3771,8 +6483,7 @@ ImageCacheImpl::erase_perthread_info()
         ImageCachePerThreadInfo* p = m_all_perthread_info[i];
         if (p) {
             // Clear the microcache.
-            p->tile     = NULL;
-            p->lasttile = NULL;
+            p->purge_microcache();
             if (p->shared) {
                 // Pointed to by both thread-specific-ptr and our list.
                 // Just remove from out list, then ownership is only
@@ -3795,8 +6506,7 @@ ImageCacheImpl::cleanup_perthread_info(ImageCachePerThreadInfo* p)
     spin_lock lock(m_perthread_info_mutex);
     if (p) {
         // Clear the microcache.
-        p->tile     = NULL;
-        p->lasttile = NULL;
+        p->purge_microcache();
         if (!p->shared)  // If we own it, delete it
             delete p;
         else
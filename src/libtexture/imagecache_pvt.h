@@ -12,13 +12,20 @@
 
 #include <tsl/robin_map.h>
 
+#include <deque>
+#include <map>
+#include <unordered_map>
+
 #include <boost/container/flat_map.hpp>
 #include <boost/thread/tss.hpp>
 
+#include <OpenImageIO/deepdata.h>
 #include <OpenImageIO/export.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/hash.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/refcnt.h>
+#include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/texture.h>
 #include <OpenImageIO/timer.h>
 #include <OpenImageIO/unordered_map_concurrent.h>
@@ -45,6 +52,7 @@ using boost::thread_specific_ptr;
 
 class ImageCacheImpl;
 class ImageCachePerThreadInfo;
+struct TileID;
 
 const char*
 texture_format_name(TexFormat f);
@@ -53,6 +61,55 @@ texture_type_name(TexFormat f);
 
 
 
+/// A distribution of latencies, kept (like HdrHistogram) as buckets that
+/// are linear within each power of two of nanoseconds, so that any
+/// percentile is known to within 1/16 of its value, from 1 ns up to about
+/// 9 minutes, in a fixed few KB. Each thread records into its own, and
+/// they're merged when queried.
+struct LatencyHistogram {
+    static constexpr int subbits    = 4;
+    static constexpr int subbuckets = 1 << subbits;
+    static constexpr int maxlog2    = 39;  // Longer times pile up here
+    static constexpr int nbuckets   = (maxlog2 - subbits + 2) * subbuckets;
+
+    long long count;
+    long long counts[nbuckets];
+    double total;  // seconds
+    double max;    // seconds
+
+    LatencyHistogram() { clear(); }
+    void clear();
+    void merge(const LatencyHistogram& h);
+
+    void record(double seconds)
+    {
+        uint64_t ns = seconds > 0.0 ? uint64_t(seconds * 1.0e9) : 0;
+        ++counts[bucket(ns)];
+        ++count;
+        total += seconds;
+        max = std::max(max, seconds);
+    }
+
+    /// The latency, in seconds, that `pct` percent of the recorded ones
+    /// did not exceed (0 if none were recorded).
+    double percentile(double pct) const;
+
+    static int bucket(uint64_t ns)
+    {
+        if (ns < uint64_t(subbuckets))
+            return int(ns);
+        if (ns >> (maxlog2 + 1))
+            return nbuckets - 1;
+        int e = subbits;  // floor(log2(ns))
+        while (ns >> (e + 1))
+            ++e;
+        return (e - subbits + 1) * subbuckets
+               + int(ns >> (e - subbits)) - subbuckets;
+    }
+};
+
+
+
 /// Structure to hold IC and TS statistics.  We combine into a single
 /// structure to minimize the number of costly thread_specific_ptr
 /// retrievals.  If somebody is using the ImageCache without a
@@ -62,10 +119,21 @@ struct ImageCacheStatistics {
     // First, the ImageCache-specific fields:
     long long find_tile_calls;
     long long find_tile_microcache_misses;
+    long long find_tile_microcache_assoc_hits;
+    long long find_tile_index_hits;
     int find_tile_cache_misses;
     long long files_totalsize;
     long long files_totalsize_ondisk;
     long long bytes_read;
+    long long diskcache_tiles_read;
+    long long diskcache_bytes_read;
+    long long tiles_mapped;
+    long long tiles_constant;
+    long long tiles_readahead;
+    long long spare_inputs_opened;
+    long long bytes_streamed;
+    long long page_fills;
+    long long page_evictions;
     // These stats are hard to deal with on a per-thread basis, so for
     // now, they are still atomics shared by the whole IC.
     // int tiles_created;
@@ -98,9 +166,23 @@ struct ImageCacheStatistics {
     long long closest_interps;
     long long bilinear_interps;
     long long cubic_interps;
+    long long deferred_queries;
+    long long deferred_tile_switches;
+    long long deferred_tile_switches_unsorted;
+    long long ewa_queries;
+    long long ewa_texels;
+    long long shadow_taps;
+    long long shadow_blocker_searches;
     int file_retry_success;
     int tile_retry_success;
 
+    // Latency distributions, recorded while the IC's "latency_stats" is
+    // on: of whole lookups (the outermost call on a thread), of waits for
+    // tile pixels that weren't yet in cache, and of file opens.
+    LatencyHistogram lookup_latency;
+    LatencyHistogram tile_wait_latency;
+    LatencyHistogram fileopen_latency;
+
     ImageCacheStatistics() { init(); }
     void init();
     void merge(const ImageCacheStatistics& s);
@@ -108,6 +190,29 @@ struct ImageCacheStatistics {
 
 
 
+/// Lookup cost counters for one texture or one call site, gathered while
+/// the TextureSystem "lookup_stats" attribute is nonzero.
+struct TextureLookupCost {
+    long long lookups           = 0;  ///< Points looked up
+    long long probes            = 0;  ///< Filter probes
+    long long texels            = 0;  ///< Texels fetched
+    long long microcache_misses = 0;  ///< Tile microcache misses
+    double io_time              = 0;  ///< Time reading tiles (seconds)
+
+    void merge(const TextureLookupCost& c)
+    {
+        lookups += c.lookups;
+        probes += c.probes;
+        texels += c.texels;
+        microcache_misses += c.microcache_misses;
+        io_time += c.io_time;
+    }
+};
+
+typedef tsl::robin_map<ustring, TextureLookupCost, ustringHash> LookupCostMap;
+
+
+
 struct UdimInfo {
     ustring filename;
     ImageCacheFile* icfile = nullptr;
@@ -184,6 +289,33 @@ public:
                    int miplevel, int x, int y, int z, int chbegin, int chend,
                    TypeDesc format, void* data);
 
+    /// Load the deep samples of a tile (which may be one emulated for an
+    /// untiled file) into `deepdata`, which will hold the part of the tile
+    /// that lies within the data window, in the file's native types.
+    bool read_deep_tile(ImageCachePerThreadInfo* thread_info, int subimage,
+                        int miplevel, int x, int y, int z, int chbegin,
+                        int chend, DeepData& deepdata);
+
+    /// If the native pixels of the requested tile are stored in the file
+    /// exactly as the cache would hold them, return a pointer to them
+    /// within a memory mapping of the file, and set `mapping` to the
+    /// mapping, which must be held for as long as the pointer is used.
+    /// Otherwise, return nullptr and the tile needs to be read.
+    const void* map_tile(ImageCachePerThreadInfo* thread_info, int subimage,
+                         int miplevel, int x, int y, int z, int chbegin,
+                         int chend,
+                         std::shared_ptr<Filesystem::MappedFile>& mapping);
+
+    /// If the ImageInput can tell that every pixel of the requested tile
+    /// has the same value, return a pointer to a tile's worth of that
+    /// value, shared by all such tiles of the file, and set `holder` to
+    /// keep it valid for as long as the pointer is used. Otherwise, return
+    /// nullptr and the tile needs to be read.
+    const void* constant_tile(ImageCachePerThreadInfo* thread_info,
+                              int subimage, int miplevel, int x, int y, int z,
+                              int chbegin, int chend,
+                              std::shared_ptr<char>& holder);
+
     /// Mark the file as recently used.
     ///
     void use(void) { m_used = true; }
@@ -232,9 +364,32 @@ public:
 
     std::time_t mod_time() const { return m_mod_time; }
     ustring fingerprint() const { return m_fingerprint; }
+
+    /// Return a fast hash of the file's bytes (and its size), computing
+    /// it the first time it's asked for. Returns an empty string if the
+    /// file can't be read.
+    ustring content_hash();
+
+    /// The content hash if it has already been computed, otherwise an
+    /// empty string.
+    ustring content_hash_if_known()
+    {
+        lock_guard lock(m_content_hash_mutex);
+        return m_content_hash;
+    }
     void duplicate(ImageCacheFile* dup) { m_duplicate = dup; }
     ImageCacheFile* duplicate() const { return m_duplicate; }
 
+    /// We open files with the "oiio:LazyMetadata" hint, so their specs may
+    /// hold undecoded Exif, XMP, and IPTC blocks. Decode those in the specs
+    /// of every subimage and MIP level, the first time anybody needs the
+    /// named metadata.
+    void decode_deferred_metadata()
+    {
+        if (!m_metadata_decoded.load(std::memory_order_acquire))
+            decode_deferred_metadata_locked();
+    }
+
     // Retrieve the average color, or try to compute it. Return true on
     // success, false on failure.
     bool get_average_color(float* avg, int subimage, int chbegin, int chend);
@@ -274,6 +429,8 @@ public:
         std::vector<float> average_color;  ///< Average color
         spin_mutex average_color_mutex;    ///< protect average_color
         std::unique_ptr<Imath::M44f> Mlocal;  ///< shadows/volumes: world-to-local
+        std::unique_ptr<Imath::M44f> Mcamera;  ///< shadows: world-to-camera
+        std::unique_ptr<Imath::M44f> Mscreen;  ///< shadows: world-to-screen
         // The scale/offset accounts for crops or overscans, converting
         // 0-1 texture space relative to the "display/full window" into
         // 0-1 relative to the "pixel window".
@@ -327,6 +484,7 @@ public:
     {
         m_validspec = false;
         m_subimages.clear();
+        m_metadata_decoded = false;
     }
 
     /// Should we print an error message? Keeps track of whether the
@@ -351,6 +509,36 @@ public:
     // Return the regex wildcard matching pattern for a udim spec.
     static std::string udim_to_wildcard(string_view udimpattern);
 
+    /// Caching priority hint for this file: each point lets its unused
+    /// tiles survive one more clock sweep (negative values make them the
+    /// first to go).
+    int priority() const { return m_priority; }
+    void priority(int p) { m_priority = p; }
+
+    /// Per-file limit on resident tile memory (0 means no limit beyond
+    /// the cache-wide one), and how much tile memory the file holds now.
+    long long max_resident_bytes() const { return m_max_resident_bytes; }
+    void max_resident_bytes(long long b) { m_max_resident_bytes = b; }
+    long long resident_bytes() const { return m_resident_bytes; }
+    bool over_quota() const
+    {
+        return m_max_resident_bytes > 0
+               && m_resident_bytes > m_max_resident_bytes;
+    }
+
+    /// Account for a tile of this file gaining or giving back `size`
+    /// bytes of memory. While a quota is set, tiles are also remembered
+    /// in the order they arrived, so the oldest can be freed first.
+    void incr_resident(const TileID& id, size_t size);
+    void decr_resident(size_t size) { m_resident_bytes -= (long long)size; }
+
+    /// Remove and return the oldest remembered tile of this file, or an
+    /// empty TileID if there are none.
+    TileID pop_oldest_resident();
+
+    /// Put a tile back at the young end of the remembered order.
+    void push_resident(const TileID& id);
+
 private:
     ustring m_filename_original;   ///< original filename before search path
     ustring m_filename;            ///< Filename
@@ -371,6 +559,8 @@ private:
     EnvLayout m_envlayout;                  ///< env map: which layout?
     bool m_y_up;                  ///< latlong: is y "up"? (else z is up)
     bool m_sample_border;         ///< are edge samples exactly on the border?
+    int m_env_lobes = 0;          ///< latlong: prefiltered lobe levels
+    ustring m_env_lobes_file;     ///< latlong: file holding those lobes
     short m_udim_nutiles;         ///< Number of u tiles (0 if not a udim)
     short m_udim_nvtiles;         ///< Number of v tiles (0 if not a udim)
     ustring m_fileformat;         ///< File format name
@@ -389,6 +579,10 @@ private:
     mutable recursive_mutex m_input_mutex;  ///< Mutex protecting the ImageInput
     std::time_t m_mod_time;                 ///< Time file was last updated
     ustring m_fingerprint;          ///< Optional cryptographic fingerprint
+    ustring m_content_hash;         ///< Lazily computed xxhash of the file
+    mutex m_content_hash_mutex;     ///< Protect m_content_hash
+    std::atomic<bool> m_metadata_decoded { false };  ///< No deferred blocks
+    mutex m_metadata_mutex;         ///< Serialize decoding them
     ImageCacheFile* m_duplicate;    ///< Is this a duplicate?
     imagesize_t m_total_imagesize;  ///< Total size, uncompressed
     imagesize_t m_total_imagesize_ondisk;  ///< Total size, compressed on disk
@@ -396,6 +590,78 @@ private:
     std::unique_ptr<ImageSpec> m_configspec;  // Optional configuration hints
     std::vector<UdimInfo> m_udim_lookup;      ///< Used for decoding udim tiles
                                               /// protected by mutex elsewhere!
+    std::shared_ptr<Filesystem::MappedFile> m_mapped;  ///< Mapping of file
+    bool m_map_failed = false;     ///< Don't retry a failed mapping
+    spin_mutex m_mapped_mutex;     ///< Protect m_mapped and m_map_failed
+    bool m_constant_tiles = false;  ///< ImageInput reports constant tiles
+    /// Shared tiles of one value, by subimage, miplevel, channels and value
+    std::map<std::string, std::shared_ptr<char>> m_constant_tile_pixels;
+    spin_mutex m_constant_tile_mutex;  ///< Protect m_constant_tile_pixels
+    // Read-ahead state: where the last tile miss was and how many tiles
+    // we decided to read for it (protected by m_readahead_mutex).
+    spin_mutex m_readahead_mutex;
+    int m_readahead_subimage = -1;
+    int m_readahead_miplevel = -1;
+    int m_readahead_x = 0, m_readahead_y = 0, m_readahead_z = 0;
+    int m_readahead_run = 1;
+    // Per-file caching hints (see ImageCache::file_attribute).
+    int m_priority = 0;
+    atomic_ll m_max_resident_bytes { 0 };
+    atomic_ll m_resident_bytes { 0 };
+    // Tiles in arrival order, only kept while there's a quota (protected
+    // by m_resident_mutex).
+    std::unique_ptr<std::deque<TileID>> m_resident_tiles;
+    spin_mutex m_resident_mutex;
+
+    // Extra ImageInputs that let several threads read tiles of this file
+    // at once: the idle ones, and how many there are in all, including
+    // those in use (both protected by m_spare_inputs_mutex). The main
+    // m_input is marked busy while a tile read is using it.
+    std::vector<std::shared_ptr<ImageInput>> m_spare_inputs;
+    int m_nspare_inputs = 0;
+    spin_mutex m_spare_inputs_mutex;
+    std::atomic<bool> m_input_busy { false };
+
+    // The most recently decoded row of tiles of an autotiled scanline
+    // file, which can supply any of its tiles without decoding the rows
+    // again. m_band_mutex is held while a band is read, so that threads
+    // wanting tiles of the same band read it only once. Its memory counts
+    // against the cache's.
+    struct DecodedBand {
+        int subimage = -1, miplevel = -1, y = 0, z = 0;
+        int chbegin = 0, chend = 0;
+        TypeDesc format;
+        std::shared_ptr<char> pixels;
+        size_t size = 0;
+    };
+    DecodedBand m_band;
+    mutex m_band_mutex;
+
+    // The ImageInput a tile read should use, and whether it's the main
+    // one (which must be marked not busy afterwards) or a spare (which
+    // goes back to m_spare_inputs).
+    struct InputLease {
+        std::shared_ptr<ImageInput> input;
+        bool main;
+        bool spare;
+    };
+
+    // Choose an ImageInput for a tile read, given `inp`, the main one
+    // returned by open(). Every lease must be handed back with
+    // release_input().
+    InputLease acquire_input(ImageCachePerThreadInfo* thread_info,
+                             const std::shared_ptr<ImageInput>& inp);
+    void release_input(InputLease& lease,
+                       const std::shared_ptr<ImageInput>& inp);
+
+    // Close all the idle spare ImageInputs.
+    void close_spare_inputs();
+
+    void decode_deferred_metadata_locked();
+
+    // Make (but don't open) a new ImageInput for this file, setting
+    // `configspec` to the configuration hints to open it with.
+    std::shared_ptr<ImageInput> create_imageinput(ImageSpec& configspec);
 
     // Thread-safe retrieve a shared pointer to the ImageInput (which may
     // not currently be open). The one returned is safe to use as long as
@@ -411,8 +677,12 @@ private:
     /// Retrieve a shared pointer to the file's open ImageInput (opening if
     /// necessary, and maintaining the limit on number of open files). For a
     /// broken file, return an empty shared ptr. This is thread-safe and
-    /// requires no external lock.
-    std::shared_ptr<ImageInput> open(ImageCachePerThreadInfo* thread_info);
+    /// requires no external lock. If `header_only` is true and the file has
+    /// no valid spec yet, the specs may be filled in from the spec cache
+    /// without opening the file at all, and the result is then empty even
+    /// though the file is not broken.
+    std::shared_ptr<ImageInput> open(ImageCachePerThreadInfo* thread_info,
+                                     bool header_only = false);
 
     /// Release the ImageInput, if currently open. It will close and destroy
     /// when the last thread holding it is done with its shared ptr. This
@@ -428,6 +698,17 @@ private:
                       int subimage, int miplevel, int x, int y, int z,
                       int chbegin, int chend, TypeDesc format, void* data);
 
+    /// Free the decoded band kept by read_untiled, if any.
+    void release_band();
+
+    /// Return how many tiles, starting with the one at (x,y,z), should be
+    /// read in one go for a tile cache miss, based on the recent pattern
+    /// of misses in this file. Never returns fewer than 1, and does not
+    /// include tiles past the end of the row or ones already in cache.
+    int readahead_run(ImageCachePerThreadInfo* thread_info, int subimage,
+                      int miplevel, int x, int y, int z, int chbegin,
+                      int chend);
+
     /// Load the requested tile, from a file that's not really MIPmapped.
     /// Preconditions: the ImageInput is already opened, and we already did
     /// a seek_subimage to the right subimage.
@@ -457,10 +738,13 @@ private:
 typedef intrusive_ptr<ImageCacheFile> ImageCacheFileRef;
 
 
-/// Map file names to file references
+/// Map file names to file references. Nearly every lookup of a file by
+/// name is a read, by many threads at once, so the bins use a
+/// distributed_rw_mutex.
 typedef unordered_map_concurrent<
     ustring, ImageCacheFileRef, ustringHash, std::equal_to<ustring>,
-    FILE_CACHE_SHARDS, tsl::robin_map<ustring, ImageCacheFileRef, ustringHash>>
+    FILE_CACHE_SHARDS, tsl::robin_map<ustring, ImageCacheFileRef, ustringHash>,
+    distributed_rw_mutex<>>
     FilenameMap;
 typedef tsl::robin_map<ustring, ImageCacheFileRef, ustringHash> FingerprintMap;
 
@@ -472,21 +756,24 @@ struct TileID {
     /// Default constructor
     ///
     TileID()
-        : m_file(nullptr)
+        : m_deep(false)
+        , m_file(nullptr)
     {
     }
 
     /// Initialize a TileID based on full elaboration of image file,
-    /// subimage, and tile x,y,z indices.
+    /// subimage, and tile x,y,z indices. A deep tile holds the samples of
+    /// a deep image, and is distinct from any flat tile of the same place.
     TileID(ImageCacheFile& file, int subimage, int miplevel, int x, int y,
-           int z = 0, int chbegin = 0, int chend = -1)
+           int z = 0, int chbegin = 0, int chend = -1, bool deep = false)
         : m_x(x)
         , m_y(y)
         , m_z(z)
         , m_subimage(subimage)
-        , m_miplevel(miplevel)
+        , m_miplevel(short(miplevel))
         , m_chbegin(chbegin)
         , m_chend(chend)
+        , m_deep(deep)
         , m_file(&file)
     {
         int nc = file.spec(subimage, miplevel).nchannels;
@@ -508,6 +795,7 @@ struct TileID {
     int chbegin() const { return m_chbegin; }
     int chend() const { return m_chend; }
     int nchannels() const { return m_chend - m_chbegin; }
+    bool deep() const { return m_deep; }
 
     void x(int v) { m_x = v; }
     void y(int v) { m_y = v; }
@@ -536,7 +824,7 @@ struct TileID {
         return (a.m_x == b.m_x && a.m_y == b.m_y && a.m_z == b.m_z
                 && a.m_subimage == b.m_subimage && a.m_miplevel == b.m_miplevel
                 && (a.m_file == b.m_file) && a.m_chbegin == b.m_chbegin
-                && a.m_chend == b.m_chend);
+                && a.m_chend == b.m_chend && a.m_deep == b.m_deep);
     }
 
     /// Do the two ID's refer to the same tile?
@@ -550,6 +838,7 @@ struct TileID {
         const uint64_t a = (uint64_t(m_x) << 32) + uint64_t(m_y);
         const uint64_t b = (uint64_t(m_z) << 32) + uint64_t(m_subimage);
         const uint64_t c = (uint64_t(m_miplevel) << 32)
+                           + (uint64_t(m_deep) << 31)
                            + (uint64_t(m_chbegin) << 16) + uint64_t(m_chend);
         const uint64_t d = m_file->filename().hash();
         return fasthash::fasthash64({ a, b, c, d });
@@ -573,8 +862,9 @@ struct TileID {
 private:
     int m_x, m_y, m_z;         ///< x,y,z tile index within the subimage
     int m_subimage;            ///< subimage
-    int m_miplevel;            ///< MIP-map level
+    short m_miplevel;          ///< MIP-map level
     short m_chbegin, m_chend;  ///< Channel range
+    bool m_deep;               ///< Deep samples rather than flat pixels
     ImageCacheFile* m_file;    ///< Which ImageCacheFile we refer to
 };
 
@@ -600,29 +890,59 @@ public:
     OIIO_NODISCARD bool read(ImageCachePerThreadInfo* thread_info);
 
     /// Return pointer to the raw pixel data
-    const void* data(void) const { return &m_pixels[0]; }
+    const void* data(void) const { return pixels(); }
 
     /// Return pointer to the pixel data for a particular pixel.  Be
     /// extremely sure the pixel is within this tile!
     const void* data(int x, int y, int z, int c) const;
 
     /// Return pointer to the floating-point pixel data
-    const float* floatdata(void) const { return (const float*)&m_pixels[0]; }
+    const float* floatdata(void) const { return (const float*)pixels(); }
 
     /// Return a pointer to the character data
     const unsigned char* bytedata(void) const
     {
-        return (unsigned char*)&m_pixels[0];
+        return (const unsigned char*)pixels();
     }
 
     /// Return a pointer to unsigned short data
     const unsigned short* ushortdata(void) const
     {
-        return (unsigned short*)&m_pixels[0];
+        return (const unsigned short*)pixels();
     }
 
     /// Return a pointer to half data
-    const half* halfdata(void) const { return (half*)&m_pixels[0]; }
+    const half* halfdata(void) const { return (const half*)pixels(); }
+
+    /// The samples of a deep tile (nullptr for flat tiles), covering the
+    /// part of the tile within the data window.
+    const DeepData* deepdata() const { return m_deepdata.get(); }
+
+    /// Most NUMA nodes that tiles keep separate copies of pixels for.
+    static constexpr int max_numa_nodes = 16;
+
+    /// The NUMA node that the calling thread was on the last time the
+    /// cache checked (only kept up to date when numa_replicate is on).
+    static int& thread_numa_node()
+    {
+        static thread_local int node = 0;
+        return node;
+    }
+
+    /// The NUMA node of the thread that read (or copied in) the pixels.
+    int numa_node() const { return m_numa_node; }
+    void numa_node(int node) { m_numa_node = short(node); }
+
+    /// Count one more main cache lookup of this tile by a thread on some
+    /// other NUMA node, returning the count so far.
+    int note_remote_use() { return ++m_remote_uses; }
+
+    /// Make a copy of the pixels for the calling thread's NUMA node. The
+    /// calling thread touches it first, so on OSes with first-touch page
+    /// placement the copy lives in that node's memory. Return true if a
+    /// copy was made by this call (false if there already was one, or the
+    /// tile doesn't own its pixels).
+    bool add_numa_replica(int node);
 
     /// Return the id for this tile.
     ///
@@ -640,24 +960,41 @@ public:
 
     /// Mark the tile as recently used.
     ///
-    void use() { m_used = 1; }
+    void use() { m_used = m_lives; }
 
-    /// Mark the tile as not recently used, return its previous value.
-    ///
+    /// Take away one of the tile's remaining "lives" in the clock sweep.
+    /// Return true if it still had any (i.e., it was used recently enough
+    /// that it should be kept), false if it is a candidate for freeing.
     bool release()
     {
         if (!pixels_ready() || !valid())
             return true;  // Don't really release invalid or unready tiles
-        // If m_used is 1, set it to zero and return true.  If it was already
-        // zero, it's fine and return false.
-        int one = 1;
-        return m_used.compare_exchange_strong(one, 0);
+        // If m_used is nonzero, decrement it and return true.  If it was
+        // already zero, it's fine and return false.
+        int u = m_used;
+        while (u > 0) {
+            if (m_used.compare_exchange_weak(u, u - 1))
+                return true;
+        }
+        return false;
     }
 
+    /// Set the number of clock sweeps an unused tile will survive before
+    /// being freed, based on how expensive (in seconds) it would be to
+    /// read it back in again. Tiles that are cheap to re-read get the
+    /// minimum of one sweep, tiles from slow files get more.
+    void set_read_cost(double seconds);
+
     /// Has this tile been recently used?
     ///
     int used(void) const { return m_used; }
 
+    /// Should this tile be saved to the disk tile cache when it is freed?
+    /// True only for tiles that were read from their image file (not
+    /// those supplied by add_tile, nor those that came from the disk
+    /// cache in the first place).
+    bool persistable() const { return m_persist; }
+
     bool valid(void) const { return m_valid; }
 
     /// Are the pixels ready for use?  If false, they're still being
@@ -685,6 +1022,24 @@ public:
     }
 
 private:
+    /// The bookkeeping after read() has read `size` bytes of pixels (or
+    /// failed to). Returns m_valid.
+    bool finish_read(size_t size);
+
+    /// The pixels the calling thread should read: the copy for its NUMA
+    /// node if there is one, otherwise the tile's own.
+    const char* pixels() const
+    {
+        std::atomic<char*>* r = m_numa_replicas.load(std::memory_order_acquire);
+        if (OIIO_UNLIKELY(r != nullptr)) {
+            const char* p = r[thread_numa_node()].load(
+                std::memory_order_acquire);
+            if (p)
+                return p;
+        }
+        return m_pixels.get();
+    }
+
     TileID m_id;                       ///< ID of this tile
     std::unique_ptr<char[]> m_pixels;  ///< The pixel data
     size_t m_pixels_size { 0 };        ///< How much m_pixels has allocated
@@ -696,7 +1051,18 @@ private:
     volatile bool m_pixels_ready {
         false
     };                        ///< The pixels have been read from disk
-    atomic_int m_used { 1 };  ///< Used recently
+    atomic_int m_used { 1 };  ///< Used recently (sweeps left before freeing)
+    int m_lives { 1 };        ///< Value of m_used when marked as used
+    bool m_persist { false };  ///< Save to the disk tile cache when freed
+    std::shared_ptr<Filesystem::MappedFile> m_mapping;  ///< Keeps mapped
+                                                        ///<   pixels valid
+    std::shared_ptr<char> m_constant;  ///< Keeps shared constant pixels valid
+    short m_numa_node { 0 };      ///< NUMA node that first had the pixels
+    atomic_int m_remote_uses { 0 };  ///< Lookups from other NUMA nodes
+    /// The samples of a deep tile, which has no m_pixels
+    std::unique_ptr<DeepData> m_deepdata;
+    /// Per-node copies of m_pixels (array of max_numa_nodes), if any
+    std::atomic<std::atomic<char*>*> m_numa_replicas { nullptr };
 };
 
 
@@ -715,6 +1081,96 @@ typedef unordered_map_concurrent<
     TileCache;
 
 
+/// A page table mapping tiles of cached images to the slots of an atlas
+/// buffer owned by the caller (see ImageCache::create_page_table). Each
+/// slot holds one page of page_width x page_height pixels, with nchannels
+/// contiguous channels of type format. When the table is full, slots are
+/// recycled by a clock sweep over their "recently requested" bits.
+class ImageCachePageTable {
+public:
+    ImageCachePageTable(void* atlas, int nslots, int page_width,
+                        int page_height, int nchannels, TypeDesc format)
+        : m_atlas((char*)atlas)
+        , m_nslots(nslots)
+        , m_page_width(page_width)
+        , m_page_height(page_height)
+        , m_nchannels(nchannels)
+        , m_format(format)
+        , m_slot_tile(nslots)
+        , m_slot_used(nslots, 0)
+    {
+    }
+
+    int nslots() const { return m_nslots; }
+    int page_width() const { return m_page_width; }
+    int page_height() const { return m_page_height; }
+    int nchannels() const { return m_nchannels; }
+    TypeDesc format() const { return m_format; }
+    size_t pixel_bytes() const { return m_nchannels * m_format.size(); }
+    size_t slot_bytes() const
+    {
+        return pixel_bytes() * m_page_width * m_page_height;
+    }
+    size_t memsize() const { return slot_bytes() * m_nslots; }
+    char* slot_data(int slot) const { return m_atlas + slot * slot_bytes(); }
+
+    /// Return the slot holding tile id (marking it recently requested),
+    /// or -1 if it isn't resident. Caller must hold mutex().
+    int find(const TileID& id)
+    {
+        auto found = m_slots.find(id);
+        if (found == m_slots.end())
+            return -1;
+        m_slot_used[found->second] = 1;
+        return found->second;
+    }
+
+    /// Assign a slot to tile id, recycling the first slot the clock hand
+    /// finds that hasn't been requested since its last sweep. Set
+    /// `evicted` if the slot held another tile. Caller must hold mutex().
+    int claim(const TileID& id, bool& evicted)
+    {
+        while (m_slot_used[m_clock]) {
+            m_slot_used[m_clock] = 0;
+            m_clock              = (m_clock + 1) % m_nslots;
+        }
+        int slot = m_clock;
+        m_clock  = (m_clock + 1) % m_nslots;
+        evicted  = !m_slot_tile[slot].empty();
+        if (evicted)
+            m_slots.erase(m_slot_tile[slot]);
+        m_slot_tile[slot] = id;
+        m_slot_used[slot] = 1;
+        m_slots[id]       = slot;
+        return slot;
+    }
+
+    /// Forget all pages. Caller must hold mutex().
+    void clear()
+    {
+        m_slots.clear();
+        std::fill(m_slot_tile.begin(), m_slot_tile.end(), TileID());
+        std::fill(m_slot_used.begin(), m_slot_used.end(), 0);
+        m_clock = 0;
+    }
+
+    spin_mutex& mutex() { return m_mutex; }
+
+private:
+    char* m_atlas;
+    int m_nslots;
+    int m_page_width, m_page_height;
+    int m_nchannels;
+    TypeDesc m_format;
+    spin_mutex m_mutex;
+    tsl::robin_map<TileID, int, TileID::Hasher> m_slots;  ///< tile -> slot
+    std::vector<TileID> m_slot_tile;  ///< slot -> tile (empty if free)
+    std::vector<char> m_slot_used;    ///< Clock "recently requested" bits
+    int m_clock = 0;                  ///< Clock hand
+};
+
+
+
 /// A very small amount of per-thread data that saves us from locking
 /// the mutex quite as often.  We store things here used by both
 /// ImageCache and TextureSystem, so they don't each need a costly
@@ -730,12 +1186,45 @@ public:
         = tsl::robin_map<ustring, ImageCacheFile*, ustringHash>;
     ThreadFilenameMap m_thread_files;
 
-    // We have a two-tile "microcache", storing the last two tiles needed.
-    ImageCacheTileRef tile, lasttile;
+    // Per-thread, lazily filled table of resolved UDIM tiles: for each
+    // UDIM file, the concrete file of each tile (indexed like the file's
+    // m_udim_lookup, nullptr if not resolved yet), so that resolving a
+    // tile this thread has already seen takes no lock. The last table
+    // used is remembered to skip the map lookup for runs of lookups in
+    // the same UDIM set.
+    using ThreadUdimMap
+        = tsl::robin_map<ImageCacheFile*, std::vector<ImageCacheFile*>>;
+    ThreadUdimMap m_udim_tiles;
+    ImageCacheFile* m_last_udimfile              = nullptr;
+    std::vector<ImageCacheFile*>* m_last_udim_tiles = nullptr;
+
+    // We have a small per-thread tile "microcache" in front of the big
+    // shared tile cache. `tile` is the tile most recently found (it's
+    // where find_tile() leaves its result). Behind it is a small
+    // set-associative cache of recently used tiles, indexed by TileID
+    // hash, big enough to hold the 2x2 neighborhood of tiles touched by
+    // filtered lookups that straddle tile corners (for two MIP levels).
+    static constexpr int microcache_sets = 2;  // must be a power of 2
+    static constexpr int microcache_ways = 4;
+    ImageCacheTileRef tile;
+    ImageCacheTileRef microcache[microcache_sets][microcache_ways];
     atomic_int purge;  // If set, tile ptrs need purging!
+    // While this thread is looking in the IC's lock-free tile index, the
+    // epoch it started in (otherwise 0). See ImageCacheImpl::retire_tile.
+    std::atomic<uint64_t> tile_epoch { 0 };
     ImageCacheStatistics m_stats;
     bool shared = false;  // Pointed to by the IC and thread_specific_ptr
 
+    // Lookup cost counters, by texture filename and by call site tag,
+    // kept only while the TextureSystem's "lookup_stats" is on. The
+    // mutex is only contended when the stats are being gathered up.
+    // m_cost_depth counts nested lookup calls, so that only the
+    // outermost one records.
+    LookupCostMap m_file_costs;
+    LookupCostMap m_site_costs;
+    spin_mutex m_cost_mutex;
+    int m_cost_depth = 0;
+
     ImageCachePerThreadInfo()
     {
         // std::cout << "Creating PerThreadInfo " << (void*)this << "\n";
@@ -747,6 +1236,42 @@ public:
         // std::cout << "Destroying PerThreadInfo " << (void*)this << "\n";
     }
 
+    // Look for the tile `id` (whose hash is `hash`) in the associative
+    // part of the microcache. If found, make it the current `tile`, move
+    // it to the front of its set, and return true.
+    bool microcache_find(const TileID& id, size_t hash)
+    {
+        ImageCacheTileRef* set = microcache[hash & (microcache_sets - 1)];
+        for (int w = 0; w < microcache_ways && set[w]; ++w) {
+            if (set[w]->id() == id) {
+                for (; w > 0; --w)
+                    set[w].swap(set[w - 1]);
+                tile = set[0];
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Add the current `tile` (whose hash is `hash`) to the front of its
+    // set in the microcache, pushing out the least recently used entry.
+    void microcache_insert(size_t hash)
+    {
+        ImageCacheTileRef* set = microcache[hash & (microcache_sets - 1)];
+        for (int w = microcache_ways - 1; w > 0; --w)
+            set[w].swap(set[w - 1]);
+        set[0] = tile;
+    }
+
+    // Clear the tile microcache.
+    void purge_microcache()
+    {
+        tile.reset();
+        for (auto& set : microcache)
+            for (auto& t : set)
+                t.reset();
+    }
+
     // Add a new filename/fileptr pair to our microcache
     void remember_filename(ustring n, ImageCacheFile* f)
     {
@@ -759,6 +1284,29 @@ public:
         auto f = m_thread_files.find(n);
         return f == m_thread_files.end() ? nullptr : f->second;
     }
+
+    // Return this thread's table of resolved tiles for udimfile, which
+    // has ntiles tiles, creating it if needed.
+    std::vector<ImageCacheFile*>& udim_tiles(ImageCacheFile* udimfile,
+                                             size_t ntiles)
+    {
+        if (udimfile != m_last_udimfile) {
+            auto& tiles = m_udim_tiles[udimfile];  // may rehash
+            if (tiles.size() != ntiles)
+                tiles.assign(ntiles, nullptr);
+            m_last_udimfile   = udimfile;
+            m_last_udim_tiles = &tiles;
+        }
+        return *m_last_udim_tiles;
+    }
+
+    // Forget all resolved UDIM tiles.
+    void purge_udim_tiles()
+    {
+        m_udim_tiles.clear();
+        m_last_udimfile   = nullptr;
+        m_last_udim_tiles = nullptr;
+    }
 };
 
 
@@ -836,7 +1384,12 @@ public:
     bool accept_unmipped() const { return m_accept_unmipped; }
     bool unassociatedalpha() const { return m_unassociatedalpha; }
     bool trust_file_extensions() const { return m_trust_file_extensions; }
+    bool mmap_tiles() const { return m_mmap_tiles; }
+    bool latency_stats() const { return m_latency_stats; }
     int failure_retries() const { return m_failure_retries; }
+    int max_readahead_tiles() const { return m_max_readahead_tiles; }
+    int max_inputs_per_file() const { return m_max_inputs_per_file; }
+    int open_files_current() const { return m_stat_open_files_current; }
     bool latlong_y_up_default() const { return m_latlong_y_up_default; }
     void get_commontoworld(Imath::M44f& result) const { result = m_Mc2w; }
     int max_errors_per_file() const { return m_max_errors_per_file; }
@@ -913,6 +1466,11 @@ public:
                TypeDesc format, void* result, stride_t xstride = AutoStride,
                stride_t ystride = AutoStride, stride_t zstride = AutoStride,
                int cache_chbegin = 0, int cache_chend = -1);
+    // Batched retrieval of many regions, grouped by tile.
+    virtual bool get_pixels(ImageHandle* file, Perthread* thread_info,
+                            cspan<PixelRequest> requests, TypeDesc format);
+    virtual bool get_pixels(ustring filename, cspan<PixelRequest> requests,
+                            TypeDesc format);
 
     // Find the ImageCacheFile record for the named image, adding an entry
     // if it is not already in the cache. This returns a plain old pointer,
@@ -957,6 +1515,9 @@ public:
         return handle && !handle->broken();
     }
 
+    virtual bool file_attribute(ImageCacheFile* file, string_view name,
+                                TypeDesc type, const void* val);
+
     virtual ustring filename_from_handle(ImageCacheFile* handle)
     {
         return handle ? handle->filename() : ustring();
@@ -988,23 +1549,24 @@ public:
     {
         ++thread_info->m_stats.find_tile_calls;
         ImageCacheTileRef& tile(thread_info->tile);
-        if (tile) {
-            if (tile->id() == id) {
-                if (mark_same_tile_used)
-                    tile->use();
-                return true;  // already have the tile we want
-            }
-            // Tile didn't match, maybe lasttile will?  Swap tile
-            // and last tile.  Then the new one will either match,
-            // or we'll fall through and replace tile.
-            tile.swap(thread_info->lasttile);
-            if (tile && tile->id() == id) {
+        if (tile && tile->id() == id) {
+            if (mark_same_tile_used)
                 tile->use();
-                return true;
-            }
+            return true;  // already have the tile we want
         }
-        return find_tile_main_cache(id, tile, thread_info);
+        // Tile didn't match, maybe one of the other recently used tiles
+        // in the microcache will?
+        size_t hash = id.hash();
+        if (thread_info->microcache_find(id, hash)) {
+            ++thread_info->m_stats.find_tile_microcache_assoc_hits;
+            tile->use();
+            return true;
+        }
+        bool ok = find_tile_main_cache(id, tile, thread_info);
         // N.B. find_tile_main_cache marks the tile as used
+        if (ok)
+            thread_info->microcache_insert(hash);
+        return ok;
     }
 
     virtual Tile* get_tile(ustring filename, int subimage, int miplevel, int x,
@@ -1012,10 +1574,39 @@ public:
     virtual Tile* get_tile(ImageHandle* file, Perthread* thread_info,
                            int subimage, int miplevel, int x, int y, int z,
                            int chbegin, int chend);
+    virtual bool get_deep_pixels(ustring filename, int subimage, int miplevel,
+                                 ROI roi, DeepData& deepdata);
+    virtual bool get_deep_pixels(ImageHandle* file, Perthread* thread_info,
+                                 int subimage, int miplevel, ROI roi,
+                                 DeepData& deepdata);
+    virtual int prefetch_tiles(ustring filename, int subimage, int miplevel,
+                               ROI roi);
+    virtual int prefetch_tiles(ImageHandle* file, Perthread* thread_info,
+                               int subimage, int miplevel, ROI roi);
+    virtual int prefetch_tiles(ImageHandle* file, Perthread* thread_info,
+                               int subimage, int miplevel, cspan<ROI> rois);
+    // Read a 2D region that lies within the data window straight from the
+    // file into the result, without going through the tile cache.
+    bool get_pixels_streaming(ImageCacheFile* file,
+                              ImageCachePerThreadInfo* thread_info,
+                              int subimage, int miplevel, int xbegin,
+                              int xend, int ybegin, int yend, int chbegin,
+                              int chend, TypeDesc format, void* result,
+                              stride_t xstride, stride_t ystride);
+    virtual bool save_manifest(string_view path);
+    virtual bool load_manifest(string_view path);
     virtual void release_tile(Tile* tile) const;
     virtual TypeDesc tile_format(const Tile* tile) const;
     virtual ROI tile_roi(const Tile* tile) const;
     virtual const void* tile_pixels(Tile* tile, TypeDesc& format) const;
+    virtual PageTable* create_page_table(void* atlas, int nslots,
+                                         int page_width, int page_height,
+                                         int nchannels, TypeDesc format);
+    virtual void destroy_page_table(PageTable* table);
+    virtual int page_slot(PageTable* table, ImageHandle* file,
+                          Perthread* thread_info, int subimage, int miplevel,
+                          int x, int y, int z, bool* filled);
+    virtual void clear_page_table(PageTable* table);
     virtual bool add_file(ustring filename, ImageInput::Creator creator,
                           const ImageSpec* config, bool replace);
     virtual bool add_tile(ustring filename, int subimage, int miplevel, int x,
@@ -1035,6 +1626,7 @@ public:
     virtual void invalidate(ustring filename, bool force);
     virtual void invalidate(ImageHandle* file, bool force);
     virtual void invalidate_all(bool force = false);
+    virtual void invalidate_files(cspan<ustring> filenames, bool force);
     virtual void close(ustring filename);
     virtual void close_all();
 
@@ -1042,6 +1634,9 @@ public:
     ///
     void mergestats(ImageCacheStatistics& merged) const;
 
+    /// Merge all threads' lookup cost counters into `files` and `sites`.
+    void merge_lookup_costs(LookupCostMap& files, LookupCostMap& sites) const;
+
     void operator delete(void* todel) { ::delete ((char*)todel); }
 
     /// Called when a new file is opened, so that the system can track
@@ -1068,6 +1663,32 @@ public:
     /// Called when a tile's pixel memory is allocated, but a new tile
     /// is not created.
     void incr_mem(size_t size) { m_mem_used += size; }
+    void decr_mem(size_t size) { m_mem_used -= size; }
+
+    /// Called when an autotiled tile is copied from a band of scanlines
+    /// that was already decoded, rather than reading the band again.
+    void incr_bands_reused() { ++m_stat_bands_reused; }
+
+    /// How many NUMA nodes tiles are replicated across (0 if the
+    /// numa_replicate option is off or there's only one node).
+    int numa_nodes() const { return m_numa_nodes; }
+
+    /// Count a tile read by a thread on NUMA node `node`.
+    void incr_numa_tiles_read(int node) { ++m_stat_numa_tiles_read[node]; }
+
+    /// Refresh and return the calling thread's NUMA node.
+    int update_thread_numa_node()
+    {
+        int node = std::min(Sysutil::current_numa_node(),
+                            ImageCacheTile::max_numa_nodes - 1);
+        ImageCacheTile::thread_numa_node() = node;
+        return node;
+    }
+
+    /// A thread on NUMA node `node` found `tile` in the main cache: if
+    /// the pixels live on another node and the tile is used from other
+    /// nodes often enough, give this node its own copy.
+    void numa_replicate(ImageCacheTile& tile, int node);
 
     /// Called when a tile is destroyed, to update all the stats.
     ///
@@ -1113,19 +1734,169 @@ public:
     /// Enforce the max number of open files.
     void check_max_files(ImageCachePerThreadInfo* thread_info);
 
+    /// Is the on-disk second tier tile cache enabled?
+    bool diskcache_enabled() const { return !m_diskcache_dir.empty(); }
+
+    /// Try to fill `data` (of `size` bytes) with the pixels of tile `id`
+    /// from the on-disk tile cache. Return true if it was found there.
+    bool read_disk_tile(const TileID& id, void* data, size_t size,
+                        ImageCachePerThreadInfo* thread_info);
+
+    /// Save the pixels of a tile that's being freed from memory into the
+    /// on-disk tile cache, if it's enabled, there's room, and the tile is
+    /// not already there.
+    void write_disk_tile(const ImageCacheTile& tile);
+
+    /// Is the compressed in-memory tile tier enabled?
+    bool compressed_tier_enabled() const
+    {
+        return m_max_compressed_bytes > 0;
+    }
+
+    /// Keep a compressed copy of the pixels of a tile that's being freed
+    /// from the main cache, if it's worth it.
+    void demote_tile(const ImageCacheTile& tile);
+
+    /// Try to fill `data` (of `size` bytes) with the pixels of tile `id`
+    /// from the compressed tier, removing it from the tier. Return true if
+    /// it was found there. If so, also set `persist` to whether the
+    /// original tile was fit for saving to the disk cache.
+    bool restore_compressed_tile(const TileID& id, void* data, size_t size,
+                                 bool& persist);
+
+    /// Is there a compressed copy of the tile in the compressed tier?
+    bool in_compressed_tier(const TileID& id)
+    {
+        if (!compressed_tier_enabled())
+            return false;
+        spin_lock lock(m_compressed_mutex);
+        return m_compressed_tiles.find(id) != m_compressed_tiles.end();
+    }
+
+    /// Discard the compressed tiles of the given files, which must be
+    /// sorted by address (or all of them, if `files` is empty).
+    void purge_compressed_tiles(cspan<const ImageCacheFile*> files);
+
     int max_mip_res() const noexcept { return m_max_mip_res; }
 
 private:
     void init();
 
+    /// The compressed pixels of a tile in the compressed tier.
+    struct CompressedTile {
+        std::unique_ptr<unsigned char[]> data;  ///< The compressed pixels
+        size_t size  = 0;                       ///< Compressed size
+        bool persist = false;  ///< Original tile could go to disk cache
+    };
+    typedef tsl::robin_map<TileID, CompressedTile, TileID::Hasher>
+        CompressedTileMap;
+
+    /// Discard the oldest compressed tiles until the tier fits its limit.
+    /// The caller must hold m_compressed_mutex.
+    void trim_compressed_tiles();
+
+    /// Per-bin state for the "clock" tile paging algorithm. Each bin of
+    /// the tile cache has its own sweep hand and mutex, so that several
+    /// threads can free tiles at once as long as they sweep different bins.
+    struct TileSweepShard {
+        OIIO_CACHE_ALIGN spin_mutex mutex;  ///< Only one sweeper per bin
+        TileID sweep_id;  ///< Next tile to examine in this bin
+    };
+
     /// Find a tile identified by 'id' in the tile cache, paging it in if
     /// needed, and store a reference to the tile.  Return true if ok,
     /// false if no such tile exists in the file or could not be read.
     bool find_tile_main_cache(const TileID& id, ImageCacheTileRef& tile,
                               ImageCachePerThreadInfo* thread_info);
 
-    /// Enforce the max memory for tile data.
-    void check_max_mem(ImageCachePerThreadInfo* thread_info);
+    /// Look for the tile in the lock-free index without taking any lock.
+    /// Return a reference to it if found, otherwise an empty reference.
+    ImageCacheTileRef find_tile_index(const TileID& id, size_t hash,
+                                      ImageCachePerThreadInfo* thread_info);
+
+    /// Make a tile findable through the lock-free index. The caller must
+    /// have found it in the tile cache and still hold the lock of its bin,
+    /// which guarantees that the tile is not concurrently being erased.
+    void publish_tile(ImageCacheTile* tile, size_t hash);
+
+    /// Remove a tile that the caller just erased from the tile cache (and
+    /// still holds a reference to) from the lock-free index.
+    void unpublish_tile(ImageCacheTile* tile);
+
+    /// Remove all tiles of the given files, which must be sorted by address
+    /// (or all tiles, if `files` is empty), from the lock-free index.
+    void unpublish_tiles(cspan<const ImageCacheFile*> files);
+
+    /// Take over the reference the index held on a tile that was just
+    /// removed from it, and release it once no thread can still be
+    /// looking at the tile through the index.
+    void retire_tile(ImageCacheTile* tile);
+
+    /// Move the retired tiles that are now safe to release (all of them,
+    /// if `all` is true) from m_retired_tiles to `freeable`. The caller
+    /// must hold m_retired_tiles_mutex.
+    void reclaim_retired_tiles(std::vector<ImageCacheTile*>& freeable,
+                               bool all = false);
+
+    /// Read the pixels of a tile that the caller just added to the cache,
+    /// accounting for the I/O time, then enforce the memory limit.
+    bool read_new_tile(ImageCacheTileRef& tile,
+                       ImageCachePerThreadInfo* thread_info);
+
+    /// Return the thread pool that services prefetch requests, creating
+    /// it if necessary.
+    thread_pool* prefetch_pool();
+
+    /// Enforce the max memory for tile data, starting the sweep with
+    /// tile cache bin `startbin`.
+    void check_max_mem(ImageCachePerThreadInfo* thread_info, size_t startbin);
+
+    /// Size the tile cache budget as `fraction` of the memory this process
+    /// may use, and adapt it to memory pressure, or stop doing so if
+    /// `fraction` is 0.
+    void set_max_memory_fraction(float fraction);
+
+    /// Body of the thread that adapts the budget: shrink it whenever the
+    /// kernel reports memory pressure, and grow it back towards `ceiling`
+    /// once the pressure has eased.
+    void adapt_max_memory(long long ceiling);
+
+    /// Start or stop watching the directories of the cached files for
+    /// changes, so that invalidate_all() needn't check every file.
+    void set_watch_files(bool watch);
+
+    /// If files are being watched, watch the directory of `file`.
+    void watch_file(ImageCacheFile* file);
+
+    /// Collect the files that the watcher has seen change since the last
+    /// call into `changed`, and those whose directories it can't watch into
+    /// `unwatched`. Return false if no files are being watched or some
+    /// changes may have been missed, so every file must be checked.
+    bool take_file_changes(std::vector<ImageCacheFileRef>& changed,
+                           std::vector<ImageCacheFileRef>& unwatched);
+
+    /// Invalidate the non-forced way: the files that were broken or have
+    /// changed on disk, and if `check_settings` is true, those that were
+    /// opened differently than the current settings would open them.
+    void invalidate_stale(bool check_settings);
+
+    /// Invalidate all of `files` unconditionally, with a single pass over
+    /// the tile cache.
+    void invalidate_batch(std::vector<ImageCacheFileRef>& files);
+
+    /// Run the clock sweep over the single tile cache bin described by
+    /// `shard` (whose mutex the caller must hold) from its saved position
+    /// to the end of the bin or until memory use is back under the limit.
+    void sweep_tile_bin(size_t bin, TileSweepShard& shard);
+
+    /// Finish evicting a tile that was just erased from the tile cache:
+    /// drop it from the lock-free index and give the compressed tier and
+    /// disk cache their chance to keep a copy.
+    void evict_tile(ImageCacheTile& tile);
+
+    /// Free the oldest tiles of `file` while it is over its own
+    /// resident memory quota.
+    void check_file_quota(ImageCacheFile& file);
 
     /// Internal statistics printing routine
     ///
@@ -1150,6 +1921,26 @@ private:
     /// Clear the fingerprint list, thread-safe.
     void clear_fingerprints();
 
+    /// For a file without a fingerprint, find an already opened file
+    /// whose contents are byte-for-byte the same, by hashing both files
+    /// if they're the same size. Return the file found, or `file` itself
+    /// if there is none.
+    ImageCacheFile* find_content_duplicate(ImageCacheFile* file);
+
+    /// Is it OK to treat `dup` as a duplicate of `file`, given that their
+    /// pixels are the same? That also requires that they have the same
+    /// shape and texture metadata.
+    bool duplicate_compatible(const ImageCacheFile* file,
+                              const ImageCacheFile* dup) const;
+
+    /// Return the unique key identifying the tile contents in the on-disk
+    /// tile cache (which may be shared by many processes), or an empty
+    /// string if the tile should not be stored there.
+    std::string disk_tile_key(const TileID& id) const;
+
+    /// Return the path to the on-disk tile cache file for the given key.
+    std::string disk_tile_path(string_view key) const;
+
     thread_specific_ptr<ImageCachePerThreadInfo> m_perthread_info;
     std::vector<ImageCachePerThreadInfo*> m_all_perthread_info;
     static spin_mutex m_perthread_info_mutex;  ///< Thread safety for perthread
@@ -1165,10 +1956,20 @@ private:
     bool m_accept_untiled;     ///< Accept untiled images?
     bool m_accept_unmipped;    ///< Accept unmipped images?
     bool m_deduplicate;        ///< Detect duplicate files?
+    bool m_deduplicate_content = false;  ///< Also by hashing file contents?
     bool m_unassociatedalpha;  ///< Keep unassociated alpha files as they are?
     bool m_latlong_y_up_default;  ///< Is +y the default "up" for latlong?
     bool m_trust_file_extensions = false;  ///< Assume file extensions don't lie?
+    bool m_mmap_tiles = false;  ///< Use uncompressed tiles from mapped files?
+    bool m_latency_stats = false;  ///< Record latency distributions?
     int m_failure_retries;                 ///< Times to re-try disk failures
+    int m_max_readahead_tiles = 8;  ///< Longest run of tiles to read at once
+    int m_max_inputs_per_file = 4;  ///< Most ImageInputs open for one file
+    int m_get_pixels_streaming = 1;  ///< When get_pixels bypasses the cache
+    int m_numa_replicate = 0;  ///< Remote lookups before a NUMA copy
+    int m_numa_nodes     = 0;  ///< Nodes to replicate across (0 = off)
+    atomic_ll m_stat_numa_tiles_read[ImageCacheTile::max_numa_nodes];
+    atomic_ll m_stat_numa_replicas[ImageCacheTile::max_numa_nodes];
     int m_max_mip_res = 1 << 30;  ///< Don't use MIP levels higher than this
     Imath::M44f m_Mw2c;           ///< world-to-"common" matrix
     Imath::M44f m_Mc2w;           ///< common-to-world matrix
@@ -1180,12 +1981,49 @@ private:
 
     spin_mutex m_fingerprints_mutex;  ///< Protect m_fingerprints
     FingerprintMap m_fingerprints;    ///< Map fingerprints to files
-
-    TileCache m_tilecache;          ///< Our in-memory tile cache
-    TileID m_tile_sweep_id;         ///< Sweeper for "clock" paging algorithm
-    spin_mutex m_tile_sweep_mutex;  ///< Ensure only one in check_max_mem
+    /// The first file seen of each size in bytes, for deduplicate_content
+    /// (protected by m_fingerprints_mutex)
+    std::unordered_map<uint64_t, ImageCacheFileRef> m_content_sizes;
+
+    TileCache m_tilecache;  ///< Our in-memory tile cache
+    TileSweepShard m_tile_sweep[TileCache::nbins()];  ///< Clock sweep hands
+
+    // Lock-free index in front of m_tilecache: a direct-mapped table, by
+    // tile hash, of tiles that were recently found in the cache. Each slot
+    // holds a reference to its tile. A reader announces the epoch it is
+    // looking in (ImageCachePerThreadInfo::tile_epoch), and a tile removed
+    // from a slot is retired, tagged with the epoch at which that happened,
+    // and only released when every reader is past that epoch.
+    static constexpr size_t tile_index_size = 16384;  // must be power of 2
+    std::unique_ptr<std::atomic<ImageCacheTile*>[]> m_tile_index;
+    std::atomic<uint64_t> m_tile_epoch { 1 };  ///< Current retire epoch
+    spin_mutex m_retired_tiles_mutex;  ///< Protect m_retired_tiles
+    std::vector<std::pair<uint64_t, ImageCacheTile*>> m_retired_tiles;
 
     atomic_ll m_mem_used;       ///< Memory being used for tiles
+    std::string m_diskcache_dir;    ///< Directory of the disk tile cache
+    atomic_ll m_max_diskcache_bytes;  ///< Max bytes we write to disk cache
+    atomic_ll m_diskcache_bytes;    ///< Bytes we have written to disk cache
+    CompressedTileMap m_compressed_tiles;  ///< The compressed tier
+    std::deque<TileID> m_compressed_order;  ///< Oldest compressed tiles first
+    spin_mutex m_compressed_mutex;  ///< Protect the compressed tier
+    atomic_ll m_max_compressed_bytes;  ///< Limit of the compressed tier
+    atomic_ll m_compressed_bytes;   ///< Current size of the compressed tier
+    int m_prefetch_threads;         ///< Size of the prefetch thread pool
+    std::unique_ptr<thread_pool> m_prefetch_pool;  ///< Prefetch I/O threads
+    spin_mutex m_prefetch_pool_mutex;  ///< Protect m_prefetch_pool creation
+    float m_max_memory_fraction = 0.0f;  ///< Automatic budget (0 = off)
+    std::unique_ptr<Sysutil::MemoryPressureMonitor> m_memory_monitor;
+    std::thread m_memory_thread;             ///< Runs adapt_max_memory()
+    std::atomic<bool> m_memory_thread_stop;  ///< Tell it to exit
+    std::atomic<bool> m_watch_files;  ///< Watch the files for changes?
+    std::unique_ptr<Filesystem::ChangeWatcher> m_watcher;
+    std::mutex m_watch_mutex;  ///< Protect m_watcher and the lists below
+    /// The watched files, by resolved filename
+    std::unordered_map<std::string, ImageCacheFileRef> m_watched_files;
+    /// Files whose directories can't be watched
+    std::vector<ImageCacheFileRef> m_unwatched_files;
+    bool m_watch_resync = false;  ///< Check all files, changes may be missed
     int m_statslevel;           ///< Statistics level
     int m_max_errors_per_file;  ///< Max errors to print for each file.
 
@@ -1203,6 +2041,13 @@ private:
     atomic_int m_stat_open_files_created;
     atomic_int m_stat_open_files_current;
     atomic_int m_stat_open_files_peak;
+    atomic_int m_stat_diskcache_tiles_written;
+    atomic_int m_stat_tiles_prefetched;
+    atomic_int m_stat_compressed_tiles_demoted;
+    atomic_int m_stat_compressed_tiles_restored;
+    atomic_int m_stat_tiles_quota_evicted;
+    atomic_int m_stat_memory_pressure_events;
+    atomic_int m_stat_bands_reused;
 
     // Simulate an atomic double with a long long!
     void incr_time_stat(double& stat, double incr)
@@ -0,0 +1,477 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+#include <cmath>
+#include <limits>
+
+#include <OpenImageIO/Imath.h>
+#include <OpenImageIO/dassert.h>
+#include <OpenImageIO/fmath.h>
+#include <OpenImageIO/imagecache.h>
+#include <OpenImageIO/simd.h>
+#include <OpenImageIO/texture.h>
+#include <OpenImageIO/typedesc.h>
+#include <OpenImageIO/ustring.h>
+#include <OpenImageIO/varyingref.h>
+
+#include "imagecache_pvt.h"
+#include "texture_pvt.h"
+
+
+/*
+Discussion of shadow map conventions:
+
+A shadow map is a depth image rendered from the light, tagged with the
+"worldtoscreen" matrix of that view (and usually "worldtocamera", both as
+written by maketx --shadow). A lookup projects the receiving point P
+through worldtoscreen, mapping screen x,y in [-1,1] to s,t in [0,1] with
+t pointing down, and compares the receiver's depth -- its camera space z
+if worldtocamera is known, otherwise its screen z -- less the shadow
+bias, to the depths stored in channel options.firstchannel of the map.
+
+Filtering is percentage-closer (PCF): depths are never averaged, only the
+results of the comparisons. We take the nearest texel to each tap of a
+fixed Poisson disk kernel scaled to the footprint of the derivatives, and
+do the comparisons four taps at a time in SIMD. The kernel is fixed, so
+the lookups are deterministic and coherent: neighboring taps nearly always
+land on the same tile, which we hold on to rather than going back to the
+cache for every tap.
+
+Soft shadows use the same kernel for a PCSS-style blocker search. When
+sblur/tblur are nonzero they give the size of the light in st units; the
+average depth of the texels closer than the receiver within that radius
+gives the penumbra width, and the PCF radius widens to match. Receivers
+with no blockers at all are lit with no further work.
+
+Only MIP level 0 is used: a MIP-mapped depth map averages depths, which is
+exactly what PCF is trying to avoid.
+*/
+
+
+OIIO_NAMESPACE_BEGIN
+using namespace pvt;
+using namespace simd;
+
+namespace {  // anonymous
+
+// 16-tap Poisson disk on the unit disk. The taps are ordered so that each
+// group of four has one tap per quadrant, so any leading multiple of four
+// is still a reasonable kernel on its own.
+alignas(16) static const float shadow_kernel_s[16] = {
+    -0.94201624f, 0.94558609f,  0.34495938f,  -0.91588581f,
+    -0.81544232f, 0.44323325f,  0.97484398f,  -0.38277543f,
+    -0.26496911f, 0.53742981f,  0.79197514f,  -0.24188840f,
+    -0.09418410f, 0.14383161f,  0.19984126f,  -0.81409955f
+};
+alignas(16) static const float shadow_kernel_t[16] = {
+    -0.39906216f, -0.76890725f, 0.29387760f,  0.45771432f,
+    -0.87912464f, -0.97511554f, 0.75648379f,  0.27676845f,
+    -0.41893023f, -0.47373420f, 0.19090188f,  0.99706507f,
+    -0.92938870f, -0.14100790f, 0.78641367f,  0.91437590f
+};
+static const int shadow_kernel_groups = 4;
+
+
+
+// Read the depth channel at `offset` into a tile of the given type.
+inline float
+tile_depth(TypeDesc::BASETYPE pixeltype, const ImageCacheTile* tile,
+           size_t offset)
+{
+    switch (pixeltype) {
+    case TypeDesc::UINT8: return tile->bytedata()[offset] * (1.0f / 255.0f);
+    case TypeDesc::UINT16:
+        return tile->ushortdata()[offset] * (1.0f / 65535.0f);
+    case TypeDesc::HALF: return float(tile->halfdata()[offset]);
+    default: OIIO_DASSERT(pixeltype == TypeDesc::FLOAT);
+    }
+    return tile->floatdata()[offset];
+}
+
+
+
+// Project common space P into the shadow map described by `si`, giving
+// its st coordinates and the depth to compare against the map. Return
+// false if P is behind the light (or on its plane).
+inline bool
+shadow_project(const ImageCacheFile::SubimageInfo& si, const Imath::V3f& P,
+               float& s, float& t, float& depth)
+{
+    const Imath::M44f& M(*si.Mscreen);
+    float x = P.x * M[0][0] + P.y * M[1][0] + P.z * M[2][0] + M[3][0];
+    float y = P.x * M[0][1] + P.y * M[1][1] + P.z * M[2][1] + M[3][1];
+    float z = P.x * M[0][2] + P.y * M[1][2] + P.z * M[2][2] + M[3][2];
+    float w = P.x * M[0][3] + P.y * M[1][3] + P.z * M[2][3] + M[3][3];
+    if (!(w > 0.0f))
+        return false;
+    float invw = 1.0f / w;
+    s          = 0.5f * (x * invw + 1.0f);
+    t          = 0.5f * (1.0f - y * invw);
+    if (si.Mcamera) {
+        Imath::V3f Pcam;
+        si.Mcamera->multVecMatrix(P, Pcam);
+        depth = Pcam.z;
+    } else {
+        depth = z * invw;
+    }
+    return true;
+}
+
+}  // end anonymous namespace
+
+namespace pvt {  // namespace pvt
+
+
+
+bool
+TextureSystemImpl::shadow_setup(TextureFile* texturefile, TextureOpt& options)
+{
+    if (!texturefile || texturefile->broken())
+        return false;
+    if (!options.subimagename.empty()) {
+        // If subimage was specified by name, figure out its index.
+        int s = m_imagecache->subimage_from_name(texturefile,
+                                                 options.subimagename);
+        if (s < 0) {
+            error("Unknown subimage \"{}\" in texture \"{}\"",
+                  options.subimagename, texturefile->filename());
+            return false;
+        }
+        options.subimage = s;
+        options.subimagename.clear();
+    }
+    if (options.subimage < 0 || options.subimage >= texturefile->subimages()) {
+        error("Unknown subimage \"{}\" in texture \"{}\"", options.subimagename,
+              texturefile->filename());
+        return false;
+    }
+    if (!texturefile->subimageinfo(options.subimage).Mscreen) {
+        error("Shadow map \"{}\" has no \"worldtoscreen\" matrix",
+              texturefile->filename());
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+TextureSystemImpl::shadow_pcf(TextureFile& texturefile,
+                              PerThreadInfo* thread_info,
+                              const TextureOpt& options, float s, float t,
+                              float depth, float sradius, float tradius,
+                              float& occlusion)
+{
+    const ImageSpec& spec(texturefile.spec(options.subimage, 0));
+    TypeDesc::BASETYPE pixeltype = texturefile.pixeltype(options.subimage);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    int tile_chbegin = 0, tile_chend = spec.nchannels;
+    if (spec.nchannels > m_max_tile_channels) {
+        // For files with many channels, narrow the range we cache
+        tile_chbegin = options.firstchannel;
+        tile_chend   = options.firstchannel + 1;
+    }
+    TileID id(texturefile, options.subimage, 0, 0, 0, 0, tile_chbegin,
+              tile_chend);
+    size_t choffset = options.firstchannel - id.chbegin();
+
+    // Nearest texel to st: texel i is centered at (i+0.5)/res, or at
+    // i/(res-1) for maps that sample their border.
+    bool border = texturefile.m_sample_border;
+    float smul  = border ? float(spec.width - 1) : float(spec.width);
+    float tmul  = border ? float(spec.height - 1) : float(spec.height);
+    float round = border ? 0.5f : 0.0f;
+    vint4 xbegin(spec.x), xend(spec.x + spec.width);
+    vint4 ybegin(spec.y), yend(spec.y + spec.height);
+
+    int ngroups = OIIO::clamp((options.samples + 3) / 4, 1,
+                              shadow_kernel_groups);
+    int ntaps   = 4 * ngroups;
+    bool ok     = true;
+    const ImageCacheTile* tile = nullptr;
+    int tilex = 0, tiley = 0;
+
+    // Depths at the four taps of kernel group g. Taps outside the data
+    // window (and any whose tile can't be read) come back as the largest
+    // float, so they never occlude and never count as blockers.
+    auto gather = [&](int g, float srad, float trad) -> vfloat4 {
+        vfloat4 ss = s + srad * vfloat4(shadow_kernel_s + 4 * g);
+        vfloat4 tt = t + trad * vfloat4(shadow_kernel_t + 4 * g);
+        vint4 x    = ifloor(ss * smul + round) + xbegin;
+        vint4 y    = ifloor(tt * tmul + round) + ybegin;
+        vbool4 valid = (x >= xbegin) & (x < xend) & (y >= ybegin)
+                       & (y < yend);
+        alignas(16) float z[4];
+        for (int i = 0; i < 4; ++i) {
+            z[i] = std::numeric_limits<float>::max();
+            if (!valid[i])
+                continue;
+            int tile_s = (x[i] - spec.x) % spec.tile_width;
+            int tile_t = (y[i] - spec.y) % spec.tile_height;
+            int tx = x[i] - tile_s, ty = y[i] - tile_t;
+            if (!tile || tx != tilex || ty != tiley) {
+                id.xy(tx, ty);
+                bool found = find_tile(id, thread_info, !tile);
+                tile       = thread_info->tile.get();
+                if (!found || !tile) {
+                    if (!found)
+                        error("{}", m_imagecache->geterror());
+                    ok   = false;
+                    tile = nullptr;
+                    continue;
+                }
+                tilex = tx;
+                tiley = ty;
+            }
+            size_t offset = id.nchannels() * tile->pixel_index(tile_s, tile_t)
+                            + choffset;
+            z[i] = tile_depth(pixeltype, tile, offset);
+        }
+        stats.shadow_taps += 4;
+        return vfloat4(z);
+    };
+
+    vfloat4 receiver(depth - options.bias);
+    if (options.sblur > 0.0f || options.tblur > 0.0f) {
+        // Blocker search over the light's extent.
+        ++stats.shadow_blocker_searches;
+        float srad = std::max(options.sblur, sradius);
+        float trad = std::max(options.tblur, tradius);
+        vfloat4 zsum = vfloat4::Zero(), nblockers = vfloat4::Zero();
+        for (int g = 0; g < ngroups; ++g) {
+            vfloat4 z      = gather(g, srad, trad);
+            vbool4 blocker = z < receiver;
+            zsum += blend0(z, blocker);
+            nblockers += blend0(vfloat4::One(), blocker);
+        }
+        float n = reduce_add(nblockers);
+        if (n == 0.0f || n == float(ntaps)) {
+            // Nothing between us and the light, or everything is.
+            occlusion = n == 0.0f ? 0.0f : 1.0f;
+            return ok;
+        }
+        float zblocker = reduce_add(zsum) / n;
+        if (zblocker > 0.0f) {
+            // Similar triangles: the penumbra grows with the distance
+            // from the blocker to the receiver.
+            float penumbra = (receiver[0] - zblocker) / zblocker;
+            sradius        = std::max(sradius, options.sblur * penumbra);
+            tradius        = std::max(tradius, options.tblur * penumbra);
+        }
+    }
+
+    vfloat4 occluded = vfloat4::Zero();
+    for (int g = 0; g < ngroups; ++g)
+        occluded += blend0(vfloat4::One(), gather(g, sradius, tradius)
+                                               < receiver);
+    occlusion = reduce_add(occluded) * (1.0f / float(ntaps));
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::shadow_lookup(TextureFile& texturefile,
+                                 PerThreadInfo* thread_info,
+                                 TextureOpt& options, const Imath::V3f& P,
+                                 const Imath::V3f& dPdx,
+                                 const Imath::V3f& dPdy, float& occlusion)
+{
+    const auto& si(texturefile.subimageinfo(options.subimage));
+    float s, t, depth;
+    if (!shadow_project(si, P, s, t, depth)) {
+        // Behind the light -- it can't be shadowed by anything in the map.
+        occlusion = 0.0f;
+        return true;
+    }
+
+    // The kernel radius comes from the projected derivatives, but is
+    // never less than a texel so that the taps straddle texel boundaries
+    // and shadow edges come out smooth.
+    const ImageSpec& spec(texturefile.spec(options.subimage, 0));
+    float sradius = 0.0f, tradius = 0.0f;
+    float sx, tx, sy, ty, d;
+    if (shadow_project(si, P + dPdx, sx, tx, d)
+        && shadow_project(si, P + dPdy, sy, ty, d)) {
+        sradius = 0.5f * options.swidth
+                  * std::max(fabsf(sx - s), fabsf(sy - s));
+        tradius = 0.5f * options.twidth
+                  * std::max(fabsf(tx - t), fabsf(ty - t));
+    }
+    sradius = std::max(sradius, 1.0f / float(spec.width));
+    tradius = std::max(tradius, 1.0f / float(spec.height));
+    return shadow_pcf(texturefile, thread_info, options, s, t, depth, sradius,
+                      tradius, occlusion);
+}
+
+
+
+bool
+TextureSystemImpl::shadow(ustring filename, TextureOpt& options,
+                          const Imath::V3f& P, const Imath::V3f& dPdx,
+                          const Imath::V3f& dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    PerThreadInfo* thread_info = m_imagecache->get_perthread_info();
+    TextureFile* texturefile   = find_texturefile(filename, thread_info);
+    return shadow((TextureHandle*)texturefile, (Perthread*)thread_info,
+                  options, P, dPdx, dPdy, result, dresultds, dresultdt);
+}
+
+
+
+bool
+TextureSystemImpl::shadow(TextureHandle* texture_handle_,
+                          Perthread* thread_info_, TextureOpt& options,
+                          const Imath::V3f& P, const Imath::V3f& dPdx,
+                          const Imath::V3f& dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info_,
+                         texture_handle_, options.site, 1);
+
+    PerThreadInfo* thread_info = m_imagecache->get_perthread_info(
+        (PerThreadInfo*)thread_info_);
+    TextureFile* texturefile = verify_texturefile((TextureFile*)texture_handle_,
+                                                  thread_info);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.shadow_batches;
+    ++stats.shadow_queries;
+
+    if (!shadow_setup(texturefile, options))
+        return missing_texture(options, 1, result, dresultds, dresultdt);
+
+    bool ok = shadow_lookup(*texturefile, thread_info, options, P, dPdx, dPdy,
+                            result[0]);
+    if (dresultds) {
+        // PCF results are piecewise constant; no useful derivatives.
+        dresultds[0] = 0.0f;
+        dresultdt[0] = 0.0f;
+    }
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::shadow(TextureHandle* texture_handle,
+                          Perthread* thread_info_, TextureOptBatch& options,
+                          Tex::RunMask mask, const float* P,
+                          const float* dPdx, const float* dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info_,
+                         texture_handle, options.site, lane_count(mask));
+
+    PerThreadInfo* thread_info = m_imagecache->get_perthread_info(
+        (PerThreadInfo*)thread_info_);
+    TextureFile* texturefile = verify_texturefile((TextureFile*)texture_handle,
+                                                  thread_info);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.shadow_batches;
+    stats.shadow_queries += lane_count(mask);
+
+    TextureOpt opt;
+    opt.firstchannel = options.firstchannel;
+    opt.subimage     = options.subimage;
+    opt.subimagename = options.subimagename;
+    opt.fill         = options.fill;
+    opt.missingcolor = options.missingcolor;
+    opt.bias         = options.bias;
+    opt.samples      = options.samples;
+
+    // Validate the map once for the whole batch; only the footprints
+    // differ from lane to lane.
+    bool valid       = shadow_setup(texturefile, opt);
+    bool ok          = true;
+    Tex::RunMask bit = 1;
+    for (int i = 0; i < Tex::BatchWidth; ++i, bit <<= 1) {
+        if (!(mask & bit))
+            continue;
+        float r = 0.0f;
+        if (valid) {
+            opt.sblur  = options.sblur[i];
+            opt.tblur  = options.tblur[i];
+            opt.swidth = options.swidth[i];
+            opt.twidth = options.twidth[i];
+            Imath::V3f P_(P[i], P[i + Tex::BatchWidth],
+                          P[i + 2 * Tex::BatchWidth]);
+            Imath::V3f dPdx_(dPdx[i], dPdx[i + Tex::BatchWidth],
+                             dPdx[i + 2 * Tex::BatchWidth]);
+            Imath::V3f dPdy_(dPdy[i], dPdy[i + Tex::BatchWidth],
+                             dPdy[i + 2 * Tex::BatchWidth]);
+            ok &= shadow_lookup(*texturefile, thread_info, opt, P_, dPdx_,
+                                dPdy_, r);
+        } else {
+            ok &= missing_texture(opt, 1, &r, nullptr, nullptr);
+        }
+        result[i] = r;
+        if (dresultds) {
+            dresultds[i] = 0.0f;
+            dresultdt[i] = 0.0f;
+        }
+    }
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::shadow(ustring filename, TextureOptBatch& options,
+                          Tex::RunMask mask, const float* P,
+                          const float* dPdx, const float* dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    Perthread* thread_info        = get_perthread_info();
+    TextureHandle* texture_handle = get_texture_handle(filename, thread_info);
+    return shadow(texture_handle, thread_info, options, mask, P, dPdx, dPdy,
+                  result, dresultds, dresultdt);
+}
+
+
+
+bool
+TextureSystemImpl::shadow(ustring filename, TextureOptions& options,
+                          Runflag* runflags, int beginactive, int endactive,
+                          VaryingRef<Imath::V3f> P,
+                          VaryingRef<Imath::V3f> dPdx,
+                          VaryingRef<Imath::V3f> dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    Perthread* thread_info        = get_perthread_info();
+    TextureHandle* texture_handle = get_texture_handle(filename, thread_info);
+    return shadow(texture_handle, thread_info, options, runflags, beginactive,
+                  endactive, P, dPdx, dPdy, result, dresultds, dresultdt);
+}
+
+
+
+bool
+TextureSystemImpl::shadow(TextureHandle* texture_handle,
+                          Perthread* thread_info, TextureOptions& options,
+                          Runflag* runflags, int beginactive, int endactive,
+                          VaryingRef<Imath::V3f> P,
+                          VaryingRef<Imath::V3f> dPdx,
+                          VaryingRef<Imath::V3f> dPdy, float* result,
+                          float* dresultds, float* dresultdt)
+{
+    if (!texture_handle)
+        return false;
+    bool ok = true;
+    for (int i = beginactive; i < endactive; ++i) {
+        if (runflags[i]) {
+            TextureOpt opt(options, i);
+            ok &= shadow(texture_handle, thread_info, opt, P[i], dPdx[i],
+                         dPdy[i], result + i, dresultds ? dresultds + i : NULL,
+                         dresultdt ? dresultdt + i : NULL);
+        }
+    }
+    return ok;
+}
+
+
+}  // end namespace pvt
+
+OIIO_NAMESPACE_END
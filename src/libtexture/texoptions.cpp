@@ -117,6 +117,7 @@ TextureOpt::TextureOpt(const TextureOptions& opt, int index)
     , rwrap((Wrap)opt.rwrap)
     , rblur(opt.rblur[index])
     , rwidth(opt.rwidth[index])
+    , roughness(0.0f)
     , envlayout(0)
 {
 }
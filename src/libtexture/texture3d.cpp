@@ -8,6 +8,7 @@
 #include <sstream>
 #include <string>
 
+#include <OpenImageIO/Imath.h>
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imagecache.h>
@@ -23,6 +24,7 @@
 
 OIIO_NAMESPACE_BEGIN
 using namespace pvt;
+using namespace simd;
 
 namespace {  // anonymous
 
@@ -75,6 +77,9 @@ TextureSystemImpl::texture3d(TextureHandle* texture_handle_,
                              int nchannels, float* result, float* dresultds,
                              float* dresultdt, float* dresultdr)
 {
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info_,
+                         texture_handle_, options.site, 1);
+
     // Handle >4 channel lookups by recursion.
     if (nchannels > 4) {
         int save_firstchannel = options.firstchannel;
@@ -109,6 +114,7 @@ TextureSystemImpl::texture3d(TextureHandle* texture_handle_,
         &TextureSystemImpl::texture3d_lookup_trilinear_mipmap,
         &TextureSystemImpl::texture3d_lookup,
         &TextureSystemImpl::texture3d_lookup_trilinear_mipmap,
+        &TextureSystemImpl::texture3d_lookup,
         &TextureSystemImpl::texture3d_lookup
     };
     texture3d_lookup_prototype lookup = lookup_functions[(int)options.mipmode];
@@ -283,6 +289,7 @@ TextureSystemImpl::texture3d_lookup_nomip(
         &TextureSystemImpl::accum3d_sample_bilinear,
         &TextureSystemImpl::accum3d_sample_bilinear,  // FIXME: bicubic,
         &TextureSystemImpl::accum3d_sample_bilinear,
+        &TextureSystemImpl::accum3d_sample_bilinear,  // FIXME: stochastic
     };
     accum3d_prototype accumer = accum_functions[(int)options.interpmode];
     bool ok = (this->*accumer)(P, 0, texturefile, thread_info, options,
@@ -298,6 +305,7 @@ TextureSystemImpl::texture3d_lookup_nomip(
     case TextureOpt::InterpBilinear: ++stats.bilinear_interps; break;
     case TextureOpt::InterpBicubic: ++stats.cubic_interps; break;
     case TextureOpt::InterpSmartBicubic: ++stats.bilinear_interps; break;
+    case TextureOpt::InterpStochasticBilinear: ++stats.bilinear_interps; break;
     }
     return ok;
 }
@@ -800,6 +808,254 @@ TextureSystemImpl::accum3d_sample_bilinear(
 
 
 
+bool
+TextureSystemImpl::accum3d_sample_bilinear_batch(
+    const Tex::FloatWide& Px, const Tex::FloatWide& Py,
+    const Tex::FloatWide& Pz, int miplevel, Tex::RunMask lanes,
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    int nchannels_result, int actualchannels, simd::vfloat4* accum,
+    simd::vfloat4* daccumds, simd::vfloat4* daccumdt, simd::vfloat4* daccumdr)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+    typedef simd::VecType<bool, Tex::BatchWidth>::type BoolWide;
+
+    const ImageSpec& spec(texturefile.spec(options.subimage, miplevel));
+    TypeDesc::BASETYPE pixeltype = texturefile.pixeltype(options.subimage);
+    size_t channelsize           = texturefile.channelsize(options.subimage);
+    int tile_chbegin = 0, tile_chend = spec.nchannels;
+    if (spec.nchannels > m_max_tile_channels) {
+        // For files with many channels, narrow the range we cache
+        tile_chbegin = options.firstchannel;
+        tile_chend   = options.firstchannel + actualchannels;
+    }
+
+    // Remap P to texel coords for all lanes at once, subtracting 0.5
+    // because samples are at texel centers.
+    FloatWide s = Px * float(spec.full_width) + (spec.full_x - 0.5f);
+    FloatWide t = Py * float(spec.full_height) + (spec.full_y - 0.5f);
+    FloatWide r = Pz * float(spec.full_depth) + (spec.full_z - 0.5f);
+    IntWide sint, tint, rint;
+    FloatWide sfrac = floorfrac(s, &sint);
+    FloatWide tfrac = floorfrac(t, &tint);
+    FloatWide rfrac = floorfrac(r, &rint);
+
+    // Lanes whose whole 2x2x2 footprint is inside the data window (where
+    // every wrap mode is the identity) and on a single tile take the
+    // gather below.
+    int slimit = spec.x + spec.width - 1;
+    int tlimit = spec.y + spec.height - 1;
+    int rlimit = spec.z + spec.depth - 1;
+    if (options.swrap == TextureOpt::WrapPeriodicSharedBorder)
+        --slimit;
+    if (options.twrap == TextureOpt::WrapPeriodicSharedBorder)
+        --tlimit;
+    if (options.rwrap == TextureOpt::WrapPeriodicSharedBorder)
+        --rlimit;
+    IntWide tile_s = (sint - spec.x) % spec.tile_width;
+    IntWide tile_t = (tint - spec.y) % spec.tile_height;
+    IntWide tile_r = (rint - spec.z) % spec.tile_depth;
+    BoolWide inside = (sint >= spec.x) & (sint < slimit) & (tint >= spec.y)
+                      & (tint < tlimit) & (rint >= spec.z) & (rint < rlimit)
+                      & (tile_s != spec.tile_width - 1)
+                      & (tile_t != spec.tile_height - 1)
+                      & (tile_r != spec.tile_depth - 1);
+    IntWide tilex = sint - tile_s, tiley = tint - tile_t, tilez = rint - tile_r;
+
+    // Trilinear weights for all lanes.
+    FloatWide sfrac1 = 1.0f - sfrac, tfrac1 = 1.0f - tfrac;
+    FloatWide rfrac1 = 1.0f - rfrac;
+    FloatWide w00 = tfrac1 * rfrac1, w01 = tfrac * rfrac1;
+    FloatWide w10 = tfrac1 * rfrac, w11 = tfrac * rfrac;
+    FloatWide w000 = sfrac1 * w00, w001 = sfrac * w00;
+    FloatWide w010 = sfrac1 * w01, w011 = sfrac * w01;
+    FloatWide w100 = sfrac1 * w10, w101 = sfrac * w10;
+    FloatWide w110 = sfrac1 * w11, w111 = sfrac * w11;
+
+    vfloat4 fill(0.0f);
+    for (int c = actualchannels; c < nchannels_result; ++c)
+        fill[c] = options.fill;
+    vfloat4 chanmask(0.0f);
+    for (int c = 0; c < actualchannels; ++c)
+        chanmask[c] = 1.0f;
+
+    Tex::RunMask fastlanes = lanes & Tex::RunMask(inside.bitmask());
+    TileID id(texturefile, options.subimage, miplevel, 0, 0, 0, tile_chbegin,
+              tile_chend);
+    int startchan_in_tile = options.firstchannel - id.chbegin();
+    while (fastlanes) {
+        int first          = first_lane(fastlanes);
+        Tex::RunMask group = fastlanes
+                             & Tex::RunMask(((tilex == tilex[first])
+                                             & (tiley == tiley[first])
+                                             & (tilez == tilez[first]))
+                                                .bitmask());
+        fastlanes &= ~group;
+        id.xyz(tilex[first], tiley[first], tilez[first]);
+        bool ok = find_tile(id, thread_info, true);
+        if (!ok)
+            error("{}", m_imagecache->geterror());
+        TileRef& tile(thread_info->tile);
+        if (!tile->valid())
+            return false;
+        size_t pixelsize   = tile->pixelsize();
+        size_t rowstride   = pixelsize * spec.tile_width;
+        size_t planestride = rowstride * spec.tile_height;
+        for (int i = first; i < Tex::BatchWidth; ++i) {
+            if (!((group >> i) & 1))
+                continue;
+            imagesize_t tilepel = (tile_r[i] * spec.tile_height
+                                   + imagesize_t(tile_t[i]))
+                                      * spec.tile_width
+                                  + tile_s[i];
+            const unsigned char* b = tile->bytedata() + pixelsize * tilepel
+                                     + channelsize * startchan_in_tile;
+            vfloat4 t000 = texel_to_float4(pixeltype, b);
+            vfloat4 t001 = texel_to_float4(pixeltype, b + pixelsize);
+            vfloat4 t010 = texel_to_float4(pixeltype, b + rowstride);
+            vfloat4 t011 = texel_to_float4(pixeltype,
+                                           b + rowstride + pixelsize);
+            b += planestride;
+            vfloat4 t100 = texel_to_float4(pixeltype, b);
+            vfloat4 t101 = texel_to_float4(pixeltype, b + pixelsize);
+            vfloat4 t110 = texel_to_float4(pixeltype, b + rowstride);
+            vfloat4 t111 = texel_to_float4(pixeltype,
+                                           b + rowstride + pixelsize);
+            vfloat4 v = w000[i] * t000 + w001[i] * t001 + w010[i] * t010
+                        + w011[i] * t011 + w100[i] * t100 + w101[i] * t101
+                        + w110[i] * t110 + w111[i] * t111;
+            accum[i] += chanmask * v + fill;
+            if (daccumds) {
+                float sf = sfrac[i], tf = tfrac[i], rf = rfrac[i];
+                vfloat4 ds = bilerp(t001 - t000, t011 - t010, t101 - t100,
+                                    t111 - t110, tf, rf);
+                vfloat4 dt = bilerp(t010 - t000, t011 - t001, t110 - t100,
+                                    t111 - t101, sf, rf);
+                vfloat4 dr = bilerp(t010 - t110, t011 - t111, t001 - t100,
+                                    t011 - t111, sf, tf);
+                daccumds[i] += chanmask * ds * float(spec.full_width);
+                daccumdt[i] += chanmask * dt * float(spec.full_height);
+                daccumdr[i] += chanmask * dr * float(spec.full_depth);
+            }
+        }
+    }
+
+    // Lanes near the edges or straddling tiles take the general path.
+    Tex::RunMask slowlanes = lanes & ~Tex::RunMask(inside.bitmask());
+    bool ok                = true;
+    for (; slowlanes; slowlanes &= slowlanes - 1) {
+        int i = first_lane(slowlanes);
+        ok &= accum3d_sample_bilinear(
+            Imath::V3f(Px[i], Py[i], Pz[i]), miplevel, texturefile,
+            thread_info, options, nchannels_result, actualchannels, 1.0f,
+            (float*)&accum[i], daccumds ? (float*)&daccumds[i] : nullptr,
+            daccumds ? (float*)&daccumdt[i] : nullptr,
+            daccumds ? (float*)&daccumdr[i] : nullptr);
+    }
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::texture3d_batch_bilinear(
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    Tex::RunMask mask, const float* P, int nchannels, float* result,
+    float* dresultds, float* dresultdt, float* dresultdr)
+{
+    using Tex::FloatWide;
+
+    int nlanes = lane_count(mask);
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.texture3d_batches;
+    stats.texture3d_queries += nlanes;
+
+    const ImageSpec& spec(texturefile.spec(options.subimage, 0));
+
+    // Figure out the wrap functions
+    if (options.swrap == TextureOpt::WrapDefault)
+        options.swrap = (TextureOpt::Wrap)texturefile.swrap();
+    if (options.swrap == TextureOpt::WrapPeriodic && ispow2(spec.width))
+        options.swrap = TextureOpt::WrapPeriodicPow2;
+    if (options.twrap == TextureOpt::WrapDefault)
+        options.twrap = (TextureOpt::Wrap)texturefile.twrap();
+    if (options.twrap == TextureOpt::WrapPeriodic && ispow2(spec.height))
+        options.twrap = TextureOpt::WrapPeriodicPow2;
+    if (options.rwrap == TextureOpt::WrapDefault)
+        options.rwrap = (TextureOpt::Wrap)texturefile.rwrap();
+    if (options.rwrap == TextureOpt::WrapPeriodic && ispow2(spec.depth))
+        options.rwrap = TextureOpt::WrapPeriodicPow2;
+
+    int actualchannels = OIIO::clamp(spec.nchannels - options.firstchannel, 0,
+                                     nchannels);
+
+    // Do the volume lookup in local space, transforming all the lanes at
+    // once (the same math as M44f::multVecMatrix).
+    FloatWide Px(P), Py(P + Tex::BatchWidth), Pz(P + 2 * Tex::BatchWidth);
+    const auto& si(texturefile.subimageinfo(options.subimage));
+    if (si.Mlocal) {
+        const Imath::M44f& M(*si.Mlocal);
+        FloatWide x = Px * M[0][0] + Py * M[1][0] + Pz * M[2][0] + M[3][0];
+        FloatWide y = Px * M[0][1] + Py * M[1][1] + Pz * M[2][1] + M[3][1];
+        FloatWide z = Px * M[0][2] + Py * M[1][2] + Pz * M[2][2] + M[3][2];
+        FloatWide w = Px * M[0][3] + Py * M[1][3] + Pz * M[2][3] + M[3][3];
+        Px          = x / w;
+        Py          = y / w;
+        Pz          = z / w;
+    }
+
+    bool derivs = (dresultds && dresultdt && dresultdr);
+    vfloat4 accum[Tex::BatchWidth], daccumds[Tex::BatchWidth];
+    vfloat4 daccumdt[Tex::BatchWidth], daccumdr[Tex::BatchWidth];
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        accum[i].clear();
+        daccumds[i].clear();
+        daccumdt[i].clear();
+        daccumdr[i].clear();
+    }
+    bool ok = accum3d_sample_bilinear_batch(Px, Py, Pz, 0, mask, texturefile,
+                                            thread_info, options, nchannels,
+                                            actualchannels, accum,
+                                            derivs ? daccumds : nullptr,
+                                            derivs ? daccumdt : nullptr,
+                                            derivs ? daccumdr : nullptr);
+
+    // Update stats
+    stats.aniso_queries += nlanes;
+    stats.aniso_probes += nlanes;
+    if (options.interpmode == TextureOpt::InterpBicubic)
+        stats.cubic_interps += nlanes;
+    else
+        stats.bilinear_interps += nlanes;
+
+    bool gray_fill = (actualchannels < nchannels && options.firstchannel == 0
+                      && m_gray_to_rgb);
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        if (!((mask >> i) & 1))
+            continue;
+        if (gray_fill)
+            fill_gray_channels(spec, nchannels, (float*)&accum[i],
+                               derivs ? (float*)&daccumds[i] : nullptr,
+                               derivs ? (float*)&daccumdt[i] : nullptr,
+                               derivs ? (float*)&daccumdr[i] : nullptr);
+        for (int c = 0; c < nchannels; ++c)
+            result[c * Tex::BatchWidth + i] = accum[i][c];
+        // As for single points, the derivs stay zero unless the caller
+        // asked for all three of them.
+        for (int c = 0; c < nchannels; ++c) {
+            if (dresultds)
+                dresultds[c * Tex::BatchWidth + i] = daccumds[i][c];
+            if (dresultdt)
+                dresultdt[c * Tex::BatchWidth + i] = daccumdt[i][c];
+            if (dresultdr)
+                dresultdr[c * Tex::BatchWidth + i] = daccumdr[i][c];
+        }
+    }
+    return ok;
+}
+
+
+
 bool
 TextureSystemImpl::texture3d(TextureHandle* texture_handle,
                              Perthread* thread_info, TextureOptBatch& options,
@@ -809,7 +1065,9 @@ TextureSystemImpl::texture3d(TextureHandle* texture_handle,
                              float* dresultds, float* dresultdt,
                              float* dresultdr)
 {
-    // (FIXME) CHEAT! Texture points individually
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info,
+                         texture_handle, options.site, lane_count(mask));
+
     TextureOpt opt;
     opt.firstchannel        = options.firstchannel;
     opt.subimage            = options.subimage;
@@ -824,6 +1082,30 @@ TextureSystemImpl::texture3d(TextureHandle* texture_handle,
     opt.missingcolor        = options.missingcolor;
     opt.rwrap               = (TextureOpt::Wrap)options.rwrap;
 
+    // Volume lookups don't filter, so everything but closest-point
+    // interpolation of up to 4 channels has a real wide implementation.
+    // The rest (and missing textures) texture the points one by one.
+    TextureFile* texturefile = (TextureFile*)texture_handle;
+    if (opt.interpmode != TextureOpt::InterpClosest && nchannels <= 4
+        && texturefile) {
+        PerThreadInfo* ptinfo = m_imagecache->get_perthread_info(
+            (PerThreadInfo*)thread_info);
+        texturefile = verify_texturefile(texturefile, ptinfo);
+        if (texturefile && !texturefile->broken()) {
+            if (!opt.subimagename.empty())
+                opt.subimage = m_imagecache->subimage_from_name(
+                    texturefile, opt.subimagename);
+            if (opt.subimage >= 0 && opt.subimage < texturefile->subimages()) {
+                opt.subimagename.clear();
+                return texture3d_batch_bilinear(*texturefile, ptinfo, opt,
+                                                mask, P, nchannels, result,
+                                                dresultds, dresultdt,
+                                                dresultdr);
+            }
+            opt.subimage = options.subimage;
+        }
+    }
+
     bool ok          = true;
     Tex::RunMask bit = 1;
     for (int i = 0; i < Tex::BatchWidth; ++i, bit <<= 1) {
@@ -166,6 +166,9 @@ public:
                          VaryingRef<float> dtdx, VaryingRef<float> dsdy,
                          VaryingRef<float> dtdy, int nchannels, float* result,
                          float* dresultds = NULL, float* dresultdt = NULL);
+    virtual bool texture_deferred(Perthread* thread_info, TextureOpt& options,
+                                  cspan<TextureRequest> requests,
+                                  int nchannels);
 
     virtual bool texture3d(ustring filename, TextureOpt& options,
                            const Imath::V3f& P, const Imath::V3f& dPdx,
@@ -211,57 +214,35 @@ public:
                            float* result, float* dresultds = NULL,
                            float* dresultdt = NULL, float* dresultdr = NULL);
 
-    virtual bool shadow(ustring /*filename*/, TextureOpt& /*options*/,
-                        const Imath::V3f& /*P*/, const Imath::V3f& /*dPdx*/,
-                        const Imath::V3f& /*dPdy*/, float* /*result*/,
-                        float* /*dresultds*/, float* /*dresultdt*/)
-    {
-        return false;
-    }
-    virtual bool shadow(TextureHandle* /*texture_handle*/,
-                        Perthread* /*thread_info*/, TextureOpt& /*options*/,
-                        const Imath::V3f& /*P*/, const Imath::V3f& /*dPdx*/,
-                        const Imath::V3f& /*dPdy*/, float* /*result*/,
-                        float* /*dresultds*/, float* /*dresultdt*/)
-    {
-        return false;
-    }
-    virtual bool shadow(ustring /*filename*/, TextureOptBatch& /*options*/,
-                        Tex::RunMask /*mask*/, const float* /*P*/,
-                        const float* /*dPdx*/, const float* /*dPdy*/,
-                        float* /*result*/, float* /*dresultds*/,
-                        float* /*dresultdt*/)
-    {
-        return false;
-    }
-    virtual bool shadow(TextureHandle* /*texture_handle*/,
-                        Perthread* /*thread_info*/,
-                        TextureOptBatch& /*options*/, Tex::RunMask /*mask*/,
-                        const float* /*P*/, const float* /*dPdx*/,
-                        const float* /*dPdy*/, float* /*result*/,
-                        float* /*dresultds*/, float* /*dresultdt*/)
-    {
-        return false;
-    }
-    virtual bool shadow(ustring /*filename*/, TextureOptions& /*options*/,
-                        Runflag* /*runflags*/, int /*beginactive*/,
-                        int /*endactive*/, VaryingRef<Imath::V3f> /*P*/,
-                        VaryingRef<Imath::V3f> /*dPdx*/,
-                        VaryingRef<Imath::V3f> /*dPdy*/, float* /*result*/,
-                        float* /*dresultds*/, float* /*dresultdt*/)
-    {
-        return false;
-    }
-    virtual bool shadow(TextureHandle* /*texture_handle*/,
-                        Perthread* /*thread_info*/, TextureOptions& /*options*/,
-                        Runflag* /*runflags*/, int /*beginactive*/,
-                        int /*endactive*/, VaryingRef<Imath::V3f> /*P*/,
-                        VaryingRef<Imath::V3f> /*dPdx*/,
-                        VaryingRef<Imath::V3f> /*dPdy*/, float* /*result*/,
-                        float* /*dresultds*/, float* /*dresultdt*/)
-    {
-        return false;
-    }
+    virtual bool shadow(ustring filename, TextureOpt& options,
+                        const Imath::V3f& P, const Imath::V3f& dPdx,
+                        const Imath::V3f& dPdy, float* result,
+                        float* dresultds = NULL, float* dresultdt = NULL);
+    virtual bool shadow(TextureHandle* texture_handle, Perthread* thread_info,
+                        TextureOpt& options, const Imath::V3f& P,
+                        const Imath::V3f& dPdx, const Imath::V3f& dPdy,
+                        float* result, float* dresultds = NULL,
+                        float* dresultdt = NULL);
+    virtual bool shadow(ustring filename, TextureOptBatch& options,
+                        Tex::RunMask mask, const float* P, const float* dPdx,
+                        const float* dPdy, float* result,
+                        float* dresultds = NULL, float* dresultdt = NULL);
+    virtual bool shadow(TextureHandle* texture_handle, Perthread* thread_info,
+                        TextureOptBatch& options, Tex::RunMask mask,
+                        const float* P, const float* dPdx, const float* dPdy,
+                        float* result, float* dresultds = NULL,
+                        float* dresultdt = NULL);
+    virtual bool shadow(ustring filename, TextureOptions& options,
+                        Runflag* runflags, int beginactive, int endactive,
+                        VaryingRef<Imath::V3f> P, VaryingRef<Imath::V3f> dPdx,
+                        VaryingRef<Imath::V3f> dPdy, float* result,
+                        float* dresultds = NULL, float* dresultdt = NULL);
+    virtual bool shadow(TextureHandle* texture_handle, Perthread* thread_info,
+                        TextureOptions& options, Runflag* runflags,
+                        int beginactive, int endactive,
+                        VaryingRef<Imath::V3f> P, VaryingRef<Imath::V3f> dPdx,
+                        VaryingRef<Imath::V3f> dPdy, float* result,
+                        float* dresultds = NULL, float* dresultdt = NULL);
 
 
     virtual bool environment(ustring filename, TextureOpt& options,
@@ -337,6 +318,9 @@ public:
     virtual bool is_udim(ustring filename);
     virtual bool is_udim(TextureHandle* udimfile);
     virtual TextureHandle* resolve_udim(ustring filename, float s, float t);
+    virtual void resolve_udim(TextureHandle* udimfile, Perthread* thread_info,
+                              Tex::RunMask mask, const float* s,
+                              const float* t, TextureHandle** handles);
     virtual TextureHandle* resolve_udim(TextureHandle* udimfile,
                                         Perthread* thread_info, float s,
                                         float t);
@@ -350,6 +334,7 @@ public:
     virtual bool has_error() const;
     virtual std::string geterror(bool clear = true) const;
     virtual std::string getstats(int level = 1, bool icstats = true) const;
+    virtual std::string lookup_stats_json() const;
     virtual void reset_stats();
 
     virtual void invalidate(ustring filename, bool force);
@@ -440,6 +425,116 @@ private:
         float _dsdx, float _dtdx, float _dsdy, float _dtdy, float* result,
         float* dresultds, float* resultdt);
 
+    /// Elliptically weighted average: Gaussian-weighted sum of every
+    /// texel under the filter ellipse, in a single MIP level.
+    bool texture_lookup_ewa(TextureFile& texfile, PerThreadInfo* thread_info,
+                            TextureOpt& options, int nchannels_result,
+                            int actualchannels, float _s, float _t,
+                            float _dsdx, float _dtdx, float _dsdy,
+                            float _dtdy, float* result, float* dresultds,
+                            float* resultdt);
+
+    /// Resolve the subimage for a shadow lookup and make sure the map
+    /// carries the projection needed to use it. Return false (having
+    /// issued any error) if the lookup should be treated as missing.
+    bool shadow_setup(TextureFile* texturefile, TextureOpt& options);
+
+    /// Shadow lookup of a single common-space position against subimage
+    /// options.subimage (already validated by shadow_setup), storing the
+    /// occluded fraction in `occlusion`.
+    bool shadow_lookup(TextureFile& texturefile, PerThreadInfo* thread_info,
+                       TextureOpt& options, const Imath::V3f& P,
+                       const Imath::V3f& dPdx, const Imath::V3f& dPdy,
+                       float& occlusion);
+
+    /// Percentage-closer filter MIP level 0 of a shadow map around (s,t)
+    /// with kernel radii (sradius,tradius) in st space, comparing against
+    /// receiver depth `depth`. Nonzero sblur/tblur in `options` first run
+    /// a blocker search that sets the penumbra width.
+    bool shadow_pcf(TextureFile& texturefile, PerThreadInfo* thread_info,
+                    const TextureOpt& options, float s, float t, float depth,
+                    float sradius, float tradius, float& occlusion);
+
+    /// Wide version of the batched 2D lookup for the bilinear interp and
+    /// NoMIP/OneLevel/Trilinear MIP modes. The MIP level selection, filter
+    /// widths and bilinear weights are computed for all lanes at once;
+    /// results are in the same channel-major layout as the batched
+    /// texture() call.
+    bool texture_batch_bilinear(TextureFile& texturefile,
+                                PerThreadInfo* thread_info,
+                                TextureOpt& options,
+                                const TextureOptBatch& batchopt,
+                                Tex::RunMask mask, const float* s,
+                                const float* t, const float* dsdx,
+                                const float* dtdx, const float* dsdy,
+                                const float* dtdy, int nchannels,
+                                float* result, float* dresultds,
+                                float* dresultdt);
+
+    /// Bilinearly sample MIP level `miplevel` at the lanes of `lanes`,
+    /// adding weight[i] times the sample into accum[i] (and daccumds[i],
+    /// daccumdt[i] if non-NULL). Lanes whose 2x2 footprint is inside the
+    /// data window and on a single tile are gathered one tile at a time;
+    /// the rest go through sample_bilinear individually.
+    bool sample_bilinear_batch(int miplevel, Tex::RunMask lanes,
+                               const Tex::FloatWide& s,
+                               const Tex::FloatWide& t,
+                               const Tex::FloatWide& weight,
+                               TextureFile& texturefile,
+                               PerThreadInfo* thread_info, TextureOpt& options,
+                               int nchannels_result, int actualchannels,
+                               simd::vfloat4* accum, simd::vfloat4* daccumds,
+                               simd::vfloat4* daccumdt);
+
+    /// Choose the MIP levels to blend for every lane at once, by the same
+    /// rules as the single-point lookups: each lane will blend
+    ///    data(level0) * (1-levelblend) + data(level1) * levelblend
+    /// `filtwidth` is the filter width in st space, or in radians if
+    /// `latlong` is true.
+    void compute_miplevels_batch(TextureFile& texturefile,
+                                 const TextureOpt& options,
+                                 const Tex::FloatWide& filtwidth, bool latlong,
+                                 Tex::IntWide& level0, Tex::IntWide& level1,
+                                 Tex::FloatWide& levelblend);
+
+    /// Bilinearly sample the two MIP levels chosen by
+    /// compute_miplevels_batch for the lanes of `mask`, one MIP level at a
+    /// time, accumulating into accum[i] (and the derivs if non-NULL).
+    /// Returns the number of probes made in `npointson`.
+    bool sample_bilinear_mipmap_batch(
+        Tex::RunMask mask, const Tex::IntWide& level0,
+        const Tex::IntWide& level1, const Tex::FloatWide& levelblend,
+        const Tex::FloatWide& s, const Tex::FloatWide& t,
+        TextureFile& texturefile, PerThreadInfo* thread_info,
+        TextureOpt& options, int nchannels_result, int actualchannels,
+        simd::vfloat4* accum, simd::vfloat4* daccumds,
+        simd::vfloat4* daccumdt, int& npointson);
+
+    /// Wide versions of the batched texture3d() and environment() lookups,
+    /// for the cases they can handle (see the batched entry points).
+    bool texture3d_batch_bilinear(TextureFile& texturefile,
+                                  PerThreadInfo* thread_info,
+                                  TextureOpt& options, Tex::RunMask mask,
+                                  const float* P, int nchannels, float* result,
+                                  float* dresultds, float* dresultdt,
+                                  float* dresultdr);
+    bool environment_batch_bilinear(TextureFile& texturefile,
+                                    PerThreadInfo* thread_info,
+                                    TextureOpt& options,
+                                    const TextureOptBatch& batchopt,
+                                    Tex::RunMask mask, const float* R,
+                                    const float* dRdx, const float* dRdy,
+                                    int nchannels, float* result,
+                                    float* dresultds, float* dresultdt);
+
+    /// Add `weight` times the reflection lobe of `options.roughness` at
+    /// latlong coordinates (s,t), from the prefiltered lobes file made by
+    /// maketx for an environment map with `nlobes` specular lobe levels.
+    bool environment_lobe(TextureFile& lobefile, int nlobes,
+                          PerThreadInfo* thread_info, TextureOpt& options,
+                          float s, float t, float weight, int nchannels,
+                          float* result, float* dresultds, float* dresultdt);
+
     // For the samplers, it's guaranteed that all float* inputs and outputs
     // are padded to length 'simd' and aligned to a simd*4-byte boundary
     // (for example, 4 for SSE). This means that the functions can behave AS
@@ -502,6 +597,18 @@ private:
                                  int actualchannels, float weight, float* accum,
                                  float* daccumds, float* daccumdt,
                                  float* daccumdr);
+    /// Trilinearly sample the volume at P for the lanes of `lanes`,
+    /// adding into accum[i] (and the derivs if non-NULL). Lanes whose
+    /// 2x2x2 footprint is inside the data window and on one tile are
+    /// gathered one tile at a time; the rest go through
+    /// accum3d_sample_bilinear individually.
+    bool accum3d_sample_bilinear_batch(
+        const Tex::FloatWide& Px, const Tex::FloatWide& Py,
+        const Tex::FloatWide& Pz, int level, Tex::RunMask lanes,
+        TextureFile& texturefile, PerThreadInfo* thread_info,
+        TextureOpt& options, int nchannels_result, int actualchannels,
+        simd::vfloat4* accum, simd::vfloat4* daccumds,
+        simd::vfloat4* daccumdt, simd::vfloat4* daccumdr);
 
     /// Helper function to calculate the anisotropic aspect ratio from
     /// the major and minor ellipse axis lengths.  The "clamped" aspect
@@ -585,6 +692,7 @@ private:
     mutable thread_specific_ptr<std::string> m_errormessage;
     Filter1D* hq_filter;  ///< Better filter for magnification
     int m_statslevel;
+    bool m_lookup_stats = false;  ///< Tally lookup costs per texture/site
     friend class TextureSystem;
 };
 
@@ -660,6 +768,136 @@ TextureSystemImpl::st_to_texel(float s, float t, TextureFile& texturefile,
 
 
 
+
+
+/// Index of the lowest lane that is on in a nonzero run mask.
+inline int
+first_lane(Tex::RunMask mask)
+{
+    int i = 0;
+    while (!((mask >> i) & 1))
+        ++i;
+    return i;
+}
+
+
+/// Number of lanes that are on in a run mask.
+inline int
+lane_count(Tex::RunMask mask)
+{
+    int n = 0;
+    for (; mask; mask &= mask - 1)
+        ++n;
+    return n;
+}
+
+
+/// Load the first four channels of the texel at p as floats, normalizing
+/// integer types to 0..1.
+inline simd::vfloat4
+texel_to_float4(TypeDesc::BASETYPE pixeltype, const unsigned char* p)
+{
+    if (pixeltype == TypeDesc::UINT8)
+        return simd::vfloat4(p) * (1.0f / 255.0f);
+    if (pixeltype == TypeDesc::UINT16)
+        return simd::vfloat4((const unsigned short*)p) * (1.0f / 65535.0f);
+    if (pixeltype == TypeDesc::HALF)
+        return simd::vfloat4((const half*)p);
+    return simd::vfloat4((const float*)p);
+}
+
+
+/// While the "lookup_stats" attribute is on, a LookupCostScope around a
+/// lookup call charges the per-thread statistics accumulated during the
+/// call to its texture and call site tag, and while the ImageCache's
+/// "latency_stats" is on, it records how long the call took. Only the
+/// outermost scope on a thread records, so lookups that are implemented
+/// by other lookups (batches by points, >4 channels by groups of 4) count
+/// once.
+class LookupCostScope {
+public:
+    LookupCostScope(bool enabled, ImageCacheImpl* imagecache,
+                    TextureSystem::Perthread* thread_info,
+                    TextureSystem::TextureHandle* texture_handle,
+                    ustring site, int npoints)
+    {
+        bool latency = imagecache->latency_stats();
+        if (!enabled && !latency)
+            return;
+        m_thread_info = imagecache->get_perthread_info(
+            (ImageCachePerThreadInfo*)thread_info);
+        if (m_thread_info->m_cost_depth++)
+            return;  // nested inside another lookup, which will record
+        m_outer = true;
+        if (latency)
+            m_timer.start();
+        if (!enabled)
+            return;
+        m_costs = true;
+        ImageCacheFile* file = (ImageCacheFile*)texture_handle;
+        m_filename           = file ? file->filename() : ustring();
+        m_site               = site;
+        m_npoints            = npoints;
+        m_start              = snapshot(m_thread_info->m_stats);
+    }
+
+    ~LookupCostScope()
+    {
+        if (!m_thread_info)
+            return;
+        --m_thread_info->m_cost_depth;
+        if (!m_outer)
+            return;
+        ImageCacheStatistics& stats(m_thread_info->m_stats);
+        if (m_timer.ticking())
+            stats.lookup_latency.record(m_timer());
+        if (!m_costs)
+            return;
+        Snapshot end = snapshot(stats);
+        TextureLookupCost cost;
+        cost.lookups = m_npoints;
+        // Non-anisotropic lookups are a single probe apiece.
+        cost.probes = (end.aniso_probes - m_start.aniso_probes) + m_npoints
+                      - (end.aniso_queries - m_start.aniso_queries);
+        cost.texels            = end.texels - m_start.texels;
+        cost.microcache_misses = end.microcache_misses
+                                 - m_start.microcache_misses;
+        cost.io_time = end.io_time - m_start.io_time;
+        spin_lock lock(m_thread_info->m_cost_mutex);
+        if (!m_filename.empty())
+            m_thread_info->m_file_costs[m_filename].merge(cost);
+        if (!m_site.empty())
+            m_thread_info->m_site_costs[m_site].merge(cost);
+    }
+
+private:
+    struct Snapshot {
+        long long aniso_queries, aniso_probes, texels, microcache_misses;
+        double io_time;
+    };
+    static Snapshot snapshot(const ImageCacheStatistics& stats)
+    {
+        Snapshot s;
+        s.aniso_queries     = stats.aniso_queries;
+        s.aniso_probes      = stats.aniso_probes;
+        s.texels            = stats.closest_interps
+                   + 4 * stats.bilinear_interps + 16 * stats.cubic_interps
+                   + stats.ewa_texels + stats.shadow_taps;
+        s.microcache_misses = stats.find_tile_microcache_misses;
+        s.io_time           = stats.fileio_time;
+        return s;
+    }
+
+    ImageCachePerThreadInfo* m_thread_info = nullptr;
+    bool m_outer                           = false;
+    bool m_costs                           = false;
+    Timer m_timer { Timer::DontStartNow };
+    ustring m_filename, m_site;
+    int m_npoints = 0;
+    Snapshot m_start;
+};
+
+
 }  // end namespace pvt
 
 OIIO_NAMESPACE_END
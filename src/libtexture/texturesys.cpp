@@ -3,23 +3,27 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <list>
 #include <random>
 #include <sstream>
 #include <string>
+#include <vector>
 
 #include <OpenImageIO/Imath.h>
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filter.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/hash.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/optparser.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/simd.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
@@ -77,12 +81,88 @@ half2float4(const half* h)
 }
 
 
+// Bilinearly interpolate the 2x2 block of texels whose upper left texel is
+// at p (its right neighbor pixelsize bytes later, the row below rowbytes
+// later), for a tile stored as T. The generic version converts each texel
+// to float and filters in float; the pixel type is a compile-time constant
+// so the conversion has no per-texel type dispatch.
+template<typename T>
+OIIO_FORCEINLINE vfloat4
+bilerp_texels(const unsigned char* p, int pixelsize, int rowbytes, float sfrac,
+              float tfrac)
+{
+    constexpr TypeDesc::BASETYPE pixeltype = TypeDesc::BASETYPE(
+        BaseTypeFromC<T>::value);
+    return bilerp(texel_to_float4(pixeltype, p),
+                  texel_to_float4(pixeltype, p + pixelsize),
+                  texel_to_float4(pixeltype, p + rowbytes),
+                  texel_to_float4(pixeltype, p + rowbytes + pixelsize), sfrac,
+                  tfrac);
+}
+
+
+// 8-bit tiles: weight the four texels in 8.8 fixed point in integer SIMD
+// (the weights sum to exactly 65536, so the sum of 0..255 values times
+// weights can't overflow), and convert to float just once at the end.
+template<>
+OIIO_FORCEINLINE vfloat4
+bilerp_texels<unsigned char>(const unsigned char* p, int pixelsize,
+                             int rowbytes, float sfrac, float tfrac)
+{
+    int ws = int(sfrac * 256.0f + 0.5f), wt = int(tfrac * 256.0f + 0.5f);
+    vint4 sum = vint4(p) * ((256 - ws) * (256 - wt))
+                + vint4(p + pixelsize) * (ws * (256 - wt))
+                + vint4(p + rowbytes) * ((256 - ws) * wt)
+                + vint4(p + rowbytes + pixelsize) * (ws * wt);
+    return vfloat4(sum) * (1.0f / (255.0f * 65536.0f));
+}
+
+
 static const OIIO_SIMD4_ALIGN vbool4 channel_masks[5] = {
     vbool4(false, false, false, false), vbool4(true, false, false, false),
     vbool4(true, true, false, false),   vbool4(true, true, true, false),
     vbool4(true, true, true, true),
 };
 
+
+// Gaussian weights for the EWA filter, exp(-alpha*r2) - exp(-alpha),
+// tabulated by r2 (the squared normalized distance from the center of the
+// ellipse, 1 at its edge) so that the inner loop needs no exp per texel.
+static const float ewa_alpha  = 2.0f;
+static const int ewa_lut_size = 128;
+
+struct EWAWeights {
+    float w[ewa_lut_size];
+    EWAWeights()
+    {
+        for (int i = 0; i < ewa_lut_size; ++i) {
+            float r2 = float(i) / float(ewa_lut_size - 1);
+            w[i]     = expf(-ewa_alpha * r2) - expf(-ewa_alpha);
+        }
+    }
+};
+static const EWAWeights ewa_weights;
+
+// Don't let a degenerate footprint turn one EWA lookup into a huge loop;
+// past this many texels in the ellipse's bounding box, fall back to the
+// probes of the anisotropic filter.
+static const int ewa_max_texels = 4096;
+
+
+
+// The entries of a lookup cost map, most texels fetched first.
+std::vector<std::pair<ustring, TextureLookupCost>>
+sorted_costs(const LookupCostMap& costs)
+{
+    std::vector<std::pair<ustring, TextureLookupCost>> v(costs.begin(),
+                                                         costs.end());
+    std::sort(v.begin(), v.end(), [](const auto& a, const auto& b) {
+        return a.second.texels > b.second.texels
+               || (a.second.texels == b.second.texels && a.first < b.first);
+    });
+    return v;
+}
+
 }  // end anonymous namespace
 
 
@@ -400,6 +480,18 @@ TextureSystemImpl::getstats(int level, bool icstats) const
             << " queries in " << stats.environment_batches << " batches\n";
         out << "    gettextureinfo :  " << stats.imageinfo_queries
             << " queries\n";
+        if (stats.deferred_queries)
+            out << Strutil::sprintf(
+                "    deferred    :  %lld queries, %lld tile switches "
+                "(%lld unsorted, %.1f%% fewer)\n",
+                stats.deferred_queries, stats.deferred_tile_switches,
+                stats.deferred_tile_switches_unsorted,
+                100.0
+                    * (1.0
+                       - double(stats.deferred_tile_switches)
+                             / double(std::max(
+                                 stats.deferred_tile_switches_unsorted,
+                                 1LL))));
         out << "  Interpolations :\n";
         out << "    closest  : " << stats.closest_interps << "\n";
         out << "    bilinear : " << stats.bilinear_interps << "\n";
@@ -412,6 +504,38 @@ TextureSystemImpl::getstats(int level, bool icstats) const
             out << Strutil::sprintf("  Average anisotropic probes : 0\n");
         out << Strutil::sprintf("  Max anisotropy in the wild : %.3g\n",
                                 stats.max_aniso);
+        if (stats.ewa_queries)
+            out << Strutil::sprintf("  EWA lookups : %lld (%.3g texels avg)\n",
+                                    stats.ewa_queries,
+                                    (double)stats.ewa_texels
+                                        / (double)stats.ewa_queries);
+        if (stats.shadow_queries)
+            out << Strutil::sprintf(
+                "  Shadow PCF taps : %.3g avg per query, "
+                "%lld blocker searches\n",
+                (double)stats.shadow_taps / (double)stats.shadow_queries,
+                stats.shadow_blocker_searches);
+        LookupCostMap files, sites;
+        m_imagecache->merge_lookup_costs(files, sites);
+        for (int which = 0; which < 2; ++which) {
+            const LookupCostMap& costs(which ? sites : files);
+            if (costs.empty())
+                continue;
+            // Only the heaviest few, unless asked for a lot of detail
+            size_t nshow = level >= 3 ? costs.size() : 10;
+            out << (which ? "  Lookup costs by site"
+                          : "  Lookup costs by texture")
+                << " (lookups, probes, texels, microcache misses, I/O):\n";
+            auto sorted = sorted_costs(costs);
+            for (size_t i = 0; i < sorted.size() && i < nshow; ++i) {
+                const TextureLookupCost& c(sorted[i].second);
+                out << Strutil::sprintf("    %lld %lld %lld %lld %s  %s\n",
+                                        c.lookups, c.probes, c.texels,
+                                        c.microcache_misses,
+                                        Strutil::timeintervalformat(c.io_time),
+                                        sorted[i].first);
+            }
+        }
         if (icstats)
             out << "\n";
     }
@@ -432,6 +556,35 @@ TextureSystemImpl::printstats() const
 
 
 
+std::string
+TextureSystemImpl::lookup_stats_json() const
+{
+    LookupCostMap files, sites;
+    m_imagecache->merge_lookup_costs(files, sites);
+    std::ostringstream out;
+    out.imbue(std::locale::classic());  // Force "C" locale with '.' decimal
+    out << "{";
+    for (int which = 0; which < 2; ++which) {
+        out << (which ? ",\n \"sites\": [" : "\"textures\": [");
+        auto sorted = sorted_costs(which ? sites : files);
+        for (size_t i = 0; i < sorted.size(); ++i) {
+            const TextureLookupCost& c(sorted[i].second);
+            out << (i ? ",\n  " : "\n  ")
+                << Strutil::sprintf(
+                       "{\"name\": \"%s\", \"lookups\": %lld, "
+                       "\"probes\": %lld, \"texels\": %lld, "
+                       "\"microcache_misses\": %lld, \"io_time\": %g}",
+                       Strutil::escape_chars(sorted[i].first), c.lookups,
+                       c.probes, c.texels, c.microcache_misses, c.io_time);
+        }
+        out << "]";
+    }
+    out << "}\n";
+    return out.str();
+}
+
+
+
 void
 TextureSystemImpl::reset_stats()
 {
@@ -471,6 +624,10 @@ TextureSystemImpl::attribute(string_view name, TypeDesc type, const void* val)
         m_max_tile_channels = *(const int*)val;
         return true;
     }
+    if (name == "lookup_stats" && type == TypeInt) {
+        m_lookup_stats = *(const int*)val;
+        return true;
+    }
     if (name == "statistics:level" && type == TypeInt) {
         m_statslevel = *(const int*)val;
         // DO NOT RETURN! pass the same message to the image cache
@@ -516,6 +673,10 @@ TextureSystemImpl::getattribute(string_view name, TypeDesc type,
         *(int*)val = m_max_tile_channels;
         return true;
     }
+    if (name == "lookup_stats" && type == TypeInt) {
+        *(int*)val = m_lookup_stats;
+        return true;
+    }
 
     // If not one of these, maybe it's an attribute meant for the image cache?
     return m_imagecache->getattribute(name, type, val);
@@ -675,6 +836,36 @@ TextureSystemImpl::resolve_udim(TextureHandle* udimfile, Perthread* thread_info,
 
 
 
+void
+TextureSystemImpl::resolve_udim(TextureHandle* udimfile, Perthread* thread_info,
+                                Tex::RunMask mask, const float* s,
+                                const float* t, TextureHandle** handles)
+{
+    thread_info = (Perthread*)m_imagecache->get_perthread_info(
+        (PerThreadInfo*)thread_info);
+    // Find the u and v tile indices of all the points at once
+    Tex::IntWide utile = max(Tex::IntWide(0), Tex::IntWide(Tex::FloatWide(s)));
+    Tex::IntWide vtile = max(Tex::IntWide(0), Tex::IntWide(Tex::FloatWide(t)));
+    // Neighboring points are usually on the same tile, so only go to the
+    // ImageCache when the tile changes.
+    int lastu = -1, lastv = -1;
+    TextureHandle* last = nullptr;
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        if (!(mask & (Tex::RunMask(1) << i)))
+            continue;
+        if (utile[i] != lastu || vtile[i] != lastv) {
+            lastu = utile[i];
+            lastv = vtile[i];
+            last  = (TextureHandle*)m_imagecache->resolve_udim(
+                (ImageCache::ImageHandle*)udimfile,
+                (ImageCache::Perthread*)thread_info, lastu, lastv);
+        }
+        handles[i] = last;
+    }
+}
+
+
+
 void
 TextureSystemImpl::inventory_udim(ustring udimpattern,
                                   std::vector<ustring>& filenames, int& nutiles,
@@ -755,11 +946,6 @@ TextureSystemImpl::get_texels(TextureHandle* texture_handle_,
     }
     const ImageSpec& spec(texfile->spec(subimage, miplevel));
 
-    // FIXME -- this could be WAY more efficient than starting from
-    // scratch for each pixel within the rectangle.  Instead, we should
-    // grab a whole tile at a time and memcpy it rapidly.  But no point
-    // doing anything more complicated (not to mention bug-prone) until
-    // somebody reports this routine as being a bottleneck.
     int nchannels      = chend - chbegin;
     int actualchannels = OIIO::clamp(spec.nchannels - chbegin, 0, nchannels);
     int tile_chbegin = 0, tile_chend = spec.nchannels;
@@ -768,55 +954,95 @@ TextureSystemImpl::get_texels(TextureHandle* texture_handle_,
         tile_chbegin = chbegin;
         tile_chend   = chbegin + actualchannels;
     }
-    TileID tileid(*texfile, subimage, miplevel, 0, 0, 0, tile_chbegin,
-                  tile_chend);
+    TypeDesc tiletype        = texfile->datatype(subimage);
     size_t formatchannelsize = format.size();
     size_t formatpixelsize   = nchannels * formatchannelsize;
     size_t scanlinesize      = (xend - xbegin) * formatpixelsize;
     size_t zplanesize        = (yend - ybegin) * scanlinesize;
-    imagesize_t npixelsread  = 0;
-    bool ok                  = true;
-    for (int z = zbegin; z < zend; ++z) {
-        if (z < spec.z || z >= (spec.z + std::max(spec.depth, 1))) {
-            // nonexistent planes
-            memset(result, 0, zplanesize);
-            result = (void*)((char*)result + zplanesize);
-            continue;
-        }
-        tileid.z(z - ((z - spec.z) % std::max(1, spec.tile_depth)));
-        for (int y = ybegin; y < yend; ++y) {
-            if (y < spec.y || y >= (spec.y + spec.height)) {
-                // nonexistent scanlines
-                memset(result, 0, scanlinesize);
-                result = (void*)((char*)result + scanlinesize);
-                continue;
-            }
-            tileid.y(y - ((y - spec.y) % spec.tile_height));
-            for (int x = xbegin; x < xend; ++x, ++npixelsread) {
-                if (x < spec.x || x >= (spec.x + spec.width)) {
-                    // nonexistent columns
-                    memset(result, 0, formatpixelsize);
-                    result = (void*)((char*)result + formatpixelsize);
+
+    // Only the part of the region within the data window has pixels; the
+    // rest of the result is zero.
+    ROI region(xbegin, xend, ybegin, yend, zbegin, zend);
+    ROI roi = roi_intersection(region, get_roi(spec));
+    if (roi.npixels() < region.npixels())
+        memset(result, 0, (zend - zbegin) * zplanesize);
+    if (roi.npixels() == 0)
+        return true;
+
+    // The values of any channels asked for beyond those of the file.
+    std::unique_ptr<char[]> fillpixel(new char[formatpixelsize]);
+    for (int c = actualchannels; c < nchannels; ++c)
+        convert_types(TypeDesc::FLOAT, &options.fill, format,
+                      fillpixel.get() + c * formatchannelsize, 1);
+
+    // The grid of tiles covering the region. Each tile is copied, and
+    // converted to the requested format, as its own task. If there's more
+    // than one tile, we first queue all of those not yet in the cache to
+    // be read by the prefetch threads, so that the reads overlap each
+    // other and the copying.
+    const int tw = spec.tile_width, th = spec.tile_height;
+    const int td = std::max(1, spec.tile_depth);
+    const int tx0 = roi.xbegin - (roi.xbegin - spec.x) % tw;
+    const int ty0 = roi.ybegin - (roi.ybegin - spec.y) % th;
+    const int tz0 = roi.zbegin - (roi.zbegin - spec.z) % td;
+    const int64_t ntx = (roi.xend - tx0 + tw - 1) / tw;
+    const int64_t nty = (roi.yend - ty0 + th - 1) / th;
+    const int64_t ntz = (roi.zend - tz0 + td - 1) / td;
+    const int64_t ntiles = ntx * nty * ntz;
+    if (ntiles > 1) {
+        ROI prefetch_roi = roi;
+        prefetch_roi.chbegin = tile_chbegin;
+        prefetch_roi.chend   = tile_chend;
+        m_imagecache->prefetch_tiles((ImageCache::ImageHandle*)texfile,
+                                     (ImageCache::Perthread*)thread_info,
+                                     subimage, miplevel, prefetch_roi);
+    }
+
+    std::atomic<bool> ok(true);
+    auto copy_tile = [&](int64_t t) {
+        int tx = tx0 + int(t % ntx) * tw;
+        int ty = ty0 + int((t / ntx) % nty) * th;
+        int tz = tz0 + int(t / (ntx * nty)) * td;
+        ROI troi = roi_intersection(ROI(tx, tx + tw, ty, ty + th, tz, tz + td),
+                                    roi);
+        PerThreadInfo* ti = m_imagecache->get_perthread_info();
+        TileID tileid(*texfile, subimage, miplevel, tx, ty, tz, tile_chbegin,
+                      tile_chend);
+        if (!find_tile(tileid, ti, true))
+            ok = false;
+        const ImageCacheTile* tile = ti->tile.get();
+        for (int z = troi.zbegin; z < troi.zend; ++z) {
+            for (int y = troi.ybegin; y < troi.yend; ++y) {
+                char* dst = (char*)result + (z - zbegin) * zplanesize
+                            + (y - ybegin) * scanlinesize
+                            + (troi.xbegin - xbegin) * formatpixelsize;
+                const void* data = tile ? tile->data(troi.xbegin, y, z,
+                                                     chbegin)
+                                        : nullptr;
+                if (!data) {
+                    memset(dst, 0, troi.width() * formatpixelsize);
                     continue;
                 }
-                tileid.x(x - ((x - spec.x) % spec.tile_width));
-                ok &= find_tile(tileid, thread_info, npixelsread == 0);
-                TileRef& tile(thread_info->tile);
-                const char* data;
-                if (tile
-                    && (data = (const char*)tile->data(x, y, z, chbegin))) {
-                    convert_types(texfile->datatype(subimage), data, format,
-                                  result, actualchannels);
-                    for (int c = actualchannels; c < nchannels; ++c)
-                        convert_types(TypeDesc::FLOAT, &options.fill, format,
-                                      (char*)result + c * formatchannelsize, 1);
-                } else {
-                    memset(result, 0, formatpixelsize);
+                if (actualchannels)
+                    convert_image(actualchannels, troi.width(), 1, 1, data,
+                                  tiletype, tile->pixelsize(), AutoStride,
+                                  AutoStride, dst, format, formatpixelsize,
+                                  AutoStride, AutoStride);
+                if (actualchannels < nchannels) {
+                    size_t fillbegin = actualchannels * formatchannelsize;
+                    for (int x = troi.xbegin; x < troi.xend;
+                         ++x, dst += formatpixelsize)
+                        memcpy(dst + fillbegin, fillpixel.get() + fillbegin,
+                               formatpixelsize - fillbegin);
                 }
-                result = (void*)((char*)result + formatpixelsize);
             }
         }
-    }
+    };
+    if (ntiles > 1)
+        parallel_for(int64_t(0), ntiles, copy_tile);
+    else
+        copy_tile(0);
+
     if (!ok) {
         std::string err = m_imagecache->geterror();
         if (!err.empty())
@@ -1059,6 +1285,9 @@ TextureSystemImpl::texture(TextureHandle* texture_handle_,
                            float dtdy, int nchannels, float* result,
                            float* dresultds, float* dresultdt)
 {
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info_,
+                         texture_handle_, options.site, 1);
+
     // Handle >4 channel lookups by recursion.
     if (nchannels > 4) {
         int save_firstchannel = options.firstchannel;
@@ -1089,7 +1318,8 @@ TextureSystemImpl::texture(TextureHandle* texture_handle_,
         &TextureSystemImpl::texture_lookup_trilinear_mipmap,
         &TextureSystemImpl::texture_lookup,
         &TextureSystemImpl::texture_lookup_trilinear_mipmap,
-        &TextureSystemImpl::texture_lookup
+        &TextureSystemImpl::texture_lookup,
+        &TextureSystemImpl::texture_lookup_ewa
     };
     texture_lookup_prototype lookup = lookup_functions[(int)options.mipmode];
 
@@ -1253,7 +1483,9 @@ TextureSystemImpl::texture(TextureHandle* texture_handle,
                            const float* dsdy, const float* dtdy, int nchannels,
                            float* result, float* dresultds, float* dresultdt)
 {
-    // (FIXME) CHEAT! Texture points individually
+    LookupCostScope cost(m_lookup_stats, m_imagecache, thread_info,
+                         texture_handle, options.site, lane_count(mask));
+
     TextureOpt opt;
     opt.firstchannel        = options.firstchannel;
     opt.subimage            = options.subimage;
@@ -1268,7 +1500,68 @@ TextureSystemImpl::texture(TextureHandle* texture_handle,
     opt.missingcolor        = options.missingcolor;
     // rwrap not needed for 2D texture
 
-    bool ok          = true;
+    // The common bilinear/trilinear cases have a real wide implementation.
+    // Everything else (anisotropic and bicubic filtering, udim, more than
+    // 4 channels, missing textures) still textures the points one by one.
+    bool wide_interp = (opt.interpmode == TextureOpt::InterpBilinear
+                        || opt.interpmode == TextureOpt::InterpSmartBicubic);
+    bool wide_mip    = (opt.mipmode == TextureOpt::MipModeNoMIP
+                     || opt.mipmode == TextureOpt::MipModeOneLevel
+                     || opt.mipmode == TextureOpt::MipModeTrilinear);
+    TextureFile* texturefile = (TextureFile*)texture_handle;
+    bool udim_ok             = true;
+    if (texturefile && texturefile->is_udim()) {
+        // Resolve all the points' UDIM tiles at once, then do the lookups
+        // for each group of points on the same concrete tile together.
+        // Points with no tile fall through to the point-by-point loop,
+        // which fills them in like any missing texture.
+        TextureHandle* handles[Tex::BatchWidth];
+        resolve_udim(texture_handle, thread_info, mask, s, t, handles);
+        alignas(Tex::BatchAlign) float stile[Tex::BatchWidth];
+        alignas(Tex::BatchAlign) float ttile[Tex::BatchWidth];
+        for (int i = 0; i < Tex::BatchWidth; ++i) {
+            // Adjust s,t to be within the udim tile
+            stile[i] = s[i] - floorf(s[i]);
+            ttile[i] = t[i] - floorf(t[i]);
+        }
+        Tex::RunMask unresolved = 0;
+        for (Tex::RunMask remaining = mask; remaining;) {
+            TextureHandle* handle = handles[first_lane(remaining)];
+            Tex::RunMask group    = 0;
+            for (int i = 0; i < Tex::BatchWidth; ++i)
+                if (((remaining >> i) & 1) && handles[i] == handle)
+                    group |= Tex::RunMask(1) << i;
+            remaining &= ~group;
+            if (handle)
+                udim_ok &= texture(handle, thread_info, options, group, stile,
+                                   ttile, dsdx, dtdx, dsdy, dtdy, nchannels,
+                                   result, dresultds, dresultdt);
+            else
+                unresolved |= group;
+        }
+        if (!unresolved)
+            return udim_ok;
+        mask = unresolved;
+    } else if (wide_interp && wide_mip && nchannels <= 4 && texturefile) {
+        PerThreadInfo* ptinfo = m_imagecache->get_perthread_info(
+            (PerThreadInfo*)thread_info);
+        texturefile = verify_texturefile(texturefile, ptinfo);
+        if (texturefile && !texturefile->broken()) {
+            if (!opt.subimagename.empty())
+                opt.subimage = m_imagecache->subimage_from_name(
+                    texturefile, opt.subimagename);
+            if (opt.subimage >= 0 && opt.subimage < texturefile->subimages()) {
+                opt.subimagename.clear();
+                return texture_batch_bilinear(*texturefile, ptinfo, opt,
+                                              options, mask, s, t, dsdx, dtdx,
+                                              dsdy, dtdy, nchannels, result,
+                                              dresultds, dresultdt);
+            }
+            opt.subimage = options.subimage;
+        }
+    }
+
+    bool ok          = udim_ok;
     Tex::RunMask bit = 1;
     for (int i = 0; i < Tex::BatchWidth; ++i, bit <<= 1) {
         float r[4], drds[4], drdt[4];  // temp result
@@ -1302,6 +1595,489 @@ TextureSystemImpl::texture(TextureHandle* texture_handle,
 
 
 
+bool
+TextureSystemImpl::texture_deferred(Perthread* thread_info_,
+                                    TextureOpt& options,
+                                    cspan<TextureRequest> requests,
+                                    int nchannels)
+{
+    PerThreadInfo* thread_info = m_imagecache->get_perthread_info(
+        (PerThreadInfo*)thread_info_);
+    size_t n = requests.size();
+    if (!n)
+        return true;
+
+    // Coherence key for each request: which file, roughly which MIP level
+    // it will read, and which tile of that level holds the center of the
+    // footprint. The index breaks ties so the sort is stable.
+    struct DeferredKey {
+        TextureFile* file;
+        int miplevel;
+        int tilex, tiley;
+        uint32_t index;
+        bool operator<(const DeferredKey& b) const
+        {
+            if (file != b.file)
+                return file < b.file;
+            if (miplevel != b.miplevel)
+                return miplevel < b.miplevel;
+            if (tiley != b.tiley)
+                return tiley < b.tiley;
+            if (tilex != b.tilex)
+                return tilex < b.tilex;
+            return index < b.index;
+        }
+        bool same_tile(const DeferredKey& b) const
+        {
+            return file == b.file && miplevel == b.miplevel
+                   && tilex == b.tilex && tiley == b.tiley;
+        }
+    };
+
+    std::vector<DeferredKey> keys(n);
+    for (size_t i = 0; i < n; ++i) {
+        const TextureRequest& r(requests[i]);
+        DeferredKey& k(keys[i]);
+        float s = r.s, t = r.t;
+        TextureFile* file = (TextureFile*)r.texture_handle;
+        if (file && file->is_udim()) {
+            file = (TextureFile*)resolve_udim(r.texture_handle,
+                                              (Perthread*)thread_info, s, t);
+            s -= floorf(s);
+            t -= floorf(t);
+        }
+        if (file)
+            file = verify_texturefile(file, thread_info);
+        k.file     = file;
+        k.miplevel = 0;
+        k.tilex = k.tiley = 0;
+        k.index           = uint32_t(i);
+        int subimage      = options.subimage;
+        if (!file || file->broken() || !options.subimagename.empty()
+            || subimage < 0 || subimage >= file->subimages())
+            continue;
+        // Estimate the MIP level the same way the trilinear lookup picks
+        // its finer level: the first one whose texels are at least as big
+        // as the filter footprint.
+        const ImageCacheFile::SubimageInfo& si(file->subimageinfo(subimage));
+        float filtwidth = std::max(std::max(fabsf(r.dsdx), fabsf(r.dtdx)),
+                                   std::max(fabsf(r.dsdy), fabsf(r.dtdy)));
+        int nmip  = si.miplevels();
+        int level = 0;
+        if (options.mipmode != TextureOpt::MipModeNoMIP) {
+            for (; level < nmip - 1; ++level) {
+                const ImageSpec& spec(si.spec(level));
+                if (filtwidth * std::min(spec.full_width, spec.full_height)
+                    <= 1.0f)
+                    break;
+            }
+        }
+        const ImageSpec& spec(si.spec(level));
+        k.miplevel = level;
+        k.tilex    = ifloor(s * spec.full_width) / std::max(spec.tile_width, 1);
+        k.tiley = ifloor(t * spec.full_height) / std::max(spec.tile_height, 1);
+    }
+
+    long long unsorted_switches = 1;
+    for (size_t i = 1; i < n; ++i)
+        unsorted_switches += !keys[i].same_tile(keys[i - 1]);
+    std::sort(keys.begin(), keys.end());
+    long long sorted_switches = 1;
+    for (size_t i = 1; i < n; ++i)
+        sorted_switches += !keys[i].same_tile(keys[i - 1]);
+
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    stats.deferred_queries += n;
+    stats.deferred_tile_switches += sorted_switches;
+    stats.deferred_tile_switches_unsorted += unsorted_switches;
+
+    // texture() may modify the options it's handed (wrap modes, subimage
+    // by name), so each lookup starts from a fresh copy.
+    bool ok = true;
+    for (const DeferredKey& k : keys) {
+        const TextureRequest& r(requests[k.index]);
+        TextureOpt opt(options);
+        ok &= texture(r.texture_handle, (Perthread*)thread_info, opt, r.s, r.t,
+                      r.dsdx, r.dtdx, r.dsdy, r.dtdy, nchannels, r.result,
+                      r.dresultds, r.dresultdt);
+    }
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::texture_batch_bilinear(
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    const TextureOptBatch& batchopt, Tex::RunMask mask, const float* s_,
+    const float* t_, const float* dsdx_, const float* dtdx_,
+    const float* dsdy_, const float* dtdy_, int nchannels, float* result,
+    float* dresultds, float* dresultdt)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.texture_batches;
+    stats.texture_queries += lane_count(mask);
+
+    const ImageCacheFile::SubimageInfo& subinfo(
+        texturefile.subimageinfo(options.subimage));
+    const ImageSpec& spec(texturefile.spec(options.subimage, 0));
+    int actualchannels = OIIO::clamp(spec.nchannels - options.firstchannel, 0,
+                                     nchannels);
+
+    // Figure out the wrap functions
+    if (options.swrap == TextureOpt::WrapDefault)
+        options.swrap = (TextureOpt::Wrap)texturefile.swrap();
+    if (options.swrap == TextureOpt::WrapPeriodic && ispow2(spec.width))
+        options.swrap = TextureOpt::WrapPeriodicPow2;
+    if (options.twrap == TextureOpt::WrapDefault)
+        options.twrap = (TextureOpt::Wrap)texturefile.twrap();
+    if (options.twrap == TextureOpt::WrapPeriodic && ispow2(spec.height))
+        options.twrap = TextureOpt::WrapPeriodicPow2;
+
+    // Per-lane results, scattered into the channel-major output at the end.
+    vfloat4 accum[Tex::BatchWidth], daccumds[Tex::BatchWidth],
+        daccumdt[Tex::BatchWidth];
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        accum[i].clear();
+        daccumds[i].clear();
+        daccumdt[i].clear();
+    }
+
+    bool ok = true;
+    if (subinfo.is_constant_image && options.swrap != TextureOpt::WrapBlack
+        && options.twrap != TextureOpt::WrapBlack) {
+        // Lookup of constant color texture, non-black wrap -- skip all the
+        // hard stuff.
+        vfloat4 c(options.fill);
+        for (int ch = 0; ch < actualchannels; ++ch)
+            c[ch] = subinfo.average_color[ch + options.firstchannel];
+        for (int i = 0; i < Tex::BatchWidth; ++i)
+            accum[i] = c;
+    } else {
+        FloatWide s(s_), t(t_), dsdx(dsdx_), dtdx(dtdx_), dsdy(dsdy_),
+            dtdy(dtdy_);
+        if (m_flip_t) {
+            t    = 1.0f - t;
+            dtdx = -dtdx;
+            dtdy = -dtdy;
+        }
+        if (!subinfo.full_pixel_range) {  // remap st for overscan or crop
+            s    = s * subinfo.sscale + subinfo.soffset;
+            dsdx = dsdx * subinfo.sscale;
+            dsdy = dsdy * subinfo.sscale;
+            t    = t * subinfo.tscale + subinfo.toffset;
+            dtdx = dtdx * subinfo.tscale;
+            dtdy = dtdy * subinfo.tscale;
+        }
+
+        FloatWide swidth(batchopt.swidth), twidth(batchopt.twidth);
+        FloatWide sblur(batchopt.sblur), tblur(batchopt.tblur);
+        FloatWide sfilt     = max(abs(dsdx * swidth), abs(dsdy * swidth));
+        FloatWide tfilt     = max(abs(dtdx * twidth), abs(dtdy * twidth));
+        FloatWide filtwidth = options.conservative_filter ? max(sfilt, tfilt)
+                                                          : min(sfilt, tfilt);
+        // Degenerate derivatives become a tiny but finite filter, as
+        // adjust_width() does for single points.
+        filtwidth = max(filtwidth, FloatWide(1.0e-8f));
+        // account for blur
+        filtwidth += max(sblur, tblur);
+        IntWide level0, level1;
+        FloatWide levelblend;
+        compute_miplevels_batch(texturefile, options, filtwidth, false, level0,
+                                level1, levelblend);
+
+        int npointson = 0;
+        ok = sample_bilinear_mipmap_batch(mask, level0, level1, levelblend, s,
+                                          t, texturefile, thread_info, options,
+                                          nchannels, actualchannels, accum,
+                                          dresultds ? daccumds : nullptr,
+                                          dresultds ? daccumdt : nullptr,
+                                          npointson);
+        stats.aniso_queries += npointson;
+        stats.aniso_probes += npointson;
+        stats.bilinear_interps += npointson;
+    }
+
+    bool gray_fill = (actualchannels < nchannels && options.firstchannel == 0
+                      && m_gray_to_rgb);
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        if (!((mask >> i) & 1))
+            continue;
+        if (gray_fill)
+            fill_gray_channels(spec, nchannels, (float*)&accum[i],
+                               dresultds ? (float*)&daccumds[i] : nullptr,
+                               dresultds ? (float*)&daccumdt[i] : nullptr);
+        for (int c = 0; c < nchannels; ++c)
+            result[c * Tex::BatchWidth + i] = accum[i][c];
+        if (dresultds) {
+            if (m_flip_t)
+                daccumdt[i] = -daccumdt[i];
+            for (int c = 0; c < nchannels; ++c) {
+                dresultds[c * Tex::BatchWidth + i] = daccumds[i][c];
+                dresultdt[c * Tex::BatchWidth + i] = daccumdt[i][c];
+            }
+        }
+    }
+    return ok;
+}
+
+
+
+void
+TextureSystemImpl::compute_miplevels_batch(TextureFile& texturefile,
+                                           const TextureOpt& options,
+                                           const Tex::FloatWide& filtwidth,
+                                           bool latlong, Tex::IntWide& level0,
+                                           Tex::IntWide& level1,
+                                           Tex::FloatWide& levelblend)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+    typedef simd::VecType<bool, Tex::BatchWidth>::type BoolWide;
+
+    const ImageCacheFile::SubimageInfo& subinfo(
+        texturefile.subimageinfo(options.subimage));
+    int min_mip_level = subinfo.min_mip_level;
+    level0            = IntWide(min_mip_level);
+    level1            = level0;
+    levelblend        = FloatWide(0.0f);
+    if (options.mipmode == TextureOpt::MipModeNoMIP)
+        return;
+
+    int nmiplevels = (int)subinfo.levels.size();
+    BoolWide found(false);
+    for (int m = min_mip_level; m < nmiplevels && !all(found); ++m) {
+        // Filter size in raster space at this MIP level. Latlong filters
+        // are in radians, and the vertical resolution of a latlong map is
+        // PI radians.
+        const ImageSpec& spec(subinfo.spec(m));
+        float res = latlong ? float(spec.full_height * M_1_PI)
+                            : float(std::min(spec.width, spec.height));
+        FloatWide filtwidth_ras = filtwidth * res;
+        BoolWide hit = (filtwidth_ras <= 1.0f) & !found;
+        level0       = blend(level0, IntWide(m - 1), hit);
+        level1       = blend(level1, IntWide(m), hit);
+        levelblend   = blend(levelblend,
+                             min(max(2.0f * filtwidth_ras - 1.0f,
+                                     FloatWide(0.0f)),
+                                 FloatWide(1.0f)),
+                             hit);
+        found |= hit;
+    }
+    // Lanes that never got down to a texel-sized filter make due with the
+    // coarsest level; lanes that wanted more resolution than the finest
+    // level get the finest.
+    level0          = blend(IntWide(nmiplevels - 1), level0, found);
+    level1          = blend(IntWide(nmiplevels - 1), level1, found);
+    levelblend      = blend0(levelblend, found);
+    BoolWide finest = level0 < min_mip_level;
+    level0          = blend(level0, IntWide(min_mip_level), finest);
+    level1          = blend(level1, IntWide(min_mip_level), finest);
+    levelblend      = blend0not(levelblend, finest);
+    if (options.mipmode == TextureOpt::MipModeOneLevel) {
+        // The 2D lookups keep the coarser level, the latlong ones the
+        // finer one.
+        if (latlong)
+            level1 = level0;
+        else
+            level0 = level1;
+        levelblend = FloatWide(0.0f);
+    }
+}
+
+
+
+bool
+TextureSystemImpl::sample_bilinear_mipmap_batch(
+    Tex::RunMask mask, const Tex::IntWide& level0, const Tex::IntWide& level1,
+    const Tex::FloatWide& levelblend, const Tex::FloatWide& s,
+    const Tex::FloatWide& t, TextureFile& texturefile,
+    PerThreadInfo* thread_info, TextureOpt& options, int nchannels_result,
+    int actualchannels, vfloat4* accum, vfloat4* daccumds, vfloat4* daccumdt,
+    int& npointson)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+
+    bool ok   = true;
+    npointson = 0;
+    for (int pass = 0; pass < 2; ++pass) {
+        const IntWide& level = pass ? level1 : level0;
+        FloatWide lw         = pass ? levelblend : 1.0f - levelblend;
+        Tex::RunMask todo    = mask & Tex::RunMask((lw != 0.0f).bitmask());
+        while (todo) {
+            int m              = level[first_lane(todo)];
+            Tex::RunMask lanes = todo & Tex::RunMask((level == m).bitmask());
+            todo &= ~lanes;
+            npointson += lane_count(lanes);
+            ok &= sample_bilinear_batch(m, lanes, s, t, lw, texturefile,
+                                        thread_info, options, nchannels_result,
+                                        actualchannels, accum, daccumds,
+                                        daccumdt);
+        }
+    }
+    return ok;
+}
+
+
+
+bool
+TextureSystemImpl::sample_bilinear_batch(
+    int miplevel, Tex::RunMask lanes, const Tex::FloatWide& s_,
+    const Tex::FloatWide& t_, const Tex::FloatWide& weight,
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    int nchannels_result, int actualchannels, vfloat4* accum,
+    vfloat4* daccumds, vfloat4* daccumdt)
+{
+    using Tex::FloatWide;
+    using Tex::IntWide;
+    typedef simd::VecType<bool, Tex::BatchWidth>::type BoolWide;
+
+    const ImageSpec& spec(texturefile.spec(options.subimage, miplevel));
+    TypeDesc::BASETYPE pixeltype = texturefile.pixeltype(options.subimage);
+    size_t channelsize           = texturefile.channelsize(options.subimage);
+    int firstchannel             = options.firstchannel;
+    int tile_chbegin = 0, tile_chend = spec.nchannels;
+    if (spec.nchannels > m_max_tile_channels) {
+        // For files with many channels, narrow the range we cache
+        tile_chbegin = options.firstchannel;
+        tile_chend   = options.firstchannel + actualchannels;
+    }
+
+    // st_to_texel for all lanes at once.
+    FloatWide s, t;
+    if (texturefile.sample_border() == 0) {
+        s = s_ * float(spec.width) + (spec.x - 0.5f);
+        t = t_ * float(spec.height) + (spec.y - 0.5f);
+    } else {
+        s = s_ * float(spec.width - 1) + float(spec.x);
+        t = t_ * float(spec.height - 1) + float(spec.y);
+    }
+    IntWide sint, tint;
+    FloatWide sfrac = floorfrac(s, &sint);
+    FloatWide tfrac = floorfrac(t, &tint);
+
+    // A lane can skip the wrap functions and the per-texel tile lookups if
+    // its whole 2x2 footprint lies inside the data window (where every
+    // wrap mode is the identity) and on a single tile. Shared-border
+    // periodic wrap maps the last column/row back to the first, so it
+    // needs one more texel of margin.
+    int slimit = spec.x + spec.width - 1;
+    int tlimit = spec.y + spec.height - 1;
+    if (options.swrap == TextureOpt::WrapPeriodicSharedBorder)
+        --slimit;
+    if (options.twrap == TextureOpt::WrapPeriodicSharedBorder)
+        --tlimit;
+    IntWide tile_s = sint - spec.x, tile_t = tint - spec.y;
+    if (ispow2(spec.tile_width) && ispow2(spec.tile_height)) {
+        tile_s &= IntWide(spec.tile_width - 1);
+        tile_t &= IntWide(spec.tile_height - 1);
+    } else {
+        tile_s = tile_s % spec.tile_width;
+        tile_t = tile_t % spec.tile_height;
+    }
+    BoolWide inside = (sint >= spec.x) & (sint < slimit) & (tint >= spec.y)
+                      & (tint < tlimit) & (tile_s != spec.tile_width - 1)
+                      & (tile_t != spec.tile_height - 1);
+    IntWide tilex = sint - tile_s, tiley = tint - tile_t;
+    // Lookups on the lowest res levels of a latlong map fade to the pole
+    // color, which only sample_bilinear knows how to do.
+    if (options.envlayout == LayoutLatLong
+        && texturefile.levelinfo(options.subimage, miplevel).onetile)
+        inside = BoolWide(false);
+
+    // Bilinear (and derivative) weights for all lanes, with the filter
+    // weight folded in.
+    FloatWide sfrac1 = 1.0f - sfrac, tfrac1 = 1.0f - tfrac;
+    FloatWide w00 = weight * sfrac1 * tfrac1, w01 = weight * sfrac * tfrac1;
+    FloatWide w10 = weight * sfrac1 * tfrac, w11 = weight * sfrac * tfrac;
+    FloatWide wds0 = weight * float(spec.width) * tfrac1;
+    FloatWide wds1 = weight * float(spec.width) * tfrac;
+    FloatWide wdt0 = weight * float(spec.height) * sfrac1;
+    FloatWide wdt1 = weight * float(spec.height) * sfrac;
+
+    simd::vbool4 channel_mask = channel_masks[actualchannels];
+    vfloat4 fill(0.0f);
+    if (nchannels_result > actualchannels && options.fill)
+        fill = blend0not(vfloat4(options.fill), channel_mask);
+
+    // Gather the fast lanes one tile at a time: each tile is looked up
+    // once for all the lanes that land on it.
+    Tex::RunMask fastlanes = lanes & Tex::RunMask(inside.bitmask());
+    TileID id(texturefile, options.subimage, miplevel, 0, 0, 0, tile_chbegin,
+              tile_chend);
+    while (fastlanes) {
+        int first = first_lane(fastlanes);
+        Tex::RunMask group
+            = fastlanes
+              & Tex::RunMask(
+                  ((tilex == tilex[first]) & (tiley == tiley[first])).bitmask());
+        fastlanes &= ~group;
+        id.xy(tilex[first], tiley[first]);
+        bool ok = find_tile(id, thread_info, true);
+        if (!ok)
+            error("{}", m_imagecache->geterror());
+        TileRef& tile(thread_info->tile);
+        if (!tile->valid())
+            return false;
+        int pixelsize    = tile->pixelsize();
+        size_t rowstride = size_t(pixelsize) * spec.tile_width;
+        const unsigned char* base = tile->bytedata()
+                                    + channelsize * (firstchannel - id.chbegin());
+        for (int i = first; i < Tex::BatchWidth; ++i) {
+            if (!((group >> i) & 1))
+                continue;
+            const unsigned char* p = base
+                                     + tile->pixel_offset(tile_s[i], tile_t[i]);
+            vfloat4 t00 = texel_to_float4(pixeltype, p);
+            vfloat4 t01 = texel_to_float4(pixeltype, p + pixelsize);
+            vfloat4 t10 = texel_to_float4(pixeltype, p + rowstride);
+            vfloat4 t11 = texel_to_float4(pixeltype, p + rowstride + pixelsize);
+            vfloat4 r   = w00[i] * t00 + w01[i] * t01 + w10[i] * t10
+                        + w11[i] * t11;
+            accum[i] += blend0(r, channel_mask) + weight[i] * fill;
+            if (daccumds) {
+                vfloat4 ds = wds0[i] * (t01 - t00) + wds1[i] * (t11 - t10);
+                vfloat4 dt = wdt0[i] * (t10 - t00) + wdt1[i] * (t11 - t01);
+                daccumds[i] += blend0(ds, channel_mask);
+                daccumdt[i] += blend0(dt, channel_mask);
+            }
+        }
+    }
+
+    // Lanes near the edges or straddling tiles take the general path.
+    Tex::RunMask slowlanes = lanes & ~Tex::RunMask(inside.bitmask());
+    OIIO_SIMD4_ALIGN float sval[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    OIIO_SIMD4_ALIGN float tval[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+    static OIIO_SIMD4_ALIGN float one[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+    bool ok = true;
+    for (int i = 0; i < Tex::BatchWidth && slowlanes; ++i) {
+        if (!((slowlanes >> i) & 1))
+            continue;
+        slowlanes &= ~(Tex::RunMask(1) << i);
+        sval[0] = s_[i];
+        tval[0] = t_[i];
+        vfloat4 r, drds, drdt;
+        ok &= sample_bilinear(1, sval, tval, miplevel, texturefile,
+                              thread_info, options, nchannels_result,
+                              actualchannels, one, &r,
+                              daccumds ? &drds : nullptr,
+                              daccumds ? &drdt : nullptr);
+        vfloat4 w = weight[i];
+        accum[i] += w * r;
+        if (daccumds) {
+            daccumds[i] += w * drds;
+            daccumdt[i] += w * drdt;
+        }
+    }
+    return ok;
+}
+
+
+
 bool
 TextureSystemImpl::texture_lookup_nomip(
     TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
@@ -1323,6 +2099,7 @@ TextureSystemImpl::texture_lookup_nomip(
         &TextureSystemImpl::sample_bilinear,
         &TextureSystemImpl::sample_bicubic,
         &TextureSystemImpl::sample_bilinear,
+        &TextureSystemImpl::sample_closest,
     };
     sampler_prototype sampler      = sample_functions[(int)options.interpmode];
     OIIO_SIMD4_ALIGN float sval[4] = { s, 0.0f, 0.0f, 0.0f };
@@ -1345,12 +2122,26 @@ TextureSystemImpl::texture_lookup_nomip(
     case TextureOpt::InterpBilinear: ++stats.bilinear_interps; break;
     case TextureOpt::InterpBicubic: ++stats.cubic_interps; break;
     case TextureOpt::InterpSmartBicubic: ++stats.bilinear_interps; break;
+    case TextureOpt::InterpStochasticBilinear: ++stats.closest_interps; break;
     }
     return ok;
 }
 
 
 
+// Turn the caller's random value plus a sample index and dimension into a
+// fresh uniform deviate in [0,1). Hashing keeps the texel and probe choices
+// of InterpStochasticBilinear independent of the MIP level choice, which
+// thresholds the same rnd value directly.
+inline float
+stochastic_deviate(float rnd, uint32_t index, uint32_t dim)
+{
+    uint32_t h = bjhash::bjfinal(bit_cast<float, uint32_t>(rnd), index, dim);
+    return float(h >> 8) * (1.0f / float(1 << 24));
+}
+
+
+
 // Scale the derivs as dictated by 'width', and also make sure
 // they are all some minimum value to make the subsequent math clean.
 inline void
@@ -1585,6 +2376,7 @@ TextureSystemImpl::texture_lookup_trilinear_mipmap(
         &TextureSystemImpl::sample_bilinear,
         &TextureSystemImpl::sample_bicubic,
         &TextureSystemImpl::sample_bilinear,
+        &TextureSystemImpl::sample_closest,
     };
     sampler_prototype sampler = sample_functions[(int)options.interpmode];
 
@@ -1636,6 +2428,9 @@ TextureSystemImpl::texture_lookup_trilinear_mipmap(
     case TextureOpt::InterpSmartBicubic:
         stats.bilinear_interps += npointson;
         break;
+    case TextureOpt::InterpStochasticBilinear:
+        stats.closest_interps += npointson;
+        break;
     }
     return ok;
 }
@@ -1841,6 +2636,29 @@ TextureSystemImpl::texture_lookup(TextureFile& texturefile,
     }
 #endif
 
+    if (options.interpmode == TextureOpt::InterpStochasticBilinear
+        && nsamples > 1) {
+        // Rather than probing every sample along the major axis, pick
+        // just one of them with probability proportional to its filter
+        // weight, and give it the whole weight.
+        float totalweight = 0.0f;
+        for (int sample = 0; sample < nsamples; ++sample)
+            totalweight += lineweight[sample];
+        float u    = stochastic_deviate(options.rnd, 0, 0) * totalweight;
+        int picked = nsamples - 1;
+        for (int sample = 0; sample < nsamples - 1; ++sample) {
+            u -= lineweight[sample];
+            if (u < 0.0f) {
+                picked = sample;
+                break;
+            }
+        }
+        sval[0]       = sval[picked];
+        tval[0]       = tval[picked];
+        lineweight[0] = totalweight;
+        nsamples      = 1;
+    }
+
     vfloat4 r_sum, drds_sum, drdt_sum;
     r_sum.clear();
     if (dresultds) {
@@ -1860,6 +2678,16 @@ TextureSystemImpl::texture_lookup(TextureFile& texturefile,
                                  actualchannels, lineweight, &r, NULL, NULL);
             ++closestprobes;
             break;
+        case TextureOpt::InterpStochasticBilinear:
+            ok &= sample_closest(nsamples, sval, tval, lev, texturefile,
+                                 thread_info, options, nchannels_result,
+                                 actualchannels, lineweight, &r, NULL, NULL);
+            if (dresultds) {
+                drds.clear();
+                drdt.clear();
+            }
+            ++closestprobes;
+            break;
         case TextureOpt::InterpBilinear:
             ok &= sample_bilinear(nsamples, sval, tval, lev, texturefile,
                                   thread_info, options, nchannels_result,
@@ -1928,6 +2756,199 @@ TextureSystemImpl::texture_lookup(TextureFile& texturefile,
 
 
 
+bool
+TextureSystemImpl::texture_lookup_ewa(
+    TextureFile& texturefile, PerThreadInfo* thread_info, TextureOpt& options,
+    int nchannels_result, int actualchannels, float s, float t, float dsdx_,
+    float dtdx_, float dsdy_, float dtdy_, float* result, float* dresultds,
+    float* dresultdt)
+{
+    OIIO_DASSERT((dresultds == NULL) == (dresultdt == NULL));
+
+    float dsdx = dsdx_, dtdx = dtdx_, dsdy = dsdy_, dtdy = dtdy_;
+    adjust_width(dsdx, dtdx, dsdy, dtdy, options.swidth, options.twidth);
+    float majorlength, minorlength, theta;
+    ellipse_axes(dsdx, dtdx, dsdy, dtdy, majorlength, minorlength, theta);
+    adjust_blur(majorlength, minorlength, theta, options.sblur, options.tblur);
+    float aspect, trueaspect;
+    aspect = anisotropic_aspect(majorlength, minorlength, options, trueaspect);
+
+    // Filter within just one MIP level: the finer of the pair trilinear
+    // filtering would blend, where the minor axis is one to two texels.
+    int miplevel[2]      = { -1, -1 };
+    float levelweight[2] = { 0, 0 };
+    compute_miplevels(texturefile, options, majorlength, minorlength, aspect,
+                      miplevel, levelweight);
+    int miplevel0 = miplevel[0];
+    const ImageSpec& spec(texturefile.spec(options.subimage, miplevel0));
+    const ImageCacheFile::LevelInfo& levelinfo(
+        texturefile.levelinfo(options.subimage, miplevel0));
+
+    // The ellipse axes in texel units at this level, and from them the
+    // implicit ellipse A*u^2 + B*u*v + C*v^2 < 1. Adding 1 to A and C
+    // (a unit reconstruction filter) keeps magnified lookups from
+    // collapsing to fewer texels than a bilinear lookup would use.
+    float sintheta, costheta;
+    sincos(theta, &sintheta, &costheta);
+    float ax = majorlength * costheta * spec.width;
+    float ay = majorlength * sintheta * spec.height;
+    float bx = -minorlength * sintheta * spec.width;
+    float by = minorlength * costheta * spec.height;
+    float A  = ay * ay + by * by + 1.0f;
+    float B  = -2.0f * (ax * ay + bx * by);
+    float C  = ax * ax + bx * bx + 1.0f;
+    float Finv = 1.0f / (A * C - 0.25f * B * B);
+    A *= Finv;
+    B *= Finv;
+    C *= Finv;
+
+    // Bounding box of the ellipse, in texels.
+    int stex, ttex;
+    float sfrac, tfrac;
+    st_to_texel(s, t, texturefile, spec, stex, ttex, sfrac, tfrac);
+    float sc   = stex + sfrac;
+    float tc   = ttex + tfrac;
+    float det  = 4.0f * A * C - B * B;
+    float uext = 2.0f * sqrtf(C / det);
+    float vext = 2.0f * sqrtf(A / det);
+    int s0 = (int)ceilf(sc - uext), s1 = (int)floorf(sc + uext);
+    int t0 = (int)ceilf(tc - vext), t1 = (int)floorf(tc + vext);
+    if (!(det > 0.0f)
+        || (int64_t(s1 - s0 + 1) * int64_t(t1 - t0 + 1)) > ewa_max_texels)
+        return texture_lookup(texturefile, thread_info, options,
+                              nchannels_result, actualchannels, s, t, dsdx_,
+                              dtdx_, dsdy_, dtdy_, result, dresultds,
+                              dresultdt);
+
+    TypeDesc::BASETYPE pixeltype = texturefile.pixeltype(options.subimage);
+    wrap_impl swrap_func         = wrap_functions[(int)options.swrap];
+    wrap_impl twrap_func         = wrap_functions[(int)options.twrap];
+    int tile_chbegin = 0, tile_chend = spec.nchannels;
+    if (spec.nchannels > m_max_tile_channels) {
+        // For files with many channels, narrow the range we cache
+        tile_chbegin = options.firstchannel;
+        tile_chend   = options.firstchannel + actualchannels;
+    }
+    TileID id(texturefile, options.subimage, miplevel0, 0, 0, 0, tile_chbegin,
+              tile_chend);
+    size_t channelsize = TypeDesc(pixeltype).size();
+
+    vfloat4 accum, daccumds, daccumdt;
+    accum.clear();
+    daccumds.clear();
+    daccumdt.clear();
+    float sumw = 0.0f, validw = 0.0f, sumdwds = 0.0f, sumdwdt = 0.0f;
+    int ntexels = 0;
+    bool allok  = true;
+    vfloat4 iota  = vfloat4::Iota();
+    vfloat4 ulast = vfloat4(float(s1) - sc);
+    for (int tt = t0; tt <= t1; ++tt) {
+        float v = float(tt) - tc;
+        vfloat4 Bv(B * v), Cvv(C * v * v);
+        // Evaluate the ellipse equation and look up the weights for four
+        // texels of the row at a time, then fetch only the ones inside.
+        for (int ss = s0; ss <= s1; ss += 4) {
+            vfloat4 u  = vfloat4(float(ss) - sc) + iota;
+            vfloat4 r2 = (A * u + Bv) * u + Cvv;
+            int inside = ((r2 < 1.0f) & (u <= ulast)).bitmask();
+            if (!inside)
+                continue;
+            OIIO_SIMD4_ALIGN int lutindex[4];
+            vint4(min(r2, vfloat4::One()) * float(ewa_lut_size - 1))
+                .store(lutindex);
+            for (int i = 0; i < 4; ++i) {
+                if (!(inside & (1 << i)))
+                    continue;
+                float w    = ewa_weights.w[lutindex[i]];
+                float dwds = 0.0f, dwdt = 0.0f;
+                sumw += w;
+                if (dresultds) {
+                    // Derivatives of the weight with respect to moving the
+                    // center of the ellipse, in texels.
+                    float g = ewa_alpha * (w + expf(-ewa_alpha));
+                    dwds    = g * (2.0f * A * u[i] + B * v);
+                    dwdt    = g * (B * u[i] + 2.0f * C * v);
+                    sumdwds += dwds;
+                    sumdwdt += dwdt;
+                }
+
+                int x = ss + i, y = tt;
+                bool svalid = swrap_func(x, spec.x, spec.width);
+                bool tvalid = twrap_func(y, spec.y, spec.height);
+                if (!levelinfo.full_pixel_range) {
+                    svalid &= (x >= spec.x && x < (spec.x + spec.width));
+                    tvalid &= (y >= spec.y && y < (spec.y + spec.height));
+                }
+                if (!(svalid & tvalid))
+                    continue;  // black wrap
+                int tile_s = (x - spec.x) % spec.tile_width;
+                int tile_t = (y - spec.y) % spec.tile_height;
+                id.xy(x - tile_s, y - tile_t);
+                bool ok = find_tile(id, thread_info, ntexels == 0);
+                if (!ok)
+                    error("{}", m_imagecache->geterror());
+                TileRef& tile(thread_info->tile);
+                if (!tile || !ok) {
+                    allok = false;
+                    continue;
+                }
+                ++ntexels;
+                size_t offset = id.nchannels()
+                                    * tile->pixel_index(tile_s, tile_t)
+                                + (options.firstchannel - id.chbegin());
+                const unsigned char* texelptr = tile->bytedata()
+                                                + offset * channelsize;
+                vfloat4 texel = texel_to_float4(pixeltype, texelptr);
+                validw += w;
+                accum += w * texel;
+                if (dresultds) {
+                    daccumds += dwds * texel;
+                    daccumdt += dwdt * texel;
+                }
+            }
+        }
+    }
+
+    ImageCacheStatistics& stats(thread_info->m_stats);
+    ++stats.ewa_queries;
+    stats.ewa_texels += ntexels;
+    if (trueaspect > stats.max_aniso)
+        stats.max_aniso = trueaspect;
+
+    if (!(sumw > 0.0f)) {
+        // No texel centers inside the ellipse at all (can only happen for
+        // degenerate input), so just take a bilinear sample at the center.
+        OIIO_SIMD4_ALIGN float sval[4]   = { s, 0.0f, 0.0f, 0.0f };
+        OIIO_SIMD4_ALIGN float tval[4]   = { t, 0.0f, 0.0f, 0.0f };
+        static OIIO_SIMD4_ALIGN float one[4] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        return sample_bilinear(1, sval, tval, miplevel0, texturefile,
+                               thread_info, options, nchannels_result,
+                               actualchannels, one, (vfloat4*)result,
+                               (vfloat4*)dresultds, (vfloat4*)dresultdt);
+    }
+
+    float invw                = 1.0f / sumw;
+    vfloat4 r                 = accum * invw;
+    simd::vbool4 channel_mask = channel_masks[actualchannels];
+    if (dresultds) {
+        // d(sum(w*texel)/sum(w)), converted from texels to s and t units.
+        vfloat4 drds = (daccumds - r * sumdwds) * (invw * spec.width);
+        vfloat4 drdt = (daccumdt - r * sumdwdt) * (invw * spec.height);
+        *(simd::vfloat4*)(dresultds) = blend0(drds, channel_mask);
+        *(simd::vfloat4*)(dresultdt) = blend0(drdt, channel_mask);
+    }
+    r             = blend0(r, channel_mask);
+    float nonfill = validw * invw;
+    if (nonfill < 1.0f && nchannels_result > actualchannels && options.fill) {
+        // Add the weighted fill color
+        r += blend0not(vfloat4((1.0f - nonfill) * options.fill), channel_mask);
+    }
+    *(simd::vfloat4*)(result) = r;
+    return allok;
+}
+
+
+
 const float*
 TextureSystemImpl::pole_color(TextureFile& texturefile,
                               PerThreadInfo* /*thread_info*/,
@@ -2044,6 +3065,8 @@ TextureSystemImpl::sample_closest(
     }
     TileID id(texturefile, options.subimage, miplevel, 0, 0, 0, tile_chbegin,
               tile_chend);
+    bool stochastic = (options.interpmode
+                       == TextureOpt::InterpStochasticBilinear);
     for (int sample = 0; sample < nsamples; ++sample) {
         float s = s_[sample], t = t_[sample];
         float weight = weight_[sample];
@@ -2052,10 +3075,19 @@ TextureSystemImpl::sample_closest(
         float sfrac, tfrac;
         st_to_texel(s, t, texturefile, spec, stex, ttex, sfrac, tfrac);
 
-        if (sfrac > 0.5f)
-            ++stex;
-        if (tfrac > 0.5f)
-            ++ttex;
+        if (stochastic) {
+            // Choose one of the four bilinear texels, each with
+            // probability equal to its bilinear weight.
+            if (stochastic_deviate(options.rnd, sample, 1) < sfrac)
+                ++stex;
+            if (stochastic_deviate(options.rnd, sample, 2) < tfrac)
+                ++ttex;
+        } else {
+            if (sfrac > 0.5f)
+                ++stex;
+            if (tfrac > 0.5f)
+                ++ttex;
+        }
 
         // Wrap
         bool svalid, tvalid;  // Valid texels?  false means black border
@@ -2246,6 +3278,8 @@ TextureSystemImpl::sample_bilinear(
         }
 
         simd::vfloat4 texel_simd[2][2];
+        simd::vfloat4 texel_bilerp;
+        bool have_bilerp    = false;
         simd::vint4 tile_st = (simd::vint4(simd::shuffle<S0, S0, T0, T0>(sttex))
                                - xy);
         if (tilepow2)
@@ -2271,7 +3305,24 @@ TextureSystemImpl::sample_bilinear(
             const unsigned char* p = tile->bytedata() + offset
                                      + channelsize
                                            * (firstchannel - id.chbegin());
-            if (pixeltype == TypeDesc::UINT8) {
+            if (!daccumds_) {
+                // Without derivatives we don't need the individual texels,
+                // so filter in the tile's native format.
+                int rowbytes = pixelsize * spec.tile_width;
+                if (pixeltype == TypeDesc::UINT8)
+                    texel_bilerp = bilerp_texels<unsigned char>(
+                        p, pixelsize, rowbytes, sfrac, tfrac);
+                else if (pixeltype == TypeDesc::UINT16)
+                    texel_bilerp = bilerp_texels<unsigned short>(
+                        p, pixelsize, rowbytes, sfrac, tfrac);
+                else if (pixeltype == TypeDesc::HALF)
+                    texel_bilerp = bilerp_texels<half>(p, pixelsize, rowbytes,
+                                                       sfrac, tfrac);
+                else
+                    texel_bilerp = bilerp_texels<float>(p, pixelsize,
+                                                        rowbytes, sfrac, tfrac);
+                have_bilerp = true;
+            } else if (pixeltype == TypeDesc::UINT8) {
                 texel_simd[0][0] = uchar2float4(p);
                 texel_simd[0][1] = uchar2float4(p + pixelsize);
                 p += pixelsize * spec.tile_width;
@@ -2365,9 +3416,12 @@ TextureSystemImpl::sample_bilinear(
         }
 
         simd::vfloat4 weight_simd = weight;
-        accum += weight_simd
-                 * bilerp(texel_simd[0][0], texel_simd[0][1], texel_simd[1][0],
-                          texel_simd[1][1], sfrac, tfrac);
+        if (have_bilerp)
+            accum += weight_simd * texel_bilerp;
+        else
+            accum += weight_simd
+                     * bilerp(texel_simd[0][0], texel_simd[0][1],
+                              texel_simd[1][0], texel_simd[1][1], sfrac, tfrac);
         if (daccumds_) {
             simd::vfloat4 scalex = weight_simd * float(spec.width);
             simd::vfloat4 scaley = weight_simd * float(spec.height);
@@ -2493,6 +3547,38 @@ namespace {
 #endif
     }
 
+#if OIIO_SIMD_AVX >= 2
+    // Sum of the 4x4 texels weighted by the separable weights wx (by
+    // column) and wy (by row), with each row of texels in one vfloat16 or
+    // two vfloat8's. The B-spline weights are non-negative, so like the
+    // lerp formulation this can't make negative results from non-negative
+    // texels.
+    inline vfloat4 bicubic_sum_wide(const vfloat4 texel[4][4],
+                                    const vfloat4& wx, const vfloat4& wy)
+    {
+#    if OIIO_SIMD_AVX >= 512
+        vfloat16 wx16(shuffle<0>(wx), shuffle<1>(wx), shuffle<2>(wx),
+                      shuffle<3>(wx));
+        vfloat16 sum = vfloat16::Zero();
+        for (int j = 0; j < 4; ++j)
+            sum = madd(vfloat16(texel[j][0], texel[j][1], texel[j][2],
+                                texel[j][3]),
+                       wx16 * vfloat16(wy[j]), sum);
+        vfloat8 sum8 = sum.lo() + sum.hi();
+#    else
+        vfloat8 wx01(shuffle<0>(wx), shuffle<1>(wx));
+        vfloat8 wx23(shuffle<2>(wx), shuffle<3>(wx));
+        vfloat8 sum8 = vfloat8::Zero();
+        for (int j = 0; j < 4; ++j) {
+            vfloat8 wyj(wy[j]);
+            sum8 = madd(vfloat8(texel[j][0], texel[j][1]), wx01 * wyj, sum8);
+            sum8 = madd(vfloat8(texel[j][2], texel[j][3]), wx23 * wyj, sum8);
+        }
+#    endif
+        return sum8.lo() + sum8.hi();
+    }
+#endif
+
 }  // anonymous namespace
 
 
@@ -2576,18 +3662,29 @@ TextureSystemImpl::sample_bicubic(
         simd::vint4 stex, ttex;  // Texel coords for each row and column
         stex                = sint + (*(vint4*)iota_1);
         ttex                = tint + (*(vint4*)iota_1);
-        simd::vbool4 svalid = swrap_func_simd(stex, spec_x_simd,
-                                              spec_width_simd);
-        simd::vbool4 tvalid = twrap_func_simd(ttex, spec_y_simd,
-                                              spec_height_simd);
-        bool allvalid       = reduce_and(svalid & tvalid);
-        bool anyvalid       = reduce_or(svalid | tvalid);
-        if (!levelinfo.full_pixel_range && anyvalid) {
-            // Handle case of crop windows or overscan
-            svalid &= (stex >= spec_x_simd) & (stex < spec_x_plus_width_simd);
-            tvalid &= (ttex >= spec_y_simd) & (ttex < spec_y_plus_height_simd);
+        simd::vbool4 svalid, tvalid;
+        bool allvalid, anyvalid;
+        if (sint > spec.x && sint + 3 < spec.x + spec.width && tint > spec.y
+            && tint + 3 < spec.y + spec.height) {
+            // The whole footprint is inside the data window (and clear of
+            // a shared border's duplicate last column/row), where every
+            // wrap mode leaves the coordinates alone.
+            svalid = tvalid = vbool4::True();
+            allvalid = anyvalid = true;
+        } else {
+            svalid   = swrap_func_simd(stex, spec_x_simd, spec_width_simd);
+            tvalid   = twrap_func_simd(ttex, spec_y_simd, spec_height_simd);
             allvalid = reduce_and(svalid & tvalid);
             anyvalid = reduce_or(svalid | tvalid);
+            if (!levelinfo.full_pixel_range && anyvalid) {
+                // Handle case of crop windows or overscan
+                svalid &= (stex >= spec_x_simd)
+                          & (stex < spec_x_plus_width_simd);
+                tvalid &= (ttex >= spec_y_simd)
+                          & (ttex < spec_y_plus_height_simd);
+                allvalid = reduce_and(svalid & tvalid);
+                anyvalid = reduce_or(svalid | tvalid);
+            }
         }
         if (!anyvalid) {
             // All texels we need were out of range and using 'black' wrap.
@@ -2792,6 +3889,18 @@ TextureSystemImpl::sample_bicubic(
         vfloat4 wx13_wy13 = AxyBxy(wx_1302, wy_1302);
         vfloat4 h         = wx13_wy13 / g;  // [ h0x h1x h0y h1y ]
 
+        simd::vfloat4 weight_simd = weight;
+#if OIIO_SIMD_AVX >= 2
+        // With 8 or 16 wide registers, do the filtering as a plain weighted
+        // sum over two or four texels (all their channels) per operation.
+        accum += weight_simd * bicubic_sum_wide(texel_simd, wx, wy);
+        if (daccumds_) {
+            simd::vfloat4 scalex = weight_simd * float(spec.width);
+            simd::vfloat4 scaley = weight_simd * float(spec.height);
+            daccumds += scalex * bicubic_sum_wide(texel_simd, dwx, wy);
+            daccumdt += scaley * bicubic_sum_wide(texel_simd, wx, dwy);
+        }
+#else
         simd::vfloat4 col[4];
         for (int j = 0; j < 4; ++j) {
             simd::vfloat4 lx = lerp(texel_simd[j][0], texel_simd[j][1],
@@ -2802,7 +3911,6 @@ TextureSystemImpl::sample_bicubic(
         }
         simd::vfloat4 ly          = lerp(col[0], col[1], shuffle<2>(h) /*h0y*/);
         simd::vfloat4 ry          = lerp(col[2], col[3], shuffle<3>(h) /*h1y*/);
-        simd::vfloat4 weight_simd = weight;
         accum += weight_simd * lerp(ly, ry, shuffle<3>(g) /*g1y*/);
         if (daccumds_) {
             simd::vfloat4 scalex = weight_simd * float(spec.width);
@@ -2850,6 +3958,7 @@ TextureSystemImpl::sample_bicubic(
                                     + wx[2] * texel_simd[3][2]
                                     + wx[3] * texel_simd[3][3]));
         }
+#endif
 
         // Compute appropriate amount of "fill" color to extra channels in
         // non-"black"-wrapped regions.
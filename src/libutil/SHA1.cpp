@@ -18,6 +18,19 @@
 
 #define SHA1_MAX_FILE_BUFFER (32 * 20 * 820)
 
+// Use the x86 SHA extensions, when the CPU has them, to compress whole
+// blocks in Update(). The digests are identical to the portable code.
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64)) \
+    && (defined(_MSC_VER) || defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 5))
+#define SHA1_SHANI 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#define SHA1_SHANI_TARGET
+#else
+#define SHA1_SHANI_TARGET __attribute__((target("sha,sse4.1")))
+#endif
+#endif
+
 // Rotate p_val32 by p_nBits bits to the left
 #ifndef ROL32
 #ifdef _MSC_VER
@@ -165,6 +178,61 @@ void CSHA1::Transform(UINT_32* pState, const UINT_8* pBuffer)
 #endif
 }
 
+#ifdef SHA1_SHANI
+// Four rounds k*4..k*4+3 with round function f. The message schedule
+// lives in the ring w[4]; e enters as the ABCD value from before the
+// previous group of rounds and leaves as the one from before this group.
+#define SHANI_QUAD(k,f) { \
+	if (k >= 4) \
+		w[k&3] = _mm_sha1msg2_epu32(_mm_xor_si128(_mm_sha1msg1_epu32(w[k&3], \
+			w[(k+1)&3]), w[(k+2)&3]), w[(k+3)&3]); \
+	e = (k == 0) ? _mm_add_epi32(e, w[0]) : _mm_sha1nexte_epu32(e, w[k&3]); \
+	__m128i prev = abcd; abcd = _mm_sha1rnds4_epu32(abcd, e, f); e = prev; }
+
+SHA1_SHANI_TARGET static void
+sha1_shani_blocks(UINT_32* pState, const UINT_8* pData, size_t nBlocks)
+{
+	// Byte-swap the big-endian message words, and put word 0 in lane 3
+	const __m128i bswap = _mm_set_epi64x(0x0001020304050607LL, 0x08090a0b0c0d0e0fLL);
+	__m128i abcd = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)pState), 0x1B);
+	__m128i e0 = _mm_set_epi32((int)pState[4], 0, 0, 0);
+	for( ; nBlocks; --nBlocks, pData += 64)
+	{
+		const __m128i abcd_save = abcd, e0_save = e0;
+		__m128i w[4], e = e0;
+		for(int i = 0; i < 4; ++i)
+			w[i] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pData + 16*i)), bswap);
+		SHANI_QUAD( 0,0); SHANI_QUAD( 1,0); SHANI_QUAD( 2,0); SHANI_QUAD( 3,0);
+		SHANI_QUAD( 4,0); SHANI_QUAD( 5,1); SHANI_QUAD( 6,1); SHANI_QUAD( 7,1);
+		SHANI_QUAD( 8,1); SHANI_QUAD( 9,1); SHANI_QUAD(10,2); SHANI_QUAD(11,2);
+		SHANI_QUAD(12,2); SHANI_QUAD(13,2); SHANI_QUAD(14,2); SHANI_QUAD(15,3);
+		SHANI_QUAD(16,3); SHANI_QUAD(17,3); SHANI_QUAD(18,3); SHANI_QUAD(19,3);
+		e0 = _mm_sha1nexte_epu32(e, e0_save);
+		abcd = _mm_add_epi32(abcd, abcd_save);
+	}
+	_mm_storeu_si128((__m128i*)pState, _mm_shuffle_epi32(abcd, 0x1B));
+	pState[4] = (UINT_32)_mm_extract_epi32(e0, 3);
+}
+
+#undef SHANI_QUAD
+
+static const bool sha1_use_shani = cpu_has_sha() && cpu_has_sse41();
+#endif
+
+// Compress nBlocks consecutive 64 byte blocks into pState
+void CSHA1::TransformBlocks(UINT_32* pState, const UINT_8* pData, size_t nBlocks)
+{
+#ifdef SHA1_SHANI
+	if(sha1_use_shani)
+	{
+		sha1_shani_blocks(pState, pData, nBlocks);
+		return;
+	}
+#endif
+	for( ; nBlocks; --nBlocks, pData += 64)
+		Transform(pState, pData);
+}
+
 void CSHA1::Update(const UINT_8* pbData, UINT_32 uLen)
 {
 	UINT_32 j = ((m_count[0] >> 3) & 0x3F);
@@ -179,10 +247,11 @@ void CSHA1::Update(const UINT_8* pbData, UINT_32 uLen)
 	{
 		i = 64 - j;
 		memcpy(&m_buffer[j], pbData, i);
-		Transform(m_state, m_buffer);
+		TransformBlocks(m_state, m_buffer, 1);
 
-		for( ; (i + 63) < uLen; i += 64)
-			Transform(m_state, &pbData[i]);
+		const UINT_32 nBlocks = (uLen - i) / 64;
+		TransformBlocks(m_state, &pbData[i], nBlocks);
+		i += nBlocks * 64;
 
 		j = 0;
 	}
@@ -272,6 +272,7 @@ public:
 private:
 	// Private SHA-1 transformation
 	void Transform(UINT_32* pState, const UINT_8* pBuffer);
+	void TransformBlocks(UINT_32* pState, const UINT_8* pData, size_t nBlocks);
 
 	// Member variables
 	UINT_32 m_state[5];
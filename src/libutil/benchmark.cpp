@@ -2,13 +2,29 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <numeric>
+#include <unordered_map>
 
 #include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
 
+#if defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/perf_event.h>)
+#        define OIIO_BENCHMARK_PERF_EVENTS 1
+#        include <linux/perf_event.h>
+#        include <sys/ioctl.h>
+#        include <sys/syscall.h>
+#        include <unistd.h>
+#    endif
+#endif
+
 
 OIIO_NAMESPACE_BEGIN
 
@@ -22,9 +38,105 @@ void OIIO_API
 {
 }
 
+
+
+// A group of hardware event counters for the calling thread: cycles (the
+// group leader), instructions, cache misses, and branch misses. Events the
+// kernel or CPU don't support are left out and read as 0; if even cycles
+// can't be counted, the group is not valid().
+class PerfEvents {
+public:
+    static const int nevents = 4;
+
+#ifdef OIIO_BENCHMARK_PERF_EVENTS
+    PerfEvents()
+    {
+        static const uint64_t config[nevents]
+            = { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS,
+                PERF_COUNT_HW_CACHE_MISSES, PERF_COUNT_HW_BRANCH_MISSES };
+        int nopen = 0;
+        for (int e = 0; e < nevents; ++e) {
+            perf_event_attr attr;
+            memset(&attr, 0, sizeof(attr));
+            attr.type           = PERF_TYPE_HARDWARE;
+            attr.size           = sizeof(attr);
+            attr.config         = config[e];
+            attr.disabled       = (e == 0);
+            attr.exclude_kernel = 1;
+            attr.exclude_hv     = 1;
+            attr.read_format    = PERF_FORMAT_GROUP;
+            int fd = int(syscall(__NR_perf_event_open, &attr, 0 /*this thread*/,
+                                 -1 /*any cpu*/, e ? m_fd[0] : -1, 0));
+            m_fd[e]   = fd;
+            m_slot[e] = fd >= 0 ? nopen++ : -1;
+            if (e == 0 && fd < 0)
+                break;  // No leader, no group
+        }
+    }
+
+    ~PerfEvents()
+    {
+        for (int fd : m_fd)
+            if (fd >= 0)
+                close(fd);
+    }
+
+    bool valid() const { return m_fd[0] >= 0; }
+
+    void start()
+    {
+        ioctl(m_fd[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(m_fd[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+
+    // Stop counting and retrieve the counts. Return true for success.
+    bool stop(double counts[nevents])
+    {
+        ioctl(m_fd[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+        uint64_t buf[1 + nevents];  // nr, then the values in opening order
+        if (::read(m_fd[0], buf, sizeof(buf)) < ssize_t(sizeof(uint64_t)))
+            return false;
+        for (int e = 0; e < nevents; ++e)
+            counts[e] = (m_slot[e] >= 0 && uint64_t(m_slot[e]) < buf[0])
+                            ? double(buf[1 + m_slot[e]])
+                            : 0.0;
+        return true;
+    }
+
+private:
+    int m_fd[nevents]   = { -1, -1, -1, -1 };
+    int m_slot[nevents] = { -1, -1, -1, -1 };
+#else
+    bool valid() const { return false; }
+    void start() {}
+    bool stop(double counts[nevents]) { return false; }
+#endif
+};
+
 }  // namespace pvt
 
 
+
+namespace {
+
+// The results of every benchmark in the process, which are written out
+// and/or compared to a baseline at exit, as the environment requests.
+struct ResultLog {
+    std::mutex mutex;
+    std::vector<Benchmarker::Result> results;
+    ~ResultLog();
+};
+
+static ResultLog&
+result_log()
+{
+    static ResultLog log;
+    return log;
+}
+
+}  // namespace
+
+
 // Implementation of clobber_ptr is trivial, but the code in other modules
 // doesn't know that.
 void OIIO_API
@@ -79,6 +191,23 @@ Benchmarker::compute_stats(std::vector<double>& times, size_t iterations)
         first += exclude_outliers();
         last -= exclude_outliers();
     }
+    if (m_outlier_mad > 0.0 && last - first >= 3) {
+        // Drop the trials too many median absolute deviations from the
+        // median. They're sorted, so those are at either end.
+        auto median_of = [](const double* v, size_t n) {
+            return (n & 1) ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+        };
+        double med = median_of(&times[first], last - first);
+        std::vector<double> dev(last - first);
+        for (size_t i = first; i < last; ++i)
+            dev[i - first] = std::abs(times[i] - med);
+        std::sort(dev.begin(), dev.end());
+        double limit = m_outlier_mad * median_of(dev.data(), dev.size());
+        while (last - first > 1 && med - times[first] > limit)
+            ++first;
+        while (last - first > 1 && times[last - 1] - med > limit)
+            --last;
+    }
     size_t nt = last - first;
     if (nt == 1) {
         m_avg    = times[first];
@@ -97,10 +226,10 @@ Benchmarker::compute_stats(std::vector<double>& times, size_t iterations)
         m_range     = times[last - 1] - times[first];
     }
 
-    if (m_trials & 1)  // odd
-        m_median = times[m_trials / 2];
+    if (trials & 1)  // odd
+        m_median = times[trials / 2];
     else
-        m_median = 0.5 * (times[m_trials / 2] + times[m_trials / 2 + 1]);
+        m_median = 0.5 * (times[trials / 2 - 1] + times[trials / 2]);
 
     m_avg /= iterations;
     m_stddev /= iterations;
@@ -110,6 +239,374 @@ Benchmarker::compute_stats(std::vector<double>& times, size_t iterations)
 
 
 
+void
+Benchmarker::counters_begin()
+{
+    m_counters = Counters();
+    m_counter_samples.clear();
+    if (!m_hw_counters)
+        return;
+    if (!m_perf)
+        m_perf = std::make_shared<pvt::PerfEvents>();
+    if (m_perf->valid())
+        m_counter_samples.resize(m_trials * pvt::PerfEvents::nevents);
+}
+
+
+
+void
+Benchmarker::counters_start()
+{
+    if (m_counter_samples.size())
+        m_perf->start();
+}
+
+
+
+void
+Benchmarker::counters_stop(size_t trial)
+{
+    if (m_counter_samples.empty())
+        return;
+    double* counts = &m_counter_samples[trial * pvt::PerfEvents::nevents];
+    if (m_perf->stop(counts))
+        for (int e = 0; e < pvt::PerfEvents::nevents; ++e)
+            counts[e] /= double(m_iterations);
+    else
+        m_counter_samples.clear();
+}
+
+
+
+void
+Benchmarker::counters_end()
+{
+    const int nevents = pvt::PerfEvents::nevents;
+    if (m_counter_samples.size() != m_trials * nevents)
+        return;
+    double* fields[nevents] = { &m_counters.cycles, &m_counters.instructions,
+                                &m_counters.cache_misses,
+                                &m_counters.branch_misses };
+    std::vector<double> v(m_trials);
+    for (int e = 0; e < nevents; ++e) {
+        for (size_t t = 0; t < m_trials; ++t)
+            v[t] = m_counter_samples[t * nevents + e];
+        std::nth_element(v.begin(), v.begin() + m_trials / 2, v.end());
+        *fields[e] = v[m_trials / 2];
+    }
+    m_counters.valid = true;
+}
+
+
+
+Benchmarker::Result
+Benchmarker::result() const
+{
+    Result r;
+    r.name       = m_name;
+    r.trials     = m_trials;
+    r.iterations = m_iterations;
+    r.work       = m_work;
+    r.avg        = m_avg;
+    r.stddev     = m_stddev;
+    r.range      = m_range;
+    r.median     = m_median;
+    r.counters   = m_counters;
+    return r;
+}
+
+
+
+void
+Benchmarker::record_result()
+{
+    ResultLog& log(result_log());
+    std::lock_guard<std::mutex> lock(log.mutex);
+    log.results.push_back(result());
+}
+
+
+
+std::vector<Benchmarker::Result>
+Benchmarker::all_results()
+{
+    ResultLog& log(result_log());
+    std::lock_guard<std::mutex> lock(log.mutex);
+    return log.results;
+}
+
+
+
+static std::string
+json_quote(string_view s)
+{
+    std::string r = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\')
+            r += '\\';
+        if ((unsigned char)c < ' ')
+            r += Strutil::fmt::format("\\u{:04x}", int(c));
+        else
+            r += c;
+    }
+    return r + "\"";
+}
+
+
+
+static std::string
+csv_quote(string_view s)
+{
+    return "\"" + Strutil::replace(s, "\"", "\"\"", true) + "\"";
+}
+
+
+
+bool
+Benchmarker::write_results(string_view filename)
+{
+    return write_results(filename, all_results());
+}
+
+
+
+bool
+Benchmarker::write_results(string_view filename,
+                           const std::vector<Result>& results)
+{
+    bool csv = Strutil::iends_with(filename, ".csv");
+    std::string text;
+    if (csv)
+        text = "name,trials,iterations,work,avg_ns,stddev_ns,range_ns,"
+               "median_ns,cycles,instructions,cache_misses,branch_misses\n";
+    else
+        text = "{\"benchmarks\": [\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& r(results[i]);
+        const Counters& c(r.counters);
+        if (csv) {
+            text += Strutil::fmt::format("{},{},{},{},{},{},{},{}",
+                                         csv_quote(r.name), r.trials,
+                                         r.iterations, r.work, r.avg * 1e9,
+                                         r.stddev * 1e9, r.range * 1e9,
+                                         r.median * 1e9);
+            if (c.valid)
+                text += Strutil::fmt::format(",{},{},{},{}\n", c.cycles,
+                                             c.instructions, c.cache_misses,
+                                             c.branch_misses);
+            else
+                text += ",,,,\n";
+        } else {
+            text += Strutil::fmt::format(
+                "  {{\"name\": {}, \"trials\": {}, \"iterations\": {}, "
+                "\"work\": {}, \"avg_ns\": {}, \"stddev_ns\": {}, "
+                "\"range_ns\": {}, \"median_ns\": {}",
+                json_quote(r.name), r.trials, r.iterations, r.work,
+                r.avg * 1e9, r.stddev * 1e9, r.range * 1e9, r.median * 1e9);
+            if (c.valid)
+                text += Strutil::fmt::format(
+                    ", \"cycles\": {}, \"instructions\": {}, "
+                    "\"cache_misses\": {}, \"branch_misses\": {}",
+                    c.cycles, c.instructions, c.cache_misses,
+                    c.branch_misses);
+            text += (i + 1 < results.size()) ? "},\n" : "}\n";
+        }
+    }
+    if (!csv)
+        text += "]}\n";
+    return Filesystem::write_text_file(filename, text);
+}
+
+
+
+// Parse the number following `"key": ` in a line of JSON results.
+static double
+json_number(string_view line, string_view key, bool* found = nullptr)
+{
+    std::string pattern = "\"" + std::string(key) + "\": ";
+    size_t pos          = line.find(pattern);
+    if (found)
+        *found = (pos != string_view::npos);
+    if (pos == string_view::npos)
+        return 0.0;
+    line.remove_prefix(pos + pattern.size());
+    return Strutil::stod(line);
+}
+
+
+
+// Parse a quoted string at the start of `s`, as written by json_quote or
+// csv_quote, and advance `s` past it. Return false if there isn't one.
+static bool
+parse_quoted(string_view& s, std::string& result, bool csv)
+{
+    if (!Strutil::parse_char(s, '"'))
+        return false;
+    result.clear();
+    while (s.size()) {
+        char c = s.front();
+        s.remove_prefix(1);
+        if (c == '"') {
+            if (!csv || s.empty() || s.front() != '"')
+                return true;
+            s.remove_prefix(1);  // "" is a quote in CSV
+        } else if (c == '\\' && !csv && s.size()) {
+            c = s.front();
+            s.remove_prefix(1);
+            if (c == 'u' && s.size() >= 4) {
+                c = char(strtol(std::string(s.substr(0, 4)).c_str(), nullptr,
+                                16));
+                s.remove_prefix(4);
+            }
+        }
+        result += c;
+    }
+    return false;
+}
+
+
+
+bool
+Benchmarker::read_results(string_view filename, std::vector<Result>& results)
+{
+    std::string text;
+    if (!Filesystem::read_text_file(filename, text))
+        return false;
+    bool csv = Strutil::iends_with(filename, ".csv");
+    bool ok  = true;
+    for (string_view line : Strutil::splitsv(text, "\n")) {
+        Result r;
+        Counters& c(r.counters);
+        string_view s = Strutil::strip(line);
+        if (csv) {
+            if (s.empty() || Strutil::starts_with(s, "name,"))
+                continue;
+            std::vector<std::string> f;
+            if (!parse_quoted(s, r.name, true)
+                || !Strutil::parse_char(s, ',')) {
+                ok = false;
+                continue;
+            }
+            Strutil::split(s, f, ",");
+            if (f.size() < 7) {
+                ok = false;
+                continue;
+            }
+            r.trials     = Strutil::from_string<uint64_t>(f[0]);
+            r.iterations = Strutil::from_string<uint64_t>(f[1]);
+            r.work       = Strutil::from_string<uint64_t>(f[2]);
+            r.avg        = Strutil::stod(f[3]) * 1e-9;
+            r.stddev     = Strutil::stod(f[4]) * 1e-9;
+            r.range      = Strutil::stod(f[5]) * 1e-9;
+            r.median     = Strutil::stod(f[6]) * 1e-9;
+            if (f.size() >= 11 && f[7].size()) {
+                c.valid         = true;
+                c.cycles        = Strutil::stod(f[7]);
+                c.instructions  = Strutil::stod(f[8]);
+                c.cache_misses  = Strutil::stod(f[9]);
+                c.branch_misses = Strutil::stod(f[10]);
+            }
+        } else {
+            if (!Strutil::parse_prefix(s, "{\"name\": "))
+                continue;  // Not a result line
+            if (!parse_quoted(s, r.name, false)) {
+                ok = false;
+                continue;
+            }
+            r.trials     = size_t(json_number(s, "trials"));
+            r.iterations = size_t(json_number(s, "iterations"));
+            r.work       = size_t(json_number(s, "work"));
+            r.avg        = json_number(s, "avg_ns") * 1e-9;
+            r.stddev     = json_number(s, "stddev_ns") * 1e-9;
+            r.range      = json_number(s, "range_ns") * 1e-9;
+            r.median     = json_number(s, "median_ns") * 1e-9;
+            c.cycles        = json_number(s, "cycles", &c.valid);
+            c.instructions  = json_number(s, "instructions");
+            c.cache_misses  = json_number(s, "cache_misses");
+            c.branch_misses = json_number(s, "branch_misses");
+        }
+        results.push_back(r);
+    }
+    return ok;
+}
+
+
+
+// Report the results that got slower than their baseline by more than the
+// threshold fraction, and return how many did.
+static int
+compare_results(const std::vector<Benchmarker::Result>& results,
+                const std::vector<Benchmarker::Result>& baseline,
+                double threshold, std::ostream* out)
+{
+    std::unordered_map<std::string, double> base;
+    for (auto& b : baseline)
+        base[b.name] = b.median;
+    int compared = 0, regressed = 0;
+    for (auto& r : results) {
+        auto found = base.find(r.name);
+        if (found == base.end() || found->second <= 0.0)
+            continue;
+        ++compared;
+        double change = r.median / found->second - 1.0;
+        if (change > threshold) {
+            ++regressed;
+            if (out)
+                (*out) << Strutil::fmt::format(
+                    "  REGRESSION {:<16}: {:.1f} ns -> {:.1f} ns ({:+.1f}%)\n",
+                    r.name, found->second * 1e9, r.median * 1e9,
+                    change * 100.0);
+        }
+    }
+    if (out)
+        (*out) << Strutil::fmt::format(
+            "{} of {} benchmarks compared to the baseline were more than "
+            "{:.1f}% slower\n",
+            regressed, compared, threshold * 100.0);
+    return regressed;
+}
+
+
+
+int
+Benchmarker::compare_to_baseline(string_view filename, double threshold,
+                                 std::ostream* out)
+{
+    std::vector<Result> baseline;
+    if (!read_results(filename, baseline)) {
+        if (out)
+            (*out) << "Could not read benchmark baseline \"" << filename
+                   << "\"\n";
+        return -1;
+    }
+    return compare_results(all_results(), baseline, threshold, out);
+}
+
+
+
+ResultLog::~ResultLog()
+{
+    std::string output = Sysutil::getenv("OIIO_BENCHMARK_OUTPUT");
+    if (output.size() && results.size()
+        && !Benchmarker::write_results(output, results))
+        std::cerr << "Could not write benchmark results to \"" << output
+                  << "\"\n";
+    std::string baseline_file = Sysutil::getenv("OIIO_BENCHMARK_BASELINE");
+    std::vector<Benchmarker::Result> baseline;
+    if (baseline_file.size() && results.size()) {
+        if (Benchmarker::read_results(baseline_file, baseline))
+            compare_results(results, baseline,
+                            Strutil::stod(Sysutil::getenv(
+                                "OIIO_BENCHMARK_THRESHOLD", "0.05")),
+                            &std::cout);
+        else
+            std::cerr << "Could not read benchmark baseline \""
+                      << baseline_file << "\"\n";
+    }
+}
+
+
+
 OIIO_API
 std::ostream&
 operator<<(std::ostream& out, const Benchmarker& bench)
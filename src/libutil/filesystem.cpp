@@ -10,12 +10,15 @@
 #include <iostream>
 #include <regex>
 #include <string>
+#include <unordered_map>
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/platform.h>
 // #include <OpenImageIO/refcnt.h>
 #include <OpenImageIO/strutil.h>
+#include <OpenImageIO/thread.h>
 #include <OpenImageIO/ustring.h>
 
 #ifdef _WIN32
@@ -24,9 +27,32 @@
 #    include <io.h>
 #    include <shellapi.h>
 #else
+#    include <sys/mman.h>
+#    include <sys/stat.h>
 #    include <unistd.h>
 #endif
 
+// io_uring lets pread_batch() keep a whole batch of reads in flight with
+// a single system call. We only need the kernel header, not liburing.
+#if defined(__linux__) && defined(__has_include)
+#    if __has_include(<linux/io_uring.h>)
+#        include <linux/io_uring.h>
+#        include <sys/syscall.h>
+#        include <sys/uio.h>
+#        if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter)
+#            define OIIO_HAS_IO_URING 1
+#        endif
+#    endif
+#endif
+#ifndef OIIO_HAS_IO_URING
+#    define OIIO_HAS_IO_URING 0
+#endif
+
+#ifdef __linux__
+#    include <poll.h>
+#    include <sys/inotify.h>
+#endif
+
 #include <boost/filesystem.hpp>
 namespace filesystem = boost::filesystem;
 using error_code     = boost::system::error_code;
@@ -256,30 +282,19 @@ Filesystem::get_directory_entries(const std::string& dirname,
                                   const std::string& filter_regex)
 {
     filenames.clear();
-    if (dirname.size() && !is_directory(dirname))
+    DirScanOptions options;
+    options.recursive = recursive;
+    std::vector<DirEntry> entries;
+    if (!scan_directory(dirname, entries, options))
         return false;
-    filesystem::path dirpath(dirname.size() ? u8path(dirname)
-                                            : filesystem::path("."));
-    std::regex re;
+    // Unlike scan_directory's filter, this one is searched for anywhere in
+    // the whole path.
     try {
-        re = std::regex(filter_regex);
-        if (recursive) {
-            error_code ec;
-            for (filesystem::recursive_directory_iterator s(dirpath, ec), end;
-                 !ec && s != end; s.increment(ec)) {
-                std::string file = pathstr(s->path());
-                if (!filter_regex.size() || std::regex_search(file, re))
-                    filenames.push_back(file);
-            }
-        } else {
-            error_code ec;
-            for (filesystem::directory_iterator s(dirpath, ec), end;
-                 !ec && s != end; s.increment(ec)) {
-                std::string file = pathstr(s->path());
-                if (!filter_regex.size() || std::regex_search(file, re))
-                    filenames.push_back(file);
-            }
-        }
+        std::regex re(filter_regex);
+        filenames.reserve(entries.size());
+        for (auto& e : entries)
+            if (!filter_regex.size() || std::regex_search(e.path, re))
+                filenames.push_back(std::move(e.path));
     } catch (...) {
         return false;
     }
@@ -288,6 +303,111 @@ Filesystem::get_directory_entries(const std::string& dirname,
 
 
 
+// List the one directory `dir` into `entries`, and when recursing, add
+// its subdirectories to `subdirs`.
+static void
+scan_one_directory(const filesystem::path& dir, const std::regex* filter,
+                   const Filesystem::DirScanOptions& options,
+                   std::vector<Filesystem::DirEntry>& entries,
+                   std::vector<filesystem::path>& subdirs)
+{
+    error_code ec;
+    for (filesystem::directory_iterator it(dir, ec), end; !ec && it != end;
+         it.increment(ec)) {
+        // The directory_entry caches the file type from the listing where
+        // the OS supplies it; only symlinks need another look.
+        error_code sec;
+        filesystem::file_status st = it->status(sec);
+        bool isdir                 = filesystem::is_directory(st);
+        if (isdir && options.recursive
+            && !filesystem::is_symlink(it->symlink_status(sec)))
+            subdirs.push_back(it->path());
+        bool isreg = filesystem::is_regular_file(st);
+        if (options.files_only && !isreg)
+            continue;
+        if (filter
+            && !std::regex_match(pathstr(it->path().filename()), *filter))
+            continue;
+        entries.emplace_back();
+        entries.back().path         = pathstr(it->path());
+        entries.back().is_directory = isdir;
+        entries.back().is_regular   = isreg;
+    }
+}
+
+
+
+bool
+Filesystem::scan_directory(const std::string& dirname,
+                           std::vector<DirEntry>& entries,
+                           const DirScanOptions& options)
+{
+    entries.clear();
+    if (dirname.size() && !is_directory(dirname))
+        return false;
+    std::regex filter;
+    if (options.filter_regex.size()) {
+        try {
+            filter = std::regex(options.filter_regex);
+        } catch (...) {
+            return false;
+        }
+    }
+    const std::regex* filterp = options.filter_regex.size() ? &filter
+                                                            : nullptr;
+    parallel_options popt(options.nthreads, Split_Y, 1);
+
+    // Breadth first, listing all the directories at each depth in
+    // parallel. Each directory's entries stay together, in listing order.
+    std::vector<filesystem::path> frontier;
+    frontier.push_back(dirname.size() ? u8path(dirname)
+                                      : filesystem::path("."));
+    while (frontier.size()) {
+        size_t n = frontier.size();
+        std::vector<std::vector<DirEntry>> found(n);
+        std::vector<std::vector<filesystem::path>> subdirs(n);
+        auto scan = [&](int64_t b, int64_t e) {
+            for (; b < e; ++b)
+                scan_one_directory(frontier[b], filterp, options, found[b],
+                                   subdirs[b]);
+        };
+        if (n == 1)
+            scan(0, 1);
+        else
+            parallel_for_chunked(0, int64_t(n), 1, scan, popt);
+        frontier.clear();
+        for (size_t i = 0; i < n; ++i) {
+            entries.insert(entries.end(),
+                           std::make_move_iterator(found[i].begin()),
+                           std::make_move_iterator(found[i].end()));
+            frontier.insert(frontier.end(), subdirs[i].begin(),
+                            subdirs[i].end());
+        }
+    }
+
+    if (options.stat && entries.size()) {
+        parallel_for_chunked(
+            0, int64_t(entries.size()), 16,
+            [&](int64_t b, int64_t e) {
+                for (; b < e; ++b) {
+                    DirEntry& d = entries[b];
+                    error_code ec;
+                    filesystem::path p = u8path(d.path);
+                    if (d.is_regular) {
+                        uintmax_t size = filesystem::file_size(p, ec);
+                        d.size         = ec ? 0 : uint64_t(size);
+                    }
+                    std::time_t t = filesystem::last_write_time(p, ec);
+                    d.mtime       = ec ? 0 : t;
+                }
+            },
+            popt);
+    }
+    return true;
+}
+
+
+
 bool
 Filesystem::path_is_absolute(string_view path, bool dot_is_absolute)
 {
@@ -916,20 +1036,18 @@ Filesystem::scan_for_matching_filenames(const std::string& pattern_,
     // are badly structured and might throw an exception.
     try {
         std::regex pattern_re(pattern_re_str);
-        error_code ec;
-        for (filesystem::directory_iterator it(u8path(directory), ec), end_it;
-             !ec && it != end_it; ++it) {
-            std::string itpath = Filesystem::generic_filepath(
-                it->path().string());
-            if (filesystem::is_regular(itpath, ec)) {
-                const std::string f = pathstr(itpath);
-                std::match_results<std::string::const_iterator> frame_match;
-                if (regex_match(f, frame_match, pattern_re)) {
-                    std::string thenumber(frame_match[1].first,
-                                          frame_match[1].second);
-                    int frame = Strutil::stoi(thenumber);
-                    matches.push_back(std::make_pair(frame, f));
-                }
+        DirScanOptions options;
+        options.files_only = true;
+        std::vector<DirEntry> entries;
+        scan_directory(directory, entries, options);
+        for (const auto& e : entries) {
+            const std::string f = Filesystem::generic_filepath(e.path);
+            std::match_results<std::string::const_iterator> frame_match;
+            if (regex_match(f, frame_match, pattern_re)) {
+                std::string thenumber(frame_match[1].first,
+                                      frame_match[1].second);
+                int frame = Strutil::stoi(thenumber);
+                matches.push_back(std::make_pair(frame, f));
             }
         }
 
@@ -1005,6 +1123,19 @@ Filesystem::IOProxy::pwrite(const void* /*buf*/, size_t /*size*/,
 
 
 
+bool
+Filesystem::IOProxy::pread_batch(span<ReadRequest> requests)
+{
+    bool ok = true;
+    for (auto& r : requests) {
+        r.result = pread(r.buf, r.size, r.offset);
+        ok &= (r.result == r.size);
+    }
+    return ok;
+}
+
+
+
 // Shared mutex to guard IOProxy error get/set. Shared should be ok. If
 // enough file I/O errors are happening that multiple threads are
 // simultaneously locking on error retrieval, the user has bigger problems
@@ -1120,6 +1251,213 @@ Filesystem::IOFile::pread(void* buf, size_t size, int64_t offset)
 #endif
 }
 
+
+
+#if OIIO_HAS_IO_URING
+namespace {
+
+// Minimal io_uring submission/completion ring, driven by the raw syscalls
+// so that we don't need liburing. Each thread that issues batched reads
+// gets its own ring (see io_uring_for_thread()), so there is exactly one
+// producer and one consumer and no locking is needed.
+class IOUringReader {
+public:
+    IOUringReader(unsigned entries = 64)
+    {
+        io_uring_params p;
+        memset(&p, 0, sizeof(p));
+        m_fd = int(syscall(__NR_io_uring_setup, entries, &p));
+        if (m_fd < 0)
+            return;  // No kernel support, or forbidden by policy
+        m_entries = p.sq_entries;
+        m_sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        m_cq_size = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        m_sqes_size = p.sq_entries * sizeof(io_uring_sqe);
+        m_sq = mmap(nullptr, m_sq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQ_RING);
+        m_cq = mmap(nullptr, m_cq_size, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_CQ_RING);
+        void* sqes = mmap(nullptr, m_sqes_size, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, m_fd, IORING_OFF_SQES);
+        if (m_sq == MAP_FAILED || m_cq == MAP_FAILED || sqes == MAP_FAILED) {
+            if (sqes != MAP_FAILED)
+                munmap(sqes, m_sqes_size);
+            teardown();
+            return;
+        }
+        char* sq     = (char*)m_sq;
+        char* cq     = (char*)m_cq;
+        m_sq_tail    = (unsigned*)(sq + p.sq_off.tail);
+        m_sq_mask    = *(unsigned*)(sq + p.sq_off.ring_mask);
+        m_sq_array   = (unsigned*)(sq + p.sq_off.array);
+        m_cq_head    = (unsigned*)(cq + p.cq_off.head);
+        m_cq_tail    = (unsigned*)(cq + p.cq_off.tail);
+        m_cq_mask    = *(unsigned*)(cq + p.cq_off.ring_mask);
+        m_cqes       = (io_uring_cqe*)(cq + p.cq_off.cqes);
+        m_sqes       = (io_uring_sqe*)sqes;
+    }
+
+    ~IOUringReader()
+    {
+        if (m_sqes)
+            munmap(m_sqes, m_sqes_size);
+        teardown();
+    }
+
+    bool valid() const { return m_fd >= 0; }
+    unsigned entries() const { return m_entries; }
+
+    // Submit the (at most entries()) reads from file descriptor fd and
+    // wait for all of them to complete, filling in each request's result.
+    // Return false if the ring itself failed, in which case the caller
+    // should fall back to plain pread for whatever is unfinished.
+    bool read(int fd, Filesystem::IOProxy::ReadRequest* reqs, unsigned n)
+    {
+        OIIO_DASSERT(n <= m_entries);
+        m_iov.resize(n);
+        unsigned tail = *m_sq_tail;  // only we write the tail
+        for (unsigned i = 0; i < n; ++i, ++tail) {
+            m_iov[i].iov_base = reqs[i].buf;
+            m_iov[i].iov_len  = reqs[i].size;
+            reqs[i].result    = 0;
+            unsigned idx      = tail & m_sq_mask;
+            io_uring_sqe* sqe = m_sqes + idx;
+            memset(sqe, 0, sizeof(*sqe));
+            // READV rather than READ so that 5.1 kernels work too
+            sqe->opcode    = IORING_OP_READV;
+            sqe->fd        = fd;
+            sqe->addr      = (unsigned long long)(uintptr_t)&m_iov[i];
+            sqe->len       = 1;
+            sqe->off       = (unsigned long long)reqs[i].offset;
+            sqe->user_data = i;
+            m_sq_array[idx] = idx;
+        }
+        __atomic_store_n(m_sq_tail, tail, __ATOMIC_RELEASE);
+
+        unsigned to_submit = n, done = 0;
+        while (done < n) {
+            int r = int(syscall(__NR_io_uring_enter, m_fd, to_submit,
+                                n - done, IORING_ENTER_GETEVENTS, nullptr,
+                                0));
+            if (r < 0 && errno != EINTR) {
+                if (to_submit) {
+                    // Nothing was consumed; retract the submissions.
+                    __atomic_store_n(m_sq_tail, tail - to_submit,
+                                     __ATOMIC_RELEASE);
+                    return false;
+                }
+                // Requests are in flight and we can't wait for them.
+                // Poison the ring so it is never reused.
+                m_broken = true;
+                return false;
+            }
+            if (r > 0)
+                to_submit -= std::min(to_submit, unsigned(r));
+            unsigned head  = *m_cq_head;
+            unsigned ctail = __atomic_load_n(m_cq_tail, __ATOMIC_ACQUIRE);
+            for (; head != ctail; ++head, ++done) {
+                const io_uring_cqe& cqe = m_cqes[head & m_cq_mask];
+                if (cqe.user_data < n && cqe.res > 0)
+                    reqs[cqe.user_data].result = size_t(cqe.res);
+            }
+            __atomic_store_n(m_cq_head, head, __ATOMIC_RELEASE);
+        }
+        return true;
+    }
+
+    bool broken() const { return m_broken; }
+
+private:
+    void teardown()
+    {
+        if (m_sq && m_sq != MAP_FAILED)
+            munmap(m_sq, m_sq_size);
+        if (m_cq && m_cq != MAP_FAILED)
+            munmap(m_cq, m_cq_size);
+        m_sq = m_cq = nullptr;
+        m_sqes      = nullptr;
+        if (m_fd >= 0)
+            ::close(m_fd);
+        m_fd = -1;
+    }
+
+    int m_fd           = -1;
+    unsigned m_entries = 0;
+    bool m_broken      = false;
+    void* m_sq         = nullptr;
+    void* m_cq         = nullptr;
+    size_t m_sq_size = 0, m_cq_size = 0, m_sqes_size = 0;
+    unsigned* m_sq_tail  = nullptr;
+    unsigned* m_sq_array = nullptr;
+    unsigned m_sq_mask   = 0;
+    unsigned* m_cq_head  = nullptr;
+    unsigned* m_cq_tail  = nullptr;
+    unsigned m_cq_mask   = 0;
+    io_uring_cqe* m_cqes = nullptr;
+    io_uring_sqe* m_sqes = nullptr;
+    std::vector<iovec> m_iov;
+};
+
+
+
+// Return this thread's ring, or nullptr if io_uring isn't usable. Setup
+// is attempted only once per thread.
+static IOUringReader*
+io_uring_for_thread()
+{
+    static thread_local std::unique_ptr<IOUringReader> ring;
+    static thread_local bool tried = false;
+    if (!tried) {
+        tried = true;
+        ring.reset(new IOUringReader);
+        if (!ring->valid())
+            ring.reset();
+    }
+    if (ring && ring->broken())
+        ring.reset();
+    return ring.get();
+}
+
+}  // namespace
+#endif
+
+
+
+bool
+Filesystem::IOFile::pread_batch(span<ReadRequest> requests)
+{
+    if (!m_file || m_mode != Read)
+        return false;
+#if OIIO_HAS_IO_URING
+    // A single read gains nothing from the ring.
+    IOUringReader* ring = requests.size() > 1 ? io_uring_for_thread()
+                                              : nullptr;
+    if (ring) {
+        int fd    = fileno(m_file);
+        bool ok   = true;
+        size_t nr = requests.size();
+        for (size_t i = 0; i < nr && ok; i += ring->entries()) {
+            unsigned n = unsigned(std::min(nr - i, size_t(ring->entries())));
+            ok         = ring->read(fd, requests.data() + i, n);
+        }
+        if (ok) {
+            // The kernel may return short reads; finish those the
+            // ordinary way.
+            for (auto& r : requests) {
+                if (r.result < r.size)
+                    r.result += pread((char*)r.buf + r.result,
+                                      r.size - r.result,
+                                      r.offset + int64_t(r.result));
+                ok &= (r.result == r.size);
+            }
+            return ok;
+        }
+        // Fall through to the serial path if the ring misbehaved
+    }
+#endif
+    return IOProxy::pread_batch(requests);
+}
+
 size_t
 Filesystem::IOFile::write(const void* buf, size_t size)
 {
@@ -1220,4 +1558,413 @@ Filesystem::IOMemReader::pread(void* buf, size_t size, int64_t offset)
 }
 
 
+
+cspan<unsigned char>
+Filesystem::IOMemReader::view(int64_t offset, size_t size) const
+{
+    if (offset < 0 || size_t(offset) >= m_buf.size())
+        return cspan<unsigned char>();
+    size = std::min(size, m_buf.size() - size_t(offset));
+    return cspan<unsigned char>(m_buf.data() + offset, size);
+}
+
+
+bool
+Filesystem::MappedFile::open(string_view filename)
+{
+    close();
+#ifdef _WIN32
+    std::wstring wfilename = Strutil::utf8_to_utf16(filename);
+    HANDLE file = CreateFileW(wfilename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                              NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (file == INVALID_HANDLE_VALUE)
+        return false;
+    LARGE_INTEGER len;
+    if (!GetFileSizeEx(file, &len) || len.QuadPart <= 0) {
+        CloseHandle(file);
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(file);  // The mapping keeps its own reference
+    if (!mapping)
+        return false;
+    void* ptr = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    if (!ptr) {
+        CloseHandle(mapping);
+        return false;
+    }
+    m_mapping = mapping;
+    m_data    = (const unsigned char*)ptr;
+    m_size    = size_t(len.QuadPart);
+    return true;
+#else
+    int fd = ::open(std::string(filename).c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+    void* ptr = mmap(nullptr, size_t(st.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);  // The mapping stays valid after the descriptor is closed
+    if (ptr == MAP_FAILED)
+        return false;
+    m_data = (const unsigned char*)ptr;
+    m_size = size_t(st.st_size);
+    return true;
+#endif
+}
+
+
+
+void
+Filesystem::MappedFile::close()
+{
+    if (!m_data)
+        return;
+#ifdef _WIN32
+    UnmapViewOfFile((void*)m_data);
+    CloseHandle((HANDLE)m_mapping);
+    m_mapping = nullptr;
+#else
+    munmap((void*)m_data, m_size);
+#endif
+    m_data = nullptr;
+    m_size = 0;
+}
+
+
+
+
+Filesystem::IOMMap::IOMMap(string_view filename)
+    : IOProxy(filename, Read)
+{
+    if (!m_map.open(filename)) {
+        m_mode = Closed;
+        error(Strutil::fmt::format("Could not memory map file \"{}\"",
+                                   filename));
+    }
+}
+
+
+
+void
+Filesystem::IOMMap::close()
+{
+    m_map.close();
+    m_mode = Closed;
+}
+
+
+
+size_t
+Filesystem::IOMMap::read(void* buf, size_t size)
+{
+    size = pread(buf, size, m_pos);
+    m_pos += size;
+    return size;
+}
+
+
+
+size_t
+Filesystem::IOMMap::pread(void* buf, size_t size, int64_t offset)
+{
+    // N.B. No lock necessary
+    cspan<unsigned char> bytes = view(offset, size);
+    if (bytes.size())
+        memcpy(buf, bytes.data(), bytes.size());
+    return bytes.size();
+}
+
+
+
+cspan<unsigned char>
+Filesystem::IOMMap::view(int64_t offset, size_t size) const
+{
+    if (offset < 0 || size_t(offset) >= m_map.size())
+        return cspan<unsigned char>();
+    size = std::min(size, m_map.size() - size_t(offset));
+    return cspan<unsigned char>(m_map.data() + offset, size);
+}
+
+
+
+
+Filesystem::IOReadAhead::IOReadAhead(IOProxy* source, size_t blocksize,
+                                     thread_pool* pool)
+    : IOProxy(source ? source->filename() : std::string(),
+              source ? source->mode() : Closed)
+    , m_source(source)
+    , m_blocksize(std::max(blocksize, size_t(4096)))
+    , m_pool(pool)
+{
+    if (m_mode != Read) {
+        m_mode = Closed;
+        error(source ? source->error() : std::string("no source proxy"));
+    } else {
+        m_pos = m_source->tell();
+    }
+}
+
+
+
+Filesystem::IOReadAhead::IOReadAhead(std::unique_ptr<IOProxy> source,
+                                     size_t blocksize, thread_pool* pool)
+    : IOReadAhead(source.get(), blocksize, pool)
+{
+    m_owned_source = std::move(source);
+}
+
+
+
+Filesystem::IOReadAhead::~IOReadAhead() { cancel_readahead(); }
+
+
+
+void
+Filesystem::IOReadAhead::close()
+{
+    cancel_readahead();
+    m_buflen = 0;
+    if (m_owned_source)
+        m_owned_source->close();
+    m_mode = Closed;
+}
+
+
+
+void
+Filesystem::IOReadAhead::cancel_readahead()
+{
+    // The background read fills m_next, so it has to finish before we can
+    // touch or free that buffer.
+    if (m_nextread.valid())
+        m_nextread.wait();
+    m_nextread  = std::future<size_t>();
+    m_nextstart = -1;
+}
+
+
+
+void
+Filesystem::IOReadAhead::fill(int64_t pos)
+{
+    if (m_nextread.valid() && m_nextstart == pos) {
+        // Sequential, as hoped: the read-ahead block is the one we need.
+        m_buflen = m_nextread.get();
+        m_buf.swap(m_next);
+        m_nextstart = -1;
+    } else {
+        cancel_readahead();
+        m_buf.resize(m_blocksize);
+        m_buflen = m_source->pread(m_buf.data(), m_blocksize, pos);
+    }
+    m_bufstart = pos;
+    // Start on the next block, unless we just hit the end of the file.
+    if (m_pool && m_buflen == m_blocksize
+        && pos + int64_t(m_buflen) < int64_t(m_source->size())) {
+        m_next.resize(m_blocksize);
+        m_nextstart      = pos + int64_t(m_buflen);
+        IOProxy* src     = m_source;
+        unsigned char* p = m_next.data();
+        size_t bs        = m_blocksize;
+        int64_t start    = m_nextstart;
+        m_nextread       = m_pool->push(
+            [=](int /*id*/) { return src->pread(p, bs, start); });
+    }
+}
+
+
+
+size_t
+Filesystem::IOReadAhead::read_slow(void* buf, size_t size)
+{
+    if (m_mode != Read || !size || m_pos < 0)
+        return 0;
+    char* dst   = (char*)buf;
+    size_t done = 0;
+    while (done < size) {
+        if (m_pos >= m_bufstart && m_pos < m_bufstart + int64_t(m_buflen)) {
+            size_t off = size_t(m_pos - m_bufstart);
+            size_t n   = std::min(size - done, m_buflen - off);
+            memcpy(dst + done, m_buf.data() + off, n);
+            done += n;
+            m_pos += int64_t(n);
+        } else if (size - done >= m_blocksize) {
+            // Big reads go straight to the source.
+            size_t n = m_source->pread(dst + done, size - done, m_pos);
+            done += n;
+            m_pos += int64_t(n);
+            break;
+        } else {
+            fill(m_pos);
+            if (!m_buflen)
+                break;  // end of file
+        }
+    }
+    if (done < size)
+        error(m_pos >= int64_t(m_source->size()) ? std::string("end of file")
+                                                 : m_source->error());
+    return done;
+}
+
+
+
+size_t
+Filesystem::IOReadAhead::pread(void* buf, size_t size, int64_t offset)
+{
+    return m_mode == Read ? m_source->pread(buf, size, offset) : 0;
+}
+
+
+
+bool
+Filesystem::IOReadAhead::pread_batch(span<ReadRequest> requests)
+{
+    return m_mode == Read ? m_source->pread_batch(requests) : false;
+}
+
+
+
+size_t
+Filesystem::IOReadAhead::size() const
+{
+    return m_mode == Read ? m_source->size() : 0;
+}
+
+
+
+cspan<unsigned char>
+Filesystem::IOReadAhead::view(int64_t offset, size_t size) const
+{
+    return m_mode == Read ? m_source->view(offset, size)
+                          : cspan<unsigned char>();
+}
+
+
+
+struct Filesystem::ChangeWatcher::Impl {
+    int fd = -1;  // The inotify instance
+    std::mutex mutex;
+    // The names each watch was added under (more than one if a directory
+    // was given by different paths), and the watch of each name.
+    std::unordered_map<int, std::vector<std::string>> dirs;
+    std::unordered_map<std::string, int> watches;
+};
+
+
+
+Filesystem::ChangeWatcher::ChangeWatcher()
+    : m_impl(new Impl)
+{
+#ifdef __linux__
+    m_impl->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+
+
+Filesystem::ChangeWatcher::~ChangeWatcher()
+{
+#ifdef __linux__
+    if (m_impl->fd >= 0)
+        ::close(m_impl->fd);
+#endif
+}
+
+
+
+bool
+Filesystem::ChangeWatcher::valid() const noexcept
+{
+    return m_impl->fd >= 0;
+}
+
+
+
+bool
+Filesystem::ChangeWatcher::watch(string_view dirname)
+{
+#ifdef __linux__
+    if (m_impl->fd < 0)
+        return false;
+    std::string dir(dirname);
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    if (m_impl->watches.count(dir))
+        return true;
+    // A file is "changed" when it's closed after writing, moved in or out
+    // (which is how most tools replace files atomically), deleted, or has
+    // its times set (as by touch).
+    const uint32_t mask = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM
+                          | IN_DELETE | IN_ATTRIB | IN_MOVE_SELF
+                          | IN_DELETE_SELF | IN_ONLYDIR;
+    int wd = inotify_add_watch(m_impl->fd, dir.empty() ? "." : dir.c_str(),
+                               mask);
+    if (wd < 0)
+        return false;
+    m_impl->dirs[wd].push_back(dir);
+    m_impl->watches[dir] = wd;
+    return true;
+#else
+    return false;
+#endif
+}
+
+
+
+int
+Filesystem::ChangeWatcher::changes(std::vector<std::string>& changed,
+                                   int timeout_ms)
+{
+#ifdef __linux__
+    if (m_impl->fd < 0)
+        return -1;
+    pollfd pfd = { m_impl->fd, POLLIN, 0 };
+    if (::poll(&pfd, 1, timeout_ms) <= 0)
+        return 0;
+    std::lock_guard<std::mutex> lock(m_impl->mutex);
+    size_t first = changed.size();
+    bool missed  = false;
+    alignas(inotify_event) char buf[16384];
+    for (;;) {
+        ssize_t n = ::read(m_impl->fd, buf, sizeof(buf));
+        if (n <= 0)
+            break;  // EAGAIN: nothing more pending
+        for (ssize_t i = 0; i < n;) {
+            const inotify_event* ev = (const inotify_event*)(buf + i);
+            i += sizeof(inotify_event) + ev->len;
+            if (ev->mask & IN_Q_OVERFLOW) {
+                missed = true;
+                continue;
+            }
+            auto dir = m_impl->dirs.find(ev->wd);
+            if (dir == m_impl->dirs.end())
+                continue;
+            if (ev->mask & (IN_MOVE_SELF | IN_DELETE_SELF | IN_IGNORED)) {
+                // The directory went away or moved, taking its files with
+                // it without any events for them. Stop watching it, so a
+                // later watch() of its name starts afresh.
+                missed = true;
+                if (!(ev->mask & IN_IGNORED))
+                    inotify_rm_watch(m_impl->fd, ev->wd);
+                for (const std::string& d : dir->second)
+                    m_impl->watches.erase(d);
+                m_impl->dirs.erase(dir);
+                continue;
+            }
+            if (ev->len) {
+                for (const std::string& d : dir->second)
+                    changed.push_back(d.empty() ? std::string(ev->name)
+                                                : d + "/" + ev->name);
+            }
+        }
+    }
+    return missed ? -1 : int(changed.size() - first);
+#else
+    return -1;
+#endif
+}
+
 OIIO_NAMESPACE_END
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 
@@ -9,6 +10,7 @@
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/platform.h>
+#include <OpenImageIO/thread.h>
 #include <OpenImageIO/unittest.h>
 
 #ifndef _WIN32
@@ -514,6 +516,72 @@ test_scan_sequences()
 
 
 
+void
+test_scan_directory()
+{
+    std::cout << "Testing scan_directory\n";
+    Filesystem::create_directory("scandir");
+    Filesystem::create_directory("scandir/sub1");
+    Filesystem::create_directory("scandir/sub2");
+    Filesystem::create_directory("scandir/sub2/deeper");
+    Filesystem::write_text_file("scandir/a.1001.tx", "abc");
+    Filesystem::write_text_file("scandir/a.1002.tx", "abcdef");
+    Filesystem::write_text_file("scandir/b.txt", "");
+    Filesystem::write_text_file("scandir/sub1/a.1003.tx", "");
+    Filesystem::write_text_file("scandir/sub2/deeper/a.1004.tx", "");
+
+    auto names = [](const std::vector<Filesystem::DirEntry>& entries) {
+        std::vector<std::string> n;
+        for (auto& e : entries)
+            n.push_back(Filesystem::generic_filepath(e.path));
+        std::sort(n.begin(), n.end());
+        return Strutil::join(n, " ");
+    };
+
+    std::vector<Filesystem::DirEntry> entries;
+    Filesystem::DirScanOptions opt;
+    OIIO_CHECK_ASSERT(Filesystem::scan_directory("scandir", entries, opt));
+    OIIO_CHECK_EQUAL(names(entries),
+                     "scandir/a.1001.tx scandir/a.1002.tx scandir/b.txt "
+                     "scandir/sub1 scandir/sub2");
+
+    opt.files_only = true;
+    opt.recursive  = true;
+    OIIO_CHECK_ASSERT(Filesystem::scan_directory("scandir", entries, opt));
+    OIIO_CHECK_EQUAL(names(entries),
+                     "scandir/a.1001.tx scandir/a.1002.tx scandir/b.txt "
+                     "scandir/sub1/a.1003.tx scandir/sub2/deeper/a.1004.tx");
+    for (auto& e : entries)
+        OIIO_CHECK_ASSERT(e.is_regular && !e.is_directory);
+
+    // The filter matches names, not paths, and doesn't stop recursion
+    opt.filter_regex = "a\\.([0-9]+)\\.tx";
+    opt.stat         = true;
+    OIIO_CHECK_ASSERT(Filesystem::scan_directory("scandir", entries, opt));
+    OIIO_CHECK_EQUAL(names(entries),
+                     "scandir/a.1001.tx scandir/a.1002.tx "
+                     "scandir/sub1/a.1003.tx scandir/sub2/deeper/a.1004.tx");
+    for (auto& e : entries) {
+        if (Strutil::ends_with(e.path, "1002.tx"))
+            OIIO_CHECK_EQUAL(e.size, 6);
+        OIIO_CHECK_ASSERT(e.mtime != 0);
+    }
+
+    // The old interface filters on the whole path
+    std::vector<std::string> files;
+    OIIO_CHECK_ASSERT(
+        Filesystem::get_directory_entries("scandir", files, true, "sub2"));
+    OIIO_CHECK_EQUAL(files.size(), 3);  // sub2, sub2/deeper, and its file
+
+    OIIO_CHECK_ASSERT(!Filesystem::scan_directory("nonexistent", entries));
+    opt.filter_regex = "(";  // botched regex
+    OIIO_CHECK_ASSERT(!Filesystem::scan_directory("scandir", entries, opt));
+    std::string err;
+    Filesystem::remove_all("scandir", err);
+}
+
+
+
 void
 test_mem_proxies()
 {
@@ -538,6 +606,83 @@ test_mem_proxies()
         10, 13, 14, 13, 14, 15, 16, 17, 18, 19
     };
     OIIO_CHECK_ASSERT(output_buf == ref_buf);
+    // Zero-copy views of the memory reader
+    cspan<unsigned char> v = in.view(8, 4);
+    OIIO_CHECK_EQUAL(v.size(), 2);
+    OIIO_CHECK_EQUAL(v[0], 18);
+    OIIO_CHECK_ASSERT(in.view(10, 1).empty());
+}
+
+
+
+void
+test_mmap_proxy()
+{
+    std::cout << "Testing memory mapped file proxy:\n";
+    const char testtext[] = "0123456789";
+    Filesystem::write_text_file("testmmap", testtext);
+
+    Filesystem::IOMMap in("testmmap");
+    OIIO_CHECK_ASSERT(in.opened());
+    OIIO_CHECK_EQUAL(in.size(), 10);
+    char b[4];
+    OIIO_CHECK_EQUAL(in.read(b, 4), 4);
+    OIIO_CHECK_EQUAL(b[3], '3');
+    OIIO_CHECK_EQUAL(in.tell(), 4);
+    OIIO_CHECK_EQUAL(in.pread(b, 4, 8), 2);
+    OIIO_CHECK_EQUAL(b[1], '9');
+    OIIO_CHECK_EQUAL(in.pread(b, 4, 12), 0);
+    cspan<unsigned char> v = in.view(5, 3);
+    OIIO_CHECK_EQUAL(v.size(), 3);
+    OIIO_CHECK_EQUAL(v[0], '5');
+    in.close();
+    OIIO_CHECK_ASSERT(!in.opened());
+
+    Filesystem::IOMMap missing("noexist");
+    OIIO_CHECK_ASSERT(!missing.opened());
+    OIIO_CHECK_ASSERT(missing.error().size());
+    Filesystem::remove("testmmap");
+}
+
+
+
+void
+test_readahead_proxy()
+{
+    std::cout << "Testing read-ahead proxy:\n";
+    std::vector<unsigned char> data(10000);
+    for (size_t i = 0; i < data.size(); ++i)
+        data[i] = (unsigned char)(i % 251);
+    Filesystem::IOMemReader mem(data);
+    Filesystem::IOReadAhead in(&mem, 4096, default_thread_pool());
+    OIIO_CHECK_ASSERT(in.opened());
+    OIIO_CHECK_EQUAL(in.size(), data.size());
+
+    // Many small sequential reads, crossing block boundaries
+    std::vector<unsigned char> out(data.size());
+    for (size_t pos = 0; pos < data.size(); pos += 7) {
+        size_t n = std::min(size_t(7), data.size() - pos);
+        OIIO_CHECK_EQUAL(in.read(out.data() + pos, n), n);
+    }
+    OIIO_CHECK_ASSERT(out == data);
+    OIIO_CHECK_EQUAL(in.tell(), int64_t(data.size()));
+    unsigned char b[16];
+    OIIO_CHECK_EQUAL(in.read(b, 4), 0);
+
+    // Seek backwards, then a read bigger than a block
+    in.seek(100);
+    OIIO_CHECK_EQUAL(in.read(b, 1), 1);
+    OIIO_CHECK_EQUAL(b[0], data[100]);
+    std::vector<unsigned char> big(5000);
+    OIIO_CHECK_EQUAL(in.read(big.data(), big.size()), big.size());
+    OIIO_CHECK_ASSERT(std::equal(big.begin(), big.end(), data.begin() + 101));
+    // Short read at the end
+    in.seek(9995);
+    OIIO_CHECK_EQUAL(in.read(b, 16), 5);
+    OIIO_CHECK_EQUAL(b[4], data[9999]);
+    // pread passes through
+    OIIO_CHECK_EQUAL(in.pread(b, 2, 500), 2);
+    OIIO_CHECK_EQUAL(b[1], data[501]);
 }
 
 
@@ -550,7 +695,10 @@ main(int /*argc*/, char* /*argv*/[])
     test_file_status();
     test_frame_sequences();
     test_scan_sequences();
+    test_scan_directory();
     test_mem_proxies();
+    test_mmap_proxy();
+    test_readahead_proxy();
 
     return unit_test_failures;
 }
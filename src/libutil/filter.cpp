@@ -20,6 +20,7 @@
 
 
 
+#include <algorithm>
 #include <cmath>
 #include <cstring>
 #include <iostream>
@@ -28,6 +29,7 @@
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filter.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/simd.h>
 
 
 OIIO_NAMESPACE_BEGIN
@@ -1015,4 +1017,63 @@ Filter2D::destroy(Filter2D* filt)
 }
 
 
+
+FilterLUT
+Filter2D::make_lut(int samples) const
+{
+    FilterLUT lut;
+    lut.m_samples = std::max(samples, 1);
+    lut.m_w       = m_w;
+    lut.m_h       = m_h;
+    lut.m_nonsep  = separable() ? nullptr : this;
+    lut.m_xscale  = m_w > 0.0f ? 2.0f * lut.m_samples / m_w : 0.0f;
+    lut.m_yscale  = m_h > 0.0f ? 2.0f * lut.m_samples / m_h : 0.0f;
+    int n         = 2 * lut.m_samples + 1;
+    lut.m_x.resize(n + 1);
+    lut.m_y.resize(n + 1);
+    for (int i = 0; i < n; ++i) {
+        // Exactly 0 in the middle and exactly +/-1 at the ends
+        float t    = float(i - lut.m_samples) / float(lut.m_samples);
+        lut.m_x[i] = xfilt(t * 0.5f * m_w);
+        lut.m_y[i] = yfilt(t * 0.5f * m_h);
+    }
+    lut.m_x[n] = lut.m_x[n - 1];
+    lut.m_y[n] = lut.m_y[n - 1];
+    return lut;
+}
+
+
+
+float
+FilterLUT::lookup(const float* table, float scale, float x0, float dx, int n,
+                  float* result) const
+{
+    using namespace simd;
+    const float last = float(2 * m_samples);
+    vfloat4 sum      = 0.0f;
+    int i            = 0;
+    for (; i + 4 <= n; i += 4) {
+        vfloat4 x = vfloat4(x0) + vfloat4::Iota(float(i)) * vfloat4(dx);
+        vfloat4 f = x * vfloat4(scale) + vfloat4(float(m_samples));
+        // Same edge tolerance as the scalar lookup; zeroing the positions
+        // outside (and NaN) keeps the gathers within the table.
+        vbool4 inside = (f >= vfloat4(-1.0e-3f))
+                        & (f <= vfloat4(last + 1.0e-3f));
+        f = clamp(blend0(f, inside), vfloat4::Zero(), vfloat4(last));
+        vint4 idx(f);
+        vfloat4 fr = f - vfloat4(idx);
+        vfloat4 a, b;
+        a.gather(table, idx);
+        b.gather(table + 1, idx);
+        vfloat4 w = blend0(a + fr * (b - a), inside);
+        w.store(result + i);
+        sum += w;
+    }
+    float total = reduce_add(sum);
+    for (; i < n; ++i)
+        total += (result[i] = lookup(table, scale, x0 + float(i) * dx));
+    return total;
+}
+
+
 OIIO_NAMESPACE_END
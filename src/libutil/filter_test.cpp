@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <cstring>
+#include <limits>
 #include <vector>
 
 #include <OpenImageIO/argparse.h>
@@ -52,6 +54,75 @@ getargs(int argc, char* argv[])
 
 
 
+// FilterLUT should match the filters it tabulates, and its batch
+// evaluation should match its one-at-a-time evaluation.
+static void
+test_lut(Benchmarker& bench)
+{
+    for (int i = 0, e = Filter2D::num_filters(); i < e; ++i) {
+        FilterDesc filtdesc;
+        Filter2D::get_filterdesc(i, &filtdesc);
+        Filter2D* f   = Filter2D::create(filtdesc.name, filtdesc.width,
+                                         0.75f * filtdesc.width);
+        FilterLUT lut = f->make_lut();
+        OIIO_CHECK_EQUAL(lut.separable(), f->separable());
+        OIIO_CHECK_EQUAL(lut.width(), f->width());
+        OIIO_CHECK_EQUAL(lut.height(), f->height());
+        // Stay out of the last table interval, where a filter that jumps
+        // to 0 at its edge can't be matched.
+        float tol    = 1.0e-5f * fabsf(f->xfilt(0.0f));
+        float interp = 1.0f - 2.0f / 1024.0f;
+        bool exact   = !strcmp(filtdesc.name, "box")
+                     || !strcmp(filtdesc.name, "triangle");
+        float maxerr = 0.0f;
+        for (int j = -1000; j <= 1000; ++j) {
+            float x = (0.5f * interp * f->width()) * float(j) / 1000.0f;
+            float y = 0.75f * x;
+            maxerr  = std::max(maxerr, fabsf(lut.xfilt(x) - f->xfilt(x)));
+            maxerr  = std::max(maxerr, fabsf(lut.yfilt(y) - f->yfilt(y)));
+        }
+        if (exact)
+            OIIO_CHECK_LE(maxerr, 1.0e-6f);
+        else
+            OIIO_CHECK_LE(maxerr, tol);
+        if (verbose)
+            Strutil::print("  {:16} LUT max error {}\n", filtdesc.name, maxerr);
+        OIIO_CHECK_EQUAL(lut.xfilt(f->width()), 0.0f);
+        OIIO_CHECK_EQUAL(lut.xfilt(std::numeric_limits<float>::quiet_NaN()),
+                         0.0f);
+        if (!lut.separable())
+            OIIO_CHECK_EQUAL(lut(0.3f, 0.2f), (*f)(0.3f, 0.2f));
+
+        // Evenly spaced taps, spilling past both edges
+        const int ntaps = 23;
+        float w[ntaps], x0 = -0.6f * f->width();
+        float dx = 1.2f * f->width() / (ntaps - 1);
+        float total = lut.xfilt(x0, dx, ntaps, w), expected = 0.0f;
+        for (int j = 0; j < ntaps; ++j) {
+            OIIO_CHECK_ASSERT(fabsf(w[j] - lut.xfilt(x0 + float(j) * dx))
+                              <= 1.0e-6f);
+            expected += w[j];
+        }
+        OIIO_CHECK_ASSERT(fabsf(total - expected) <= 1.0e-5f);
+
+        // Time it against the virtual calls
+        const size_t ncalls = 100000;
+        bench.work(ncalls);
+        float ninv = (filtdesc.width / 2.0f) / ncalls;
+        bench(Strutil::fmt::format("{} xfilt", filtdesc.name), [=]() {
+            for (size_t i = 0; i < ncalls; ++i)
+                DoNotOptimize(f->xfilt(i * ninv));
+        });
+        std::vector<float> lutvals(ncalls);
+        bench(Strutil::fmt::format("{} LUT xfilt", filtdesc.name), [&]() {
+            DoNotOptimize(lut.xfilt(0.0f, ninv, int(ncalls), lutvals.data()));
+        });
+        Filter2D::destroy(f);
+    }
+}
+
+
+
 int
 main(int argc, char* argv[])
 {
@@ -113,5 +184,7 @@ main(int argc, char* argv[])
 
     graph.write("filters.tif");
 
+    test_lut(bench);
+
     return unit_test_failures != 0;
 }
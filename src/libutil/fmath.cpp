@@ -9,3 +9,74 @@
 #define OIIO_FMATH_HEADER_ONLY 1
 
 #include <OpenImageIO/fmath.h>
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#    include <arm_neon.h>
+#endif
+
+
+OIIO_NAMESPACE_BEGIN
+
+// If the build's own flags don't enable F16C, the bulk half conversions
+// are also compiled with them in fmath_f16c.cpp (see CMakeLists.txt), and
+// used if the running CPU and OS support them.
+#if OIIO_FMATH_F16C_DISPATCH && !OIIO_F16C_ENABLED
+namespace pvt {
+void
+half_to_float_f16c(const uint16_t* src, float* dst, size_t n);
+void
+float_to_half_f16c(const float* src, uint16_t* dst, size_t n);
+}  // namespace pvt
+
+static bool
+use_f16c()
+{
+    static const bool ok = cpu_has_avx() && cpu_has_f16c()
+                           && os_saves_xstate(0x6);
+    return ok;
+}
+#endif
+
+
+
+void
+convert_half_to_float(cspan<half> src, span<float> dst)
+{
+    OIIO_DASSERT(dst.size() >= src.size());
+    size_t n      = std::min(size_t(src.size()), size_t(dst.size()));
+    const half* s = src.data();
+    float* d      = dst.data();
+#if OIIO_FMATH_F16C_DISPATCH && !OIIO_F16C_ENABLED
+    if (use_f16c()) {
+        pvt::half_to_float_f16c((const uint16_t*)s, d, n);
+        return;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    for (; n >= 4; n -= 4, s += 4, d += 4)
+        vst1q_f32(d, vcvt_f32_f16(vld1_f16((const float16_t*)s)));
+#endif
+    convert_type(s, d, n);
+}
+
+
+
+void
+convert_float_to_half(cspan<float> src, span<half> dst)
+{
+    OIIO_DASSERT(dst.size() >= src.size());
+    size_t n       = std::min(size_t(src.size()), size_t(dst.size()));
+    const float* s = src.data();
+    half* d        = dst.data();
+#if OIIO_FMATH_F16C_DISPATCH && !OIIO_F16C_ENABLED
+    if (use_f16c()) {
+        pvt::float_to_half_f16c(s, (uint16_t*)d, n);
+        return;
+    }
+#elif defined(__aarch64__) || defined(_M_ARM64)
+    for (; n >= 4; n -= 4, s += 4, d += 4)
+        vst1_f16((float16_t*)d, vcvt_f16_f32(vld1q_f32(s)));
+#endif
+    convert_type(s, d, n);
+}
+
+OIIO_NAMESPACE_END
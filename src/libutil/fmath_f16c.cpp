@@ -0,0 +1,70 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+// The bulk half <-> float conversions of fmath.cpp, compiled with the
+// flags for F16C (set in CMakeLists.txt), for builds whose baseline lacks
+// it. Only intrinsics are used here, and no OIIO inline functions: a copy
+// of one compiled with these flags could otherwise be the one the linker
+// keeps for the whole library.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <immintrin.h>
+
+#include <OpenImageIO/oiioversion.h>
+
+
+OIIO_NAMESPACE_BEGIN
+
+namespace pvt {
+
+void
+half_to_float_f16c(const uint16_t* src, float* dst, size_t n);
+void
+float_to_half_f16c(const float* src, uint16_t* dst, size_t n);
+
+
+
+void
+half_to_float_f16c(const uint16_t* src, float* dst, size_t n)
+{
+    for (; n >= 8; n -= 8, src += 8, dst += 8)
+        _mm256_storeu_ps(dst,
+                         _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)src)));
+    if (n) {
+        uint16_t sbuf[8] = {};
+        float dbuf[8];
+        memcpy(sbuf, src, n * sizeof(uint16_t));
+        _mm256_storeu_ps(dbuf,
+                         _mm256_cvtph_ps(_mm_loadu_si128((__m128i*)sbuf)));
+        memcpy(dst, dbuf, n * sizeof(float));
+    }
+}
+
+
+
+void
+float_to_half_f16c(const float* src, uint16_t* dst, size_t n)
+{
+    // Round to nearest even, like Imath's half
+    for (; n >= 8; n -= 8, src += 8, dst += 8)
+        _mm_storeu_si128((__m128i*)dst,
+                         _mm256_cvtps_ph(_mm256_loadu_ps(src),
+                                         _MM_FROUND_TO_NEAREST_INT));
+    if (n) {
+        float sbuf[8] = {};
+        uint16_t dbuf[8];
+        memcpy(sbuf, src, n * sizeof(float));
+        _mm_storeu_si128((__m128i*)dbuf,
+                         _mm256_cvtps_ph(_mm256_loadu_ps(sbuf),
+                                         _MM_FROUND_TO_NEAREST_INT));
+        memcpy(dst, dbuf, n * sizeof(uint16_t));
+    }
+}
+
+}  // namespace pvt
+
+OIIO_NAMESPACE_END
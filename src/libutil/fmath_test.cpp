@@ -519,6 +519,11 @@ test_half_convert_accuracy()
     // And convert back in a batch as well (using SIMD if available)
     std::vector<float> H2(nhalfs);
     convert_type(F.data(), H2.data(), nhalfs);
+    // The bulk conversions, which pick F16C at runtime, must agree too.
+    std::vector<float> FB(nhalfs);
+    convert_half_to_float(H, FB);
+    std::vector<half> HB(nhalfs);
+    convert_float_to_half(FB, HB);
 
     // Compare the round trip as well as all the values to the result we get
     // if we convert individually, which will use the table-based method
@@ -528,8 +533,10 @@ test_half_convert_accuracy()
         float f = H[i];  // single assignment uses table from Imath
         half h  = (half)f;
         if ((f != F[i] || f != H2[i] || f != h || H[i] != H2[i]
+             || f != FB[i]
              || bit_cast<half, unsigned short>(h)
                     != bit_cast<half, unsigned short>(H[i])
+             || bit_cast<half, unsigned short>(HB[i]) != i
              || bit_cast<half, unsigned short>(h) != i)
             && Imath::finitef(H[i])) {
             ++nwrong;
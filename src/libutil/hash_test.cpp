@@ -49,6 +49,16 @@ test_xxhash(int len)
     return a;
 }
 
+uint64_t
+test_xxh3(int len)
+{
+    char* ptr  = reinterpret_cast<char*>(data.data());
+    uint64_t a = 0;
+    for (int i = 0, e = iterations / len; i < e; i++, ptr += len)
+        a += xxhash::xxh3(ptr, len);
+    return a;
+}
+
 uint64_t
 test_farmhash(int len)
 {
@@ -233,6 +243,7 @@ main(int argc, char* argv[])
     auto candidates = {
         std::make_pair("BJ hash           ", test_bjhash),
         std::make_pair("XX hash           ", test_xxhash),
+        std::make_pair("XXH3 hash         ", test_xxh3),
         std::make_pair("farmhash          ", test_farmhash),
         std::make_pair("farmhash::inlined ", test_farmhash_inlined),
         std::make_pair("fasthash64        ", test_fasthash64),
@@ -273,6 +284,11 @@ main(int argc, char* argv[])
                                                [](string_view s) -> uint64_t {
                                                    return xxhash::xxhash(s);
                                                }),
+        std::make_pair<string_view, hashfn_t*>("XXH3 hash         ",
+                                               [](string_view s) -> uint64_t {
+                                                   return xxhash::xxh3(
+                                                       s.data(), s.size());
+                                               }),
         std::make_pair<string_view, hashfn_t*>("farmhash          ",
                                                [](string_view s) -> uint64_t {
                                                    return farmhash::Hash(s);
@@ -315,6 +331,13 @@ main(int argc, char* argv[])
             0x4465cf017b51e76b,
             0x1c9ebf5ebae6e8ad,
         },
+        {
+            // xxh3
+            0x2d06800538d394c2,
+            0x469136afefe185d2,
+            0xb0c8f5f68e838df5,
+            0x4822b54adf8af5db,
+        },
         {
             // farmhash
             0x9ae16a3b2f90404f,
@@ -358,5 +381,31 @@ main(int argc, char* argv[])
         ++stringno;
     }
 
+    // XXH3_128bits, for a short input and a seeded long one
+    {
+        string_view s(teststrings[3]);
+        auto h = xxhash::XXH3_128bits(s.data(), s.size());
+        OIIO_CHECK_EQUAL(h.low64, 0x44c11691e07962c0ULL);
+        OIIO_CHECK_EQUAL(h.high64, 0xf37bb1a51e165e1cULL);
+        std::string x(1000, 'x');
+        h = xxhash::XXH3_128bits(x.data(), x.size(), 1771);
+        OIIO_CHECK_EQUAL(h.low64, 0x5cc21b07317fd85eULL);
+        OIIO_CHECK_EQUAL(h.high64, 0x4a529f4c4b3b27daULL);
+    }
+
+    // SHA-1 test vectors, including one long enough to go through the
+    // multi-block path (and the SHA extensions, if the CPU has them).
+    print("\nTesting SHA-1\n");
+    OIIO_CHECK_EQUAL(SHA1::digest("abc", 3),
+                     "A9993E364706816ABA3E25717850C26C9CD0D89D");
+    {
+        std::string a(1000000, 'a');
+        SHA1 sha;
+        sha.append(a.data(), 1);
+        sha.append(a.data() + 1, a.size() - 1);
+        OIIO_CHECK_EQUAL(sha.digest(),
+                         "34AA973CD4C4DAA4F61EEB2BDBAD27316534016F");
+    }
+
     return unit_test_failures;
 }
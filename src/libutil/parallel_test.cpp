@@ -113,6 +113,22 @@ test_parallel_for_2D()
     bool all_one = std::all_of(vals.cbegin(), vals.cend(),
                                [&](int i) { return vals[i] == 1; });
     OIIO_CHECK_ASSERT(all_one);
+
+    // Tiles handed out in Morton order must still cover everything once,
+    // including partial tiles at the right and bottom edges.
+    std::fill(vals.begin(), vals.end(), 0);
+    parallel_for_chunked_2D(
+        0, size, 7, 0, size, 9,
+        [&](int64_t xb, int64_t xe, int64_t yb, int64_t ye) {
+            for (auto j = yb; j < ye; ++j)
+                for (auto i = xb; i < xe; ++i)
+                    vals[j * size + i] += 1;
+        },
+        parallel_options(0, Split_Tile));
+    OIIO_CHECK_ASSERT(
+        std::all_of(vals.cbegin(), vals.cend(), [](int v) { return v == 1; }));
+    int64_t tile = cache_tile_size();
+    OIIO_CHECK_ASSERT(tile >= 8 && tile <= 1024 && tile % 8 == 0);
 }
 
 
@@ -140,6 +156,95 @@ test_thread_pool_recursion()
 
 
 
+void
+test_nested_wait()
+{
+    std::cout << "\nTesting pool workers waiting on their own subtasks"
+              << std::endl;
+    // With just one worker, a task that pushes subtasks and waits for them
+    // can only finish if the worker runs them itself while it waits.
+    thread_pool pool(1);
+    atomic_int count(0);
+    auto outer = pool.push([&](int /*id*/) {
+        task_set ts(&pool);
+        for (int i = 0; i < 10; ++i)
+            ts.push(pool.push([&](int /*id*/) { count += 1; }));
+        ts.wait();
+        return int(count);
+    });
+    OIIO_CHECK_EQUAL(outer.get(), 10);
+
+    // Nested parallel_for no longer runs its inner loops serially, and
+    // must still cover every index exactly once.
+    default_thread_pool()->resize(4);
+    std::vector<int> vals(16 * 1000, 0);
+    parallel_for(0, 16, [&](int64_t i) {
+        parallel_for_chunked(0, 1000, 10, [&](int64_t b, int64_t e) {
+            for (int64_t j = b; j < e; ++j)
+                vals[i * 1000 + j] += 1;
+        });
+    });
+    OIIO_CHECK_ASSERT(
+        std::all_of(vals.cbegin(), vals.cend(), [](int v) { return v == 1; }));
+}
+
+
+
+// A stand-in for a host application's scheduler, which runs everything
+// with the calling thread and counts what it was handed.
+class test_executor final : public parallel_executor {
+public:
+    void submit(std::function<void()>&& task) override
+    {
+        ++submitted;
+        task();
+    }
+    void parallel_for(int64_t start, int64_t end, int64_t grainsize,
+                      function_view<void(int64_t, int64_t)> task) override
+    {
+        ++loops;
+        for (int64_t b = start; b < end; b += grainsize)
+            task(b, std::min(end, b + grainsize));
+    }
+    atomic_int submitted { 0 }, loops { 0 };
+};
+
+
+
+void
+test_executor_routing()
+{
+    std::cout << "\nTesting that an executor takes over the pool's work"
+              << std::endl;
+    thread_pool* pool(default_thread_pool());
+    pool->resize(4);
+    test_executor executor;
+    pool->set_executor(&executor);
+    OIIO_CHECK_EQUAL(pool->executor(), &executor);
+
+    std::vector<int> vals(1000, 0);
+    parallel_for_chunked(0, 1000, 64, [&](int64_t b, int64_t e) {
+        OIIO_CHECK_ASSERT(b % 64 == 0 && e - b <= 64);
+        for (int64_t i = b; i < e; ++i)
+            vals[i] += 1;
+    });
+    OIIO_CHECK_ASSERT(
+        std::all_of(vals.cbegin(), vals.cend(), [](int v) { return v == 1; }));
+    OIIO_CHECK_EQUAL(executor.loops, 1);
+
+    atomic_int count(0);
+    task_set ts(pool);
+    for (int i = 0; i < 10; ++i)
+        ts.push(pool->push([&](int /*id*/) { count += 1; }));
+    ts.wait();
+    OIIO_CHECK_EQUAL(count, 10);
+    OIIO_CHECK_EQUAL(executor.submitted, 10);
+
+    pool->set_executor(nullptr);
+}
+
+
+
 void
 test_empty_thread_pool()
 {
@@ -181,6 +286,8 @@ main(int argc, char** argv)
     test_parallel_for_2D();
     time_parallel_for();
     test_thread_pool_recursion();
+    test_nested_wait();
+    test_executor_routing();
     test_empty_thread_pool();
 
     return unit_test_failures;
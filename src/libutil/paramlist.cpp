@@ -3,6 +3,7 @@
 // https://github.com/OpenImageIO/oiio
 
 #include <algorithm>
+#include <atomic>
 #include <cstdio>
 #include <cstdlib>
 
@@ -15,6 +16,38 @@
 OIIO_NAMESPACE_BEGIN
 
 
+// Values too big to store locally are copied into a heap block headed by
+// a reference count. They're never modified once the ParamValue is set
+// up, so copies of the ParamValue (and so whole ParamValueLists, like an
+// ImageSpec's attributes) can share the block instead of each allocating
+// and copying their own.
+namespace {
+struct alignas(16) SharedValueHeader {
+    std::atomic<int> refs;
+    size_t size;  // Of the whole block
+};
+
+std::atomic<size_t> shared_value_bytes(0);
+
+void*
+new_shared_value(size_t size)
+{
+    size += sizeof(SharedValueHeader);
+    void* mem = malloc(size);
+    new (mem) SharedValueHeader { { 1 }, size };
+    shared_value_bytes += size;
+    return (char*)mem + sizeof(SharedValueHeader);
+}
+
+SharedValueHeader*
+shared_value_header(const void* value)
+{
+    return (SharedValueHeader*)((char*)value - sizeof(SharedValueHeader));
+}
+}  // namespace
+
+
+
 void
 ParamValue::init_noclear(ustring _name, TypeDesc _type, int _nvalues,
                          const void* _value, bool _copy) noexcept
@@ -46,7 +79,7 @@ ParamValue::init_noclear(ustring _name, TypeDesc _type, int _nvalues,
             m_copy     = false;
             m_nonlocal = false;
         } else {
-            m_data.ptr = malloc(size);
+            m_data.ptr = new_shared_value(size);
             if (_value)
                 memcpy((char*)m_data.ptr, _value, size);
             else
@@ -410,11 +443,45 @@ ParamValue::get_ustring_indexed(int index) const
 
 
 
+void
+ParamValue::init_copy_noclear(const ParamValue& p, bool _copy) noexcept
+{
+    if (_copy && p.m_copy && p.m_nonlocal && p.m_data.ptr) {
+        // p owns a shared value block: just add a reference to it
+        m_name     = p.m_name;
+        m_type     = p.m_type;
+        m_nvalues  = p.m_nvalues;
+        m_interp   = p.m_interp;
+        m_data.ptr = p.m_data.ptr;
+        m_copy     = true;
+        m_nonlocal = true;
+        shared_value_header(m_data.ptr)->refs.fetch_add(1);
+    } else {
+        init_noclear(p.name(), p.type(), p.nvalues(), p.interp(), p.data(),
+                     _copy);
+    }
+}
+
+
+
+size_t
+ParamValue::heap_memory() noexcept
+{
+    return shared_value_bytes.load(std::memory_order_relaxed);
+}
+
+
+
 void
 ParamValue::clear_value() noexcept
 {
-    if (m_copy && m_nonlocal && m_data.ptr)
-        free((void*)m_data.ptr);
+    if (m_copy && m_nonlocal && m_data.ptr) {
+        SharedValueHeader* header = shared_value_header(m_data.ptr);
+        if (header->refs.fetch_sub(1) == 1) {
+            shared_value_bytes -= header->size;
+            free(header);
+        }
+    }
     m_data.ptr = nullptr;
     m_copy     = false;
     m_nonlocal = false;
@@ -422,6 +489,18 @@ ParamValue::clear_value() noexcept
 
 
 
+// Case-insensitive name comparison for find(). Most names in a list
+// differ in length from the one sought, or are the very same ustring, and
+// both are far cheaper to check than a locale-aware iequals.
+static inline bool
+iequals_name(ustring a, string_view b)
+{
+    return a.length() == b.length()
+           && (a.c_str() == b.data() || Strutil::iequals(a, b));
+}
+
+
+
 ParamValueList::const_iterator
 ParamValueList::find(ustring name, TypeDesc type, bool casesensitive) const
 {
@@ -433,7 +512,7 @@ ParamValueList::find(ustring name, TypeDesc type, bool casesensitive) const
         }
     } else {
         for (const_iterator i = cbegin(), e = cend(); i != e; ++i) {
-            if (Strutil::iequals(i->name(), name)
+            if (iequals_name(i->name(), name)
                 && (type == TypeDesc::UNKNOWN || type == i->type()))
                 return i;
         }
@@ -450,7 +529,7 @@ ParamValueList::find(string_view name, TypeDesc type, bool casesensitive) const
         return find(ustring(name), type, casesensitive);
     } else {
         for (const_iterator i = cbegin(), e = cend(); i != e; ++i) {
-            if (Strutil::iequals(i->name(), name)
+            if (iequals_name(i->name(), name)
                 && (type == TypeDesc::UNKNOWN || type == i->type()))
                 return i;
         }
@@ -471,7 +550,7 @@ ParamValueList::find(ustring name, TypeDesc type, bool casesensitive)
         }
     } else {
         for (iterator i = begin(), e = end(); i != e; ++i) {
-            if (Strutil::iequals(i->name(), name)
+            if (iequals_name(i->name(), name)
                 && (type == TypeDesc::UNKNOWN || type == i->type()))
                 return i;
         }
@@ -488,7 +567,7 @@ ParamValueList::find(string_view name, TypeDesc type, bool casesensitive)
         return find(ustring(name), type, casesensitive);
     } else {
         for (iterator i = begin(), e = end(); i != e; ++i) {
-            if (Strutil::iequals(i->name(), name)
+            if (iequals_name(i->name(), name)
                 && (type == TypeDesc::UNKNOWN || type == i->type()))
                 return i;
         }
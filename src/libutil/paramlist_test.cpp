@@ -314,6 +314,40 @@ test_paramlist()
 
 
 
+static void
+test_shared_values()
+{
+    std::cout << "test_shared_values\n";
+    // A matrix is too big to store locally, so copies share its values
+    float m[16] = { 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1, 0, 0, 0, 0, 1 };
+    ParamValueList pl;
+    pl.attribute("worldtocamera", TypeMatrix, m);
+    pl.attribute("foo", 42);
+    ParamValueList copy = pl;
+    OIIO_CHECK_EQUAL(copy[0].data(), pl[0].data());
+    OIIO_CHECK_EQUAL(copy[0].get<float>(15), 1.0f);
+
+    // Replacing the original's value leaves the copy's alone
+    m[15] = 2.0f;
+    pl.attribute("worldtocamera", TypeMatrix, m);
+    OIIO_CHECK_NE(copy[0].data(), pl[0].data());
+    OIIO_CHECK_EQUAL(pl[0].get<float>(15), 2.0f);
+    OIIO_CHECK_EQUAL(copy[0].get<float>(15), 1.0f);
+    pl.clear();
+    OIIO_CHECK_EQUAL(copy[0].get<float>(15), 1.0f);
+    OIIO_CHECK_EQUAL(copy.get_int("FOO"), 42);
+
+    // Assignment shares too, and a non-owning ParamValue stays non-owning
+    ParamValue pv;
+    pv = copy[0];
+    OIIO_CHECK_EQUAL(pv.data(), copy[0].data());
+    ParamValue ref("ref", TypeMatrix, 1, m, false);
+    ParamValue ref2(ref);
+    OIIO_CHECK_EQUAL(ref2.get<float>(15), 2.0f);
+}
+
+
+
 static void
 test_delegates()
 {
@@ -374,6 +408,7 @@ main(int /*argc*/, char* /*argv*/[])
     test_value_types();
     test_from_string();
     test_paramlist();
+    test_shared_values();
     test_delegates();
 
     return unit_test_failures;
@@ -22,7 +22,9 @@ using namespace OIIO;
 // the accumulator value (requiring a read lock), but occasionally
 // (1/100 of the time) increment the accumulator, requiring a write
 // lock.  If, at the end, the accumulated value is equal to
-// iterations/read_to_write_ratio*threads, then the locks worked.
+// iterations/read_to_write_ratio*threads, then the locks worked. The same
+// test is timed with a distributed_rw_mutex, to compare how well the two
+// scale with the number of threads.
 
 static int read_write_ratio = 99;
 static int iterations       = 16000000;
@@ -33,18 +35,20 @@ static bool wedge           = false;
 
 long long accum = 0;
 spin_rw_mutex mymutex;
+distributed_rw_mutex<> mydistmutex;
 
 
 
+template<class Mutex>
 static void
-do_accum(int iterations)
+do_accum(Mutex* mutex, int iterations)
 {
     for (int i = 0; i < iterations; ++i) {
         if ((i % (read_write_ratio + 1)) == read_write_ratio) {
-            spin_rw_write_lock lock(mymutex);
+            typename Mutex::write_lock_guard lock(*mutex);
             accum += 1;
         } else {
-            spin_rw_read_lock lock(mymutex);
+            typename Mutex::read_lock_guard lock(*mutex);
             // meaningless test to force examination of the variable
             if (accum < 0)
                 break;
@@ -54,13 +58,14 @@ do_accum(int iterations)
 
 
 
+template<class Mutex>
 void
-test_spin_rw(int numthreads, int iterations)
+test_spin_rw(Mutex* mutex, int numthreads, int iterations)
 {
     accum = 0;
     thread_group threads;
     for (int i = 0; i < numthreads; ++i) {
-        threads.create_thread(do_accum, iterations);
+        threads.create_thread(do_accum<Mutex>, mutex, iterations);
     }
     if (verbose)
         std::cout << "Created " << threads.size() << " threads\n";
@@ -109,7 +114,8 @@ main(int argc, char* argv[])
     std::cout << "hw threads = " << Sysutil::hardware_concurrency() << "\n";
     std::cout << "reader:writer ratio = " << read_write_ratio << ":1\n";
     std::cout << "threads\ttime (best of " << ntrials << ")\n";
-    std::cout << "-------\t----------\n";
+    std::cout << "\tspin_rw_mutex\t\tdistributed_rw_mutex\n";
+    std::cout << "-------\t--------------------\t--------------------\n";
 
     static int threadcounts[] = { 1,  2,  4,  8,  12,  16,   20,
                                   24, 28, 32, 64, 128, 1024, 1 << 30 };
@@ -117,12 +123,17 @@ main(int argc, char* argv[])
         int nt  = threadcounts[i];
         int its = iterations / nt;
 
-        double range;
-        double t = time_trial(std::bind(test_spin_rw, nt, its), ntrials,
-                              &range);
-
-        Strutil::printf("%2d\t%s\t%5.1fs, range %.1f\t(%d iters/thread)\n", nt,
-                        Strutil::timeintervalformat(t), t, range, its);
+        double range, drange;
+        double t  = time_trial(std::bind(test_spin_rw<spin_rw_mutex>,
+                                        &mymutex, nt, its),
+                              ntrials, &range);
+        double dt = time_trial(std::bind(test_spin_rw<distributed_rw_mutex<>>,
+                                         &mydistmutex, nt, its),
+                               ntrials, &drange);
+
+        Strutil::printf("%2d\t%5.1fs, range %.1f\t%5.1fs, range %.1f"
+                        "\t(%d iters/thread)\n",
+                        nt, t, range, dt, drange, its);
         if (!wedge)
             break;  // don't loop if we're not wedging
     }
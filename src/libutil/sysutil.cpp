@@ -6,6 +6,7 @@
 #    define _POSIX_C_SOURCE 1  // for localtime_r
 #endif
 
+#include <algorithm>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
@@ -17,7 +18,10 @@
 #include <thread>
 
 #ifdef __linux__
+#    include <fcntl.h>
+#    include <poll.h>
 #    include <sys/ioctl.h>
+#    include <sys/syscall.h>
 #    include <sys/sysinfo.h>
 #    include <unistd.h>
 #endif
@@ -60,6 +64,7 @@
 #endif
 
 #include <OpenImageIO/dassert.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/ustring.h>
@@ -219,6 +224,71 @@ Sysutil::physical_memory()
 
 
 
+#ifdef __linux__
+// The directory of this process's control group in the hierarchy mounted
+// at `mount`: the cgroup v2 one if `controller` is empty, otherwise the
+// cgroup v1 one of that controller. Return "" if there's no such group.
+static std::string
+cgroup_dir(string_view mount, string_view controller)
+{
+    std::string groups;
+    if (!Filesystem::read_text_file("/proc/self/cgroup", groups))
+        return {};
+    for (string_view line : Strutil::splitsv(groups, "\n")) {
+        // Each line is "id:controllers:path", with id 0 and no
+        // controllers for the v2 group.
+        auto fields = Strutil::splitsv(line, ":", 2);
+        if (fields.size() != 3)
+            continue;
+        auto controllers = Strutil::splitsv(fields[1], ",");
+        if (controller.empty() ? fields[0] != "0" || fields[1].size()
+                               : std::find(controllers.begin(),
+                                           controllers.end(), controller)
+                                     == controllers.end())
+            continue;
+        std::string dir = std::string(mount)
+                          + std::string(Strutil::rstrip(fields[2], "/"));
+        return Filesystem::is_directory(dir) ? dir : std::string();
+    }
+    return {};
+}
+#endif
+
+
+
+size_t
+Sysutil::memory_limit()
+{
+    size_t limit = physical_memory();
+#ifdef __linux__
+    // The kernel kills a process whose cgroup exceeds its memory limit, no
+    // matter how much memory the machine has, and the limits of all the
+    // group's ancestors apply as well. No limit reads as "max" in v2, and
+    // as a huge number in v1.
+    auto lower_to = [&](string_view mount, string_view controller,
+                        string_view limitfile) {
+        std::string dir = cgroup_dir(mount, controller);
+        for (; dir.size() >= mount.size(); dir = Filesystem::parent_path(dir)) {
+            std::string val;
+            if (!Filesystem::read_text_file(dir + "/" + std::string(limitfile),
+                                            val))
+                continue;
+            string_view v = Strutil::strip(val);
+            if (v.size() && isdigit((unsigned char)v[0])) {
+                size_t n = size_t(strtoull(val.c_str(), nullptr, 10));
+                if (n && (!limit || n < limit))
+                    limit = n;
+            }
+        }
+    };
+    lower_to("/sys/fs/cgroup", "", "memory.max");
+    lower_to("/sys/fs/cgroup/memory", "memory", "memory.limit_in_bytes");
+#endif
+    return limit;
+}
+
+
+
 void
 Sysutil::get_local_time(const time_t* time, struct tm* converted_time)
 {
@@ -612,6 +682,104 @@ Sysutil::physical_concurrency()
 
 
 
+int
+Sysutil::numa_nodes()
+{
+#if defined(__linux__)
+    // The kernel lists the nodes that are online as ranges, like "0-1" or
+    // "0,2-3". We only care about the highest one.
+    static int nodes = []() {
+        std::string online;
+        if (!Filesystem::read_text_file("/sys/devices/system/node/online",
+                                        online))
+            return 1;
+        int highest = 0;
+        for (string_view range : Strutil::splitsv(online, ",")) {
+            auto ends = Strutil::splitsv(range, "-");
+            if (ends.size())
+                highest = std::max(highest, Strutil::stoi(ends.back()));
+        }
+        return highest + 1;
+    }();
+    return nodes;
+#else
+    return 1;
+#endif
+}
+
+
+
+int
+Sysutil::current_numa_node()
+{
+#if defined(__linux__) && defined(SYS_getcpu)
+    unsigned int cpu = 0, node = 0;
+    if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+        return int(node);
+#endif
+    return 0;
+}
+
+
+
+size_t
+Sysutil::cache_size(int level)
+{
+#if defined(__linux__)
+    // Each cache of cpu0 is described by a directory index0, index1, ...
+    // holding its level, type, and a size like "1024K".
+    for (int i = 0; i < 16; ++i) {
+        std::string dir = Strutil::fmt::format(
+            "/sys/devices/system/cpu/cpu0/cache/index{}/", i);
+        std::string lev, type, size;
+        if (!Filesystem::read_text_file(dir + "level", lev))
+            break;
+        if (Strutil::stoi(lev) != level
+            || !Filesystem::read_text_file(dir + "type", type)
+            || Strutil::starts_with(type, "Instruction")
+            || !Filesystem::read_text_file(dir + "size", size))
+            continue;
+        string_view sz(size);
+        int n = 0;
+        if (!Strutil::parse_int(sz, n))
+            continue;
+        size_t bytes = size_t(n);
+        if (Strutil::parse_char(sz, 'K'))
+            bytes *= 1024;
+        else if (Strutil::parse_char(sz, 'M'))
+            bytes *= 1024 * 1024;
+        return bytes;
+    }
+    return 0;
+#elif defined(__APPLE__)
+    const char* names[] = { "", "hw.l1dcachesize", "hw.l2cachesize",
+                            "hw.l3cachesize" };
+    if (level < 1 || level > 3)
+        return 0;
+    int64_t size  = 0;
+    size_t length = sizeof(size);
+    if (sysctlbyname(names[level], &size, &length, NULL, 0) != 0)
+        return 0;
+    return size_t(size);
+#elif defined(_WIN32)
+    DWORD length = 0;
+    GetLogicalProcessorInformation(nullptr, &length);
+    std::vector<SYSTEM_LOGICAL_PROCESSOR_INFORMATION> info(
+        length / sizeof(SYSTEM_LOGICAL_PROCESSOR_INFORMATION));
+    if (info.empty() || !GetLogicalProcessorInformation(info.data(), &length))
+        return 0;
+    for (auto& i : info)
+        if (i.Relationship == RelationCache && i.Cache.Level == level
+            && i.Cache.Type != CacheInstruction)
+            return size_t(i.Cache.Size);
+    return 0;
+#else
+    return 0;
+#endif
+}
+
+
+
 size_t
 Sysutil::max_open_files()
 {
@@ -707,4 +875,78 @@ Sysutil::setup_crash_stacktrace(string_view filename)
 }
 
 
+
+MemoryPressureMonitor::MemoryPressureMonitor(int stall_us, int window_us)
+{
+#ifdef __linux__
+    // A PSI trigger is set up by writing "some <stall> <window>" to a
+    // pressure file, which then polls with POLLPRI each time the tasks
+    // stall for that long within a window. Watch our own cgroup if we can,
+    // since its limit is the one that matters, otherwise the whole system.
+    std::string trigger = Strutil::fmt::format("some {} {}", stall_us,
+                                               window_us);
+    std::string dir     = cgroup_dir("/sys/fs/cgroup", "");
+    for (std::string file : { dir.size() ? dir + "/memory.pressure" : "",
+                              std::string("/proc/pressure/memory") }) {
+        if (file.empty())
+            continue;
+        int fd = ::open(file.c_str(), O_RDWR | O_NONBLOCK | O_CLOEXEC);
+        if (fd < 0)
+            continue;
+        if (::write(fd, trigger.c_str(), trigger.size() + 1) > 0) {
+            m_trigger = fd;
+            break;
+        }
+        ::close(fd);
+    }
+    if (m_trigger >= 0 && ::pipe(m_wake) != 0) {
+        ::close(m_trigger);
+        m_trigger = -1;
+    }
+#endif
+}
+
+
+
+MemoryPressureMonitor::~MemoryPressureMonitor()
+{
+#ifdef __linux__
+    for (int fd : { m_trigger, m_wake[0], m_wake[1] })
+        if (fd >= 0)
+            ::close(fd);
+#endif
+}
+
+
+
+bool
+MemoryPressureMonitor::wait(int timeout_ms)
+{
+#ifdef __linux__
+    if (m_trigger < 0)
+        return false;
+    pollfd fds[2] = { { m_trigger, POLLPRI, 0 }, { m_wake[0], POLLIN, 0 } };
+    int n         = ::poll(fds, 2, timeout_ms);
+    return n > 0 && !fds[1].revents && (fds[0].revents & POLLPRI)
+           && !(fds[0].revents & POLLERR);
+#else
+    return false;
+#endif
+}
+
+
+
+void
+MemoryPressureMonitor::interrupt()
+{
+#ifdef __linux__
+    if (m_wake[1] >= 0) {
+        char c = 0;
+        if (::write(m_wake[1], &c, 1) < 0) {
+            // Nothing to be done
+        }
+    }
+#endif
+}
+
 OIIO_NAMESPACE_END
@@ -18,6 +18,9 @@
 #    define _ENABLE_ATOMIC_ALIGNMENT_FIX /* Avoid MSVS error, ugh */
 #endif
 
+#include <algorithm>
+#include <cmath>
+#include <deque>
 #include <exception>
 #include <functional>
 #include <future>
@@ -27,6 +30,7 @@
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/thread.h>
+#include <OpenImageIO/trace.h>
 
 #include <boost/container/flat_map.hpp>
 
@@ -101,6 +105,7 @@ class thread_pool::Impl {
 public:
     Impl(int nThreads = 0, int queueSize = 1024)
         : q(queueSize)
+        , m_deques(new WorkerDeque[max_deques])
     {
         this->init();
         this->resize(nThreads);
@@ -163,15 +168,15 @@ public:
     void clear_queue()
     {
         std::function<void(int id)>* _f;
-        while (this->q.pop(_f))
-            delete _f;  // empty the queue
+        while (this->pop_task(-1, _f))
+            delete _f;  // empty the queue and all the worker deques
     }
 
     // pops a functional wraper to the original function
     std::function<void(int)> pop()
     {
         std::function<void(int id)>* _f = nullptr;
-        this->q.pop(_f);
+        this->pop_task(-1, _f);
         std::unique_ptr<std::function<void(int id)>> func(
             _f);  // at return, delete the function even if an exception occurred
         std::function<void(int)> f;
@@ -239,25 +244,54 @@ public:
         this->flags.clear();
     }
 
+    // A task pushed by one of our own workers goes on that worker's
+    // deque, anything else on the shared queue. Count it first, so that
+    // m_njobs is never less than the number of tasks waiting.
     void push_queue_and_notify(std::function<void(int id)>* f)
     {
-        this->q.push(f);
+        ++m_njobs;
+        int self = my_worker_index();
+        if (self >= 0)
+            m_deques[self].push_back(f);
+        else
+            this->q.push(f);
+        if (parallel_executor* executor = m_executor.load()) {
+            // Ask the host's scheduler for a thread to run a task -- this
+            // one, unless a waiting thread has helped itself to it first.
+            executor->submit(
+                [this]() { run_one_task(std::this_thread::get_id()); });
+            return;
+        }
         std::unique_lock<std::mutex> lock(this->mutex);
         this->cv.notify_one();
     }
 
-    // If any tasks are on the queue, pop and run one with the calling
-    // thread.
+    void set_executor(parallel_executor* executor)
+    {
+        m_executor = executor;
+        // Wake the idle threads, in case they have work again
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->cv.notify_all();
+    }
+
+    parallel_executor* executor() const { return m_executor.load(); }
+
+    // If any tasks are waiting, pop and run one with the calling thread.
+    // A worker of this pool that's waiting on its own subtasks will find
+    // them first, on its own deque.
     bool run_one_task(std::thread::id id)
     {
         std::function<void(int)>* f = nullptr;
-        bool isPop                  = this->q.pop(f);
+        bool isPop                  = this->pop_task(my_worker_index(), f);
         if (isPop) {
             OIIO_DASSERT(f);
             std::unique_ptr<std::function<void(int id)>> func(
                 f);  // at return, delete the function even if an exception occurred
             register_worker(id);
-            (*f)(-1);
+            {
+                OIIO_TRACE_ZONE("thread_pool task", "parallel");
+                (*f)(-1);
+            }
             deregister_worker(id);
         } else {
             OIIO_DASSERT(f == nullptr);
@@ -281,7 +315,10 @@ public:
         return m_worker_threadids[id] != 0;
     }
 
-    size_t jobs_in_queue() const { return q.size(); }
+    size_t jobs_in_queue() const
+    {
+        return size_t(std::max(0, m_njobs.load()));
+    }
 
     bool very_busy() const { return jobs_in_queue() > size_t(4 * m_size); }
 
@@ -291,32 +328,112 @@ private:
     Impl& operator=(const Impl&) = delete;
     Impl& operator=(Impl&&) = delete;
 
+    // Each worker has a deque of the tasks it pushed itself. The worker
+    // runs the newest of them first -- they're what it's most likely to be
+    // waiting on, and their data is still in its cache -- while other
+    // threads steal the oldest, which tend to be the biggest pieces of
+    // work left.
+    struct WorkerDeque {
+        spin_mutex mutex;
+        std::deque<std::function<void(int id)>*> tasks;
+
+        void push_back(std::function<void(int id)>* f)
+        {
+            spin_lock lock(mutex);
+            tasks.push_back(f);
+        }
+        bool pop_back(std::function<void(int id)>*& f)
+        {
+            spin_lock lock(mutex);
+            if (tasks.empty())
+                return false;
+            f = tasks.back();
+            tasks.pop_back();
+            return true;
+        }
+        bool pop_front(std::function<void(int id)>*& f)
+        {
+            spin_lock lock(mutex);
+            if (tasks.empty())
+                return false;
+            f = tasks.front();
+            tasks.pop_front();
+            return true;
+        }
+    };
+
+    // Workers numbered beyond this share the queue with outside threads.
+    static constexpr int max_deques = 256;
+
+    // The index of the calling thread among this pool's workers (which is
+    // also its deque), or -1 if it isn't one of them.
+    int my_worker_index() const
+    {
+        return (tls_pool == this && tls_worker < max_deques) ? tls_worker
+                                                             : -1;
+    }
+
+    // Pop a task for worker `self` (-1 for any other thread): the newest
+    // one on its own deque, else the oldest on the shared queue, else the
+    // oldest one stolen from another worker's deque.
+    bool pop_task(int self, std::function<void(int id)>*& f)
+    {
+        if (m_njobs.load() <= 0)
+            return false;  // nothing anywhere, don't bother locking
+        bool found = (self >= 0 && m_deques[self].pop_back(f))
+                     || this->q.pop(f);
+        for (int n = m_ndeques, i = 1; !found && i <= n; ++i) {
+            int victim = (self + i) % n;
+            if (victim != self)
+                found = m_deques[victim].pop_front(f);
+        }
+        if (found)
+            --m_njobs;
+        return found;
+    }
+
+    // Pop a task for our own pool thread to run, unless an executor has
+    // taken over the work.
+    bool worker_pop(std::function<void(int id)>*& f)
+    {
+        return !m_executor.load() && pop_task(my_worker_index(), f);
+    }
+
     void set_thread(int i)
     {
         std::shared_ptr<std::atomic<bool>> flag(
             this->flags[i]);  // a copy of the shared ptr to the flag
+        // The deques of workers that have since been removed by resize()
+        // stay in the list, so that any tasks left on them get stolen.
+        if (i < max_deques && m_ndeques < i + 1)
+            m_ndeques = i + 1;
         auto f = [this, i, flag /* a copy of the shared ptr to the flag */]() {
             register_worker(std::this_thread::get_id());
+            tls_pool                 = this;
+            tls_worker               = i;
             std::atomic<bool>& _flag = *flag;
             std::function<void(int id)>* _f;
-            bool isPop = this->q.pop(_f);
+            bool isPop = this->worker_pop(_f);
             while (true) {
                 while (isPop) {  // if there is anything in the queue
                     std::unique_ptr<std::function<void(int id)>> func(
                         _f);  // at return, delete the function even if an exception occurred
-                    (*_f)(i);
+                    {
+                        OIIO_TRACE_ZONE("thread_pool task", "parallel");
+                        (*_f)(i);
+                    }
                     if (_flag) {
                         // the thread is wanted to stop, return even if the queue is not empty yet
                         return;
                     } else {
-                        isPop = this->q.pop(_f);
+                        isPop = this->worker_pop(_f);
                     }
                 }
                 // the queue is empty here, wait for the next command
                 std::unique_lock<std::mutex> lock(this->mutex);
                 ++this->nWaiting;
                 this->cv.wait(lock, [this, &_f, &isPop, &_flag]() {
-                    isPop = this->q.pop(_f);
+                    isPop = this->worker_pop(_f);
                     return isPop || this->isDone || _flag;
                 });
                 --this->nWaiting;
@@ -324,6 +441,7 @@ private:
                     break;  // if the queue is empty and this->isDone == true or *flag then return
             }
             deregister_worker(std::this_thread::get_id());
+            tls_pool = nullptr;
         };
         this->threads[i].reset(
             new std::thread(f));  // compiler may not support std::make_unique()
@@ -339,7 +457,11 @@ private:
     std::vector<std::unique_ptr<std::thread>> threads;
     std::vector<std::unique_ptr<std::thread>> terminating_threads;
     std::vector<std::shared_ptr<std::atomic<bool>>> flags;
-    mutable Queue<std::function<void(int id)>*> q;
+    mutable Queue<std::function<void(int id)>*> q;  // tasks from outside
+    std::unique_ptr<WorkerDeque[]> m_deques;        // one per worker
+    std::atomic<int> m_ndeques { 0 };  // How many deques have been used
+    std::atomic<int> m_njobs { 0 };    // Tasks in the queue and deques
+    std::atomic<parallel_executor*> m_executor { nullptr };  // Host's, if any
     std::atomic<bool> isDone;
     std::atomic<bool> isStop;
     std::atomic<int> nWaiting;  // how many threads are waiting
@@ -348,10 +470,18 @@ private:
     std::condition_variable cv;
     mutable boost::container::flat_map<std::thread::id, int> m_worker_threadids;
     mutable spin_mutex m_worker_threadids_mutex;
+
+    static thread_local const Impl* tls_pool;  // Pool the thread works for
+    static thread_local int tls_worker;        // Its worker index there
 };
 
 
 
+thread_local const thread_pool::Impl* thread_pool::Impl::tls_pool = nullptr;
+thread_local int thread_pool::Impl::tls_worker                    = -1;
+
+
+
 thread_pool::thread_pool(int nthreads)
     : m_impl(new Impl(nthreads))
 {
@@ -459,6 +589,26 @@ thread_pool::very_busy() const
 
 
 
+void
+thread_pool::set_executor(parallel_executor* executor)
+{
+    m_impl->set_executor(executor);
+}
+
+
+
+parallel_executor*
+thread_pool::executor() const
+{
+    return m_impl->executor();
+}
+
+
+
+parallel_executor::~parallel_executor() {}
+
+
+
 thread_pool*
 default_thread_pool()
 {
@@ -475,14 +625,16 @@ task_set::wait_for_task(size_t taskindex, bool block)
     if (taskindex >= m_futures.size())
         return;  // nothing to wait for
     auto& f(m_futures[taskindex]);
-    if (block || m_pool->is_worker(m_submitter_thread)) {
+    if (block) {
         // Block on completion of all the task and don't try to do any
         // of the work with the calling thread.
         f.wait();
         return;
     }
     // If we made it here, we want to allow the calling thread to help
-    // do pool work if it's waiting around for a while.
+    // do pool work if it's waiting around for a while. That goes for pool
+    // workers too: blocking one that's waiting on its own subtasks would
+    // just take it out of the pool (or deadlock, if it's the only one).
     const std::chrono::milliseconds wait_time(0);
     int tries = 0;
     while (1) {
@@ -511,8 +663,6 @@ task_set::wait(bool block)
 {
     OIIO_DASSERT(submitter() == std::this_thread::get_id());
     const std::chrono::milliseconds wait_time(0);
-    if (m_pool->is_worker(m_submitter_thread))
-        block = true;  // don't get into recursive work stealing
     if (block == false) {
         int tries = 0;
         while (1) {
@@ -568,27 +718,14 @@ task_set::wait(bool block)
 
 
 
-// Helper function to keep track of the recursve depth of our use of the
-// thread pool. Call with the adjustment (i.e., parallel_recursive_depth(1)
-// to enter, parallel_recursive_depth(-1) to exit), and it will return the
-// new value. Call with default args (0) to just return the current depth.
-static int
-parallel_recursive_depth(int change = 0)
-{
-    thread_local int depth = 0;  // let's only allow one level of parallel work
-    depth += change;
-    return depth;
-}
-
-
-
 void
 parallel_for_chunked(int64_t start, int64_t end, int64_t chunksize,
                      std::function<void(int id, int64_t b, int64_t e)>&& task,
                      parallel_options opt)
 {
-    if (parallel_recursive_depth(1) > 1)
-        opt.maxthreads = 1;
+    // Nested calls are fine: the subtasks a pool worker pushes go on its
+    // own deque, and while it waits for them it runs them itself, unless
+    // idle threads have stolen them first.
     opt.resolve();
     chunksize = std::min(chunksize, end - start);
     if (chunksize < 1) {           // If caller left chunk size to us...
@@ -601,6 +738,19 @@ parallel_for_chunked(int64_t start, int64_t end, int64_t chunksize,
     }
     // N.B. If chunksize was specified, honor it, even for the single
     // threaded case.
+    parallel_executor* executor = opt.pool->executor();
+    if (executor && !opt.singlethread() && chunksize < end - start) {
+        // The host's scheduler splits the loop, over whole chunks so that
+        // the task still sees exactly the ranges it would have otherwise.
+        int64_t nchunks = (end - start + chunksize - 1) / chunksize;
+        executor->parallel_for(0, nchunks, 1, [&](int64_t cb, int64_t ce) {
+            OIIO_TRACE_ZONE("executor chunk", "parallel");
+            for (int64_t c = cb; c < ce; ++c)
+                task(-1, start + c * chunksize,
+                     std::min(end, start + (c + 1) * chunksize));
+        });
+        return;
+    }
     for (task_set ts(opt.pool); start < end; start += chunksize) {
         int64_t e = std::min(end, start + chunksize);
         if (e == end || opt.singlethread() || opt.pool->very_busy()) {
@@ -608,12 +758,43 @@ parallel_for_chunked(int64_t start, int64_t end, int64_t chunksize,
             // thread, or if the pool is already oversubscribed, do it
             // ourselves and avoid messing with the queue or handing off
             // between threads.
+            OIIO_TRACE_ZONE("caller chunk", "parallel");
             task(-1, start, e);
         } else {
             ts.push(opt.pool->push(task, start, e));
         }
     }
-    parallel_recursive_depth(-1);
+}
+
+
+
+int64_t
+cache_tile_size(size_t itembytes)
+{
+    static const size_t l2 = Sysutil::cache_size(2);
+    size_t cache = l2 ? l2 : 256 * 1024;  // a conservative guess
+    if (!itembytes)
+        itembytes = 32;
+    int64_t side = int64_t(std::sqrt(double(cache / 2) / double(itembytes)));
+    return std::min(std::max(side & ~int64_t(7), int64_t(8)), int64_t(1024));
+}
+
+
+
+// Interleave the bits of x and y, giving the position of (x,y) along a
+// Z-shaped (Morton order) curve that visits 2D neighbours close together.
+static uint64_t
+morton_code(uint32_t x, uint32_t y)
+{
+    auto spread = [](uint64_t v) {
+        v = (v | (v << 16)) & 0x0000FFFF0000FFFFull;
+        v = (v | (v << 8)) & 0x00FF00FF00FF00FFull;
+        v = (v | (v << 4)) & 0x0F0F0F0F0F0F0F0Full;
+        v = (v | (v << 2)) & 0x3333333333333333ull;
+        v = (v | (v << 1)) & 0x5555555555555555ull;
+        return v;
+    };
+    return spread(x) | (spread(y) << 1);
 }
 
 
@@ -625,14 +806,11 @@ parallel_for_chunked_2D(
     std::function<void(int id, int64_t, int64_t, int64_t, int64_t)>&& task,
     parallel_options opt)
 {
-    if (parallel_recursive_depth(1) > 1)
-        opt.maxthreads = 1;
     opt.resolve();
     if (opt.singlethread()
         || (xchunksize >= (xend - xstart) && ychunksize >= (yend - ystart))
         || opt.pool->very_busy()) {
         task(-1, xstart, xend, ystart, yend);
-        parallel_recursive_depth(-1);
         return;
     }
     if (ychunksize < 1)
@@ -643,6 +821,47 @@ parallel_for_chunked_2D(
         int64_t nx = std::max(int64_t(1), opt.maxthreads / ny);
         xchunksize = std::max(int64_t(1), (xend - xstart) / nx);
     }
+    if (opt.splitdir == Split_Tile) {
+        // List the tiles in Morton order and give each task a run of
+        // consecutive ones, which is a compact patch of the range rather
+        // than a strip, so neighbouring tiles (whose footprints may well
+        // overlap) mostly end up sharing a thread and its cache.
+        int64_t nx = (xend - xstart + xchunksize - 1) / xchunksize;
+        int64_t ny = (yend - ystart + ychunksize - 1) / ychunksize;
+        std::vector<std::pair<uint64_t, int64_t>> order;  // code, tile
+        order.reserve(size_t(nx * ny));
+        for (int64_t t = 0; t < nx * ny; ++t)
+            order.emplace_back(morton_code(uint32_t(t % nx), uint32_t(t / nx)),
+                               t);
+        std::sort(order.begin(), order.end());
+        int64_t run = std::max(int64_t(1), nx * ny / (4 * opt.maxthreads));
+        parallel_for_chunked(
+            0, nx * ny, run,
+            [&](int id, int64_t b, int64_t e) {
+                for (int64_t i = b; i < e; ++i) {
+                    int64_t t = order[i].second;
+                    int64_t x = xstart + (t % nx) * xchunksize;
+                    int64_t y = ystart + (t / nx) * ychunksize;
+                    task(id, x, std::min(xend, x + xchunksize), y,
+                         std::min(yend, y + ychunksize));
+                }
+            },
+            opt);
+        return;
+    }
+    if (parallel_executor* executor = opt.pool->executor()) {
+        int64_t nx = (xend - xstart + xchunksize - 1) / xchunksize;
+        int64_t ny = (yend - ystart + ychunksize - 1) / ychunksize;
+        executor->parallel_for(0, nx * ny, 1, [&](int64_t tb, int64_t te) {
+            for (int64_t t = tb; t < te; ++t) {
+                int64_t x = xstart + (t % nx) * xchunksize;
+                int64_t y = ystart + (t / nx) * ychunksize;
+                task(-1, x, std::min(xend, x + xchunksize), y,
+                     std::min(yend, y + ychunksize));
+            }
+        });
+        return;
+    }
     task_set ts(opt.pool);
     for (auto y = ystart; y < yend; y += ychunksize) {
         int64_t ychunkend = std::min(yend, y + ychunksize);
@@ -651,7 +870,6 @@ parallel_for_chunked_2D(
             ts.push(opt.pool->push(task, x, xchunkend, y, ychunkend));
         }
     }
-    parallel_recursive_depth(-1);
 }
 
 
@@ -5,12 +5,14 @@
 
 #include <OpenImageIO/argparse.h>
 #include <OpenImageIO/benchmark.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/simd.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/timer.h>
+#include <OpenImageIO/trace.h>
 #include <OpenImageIO/unittest.h>
 
 #include <iostream>
@@ -148,5 +150,77 @@ main(int argc, char** argv)
     bench("sqrt", [&]() { DoNotOptimize(std::sqrt(val)); });
     bench.work(4);
     bench("simd sqrt", [&]() { DoNotOptimize(sqrt(val4)); });
+
+    // Test warmup, robust outlier exclusion, hardware counters, and the
+    // machine-readable results.
+    {
+        Benchmarker b;
+        b.warmup(2).outlier_mad(3.0).hw_counters(true).trials(15).work(1);
+        b("sqrt, counted", [&]() { DoNotOptimize(std::sqrt(val)); });
+        OIIO_CHECK_ASSERT(b.median() > 0.0);
+        if (b.counters().valid)
+            OIIO_CHECK_ASSERT(b.counters().cycles > 0.0);
+        Benchmarker::Result r = b.result();
+        OIIO_CHECK_EQUAL(r.name, "sqrt, counted");
+        OIIO_CHECK_EQUAL(r.trials, 15);
+        OIIO_CHECK_EQUAL(r.median, b.median());
+
+        auto all = Benchmarker::all_results();
+        OIIO_CHECK_ASSERT(all.size() >= 9);
+        for (const char* filename : { "timer_test_results.json",
+                                      "timer_test_results.csv" }) {
+            std::vector<Benchmarker::Result> read;
+            OIIO_CHECK_ASSERT(Benchmarker::write_results(filename));
+            OIIO_CHECK_ASSERT(Benchmarker::read_results(filename, read));
+            OIIO_CHECK_EQUAL(read.size(), all.size());
+            if (read.size() == all.size()) {
+                OIIO_CHECK_EQUAL(read.back().name, all.back().name);
+                OIIO_CHECK_EQUAL(read.back().iterations,
+                                 all.back().iterations);
+                OIIO_CHECK_EQUAL_THRESH(read.back().median,
+                                        all.back().median, 1e-12);
+                OIIO_CHECK_EQUAL(read.back().counters.valid,
+                                 all.back().counters.valid);
+            }
+            OIIO_CHECK_EQUAL(Benchmarker::compare_to_baseline(filename, 0.05,
+                                                              nullptr),
+                             0);
+            Filesystem::remove(filename);
+        }
+        OIIO_CHECK_EQUAL(Benchmarker::compare_to_baseline("nonexistent.json",
+                                                          0.05, nullptr),
+                         -1);
+    }
+
+    // Test tracing: only zones begun while a trace is recorded are written
+    {
+        const char* filename = "timer_test_trace.json";
+        { OIIO_TRACE_ZONE("before", "test"); }
+        OIIO_CHECK_ASSERT(!Tracing::enabled());
+        OIIO_CHECK_ASSERT(Tracing::start(filename));
+        OIIO_CHECK_ASSERT(Tracing::enabled());
+        OIIO_CHECK_EQUAL(Tracing::filename(), filename);
+        {
+            OIIO_TRACE_ZONE("outer \"zone\"", "test", "some detail");
+            OIIO_TRACE_ZONE("inner", "test");
+            Sysutil::usleep(1000);
+        }
+        OIIO_CHECK_ASSERT(Tracing::stop());
+        OIIO_CHECK_ASSERT(!Tracing::stop());
+        OIIO_CHECK_EQUAL(Tracing::filename(), "");
+        { OIIO_TRACE_ZONE("after", "test"); }
+
+        std::string trace;
+        OIIO_CHECK_ASSERT(Filesystem::read_text_file(filename, trace));
+        std::cout << trace;
+        OIIO_CHECK_ASSERT(Strutil::contains(trace, "\"traceEvents\""));
+        OIIO_CHECK_ASSERT(Strutil::contains(trace, "outer \\\"zone\\\""));
+        OIIO_CHECK_ASSERT(Strutil::contains(trace, "\"inner\""));
+        OIIO_CHECK_ASSERT(Strutil::contains(trace, "some detail"));
+        OIIO_CHECK_ASSERT(!Strutil::contains(trace, "\"before\""));
+        OIIO_CHECK_ASSERT(!Strutil::contains(trace, "\"after\""));
+        Filesystem::remove(filename);
+    }
+
     return unit_test_failures;
 }
@@ -0,0 +1,197 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/trace.h>
+
+
+OIIO_NAMESPACE_BEGIN
+
+namespace Tracing {
+
+namespace pvt {
+std::atomic<bool> active(false);
+}
+
+namespace {
+
+struct Event {
+    const char* name;
+    const char* category;
+    const char* detail;
+    uint64_t begin, end;
+};
+
+// The events of one thread. Only that thread writes them, so recording
+// needs no locks; the trace is exported after recording is turned off.
+struct ThreadBuffer {
+    static constexpr uint64_t capacity = 1 << 16;
+    std::unique_ptr<Event[]> events { new Event[capacity] };
+    std::atomic<uint64_t> count { 0 };  // Events ever recorded
+    int tid = 0;
+};
+
+struct TraceState {
+    std::mutex mutex;
+    std::string filename;
+    uint64_t start_time = 0;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+
+    // Write any trace still being recorded when the program exits
+    ~TraceState()
+    {
+        if (filename.size())
+            stop();
+    }
+};
+
+static TraceState&
+trace_state()
+{
+    static TraceState state;
+    return state;
+}
+
+static thread_local std::shared_ptr<ThreadBuffer> tls_buffer;
+
+
+
+static void
+append_json_string(std::string& out, const char* s)
+{
+    out += '"';
+    for (; *s; ++s) {
+        if (*s == '"' || *s == '\\')
+            out += '\\';
+        if ((unsigned char)*s < ' ')
+            out += Strutil::fmt::format("\\u{:04x}", int(*s));
+        else
+            out += *s;
+    }
+    out += '"';
+}
+
+}  // namespace
+
+
+
+uint64_t
+pvt::now_ns() noexcept
+{
+    return uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now().time_since_epoch())
+                        .count());
+}
+
+
+
+void
+pvt::record(const char* name, const char* category, const char* detail,
+            uint64_t begin, uint64_t end) noexcept
+{
+    ThreadBuffer* buf = tls_buffer.get();
+    if (!buf) {
+        // First event of this thread: register its buffer, which lives on
+        // in the registry after the thread exits.
+        TraceState& state(trace_state());
+        std::lock_guard<std::mutex> lock(state.mutex);
+        tls_buffer      = std::make_shared<ThreadBuffer>();
+        tls_buffer->tid = int(state.buffers.size()) + 1;
+        state.buffers.push_back(tls_buffer);
+        buf = tls_buffer.get();
+    }
+    uint64_t n = buf->count.load(std::memory_order_relaxed);
+    buf->events[n % ThreadBuffer::capacity] = { name, category, detail, begin,
+                                                end };
+    buf->count.store(n + 1, std::memory_order_release);
+}
+
+
+
+bool
+start(string_view filename)
+{
+    if (filename.empty())
+        return false;
+    stop();
+    TraceState& state(trace_state());
+    std::lock_guard<std::mutex> lock(state.mutex);
+    for (auto& buf : state.buffers)
+        buf->count.store(0, std::memory_order_relaxed);
+    state.filename   = filename;
+    state.start_time = pvt::now_ns();
+    pvt::active.store(true);
+    return true;
+}
+
+
+
+bool
+stop()
+{
+    TraceState& state(trace_state());
+    std::lock_guard<std::mutex> lock(state.mutex);
+    if (!pvt::active.exchange(false))
+        return false;
+    std::string filename;
+    std::swap(filename, state.filename);
+
+    std::string out = "{\"traceEvents\": [\n";
+    for (auto& buf : state.buffers) {
+        uint64_t count = buf->count.load(std::memory_order_acquire);
+        if (!count)
+            continue;
+        out += Strutil::fmt::format(
+            "{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+            "\"tid\": {}, \"args\": {{\"name\": \"thread {}\"}}}},\n",
+            buf->tid, buf->tid);
+        uint64_t first = count > ThreadBuffer::capacity
+                             ? count - ThreadBuffer::capacity
+                             : 0;
+        for (uint64_t i = first; i < count; ++i) {
+            const Event& e(buf->events[i % ThreadBuffer::capacity]);
+            if (e.begin < state.start_time)
+                continue;  // Begun before this trace started
+            out += "{\"name\": ";
+            append_json_string(out, e.name);
+            out += ", \"cat\": ";
+            append_json_string(out, e.category);
+            out += Strutil::fmt::format(
+                ", \"ph\": \"X\", \"ts\": {:.3f}, \"dur\": {:.3f}, "
+                "\"pid\": 1, \"tid\": {}",
+                (e.begin - state.start_time) * 1.0e-3,
+                (e.end - e.begin) * 1.0e-3, buf->tid);
+            if (e.detail && e.detail[0]) {
+                out += ", \"args\": {\"detail\": ";
+                append_json_string(out, e.detail);
+                out += "}";
+            }
+            out += "},\n";
+        }
+    }
+    if (Strutil::ends_with(out, ",\n"))
+        out.erase(out.size() - 2, 1);  // No comma after the last event
+    out += "],\n\"displayTimeUnit\": \"ns\"}\n";
+    return Filesystem::write_text_file(filename, out);
+}
+
+
+
+std::string
+filename()
+{
+    TraceState& state(trace_state());
+    std::lock_guard<std::mutex> lock(state.mutex);
+    return state.filename;
+}
+
+}  // namespace Tracing
+
+OIIO_NAMESPACE_END
@@ -14,10 +14,9 @@
 
 OIIO_NAMESPACE_BEGIN
 
-// Use rw spin locks
-typedef spin_rw_mutex ustring_mutex_t;
-typedef spin_rw_read_lock ustring_read_lock_t;
-typedef spin_rw_write_lock ustring_write_lock_t;
+// Only insertions lock; lookups don't.
+typedef spin_mutex ustring_mutex_t;
+typedef spin_lock ustring_lock_t;
 
 
 #define PREVENT_HASH_COLLISIONS 1
@@ -32,16 +31,22 @@ template<class T> struct identity {
 // #define USTRING_TRACK_NUM_LOOKUPS
 
 
+// An open-addressed hash table of TableReps whose lookups take no lock.
+// Slots only ever change from empty to a fully constructed TableRep,
+// published with a release store, and when the table outgrows its slot
+// array, a copy twice the size is published in the same way. The old
+// array is never freed (a lookup may still be probing it), which costs no
+// more than the current array in total. A lookup that raced with the
+// growth may miss a string that was just added, in which case the caller
+// falls back to insert(), which holds the mutex and will find it.
 template<unsigned BASE_CAPACITY, unsigned POOL_SIZE> struct TableRepMap {
     static_assert((BASE_CAPACITY & (BASE_CAPACITY - 1)) == 0,
                   "BASE_CAPACITY must be a power of 2");
 
     TableRepMap()
-        : entries(static_cast<ustring::TableRep**>(
-            calloc(BASE_CAPACITY, sizeof(ustring::TableRep*))))
+        : table(new_table(BASE_CAPACITY - 1))
         , pool(static_cast<char*>(malloc(POOL_SIZE)))
-        , memory_usage(sizeof(*this) + POOL_SIZE
-                       + sizeof(ustring::TableRep*) * BASE_CAPACITY)
+        , memory_usage(sizeof(*this) + POOL_SIZE + table_bytes(BASE_CAPACITY))
     {
     }
 
@@ -51,27 +56,22 @@ template<unsigned BASE_CAPACITY, unsigned POOL_SIZE> struct TableRepMap {
 
     size_t get_memory_usage()
     {
-        ustring_read_lock_t lock(mutex);
+        ustring_lock_t lock(mutex);
         return memory_usage;
     }
 
     size_t get_num_entries()
     {
-        ustring_read_lock_t lock(mutex);
+        ustring_lock_t lock(mutex);
         return num_entries;
     }
 
 #ifdef USTRING_TRACK_NUM_LOOKUPS
-    size_t get_num_lookups()
-    {
-        ustring_read_lock_t lock(mutex);
-        return num_lookups;
-    }
+    size_t get_num_lookups() { return num_lookups; }
 #endif
 
     const char* lookup(string_view str, size_t hash)
     {
-        ustring_read_lock_t lock(mutex);
 #ifdef USTRING_TRACK_NUM_LOOKUPS
         // NOTE: this simple increment adds a substantial amount of overhead
         // so keep it off by default, unless the user really wants it
@@ -79,74 +79,103 @@ template<unsigned BASE_CAPACITY, unsigned POOL_SIZE> struct TableRepMap {
         // can skew the number of lookups compared to release builds
         ++num_lookups;
 #endif
-        size_t pos = hash & mask, dist = 0;
+        const Table* t = table.load(std::memory_order_acquire);
+        size_t pos = hash & t->mask, dist = 0;
         for (;;) {
-            if (entries[pos] == 0)
+            const ustring::TableRep* rep = t->slots()[pos].load(
+                std::memory_order_acquire);
+            if (rep == 0)
                 return 0;
-            if (entries[pos]->hashed == hash
-                && entries[pos]->length == str.length()
-                && strncmp(entries[pos]->c_str(), str.data(), str.length())
-                       == 0)
-                return entries[pos]->c_str();
+            if (matches(rep, str, hash))
+                return rep->c_str();
             ++dist;
-            pos = (pos + dist) & mask;  // quadratic probing
+            pos = (pos + dist) & t->mask;  // quadratic probing
         }
     }
 
     const char* insert(string_view str, size_t hash)
     {
-        ustring_write_lock_t lock(mutex);
-        size_t pos = hash & mask, dist = 0;
+        ustring_lock_t lock(mutex);
+        Table* t   = table.load(std::memory_order_relaxed);
+        size_t pos = hash & t->mask, dist = 0;
         for (;;) {
-            if (entries[pos] == 0)
+            const ustring::TableRep* rep = t->slots()[pos].load(
+                std::memory_order_relaxed);
+            if (rep == 0)
                 break;  // found insert pos
-            if (entries[pos]->hashed == hash
-                && entries[pos]->length == str.length()
-                && !strncmp(entries[pos]->c_str(), str.data(), str.length())) {
+            if (matches(rep, str, hash)) {
                 // same string is already inserted, return the one that is
                 // already in the table
-                return entries[pos]->c_str();
+                return rep->c_str();
             }
             ++dist;
-            pos = (pos + dist) & mask;  // quadratic probing
+            pos = (pos + dist) & t->mask;  // quadratic probing
         }
 
         ustring::TableRep* rep = make_rep(str, hash);
-        entries[pos]           = rep;
+        t->slots()[pos].store(rep, std::memory_order_release);
         ++num_entries;
-        if (2 * num_entries > mask)
+        if (2 * num_entries > t->mask)
             grow();           // maintain 0.5 load factor
         return rep->c_str();  // rep is now in the table
     }
 
 private:
-    void grow()
+    // A slot array and its size, allocated together.
+    struct Table {
+        size_t mask;
+        std::atomic<ustring::TableRep*>* slots() const
+        {
+            return (std::atomic<ustring::TableRep*>*)(this + 1);
+        }
+    };
+
+    static size_t table_bytes(size_t capacity)
+    {
+        return sizeof(Table)
+               + capacity * sizeof(std::atomic<ustring::TableRep*>);
+    }
+
+    static Table* new_table(size_t mask)
     {
-        size_t new_mask = mask * 2 + 1;
+        Table* t = static_cast<Table*>(malloc(table_bytes(mask + 1)));
+        t->mask  = mask;
+        for (size_t i = 0; i <= mask; ++i)
+            new (t->slots() + i) std::atomic<ustring::TableRep*>(nullptr);
+        return t;
+    }
 
-        // NOTE: only increment by half because we are doubling the entries and freeing the old
-        memory_usage += (mask + 1) * sizeof(ustring::TableRep*);
+    static bool matches(const ustring::TableRep* rep, string_view str,
+                        size_t hash)
+    {
+        return rep->hashed == hash && rep->length == str.length()
+               && !strncmp(rep->c_str(), str.data(), str.length());
+    }
+
+    void grow()
+    {
+        const Table* old = table.load(std::memory_order_relaxed);
+        Table* t         = new_table(old->mask * 2 + 1);
+        // NOTE: the old table is never freed, see above
+        memory_usage += table_bytes(t->mask + 1);
 
-        ustring::TableRep** new_entries = static_cast<ustring::TableRep**>(
-            calloc(new_mask + 1, sizeof(ustring::TableRep*)));
         size_t to_copy = num_entries;
         for (size_t i = 0; to_copy != 0; i++) {
-            if (entries[i] == 0)
+            ustring::TableRep* rep = old->slots()[i].load(
+                std::memory_order_relaxed);
+            if (rep == 0)
                 continue;
-            size_t pos = entries[i]->hashed & new_mask, dist = 0;
+            size_t pos = rep->hashed & t->mask, dist = 0;
             for (;;) {
-                if (new_entries[pos] == 0)
+                if (t->slots()[pos].load(std::memory_order_relaxed) == 0)
                     break;
                 ++dist;
-                pos = (pos + dist) & new_mask;  // quadratic probing
+                pos = (pos + dist) & t->mask;  // quadratic probing
             }
-            new_entries[pos] = entries[i];
+            t->slots()[pos].store(rep, std::memory_order_relaxed);
             to_copy--;
         }
-
-        free(entries);
-        entries = new_entries;
-        mask    = new_mask;
+        table.store(t, std::memory_order_release);
     }
 
     ustring::TableRep* make_rep(string_view str, size_t hash)
@@ -176,15 +205,14 @@ private:
         return result;
     }
 
+    OIIO_CACHE_ALIGN std::atomic<Table*> table;
     OIIO_CACHE_ALIGN mutable ustring_mutex_t mutex;
-    size_t mask = BASE_CAPACITY - 1;
-    ustring::TableRep** entries;
     size_t num_entries = 0;
     char* pool;
     size_t pool_offset = 0;
     size_t memory_usage;
 #ifdef USTRING_TRACK_NUM_LOOKUPS
-    size_t num_lookups = 0;
+    std::atomic<size_t> num_lookups { 0 };
 #endif
 };
 
@@ -50,6 +50,29 @@ create_lotso_ustrings(int iterations)
 
 
 
+// Mostly look up strings that already exist, making a new one every 16th
+// time, as parsing metadata tends to. This is the mix that lock-free
+// lookups in the ustring table are meant to scale for.
+static void
+lookup_mostly_ustrings(int iterations)
+{
+    static atomic_ll nnew(0);
+    size_t h = 0;
+    for (int i = 0; i < iterations; ++i) {
+        if ((i & 15) == 15) {
+            char buf[32];
+            snprintf(buf, sizeof(buf), "new%lld", (long long)(nnew++));
+            h += ustring(buf).hash();
+        } else {
+            h += ustring(strings[i % strings.size()].data()).hash();
+        }
+    }
+    if (verbose)
+        Strutil::printf("checksum %08x\n", unsigned(h));
+}
+
+
+
 static void
 getargs(int argc, char* argv[])
 {
@@ -119,6 +142,17 @@ main(int argc, char* argv[])
     }
     OIIO_CHECK_ASSERT(true);  // If we make it here without crashing, pass
 
+    // The strings all exist now, so this is mostly lookups
+    std::cout << "\nLookups with 1 in 16 new strings:\n";
+    if (wedge) {
+        timed_thread_wedge(lookup_mostly_ustrings, numthreads, iterations,
+                           ntrials);
+    } else {
+        timed_thread_wedge(lookup_mostly_ustrings, numthreads, iterations,
+                           ntrials,
+                           numthreads /* just this one thread count */);
+    }
+
     // Try to force a hash collision
     parallel_for(0LL, 1000000LL * int64_t(collide),
                  [](int64_t i) { ustring u = ustring::fmtformat("{:x}", i); });
@@ -944,5 +944,401 @@ unsigned long long XXH64_digest (const XXH64_state_t* state_in)
 }
 
 
+
+//**************************************
+// XXH3 (xxHash 0.8), 64 and 128 bit variants
+//**************************************
+// A port of the portable code of the upstream xxhash.h, plus an SSE2 inner
+// loop on x86. Hashes are identical to upstream's XXH3_64bits_withSeed and
+// XXH3_128bits_withSeed on every platform.
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#  define XXH3_SSE2 1
+#  include <emmintrin.h>
+#endif
+#if defined(_MSC_VER) && defined(_M_X64)
+#  include <intrin.h>   // _umul128
+#endif
+
+#define XXH3_SECRET_SIZE      192
+#define XXH3_SECRET_SIZE_MIN  136
+#define XXH3_MIDSIZE_MAX      240
+#define XXH3_STRIPE_LEN        64
+#define XXH3_SECRET_CONSUME     8
+#define XXH3_ACC_NB             8
+#define XXH3_PRIME_MX1 0x165667919E3779F9ULL
+#define XXH3_PRIME_MX2 0x9FB21C651E98DF25ULL
+
+// Pseudorandom secret taken directly from FARSH
+alignas(64) static const BYTE XXH3_kSecret[XXH3_SECRET_SIZE] = {
+    0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+    0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+    0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+    0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+    0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+    0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+    0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+    0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+    0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+    0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+    0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+    0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+};
+
+FORCE_INLINE U32 XXH3_read32(const void* ptr)
+{
+    U32 v;
+    XXH_memcpy(&v, ptr, 4);
+    return XXH_CPU_LITTLE_ENDIAN ? v : XXH_swap32(v);
+}
+
+FORCE_INLINE U64 XXH3_read64(const void* ptr)
+{
+    U64 v;
+    XXH_memcpy(&v, ptr, 8);
+    return XXH_CPU_LITTLE_ENDIAN ? v : XXH_swap64(v);
+}
+
+FORCE_INLINE void XXH3_write64(void* dst, U64 v)
+{
+    if (!XXH_CPU_LITTLE_ENDIAN)
+        v = XXH_swap64(v);
+    XXH_memcpy(dst, &v, 8);
+}
+
+FORCE_INLINE XXH128_hash_t XXH3_mult64to128(U64 lhs, U64 rhs)
+{
+    XXH128_hash_t r;
+#if defined(__SIZEOF_INT128__)
+    __uint128_t const product = (__uint128_t)lhs * (__uint128_t)rhs;
+    r.low64  = (U64)product;
+    r.high64 = (U64)(product >> 64);
+#elif defined(_M_X64) && !defined(_M_ARM64EC)
+    r.low64 = _umul128(lhs, rhs, &r.high64);
+#else
+    U64 const lo_lo = (lhs & 0xFFFFFFFF) * (rhs & 0xFFFFFFFF);
+    U64 const hi_lo = (lhs >> 32)        * (rhs & 0xFFFFFFFF);
+    U64 const lo_hi = (lhs & 0xFFFFFFFF) * (rhs >> 32);
+    U64 const hi_hi = (lhs >> 32)        * (rhs >> 32);
+    U64 const cross = (lo_lo >> 32) + (hi_lo & 0xFFFFFFFF) + lo_hi;
+    r.high64 = (hi_lo >> 32) + (cross >> 32) + hi_hi;
+    r.low64  = (cross << 32) | (lo_lo & 0xFFFFFFFF);
+#endif
+    return r;
+}
+
+FORCE_INLINE U64 XXH3_mul128_fold64(U64 lhs, U64 rhs)
+{
+    XXH128_hash_t const product = XXH3_mult64to128(lhs, rhs);
+    return product.low64 ^ product.high64;
+}
+
+FORCE_INLINE U64 XXH3_xorshift64(U64 v, int shift)
+{
+    return v ^ (v >> shift);
+}
+
+static U64 XXH3_avalanche64(U64 h)  // XXH64's avalanche
+{
+    h ^= h >> 33;
+    h *= PRIME64_2;
+    h ^= h >> 29;
+    h *= PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
+
+static U64 XXH3_avalanche(U64 h)
+{
+    h = XXH3_xorshift64(h, 37);
+    h *= XXH3_PRIME_MX1;
+    return XXH3_xorshift64(h, 32);
+}
+
+static U64 XXH3_rrmxmx(U64 h, U64 len)
+{
+    h ^= XXH_rotl64(h, 49) ^ XXH_rotl64(h, 24);
+    h *= XXH3_PRIME_MX2;
+    h ^= (h >> 35) + len;
+    h *= XXH3_PRIME_MX2;
+    return XXH3_xorshift64(h, 28);
+}
+
+FORCE_INLINE U64 XXH3_mix16B(const BYTE* input, const BYTE* secret, U64 seed)
+{
+    return XXH3_mul128_fold64(XXH3_read64(input)     ^ (XXH3_read64(secret)     + seed),
+                              XXH3_read64(input + 8) ^ (XXH3_read64(secret + 8) - seed));
+}
+
+FORCE_INLINE XXH128_hash_t XXH3_mix32B(XXH128_hash_t acc, const BYTE* input_1, const BYTE* input_2,
+                                       const BYTE* secret, U64 seed)
+{
+    acc.low64  += XXH3_mix16B(input_1, secret, seed);
+    acc.low64  ^= XXH3_read64(input_2) + XXH3_read64(input_2 + 8);
+    acc.high64 += XXH3_mix16B(input_2, secret + 16, seed);
+    acc.high64 ^= XXH3_read64(input_1) + XXH3_read64(input_1 + 8);
+    return acc;
+}
+
+
+// Long inputs: 8 lanes of accumulators, consuming 64 byte stripes
+
+static void XXH3_accumulate_512(U64* acc, const BYTE* input, const BYTE* secret)
+{
+#if XXH3_SSE2
+    __m128i* xacc = (__m128i*)acc;
+    for (int i = 0; i < XXH3_ACC_NB / 2; i++) {
+        __m128i const data_vec = _mm_loadu_si128((const __m128i*)input + i);
+        __m128i const key_vec  = _mm_loadu_si128((const __m128i*)secret + i);
+        __m128i const data_key = _mm_xor_si128(data_vec, key_vec);
+        // 32x32->64 multiply of the halves of each lane of data_key
+        __m128i const data_key_lo = _mm_shuffle_epi32(data_key, _MM_SHUFFLE(0, 3, 0, 1));
+        __m128i const product     = _mm_mul_epu32(data_key, data_key_lo);
+        // add the data to the neighboring lane
+        __m128i const data_swap = _mm_shuffle_epi32(data_vec, _MM_SHUFFLE(1, 0, 3, 2));
+        xacc[i] = _mm_add_epi64(product, _mm_add_epi64(xacc[i], data_swap));
+    }
+#else
+    for (int i = 0; i < XXH3_ACC_NB; i++) {
+        U64 const data_val = XXH3_read64(input + 8 * i);
+        U64 const data_key = data_val ^ XXH3_read64(secret + 8 * i);
+        acc[i ^ 1] += data_val;
+        acc[i] += (data_key & 0xFFFFFFFF) * (data_key >> 32);
+    }
+#endif
+}
+
+static void XXH3_scrambleAcc(U64* acc, const BYTE* secret)
+{
+    for (int i = 0; i < XXH3_ACC_NB; i++) {
+        U64 a = XXH3_xorshift64(acc[i], 47);
+        a ^= XXH3_read64(secret + 8 * i);
+        acc[i] = a * PRIME32_1;
+    }
+}
+
+static U64 XXH3_mergeAccs(const U64* acc, const BYTE* secret, U64 start)
+{
+    U64 result = start;
+    for (int i = 0; i < 4; i++)
+        result += XXH3_mul128_fold64(acc[2 * i]     ^ XXH3_read64(secret + 16 * i),
+                                     acc[2 * i + 1] ^ XXH3_read64(secret + 16 * i + 8));
+    return XXH3_avalanche(result);
+}
+
+static void XXH3_hashLong(U64* acc, const BYTE* input, size_t len, const BYTE* secret)
+{
+    size_t const nbStripesPerBlock = (XXH3_SECRET_SIZE - XXH3_STRIPE_LEN) / XXH3_SECRET_CONSUME;
+    size_t const block_len = XXH3_STRIPE_LEN * nbStripesPerBlock;
+    size_t const nb_blocks = (len - 1) / block_len;
+
+    acc[0] = PRIME32_3;  acc[1] = PRIME64_1;  acc[2] = PRIME64_2;  acc[3] = PRIME64_3;
+    acc[4] = PRIME64_4;  acc[5] = PRIME32_2;  acc[6] = PRIME64_5;  acc[7] = PRIME32_1;
+
+    for (size_t n = 0; n < nb_blocks; n++) {
+        for (size_t s = 0; s < nbStripesPerBlock; s++)
+            XXH3_accumulate_512(acc, input + n * block_len + s * XXH3_STRIPE_LEN,
+                                secret + s * XXH3_SECRET_CONSUME);
+        XXH3_scrambleAcc(acc, secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN);
+    }
+
+    // last partial block
+    size_t const nbStripes = ((len - 1) - block_len * nb_blocks) / XXH3_STRIPE_LEN;
+    for (size_t s = 0; s < nbStripes; s++)
+        XXH3_accumulate_512(acc, input + nb_blocks * block_len + s * XXH3_STRIPE_LEN,
+                            secret + s * XXH3_SECRET_CONSUME);
+
+    // last stripe
+    XXH3_accumulate_512(acc, input + len - XXH3_STRIPE_LEN,
+                        secret + XXH3_SECRET_SIZE - XXH3_STRIPE_LEN - 7);
+}
+
+// The secret used for a nonzero seed
+static void XXH3_initCustomSecret(BYTE* customSecret, U64 seed)
+{
+    for (int i = 0; i < XXH3_SECRET_SIZE / 16; i++) {
+        XXH3_write64(customSecret + 16 * i,     XXH3_read64(XXH3_kSecret + 16 * i)     + seed);
+        XXH3_write64(customSecret + 16 * i + 8, XXH3_read64(XXH3_kSecret + 16 * i + 8) - seed);
+    }
+}
+
+
+unsigned long long XXH3_64bits (const void* data, size_t len, unsigned long long seed)
+{
+    const BYTE* input  = (const BYTE*)data;
+    const BYTE* secret = XXH3_kSecret;
+
+    if (len <= 16) {
+        if (len > 8) {
+            U64 const bitflip1 = (XXH3_read64(secret + 24) ^ XXH3_read64(secret + 32)) + seed;
+            U64 const bitflip2 = (XXH3_read64(secret + 40) ^ XXH3_read64(secret + 48)) - seed;
+            U64 const input_lo = XXH3_read64(input) ^ bitflip1;
+            U64 const input_hi = XXH3_read64(input + len - 8) ^ bitflip2;
+            U64 const acc = len + XXH_swap64(input_lo) + input_hi
+                          + XXH3_mul128_fold64(input_lo, input_hi);
+            return XXH3_avalanche(acc);
+        }
+        if (len >= 4) {
+            seed ^= (U64)XXH_swap32((U32)seed) << 32;
+            U32 const input1 = XXH3_read32(input);
+            U32 const input2 = XXH3_read32(input + len - 4);
+            U64 const bitflip = (XXH3_read64(secret + 8) ^ XXH3_read64(secret + 16)) - seed;
+            U64 const input64 = input2 + (((U64)input1) << 32);
+            return XXH3_rrmxmx(input64 ^ bitflip, len);
+        }
+        if (len) {
+            U32 const combined = ((U32)input[0] << 16) | ((U32)input[len >> 1] << 24)
+                               | ((U32)input[len - 1] << 0) | ((U32)len << 8);
+            U64 const bitflip = (XXH3_read32(secret) ^ XXH3_read32(secret + 4)) + seed;
+            return XXH3_avalanche64((U64)combined ^ bitflip);
+        }
+        return XXH3_avalanche64(seed ^ (XXH3_read64(secret + 56) ^ XXH3_read64(secret + 64)));
+    }
+
+    if (len <= 128) {
+        U64 acc = len * PRIME64_1;
+        if (len > 32) {
+            if (len > 64) {
+                if (len > 96) {
+                    acc += XXH3_mix16B(input + 48, secret + 96, seed);
+                    acc += XXH3_mix16B(input + len - 64, secret + 112, seed);
+                }
+                acc += XXH3_mix16B(input + 32, secret + 64, seed);
+                acc += XXH3_mix16B(input + len - 48, secret + 80, seed);
+            }
+            acc += XXH3_mix16B(input + 16, secret + 32, seed);
+            acc += XXH3_mix16B(input + len - 32, secret + 48, seed);
+        }
+        acc += XXH3_mix16B(input + 0, secret + 0, seed);
+        acc += XXH3_mix16B(input + len - 16, secret + 16, seed);
+        return XXH3_avalanche(acc);
+    }
+
+    if (len <= XXH3_MIDSIZE_MAX) {
+        U64 acc = len * PRIME64_1;
+        int const nbRounds = (int)len / 16;
+        for (int i = 0; i < 8; i++)
+            acc += XXH3_mix16B(input + 16 * i, secret + 16 * i, seed);
+        U64 acc_end = XXH3_mix16B(input + len - 16, secret + XXH3_SECRET_SIZE_MIN - 17, seed);
+        acc = XXH3_avalanche(acc);
+        for (int i = 8; i < nbRounds; i++)
+            acc_end += XXH3_mix16B(input + 16 * i, secret + 16 * (i - 8) + 3, seed);
+        return XXH3_avalanche(acc + acc_end);
+    }
+
+    alignas(16) BYTE customSecret[XXH3_SECRET_SIZE];
+    if (seed) {
+        XXH3_initCustomSecret(customSecret, seed);
+        secret = customSecret;
+    }
+    alignas(16) U64 acc[XXH3_ACC_NB];
+    XXH3_hashLong(acc, input, len, secret);
+    return XXH3_mergeAccs(acc, secret + 11, (U64)len * PRIME64_1);
+}
+
+
+XXH128_hash_t XXH3_128bits (const void* data, size_t len, unsigned long long seed)
+{
+    const BYTE* input  = (const BYTE*)data;
+    const BYTE* secret = XXH3_kSecret;
+    XXH128_hash_t h128;
+
+    if (len <= 16) {
+        if (len > 8) {
+            U64 const bitflipl = (XXH3_read64(secret + 32) ^ XXH3_read64(secret + 40)) - seed;
+            U64 const bitfliph = (XXH3_read64(secret + 48) ^ XXH3_read64(secret + 56)) + seed;
+            U64 const input_lo = XXH3_read64(input);
+            U64 input_hi = XXH3_read64(input + len - 8);
+            XXH128_hash_t m128 = XXH3_mult64to128(input_lo ^ input_hi ^ bitflipl, PRIME64_1);
+            m128.low64 += (U64)(len - 1) << 54;
+            input_hi ^= bitfliph;
+            m128.high64 += input_hi + (input_hi & 0xFFFFFFFF) * (PRIME32_2 - 1);
+            m128.low64 ^= XXH_swap64(m128.high64);
+            h128 = XXH3_mult64to128(m128.low64, PRIME64_2);
+            h128.high64 += m128.high64 * PRIME64_2;
+            h128.low64  = XXH3_avalanche(h128.low64);
+            h128.high64 = XXH3_avalanche(h128.high64);
+            return h128;
+        }
+        if (len >= 4) {
+            seed ^= (U64)XXH_swap32((U32)seed) << 32;
+            U32 const input_lo = XXH3_read32(input);
+            U32 const input_hi = XXH3_read32(input + len - 4);
+            U64 const input_64 = input_lo + ((U64)input_hi << 32);
+            U64 const bitflip = (XXH3_read64(secret + 16) ^ XXH3_read64(secret + 24)) + seed;
+            // Shift len to the left to ensure it is even, this avoids even multiplies
+            h128 = XXH3_mult64to128(input_64 ^ bitflip, PRIME64_1 + (len << 2));
+            h128.high64 += (h128.low64 << 1);
+            h128.low64  ^= (h128.high64 >> 3);
+            h128.low64   = XXH3_xorshift64(h128.low64, 35);
+            h128.low64  *= XXH3_PRIME_MX2;
+            h128.low64   = XXH3_xorshift64(h128.low64, 28);
+            h128.high64  = XXH3_avalanche(h128.high64);
+            return h128;
+        }
+        if (len) {
+            U32 const combinedl = ((U32)input[0] << 16) | ((U32)input[len >> 1] << 24)
+                                | ((U32)input[len - 1] << 0) | ((U32)len << 8);
+            U32 const swapped   = XXH_swap32(combinedl);
+            U32 const combinedh = XXH_rotl32(swapped, 13);
+            U64 const bitflipl = (XXH3_read32(secret) ^ XXH3_read32(secret + 4)) + seed;
+            U64 const bitfliph = (XXH3_read32(secret + 8) ^ XXH3_read32(secret + 12)) - seed;
+            h128.low64  = XXH3_avalanche64((U64)combinedl ^ bitflipl);
+            h128.high64 = XXH3_avalanche64((U64)combinedh ^ bitfliph);
+            return h128;
+        }
+        h128.low64  = XXH3_avalanche64(seed ^ XXH3_read64(secret + 64) ^ XXH3_read64(secret + 72));
+        h128.high64 = XXH3_avalanche64(seed ^ XXH3_read64(secret + 80) ^ XXH3_read64(secret + 88));
+        return h128;
+    }
+
+    if (len <= XXH3_MIDSIZE_MAX) {
+        XXH128_hash_t acc;
+        acc.low64  = len * PRIME64_1;
+        acc.high64 = 0;
+        if (len <= 128) {
+            if (len > 32) {
+                if (len > 64) {
+                    if (len > 96)
+                        acc = XXH3_mix32B(acc, input + 48, input + len - 64, secret + 96, seed);
+                    acc = XXH3_mix32B(acc, input + 32, input + len - 48, secret + 64, seed);
+                }
+                acc = XXH3_mix32B(acc, input + 16, input + len - 32, secret + 32, seed);
+            }
+            acc = XXH3_mix32B(acc, input, input + len - 16, secret, seed);
+        } else {
+            for (size_t i = 32; i < 160; i += 32)
+                acc = XXH3_mix32B(acc, input + i - 32, input + i - 16, secret + i - 32, seed);
+            acc.low64  = XXH3_avalanche(acc.low64);
+            acc.high64 = XXH3_avalanche(acc.high64);
+            for (size_t i = 160; i <= len; i += 32)
+                acc = XXH3_mix32B(acc, input + i - 32, input + i - 16,
+                                  secret + 3 + i - 160, seed);
+            // last bytes
+            acc = XXH3_mix32B(acc, input + len - 16, input + len - 32,
+                              secret + XXH3_SECRET_SIZE_MIN - 17 - 16, (U64)0 - seed);
+        }
+        h128.low64  = acc.low64 + acc.high64;
+        h128.high64 = (acc.low64 * PRIME64_1) + (acc.high64 * PRIME64_4)
+                    + ((len - seed) * PRIME64_2);
+        h128.low64  = XXH3_avalanche(h128.low64);
+        h128.high64 = (U64)0 - XXH3_avalanche(h128.high64);
+        return h128;
+    }
+
+    alignas(16) BYTE customSecret[XXH3_SECRET_SIZE];
+    if (seed) {
+        XXH3_initCustomSecret(customSecret, seed);
+        secret = customSecret;
+    }
+    alignas(16) U64 acc[XXH3_ACC_NB];
+    XXH3_hashLong(acc, input, len, secret);
+    h128.low64  = XXH3_mergeAccs(acc, secret + 11, (U64)len * PRIME64_1);
+    h128.high64 = XXH3_mergeAccs(acc, secret + XXH3_SECRET_SIZE - sizeof(acc) - 11,
+                                 ~((U64)len * PRIME64_2));
+    return h128;
+}
+
+
 } // namespace xxhash
 OIIO_NAMESPACE_END
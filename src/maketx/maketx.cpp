@@ -36,6 +36,9 @@ static std::string outputfilename;
 static bool verbose  = false;
 static bool runstats = false;
 static int nthreads  = 0;  // default: use #cores threads if available
+static bool batch    = false;
+static std::string manifest;
+static int njobs = 0;  // default: pick from the thread count
 
 // Conversion modes.  If none are true, we just make an ordinary texture.
 static bool mipmapmode     = false;
@@ -151,6 +154,7 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
     int tile[3] = { 64, 64, 1 };  // FIXME if we ever support volume MIPmaps
     std::string compression = "zip";
     bool updatemode         = false;
+    bool incremental        = false;
     bool checknan           = false;
     std::string fixnan;  // none, black, box3
     bool set_full_to_pixels        = false;
@@ -165,6 +169,7 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
     Imath::M44f Mcam(0.0f), Mscr(0.0f), MNDC(0.0f);  // Initialize to 0
     bool separate              = false;
     bool nomipmap              = false;
+    bool stream                = false;
     bool prman_metadata        = false;
     bool constant_color_detect = false;
     bool monochrome_detect     = false;
@@ -181,6 +186,8 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
     bool cdf                   = false;
     float cdfsigma             = 1.0f / 6;
     int cdfbits                = 8;
+    bool envlobes              = false;
+    int envlobes_res           = 256;
     std::string incolorspace;
     std::string outcolorspace;
     std::string colorconfigname;
@@ -205,8 +212,16 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
       .help("Output filename");
     ap.arg("--threads %d:NUMTHREADS", &nthreads)
       .help("Number of threads (default: #cores)");
+    ap.arg("--batch", &batch)
+      .help("Convert each input file to its own texture, several at once");
+    ap.arg("--manifest %s:FILENAME", &manifest)
+      .help("Batch convert the files listed in a manifest (one 'input [output] [name=value ...]' per line)");
+    ap.arg("--jobs %d:N", &njobs)
+      .help("Number of files to convert at once in batch mode (default: automatic)");
     ap.arg("-u", &updatemode)
       .help("Update mode");
+    ap.arg("--incremental", &incremental)
+      .help("Skip if the output was made from identical input and settings");
     ap.arg("--format %s:FILEFORMAT", &fileformatname)
       .help("Specify output file format (default: guess from extension)");
     ap.arg("--nchannels %d:N", &nchannels)
@@ -241,6 +256,8 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
       .help("Sharpen MIP levels (default = 0.0 = no)");
     ap.arg("--nomipmap", &nomipmap)
       .help("Do not make multiple MIP-map levels");
+    ap.arg("--stream", &stream)
+      .help("Build the MIP-map a few tile rows at a time, to save memory");
     ap.arg("--checknan", &checknan)
       .help("Check for NaN/Inf values (abort if found)");
     ap.arg("--fixnan %s:STRATEGY", &fixnan)
@@ -304,6 +321,10 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
       .help("Create lat/long environment map");
     ap.arg("--lightprobe", &lightprobemode)
       .help("Create lat/long environment map from a light probe");
+    ap.arg("--envlobes", &envlobes)
+      .help("For an environment map, also write its prefiltered specular and diffuse reflection lobes to a companion file");
+    ap.arg("--envlobes_res %d:RES", &envlobes_res)
+      .help("Width of the sharpest prefiltered lobe (default: 256)");
     ap.arg("--bumpslopes", &bumpslopesmode)
       .help("Create a 6 channels bump-map with height, derivatives and square derivatives from an height or a normal map");
     ap.arg("--uvslopes_scale %f:VALUE", &uvslopes_scale)
@@ -330,7 +351,7 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
 
     // clang-format on
     ap.parse(argc, (const char**)argv);
-    if (filenames.empty()) {
+    if (filenames.empty() && manifest.empty()) {
         ap.briefusage();
         std::cout << "\nFor detailed help: maketx --help\n";
         exit(EXIT_SUCCESS);
@@ -357,8 +378,16 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
         exit(EXIT_FAILURE);
     }
 
-    if (filenames.size() != 1) {
-        std::cerr << "maketx ERROR: requires exactly one input filename\n";
+    if (manifest.size())
+        batch = true;
+    if (!batch && filenames.size() != 1) {
+        std::cerr << "maketx ERROR: requires exactly one input filename "
+                     "(or --batch)\n";
+        exit(EXIT_FAILURE);
+    }
+    if (batch && outputfilename.size()
+        && (filenames.size() != 1 || manifest.size())) {
+        std::cerr << "maketx ERROR: -o may only be used with a single input\n";
         exit(EXIT_FAILURE);
     }
 
@@ -409,7 +438,9 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
     configspec.attribute("maketx:runstats", runstats);
     configspec.attribute("maketx:resize", doresize);
     configspec.attribute("maketx:nomipmap", nomipmap);
+    configspec.attribute("maketx:stream", stream);
     configspec.attribute("maketx:updatemode", updatemode);
+    configspec.attribute("maketx:incremental", incremental);
     configspec.attribute("maketx:constant_color_detect", constant_color_detect);
     configspec.attribute("maketx:monochrome_detect", monochrome_detect);
     configspec.attribute("maketx:opaque_detect", opaque_detect);
@@ -440,6 +471,10 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
     configspec.attribute("maketx:cdf", cdf);
     configspec.attribute("maketx:cdfsigma", cdfsigma);
     configspec.attribute("maketx:cdfbits", cdfbits);
+    if (envlobes) {
+        configspec.attribute("maketx:envlobes", 1);
+        configspec.attribute("maketx:envlobes_res", envlobes_res);
+    }
 
     std::string cmdline
         = Strutil::sprintf("OpenImageIO %s : %s", OIIO_VERSION_STRING,
@@ -490,6 +525,60 @@ getargs(int argc, char* argv[], ImageSpec& configspec)
 
 
 
+// Add the conversions listed in a batch manifest to `jobs`. Each line
+// gives an input file, optionally its output file, then any number of
+// name=value config attributes that apply to that file on top of the
+// command line options (for example `maketx:filtername=lanczos3` or
+// `compression=dwaa`). Blank lines and lines starting with '#' are skipped.
+static bool
+read_manifest(const std::string& manifest, ImageBufAlgo::MakeTextureMode mode,
+              const ImageSpec& configspec,
+              std::vector<ImageBufAlgo::MakeTextureJob>& jobs)
+{
+    std::string contents;
+    if (!Filesystem::read_text_file(manifest, contents)) {
+        std::cerr << "maketx ERROR: Could not read manifest \"" << manifest
+                  << "\"\n";
+        return false;
+    }
+    int lineno = 0;
+    for (string_view line : Strutil::splitsv(contents, "\n")) {
+        ++lineno;
+        line = Strutil::strip(line);
+        if (line.empty() || line.front() == '#')
+            continue;
+        ImageBufAlgo::MakeTextureJob job;
+        job.mode   = mode;
+        job.config = configspec;
+        string_view word;
+        while (Strutil::parse_string(line, word)) {
+            size_t eq = word.find('=');
+            if (job.filename.size() && eq != string_view::npos) {
+                string_view name = word.substr(0, eq);
+                string_view val  = word.substr(eq + 1);
+                if (Strutil::string_is_int(val))
+                    job.config.attribute(name, Strutil::stoi(val));
+                else if (Strutil::string_is_float(val))
+                    job.config.attribute(name, Strutil::stof(val));
+                else
+                    job.config.attribute(name, val);
+            } else if (job.filename.empty()) {
+                job.filename = word;
+            } else if (job.outputfilename.empty()) {
+                job.outputfilename = word;
+            } else {
+                std::cerr << "maketx ERROR: " << manifest << ":" << lineno
+                          << ": unexpected \"" << word << "\"\n";
+                return false;
+            }
+        }
+        jobs.push_back(std::move(job));
+    }
+    return true;
+}
+
+
+
 int
 main(int argc, char* argv[])
 {
@@ -524,10 +613,35 @@ main(int argc, char* argv[])
     if (bumpslopesmode)
         mode = ImageBufAlgo::MakeTxBumpWithSlopes;
 
-    bool ok = ImageBufAlgo::make_texture(mode, filenames[0], outputfilename,
-                                         configspec);
-    if (!ok)
-        std::cout << "make_texture ERROR: " << OIIO::geterror() << "\n";
+    bool ok = true;
+    if (batch) {
+        // All the conversions go to make_texture together, so that it can
+        // run several at once and keep the cores busy.
+        std::vector<ImageBufAlgo::MakeTextureJob> jobs;
+        for (auto& f : filenames) {
+            ImageBufAlgo::MakeTextureJob job;
+            job.mode           = mode;
+            job.filename       = f;
+            job.outputfilename = outputfilename;
+            job.config         = configspec;
+            jobs.push_back(std::move(job));
+        }
+        if (manifest.size() && !read_manifest(manifest, mode, configspec, jobs))
+            return EXIT_FAILURE;
+        ok = ImageBufAlgo::make_texture(jobs, &std::cout, njobs);
+        if (!ok) {
+            int nfailed = 0;
+            for (auto& job : jobs)
+                nfailed += !job.ok;
+            std::cout << "maketx: " << nfailed << " of " << jobs.size()
+                      << " conversions failed\n";
+        }
+    } else {
+        ok = ImageBufAlgo::make_texture(mode, filenames[0], outputfilename,
+                                        configspec);
+        if (!ok)
+            std::cout << "make_texture ERROR: " << OIIO::geterror() << "\n";
+    }
     if (runstats)
         std::cout << "\n" << ic->getstats();
 
@@ -6,6 +6,7 @@
 #include "DDImage/Reader.h"
 #include "DDImage/Row.h"
 
+#include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
 
 
@@ -13,13 +14,16 @@ using namespace DD::Image;
 
 
 /*
+ * Pixels are read through the process-wide shared OIIO ImageCache, one row
+ * at a time as Nuke asks for them, so only the tiles under the requested
+ * rows of the chosen mip level are ever read, and all the txReaders of a
+ * session share the cache's memory limit (which may be set with the
+ * OPENIMAGEIO_IMAGECACHE_OPTIONS environment variable, for example
+ * "max_memory_MB=4096").
+ *
  * TODO:
  * - Look into using the planar Reader API in Nuke 8, which may map better to
  *      TIFF/OIIO.
- * - It would be nice to have a way to read in a region, rather than the whole
- *      image, but this would require access to the Read's request region,
- *      which isn't currently possible. A feature request for this is logged
- *      with The Foundry as Bug 46237.
  */
 
 
@@ -93,12 +97,14 @@ public:
 
 
 class txReader final : public Reader {
-    std::unique_ptr<ImageInput> oiioInput_;
+    ImageCache* cache_;
+    ImageCache::ImageHandle* handle_;
+    ustring filename_;
     TxReaderFormat* txFmt_;
 
     int chanCount_, lastMipLevel_;
-    bool haveImage_, flip_;
-    std::vector<float> imageBuf_;
+    int mipX_, mipY_, mipW_, mipH_;  // Data window of the mip level read
+    bool flip_;
     std::map<Channel, int> chanMap_;
 
     MetaData::Bundle meta_;
@@ -201,23 +207,33 @@ class txReader final : public Reader {
 public:
     txReader(Read* iop)
         : Reader(iop)
-        , oiioInput_(ImageInput::open(filename()))
+        , cache_(ImageCache::create(true))
+        , handle_(NULL)
+        , filename_(filename())
         , chanCount_(0)
         , lastMipLevel_(-1)
-        , haveImage_(false)
+        , mipX_(0)
+        , mipY_(0)
+        , mipW_(0)
+        , mipH_(0)
         , flip_(false)
     {
         txFmt_ = dynamic_cast<TxReaderFormat*>(iop->handler());
 
         OIIO::attribute("threads", (int)Thread::numThreads / 2);
 
-        if (!oiioInput_) {
+        // Nuke makes a new Reader when a file is reloaded, which is our cue
+        // to forget anything cached for it if it changed on disk.
+        cache_->invalidate(filename_, false);
+        handle_ = cache_->get_image_handle(filename_);
+        const ImageSpec* baseSpecPtr
+            = handle_ ? cache_->imagespec(handle_, NULL, 0, 0) : NULL;
+        if (!baseSpecPtr) {
             iop->internalError("OIIO: Failed to open file %s: %s", filename(),
-                               geterror().c_str());
+                               cache_->geterror().c_str());
             return;
         }
-
-        const ImageSpec& baseSpec = oiioInput_->spec();
+        const ImageSpec& baseSpec = *baseSpecPtr;
 
         if (!(baseSpec.width * baseSpec.height)) {
             iop->internalError("tx file has one or more zero dimensions "
@@ -226,8 +242,11 @@ public:
             return;
         }
 
-        chanCount_       = baseSpec.nchannels;
-        const bool isEXR = strcmp(oiioInput_->format_name(), "openexr") == 0;
+        chanCount_             = baseSpec.nchannels;
+        const char* fileFormat = "";
+        cache_->get_image_info(handle_, NULL, 0, 0, ustring("fileformat"),
+                               TypeString, &fileFormat);
+        const bool isEXR = strcmp(fileFormat, "openexr") == 0;
 
         if (isEXR) {
             float pixAspect = baseSpec.get_float_attribute("PixelAspectRatio",
@@ -252,70 +271,62 @@ public:
 
         // Populate mip level pulldown with labels in the form:
         //      "MIPLEVEL - WxH" (e.g. "0 - 1920x1080")
+        int mipLevels = 1;
+        cache_->get_image_info(handle_, NULL, 0, 0, ustring("miplevels"),
+                               TypeInt, &mipLevels);
         std::vector<std::string> mipLabels;
-        std::ostringstream buf;
-        ImageSpec mipSpec(baseSpec);
-        int mipLevel = 0;
-        while (true) {
-            buf << mipLevel << " - " << mipSpec.width << 'x' << mipSpec.height;
-            mipLabels.push_back(buf.str());
-            if (oiioInput_->seek_subimage(0, mipLevel + 1, mipSpec)) {
-                buf.str(std::string());
-                buf.clear();
-                mipLevel++;
-            } else
+        for (int mipLevel = 0; mipLevel < mipLevels; ++mipLevel) {
+            const ImageSpec* mipSpec = cache_->imagespec(handle_, NULL, 0,
+                                                         mipLevel);
+            if (!mipSpec)
                 break;
+            std::ostringstream buf;
+            buf << mipLevel << " - " << mipSpec->width << 'x'
+                << mipSpec->height;
+            mipLabels.push_back(buf.str());
         }
 
-        meta_.setData("tx/mip_levels", mipLevel + 1);
+        meta_.setData("tx/mip_levels", int(mipLabels.size()));
 
         txFmt_->setMipLabels(mipLabels);
     }
 
-    virtual ~txReader()
-    {
-        if (oiioInput_)
-            oiioInput_->close();
-    }
+    virtual ~txReader() { ImageCache::destroy(cache_); }
 
     void open()
     {
         if (lastMipLevel_ != txFmt_->mipLevel()) {
-            ImageSpec mipSpec;
-            if (!oiioInput_->seek_subimage(0, txFmt_->mipLevel(), mipSpec)) {
+            const ImageSpec* mipSpec
+                = handle_ ? cache_->imagespec(handle_, NULL, 0,
+                                              txFmt_->mipLevel())
+                          : NULL;
+            if (!mipSpec) {
                 iop->internalError("Failed to seek to mip level %d: %s",
                                    txFmt_->mipLevel(),
-                                   oiioInput_->geterror().c_str());
+                                   cache_->geterror().c_str());
                 return;
             }
 
-            if (txFmt_->mipLevel() && mipSpec.nchannels != chanCount_) {
+            if (txFmt_->mipLevel() && mipSpec->nchannels != chanCount_) {
                 iop->internalError("txReader does not support mip levels with "
                                    "different channel counts");
                 return;
             }
 
+            mipX_         = mipSpec->x;
+            mipY_         = mipSpec->y;
+            mipW_         = mipSpec->width;
+            mipH_         = mipSpec->height;
             lastMipLevel_ = txFmt_->mipLevel();
-            haveImage_    = false;
-        }
-
-        if (!haveImage_) {
-            const int needSize = oiioInput_->spec().width
-                                 * oiioInput_->spec().height
-                                 * oiioInput_->spec().nchannels;
-            if (size_t(needSize) > imageBuf_.size())
-                imageBuf_.resize(needSize);
-            oiioInput_->read_image(&imageBuf_[0]);
-            haveImage_ = true;
         }
     }
 
     void engine(int y, int x, int r, ChannelMask channels, Row& row)
     {
-        if (!haveImage_)
-            iop->internalError("engine called, but haveImage_ is false");
+        if (lastMipLevel_ < 0)
+            iop->internalError("engine called, but no mip level is open");
 
-        if (aborted()) {
+        if (aborted() || lastMipLevel_ < 0 || r <= x) {
             row.erase(channels);
             return;
         }
@@ -325,38 +336,44 @@ public:
         if (flip_)
             y = height() - y - 1;
 
-        if (lastMipLevel_) {  // Mip level other than 0
-            const int mipW    = oiioInput_->spec().width;
-            const int mipMult = width() / mipW;
-
-            y              = y * oiioInput_->spec().height / height();
-            const int bufX = x ? x / mipMult : 0;
-            const int bufR = r / mipMult;
-            const int bufW = bufR - bufX;
+        // The span of the mip level's row that covers [x, r) of the
+        // full-resolution row. A lower mip level is resampled to fill the
+        // same resolution by repeating its pixels.
+        const int mipMult = lastMipLevel_ ? std::max(width() / mipW_, 1) : 1;
+        const int bufY    = lastMipLevel_ ? y * mipH_ / height() : y;
+        const int bufX    = std::min(x / mipMult, mipW_ - 1);
+        const int bufR    = std::max(std::min((r + mipMult - 1) / mipMult,
+                                              mipW_),
+                                     bufX + 1);
+        const int bufW    = bufR - bufX;
+
+        // Only the tiles under this row are read, and only if the cache
+        // doesn't have them already.
+        std::vector<float> pixels(size_t(bufW) * chanCount_);
+        if (!cache_->get_pixels(handle_, cache_->get_perthread_info(), 0,
+                                lastMipLevel_, mipX_ + bufX, mipX_ + bufR,
+                                mipY_ + bufY, mipY_ + bufY + 1, 0, 1, 0,
+                                chanCount_, TypeFloat, &pixels[0])) {
+            iop->internalError("OIIO: Failed to read %s: %s", filename(),
+                               cache_->geterror().c_str());
+            row.erase(channels);
+            return;
+        }
 
-            std::vector<float> chanBuf(bufW);
-            float* chanStart   = &chanBuf[0];
-            const int bufStart = y * mipW * chanCount_ + bufX * chanCount_;
-            const float* alpha
-                = doAlpha ? &imageBuf_[bufStart + chanMap_[Chan_Alpha]] : NULL;
+        const float* alpha = doAlpha ? &pixels[chanMap_[Chan_Alpha]] : NULL;
+        if (mipMult == 1) {
             foreach (z, channels) {
-                from_float(z, &chanBuf[0], &imageBuf_[bufStart + chanMap_[z]],
-                           alpha, bufW, chanCount_);
-
-                float* OUT = row.writable(z);
-                for (int stride = 0, c = 0; stride < bufW; stride++, c = 0)
-                    for (; c < mipMult; c++)
-                        *OUT++ = *(chanStart + stride);
+                from_float(z, row.writable(z) + x, &pixels[chanMap_[z]],
+                           alpha, r - x, chanCount_);
             }
-        } else {  // Mip level 0
-            const int pixStart = y * width() * chanCount_ + x * chanCount_;
-            const float* alpha
-                = doAlpha ? &imageBuf_[pixStart + chanMap_[Chan_Alpha]] : NULL;
-
+        } else {
+            std::vector<float> chanBuf(bufW);
             foreach (z, channels) {
-                from_float(z, row.writable(z) + x,
-                           &imageBuf_[pixStart + chanMap_[z]], alpha, r - x,
+                from_float(z, &chanBuf[0], &pixels[chanMap_[z]], alpha, bufW,
                            chanCount_);
+                float* OUT = row.writable(z);
+                for (int i = x; i < r; ++i)
+                    OUT[i] = chanBuf[std::min(i / mipMult - bufX, bufW - 1)];
             }
         }
     }
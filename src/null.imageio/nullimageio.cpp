@@ -3,13 +3,17 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <chrono>
 #include <cstdio>
 #include <cstdlib>
+#include <thread>
 
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/hash.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/strutil.h>
+#include <OpenImageIO/thread.h>
 
 #include "imageio_pvt.h"
 
@@ -55,6 +59,10 @@ public:
 // Null input emulates a file, but just returns black tiles.
 // But we accept REST-like filename designations to set certain parameters,
 // such as "myfile.null&RES=1920x1080&CHANNELS=3&TYPE=uint16"
+// It can also fill the pixels with a deterministic pattern, and pretend
+// to be slow storage (open and read latency, bandwidth) with a costly
+// decoder, which makes for reproducible ImageCache/TextureSystem
+// benchmarks, e.g. "tex.null?TEX=1&PATTERN=noise&READDELAY=2&DECODECOST=5"
 class NullInput final : public ImageInput {
 public:
     NullInput() { init(); }
@@ -78,12 +86,19 @@ public:
                                   int z, void* data) override;
 
 private:
+    enum Pattern { Constant, Ramp, Checker, Noise };
+
     std::string m_filename;        ///< Stash the filename
     int m_subimage;                ///< What subimage are we looking at?
     int m_miplevel;                ///< What miplevel are we looking at?
     bool m_mip;                    ///< MIP-mapped?
     std::vector<uint8_t> m_value;  ///< Pixel value (if not black)
     ImageSpec m_topspec;
+    Pattern m_pattern;    ///< Pixel pattern
+    float m_open_delay;   ///< Simulated open latency (ms)
+    float m_read_delay;   ///< Simulated latency of each read (ms)
+    float m_bandwidth;    ///< Simulated bandwidth (MB/s), 0 = no limit
+    float m_decode_cost;  ///< Simulated CPU cost per pixel (ns)
 
     // Reset everything to initial state
     void init()
@@ -92,7 +107,21 @@ private:
         m_miplevel = -1;
         m_mip      = false;
         m_value.clear();
+        m_pattern     = Constant;
+        m_open_delay  = 0.0f;
+        m_read_delay  = 0.0f;
+        m_bandwidth   = 0.0f;
+        m_decode_cost = 0.0f;
     }
+
+    // Fill the pixels [xbegin,xend) x [ybegin,yend) x [zbegin,zend) of
+    // the current level, contiguous in native format.
+    void fill(int xbegin, int xend, int ybegin, int yend, int zbegin,
+              int zend, void* data);
+
+    // Pretend that reading `bytes` of data holding `pixels` pixels took as
+    // long as the simulated storage and decoder would.
+    void simulate_read(imagesize_t bytes, imagesize_t pixels);
 };
 
 
@@ -124,6 +153,8 @@ null_input_imageio_create()
 
 OIIO_EXPORT const char* null_input_extensions[] = { "null", "nul", nullptr };
 
+OIIO_EXPORT const char* null_input_signatures[] = { nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -240,10 +271,8 @@ bool
 NullInput::open(const std::string& name, ImageSpec& newspec,
                 const ImageSpec& config)
 {
+    init();
     m_filename = name;
-    m_subimage = -1;
-    m_miplevel = -1;
-    m_mip      = false;
     m_topspec  = config;
 
     // std::vector<std::pair<string_view,string_view> > args;
@@ -319,6 +348,23 @@ NullInput::open(const std::string& name, ImageSpec& newspec,
         } else if (a.first == "PIXEL") {
             Strutil::extract_from_list_string(fvalue, a.second);
             fvalue.resize(m_topspec.nchannels);
+        } else if (a.first == "PATTERN") {
+            if (Strutil::iequals(a.second, "ramp"))
+                m_pattern = Ramp;
+            else if (Strutil::iequals(a.second, "checker"))
+                m_pattern = Checker;
+            else if (Strutil::iequals(a.second, "noise"))
+                m_pattern = Noise;
+            else
+                m_pattern = Constant;
+        } else if (a.first == "OPENDELAY") {
+            m_open_delay = Strutil::from_string<float>(a.second);
+        } else if (a.first == "READDELAY") {
+            m_read_delay = Strutil::from_string<float>(a.second);
+        } else if (a.first == "BANDWIDTH") {
+            m_bandwidth = Strutil::from_string<float>(a.second);
+        } else if (a.first == "DECODECOST") {
+            m_decode_cost = Strutil::from_string<float>(a.second);
         } else if (a.first.size() && a.second.size()) {
             parse_param(a.first, a.second, m_topspec);
         }
@@ -332,6 +378,10 @@ NullInput::open(const std::string& name, ImageSpec& newspec,
                       m_value.data(), m_topspec.nchannels);
     }
 
+    if (m_open_delay > 0.0f)
+        std::this_thread::sleep_for(
+            std::chrono::duration<float, std::milli>(m_open_delay));
+
     bool ok = seek_subimage(0, 0);
     newspec = spec();
     return ok;
@@ -369,33 +419,115 @@ NullInput::seek_subimage(int subimage, int miplevel)
 
 
 
-bool
-NullInput::read_native_scanline(int /*subimage*/, int /*miplevel*/, int /*y*/,
-                                int /*z*/, void* data)
+void
+NullInput::fill(int xbegin, int xend, int ybegin, int yend, int zbegin,
+                int zend, void* data)
+{
+    const size_t npixels = size_t(xend - xbegin) * (yend - ybegin)
+                           * (zend - zbegin);
+    const size_t s = m_spec.pixel_bytes();
+    if (m_pattern == Constant) {
+        if (m_value.size()) {
+            for (size_t p = 0; p < npixels; ++p)
+                memcpy((char*)data + s * p, m_value.data(), s);
+        } else {
+            memset(data, 0, s * npixels);
+        }
+        return;
+    }
+
+    // The patterns are functions of the pixel coordinates, channel and
+    // MIP level only, so every read of a pixel gives the same value.
+    const int nc = m_spec.nchannels;
+    std::vector<float> fvalues(npixels * nc);
+    float* f = fvalues.data();
+    for (int z = zbegin; z < zend; ++z) {
+        for (int y = ybegin; y < yend; ++y) {
+            for (int x = xbegin; x < xend; ++x) {
+                for (int c = 0; c < nc; ++c, ++f) {
+                    switch (m_pattern) {
+                    case Ramp:
+                        *f = c == 0   ? (x + 0.5f) / m_spec.width
+                             : c == 1 ? (y + 0.5f) / m_spec.height
+                             : c == 2 ? (z + 0.5f) / m_spec.depth
+                                      : 1.0f;
+                        break;
+                    case Checker:
+                        *f = float(((x >> 4) ^ (y >> 4) ^ (z >> 4)) & 1);
+                        break;
+                    default:
+                        *f = bjhash::bjfinal(uint32_t(x) ^ (uint32_t(c) << 24),
+                                             uint32_t(y)
+                                                 ^ (uint32_t(m_miplevel) << 24),
+                                             uint32_t(z))
+                             * (1.0f / 4294967296.0f);
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    convert_types(TypeFloat, fvalues.data(), m_spec.format, data,
+                  npixels * nc);
+}
+
+
+
+void
+NullInput::simulate_read(imagesize_t bytes, imagesize_t pixels)
 {
-    if (m_value.size()) {
-        size_t s = m_spec.pixel_bytes();
-        for (int x = 0; x < m_spec.width; ++x)
-            memcpy((char*)data + s * x, m_value.data(), s);
-    } else {
-        memset(data, 0, m_spec.scanline_bytes());
+    using namespace std::chrono;
+    if (m_decode_cost <= 0.0f && m_read_delay <= 0.0f && m_bandwidth <= 0.0f)
+        return;
+    auto ms = [](double t) {
+        return duration_cast<steady_clock::duration>(
+            duration<double, std::milli>(t));
+    };
+    steady_clock::time_point start = steady_clock::now();
+
+    // The decode cost is real CPU work, spin until it's been spent.
+    if (m_decode_cost > 0.0f) {
+        steady_clock::time_point end = start
+                                       + ms(1.0e-6 * m_decode_cost * pixels);
+        while (steady_clock::now() < end)
+            ;
+    }
+
+    // Latency and bandwidth are waiting on the storage, so sleep. All null
+    // files share the same simulated link: transfers queue up behind each
+    // other, so that many threads can't get more than its bandwidth.
+    steady_clock::time_point done = start + ms(m_read_delay);
+    if (m_bandwidth > 0.0f) {
+        static spin_mutex link_mutex;
+        static steady_clock::time_point link_free;
+        spin_lock lock(link_mutex);
+        link_free = std::max(link_free, start)
+                    + ms(1.0e3 * bytes / (m_bandwidth * 1.0e6));
+        done = std::max(done, link_free);
     }
+    std::this_thread::sleep_until(done);
+}
+
+
+
+bool
+NullInput::read_native_scanline(int /*subimage*/, int /*miplevel*/, int y,
+                                int z, void* data)
+{
+    fill(m_spec.x, m_spec.x + m_spec.width, y, y + 1, z, z + 1, data);
+    simulate_read(m_spec.scanline_bytes(), m_spec.width);
     return true;
 }
 
 
 
 bool
-NullInput::read_native_tile(int /*subimage*/, int /*miplevel*/, int /*x*/,
-                            int /*y*/, int /*z*/, void* data)
+NullInput::read_native_tile(int /*subimage*/, int /*miplevel*/, int x, int y,
+                            int z, void* data)
 {
-    if (m_value.size()) {
-        size_t s = m_spec.pixel_bytes();
-        for (size_t x = 0, e = m_spec.tile_pixels(); x < e; ++x)
-            memcpy((char*)data + s * x, m_value.data(), s);
-    } else {
-        memset(data, 0, m_spec.tile_bytes());
-    }
+    fill(x, x + m_spec.tile_width, y, y + m_spec.tile_height, z,
+         z + std::max(1, m_spec.tile_depth), data);
+    simulate_read(m_spec.tile_bytes(), m_spec.tile_pixels());
     return true;
 }
 
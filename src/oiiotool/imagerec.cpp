@@ -3,6 +3,7 @@
 // https://github.com/OpenImageIO/oiio
 
 
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -19,6 +20,7 @@
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/thread.h>
 
 #include "oiiotool.h"
@@ -236,8 +238,28 @@ ImageRec::read_nativespec()
 
 
 bool
-ImageRec::read(ReadPolicy readpolicy, string_view channel_set)
+ImageRec::unstream()
 {
+    if (!m_stream_op)
+        return true;
+    std::shared_ptr<OiiotoolOp> op = std::move(m_stream_op);
+    ImageBuf& ib(*m_subimages[0][0]);
+    bool ok = op->stream_region(ib, get_roi(*spec(0, 0)));
+    if (ok)
+        *spec(0, 0) = ib.spec();
+    else
+        errorfmt("{}", ib.geterror());
+    m_elaborated = true;
+    return ok;
+}
+
+
+
+bool
+ImageRec::read(ReadPolicy readpolicy, string_view channel_set, ROI region)
+{
+    if (streamed())
+        return unstream();
     if (elaborated())
         return true;
     static ustring u_subimages("subimages"), u_miplevels("miplevels");
@@ -249,8 +271,8 @@ ImageRec::read(ReadPolicy readpolicy, string_view channel_set)
         return false;  // Image not found
     }
     m_subimages.resize(subimages);
-    bool allok = true;
-    for (int s = 0; s < subimages; ++s) {
+    std::atomic<bool> allok(true);
+    auto read_subimage = [&](int s) {
         int miplevels = 0;
         m_imagecache->get_image_info(uname, s, 0, u_miplevels, TypeInt,
                                      &miplevels);
@@ -324,7 +346,14 @@ ImageRec::read(ReadPolicy readpolicy, string_view channel_set)
                 forceread = true;
             }
 
-            bool ok = ib->read(s, m, chbegin, chend, forceread, convert);
+            bool ok;
+            if (s == 0 && m == 0 && region.defined()) {
+                region.chbegin = chbegin;
+                region.chend   = chend < 0 ? ib->nativespec().nchannels : chend;
+                ok             = ib->read(s, m, region, convert);
+            } else {
+                ok = ib->read(s, m, chbegin, chend, forceread, convert);
+            }
             if (ok && post_channel_set_action) {
                 ImageBufRef allchan_buf;
                 std::swap(allchan_buf, ib);
@@ -337,7 +366,8 @@ ImageRec::read(ReadPolicy readpolicy, string_view channel_set)
             if (!ok)
                 errorfmt("{}", ib->geterror());
 
-            allok &= ok;
+            if (!ok)
+                allok = false;
             // Remove any existing SHA-1 hash from the spec.
             ib->specmod().erase_attribute("oiio:SHA-1");
             std::string desc = ib->spec().get_string_attribute(
@@ -357,6 +387,18 @@ ImageRec::read(ReadPolicy readpolicy, string_view channel_set)
             m_subimages[s].m_specs[m].tile_height = nativespec.tile_height;
             m_subimages[s].m_specs[m].tile_depth  = nativespec.tile_depth;
         }
+    };
+    // When bypassing the cache, each subimage gets a full read by its own
+    // ImageBuf (and ImageInput), so the subimages of a multi-part file can
+    // all be read at once.
+    if (subimages > 1 && (readpolicy & ReadNoCache)) {
+        parallel_for_chunked(0, subimages, 1, [&](int64_t b, int64_t e) {
+            for (; b < e; ++b)
+                read_subimage(int(b));
+        });
+    } else {
+        for (int s = 0; s < subimages; ++s)
+            read_subimage(s);
     }
 
     m_time       = Filesystem::last_write_time(name());
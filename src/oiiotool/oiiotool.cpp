@@ -4,19 +4,33 @@
 
 
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
 #include <cmath>
+#include <csignal>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <ctime>
 #include <iostream>
 #include <iterator>
 #include <map>
+#include <new>
 #include <regex>
+#include <set>
 #include <sstream>
 #include <string>
+#include <thread>
 #include <utility>
 #include <vector>
 
+#ifndef _WIN32
+#    include <sys/socket.h>
+#    include <sys/un.h>
+#    include <unistd.h>
+#endif
+
 #include <OpenEXR/ImfTimeCode.h>
 #include <OpenImageIO/Imath.h>
 
@@ -29,6 +43,7 @@
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imagecache.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/simd.h>
 #include <OpenImageIO/strutil.h>
 #include <OpenImageIO/sysutil.h>
@@ -49,13 +64,15 @@ static Oiiotool ot;
 // a lambda for each subimage. Beware, the macro expansion rules may require
 // you may need to enclose the lambda itself in parenthesis () if there it
 // contains commas that are not inside other parentheses.
-#define OIIOTOOL_OP(name, ninputs, ...)                                 \
-    static int action_##name(int argc, const char* argv[])              \
-    {                                                                   \
-        if (ot.postpone_callback(ninputs, action_##name, argc, argv))   \
-            return 0;                                                   \
-        OiiotoolOp op(ot, "-" #name, argc, argv, ninputs, __VA_ARGS__); \
-        return op();                                                    \
+#define OIIOTOOL_OP(name, ninputs, ...)                                   \
+    static int action_##name(int argc, const char* argv[])                \
+    {                                                                     \
+        if (ot.postpone_callback(ninputs, action_##name, argc, argv))     \
+            return 0;                                                     \
+        auto op = std::make_shared<OiiotoolOp>(ot, "-" #name, argc, argv, \
+                                               ninputs, __VA_ARGS__);     \
+        op->inplace(pixelwise_op(op->opname()));                          \
+        return stream_op(op) ? 0 : (*op)();                               \
     }
 
 // Canned setup for an op that uses one image on the stack.
@@ -103,6 +120,73 @@ static Oiiotool ot;
 
 
 
+
+// Is the op pixel-wise: does each output pixel depend only on the same
+// pixel of its inputs? Such ops can be streamed, or run in place.
+static bool
+pixelwise_op(string_view opname)
+{
+    static const std::set<string_view> pixelwise {
+        "-abs",  "-absdiff",  "-absdiffc", "-add",  "-addc",      "-div",
+        "-divc", "-invert",   "-mad",      "-max",  "-maxc",      "-min",
+        "-minc", "-mul",      "-mulc",     "-powc", "-premult",   "-repremult",
+        "-sub",  "-saturate", "-subc"
+    };
+    return pixelwise.count(opname) > 0;
+}
+
+
+
+// With --stream, rather than computing an op right away, if it's pixel-wise
+// (each output pixel depends only on the same pixel of its inputs), push a
+// streamed ImageRec that computes it later, a region at a time, and return
+// true. Streamed ops pile up into a pipeline that, when written with -o,
+// computes only a strip of the output at a time, reading just those parts
+// of any cached input files, so no whole-image buffers are ever made.
+// Anything else that needs the pixels computes the whole image. Ops with
+// modifiers, or whose inputs have multiple subimages or MIP levels, deep
+// data, or different data windows, are always run right away.
+static bool
+stream_op(std::shared_ptr<OiiotoolOp> op)
+{
+    if (!ot.stream || ot.metamerge || !pixelwise_op(op->opname())
+        || op->args(0).find(':') != string_view::npos || op->nimages() < 2)
+        return false;
+    ROI roi;
+    for (int i = 1; i < op->nimages(); ++i) {
+        ImageRecRef& ir(op->ir(i));
+        if (!ir->streamed() && !ot.read(ir))
+            return false;  // let the op itself report the error
+        if (ir->subimages() != 1 || ir->miplevels(0) != 1 || ir->spec()->deep)
+            return false;
+        ROI irroi     = get_roi(*ir->spec());
+        irroi.chbegin = 0;
+        irroi.chend   = 10000;
+        if (i > 1 && irroi != roi)
+            return false;
+        roi = irroi;
+    }
+
+    // Compute a single pixel to find out the output spec.
+    ImageBuf probe;
+    ROI pixel(roi.xbegin, roi.xbegin + 1, roi.ybegin, roi.ybegin + 1,
+              roi.zbegin, roi.zbegin + 1);
+    if (!op->stream_region(probe, pixel))
+        return false;
+    ImageSpec spec = probe.spec();
+    spec.set_roi(roi);
+
+    auto result = std::make_shared<ImageRec>(op->opname(), 1);
+    result->stream_op(op, spec);
+    op->ir(0) = result;
+    ot.push(result);
+    if (ot.debug)
+        Strutil::print("Streaming '{}'\n", op->opname());
+    return true;
+}
+
+
+
 Oiiotool::Oiiotool() { clear_options(); }
 
 
@@ -291,8 +375,18 @@ remove_modifier(string_view str, string_view name)
 
 
 bool
-Oiiotool::read(ImageRecRef img, ReadPolicy readpolicy, string_view channel_set)
+Oiiotool::read(ImageRecRef img, ReadPolicy readpolicy, string_view channel_set,
+               ROI region)
 {
+    // A streamed image is computed, not read from disk, so it mustn't
+    // affect the format and tile adjustments below either.
+    if (img->streamed()) {
+        bool ok = img->unstream();
+        if (!ok)
+            error("read", img->geterror());
+        return ok;
+    }
+
     // If the image is already elaborated, take an early out, both to
     // save time, but also because we only want to do the format and
     // tile adjustments below as images are read in fresh from disk.
@@ -306,12 +400,58 @@ Oiiotool::read(ImageRecRef img, ReadPolicy readpolicy, string_view channel_set)
     total_readtime.start();
     if (ot.nativeread)
         readpolicy = ReadPolicy(readpolicy | ReadNative);
-    bool ok = img->read(readpolicy, channel_set);
+    bool ok = img->read(readpolicy, channel_set, region);
     total_readtime.stop();
     imagecache->getattribute("stat:fileio_time", post_ic_time);
     total_imagecache_readtime += post_ic_time - pre_ic_time;
     total_readtime.add_seconds(pre_ic_time - post_ic_time);
+    return finish_read(img, ok);
+}
+
 
+
+bool
+Oiiotool::read_images(span<ImageRecRef> imgs, ReadPolicy readpolicy)
+{
+    // Streamed images are computed rather than read, possibly sharing
+    // ops with each other, so do them (and the trivial cases) in order.
+    std::vector<ImageRecRef> files;
+    bool ok = true;
+    for (auto& img : imgs) {
+        if (img->streamed() || img->elaborated())
+            ok &= read(img, readpolicy);
+        else if (std::find(files.begin(), files.end(), img) == files.end())
+            files.push_back(img);
+    }
+    if (files.size() < 2) {
+        for (auto& img : files)
+            ok &= read(img, readpolicy);
+        return ok;
+    }
+
+    float pre_ic_time, post_ic_time;
+    imagecache->getattribute("stat:fileio_time", pre_ic_time);
+    total_readtime.start();
+    if (ot.nativeread)
+        readpolicy = ReadPolicy(readpolicy | ReadNative);
+    std::unique_ptr<bool[]> readok(new bool[files.size()]);
+    parallel_for(int64_t(0), int64_t(files.size()), [&](int64_t i) {
+        readok[i] = files[i]->read(readpolicy);
+    });
+    total_readtime.stop();
+    imagecache->getattribute("stat:fileio_time", post_ic_time);
+    total_imagecache_readtime += post_ic_time - pre_ic_time;
+    total_readtime.add_seconds(pre_ic_time - post_ic_time);
+    for (size_t i = 0; i < files.size(); ++i)
+        ok &= finish_read(files[i], readok[i]);
+    return ok;
+}
+
+
+
+bool
+Oiiotool::finish_read(ImageRecRef img, bool ok)
+{
     // If this is the first tiled image we have come across, use it to
     // set our tile size (unless the user explicitly set a tile size, or
     // explicitly instructed scanline output).
@@ -357,6 +497,126 @@ Oiiotool::read_nativespec(ImageRecRef img)
 
 
 
+ROI
+Oiiotool::crop_read_region(string_view command, string_view size,
+                           bool allsubimages)
+{
+    // Nobody else may look at the rest of the image: only the stack top
+    // holds it, and it's not labeled or on the stack below.
+    if (allsubimages || !curimg || curimg->elaborated() || curimg->streamed()
+        || curimg.use_count() > 1 || !read_nativespec(curimg))
+        return {};
+    const ImageSpec& nspec(*curimg->nativespec(0, 0));
+    if (nspec.deep)
+        return {};
+    ImageSpec spec = nspec;
+    adjust_geometry(command, spec.width, spec.height, spec.x, spec.y, size);
+    ROI region = roi_intersection(get_roi(spec), get_roi(nspec));
+    if (region.width() <= 0 || region.height() <= 0 || region == get_roi(nspec))
+        return {};
+    return region;
+}
+
+
+
+void
+Oiiotool::reset()
+{
+    clear_options();
+    curimg.reset();
+    image_stack.clear();
+    image_labels.clear();
+    uservars.clear();
+    while (control_stack.size())
+        control_stack.pop();
+    m_pending_action = nullptr;
+    // getargs() declares all the options again, so start a fresh parser
+    // rather than let them pile up.
+    ap.~ArgParse();
+    new (&ap) ArgParse();
+    function_times.clear();
+    total_runtime.reset();
+    total_runtime.start();
+    total_readtime.reset();
+    total_writetime.reset();
+    total_imagecache_readtime = 0.0;
+    peak_memory               = 0;
+    return_value              = EXIT_SUCCESS;
+    num_outputs               = 0;
+    bytes_written             = 0;
+    printed_info              = false;
+    command_args.clear();
+    info_prefetch.clear();
+    profile_filename.clear();
+    profile_events.clear();
+    // Files may have changed on disk since the last command line
+    imagecache->invalidate_all(false);
+}
+
+
+
+Oiiotool::ProfileCounters
+Oiiotool::profile_counters() const
+{
+    ProfileCounters c;
+    c.time      = total_runtime();
+    c.cpu       = double(std::clock()) / CLOCKS_PER_SEC;
+    c.bytes_out = bytes_written;
+    imagecache->getattribute("stat:fileio_time", c.fileio_time);
+    imagecache->getattribute("stat:bytes_read", TypeInt64, &c.bytes_read);
+    imagecache->getattribute("stat:find_tile_calls", TypeInt64, &c.tile_calls);
+    imagecache->getattribute("stat:find_tile_cache_misses", c.tile_misses);
+    return c;
+}
+
+
+
+void
+Oiiotool::profile_event(string_view name, const ProfileCounters& start)
+{
+    ProfileCounters end = profile_counters();
+    double wall         = end.time - start.time;
+    double cpu          = end.cpu - start.cpu;
+    int threads         = 1;
+    OIIO::getattribute("threads", threads);
+    // Thread utilization is the fraction of the available threads' time
+    // that was spent on the CPU.
+    double utilization = wall > 0.0 ? cpu / (wall * std::max(threads, 1))
+                                    : 0.0;
+    int misses         = end.tile_misses - start.tile_misses;
+    size_t mem         = check_peak_memory();
+    profile_events.push_back(Strutil::fmt::format(
+        "{{\"name\": \"{}\", \"cat\": \"oiiotool\", \"ph\": \"X\", "
+        "\"pid\": 1, \"tid\": 1, \"ts\": {:.0f}, \"dur\": {:.0f}, "
+        "\"args\": {{\"cpu_ms\": {:.3f}, \"thread_utilization\": {:.3f}, "
+        "\"bytes_read\": {}, \"bytes_written\": {}, "
+        "\"imagecache_hits\": {}, \"imagecache_misses\": {}, "
+        "\"imagecache_io_ms\": {:.3f}, \"memory_used\": {}, "
+        "\"peak_memory\": {}}}}}",
+        Strutil::escape_chars(name), start.time * 1.0e6, wall * 1.0e6,
+        cpu * 1.0e3, utilization, end.bytes_read - start.bytes_read,
+        end.bytes_out - start.bytes_out,
+        end.tile_calls - start.tile_calls - misses, misses,
+        (end.fileio_time - start.fileio_time) * 1.0e3, mem, peak_memory));
+}
+
+
+
+bool
+Oiiotool::write_profile()
+{
+    std::string json = Strutil::fmt::format(
+        "{{\"traceEvents\": [\n{}\n],\n\"displayTimeUnit\": \"ms\"}}\n",
+        Strutil::join(profile_events, ",\n"));
+    if (!Filesystem::write_text_file(profile_filename, json)) {
+        errorfmt("--profile", "Could not write {}", profile_filename);
+        return false;
+    }
+    return true;
+}
+
+
+
 void
 Oiiotool::remember_input_channelformats(ImageRecRef img)
 {
@@ -2724,6 +2984,11 @@ OIIOTOOL_OP(ccmatrix, 1, [](OiiotoolOp& op, span<ImageBuf*> img) {
         MM.transpose();
     if (op.options().get_int("invert") || op.options().get_int("inverse"))
         MM.invert();
+    std::string from = op.options().get_string("from");
+    std::string to   = op.options().get_string("to");
+    if (from.size() || to.size())
+        return ImageBufAlgo::colormatrixtransfer(*img[0], *img[1], MM, from,
+                                                 to, unpremult);
     return ImageBufAlgo::colormatrixtransform(*img[0], *img[1], MM, unpremult);
 });
 
@@ -3920,7 +4185,7 @@ action_crop(int argc, const char* argv[])
     auto options      = ot.extract_options(command);
     bool allsubimages = options.get_int("allsubimages", ot.allsubimages);
 
-    ot.read();
+    ot.read(ReadDefault, "", ot.crop_read_region(argv[0], size, allsubimages));
     ImageRecRef A     = ot.curimg;
     bool crops_needed = false;
     int subimages     = allsubimages ? A->subimages() : 1;
@@ -4086,8 +4351,9 @@ action_cut(int argc, const char* argv[])
     auto options      = ot.extract_options(command);
     bool allsubimages = options.get_int("allsubimages", ot.allsubimages);
 
-    // Operate on (and replace) the top-of-stack image
-    ot.read();
+    // Operate on (and replace) the top-of-stack image, of which only the
+    // part we keep needs to be read if it hasn't been yet.
+    ot.read(ReadDefault, "", ot.crop_read_region(argv[0], size, allsubimages));
     ImageRecRef A = ot.pop();
 
     // First, compute the specs of the cropped subimages
@@ -5068,18 +5334,72 @@ OIIOTOOL_OP(text, 1, [](OiiotoolOp& op, span<ImageBuf*> img) {
 
 
 // -i
+// Print the --info for `filename`, the current command line argument. If
+// only header information is wanted, rather than open the files one at a
+// time, describe this file and the plain filename arguments right after it
+// in parallel (also loading their headers into the ImageCache), and save
+// the others' output to print in order as each of them is reached.
+static bool
+print_info_prefetched(const std::string& filename,
+                      const print_info_options& pio, std::string& error)
+{
+    if (pio.compute_sha1 || pio.compute_stats || pio.dumpdata)
+        return OiioTool::print_info(std::cout, ot, filename, pio, error);
+
+    auto found = ot.info_prefetch.find(filename);
+    if (found == ot.info_prefetch.end()) {
+        const size_t batchsize = 256;
+        std::vector<std::string> files { filename };
+        for (size_t a = ot.ap.current_arg() + 1;
+             a < ot.command_args.size() && files.size() < batchsize; ++a) {
+            const std::string& arg(ot.command_args[a]);
+            if (arg.empty() || arg[0] == '-' || arg.find('{') != arg.npos
+                || ot.image_labels.count(arg))
+                break;
+            files.push_back(arg);
+        }
+        std::vector<Oiiotool::InfoResult> results(files.size());
+        parallel_for(int64_t(0), int64_t(files.size()), [&](int64_t i) {
+            if (i > 0 && !ot.input_config_set) {
+                int exists = 0;
+                ot.imagecache->get_image_info(ustring(files[i]), 0, 0,
+                                              ustring("exists"), TypeInt,
+                                              &exists);
+            }
+            std::ostringstream out;
+            results[i].ok   = OiioTool::print_info(out, ot, files[i], pio,
+                                                   results[i].error);
+            results[i].text = out.str();
+        });
+        for (size_t i = 1; i < files.size(); ++i)
+            ot.info_prefetch[files[i]] = std::move(results[i]);
+        std::cout << results[0].text;
+        error = results[0].error;
+        return results[0].ok;
+    }
+    std::cout << found->second.text;
+    error   = found->second.error;
+    bool ok = found->second.ok;
+    ot.info_prefetch.erase(found);
+    return ok;
+}
+
+
+
 static int
 input_file(int argc, const char* argv[])
 {
     // ot.total_readtime.start();
     string_view command = ot.express(argv[0]);
+    bool positional     = false;  // a bare filename, not an explicit -i
     if (argc > 1
         && (Strutil::starts_with(command, "-i")
             || Strutil::starts_with(command, "--i"))) {
         --argc;
         ++argv;
     } else {
-        command = "-i";
+        command    = "-i";
+        positional = true;
     }
     auto fileoptions     = ot.extract_options(command);
     int printinfo        = fileoptions.get_int("info", ot.printinfo);
@@ -5193,7 +5513,13 @@ input_file(int argc, const char* argv[])
             pio.subimages |= printinfo > 1;
             pio.infoformat = infoformat;
             std::string error;
-            bool ok = OiioTool::print_info(std::cout, ot, filename, pio, error);
+            bool ok;
+            size_t arg = ot.ap.current_arg();
+            if (positional && arg < ot.command_args.size()
+                && ot.command_args[arg] == filename)
+                ok = print_info_prefetched(filename, pio, error);
+            else
+                ok = OiioTool::print_info(std::cout, ot, filename, pio, error);
             if (!ok) {
                 ot.error("read", ot.format_read_error(filename, error));
                 break;
@@ -5347,6 +5673,43 @@ remove_all_cmd(std::string& str)
 
 
 // -o
+// Write a streamed ImageRec to the opened `out` a strip of tiles or
+// scanlines at a time, computing just that strip each time.
+static bool
+write_streamed(string_view command, ImageRec& ir, ImageOutput* out)
+{
+    const ImageSpec& spec(out->spec());
+    const int rows  = spec.tile_width ? spec.tile_height : 64;
+    const int slabs = spec.tile_width ? std::max(spec.tile_depth, 1) : 1;
+    for (int z = spec.z; z < spec.z + spec.depth; z += slabs) {
+        for (int y = spec.y; y < spec.y + spec.height; y += rows) {
+            ROI roi(spec.x, spec.x + spec.width, y,
+                    std::min(y + rows, spec.y + spec.height), z,
+                    std::min(z + slabs, spec.z + spec.depth));
+            ImageBuf strip;
+            if (!ir.stream_op()->stream_region(strip, roi)) {
+                ot.error(command, strip.geterror());
+                return false;
+            }
+            bool ok = spec.tile_width
+                          ? out->write_tiles(roi.xbegin, roi.xend, roi.ybegin,
+                                             roi.yend, roi.zbegin, roi.zend,
+                                             strip.spec().format,
+                                             strip.localpixels())
+                          : out->write_scanlines(roi.ybegin, roi.yend, z,
+                                                 strip.spec().format,
+                                                 strip.localpixels());
+            if (!ok) {
+                ot.error(command, out->geterror());
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+
+
 static int
 output_file(int /*argc*/, const char* argv[])
 {
@@ -5425,7 +5788,11 @@ output_file(int /*argc*/, const char* argv[])
     bool supports_negativeorigin = out->supports("negativeorigin");
     bool supports_tiles = out->supports("tiles") || ot.output_force_tiles;
     bool procedural     = out->supports("procedural");
-    if (!ot.read()) {
+    // A streamed image is left to be computed as it's written, unless
+    // something below needs its pixels first.
+    bool stream_write = ot.curimg->streamed() && !do_tex && !do_latlong
+                        && !do_bumpslopes;
+    if (!stream_write && !ot.read()) {
         return 0;
     }
     ImageRecRef saveimg = ot.curimg;
@@ -5455,6 +5822,8 @@ output_file(int /*argc*/, const char* argv[])
     // Handle --autotrim
     int autotrim = fileoptions.get_int("autotrim", ot.output_autotrim);
     if (supports_displaywindow && autotrim) {
+        if (!ot.read(ir))
+            return 0;
         ROI roi           = nonzero_region_all_subimages(ir);
         bool crops_needed = false;
         for (int s = 0; s < ir->subimages(); ++s)
@@ -5668,7 +6037,12 @@ output_file(int /*argc*/, const char* argv[])
                         break;
                     }
                 }
-                if (!(*ir)(s, m).write(out.get())) {
+                if (ir->streamed()) {
+                    if (!write_streamed(command, *ir, out.get())) {
+                        ok = false;
+                        break;
+                    }
+                } else if (!(*ir)(s, m).write(out.get())) {
                     ot.error(command, (*ir)(s, m).geterror());
                     ok = false;
                     break;
@@ -5712,6 +6086,8 @@ output_file(int /*argc*/, const char* argv[])
                     command,
                     "oiiotool ERROR: could not move temp file {} to {}: {}",
                     tmpfilename, filename, err);
+            else
+                ot.bytes_written += Filesystem::file_size(filename);
         }
         if (!ok)
             Filesystem::remove(tmpfilename);
@@ -6120,6 +6496,8 @@ Oiiotool::getargs(int argc, char* argv[])
         if (!strcmp(argv[i], "--sansattrib") || !strcmp(argv[i], "-sansattrib"))
             sansattrib = true;
     ot.full_command_line = command_line_string(argc, argv, sansattrib);
+    command_args.assign(argv, argv + argc);
+    info_prefetch.clear();
 
     // clang-format off
     ap.intro("oiiotool -- simple image processing operations\n"
@@ -6148,6 +6526,10 @@ Oiiotool::getargs(int argc, char* argv[])
       .help("Debug mode");
     ap.arg("--runstats", &ot.runstats)
       .help("Print runtime statistics");
+    ap.arg("--serve %s:SOCKET")
+      .help("Stay running, and run the command lines sent to the Unix domain socket SOCKET");
+    ap.arg("--profile %s:FILENAME", &ot.profile_filename)
+      .help("Write per-command times, I/O, and memory to a file in Chrome trace event (JSON) format");
     ap.arg("--info")
       .help("Print resolution and basic info on all inputs, detailed metadata if -v is also used (options: format=xml:verbose=1)")
       .action(set_printinfo);
@@ -6200,6 +6582,8 @@ Oiiotool::getargs(int argc, char* argv[])
       .action(set_autotile);
     ap.arg("--metamerge", &ot.metamerge)
       .help("Always merge metadata of all inputs into output");
+    ap.arg("--stream", &ot.stream)
+      .help("Compute chains of pixel-wise operations a strip at a time as they are output");
     ap.arg("--oiioattrib %s:NAME %s:VALUE")
       .help("Sets global OpenImageIO attribute (options: type=...)")
       .action(set_oiio_attribute);
@@ -6248,6 +6632,8 @@ Oiiotool::getargs(int argc, char* argv[])
       .help("Views for %V/%v wildcards (comma-separated, defaults to \"left,right\")");
     ap.arg("--skip-bad-frames", &ot.skip_bad_frames)
       .help("Skip to next frame in range if there's an error, rather than exiting");
+    ap.arg("--parallel-frames %d:N")
+      .help("Process N frames of a sequence at once, as separate processes sharing the --cache budget (0 = one per core)");
     ap.arg("--wildcardoff")
       .help("Disable numeric wildcard expansion for subsequent command line arguments");
     ap.arg("--wildcardon")
@@ -6715,7 +7101,7 @@ Oiiotool::getargs(int argc, char* argv[])
       .help("Convert pixels from 'src' to 'dst' color space (options: key=, value=, unpremult=, strict=)")
       .action(action_colorconvert);
     ap.arg("--ccmatrix %s:MATRIXVALS")
-      .help("Color convert pixels with a 3x3 or 4x4 matrix (options: unpremult=,transpose=)")
+      .help("Color convert pixels with a 3x3 or 4x4 matrix (options: unpremult=,transpose=,from=,to=)")
       .action(action_ccmatrix);
     ap.arg("--ociolook %s:LOOK")
       .help("Apply the named OCIO look (options: from=, to=, inverse=, key=, value=, unpremult=)")
@@ -6764,6 +7150,95 @@ Oiiotool::getargs(int argc, char* argv[])
 
 
 
+// Quote an argument for the command shell used by std::system.
+static std::string
+shell_quote(string_view arg)
+{
+#ifdef _WIN32
+    return "\"" + Strutil::replace(arg, "\"", "\\\"", true) + "\"";
+#else
+    return "'" + Strutil::replace(arg, "'", "'\\''", true) + "'";
+#endif
+}
+
+
+
+// For --parallel-frames: run each frame of a sequence as its own oiiotool
+// process, with its own wildcard arguments substituted, and up to nprocs
+// of them at once, so that the reads and writes of some frames overlap
+// the computation of others. The processes split the ImageCache budget
+// and the threads between them.
+static bool
+run_parallel_frames(int argc, const char** argv,
+                    const std::vector<int>& sequence_args,
+                    const std::vector<std::vector<std::string>>& filenames,
+                    const std::vector<int>& frame_numbers, size_t nframes,
+                    int nprocs, int cachesize, bool skip_bad_frames)
+{
+    nprocs       = std::min(nprocs, int(nframes));
+    int nthreads = std::max(1, int(Sysutil::hardware_concurrency()) / nprocs);
+
+    std::string cache   = Strutil::to_string(std::max(1, cachesize / nprocs));
+    std::string program = shell_quote(Sysutil::this_program_path());
+    std::atomic<size_t> next_frame(0);
+    std::atomic<int> frames_ok(0);
+    std::atomic<bool> failed(false);
+    auto run_frames = [&]() {
+        while (true) {
+            size_t i = next_frame++;
+            if (i >= nframes || (failed && !skip_bad_frames))
+                break;
+            // The per-frame process gets just this frame number, which
+            // also sets FRAME_NUMBER for expressions, and the command line
+            // with the wildcards already substituted. Its own --cache and
+            // --threads come first, so any from the user override them
+            // (but a --cache is divided as well).
+            std::string cmd = Strutil::fmt::format(
+                "{} --frames {} --threads {} --cache {}", program,
+                frame_numbers[i], nthreads, cache);
+            for (int a = 1; a < argc; ++a) {
+                string_view arg(argv[a]);
+                if ((arg == "--parallel-frames" || arg == "-parallel-frames"
+                     || arg == "--frames" || arg == "-frames")
+                    && a < argc - 1) {
+                    ++a;
+                    continue;
+                }
+                if (std::find(sequence_args.begin(), sequence_args.end(), a)
+                    != sequence_args.end())
+                    arg = filenames[a][i];
+                cmd += " " + shell_quote(arg);
+                if ((arg == "--cache" || arg == "-cache") && a < argc - 1) {
+                    cmd += " " + cache;
+                    ++a;
+                }
+            }
+#ifdef _WIN32
+            cmd = "\"" + cmd + "\"";  // cmd.exe strips one set of quotes
+#endif
+            if (ot.debug)
+                Strutil::print("FRAME {}: {}\n", frame_numbers[i], cmd);
+            if (std::system(cmd.c_str()) == 0)
+                ++frames_ok;
+            else
+                failed = true;
+        }
+    };
+    std::vector<std::thread> workers;
+    for (int p = 0; p < nprocs; ++p)
+        workers.emplace_back(run_frames);
+    for (auto& w : workers)
+        w.join();
+
+    if (failed)
+        ot.return_value = EXIT_FAILURE;
+    // Each frame's process did its own check for missing outputs.
+    ot.num_outputs += frames_ok;
+    return true;
+}
+
+
+
 // Check if any of the command line arguments contains numeric ranges or
 // wildcards.  If not, just return 'false'.  But if they do, the
 // remainder of processing will happen here (and return 'true').
@@ -6789,7 +7264,10 @@ handle_sequence(int argc, const char** argv)
     std::vector<string_view> views;
     Strutil::split(default_views, views, ",");
 
-    int framepadding = 0;
+    int framepadding    = 0;
+    int parallel_frames = 1;
+    int cachesize       = ot.cachesize;
+    bool skip_bad       = false;
     std::vector<int> sequence_args;  // Args with sequence numbers
     std::vector<bool> sequence_is_output;
     bool is_sequence = false;
@@ -6823,6 +7301,18 @@ handle_sequence(int argc, const char** argv)
         } else if ((strarg == "--views" || strarg == "-views")
                    && a < argc - 1) {
             Strutil::split(argv[++a], views, ",");
+        } else if ((strarg == "--parallel-frames"
+                    || strarg == "-parallel-frames")
+                   && a < argc - 1) {
+            parallel_frames = Strutil::stoi(argv[++a]);
+            if (parallel_frames <= 0)
+                parallel_frames = Sysutil::hardware_concurrency();
+        } else if ((strarg == "--cache" || strarg == "-cache")
+                   && a < argc - 1) {
+            cachesize = Strutil::stoi(argv[++a]);
+        } else if (strarg == "--skip-bad-frames"
+                   || strarg == "-skip-bad-frames") {
+            skip_bad = true;
         } else if (strarg == "--wildcardoff" || strarg == "-wildcardoff") {
             wildcard_on = false;
         } else if (strarg == "--wildcardon" || strarg == "-wildcardon") {
@@ -6914,6 +7404,11 @@ handle_sequence(int argc, const char** argv)
     if (sequence_args.size() && frame_numbers[0].empty())
         frame_numbers[0] = frame_numbers[sequence_args[0]];
 
+    if (parallel_frames > 1 && nfilenames > 1)
+        return run_parallel_frames(argc, argv, sequence_args, filenames,
+                                   frame_numbers[0], nfilenames,
+                                   parallel_frames, cachesize, skip_bad);
+
     // OK, now we just call getargs once for each item in the sequences,
     // substituting the i-th sequence entry for its respective argument
     // every time.
@@ -6967,55 +7462,15 @@ handle_sequence(int argc, const char** argv)
 
 
 
-int
-main(int argc, char* argv[])
+// Run one whole oiiotool command line.
+static int
+run_command_line(int argc, char* argv[])
 {
-#if OIIO_SIMD_SSE && !OIIO_F16C_ENABLED
-    // We've found old versions of libopenjpeg (either by itself, or
-    // pulled in by ffmpeg libraries that link against it) that upon its
-    // dso load will turn on the cpu mode that causes floating point
-    // denormals get crushed to 0.0 in certain ops, and leave it that
-    // way! This can give us the wrong results for the particular
-    // sequence of SSE intrinsics we use to convert half->float for exr
-    // files containing pixels with denorm values. Can't fix everywhere,
-    // but at least for oiiotool we know it's safe to just fix the flag
-    // for our app. We only need to do this if using sse instructions and
-    // the f16c hardware half<->float ops are not enabled. This does not
-    // seem to be a problem in libopenjpeg > 1.5.
-    // And, oy, just to mess with us, this doesn't work in gcc 4.8.
-    simd::set_denorms_zero_mode(false);
-#endif
-    {
-        // DEBUG -- this checks some problematic half->float values if the
-        // denorms zero mode is not set correctly. Leave this fragment in
-        // case we ever need to check it again.
-        // using namespace OIIO::simd;
-        const unsigned short bad[] = { 59, 12928, 2146, 32805 };
-        const half* h              = (half*)bad;
-        simd::vfloat4 vf(h);
-        if (vf[0] == 0.0f || *h != vf[0])
-            Strutil::print(stderr,
-                           "Bad half conversion, code {} {} -> {} "
-                           "(suspect badly set DENORMS_ZERO_MODE)\n",
-                           bad[0], h[0], vf[0]);
-    }
-
-    // Helpful for debugging to make sure that any crashes dump a stack
-    // trace.
-    Sysutil::setup_crash_stacktrace("stdout");
-
-    // Globally force classic "C" locale, and turn off all formatting
-    // internationalization, for the entire oiiotool application.
-    std::locale::global(std::locale::classic());
-
-    ot.imagecache = ImageCache::create();
-    OIIO_DASSERT(ot.imagecache);
-    ot.imagecache->attribute("forcefloat", 1);
-    ot.imagecache->attribute("max_memory_MB", float(ot.cachesize));
-    ot.imagecache->attribute("autotile", ot.autotile);
-    ot.imagecache->attribute("autoscanline", int(ot.autotile ? 1 : 0));
-
-    Filesystem::convert_native_arguments(argc, (const char**)argv);
+    // Find --profile up front, so the commands before it are profiled too
+    for (int a = 1; a < argc - 1; ++a)
+        if (string_view(argv[a]) == "--profile"
+            || string_view(argv[a]) == "-profile")
+            ot.profile_filename = argv[a + 1];
     if (handle_sequence(argc, (const char**)argv)) {
         // Deal with sequence
 
@@ -7073,5 +7528,189 @@ main(int argc, char* argv[])
         std::cout << "\n" << ot.imagecache->getstats(2) << "\n";
     }
 
+    if (ot.profile_filename.size() && !ot.write_profile())
+        ot.return_value = EXIT_FAILURE;
+
     return ot.return_value;
 }
+
+
+#ifndef _WIN32
+// Read a --serve job from the client: each argument is followed by a NUL
+// byte, and an empty argument ends the command line.
+static bool
+read_job(int conn, std::vector<std::string>& args)
+{
+    std::string arg;
+    char buf[4096];
+    while (true) {
+        ssize_t n = ::read(conn, buf, sizeof(buf));
+        if (n <= 0)
+            return false;
+        for (ssize_t i = 0; i < n; ++i) {
+            if (buf[i]) {
+                arg += buf[i];
+            } else if (arg.empty()) {
+                return true;
+            } else {
+                args.push_back(arg);
+                arg.clear();
+            }
+        }
+    }
+}
+
+
+
+// Run a --serve job, sending everything it prints to the client.
+static int
+run_job(int conn, std::vector<std::string>& args)
+{
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    int saved_out = dup(1), saved_err = dup(2);
+    dup2(conn, 1);
+    dup2(conn, 2);
+
+    std::vector<char*> argv { const_cast<char*>("oiiotool") };
+    for (auto& a : args)
+        argv.push_back(&a[0]);
+    argv.push_back(nullptr);
+    ot.reset();
+    int status = run_command_line(int(args.size()) + 1, argv.data());
+
+    std::cout.flush();
+    std::cerr.flush();
+    fflush(stdout);
+    fflush(stderr);
+    dup2(saved_out, 1);
+    dup2(saved_err, 2);
+    close(saved_out);
+    close(saved_err);
+    return status;
+}
+#endif
+
+
+
+// --serve: rather than running a command line, stay running and run the
+// command lines sent by clients over the Unix domain socket `socketpath`,
+// one at a time, so they share this process's loaded plugins, color
+// configuration, and warm ImageCache. A client sends each argument of a
+// command line (without the leading "oiiotool") followed by a NUL byte,
+// and then an empty argument. It receives everything the command printed,
+// then a NUL byte and the command's exit status as decimal text.
+static int
+serve(const char* socketpath)
+{
+#ifdef _WIN32
+    ot.errorfmt("--serve", "not supported on this platform");
+    return EXIT_FAILURE;
+#else
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (strlen(socketpath) >= sizeof(addr.sun_path)) {
+        ot.errorfmt("--serve", "socket name too long: {}", socketpath);
+        return EXIT_FAILURE;
+    }
+    strncpy(addr.sun_path, socketpath, sizeof(addr.sun_path) - 1);
+    unlink(socketpath);  // remove any left by an earlier server
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0 || bind(listener, (sockaddr*)&addr, sizeof(addr)) < 0
+        || listen(listener, 64) < 0) {
+        ot.errorfmt("--serve", "could not listen on {}: {}", socketpath,
+                    strerror(errno));
+        if (listener >= 0)
+            close(listener);
+        return EXIT_FAILURE;
+    }
+    // A client that disconnects early must not take the server down
+    signal(SIGPIPE, SIG_IGN);
+
+    // Load all the plugins now, rather than during the first job
+    std::string formats;
+    OIIO::getattribute("format_list", formats);
+
+    while (true) {
+        int conn = accept(listener, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+        std::vector<std::string> args;
+        if (read_job(conn, args)) {
+            int status = run_job(conn, args);
+            std::string trailer(1, '\0');
+            trailer += Strutil::fmt::format("{}\n", status);
+            if (::write(conn, trailer.data(), trailer.size()) < 0)
+                ot.warningfmt("--serve", "lost client: {}", strerror(errno));
+        }
+        close(conn);
+    }
+    close(listener);
+    unlink(socketpath);
+    return EXIT_SUCCESS;
+#endif
+}
+
+
+
+int
+main(int argc, char* argv[])
+{
+#if OIIO_SIMD_SSE && !OIIO_F16C_ENABLED
+    // We've found old versions of libopenjpeg (either by itself, or
+    // pulled in by ffmpeg libraries that link against it) that upon its
+    // dso load will turn on the cpu mode that causes floating point
+    // denormals get crushed to 0.0 in certain ops, and leave it that
+    // way! This can give us the wrong results for the particular
+    // sequence of SSE intrinsics we use to convert half->float for exr
+    // files containing pixels with denorm values. Can't fix everywhere,
+    // but at least for oiiotool we know it's safe to just fix the flag
+    // for our app. We only need to do this if using sse instructions and
+    // the f16c hardware half<->float ops are not enabled. This does not
+    // seem to be a problem in libopenjpeg > 1.5.
+    // And, oy, just to mess with us, this doesn't work in gcc 4.8.
+    simd::set_denorms_zero_mode(false);
+#endif
+    {
+        // DEBUG -- this checks some problematic half->float values if the
+        // denorms zero mode is not set correctly. Leave this fragment in
+        // case we ever need to check it again.
+        // using namespace OIIO::simd;
+        const unsigned short bad[] = { 59, 12928, 2146, 32805 };
+        const half* h              = (half*)bad;
+        simd::vfloat4 vf(h);
+        if (vf[0] == 0.0f || *h != vf[0])
+            Strutil::print(stderr,
+                           "Bad half conversion, code {} {} -> {} "
+                           "(suspect badly set DENORMS_ZERO_MODE)\n",
+                           bad[0], h[0], vf[0]);
+    }
+
+    // Helpful for debugging to make sure that any crashes dump a stack
+    // trace.
+    Sysutil::setup_crash_stacktrace("stdout");
+
+    // Globally force classic "C" locale, and turn off all formatting
+    // internationalization, for the entire oiiotool application.
+    std::locale::global(std::locale::classic());
+
+    ot.imagecache = ImageCache::create();
+    OIIO_DASSERT(ot.imagecache);
+    ot.imagecache->attribute("forcefloat", 1);
+    ot.imagecache->attribute("max_memory_MB", float(ot.cachesize));
+    ot.imagecache->attribute("autotile", ot.autotile);
+    ot.imagecache->attribute("autoscanline", int(ot.autotile ? 1 : 0));
+
+    Filesystem::convert_native_arguments(argc, (const char**)argv);
+    for (int a = 1; a < argc - 1; ++a)
+        if (string_view(argv[a]) == "--serve"
+            || string_view(argv[a]) == "-serve")
+            return serve(argv[a + 1]);
+    return run_command_line(argc, argv);
+}
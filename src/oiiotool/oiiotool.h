@@ -25,6 +25,7 @@ typedef int (*CallbackFunction)(int argc, const char* argv[]);
 
 class Oiiotool;
 class ImageRec;
+class OiiotoolOp;
 typedef std::shared_ptr<ImageRec> ImageRecRef;
 
 
@@ -95,6 +96,7 @@ public:
     bool eval_enable;              // Enable evaluation of expressions
     bool skip_bad_frames = false;  // Just skip a bad frame, don't exit
     bool nostderr        = false;  // If true, use stdout for errors
+    bool stream          = false;  // Defer pixel-wise ops (--stream)
     std::string dumpdata_C_name;
     std::string full_command_line;
     std::string printinfo_metamatch;
@@ -147,6 +149,19 @@ public:
     float diff_failpercent;
     float diff_hardfail;
 
+    // --profile: per-command trace events, written as JSON at the end
+    std::string profile_filename;
+    std::vector<std::string> profile_events;
+
+    // Header-only --info output for the input files that come next on the
+    // command line, computed ahead in parallel (see input_file).
+    struct InfoResult {
+        bool ok = false;
+        std::string text, error;
+    };
+    std::vector<std::string> command_args;  // argv being parsed by getargs
+    std::map<std::string, InfoResult> info_prefetch;
+
     // Internal state
     ImageRecRef curimg;                    // current image
     std::vector<ImageRecRef> image_stack;  // stack of previous images
@@ -164,6 +179,7 @@ public:
     size_t peak_memory          = 0;
     int return_value            = EXIT_SUCCESS;  // oiiotool command return code
     int num_outputs             = 0;             // Count of outputs written
+    imagesize_t bytes_written   = 0;             // Total bytes of outputs
     int frame_number            = 0;
     bool enable_function_timing = true;
     bool input_config_set       = false;
@@ -178,6 +194,10 @@ public:
     void clear_options();
     void clear_input_config();
 
+    // Forget everything from running a previous command line (for
+    // --serve), except for the ImageCache and color configuration.
+    void reset();
+
     // Process command line arguments
     void getargs(int argc, char* argv[]);
 
@@ -203,17 +223,33 @@ public:
 
     /// Force img to be read at this point.  Use this wrapper, don't directly
     /// call img->read(), because there's extra work done here specific to
-    /// oiiotool.
+    /// oiiotool. If `region` is defined, only that part of the first
+    /// subimage is needed.
     bool read(ImageRecRef img, ReadPolicy readpolicy = ReadDefault,
-              string_view channel_set = "");
+              string_view channel_set = "", ROI region = ROI::All());
     // Read the current image
-    bool read(ReadPolicy readpolicy = ReadDefault, string_view channel_set = "")
+    bool read(ReadPolicy readpolicy = ReadDefault, string_view channel_set = "",
+              ROI region = ROI::All())
     {
         if (curimg)
-            return read(curimg, readpolicy, channel_set);
+            return read(curimg, readpolicy, channel_set, region);
         return true;
     }
 
+    // Read several images, such as all the inputs of an op. Those that
+    // need to be read from disk don't depend on each other, so they are
+    // read concurrently.
+    bool read_images(span<ImageRecRef> imgs,
+                     ReadPolicy readpolicy = ReadDefault);
+
+    // The region of the current image that an operation about to replace
+    // it with the crop `size` (as accepted by adjust_geometry) will need,
+    // or an undefined ROI if the whole image should be read: because it
+    // has already been read, other references to it remain, or the
+    // operation applies to all subimages.
+    ROI crop_read_region(string_view command, string_view size,
+                         bool allsubimages);
+
     /// Force partial read of image (if it hasn't been yet), just enough
     /// that the nativespec can be examined.
     bool read_nativespec(ImageRecRef img);
@@ -336,6 +372,26 @@ public:
         return mem;
     }
 
+    // Snapshot of the running totals that --profile reports for each
+    // command as the difference between its start and end.
+    struct ProfileCounters {
+        double time           = 0.0;  // since oiiotool started
+        double cpu            = 0.0;  // process CPU time, all threads
+        float fileio_time     = 0.0f;
+        long long bytes_read  = 0;
+        long long tile_calls  = 0;
+        int tile_misses       = 0;
+        imagesize_t bytes_out = 0;
+    };
+    ProfileCounters profile_counters() const;
+
+    // Record a --profile trace event for command `name`, which began when
+    // the counters were `start`.
+    void profile_event(string_view name, const ProfileCounters& start);
+
+    // Write the --profile trace events, in Chrome trace event format.
+    bool write_profile();
+
     static std::string format_read_error(string_view filename, std::string err)
     {
         if (!err.size())
@@ -354,6 +410,9 @@ private:
     int m_pending_argc;
     const char* m_pending_argv[4];
 
+    // The bookkeeping after img has been read from disk.
+    bool finish_read(ImageRecRef img, bool ok);
+
     void express_error(const string_view expr, const string_view s,
                        string_view explanation);
 
@@ -498,8 +557,11 @@ public:
     // Read just enough to fill in the nativespecs
     bool read_nativespec();
 
+    // Read the image. If `region` is defined, only that window of the
+    // first subimage's highest resolution level is read, the rest as
+    // usual.
     bool read(ReadPolicy readpolicy   = ReadDefault,
-              string_view channel_set = "");
+              string_view channel_set = "", ROI region = ROI::All());
 
     // ir(subimg,mip) references a specific MIP level of a subimage
     // ir(subimg) references the first MIP level of a subimage
@@ -524,10 +586,31 @@ public:
 
     const ImageSpec* nativespec(int subimg = 0, int mip = 0) const
     {
+        if (streamed())
+            return spec(subimg, mip);
         return subimg < subimages() ? &((*this)(subimg, mip).nativespec())
                                     : nullptr;
     }
 
+    // A streamed ImageRec (see --stream) knows its spec but has no pixels
+    // yet. Instead it holds the pixel-wise op that computes them, which
+    // can be asked for one region at a time, such as a strip of an output
+    // file. Reading it computes the whole image, after which it's an
+    // ordinary ImageRec.
+    bool streamed() const { return m_stream_op != nullptr; }
+    const std::shared_ptr<OiiotoolOp>& stream_op() const
+    {
+        return m_stream_op;
+    }
+    void stream_op(std::shared_ptr<OiiotoolOp> op, const ImageSpec& spec)
+    {
+        *m_subimages[0].spec(0) = spec;
+        m_stream_op             = std::move(op);
+        m_elaborated            = false;
+        metadata_modified(true);
+    }
+    bool unstream();
+
     bool was_output() const { return m_was_output; }
     void was_output(bool val) { m_was_output = val; }
     bool metadata_modified() const { return m_metadata_modified; }
@@ -610,6 +693,7 @@ private:
     ImageCache* m_imagecache = nullptr;
     mutable std::string m_err;
     std::unique_ptr<ImageSpec> m_configspec;
+    std::shared_ptr<OiiotoolOp> m_stream_op;
 
     // Add to the error message
     void append_error(string_view message) const;
@@ -731,6 +815,8 @@ public:
         , m_ot(ot)
         , m_name(name)
     {
+        if (m_ot.profile_filename.size())
+            m_profile_start = m_ot.profile_counters();
         if (m_ot.enable_function_timing)
             start();
     }
@@ -741,6 +827,8 @@ public:
         stop();
         m_ot.function_times[m_name] += m_timer() - m_io_time;
         m_ot.function_times["-i"] += m_io_time;
+        if (m_ot.profile_filename.size())
+            m_ot.profile_event(m_name, m_profile_start);
     }
 
     // Explicit start of the timer.
@@ -775,6 +863,7 @@ private:
     double m_pre_input_time = 0.0f;
     double m_pre_ic_time    = 0.0f;
     double m_io_time        = 0.0f;
+    Oiiotool::ProfileCounters m_profile_start;
 };
 
 
@@ -844,11 +933,9 @@ public:
         // Read all input images, and reserve (and push) the output image.
         int subimages = compute_subimages();
         timer.stop();  // suspend timer to avoid double counting reads
-        for (int i = 1; i < nimages(); ++i) {
-            bool ok = ot.read(m_ir[i]);
-            if (!ok)
-                return 0;
-        }
+        if (nimages() > 1
+            && !ot.read_images(span<ImageRecRef>(m_ir).subspan(1)))
+            return 0;
         timer.start();
         if (nimages()) {
             // Read the inputs
@@ -901,7 +988,9 @@ public:
                                           std::min(m, ir(i)->miplevels(s))));
 
                 if (subimage_is_active(s)) {
-                    // Call the impl kernel for this subimage
+                    // Call the impl kernel for this subimage, in place if
+                    // possible.
+                    take_first_input();
                     bool ok = impl(m_img);
                     if (!ok)
                         ot.errorfmt(opname(), "{}", m_img[0]->geterror());
@@ -926,6 +1015,64 @@ public:
         }
     }
 
+    // If the op may run in place and nothing else refers to its first
+    // input, move the input's pixels into the (still empty) output so that
+    // impl() overwrites them rather than filling a new buffer. This is only
+    // done when the result is the same either way: a local float buffer
+    // with the same data window and channels as any other inputs.
+    bool take_first_input()
+    {
+        if (!m_inplace || nimages() < 2 || m_ir[1].use_count() != 1
+            || m_img[0]->initialized())
+            return false;
+        const ImageBuf& A(*m_img[1]);
+        if (A.storage() != ImageBuf::LOCALBUFFER || A.deep()
+            || A.spec().format != TypeFloat)
+            return false;
+        for (int i = 2; i < nimages(); ++i)
+            if (m_img[i]->roi() != A.roi()
+                || m_img[i]->spec().format != TypeFloat)
+                return false;
+        m_img[0]->swap(*m_img[1]);
+        m_img[1] = m_img[0];
+        return true;
+    }
+
+    // For a streamed op (see --stream), compute region `roi` of its output
+    // into dst. If dst is not yet initialized, it gets the spec the op
+    // would give its whole result, but with roi as its data window. Inputs
+    // that are themselves streamed are computed for just that region, and
+    // other inputs are copied for it unless they already match it.
+    bool stream_region(ImageBuf& dst, ROI roi)
+    {
+        std::vector<ImageBuf> region(nimages());
+        m_img.resize(nimages());
+        m_img[0] = &dst;
+        for (int i = 1; i < nimages(); ++i) {
+            m_img[i] = &region[i];
+            if (ir(i)->streamed()) {
+                if (!ir(i)->stream_op()->stream_region(region[i], roi)) {
+                    dst.errorfmt("{}", region[i].geterror());
+                    return false;
+                }
+                continue;
+            }
+            ImageBuf& src((*ir(i))());
+            ROI srcroi     = src.roi();
+            srcroi.chbegin = roi.chbegin;
+            srcroi.chend   = roi.chend;
+            if (srcroi == roi) {
+                m_img[i] = &src;
+            } else {
+                ImageSpec spec = src.spec();
+                spec.set_roi(roi);
+                region[i].reset(spec);
+                region[i].copy_pixels(src);
+            }
+        }
+        return impl(m_img);
+    }
+
     // THIS is the method that needs to be separately overloaded for each
     // different op. This is called once for each subimage, generally with
     // img[0] the destination ImageBuf, and img[1..] as the inputs. It's
@@ -1076,6 +1223,11 @@ public:
     void preserve_miplevels(bool val) { m_preserve_miplevels = val; }
     bool preserve_miplevels() const { return m_preserve_miplevels; }
 
+    // Call inplace(true) if the impl may write its result over its first
+    // input image, as the pixel-wise IBA functions can.
+    void inplace(bool val) { m_inplace = val; }
+    bool inplace() const { return m_inplace; }
+
     // Call skip_impl(true) if the impl should skipped entirely and just
     // leave the stack unchanged. This can be set by a custom setup method.
     void skip_impl(bool val) { m_skip_impl = val; }
@@ -1088,6 +1240,7 @@ protected:
     int m_nimages;
     bool m_preserve_miplevels = false;
     bool m_skip_impl          = false;
+    bool m_inplace            = false;
     std::vector<ImageRecRef> m_ir;
     std::vector<ImageBuf*> m_img;
     std::vector<string_view> m_args;
@@ -0,0 +1,85 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Private definitions internal to the openexr.imageio plugin
+/////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <OpenImageIO/Imath.h>
+#include <OpenImageIO/dassert.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/platform.h>
+
+// The way that OpenEXR uses dynamic casting requires temporarily
+// suspending "hidden" symbol visibility mode.
+OIIO_PRAGMA_VISIBILITY_PUSH
+#include <OpenEXR/IexBaseExc.h>
+#include <OpenEXR/ImfIO.h>
+OIIO_PRAGMA_VISIBILITY_POP
+
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+
+// Custom file input stream, copying code from the class StdIFStream in OpenEXR,
+// which would have been used if we just provided a filename. The difference is
+// that this can handle UTF-8 file paths on all platforms.
+class OpenEXRInputStream final : public Imf::IStream {
+public:
+    OpenEXRInputStream(const char* filename, Filesystem::IOProxy* io)
+        : Imf::IStream(filename)
+        , m_io(io)
+    {
+        if (!io || io->mode() != Filesystem::IOProxy::Read)
+            throw Iex::IoExc("File intput failed.");
+    }
+    virtual bool read(char c[], int n)
+    {
+        OIIO_DASSERT(m_io);
+        if (m_io->read(c, n) != size_t(n))
+            throw Iex::IoExc("Unexpected end of file.");
+        return n;
+    }
+#if OIIO_USING_IMATH >= 3
+    virtual uint64_t tellg() { return m_io->tell(); }
+    virtual void seekg(uint64_t pos)
+    {
+        if (!m_io->seek(pos))
+            throw Iex::IoExc("File input failed.");
+    }
+#else
+    virtual Imath::Int64 tellg() { return m_io->tell(); }
+    virtual void seekg(Imath::Int64 pos)
+    {
+        if (!m_io->seek(pos))
+            throw Iex::IoExc("File input failed.");
+    }
+#endif
+    virtual void clear() {}
+
+private:
+    Filesystem::IOProxy* m_io = nullptr;
+};
+
+
+
+// Both OpenEXR readers implement this, so that OpenEXROutput::copy_image()
+// can copy the compressed chunks of the file they are reading straight
+// into the file being written, without decoding and re-encoding them.
+class OpenEXRRawSource {
+public:
+    // The IOProxy that the open file is read through.
+    virtual Filesystem::IOProxy* raw_ioproxy() = 0;
+
+protected:
+    ~OpenEXRRawSource() {}
+};
+
+
+OIIO_PLUGIN_NAMESPACE_END
@@ -88,6 +88,7 @@ OIIO_PRAGMA_VISIBILITY_POP
 #    define USE_OPENEXR_CORE
 #endif
 
+#include "exr_pvt.h"
 #include "imageio_pvt.h"
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/deepdata.h>
@@ -102,49 +103,7 @@ OIIO_PRAGMA_VISIBILITY_POP
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 
-// Custom file input stream, copying code from the class StdIFStream in OpenEXR,
-// which would have been used if we just provided a filename. The difference is
-// that this can handle UTF-8 file paths on all platforms.
-class OpenEXRInputStream final : public Imf::IStream {
-public:
-    OpenEXRInputStream(const char* filename, Filesystem::IOProxy* io)
-        : Imf::IStream(filename)
-        , m_io(io)
-    {
-        if (!io || io->mode() != Filesystem::IOProxy::Read)
-            throw Iex::IoExc("File intput failed.");
-    }
-    virtual bool read(char c[], int n)
-    {
-        OIIO_DASSERT(m_io);
-        if (m_io->read(c, n) != size_t(n))
-            throw Iex::IoExc("Unexpected end of file.");
-        return n;
-    }
-#if OIIO_USING_IMATH >= 3
-    virtual uint64_t tellg() { return m_io->tell(); }
-    virtual void seekg(uint64_t pos)
-    {
-        if (!m_io->seek(pos))
-            throw Iex::IoExc("File input failed.");
-    }
-#else
-    virtual Imath::Int64 tellg() { return m_io->tell(); }
-    virtual void seekg(Imath::Int64 pos)
-    {
-        if (!m_io->seek(pos))
-            throw Iex::IoExc("File input failed.");
-    }
-#endif
-    virtual void clear() {}
-
-private:
-    Filesystem::IOProxy* m_io = nullptr;
-};
-
-
-
-class OpenEXRInput final : public ImageInput {
+class OpenEXRInput final : public ImageInput, public OpenEXRRawSource {
 public:
     OpenEXRInput();
     virtual ~OpenEXRInput() { close(); }
@@ -199,6 +158,7 @@ public:
         m_io = ioproxy;
         return true;
     }
+    virtual Filesystem::IOProxy* raw_ioproxy() override { return m_io; }
 
 private:
     struct PartInfo {
@@ -307,6 +267,8 @@ openexr_input_imageio_create()
 OIIO_EXPORT const char* openexr_input_extensions[] = { "exr", "sxr", "mxr",
                                                        nullptr };
 
+OIIO_EXPORT const char* openexr_input_signatures[] = { "762f3101", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -399,7 +361,7 @@ OpenEXRInput::valid_file(const std::string& filename,
     try {
         std::unique_ptr<Filesystem::IOProxy> local_io;
         if (!io) {
-            io = new Filesystem::IOFile(filename, Filesystem::IOProxy::Read);
+            io = pvt::create_read_ioproxy(filename);
             local_io.reset(io);
         }
         OpenEXRInputStream IStream(filename.c_str(), io);
@@ -423,6 +385,17 @@ OpenEXRInput::open(const std::string& name, ImageSpec& newspec,
     if (param)
         m_io = param->get<Filesystem::IOProxy*>();
 
+    // A remote file gets its proxy right away, so that the validity check
+    // below doesn't have to make its own connection.
+    if (!m_io && pvt::is_remote_url(name)) {
+        m_io = pvt::create_read_ioproxy(name);
+        m_local_io.reset(m_io);
+        if (m_io->mode() != Filesystem::IOProxy::Read) {
+            errorf("%s", m_io->error());
+            return false;
+        }
+    }
+
     // Quick check to immediately reject nonexistant or non-exr files.
     if (!m_io && !Filesystem::is_regular(name)) {
         errorf("Could not open file \"%s\"", name);
@@ -467,7 +440,7 @@ OpenEXRInput::open(const std::string& name, ImageSpec& newspec,
     // now that just reads from the file.
     try {
         if (!m_io) {
-            m_io = new Filesystem::IOFile(name, Filesystem::IOProxy::Read);
+            m_io = pvt::create_read_ioproxy(name);
             m_local_io.reset(m_io);
         }
         OIIO_ASSERT(m_io);
@@ -1598,6 +1571,7 @@ OpenEXRInput::read_native_deep_scanlines(int subimage, int miplevel, int ybegin,
         frameBuffer.insertSampleCountSlice(countslice);
 
         for (int c = chbegin; c < chend; ++c) {
+            size_t stride = deepdata.sample_stride(c - chbegin);
             Imf::DeepSlice slice(
                 part.pixeltype[c],
                 (char*)(&pointerbuf[0] + (c - chbegin) - m_spec.x * nchans
@@ -1605,7 +1579,7 @@ OpenEXRInput::read_native_deep_scanlines(int subimage, int miplevel, int ybegin,
                 sizeof(void*) * nchans,  // xstride of pointer array
                 sizeof(void*) * nchans
                     * m_spec.width,      // ystride of pointer array
-                deepdata.samplesize());  // stride of data sample
+                stride);                 // stride of data sample
             frameBuffer.insert(m_spec.channelnames[c].c_str(), slice);
         }
         m_deep_scanline_input_part->setFrameBuffer(frameBuffer);
@@ -1669,13 +1643,14 @@ OpenEXRInput::read_native_deep_tiles(int subimage, int miplevel, int xbegin,
             sizeof(unsigned int), sizeof(unsigned int) * width);
         frameBuffer.insertSampleCountSlice(countslice);
         for (int c = chbegin; c < chend; ++c) {
+            size_t stride = deepdata.sample_stride(c - chbegin);
             Imf::DeepSlice slice(
                 part.pixeltype[c],
                 (char*)(&pointerbuf[0] + (c - chbegin) - xbegin * nchans
                         - ybegin * width * nchans),
                 sizeof(void*) * nchans,          // xstride of pointer array
                 sizeof(void*) * nchans * width,  // ystride of pointer array
-                deepdata.samplesize());          // stride of data sample
+                stride);                         // stride of data sample
             frameBuffer.insert(m_spec.channelnames[c].c_str(), slice);
         }
         m_deep_tiled_input_part->setFrameBuffer(frameBuffer);
@@ -42,6 +42,7 @@ using boost::math::gcd;
 #    define OPENEXR_HAS_FLOATVECTOR 0
 #endif
 
+#include "exr_pvt.h"
 #include "imageio_pvt.h"
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/deepdata.h>
@@ -59,8 +60,191 @@ OIIO_PLUGIN_NAMESPACE_BEGIN
 struct oiioexr_filebuf_struct {
     ImageInput* m_img         = nullptr;
     Filesystem::IOProxy* m_io = nullptr;
+
+    // Chunks that have already been fetched by a batched read (see
+    // ExrChunkPrefetch), keyed by file offset, so that the read callback
+    // can hand them to the decoders without going back to the file.
+    struct Prefetched {
+        const uint8_t* data;
+        uint64_t size;
+    };
+    std::mutex m_prefetch_mutex;
+    std::map<uint64_t, Prefetched> m_prefetched;
+    std::atomic<int> m_nprefetched { 0 };
+
+    // If [offset,offset+sz) was prefetched, copy it to buffer and return
+    // true.
+    bool read_prefetched(void* buffer, uint64_t sz, uint64_t offset)
+    {
+        if (!m_nprefetched.load())
+            return false;
+        std::lock_guard<std::mutex> lock(m_prefetch_mutex);
+        auto found = m_prefetched.find(offset);
+        if (found == m_prefetched.end() || found->second.size < sz)
+            return false;
+        memcpy(buffer, found->second.data, sz);
+        return true;
+    }
+};
+
+
+
+// Gathers the locations of a set of chunks, fetches all of their packed
+// data with one IOProxy::pread_batch() call (which lets the proxy keep the
+// reads in flight together, e.g. with io_uring), and publishes it to the
+// read callback for as long as this object lives.
+class ExrChunkPrefetch {
+public:
+    ExrChunkPrefetch(oiioexr_filebuf_struct& fb)
+        : m_fb(fb)
+    {
+    }
+    ~ExrChunkPrefetch()
+    {
+        if (m_published.empty())
+            return;
+        std::lock_guard<std::mutex> lock(m_fb.m_prefetch_mutex);
+        for (auto offset : m_published)
+            m_fb.m_prefetched.erase(offset);
+        m_fb.m_nprefetched -= int(m_published.size());
+    }
+
+    void add(const exr_chunk_info_t& cinfo)
+    {
+        add_range(cinfo.data_offset, cinfo.packed_size);
+    }
+
+    // The sample count table of a deep chunk is stored (and read by the
+    // decoder) separately from its sample data.
+    void add_sample_counts(const exr_chunk_info_t& cinfo)
+    {
+        add_range(cinfo.sample_count_data_offset,
+                  cinfo.sample_count_table_size);
+    }
+
+    void fetch()
+    {
+        if (m_requests.size() < 2 || !m_fb.m_io)
+            return;  // Nothing to gain over the decoder's own read
+        m_buffer.reset(new uint8_t[m_total]);
+        uint8_t* ptr = m_buffer.get();
+        for (auto& r : m_requests) {
+            r.buf = ptr;
+            ptr += r.size;
+        }
+        m_fb.m_io->pread_batch(m_requests);
+        // Publish only what was read in full; anything else will be read
+        // (and its error reported) the ordinary way by the decoder.
+        std::lock_guard<std::mutex> lock(m_fb.m_prefetch_mutex);
+        for (auto& r : m_requests) {
+            if (r.result != r.size)
+                continue;
+            oiioexr_filebuf_struct::Prefetched pf { (const uint8_t*)r.buf,
+                                                    uint64_t(r.size) };
+            if (m_fb.m_prefetched.emplace(uint64_t(r.offset), pf).second)
+                m_published.push_back(uint64_t(r.offset));
+        }
+        m_fb.m_nprefetched += int(m_published.size());
+    }
+
+private:
+    void add_range(uint64_t offset, uint64_t size)
+    {
+        if (size == 0)
+            return;
+        Filesystem::IOProxy::ReadRequest r;
+        r.size   = size_t(size);
+        r.offset = int64_t(offset);
+        m_requests.push_back(r);
+        m_total += r.size;
+    }
+
+    oiioexr_filebuf_struct& m_fb;
+    std::vector<Filesystem::IOProxy::ReadRequest> m_requests;
+    std::vector<uint64_t> m_published;
+    std::unique_ptr<uint8_t[]> m_buffer;
+    size_t m_total = 0;
 };
 
+
+
+// Point the decoder's channels for [chbegin,chend) straight at their
+// interleaved positions in the destination buffer, so that the unpack step
+// writes the pixels where the caller wants them with no intermediate copy.
+static void
+bind_decode_channels(const ImageSpec& spec, int chbegin, int chend,
+                     exr_decode_pipeline_t& decoder, uint8_t* base,
+                     size_t pixelbytes, size_t linebytes)
+{
+    size_t chanoffset = 0;
+    for (int c = chbegin; c < chend; ++c) {
+        size_t chanbytes  = spec.channelformat(c).size();
+        string_view cname = spec.channel_name(c);
+        for (int dc = 0; dc < decoder.channel_count; ++dc) {
+            exr_coding_channel_info_t& curchan = decoder.channels[dc];
+            if (cname == curchan.channel_name) {
+                curchan.decode_to_ptr     = base + chanoffset;
+                curchan.user_pixel_stride = pixelbytes;
+                curchan.user_line_stride  = linebytes;
+                chanoffset += chanbytes;
+                break;
+            }
+        }
+    }
+}
+
+
+
+// How many chunks each decoding task should take on. Each task keeps one
+// decoder (and its scratch buffers) alive for its whole batch, so we want
+// few batches -- but a couple per thread, so that a slow chunk doesn't
+// leave the other threads idle at the end.
+static int64_t
+decode_batch_size(int64_t nchunks, int nthreads)
+{
+    if (nthreads <= 0)
+        nthreads = default_thread_pool()->size() + 1;
+    int64_t nbatches = std::max(int64_t(1), int64_t(2) * nthreads);
+    return std::max(int64_t(1), (nchunks + nbatches - 1) / nbatches);
+}
+
+
+
+// Run one chunk through a decoder that is reused across the chunks of a
+// batch: the first chunk initializes it, later ones only update the chunk
+// it points at, which keeps its allocations and avoids re-deriving the
+// channel list. A failed decoder is torn down so the next chunk will
+// start over with a fresh one.
+static exr_result_t
+run_reused_decoder(exr_const_context_t ctx, int subimage,
+                   const exr_chunk_info_t& cinfo, exr_decode_pipeline_t& decoder,
+                   bool& initialized, const ImageSpec& spec, int chbegin,
+                   int chend, uint8_t* base, size_t pixelbytes,
+                   size_t linebytes)
+{
+    exr_result_t rv;
+    if (!initialized)
+        rv = exr_decoding_initialize(ctx, subimage, &cinfo, &decoder);
+    else
+        rv = exr_decoding_update(ctx, subimage, &cinfo, &decoder);
+    initialized = (rv == EXR_ERR_SUCCESS);
+    if (rv == EXR_ERR_SUCCESS) {
+        bind_decode_channels(spec, chbegin, chend, decoder, base, pixelbytes,
+                             linebytes);
+        // The destination pointers (and for a short last chunk, the
+        // height) change from chunk to chunk, so let the library pick the
+        // unpacker again. This is cheap compared with the decode itself.
+        rv = exr_decoding_choose_default_routines(ctx, subimage, &decoder);
+    }
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_decoding_run(ctx, subimage, &decoder);
+    if (rv != EXR_ERR_SUCCESS && initialized) {
+        exr_decoding_destroy(ctx, &decoder);
+        initialized = false;
+    }
+    return rv;
+}
+
 static void
 oiio_exr_error_handler(exr_const_context_t ctxt, exr_result_t code,
                        const char* msg = nullptr)
@@ -88,6 +272,33 @@ oiio_exr_error_handler(exr_const_context_t ctxt, exr_result_t code,
     //          << std::endl;
 }
 
+// Allocator for the OpenEXR library's own memory for an open file -- its
+// headers, chunk tables, and decode buffers -- which counts it as
+// ImageInput codec memory. Each block is prefixed with its size, keeping
+// the 16 byte alignment of malloc.
+static constexpr size_t exr_alloc_prefix = 16;
+
+static void*
+oiio_exr_alloc_func(size_t bytes)
+{
+    char* mem = (char*)malloc(bytes + exr_alloc_prefix);
+    if (!mem)
+        return nullptr;
+    *(size_t*)mem = bytes;
+    pvt::imageinput_codec_mem += (long long)bytes;
+    return mem + exr_alloc_prefix;
+}
+
+static void
+oiio_exr_free_func(void* ptr)
+{
+    if (!ptr)
+        return;
+    char* mem = (char*)ptr - exr_alloc_prefix;
+    pvt::imageinput_codec_mem -= (long long)*(size_t*)mem;
+    free(mem);
+}
+
 static int64_t
 oiio_exr_query_size_func(exr_const_context_t ctxt, void* userdata)
 {
@@ -106,7 +317,9 @@ oiio_exr_read_func(exr_const_context_t ctxt, void* userdata, void* buffer,
     int64_t nread              = -1;
     if (fb) {
         Filesystem::IOProxy* io = fb->m_io;
-        if (io) {
+        if (fb->read_prefetched(buffer, sz, offset)) {
+            nread = static_cast<int64_t>(sz);
+        } else if (io) {
             size_t retval = io->pread(buffer, sz, offset);
             if (retval != size_t(-1)) {
                 nread = static_cast<int64_t>(retval);
@@ -122,7 +335,7 @@ oiio_exr_read_func(exr_const_context_t ctxt, void* userdata, void* buffer,
     return nread;
 }
 
-class OpenEXRCoreInput final : public ImageInput {
+class OpenEXRCoreInput final : public ImageInput, public OpenEXRRawSource {
 public:
     OpenEXRCoreInput();
     virtual ~OpenEXRCoreInput() { close(); }
@@ -132,7 +345,8 @@ public:
         return (feature == "arbitrary_metadata"
                 || feature == "exif"  // Because of arbitrary_metadata
                 || feature == "iptc"  // Because of arbitrary_metadata
-                || feature == "ioproxy");
+                || feature == "ioproxy"
+                || feature == "concurrent_subimages");
     }
     virtual bool valid_file(const std::string& filename) const override;
     virtual bool open(const std::string& name, ImageSpec& newspec,
@@ -178,6 +392,10 @@ public:
         m_userdata.m_io = ioproxy;
         return true;
     }
+    virtual Filesystem::IOProxy* raw_ioproxy() override
+    {
+        return m_userdata.m_io;
+    }
 
 private:
     const ImageSpec& init_part(int subimage, int miplevel);
@@ -248,10 +466,12 @@ private:
 
     bool valid_file(const std::string& filename, Filesystem::IOProxy* io) const;
 
-    // Fill in with 'missing' color/pattern.
-    bool check_fill_missing(int xbegin, int xend, int ybegin, int yend,
-                            int zbegin, int zend, int chbegin, int chend,
-                            void* data, stride_t xstride, stride_t ystride);
+    // Fill in with 'missing' color/pattern. The spec is that of the part
+    // being read (not m_spec, which another thread may be seeking).
+    bool check_fill_missing(const ImageSpec& spec, int xbegin, int xend,
+                            int ybegin, int yend, int zbegin, int zend,
+                            int chbegin, int chend, void* data,
+                            stride_t xstride, stride_t ystride);
 
     // Helper struct to destroy decoder upon scope exit
     class DecoderDestroyer {
@@ -363,8 +583,7 @@ OpenEXRCoreInput::valid_file(const std::string& filename,
     // do we always want this?
     std::unique_ptr<Filesystem::IOProxy> localio;
     if (!io) {
-        localio.reset(
-            new Filesystem::IOFile(filename, Filesystem::IOProxy::Read));
+        localio.reset(pvt::create_read_ioproxy(filename));
         io = localio.get();
     }
 
@@ -433,10 +652,9 @@ OpenEXRCoreInput::open(const std::string& name, ImageSpec& newspec,
     m_spec = ImageSpec();
 
     // Establish an input stream. If we weren't given an IOProxy, create one
-    // now that just reads from the file.
+    // now that just reads from the file (or remote URL).
     if (!m_userdata.m_io) {
-        m_userdata.m_io = new Filesystem::IOFile(name,
-                                                 Filesystem::IOProxy::Read);
+        m_userdata.m_io = pvt::create_read_ioproxy(name);
         m_local_io.reset(m_userdata.m_io);
     }
     if (m_userdata.m_io->mode() != Filesystem::IOProxy::Read) {
@@ -453,6 +671,8 @@ OpenEXRCoreInput::open(const std::string& name, ImageSpec& newspec,
     exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
 
     cinit.error_handler_fn = &oiio_exr_error_handler;
+    cinit.alloc_fn         = &oiio_exr_alloc_func;
+    cinit.free_fn          = &oiio_exr_free_func;
     cinit.user_data        = &m_userdata;
     if (m_userdata.m_io) {
         cinit.read_fn = &oiio_exr_read_func;
@@ -1251,75 +1471,67 @@ OpenEXRCoreInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
     yend            = std::min(endy, yend);
     int ychunkstart = spec.y
                       + round_down_to_multiple(ybegin - spec.y, scansperchunk);
+
+    // Look up all the chunks first and fetch their data in one batch,
+    // rather than having each decoder issue its own small read.
+    int nchunks = (yend - ychunkstart + scansperchunk - 1) / scansperchunk;
+    std::vector<exr_chunk_info_t> cinfos(std::max(nchunks, 0));
+    std::vector<exr_result_t> cinfo_rv(cinfos.size(), EXR_ERR_SUCCESS);
+    ExrChunkPrefetch prefetch(m_userdata);
+    for (int c = 0; c < nchunks; ++c) {
+        cinfo_rv[c] = exr_read_scanline_chunk_info(m_exr_context, subimage,
+                                                   ychunkstart
+                                                       + c * scansperchunk,
+                                                   &cinfos[c]);
+        if (cinfo_rv[c] == EXR_ERR_SUCCESS)
+            prefetch.add(cinfos[c]);
+    }
+    prefetch.fetch();
+
+    // Each task decodes a contiguous batch of chunks with a single decoder.
+    // Chunks that lie wholly inside [ybegin,yend) -- or that run off the end
+    // of the image, which the decoder clips itself -- are unpacked directly
+    // into the caller's buffer; only the partial chunks at either end of
+    // the range go through a scratch buffer.
     std::atomic<bool> ok(true);
     parallel_for_chunked(
-        ychunkstart, yend, scansperchunk,
-        [&](int64_t yb, int64_t ye) {
-            int y             = std::max(int(yb), ybegin);
-            uint8_t* linedata = static_cast<uint8_t*>(data)
-                                + scanlinebytes * (y - ybegin);
-            std::unique_ptr<uint8_t> fullchunk;
-            int nlines = scansperchunk;
-            exr_chunk_info_t cinfo;
+        0, nchunks, decode_batch_size(nchunks, threads()),
+        [&](int64_t cbegin, int64_t cend) {
             exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
             DecoderDestroyer dd(m_exr_context, &decoder);
             // Note: the decoder will be destroyed by dd exiting scope
-            uint8_t* cdata = linedata;
-            // handle scenario where caller asked us to read a scanline
-            // that isn't aligned to a chunk boundary
-            int invalid = (y - spec.y) % scansperchunk;
-            if (invalid != 0) {
-                // Our first scanline, ybegin, is not on a chunk boundary.
-                // We'll need to "back up" and read a whole chunk.
-                fullchunk.reset(new uint8_t[scanlinebytes * scansperchunk]);
-                nlines = scansperchunk - invalid;
-                cdata  = fullchunk.get();
-                y      = y - invalid;
-            } else if ((y + scansperchunk) > yend && yend < endy) {
-                // ybegin is at a chunk boundary, but yend is not (and isn't
-                // the special case of it encompassing the end of the image,
-                // which is not at a chunk boundary). We'll need to read a
-                // full chunk and use only part of it.
-                fullchunk.reset(new uint8_t[scanlinebytes * scansperchunk]);
-                nlines = yend - y;
-                cdata  = fullchunk.get();
-            } else {
-                // We need a full aligned chunk. Everything is already set up.
-            }
-            exr_result_t rv = exr_read_scanline_chunk_info(m_exr_context,
-                                                           subimage, y, &cinfo);
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_initialize(m_exr_context, subimage, &cinfo,
-                                             &decoder);
-            if (rv == EXR_ERR_SUCCESS) {
-                size_t chanoffset = 0;
-                for (int c = chbegin; c < chend; ++c) {
-                    size_t chanbytes  = spec.channelformat(c).size();
-                    string_view cname = spec.channel_name(c);
-                    for (int dc = 0; dc < decoder.channel_count; ++dc) {
-                        exr_coding_channel_info_t& curchan
-                            = decoder.channels[dc];
-                        if (cname == curchan.channel_name) {
-                            curchan.decode_to_ptr     = cdata + chanoffset;
-                            curchan.user_pixel_stride = pixelbytes;
-                            curchan.user_line_stride  = scanlinebytes;
-                            chanoffset += chanbytes;
-                            break;
-                        }
-                    }
+            bool initialized = false;
+            std::unique_ptr<uint8_t[]> fullchunk;
+            for (int64_t chunk = cbegin; chunk < cend; ++chunk) {
+                int y       = ychunkstart + int(chunk) * scansperchunk;
+                int first   = std::max(y, ybegin);
+                int last    = std::min(y + scansperchunk, yend);
+                bool direct = (y >= ybegin
+                               && (y + scansperchunk <= yend || yend >= endy));
+                uint8_t* cdata;
+                if (direct) {
+                    cdata = static_cast<uint8_t*>(data)
+                            + scanlinebytes * (y - ybegin);
+                } else {
+                    if (!fullchunk)
+                        fullchunk.reset(
+                            new uint8_t[scanlinebytes * scansperchunk]);
+                    cdata = fullchunk.get();
+                }
+                exr_result_t rv = cinfo_rv[chunk];
+                if (rv == EXR_ERR_SUCCESS)
+                    rv = run_reused_decoder(m_exr_context, subimage,
+                                            cinfos[chunk], decoder,
+                                            initialized, spec, chbegin, chend,
+                                            cdata, pixelbytes, scanlinebytes);
+                if (rv != EXR_ERR_SUCCESS) {
+                    ok = false;
+                } else if (!direct) {
+                    memcpy(static_cast<uint8_t*>(data)
+                               + scanlinebytes * (first - ybegin),
+                           cdata + scanlinebytes * (first - y),
+                           scanlinebytes * (last - first));
                 }
-                rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                          subimage, &decoder);
-            }
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_run(m_exr_context, subimage, &decoder);
-            if (rv != EXR_ERR_SUCCESS) {
-                ok = false;
-            } else if (cdata != linedata) {
-                y += invalid;
-                nlines = std::min(nlines, yend - y);
-                memcpy(linedata, cdata + invalid * scanlinebytes,
-                       nlines * scanlinebytes);
             }
         },
         threads());
@@ -1394,9 +1606,9 @@ OpenEXRCoreInput::read_native_tile(int subimage, int miplevel, int x, int y,
     rv = exr_get_level_sizes(m_exr_context, subimage, miplevel, miplevel, &levw,
                              &levh);
     if (rv != EXR_ERR_SUCCESS)
-        return check_fill_missing(x, x + tilew, y, y + tileh, z, z + spec.depth,
-                                  0, spec.nchannels, data, pixelbytes,
-                                  scanlinebytes);
+        return check_fill_missing(spec, x, x + tilew, y, y + tileh, z,
+                                  z + spec.depth, 0, spec.nchannels, data,
+                                  pixelbytes, scanlinebytes);
 
     exr_chunk_info_t cinfo;
     exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
@@ -1408,7 +1620,7 @@ OpenEXRCoreInput::read_native_tile(int subimage, int miplevel, int x, int y,
     if (rv == EXR_ERR_SUCCESS)
         rv = exr_decoding_initialize(m_exr_context, subimage, &cinfo, &decoder);
     if (rv != EXR_ERR_SUCCESS) {
-        return check_fill_missing(x, std::min(levw, x + tilew), y,
+        return check_fill_missing(spec, x, std::min(levw, x + tilew), y,
                                   std::min(levh, y + tileh), z, z + spec.depth,
                                   0, spec.nchannels, data, pixelbytes,
                                   scanlinebytes);
@@ -1450,7 +1662,7 @@ OpenEXRCoreInput::read_native_tile(int subimage, int miplevel, int x, int y,
     if (rv == EXR_ERR_SUCCESS)
         rv = exr_decoding_run(m_exr_context, subimage, &decoder);
     if (rv != EXR_ERR_SUCCESS) {
-        return check_fill_missing(x, std::min(levw, x + tilew), y,
+        return check_fill_missing(spec, x, std::min(levw, x + tilew), y,
                                   std::min(levh, y + tileh), z, z + spec.depth,
                                   0, spec.nchannels, data, pixelbytes,
                                   scanlinebytes);
@@ -1507,8 +1719,8 @@ OpenEXRCoreInput::read_native_tiles(int subimage, int miplevel, int xbegin,
     exr_result_t rv = exr_get_level_sizes(m_exr_context, subimage, miplevel,
                                           miplevel, &levw, &levh);
     if (rv != EXR_ERR_SUCCESS)
-        return check_fill_missing(xbegin, xend, ybegin, yend, zbegin, zend,
-                                  chbegin, chend, data, pixelbytes,
+        return check_fill_missing(spec, xbegin, xend, ybegin, yend, zbegin,
+                                  zend, chbegin, chend, data, pixelbytes,
                                   size_t(tilew) * pixelbytes
                                       * size_t((xend - xbegin + tilew - 1)
                                                / tilew));
@@ -1535,56 +1747,57 @@ OpenEXRCoreInput::read_native_tiles(int subimage, int miplevel, int xbegin,
     }
 #endif
 
+    // Look up all the tiles first and fetch their data in one batch,
+    // rather than having each decoder issue its own small read.
+    std::vector<exr_chunk_info_t> cinfos(size_t(std::max(nxtiles, 0))
+                                         * size_t(std::max(nytiles, 0)));
+    std::vector<exr_result_t> cinfo_rv(cinfos.size(), EXR_ERR_SUCCESS);
+    ExrChunkPrefetch prefetch(m_userdata);
+    for (int ty = 0; ty < nytiles; ++ty) {
+        for (int tx = 0; tx < nxtiles; ++tx) {
+            size_t t    = size_t(ty) * nxtiles + tx;
+            cinfo_rv[t] = exr_read_tile_chunk_info(m_exr_context, subimage,
+                                                   firstxtile + tx,
+                                                   firstytile + ty, miplevel,
+                                                   miplevel, &cinfos[t]);
+            if (cinfo_rv[t] == EXR_ERR_SUCCESS)
+                prefetch.add(cinfos[t]);
+        }
+    }
+    prefetch.fetch();
+
+    // As with scanlines, each task decodes a batch of tiles with a single
+    // decoder, unpacking each one in place in the caller's buffer.
     std::atomic<bool> ok(true);
-    parallel_for_2D(
-        0, nxtiles, 0, nytiles,
-        [&](int64_t tx, int64_t ty) {
-            int curytile         = firstytile + ty;
-            int curxtile         = firstxtile + tx;
-            uint8_t* tilesetdata = static_cast<uint8_t*>(data);
-            tilesetdata += ty * tileh * scanlinebytes;
-            exr_chunk_info_t cinfo;
+    int64_t ntiles = int64_t(cinfos.size());
+    parallel_for_chunked(
+        0, ntiles, decode_batch_size(ntiles, threads()),
+        [&](int64_t tbegin, int64_t tend) {
             exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
             DecoderDestroyer dd(m_exr_context, &decoder);
             // Note: the decoder will be destroyed by dd exiting scope
-            uint8_t* curtilestart = tilesetdata + tx * tilew * pixelbytes;
-            exr_result_t rv = exr_read_tile_chunk_info(m_exr_context, subimage,
-                                                       curxtile, curytile,
-                                                       miplevel, miplevel,
-                                                       &cinfo);
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_initialize(m_exr_context, subimage, &cinfo,
-                                             &decoder);
-            if (rv == EXR_ERR_SUCCESS) {
-                size_t chanoffset = 0;
-                for (int c = chbegin; c < chend; ++c) {
-                    size_t chanbytes  = spec.channelformat(c).size();
-                    string_view cname = spec.channel_name(c);
-                    for (int dc = 0; dc < decoder.channel_count; ++dc) {
-                        exr_coding_channel_info_t& curchan
-                            = decoder.channels[dc];
-                        if (cname == curchan.channel_name) {
-                            curchan.decode_to_ptr = curtilestart + chanoffset;
-                            curchan.user_pixel_stride = pixelbytes;
-                            curchan.user_line_stride  = scanlinebytes;
-                            chanoffset += chanbytes;
-                            break;
-                        }
-                    }
+            bool initialized = false;
+            for (int64_t t = tbegin; t < tend; ++t) {
+                int tx = int(t % nxtiles);
+                int ty = int(t / nxtiles);
+                uint8_t* curtilestart = static_cast<uint8_t*>(data)
+                                        + ty * tileh * scanlinebytes
+                                        + tx * tilew * pixelbytes;
+                exr_result_t rv = cinfo_rv[t];
+                if (rv == EXR_ERR_SUCCESS)
+                    rv = run_reused_decoder(m_exr_context, subimage, cinfos[t],
+                                            decoder, initialized, spec,
+                                            chbegin, chend, curtilestart,
+                                            pixelbytes, scanlinebytes);
+                if (rv != EXR_ERR_SUCCESS
+                    && !check_fill_missing(spec, xbegin + tx * tilew,
+                                           xbegin + (tx + 1) * tilew,
+                                           ybegin + ty * tileh,
+                                           ybegin + (ty + 1) * tileh, zbegin,
+                                           zend, chbegin, chend, curtilestart,
+                                           pixelbytes, scanlinebytes)) {
+                    ok = false;
                 }
-                rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                          subimage, &decoder);
-            }
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_run(m_exr_context, subimage, &decoder);
-            if (rv != EXR_ERR_SUCCESS
-                && !check_fill_missing(xbegin + tx * tilew,
-                                       xbegin + (tx + 1) * tilew,
-                                       ybegin + ty * tileh,
-                                       ybegin + (ty + 1) * tileh, zbegin, zend,
-                                       chbegin, chend, curtilestart, pixelbytes,
-                                       scanlinebytes)) {
-                ok = false;
             }
         },
         threads());
@@ -1604,7 +1817,8 @@ OpenEXRCoreInput::read_native_tiles(int subimage, int miplevel, int xbegin,
 
 
 bool
-OpenEXRCoreInput::check_fill_missing(int xbegin, int xend, int ybegin, int yend,
+OpenEXRCoreInput::check_fill_missing(const ImageSpec& spec, int xbegin,
+                                     int xend, int ybegin, int yend,
                                      int /*zbegin*/, int /*zend*/, int chbegin,
                                      int chend, void* data, stride_t xstride,
                                      stride_t ystride)
@@ -1624,7 +1838,7 @@ OpenEXRCoreInput::check_fill_missing(int xbegin, int xend, int ybegin, int yend,
                 float v = missingcolor[ch];
                 if (stripe && ((x - y) & 8))
                     v = 0.0f;
-                TypeDesc cf = m_spec.channelformat(ch);
+                TypeDesc cf = spec.channelformat(ch);
                 if (cf == TypeFloat)
                     *(float*)d = v;
                 else if (cf == TypeHalf)
@@ -1645,9 +1859,10 @@ struct deepdecode_userdata {
     size_t xoff;
     const ImageSpec* spec;
     DeepData* deepdata;
-    std::vector<void*> linepointers;
+    // Pointers to the first sample of each pixel and channel of the whole
+    // DeepData, shared (read-only) by all the decoders.
+    std::vector<void*>* pointers;
     bool firstisfullread;
-    bool samplesset;
 };
 
 static exr_result_t
@@ -1656,44 +1871,27 @@ realloc_deepdata(exr_decode_pipeline_t* decode)
     deepdecode_userdata* ud = static_cast<deepdecode_userdata*>(
         decode->decoding_user_data);
 
-    // TODO: In order to read an entire image in, this is not as
-    // efficient as it will cause a number of re-allocations. But
-    // hopefully people are asking for an individual scanline at a
-    // time.
     int w            = decode->chunk.width;
     int h            = decode->chunk.height;
     int chans        = ud->nchans;
     size_t fullwidth = ud->fullwidth;
-    size_t xoff      = ud->xoff;
-    ud->linepointers.resize(w * h * chans);
     if (ud->firstisfullread) {
+        // Reading just this one chunk, so we only now learn the sample
+        // counts.
         ud->deepdata->set_all_samples(
             cspan<unsigned int>((const uint32_t*)decode->sample_count_table,
                                 (const uint32_t*)decode->sample_count_table
                                     + w * h));
-        ud->deepdata->get_pointers(ud->linepointers);
-    } else {
-        // this is super slow, read the sample counts up front and set the counts once
-        // unless that is hard...
-        if (!ud->samplesset) {
-            for (int y = 0; y < h; ++y)
-                for (int x = 0; x < w; ++x)
-                    ud->deepdata->set_samples(
-                        (y + ud->cury) * fullwidth + xoff + x,
-                        decode->sample_count_table[y * w + x]);
-        }
-        for (int y = 0; y < h; ++y)
-            for (int x = 0; x < w; ++x)
-                for (int c = 0; c < chans; ++c)
-                    ud->linepointers[(y * w + x) * chans + c]
-                        = ud->deepdata->data_ptr((y + ud->cury) * fullwidth
-                                                     + xoff + x,
-                                                 c, 0);
+        ud->deepdata->get_pointers(*ud->pointers);
     }
+    // Otherwise the counts were all set, the DeepData allocated, and the
+    // pointers found before any sample data was decoded, so all that's left
+    // is to aim the decoder at this chunk's part of the pointer table.
 
     const ImageSpec& spec = *(ud->spec);
     size_t chanoffset     = 0;
-    void** cdata          = &(ud->linepointers[0]);
+    void** cdata          = ud->pointers->data()
+                   + (size_t(ud->cury) * fullwidth + ud->xoff) * chans;
     for (int c = ud->chbegin; c < ud->chend; ++c) {
         string_view cname = spec.channel_name(c);
         for (int dc = 0; dc < decode->channel_count; ++dc) {
@@ -1702,9 +1900,10 @@ realloc_deepdata(exr_decode_pipeline_t* decode)
             if (cname == curchan.channel_name) {
                 curchan.decode_to_ptr = reinterpret_cast<uint8_t*>(
                     cdata + chanoffset);
-                curchan.user_bytes_per_element = ud->deepdata->samplesize();
+                curchan.user_bytes_per_element = ud->deepdata->sample_stride(
+                    c - ud->chbegin);
                 curchan.user_pixel_stride      = size_t(chans) * sizeof(void*);
-                curchan.user_line_stride       = (size_t(w) * size_t(chans)
+                curchan.user_line_stride       = (fullwidth * size_t(chans)
                                             * sizeof(void*));
                 chanoffset += 1;
                 break;
@@ -1715,6 +1914,122 @@ realloc_deepdata(exr_decode_pipeline_t* decode)
 }
 
 
+
+// Decode the sample count tables of the given deep chunks (in parallel,
+// and without touching their sample data), copying each into its place in
+// all_samples. The chunk for index i is placed by place(i, cinfo), which
+// returns the offset of its first pixel in all_samples and the row stride.
+template<typename PLACE>
+static bool
+decode_deep_sample_counts(exr_const_context_t ctx, int subimage,
+                          const std::vector<exr_chunk_info_t>& cinfos,
+                          const std::vector<exr_result_t>& cinfo_rv,
+                          std::vector<uint32_t>& all_samples, int nthreads,
+                          PLACE place)
+{
+    std::atomic<bool> ok(true);
+    int64_t nchunks = int64_t(cinfos.size());
+    parallel_for_chunked(
+        0, nchunks, decode_batch_size(nchunks, nthreads),
+        [&](int64_t cbegin, int64_t cend) {
+            exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+            bool initialized              = false;
+            for (int64_t i = cbegin; i < cend && ok; ++i) {
+                const exr_chunk_info_t& cinfo = cinfos[i];
+                exr_result_t rv               = cinfo_rv[i];
+                if (rv == EXR_ERR_SUCCESS) {
+                    if (!initialized) {
+                        rv = exr_decoding_initialize(ctx, subimage, &cinfo,
+                                                     &decoder);
+                        initialized = (rv == EXR_ERR_SUCCESS);
+                        decoder.decode_flags
+                            |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
+                                | EXR_DECODE_SAMPLE_DATA_ONLY);
+                        if (rv == EXR_ERR_SUCCESS)
+                            rv = exr_decoding_choose_default_routines(
+                                ctx, subimage, &decoder);
+                    } else {
+                        rv = exr_decoding_update(ctx, subimage, &cinfo,
+                                                 &decoder);
+                    }
+                }
+                if (rv == EXR_ERR_SUCCESS)
+                    rv = exr_decoding_run(ctx, subimage, &decoder);
+                if (rv != EXR_ERR_SUCCESS) {
+                    ok = false;
+                    break;
+                }
+                std::pair<size_t, size_t> where = place(i, cinfo);
+                for (int y = 0; y < cinfo.height; ++y)
+                    memcpy(all_samples.data() + where.first + y * where.second,
+                           decoder.sample_count_table + y * cinfo.width,
+                           cinfo.width * sizeof(uint32_t));
+            }
+            if (initialized)
+                exr_decoding_destroy(ctx, &decoder);
+        },
+        nthreads);
+    return ok;
+}
+
+
+
+// Decode the sample data of the given deep chunks in parallel, straight
+// into the DeepData by way of the pointer table in ud. The chunk for index
+// i is placed by setup(i, myud), which sets the chunk's position in the
+// DeepData.
+template<typename SETUP>
+static bool
+decode_deep_sample_data(exr_const_context_t ctx, int subimage,
+                        const std::vector<exr_chunk_info_t>& cinfos,
+                        const std::vector<exr_result_t>& cinfo_rv,
+                        const deepdecode_userdata& ud, int nthreads,
+                        SETUP setup)
+{
+    std::atomic<bool> ok(true);
+    int64_t nchunks = int64_t(cinfos.size());
+    parallel_for_chunked(
+        0, nchunks, decode_batch_size(nchunks, nthreads),
+        [&](int64_t cbegin, int64_t cend) {
+            deepdecode_userdata myud      = ud;
+            exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
+            bool initialized              = false;
+            for (int64_t i = cbegin; i < cend && ok; ++i) {
+                setup(i, myud);
+                const exr_chunk_info_t& cinfo = cinfos[i];
+                exr_result_t rv               = cinfo_rv[i];
+                if (rv == EXR_ERR_SUCCESS) {
+                    if (!initialized) {
+                        rv = exr_decoding_initialize(ctx, subimage, &cinfo,
+                                                     &decoder);
+                        initialized = (rv == EXR_ERR_SUCCESS);
+                        decoder.decode_flags
+                            |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
+                                | EXR_DECODE_NON_IMAGE_DATA_AS_POINTERS);
+                        decoder.decoding_user_data       = &myud;
+                        decoder.realloc_nonimage_data_fn = &realloc_deepdata;
+                        if (rv == EXR_ERR_SUCCESS)
+                            rv = exr_decoding_choose_default_routines(
+                                ctx, subimage, &decoder);
+                    } else {
+                        rv = exr_decoding_update(ctx, subimage, &cinfo,
+                                                 &decoder);
+                    }
+                }
+                if (rv == EXR_ERR_SUCCESS)
+                    rv = exr_decoding_run(ctx, subimage, &decoder);
+                if (rv != EXR_ERR_SUCCESS)
+                    ok = false;
+            }
+            if (initialized)
+                exr_decoding_destroy(ctx, &decoder);
+        },
+        nthreads);
+    return ok;
+}
+
+
+
 bool
 OpenEXRCoreInput::read_native_deep_scanlines(int subimage, int miplevel,
                                              int ybegin, int yend, int /*z*/,
@@ -1743,16 +2058,17 @@ OpenEXRCoreInput::read_native_deep_scanlines(int subimage, int miplevel,
                   cspan<TypeDesc>(&channeltypes[chbegin], nchans),
                   spec.channelnames);
 
+    std::vector<void*> pointers;
     deepdecode_userdata ud;
-    ud.cury       = 0;
-    ud.nchans     = nchans;
-    ud.chbegin    = chbegin;
-    ud.chend      = chend;
-    ud.spec       = &spec;
-    ud.fullwidth  = spec.width;
-    ud.xoff       = 0;
-    ud.deepdata   = &deepdata;
-    ud.samplesset = false;
+    ud.cury     = 0;
+    ud.nchans   = nchans;
+    ud.chbegin  = chbegin;
+    ud.chend    = chend;
+    ud.spec     = &spec;
+    ud.fullwidth = spec.width;
+    ud.xoff     = 0;
+    ud.deepdata = &deepdata;
+    ud.pointers = &pointers;
 
     int32_t scansperchunk;
     exr_result_t rv = exr_get_scanlines_per_chunk(m_exr_context, subimage,
@@ -1765,112 +2081,58 @@ OpenEXRCoreInput::read_native_deep_scanlines(int subimage, int miplevel,
         return false;
     }
 
-    std::atomic<bool> ok(true);
+    // Look up all the chunks first, so that both passes below can fetch
+    // what they need from the file in one batch.
+    int nchunks = std::max(yend - ybegin, 0);
+    std::vector<exr_chunk_info_t> cinfos(nchunks);
+    std::vector<exr_result_t> cinfo_rv(nchunks, EXR_ERR_SUCCESS);
+    for (int c = 0; c < nchunks; ++c)
+        cinfo_rv[c] = exr_read_scanline_chunk_info(m_exr_context, subimage,
+                                                   ybegin + c, &cinfos[c]);
+
     ud.firstisfullread = (yend - ybegin) == scansperchunk;
-    // it is very slow to update the number of samples one at a time, so when not
-    // only reading one line, make a pass and load all the sample counts
+    // It is very slow to grow the DeepData a pixel at a time, so when
+    // reading more than one chunk, first decode just the sample counts of
+    // all of them, so that the DeepData can be allocated once, with every
+    // pixel's place in it known before any sample data is decoded.
     if (!ud.firstisfullread) {
-        std::vector<unsigned int> all_samples(npixels);
-        parallel_for_chunked(
-            ybegin, yend, 16,
-            [&](int64_t yb, int64_t ye) {
-                exr_chunk_info_t cinfo;
-                exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
-                DecoderDestroyer dd(m_exr_context, &decoder);
-                // Note: the decoder will be destroyed by dd exiting scope
-                exr_result_t rv = EXR_ERR_SUCCESS;
-                bool first      = true;
-                for (int y = yb; y < ye; ++y) {
-                    rv = exr_read_scanline_chunk_info(m_exr_context, subimage,
-                                                      y, &cinfo);
-                    if (rv != EXR_ERR_SUCCESS)
-                        break;
-                    if (first) {
-                        rv = exr_decoding_initialize(m_exr_context, subimage,
-                                                     &cinfo, &decoder);
-                        decoder.decode_flags
-                            |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
-                                | EXR_DECODE_SAMPLE_DATA_ONLY);
-                    } else {
-                        rv = exr_decoding_update(m_exr_context, subimage,
-                                                 &cinfo, &decoder);
-                    }
-                    if (rv != EXR_ERR_SUCCESS)
-                        break;
-                    if (first) {
-                        rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                                  subimage,
-                                                                  &decoder);
-                        if (rv != EXR_ERR_SUCCESS)
-                            break;
-                    }
-                    first = false;
-                    rv    = exr_decoding_run(m_exr_context, subimage, &decoder);
-                    if (rv != EXR_ERR_SUCCESS)
-                        break;
-                    memcpy(all_samples.data() + (y - ybegin) * ud.fullwidth,
-                           decoder.sample_count_table,
-                           scansperchunk * ud.fullwidth * sizeof(uint32_t));
-                }
-                if (rv != EXR_ERR_SUCCESS)
-                    ok = false;
-            },
-            threads());
+        std::vector<uint32_t> all_samples(npixels);
+        bool ok;
+        {
+            ExrChunkPrefetch prefetch(m_userdata);
+            for (int c = 0; c < nchunks; ++c)
+                if (cinfo_rv[c] == EXR_ERR_SUCCESS)
+                    prefetch.add_sample_counts(cinfos[c]);
+            prefetch.fetch();
+            ok = decode_deep_sample_counts(
+                m_exr_context, subimage, cinfos, cinfo_rv, all_samples,
+                threads(), [&](int64_t c, const exr_chunk_info_t&) {
+                    return std::make_pair(size_t(c) * spec.width,
+                                          size_t(spec.width));
+                });
+        }
         if (!ok) {
             geterror(true);  // clear the error, issue our own
             errorfmt("Some scanline chunks were missing or corrupted");
             return false;
         }
         deepdata.set_all_samples(all_samples);
-        ud.samplesset = true;
+        deepdata.get_pointers(pointers);  // allocates, once
     }
 
-    parallel_for_chunked(
-        ybegin, yend, 16,
-        [&](int64_t yb, int64_t ye) {
-            bool first                    = true;
-            deepdecode_userdata myud      = ud;
-            exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
-            DecoderDestroyer dd(m_exr_context, &decoder);
-            exr_result_t rv = EXR_ERR_SUCCESS;
-            for (int y = yb; y < ye; ++y) {
-                myud.cury = y - ybegin;
-                exr_chunk_info_t cinfo;
-                rv = exr_read_scanline_chunk_info(m_exr_context, subimage, y,
-                                                  &cinfo);
-                if (rv != EXR_ERR_SUCCESS)
-                    break;
-                if (first) {
-                    rv = exr_decoding_initialize(m_exr_context, subimage,
-                                                 &cinfo, &decoder);
-                    decoder.decode_flags
-                        |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
-                            | EXR_DECODE_NON_IMAGE_DATA_AS_POINTERS);
-                    decoder.decoding_user_data       = &myud;
-                    decoder.realloc_nonimage_data_fn = &realloc_deepdata;
-                } else {
-                    rv = exr_decoding_update(m_exr_context, subimage, &cinfo,
-                                             &decoder);
-                }
-                if (rv != EXR_ERR_SUCCESS)
-                    break;
-                if (first) {
-                    rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                              subimage,
-                                                              &decoder);
-                    if (rv != EXR_ERR_SUCCESS)
-                        break;
-                }
-                rv = exr_decoding_run(m_exr_context, subimage, &decoder);
-                if (rv != EXR_ERR_SUCCESS)
-                    break;
-                first = false;
-            }
-            if (rv != EXR_ERR_SUCCESS)
-                ok = false;
-        },
-        threads());
-
+    ExrChunkPrefetch prefetch(m_userdata);
+    for (int c = 0; c < nchunks; ++c) {
+        if (cinfo_rv[c] == EXR_ERR_SUCCESS) {
+            prefetch.add_sample_counts(cinfos[c]);
+            prefetch.add(cinfos[c]);
+        }
+    }
+    prefetch.fetch();
+    bool ok = decode_deep_sample_data(m_exr_context, subimage, cinfos,
+                                      cinfo_rv, ud, threads(),
+                                      [&](int64_t c, deepdecode_userdata& u) {
+                                          u.cury = int(c);
+                                      });
     if (!ok) {
         geterror(true);  // clear the error, issue our own
         errorfmt("Some scanline chunks were missing or corrupted");
@@ -1931,6 +2193,7 @@ OpenEXRCoreInput::read_native_deep_tiles(int subimage, int miplevel, int xbegin,
                   cspan<TypeDesc>(&channeltypes[chbegin], nchans),
                   spec.channelnames);
 
+    std::vector<void*> pointers;
     deepdecode_userdata ud;
     ud.cury            = 0;
     ud.nchans          = nchans;
@@ -1940,93 +2203,65 @@ OpenEXRCoreInput::read_native_deep_tiles(int subimage, int miplevel, int xbegin,
     ud.fullwidth       = width;
     ud.xoff            = 0;
     ud.deepdata        = &deepdata;
+    ud.pointers        = &pointers;
     ud.firstisfullread = nxtiles == 1 && nytiles == 1;
-    ud.samplesset      = false;
-
-    std::atomic<bool> ok(true);
 
-    // it is very slow to update the number of samples one at a time, so when not
-    // only reading one line, make a pass and load all the sample counts
+    // Look up all the tiles first, so that both passes below can fetch
+    // what they need from the file in one batch.
+    size_t ntiles = size_t(std::max(nxtiles, 0)) * size_t(std::max(nytiles, 0));
+    std::vector<exr_chunk_info_t> cinfos(ntiles);
+    std::vector<exr_result_t> cinfo_rv(ntiles, EXR_ERR_SUCCESS);
+    for (size_t t = 0; t < ntiles; ++t)
+        cinfo_rv[t] = exr_read_tile_chunk_info(m_exr_context, subimage,
+                                               firstxtile + int(t % nxtiles),
+                                               firstytile + int(t / nxtiles),
+                                               miplevel, miplevel,
+                                               &cinfos[t]);
+
+    // It is very slow to grow the DeepData a pixel at a time, so when
+    // reading more than one tile, first decode just the sample counts of
+    // all of them, so that the DeepData can be allocated once, with every
+    // pixel's place in it known before any sample data is decoded.
     if (!ud.firstisfullread) {
         std::vector<uint32_t> all_samples(npixels);
-        parallel_for_2D(
-            0, nxtiles, 0, nytiles,
-            [&](int64_t tx, int64_t ty) {
-                exr_chunk_info_t cinfo;
-                exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
-                DecoderDestroyer dd(m_exr_context, &decoder);
-                // Note: the decoder will be destroyed by dd exiting scope
-                exr_result_t rv
-                    = exr_read_tile_chunk_info(m_exr_context, subimage,
-                                               firstxtile + tx, firstytile + ty,
-                                               miplevel, miplevel, &cinfo);
-                if (rv == EXR_ERR_SUCCESS)
-                    rv = exr_decoding_initialize(m_exr_context, subimage,
-                                                 &cinfo, &decoder);
-                decoder.decode_flags |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
-                                         | EXR_DECODE_SAMPLE_DATA_ONLY);
-                if (rv == EXR_ERR_SUCCESS)
-                    rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                              subimage,
-                                                              &decoder);
-                if (rv == EXR_ERR_SUCCESS)
-                    rv = exr_decoding_run(m_exr_context, subimage, &decoder);
-                if (rv != EXR_ERR_SUCCESS) {
-                    ok = false;
-                } else {
-                    uint32_t* allsampdata = all_samples.data()
-                                            + ty * width * tileh;
-                    int sw = tilew;
-                    if ((size_t(tx) * size_t(tilew) + size_t(tilew)) > width)
-                        sw = width - (tx * tilew);
-                    int nlines = tileh;
-                    if ((size_t(ty) * size_t(tileh) + size_t(tileh)) > height)
-                        nlines = height - (ty * tileh);
-                    for (int y = 0; y < nlines; ++y) {
-                        memcpy(allsampdata + y * ud.fullwidth + tx * tilew,
-                               decoder.sample_count_table + y * sw,
-                               sw * sizeof(uint32_t));
-                    }
-                }
-            },
-            threads());
-        if (!ok)
+        bool ok;
+        {
+            ExrChunkPrefetch prefetch(m_userdata);
+            for (size_t t = 0; t < ntiles; ++t)
+                if (cinfo_rv[t] == EXR_ERR_SUCCESS)
+                    prefetch.add_sample_counts(cinfos[t]);
+            prefetch.fetch();
+            ok = decode_deep_sample_counts(
+                m_exr_context, subimage, cinfos, cinfo_rv, all_samples,
+                threads(), [&](int64_t t, const exr_chunk_info_t&) {
+                    size_t tx = size_t(t % nxtiles), ty = size_t(t / nxtiles);
+                    return std::make_pair(ty * tileh * width + tx * tilew,
+                                          width);
+                });
+        }
+        if (!ok) {
+            geterror(true);  // clear the error, issue our own
+            errorfmt("Some tiles were missing or corrupted");
             return false;
+        }
         deepdata.set_all_samples(all_samples);
-        ud.samplesset = true;
+        deepdata.get_pointers(pointers);  // allocates, once
     }
 
-    parallel_for_2D(
-        0, nxtiles, 0, nytiles,
-        [&](int64_t tx, int64_t ty) {
-            auto myud = ud;
-            myud.xoff = tx * tilew;
-            myud.cury = ty * tileh;
-            exr_chunk_info_t cinfo;
-            exr_decode_pipeline_t decoder = EXR_DECODE_PIPELINE_INITIALIZER;
-            DecoderDestroyer dd(m_exr_context, &decoder);
-            // Note: the decoder will be destroyed by dd exiting scope
-            exr_result_t rv
-                = exr_read_tile_chunk_info(m_exr_context, subimage,
-                                           firstxtile + tx, firstytile + ty,
-                                           miplevel, miplevel, &cinfo);
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_initialize(m_exr_context, subimage, &cinfo,
-                                             &decoder);
-            decoder.decode_flags |= (EXR_DECODE_SAMPLE_COUNTS_AS_INDIVIDUAL
-                                     | EXR_DECODE_NON_IMAGE_DATA_AS_POINTERS);
-            decoder.decoding_user_data       = &myud;
-            decoder.realloc_nonimage_data_fn = &realloc_deepdata;
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_choose_default_routines(m_exr_context,
-                                                          subimage, &decoder);
-            if (rv == EXR_ERR_SUCCESS)
-                rv = exr_decoding_run(m_exr_context, subimage, &decoder);
-            if (rv != EXR_ERR_SUCCESS)
-                ok = false;
-        },
-        threads());
-
+    ExrChunkPrefetch prefetch(m_userdata);
+    for (size_t t = 0; t < ntiles; ++t) {
+        if (cinfo_rv[t] == EXR_ERR_SUCCESS) {
+            prefetch.add_sample_counts(cinfos[t]);
+            prefetch.add(cinfos[t]);
+        }
+    }
+    prefetch.fetch();
+    bool ok = decode_deep_sample_data(m_exr_context, subimage, cinfos,
+                                      cinfo_rv, ud, threads(),
+                                      [&](int64_t t, deepdecode_userdata& u) {
+                                          u.xoff = size_t(t % nxtiles) * tilew;
+                                          u.cury = int(t / nxtiles) * tileh;
+                                      });
     if (!ok) {
         // FIXME: Please see the long comment at the end of
         // read_native_scanlines.
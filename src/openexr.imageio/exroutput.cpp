@@ -62,14 +62,23 @@ OIIO_GCC_PRAGMA(GCC diagnostic ignored "-Wunused-parameter")
 #include <OpenEXR/ImfDeepScanLineOutputPart.h>
 #include <OpenEXR/ImfDeepTiledOutputPart.h>
 #include <OpenEXR/ImfDoubleAttribute.h>
+#include <OpenEXR/ImfInputPart.h>
+#include <OpenEXR/ImfMultiPartInputFile.h>
 #include <OpenEXR/ImfMultiPartOutputFile.h>
 #include <OpenEXR/ImfOutputPart.h>
 #include <OpenEXR/ImfPartType.h>
 #include <OpenEXR/ImfStringVectorAttribute.h>
+#include <OpenEXR/ImfTiledInputPart.h>
 #include <OpenEXR/ImfTiledOutputPart.h>
 OIIO_PRAGMA_WARNING_POP
 OIIO_PRAGMA_VISIBILITY_POP
 
+#if OPENEXR_CODED_VERSION >= 30100 && defined(OIIO_USE_EXR_C_API)
+#    define USE_OPENEXR_CORE
+#endif
+
+#include "exr_pvt.h"
+#include "imageio_pvt.h"
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/deepdata.h>
 #include <OpenImageIO/filesystem.h>
@@ -147,6 +156,7 @@ public:
     virtual bool write_deep_tiles(int xbegin, int xend, int ybegin, int yend,
                                   int zbegin, int zend,
                                   const DeepData& deepdata) override;
+    virtual bool copy_image(ImageInput* in) override;
     virtual bool set_ioproxy(Filesystem::IOProxy* ioproxy) override
     {
         m_io = ioproxy;
@@ -171,6 +181,7 @@ private:
     int m_nsubimages;    ///< How many subimages are there?
     int m_miplevel;      ///< What miplevel we're writing now
     int m_nmiplevels;    ///< How many mip levels are there?
+    bool m_raw_copied;   ///< Were all levels of the subimage copied raw?
     std::vector<Imf::PixelType> m_pixeltype;  ///< Imf pixel type for each
                                               ///<   channel of current subimage
     std::vector<unsigned char> m_scratch;     ///< Scratch space for us to use
@@ -190,8 +201,9 @@ private:
         m_tiled_output_part.reset();
         m_deep_scanline_output_part.reset();
         m_deep_tiled_output_part.reset();
-        m_subimage = -1;
-        m_miplevel = -1;
+        m_subimage   = -1;
+        m_miplevel   = -1;
+        m_raw_copied = false;
         m_subimagespecs.clear();
         m_subimagespecs.shrink_to_fit();
         m_headers.clear();
@@ -218,6 +230,12 @@ private:
     // Helper: if the channel names are nonsensical, fix them to keep the
     // app from shooting itself in the foot.
     void sanity_check_channelnames();
+
+    // Copy the compressed chunks of the current image of `in`, whose file
+    // is read through `io`, if they can be written as they are. Set
+    // `copied` to whether they were (or were attempted to be).
+    bool copy_raw_chunks(ImageInput* in, Filesystem::IOProxy* io,
+                         bool& copied);
 };
 
 
@@ -228,6 +246,12 @@ OIIO_PLUGIN_EXPORTS_BEGIN
 OIIO_EXPORT ImageOutput*
 openexr_output_imageio_create()
 {
+#ifdef USE_OPENEXR_CORE
+    if (pvt::openexr_core) {
+        extern ImageOutput* openexrcore_output_imageio_create();
+        return openexrcore_output_imageio_create();
+    }
+#endif
     return new OpenEXROutput;
 }
 
@@ -250,6 +274,16 @@ OIIO_PLUGIN_EXPORTS_END
 
 
 
+// The OpenEXRCore-based writer (exroutput_c.cpp) defers to this one for
+// the kinds of files it doesn't write itself.
+ImageOutput*
+openexr_imf_output_create()
+{
+    return new OpenEXROutput;
+}
+
+
+
 namespace pvt {
 
 void
@@ -466,7 +500,8 @@ OpenEXROutput::open(const std::string& name, const ImageSpec& userspec,
             m_deep_tiled_output_part.reset();
             return false;
         }
-        m_spec = m_subimagespecs[m_subimage];
+        m_spec       = m_subimagespecs[m_subimage];
+        m_raw_copied = false;
         sanity_check_channelnames();
         compute_pixeltypes(m_spec);
         return true;
@@ -1613,6 +1648,7 @@ OpenEXROutput::write_deep_scanlines(int ybegin, int yend, int /*z*/,
         std::vector<void*> pointerbuf;
         deepdata.get_pointers(pointerbuf);
         for (int c = 0; c < nchans; ++c) {
+            size_t stride = deepdata.sample_stride(c);
             Imf::DeepSlice slice(
                 m_pixeltype[c],
                 (char*)(&pointerbuf[c] - m_spec.x * nchans
@@ -1620,7 +1656,7 @@ OpenEXROutput::write_deep_scanlines(int ybegin, int yend, int /*z*/,
                 sizeof(void*) * nchans,  // xstride of pointer array
                 sizeof(void*) * nchans
                     * m_spec.width,      // ystride of pointer array
-                deepdata.samplesize());  // stride of data sample
+                stride);                 // stride of data sample
             frameBuffer.insert(m_spec.channelnames[c].c_str(), slice);
         }
         m_deep_scanline_output_part->setFrameBuffer(frameBuffer);
@@ -1670,13 +1706,14 @@ OpenEXROutput::write_deep_tiles(int xbegin, int xend, int ybegin, int yend,
         std::vector<void*> pointerbuf;
         deepdata.get_pointers(pointerbuf);
         for (int c = 0; c < nchans; ++c) {
+            size_t stride = deepdata.sample_stride(c);
             Imf::DeepSlice slice(
                 m_pixeltype[c],
                 (char*)(&pointerbuf[c] - xbegin * nchans
                         - ybegin * width * nchans),
                 sizeof(void*) * nchans,          // xstride of pointer array
                 sizeof(void*) * nchans * width,  // ystride of pointer array
-                deepdata.samplesize());          // stride of data sample
+                stride);                         // stride of data sample
             frameBuffer.insert(m_spec.channelnames[c].c_str(), slice);
         }
         m_deep_tiled_output_part->setFrameBuffer(frameBuffer);
@@ -1706,4 +1743,105 @@ OpenEXROutput::write_deep_tiles(int xbegin, int xend, int ybegin, int yend,
 }
 
 
+bool
+OpenEXROutput::copy_image(ImageInput* in)
+{
+    // Another OpenEXR file may be copied without decoding and re-encoding
+    // its pixels, if its chunks can be written here as they are.
+    auto source = dynamic_cast<OpenEXRRawSource*>(in);
+    if (source && !m_spec.deep) {
+        bool copied = false;
+        bool ok     = copy_raw_chunks(in, source->raw_ioproxy(), copied);
+        if (copied)
+            return ok;
+    }
+    return ImageOutput::copy_image(in);
+}
+
+
+
+bool
+OpenEXROutput::copy_raw_chunks(ImageInput* in, Filesystem::IOProxy* io,
+                               bool& copied)
+{
+    copied = false;
+    if (m_raw_copied) {
+        // The raw copy of MIP level 0 copied every level of the image, so
+        // there's nothing left to do for the later ones.
+        copied = true;
+        if (in->current_miplevel() != m_miplevel) {
+            errorfmt("MIP level {} was already copied", m_miplevel);
+            return false;
+        }
+        return true;
+    }
+    if (!io || m_miplevel != 0 || in->current_miplevel() != 0)
+        return true;
+    const Imf::Header* header = nullptr;
+    if (m_output_scanline)
+        header = &m_output_scanline->header();
+    else if (m_output_tiled)
+        header = &m_output_tiled->header();
+    else if (m_scanline_output_part)
+        header = &m_scanline_output_part->header();
+    else if (m_tiled_output_part)
+        header = &m_tiled_output_part->header();
+    if (!header)
+        return true;
+
+    // Read the chunks through a file of our own, and leave the IOProxy
+    // where the reader expects it to be.
+    int64_t pos = io->tell();
+    bool ok     = true;
+    try {
+        OpenEXRInputStream stream(io->filename().c_str(), io);
+        Imf::MultiPartInputFile file(stream);
+        int part = in->current_subimage();
+        const Imf::Header& inheader(file.header(part));
+        bool tiled = header->hasTileDescription();
+        // Chunks are only interchangeable if everything that determines
+        // how the pixels are laid out and compressed is the same.
+        bool compatible
+            = !(inheader.hasType() && Imf::isDeepData(inheader.type()))
+              && inheader.hasTileDescription() == tiled
+              && (!tiled
+                  || inheader.tileDescription() == header->tileDescription())
+              && inheader.dataWindow() == header->dataWindow()
+              && inheader.lineOrder() == header->lineOrder()
+              && inheader.compression() == header->compression()
+              && inheader.channels() == header->channels();
+        if (compatible && tiled) {
+            copied = true;
+            Imf::TiledInputPart inpart(file, part);
+            if (m_output_tiled)
+                m_output_tiled->copyPixels(inpart);
+            else
+                m_tiled_output_part->copyPixels(inpart);
+            m_raw_copied = (m_levelmode != Imf::ONE_LEVEL);
+        } else if (compatible) {
+            copied = true;
+            Imf::InputPart inpart(file, part);
+            if (m_output_scanline)
+                m_output_scanline->copyPixels(inpart);
+            else
+                m_scanline_output_part->copyPixels(inpart);
+        }
+    } catch (const std::exception& e) {
+        // If we failed before copying anything, decoding may still work
+        if (copied) {
+            errorfmt("Failed OpenEXR raw copy: {}", e.what());
+            ok = false;
+        }
+    } catch (...) {  // catch-all for edge cases or compiler bugs
+        if (copied) {
+            errorfmt("Failed OpenEXR raw copy: unknown exception");
+            ok = false;
+        }
+    }
+    io->seek(pos);
+    return ok;
+}
+
+
+
 OIIO_PLUGIN_NAMESPACE_END
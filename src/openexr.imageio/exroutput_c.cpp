@@ -0,0 +1,1819 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <memory>
+
+#include <zlib.h>
+
+#include <OpenImageIO/Imath.h>
+#include <OpenImageIO/platform.h>
+
+#include <OpenEXR/openexr.h>
+
+#include <OpenImageIO/dassert.h>
+#include <OpenImageIO/deepdata.h>
+#include <OpenImageIO/filesystem.h>
+#include <OpenImageIO/fmath.h>
+#include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
+#include <OpenImageIO/strutil.h>
+#include <OpenImageIO/sysutil.h>
+#include <OpenImageIO/thread.h>
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+// The OpenEXRCore-based writer hands off to the Imf-based one (in
+// exroutput.cpp) for the files it doesn't write itself.
+ImageOutput*
+openexr_imf_output_create();
+
+
+
+struct oiioexr_output_struct {
+    ImageOutput* m_img         = nullptr;
+    Filesystem::IOProxy* m_io = nullptr;
+};
+
+
+
+static void
+oiio_exr_write_error_handler(exr_const_context_t ctxt, exr_result_t code,
+                             const char* msg = nullptr)
+{
+    void* userdata;
+    if (EXR_ERR_SUCCESS == exr_get_user_data(ctxt, &userdata) && userdata) {
+        oiioexr_output_struct* fb = static_cast<oiioexr_output_struct*>(
+            userdata);
+        if (fb->m_img)
+            fb->m_img->errorfmt("EXR Error ({}): {} {}",
+                                (fb->m_io ? fb->m_io->filename()
+                                          : std::string("<unknown>")),
+                                exr_get_error_code_as_string(code),
+                                msg ? msg : exr_get_default_error_message(code));
+    }
+}
+
+static int64_t
+oiio_exr_write_func(exr_const_context_t ctxt, void* userdata,
+                    const void* buffer, uint64_t sz, uint64_t offset,
+                    exr_stream_error_func_ptr_t error_cb)
+{
+    oiioexr_output_struct* fb = static_cast<oiioexr_output_struct*>(userdata);
+    if (!fb || !fb->m_io)
+        return -1;
+    size_t nwritten = fb->m_io->pwrite(buffer, sz, int64_t(offset));
+    if (nwritten != sz) {
+        std::string err = fb->m_io->error();
+        error_cb(ctxt, EXR_ERR_WRITE_IO, "Could not write to file: \"%s\" (%s)",
+                 fb->m_io->filename().c_str(),
+                 err.empty() ? "<unknown error>" : err.c_str());
+        return -1;
+    }
+    return int64_t(nwritten);
+}
+
+
+
+// Encoder write_fn that, instead of writing the chunk, keeps a copy of it
+// in the std::vector pointed to by the encoder's user data. This lets
+// chunks be compressed on any thread and then written in file order.
+static exr_result_t
+oiio_exr_capture_chunk(exr_encode_pipeline_t* encoder)
+{
+    auto out         = static_cast<std::vector<unsigned char>*>(
+        encoder->encoding_user_data);
+    const void* buf  = encoder->compressed_buffer;
+    size_t n         = encoder->compressed_bytes;
+    if (!buf || !n) {  // Uncompressed chunks are sent as packed
+        buf = encoder->packed_buffer;
+        n   = encoder->packed_bytes;
+    }
+    const unsigned char* b = static_cast<const unsigned char*>(buf);
+    out->assign(b, b + n);
+    return EXR_ERR_SUCCESS;
+}
+
+
+
+class OpenEXRCoreOutput final : public ImageOutput {
+public:
+    OpenEXRCoreOutput() { init(); }
+    virtual ~OpenEXRCoreOutput();
+    virtual const char* format_name(void) const override { return "openexr"; }
+    virtual int supports(string_view feature) const override;
+    virtual bool open(const std::string& name, const ImageSpec& spec,
+                      OpenMode mode = Create) override;
+    virtual bool open(const std::string& name, int subimages,
+                      const ImageSpec* specs) override;
+    virtual bool close() override;
+    virtual bool write_scanline(int y, int z, TypeDesc format, const void* data,
+                                stride_t xstride) override;
+    virtual bool write_scanlines(int ybegin, int yend, int z, TypeDesc format,
+                                 const void* data, stride_t xstride,
+                                 stride_t ystride) override;
+    virtual bool write_tile(int x, int y, int z, TypeDesc format,
+                            const void* data, stride_t xstride,
+                            stride_t ystride, stride_t zstride) override;
+    virtual bool write_tiles(int xbegin, int xend, int ybegin, int yend,
+                             int zbegin, int zend, TypeDesc format,
+                             const void* data, stride_t xstride,
+                             stride_t ystride, stride_t zstride) override;
+    virtual bool write_deep_scanlines(int ybegin, int yend, int z,
+                                      const DeepData& deepdata) override;
+    virtual bool write_deep_tiles(int xbegin, int xend, int ybegin, int yend,
+                                  int zbegin, int zend,
+                                  const DeepData& deepdata) override;
+    virtual bool set_ioproxy(Filesystem::IOProxy* ioproxy) override
+    {
+        m_userdata.m_io = ioproxy;
+        return true;
+    }
+
+protected:
+    virtual int pipeline_chunk_size() const override;
+    virtual bool
+    pipeline_compress(const ROI& chunk, void* data,
+                      std::vector<unsigned char>& compressed) const override;
+    virtual bool pipeline_write(const ROI& chunk,
+                                cspan<unsigned char> compressed) override;
+
+private:
+    // One chunk to be encoded: where it is in the file, and where its
+    // native, interleaved pixels are in memory.
+    struct ChunkRef {
+        int y, tx, ty;  // start scanline, or tile indices
+        const unsigned char* data;
+        size_t linebytes;
+    };
+
+    // One deep chunk to be packed: where it is in the file, and the pixels
+    // of the DeepData it's made of.
+    struct DeepChunkRef {
+        int y, tx, ty;  // start scanline, or tile indices
+        ROI roi;        // the chunk's pixels, within the DeepData's region
+    };
+
+    // A deep chunk as it's written to the file: its sample count table and
+    // sample data, each compressed unless that didn't make it smaller.
+    struct DeepChunk {
+        std::vector<unsigned char> counts, data;
+        uint64_t unpacked_size = 0;  // of the sample data
+    };
+
+    exr_context_t m_exr_context = nullptr;
+    oiioexr_output_struct m_userdata;
+    std::unique_ptr<Filesystem::IOProxy> m_local_io;
+    std::unique_ptr<ImageOutput> m_imf;  ///< Imf-based writer we defer to
+    int m_levelmode;                     ///< The level mode of the file
+    int m_roundingmode;                  ///< Rounding mode of the file
+    int m_subimage;                      ///< What subimage we're writing now
+    int m_nsubimages;                    ///< How many subimages are there?
+    int m_miplevel;                      ///< What miplevel we're writing now
+    int m_nmiplevels;                    ///< How many mip levels are there?
+    int m_scansperchunk;                 ///< Scanlines per chunk, this part
+    int m_next_y;                        ///< Next scanline we expect
+    std::vector<unsigned char> m_partial;  ///< Incomplete scanline chunk
+    std::vector<unsigned char> m_scratch;  ///< Scratch space for us to use
+    std::vector<ImageSpec> m_subimagespecs;  ///< Saved subimage specs
+
+    // Initialize private members to pre-opened state
+    void init(void)
+    {
+        m_exr_context     = nullptr;
+        m_userdata.m_img  = this;
+        m_userdata.m_io   = nullptr;
+        m_local_io.reset();
+        m_imf.reset();
+        m_levelmode     = EXR_TILE_ONE_LEVEL;
+        m_roundingmode  = EXR_TILE_ROUND_DOWN;
+        m_subimage      = -1;
+        m_nsubimages    = 0;
+        m_miplevel      = -1;
+        m_nmiplevels    = 1;
+        m_scansperchunk = 1;
+        m_next_y        = 0;
+        m_partial.clear();
+        m_subimagespecs.clear();
+        m_subimagespecs.shrink_to_fit();
+    }
+
+    // Does this set of specs need the Imf-based writer?
+    static bool needs_imf(int subimages, const ImageSpec* specs);
+    // Open via the Imf-based writer.
+    bool open_imf(const std::string& name, int subimages,
+                  const ImageSpec* specs);
+    // Forward the error of the Imf-based writer, return false.
+    bool imf_error();
+
+    // Add a part to the file for the given spec. Also may doctor the spec
+    // a bit.
+    bool spec_to_part(ImageSpec& spec, int subimage);
+
+    // Add a parameter to the output
+    bool put_parameter(const std::string& name, TypeDesc type, const void* data,
+                       int part);
+
+    // Decode the MIP parameters from the spec.
+    static void figure_mip(const ImageSpec& spec, int& nmiplevels,
+                           int& levelmode, int& roundingmode);
+
+    // Helper: if the channel names are nonsensical, fix them to keep the
+    // app from shooting itself in the foot.
+    void sanity_check_channelnames(ImageSpec& spec);
+
+    // Make the current subimage's spec current.
+    void start_part();
+
+    // Look up where a chunk goes in the file.
+    exr_result_t chunk_info(const ChunkRef& c, exr_chunk_info_t& cinfo) const;
+
+    // Run one chunk through an encoder that is reused across the chunks
+    // of a batch, capturing its compressed bytes.
+    exr_result_t encode_chunk(const ChunkRef& c,
+                              exr_encode_pipeline_t& encoder,
+                              bool& initialized,
+                              std::vector<unsigned char>& compressed) const;
+
+    // Write one already-compressed chunk to the file.
+    bool write_chunk(const ChunkRef& c, cspan<unsigned char> compressed);
+
+    // Compress the chunks in parallel on the thread pool, then write them
+    // to the file in the order given.
+    bool encode_and_write_chunks(cspan<ChunkRef> chunks);
+
+    // Gather the sample counts and samples of a deep chunk from
+    // `deepdata`, whose pixels cover `region`, into the file's layout, and
+    // compress them.
+    bool pack_deep_chunk(const DeepData& deepdata, const ROI& region,
+                         const DeepChunkRef& c, DeepChunk& packed) const;
+
+    // Pack and compress deep chunks in parallel on the thread pool, and
+    // write them to the file in the order given.
+    bool write_deep_chunks(const DeepData& deepdata, const ROI& region,
+                           cspan<DeepChunkRef> chunks);
+
+    // Write the file's chunk table and close it.
+    bool finish();
+
+    // Helper struct to destroy encoder upon scope exit
+    class EncoderDestroyer {
+    public:
+        EncoderDestroyer(exr_const_context_t ctx,
+                         exr_encode_pipeline_t* encoder)
+            : ctx(ctx)
+            , encoder(encoder) {};
+        ~EncoderDestroyer() { exr_encoding_destroy(ctx, encoder); }
+
+    private:
+        exr_const_context_t ctx;
+        exr_encode_pipeline_t* encoder;
+    };
+};
+
+
+
+OIIO_EXPORT ImageOutput*
+openexrcore_output_imageio_create()
+{
+    return new OpenEXRCoreOutput;
+}
+
+
+
+OpenEXRCoreOutput::~OpenEXRCoreOutput()
+{
+    // Close for real, even for MIP-mapped files that close() leaves open.
+    if (m_exr_context)
+        finish();
+    init();
+}
+
+
+
+int
+OpenEXRCoreOutput::supports(string_view feature) const
+{
+    if (m_imf)
+        return m_imf->supports(feature);
+    if (feature == "tiles")
+        return true;
+    if (feature == "mipmap")
+        return true;
+    if (feature == "alpha")
+        return true;
+    if (feature == "nchannels")
+        return true;
+    if (feature == "channelformats")
+        return true;
+    if (feature == "displaywindow")
+        return true;
+    if (feature == "origin")
+        return true;
+    if (feature == "negativeorigin")
+        return true;
+    if (feature == "arbitrary_metadata")
+        return true;
+    if (feature == "exif")  // Because of arbitrary_metadata
+        return true;
+    if (feature == "iptc")  // Because of arbitrary_metadata
+        return true;
+    if (feature == "multiimage")
+        return true;  // N.B. But OpenEXR does not support "appendsubimage"
+    if (feature == "deepdata")
+        return true;
+    if (feature == "ioproxy")
+        return true;
+
+    // EXR supports random write order iff lineOrder is set to 'random Y'
+    // and it's a tiled file.
+    if (feature == "random_access" && m_spec.tile_width != 0) {
+        const ParamValue* param = m_spec.find_attribute("openexr:lineOrder");
+        const char* lineorder   = param ? *(char**)param->data() : NULL;
+        return (lineorder && Strutil::iequals(lineorder, "randomY"));
+    }
+
+    // Everything else, we either don't support or don't know about
+    return false;
+}
+
+
+
+bool
+OpenEXRCoreOutput::needs_imf(int subimages, const ImageSpec* specs)
+{
+    for (int s = 0; s < subimages; ++s) {
+        // Chunks in decreasing order would have to be held back until the
+        // end.
+        if (Strutil::iequals(specs[s].get_string_attribute(
+                                 "openexr:lineOrder"),
+                             "decreasingY"))
+            return true;
+    }
+    return false;
+}
+
+
+
+bool
+OpenEXRCoreOutput::open_imf(const std::string& name, int subimages,
+                            const ImageSpec* specs)
+{
+    Filesystem::IOProxy* io = m_userdata.m_io;
+    init();
+    m_imf.reset(openexr_imf_output_create());
+    m_imf->threads(threads());
+    if (io)
+        m_imf->set_ioproxy(io);
+    bool ok = (subimages == 1) ? m_imf->open(name, specs[0], Create)
+                               : m_imf->open(name, subimages, specs);
+    if (!ok)
+        return imf_error();
+    m_spec = m_imf->spec();
+    return true;
+}
+
+
+
+bool
+OpenEXRCoreOutput::imf_error()
+{
+    std::string err = m_imf->geterror();
+    errorfmt("{}", err.size() ? err : std::string("unknown error"));
+    return false;
+}
+
+
+
+bool
+OpenEXRCoreOutput::open(const std::string& name, const ImageSpec& userspec,
+                        OpenMode mode)
+{
+    if (mode == Create)
+        return open(name, 1, &userspec);
+
+    if (m_imf) {
+        bool ok = m_imf->open(name, userspec, mode);
+        m_spec  = m_imf->spec();
+        return ok ? true : imf_error();
+    }
+
+    if (mode == AppendSubimage) {
+        // OpenEXR 2.x supports subimages, but we only allow it to use the
+        // open(name,subimages,specs[]) variety.
+        if (m_subimagespecs.size() == 0 || !m_exr_context) {
+            errorfmt("{} not opened properly for subimages", format_name());
+            return false;
+        }
+        // Move on to next subimage
+        ++m_subimage;
+        if (m_subimage >= m_nsubimages) {
+            errorfmt("More subimages than originally declared.");
+            return false;
+        }
+        start_part();
+        return true;
+    }
+
+    if (mode == AppendMIPLevel) {
+        if (!m_exr_context) {
+            errorfmt("Cannot append a MIP level if no file has been opened");
+            return false;
+        }
+        if (m_spec.tile_width && m_levelmode != EXR_TILE_ONE_LEVEL) {
+            // OpenEXR does not support differing tile sizes on different
+            // MIP-map levels.  Reject the open() if not using the original
+            // tile sizes.
+            if (userspec.tile_width != m_spec.tile_width
+                || userspec.tile_height != m_spec.tile_height) {
+                errorfmt(
+                    "OpenEXR tiles must have the same size on all MIPmap levels");
+                return false;
+            }
+            // Copy the new mip level size.  Keep everything else from the
+            // original level.
+            m_spec.width  = userspec.width;
+            m_spec.height = userspec.height;
+            ++m_miplevel;
+            return true;
+        } else {
+            errorfmt("Cannot add MIP level to a non-MIPmapped file");
+            return false;
+        }
+    }
+
+    errorfmt("Unknown open mode {}", int(mode));
+    return false;
+}
+
+
+
+bool
+OpenEXRCoreOutput::open(const std::string& name, int subimages,
+                        const ImageSpec* specs)
+{
+    if (subimages < 1) {
+        errorfmt("OpenEXR does not support {} subimages.", subimages);
+        return false;
+    }
+    if (m_exr_context)
+        finish();  // A MIP-mapped file left open by close()
+
+    if (needs_imf(subimages, specs))
+        return open_imf(name, subimages, specs);
+
+    Filesystem::IOProxy* io = m_userdata.m_io;
+    if (!io) {
+        const ParamValue* param = specs[0].find_attribute("oiio:ioproxy",
+                                                          TypeDesc::PTR);
+        if (param)
+            io = param->get<Filesystem::IOProxy*>();
+    }
+    for (int s = 1; s < subimages; ++s) {
+        if (specs[s].deep != specs[0].deep) {
+            errorfmt(
+                "OpenEXR does not support mixed deep/nondeep multi-part image files");
+            return false;
+        }
+    }
+    init();
+    m_nsubimages = subimages;
+    m_subimagespecs.assign(specs, specs + subimages);
+    for (auto& s : m_subimagespecs)
+        sanity_check_channelnames(s);
+
+    // Establish an output stream. If we weren't given an IOProxy, create
+    // one now that writes to the file.
+    if (!io) {
+        io = new Filesystem::IOFile(name, Filesystem::IOProxy::Write);
+        m_local_io.reset(io);
+    }
+    if (io->mode() != Filesystem::IOProxy::Write) {
+        // If the proxy couldn't be opened in write mode, try to return an
+        // error.
+        std::string e = io->error();
+        errorfmt("Could not open \"{}\" ({})", name,
+                 e.size() ? e : std::string("unknown error"));
+        init();
+        return false;
+    }
+    m_userdata.m_io = io;
+
+    exr_context_initializer_t cinit = EXR_DEFAULT_CONTEXT_INITIALIZER;
+    cinit.error_handler_fn          = &oiio_exr_write_error_handler;
+    cinit.user_data                 = &m_userdata;
+    cinit.write_fn                  = &oiio_exr_write_func;
+    exr_result_t rv = exr_start_write(&m_exr_context, name.c_str(),
+                                      EXR_WRITE_FILE_DIRECTLY, &cinit);
+    if (rv != EXR_ERR_SUCCESS) {
+        // the error handler would have already reported the error into us
+        m_exr_context = nullptr;
+        init();
+        return false;
+    }
+
+    // Names longer than 31 characters need the "long names" file flag.
+    bool longnames = false;
+    for (const auto& s : m_subimagespecs) {
+        for (const auto& c : s.channelnames)
+            longnames |= (c.size() > 31);
+        for (const auto& p : s.extra_attribs)
+            longnames |= (p.name().size() > 31);
+    }
+    if (longnames)
+        exr_set_longname_support(m_exr_context, 1);
+
+    for (int s = 0; s < subimages; ++s) {
+        if (!spec_to_part(m_subimagespecs[s], s)) {
+            exr_finish(&m_exr_context);
+            init();
+            return false;
+        }
+    }
+    rv = exr_write_header(m_exr_context);
+    if (rv != EXR_ERR_SUCCESS) {
+        exr_finish(&m_exr_context);
+        init();
+        return false;
+    }
+
+    m_subimage = 0;
+    start_part();
+    return true;
+}
+
+
+
+void
+OpenEXRCoreOutput::start_part()
+{
+    m_spec     = m_subimagespecs[m_subimage];
+    m_miplevel = 0;
+    figure_mip(m_spec, m_nmiplevels, m_levelmode, m_roundingmode);
+    int32_t spc = 1;
+    if (!m_spec.tile_width
+        && exr_get_scanlines_per_chunk(m_exr_context, m_subimage, &spc)
+               != EXR_ERR_SUCCESS)
+        spc = 1;
+    m_scansperchunk = std::max(1, int(spc));
+    m_next_y        = m_spec.y;
+    m_partial.clear();
+}
+
+
+
+void
+OpenEXRCoreOutput::sanity_check_channelnames(ImageSpec& spec)
+{
+    static const char* default_chan_names[] = { "R", "G", "B", "A" };
+    spec.channelnames.resize(spec.nchannels, "");
+    for (int c = 0; c < spec.nchannels; ++c) {
+        if (spec.channelnames[c].empty())
+            spec.channelnames[c] = (c < 4) ? default_chan_names[c]
+                                           : Strutil::sprintf("unknown %d", c);
+        for (int i = 0; i < c; ++i) {
+            if (spec.channelnames[c] == spec.channelnames[i]) {
+                // Duplicate channel name! OpenEXR can't have two channels
+                // of the same name, so rename it and hope for the best.
+                spec.channelnames[c] = Strutil::sprintf("channel%d", c);
+                break;
+            }
+        }
+    }
+}
+
+
+
+void
+OpenEXRCoreOutput::figure_mip(const ImageSpec& spec, int& nmiplevels,
+                              int& levelmode, int& roundingmode)
+{
+    nmiplevels   = 1;
+    levelmode    = EXR_TILE_ONE_LEVEL;  // Default to no MIP-mapping
+    roundingmode = spec.get_int_attribute("openexr:roundingmode",
+                                          EXR_TILE_ROUND_DOWN);
+
+    std::string textureformat = spec.get_string_attribute("textureformat", "");
+    if (Strutil::iequals(textureformat, "Plain Texture")
+        || Strutil::iequals(textureformat, "CubeFace Environment")
+        || Strutil::iequals(textureformat, "LatLong Environment")) {
+        levelmode = spec.get_int_attribute("openexr:levelmode",
+                                           EXR_TILE_MIPMAP_LEVELS);
+    } else if (Strutil::iequals(textureformat, "Shadow")) {
+        levelmode = EXR_TILE_ONE_LEVEL;  // Force one level for shadow maps
+    }
+    if (!spec.tile_width)
+        levelmode = EXR_TILE_ONE_LEVEL;  // Only tiled files can MIP-map
+
+    if (levelmode == EXR_TILE_MIPMAP_LEVELS) {
+        // Compute how many mip levels there will be
+        int w = spec.width;
+        int h = spec.height;
+        while (w > 1 && h > 1) {
+            if (roundingmode == EXR_TILE_ROUND_DOWN) {
+                w = w / 2;
+                h = h / 2;
+            } else {
+                w = (w + 1) / 2;
+                h = (h + 1) / 2;
+            }
+            w = std::max(1, w);
+            h = std::max(1, h);
+            ++nmiplevels;
+        }
+    }
+}
+
+
+
+static exr_compression_t
+exr_compression_from_name(string_view comp, bool& known)
+{
+    known = true;
+    if (Strutil::iequals(comp, "none"))
+        return EXR_COMPRESSION_NONE;
+    if (Strutil::iequals(comp, "deflate") || Strutil::iequals(comp, "zip"))
+        return EXR_COMPRESSION_ZIP;
+    if (Strutil::iequals(comp, "rle"))
+        return EXR_COMPRESSION_RLE;
+    if (Strutil::iequals(comp, "zips"))
+        return EXR_COMPRESSION_ZIPS;
+    if (Strutil::iequals(comp, "piz"))
+        return EXR_COMPRESSION_PIZ;
+    if (Strutil::iequals(comp, "pxr24"))
+        return EXR_COMPRESSION_PXR24;
+    if (Strutil::iequals(comp, "b44"))
+        return EXR_COMPRESSION_B44;
+    if (Strutil::iequals(comp, "b44a"))
+        return EXR_COMPRESSION_B44A;
+    if (Strutil::iequals(comp, "dwaa"))
+        return EXR_COMPRESSION_DWAA;
+    if (Strutil::iequals(comp, "dwab"))
+        return EXR_COMPRESSION_DWAB;
+    known = false;
+    return EXR_COMPRESSION_ZIP;  // Default
+}
+
+
+
+bool
+OpenEXRCoreOutput::spec_to_part(ImageSpec& spec, int subimage)
+{
+    if (spec.width < 1 || spec.height < 1) {
+        errorfmt("Image resolution must be at least 1x1, you asked for {} x {}",
+                 spec.width, spec.height);
+        return false;
+    }
+    if (spec.depth < 1)
+        spec.depth = 1;
+    if (spec.depth > 1) {
+        errorfmt("{} does not support volume images (depth > 1)",
+                 format_name());
+        return false;
+    }
+
+    if (spec.full_width <= 0)
+        spec.full_width = spec.width;
+    if (spec.full_height <= 0)
+        spec.full_height = spec.height;
+
+    // Force use of one of the three data types that OpenEXR supports
+    switch (spec.format.basetype) {
+    case TypeDesc::UINT: spec.format = TypeDesc::UINT; break;
+    case TypeDesc::FLOAT:
+    case TypeDesc::DOUBLE: spec.format = TypeDesc::FLOAT; break;
+    default:
+        // Everything else defaults to half
+        spec.format = TypeDesc::HALF;
+    }
+    for (auto& f : spec.channelformats) {
+        switch (f.basetype) {
+        case TypeDesc::UINT: f = TypeDesc::UINT; break;
+        case TypeDesc::FLOAT:
+        case TypeDesc::DOUBLE: f = TypeDesc::FLOAT; break;
+        default: f = TypeDesc::HALF;
+        }
+    }
+
+    // Multi-part EXR files required to have a name. Make one up if not
+    // supplied.
+    std::string partname = spec.get_string_attribute("oiio:subimagename");
+    if (partname.empty() && m_nsubimages > 1)
+        partname = Strutil::sprintf("subimage%02d", subimage);
+
+    exr_storage_t storage;
+    if (spec.deep)
+        storage = spec.tile_width ? EXR_STORAGE_DEEP_TILED
+                                  : EXR_STORAGE_DEEP_SCANLINE;
+    else
+        storage = spec.tile_width ? EXR_STORAGE_TILED : EXR_STORAGE_SCANLINE;
+    int part        = -1;
+    exr_result_t rv = exr_add_part(m_exr_context,
+                                   partname.size() ? partname.c_str()
+                                                   : nullptr,
+                                   storage, &part);
+    if (rv != EXR_ERR_SUCCESS)
+        return false;
+    OIIO_DASSERT(part == subimage);
+
+    string_view comp;
+    int qual;
+    std::tie(comp, qual) = spec.decode_compression_metadata("zip", 4);
+    // Deep files are only written with zips (or no) compression, as by the
+    // Imf-based writer.
+    if (spec.deep && comp != "none")
+        comp = "zips";
+    // For single channel images, dwaa/b compression only seems to work reliably
+    // when size > 16 and size is a power of two
+    if (spec.nchannels == 1 && Strutil::istarts_with(comp, "dwa")
+        && ((spec.tile_width < 16 && spec.tile_height < 16)
+            || !ispow2(spec.tile_width) || !ispow2(spec.tile_height))) {
+        comp = "zip";
+    }
+    bool known_comp;
+    exr_compression_t ctype = exr_compression_from_name(comp, known_comp);
+    if (Strutil::istarts_with(comp, "dwa")) {
+        spec.attribute("openexr:dwaCompressionLevel",
+                       qual > 0 ? float(qual) : 45.0f);
+    }
+    spec.attribute("compression", comp);
+
+    // Default to increasingY line order
+    if (!spec.find_attribute("openexr:lineOrder"))
+        spec.attribute("openexr:lineOrder", "increasingY");
+
+    rv = exr_initialize_required_attr_simple(m_exr_context, part, spec.width,
+                                             spec.height, ctype);
+    if (rv != EXR_ERR_SUCCESS)
+        return false;
+    exr_attr_box2i_t dataWindow = { { spec.x, spec.y },
+                                    { spec.x + spec.width - 1,
+                                      spec.y + spec.height - 1 } };
+    exr_attr_box2i_t displayWindow
+        = { { spec.full_x, spec.full_y },
+            { spec.full_x + spec.full_width - 1,
+              spec.full_y + spec.full_height - 1 } };
+    rv = exr_set_data_window(m_exr_context, part, &dataWindow);
+    if (rv == EXR_ERR_SUCCESS)
+        rv = exr_set_display_window(m_exr_context, part, &displayWindow);
+    if (rv == EXR_ERR_SUCCESS && ctype == EXR_COMPRESSION_ZIP
+        && Strutil::istarts_with(comp, "zip") && qual >= 1 && qual <= 9)
+        rv = exr_set_zip_compression_level(m_exr_context, part, qual);
+    if (rv != EXR_ERR_SUCCESS)
+        return false;
+
+    // Insert channels into the part. Hint to lossy compression methods
+    // that human perception of all channels is closer to logarithmic,
+    // just as the Imf-based writer does.
+    for (int c = 0; c < spec.nchannels; ++c) {
+        exr_pixel_type_t ptype;
+        switch (spec.channelformat(c).basetype) {
+        case TypeDesc::UINT: ptype = EXR_PIXEL_UINT; break;
+        case TypeDesc::FLOAT: ptype = EXR_PIXEL_FLOAT; break;
+        default: ptype = EXR_PIXEL_HALF; break;
+        }
+        rv = exr_add_channel(m_exr_context, part,
+                             spec.channelnames[c].c_str(), ptype,
+                             EXR_PERCEPTUALLY_LOGARITHMIC, 1, 1);
+        if (rv != EXR_ERR_SUCCESS)
+            return false;
+    }
+
+    // Automatically set date field if the client didn't supply it.
+    if (!spec.find_attribute("DateTime")) {
+        time_t now;
+        time(&now);
+        struct tm mytm;
+        Sysutil::get_local_time(&now, &mytm);
+        std::string date = Strutil::sprintf("%4d:%02d:%02d %02d:%02d:%02d",
+                                            mytm.tm_year + 1900,
+                                            mytm.tm_mon + 1, mytm.tm_mday,
+                                            mytm.tm_hour, mytm.tm_min,
+                                            mytm.tm_sec);
+        spec.attribute("DateTime", date);
+    }
+
+    int nmiplevels, levelmode, roundingmode;
+    figure_mip(spec, nmiplevels, levelmode, roundingmode);
+
+    std::string textureformat = spec.get_string_attribute("textureformat", "");
+    if (Strutil::iequals(textureformat, "CubeFace Environment"))
+        exr_attr_set_envmap(m_exr_context, part, "envmap", EXR_ENVMAP_CUBE);
+    else if (Strutil::iequals(textureformat, "LatLong Environment"))
+        exr_attr_set_envmap(m_exr_context, part, "envmap", EXR_ENVMAP_LATLONG);
+
+    // Fix up density and aspect to be consistent
+    float aspect   = spec.get_float_attribute("PixelAspectRatio", 0.0f);
+    float xdensity = spec.get_float_attribute("XResolution", 0.0f);
+    float ydensity = spec.get_float_attribute("YResolution", 0.0f);
+    if (!aspect && xdensity && ydensity) {
+        // No aspect ratio. Compute it from density, if supplied.
+        spec.attribute("PixelAspectRatio", xdensity / ydensity);
+    }
+    if (xdensity && ydensity
+        && spec.get_string_attribute("ResolutionUnit") == "cm") {
+        // OpenEXR only supports pixels per inch, so fix the values if they
+        // came to us in cm.
+        spec.attribute("XResolution", xdensity / 2.54f);
+        spec.attribute("YResolution", ydensity / 2.54f);
+    }
+
+    // We must set the tile description before the put_parameter calls
+    // below, since put_parameter will check it to ensure this is a tiled
+    // image before setting lineOrder to randomY.
+    if (spec.tile_width) {
+        rv = exr_set_tile_descriptor(m_exr_context, part,
+                                     uint32_t(spec.tile_width),
+                                     uint32_t(spec.tile_height),
+                                     exr_tile_level_mode_t(levelmode),
+                                     exr_tile_round_mode_t(roundingmode));
+        if (rv != EXR_ERR_SUCCESS)
+            return false;
+    }
+
+    // Deal with all other params
+    for (const auto& p : spec.extra_attribs)
+        put_parameter(p.name().string(), p.type(), p.data(), part);
+
+    return true;
+}
+
+
+
+namespace {
+
+struct ExrCoreMeta {
+    const char *oiioname, *exrname;
+    TypeDesc exrtype;
+};
+
+// Translate OIIO standard metadata names to OpenEXR standard names. This
+// matches the translation done by the Imf-based writer.
+const ExrCoreMeta exrcore_meta_translation[] = {
+    { "worldtocamera", "worldToCamera", TypeMatrix },
+    { "worldtoNDC", "worldToNDC", TypeMatrix },
+    { "worldtoscreen", "worldToScreen", TypeMatrix },
+    { "DateTime", "capDate", TypeString },
+    { "ImageDescription", "comments", TypeString },
+    { "description", "comments", TypeString },
+    { "Copyright", "owner", TypeString },
+    { "PixelAspectRatio", "pixelAspectRatio", TypeFloat },
+    { "XResolution", "xDensity", TypeFloat },
+    { "ExposureTime", "expTime", TypeFloat },
+    { "FNumber", "aperture", TypeFloat },
+    { "openexr:dwaCompressionLevel", "dwaCompressionLevel", TypeFloat },
+    { "smpte:TimeCode", "timeCode", TypeTimeCode },
+    { "smpte:KeyCode", "keyCode", TypeKeyCode },
+    // Empty exrname means that we silently drop this metadata. Often this
+    // is because they have particular meaning to OpenEXR and we don't want
+    // to mess it up by inadvertently copying it wrong from the user or
+    // from a file we read. The part name was set by exr_add_part.
+    { "oiio:subimagename", nullptr, TypeUnknown },
+    { "name", nullptr, TypeUnknown },
+    { "YResolution", nullptr, TypeUnknown },
+    { "planarconfig", nullptr, TypeUnknown },
+    { "type", nullptr, TypeUnknown },
+    { "tiles", nullptr, TypeUnknown },
+    { "chunkCount", nullptr, TypeUnknown },
+    { "maxSamplesPerPixel", nullptr, TypeUnknown },
+    { "openexr:roundingmode", nullptr, TypeUnknown },
+    { "channels", nullptr, TypeUnknown },
+    { "dataWindow", nullptr, TypeUnknown },
+    { "displayWindow", nullptr, TypeUnknown },
+};
+
+}  // namespace
+
+
+
+bool
+OpenEXRCoreOutput::put_parameter(const std::string& name, TypeDesc type,
+                                 const void* data, int part)
+{
+    // Translate
+    if (name.empty())
+        return false;
+    std::string xname = name;
+    TypeDesc exrtype  = TypeUnknown;
+
+    for (const auto& e : exrcore_meta_translation) {
+        if (Strutil::iequals(xname, e.oiioname)
+            || (e.exrname && Strutil::iequals(xname, e.exrname))) {
+            xname   = std::string(e.exrname ? e.exrname : "");
+            exrtype = e.exrtype;
+            break;
+        }
+    }
+
+    exr_context_t ctx = m_exr_context;
+    const char* n     = xname.c_str();
+
+    // Special cases
+    if (Strutil::iequals(xname, "Compression") && type == TypeString) {
+        const char* str = *(char**)data;
+        bool known;
+        exr_set_compression(ctx, part,
+                            exr_compression_from_name(str ? str : "", known));
+        return true;
+    }
+
+    if (Strutil::iequals(xname, "openexr:lineOrder") && type == TypeString) {
+        const char* str         = *(char**)data;
+        exr_lineorder_t order   = EXR_LINEORDER_INCREASING_Y;  // Default
+        exr_storage_t storage   = EXR_STORAGE_SCANLINE;
+        if (str && Strutil::iequals(str, "randomY")
+            && exr_get_storage(ctx, part, &storage) == EXR_ERR_SUCCESS
+            && storage == EXR_STORAGE_TILED /* randomY is only for tiles */)
+            order = EXR_LINEORDER_RANDOM_Y;
+        exr_set_lineorder(ctx, part, order);
+        return true;
+    }
+
+    if (xname == "dwaCompressionLevel" && type == TypeFloat)
+        exr_set_dwa_compression_level(ctx, part, *(const float*)data);
+    // ...and store it as metadata, as well, like the Imf-based writer.
+
+    // Special handling of any remaining "oiio:*" metadata.
+    if (Strutil::istarts_with(xname, "oiio:")) {
+        if (Strutil::iequals(xname, "oiio:ConstantColor")
+            || Strutil::iequals(xname, "oiio:AverageColor")
+            || Strutil::iequals(xname, "oiio:SHA-1")) {
+            // let these fall through and get stored as metadata
+        } else {
+            // Other than the listed exceptions, suppress any other custom
+            // oiio: directives.
+            return false;
+        }
+    }
+
+    // Before handling general named metadata, suppress format-specific
+    // metadata meant for other formats.
+    if (const char* colon = strchr(xname.c_str(), ':')) {
+        std::string prefix(xname.c_str(), colon);
+        Strutil::to_lower(prefix);
+        if (prefix != format_name() && is_imageio_format_name(prefix))
+            return false;
+    }
+
+    if (!xname.length())
+        return false;  // Skip suppressed names
+
+    // Handle some cases where the user passed a type different than what
+    // OpenEXR expects, and we can make a good guess about how to translate.
+    float tmpfloat;
+    if (exrtype == TypeFloat && type == TypeInt) {
+        tmpfloat = float(*(const int*)data);
+        data     = &tmpfloat;
+        type     = TypeFloat;
+    } else if (exrtype == TypeMatrix && type == TypeDesc(TypeDesc::FLOAT, 16)) {
+        // Automatically translate float[16] to Matrix when expected
+        type = TypeMatrix;
+    }
+
+    // Now if we still don't match a specific type OpenEXR is looking for,
+    // skip it.
+    if (exrtype != TypeDesc() && !exrtype.equivalent(type)) {
+        OIIO::debugf(
+            "OpenEXR output metadata \"%s\" type mismatch: expected %s, got %s\n",
+            name, exrtype, type);
+        return false;
+    }
+
+    // The required attributes have their own setters.
+    if (xname == "pixelAspectRatio" && type == TypeFloat)
+        return exr_set_pixel_aspect_ratio(ctx, part, *(const float*)data)
+               == EXR_ERR_SUCCESS;
+    if (xname == "screenWindowWidth" && type == TypeFloat)
+        return exr_set_screen_window_width(ctx, part, *(const float*)data)
+               == EXR_ERR_SUCCESS;
+    if (xname == "screenWindowCenter" && type == TypeDesc(TypeDesc::FLOAT, 2))
+        return exr_set_screen_window_center(ctx, part,
+                                            (const exr_attr_v2f_t*)data)
+               == EXR_ERR_SUCCESS;
+
+    // General handling of attributes. The exr_attr_*_t structs are laid
+    // out just like the corresponding OIIO types.
+    exr_result_t rv = EXR_ERR_INVALID_ATTR;
+    int nvalues     = int(type.basevalues());
+    if (type.arraylen == 0 && type.aggregate == TypeDesc::SCALAR) {
+        if (type == TypeDesc::INT || type == TypeDesc::UINT)
+            rv = exr_attr_set_int(ctx, part, n, *(const int*)data);
+        else if (type == TypeDesc::INT16)
+            rv = exr_attr_set_int(ctx, part, n, *(const short*)data);
+        else if (type == TypeDesc::UINT16)
+            rv = exr_attr_set_int(ctx, part, n, *(const unsigned short*)data);
+        else if (type == TypeDesc::FLOAT)
+            rv = exr_attr_set_float(ctx, part, n, *(const float*)data);
+        else if (type == TypeDesc::HALF)
+            rv = exr_attr_set_float(ctx, part, n, float(*(const half*)data));
+        else if (type == TypeString)
+            rv = exr_attr_set_string(ctx, part, n, *(const char**)data);
+        else if (type == TypeDesc::DOUBLE)
+            rv = exr_attr_set_double(ctx, part, n, *(const double*)data);
+    } else if (type.arraylen < 0) {
+        // Unknown length arrays (Don't know how to handle these yet)
+        return false;
+    } else if (type == TypeTimeCode) {
+        rv = exr_attr_set_timecode(ctx, part, n,
+                                   (const exr_attr_timecode_t*)data);
+    } else if (type == TypeKeyCode) {
+        rv = exr_attr_set_keycode(ctx, part, n, (const exr_attr_keycode_t*)data);
+    } else if (type.aggregate == TypeDesc::VEC2
+               && type.vecsemantics == TypeDesc::RATIONAL
+               && (type.basetype == TypeDesc::INT
+                   || type.basetype == TypeDesc::UINT)) {
+        // It's a floor wax AND a dessert topping
+        rv = exr_attr_set_rational(ctx, part, n,
+                                   (const exr_attr_rational_t*)data);
+    } else if (type.basetype == TypeDesc::FLOAT && nvalues == 8
+               && Strutil::iequals(xname, "chromaticities")) {
+        rv = exr_attr_set_chromaticities(
+            ctx, part, "chromaticities",
+            (const exr_attr_chromaticities_t*)data);
+    } else if (type.arraylen == 2 && type.aggregate == TypeDesc::VEC2) {
+        // 2 Vec2's are treated as a Box
+        if (type.basetype == TypeDesc::INT || type.basetype == TypeDesc::UINT)
+            rv = exr_attr_set_box2i(ctx, part, n,
+                                    (const exr_attr_box2i_t*)data);
+        else if (type.basetype == TypeDesc::FLOAT)
+            rv = exr_attr_set_box2f(ctx, part, n,
+                                    (const exr_attr_box2f_t*)data);
+    } else if (type.basetype == TypeDesc::STRING) {
+        // String Vector
+        rv = exr_attr_set_string_vector(ctx, part, n, nvalues,
+                                        (const char**)data);
+    } else if (nvalues == 2 || nvalues == 3) {
+        // Vec2 and Vec3, either as aggregates or as plain arrays
+        bool v3 = (nvalues == 3);
+        switch (type.basetype) {
+        case TypeDesc::UINT:
+        case TypeDesc::INT:
+            rv = v3 ? exr_attr_set_v3i(ctx, part, n,
+                                       (const exr_attr_v3i_t*)data)
+                    : exr_attr_set_v2i(ctx, part, n,
+                                       (const exr_attr_v2i_t*)data);
+            break;
+        case TypeDesc::FLOAT:
+            rv = v3 ? exr_attr_set_v3f(ctx, part, n,
+                                       (const exr_attr_v3f_t*)data)
+                    : exr_attr_set_v2f(ctx, part, n,
+                                       (const exr_attr_v2f_t*)data);
+            break;
+        case TypeDesc::DOUBLE:
+            rv = v3 ? exr_attr_set_v3d(ctx, part, n,
+                                       (const exr_attr_v3d_t*)data)
+                    : exr_attr_set_v2d(ctx, part, n,
+                                       (const exr_attr_v2d_t*)data);
+            break;
+        default: break;
+        }
+    } else if (nvalues == 9 || nvalues == 16) {
+        // Matrix, either as an aggregate or as a plain array
+        bool m44 = (nvalues == 16);
+        if (type.basetype == TypeDesc::FLOAT)
+            rv = m44 ? exr_attr_set_m44f(ctx, part, n,
+                                         (const exr_attr_m44f_t*)data)
+                     : exr_attr_set_m33f(ctx, part, n,
+                                         (const exr_attr_m33f_t*)data);
+        else if (type.basetype == TypeDesc::DOUBLE)
+            rv = m44 ? exr_attr_set_m44d(ctx, part, n,
+                                         (const exr_attr_m44d_t*)data)
+                     : exr_attr_set_m33d(ctx, part, n,
+                                         (const exr_attr_m33d_t*)data);
+    } else if (type.basetype == TypeDesc::FLOAT) {
+        // float Vector
+        rv = exr_attr_set_float_vector(ctx, part, n, nvalues,
+                                       (const float*)data);
+    }
+
+    if (rv == EXR_ERR_SUCCESS)
+        return true;
+    OIIO::debugf("Don't know what to do with %s %s\n", type, xname);
+    return false;
+}
+
+
+
+bool
+OpenEXRCoreOutput::finish()
+{
+    bool ok = true;
+    if (m_exr_context) {
+        // Writes the chunk table and releases the file
+        ok = (exr_finish(&m_exr_context) == EXR_ERR_SUCCESS);
+    }
+    m_exr_context = nullptr;
+    init();
+    return ok;
+}
+
+
+
+bool
+OpenEXRCoreOutput::close()
+{
+    if (m_imf) {
+        bool ok = m_imf->close();
+        if (!ok)
+            imf_error();
+        init();
+        return ok;
+    }
+
+    // FIXME: if the use pattern for mipmaps is open(), open(append),
+    // ... close(), then we don't have to leave the file open with this
+    // trickery.  That's only necessary if it's open(), close(),
+    // open(append), close(), ...
+    if (m_exr_context && m_levelmode != EXR_TILE_ONE_LEVEL) {
+        // Leave MIP-map files open, since appending cannot be done via
+        // a re-open like it can with TIFF files.
+        return true;
+    }
+    return finish();
+}
+
+
+
+exr_result_t
+OpenEXRCoreOutput::chunk_info(const ChunkRef& c, exr_chunk_info_t& cinfo) const
+{
+    if (m_spec.tile_width)
+        return exr_write_tile_chunk_info(m_exr_context, m_subimage, c.tx, c.ty,
+                                         m_miplevel, m_miplevel, &cinfo);
+    return exr_write_scanline_chunk_info(m_exr_context, m_subimage, c.y,
+                                         &cinfo);
+}
+
+
+
+exr_result_t
+OpenEXRCoreOutput::encode_chunk(const ChunkRef& c,
+                                exr_encode_pipeline_t& encoder,
+                                bool& initialized,
+                                std::vector<unsigned char>& compressed) const
+{
+    exr_chunk_info_t cinfo;
+    exr_result_t rv = chunk_info(c, cinfo);
+    if (rv != EXR_ERR_SUCCESS)
+        return rv;
+    // The first chunk of a batch initializes the encoder, later ones only
+    // update the chunk it points at, which keeps its allocations.
+    if (!initialized)
+        rv = exr_encoding_initialize(m_exr_context, m_subimage, &cinfo,
+                                     &encoder);
+    else
+        rv = exr_encoding_update(m_exr_context, m_subimage, &cinfo, &encoder);
+    initialized = (rv == EXR_ERR_SUCCESS);
+    if (rv == EXR_ERR_SUCCESS) {
+        // Point the encoder's channels straight at the interleaved native
+        // pixels, so packing reads them in place.
+        size_t pixelbytes = m_spec.pixel_bytes(true);
+        size_t chanoffset = 0;
+        for (int ch = 0; ch < m_spec.nchannels; ++ch) {
+            size_t chanbytes  = m_spec.channelformat(ch).size();
+            string_view cname = m_spec.channelnames[ch];
+            for (int ec = 0; ec < encoder.channel_count; ++ec) {
+                exr_coding_channel_info_t& curchan = encoder.channels[ec];
+                if (cname == curchan.channel_name) {
+                    curchan.encode_from_ptr   = c.data + chanoffset;
+                    curchan.user_pixel_stride = int32_t(pixelbytes);
+                    curchan.user_line_stride  = int32_t(c.linebytes);
+                    break;
+                }
+            }
+            chanoffset += chanbytes;
+        }
+        rv = exr_encoding_choose_default_routines(m_exr_context, m_subimage,
+                                                  &encoder);
+    }
+    if (rv == EXR_ERR_SUCCESS) {
+        encoder.write_fn           = &oiio_exr_capture_chunk;
+        encoder.encoding_user_data = &compressed;
+        rv = exr_encoding_run(m_exr_context, m_subimage, &encoder);
+    }
+    if (rv != EXR_ERR_SUCCESS && initialized) {
+        // Tear down a failed encoder so the next chunk starts over
+        exr_encoding_destroy(m_exr_context, &encoder);
+        initialized = false;
+    }
+    return rv;
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_chunk(const ChunkRef& c,
+                               cspan<unsigned char> compressed)
+{
+    exr_result_t rv;
+    if (m_spec.tile_width)
+        rv = exr_write_tile_chunk(m_exr_context, m_subimage, c.tx, c.ty,
+                                  m_miplevel, m_miplevel, compressed.data(),
+                                  uint64_t(compressed.size()));
+    else
+        rv = exr_write_scanline_chunk(m_exr_context, m_subimage, c.y,
+                                      compressed.data(),
+                                      uint64_t(compressed.size()));
+    // On failure, the error handler will have already reported it
+    return rv == EXR_ERR_SUCCESS;
+}
+
+
+
+bool
+OpenEXRCoreOutput::encode_and_write_chunks(cspan<ChunkRef> chunks)
+{
+    int64_t nchunks = int64_t(chunks.size());
+    std::vector<std::vector<unsigned char>> compressed(chunks.size());
+    std::vector<exr_result_t> results(chunks.size(), EXR_ERR_SUCCESS);
+
+    // Each task compresses a contiguous batch of chunks with a single
+    // encoder. Aim for a couple of batches per thread, so that a slow
+    // chunk doesn't leave the other threads idle at the end.
+    int nthreads = threads() > 0 ? threads()
+                                 : default_thread_pool()->size() + 1;
+    int64_t nbatches  = std::max(int64_t(1), int64_t(2) * nthreads);
+    int64_t batchsize = std::max(int64_t(1),
+                                 (nchunks + nbatches - 1) / nbatches);
+    parallel_for_chunked(
+        0, nchunks, batchsize,
+        [&](int64_t cbegin, int64_t cend) {
+            exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+            EncoderDestroyer ed(m_exr_context, &encoder);
+            // Note: the encoder will be destroyed by ed exiting scope
+            bool initialized = false;
+            for (int64_t c = cbegin; c < cend; ++c)
+                results[c] = encode_chunk(chunks[c], encoder, initialized,
+                                          compressed[c]);
+        },
+        threads());
+
+    // Now stream them out, in order, from this thread.
+    for (int64_t c = 0; c < nchunks; ++c) {
+        if (results[c] != EXR_ERR_SUCCESS) {
+            // Errors raised on the pool's threads don't reach us, so
+            // issue our own.
+            errorfmt("Failed OpenEXR write: could not compress {} ({})",
+                     m_spec.tile_width ? "tile" : "scanline chunk",
+                     exr_get_error_code_as_string(results[c]));
+            return false;
+        }
+        if (!write_chunk(chunks[c], compressed[c]))
+            return false;
+        std::vector<unsigned char>().swap(compressed[c]);
+    }
+    return true;
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_scanline(int y, int z, TypeDesc format,
+                                  const void* data, stride_t xstride)
+{
+    if (m_imf)
+        return m_imf->write_scanline(y, z, format, data, xstride)
+                   ? true
+                   : imf_error();
+    return write_scanlines(y, y + 1, z, format, data, xstride, AutoStride);
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_scanlines(int ybegin, int yend, int z,
+                                   TypeDesc format, const void* data,
+                                   stride_t xstride, stride_t ystride)
+{
+    if (m_imf)
+        return m_imf->write_scanlines(ybegin, yend, z, format, data, xstride,
+                                      ystride)
+                   ? true
+                   : imf_error();
+    if (!m_exr_context || m_spec.tile_width || m_spec.deep) {
+        errorfmt(
+            "called OpenEXROutput::write_scanlines without an open file");
+        return false;
+    }
+
+    yend = std::min(yend, m_spec.y + m_spec.height);
+    if (ybegin >= yend)
+        return true;
+    if (ybegin != m_next_y) {
+        errorfmt(
+            "OpenEXR scanlines must be written in order (expected y={}, got {})",
+            m_next_y, ybegin);
+        return false;
+    }
+
+    bool native               = (format == TypeDesc::UNKNOWN);
+    size_t pixel_bytes        = m_spec.pixel_bytes(true);
+    imagesize_t scanlinebytes = m_spec.scanline_bytes(true);
+    if (native && xstride == AutoStride)
+        xstride = (stride_t)pixel_bytes;
+    stride_t zstride = AutoStride;
+    m_spec.auto_stride(xstride, ystride, zstride, format, m_spec.nchannels,
+                       m_spec.width, m_spec.height);
+
+    // Work through the scanlines in windows of about 16 MB of native
+    // pixels, a whole number of chunks each.
+    int spc     = m_scansperchunk;
+    int endy    = m_spec.y + m_spec.height;
+    int window  = std::max(1, int((16 * 1024 * 1024) / scanlinebytes));
+    window      = round_to_multiple(window, spc);
+    bool ok     = true;
+    std::vector<ChunkRef> chunks;
+    for (int y = ybegin; ok && y < yend;) {
+        int y1 = std::min(yend, m_spec.y
+                                    + round_down_to_multiple(y - m_spec.y, spc)
+                                    + window);
+        const unsigned char* d = (const unsigned char*)to_native_rectangle(
+            m_spec.x, m_spec.x + m_spec.width, y, y1, z, z + 1, format, data,
+            xstride, ystride, zstride, m_scratch);
+        data = (const char*)data + ystride * (y1 - y);
+
+        // Finish any chunk that was started by an earlier call.
+        int chunkstart = m_spec.y + round_down_to_multiple(y - m_spec.y, spc);
+        if (y != chunkstart || (y1 < chunkstart + spc && y1 < endy)) {
+            int chunkend = std::min(chunkstart + spc, endy);
+            int n        = std::min(y1, chunkend) - y;
+            m_partial.resize(size_t(spc) * scanlinebytes);
+            memcpy(m_partial.data() + size_t(y - chunkstart) * scanlinebytes,
+                   d, size_t(n) * scanlinebytes);
+            d += size_t(n) * scanlinebytes;
+            y += n;
+            if (y == chunkend) {
+                ChunkRef c { chunkstart, 0, 0, m_partial.data(),
+                             size_t(scanlinebytes) };
+                ok = encode_and_write_chunks(cspan<ChunkRef>(&c, 1));
+            }
+        }
+
+        // Compress the whole chunks in this window in parallel, straight
+        // from the native pixels.
+        chunks.clear();
+        for (; y < y1 && (y + spc <= y1 || y1 == endy); y += spc)
+            chunks.push_back({ y, 0, 0, d, size_t(scanlinebytes) });
+        y = std::min(y, y1);
+        if (ok && chunks.size()) {
+            ok = encode_and_write_chunks(chunks);
+            d += size_t(y - chunks.front().y) * scanlinebytes;
+        }
+
+        // Hold on to the start of a chunk that isn't finished yet.
+        if (ok && y < y1) {
+            m_partial.resize(size_t(spc) * scanlinebytes);
+            memcpy(m_partial.data(), d, size_t(y1 - y) * scanlinebytes);
+            y = y1;
+        }
+    }
+    m_next_y = ok ? yend : m_next_y;
+
+    // If we allocated more than 1M, free the memory.  It's not wasteful,
+    // because it means we're writing big chunks at a time, and therefore
+    // there will be few allocations and deletions.
+    if (m_scratch.size() > 1 * 1024 * 1024)
+        std::vector<unsigned char>().swap(m_scratch);
+    return ok;
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_tile(int x, int y, int z, TypeDesc format,
+                              const void* data, stride_t xstride,
+                              stride_t ystride, stride_t zstride)
+{
+    if (m_imf)
+        return m_imf->write_tile(x, y, z, format, data, xstride, ystride,
+                                 zstride)
+                   ? true
+                   : imf_error();
+    bool native = (format == TypeDesc::UNKNOWN);
+    if (native && xstride == AutoStride)
+        xstride = (stride_t)m_spec.pixel_bytes(native);
+    m_spec.auto_stride(xstride, ystride, zstride, format, spec().nchannels,
+                       m_spec.tile_width, m_spec.tile_height);
+    return write_tiles(
+        x, std::min(x + m_spec.tile_width, m_spec.x + m_spec.width), y,
+        std::min(y + m_spec.tile_height, m_spec.y + m_spec.height), z,
+        std::min(z + m_spec.tile_depth, m_spec.z + m_spec.depth), format, data,
+        xstride, ystride, zstride);
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_tiles(int xbegin, int xend, int ybegin, int yend,
+                               int zbegin, int zend, TypeDesc format,
+                               const void* data, stride_t xstride,
+                               stride_t ystride, stride_t zstride)
+{
+    if (m_imf)
+        return m_imf->write_tiles(xbegin, xend, ybegin, yend, zbegin, zend,
+                                  format, data, xstride, ystride, zstride)
+                   ? true
+                   : imf_error();
+    if (!m_exr_context || !m_spec.tile_width || m_spec.deep) {
+        errorfmt("called OpenEXROutput::write_tiles without an open file");
+        return false;
+    }
+    if (!m_spec.valid_tile_range(xbegin, xend, ybegin, yend, zbegin, zend)) {
+        errorfmt(
+            "called OpenEXROutput::write_tiles with an invalid tile range");
+        return false;
+    }
+
+    bool native            = (format == TypeDesc::UNKNOWN);
+    size_t user_pixelbytes = m_spec.pixel_bytes(native);
+    size_t pixelbytes      = m_spec.pixel_bytes(true);
+    if (native && xstride == AutoStride)
+        xstride = (stride_t)user_pixelbytes;
+    m_spec.auto_stride(xstride, ystride, zstride, format, spec().nchannels,
+                       (xend - xbegin), (yend - ybegin));
+    const unsigned char* d = (const unsigned char*)to_native_rectangle(
+        xbegin, xend, ybegin, yend, zbegin, zend, format, data, xstride,
+        ystride, zstride, m_scratch);
+    size_t linebytes = size_t(xend - xbegin) * pixelbytes;
+
+    // Tiles at the right and bottom edges are clipped to the image in an
+    // OpenEXR file, so every tile can be encoded straight out of the
+    // region with no padding.
+    xend           = std::min(xend, m_spec.x + m_spec.width);
+    yend           = std::min(yend, m_spec.y + m_spec.height);
+    int tilew      = m_spec.tile_width;
+    int tileh      = m_spec.tile_height;
+    int firstxtile = (xbegin - m_spec.x) / tilew;
+    int firstytile = (ybegin - m_spec.y) / tileh;
+    int nxtiles    = (xend - xbegin + tilew - 1) / tilew;
+    int nytiles    = (yend - ybegin + tileh - 1) / tileh;
+    std::vector<ChunkRef> chunks;
+    chunks.reserve(size_t(nxtiles) * size_t(nytiles));
+    for (int ty = 0; ty < nytiles; ++ty)
+        for (int tx = 0; tx < nxtiles; ++tx)
+            chunks.push_back({ 0, firstxtile + tx, firstytile + ty,
+                               d + size_t(ty) * tileh * linebytes
+                                   + size_t(tx) * tilew * pixelbytes,
+                               linebytes });
+    return encode_and_write_chunks(chunks);
+}
+
+
+
+// Compress `raw` the way the zip compressors of OpenEXR do -- the bytes
+// split into odd and even halves and delta encoded, then deflated -- into
+// `out`, or copy it unchanged if that doesn't make it any smaller, which
+// readers tell by its size.
+static bool
+exr_zip_compress(cspan<unsigned char> raw, int level,
+                 std::vector<unsigned char>& out,
+                 std::vector<unsigned char>& tmp)
+{
+    size_t n = raw.size();
+    if (!n) {
+        out.clear();
+        return true;
+    }
+    tmp.resize(n);
+    unsigned char* t1 = tmp.data();
+    unsigned char* t2 = tmp.data() + (n + 1) / 2;
+    for (size_t i = 0; i < n; i += 2) {
+        *t1++ = raw[i];
+        if (i + 1 < n)
+            *t2++ = raw[i + 1];
+    }
+    for (size_t i = n - 1; i > 0; --i)
+        tmp[i] = (unsigned char)(int(tmp[i]) - int(tmp[i - 1]) + 128);
+    uLongf outsize = compressBound(uLong(n));
+    out.resize(outsize);
+    if (compress2(out.data(), &outsize, tmp.data(), uLong(n), level) != Z_OK)
+        return false;
+    if (outsize < n)
+        out.resize(outsize);
+    else
+        out.assign(raw.begin(), raw.end());
+    return true;
+}
+
+
+
+bool
+OpenEXRCoreOutput::pack_deep_chunk(const DeepData& deepdata, const ROI& region,
+                                   const DeepChunkRef& c,
+                                   DeepChunk& packed) const
+{
+    const exr_attr_chlist_t* chlist = nullptr;
+    if (exr_get_channels(m_exr_context, m_subimage, &chlist)
+            != EXR_ERR_SUCCESS
+        || chlist->num_channels != m_spec.nchannels)
+        return false;
+    // The file's channels are sorted by name. Find each in the DeepData.
+    int nchans = m_spec.nchannels;
+    std::vector<int> chanindex(nchans);
+    std::vector<TypeDesc> filetype(nchans);
+    size_t samplebytes = 0;
+    for (int fc = 0; fc < nchans; ++fc) {
+        const exr_attr_chlist_entry_t& e(chlist->entries[fc]);
+        auto name = std::find(m_spec.channelnames.begin(),
+                              m_spec.channelnames.end(), e.name.str);
+        if (name == m_spec.channelnames.end())
+            return false;
+        chanindex[fc] = int(name - m_spec.channelnames.begin());
+        filetype[fc]  = e.pixel_type == EXR_PIXEL_UINT ? TypeDesc::UINT
+                        : e.pixel_type == EXR_PIXEL_FLOAT ? TypeDesc::FLOAT
+                                                          : TypeDesc::HALF;
+        samplebytes += filetype[fc].size();
+    }
+
+    // The sample count table holds, for each pixel, the total number of
+    // samples of its scanline up to and including it.
+    int width  = c.roi.width();
+    int height = c.roi.height();
+    std::vector<int32_t> counts(size_t(width) * size_t(height));
+    size_t nsamples = 0;
+    for (int y = 0; y < height; ++y) {
+        int64_t p = int64_t(c.roi.ybegin - region.ybegin + y) * region.width()
+                    + (c.roi.xbegin - region.xbegin);
+        int32_t total = 0;
+        for (int x = 0; x < width; ++x, ++p) {
+            total += deepdata.samples(p);
+            counts[size_t(y) * width + x] = total;
+        }
+        nsamples += size_t(total);
+    }
+
+    // The samples go scanline by scanline, and within each scanline,
+    // channel by channel, all the samples of all the pixels. They're
+    // copied straight out of the DeepData unless the file stores the
+    // channel as a different type.
+    std::vector<unsigned char> data(nsamples * samplebytes);
+    unsigned char* d = data.data();
+    for (int y = 0; y < height; ++y) {
+        int64_t rowstart = int64_t(c.roi.ybegin - region.ybegin + y)
+                               * region.width()
+                           + (c.roi.xbegin - region.xbegin);
+        for (int fc = 0; fc < nchans; ++fc) {
+            int ch        = chanindex[fc];
+            TypeDesc ft   = filetype[fc];
+            size_t size   = ft.size();
+            size_t stride = deepdata.sample_stride(ch);
+            bool same     = (deepdata.channeltype(ch) == ft);
+            for (int64_t p = rowstart; p < rowstart + width; ++p) {
+                int n = deepdata.samples(p);
+                if (!n)
+                    continue;
+                if (same) {
+                    const char* s = (const char*)deepdata.data_ptr(p, ch, 0);
+                    if (stride == size) {
+                        memcpy(d, s, n * size);
+                        d += n * size;
+                    } else {
+                        for (int i = 0; i < n; ++i, d += size, s += stride)
+                            memcpy(d, s, size);
+                    }
+                } else if (ft == TypeDesc::UINT) {
+                    for (int i = 0; i < n; ++i, d += size) {
+                        uint32_t v = deepdata.deep_value_uint(p, ch, i);
+                        memcpy(d, &v, size);
+                    }
+                } else if (ft == TypeDesc::FLOAT) {
+                    for (int i = 0; i < n; ++i, d += size) {
+                        float v = deepdata.deep_value(p, ch, i);
+                        memcpy(d, &v, size);
+                    }
+                } else {
+                    for (int i = 0; i < n; ++i, d += size) {
+                        half v = deepdata.deep_value(p, ch, i);
+                        memcpy(d, &v, size);
+                    }
+                }
+                if (bigendian()) {
+                    if (size == 2)
+                        swap_endian((uint16_t*)(d - n * size), n);
+                    else
+                        swap_endian((uint32_t*)(d - n * size), n);
+                }
+            }
+        }
+    }
+    if (bigendian())
+        swap_endian(counts.data(), int(counts.size()));
+
+    packed.unpacked_size = data.size();
+    cspan<unsigned char> rawcounts((const unsigned char*)counts.data(),
+                                   counts.size() * sizeof(int32_t));
+    string_view comp;
+    int level;
+    std::tie(comp, level) = m_spec.decode_compression_metadata("zip", 4);
+    if (comp == "none") {
+        packed.counts.assign(rawcounts.begin(), rawcounts.end());
+        packed.data.swap(data);
+        return true;
+    }
+    if (level < 1 || level > 9)
+        level = 4;
+    std::vector<unsigned char> tmp;
+    return exr_zip_compress(rawcounts, level, packed.counts, tmp)
+           && exr_zip_compress(data, level, packed.data, tmp);
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_deep_chunks(const DeepData& deepdata,
+                                     const ROI& region,
+                                     cspan<DeepChunkRef> chunks)
+{
+    // Pack and compress a window of chunks at a time, a few per thread,
+    // then write them out in order from this thread, so that only that
+    // window of compressed chunks is ever held in memory.
+    int nthreads = threads() > 0 ? threads()
+                                 : default_thread_pool()->size() + 1;
+    int64_t nchunks = int64_t(chunks.size());
+    int64_t window  = std::max(int64_t(1), int64_t(4) * nthreads);
+    std::vector<DeepChunk> packed(std::min(nchunks, window));
+    std::vector<char> ok(packed.size());
+    for (int64_t first = 0; first < nchunks; first += window) {
+        int64_t n = std::min(window, nchunks - first);
+        parallel_for_chunked(
+            0, n, 1,
+            [&](int64_t b, int64_t e) {
+                for (int64_t i = b; i < e; ++i)
+                    ok[i] = pack_deep_chunk(deepdata, region,
+                                            chunks[first + i], packed[i]);
+            },
+            threads());
+        for (int64_t i = 0; i < n; ++i) {
+            const DeepChunkRef& c(chunks[first + i]);
+            if (!ok[i]) {
+                errorfmt("Failed OpenEXR write: could not compress deep {}",
+                         m_spec.tile_width ? "tile" : "scanline chunk");
+                return false;
+            }
+            const DeepChunk& p(packed[i]);
+            exr_result_t rv;
+            if (m_spec.tile_width)
+                rv = exr_write_deep_tile_chunk(
+                    m_exr_context, m_subimage, c.tx, c.ty, m_miplevel,
+                    m_miplevel, p.data.data(), p.data.size(),
+                    p.unpacked_size, p.counts.data(), p.counts.size());
+            else
+                rv = exr_write_deep_scanline_chunk(
+                    m_exr_context, m_subimage, c.y, p.data.data(),
+                    p.data.size(), p.unpacked_size, p.counts.data(),
+                    p.counts.size());
+            // On failure, the error handler will have already reported it
+            if (rv != EXR_ERR_SUCCESS)
+                return false;
+        }
+    }
+    return true;
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_deep_scanlines(int ybegin, int yend, int z,
+                                        const DeepData& deepdata)
+{
+    if (m_imf)
+        return m_imf->write_deep_scanlines(ybegin, yend, z, deepdata)
+                   ? true
+                   : imf_error();
+    if (!m_exr_context || m_spec.tile_width || !m_spec.deep) {
+        errorfmt(
+            "called OpenEXROutput::write_deep_scanlines without an open file");
+        return false;
+    }
+    if (m_spec.width * (yend - ybegin) != deepdata.pixels()
+        || m_spec.nchannels != deepdata.channels()) {
+        errorfmt(
+            "called OpenEXROutput::write_deep_scanlines with non-matching DeepData size");
+        return false;
+    }
+    if (ybegin != m_next_y
+        || ((yend - m_spec.y) % m_scansperchunk
+            && yend != m_spec.y + m_spec.height)) {
+        errorfmt(
+            "OpenEXR deep scanlines must be written in order, whole chunks at a time");
+        return false;
+    }
+
+    ROI region(m_spec.x, m_spec.x + m_spec.width, ybegin, yend);
+    std::vector<DeepChunkRef> chunks;
+    for (int y = ybegin; y < yend; y += m_scansperchunk)
+        chunks.push_back({ y, 0, 0,
+                           ROI(region.xbegin, region.xend, y,
+                               std::min(y + m_scansperchunk, yend)) });
+    bool ok  = write_deep_chunks(deepdata, region, chunks);
+    m_next_y = ok ? yend : m_next_y;
+    return ok;
+}
+
+
+
+bool
+OpenEXRCoreOutput::write_deep_tiles(int xbegin, int xend, int ybegin, int yend,
+                                    int zbegin, int zend,
+                                    const DeepData& deepdata)
+{
+    if (m_imf)
+        return m_imf->write_deep_tiles(xbegin, xend, ybegin, yend, zbegin,
+                                       zend, deepdata)
+                   ? true
+                   : imf_error();
+    if (!m_exr_context || !m_spec.tile_width || !m_spec.deep) {
+        errorfmt("called OpenEXROutput::write_deep_tiles without an open file");
+        return false;
+    }
+    if ((xend - xbegin) * (yend - ybegin) * (zend - zbegin) != deepdata.pixels()
+        || m_spec.nchannels != deepdata.channels()) {
+        errorfmt(
+            "called OpenEXROutput::write_deep_tiles with non-matching DeepData size");
+        return false;
+    }
+    if (!m_spec.valid_tile_range(xbegin, xend, ybegin, yend, zbegin, zend)) {
+        errorfmt(
+            "called OpenEXROutput::write_deep_tiles with an invalid tile range");
+        return false;
+    }
+
+    // The DeepData covers the whole region, but tiles at the right and
+    // bottom edges are clipped to the image.
+    ROI region(xbegin, xend, ybegin, yend);
+    int tilew      = m_spec.tile_width;
+    int tileh      = m_spec.tile_height;
+    int xlast      = std::min(xend, m_spec.x + m_spec.width);
+    int ylast      = std::min(yend, m_spec.y + m_spec.height);
+    int firstxtile = (xbegin - m_spec.x) / tilew;
+    int firstytile = (ybegin - m_spec.y) / tileh;
+    std::vector<DeepChunkRef> chunks;
+    for (int y = ybegin, ty = firstytile; y < ylast; y += tileh, ++ty)
+        for (int x = xbegin, tx = firstxtile; x < xlast; x += tilew, ++tx)
+            chunks.push_back({ 0, tx, ty,
+                               ROI(x, std::min(x + tilew, xlast), y,
+                                   std::min(y + tileh, ylast)) });
+    return write_deep_chunks(deepdata, region, chunks);
+}
+
+
+
+int
+OpenEXRCoreOutput::pipeline_chunk_size() const
+{
+    if (!m_exr_context || m_imf || m_spec.deep)
+        return 0;
+    if (m_spec.tile_width)
+        return 1;
+    // Only whole images can be written this way, so there mustn't be any
+    // scanlines written already.
+    return m_next_y == m_spec.y ? m_scansperchunk : 0;
+}
+
+
+
+bool
+OpenEXRCoreOutput::pipeline_compress(
+    const ROI& chunk, void* data, std::vector<unsigned char>& compressed) const
+{
+    size_t pixelbytes = m_spec.pixel_bytes(true);
+    ChunkRef c;
+    if (m_spec.tile_width) {
+        // Tiles come to us padded to the full tile size
+        c = { 0, (chunk.xbegin - m_spec.x) / m_spec.tile_width,
+              (chunk.ybegin - m_spec.y) / m_spec.tile_height,
+              (const unsigned char*)data, pixelbytes * m_spec.tile_width };
+    } else {
+        c = { chunk.ybegin, 0, 0, (const unsigned char*)data,
+              pixelbytes * m_spec.width };
+    }
+    exr_encode_pipeline_t encoder = EXR_ENCODE_PIPELINE_INITIALIZER;
+    EncoderDestroyer ed(m_exr_context, &encoder);
+    bool initialized = false;
+    return encode_chunk(c, encoder, initialized, compressed)
+           == EXR_ERR_SUCCESS;
+}
+
+
+
+bool
+OpenEXRCoreOutput::pipeline_write(const ROI& chunk,
+                                  cspan<unsigned char> compressed)
+{
+    ChunkRef c;
+    if (m_spec.tile_width) {
+        c = { 0, (chunk.xbegin - m_spec.x) / m_spec.tile_width,
+              (chunk.ybegin - m_spec.y) / m_spec.tile_height, nullptr, 0 };
+    } else {
+        c        = { chunk.ybegin, 0, 0, nullptr, 0 };
+        m_next_y = chunk.yend;
+    }
+    return write_chunk(c, compressed);
+}
+
+
+OIIO_PLUGIN_NAMESPACE_END
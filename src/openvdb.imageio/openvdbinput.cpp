@@ -70,7 +70,8 @@ public:
     virtual const char* format_name(void) const override { return "openvdb"; }
     virtual int supports(string_view feature) const override
     {
-        return (feature == "arbitrary_metadata");
+        return (feature == "arbitrary_metadata"
+                || feature == "constant_tiles");
     }
     virtual bool valid_file(const std::string& filename) const override;
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
@@ -82,6 +83,8 @@ public:
                                       void* data) override;
     virtual bool read_native_tile(int subimage, int miplevel, int x, int y,
                                   int z, void* data) override;
+    virtual bool native_tile_constant(int subimage, int miplevel, int x, int y,
+                                      int z, void* pixel) override;
 
     ImageSpec spec(int subimage, int miplevel) override;
     ImageSpec spec_dimensions(int subimage, int miplevel) override;
@@ -225,6 +228,21 @@ template<typename GridType> struct VDBReader {
         return true;
     }
 
+    // A tile that isn't backed by a leaf node is a single value: a tile
+    // value of an internal node, or the background. Knowing that only
+    // takes the tree topology, not the voxel buffers.
+    static bool constantTile(const GridType& grid, int x, int y, int z,
+                             ValueType* value)
+    {
+        enum { kOffset = LeafType::DIM / 2 };
+        const openvdb::Coord xyz(x + kOffset, y + kOffset, z + kOffset);
+        typename GridType::ConstAccessor cache = grid.getConstAccessor();
+        if (cache.probeConstLeaf(xyz))
+            return false;
+        *value = cache.getValue(xyz);
+        return true;
+    }
+
     static void fillSpec(const CoordBBox& bounds, const Coord& dim,
                          ImageSpec& spec)
     {
@@ -316,7 +334,10 @@ openVDB(const std::string& filename, const ImageInput* errReport)
 
         VDBFile file(new io::File(filename));
 
-        file->open();
+        // With delayed loading, only the tree topology is read when we
+        // read a grid. Each leaf's voxels are read the first time a tile
+        // needs them, so a volume is streamed in as it's looked up.
+        file->open(true /*delayLoad*/);
         if (file->isOpen())
             return file;
 
@@ -578,6 +599,31 @@ OpenVDBInput::read_native_tile(int subimage, int miplevel, int x, int y, int z,
 
 
 
+bool
+OpenVDBInput::native_tile_constant(int subimage, int miplevel, int x, int y,
+                                   int z, void* pixel)
+{
+    lock_guard lock(*this);
+    if (subimage < 0 || subimage >= m_nsubimages || miplevel != 0)
+        return false;
+
+    const layerrecord& lay = m_layers[subimage];
+    switch (lay.spec.nchannels) {
+    case 1:
+        return VDBReader<FloatGrid>::constantTile(
+            *gridPtrCast<ScalarGrid>(lay.grid), x, y, z,
+            reinterpret_cast<float*>(pixel));
+    case 3:
+        return VDBReader<Vec3fGrid>::constantTile(
+            *gridPtrCast<Vec3fGrid>(lay.grid), x, y, z,
+            reinterpret_cast<Vec3f*>(pixel));
+    default: break;
+    }
+    return false;
+}
+
+
+
 // Obligatory material to make this a recognizeable imageio plugin:
 OIIO_PLUGIN_EXPORTS_BEGIN
 
@@ -589,6 +635,8 @@ openvdb_input_imageio_create()
 
 OIIO_EXPORT const char* openvdb_input_extensions[] = { "vdb", nullptr };
 
+OIIO_EXPORT const char* openvdb_input_signatures[] = { "20424456", nullptr };
+
 OIIO_EXPORT int openvdb_imageio_version = OIIO_PLUGIN_VERSION;
 
 OIIO_EXPORT const char*
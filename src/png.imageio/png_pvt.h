@@ -143,7 +143,7 @@ hex2int(char a)
 //     ...more lines of 72 hex digits...
 //
 static bool
-decode_png_text_exif(string_view raw, ImageSpec& spec)
+decode_png_text_exif(string_view raw, ImageSpec& spec, bool lazy_metadata)
 {
     // Strutil::print("Found exif raw len={} '{}{}'\n", raw.size(),
     //                raw.substr(0,200), raw.size() > 200 ? "..." : "");
@@ -167,7 +167,13 @@ decode_png_text_exif(string_view raw, ImageSpec& spec)
         raw.remove_prefix(2);
     }
     if (Strutil::istarts_with(decoded, "Exif")) {
-        decode_exif(decoded, spec);
+        if (lazy_metadata)
+            defer_metadata("exif",
+                           cspan<uint8_t>((const uint8_t*)decoded.data(),
+                                          decoded.size()),
+                           spec);
+        else
+            decode_exif(decoded, spec);
     }
     return false;
 }
@@ -179,7 +185,7 @@ decode_png_text_exif(string_view raw, ImageSpec& spec)
 inline bool
 read_info(png_structp& sp, png_infop& ip, int& bit_depth, int& color_type,
           int& interlace_type, Imath::Color3f& bg, ImageSpec& spec,
-          bool keep_unassociated_alpha)
+          bool keep_unassociated_alpha, bool lazy_metadata = false)
 {
     // Must call this setjmp in every function that does PNG reads
     if (setjmp(png_jmpbuf(sp)))  // NOLINT(cert-err52-cpp)
@@ -271,15 +277,22 @@ read_info(png_structp& sp, png_infop& ip, int& bit_depth, int& color_type,
                 spec.attribute("Artist", text_ptr[i].text);
             else if (Strutil::iequals(text_ptr[i].key, "Title"))
                 spec.attribute("DocumentName", text_ptr[i].text);
-            else if (Strutil::iequals(text_ptr[i].key, "XML:com.adobe.xmp"))
-                decode_xmp(text_ptr[i].text, spec);
-            else if (Strutil::iequals(text_ptr[i].key,
+            else if (Strutil::iequals(text_ptr[i].key, "XML:com.adobe.xmp")) {
+                string_view xml(text_ptr[i].text);
+                if (lazy_metadata)
+                    defer_metadata("xmp",
+                                   cspan<uint8_t>((const uint8_t*)xml.data(),
+                                                  xml.size()),
+                                   spec);
+                else
+                    decode_xmp(xml, spec);
+            } else if (Strutil::iequals(text_ptr[i].key,
                                       "Raw profile type exif")) {
                 // Most PNG files seem to encode Exif by cramming it into a
                 // text field, with the key "Raw profile type exif" and then
                 // a special text encoding that we handle with the following
                 // function:
-                decode_png_text_exif(text_ptr[i].text, spec);
+                decode_png_text_exif(text_ptr[i].text, spec, lazy_metadata);
             } else {
                 spec.attribute(text_ptr[i].key, text_ptr[i].text);
             }
@@ -322,7 +335,11 @@ read_info(png_structp& sp, png_infop& ip, int& bit_depth, int& color_type,
     png_uint_32 num_exif = 0;
     png_bytep exif_data  = nullptr;
     if (png_get_eXIf_1(sp, ip, &num_exif, &exif_data)) {
-        decode_exif(cspan<uint8_t>(exif_data, num_exif), spec);
+        cspan<uint8_t> exif(exif_data, num_exif);
+        if (lazy_metadata)
+            defer_metadata("exif", exif, spec);
+        else
+            decode_exif(exif, spec);
     }
 #endif
 
@@ -688,6 +705,36 @@ write_row(png_structp& sp, png_byte* data)
 
 
 
+/// Writes one raw chunk (for example an IDAT whose zlib stream was built
+/// outside of libpng).
+///
+inline bool
+write_chunk(png_structp& sp, const char* name, const void* data, size_t size)
+{
+    if (setjmp(png_jmpbuf(sp))) {  // NOLINT(cert-err52-cpp)
+        //error ("PNG library error");
+        return false;
+    }
+    png_write_chunk(sp, (png_const_bytep)name, (png_const_bytep)data, size);
+    return true;
+}
+
+
+
+/// Helper function - finalizes an image whose IDAT chunks were written with
+/// write_chunk() rather than write_row() (so libpng won't agree to
+/// png_write_end), and destroy the write struct.
+inline void
+finish_raw_image(png_structp& sp, png_infop& ip)
+{
+    write_chunk(sp, "IEND", nullptr, 0);
+    png_destroy_write_struct(&sp, &ip);
+    sp = nullptr;
+    ip = nullptr;
+}
+
+
+
 /// Helper function - finalizes writing the image and destroy the write
 /// struct.
 inline void
@@ -103,6 +103,10 @@ png_imageio_library_version()
 
 OIIO_EXPORT const char* png_input_extensions[] = { "png", nullptr };
 
+OIIO_EXPORT const char* png_input_signatures[] = {
+    "89504e470d0a1a0a", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -151,13 +155,13 @@ PNGInput::open(const std::string& name, ImageSpec& newspec)
 
     bool ok = PNG_pvt::read_info(m_png, m_info, m_bit_depth, m_color_type,
                                  m_interlace_type, m_bg, m_spec,
-                                 m_keep_unassociated_alpha);
+                                 m_keep_unassociated_alpha, lazy_metadata());
     if (!ok || m_err) {
         close();
         return false;
     }
 
-    newspec         = spec();
+    newspec         = m_spec;
     m_next_scanline = 0;
 
     return ok;
@@ -172,6 +176,7 @@ PNGInput::open(const std::string& name, ImageSpec& newspec,
     // Check 'config' for any special requests
     if (config.get_int_attribute("oiio:UnassociatedAlpha", 0) == 1)
         m_keep_unassociated_alpha = true;
+    lazy_metadata(config);
     ioproxy_retrieve_from_config(config);
     m_config.reset(new ImageSpec(config));  // save config spec
     return open(name, newspec);
@@ -8,6 +8,8 @@
 #include <ctime>
 #include <iostream>
 
+#include <OpenImageIO/parallel.h>
+
 #include "png_pvt.h"
 
 
@@ -45,6 +47,20 @@ private:
     std::vector<unsigned char> m_tilebuffer;
     bool m_err = false;
 
+    // For png:multithread, we filter and deflate groups of rows ourselves
+    // on the thread pool and write the resulting zlib stream as raw IDAT
+    // chunks, rather than passing rows one at a time to libpng.
+    bool m_multithread = false;
+    int m_zlevel;
+    int m_zstrategy;
+    int m_filters;  ///< PNG_FILTER_* mask of row filters to try
+    int m_rows_per_group;
+    size_t m_pending_limit;               ///< Bytes to buffer before deflating
+    std::vector<unsigned char> m_pending;  ///< Rows not yet deflated
+    std::vector<unsigned char> m_prevrow;  ///< Last row already deflated
+    uLong m_adler;                         ///< Running zlib checksum
+    bool m_wrote_zheader;
+
     // Initialize private members to pre-opened state
     void init(void)
     {
@@ -54,13 +70,20 @@ private:
         m_gamma         = 1.0;
         m_pngtext.clear();
         ioproxy_clear();
-        m_err = false;
+        m_err         = false;
+        m_multithread = false;
+        m_pending.clear();
+        m_prevrow.clear();
     }
 
     // Add a parameter to the output
     bool put_parameter(const std::string& name, TypeDesc type,
                        const void* data);
 
+    // Filter and deflate the buffered rows in parallel and write them out
+    // as an IDAT chunk. If finish is true, this ends the zlib stream.
+    bool write_pending_rows(bool finish);
+
     // Callback for PNG that writes via an IOProxy instead of writing
     // to a file.
     static void PngWriteCallback(png_structp png_ptr, png_bytep data,
@@ -142,31 +165,32 @@ PNGOutput::open(const std::string& name, const ImageSpec& userspec,
 
     png_set_write_fn(m_png, this, PngWriteCallback, PngFlushCallback);
 
-    png_set_compression_level(
-        m_png, std::max(std::min(m_spec.get_int_attribute(
+    m_zlevel = std::max(std::min(m_spec.get_int_attribute(
                                      "png:compressionLevel",
                                      6 /* medium speed vs size tradeoff */),
                                  Z_BEST_COMPRESSION),
-                        Z_NO_COMPRESSION));
+                        Z_NO_COMPRESSION);
+    png_set_compression_level(m_png, m_zlevel);
     std::string compression = m_spec.get_string_attribute("compression");
     if (compression.empty()) {
-        png_set_compression_strategy(m_png, Z_DEFAULT_STRATEGY);
+        m_zstrategy = Z_DEFAULT_STRATEGY;
     } else if (Strutil::iequals(compression, "default")) {
-        png_set_compression_strategy(m_png, Z_DEFAULT_STRATEGY);
+        m_zstrategy = Z_DEFAULT_STRATEGY;
     } else if (Strutil::iequals(compression, "filtered")) {
-        png_set_compression_strategy(m_png, Z_FILTERED);
+        m_zstrategy = Z_FILTERED;
     } else if (Strutil::iequals(compression, "huffman")) {
-        png_set_compression_strategy(m_png, Z_HUFFMAN_ONLY);
+        m_zstrategy = Z_HUFFMAN_ONLY;
     } else if (Strutil::iequals(compression, "rle")) {
-        png_set_compression_strategy(m_png, Z_RLE);
+        m_zstrategy = Z_RLE;
     } else if (Strutil::iequals(compression, "fixed")) {
-        png_set_compression_strategy(m_png, Z_FIXED);
+        m_zstrategy = Z_FIXED;
     } else {
-        png_set_compression_strategy(m_png, Z_DEFAULT_STRATEGY);
+        m_zstrategy = Z_DEFAULT_STRATEGY;
     }
+    png_set_compression_strategy(m_png, m_zstrategy);
 
-    png_set_filter(m_png, 0,
-                   spec().get_int_attribute("png:filter", PNG_NO_FILTERS));
+    int filter = spec().get_int_attribute("png:filter", PNG_NO_FILTERS);
+    png_set_filter(m_png, 0, filter);
     // https://www.w3.org/TR/PNG-Encoders.html#E.Filter-selection
     // https://www.w3.org/TR/PNG-Rationale.html#R.Filtering
     // The official advice is to PNG_NO_FILTER for palette or < 8 bpp
@@ -208,6 +232,35 @@ PNGOutput::open(const std::string& name, const ImageSpec& userspec,
     if (m_spec.tile_width && m_spec.tile_height)
         m_tilebuffer.resize(m_spec.image_bytes());
 
+    m_multithread = m_spec.get_int_attribute("png:multithread", 0) != 0;
+    if (m_multithread) {
+        // Same interpretation of png:filter as png_set_filter: either one
+        // of the PNG_FILTER_VALUE_* filter types, or a mask of filters
+        // among which to choose row by row.
+        switch (filter & (PNG_ALL_FILTERS | 0x07)) {
+        case PNG_FILTER_VALUE_NONE: m_filters = PNG_FILTER_NONE; break;
+        case PNG_FILTER_VALUE_SUB: m_filters = PNG_FILTER_SUB; break;
+        case PNG_FILTER_VALUE_UP: m_filters = PNG_FILTER_UP; break;
+        case PNG_FILTER_VALUE_AVG: m_filters = PNG_FILTER_AVG; break;
+        case PNG_FILTER_VALUE_PAETH: m_filters = PNG_FILTER_PAETH; break;
+        default: m_filters = filter & PNG_ALL_FILTERS; break;
+        }
+        if (!m_filters)
+            m_filters = PNG_FILTER_NONE;
+        // Deflate groups of about half a MB of rows each, a couple of
+        // groups per thread at a time. The full flush at the end of each
+        // group costs only the few bytes of the flush marker plus the
+        // compressor's lost history at that point.
+        size_t rowbytes  = m_spec.scanline_bytes();
+        m_rows_per_group = int(std::max(size_t(1), (size_t(1) << 19) / rowbytes));
+        int nthreads     = threads() ? threads()
+                                     : default_thread_pool()->size() + 1;
+        m_pending_limit  = size_t(2 * nthreads) * m_rows_per_group * rowbytes;
+        m_prevrow.assign(rowbytes, 0);  // The row "above" the first is zero
+        m_adler         = adler32(0L, Z_NULL, 0);
+        m_wrote_zheader = false;
+    }
+
     return true;
 }
 
@@ -231,7 +284,12 @@ PNGOutput::close()
     }
 
     if (m_png) {
-        PNG_pvt::finish_image(m_png, m_info);
+        if (m_multithread) {
+            ok &= write_pending_rows(true);
+            PNG_pvt::finish_raw_image(m_png, m_info);
+        } else {
+            PNG_pvt::finish_image(m_png, m_info);
+        }
     }
 
     init();  // re-initialize
@@ -299,6 +357,14 @@ PNGOutput::write_scanline(int y, int z, TypeDesc format, const void* data,
     if (littleendian() && m_spec.format == TypeDesc::UINT16)
         swap_endian((unsigned short*)data, m_spec.width * m_spec.nchannels);
 
+    if (m_multithread) {
+        m_pending.insert(m_pending.end(), (const unsigned char*)data,
+                         (const unsigned char*)data + m_spec.scanline_bytes());
+        if (m_pending.size() >= m_pending_limit)
+            return write_pending_rows(false);
+        return true;
+    }
+
     if (!PNG_pvt::write_row(m_png, (png_byte*)data)) {
         errorf("PNG library error");
         return false;
@@ -309,6 +375,192 @@ PNGOutput::write_scanline(int y, int z, TypeDesc format, const void* data,
 
 
 
+// Apply PNG filter type `type` (a PNG_FILTER_VALUE_*) to one row, given
+// the unfiltered row above it, writing the filter type byte followed by
+// the filtered bytes to out.
+static void
+filter_row(int type, const unsigned char* row, const unsigned char* prev,
+           size_t rowbytes, size_t bpp, unsigned char* out)
+{
+    *out++ = (unsigned char)type;
+    switch (type) {
+    case PNG_FILTER_VALUE_SUB:
+        for (size_t i = 0; i < rowbytes; ++i)
+            out[i] = row[i] - (i >= bpp ? row[i - bpp] : 0);
+        break;
+    case PNG_FILTER_VALUE_UP:
+        for (size_t i = 0; i < rowbytes; ++i)
+            out[i] = row[i] - prev[i];
+        break;
+    case PNG_FILTER_VALUE_AVG:
+        for (size_t i = 0; i < rowbytes; ++i)
+            out[i] = row[i]
+                     - (unsigned char)(((i >= bpp ? row[i - bpp] : 0)
+                                        + prev[i])
+                                       / 2);
+        break;
+    case PNG_FILTER_VALUE_PAETH:
+        for (size_t i = 0; i < rowbytes; ++i) {
+            int a  = i >= bpp ? row[i - bpp] : 0;
+            int b  = prev[i];
+            int c  = i >= bpp ? prev[i - bpp] : 0;
+            int pa = std::abs(b - c);
+            int pb = std::abs(a - c);
+            int pc = std::abs(a + b - 2 * c);
+            int pred = (pa <= pb && pa <= pc) ? a : (pb <= pc ? b : c);
+            out[i]   = row[i] - (unsigned char)pred;
+        }
+        break;
+    default: memcpy(out, row, rowbytes); break;
+    }
+}
+
+
+
+// Filter and deflate nrows rows (the first of which has prev above it)
+// into a raw deflate stream that ends on a byte boundary: with a full
+// flush, so that independently compressed groups can simply be
+// concatenated, or for the last group of the image, with the final block.
+// Also return the zlib checksum of the filtered data and its length.
+static bool
+deflate_rows(const unsigned char* rows, const unsigned char* prev, int nrows,
+             size_t rowbytes, size_t bpp, int filters, int level,
+             int strategy, bool finish, std::vector<unsigned char>& out,
+             uLong& adler, size_t& filteredbytes)
+{
+    const int types[] = { PNG_FILTER_VALUE_NONE, PNG_FILTER_VALUE_SUB,
+                          PNG_FILTER_VALUE_UP, PNG_FILTER_VALUE_AVG,
+                          PNG_FILTER_VALUE_PAETH };
+    const int masks[] = { PNG_FILTER_NONE, PNG_FILTER_SUB, PNG_FILTER_UP,
+                          PNG_FILTER_AVG, PNG_FILTER_PAETH };
+    filteredbytes = size_t(nrows) * (rowbytes + 1);
+    std::unique_ptr<unsigned char[]> filtered(new unsigned char[filteredbytes]);
+    std::unique_ptr<unsigned char[]> trial(new unsigned char[rowbytes + 1]);
+    for (int r = 0; r < nrows; ++r) {
+        const unsigned char* row = rows + r * rowbytes;
+        const unsigned char* up  = r ? row - rowbytes : prev;
+        unsigned char* dst       = filtered.get() + r * (rowbytes + 1);
+        // With more than one filter allowed, pick the one giving the
+        // smallest sum of absolute (signed) differences, the same
+        // heuristic libpng uses.
+        uint64_t best = std::numeric_limits<uint64_t>::max();
+        for (int f = 0; f < 5; ++f) {
+            if (!(filters & masks[f]))
+                continue;
+            if (best == std::numeric_limits<uint64_t>::max()
+                && !(filters & ~(masks[f] | (masks[f] - 1)))) {
+                filter_row(types[f], row, up, rowbytes, bpp, dst);
+                break;  // The only (remaining) choice
+            }
+            filter_row(types[f], row, up, rowbytes, bpp, trial.get());
+            uint64_t sum = 0;
+            for (size_t i = 1; i <= rowbytes; ++i)
+                sum += std::abs(int((signed char)trial[i]));
+            if (sum < best) {
+                best = sum;
+                memcpy(dst, trial.get(), rowbytes + 1);
+            }
+        }
+    }
+    adler = adler32(adler32(0L, Z_NULL, 0), filtered.get(),
+                    uInt(filteredbytes));
+
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (deflateInit2(&z, level, Z_DEFLATED, -MAX_WBITS, 8, strategy) != Z_OK)
+        return false;
+    out.resize(deflateBound(&z, uLong(filteredbytes)) + 64);
+    z.next_in     = filtered.get();
+    z.avail_in    = uInt(filteredbytes);
+    size_t nbytes = 0;
+    int rv;
+    for (;;) {
+        if (nbytes == out.size())
+            out.resize(2 * out.size());
+        z.next_out  = out.data() + nbytes;
+        z.avail_out = uInt(out.size() - nbytes);
+        rv          = deflate(&z, finish ? Z_FINISH : Z_FULL_FLUSH);
+        nbytes      = out.size() - z.avail_out;
+        if (rv == Z_STREAM_ERROR
+            || (finish ? rv == Z_STREAM_END : z.avail_out != 0))
+            break;
+    }
+    deflateEnd(&z);
+    out.resize(nbytes);
+    return rv != Z_STREAM_ERROR;
+}
+
+
+
+bool
+PNGOutput::write_pending_rows(bool finish)
+{
+    size_t rowbytes = m_spec.scanline_bytes();
+    int nrows       = int(m_pending.size() / rowbytes);
+    if (!nrows && !finish)
+        return true;
+    // At the end there may be no rows left, but the stream still needs its
+    // final (empty) block.
+    int ngroups = std::max(1, (nrows + m_rows_per_group - 1) / m_rows_per_group);
+    std::vector<std::vector<unsigned char>> compressed(ngroups);
+    std::vector<uLong> adlers(ngroups);
+    std::vector<size_t> lengths(ngroups);
+    std::atomic<bool> ok(true);
+    parallel_for_chunked(
+        0, ngroups, 1,
+        [&](int64_t gbegin, int64_t gend) {
+            for (int64_t g = gbegin; g < gend; ++g) {
+                int r0 = int(g) * m_rows_per_group;
+                int n  = std::min(m_rows_per_group, nrows - r0);
+                const unsigned char* rows = m_pending.data() + r0 * rowbytes;
+                const unsigned char* prev = r0 ? rows - rowbytes
+                                               : m_prevrow.data();
+                if (!deflate_rows(rows, prev, std::max(n, 0), rowbytes,
+                                  m_spec.pixel_bytes(), m_filters, m_zlevel,
+                                  m_zstrategy, finish && g == ngroups - 1,
+                                  compressed[g], adlers[g], lengths[g]))
+                    ok = false;
+            }
+        },
+        threads());
+    if (!ok) {
+        errorf("PNG compression error");
+        return false;
+    }
+
+    // Stitch the groups together into one zlib stream: the header, the
+    // concatenated deflate data, and (at the end) the checksum of it all.
+    std::vector<unsigned char> idat;
+    if (!m_wrote_zheader) {
+        int flevel = m_zlevel < 2 ? 0 : m_zlevel < 6 ? 1 : m_zlevel == 6 ? 2 : 3;
+        unsigned int header = (0x78 << 8) | (flevel << 6);
+        header += 31 - (header % 31);
+        idat.push_back((unsigned char)(header >> 8));
+        idat.push_back((unsigned char)(header & 0xff));
+        m_wrote_zheader = true;
+    }
+    for (int g = 0; g < ngroups; ++g) {
+        idat.insert(idat.end(), compressed[g].begin(), compressed[g].end());
+        m_adler = adler32_combine(m_adler, adlers[g], z_off_t(lengths[g]));
+    }
+    if (finish)
+        for (int shift = 24; shift >= 0; shift -= 8)
+            idat.push_back((unsigned char)(m_adler >> shift));
+
+    if (nrows)
+        m_prevrow.assign(m_pending.end() - rowbytes, m_pending.end());
+    m_pending.clear();
+
+    if (!PNG_pvt::write_chunk(m_png, "IDAT", idat.data(), idat.size())
+        || m_err) {
+        errorf("PNG library error");
+        return false;
+    }
+    return true;
+}
+
+
+
 bool
 PNGOutput::write_tile(int x, int y, int z, TypeDesc format, const void* data,
                       stride_t xstride, stride_t ystride, stride_t zstride)
@@ -9,6 +9,7 @@
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
@@ -37,6 +38,8 @@ public:
     virtual int current_subimage(void) const override { return 0; }
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
 
 private:
     enum PNMType { P1, P2, P3, P4, P5, P6, Pf, PF };
@@ -59,6 +62,16 @@ private:
     bool read_file_scanline(void* data, int y);
     bool read_file_header();
 
+    // The binary types (P4-P6, Pf, PF) store every scanline in the same
+    // number of bytes at a fixed offset after the header, so they can be
+    // read in any order.
+    bool is_binary() const { return m_pnm_type >= P4; }
+    size_t binary_scanline_bytes() const;
+    // Where scanline y is, relative to the end of the header.
+    size_t binary_scanline_offset(int y) const;
+    // Decode one binary scanline from `src` (the file's bytes) into `data`.
+    void decode_binary_scanline(const unsigned char* src, void* data) const;
+
     void skipComments()
     {
         while (m_remaining.size() && Strutil::parse_char(m_remaining, '#'))
@@ -96,6 +109,10 @@ pnm_imageio_library_version()
 OIIO_EXPORT const char* pnm_input_extensions[] = { "ppm", "pgm", "pbm",
                                                    "pnm", "pfm", nullptr };
 
+OIIO_EXPORT const char* pnm_input_signatures[] = {
+    "5031", "5032", "5033", "5034", "5035", "5036", "5046", "5066", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -180,9 +197,76 @@ unpack_floats(const unsigned char* read, float* write, imagesize_t numsamples,
 
 
 
+size_t
+PNMInput::binary_scanline_bytes() const
+{
+    if (m_pnm_type == P4)
+        return (m_spec.width + 7) / 8;
+    if (m_pnm_type == PF || m_pnm_type == Pf)
+        return size_t(m_spec.nchannels) * 4 * m_spec.width;
+    return m_spec.scanline_bytes();
+}
+
+
+
+size_t
+PNMInput::binary_scanline_offset(int y) const
+{
+    // PFM files are bottom-to-top
+    int file_scanline = y - m_spec.y;
+    if (m_pnm_type == PF || m_pnm_type == Pf)
+        file_scanline = m_spec.height - 1 - file_scanline;
+    return size_t(file_scanline) * binary_scanline_bytes();
+}
+
+
+
+void
+PNMInput::decode_binary_scanline(const unsigned char* src, void* data) const
+{
+    // The file's bytes may be a read-only mapping, so anything that has to
+    // be byte swapped is copied to `data` first and converted there.
+    int nsamples = m_spec.width * m_spec.nchannels;
+    switch (m_pnm_type) {
+    case P4: unpack(src, (unsigned char*)data, nsamples); break;
+    case P5:
+    case P6:
+        if (m_max_val > std::numeric_limits<unsigned char>::max()) {
+            memcpy(data, src, nsamples * sizeof(unsigned short));
+            if (littleendian())
+                swap_endian((unsigned short*)data, nsamples);
+            raw_to_raw((unsigned short*)data, (unsigned short*)data,
+                       nsamples, (unsigned short)m_max_val);
+        } else {
+            raw_to_raw(src, (unsigned char*)data, nsamples,
+                       (unsigned char)m_max_val);
+        }
+        break;
+    case Pf:
+    case PF:
+        memcpy(data, src, nsamples * sizeof(float));
+        unpack_floats((const unsigned char*)data, (float*)data, nsamples,
+                      m_scaling_factor);
+        break;
+    default: break;
+    }
+}
+
+
+
 bool
 PNMInput::read_file_scanline(void* data, int y)
 {
+    if (is_binary()) {
+        size_t offset = binary_scanline_offset(y);
+        if (offset + binary_scanline_bytes() > m_after_header.size())
+            return false;
+        decode_binary_scanline((const unsigned char*)m_after_header.data()
+                                   + offset,
+                               data);
+        return true;
+    }
+
     if (y < m_y_next) {
         // If being asked to backtrack to an earlier scanline, reset all the
         // way to the beginning, right after the header.
@@ -190,33 +274,10 @@ PNMInput::read_file_scanline(void* data, int y)
         m_y_next    = 0;
     }
 
-    std::vector<unsigned char> buf;
     int nsamples = m_spec.width * m_spec.nchannels;
     bool good    = true;
     // If y is farther ahead, skip scanlines to get to it
     for (; good && m_y_next <= y; ++m_y_next) {
-        // PFM files are bottom-to-top, so we need to seek to the right spot
-        if (m_pnm_type == PF || m_pnm_type == Pf) {
-            int file_scanline = m_spec.height - 1 - (y - m_spec.y);
-            auto offset       = file_scanline * m_spec.scanline_bytes();
-            m_remaining       = m_after_header.substr(offset);
-        }
-
-        if ((m_pnm_type >= P4 && m_pnm_type <= P6) || m_pnm_type == PF
-            || m_pnm_type == Pf) {
-            int numbytes;
-            if (m_pnm_type == P4)
-                numbytes = (m_spec.width + 7) / 8;
-            else if (m_pnm_type == PF || m_pnm_type == Pf)
-                numbytes = m_spec.nchannels * 4 * m_spec.width;
-            else
-                numbytes = m_spec.scanline_bytes();
-            if (size_t(numbytes) > m_remaining.size())
-                return false;
-            buf.assign(m_remaining.begin(), m_remaining.begin() + numbytes);
-            m_remaining.remove_prefix(numbytes);
-        }
-
         switch (m_pnm_type) {
         //Ascii
         case P1:
@@ -233,25 +294,6 @@ PNMInput::read_file_scanline(void* data, int y)
                 good &= ascii_to_raw((unsigned char*)data, nsamples,
                                      (unsigned char)m_max_val);
             break;
-        //Raw
-        case P4: unpack(&buf[0], (unsigned char*)data, nsamples); break;
-        case P5:
-        case P6:
-            if (m_max_val > std::numeric_limits<unsigned char>::max()) {
-                if (littleendian())
-                    swap_endian((unsigned short*)&buf[0], nsamples);
-                raw_to_raw((unsigned short*)&buf[0], (unsigned short*)data,
-                           nsamples, (unsigned short)m_max_val);
-            } else {
-                raw_to_raw((unsigned char*)&buf[0], (unsigned char*)data,
-                           nsamples, (unsigned char)m_max_val);
-            }
-            break;
-        //Floating point
-        case Pf:
-        case PF:
-            unpack_floats(&buf[0], (float*)data, nsamples, m_scaling_factor);
-            break;
         default: return false;
         }
     }
@@ -345,11 +387,19 @@ PNMInput::open(const std::string& name, ImageSpec& newspec)
     if (!ioproxy_use_or_open(name))
         return false;
 
-    // Read the whole file's contents into m_file_contents
-    Filesystem::IOProxy* m_io = ioproxy();
-    m_file_contents.resize(m_io->size());
-    m_io->pread(m_file_contents.data(), m_file_contents.size(), 0);
-    m_remaining = string_view(m_file_contents.data(), m_file_contents.size());
+    // If the proxy can show us the whole file in place (memory mapped or
+    // in-memory), parse it from there. Otherwise, read the whole file's
+    // contents into m_file_contents.
+    Filesystem::IOProxy* m_io  = ioproxy();
+    cspan<unsigned char> whole = m_io->view(0, m_io->size());
+    if (whole.size() && whole.size() == m_io->size()) {
+        m_remaining = string_view((const char*)whole.data(), whole.size());
+    } else {
+        m_file_contents.resize(m_io->size());
+        m_io->pread(m_file_contents.data(), m_file_contents.size(), 0);
+        m_remaining = string_view(m_file_contents.data(),
+                                  m_file_contents.size());
+    }
 
     if (!read_file_header())
         return false;
@@ -384,4 +434,43 @@ PNMInput::read_native_scanline(int subimage, int miplevel, int y, int z,
     return true;
 }
 
+
+
+bool
+PNMInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int z, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+
+    // ASCII scanlines have to be parsed in order
+    if (!is_binary())
+        return ImageInput::read_native_scanlines(subimage, miplevel, ybegin,
+                                                 yend, z, data);
+
+    if (z || ybegin < m_spec.y || yend > m_spec.y + m_spec.height)
+        return false;
+    if (ybegin >= yend)
+        return true;
+    size_t nbytes = binary_scanline_bytes();
+    if (binary_scanline_offset(ybegin) + nbytes > m_after_header.size()
+        || binary_scanline_offset(yend - 1) + nbytes > m_after_header.size())
+        return false;
+
+    // The scanlines are all in memory, so decode them in parallel.
+    size_t sbytes = m_spec.scanline_bytes();
+    parallel_for_chunked(
+        ybegin, yend, 0,
+        [&](int64_t b, int64_t e) {
+            for (int64_t y = b; y < e; ++y)
+                decode_binary_scanline(
+                    (const unsigned char*)m_after_header.data()
+                        + binary_scanline_offset(int(y)),
+                    (unsigned char*)data + (y - ybegin) * sbytes);
+        },
+        parallel_options(threads(), Split_Y, 1));
+    return true;
+}
+
 OIIO_PLUGIN_NAMESPACE_END
@@ -9,6 +9,7 @@
 //
 
 
+#include <atomic>
 #include <csetjmp>
 #include <functional>
 #include <map>
@@ -18,8 +19,11 @@
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imagebufalgo.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/tiffutils.h>
 
+#include <zlib.h>
+
 #include "jpeg_memory_src.h"
 #include "psd_pvt.h"
 
@@ -36,7 +40,7 @@ public:
     virtual int supports(string_view feature) const override
     {
         return (feature == "exif" || feature == "iptc" || feature == "thumbnail"
-                || feature == "ioproxy");
+                || feature == "ioproxy" || feature == "sequential_io");
     }
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
     virtual bool open(const std::string& name, ImageSpec& newspec,
@@ -46,6 +50,8 @@ public:
     virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
     virtual bool get_thumbnail(ImageBuf& thumb, int subimage) override
     {
         thumb = m_thumbnail;
@@ -123,12 +129,18 @@ private:
 
     struct ChannelInfo {
         uint32_t row_length;
+        uint32_t height;
         int16_t channel_id;
         uint64_t data_length;
         int64_t data_pos;
         uint16_t compression;
+        //For layers, the RLE lengths and row positions are only filled in
+        //by index_channel when the layer is first read
         std::vector<uint32_t> rle_lengths;
         std::vector<int64_t> row_pos;
+        //ZIP compressed channels can't be read a row at a time, so they
+        //are inflated whole when first read
+        std::vector<char> inflated;
     };
 
     struct Layer {
@@ -201,10 +213,8 @@ private:
     std::vector<std::vector<ChannelInfo*>> m_channels;
     //Alpha Channel Names, not currently used
     std::vector<std::string> m_alpha_names;
-    //Buffers for channel data
+    //Buffers for channel data, holding the rows being read
     std::vector<std::string> m_channel_buffers;
-    //Buffer for RLE conversion
-    std::string m_rle_buffer;
     //Index of the transparent color, if any (for Indexed color mode only)
     int16_t m_transparency_index;
     //Background color
@@ -279,6 +289,8 @@ private:
     bool load_layer_channels(Layer& layer);
     bool load_layer_channel(Layer& layer, ChannelInfo& channel_info);
     bool read_rle_lengths(uint32_t height, std::vector<uint32_t>& rle_lengths);
+    void parse_rle_lengths(const char* src, uint32_t height,
+                           std::vector<uint32_t>& rle_lengths);
 
     //Global Mask Info
     bool load_global_mask_info();
@@ -294,17 +306,25 @@ private:
     void setup();
     void fill_channel_names(ImageSpec& spec, bool transparency);
 
-    //Read a row of channel data
-    bool read_channel_row(const ChannelInfo& channel_info, uint32_t row,
-                          char* data);
-
-    // Interleave channels (RRRGGGBBB -> RGBRGBRGB) while copying from
-    // m_channel_buffers[0..nchans-1] to dst.
-    template<typename T> void interleave_row(T* dst, size_t nchans);
+    //Find the rows of a channel: read its RLE lengths (if it's a layer
+    //channel that hasn't been read before) and compute the row positions
+    bool index_channel(ChannelInfo& channel_info);
+    //Read rows [ybegin,yend) of an indexed channel into data. Only uses
+    //positional reads, so different channels may be read concurrently.
+    bool read_channel_rows(ChannelInfo& channel_info, uint32_t ybegin,
+                           uint32_t yend, char* data);
+    //Inflate a ZIP compressed channel, undoing the prediction if any
+    bool inflate_channel(ChannelInfo& channel_info);
+    //Convert one row from m_channel_buffers to the spec's layout
+    bool convert_row(int row, void* data);
+
+    // Interleave channels (RRRGGGBBB -> RGBRGBRGB) while copying row `row`
+    // of m_channel_buffers[0..nchans-1] to dst.
+    template<typename T> void interleave_row(T* dst, size_t nchans, int row);
 
     //Convert the channel data to RGB
-    bool indexed_to_rgb(char* dst);
-    bool bitmap_to_rgb(char* dst);
+    bool indexed_to_rgb(const char* src, char* dst);
+    bool bitmap_to_rgb(const char* src, char* dst);
 
     // Convert from photoshop native alpha to
     // associated/premultiplied
@@ -413,8 +433,8 @@ private:
 
     int read_pascal_string(std::string& s, uint16_t mod_padding);
 
-    bool decompress_packbits(const char* src, char* dst, uint16_t packed_length,
-                             uint16_t unpacked_length);
+    bool decompress_packbits(const char* src, char* dst, uint32_t packed_length,
+                             uint32_t unpacked_length);
 
     // These are AdditionalInfo entries that, for PSBs, have an 8-byte length
     static const char* additional_info_psb[];
@@ -519,6 +539,8 @@ psd_imageio_library_version()
 OIIO_EXPORT const char* psd_input_extensions[] = { "psd", "pdd", "psb",
                                                    nullptr };
 
+OIIO_EXPORT const char* psd_input_signatures[] = { "38425053", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -603,6 +625,7 @@ PSDInput::open(const std::string& name, ImageSpec& newspec,
     if (config.get_int_attribute("oiio:UnassociatedAlpha", 0) == 1)
         m_keep_unassociated_alpha = true;
 
+    lazy_metadata(config);
     ioproxy_retrieve_from_config(config);
 
     return open(name, newspec);
@@ -629,6 +652,12 @@ PSDInput::seek_subimage(int subimage, int miplevel)
     if (subimage < 0 || subimage >= m_subimage_count)
         return false;
 
+    // Let go of the inflated ZIP channels of the subimage we're leaving
+    if (m_subimage >= 0) {
+        for (ChannelInfo* channel_info : m_channels[m_subimage])
+            if (channel_info)
+                std::vector<char>().swap(channel_info->inflated);
+    }
     m_subimage = subimage;
     m_spec     = m_specs[subimage];
     return true;
@@ -714,53 +743,87 @@ PSDInput::unassalpha_to_assocalpha(int n, void* data)
 
 
 bool
-PSDInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+PSDInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+PSDInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int /*z*/, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
 
-    y -= m_spec.y;
-    if (y < 0 || y > m_spec.height)
+    ybegin -= m_spec.y;
+    yend -= m_spec.y;
+    if (ybegin < 0 || yend > m_spec.height || ybegin > yend)
         return false;
+    int nrows = yend - ybegin;
 
-    if (m_channel_buffers.size() < m_channels[m_subimage].size())
-        m_channel_buffers.resize(m_channels[m_subimage].size());
-
-    int bps = (m_header.depth + 7) / 8;  // bytes per sample
-    OIIO_DASSERT(bps == 1 || bps == 2 || bps == 4);
     std::vector<ChannelInfo*>& channels = m_channels[m_subimage];
     int channel_count                   = (int)channels.size();
+    if (m_channel_buffers.size() < channels.size())
+        m_channel_buffers.resize(channels.size());
+    // Find the rows of each channel first. For layers this is where the
+    // RLE lengths get read, the first time the layer is read.
     for (int c = 0; c < channel_count; ++c) {
-        std::string& buffer       = m_channel_buffers[c];
-        ChannelInfo& channel_info = *channels[c];
-        if (buffer.size() < channel_info.row_length)
-            buffer.resize(channel_info.row_length);
+        if (!channels[c] || !index_channel(*channels[c]))
+            return false;
+        std::string& buffer = m_channel_buffers[c];
+        if (buffer.size() < size_t(channels[c]->row_length) * nrows)
+            buffer.resize(size_t(channels[c]->row_length) * nrows);
+    }
+
+    // Then decompress the channels in parallel
+    std::atomic<bool> ok(true);
+    parallel_for(
+        0, channel_count,
+        [&](int64_t c) {
+            if (!read_channel_rows(*channels[c], ybegin, yend,
+                                   &m_channel_buffers[c][0]))
+                ok = false;
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok) {
+        errorfmt("Failed to read scanlines {}-{} of subimage {}",
+                 ybegin + m_spec.y, yend + m_spec.y - 1, m_subimage);
+        return false;
+    }
 
-        if (!read_channel_row(channel_info, y, &buffer[0]))
+    for (int row = 0; row < nrows; ++row) {
+        if (!convert_row(row, (char*)data + row * m_spec.scanline_bytes()))
             return false;
     }
+    return true;
+}
+
+
+
+bool
+PSDInput::convert_row(int row, void* data)
+{
+    int bps = (m_header.depth + 7) / 8;  // bytes per sample
+    OIIO_DASSERT(bps == 1 || bps == 2 || bps == 4);
     char* dst = (char*)data;
     if (m_WantRaw || m_header.color_mode == ColorMode_RGB
         || m_header.color_mode == ColorMode_Multichannel
         || m_header.color_mode == ColorMode_Grayscale) {
+        size_t nchans = m_channels[m_subimage].size();
         switch (bps) {
-        case 4:
-            interleave_row((float*)dst, m_channels[m_subimage].size());
-            break;
-        case 2:
-            interleave_row((unsigned short*)dst, m_channels[m_subimage].size());
-            break;
-        default:
-            interleave_row((unsigned char*)dst, m_channels[m_subimage].size());
-            break;
+        case 4: interleave_row((float*)dst, nchans, row); break;
+        case 2: interleave_row((unsigned short*)dst, nchans, row); break;
+        default: interleave_row((unsigned char*)dst, nchans, row); break;
         }
     } else if (m_header.color_mode == ColorMode_CMYK) {
         switch (bps) {
         case 4: {
             std::unique_ptr<float[]> cmyk(new float[4 * m_spec.width]);
-            interleave_row(cmyk.get(), 4);
+            interleave_row(cmyk.get(), 4, row);
             cmyk_to_rgb(m_spec.width, cmyk.get(), 4, (float*)dst,
                         m_spec.nchannels);
             break;
@@ -768,7 +831,7 @@ PSDInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
         case 2: {
             std::unique_ptr<unsigned short[]> cmyk(
                 new unsigned short[4 * m_spec.width]);
-            interleave_row(cmyk.get(), 4);
+            interleave_row(cmyk.get(), 4, row);
             cmyk_to_rgb(m_spec.width, cmyk.get(), 4, (unsigned short*)dst,
                         m_spec.nchannels);
             break;
@@ -776,17 +839,19 @@ PSDInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
         default: {
             std::unique_ptr<unsigned char[]> cmyk(
                 new unsigned char[4 * m_spec.width]);
-            interleave_row(cmyk.get(), 4);
+            interleave_row(cmyk.get(), 4, row);
             cmyk_to_rgb(m_spec.width, cmyk.get(), 4, (unsigned char*)dst,
                         m_spec.nchannels);
             break;
         }
         }
     } else if (m_header.color_mode == ColorMode_Indexed) {
-        if (!indexed_to_rgb(dst))
+        size_t row_length = m_channels[m_subimage][0]->row_length;
+        if (!indexed_to_rgb(&m_channel_buffers[0][row * row_length], dst))
             return false;
     } else if (m_header.color_mode == ColorMode_Bitmap) {
-        if (!bitmap_to_rgb(dst))
+        size_t row_length = m_channels[m_subimage][0]->row_length;
+        if (!bitmap_to_rgb(&m_channel_buffers[0][row * row_length], dst))
             return false;
     } else {
         OIIO_ASSERT(0 && "unknown color mode");
@@ -825,7 +890,6 @@ PSDInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     }
 
     return true;
-#undef DEB
 }
 
 
@@ -844,7 +908,6 @@ PSDInput::init()
     m_channels.clear();
     m_alpha_names.clear();
     m_channel_buffers.clear();
-    m_rle_buffer.clear();
     m_transparency_index      = -1;
     m_keep_unassociated_alpha = false;
     m_background_color[0]     = 1.0;
@@ -1190,6 +1253,12 @@ PSDInput::load_resource_1058(uint32_t length)
     if (!ioread(&data[0], length))
         return false;
 
+    if (lazy_metadata()) {
+        cspan<uint8_t> exif((const uint8_t*)data.data(), data.size());
+        defer_metadata("exif", exif, m_composite_attribs);
+        defer_metadata("exif", exif, m_common_attribs);
+        return true;
+    }
     if (!decode_exif(data, m_composite_attribs)
         || !decode_exif(data, m_common_attribs)) {
         errorfmt("Failed to decode Exif data");
@@ -1217,6 +1286,12 @@ PSDInput::load_resource_1060(uint32_t length)
         return false;
 
     // Store the XMP data for the composite and all other subimages
+    if (lazy_metadata()) {
+        cspan<uint8_t> xml((const uint8_t*)data.data(), data.size());
+        defer_metadata("xmp", xml, m_composite_attribs);
+        defer_metadata("xmp", xml, m_common_attribs);
+        return true;
+    }
     if (!decode_xmp(data, m_composite_attribs)
         || !decode_xmp(data, m_common_attribs)) {
         errorfmt("Failed to decode XMP data");
@@ -1514,7 +1589,8 @@ PSDInput::load_layer_channels(Layer& layer)
 bool
 PSDInput::load_layer_channel(Layer& layer, ChannelInfo& channel_info)
 {
-    int64_t start_pos = iotell();
+    channel_info.height     = 0;
+    channel_info.row_length = 0;
     if (channel_info.data_length >= 2) {
         if (!read_bige<uint16_t>(channel_info.compression))
             return false;
@@ -1535,48 +1611,27 @@ PSDInput::load_layer_channel(Layer& layer, ChannelInfo& channel_info)
         height = layer.height;
     }
 
-    channel_info.data_pos = iotell();
-    channel_info.row_pos.resize(height);
-    channel_info.row_length = (width * m_header.depth + 7) / 8;
+    channel_info.data_pos    = iotell();
+    channel_info.data_length = channel_info.data_length - 2;
+    channel_info.height      = height;
+    channel_info.row_length  = (width * m_header.depth + 7) / 8;
     switch (channel_info.compression) {
     case Compression_Raw:
-        if (height) {
-            channel_info.row_pos[0] = channel_info.data_pos;
-            for (uint32_t i = 1; i < height; ++i)
-                channel_info.row_pos[i] = channel_info.row_pos[i - 1]
-                                          + channel_info.row_length;
-        }
         channel_info.data_length = channel_info.row_length * height;
         break;
     case Compression_RLE:
-        // RLE lengths are stored before the channel data
-        if (!read_rle_lengths(height, channel_info.rle_lengths))
-            return false;
-
-        // channel data is located after the RLE lengths
-        channel_info.data_pos = iotell();
-        // subtract the RLE lengths read above
-        channel_info.data_length = channel_info.data_length
-                                   - (channel_info.data_pos - start_pos);
-        if (height) {
-            channel_info.row_pos[0] = channel_info.data_pos;
-            for (uint32_t i = 1; i < height; ++i)
-                channel_info.row_pos[i] = channel_info.row_pos[i - 1]
-                                          + channel_info.rle_lengths[i - 1];
-        }
-        break;
-    // These two aren't currently supported. They would likely
-    // require large changes in the code as they probably don't
-    // support random access like the other modes. I doubt these are
-    // used much and I haven't found any test images.
     case Compression_ZIP:
     case Compression_ZIP_Predict:
+        // The RLE lengths stored before the channel data are only read by
+        // index_channel, when the layer is read, so that opening a file
+        // with many layers doesn't have to visit all of them.
+        break;
     default:
         errorfmt("[Layer Channel] unsupported compression");
         return false;
         ;
     }
-    return ioseek(channel_info.data_length, SEEK_CUR);
+    return ioseek(channel_info.data_pos + channel_info.data_length);
 }
 
 
@@ -1584,15 +1639,34 @@ PSDInput::load_layer_channel(Layer& layer, ChannelInfo& channel_info)
 bool
 PSDInput::read_rle_lengths(uint32_t height, std::vector<uint32_t>& rle_lengths)
 {
+    // Read them all at once rather than one at a time
+    std::unique_ptr<char[]> buf(
+        new char[size_t(height) * (m_header.version == 1 ? 2 : 4)]);
+    if (!ioread(buf.get(), size_t(height) * (m_header.version == 1 ? 2 : 4)))
+        return false;
+    parse_rle_lengths(buf.get(), height, rle_lengths);
+    return true;
+}
+
+
+
+void
+PSDInput::parse_rle_lengths(const char* src, uint32_t height,
+                            std::vector<uint32_t>& rle_lengths)
+{
+    // Big endian, 2 bytes each for PSD and 4 for PSB
+    const unsigned char* p = (const unsigned char*)src;
     rle_lengths.resize(height);
-    bool ok = true;
-    for (uint32_t row = 0; row < height && ok; ++row) {
-        if (m_header.version == 1)
-            ok &= read_bige<uint16_t>(rle_lengths[row]);
-        else
-            ok &= read_bige<uint32_t>(rle_lengths[row]);
+    for (uint32_t row = 0; row < height; ++row) {
+        if (m_header.version == 1) {
+            rle_lengths[row] = uint32_t(p[0]) << 8 | p[1];
+            p += 2;
+        } else {
+            rle_lengths[row] = uint32_t(p[0]) << 24 | uint32_t(p[1]) << 16
+                               | uint32_t(p[2]) << 8 | p[3];
+            p += 4;
+        }
     }
-    return ok;
 }
 
 
@@ -1709,32 +1783,22 @@ PSDInput::load_image_data()
                 return false;
         }
     }
-    bool ok = true;
+    // The channels' data follows, one after the other
+    int64_t pos = iotell();
     for (ChannelInfo& channel_info : m_image_data.channel_info) {
-        channel_info.row_pos.resize(m_header.height);
-        channel_info.data_pos   = iotell();
-        channel_info.row_length = (m_header.width * m_header.depth + 7) / 8;
-        switch (compression) {
-        case Compression_Raw:
-            channel_info.row_pos[0] = channel_info.data_pos;
-            for (uint32_t i = 1; i < m_header.height; ++i)
-                channel_info.row_pos[i] = channel_info.row_pos[i - 1]
-                                          + row_length;
-
-            ok &= ioseek(channel_info.row_pos.back() + row_length);
-            break;
-        case Compression_RLE:
-            channel_info.row_pos[0] = channel_info.data_pos;
-            for (uint32_t i = 1; i < m_header.height; ++i)
-                channel_info.row_pos[i] = channel_info.row_pos[i - 1]
-                                          + channel_info.rle_lengths[i - 1];
-
-            ok &= ioseek(channel_info.row_pos.back()
-                         + channel_info.rle_lengths.back());
-            break;
+        channel_info.data_pos   = pos;
+        channel_info.height     = m_header.height;
+        channel_info.row_length = row_length;
+        if (compression == Compression_RLE) {
+            channel_info.data_length = 0;
+            for (uint32_t len : channel_info.rle_lengths)
+                channel_info.data_length += len;
         }
+        pos += channel_info.data_length;
+        if (!index_channel(channel_info))
+            return false;
     }
-    return ok;
+    return ioseek(pos);
 }
 
 
@@ -1833,48 +1897,162 @@ PSDInput::fill_channel_names(ImageSpec& spec, bool transparency)
 
 
 bool
-PSDInput::read_channel_row(const ChannelInfo& channel_info, uint32_t row,
-                           char* data)
+PSDInput::index_channel(ChannelInfo& channel_info)
 {
-    if (row >= channel_info.row_pos.size())
-        return false;
+    if (channel_info.row_pos.size() == channel_info.height)
+        return true;  // Already done
 
-    bool ok = true;
-    uint32_t rle_length;
-    channel_info.row_pos[row];
-    ok &= ioseek(channel_info.row_pos[row]);
+    uint32_t height = channel_info.height;
     switch (channel_info.compression) {
-    case Compression_Raw: ok &= ioread(data, channel_info.row_length); break;
+    case Compression_Raw: break;
     case Compression_RLE:
-        rle_length = channel_info.rle_lengths[row];
-        if (m_rle_buffer.size() < rle_length)
-            m_rle_buffer.resize(rle_length);
+        if (channel_info.rle_lengths.empty()) {
+            // RLE lengths of layer channels are stored before their data
+            size_t size = size_t(height) * (m_header.version == 1 ? 2 : 4);
+            std::unique_ptr<char[]> buf(new char[size]);
+            if (size > channel_info.data_length
+                || ioproxy()->pread(buf.get(), size, channel_info.data_pos)
+                       != size) {
+                errorfmt("[Layer Channel] failed to read RLE lengths");
+                return false;
+            }
+            parse_rle_lengths(buf.get(), height, channel_info.rle_lengths);
+            channel_info.data_pos += size;
+            channel_info.data_length -= size;
+        }
+        break;
+    case Compression_ZIP:
+    case Compression_ZIP_Predict:
+        // No row positions, the whole channel gets inflated when read
+        break;
+    default: return false;
+    }
+
+    channel_info.row_pos.resize(height);
+    if (height && channel_info.compression == Compression_Raw) {
+        channel_info.row_pos[0] = channel_info.data_pos;
+        for (uint32_t i = 1; i < height; ++i)
+            channel_info.row_pos[i] = channel_info.row_pos[i - 1]
+                                      + channel_info.row_length;
+    } else if (height && channel_info.compression == Compression_RLE) {
+        channel_info.row_pos[0] = channel_info.data_pos;
+        for (uint32_t i = 1; i < height; ++i)
+            channel_info.row_pos[i] = channel_info.row_pos[i - 1]
+                                      + channel_info.rle_lengths[i - 1];
+    }
+    return true;
+}
 
-        ok &= ioread(&m_rle_buffer[0], rle_length);
-        if (!ok)
-            return false;
 
-        if (!decompress_packbits(&m_rle_buffer[0], data, rle_length,
-                                 channel_info.row_length))
-            return false;
 
+bool
+PSDInput::read_channel_rows(ChannelInfo& channel_info, uint32_t ybegin,
+                            uint32_t yend, char* data)
+{
+    if (yend > channel_info.height || ybegin > yend)
+        return false;
+    if (ybegin == yend)
+        return true;
+
+    size_t row_length = channel_info.row_length;
+    size_t size       = row_length * (yend - ybegin);
+    switch (channel_info.compression) {
+    case Compression_Raw:
+        if (ioproxy()->pread(data, size, channel_info.row_pos[ybegin]) != size)
+            return false;
+        break;
+    case Compression_RLE: {
+        // Read all the packed rows at once, then unpack them
+        int64_t begin = channel_info.row_pos[ybegin];
+        int64_t end   = channel_info.row_pos[yend - 1]
+                      + channel_info.rle_lengths[yend - 1];
+        std::unique_ptr<char[]> packed(new char[end - begin]);
+        if (ioproxy()->pread(packed.get(), end - begin, begin)
+            != size_t(end - begin))
+            return false;
+        for (uint32_t y = ybegin; y < yend; ++y) {
+            if (!decompress_packbits(packed.get()
+                                         + (channel_info.row_pos[y] - begin),
+                                     data + (y - ybegin) * row_length,
+                                     channel_info.rle_lengths[y], row_length))
+                return false;
+        }
         break;
     }
-    if (!ok)
-        return false;
+    case Compression_ZIP:
+    case Compression_ZIP_Predict:
+        if (channel_info.inflated.empty() && !inflate_channel(channel_info))
+            return false;
+        // Already in native byte order
+        memcpy(data, &channel_info.inflated[ybegin * row_length], size);
+        return true;
+    default: return false;
+    }
 
     if (!bigendian()) {
         switch (m_header.depth) {
-        case 16: swap_endian((uint16_t*)data, m_spec.width); break;
-        case 32:
-            swap_endian((uint32_t*)data, m_spec.width);
-            // if (row == 131)
-            //     printf ("%x %x %x %x\n",
-            //             ((uint32_t*)data)[0], ((uint32_t*)data)[1],
-            //             ((uint32_t*)data)[2], ((uint32_t*)data)[3]);
-            // convert_type<float,uint32_t> ((float *)&data[0],
-            //                               (uint32_t*)&data[1], m_spec.width);
-            break;
+        case 16: swap_endian((uint16_t*)data, size / 2); break;
+        case 32: swap_endian((uint32_t*)data, size / 4); break;
+        }
+    }
+    return true;
+}
+
+
+
+bool
+PSDInput::inflate_channel(ChannelInfo& channel_info)
+{
+    size_t row_length = channel_info.row_length;
+    size_t size       = row_length * channel_info.height;
+    std::unique_ptr<char[]> packed(new char[channel_info.data_length]);
+    if (ioproxy()->pread(packed.get(), channel_info.data_length,
+                         channel_info.data_pos)
+        != channel_info.data_length)
+        return false;
+    channel_info.inflated.resize(size);
+    uLongf inflated_size = (uLongf)size;
+    if (uncompress((Bytef*)channel_info.inflated.data(), &inflated_size,
+                   (const Bytef*)packed.get(), (uLong)channel_info.data_length)
+            != Z_OK
+        || inflated_size != size) {
+        std::vector<char>().swap(channel_info.inflated);
+        return false;
+    }
+
+    // Undo the prediction, which stores each sample as the difference from
+    // its left neighbor. 16 bit samples are differenced as big endian
+    // values; 32 bit rows are first split into planes of their 1st, 2nd,
+    // 3rd and 4th bytes, which are then differenced as bytes.
+    bool predict = channel_info.compression == Compression_ZIP_Predict;
+    for (uint32_t y = 0; y < channel_info.height; ++y) {
+        char* row = &channel_info.inflated[y * row_length];
+        if (m_header.depth == 16) {
+            uint16_t* r = (uint16_t*)row;
+            size_t w    = row_length / 2;
+            if (!bigendian())
+                swap_endian(r, w);
+            for (size_t x = 1; predict && x < w; ++x)
+                r[x] += r[x - 1];
+        } else if (m_header.depth == 32) {
+            unsigned char* r = (unsigned char*)row;
+            size_t w         = row_length / 4;
+            if (predict) {
+                for (size_t x = 1; x < row_length; ++x)
+                    r[x] += r[x - 1];
+                std::unique_ptr<unsigned char[]> planes(
+                    new unsigned char[row_length]);
+                memcpy(planes.get(), r, row_length);
+                for (size_t x = 0; x < w; ++x)
+                    for (size_t b = 0; b < 4; ++b)
+                        r[4 * x + b] = planes[b * w + x];
+            }
+            if (!bigendian())
+                swap_endian((uint32_t*)r, w);
+        } else if (m_header.depth == 8 && predict) {
+            unsigned char* r = (unsigned char*)row;
+            for (size_t x = 1; x < row_length; ++x)
+                r[x] += r[x - 1];
         }
     }
     return true;
@@ -1884,11 +2062,12 @@ PSDInput::read_channel_row(const ChannelInfo& channel_info, uint32_t row,
 
 template<typename T>
 void
-PSDInput::interleave_row(T* dst, size_t nchans)
+PSDInput::interleave_row(T* dst, size_t nchans, int row)
 {
     OIIO_DASSERT(nchans <= m_channels[m_subimage].size());
     for (size_t c = 0; c < nchans; ++c) {
-        const T* cbuf = (const T*)&(m_channel_buffers[c][0]);
+        size_t row_length = m_channels[m_subimage][c]->row_length;
+        const T* cbuf = (const T*)&(m_channel_buffers[c][row * row_length]);
         for (int x = 0; x < m_spec.width; ++x)
             dst[nchans * x + c] = cbuf[x];
     }
@@ -1897,9 +2076,8 @@ PSDInput::interleave_row(T* dst, size_t nchans)
 
 
 bool
-PSDInput::indexed_to_rgb(char* dst)
+PSDInput::indexed_to_rgb(const char* src, char* dst)
 {
-    char* src = &m_channel_buffers[m_subimage][0];
     // The color table is 768 bytes which is 256 * 3 channels (always RGB)
     char* table = &m_color_data.data[0];
     if (m_transparency_index >= 0) {
@@ -1929,14 +2107,13 @@ PSDInput::indexed_to_rgb(char* dst)
 
 
 bool
-PSDInput::bitmap_to_rgb(char* dst)
+PSDInput::bitmap_to_rgb(const char* src, char* dst)
 {
     for (int i = 0; i < m_spec.width; ++i) {
         int byte = i / 8;
         int bit  = 7 - i % 8;
         char result;
-        char* src = &m_channel_buffers[m_subimage][byte];
-        if (*src & (1 << bit))
+        if (src[byte] & (1 << bit))
             result = 0;
         else
             result = 0xff;
@@ -1995,7 +2172,7 @@ PSDInput::read_pascal_string(std::string& s, uint16_t mod_padding)
 
 bool
 PSDInput::decompress_packbits(const char* src, char* dst,
-                              uint16_t packed_length, uint16_t unpacked_length)
+                              uint32_t packed_length, uint32_t unpacked_length)
 {
     int32_t src_remaining = packed_length;
     int32_t dst_remaining = unpacked_length;
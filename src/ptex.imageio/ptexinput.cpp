@@ -15,6 +15,7 @@ class PtexInput final : public ImageInput {
 public:
     PtexInput()
         : m_ptex(NULL)
+        , m_cache(NULL)
     {
         init();
     }
@@ -27,6 +28,8 @@ public:
                 || feature == "iptc");  // Because of arbitrary_metadata
     }
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
+    virtual bool open(const std::string& name, ImageSpec& newspec,
+                      const ImageSpec& config) override;
     virtual bool close() override;
     virtual int current_subimage(void) const override
     {
@@ -46,6 +49,8 @@ public:
 
 private:
     PtexTexture* m_ptex;
+    PtexCache* m_cache;  // Only in ImageCache mode
+    std::string m_filename;
     int m_subimage;
     int m_miplevel;
     int m_numFaces;
@@ -62,10 +67,26 @@ private:
     {
         if (m_ptex)
             m_ptex->release();
-        m_ptex     = NULL;
+        m_ptex = NULL;
+        if (m_cache)
+            m_cache->release();
+        m_cache    = NULL;
         m_subimage = -1;
         m_miplevel = -1;
     }
+
+    // In ImageCache mode we only hold the texture while using it, so
+    // reacquire it from our private PtexCache if needed.
+    bool acquire();
+    // In ImageCache mode, let go of the texture so that the PtexCache can
+    // prune the face data we read, since the caller keeps its own copy.
+    void release_facedata()
+    {
+        if (m_cache && m_ptex) {
+            m_ptex->release();
+            m_ptex = NULL;
+        }
+    }
 };
 
 
@@ -91,6 +112,8 @@ ptex_imageio_library_version()
 
 OIIO_EXPORT const char* ptex_input_extensions[] = { "ptex", "ptx", nullptr };
 
+OIIO_EXPORT const char* ptex_input_signatures[] = { "50746578", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -98,14 +121,35 @@ OIIO_PLUGIN_EXPORTS_END
 bool
 PtexInput::open(const std::string& name, ImageSpec& newspec)
 {
+    return open(name, newspec, ImageSpec());
+}
+
+
+
+bool
+PtexInput::open(const std::string& name, ImageSpec& newspec,
+                const ImageSpec& config)
+{
+    m_filename = name;
     Ptex::String perr;
-    m_ptex = PtexTexture::open(name.c_str(), perr, true /*premultiply*/);
-    if (!perr.empty()) {
+    if (config.get_int_attribute("ptex:imagecache", 0)) {
+        // The caller caches tiles itself (e.g. ImageCache), so rather than
+        // letting Ptex keep every face it ever reads for as long as the
+        // file is open, read through a PtexCache with a memory budget that
+        // only holds the face data of the read in progress.
+        m_cache = PtexCache::create(1 /*maxFiles*/, 1 << 20 /*maxMem*/,
+                                    true /*premultiply*/);
+        m_ptex  = m_cache->get(name.c_str(), perr);
+    } else {
+        m_ptex = PtexTexture::open(name.c_str(), perr, true /*premultiply*/);
+    }
+    if (!perr.empty() || !m_ptex) {
         if (m_ptex) {
             m_ptex->release();
             m_ptex = NULL;
         }
         errorf("%s", perr.c_str());
+        init();
         return false;
     }
 
@@ -119,6 +163,22 @@ PtexInput::open(const std::string& name, ImageSpec& newspec)
 
 
 
+bool
+PtexInput::acquire()
+{
+    if (m_ptex)
+        return true;
+    Ptex::String perr;
+    m_ptex = m_cache->get(m_filename.c_str(), perr);
+    if (!m_ptex) {
+        errorf("%s", perr.c_str());
+        return false;
+    }
+    return true;
+}
+
+
+
 bool
 PtexInput::seek_subimage(int subimage, int miplevel)
 {
@@ -127,6 +187,8 @@ PtexInput::seek_subimage(int subimage, int miplevel)
 
     if (subimage < 0 || subimage >= m_numFaces)
         return false;
+    if (!acquire())
+        return false;
     m_subimage                  = subimage;
     const Ptex::FaceInfo& pface = m_ptex->getFaceInfo(subimage);
     m_faceres                   = pface.res;
@@ -239,6 +301,7 @@ PtexInput::seek_subimage(int subimage, int miplevel)
     }
 
     facedata->release();
+    release_facedata();
     return true;
 }
 
@@ -267,7 +330,7 @@ PtexInput::read_native_tile(int subimage, int miplevel, int x, int y, int /*z*/,
                             void* data)
 {
     lock_guard lock(*this);
-    if (!seek_subimage(subimage, miplevel))
+    if (!seek_subimage(subimage, miplevel) || !acquire())
         return false;
 
     PtexFaceData* facedata = m_ptex->getData(m_subimage, m_mipfaceres);
@@ -289,6 +352,7 @@ PtexInput::read_native_tile(int subimage, int miplevel, int x, int y, int /*z*/,
     if (m_isTiled)
         f->release();
     facedata->release();
+    release_facedata();
     return ok;
 }
 
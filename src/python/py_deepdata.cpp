@@ -113,6 +113,8 @@ declare_deepdata(py::module& m)
         .def("channelsize",
              [](const DeepData& dd, int c) { return (int)dd.channelsize(c); })
         .def("samplesize", &DeepData::samplesize)
+        .def_property("planar", &DeepData::planar, &DeepData::set_planar)
+        .def("sample_stride", &DeepData::sample_stride)
         .def("deep_value", &DeepData::deep_value, "pixel"_a, "channel"_a,
              "sample"_a)
         .def("deep_value_uint", &DeepData::deep_value_uint, "pixel"_a,
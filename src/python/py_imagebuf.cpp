@@ -13,11 +13,15 @@ namespace PyOpenImageIO {
 
 
 
+// Make an ImageBuf from a numpy array (or other buffer). If `wrap` is
+// true, the ImageBuf uses the array's memory as its pixels (the caller is
+// responsible for keeping the array alive); otherwise it copies them.
 static ImageBuf
-ImageBuf_from_buffer(const py::buffer& buffer)
+ImageBuf_from_buffer(const py::buffer& buffer, bool wrap = false)
 {
     ImageBuf ib;
-    const py::buffer_info info = buffer.request();
+    // Wrapping needs the array to be writable (request() throws if not)
+    const py::buffer_info info = buffer.request(wrap);
     TypeDesc format;
     if (info.format.size())
         format = typedesc_from_python_array_code(info.format);
@@ -33,35 +37,85 @@ ImageBuf_from_buffer(const py::buffer& buffer)
         return ib;
     }
 
+    ImageSpec spec;
+    stride_t xstride, ystride, zstride = AutoStride;
     if (info.ndim == 3) {
         // Assume [y][x][c]
-        ImageSpec spec(info.shape[1], info.shape[0], info.shape[2], format);
-        ib.reset(spec, InitializePixels::No);
-        ib.set_pixels(get_roi(spec), format, info.ptr, info.strides[1],
-                      info.strides[0]);
+        spec    = ImageSpec(info.shape[1], info.shape[0], info.shape[2],
+                            format);
+        xstride = info.strides[1];
+        ystride = info.strides[0];
     } else if (info.ndim == 2) {
         // Assume [y][x], single channel
-        ImageSpec spec(info.shape[1], info.shape[0], 1, format);
-        ib.reset(spec, InitializePixels::No);
-        ib.set_pixels(get_roi(spec), format, info.ptr, info.strides[1],
-                      info.strides[0]);
+        spec    = ImageSpec(info.shape[1], info.shape[0], 1, format);
+        xstride = info.strides[1];
+        ystride = info.strides[0];
     } else if (info.ndim == 4) {
         // Assume volume [z][y][x][c]
-        ImageSpec spec(info.shape[2], info.shape[1], info.shape[3], format);
+        spec = ImageSpec(info.shape[2], info.shape[1], info.shape[3], format);
         spec.depth      = info.shape[0];
         spec.full_depth = spec.depth;
-        ib.reset(spec, InitializePixels::No);
-        ib.set_pixels(get_roi(spec), format, info.ptr, info.strides[2],
-                      info.strides[1], info.strides[0]);
+        xstride         = info.strides[2];
+        ystride         = info.strides[1];
+        zstride         = info.strides[0];
     } else {
         ib.errorfmt(
             "ImageBuf-from-numpy-array must have 2, 3, or 4 dimensions");
+        return ib;
+    }
+    if (wrap) {
+        ib.reset(spec, info.ptr, xstride, ystride, zstride);
+    } else {
+        py::gil_scoped_release gil;
+        ib.reset(spec, InitializePixels::No);
+        ib.set_pixels(get_roi(spec), format, info.ptr, xstride, ystride,
+                      zstride);
     }
     return ib;
 }
 
 
 
+// The Python buffer protocol for an ImageBuf: a view of its pixel memory,
+// in its own data type, indexed as [y][x][channel] (or [z][y][x][channel]
+// for volumes), with no copying. An ImageBuf that can't give a view (deep,
+// or failing to read) gives an empty one and sets its error.
+static py::buffer_info
+ImageBuf_buffer_info(ImageBuf& ib)
+{
+    // Exceptions can't escape a buffer request, so report errors through
+    // the ImageBuf. make_writable() brings pixels backed by an ImageCache
+    // (or shared with a copy) into memory of this ImageBuf's own.
+    const char* code = nullptr;
+    if (ib.deep()) {
+        ib.errorfmt("ImageBuf: deep images have no pixel buffer");
+    } else if (!ib.make_writable(true) || !ib.localpixels()) {
+        if (!ib.has_error())
+            ib.errorfmt("ImageBuf: no pixels");
+    } else if (!(code = buffer_format_code(ib.spec().format))) {
+        ib.errorfmt("ImageBuf: no pixel buffer for type {}", ib.spec().format);
+    }
+    if (!code) {
+        static char empty = 0;
+        return py::buffer_info(&empty, 1, "B", 1, { 0 }, { 1 });
+    }
+
+    const ImageSpec& spec(ib.spec());
+    const py::ssize_t size = py::ssize_t(spec.format.size());
+    std::vector<py::ssize_t> shape, strides;
+    if (spec.depth > 1) {
+        shape.push_back(spec.depth);
+        strides.push_back(ib.z_stride());
+    }
+    shape.insert(shape.end(), { spec.height, spec.width, spec.nchannels });
+    strides.insert(strides.end(), { py::ssize_t(ib.scanline_stride()),
+                                    py::ssize_t(ib.pixel_stride()), size });
+    return py::buffer_info(ib.localpixels(), size, code,
+                           py::ssize_t(shape.size()), shape, strides);
+}
+
+
+
 py::tuple
 ImageBuf_getpixel(const ImageBuf& buf, int x, int y, int z = 0,
                   const std::string& wrapname = "black")
@@ -165,7 +219,12 @@ ImageBuf_get_pixels(const ImageBuf& buf, TypeDesc format, ROI roi = ROI::All())
 
     size_t size = (size_t)roi.npixels() * roi.nchannels() * format.size();
     std::unique_ptr<char[]> data(new char[size]);
-    if (buf.get_pixels(roi, format, &data[0]))
+    bool ok;
+    {
+        py::gil_scoped_release gil;
+        ok = buf.get_pixels(roi, format, &data[0]);
+    }
+    if (ok)
         return make_numpy_array(format, data.release(),
                                 buf.spec().depth > 1 ? 4 : 3, roi.nchannels(),
                                 roi.width(), roi.height(), roi.depth());
@@ -238,7 +297,7 @@ declare_imagebuf(py::module& m)
 {
     using namespace pybind11::literals;
 
-    py::class_<ImageBuf>(m, "ImageBuf")
+    py::class_<ImageBuf>(m, "ImageBuf", py::buffer_protocol())
         .def(py::init<>())
         .def(py::init<const std::string&>())
         .def(py::init<const std::string&, int, int>())
@@ -256,6 +315,13 @@ declare_imagebuf(py::module& m)
                  return ImageBuf_from_buffer(buffer);
              }),
              "buffer"_a)
+        .def_buffer(&ImageBuf_buffer_info)
+        .def_static(
+            "wrap",
+            [](const py::buffer& buffer) {
+                return ImageBuf_from_buffer(buffer, true);
+            },
+            "buffer"_a, py::keep_alive<0, 1>())
         .def("clear", &ImageBuf::clear)
         .def(
             "reset",
@@ -315,6 +381,19 @@ declare_imagebuf(py::module& m)
             },
             "subimage"_a = 0, "miplevel"_a = 0, "force"_a = false,
             "convert"_a = TypeUnknown)
+        .def(
+            "read_async",
+            [](const py::object& self, int subimage, int miplevel, bool force,
+               TypeDesc convert) {
+                ImageBuf& buf(self.cast<ImageBuf&>());
+                return run_async_io(
+                    [&buf, subimage, miplevel, force, convert]() {
+                        return buf.read(subimage, miplevel, force, convert);
+                    },
+                    [](bool ok) -> py::object { return py::bool_(ok); }, self);
+            },
+            "subimage"_a = 0, "miplevel"_a = 0, "force"_a = false,
+            "convert"_a = TypeUnknown)
 
         .def(
             "write",
@@ -324,6 +403,18 @@ declare_imagebuf(py::module& m)
                 return self.write(filename, dtype, fileformat);
             },
             "filename"_a, "dtype"_a = TypeUnknown, "fileformat"_a = "")
+        .def(
+            "write_async",
+            [](const py::object& self, const std::string& filename,
+               TypeDesc dtype, const std::string& fileformat) {
+                ImageBuf& buf(self.cast<ImageBuf&>());
+                return run_async_io(
+                    [&buf, filename, dtype, fileformat]() {
+                        return buf.write(filename, dtype, fileformat);
+                    },
+                    [](bool ok) -> py::object { return py::bool_(ok); }, self);
+            },
+            "filename"_a, "dtype"_a = TypeUnknown, "fileformat"_a = "")
         .def(
             "write",
             [](ImageBuf& self, ImageOutput& out) {
@@ -418,7 +509,11 @@ declare_imagebuf(py::module& m)
         .def("pixelindex", &ImageBuf::pixelindex, "x"_a, "y"_a, "z"_a,
              "check_range"_a = false)
         .def("copy_metadata", &ImageBuf::copy_metadata)
-        .def("copy_pixels", &ImageBuf::copy_pixels)
+        .def("copy_pixels",
+             [](ImageBuf& self, const ImageBuf& src) {
+                 py::gil_scoped_release gil;
+                 return self.copy_pixels(src);
+             })
         .def(
             "copy",
             [](ImageBuf& self, const ImageBuf& src, TypeDesc format) {
@@ -2001,6 +2001,42 @@ IBA_colormatrixtransform_ret(const ImageBuf& src, const py::object& Mobj,
 
 
 
+bool
+IBA_colormatrixtransfer(ImageBuf& dst, const ImageBuf& src,
+                        const py::object& Mobj, const std::string& fromtransfer,
+                        const std::string& totransfer, bool unpremult = true,
+                        ROI roi = ROI::All(), int nthreads = 0)
+{
+    std::vector<float> Mvals;
+    bool ok = py_to_stdvector(Mvals, Mobj);
+    if (!ok || Mvals.size() != 16) {
+        dst.errorfmt(
+            "colormatrixtransfer did not receive 16 elements to make a 4x4 matrix");
+        return false;
+    }
+    py::gil_scoped_release gil;
+    const Imath::M44f* M = (const Imath::M44f*)Mvals.data();
+    return ImageBufAlgo::colormatrixtransfer(dst, src, *M, fromtransfer,
+                                             totransfer, unpremult, roi,
+                                             nthreads);
+}
+
+
+ImageBuf
+IBA_colormatrixtransfer_ret(const ImageBuf& src, const py::object& Mobj,
+                            const std::string& fromtransfer,
+                            const std::string& totransfer,
+                            bool unpremult = true, ROI roi = ROI::All(),
+                            int nthreads = 0)
+{
+    ImageBuf dst;
+    IBA_colormatrixtransfer(dst, src, Mobj, fromtransfer, totransfer,
+                            unpremult, roi, nthreads);
+    return dst;
+}
+
+
+
 bool
 IBA_ociolook(ImageBuf& dst, const ImageBuf& src, const std::string& looks,
              const std::string& from, const std::string& to, bool unpremult,
@@ -2378,6 +2414,23 @@ IBA_histogram(const ImageBuf& src, int channel = 0, int bins = 256,
 }
 
 
+py::object
+IBA_histogram_channels(const ImageBuf& src, int bins = 256, float min = 0.0f,
+                       float max = 1.0f, bool ignore_empty = false,
+                       ROI roi = ROI::All(), int nthreads = 0)
+{
+    std::vector<int> h;
+    {
+        py::gil_scoped_release gil;
+        auto hist = ImageBufAlgo::histogram_channels(src, bins, min, max,
+                                                     ignore_empty, roi,
+                                                     nthreads);
+        h.assign(hist.begin(), hist.end());
+    }
+    return C_to_tuple<int>(h);
+}
+
+
 
 bool
 IBA_capture_image(ImageBuf& dst, int cameranum,
@@ -2798,6 +2851,14 @@ declare_imagebufalgo(py::module& m)
         .def_static("colormatrixtransform", &IBA_colormatrixtransform_ret,
                     "src"_a, "M"_a, "unpremult"_a = true, "roi"_a = ROI::All(),
                     "nthreads"_a = 0)
+        .def_static("colormatrixtransfer", &IBA_colormatrixtransfer, "dst"_a,
+                    "src"_a, "M"_a, "fromtransfer"_a, "totransfer"_a,
+                    "unpremult"_a = true, "roi"_a = ROI::All(),
+                    "nthreads"_a = 0)
+        .def_static("colormatrixtransfer", &IBA_colormatrixtransfer_ret,
+                    "src"_a, "M"_a, "fromtransfer"_a, "totransfer"_a,
+                    "unpremult"_a = true, "roi"_a = ROI::All(),
+                    "nthreads"_a = 0)
 
         .def_static("ociolook", &IBA_ociolook, "dst"_a, "src"_a, "looks"_a,
                     "fromspace"_a, "tospace"_a, "unpremult"_a = true,
@@ -3063,6 +3124,10 @@ declare_imagebufalgo(py::module& m)
                     "bins"_a = 256, "min"_a = 0.0f, "max"_a = 1.0f,
                     "ignore_empty"_a = false, "roi"_a = ROI::All(),
                     "nthreads"_a = 0)
+        .def_static("histogram_channels", &IBA_histogram_channels, "src"_a,
+                    "bins"_a = 256, "min"_a = 0.0f, "max"_a = 1.0f,
+                    "ignore_empty"_a = false, "roi"_a = ROI::All(),
+                    "nthreads"_a = 0)
 
         .def_static("make_texture", &IBA_make_texture_filename, "mode"_a,
                     "filename"_a, "outputfilename"_a, "config"_a = ImageSpec())
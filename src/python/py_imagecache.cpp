@@ -4,6 +4,8 @@
 
 #include "py_oiio.h"
 
+#include <OpenImageIO/parallel.h>
+
 namespace PyOpenImageIO {
 
 // Make a special wrapper to help with the weirdo way we use create/destroy.
@@ -27,24 +29,76 @@ public:
     }
     py::object get_pixels(const std::string& filename, int subimage,
                           int miplevel, int xbegin, int xend, int ybegin,
-                          int yend, int zbegin, int zend, TypeDesc datatype);
+                          int yend, int zbegin, int zend, TypeDesc datatype,
+                          const py::object& out);
+    py::object get_pixels_batch(const std::string& filename, int subimage,
+                                int miplevel, const std::vector<ROI>& rois,
+                                TypeDesc datatype, const py::object& out,
+                                int nthreads);
 };
 
 
 
+// Request a writable view of the array `out` that get_pixels will fill,
+// and check that its element type agrees with `datatype` (if given) and
+// that the channels of each pixel are adjacent.
+static py::buffer_info
+writable_out_buffer(const py::object& out, TypeDesc& datatype)
+{
+    if (!py::isinstance<py::buffer>(out))
+        throw std::invalid_argument("out must be an array or buffer");
+    py::buffer_info info = out.cast<py::buffer>().request(true);
+    TypeDesc format      = typedesc_from_python_array_code(info.format);
+    if (format == TypeUnknown)
+        throw std::invalid_argument(
+            Strutil::fmt::format("out has unsupported format '{}'",
+                                 info.format));
+    if (datatype != TypeUnknown && datatype != format)
+        throw std::invalid_argument(
+            Strutil::fmt::format("out has type {} but {} was requested",
+                                 format, datatype));
+    if (info.ndim < 1 || info.strides[info.ndim - 1] != info.itemsize)
+        throw std::invalid_argument("out must have contiguous channels");
+    datatype = format;
+    return info;
+}
+
+
+
 py::object
 ImageCacheWrap::get_pixels(const std::string& filename_, int subimage,
                            int miplevel, int xbegin, int xend, int ybegin,
-                           int yend, int zbegin, int zend, TypeDesc datatype)
+                           int yend, int zbegin, int zend, TypeDesc datatype,
+                           const py::object& out)
 {
     ustring filename(filename_);
-    if (datatype == TypeUnknown)
-        datatype = TypeFloat;
     int chbegin = 0, chend = 0;
     if (!m_cache->get_image_info(filename, subimage, miplevel,
                                  ustring("channels"), TypeDesc::INT, &chend))
         return py::none();  // couldn't open file
 
+    if (!out.is_none()) {
+        // Fill the caller's array in place, with whatever strides it has
+        py::buffer_info info = writable_out_buffer(out, datatype);
+        int depth            = zend - zbegin;
+        oiio_bufinfo buf(info, chend - chbegin, xend - xbegin, yend - ybegin,
+                         depth, depth > 1 ? 3 : 2);
+        if (buf.format == TypeUnknown)
+            throw std::invalid_argument("out: " + buf.error);
+        bool ok;
+        {
+            py::gil_scoped_release gil;
+            ok = m_cache->get_pixels(filename, subimage, miplevel, xbegin,
+                                     xend, ybegin, yend, zbegin, zend,
+                                     chbegin, chend, buf.format, buf.data,
+                                     buf.xstride, buf.ystride, buf.zstride);
+        }
+        return ok ? out : py::none();
+    }
+
+    if (datatype == TypeUnknown)
+        datatype = TypeFloat;
+
     size_t size = size_t((xend - xbegin) * (yend - ybegin) * (zend - zbegin)
                          * (chend - chbegin) * datatype.size());
     std::unique_ptr<char[]> data(new char[size]);
@@ -65,6 +119,86 @@ ImageCacheWrap::get_pixels(const std::string& filename_, int subimage,
 
 
 
+py::object
+ImageCacheWrap::get_pixels_batch(const std::string& filename_, int subimage,
+                                 int miplevel, const std::vector<ROI>& rois,
+                                 TypeDesc datatype, const py::object& out,
+                                 int nthreads)
+{
+    if (rois.empty())
+        throw std::invalid_argument("get_pixels_batch needs at least one ROI");
+    ustring filename(filename_);
+    int nchannels = 0;
+    if (!m_cache->get_image_info(filename, subimage, miplevel,
+                                 ustring("channels"), TypeDesc::INT,
+                                 &nchannels))
+        return py::none();  // couldn't open file
+
+    // Every crop must have the same size, so that they stack into one
+    // array of shape (n, [depth,] height, width, channels).
+    const ROI& r0(rois[0]);
+    int chbegin = clamp(r0.chbegin, 0, nchannels);
+    int chend   = clamp(r0.chend, chbegin, nchannels);
+    for (const ROI& r : rois)
+        if (r.width() != r0.width() || r.height() != r0.height()
+            || r.depth() != r0.depth() || r.chbegin != r0.chbegin
+            || r.chend != r0.chend)
+            throw std::invalid_argument(
+                "get_pixels_batch: all ROIs must be the same size");
+    bool volume = r0.depth() > 1;
+    std::vector<py::ssize_t> shape { py::ssize_t(rois.size()) };
+    if (volume)
+        shape.push_back(r0.depth());
+    shape.push_back(r0.height());
+    shape.push_back(r0.width());
+    shape.push_back(chend - chbegin);
+
+    py::object result = out;
+    if (result.is_none()) {
+        if (datatype == TypeUnknown)
+            datatype = TypeFloat;
+        const char* code = buffer_format_code(datatype);
+        if (!code)
+            throw std::invalid_argument(Strutil::fmt::format(
+                "get_pixels_batch: unsupported data type {}", datatype));
+        result = py::array(py::dtype(code), shape);
+    }
+    py::buffer_info info = writable_out_buffer(result, datatype);
+    if (info.shape != shape)
+        throw std::invalid_argument(Strutil::fmt::format(
+            "get_pixels_batch: out must have shape ({})",
+            Strutil::join(shape, ", ")));
+
+    char* base       = (char*)info.ptr;
+    int ndim         = int(info.ndim);
+    stride_t xstride = info.strides[ndim - 2];
+    stride_t ystride = info.strides[ndim - 3];
+    stride_t zstride = volume ? info.strides[1] : AutoStride;
+    std::atomic<bool> ok(true);
+    {
+        py::gil_scoped_release gil;
+        ImageCache* ic                = m_cache.get();
+        ImageCache::ImageHandle* file = ic->get_image_handle(filename);
+        auto crop                     = [&](int64_t i) {
+            const ROI& r(rois[i]);
+            if (!ic->get_pixels(file, ic->get_perthread_info(), subimage,
+                                miplevel, r.xbegin, r.xend, r.ybegin, r.yend,
+                                r.zbegin, r.zend, chbegin, chend, datatype,
+                                base + i * info.strides[0], xstride, ystride,
+                                zstride))
+                ok = false;
+        };
+        if (file)
+            parallel_for(0, int64_t(rois.size()), crop,
+                         parallel_options(nthreads, Split_Y, 1));
+        else
+            ok = false;
+    }
+    return ok ? result : py::none();
+}
+
+
+
 void
 declare_imagecache(py::module& m)
 {
@@ -116,7 +250,14 @@ declare_imagecache(py::module& m)
         //      "subimage"_a=0),
         // .def("get_thumbnail", &ImageCacheWrap::get_thumbnail,
         //      "subimage"_a=0)
-        .def("get_pixels", &ImageCacheWrap::get_pixels)
+        .def("get_pixels", &ImageCacheWrap::get_pixels, "filename"_a,
+             "subimage"_a, "miplevel"_a, "xbegin"_a, "xend"_a, "ybegin"_a,
+             "yend"_a, "zbegin"_a = 0, "zend"_a = 1,
+             "datatype"_a = TypeUnknown, "out"_a = py::none())
+        .def("get_pixels_batch", &ImageCacheWrap::get_pixels_batch,
+             "filename"_a, "subimage"_a, "miplevel"_a, "rois"_a,
+             "datatype"_a = TypeUnknown, "out"_a = py::none(),
+             "nthreads"_a = 0)
         // .def("get_tile", &ImageCacheWrap::get_tile)
         // .def("release_tile", &ImageCacheWrap::release_tile)
         // .def("tile_pixels", &ImageCacheWrap::tile_pixels)
@@ -151,7 +292,16 @@ declare_imagecache(py::module& m)
                 py::gil_scoped_release gil;
                 ic.m_cache->invalidate_all(force);
             },
-            "force"_a = false);
+            "force"_a = false)
+        .def(
+            "invalidate_files",
+            [](ImageCacheWrap& ic, const std::vector<std::string>& filenames,
+               bool force) {
+                py::gil_scoped_release gil;
+                std::vector<ustring> names(filenames.begin(), filenames.end());
+                ic.m_cache->invalidate_files(names, force);
+            },
+            "filenames"_a, "force"_a = true);
 }
 
 }  // namespace PyOpenImageIO
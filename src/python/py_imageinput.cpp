@@ -41,6 +41,45 @@ ImageInput_read_image(ImageInput& self, int subimage, int miplevel, int chbegin,
 
 
 
+// Like ImageInput_read_image, but return an asyncio future of the array.
+static py::object
+ImageInput_read_image_async(const py::object& pyself, int subimage,
+                            int miplevel, int chbegin, int chend,
+                            TypeDesc format)
+{
+    ImageInput& self(pyself.cast<ImageInput&>());
+    self.lock();
+    self.seek_subimage(subimage, miplevel);
+    ImageSpec spec;
+    spec.copy_dimensions(self.spec());
+    self.unlock();
+
+    if (format == TypeUnknown)
+        format = spec.format;
+    chend            = clamp(chend, chbegin + 1, spec.nchannels);
+    size_t nchans    = size_t(chend - chbegin);
+    size_t pixelsize = size_t(nchans * format.size());
+    size_t size      = spec.image_pixels() * pixelsize;
+    int dims         = spec.depth > 1 ? 4 : 3;
+    char* data       = new char[size];
+    return run_async_io(
+        [&self, subimage, miplevel, chbegin, chend, format, data]() {
+            return self.read_image(subimage, miplevel, chbegin, chend, format,
+                                   data);
+        },
+        [format, data, dims, nchans, spec](bool ok) -> py::object {
+            if (ok)
+                return make_numpy_array(format, data, dims, nchans,
+                                        spec.width, spec.height, spec.depth);
+            delete[] data;
+            return py::none();
+        },
+        pyself);
+}
+
+
+
+
 static py::object
 ImageInput_read_scanlines(ImageInput& self, int subimage, int miplevel,
                           int ybegin, int yend, int z, int chbegin, int chend,
@@ -194,14 +233,22 @@ declare_imageinput(py::module& m)
             "create",
             [](const std::string& filename,
                const std::string& searchpath) -> py::object {
-                auto in = ImageInput::create(filename, searchpath);
+                std::unique_ptr<ImageInput> in;
+                {
+                    py::gil_scoped_release gil;
+                    in = ImageInput::create(filename, searchpath);
+                }
                 return in ? py::cast(in.release()) : py::none();
             },
             "filename"_a, "plugin_searchpath"_a = "")
         .def_static(
             "open",
             [](const std::string& filename) -> py::object {
-                auto in = ImageInput::open(filename);
+                std::unique_ptr<ImageInput> in;
+                {
+                    py::gil_scoped_release gil;
+                    in = ImageInput::open(filename);
+                }
                 return in ? py::cast(in.release()) : py::none();
             },
             "filename"_a)
@@ -209,13 +256,18 @@ declare_imageinput(py::module& m)
             "open",
             [](const std::string& filename,
                const ImageSpec& config) -> py::object {
-                auto in = ImageInput::open(filename, &config);
+                std::unique_ptr<ImageInput> in;
+                {
+                    py::gil_scoped_release gil;
+                    in = ImageInput::open(filename, &config);
+                }
                 return in ? py::cast(in.release()) : py::none();
             },
             "filename"_a, "config"_a)
         .def("format_name", &ImageInput::format_name)
         .def("valid_file",
              [](ImageInput& self, const std::string& filename) {
+                 py::gil_scoped_release gil;
                  return self.valid_file(filename);
              })
         .def("spec", [](ImageInput& self) { return self.spec(); })
@@ -235,7 +287,11 @@ declare_imageinput(py::module& m)
              [](const ImageInput& self, const std::string& feature) {
                  return self.supports(feature);
              })
-        .def("close", &ImageInput::close)
+        .def("close",
+             [](ImageInput& self) {
+                 py::gil_scoped_release gil;
+                 return self.close();
+             })
         .def("current_subimage", &ImageInput::current_subimage)
         .def("current_miplevel", &ImageInput::current_miplevel)
         .def("seek_subimage",
@@ -268,6 +324,17 @@ declare_imageinput(py::module& m)
                                              format);
             },
             "format"_a = TypeFloat)
+        .def("read_image_async", &ImageInput_read_image_async, "subimage"_a,
+             "miplevel"_a, "chbegin"_a, "chend"_a, "format"_a = TypeFloat)
+        .def(
+            "read_image_async",
+            [](const py::object& self, TypeDesc format) -> py::object {
+                ImageInput& in(self.cast<ImageInput&>());
+                return ImageInput_read_image_async(self, in.current_subimage(),
+                                                   in.current_miplevel(), 0,
+                                                   10000, format);
+            },
+            "format"_a = TypeFloat)
         .def(
             "read_scanline",
             [](ImageInput& self, int y, int z, TypeDesc format) -> py::object {
@@ -367,6 +434,7 @@ declare_imageinput(py::module& m)
         .def(
             "get_thumbnail",
             [](ImageInput& self, int subimage) {
+                py::gil_scoped_release gil;
                 ImageBuf buf;
                 self.get_thumbnail(buf, subimage);
                 return buf;
@@ -251,6 +251,9 @@ declare_imagespec(py::module& m)
             "serialize",
             [](const ImageSpec& spec, const std::string& format,
                const std::string& verbose) {
+                if (Strutil::iequals(format, "binary"))
+                    return py::object(py::bytes(
+                        spec.serialize(ImageSpec::SerialBinary)));
                 ImageSpec::SerialFormat fmt = ImageSpec::SerialText;
                 if (Strutil::iequals(format, "xml"))
                     fmt = ImageSpec::SerialXML;
@@ -261,12 +264,16 @@ declare_imagespec(py::module& m)
                     verb = ImageSpec::SerialDetailed;
                 else if (Strutil::iequals(verbose, "detailedhuman"))
                     verb = ImageSpec::SerialDetailedHuman;
-                return PY_STR(spec.serialize(fmt, verb));
+                return py::object(PY_STR(spec.serialize(fmt, verb)));
             },
             "format"_a = "text", "verbose"_a = "detailed")
         .def("to_xml",
              [](const ImageSpec& spec) { return PY_STR(spec.to_xml()); })
         .def("from_xml", &ImageSpec::from_xml)
+        .def("from_binary",
+             [](ImageSpec& spec, const py::bytes& data) {
+                 return spec.from_binary(std::string(data));
+             })
         .def("valid_tile_range", &ImageSpec::valid_tile_range, "xbegin"_a,
              "xend"_a, "ybegin"_a, "yend"_a, "zbegin"_a, "zend"_a)
         .def("copy_dimensions", &ImageSpec::copy_dimensions, "other"_a)
@@ -31,6 +31,29 @@ python_array_code(TypeDesc format)
 
 
 
+// The Python buffer protocol format code for a pixel data type, or nullptr
+// if there isn't one.
+const char*
+buffer_format_code(TypeDesc format)
+{
+    switch (format.basetype) {
+    case TypeDesc::UINT8: return "B";
+    case TypeDesc::INT8: return "b";
+    case TypeDesc::UINT16: return "H";
+    case TypeDesc::INT16: return "h";
+    case TypeDesc::UINT32: return "I";
+    case TypeDesc::INT32: return "i";
+    case TypeDesc::UINT64: return "Q";
+    case TypeDesc::INT64: return "q";
+    case TypeDesc::HALF: return "e";
+    case TypeDesc::FLOAT: return "f";
+    case TypeDesc::DOUBLE: return "d";
+    default: return nullptr;
+    }
+}
+
+
+
 TypeDesc
 typedesc_from_python_array_code(string_view code)
 {
@@ -185,6 +208,52 @@ oiio_bufinfo::oiio_bufinfo(const py::buffer_info& pybuf, int nchans, int width,
 
 
 
+namespace {
+// Everything that an asynchronous call holds on to until it completes.
+// Its Python objects are only touched with the GIL held.
+struct AsyncIOCall {
+    std::function<bool()> work;
+    std::function<py::object(bool)> finish;
+    py::object loop, future, keepalive;
+};
+}  // namespace
+
+
+
+py::object
+run_async_io(std::function<bool()>&& work,
+             std::function<py::object(bool)>&& finish, py::object keepalive)
+{
+    // Raises RuntimeError if not called from a coroutine
+    py::object asyncio = py::module::import("asyncio");
+    py::object loop    = asyncio.attr("get_running_loop")();
+    AsyncIOCall* call  = new AsyncIOCall { std::move(work), std::move(finish),
+                                           loop, loop.attr("create_future")(),
+                                           std::move(keepalive) };
+    py::object future  = call->future;
+    io_thread_pool()->push([call](int /*id*/) {
+        bool ok = call->work();
+        py::gil_scoped_acquire gil;
+        std::unique_ptr<AsyncIOCall> done(call);
+        try {
+            // Futures may only be resolved by their loop's own thread, and
+            // not at all if they were cancelled in the meantime.
+            py::object future = done->future;
+            py::object result = done->finish(ok);
+            py::cpp_function resolve([future, result]() {
+                if (!future.attr("done")().cast<bool>())
+                    future.attr("set_result")(result);
+            });
+            done->loop.attr("call_soon_threadsafe")(resolve);
+        } catch (const py::error_already_set&) {
+            // The loop was closed before the call finished; nobody waits.
+        }
+    });
+    return future;
+}
+
+
+
 bool
 oiio_attribute_typed(const std::string& name, TypeDesc type,
                      const py::object& obj)
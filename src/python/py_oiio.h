@@ -19,6 +19,7 @@
 #include <Python.h>
 // clang-format on
 
+#include <functional>
 #include <memory>
 
 // Avoid a compiler warning from a duplication in tiffconf.h/pyconfig.h
@@ -118,6 +119,15 @@ void declare_texturesystem (py::module& m);
 // object C_array_to_Python_array (const char *data, TypeDesc type, size_t size);
 const char * python_array_code (TypeDesc format);
 TypeDesc typedesc_from_python_array_code (string_view code);
+const char * buffer_format_code (TypeDesc format);
+
+// Run `work` on the OIIO I/O thread pool, without the GIL, and return an
+// asyncio future of the running event loop that will be resolved with
+// `finish(result of work)`, which is called with the GIL held. The
+// `keepalive` object is held until then, to protect what `work` uses.
+py::object run_async_io (std::function<bool()>&& work,
+                         std::function<py::object(bool)>&& finish,
+                         py::object keepalive);
 
 
 inline std::string
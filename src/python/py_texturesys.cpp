@@ -4,6 +4,10 @@
 
 #include "py_oiio.h"
 
+#include <algorithm>
+
+#include <OpenImageIO/parallel.h>
+
 namespace PyOpenImageIO {
 
 
@@ -65,6 +69,124 @@ public:
 
 
 
+using FloatArray
+    = py::array_t<float, py::array::c_style | py::array::forcecast>;
+
+
+
+// Set the batch options to the values of a TextureOpt, the same for all
+// lanes.
+static void
+batch_options(const TextureOpt& opt, TextureOptBatch& batch)
+{
+    for (int i = 0; i < Tex::BatchWidth; ++i) {
+        batch.sblur[i]  = opt.sblur;
+        batch.tblur[i]  = opt.tblur;
+        batch.rblur[i]  = opt.rblur;
+        batch.swidth[i] = opt.swidth;
+        batch.twidth[i] = opt.twidth;
+        batch.rwidth[i] = opt.rwidth;
+        batch.rnd[i]    = opt.rnd;
+    }
+    batch.firstchannel        = opt.firstchannel;
+    batch.subimage            = opt.subimage;
+    batch.subimagename        = opt.subimagename;
+    batch.swrap               = (Tex::Wrap)opt.swrap;
+    batch.twrap               = (Tex::Wrap)opt.twrap;
+    batch.rwrap               = (Tex::Wrap)opt.rwrap;
+    batch.mipmode             = (Tex::MipMode)opt.mipmode;
+    batch.interpmode          = (Tex::InterpMode)opt.interpmode;
+    batch.anisotropic         = opt.anisotropic;
+    batch.conservative_filter = opt.conservative_filter;
+    batch.fill                = opt.fill;
+    batch.missingcolor        = opt.missingcolor;
+    batch.samples             = opt.samples;
+    batch.site                = opt.site;
+}
+
+
+
+// Look up the batches [bbegin,bend) of n points, whose s, t, dsdx, dtdx,
+// dsdy, dtdy are in `inputs`, writing out[point][channel].
+static void
+texture_batches(TextureSystem* texsys, TextureSystem::TextureHandle* handle,
+                const TextureOptBatch& batchopt, const float* const* inputs,
+                int64_t n, int64_t bbegin, int64_t bend, int nchannels,
+                float* out)
+{
+    TextureSystem::Perthread* thread_info = texsys->get_perthread_info();
+    TextureOptBatch opt(batchopt);
+    alignas(Tex::BatchAlign) float in[6][Tex::BatchWidth];
+    std::vector<float> res(size_t(nchannels) * Tex::BatchWidth);
+    for (int64_t b = bbegin; b < bend; ++b) {
+        int64_t first = b * Tex::BatchWidth;
+        int nlanes    = int(std::min(int64_t(Tex::BatchWidth), n - first));
+        for (int a = 0; a < 6; ++a) {
+            std::copy_n(inputs[a] + first, nlanes, in[a]);
+            std::fill(in[a] + nlanes, in[a] + Tex::BatchWidth, 0.0f);
+        }
+        Tex::RunMask mask = nlanes == Tex::BatchWidth
+                                ? Tex::RunMaskOn
+                                : (Tex::RunMask(1) << nlanes) - 1;
+        texsys->texture(handle, thread_info, opt, mask, in[0], in[1], in[2],
+                        in[3], in[4], in[5], nchannels, res.data());
+        // The batch results are [channel][lane]
+        float* o = out + first * nchannels;
+        for (int i = 0; i < nlanes; ++i)
+            for (int c = 0; c < nchannels; ++c)
+                o[i * nchannels + c] = res[c * Tex::BatchWidth + i];
+    }
+}
+
+
+
+// Texture lookups for arrays of s, t and derivatives, all of the same
+// shape, returning a float array of that shape with an extra axis of
+// nchannels. The points are looked up Tex::BatchWidth at a time with the
+// batched TextureSystem::texture(), with the batches spread across
+// threads and the GIL released.
+static py::object
+TextureSystem_texture_array(const TextureSystemWrap& ts,
+                            const std::string& filename,
+                            const TextureOptWrap& options, const FloatArray& s,
+                            const FloatArray& t, const FloatArray& dsdx,
+                            const FloatArray& dtdx, const FloatArray& dsdy,
+                            const FloatArray& dtdy, int nchannels,
+                            int nthreads)
+{
+    if (!ts.m_texsys || nchannels < 1)
+        return py::none();
+    const int64_t n = int64_t(s.size());
+    for (const FloatArray* a : { &t, &dsdx, &dtdx, &dsdy, &dtdy })
+        if (int64_t(a->size()) != n)
+            throw std::invalid_argument("texture_array: s, t, and the "
+                                        "derivatives must be the same size");
+    std::vector<py::ssize_t> shape(s.shape(), s.shape() + s.ndim());
+    shape.push_back(nchannels);
+    py::array_t<float> result(shape);
+    float* out            = result.mutable_data();
+    const float* inputs[] = { s.data(),    t.data(),    dsdx.data(),
+                              dtdx.data(), dsdy.data(), dtdy.data() };
+    {
+        py::gil_scoped_release gil;
+        TextureSystem* texsys = ts.m_texsys.get();
+        TextureOptBatch batchopt;
+        batch_options(options, batchopt);
+        auto handle = texsys->get_texture_handle(ustring(filename));
+        int64_t nbatches = (n + Tex::BatchWidth - 1) / Tex::BatchWidth;
+        parallel_for_chunked(
+            0, nbatches, 0,
+            [&](int64_t bbegin, int64_t bend) {
+                texture_batches(texsys, handle, batchopt, inputs, n, bbegin,
+                                bend, nchannels, out);
+            },
+            parallel_options(nthreads, Split_Y, 1));
+    }
+    return std::move(result);
+}
+
+
+
 void
 declare_wrap(py::module& m)
 {
@@ -89,7 +211,8 @@ declare_mipmpode(py::module& m)
         .value("NoMIP", Tex::MipMode::NoMIP)
         .value("OneLevel", Tex::MipMode::OneLevel)
         .value("Trilinear", Tex::MipMode::Trilinear)
-        .value("Aniso", Tex::MipMode::Aniso);
+        .value("Aniso", Tex::MipMode::Aniso)
+        .value("EWA", Tex::MipMode::EWA);
 }
 
 
@@ -101,7 +224,8 @@ declare_interpmode(py::module& m)
         .value("Closest", Tex::InterpMode::Closest)
         .value("Bilinear", Tex::InterpMode::Bilinear)
         .value("Bicubic", Tex::InterpMode::Bicubic)
-        .value("SmartBicubic", Tex::InterpMode::SmartBicubic);
+        .value("SmartBicubic", Tex::InterpMode::SmartBicubic)
+        .value("StochasticBilinear", Tex::InterpMode::StochasticBilinear);
 }
 
 
@@ -168,7 +292,16 @@ declare_textureopt(py::module& m)
             [](TextureOptWrap& texopt, const Tex::Wrap wrap) {
                 texopt.rwrap = (TextureOpt::Wrap)wrap;
             })
-        .def_readwrite("rwidth", &TextureOptWrap::rwidth);
+        .def_readwrite("rwidth", &TextureOptWrap::rwidth)
+        .def_readwrite("roughness", &TextureOptWrap::roughness)
+        .def_property(
+            "site",
+            [](const TextureOptWrap& texopt) {
+                return std::string(texopt.site);
+            },
+            [](TextureOptWrap& texopt, const std::string& site) {
+                texopt.site = ustring(site);
+            });
 }
 
 
@@ -230,7 +363,9 @@ declare_texturesystem(py::module& m)
             },
             "filename"_a, "options"_a, "s"_a, "t"_a, "dsdx"_a, "dtdx"_a,
             "dsdy"_a, "dtdy"_a, "nchannels"_a)
-
+        .def("texture_array", &TextureSystem_texture_array, "filename"_a,
+             "options"_a, "s"_a, "t"_a, "dsdx"_a, "dtdx"_a, "dsdy"_a, "dtdy"_a,
+             "nchannels"_a, "nthreads"_a = 0)
 
         .def(
             "texture3d",
@@ -372,6 +507,10 @@ declare_texturesystem(py::module& m)
                 return ts.m_texsys->getstats(level, icstats);
             },
             "level"_a = 1, "icstats"_a = true)
+        .def("lookup_stats_json",
+             [](TextureSystemWrap& ts) {
+                 return ts.m_texsys->lookup_stats_json();
+             })
         .def("reset_stats",
              [](TextureSystemWrap& ts) { return ts.m_texsys->reset_stats(); })
 
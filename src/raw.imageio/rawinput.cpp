@@ -8,7 +8,9 @@
 #include <memory>
 
 #include <OpenImageIO/Imath.h>
+#include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imageio.h>
 #include <OpenImageIO/platform.h>
 #include <OpenImageIO/strutil.h>
@@ -60,7 +62,7 @@ public:
     virtual const char* format_name(void) const override { return "raw"; }
     virtual int supports(string_view feature) const override
     {
-        return (feature == "exif"
+        return (feature == "exif" || feature == "thumbnail"
                 /* not yet? || feature == "iptc"*/);
     }
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
@@ -69,11 +71,14 @@ public:
     virtual bool close() override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool get_thumbnail(ImageBuf& thumb, int subimage) override;
 
 private:
     bool process();
     bool m_process  = true;
     bool m_unpacked = false;
+    bool m_preview  = false;  // deliver the embedded preview instead
+    ImageBuf m_previewbuf;    // the decoded embedded preview
     std::unique_ptr<LibRaw> m_processor;
     libraw_processed_image_t* m_image = nullptr;
     bool m_do_scene_linear_scale      = false;
@@ -86,6 +91,8 @@ private:
     std::string m_make;
 
     bool do_unpack();
+    bool open_preview();
+    bool decode_thumb(const libraw_processed_image_t* thumb, ImageBuf& buf);
 
     // Do the actual open. It expects m_filename and m_config to be set.
     bool open_raw(bool unpack, const std::string& name,
@@ -244,6 +251,8 @@ OIIO_EXPORT const char* raw_input_extensions[]
         "kc2", "mef", "nrw", "qtk", "rw2", "sti", "rwl",  "srw",  "drf",
         "dsc", "ptx", "cap", "iiq", "rwz", "cr3", nullptr };
 
+OIIO_EXPORT const char* raw_input_signatures[] = { nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 namespace {
@@ -373,7 +382,10 @@ RawInput::open(const std::string& name, ImageSpec& newspec,
     // call open_raw passing unpack=false. This will not read the pixels! We
     // will need to close and re-open with unpack=true if and when we need
     // the actual pixel values.
-    bool ok = open_raw(false, m_filename, m_config);
+    m_preview = config.get_int_attribute("raw:preview", 0) != 0;
+    bool ok   = open_raw(false, m_filename, m_config);
+    if (ok && m_preview)
+        ok = open_preview();
     if (ok)
         newspec = m_spec;
     return ok;
@@ -1411,6 +1423,7 @@ RawInput::close()
         m_image = nullptr;
     }
     m_processor.reset();
+    m_previewbuf.reset();
     m_unpacked = false;
     m_process  = true;
     return true;
@@ -1434,6 +1447,116 @@ RawInput::do_unpack()
 
 
 
+bool
+RawInput::decode_thumb(const libraw_processed_image_t* thumb, ImageBuf& buf)
+{
+    if (thumb->type == LIBRAW_IMAGE_BITMAP) {
+        ImageSpec spec(thumb->width, thumb->height, thumb->colors,
+                       thumb->bits == 16 ? TypeUInt16 : TypeUInt8);
+        buf.reset(spec);
+        return buf.set_pixels(ROI::All(), spec.format, thumb->data);
+    }
+    if (thumb->type != LIBRAW_IMAGE_JPEG) {
+        errorfmt("Unsupported embedded preview type");
+        return false;
+    }
+    // Cameras embed plain JPEG files, so let the JPEG reader do the work,
+    // straight from the memory LibRaw extracted them to.
+    Filesystem::IOMemReader memreader((void*)thumb->data, thumb->data_size);
+    auto in = ImageInput::open("preview.jpg", nullptr, &memreader);
+    if (!in) {
+        errorfmt("Could not decode embedded preview: {}", OIIO::geterror());
+        return false;
+    }
+    ImageSpec spec = in->spec();
+    buf.reset(spec);
+    if (!in->read_image(0, 0, 0, spec.nchannels, spec.format,
+                        buf.localpixels())) {
+        errorfmt("Could not decode embedded preview: {}", in->geterror());
+        buf.reset();
+        return false;
+    }
+    return true;
+}
+
+
+
+bool
+RawInput::open_preview()
+{
+    // Pick the largest preview the camera embedded. Older LibRaw only
+    // knows about one, its idea of the best.
+    int ret = LIBRAW_SUCCESS;
+#if LIBRAW_VERSION >= LIBRAW_MAKE_VERSION(0, 21, 0)
+    const auto& list = m_processor->imgdata.thumbs_list;
+    int best         = -1;
+    for (int i = 0; i < list.thumbcount; ++i) {
+        const auto& t = list.thumblist[i];
+        if (best < 0
+            || int(t.twidth) * int(t.theight)
+                   > int(list.thumblist[best].twidth)
+                         * int(list.thumblist[best].theight))
+            best = i;
+    }
+    ret = best >= 0 ? m_processor->unpack_thumb_ex(best)
+                    : m_processor->unpack_thumb();
+#else
+    ret = m_processor->unpack_thumb();
+#endif
+    if (ret != LIBRAW_SUCCESS) {
+        errorfmt("\"{}\" has no usable embedded preview, {}", m_filename,
+                 libraw_strerror(ret));
+        return false;
+    }
+    libraw_processed_image_t* thumb = m_processor->dcraw_make_mem_thumb(&ret);
+    if (!thumb) {
+        errorfmt("LibRaw failed to extract the embedded preview, {}",
+                 libraw_strerror(ret));
+        return false;
+    }
+    bool ok = decode_thumb(thumb, m_previewbuf);
+    LibRaw::dcraw_clear_mem(thumb);
+    if (!ok)
+        return false;
+
+    // Keep all the metadata of the raw image, but describe the preview's
+    // pixels, which are display referred and not reoriented by LibRaw.
+    ImageSpec spec(m_previewbuf.spec().width, m_previewbuf.spec().height,
+                   m_previewbuf.spec().nchannels, m_previewbuf.spec().format);
+    spec.extra_attribs = m_spec.extra_attribs;
+    spec.attribute("oiio:ColorSpace", "sRGB");
+    spec.attribute("Orientation", m_spec.get_int_attribute("raw:Orientation",
+                                                           1));
+    spec.attribute("raw:preview", 1);
+    m_spec = spec;
+    return true;
+}
+
+
+
+bool
+RawInput::get_thumbnail(ImageBuf& thumb, int subimage)
+{
+    lock_guard lock(*this);
+    if (subimage != 0 || !m_processor)
+        return false;
+    // This only reads the embedded thumbnail, the raw data stays packed
+    int ret = m_processor->unpack_thumb();
+    if (ret != LIBRAW_SUCCESS)
+        return false;  // no thumbnail
+    libraw_processed_image_t* img = m_processor->dcraw_make_mem_thumb(&ret);
+    if (!img) {
+        errorfmt("LibRaw failed to extract the thumbnail, {}",
+                 libraw_strerror(ret));
+        return false;
+    }
+    bool ok = decode_thumb(img, thumb);
+    LibRaw::dcraw_clear_mem(img);
+    return ok;
+}
+
+
+
 bool
 RawInput::process()
 {
@@ -1476,6 +1599,11 @@ RawInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
     if (y < 0 || y >= m_spec.height)  // out of range scanline
         return false;
 
+    if (m_preview) {
+        memcpy(data, m_previewbuf.pixeladdr(0, y), m_spec.scanline_bytes());
+        return true;
+    }
+
     if (!m_unpacked)
         do_unpack();
 
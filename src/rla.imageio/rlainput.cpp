@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
@@ -11,7 +13,10 @@
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imagebufalgo_util.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
+#include <OpenImageIO/thread.h>
 
+#include "../libOpenImageIO/rle_pvt.h"
 #include "rla_pvt.h"
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -34,22 +39,26 @@ public:
     virtual bool close() override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
 
 private:
-    std::string m_filename;            ///< Stash the filename
-    FILE* m_file;                      ///< Open image handle
-    RLAHeader m_rla;                   ///< Wavefront RLA header
-    std::vector<unsigned char> m_buf;  ///< Buffer the image pixels
-    int m_subimage;                    ///< Current subimage index
-    std::vector<uint32_t> m_sot;       ///< Scanline offsets table
-    int m_stride;                      ///< Number of bytes a contig pixel takes
+    std::string m_filename;              ///< Stash the filename
+    FILE* m_file;                        ///< Open image handle
+    RLAHeader m_rla;                     ///< Wavefront RLA header
+    int m_subimage;                      ///< Current subimage index
+    std::vector<uint32_t> m_sot;         ///< Scanline offsets table
+    std::vector<uint32_t> m_sot_sorted;  ///< ... in file order
+    uint64_t m_file_size;                ///< Size of the whole file
+    int m_stride;  ///< Number of bytes a contig pixel takes
 
     /// Reset everything to initial state
     ///
     void init()
     {
-        m_file = NULL;
-        m_buf.clear();
+        m_file      = NULL;
+        m_file_size = 0;
+        m_sot_sorted.clear();
     }
 
     /// Helper: raw read, with error detection
@@ -84,17 +93,24 @@ private:
     ///
     inline bool read_header();
 
-    /// Helper: read and decode a single channel group consisting of
-    /// channels [first_channel .. first_channel+num_channels-1], which
-    /// all share the same number of significant bits.
+    /// Helper: decode a single channel group consisting of channels
+    /// [first_channel .. first_channel+num_channels-1], which all share
+    /// the same number of significant bits, from the scanline record at
+    /// `in` (advancing it past the group) into the scanline `buf`. On
+    /// failure, return false and describe the problem in `err`.
     bool decode_channel_group(int first_channel, short num_channels,
-                              short num_bits, int y);
+                              short num_bits, int y, const unsigned char*& in,
+                              const unsigned char* end, unsigned char* buf,
+                              std::string& err) const;
+
+    /// Helper: decode all channel groups of the scanline record at `in`.
+    bool decode_scanline(int y, const unsigned char* in,
+                         const unsigned char* end, unsigned char* buf,
+                         std::string& err) const;
 
-    /// Helper: decode a span of n RLE-encoded bytes from encoded[0..elen-1]
-    /// into buf[0],buf[stride],buf[2*stride]...buf[(n-1)*stride].
-    /// Return the number of encoded bytes we ate to fill buf.
-    size_t decode_rle_span(unsigned char* buf, int n, int stride,
-                           const char* encoded, size_t elen);
+    /// Helper: the offset where the scanline record starting at `start`
+    /// must end: the next record or subimage, or the end of the file.
+    uint64_t record_end(uint64_t start) const;
 
     /// Helper: determine channel TypeDesc
     inline TypeDesc get_channel_typedesc(short chan_type, short chan_bits);
@@ -146,6 +162,8 @@ rla_imageio_library_version()
 
 OIIO_EXPORT const char* rla_input_extensions[] = { "rla", nullptr };
 
+OIIO_EXPORT const char* rla_input_signatures[] = { nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -160,6 +178,7 @@ RLAInput::open(const std::string& name, ImageSpec& newspec)
         errorf("Could not open file \"%s\"", name);
         return false;
     }
+    m_file_size = Filesystem::file_size(name);
 
     // set a bogus subimage index so that seek_subimage actually seeks
     m_subimage = 1;
@@ -250,6 +269,11 @@ RLAInput::seek_subimage(int subimage, int miplevel)
     // Now m_rla holds the header of the requested subimage.  Examine it
     // to fill out our ImageSpec.
 
+    // Scanline records are in the file in the order of the offset table
+    // sorted, which tells us where each one must end.
+    m_sot_sorted = m_sot;
+    std::sort(m_sot_sorted.begin(), m_sot_sorted.end());
+
     if (m_rla.ColorChannelType < 0 || m_rla.ColorChannelType > CT_FLOAT) {
         errorf("Illegal color channel type: %d", m_rla.ColorChannelType);
         return false;
@@ -478,37 +502,11 @@ RLAInput::close()
 
 
 
-size_t
-RLAInput::decode_rle_span(unsigned char* buf, int n, int stride,
-                          const char* encoded, size_t elen)
-{
-    size_t e = 0;
-    while (n > 0 && e < elen) {
-        signed char count = (signed char)encoded[e++];
-        if (count >= 0) {
-            // run count positive: value repeated count+1 times
-            for (int i = 0; i <= count && n; ++i, buf += stride, --n)
-                *buf = encoded[e];
-            ++e;
-        } else {
-            // run count negative: repeat bytes literally
-            count = -count;  // make it positive
-            for (; count && n > 0 && e < elen; --count, buf += stride, --n)
-                *buf = encoded[e++];
-        }
-    }
-    if (n != 0) {
-        errorf("Read error: malformed RLE record");
-        return 0;
-    }
-    return e;
-}
-
-
-
 bool
 RLAInput::decode_channel_group(int first_channel, short num_channels,
-                               short num_bits, int y)
+                               short num_bits, int y, const unsigned char*& in,
+                               const unsigned char* end, unsigned char* buf,
+                               std::string& err) const
 {
     // Some preliminaries -- figure out various sizes and offsets
     int chsize;         // size of the channels in this group, in bytes
@@ -531,51 +529,53 @@ RLAInput::decode_channel_group(int first_channel, short num_channels,
             offset += m_spec.channelformats[i].size();
     }
 
-    // Read the big-endian values into the buffer.
+    // Decode the big-endian values into the buffer.
     // The channels are simply concatenated together in order.
     // Each channel starts with a length, from which we know how many
-    // bytes of encoded RLE data to read.  Then there are RLE
+    // bytes of encoded RLE data follow.  Then there are RLE
     // spans for each 8-bit slice of the channel.
-    std::vector<char> encoded;
     for (int c = 0; c < num_channels; ++c) {
         // Read the length
-        uint16_t lenu16;  // number of encoded bytes
-        if (!read(&lenu16)) {
-            errorf("Read error: couldn't read RLE record length");
+        if (end - in < 2) {
+            err = "Read error: couldn't read RLE record length";
             return false;
         }
-        size_t length = lenu16;
-        // Read the encoded RLE record
-        encoded.resize(length);
-        if (!read(&encoded[0], length)) {
-            errorf("Read error: couldn't read RLE data span");
+        size_t length = (size_t(in[0]) << 8) | in[1];  // big-endian uint16
+        in += 2;
+        // Find the encoded RLE record
+        if (size_t(end - in) < length) {
+            err = "Read error: couldn't read RLE data span";
             return false;
         }
+        const unsigned char* encoded = in;
+        in += length;
 
         if (chantype == TypeDesc::FLOAT) {
             // Special case -- float data is just dumped raw, no RLE
             if (length != size_t(m_spec.width * chsize)) {
-                errorfmt(
+                err = Strutil::fmt::format(
                     "Read error: not enough data in scanline {}, channel {}", y,
                     c);
                 return false;
             }
-            for (int x = 0; x < m_spec.width; ++x)
-                *((float*)&m_buf[offset + c * chsize + x * pixelsize])
-                    = ((float*)&encoded[0])[x];
+            RLE_pvt::copy(&buf[offset + c * chsize], encoded, m_spec.width,
+                          chsize, pixelsize);
             continue;
         }
 
         // Decode RLE -- one pass for each significant byte of the file,
         // which we re-interleave properly by passing the right offsets
-        // and strides to decode_rle_span.
+        // and strides to the decoder.
         size_t eoffset = 0;
         for (int bytes = 0; bytes < chsize && length > 0; ++bytes) {
-            size_t e = decode_rle_span(&m_buf[offset + c * chsize + bytes],
-                                       m_spec.width, pixelsize,
-                                       &encoded[eoffset], length);
-            if (!e)
+            size_t e = RLE_pvt::decode(RLE_pvt::SignedHeader(),
+                                       encoded + eoffset, length,
+                                       &buf[offset + c * chsize + bytes],
+                                       m_spec.width, 1, pixelsize);
+            if (!e) {
+                err = "Read error: malformed RLE record";
                 return false;
+            }
             eoffset += e;
             length -= e;
         }
@@ -586,17 +586,17 @@ RLAInput::decode_channel_group(int first_channel, short num_channels,
     if (littleendian()) {
         if (chsize == 2) {
             if (num_channels == m_spec.nchannels)
-                swap_endian((uint16_t*)&m_buf[0], num_channels * m_spec.width);
+                swap_endian((uint16_t*)&buf[0], num_channels * m_spec.width);
             else
                 for (int x = 0; x < m_spec.width; ++x)
-                    swap_endian((uint16_t*)&m_buf[offset + x * pixelsize],
+                    swap_endian((uint16_t*)&buf[offset + x * pixelsize],
                                 num_channels);
         } else if (chsize == 4 && chantype != TypeDesc::FLOAT) {
             if (num_channels == m_spec.nchannels)
-                swap_endian((uint32_t*)&m_buf[0], num_channels * m_spec.width);
+                swap_endian((uint32_t*)&buf[0], num_channels * m_spec.width);
             else
                 for (int x = 0; x < m_spec.width; ++x)
-                    swap_endian((uint32_t*)&m_buf[offset + x * pixelsize],
+                    swap_endian((uint32_t*)&buf[offset + x * pixelsize],
                                 num_channels);
         }
     }
@@ -610,28 +610,28 @@ RLAInput::decode_channel_group(int first_channel, short num_channels,
     } else if (num_bits == 10) {
         // fast, common case -- use templated hard-code
         for (int x = 0; x < m_spec.width; ++x) {
-            uint16_t* b = (uint16_t*)(&m_buf[offset + x * pixelsize]);
+            uint16_t* b = (uint16_t*)(&buf[offset + x * pixelsize]);
             for (int c = 0; c < num_channels; ++c)
                 b[c] = bit_range_convert<10, 16>(b[c]);
         }
     } else if (num_bits < 8) {
         // rare case, use slow code to make this clause short and simple
         for (int x = 0; x < m_spec.width; ++x) {
-            uint8_t* b = (uint8_t*)&m_buf[offset + x * pixelsize];
+            uint8_t* b = (uint8_t*)&buf[offset + x * pixelsize];
             for (int c = 0; c < num_channels; ++c)
                 b[c] = bit_range_convert(b[c], num_bits, 8);
         }
     } else if (num_bits > 8 && num_bits < 16) {
         // rare case, use slow code to make this clause short and simple
         for (int x = 0; x < m_spec.width; ++x) {
-            uint16_t* b = (uint16_t*)&m_buf[offset + x * pixelsize];
+            uint16_t* b = (uint16_t*)&buf[offset + x * pixelsize];
             for (int c = 0; c < num_channels; ++c)
                 b[c] = bit_range_convert(b[c], num_bits, 16);
         }
     } else if (num_bits > 16 && num_bits < 32) {
         // rare case, use slow code to make this clause short and simple
         for (int x = 0; x < m_spec.width; ++x) {
-            uint32_t* b = (uint32_t*)&m_buf[offset + x * pixelsize];
+            uint32_t* b = (uint32_t*)&buf[offset + x * pixelsize];
             for (int c = 0; c < num_channels; ++c)
                 b[c] = bit_range_convert(b[c], num_bits, 32);
         }
@@ -642,45 +642,121 @@ RLAInput::decode_channel_group(int first_channel, short num_channels,
 
 
 bool
-RLAInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
-                               void* data)
+RLAInput::decode_scanline(int y, const unsigned char* in,
+                          const unsigned char* end, unsigned char* buf,
+                          std::string& err) const
 {
-    lock_guard lock(*this);
-    if (!seek_subimage(subimage, miplevel))
-        return false;
-
-    // By convention, RLA images store their images bottom-to-top.
-    y = m_spec.height - (y - m_spec.y) - 1;
-
-    // Seek to scanline start, based on the scanline offset table
-    fseek(m_file, m_sot[y], SEEK_SET);
-
-    // Now decode and interleave the channels.
     // The channels are non-interleaved (i.e. rrrrrgggggbbbbb...).
     // Color first, then matte, then auxiliary channels.  We can't
     // decode all in one shot, though, because the data type and number
     // of significant bits may be may be different for each class of
     // channels, so we deal with them separately and interleave into
     // our buffer as we go.
-    size_t size = m_spec.scanline_bytes(true);
-    m_buf.resize(size);
     if (m_rla.NumOfColorChannels > 0)
         if (!decode_channel_group(0, m_rla.NumOfColorChannels,
-                                  m_rla.NumOfChannelBits, y))
+                                  m_rla.NumOfChannelBits, y, in, end, buf, err))
             return false;
     if (m_rla.NumOfMatteChannels > 0)
         if (!decode_channel_group(m_rla.NumOfColorChannels,
                                   m_rla.NumOfMatteChannels,
-                                  m_rla.NumOfMatteBits, y))
+                                  m_rla.NumOfMatteBits, y, in, end, buf, err))
             return false;
     if (m_rla.NumOfAuxChannels > 0)
         if (!decode_channel_group(m_rla.NumOfColorChannels
                                       + m_rla.NumOfMatteChannels,
                                   m_rla.NumOfAuxChannels, m_rla.NumOfAuxBits,
-                                  y))
+                                  y, in, end, buf, err))
+            return false;
+    return true;
+}
+
+
+
+uint64_t
+RLAInput::record_end(uint64_t start) const
+{
+    auto next = std::upper_bound(m_sot_sorted.begin(), m_sot_sorted.end(),
+                                 start);
+    uint64_t end = m_file_size;
+    if (next != m_sot_sorted.end())
+        end = *next;
+    else if (m_rla.NextOffset > 0 && uint64_t(m_rla.NextOffset) > start)
+        end = m_rla.NextOffset;
+    return std::min(end, m_file_size);
+}
+
+
+
+bool
+RLAInput::read_native_scanline(int subimage, int miplevel, int y, int z,
+                               void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+RLAInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int /*z*/, void* data)
+{
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+
+    // By convention, RLA images store their images bottom-to-top.
+    auto filerow = [&](int y) { return m_spec.height - (y - m_spec.y) - 1; };
+    for (int y = ybegin; y < yend; ++y) {
+        if (filerow(y) < 0 || filerow(y) >= int(m_sot.size())) {
+            errorfmt("Invalid scanline {}", y);
             return false;
+        }
+    }
+
+    // Read the records of all the scanlines, which the offset table tells
+    // us the locations of, in one go.
+    uint64_t base = std::numeric_limits<uint64_t>::max(), last = 0;
+    for (int y = ybegin; y < yend; ++y) {
+        base = std::min(base, uint64_t(m_sot[filerow(y)]));
+        last = std::max(last, uint64_t(m_sot[filerow(y)]));
+    }
+    uint64_t end = record_end(last);
+    if (end <= last) {
+        errorfmt("Read error: scanline offset {} is past the end of the file",
+                 last);
+        return false;
+    }
+    std::vector<unsigned char> encoded(end - base);
+    fseek(m_file, base, SEEK_SET);
+    if (!read(&encoded[0], encoded.size()))
+        return false;
 
-    memcpy(data, &m_buf[0], size);
+    // Now decode the scanlines in parallel
+    const size_t size = m_spec.scanline_bytes(true);
+    std::atomic<bool> ok(true);
+    std::string err;
+    spin_mutex err_mutex;
+    parallel_for(
+        ybegin, yend,
+        [&](int64_t y) {
+            if (!ok)
+                return;
+            std::string e;
+            const unsigned char* in = &encoded[m_sot[filerow(y)] - base];
+            if (!decode_scanline(filerow(y), in, encoded.data() + encoded.size(),
+                                 (unsigned char*)data + (y - ybegin) * size,
+                                 e)) {
+                spin_lock lock(err_mutex);
+                if (ok)
+                    err = e;
+                ok = false;
+            }
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok) {
+        errorfmt("{}", err);
+        return false;
+    }
     return true;
 }
 
@@ -72,6 +72,8 @@ public:
     virtual bool close(void) override;
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
+    virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                       int yend, int z, void* data) override;
 
 private:
     FILE* m_fd = nullptr;
@@ -96,11 +98,11 @@ private:
     // Return true if ok, false if there was a read error.
     bool read_offset_tables();
 
-    // read channel scanline data from file, uncompress it and save the data to
-    // 'out' buffer; 'out' should be allocate before call to this method.
-    // Return true if ok, false if there was a read error.
-    bool uncompress_rle_channel(int scanline_off, int scanline_len,
-                                unsigned char* out);
+    // uncompress one channel of a scanline from the 'len' bytes at 'in',
+    // writing its values 'stride' bytes apart to 'out'.
+    // Return true if ok, false if the RLE data is corrupt.
+    bool uncompress_rle_channel(const unsigned char* in, size_t len,
+                                unsigned char* out, size_t stride) const;
 
     /// Helper: read, with error detection
     ///
@@ -2,8 +2,15 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 #include "sgi_pvt.h"
+
+#include <atomic>
+#include <limits>
+
 #include <OpenImageIO/dassert.h>
 #include <OpenImageIO/fmath.h>
+#include <OpenImageIO/parallel.h>
+
+#include "../libOpenImageIO/rle_pvt.h"
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
@@ -27,6 +34,8 @@ sgi_input_imageio_create()
 OIIO_EXPORT const char* sgi_input_extensions[] = { "sgi", "rgb",  "rgba", "bw",
                                                    "int", "inta", nullptr };
 
+OIIO_EXPORT const char* sgi_input_signatures[] = { "01da", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -96,6 +105,12 @@ SgiInput::open(const std::string& name, ImageSpec& spec)
         return false;
     }
 
+    if (m_sgi_header.bpc != 1 && m_sgi_header.bpc != 2) {
+        errorfmt("Unknown bytes per channel {}", m_sgi_header.bpc);
+        close();
+        return false;
+    }
+
     m_spec = ImageSpec(m_sgi_header.xsize, height, nchannels,
                        m_sgi_header.bpc == 1 ? TypeDesc::UINT8
                                              : TypeDesc::UINT16);
@@ -115,62 +130,104 @@ SgiInput::open(const std::string& name, ImageSpec& spec)
 
 
 bool
-SgiInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
+SgiInput::read_native_scanline(int subimage, int miplevel, int y, int z,
                                void* data)
+{
+    return read_native_scanlines(subimage, miplevel, y, y + 1, z, data);
+}
+
+
+
+bool
+SgiInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
+                                int yend, int /*z*/, void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
 
-    if (y < 0 || y > m_spec.height)
+    if (ybegin < 0 || yend > m_spec.height || ybegin >= yend)
         return false;
 
-    y = m_spec.height - y - 1;
-
-    ptrdiff_t bpc = m_sgi_header.bpc;
-    std::vector<std::vector<unsigned char>> channeldata(m_spec.nchannels);
-    if (m_sgi_header.storage == sgi_pvt::RLE) {
-        // reading and uncompressing first channel (red in RGBA images)
-        for (int c = 0; c < m_spec.nchannels; ++c) {
-            // offset for this scanline/channel
-            ptrdiff_t off             = y + c * m_spec.height;
-            ptrdiff_t scanline_offset = start_tab[off];
-            ptrdiff_t scanline_length = length_tab[off];
-            channeldata[c].resize(m_spec.width * bpc);
-            uncompress_rle_channel(scanline_offset, scanline_length,
-                                   &(channeldata[c][0]));
+    // Scanlines are stored bottom to top, and each channel is a separate
+    // plane, so our rows are file rows [height-yend, height-ybegin) of
+    // every plane.
+    const int height     = m_spec.height;
+    const int nchannels  = m_spec.nchannels;
+    const int nrows      = yend - ybegin;
+    const int firstrow   = height - yend;
+    const size_t bpc     = m_sgi_header.bpc;
+    const size_t chbytes = m_spec.width * bpc;
+    const bool rle       = (m_sgi_header.storage == sgi_pvt::RLE);
+
+    // Get all the bytes we need with as few reads as possible: the span
+    // covering all the RLE records of these rows, or for uncompressed
+    // files one contiguous block per channel plane.
+    std::vector<unsigned char> buf;
+    uint64_t base = 0;
+    if (rle) {
+        uint64_t end = 0;
+        base         = std::numeric_limits<uint64_t>::max();
+        for (int c = 0; c < nchannels; ++c) {
+            for (int r = firstrow; r < firstrow + nrows; ++r) {
+                size_t off = r + c * height;
+                base       = std::min(base, uint64_t(start_tab[off]));
+                end = std::max(end, uint64_t(start_tab[off]) + length_tab[off]);
+            }
         }
+        if (end > Filesystem::file_size(m_filename)) {
+            error("Corrupt RLE data");
+            return false;
+        }
+        buf.resize(end - base);
+        Filesystem::fseek(m_fd, base, SEEK_SET);
+        if (!fread(buf.data(), 1, buf.size()))
+            return false;
     } else {
-        // non-RLE case -- just read directly into our channel data
-        for (int c = 0; c < m_spec.nchannels; ++c) {
-            // offset for this scanline/channel
-            ptrdiff_t off             = y + c * m_spec.height;
-            ptrdiff_t scanline_offset = sgi_pvt::SGI_HEADER_LEN
-                                        + off * m_spec.width * bpc;
-            Filesystem::fseek(m_fd, scanline_offset, SEEK_SET);
-            channeldata[c].resize(m_spec.width * bpc);
-            if (!fread(&(channeldata[c][0]), 1, m_spec.width * bpc))
+        const size_t planebytes = nrows * chbytes;
+        buf.resize(nchannels * planebytes);
+        for (int c = 0; c < nchannels; ++c) {
+            Filesystem::fseek(m_fd,
+                              sgi_pvt::SGI_HEADER_LEN
+                                  + (firstrow + c * height) * chbytes,
+                              SEEK_SET);
+            if (!fread(&buf[c * planebytes], 1, planebytes))
                 return false;
         }
     }
 
-    if (m_spec.nchannels == 1) {
-        // If just one channel, no interleaving is necessary, just memcpy
-        memcpy(data, &(channeldata[0][0]), channeldata[0].size());
-    } else {
-        unsigned char* cdata = (unsigned char*)data;
-        for (int x = 0; x < m_spec.width; ++x) {
-            for (int c = 0; c < m_spec.nchannels; ++c) {
-                *cdata++ = channeldata[c][x * bpc];
-                if (bpc == 2)
-                    *cdata++ = channeldata[c][x * bpc + 1];
+    // Decode and interleave the channels of each scanline, in parallel.
+    const size_t stride = nchannels * bpc;
+    std::atomic<bool> ok(true);
+    parallel_for(
+        0, nrows,
+        [&](int64_t i) {
+            int r              = height - 1 - (ybegin + int(i));
+            unsigned char* out = (unsigned char*)data + i * nchannels * chbytes;
+            for (int c = 0; c < nchannels && ok; ++c) {
+                if (rle) {
+                    size_t off = r + c * height;
+                    if (!uncompress_rle_channel(&buf[start_tab[off] - base],
+                                                length_tab[off], out + c * bpc,
+                                                stride))
+                        ok = false;
+                } else {
+                    RLE_pvt::copy(out + c * bpc,
+                                  &buf[((c * nrows) + r - firstrow) * chbytes],
+                                  m_spec.width, bpc, stride);
+                }
             }
-        }
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok) {
+        error("Corrupt RLE data");
+        return false;
     }
 
     // Swap endianness if needed
     if (bpc == 2 && littleendian())
-        swap_endian((unsigned short*)data, m_spec.width * m_spec.nchannels);
+        swap_endian((unsigned short*)data,
+                    size_t(m_spec.width) * nchannels * nrows);
 
     return true;
 }
@@ -178,84 +235,21 @@ SgiInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
 
 
 bool
-SgiInput::uncompress_rle_channel(int scanline_off, int scanline_len,
-                                 unsigned char* out)
+SgiInput::uncompress_rle_channel(const unsigned char* in, size_t len,
+                                 unsigned char* out, size_t stride) const
 {
-    int bpc = m_sgi_header.bpc;
-    std::unique_ptr<unsigned char[]> rle_scanline(
-        new unsigned char[scanline_len]);
-    Filesystem::fseek(m_fd, scanline_off, SEEK_SET);
-    if (!fread(&rle_scanline[0], 1, scanline_len))
+    size_t bpc = m_sgi_header.bpc;
+    RLE_pvt::LiteralBitHeader header;
+    header.size = bpc;
+    size_t used = RLE_pvt::decode(header, in, len, out, m_spec.width, bpc,
+                                  stride);
+    if (!used)
         return false;
-    int limit = m_spec.width;
-    int i     = 0;
-    if (bpc == 1) {
-        // 1 bit per channel
-        while (i < scanline_len) {
-            // Read a byte, it is the count.
-            unsigned char value = rle_scanline[i++];
-            int count           = value & 0x7F;
-            // If the count is zero, we're done
-            if (!count)
-                break;
-            // If the high bit is set, we just copy the next 'count' values
-            if (value & 0x80) {
-                while (count--) {
-                    OIIO_DASSERT(i < scanline_len && limit > 0);
-                    *(out++) = rle_scanline[i++];
-                    --limit;
-                }
-            }
-            // If the high bit is zero, we copy the NEXT value, count times
-            else {
-                value = rle_scanline[i++];
-                while (count--) {
-                    OIIO_DASSERT(limit > 0);
-                    *(out++) = value;
-                    --limit;
-                }
-            }
-        }
-    } else if (bpc == 2) {
-        // 2 bits per channel
-        while (i < scanline_len) {
-            // Read a byte, it is the count.
-            unsigned short value = (rle_scanline[i] << 8) | rle_scanline[i + 1];
-            i += 2;
-            int count = value & 0x7F;
-            // If the count is zero, we're done
-            if (!count)
-                break;
-            // If the high bit is set, we just copy the next 'count' values
-            if (value & 0x80) {
-                while (count--) {
-                    OIIO_DASSERT(i + 1 < scanline_len && limit > 0);
-                    *(out++) = rle_scanline[i++];
-                    *(out++) = rle_scanline[i++];
-                    --limit;
-                }
-            }
-            // If the high bit is zero, we copy the NEXT value, count times
-            else {
-                while (count--) {
-                    OIIO_DASSERT(limit > 0);
-                    *(out++) = rle_scanline[i];
-                    *(out++) = rle_scanline[i + 1];
-                    --limit;
-                }
-                i += 2;
-            }
-        }
-    } else {
-        errorfmt("Unknown bytes per channel {}", bpc);
-        return false;
-    }
-    if (i != scanline_len || limit != 0) {
-        error("Corrupt RLE data");
-        return false;
-    }
-
-    return true;
+    // Besides the values, the record may only hold the zero count that
+    // ends the data.
+    bool run;
+    return used == len
+           || (used + bpc == len && header(in + used, run) == 0);
 }
 
 
@@ -9,6 +9,16 @@
 
 
 
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <boost/interprocess/shared_memory_object.hpp>
+#include <boost/interprocess/sync/interprocess_condition.hpp>
+#include <boost/interprocess/sync/interprocess_mutex.hpp>
+#include <boost/interprocess/sync/scoped_lock.hpp>
+
 #include "socket_pvt.h"
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -29,6 +39,259 @@ socket_write(ip::tcp::socket& s, TypeDesc& /*type*/, const void* data, int size)
     return bytes;
 }
 
+
+
+namespace ipc = boost::interprocess;
+
+static const uint32_t shm_magic   = 0x4f49534d;  // "OISM"
+static const uint32_t shm_version = 1;
+
+// Start of the segment. The ring of dirty slot indices and then the slots
+// themselves follow, each 64 byte aligned.
+struct SharedFramebuffer::Header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t nslots;
+    uint32_t ring_size;
+    uint64_t slot_bytes;
+    uint64_t head;  // total number of records ever written to the ring
+    uint32_t done;  // the writer has closed the image
+    ipc::interprocess_mutex mutex;
+    ipc::interprocess_condition cond;
+};
+
+
+
+static size_t
+align64(size_t n)
+{
+    return (n + 63) & ~size_t(63);
+}
+
+
+
+bool
+SharedFramebuffer::layout(const ImageSpec& spec, uint32_t& nslots,
+                          uint64_t& slot_bytes) const
+{
+    int64_t n;
+    if (spec.tile_width) {
+        int tile_depth = std::max(spec.tile_depth, 1);
+        n = int64_t((spec.width + spec.tile_width - 1) / spec.tile_width)
+            * ((spec.height + spec.tile_height - 1) / spec.tile_height)
+            * ((spec.depth + tile_depth - 1) / tile_depth);
+        slot_bytes = spec.tile_bytes();
+    } else {
+        n          = int64_t(spec.height) * std::max(spec.depth, 1);
+        slot_bytes = spec.scanline_bytes();
+    }
+    if (n <= 0 || n > (1 << 30) || slot_bytes == 0)
+        return false;
+    nslots = uint32_t(n);
+    return true;
+}
+
+
+
+int64_t
+SharedFramebuffer::slot_index(int x, int y, int z) const
+{
+    const ImageSpec& spec(m_spec);
+    if (!spec.tile_width)
+        return int64_t(z - spec.z) * spec.height + (y - spec.y);
+    int64_t nx = (spec.width + spec.tile_width - 1) / spec.tile_width;
+    int64_t ny = (spec.height + spec.tile_height - 1) / spec.tile_height;
+    int64_t tz = (z - spec.z) / std::max(spec.tile_depth, 1);
+    return (tz * ny + (y - spec.y) / spec.tile_height) * nx
+           + (x - spec.x) / spec.tile_width;
+}
+
+
+
+bool
+SharedFramebuffer::create(const std::string& name, const ImageSpec& spec)
+{
+    close();
+    uint32_t nslots;
+    uint64_t slot_bytes;
+    if (!layout(spec, nslots, slot_bytes)) {
+        m_error = "unsupported image layout";
+        return false;
+    }
+    uint32_t ring_size  = std::max(1024u, 2 * nslots);
+    size_t ring_offset  = align64(sizeof(Header));
+    size_t pixel_offset = align64(ring_offset + ring_size * sizeof(uint32_t));
+    try {
+        ipc::shared_memory_object shm(ipc::create_only, name.c_str(),
+                                      ipc::read_write);
+        m_name  = name;
+        m_owner = true;
+        shm.truncate(ipc::offset_t(pixel_offset + nslots * slot_bytes));
+        m_region = ipc::mapped_region(shm, ipc::read_write);
+    } catch (const ipc::interprocess_exception& err) {
+        m_error = err.what();
+        close();
+        return false;
+    }
+    char* base           = (char*)m_region.get_address();
+    m_header             = new (base) Header;
+    m_header->magic      = shm_magic;
+    m_header->version    = shm_version;
+    m_header->nslots     = nslots;
+    m_header->ring_size  = ring_size;
+    m_header->slot_bytes = slot_bytes;
+    m_header->head       = 0;
+    m_header->done       = 0;
+    m_ring               = (uint32_t*)(base + ring_offset);
+    m_pixels             = base + pixel_offset;
+    m_spec               = spec;
+    return true;
+}
+
+
+
+bool
+SharedFramebuffer::open(const std::string& name, const ImageSpec& spec)
+{
+    close();
+    uint32_t nslots;
+    uint64_t slot_bytes;
+    if (!layout(spec, nslots, slot_bytes)) {
+        m_error = "unsupported image layout";
+        return false;
+    }
+    try {
+        ipc::shared_memory_object shm(ipc::open_only, name.c_str(),
+                                      ipc::read_write);
+        m_region = ipc::mapped_region(shm, ipc::read_write);
+    } catch (const ipc::interprocess_exception& err) {
+        m_error = err.what();
+        close();
+        return false;
+    }
+    char* base          = (char*)m_region.get_address();
+    Header* hdr         = (Header*)base;
+    size_t ring_offset  = align64(sizeof(Header));
+    size_t pixel_offset = 0;
+    if (m_region.get_size() >= sizeof(Header) && hdr->magic == shm_magic
+        && hdr->version == shm_version && hdr->nslots == nslots
+        && hdr->slot_bytes == slot_bytes)
+        pixel_offset = align64(ring_offset
+                               + hdr->ring_size * sizeof(uint32_t));
+    if (!pixel_offset
+        || m_region.get_size() < pixel_offset + nslots * slot_bytes) {
+        m_error = "shared memory segment does not match the image";
+        close();
+        return false;
+    }
+    m_header = hdr;
+    m_ring   = (uint32_t*)(base + ring_offset);
+    m_pixels = base + pixel_offset;
+    m_spec   = spec;
+    m_dirty.assign(nslots, false);
+    ipc::scoped_lock<ipc::interprocess_mutex> lock(m_header->mutex);
+    m_tail = m_header->head;
+    // Anything written before we attached counts as an update
+    std::fill(m_dirty.begin(), m_dirty.end(), m_tail != 0);
+    return true;
+}
+
+
+
+void
+SharedFramebuffer::unlink()
+{
+    if (m_owner && !m_name.empty())
+        ipc::shared_memory_object::remove(m_name.c_str());
+    m_name.clear();
+}
+
+
+
+void
+SharedFramebuffer::close()
+{
+    unlink();
+    m_region = ipc::mapped_region();
+    m_header = nullptr;
+    m_ring   = nullptr;
+    m_pixels = nullptr;
+    m_owner  = false;
+    m_tail   = 0;
+    m_dirty.clear();
+}
+
+
+
+void
+SharedFramebuffer::write_slot(int64_t slot, const void* data)
+{
+    if (slot < 0 || slot >= m_header->nslots)
+        return;
+    {
+        ipc::scoped_lock<ipc::interprocess_mutex> lock(m_header->mutex);
+        memcpy(m_pixels + slot * m_header->slot_bytes, data,
+               m_header->slot_bytes);
+        m_ring[m_header->head % m_header->ring_size] = uint32_t(slot);
+        ++m_header->head;
+    }
+    m_header->cond.notify_all();
+}
+
+
+
+void
+SharedFramebuffer::mark_done()
+{
+    {
+        ipc::scoped_lock<ipc::interprocess_mutex> lock(m_header->mutex);
+        m_header->done = 1;
+    }
+    m_header->cond.notify_all();
+}
+
+
+
+// Mark the slots named by ring records we haven't seen yet as dirty. If
+// the writer got more than a whole ring ahead of us, we've lost track of
+// what changed, so everything is dirty. Called with the mutex held.
+void
+SharedFramebuffer::drain()
+{
+    uint64_t head = m_header->head;
+    if (head - m_tail > m_header->ring_size) {
+        std::fill(m_dirty.begin(), m_dirty.end(), true);
+    } else {
+        for (; m_tail < head; ++m_tail)
+            m_dirty[m_ring[m_tail % m_header->ring_size]] = true;
+    }
+    m_tail = head;
+}
+
+
+
+void
+SharedFramebuffer::read_slot(int64_t slot, void* data, bool wait,
+                             const std::function<bool()>& alive)
+{
+    if (slot < 0 || slot >= m_header->nslots)
+        return;
+    ipc::scoped_lock<ipc::interprocess_mutex> lock(m_header->mutex);
+    drain();
+    while (wait && !m_dirty[slot] && !m_header->done) {
+        // Wake up now and then to notice a writer that went away without
+        // saying so.
+        auto timeout = boost::posix_time::microsec_clock::universal_time()
+                       + boost::posix_time::milliseconds(100);
+        if (!m_header->cond.timed_wait(lock, timeout) && !alive())
+            break;
+        drain();
+    }
+    memcpy(data, m_pixels + slot * m_header->slot_bytes,
+           m_header->slot_bytes);
+    m_dirty[slot] = false;
+}
+
 }  // namespace socket_pvt
 
 OIIO_PLUGIN_NAMESPACE_END
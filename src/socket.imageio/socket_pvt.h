@@ -10,8 +10,12 @@
 
 #pragma once
 
+#include <cstdint>
+#include <functional>
 #include <map>
 #include <memory>
+#include <string>
+#include <vector>
 
 #include <OpenImageIO/imageio.h>
 
@@ -25,12 +29,73 @@
 #endif
 
 #include <boost/asio.hpp>
+#include <boost/interprocess/mapped_region.hpp>
 
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
 using namespace boost::asio;
 
+namespace socket_pvt {
+
+// Shared memory transport, used instead of sending the pixels over the
+// socket when both ends are on the same host. The writer keeps the whole
+// image in a shared segment, one slot per tile (or per scanline for
+// untiled images), and appends the index of every slot it updates to a
+// ring of dirty records. The reader drains the ring to learn which slots
+// changed since it last read them. Only the handshake goes over the socket.
+class SharedFramebuffer {
+public:
+    SharedFramebuffer() {}
+    ~SharedFramebuffer() { close(); }
+
+    /// Create and map a new segment for images described by `spec`.
+    bool create(const std::string& name, const ImageSpec& spec);
+    /// Map an existing segment created by the other end for `spec`.
+    bool open(const std::string& name, const ImageSpec& spec);
+    /// Unmap the segment, and remove its name if we created it.
+    void close();
+    /// Remove the segment's name. Mappings stay valid until closed.
+    void unlink();
+    bool is_open() const { return m_header != nullptr; }
+
+    /// Slot holding the tile containing (x,y,z), or scanline (y,z).
+    int64_t slot_index(int x, int y, int z) const;
+
+    /// Copy one slot's worth of pixels in and mark the slot dirty.
+    void write_slot(int64_t slot, const void* data);
+    /// Copy one slot's worth of pixels out. If `wait` is true, first block
+    /// until the slot has been updated since we last read it, the writer
+    /// is done, or `alive()` returns false.
+    void read_slot(int64_t slot, void* data, bool wait,
+                   const std::function<bool()>& alive);
+    /// Tell the reader no more updates are coming.
+    void mark_done();
+
+    const std::string& error() const { return m_error; }
+
+private:
+    struct Header;
+    ImageSpec m_spec;
+    boost::interprocess::mapped_region m_region;
+    Header* m_header = nullptr;
+    uint32_t* m_ring = nullptr;
+    char* m_pixels   = nullptr;
+    std::string m_name;
+    std::string m_error;
+    bool m_owner = false;
+    uint64_t m_tail = 0;       // ring records consumed by the reader
+    std::vector<bool> m_dirty; // reader: slots updated since last read
+
+    bool layout(const ImageSpec& spec, uint32_t& nslots,
+                uint64_t& slot_bytes) const;
+    void drain();
+};
+
+}  // namespace socket_pvt
+
+
+
 
 
 class SocketOutput final : public ImageOutput {
@@ -54,6 +119,8 @@ private:
     io_service io;
     ip::tcp::socket socket;
     std::vector<unsigned char> m_scratch;
+    bool m_use_shm;  // Was the shared memory transport requested?
+    socket_pvt::SharedFramebuffer m_shm;
 
     bool connect_to_server(const std::string& name);
     bool send_spec_to_server(const ImageSpec& spec);
@@ -81,9 +148,13 @@ private:
     io_service io;
     ip::tcp::socket socket;
     std::shared_ptr<ip::tcp::acceptor> acceptor;
+    bool m_wait;  // Block shared memory reads until the data is updated
+    socket_pvt::SharedFramebuffer m_shm;
 
     bool accept_connection(const std::string& name);
     bool get_spec_from_client(ImageSpec& spec);
+    bool read_shared(int x, int y, int z, void* data);
+    bool peer_connected();
 
     friend class SocketOutput;
 };
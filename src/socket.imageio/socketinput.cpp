@@ -28,12 +28,15 @@ socket_input_imageio_create()
 
 OIIO_EXPORT const char* socket_input_extensions[] = { "socket", nullptr };
 
+OIIO_EXPORT const char* socket_input_signatures[] = { nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
 
 SocketInput::SocketInput()
     : socket(io)
+    , m_wait(true)
 {
 }
 
@@ -74,6 +77,7 @@ SocketInput::open(const std::string& name, ImageSpec& newspec,
     if (config.get_int_attribute("nowait", 0)) {
         return false;
     }
+    m_wait = config.get_int_attribute("socket:wait", 1) != 0;
 
     if (!(accept_connection(name) && get_spec_from_client(newspec))) {
         return false;
@@ -88,12 +92,14 @@ SocketInput::open(const std::string& name, ImageSpec& newspec,
 
 
 bool
-SocketInput::read_native_scanline(int subimage, int miplevel, int /*y*/,
-                                  int /*z*/, void* data)
+SocketInput::read_native_scanline(int subimage, int miplevel, int y, int z,
+                                  void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
+    if (m_shm.is_open())
+        return read_shared(0, y, z, data);
     try {
         boost::asio::read(socket, buffer(reinterpret_cast<char*>(data),
                                          m_spec.scanline_bytes()));
@@ -111,12 +117,14 @@ SocketInput::read_native_scanline(int subimage, int miplevel, int /*y*/,
 
 
 bool
-SocketInput::read_native_tile(int subimage, int miplevel, int /*x*/, int /*y*/,
-                              int /*z*/, void* data)
+SocketInput::read_native_tile(int subimage, int miplevel, int x, int y, int z,
+                              void* data)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
+    if (m_shm.is_open())
+        return read_shared(x, y, z, data);
     try {
         boost::asio::read(socket, buffer(reinterpret_cast<char*>(data),
                                          m_spec.tile_bytes()));
@@ -133,9 +141,37 @@ SocketInput::read_native_tile(int subimage, int miplevel, int /*x*/, int /*y*/,
 
 
 
+bool
+SocketInput::read_shared(int x, int y, int z, void* data)
+{
+    m_shm.read_slot(m_shm.slot_index(x, y, z), data, m_wait,
+                    [this]() { return peer_connected(); });
+    return true;
+}
+
+
+
+// With the shared memory transport nothing more arrives on the socket
+// after the handshake, so a read that doesn't block tells us whether the
+// writer is still there.
+bool
+SocketInput::peer_connected()
+{
+    boost::system::error_code err;
+    char c;
+    socket.non_blocking(true, err);
+    socket.read_some(buffer(&c, 1), err);
+    boost::system::error_code ignored;
+    socket.non_blocking(false, ignored);
+    return err == error::would_block;
+}
+
+
+
 bool
 SocketInput::close()
 {
+    m_shm.close();
     socket.close();
     return true;
 }
@@ -183,11 +219,22 @@ SocketInput::get_spec_from_client(ImageSpec& spec)
         boost::asio::read(socket, buffer(reinterpret_cast<char*>(&spec_length),
                                          sizeof(boost::uint32_t)));
 
-        char* spec_xml = new char[spec_length + 1];
-        boost::asio::read(socket, buffer(spec_xml, spec_length));
-
-        spec.from_xml(spec_xml);
-        delete[] spec_xml;
+        std::string spec_buf(size_t(spec_length), '\0');
+        boost::asio::read(socket, buffer(&spec_buf[0], spec_buf.size()));
+
+        // Current clients send the spec's SerialBinary encoding, older
+        // ones send XML.
+        if (!spec.from_binary(spec_buf))
+            spec.from_xml(spec_buf.c_str());
+
+        // The client offers a shared memory segment for the pixels by
+        // naming it in the spec. Tell it whether we could map it.
+        std::string shm_name = spec.get_string_attribute("socket:shm");
+        if (!shm_name.empty()) {
+            spec.erase_attribute("socket:shm");
+            char accepted = m_shm.open(shm_name, spec) ? 1 : 0;
+            boost::asio::write(socket, buffer(&accepted, 1));
+        }
     } catch (boost::system::system_error& err) {
         errorf("Error while get_spec_from_client: %s", err.what());
         return false;
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <random>
+
 #include <OpenImageIO/imageio.h>
 
 #include "socket_pvt.h"
@@ -26,6 +28,7 @@ OIIO_PLUGIN_EXPORTS_END
 
 SocketOutput::SocketOutput()
     : socket(io)
+    , m_use_shm(false)
 {
 }
 
@@ -43,26 +46,32 @@ bool
 SocketOutput::open(const std::string& name, const ImageSpec& newspec,
                    OpenMode /*mode*/)
 {
-    if (!(connect_to_server(name) && send_spec_to_server(newspec))) {
-        return false;
-    }
-
     m_next_scanline = 0;
     m_spec          = newspec;
     if (m_spec.format == TypeDesc::UNKNOWN)
         m_spec.set_format(TypeDesc::UINT8);  // Default to 8 bit channels
 
+    if (!(connect_to_server(name) && send_spec_to_server(m_spec))) {
+        return false;
+    }
+
     return true;
 }
 
 
 
 bool
-SocketOutput::write_scanline(int /*y*/, int /*z*/, TypeDesc format,
+SocketOutput::write_scanline(int y, int z, TypeDesc format,
                              const void* data, stride_t xstride)
 {
     data = to_native_scanline(format, data, xstride, m_scratch);
 
+    if (m_shm.is_open()) {
+        m_shm.write_slot(m_shm.slot_index(0, y, z), data);
+        ++m_next_scanline;
+        return true;
+    }
+
     try {
         socket_pvt::socket_write(socket, format, data, m_spec.scanline_bytes());
     } catch (boost::system::system_error& err) {
@@ -81,12 +90,17 @@ SocketOutput::write_scanline(int /*y*/, int /*z*/, TypeDesc format,
 
 
 bool
-SocketOutput::write_tile(int /*x*/, int /*y*/, int /*z*/, TypeDesc format,
+SocketOutput::write_tile(int x, int y, int z, TypeDesc format,
                          const void* data, stride_t xstride, stride_t ystride,
                          stride_t zstride)
 {
     data = to_native_tile(format, data, xstride, ystride, zstride, m_scratch);
 
+    if (m_shm.is_open()) {
+        m_shm.write_slot(m_shm.slot_index(x, y, z), data);
+        return true;
+    }
+
     try {
         socket_pvt::socket_write(socket, format, data, m_spec.tile_bytes());
     } catch (boost::system::system_error& err) {
@@ -105,6 +119,10 @@ SocketOutput::write_tile(int /*x*/, int /*y*/, int /*z*/, TypeDesc format,
 bool
 SocketOutput::close()
 {
+    if (m_shm.is_open()) {
+        m_shm.mark_done();
+        m_shm.close();
+    }
     socket.close();
     return true;
 }
@@ -122,14 +140,34 @@ SocketOutput::copy_image(ImageInput* /*in*/)
 bool
 SocketOutput::send_spec_to_server(const ImageSpec& spec)
 {
-    std::string spec_xml = spec.to_xml();
-    int xml_length       = spec_xml.length();
+    // If asked to, offer the server a shared memory segment for the
+    // pixels by naming it in the spec. A server that can map it answers
+    // with a nonzero byte, otherwise we keep sending pixels over the socket.
+    ImageSpec sent(spec);
+    if (m_use_shm) {
+        std::random_device rd;
+        std::string shm_name = Strutil::sprintf("oiio_socket_%08x%08x", rd(),
+                                                rd());
+        if (m_shm.create(shm_name, spec))
+            sent.attribute("socket:shm", shm_name);
+    }
+    std::string spec_buf = sent.serialize(ImageSpec::SerialBinary);
+    int spec_length      = spec_buf.length();
 
     try {
         boost::asio::write(socket,
-                           buffer(reinterpret_cast<const char*>(&xml_length),
+                           buffer(reinterpret_cast<const char*>(&spec_length),
                                   sizeof(boost::uint32_t)));
-        boost::asio::write(socket, buffer(spec_xml.c_str(), spec_xml.length()));
+        boost::asio::write(socket, buffer(spec_buf.data(), spec_buf.size()));
+        if (m_shm.is_open()) {
+            char accepted = 0;
+            boost::asio::read(socket, buffer(&accepted, 1));
+            // Once the server has mapped it (or declined), the segment no
+            // longer needs a name.
+            m_shm.unlink();
+            if (!accepted)
+                m_shm.close();
+        }
     } catch (boost::system::system_error& err) {
         errorf("Error while send_spec_to_server: %s", err.what());
         return false;
@@ -150,11 +188,13 @@ SocketOutput::connect_to_server(const std::string& name)
     std::string baseurl;
     rest_args["port"] = socket_pvt::default_port;
     rest_args["host"] = socket_pvt::default_host;
+    rest_args["shm"]  = "0";
 
     if (!Strutil::get_rest_arguments(name, baseurl, rest_args)) {
         errorf("Invalid 'open ()' argument: %s", name);
         return false;
     }
+    m_use_shm = Strutil::stoi(rest_args["shm"]) != 0;
 
     try {
         ip::tcp::resolver resolver(io);
@@ -62,6 +62,8 @@ softimage_input_imageio_create()
 
 OIIO_EXPORT const char* softimage_input_extensions[] = { "pic", nullptr };
 
+OIIO_EXPORT const char* softimage_input_signatures[] = { "5380f634", nullptr };
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -2,6 +2,7 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <atomic>
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
@@ -12,9 +13,11 @@
 #include <OpenImageIO/fmath.h>
 #include <OpenImageIO/imagebuf.h>
 #include <OpenImageIO/imageio.h>
+#include <OpenImageIO/parallel.h>
 #include <OpenImageIO/sysutil.h>
 #include <OpenImageIO/typedesc.h>
 
+#include "../libOpenImageIO/rle_pvt.h"
 #include "targa_pvt.h"
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -39,7 +42,8 @@ public:
     virtual const char* format_name(void) const override { return "targa"; }
     virtual int supports(string_view feature) const override
     {
-        return (feature == "thumbnail" || feature == "ioproxy");
+        return (feature == "thumbnail" || feature == "ioproxy"
+                || feature == "sequential_io");
     }
     virtual bool open(const std::string& name, ImageSpec& newspec) override;
     virtual bool open(const std::string& name, ImageSpec& newspec,
@@ -127,6 +131,8 @@ OIIO_EXPORT int targa_imageio_version = OIIO_PLUGIN_VERSION;
 
 OIIO_EXPORT const char* targa_input_extensions[] = { "tga", "tpic", nullptr };
 
+OIIO_EXPORT const char* targa_input_signatures[] = { nullptr };
+
 OIIO_EXPORT const char*
 targa_imageio_library_version()
 {
@@ -699,122 +705,82 @@ TGAInput::readimg()
             return false;
     }
 
-    unsigned char pixel[4] = { 0, 0, 0, 0 };
-    if (m_tga.type < TYPE_PALETTED_RLE) {
-        // uncompressed image data
-        DBG("TGA readimg, reading uncompressed image data\n");
-        unsigned char in[4];
-        for (int64_t y = m_spec.height - 1; y >= 0; y--) {
-            for (int64_t x = 0; x < m_spec.width; x++) {
-                if (!ioread(in, bytespp, 1))
-                    return false;
-                decode_pixel(in, pixel, palette.get(), bytespp, palbytespp);
-                memcpy(m_buf.get() + y * m_spec.width * m_spec.nchannels
-                           + x * m_spec.nchannels,
-                       pixel, m_spec.nchannels);
-            }
-        }
-    } else {
-        // Run Length Encoded image
-        unsigned char in[5];
+    // Read all the pixel data in one go. RLE packets add a header byte
+    // to each run or literal, so the data can't be larger than that for
+    // one-pixel packets, but may of course be much smaller.
+    const bool rle        = (m_tga.type >= TYPE_PALETTED_RLE);
+    const int width       = m_spec.width;
+    const int height      = m_spec.height;
+    const int nc          = m_spec.nchannels;
+    const int64_t npixels = m_spec.image_pixels();
+    int64_t start         = iotell();
+    int64_t avail = std::max(int64_t(ioproxy()->size()) - start, int64_t(0));
+    size_t size   = std::min(size_t(npixels) * (bytespp + (rle ? 1 : 0)),
+                             size_t(avail));
+    if (!rle && size < size_t(npixels) * bytespp) {
+        errorfmt("Read error on \"{}\": hit end of file", m_filename);
+        return false;
+    }
+    std::unique_ptr<unsigned char[]> encoded(new unsigned char[size]);
+    if (size && !ioread(encoded.get(), size))
+        return false;
+
+    // RLE packets may span scanlines, so first find where each one starts,
+    // which only needs a quick pass over the packet headers.
+    std::vector<RLE_pvt::RowStart> rows;
+    if (rle) {
         DBG("TGA readimg, reading RLE image data\n");
-        int packet_size;
-        for (int64_t y = m_spec.height - 1; y >= 0; y--) {
-            for (int64_t x = 0; x < m_spec.width; x++) {
-                if (!ioread(in, 1 + bytespp, 1)) {
-                    DBG("Failed on scanline {}\n", y);
-                    return false;
-                }
-                packet_size = 1 + (in[0] & 0x7f);
-                decode_pixel(&in[1], pixel, palette.get(), bytespp, palbytespp);
-                if (in[0] & 0x80) {  // run length packet
-                    // DBG("[tga] run length packet size {} @ ({},{})\n",
-                    //     packet_size, x, y);
-                    for (int i = 0; i < packet_size; i++) {
-                        memcpy(m_buf.get() + y * m_spec.width * m_spec.nchannels
-                                   + x * m_spec.nchannels,
-                               pixel, m_spec.nchannels);
-                        if (i < packet_size - 1) {
-                            x++;
-                            if (x >= m_spec.width) {
-                                // run spans across multiple scanlines
-                                x = 0;
-                                if (y > 0)
-                                    y--;
-                                else
-                                    goto loop_break;
-                            }
-                        }
-                    }
-                } else {  // non-rle packet
-                    // DBG("[tga] non-run length packet size {} @ ({},{}): [{:d} {:d} {:d} {:d}]\n",
-                    //     packet_size, x, y, pixel[0], pixel[1], pixel[2],
-                    //     pixel[3]);
-                    for (int i = 0; i < packet_size; i++) {
-                        memcpy(m_buf.get() + y * m_spec.width * m_spec.nchannels
-                                   + x * m_spec.nchannels,
-                               pixel, m_spec.nchannels);
-                        if (i < packet_size - 1) {
-                            x++;
-                            if (x >= m_spec.width) {
-                                // run spans across multiple scanlines
-                                x = 0;
-                                if (y > 0)
-                                    y--;
-                                else
-                                    goto loop_break;
-                            }
-                            // skip the packet header byte
-                            if (!ioread(&in[1], bytespp, 1)) {
-                                DBG("Failed on scanline {}\n", y);
-                                return false;
-                            }
-                            decode_pixel(&in[1], pixel, palette.get(), bytespp,
-                                         palbytespp);
-                            // DBG("\t\t@ ({},{}): [{:d} {:d} {:d} {:d}]\n", x, y,
-                            //     pixel[0], pixel[1], pixel[2], pixel[3]);
-                        }
-                    }
-                }
-            }
-        loop_break:;
+        rows.resize(height);
+        if (!RLE_pvt::index_rows(RLE_pvt::RunBitHeader(), encoded.get(), size,
+                                 bytespp, width, height, rows.data())) {
+            errorfmt("Read error on \"{}\": hit end of file", m_filename);
+            return false;
         }
+    } else {
+        DBG("TGA readimg, reading uncompressed image data\n");
     }
 
-    // flip the image, if necessary
-    if (is_palette())
-        bytespp = palbytespp;
-    // Y-flipping is now done in read_native_scanline instead
-    /*if (m_tga.attr & FLAG_Y_FLIP) {
-        //std::cerr << "[tga] y flipping\n";
-
-        std::vector<unsigned char> flip (m_spec.width * bytespp);
-        unsigned char *src, *dst, *tmp = &flip[0];
-        for (int y = 0; y < m_spec.height / 2; y++) {
-            src = m_buf.get() + (m_spec.height - y - 1) * m_spec.width * bytespp;
-            dst = m_buf.get() + y * m_spec.width * bytespp;
-
-            memcpy(tmp, src, m_spec.width * bytespp);
-            memcpy(src, dst, m_spec.width * bytespp);
-            memcpy(dst, tmp, m_spec.width * bytespp);
-        }
-    }*/
-    if (m_tga.attr & FLAG_X_FLIP) {
-        //std::cerr << "[tga] x flipping\n";
-        unsigned char flip[4];
-        int nc             = m_spec.nchannels;
-        int scanline_bytes = m_spec.width * m_spec.nchannels;
-        for (int64_t y = 0; y < m_spec.height; y++) {
-            unsigned char* line = m_buf.get() + y * scanline_bytes;
-            for (int64_t x = 0; x < m_spec.width / 2; x++) {
-                unsigned char* src = line + x * m_spec.nchannels;
-                unsigned char* dst
-                    = line + (m_spec.width - 1 - x) * m_spec.nchannels;
-                memcpy(flip, src, nc);
-                memcpy(src, dst, nc);
-                memcpy(dst, flip, nc);
+    // Now expand and convert the scanlines in parallel. The file stores
+    // them bottom to top (Y-flipping is done in read_native_scanline), and
+    // the pixels of each may be right to left.
+    const size_t scanline_bytes = size_t(width) * nc;
+    const bool xflip            = (m_tga.attr & FLAG_X_FLIP);
+    std::atomic<bool> ok(true);
+    parallel_for_chunked(
+        0, height, 0,
+        [&](int64_t rbegin, int64_t rend) {
+            std::unique_ptr<unsigned char[]> native(
+                rle ? new unsigned char[size_t(width) * bytespp] : nullptr);
+            unsigned char pixel[4] = { 0, 0, 0, 0 };
+            for (int64_t r = rbegin; r < rend && ok; ++r) {
+                unsigned char* in = rle ? native.get()
+                                        : encoded.get() + r * width * bytespp;
+                if (rle) {
+                    if (!RLE_pvt::decode(RLE_pvt::RunBitHeader(),
+                                         encoded.get() + rows[r].offset,
+                                         size - rows[r].offset, in, width,
+                                         bytespp, 0, rows[r].skip)) {
+                        ok = false;
+                        break;
+                    }
+                }
+                unsigned char* out = m_buf.get()
+                                     + (height - 1 - r) * scanline_bytes;
+                ptrdiff_t step = nc;
+                if (xflip) {
+                    out += (width - 1) * nc;
+                    step = -step;
+                }
+                for (int x = 0; x < width; ++x, in += bytespp, out += step) {
+                    decode_pixel(in, pixel, palette.get(), bytespp, palbytespp);
+                    memcpy(out, pixel, nc);
+                }
             }
-        }
+        },
+        parallel_options(threads(), Split_Y, 1));
+    if (!ok) {
+        errorfmt("Corrupt RLE data in \"{}\"", m_filename);
+        return false;
     }
 
     // Convert to associated unless we were requested not to do so.
@@ -824,8 +790,7 @@ TGAInput::readimg()
         // premultiplied. We presume unpremultiplied, but if alpha is zero
         // everywhere, ugh, it's probably meaningless.
         bool alpha0_everywhere = (m_tga_version == 1);
-        int64_t size           = m_spec.image_pixels();
-        for (int64_t i = 0; i < size; ++i) {
+        for (int64_t i = 0; i < npixels; ++i) {
             if (m_buf[i * m_spec.nchannels + m_spec.alpha_channel]) {
                 alpha0_everywhere = false;
                 break;
@@ -833,8 +798,14 @@ TGAInput::readimg()
         }
         if (!alpha0_everywhere) {
             float gamma = m_spec.get_float_attribute("oiio:Gamma", 1.0f);
-            associateAlpha((unsigned char*)m_buf.get(), size, m_spec.nchannels,
-                           m_spec.alpha_channel, gamma);
+            parallel_for_chunked(
+                0, height, 0,
+                [&](int64_t ybegin, int64_t yend) {
+                    associateAlpha(m_buf.get() + ybegin * scanline_bytes,
+                                   (yend - ybegin) * width, nc,
+                                   m_spec.alpha_channel, gamma);
+                },
+                parallel_options(threads(), Split_Y, 1));
         }
     }
 
@@ -74,6 +74,7 @@ static bool gray_to_rgb            = false;
 static bool flip_t                 = false;
 static bool resetstats             = false;
 static bool testhash               = false;
+static bool benchfilters           = false;
 static bool wedge                  = false;
 static int ntrials                 = 1;
 static int testicwrite             = 0;
@@ -82,6 +83,7 @@ static bool test_statquery         = false;
 static bool invalidate_before_iter = true;
 static bool close_before_iter      = false;
 static bool runstats               = false;
+static std::string scenario_list;
 static Imath::M33f xform;
 static std::string texoptions;
 static std::string gtiname;
@@ -152,7 +154,7 @@ getargs(int argc, const char* argv[])
     ap.arg("--mipmode %d:MODE", &mipmode)
       .help("Set mip mode (default: 0 = aniso)");
     ap.arg("--interpmode %d:MODE", &interpmode)
-      .help("Set interp mode (default: 3 = smart bicubic)");
+      .help("Set interp mode (default: 3 = smart bicubic, 4 = stochastic bilinear)");
     ap.arg("--missing %f:R %f:G %f:B", &missing[0], &missing[1], &missing[2])
       .help("Specify missing texture color");
     ap.arg("--autotile %d:TILESIZE", &autotile)
@@ -205,6 +207,8 @@ getargs(int argc, const char* argv[])
       .help("Print and reset statistics on each iteration");
     ap.arg("--testhash", &testhash)
       .help("Test the tile hashing function");
+    ap.arg("--benchfilters", &benchfilters)
+      .help("Benchmark the anisotropic filter modes on a grazing footprint");
     ap.arg("--threadtimes %d:MODE", &threadtimes)
       .help("Do thread timings (arg = workload profile)");
     ap.arg("--trials %d:N", &ntrials)
@@ -221,12 +225,15 @@ getargs(int argc, const char* argv[])
       .help("Test queries of statistics");
     ap.arg("--runstats", &runstats)
       .help("Print runtime statistics");
+    ap.arg("--scenario %s:NAMES", &scenario_list)
+      .help("Run standard throughput workloads over a range of thread counts "
+            "(comma-separated: coherent, incoherent, udim, ground, thrash, or all)");
 
     // clang-format on
     ap.parse(argc, argv);
 
     if (filenames.size() < 1 && !test_construction && !test_getimagespec
-        && !testhash) {
+        && !testhash && scenario_list.empty()) {
         std::cerr << "testtex: Must have at least one input file\n";
         ap.usage();
         exit(EXIT_FAILURE);
@@ -588,7 +595,8 @@ plain_tex_region(ImageBuf& image, ustring filename, Mapping2D mapping,
             opt.twidth = opt.swidth;
         }
         if (mipmode == TextureOpt::MipModeStochasticTrilinear
-            || mipmode == TextureOpt::MipModeStochasticAniso) {
+            || mipmode == TextureOpt::MipModeStochasticAniso
+            || interpmode == TextureOpt::InterpStochasticBilinear) {
             // Hash the pixel coords to get a pseudo-random variant
             constexpr float inv = 1.0f
                                   / float(std::numeric_limits<uint32_t>::max());
@@ -721,7 +729,8 @@ plain_tex_region_batch(ImageBuf& image, ustring filename, Mapping2DWide mapping,
                 }
             }
             if (mipmode == TextureOpt::MipModeStochasticTrilinear
-                || mipmode == TextureOpt::MipModeStochasticAniso) {
+                || mipmode == TextureOpt::MipModeStochasticAniso
+                || interpmode == TextureOpt::InterpStochasticBilinear) {
                 // Hash the pixel coords to get a pseudo-random variant
 #if OIIO_VERSION_GREATER_EQUAL(2, 4, 0)
                 constexpr float inv
@@ -1166,6 +1175,70 @@ test_hash()
 
 
 
+// Time the anisotropic filter modes on a strongly anisotropic footprint,
+// like a ground plane seen at a grazing angle.
+static void
+benchmark_aniso_filters(ustring filename)
+{
+    ImageSpec spec;
+    if (!texsys->get_imagespec(filename, 0, spec)) {
+        Strutil::fprintf(std::cerr, "Unexpected error: %s\n",
+                         texsys->geterror());
+        return;
+    }
+    TextureSystem::Perthread* perthread_info = texsys->get_perthread_info();
+    TextureSystem::TextureHandle* handle
+        = texsys->get_texture_handle(filename, perthread_info);
+    int nchannels = nchannels_override ? nchannels_override : 3;
+    std::vector<float> result(std::max(nchannels, 4));
+
+    // Ellipse 30 degrees off horizontal, with the minor axis a few texels
+    // wide at the finest level, and --anisoaspect (default 16) to 1.
+    float aspect = anisoaspect > 1.001f ? anisoaspect : 16.0f;
+    float fw = 3.0f / spec.width, fh = 3.0f / spec.height;
+    float xs = sqrtf(3.0) / 2.0, ys = 0.5f;
+    float dsdx = fw * xs * aspect, dtdx = fh * ys * aspect;
+    float dsdy = fw * ys, dtdy = -fh * xs;
+
+    struct FilterMode {
+        const char* name;
+        TextureOpt::MipMode mipmode;
+        TextureOpt::InterpMode interpmode;
+    };
+    static const FilterMode modes[] = {
+        { "aniso, bilinear probes", TextureOpt::MipModeAniso,
+          TextureOpt::InterpBilinear },
+        { "aniso, smart bicubic probes", TextureOpt::MipModeAniso,
+          TextureOpt::InterpSmartBicubic },
+        { "stochastic aniso, single tap", TextureOpt::MipModeStochasticAniso,
+          TextureOpt::InterpStochasticBilinear },
+        { "EWA", TextureOpt::MipModeEWA, TextureOpt::InterpBilinear },
+    };
+    constexpr float inv = 1.0f / float(std::numeric_limits<uint32_t>::max());
+    std::cout << "Benchmarking anisotropic filters, aspect " << aspect
+              << ":\n";
+    Benchmarker bench;
+    bench.units(Benchmarker::Unit::ns);
+    for (const FilterMode& mode : modes) {
+        TextureOpt opt;
+        initialize_opt(opt);
+        opt.mipmode    = mode.mipmode;
+        opt.interpmode = mode.interpmode;
+        int pixel      = 0;
+        bench(mode.name, [&]() {
+            ++pixel;
+            float s = ((pixel % 1024) + 0.5f) / 1024.0f;
+            float t = (((pixel / 1024) % 1024) + 0.5f) / 1024.0f;
+            opt.rnd = bjhash::bjfinal(pixel, 0) * inv;
+            texsys->texture(handle, perthread_info, opt, s, t, dsdx, dtdx,
+                            dsdy, dtdy, nchannels, result.data());
+            DoNotOptimize(result[0]);
+        });
+    }
+}
+
+
+
 static const char* workload_names[] = {
     /*0*/ "None",
     /*1*/ "Everybody accesses the same spot in one file (handles)",
@@ -1329,6 +1402,229 @@ launch_tex_threads(int numthreads, int iterations)
 
 
 
+// Standard workloads, for reproducible comparisons of TextureSystem
+// throughput and scaling with --scenario.
+struct Scenario {
+    const char* name;
+    const char* description;
+};
+static const Scenario scenarios[] = {
+    { "coherent", "Coherent camera rays: warped raster in 16x16 buckets" },
+    { "incoherent", "Incoherent: random positions and filter sizes" },
+    { "udim", "UDIM scatter: random tiles of a UDIM set (or all files)" },
+    { "ground", "Anisotropic ground plane receding to the horizon" },
+    { "thrash", "Many small files: every lookup in a different file" },
+};
+
+
+
+// Perform `iterations` texture lookups of scenario `sc` (an index into
+// scenarios[]), as thread `mythread` of `nthreads`.
+static void
+do_scenario_thread(int sc, int iterations, int mythread, int nthreads)
+{
+    const int nfiles   = (int)filenames.size();
+    const int nc       = nchannels_override ? nchannels_override : 3;
+    float* result      = OIIO_ALLOCA(float, nc);
+    constexpr float inv = 1.0f / float(std::numeric_limits<uint32_t>::max());
+    TextureSystem::Perthread* perthread_info = texsys->get_perthread_info();
+    std::vector<TextureSystem::TextureHandle*> handles;
+    for (auto f : filenames)
+        handles.push_back(texsys->get_texture_handle(f, perthread_info));
+    TextureOpt opt;
+    initialize_opt(opt);
+
+    // UDIM scatter looks up random tiles of a UDIM set, if the first file
+    // is one, otherwise of the set of all the files.
+    int nutiles = 1, nvtiles = 1;
+    if (string_view(scenarios[sc].name) == "udim"
+        && texsys->is_udim(handles[0])) {
+        std::vector<ustring> tilenames;
+        texsys->inventory_udim(handles[0], perthread_info, tilenames, nutiles,
+                               nvtiles);
+    }
+
+    const int bucketpixels = 16 * 16;
+    const int xbuckets     = (output_xres + 15) / 16;
+    const int nbuckets     = xbuckets * ((output_yres + 15) / 16);
+    for (int i = 0; i < iterations; ++i) {
+        uint32_t h0 = bjhash::bjfinal(i, mythread, sc);
+        uint32_t h1 = bjhash::bjfinal(i, mythread, sc + 1000);
+        float s = 0.5f, t = 0.5f, dsdx = 0.0f, dtdx = 0.0f, dsdy = 0.0f,
+              dtdy = 0.0f;
+        int whichfile = 0;
+        switch (sc) {
+        case 0: {
+            // Each thread renders its own buckets, in turn
+            int b = ((i / bucketpixels) * nthreads + mythread) % nbuckets;
+            int p = i % bucketpixels;
+            int x = (b % xbuckets) * 16 + p % 16;
+            int y = (b / xbuckets) * 16 + p / 16;
+            map_warp(x, y, s, t, dsdx, dtdx, dsdy, dtdy);
+            break;
+        }
+        case 1:
+        case 4: {
+            // Filter widths from a texel to 1/16 of the image (log-uniform)
+            // for "incoherent", always the finest level for "thrash".
+            s        = h0 * inv;
+            t        = h1 * inv;
+            float fw = sc == 1 ? powf(2.0f, -12.0f + 8.0f * ((h0 ^ h1) * inv))
+                               : 1.0f / 4096.0f;
+            dsdx     = fw;
+            dtdy     = fw;
+            if (sc == 1)
+                whichfile = int(bjhash::bjfinal(h0, h1) % uint32_t(nfiles));
+            else
+                whichfile = (i * 7 + mythread) % nfiles;
+            break;
+        }
+        case 2: {
+            // Coherent runs of 64 lookups within each randomly chosen tile
+            uint32_t run = bjhash::bjfinal(i / 64, mythread, sc);
+            int tile     = int(run % uint32_t(std::max(nutiles * nvtiles,
+                                                    nfiles)));
+            float u      = ((i % 64) + 0.5f) / 64.0f;
+            if (nutiles * nvtiles > 1) {
+                s = (tile % nutiles) + u;
+                t = (tile / nutiles) + (run >> 16) * (1.0f / 65536.0f);
+            } else {
+                whichfile = tile;
+                s         = u;
+                t         = (run >> 16) * (1.0f / 65536.0f);
+            }
+            dsdx = dtdy = 1.0f / 1024.0f;
+            break;
+        }
+        case 3: {
+            // A ground plane under a camera looking at the horizon: the
+            // footprints grow and stretch with the distance 1/v.
+            int p   = (i * nthreads + mythread)
+                    % std::max(output_xres * output_yres, 1);
+            float u = ((p % output_xres) + 0.5f) / output_xres - 0.5f;
+            float v = ((p / output_xres) + 0.5f) / output_yres;
+            float d = 1.0f / v;
+            s       = 0.5f + u * d;
+            t       = d;
+            dsdx    = d / output_xres;
+            dsdy    = -u * d * d / output_yres;
+            dtdy    = -d * d / output_yres;
+            break;
+        }
+        }
+        bool ok = texsys->texture(handles[whichfile], perthread_info, opt, s, t,
+                                  dsdx, dtdx, dsdy, dtdy, nc, result);
+        if (!ok) {
+            Strutil::fprintf(std::cerr, "Unexpected error: %s\n",
+                             texsys->geterror());
+            return;
+        }
+        DoNotOptimize(result[0]);
+    }
+}
+
+
+
+// Snapshot of the TextureSystem statistics that the scenarios report.
+struct ScenarioStats {
+    long long queries = 0, texels = 0, find_tile_calls = 0;
+    long long microcache_misses = 0, cache_misses = 0;
+    float lock_wait             = 0.0f;
+
+    ScenarioStats()
+    {
+        long long closest = 0, bilinear = 0, cubic = 0, ewa = 0;
+        int misses = 0;
+        texsys->getattribute("stat:texture_queries", TypeInt64, &queries);
+        texsys->getattribute("stat:closest_interps", TypeInt64, &closest);
+        texsys->getattribute("stat:bilinear_interps", TypeInt64, &bilinear);
+        texsys->getattribute("stat:cubic_interps", TypeInt64, &cubic);
+        texsys->getattribute("stat:ewa_texels", TypeInt64, &ewa);
+        texsys->getattribute("stat:find_tile_calls", TypeInt64,
+                             &find_tile_calls);
+        texsys->getattribute("stat:find_tile_microcache_misses", TypeInt64,
+                             &microcache_misses);
+        texsys->getattribute("stat:find_tile_cache_misses", TypeInt, &misses);
+        texsys->getattribute("stat:input_mutex_wait_time", TypeFloat,
+                             &lock_wait);
+        texels       = closest + 4 * bilinear + 16 * cubic + ewa;
+        cache_misses = misses;
+    }
+};
+
+
+
+// Run the named scenarios, each over a range of thread counts up to
+// --threads, and report lookups per second, texels per lookup, the hit
+// rates of the per-thread microcache and the shared tile cache, and time
+// spent waiting for file locks.
+static void
+run_scenarios(string_view names)
+{
+    const int maxthreads = nthreads ? nthreads
+                                    : Sysutil::hardware_concurrency();
+    const int iterations = iters > 1 ? iters : 1000000;
+    std::vector<int> threadcounts;
+    for (int nt = 1; nt < maxthreads; nt *= 2)
+        threadcounts.push_back(nt);
+    threadcounts.push_back(maxthreads);
+    auto requested = Strutil::splitsv(names, ",");
+    for (int sc = 0; sc < int(sizeof(scenarios) / sizeof(scenarios[0]));
+         ++sc) {
+        if (names != "all"
+            && std::find(requested.begin(), requested.end(),
+                         scenarios[sc].name)
+                   == requested.end())
+            continue;
+        std::cout << "Scenario \"" << scenarios[sc].name
+                  << "\": " << scenarios[sc].description << "\n";
+        std::cout << "threads  Mlookups/s  speedup  texels/lookup  "
+                     "microcache hit  cache hit  lock wait\n";
+        double single_thread_rate = 0.0;
+        for (int nt : threadcounts) {
+            int its = std::max(1, iterations / nt);
+            texsys->invalidate_all(true);
+            ScenarioStats before;
+            double t = time_trial(
+                [&]() {
+                    OIIO::thread_group threads;
+                    for (int i = 0; i < nt; ++i)
+                        threads.create_thread(do_scenario_thread, sc, its, i,
+                                              nt);
+                    threads.join_all();
+                },
+                ntrials);
+            ScenarioStats after;
+            double lookups = double(after.queries - before.queries);
+            double texels  = double(after.texels - before.texels);
+            double calls   = std::max(
+                double(after.find_tile_calls - before.find_tile_calls), 1.0);
+            double microcache_hits
+                = 1.0
+                  - (after.microcache_misses - before.microcache_misses)
+                        / calls;
+            double cache_hits = 1.0
+                                - (after.cache_misses - before.cache_misses)
+                                      / calls;
+            double rate = double(nt) * its / t;
+            if (nt == 1)
+                single_thread_rate = rate;
+            Strutil::print(
+                "{:4}    {:9.2f}   {:6.2f}x  {:11.1f}    {:10.2f}%  {:8.2f}%  "
+                "{}\n",
+                nt, rate / 1.0e6, rate / single_thread_rate,
+                texels / std::max(lookups, 1.0), 100.0 * microcache_hits,
+                100.0 * cache_hits,
+                Strutil::timeintervalformat(after.lock_wait - before.lock_wait,
+                                            3));
+            std::cout.flush();
+        }
+        std::cout << "\n";
+    }
+}
+
+
+
 class GridImageInput final : public ImageInput {
 public:
     GridImageInput()
@@ -1552,6 +1848,11 @@ main(int argc, const char* argv[])
         test_hash();
     }
 
+    if (benchfilters && filenames.size()) {
+        benchmark_aniso_filters(filenames[0]);
+        iters = 0;
+    }
+
     Imath::M33f scale;
     scale.scale(Imath::V2f(0.3, 0.3));
     Imath::M33f rot;
@@ -1562,7 +1863,9 @@ main(int argc, const char* argv[])
     xform = persp * rot * trans * scale;
     xform.invert();
 
-    if (threadtimes) {
+    if (scenario_list.size()) {
+        run_scenarios(scenario_list);
+    } else if (threadtimes) {
         // If the --iters flag was used, do that number of iterations total
         // (divided among the threads). If not supplied (iters will be 1),
         // then use a large constant *per thread*.
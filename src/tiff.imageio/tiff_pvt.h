@@ -0,0 +1,86 @@
+// Copyright 2008-present Contributors to the OpenImageIO project.
+// SPDX-License-Identifier: BSD-3-Clause
+// https://github.com/OpenImageIO/oiio
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Private definitions internal to the tiff.imageio plugin
+/////////////////////////////////////////////////////////////////////////////
+
+
+#pragma once
+
+#include <tiffio.h>
+
+#ifdef USE_LIBDEFLATE
+#    include <libdeflate.h>
+#endif
+
+#include <OpenImageIO/imageio.h>
+
+
+OIIO_PLUGIN_NAMESPACE_BEGIN
+
+
+// TIFFInput implements this, so that TIFFOutput::copy_image() can copy the
+// compressed strips or tiles of the file it is reading straight into the
+// file being written, without decoding and re-encoding them.
+class TIFFRawSource {
+public:
+    // The libtiff handle of the open file, set to the directory of the
+    // current subimage.
+    virtual TIFF* raw_tif() = 0;
+
+protected:
+    ~TIFFRawSource() {}
+};
+
+
+
+#ifdef USE_LIBDEFLATE
+// libdeflate is 2-3x faster than zlib for the whole-buffer (de)compression
+// of zip strips and tiles that we do ourselves. Its (de)compressors are
+// costly to set up, so each thread keeps its own. A compressor is for one
+// compression level; return nullptr if one can't be made.
+
+inline libdeflate_compressor*
+thread_deflate_compressor(int level)
+{
+    struct Cached {
+        libdeflate_compressor* compressor = nullptr;
+        int level                         = -1;
+        ~Cached()
+        {
+            if (compressor)
+                libdeflate_free_compressor(compressor);
+        }
+    };
+    static thread_local Cached cached;
+    if (cached.level != level) {
+        if (cached.compressor)
+            libdeflate_free_compressor(cached.compressor);
+        cached.compressor = libdeflate_alloc_compressor(level);
+        cached.level      = cached.compressor ? level : -1;
+    }
+    return cached.compressor;
+}
+
+
+inline libdeflate_decompressor*
+thread_deflate_decompressor()
+{
+    struct Cached {
+        libdeflate_decompressor* decompressor = libdeflate_alloc_decompressor();
+        ~Cached()
+        {
+            if (decompressor)
+                libdeflate_free_decompressor(decompressor);
+        }
+    };
+    static thread_local Cached cached;
+    return cached.decompressor;
+}
+#endif
+
+
+OIIO_PLUGIN_NAMESPACE_END
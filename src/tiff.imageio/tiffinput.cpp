@@ -7,6 +7,8 @@
 #include <cmath>
 #include <cstdio>
 #include <cstdlib>
+#include <cstring>
+#include <memory>
 
 #define AVOID_WIN32_FILEIO
 #include <tiffio.h>
@@ -23,6 +25,7 @@
 #include <OpenImageIO/typedesc.h>
 
 #include "imageio_pvt.h"
+#include "tiff_pvt.h"
 
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
@@ -50,6 +53,227 @@ struct TIFF_tag_info {
 
 
 
+// Everything needed to turn one raw (still compressed) TIFF strip or tile
+// into native pixels without going back through libtiff, which is fully
+// serialized. It is captured while the reader's lock is held, so that the
+// decoding itself may then run on any thread.
+struct TIFFRawChunkInfo {
+    int compression;   // TIFF compression tag
+    int predictor;     // TIFF predictor tag
+    int formatsize;    // bytes per sample
+    int nchannels;     // channels per pixel
+    int planes;        // 1 for contig, nchannels for separate planarconfig
+    int width;         // pixels per row of the chunk
+    int rows;          // rows of the chunk (tile height * depth for tiles)
+    int byteswapped;   // file endianness is opposite ours
+    int miniswhite;    // 8 bit MINISWHITE that must be inverted
+    int decoded;       // already native pixels, just copy (see read_raw_tile)
+};
+
+
+
+// Decode TIFF flavored LZW (codes MSB-first, 9 to 12 bits, code width bumped
+// one code early), which is what libtiff has been writing since 1995. The
+// older "compat" LZW is recognized by lzw_old_style() and is not handled
+// here. Return false if the stream is corrupt; a short stream leaves the
+// remainder of dst untouched, as libtiff does.
+static bool
+lzw_decode(const unsigned char* src, size_t srclen, unsigned char* dst,
+           size_t dstlen)
+{
+    enum { ClearCode = 256, EOICode = 257, FirstCode = 258, MaxCode = 4096 };
+    uint16_t prefix[MaxCode], length[MaxCode];
+    unsigned char suffix[MaxCode], first[MaxCode];
+    for (int i = 0; i < 256; ++i) {
+        prefix[i] = 0;
+        length[i] = 1;
+        suffix[i] = (unsigned char)i;
+        first[i]  = (unsigned char)i;
+    }
+    int nextcode = FirstCode, width = 9, oldcode = -1;
+    uint32_t bits = 0;
+    int nbits     = 0;
+    size_t in = 0, out = 0;
+    while (out < dstlen) {
+        while (nbits < width && in < srclen) {
+            bits = (bits << 8) | src[in++];
+            nbits += 8;
+        }
+        if (nbits < width)
+            break;  // ran out of input without an EOI
+        int code = int(bits >> (nbits - width)) & ((1 << width) - 1);
+        nbits -= width;
+        if (code == EOICode)
+            break;
+        if (code == ClearCode) {
+            nextcode = FirstCode;
+            width    = 9;
+            oldcode  = -1;
+            continue;
+        }
+        if (oldcode < 0) {
+            if (code >= 256)
+                return false;
+            dst[out++] = (unsigned char)code;
+            oldcode    = code;
+            continue;
+        }
+        if (code > nextcode || (code == nextcode && nextcode >= MaxCode))
+            return false;
+        if (nextcode < MaxCode) {
+            // New entry: the previous string plus the first character of
+            // this one (which, for the KwKwK case, is the previous one's).
+            prefix[nextcode] = uint16_t(oldcode);
+            suffix[nextcode] = first[code == nextcode ? oldcode : code];
+            first[nextcode]  = first[oldcode];
+            length[nextcode] = uint16_t(length[oldcode] + 1);
+            ++nextcode;
+            if (nextcode >= (1 << width) - 1 && width < 12)
+                ++width;
+        }
+        // Emit the string for code, back to front.
+        size_t len = std::min(size_t(length[code]), dstlen - out);
+        for (int c = code, i = length[code] - 1; i >= 0; c = prefix[c], --i)
+            if (size_t(i) < len)
+                dst[out + i] = suffix[c];
+        out += len;
+        oldcode = code;
+    }
+    return true;
+}
+
+
+
+// Does this raw LZW chunk use the pre-1995 bit order, which lzw_decode
+// doesn't speak?
+inline bool
+lzw_old_style(const unsigned char* src, size_t srclen)
+{
+    return srclen >= 2 && src[0] == 0 && (src[1] & 0x1);
+}
+
+
+
+// Copy a height x width x chans region of src to dst, un-applying a
+// horizontal predictor to each row. It is permitted for src and dst to
+// be the same.
+template<typename T>
+static void
+undo_horizontal_predictor(T* dst, const T* src, int chans, int width,
+                          int height)
+{
+    for (int y = 0; y < height;
+         ++y, src += chans * width, dst += chans * width)
+        for (int c = 0; c < chans; ++c) {
+            dst[c] = src[c];  // element 0
+            for (int x = 1; x < width; ++x)
+                dst[x * chans + c] = src[(x - 1) * chans + c]
+                                     + src[x * chans + c];
+        }
+}
+
+
+
+// Decompress zip-compressed raw bytes into exactly `bytes` bytes of dst.
+static bool
+zip_decode(const unsigned char* raw, size_t rawsize, unsigned char* dst,
+           size_t bytes)
+{
+#ifdef USE_LIBDEFLATE
+    if (libdeflate_decompressor* d = thread_deflate_decompressor()) {
+        size_t actual = 0;
+        auto r = libdeflate_zlib_decompress(d, raw, rawsize, dst, bytes,
+                                            &actual);
+        if (r == LIBDEFLATE_SUCCESS && actual == bytes)
+            return true;
+        // Otherwise let zlib have a go, it may be more forgiving
+    }
+#endif
+    uLong uncompressed_size = (uLong)bytes;
+    auto zok = uncompress((Bytef*)dst, &uncompressed_size, (const Bytef*)raw,
+                          (uLong)rawsize);
+    return zok == Z_OK && uncompressed_size == bytes;
+}
+
+
+
+// Decode one plane (all channels for contig, one channel for separate) of
+// a raw chunk into dst, which has room for info.width * info.rows pixels
+// of that plane: decompress, fix the byte order, undo the predictor.
+static bool
+decode_raw_plane(const TIFFRawChunkInfo& info, const unsigned char* raw,
+                 size_t rawsize, unsigned char* dst)
+{
+    int chans    = info.planes > 1 ? 1 : info.nchannels;
+    size_t nvals = size_t(info.width) * info.rows * chans;
+    size_t bytes = nvals * info.formatsize;
+    if (info.compression == COMPRESSION_LZW) {
+        if (!lzw_decode(raw, rawsize, dst, bytes))
+            return false;
+    } else if (info.compression == COMPRESSION_ADOBE_DEFLATE
+               || info.compression == COMPRESSION_DEFLATE) {
+        if (!zip_decode(raw, rawsize, dst, bytes))
+            return false;
+    } else {
+        // just copy if there's no compression
+        memcpy(dst, raw, std::min(bytes, rawsize));
+    }
+    if (info.byteswapped) {
+        if (info.formatsize == 2)
+            TIFFSwabArrayOfShort((uint16_t*)dst, tmsize_t(nvals));
+        else if (info.formatsize == 4)
+            TIFFSwabArrayOfLong((uint32_t*)dst, tmsize_t(nvals));
+    }
+    if (info.predictor == PREDICTOR_HORIZONTAL) {
+        if (info.formatsize == 1)
+            undo_horizontal_predictor(dst, dst, chans, info.width, info.rows);
+        else if (info.formatsize == 2)
+            undo_horizontal_predictor((uint16_t*)dst, (const uint16_t*)dst,
+                                      chans, info.width, info.rows);
+    }
+    return true;
+}
+
+
+
+// Decode all planes of a raw chunk into contiguous native pixels. The raw
+// bytes of plane c are in raw[c].
+static bool
+decode_raw_chunk(const TIFFRawChunkInfo& info, const cspan<unsigned char>* raw,
+                 void* data)
+{
+    size_t npixels = size_t(info.width) * info.rows;
+    if (info.planes <= 1) {
+        if (!decode_raw_plane(info, raw[0].data(), raw[0].size(),
+                              (unsigned char*)data))
+            return false;
+    } else {
+        // Decode each plane, then separate_to_contig (RRRGGGBBB to
+        // RGBRGBRGB) into the caller's buffer.
+        size_t plane_bytes = npixels * info.formatsize;
+        std::unique_ptr<unsigned char[]> sep(
+            new unsigned char[plane_bytes * info.planes]);
+        for (int c = 0; c < info.planes; ++c)
+            if (!decode_raw_plane(info, raw[c].data(), raw[c].size(),
+                                  sep.get() + c * plane_bytes))
+                return false;
+        unsigned char* contig = (unsigned char*)data;
+        int fs                = info.formatsize;
+        for (size_t p = 0; p < npixels; ++p)
+            for (int c = 0; c < info.planes; ++c)
+                memcpy(contig + (p * info.planes + c) * fs,
+                       sep.get() + (c * npixels + p) * fs, fs);
+    }
+    if (info.miniswhite) {
+        unsigned char* d = (unsigned char*)data;
+        for (size_t i = 0, n = npixels * info.nchannels; i < n; ++i)
+            d[i] = 255 - d[i];
+    }
+    return true;
+}
+
+
+
 // Note about MIP-maps versus subimages:
 //
 // TIFF files support subimages, but do not explicitly support
@@ -69,7 +293,7 @@ struct TIFF_tag_info {
 
 
 
-class TIFFInput final : public ImageInput {
+class TIFFInput final : public ImageInput, public TIFFRawSource {
 public:
     TIFFInput();
     virtual ~TIFFInput();
@@ -77,6 +301,13 @@ public:
     virtual bool valid_file(const std::string& filename) const override;
     virtual int supports(string_view feature) const override
     {
+        if (feature == "rawtiles") {
+            // Let the base class read_native_tiles decode in parallel,
+            // unless the feature has been turned off.
+            lock_guard lock(*this);
+            return m_spec.get_int_attribute(
+                "tiff:multithread", OIIO::get_int_attribute("tiff:multithread"));
+        }
         return (feature == "exif" || feature == "iptc" || feature == "ioproxy");
         // N.B. No support for arbitrary metadata.
     }
@@ -84,6 +315,7 @@ public:
     virtual bool open(const std::string& name, ImageSpec& newspec,
                       const ImageSpec& config) override;
     virtual bool close() override;
+    virtual TIFF* raw_tif() override { return m_tif; }
     virtual int current_subimage(void) const override
     {
         // If m_emulate_mipmap is true, pretend subimages are mipmap levels
@@ -99,16 +331,21 @@ public:
     virtual bool seek_subimage(int subimage, int miplevel) override;
     virtual ImageSpec spec(int subimage, int miplevel) override;
     virtual ImageSpec spec_dimensions(int subimage, int miplevel) override;
-    const ImageSpec& spec(void) const override { return m_spec; }
+    const ImageSpec& spec(void) const override { return ImageInput::spec(); }
     virtual bool read_native_scanline(int subimage, int miplevel, int y, int z,
                                       void* data) override;
     virtual bool read_native_scanlines(int subimage, int miplevel, int ybegin,
                                        int yend, int z, void* data) override;
     virtual bool read_native_tile(int subimage, int miplevel, int x, int y,
                                   int z, void* data) override;
-    virtual bool read_native_tiles(int subimage, int miplevel, int xbegin,
-                                   int xend, int ybegin, int yend, int zbegin,
-                                   int zend, void* data) override;
+    virtual bool read_raw_tile(int subimage, int miplevel, int x, int y, int z,
+                               std::vector<unsigned char>& rawdata) override;
+    virtual bool decode_raw_tile(int subimage, int miplevel, int x, int y,
+                                 int z, span<unsigned char> rawdata,
+                                 void* data) override;
+    virtual bool native_tile_location(int subimage, int miplevel, int x, int y,
+                                      int z, int64_t& offset,
+                                      int64_t& size) override;
     virtual bool read_scanline(int y, int z, TypeDesc format, void* data,
                                stride_t xstride) override;
     virtual bool read_scanlines(int subimage, int miplevel, int ybegin,
@@ -149,6 +386,7 @@ private:
     unsigned short m_compression;    ///< TIFF compression tag
     unsigned short m_predictor;      ///< TIFF compression predictor tag
     unsigned short m_inputchannels;  ///< Channels in the file (careful with CMYK)
+    int m_raw_chunks_ok;             ///< Cached raw_chunks_ok(), -1 = unknown
     std::vector<unsigned short> m_colormap;   ///< Color map for palette images
     std::vector<uint32_t> m_rgbadata;         ///< Sometimes we punt
     std::vector<ImageSpec> m_subimage_specs;  ///< Cached subimage specs
@@ -167,6 +405,7 @@ private:
         m_testopenconfig          = false;
         m_colormap.clear();
         m_use_rgba_interface = false;
+        m_raw_chunks_ok      = -1;
         m_subimage_specs.clear();
         ioproxy_clear();
     }
@@ -383,57 +622,42 @@ private:
         return y == next_strip_boundary(y) || y == m_spec.height;
     }
 
-    // Copy a height x width x chans region of src to dst, un-applying a
-    // horizontal predictor to each row. It is permitted for src and dst to
-    // be the same.
-    template<typename T>
-    void undo_horizontal_predictor(T* dst, const T* src, int chans, int width,
-                                   int height)
-    {
-        for (int y = 0; y < height;
-             ++y, src += chans * width, dst += chans * width)
-            for (int c = 0; c < chans; ++c) {
-                dst[c] = src[c];  // element 0
-                for (int x = 1; x < width; ++x)
-                    dst[x * chans + c] = src[(x - 1) * chans + c]
-                                         + src[x * chans + c];
-            }
-    }
+    // Can the strips or tiles of the current subimage be read raw and
+    // decoded by decode_raw_chunk, bypassing libtiff? Only deflate and LZW
+    // are worth it, and only for the plain cases that need no palette,
+    // color space, or bit depth conversion.
+    bool raw_chunks_ok();
 
-    void uncompress_one_strip(void* compressed_buf, unsigned long csize,
-                              void* uncompressed_buf, size_t strip_bytes,
-                              int channels, int width, int height, bool* ok)
+    // Describe a raw chunk of the current subimage having the given
+    // dimensions, for decode_raw_chunk.
+    TIFFRawChunkInfo raw_chunk_info(int width, int rows) const
     {
-        OIIO_DASSERT (m_compression == COMPRESSION_ADOBE_DEFLATE /*||
-                      m_compression == COMPRESSION_NONE*/);
-        if (m_compression == COMPRESSION_NONE) {
-            // just copy if there's no compression
-            memcpy(uncompressed_buf, compressed_buf, csize);
-            if (m_is_byte_swapped && m_spec.format == TypeUInt16)
-                TIFFSwabArrayOfShort((unsigned short*)uncompressed_buf,
-                                     width * height * channels);
-            return;
-        }
-        uLong uncompressed_size = (uLong)strip_bytes;
-        auto zok = uncompress((Bytef*)uncompressed_buf, &uncompressed_size,
-                              (const Bytef*)compressed_buf, csize);
-        if (zok != Z_OK || uncompressed_size != strip_bytes) {
-            *ok = false;
-            return;
-        }
-        if (m_is_byte_swapped && m_spec.format == TypeUInt16)
-            TIFFSwabArrayOfShort((unsigned short*)uncompressed_buf,
-                                 width * height * channels);
-        if (m_predictor == PREDICTOR_HORIZONTAL) {
-            if (m_spec.format == TypeUInt8)
-                undo_horizontal_predictor((unsigned char*)uncompressed_buf,
-                                          (unsigned char*)uncompressed_buf,
-                                          channels, width, height);
-            else if (m_spec.format == TypeUInt16)
-                undo_horizontal_predictor((unsigned short*)uncompressed_buf,
-                                          (unsigned short*)uncompressed_buf,
-                                          channels, width, height);
-        }
+        TIFFRawChunkInfo info;
+        info.compression = m_compression;
+        info.predictor   = m_predictor;
+        info.formatsize  = int(m_spec.format.size());
+        info.nchannels   = m_spec.nchannels;
+        info.planes      = m_separate ? m_spec.nchannels : 1;
+        info.width       = width;
+        info.rows        = rows;
+        info.byteswapped = m_is_byte_swapped;
+        info.miniswhite  = (m_photometric == PHOTOMETRIC_MINISWHITE
+                           && m_spec.format == TypeUInt8);
+        info.decoded     = 0;
+        return info;
+    }
+
+    // Size in bytes of the raw data of strip or tile number `chunk`.
+    tmsize_t raw_chunk_size(uint32_t chunk)
+    {
+        toff_t* bytecounts = nullptr;
+        if (!TIFFGetField(m_tif,
+                          m_spec.tile_width ? TIFFTAG_TILEBYTECOUNTS
+                                            : TIFFTAG_STRIPBYTECOUNTS,
+                          &bytecounts)
+            || !bytecounts)
+            return -1;
+        return tmsize_t(bytecounts[chunk]);
     }
 
     int tile_index(int x, int y, int z)
@@ -467,6 +691,10 @@ tiff_input_imageio_create()
 OIIO_EXPORT const char* tiff_input_extensions[]
     = { "tif", "tiff", "tx", "env", "sm", "vsm", nullptr };
 
+OIIO_EXPORT const char* tiff_input_signatures[] = {
+    "49492a00", "4d4d002a", "49492b00", "4d4d002b", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 
@@ -562,9 +790,17 @@ sizeproc(thandle_t handle)
 }
 
 static int
-mapproc(thandle_t, tdata_t*, toff_t*)
+mapproc(thandle_t handle, tdata_t* base, toff_t* size)
 {
-    return 0;
+    // If the proxy is backed by memory (such as an IOMMap or IOMemReader),
+    // let libtiff use those bytes in place.
+    auto io                    = static_cast<Filesystem::IOProxy*>(handle);
+    cspan<unsigned char> bytes = io->view(0, io->size());
+    if (bytes.empty() || bytes.size() != io->size())
+        return 0;
+    *base = (tdata_t)bytes.data();
+    *size = toff_t(bytes.size());
+    return 1;
 }
 
 static void unmapproc(thandle_t, tdata_t, toff_t) {}
@@ -684,6 +920,12 @@ TIFFInput::open(const std::string& name, ImageSpec& newspec)
     m_filename = name;
     m_subimage = -1;
 
+    // libtiff can't open a URL itself, so a remote file is always read
+    // through a proxy.
+    if (!ioproxy_opened() && pvt::is_remote_url(name)
+        && !ioproxy_use_or_open(name))
+        return false;
+
     bool ok = seek_subimage(0, 0);
     newspec = spec();
     return ok;
@@ -697,6 +939,7 @@ TIFFInput::open(const std::string& name, ImageSpec& newspec,
 {
     // Check 'config' for any special requests
     ioproxy_retrieve_from_config(config);
+    lazy_metadata(config);
     if (config.get_int_attribute("oiio:UnassociatedAlpha", 0) == 1)
         m_keep_unassociated_alpha = true;
     if (config.get_int_attribute("oiio:RawColor", 0) == 1)
@@ -743,15 +986,21 @@ TIFFInput::seek_subimage(int subimage, int miplevel)
                           "thandle_t must be same size as void*");
             // Strutil::print("\n\nOpening client \"{}\"\n", m_filename);
             ioseek(0);
-            m_tif = TIFFClientOpen(m_filename.c_str(), "rm", ioproxy(),
+            // "m" tells libtiff not to try to memory map, which we only
+            // allow if the proxy can show it the bytes in place.
+            const char* mode = ioproxy()->view(0, 1).size() ? "r" : "rm";
+            m_tif = TIFFClientOpen(m_filename.c_str(), mode, ioproxy(),
                                    readproc, writeproc, seekproc, closeproc,
                                    sizeproc, mapproc, unmapproc);
         } else {
+            // Let libtiff memory map the file itself if "use_mmap" is on.
+            const char* mode = OIIO::get_int_attribute("use_mmap") ? "r"
+                                                                   : "rm";
 #ifdef _WIN32
             std::wstring wfilename = Strutil::utf8_to_utf16(m_filename);
-            m_tif                  = TIFFOpenW(wfilename.c_str(), "rm");
+            m_tif                  = TIFFOpenW(wfilename.c_str(), mode);
 #else
-            m_tif = TIFFOpen(m_filename.c_str(), "rm");
+            m_tif = TIFFOpen(m_filename.c_str(), mode);
 #endif
         }
         if (m_tif == NULL) {
@@ -778,6 +1027,7 @@ TIFFInput::seek_subimage(int subimage, int miplevel)
                                || m_photometric == PHOTOMETRIC_LOGL
                                || m_photometric == PHOTOMETRIC_LOGLUV);
         m_use_rgba_interface = false;
+        m_raw_chunks_ok      = -1;
         m_rgbadata.clear();
         if ((is_jpeg && m_spec.nchannels != 3)
             || (is_nonspectral && !m_raw_color)) {
@@ -852,9 +1102,11 @@ TIFFInput::spec(int subimage, int miplevel)
         && !m_subimage_specs[s].undefined()) {
         // If we've cached this spec, we don't need to seek and read
         ret = m_subimage_specs[s];
+        if (lazy_metadata() == 1)
+            decode_deferred_metadata(ret);
     } else {
         if (seek_subimage(subimage, miplevel))
-            ret = m_spec;
+            ret = spec();
     }
     return ret;
 }
@@ -1229,7 +1481,13 @@ TIFFInput::readspec(bool read_meta)
                                    (uint32_t*)iptcdata + iptcsize);
         if (TIFFIsByteSwapped(m_tif))
             TIFFSwabArrayOfLong((uint32_t*)&iptc[0], iptcsize);
-        decode_iptc_iim(&iptc[0], iptcsize * 4, m_spec);
+        if (lazy_metadata())
+            defer_metadata("iptc",
+                           cspan<uint8_t>((const uint8_t*)iptc.data(),
+                                          iptcsize * 4),
+                           m_spec);
+        else
+            decode_iptc_iim(&iptc[0], iptcsize * 4, m_spec);
     }
 #endif
 
@@ -1239,8 +1497,11 @@ TIFFInput::readspec(bool read_meta)
     if (TIFFGetField(m_tif, TIFFTAG_XMLPACKET, &xmlsize, &xmldata)) {
         // std::cerr << "Found XML data, size " << xmlsize << "\n";
         if (xmldata && xmlsize) {
-            std::string xml((const char*)xmldata, xmlsize);
-            decode_xmp(xml, m_spec);
+            cspan<uint8_t> xml((const uint8_t*)xmldata, xmlsize);
+            if (lazy_metadata())
+                defer_metadata("xmp", xml, m_spec);
+            else
+                decode_xmp(xml, m_spec);
         }
     }
 
@@ -1288,6 +1549,16 @@ TIFFInput::readspec(bool read_meta)
         m_spec.attribute("oiio:SHA-1", sha);
         updatedDesc = true;
     }
+    auto sh = Strutil::excise_string_after_head(desc, "oiio:SourceHash=");
+    if (sh.size()) {
+        m_spec.attribute("oiio:SourceHash", sh);
+        updatedDesc = true;
+    }
+    auto el = Strutil::excise_string_after_head(desc, "oiio:EnvLobes=");
+    if (el.size()) {
+        m_spec.attribute("oiio:EnvLobes", Strutil::stoi(el));
+        updatedDesc = true;
+    }
 
     if (updatedDesc) {
         string_view d(desc);
@@ -1763,6 +2034,41 @@ TIFFInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
 
 
 
+bool
+TIFFInput::raw_chunks_ok()
+{
+    if (m_raw_chunks_ok >= 0)
+        return m_raw_chunks_ok;
+    int fs = int(m_spec.format.size());
+    bool ok =
+        // only deflate/zip or LZW compression
+        (m_compression == COMPRESSION_ADOBE_DEFLATE
+         || m_compression == COMPRESSION_DEFLATE
+         || m_compression == COMPRESSION_LZW)
+        // only horizontal predictor (on 8 or 16 bit data) or none
+        && (m_predictor == PREDICTOR_NONE
+            || (m_predictor == PREDICTOR_HORIZONTAL && (fs == 1 || fs == 2)))
+        // whole 8, 16, or 32 bit samples, the same for all channels
+        && (fs == 1 || fs == 2 || fs == 4) && fs * 8 == m_bitspersample
+        && m_spec.channelformats.empty()
+        // and not palette or cmyk color separated conversions
+        && m_photometric != PHOTOMETRIC_SEPARATED
+        && m_photometric != PHOTOMETRIC_PALETTE
+        // No other unusual cases
+        && !m_use_rgba_interface;
+    if (ok && m_compression == COMPRESSION_LZW) {
+        // Peek at the start of the first chunk to rule out old-style LZW.
+        unsigned char head[2] = { 0, 0 };
+        tmsize_t n = m_spec.tile_width ? TIFFReadRawTile(m_tif, 0, head, 2)
+                                       : TIFFReadRawStrip(m_tif, 0, head, 2);
+        ok         = (n == 2 && !lzw_old_style(head, 2));
+    }
+    m_raw_chunks_ok = ok;
+    return ok;
+}
+
+
+
 bool
 TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
                                  int yend, int z, void* data)
@@ -1806,17 +2112,7 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
 
     // Are we reading raw (compressed) strips and doing the decompression
     // ourselves?
-    bool read_raw_strips =
-        // only deflate/zip compression
-        (m_compression
-         == COMPRESSION_ADOBE_DEFLATE /*|| m_compression == COMPRESSION_NONE*/)
-        // only horizontal predictor (or none)
-        && (m_predictor == PREDICTOR_HORIZONTAL
-            || m_predictor == PREDICTOR_NONE)
-        // contig planarconfig only (for now?)
-        && !m_separate
-        // only uint8, uint16
-        && (m_spec.format == TypeUInt8 || m_spec.format == TypeUInt16);
+    bool read_raw_strips = raw_chunks_ok();
 
     // We know we wish to read as strips. But additionally, there are some
     // circumstances in which we want to read RAW strips, and do the
@@ -1831,6 +2127,8 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
         // only if we're threading and don't enter the thread pool recursively!
         && pool->size() > 1
         && !pool->is_worker()
+        // only if this ImageInput wasn't asked to be single-threaded
+        && this->threads() != 1
         // and not if the feature is turned off
         && m_spec.get_int_attribute("tiff:multithread",
                                     OIIO::get_int_attribute("tiff:multithread"));
@@ -1839,7 +2137,7 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
     // one is read, kick off the decompress and any other extras, to execute
     // in parallel.
     task_set tasks(pool);
-    bool ok        = true;  // failed compression will stash a false here
+    std::atomic<bool> ok(true);  // failed decompression will stash a false
     int y          = ybegin;
     size_t ystride = m_spec.scanline_bytes(true);
     int stripchans = m_separate ? 1 : m_spec.nchannels;  // chans in each strip
@@ -1848,43 +2146,49 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
     int stripvals = m_spec.width * stripchans
                     * m_rowsperstrip;  // values in a strip
     imagesize_t strip_bytes = stripvals * m_spec.format.size();
-    size_t cbound           = compressBound((uLong)strip_bytes);
-    std::unique_ptr<char[]> compressed_scratch;
     std::unique_ptr<char[]> separate_tmp(
         m_separate ? new char[strip_bytes * nstrips * planes] : nullptr);
+    int strips_in_file = (m_spec.height + m_rowsperstrip - 1) / m_rowsperstrip;
 
     if (read_raw_strips) {
-        // Make room for, and read the raw (still compressed) strips. As each
-        // one is read, kick off the decompress and any other extras, to execute
-        // in parallel.
-        compressed_scratch.reset(new char[cbound * nstrips * planes]);
-        for (size_t stripidx = 0; y + m_rowsperstrip <= yend;
+        // Read the raw (still compressed) strips -- for "separate"
+        // planarconfig, one per channel -- and as each is read, kick off
+        // the decompression and any other extras, to execute in parallel.
+        TIFFRawChunkInfo info = raw_chunk_info(m_spec.width, m_rowsperstrip);
+        std::vector<std::vector<unsigned char>> raw(size_t(nstrips) * planes);
+        for (size_t stripidx = 0; ok && y + m_rowsperstrip <= yend;
              y += m_rowsperstrip, ++stripidx) {
-            char* cbuf        = compressed_scratch.get() + stripidx * cbound;
-            tstrip_t stripnum = (y - m_spec.y) / m_rowsperstrip;
-            tsize_t csize     = TIFFReadRawStrip(m_tif, stripnum, cbuf,
-                                             tmsize_t(cbound));
-            if (csize < 0) {
-                std::string err = oiio_tiff_last_error();
-                errorf("TIFFRead%sStrip failed reading line y=%d,z=%d: %s",
-                       read_raw_strips ? "Raw" : "Encoded", y, z,
-                       err.size() ? err.c_str() : "unknown error");
-                ok = false;
+            std::vector<unsigned char>* rawplanes = &raw[stripidx * planes];
+            for (int c = 0; c < planes; ++c) {
+                tstrip_t stripnum = ((y - m_spec.y) / m_rowsperstrip)
+                                    + c * strips_in_file;
+                tmsize_t csize = raw_chunk_size(stripnum);
+                if (csize >= 0) {
+                    rawplanes[c].resize(size_t(csize));
+                    csize = TIFFReadRawStrip(m_tif, stripnum,
+                                             rawplanes[c].data(), csize);
+                }
+                if (csize < 0) {
+                    std::string err = oiio_tiff_last_error();
+                    errorf("TIFFReadRawStrip failed reading line y=%d,z=%d: %s",
+                           y, z, err.size() ? err.c_str() : "unknown error");
+                    ok = false;
+                    break;
+                }
             }
-            auto out            = this;
-            auto uncompress_etc = [=, &ok](int /*id*/) {
-                out->uncompress_one_strip(cbuf, (unsigned long)csize, data,
-                                          strip_bytes, out->m_spec.nchannels,
-                                          out->m_spec.width,
-                                          out->m_rowsperstrip, &ok);
-                if (out->m_photometric == PHOTOMETRIC_MINISWHITE)
-                    out->invert_photometric(stripvals * stripchans, data);
+            if (!ok)
+                break;
+            auto decode_etc = [=, &ok](int /*id*/) {
+                std::vector<cspan<unsigned char>> rawspans(rawplanes,
+                                                           rawplanes + planes);
+                if (!decode_raw_chunk(info, rawspans.data(), data))
+                    ok = false;
             };
             if (parallelize) {
                 // Push the rest of the work onto the thread pool queue
-                tasks.push(pool->push(uncompress_etc));
+                tasks.push(pool->push(decode_etc));
             } else {
-                uncompress_etc(0);
+                decode_etc(0);
             }
             data = (char*)data + strip_bytes * planes;
         }
@@ -1894,8 +2198,6 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
         // encoded strips. Still can be a lot more efficient than reading
         // individual scanlines. This is the clause that has to handle
         // "separate" planarconfig.
-        int strips_in_file = (m_spec.height + m_rowsperstrip - 1)
-                             / m_rowsperstrip;
         for (size_t stripidx = 0; y < yend; y += m_rowsperstrip, ++stripidx) {
             int myrps       = std::min(yend - y, m_rowsperstrip);
             int strip_endy  = std::min(y + m_rowsperstrip, yend);
@@ -1934,14 +2236,15 @@ TIFFInput::read_native_scanlines(int subimage, int miplevel, int ybegin,
 
     // If we have left over scanlines, read them serially
     m_next_scanline = y;
-    for (; y < yend; ++y) {
-        bool ok = read_native_scanline(subimage, miplevel, y, z, data);
-        if (!ok)
+    for (; ok && y < yend; ++y) {
+        if (!read_native_scanline(subimage, miplevel, y, z, data))
             return false;
         data = (char*)data + ystride;
     }
     tasks.wait();
-    return true;
+    if (!ok && !has_error())
+        errorf("Could not decompress TIFF strips for y=[%d,%d)", ybegin, yend);
+    return ok;
 }
 
 
@@ -2061,120 +2364,139 @@ TIFFInput::read_native_tile(int subimage, int miplevel, int x, int y, int z,
 
 
 bool
-TIFFInput::read_native_tiles(int subimage, int miplevel, int xbegin, int xend,
-                             int ybegin, int yend, int zbegin, int zend,
-                             void* data)
+TIFFInput::native_tile_location(int subimage, int miplevel, int x, int y,
+                                int z, int64_t& offset, int64_t& size)
 {
     lock_guard lock(*this);
     if (!seek_subimage(subimage, miplevel))
         return false;
-    if (!m_spec.valid_tile_range(xbegin, xend, ybegin, yend, zbegin, zend))
+    // Only a tile that read_native_tile would hand back untouched can be
+    // used in place: uncompressed, contiguous, whole-byte samples in our
+    // own byte order, and no color or alpha conversion. Data read through
+    // a proxy has no meaningful file offset.
+    if (!m_spec.tile_width || ioproxy_opened() || m_use_rgba_interface
+        || m_compression != COMPRESSION_NONE || m_predictor != PREDICTOR_NONE
+        || m_separate || m_is_byte_swapped || m_convert_alpha
+        || m_inputchannels != m_spec.nchannels
+        || m_bitspersample != 8 * m_spec.format.size()
+        || m_photometric == PHOTOMETRIC_PALETTE
+        || m_photometric == PHOTOMETRIC_MINISWHITE
+        || (m_photometric == PHOTOMETRIC_SEPARATED && !m_raw_color)
+        || !m_spec.channelformats.empty())
+        return false;
+    toff_t* offsets    = nullptr;
+    toff_t* bytecounts = nullptr;
+    if (!TIFFGetField(m_tif, TIFFTAG_TILEOFFSETS, &offsets)
+        || !TIFFGetField(m_tif, TIFFTAG_TILEBYTECOUNTS, &bytecounts)
+        || !offsets || !bytecounts)
         return false;
+    ttile_t tile = TIFFComputeTile(m_tif, x - m_spec.x, y - m_spec.y,
+                                   z - m_spec.z, 0);
+    if (tile >= TIFFNumberOfTiles(m_tif)
+        || imagesize_t(bytecounts[tile]) != m_spec.tile_bytes())
+        return false;
+    offset = int64_t(offsets[tile]);
+    size   = int64_t(bytecounts[tile]);
+    return true;
+}
 
-    // If the stars all align properly, use the thread pool to parallelize
-    // the decompression. This can give a large speedup (5x or more!)
-    // because the zip decompression dwarfs the actual raw I/O. But libtiff
-    // is totally serialized, so we can only parallelize by making calls to
-    // zlib ourselves and then writing "raw" (compressed) strips. Don't
-    // bother trying to handle any of the uncommon cases with strips. This
-    // covers most real-world cases.
-    thread_pool* pool = default_thread_pool();
-    OIIO_DASSERT(m_spec.tile_depth >= 1);
-    size_t ntiles = size_t(
-        (xend - xbegin + m_spec.tile_width - 1) / m_spec.tile_width
-        * (yend - ybegin + m_spec.tile_height - 1) / m_spec.tile_height
-        * (zend - zbegin + m_spec.tile_depth - 1) / m_spec.tile_depth);
-    bool parallelize =
-        // more than one tile, or no point parallelizing
-        ntiles > 1
-        // and not palette or cmyk color separated conversions
-        && (m_photometric != PHOTOMETRIC_SEPARATED
-            && m_photometric != PHOTOMETRIC_PALETTE)
-        // no non-multiple-of-8 bits per sample
-        && (spec().format.size() * 8 == m_bitspersample)
-        // contig planarconfig only (for now?)
-        && !m_separate
-        // only deflate/zip compression with horizontal predictor
-        && m_compression == COMPRESSION_ADOBE_DEFLATE
-        && m_predictor == PREDICTOR_HORIZONTAL
-        // only uint8, uint16
-        && (m_spec.format == TypeUInt8 || m_spec.format == TypeUInt16)
-        // No other unusual cases
-        && !m_use_rgba_interface
-        // only if we're threading and don't enter the thread pool recursively!
-        && pool->size() > 1
-        && !pool->is_worker()
-        // only if this ImageInput wasn't asked to be single-threaded
-        && this->threads() != 1
-        // and not if the feature is turned off
-        && m_spec.get_int_attribute("tiff:multithread",
-                                    OIIO::get_int_attribute("tiff:multithread"));
 
-    // If we're not parallelizing, just call the parent class default
-    // implementaiton of read_native_tiles, which will loop over the tiles
-    // and read each one individually.
-    if (!parallelize) {
-        return ImageInput::read_native_tiles(subimage, miplevel, xbegin, xend,
-                                             ybegin, yend, zbegin, zend, data);
-    }
-
-    // Make room for, and read the raw (still compressed) tiles. As each one
-    // is read, kick off the decompress and any other extras, to execute in
-    // parallel.
-    stride_t pixel_bytes   = (stride_t)m_spec.pixel_bytes(true);
-    stride_t tileystride   = pixel_bytes * m_spec.tile_width;
-    stride_t tilezstride   = tileystride * m_spec.tile_height;
-    stride_t ystride       = (xend - xbegin) * pixel_bytes;
-    stride_t zstride       = (yend - ybegin) * ystride;
-    imagesize_t tile_bytes = m_spec.tile_bytes(true);
-    int tilevals           = m_spec.tile_pixels() * m_spec.nchannels;
-    size_t cbound          = compressBound((uLong)tile_bytes);
-    std::unique_ptr<char[]> compressed_scratch(new char[cbound * ntiles]);
-    std::unique_ptr<char[]> scratch(new char[tile_bytes * ntiles]);
-    task_set tasks(pool);
-    bool ok = true;  // failed compression will stash a false here
-
-    // Strutil::printf ("Parallel tile case %d %d  %d %d  %d %d\n",
-    //                  xbegin, xend, ybegin, yend, zbegin, zend);
-    size_t tileidx = 0;
-    for (int z = zbegin; z < zend; z += m_spec.tile_depth) {
-        for (int y = ybegin; y < yend; y += m_spec.tile_height) {
-            for (int x = xbegin; x < xend; x += m_spec.tile_width, ++tileidx) {
-                char* cbuf = compressed_scratch.get() + tileidx * cbound;
-                char* ubuf = scratch.get() + tileidx * tile_bytes;
-                auto csize = TIFFReadRawTile(m_tif, tile_index(x, y, z), cbuf,
-                                             tmsize_t(cbound));
-                if (csize < 0) {
-                    std::string err = oiio_tiff_last_error();
-                    errorf(
-                        "TIFFReadRawTile failed reading tile x=%d,y=%d,z=%d: %s",
-                        x, y, z, err.size() ? err.c_str() : "unknown error");
-                    return false;
-                }
-                // Push the rest of the work onto the thread pool queue
-                auto out = this;
-                tasks.push(pool->push([=, &ok](int /*id*/) {
-                    out->uncompress_one_strip(cbuf, (unsigned long)csize, ubuf,
-                                              tile_bytes, out->m_spec.nchannels,
-                                              out->m_spec.tile_width,
-                                              out->m_spec.tile_height
-                                                  * out->m_spec.tile_depth,
-                                              &ok);
-                    if (out->m_photometric == PHOTOMETRIC_MINISWHITE)
-                        out->invert_photometric(tilevals, ubuf);
-                    copy_image(out->m_spec.nchannels, out->m_spec.tile_width,
-                               out->m_spec.tile_height, out->m_spec.tile_depth,
-                               ubuf, size_t(pixel_bytes), pixel_bytes,
-                               tileystride, tilezstride,
-                               (char*)data + (z - zbegin) * zstride
-                                   + (y - ybegin) * ystride
-                                   + (x - xbegin) * pixel_bytes,
-                               pixel_bytes, ystride, zstride);
-                }));
+
+bool
+TIFFInput::read_raw_tile(int subimage, int miplevel, int x, int y, int z,
+                         std::vector<unsigned char>& rawdata)
+{
+    // The raw data of the tile (one chunk per plane), followed by the size
+    // of each plane's chunk, followed by the TIFFRawChunkInfo describing
+    // how to decode them. That trailer lets decode_raw_tile work without
+    // the lock and regardless of which subimage is current by then.
+    lock_guard lock(*this);
+    if (!seek_subimage(subimage, miplevel))
+        return false;
+    TIFFRawChunkInfo info = raw_chunk_info(m_spec.tile_width,
+                                           m_spec.tile_height
+                                               * m_spec.tile_depth);
+    std::vector<uint64_t> sizes;
+    rawdata.clear();
+    if (raw_chunks_ok()) {
+        for (int c = 0; c < info.planes; ++c) {
+            ttile_t tile   = TIFFComputeTile(m_tif, x - m_spec.x, y - m_spec.y,
+                                             z - m_spec.z, c);
+            tmsize_t csize = raw_chunk_size(tile);
+            size_t offset  = rawdata.size();
+            if (csize >= 0) {
+                rawdata.resize(offset + size_t(csize));
+                csize = TIFFReadRawTile(m_tif, tile, rawdata.data() + offset,
+                                        csize);
+            }
+            if (csize < 0) {
+                std::string err = oiio_tiff_last_error();
+                errorf("TIFFReadRawTile failed reading tile x=%d,y=%d,z=%d: %s",
+                       x, y, z, err.size() ? err.c_str() : "unknown error");
+                return false;
             }
+            rawdata.resize(offset + size_t(csize));
+            sizes.push_back(uint64_t(csize));
+        }
+    } else {
+        // Nothing we can decode without libtiff, so do all the work here
+        // and leave decode_raw_tile nothing but a copy.
+        rawdata.resize(m_spec.tile_bytes(true));
+        if (!read_native_tile(subimage, miplevel, x, y, z, rawdata.data()))
+            return false;
+        info.decoded    = 1;
+        info.planes     = 1;
+        info.miniswhite = 0;
+        sizes.push_back(rawdata.size());
+    }
+    const unsigned char* sizebytes = (const unsigned char*)sizes.data();
+    rawdata.insert(rawdata.end(), sizebytes,
+                   sizebytes + sizes.size() * sizeof(uint64_t));
+    rawdata.insert(rawdata.end(), (const unsigned char*)&info,
+                   (const unsigned char*)&info + sizeof(info));
+    return true;
+}
+
+
+
+bool
+TIFFInput::decode_raw_tile(int /*subimage*/, int /*miplevel*/, int x, int y,
+                           int z, span<unsigned char> rawdata, void* data)
+{
+    // N.B. No lock: everything we need is in the trailer that
+    // read_raw_tile appended to the raw data.
+    TIFFRawChunkInfo info;
+    size_t nbytes = rawdata.size();
+    if (nbytes >= sizeof(info))
+        memcpy(&info, rawdata.data() + nbytes - sizeof(info), sizeof(info));
+    if (nbytes < sizeof(info) || info.planes < 1
+        || nbytes < sizeof(info) + info.planes * sizeof(uint64_t)) {
+        errorf("Corrupt raw TIFF tile x=%d,y=%d,z=%d", x, y, z);
+        return false;
+    }
+    size_t databytes = nbytes - sizeof(info) - info.planes * sizeof(uint64_t);
+    std::vector<cspan<unsigned char>> planes;
+    size_t offset = 0;
+    for (int c = 0; c < info.planes; ++c) {
+        uint64_t size;
+        memcpy(&size, rawdata.data() + databytes + c * sizeof(uint64_t),
+               sizeof(size));
+        if (offset + size > databytes) {
+            errorf("Corrupt raw TIFF tile x=%d,y=%d,z=%d", x, y, z);
+            return false;
         }
+        planes.emplace_back(rawdata.data() + offset, size_t(size));
+        offset += size_t(size);
     }
-    return ok;
+    if (info.decoded) {
+        memcpy(data, planes[0].data(), planes[0].size());
+        return true;
+    }
+    if (!decode_raw_chunk(info, planes.data(), data)) {
+        errorf("Could not decompress TIFF tile x=%d,y=%d,z=%d", x, y, z);
+        return false;
+    }
+    return true;
 }
 
 
@@ -23,6 +23,8 @@
 #include <OpenImageIO/tiffutils.h>
 #include <OpenImageIO/timer.h>
 
+#include "tiff_pvt.h"
+
 
 OIIO_PLUGIN_NAMESPACE_BEGIN
 
@@ -58,6 +60,15 @@ public:
                              const void* data, stride_t xstride = AutoStride,
                              stride_t ystride = AutoStride,
                              stride_t zstride = AutoStride) override;
+    virtual bool copy_image(ImageInput* in) override;
+
+protected:
+    virtual int pipeline_chunk_size() const override;
+    virtual bool
+    pipeline_compress(const ROI& chunk, void* data,
+                      std::vector<unsigned char>& compressed) const override;
+    virtual bool pipeline_write(const ROI& chunk,
+                                cspan<unsigned char> compressed) override;
 
 private:
     TIFF* m_tif = nullptr;
@@ -143,7 +154,7 @@ private:
     // be the same.
     template<typename T>
     void horizontal_predictor(T* dst, const T* src, int chans, int width,
-                              int height)
+                              int height) const
     {
         for (int y = 0; y < height;
              ++y, src += chans * width, dst += chans * width)
@@ -155,10 +166,38 @@ private:
             }
     }
 
+    // Can we compress strips or tiles ourselves and write them raw?
+    bool can_compress_raw() const
+    {
+        return
+            // not palette or cmyk color separated conversions
+            (m_photometric != PHOTOMETRIC_SEPARATED
+             && m_photometric != PHOTOMETRIC_PALETTE)
+            // no non-multiple-of-8 bits per sample
+            && (spec().format.size() * 8 == m_bitspersample)
+            // contig planarconfig only
+            && m_planarconfig == PLANARCONFIG_CONTIG
+            // only deflate/zip compression with horizontal predictor
+            && m_compression == COMPRESSION_ADOBE_DEFLATE
+            && m_predictor == PREDICTOR_HORIZONTAL
+            // only uint8, uint16
+            && (m_spec.format == TypeUInt8 || m_spec.format == TypeUInt16)
+            // and not if the feature is turned off
+            && m_spec.get_int_attribute(
+                "tiff:multithread",
+                OIIO::get_int_attribute("tiff:multithread"));
+    }
+
+    // Copy the compressed strips or tiles of the directory that `in` is
+    // reading, if they can be written here unchanged. Set `copied` if the
+    // raw copy was attempted; if it wasn't, the pixels need to be copied
+    // the usual way.
+    bool copy_raw_chunks(TIFF* in, bool& copied);
+
     void compress_one_strip(void* uncompressed_buf, size_t strip_bytes,
                             void* compressed_buf, unsigned long cbound,
                             int channels, int width, int height,
-                            unsigned long* compressed_size, bool* ok);
+                            unsigned long* compressed_size, bool* ok) const;
 
     int tile_index(int x, int y, int z)
     {
@@ -1169,7 +1208,7 @@ void
 TIFFOutput::compress_one_strip(void* uncompressed_buf, size_t strip_bytes,
                                void* compressed_buf, unsigned long cbound,
                                int channels, int width, int height,
-                               unsigned long* compressed_size, bool* ok)
+                               unsigned long* compressed_size, bool* ok) const
 {
     if (m_spec.format == TypeUInt8)
         horizontal_predictor((unsigned char*)uncompressed_buf,
@@ -1179,6 +1218,19 @@ TIFFOutput::compress_one_strip(void* uncompressed_buf, size_t strip_bytes,
         horizontal_predictor((unsigned short*)uncompressed_buf,
                              (unsigned short*)uncompressed_buf, channels, width,
                              height);
+#ifdef USE_LIBDEFLATE
+    if (libdeflate_compressor* c = thread_deflate_compressor(m_zipquality)) {
+        // A result of 0 means it didn't fit in cbound, which is computed
+        // for zlib; let zlib have a go in that (unlikely) case.
+        size_t csize = libdeflate_zlib_compress(c, uncompressed_buf,
+                                                strip_bytes, compressed_buf,
+                                                cbound);
+        if (csize) {
+            *compressed_size = (unsigned long)csize;
+            return;
+        }
+    }
+#endif
     *compressed_size = cbound;
     auto zok         = compress2((Bytef*)compressed_buf, compressed_size,
                          (const Bytef*)uncompressed_buf,
@@ -1209,26 +1261,13 @@ TIFFOutput::write_scanlines(int ybegin, int yend, int z, TypeDesc format,
         && is_strip_boundary(yend)
         // and more than one, or no point parallelizing
         && nstrips > 1
-        // and not palette or cmyk color separated conversions
-        && (m_photometric != PHOTOMETRIC_SEPARATED
-            && m_photometric != PHOTOMETRIC_PALETTE)
-        // no non-multiple-of-8 bits per sample
-        && (spec().format.size() * 8 == m_bitspersample)
-        // contig planarconfig only
-        && m_planarconfig == PLANARCONFIG_CONTIG
-        // only deflate/zip compression with horizontal predictor
-        && m_compression == COMPRESSION_ADOBE_DEFLATE
-        && m_predictor == PREDICTOR_HORIZONTAL
-        // only uint8, uint16
-        && (m_spec.format == TypeUInt8 || m_spec.format == TypeUInt16)
+        // and a data layout and compression we can handle ourselves
+        && can_compress_raw()
         // only if we're threading and don't enter the thread pool recursively!
         && pool->size() > 1
         && !pool->is_worker()
         // only if this ImageInput wasn't asked to be single-threaded
-        && this->threads() != 1
-        // and not if the feature is turned off
-        && m_spec.get_int_attribute("tiff:multithread",
-                                    OIIO::get_int_attribute("tiff:multithread"));
+        && this->threads() != 1;
 
     // If we're not parallelizing, just call the parent class default
     // implementaiton of write_scanlines, which will loop over the scanlines
@@ -1439,24 +1478,11 @@ TIFFOutput::write_tiles(int xbegin, int xend, int ybegin, int yend, int zbegin,
     bool parallelize =
         // more than one tile, or no point parallelizing
         ntiles > 1
-        // and not palette or cmyk color separated conversions
-        && (m_photometric != PHOTOMETRIC_SEPARATED
-            && m_photometric != PHOTOMETRIC_PALETTE)
-        // no non-multiple-of-8 bits per sample
-        && (spec().format.size() * 8 == m_bitspersample)
-        // contig planarconfig only
-        && m_planarconfig == PLANARCONFIG_CONTIG
-        // only deflate/zip compression with horizontal predictor
-        && m_compression == COMPRESSION_ADOBE_DEFLATE
-        && m_predictor == PREDICTOR_HORIZONTAL
-        // only uint8, uint16
-        && (m_spec.format == TypeUInt8 || m_spec.format == TypeUInt16)
+        // and a data layout and compression we can handle ourselves
+        && can_compress_raw()
         // only if we're threading and don't enter the thread pool recursively!
         && pool->size() > 1
-        && !pool->is_worker()
-        // and not if the feature is turned off
-        && m_spec.get_int_attribute("tiff:multithread",
-                                    OIIO::get_int_attribute("tiff:multithread"));
+        && !pool->is_worker();
 
     // If we're not parallelizing, just call the parent class default
     // implementaiton of write_tiles, which will loop over the tiles and
@@ -1572,6 +1598,191 @@ TIFFOutput::write_tiles(int xbegin, int xend, int ybegin, int yend, int zbegin,
 
 
 
+int
+TIFFOutput::pipeline_chunk_size() const
+{
+    if (!m_tif || !can_compress_raw())
+        return 0;
+    if (m_spec.tile_width)
+        return 1;
+    return m_spec.depth <= 1 ? m_rowsperstrip : 0;
+}
+
+
+
+bool
+TIFFOutput::pipeline_compress(const ROI& chunk, void* data,
+                              std::vector<unsigned char>& compressed) const
+{
+    int width = m_spec.tile_width ? m_spec.tile_width : m_spec.width;
+    int height = m_spec.tile_width
+                     ? m_spec.tile_height * std::max(1, m_spec.tile_depth)
+                     : chunk.height();
+    size_t nbytes = size_t(m_spec.pixel_bytes(true)) * width * height;
+    unsigned long cbound = compressBound((uLong)nbytes);
+    compressed.resize(cbound);
+    unsigned long clen = 0;
+    bool ok            = true;
+    compress_one_strip(data, nbytes, compressed.data(), cbound,
+                       m_spec.nchannels, width, height, &clen, &ok);
+    compressed.resize(ok ? clen : 0);
+    return ok;
+}
+
+
+
+bool
+TIFFOutput::pipeline_write(const ROI& chunk, cspan<unsigned char> compressed)
+{
+    if (m_spec.tile_width) {
+        int tile = tile_index(chunk.xbegin, chunk.ybegin, chunk.zbegin);
+        if (TIFFWriteRawTile(m_tif, uint32_t(tile), (void*)compressed.data(),
+                             tmsize_t(compressed.size()))
+            < 0) {
+            std::string err = oiio_tiff_last_error();
+            errorfmt("TIFFWriteRawTile failed writing tile {} (x={},y={},z={}): {}",
+                     tile, chunk.xbegin, chunk.ybegin, chunk.zbegin,
+                     err.size() ? err : "unknown error");
+            return false;
+        }
+    } else {
+        tstrip_t stripnum = (chunk.ybegin - m_spec.y) / m_rowsperstrip;
+        if (TIFFWriteRawStrip(m_tif, stripnum, (void*)compressed.data(),
+                              tmsize_t(compressed.size()))
+            < 0) {
+            std::string err = oiio_tiff_last_error();
+            errorfmt("TIFFWriteRawStrip failed writing line y={},z={}: {}",
+                     chunk.ybegin, chunk.zbegin,
+                     err.size() ? err : "unknown error");
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
+bool
+TIFFOutput::copy_image(ImageInput* in)
+{
+    // Another TIFF file may be copied without decoding and re-encoding its
+    // pixels, if its strips or tiles can be written here as they are.
+    auto source = dynamic_cast<TIFFRawSource*>(in);
+    if (source && !m_spec.deep) {
+        ImageInput::lock_guard lock(*in);
+        bool copied = false;
+        bool ok     = copy_raw_chunks(source->raw_tif(), copied);
+        if (copied)
+            return ok;
+    }
+    return ImageOutput::copy_image(in);
+}
+
+
+
+bool
+TIFFOutput::copy_raw_chunks(TIFF* in, bool& copied)
+{
+    copied = false;
+    if (!in || !m_tif)
+        return true;
+
+    // Strips or tiles are only interchangeable if everything that
+    // determines how the pixels are laid out and compressed is the same.
+    auto same16 = [&](ttag_t tag) {
+        uint16_t a = 0, b = 0;
+        return TIFFGetFieldDefaulted(in, tag, &a) == 1
+               && TIFFGetFieldDefaulted(m_tif, tag, &b) == 1 && a == b;
+    };
+    auto same32 = [&](ttag_t tag) {
+        uint32_t a = 0, b = 0;
+        return TIFFGetFieldDefaulted(in, tag, &a) == 1
+               && TIFFGetFieldDefaulted(m_tif, tag, &b) == 1 && a == b;
+    };
+    bool tiled = TIFFIsTiled(m_tif);
+    if (bool(TIFFIsTiled(in)) != tiled)
+        return true;
+    for (ttag_t tag : { TIFFTAG_BITSPERSAMPLE, TIFFTAG_SAMPLESPERPIXEL,
+                        TIFFTAG_SAMPLEFORMAT, TIFFTAG_PLANARCONFIG,
+                        TIFFTAG_COMPRESSION, TIFFTAG_PHOTOMETRIC })
+        if (!same16(tag))
+            return true;
+    // Not every codec knows a predictor, so don't ask for a default
+    uint16_t inpredictor = PREDICTOR_NONE;
+    TIFFGetField(in, TIFFTAG_PREDICTOR, &inpredictor);
+    if (inpredictor != m_predictor)
+        return true;
+    for (ttag_t tag : { TIFFTAG_IMAGEWIDTH, TIFFTAG_IMAGELENGTH,
+                        TIFFTAG_IMAGEDEPTH })
+        if (!same32(tag))
+            return true;
+    if (tiled ? !(same32(TIFFTAG_TILEWIDTH) && same32(TIFFTAG_TILELENGTH)
+                  && same32(TIFFTAG_TILEDEPTH))
+              : !same32(TIFFTAG_ROWSPERSTRIP))
+        return true;
+    // Only compression methods whose chunks stand alone. (JPEG, for
+    // example, may keep tables in the directory rather than the chunks.)
+    switch (m_compression) {
+    case COMPRESSION_NONE:
+    case COMPRESSION_LZW:
+    case COMPRESSION_ADOBE_DEFLATE:
+    case COMPRESSION_DEFLATE:
+    case COMPRESSION_PACKBITS:
+#ifdef COMPRESSION_ZSTD
+    case COMPRESSION_ZSTD:
+#endif
+#ifdef COMPRESSION_LZMA
+    case COMPRESSION_LZMA:
+#endif
+        break;
+    default: return true;
+    }
+    if (m_photometric == PHOTOMETRIC_YCBCR)
+        return true;
+    // Multi-byte samples are stored in the byte order of their file
+    if (m_bitspersample > 8
+        && TIFFIsByteSwapped(in) != TIFFIsByteSwapped(m_tif))
+        return true;
+
+    uint32_t nchunks   = tiled ? TIFFNumberOfTiles(in) : TIFFNumberOfStrips(in);
+    toff_t* bytecounts = nullptr;
+    if (nchunks != (tiled ? TIFFNumberOfTiles(m_tif)
+                          : TIFFNumberOfStrips(m_tif))
+        || !TIFFGetField(in,
+                         tiled ? TIFFTAG_TILEBYTECOUNTS
+                               : TIFFTAG_STRIPBYTECOUNTS,
+                         &bytecounts)
+        || !bytecounts)
+        return true;
+
+    copied = true;
+    std::vector<unsigned char> raw;
+    for (uint32_t c = 0; c < nchunks; ++c) {
+        raw.resize(size_t(bytecounts[c]));
+        tmsize_t n = tiled ? TIFFReadRawTile(in, c, raw.data(),
+                                             tmsize_t(raw.size()))
+                           : TIFFReadRawStrip(in, c, raw.data(),
+                                              tmsize_t(raw.size()));
+        if (n < 0) {
+            std::string err = oiio_tiff_last_error();
+            errorfmt("Failed reading raw {} {}: {}", tiled ? "tile" : "strip",
+                     c, err.size() ? err : "unknown error");
+            return false;
+        }
+        if ((tiled ? TIFFWriteRawTile(m_tif, c, raw.data(), n)
+                   : TIFFWriteRawStrip(m_tif, c, raw.data(), n))
+            < 0) {
+            std::string err = oiio_tiff_last_error();
+            errorfmt("Failed writing raw {} {}: {}", tiled ? "tile" : "strip",
+                     c, err.size() ? err : "unknown error");
+            return false;
+        }
+    }
+    return true;
+}
+
+
+
 bool
 TIFFOutput::source_is_cmyk(const ImageSpec& spec)
 {
@@ -2,6 +2,8 @@
 // SPDX-License-Identifier: BSD-3-Clause
 // https://github.com/OpenImageIO/oiio
 
+#include <map>
+
 #include <OpenImageIO/filesystem.h>
 #include <OpenImageIO/imagebufalgo.h>
 #include <OpenImageIO/imageio.h>
@@ -45,6 +47,14 @@ private:
     WebPIterator m_iter;
     int m_subimage      = -1;  // Subimage we're pointed to
     int m_subimage_read = -1;  // Subimage stored in decoded_image
+    // Frames that fully overwrite the canvas, and so don't depend on any
+    // of the frames before them.
+    std::vector<bool> m_keyframe;
+    // Composited canvas after every m_snapshot_interval'th frame, so that
+    // random access doesn't have to start over from the first frame.
+    std::map<int, std::unique_ptr<uint8_t[]>> m_snapshots;
+    int m_snapshot_interval = 0;
+    bool m_use_threads      = true;  // Let libwebp decode with a second thread
 
     void init(void)
     {
@@ -69,6 +79,14 @@ private:
     // immediately preceding it.
     bool read_current_subimage();
 
+    // Decode the current frame into an 8 bit RGB or RGBA buffer, return
+    // true for success.
+    bool decode_frame(uint8_t* dst, size_t size, int stride, bool alpha);
+
+    // Scan the frame headers to find the keyframes and size the snapshot
+    // interval.
+    void build_index();
+
     // Reposition to the desired subimage and also read the pixels if `read`
     // is true. Return true for success, false for failure. This is all the
     // hard logic about how to get to the right spot if it's not the next
@@ -90,7 +108,9 @@ bool
 WebpInput::open(const std::string& name, ImageSpec& spec,
                 const ImageSpec& config)
 {
-    m_filename = name;
+    m_filename    = name;
+    m_use_threads = config.get_int_attribute("webp:use_threads",
+                                             threads() != 1);
 
     ioproxy_retrieve_from_config(config);
     if (!ioproxy_use_or_open(name))
@@ -199,6 +219,7 @@ WebpInput::open(const std::string& name, ImageSpec& spec,
 
     // Make space for the decoded image
     m_decoded_image.reset(new uint8_t[m_spec.image_bytes()]);
+    build_index();
 
     seek_subimage(0, 0);
     spec = m_spec;
@@ -207,6 +228,31 @@ WebpInput::open(const std::string& name, ImageSpec& spec,
 
 
 
+void
+WebpInput::build_index()
+{
+    m_keyframe.assign(m_frame_count, false);
+    m_snapshots.clear();
+    for (int f = 0; f < m_frame_count; ++f) {
+        if (!WebPDemuxGetFrame(m_demux, f + 1, &m_iter))
+            break;
+        m_keyframe[f] = f == 0
+                        || (!m_iter.has_alpha && m_iter.x_offset == 0
+                            && m_iter.y_offset == 0
+                            && m_iter.width == m_spec.width
+                            && m_iter.height == m_spec.height);
+    }
+    // Keep the snapshots within a fixed memory budget, however long the
+    // animation, but don't bother snapshotting very often.
+    const size_t budget = size_t(64) << 20;
+    size_t imagebytes   = std::max(size_t(m_spec.image_bytes()), size_t(1));
+    size_t maxsnaps     = std::max(budget / imagebytes, size_t(1));
+    m_snapshot_interval = std::max(8, int((m_frame_count + maxsnaps - 1)
+                                          / maxsnaps));
+}
+
+
+
 bool
 WebpInput::seek_subimage(int subimage, int miplevel)
 {
@@ -247,26 +293,27 @@ WebpInput::read_subimage(int subimage, bool read)
     if (m_subimage == subimage && read_current_subimage())
         return true;
 
-    // All other cases: backtrack to the beginning and read up to where
-    // we need to be.
-    m_subimage      = -1;
-    m_subimage_read = -1;
+    // All other cases: back up to the closest frame that we can start
+    // decoding from -- one that doesn't depend on its predecessors, one
+    // right after a snapshot, or one right after what we've last read --
+    // and read up to where we need to be.
+    if (subimage >= int(m_keyframe.size()))
+        return false;
+    int start = subimage;
+    while (start > 0 && !m_keyframe[start] && start - 1 != m_subimage_read
+           && !m_snapshots.count(start - 1))
+        --start;
+    if (start > 0 && !m_keyframe[start] && start - 1 != m_subimage_read)
+        memcpy(m_decoded_image.get(), m_snapshots[start - 1].get(),
+               m_spec.image_bytes());
+    m_subimage      = start - 1;
+    m_subimage_read = start - 1;
     while (m_subimage < subimage) {
-        if (iter_to_subimage(m_subimage + 1) && read_current_subimage())
-            m_subimage_read = m_subimage;
-        else
+        if (!iter_to_subimage(m_subimage + 1) || !read_current_subimage())
             return false;
     }
 
     return true;
-
-    // FIXME: this covers the common cases efficiently: sequential or random
-    // access for reading just subimage metadata, and sequential access to
-    // subimages for reading pixels. Random access to subimages requiring
-    // pixel reads incurs lots of backtracking. It would be straightforward
-    // to add the case where we randomly seek forward (just keep reading
-    // until we catch up), but we can leave that until it becomes apparent
-    // that this is an important performance case.
 }
 
 
@@ -284,28 +331,19 @@ WebpInput::read_current_subimage()
     if (m_subimage_read != m_subimage - 1)
         return false;  // fail -- last read is not merely one frame behind
 
-    uint8_t* okptr = nullptr;
+    bool ok = false;
     if (m_subimage == 0 || !m_iter.has_alpha) {
         // No alpha supplied (or first image) -- full overwrite
         size_t offset = (m_iter.y_offset * m_spec.width + m_iter.x_offset)
                         * m_spec.pixel_bytes();
-        if (m_spec.nchannels == 3) {
-            okptr = WebPDecodeRGBInto(m_iter.fragment.bytes,
-                                      m_iter.fragment.size,
-                                      m_decoded_image.get() + offset,
-                                      m_spec.image_bytes() - offset,
-                                      m_spec.scanline_bytes());
-        } else {
-            OIIO_DASSERT(m_spec.nchannels == 4);
-            okptr = WebPDecodeRGBAInto(m_iter.fragment.bytes,
-                                       m_iter.fragment.size,
-                                       m_decoded_image.get() + offset,
-                                       m_spec.image_bytes() - offset,
-                                       m_spec.scanline_bytes());
+        ok = decode_frame(m_decoded_image.get() + offset,
+                          m_spec.image_bytes() - offset,
+                          m_spec.scanline_bytes(), m_spec.nchannels == 4);
+        if (m_spec.nchannels == 4) {
             // WebP requires unassociated alpha, and it's sRGB.
             // Handle this all by wrapping an IB around it.
             ImageBuf fullbuf(m_spec, m_decoded_image.get());
-            ImageBufAlgo::premult(fullbuf, fullbuf);
+            ImageBufAlgo::premult(fullbuf, fullbuf, {}, threads());
         }
     } else {
         // This subimage writes *atop* the prior image, we must composite
@@ -316,27 +354,51 @@ WebpInput::read_current_subimage()
         fragspec.x = m_iter.x_offset;
         fragspec.y = m_iter.y_offset;
         ImageBuf fragbuf(fragspec);
-        okptr = WebPDecodeRGBAInto(m_iter.fragment.bytes, m_iter.fragment.size,
-                                   (uint8_t*)fragbuf.localpixels(),
-                                   fragspec.image_bytes(),
-                                   fragspec.scanline_bytes());
+        ok = decode_frame((uint8_t*)fragbuf.localpixels(),
+                          fragspec.image_bytes(), fragspec.scanline_bytes(),
+                          true);
         // WebP requires unassociated alpha, and it's sRGB.
         // Handle this all by wrapping an IB around it.
-        ImageBufAlgo::premult(fragbuf, fragbuf);
-        ImageBufAlgo::over(fullbuf, fragbuf, fullbuf);
+        ImageBufAlgo::premult(fragbuf, fragbuf, {}, threads());
+        ImageBufAlgo::over(fullbuf, fragbuf, fullbuf, {}, threads());
     }
 
-    if (!okptr) {
+    if (!ok) {
         errorfmt("Couldn't decode subimage {}", m_subimage);
         return false;
     }
 
     m_subimage_read = m_subimage;
+    if (m_snapshot_interval && m_subimage > 0
+        && m_subimage % m_snapshot_interval == 0
+        && !m_snapshots.count(m_subimage)) {
+        std::unique_ptr<uint8_t[]> snap(new uint8_t[m_spec.image_bytes()]);
+        memcpy(snap.get(), m_decoded_image.get(), m_spec.image_bytes());
+        m_snapshots[m_subimage] = std::move(snap);
+    }
     return true;
 }
 
 
 
+bool
+WebpInput::decode_frame(uint8_t* dst, size_t size, int stride, bool alpha)
+{
+    WebPDecoderConfig config;
+    if (!WebPInitDecoderConfig(&config))
+        return false;
+    config.options.use_threads       = m_use_threads;
+    config.output.colorspace         = alpha ? MODE_RGBA : MODE_RGB;
+    config.output.is_external_memory = 1;
+    config.output.u.RGBA.rgba        = dst;
+    config.output.u.RGBA.stride      = stride;
+    config.output.u.RGBA.size        = size;
+    return WebPDecode(m_iter.fragment.bytes, m_iter.fragment.size, &config)
+           == VP8_STATUS_OK;
+}
+
+
+
 bool
 WebpInput::read_native_scanline(int subimage, int miplevel, int y, int /*z*/,
                                 void* data)
@@ -363,7 +425,10 @@ WebpInput::close()
     }
     m_decoded_image.reset();
     m_encoded_image.reset();
-    m_subimage = -1;
+    m_keyframe.clear();
+    m_snapshots.clear();
+    m_subimage      = -1;
+    m_subimage_read = -1;
     init();
     return true;
 }
@@ -391,6 +456,10 @@ webp_input_imageio_create()
 
 OIIO_EXPORT const char* webp_input_extensions[] = { "webp", nullptr };
 
+OIIO_EXPORT const char* webp_input_signatures[] = {
+    "52494646????????57454250", nullptr
+};
+
 OIIO_PLUGIN_EXPORTS_END
 
 OIIO_PLUGIN_NAMESPACE_END
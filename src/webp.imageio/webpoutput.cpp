@@ -99,27 +99,57 @@ WebpOutput::open(const std::string& name, const ImageSpec& spec, OpenMode mode)
     m_webp_picture.writer     = WebpImageWriter;
     m_webp_picture.custom_ptr = (void*)ioproxy();
 
-    if (!WebPConfigInit(&m_webp_config)) {
-        errorfmt("Couldn't initialize WebPPicture\n");
+    auto compqual = m_spec.decode_compression_metadata("webp", 100);
+    // If compression name wasn't "webp", don't trust the quality metric,
+    // just use the default.
+    int quality = Strutil::iequals(compqual.first, "webp")
+                      ? OIIO::clamp(compqual.second, 1, 100)
+                      : 100;
+
+    // Start from one of libwebp's content presets if asked to. The
+    // "fast" preset trades some compression for the lowest encode
+    // latency, for things like batch thumbnail generation.
+    std::string preset = m_spec.get_string_attribute("webp:preset", "default");
+    WebPPreset webp_preset = WEBP_PRESET_DEFAULT;
+    if (Strutil::iequals(preset, "picture"))
+        webp_preset = WEBP_PRESET_PICTURE;
+    else if (Strutil::iequals(preset, "photo"))
+        webp_preset = WEBP_PRESET_PHOTO;
+    else if (Strutil::iequals(preset, "drawing"))
+        webp_preset = WEBP_PRESET_DRAWING;
+    else if (Strutil::iequals(preset, "icon"))
+        webp_preset = WEBP_PRESET_ICON;
+    else if (Strutil::iequals(preset, "text"))
+        webp_preset = WEBP_PRESET_TEXT;
+    if (!WebPConfigPreset(&m_webp_config, webp_preset, float(quality))) {
+        errorfmt("Couldn't initialize WebPConfig\n");
         close();
         return false;
     }
-
-    auto compqual = m_spec.decode_compression_metadata("webp", 100);
-    if (Strutil::iequals(compqual.first, "webp")) {
-        m_webp_config.method  = 6;
-        m_webp_config.quality = OIIO::clamp(compqual.second, 1, 100);
-    } else {
-        // If compression name wasn't "webp", don't trust the quality
-        // metric, just use the default.
-        m_webp_config.method  = 6;
-        m_webp_config.quality = 100;
-    }
+    bool fast = Strutil::iequals(preset, "fast");
 
     // Lossless encoding (0=lossy(default), 1=lossless).
     m_webp_config.lossless
         = (m_spec.get_string_attribute("compression", "lossy") == "lossless");
 
+    // Effort: 0 is fastest, 6 (our default) compresses best.
+    m_webp_config.method = OIIO::clamp(
+        m_spec.get_int_attribute("webp:method", fast ? 0 : 6), 0, 6);
+    if (fast) {
+        m_webp_config.segments = 1;
+        m_webp_config.pass     = 1;
+    }
+
+    // Let libwebp use a second thread for lossy encoding, unless we've been
+    // asked to stay on the calling thread.
+    m_webp_config.thread_level = m_spec.get_int_attribute("webp:thread_level",
+                                                          threads() != 1);
+    if (!WebPValidateConfig(&m_webp_config)) {
+        errorfmt("Invalid WebP encoding configuration");
+        close();
+        return false;
+    }
+
     // forcing UINT8 format
     m_spec.set_format(TypeDesc::UINT8);
     m_dither = m_spec.get_int_attribute("oiio:dither", 0);
@@ -151,9 +181,10 @@ WebpOutput::write_scanline(int y, int z, TypeDesc format, const void* data,
             ImageSpec specwrap(m_spec.width, m_spec.height, 4, TypeUInt8);
             ImageBuf bufwrap(specwrap, &m_uncompressed_image[0]);
             ROI rgbroi(0, m_spec.width, 0, m_spec.height, 0, 1, 0, 3);
-            ImageBufAlgo::pow(bufwrap, bufwrap, 2.2f, rgbroi);
-            ImageBufAlgo::unpremult(bufwrap, bufwrap);
-            ImageBufAlgo::pow(bufwrap, bufwrap, 1.0f / 2.2f, rgbroi);
+            ImageBufAlgo::pow(bufwrap, bufwrap, 2.2f, rgbroi, threads());
+            ImageBufAlgo::unpremult(bufwrap, bufwrap, {}, threads());
+            ImageBufAlgo::pow(bufwrap, bufwrap, 1.0f / 2.2f, rgbroi,
+                              threads());
             WebPPictureImportRGBA(&m_webp_picture, &m_uncompressed_image[0],
                                   m_scanline_size);
         } else {
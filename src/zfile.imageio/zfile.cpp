@@ -131,6 +131,10 @@ zfile_input_imageio_create()
 
 OIIO_EXPORT const char* zfile_input_extensions[] = { "zfile", nullptr };
 
+OIIO_EXPORT const char* zfile_input_signatures[] = {
+    "ab67082f", "2f0867ab", nullptr
+};
+
 OIIO_EXPORT ImageOutput*
 zfile_output_imageio_create()
 {
@@ -134,6 +134,28 @@ def test_multiimage () :
 
 
 
+# Test the buffer protocol view of an ImageBuf's pixels, and wrapping a
+# numpy array as an ImageBuf, neither of which copies the pixels.
+def test_buffer_protocol () :
+    print ("Testing buffer protocol:")
+    b = oiio.ImageBuf (oiio.ImageSpec (3, 2, 4, "float"))
+    a = numpy.asarray (b)
+    print ("  view shape", a.shape, "dtype", a.dtype)
+    a[1][2] = (0.5, 0.25, 0.125, 1.0)
+    print ("  pixel 2,1 after writing the view:", b.getpixel (2, 1))
+    arr = numpy.zeros ((2, 3, 1), dtype="f")
+    w = oiio.ImageBuf.wrap (arr)
+    print ("  wrapped", w.spec().width, "x", w.spec().height, "x",
+           w.spec().nchannels, str(w.spec().format))
+    w.setpixel (1, 0, (0.75,))
+    print ("  array after setpixel:", arr[0][1][0])
+    arr[1][2][0] = 0.5
+    print ("  pixel 2,1 after writing the array:", w.getpixel (2, 1))
+    print ("  view shares the array:",
+           numpy.shares_memory (numpy.asarray (w), arr))
+
+
+
 ######################################################################
 # main test starts here
 
@@ -225,6 +247,7 @@ try:
     test_perchannel_formats ()
     test_deep ()
     test_multiimage ()
+    test_buffer_protocol ()
 
     print ("\nDone.")
 except Exception as detail:
@@ -0,0 +1,3 @@
+#!/usr/bin/env python
+
+command += pythonbin + " src/test_imagecache.py > out.txt"
@@ -0,0 +1,84 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+from __future__ import absolute_import
+import numpy
+import OpenImageIO as oiio
+from OpenImageIO import ImageBuf, ImageSpec, ImageBufAlgo, ImageCache, ROI
+
+
+# Make a small test image whose pixel values encode their coordinates
+def make_test_image (filename) :
+    buf = ImageBuf (ImageSpec (8, 8, 3, "float"))
+    for y in range (8) :
+        for x in range (8) :
+            buf.setpixel (x, y, (x / 8.0, y / 8.0, 0.5))
+    buf.write (filename)
+
+
+######################################################################
+# main test starts here
+
+try:
+    make_test_image ("coords.exr")
+    ic = ImageCache ()
+
+    # Plain get_pixels allocates a new array
+    p = ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3)
+    print ("get_pixels:", p.shape, p.dtype)
+    print (p.tolist ())
+
+    # Fill a preallocated array in place
+    out = numpy.zeros ((2, 2, 3), dtype="float32")
+    r = ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3, out=out)
+    print ("out= returns its array:", r is out)
+    print ("out= matches:", numpy.array_equal (out, p))
+
+    # A strided view: every other pixel of a bigger array
+    big = numpy.zeros ((2, 4, 3), dtype="float32")
+    ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3, out=big[:, ::2, :])
+    print ("strided out= matches:", numpy.array_equal (big[:, ::2, :], p),
+           "untouched:", not big[:, 1::2, :].any ())
+
+    # The element type comes from the array
+    u8 = numpy.zeros ((2, 2, 3), dtype="uint8")
+    ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3, out=u8)
+    print ("uint8 out=:", u8[1, 1].tolist ())
+
+    # Mismatched types or shapes are errors
+    try :
+        ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3,
+                       datatype="uint16", out=out)
+    except Exception as e :
+        print ("mismatched type raised", type(e).__name__)
+    try :
+        ic.get_pixels ("coords.exr", 0, 0, 2, 4, 1, 3,
+                       out=numpy.zeros ((3, 3, 3), dtype="float32"))
+    except Exception as e :
+        print ("mismatched shape raised", type(e).__name__)
+
+    # Many same-sized crops at once, into a new array or a reused one
+    rois = [ ROI(0, 2, 0, 2), ROI(4, 6, 2, 4), ROI(6, 8, 6, 8, 0, 1, 0, 2) ]
+    try :
+        ic.get_pixels_batch ("coords.exr", 0, 0, rois)
+    except Exception as e :
+        print ("different-sized ROIs raised", type(e).__name__)
+    rois[2].chend = 10000
+    batch = ic.get_pixels_batch ("coords.exr", 0, 0, rois)
+    print ("get_pixels_batch:", batch.shape, batch.dtype)
+    for roi, crop in zip (rois, batch) :
+        single = ic.get_pixels ("coords.exr", 0, 0, roi.xbegin, roi.xend,
+                                roi.ybegin, roi.yend)
+        print ("  crop", roi, "matches:", numpy.array_equal (crop, single))
+    reused = numpy.zeros ((3, 2, 2, 3), dtype="float16")
+    r = ic.get_pixels_batch ("coords.exr", 0, 0, rois, out=reused, nthreads=2)
+    print ("batch out= returns its array:", r is reused, reused.dtype)
+    print ("batch out= matches:", numpy.array_equal (reused, batch))
+
+    print ("Missing file:",
+           ic.get_pixels_batch ("nonexistent.exr", 0, 0, rois))
+    ic.geterror ()
+
+    print ("\nDone.")
+except Exception as detail:
+    print ("Unknown exception:", detail)
@@ -49,6 +49,18 @@ diff = oiio.ImageBufAlgo.compare(checker_buf, render_buf, 0, 0)
 
 print("top mip pixel differences when streaming =", diff.nfail)
 
+# The same, with all the lookups in a single call with arrays
+ys, xs = numpy.mgrid[0:512, 0:512]
+s = (xs + 0.5) / 512.0
+t = (ys + 0.5) / 512.0
+zero = numpy.zeros_like (s)
+array_pixels = texture_sys.texture_array(checker, texture_opt, s, t,
+                                         zero, zero, zero, zero, 3)
+print("array lookup result shape =", array_pixels.shape, array_pixels.dtype)
+render_buf.set_pixels(render_buf.roi, array_pixels)
+diff = oiio.ImageBufAlgo.compare(checker_buf, render_buf, 0, 0)
+print("top mip pixel differences with array lookup =", diff.nfail)
+
 print ("")
 
 # Test udim
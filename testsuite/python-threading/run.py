@@ -0,0 +1,3 @@
+#!/usr/bin/env python
+
+command += pythonbin + " src/test_threading.py > out.txt"
@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+from __future__ import absolute_import
+import asyncio
+import threading
+import OpenImageIO as oiio
+from OpenImageIO import ImageBuf, ImageSpec, ImageBufAlgo, ImageInput, ImageOutput
+
+
+# Run func in a second thread, and report whether this thread got to run
+# Python code while func was in its long C++ call, which it can only do if
+# the binding released the GIL. This is what lets a Python thread pool
+# convert images concurrently.
+def test_releases_gil (name, func) :
+    started = threading.Event ()
+    def worker () :
+        started.set ()
+        func ()
+    t = threading.Thread (target=worker)
+    t.start ()
+    started.wait ()
+    count = 0
+    while t.is_alive () :
+        count += 1
+    t.join ()
+    print (name, "releases the GIL:", count > 100)
+
+
+def read_image (filename) :
+    inp = ImageInput.open (filename)
+    inp.read_image ("float")
+    inp.close ()
+
+
+def write_image (buf, filename) :
+    out = ImageOutput.create (filename)
+    out.open (filename, buf.spec())
+    out.write_image (buf.get_pixels ("float"))
+    out.close ()
+
+
+
+# Read several files at once with the async methods, while counting how
+# often the event loop got to run another coroutine in the meantime.
+async def test_async (filenames) :
+    ticks = 0
+    done = False
+    async def ticker () :
+        nonlocal ticks
+        while not done :
+            ticks += 1
+            await asyncio.sleep (0)
+    async def load (filename) :
+        inp = ImageInput.open (filename)
+        pixels = await inp.read_image_async ("float")
+        inp.close ()
+        return pixels
+    tick_task = asyncio.ensure_future (ticker ())
+    arrays = await asyncio.gather (*[load (f) for f in filenames])
+    buf = ImageBuf (filenames[0])
+    read_ok = await buf.read_async (force=True)
+    write_ok = await buf.write_async ("async.exr", "half")
+    done = True
+    await tick_task
+    print ("read_image_async shapes:", [a.shape for a in arrays])
+    print ("read_image_async matches read_image:",
+           all ((a == ImageInput.open (f).read_image ("float")).all ()
+                for a, f in zip (arrays, filenames)))
+    print ("ImageBuf.read_async:", read_ok, "write_async:", write_ok)
+    print ("event loop ran during the I/O:", ticks > 10)
+    missing = ImageBuf ("nonexistent.exr")
+    print ("read_async of a missing file:", await missing.read_async ())
+
+
+######################################################################
+# main test starts here
+
+try:
+    big = ImageBuf (ImageSpec (1024, 1024, 4, "float"))
+    ImageBufAlgo.noise (big, "uniform", 0.0, 1.0, nthreads=1)
+
+    test_releases_gil ("ImageBufAlgo.resize",
+                       lambda: ImageBufAlgo.resize (big, "lanczos3",
+                                                    roi=oiio.ROI(0, 1500, 0, 1500),
+                                                    nthreads=1))
+    test_releases_gil ("ImageBuf.write",
+                       lambda: big.write ("big.exr", "half"))
+    test_releases_gil ("ImageInput.read_image",
+                       lambda: read_image ("big.exr"))
+    test_releases_gil ("ImageOutput.write_image",
+                       lambda: write_image (big, "big2.exr"))
+    test_releases_gil ("ImageBuf.get_pixels",
+                       lambda: big.get_pixels ("half"))
+    asyncio.run (test_async (["big.exr", "big2.exr"]))
+
+    print ("Done.")
+except Exception as detail:
+    print ("Unknown exception:", detail)